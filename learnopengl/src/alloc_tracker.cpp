@@ -0,0 +1,248 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+// ALLOC_TRACKING 0 leaves operator new and delete to the standard library and compiles
+// every ALLOC_TAG away
+#ifndef ALLOC_TRACKING
+#define ALLOC_TRACKING 1
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Counts every operator new and delete of the program, by the tag of the scope the thread
+// is in (ALLOC_TAG, "untagged" outside any) and by frame. The render loop calls
+// beginFrame() once per frame, frameAllocations is then what the frame before allocated
+// on every thread. A thread that calls guard(true) flags each allocation it makes from
+// then on with its tag and size, which is how --assert-no-alloc checks that the steady
+// state loop of the main thread doesn't allocate. Aligned new (over-aligned types) and
+// malloc itself aren't seen.
+class AllocTracker
+{
+  public:
+    static const int MAX_TAGS = 32;
+    // flagged allocations printed, the rest are only counted
+    static const unsigned int MAX_REPORTS = 16;
+
+    struct Tag
+    {
+        std::atomic<const char *> name{NULL};
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> bytes{0};
+    };
+
+    Tag tags[MAX_TAGS];
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> frees{0};
+    std::atomic<uint64_t> bytes{0};
+    // allocations made on a guarded thread
+    std::atomic<uint64_t> violations{0};
+
+    // allocations and bytes of the last whole frame, every thread
+    uint64_t frameAllocations = 0;
+    uint64_t frameBytes = 0;
+
+    static AllocTracker &instance()
+    {
+        // constant initialized, usable from the first operator new on
+        static AllocTracker tracker;
+        return tracker;
+    }
+
+    // the slot of a tag name, a string literal compared by address; the last slot takes
+    // every name past MAX_TAGS
+    int tag(const char *name)
+    {
+        for (int i = 1; i < MAX_TAGS - 1; i++)
+        {
+            const char *current = tags[i].name.load(std::memory_order_acquire);
+            if (current == name)
+                return i;
+            const char *empty = NULL;
+            if (!current && tags[i].name.compare_exchange_strong(empty, name))
+                return i;
+            if (empty == name)
+                return i;
+        }
+        return MAX_TAGS - 1;
+    }
+
+    void beginFrame()
+    {
+        uint64_t count = allocations.load(std::memory_order_relaxed);
+        uint64_t total = bytes.load(std::memory_order_relaxed);
+        frameAllocations = count - frameStartAllocations;
+        frameBytes = total - frameStartBytes;
+        frameStartAllocations = count;
+        frameStartBytes = total;
+    }
+
+    // flags the calling thread's allocations from now on, or stops flagging them
+    static void guard(bool on)
+    {
+        guarded() = on;
+    }
+
+    static int &currentTag()
+    {
+        thread_local int current = 0;
+        return current;
+    }
+
+    void recordAllocation(size_t size)
+    {
+        int slot = currentTag();
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+        tags[slot].allocations.fetch_add(1, std::memory_order_relaxed);
+        tags[slot].bytes.fetch_add(size, std::memory_order_relaxed);
+        if (guarded())
+        {
+            uint64_t index = violations.fetch_add(1, std::memory_order_relaxed);
+            // stdio without a std::string, the report mustn't allocate through operator new itself
+            if (index < MAX_REPORTS)
+            {
+                const char *name = tags[slot].name.load(std::memory_order_relaxed);
+                std::fprintf(stderr, "ERROR::ALLOC_TRACKER::ALLOCATION_IN_FRAME: %zu bytes in %s\n", size,
+                             name ? name : "untagged");
+            }
+            allocationFlagged();
+        }
+    }
+
+    void recordFree()
+    {
+        frees.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // the totals and every tag that allocated anything
+    void print() const
+    {
+        std::printf("allocations %llu (%llu bytes), frees %llu, flagged %llu\n",
+                    (unsigned long long)allocations.load(), (unsigned long long)bytes.load(),
+                    (unsigned long long)frees.load(), (unsigned long long)violations.load());
+        for (int i = 0; i < MAX_TAGS; i++)
+        {
+            uint64_t count = tags[i].allocations.load();
+            if (count == 0)
+                continue;
+            const char *name = tags[i].name.load();
+            std::printf("  %-24s %10llu allocations %14llu bytes\n", name ? name : "untagged",
+                        (unsigned long long)count, (unsigned long long)tags[i].bytes.load());
+        }
+    }
+
+  private:
+    uint64_t frameStartAllocations = 0;
+    uint64_t frameStartBytes = 0;
+
+    static bool &guarded()
+    {
+        thread_local bool on = false;
+        return on;
+    }
+
+    // a place for a breakpoint (or an abort()) on a flagged allocation
+    static void allocationFlagged()
+    {
+    }
+};
+
+// tags the allocations of the rest of the scope on this thread, the previous tag comes back after it
+class AllocScope
+{
+  public:
+    AllocScope(const char *name) : previous(AllocTracker::currentTag())
+    {
+        AllocTracker::currentTag() = AllocTracker::instance().tag(name);
+    }
+
+    ~AllocScope()
+    {
+        AllocTracker::currentTag() = previous;
+    }
+
+    AllocScope(const AllocScope &) = delete;
+    AllocScope &operator=(const AllocScope &) = delete;
+
+  private:
+    int previous;
+};
+
+#if ALLOC_TRACKING
+#define ALLOC_CONCAT_(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_(a, b)
+// tags the allocations of the rest of the enclosing scope, name must be a string literal
+#define ALLOC_TAG(name) AllocScope ALLOC_CONCAT(allocScope, __LINE__)(name)
+
+// the replacements every operator new and delete of the program go through; the global
+// operators are replaced at link time, so camera.cpp, glad.c and stb_image.cpp allocate through
+// them as well. Defined once, in the main.cpp unity build.
+void *operator new(size_t size)
+{
+    void *memory = std::malloc(size ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    AllocTracker::instance().recordAllocation(size);
+    return memory;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    void *memory = std::malloc(size ? size : 1);
+    if (memory)
+        AllocTracker::instance().recordAllocation(size);
+    return memory;
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *memory) noexcept
+{
+    if (!memory)
+        return;
+    AllocTracker::instance().recordFree();
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    operator delete(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    operator delete(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+    operator delete(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept
+{
+    operator delete(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept
+{
+    operator delete(memory);
+}
+#else
+#define ALLOC_TAG(name)
+#endif
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef AMBIENT_OCCLUSION_H
+#define AMBIENT_OCCLUSION_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "frame_graph.cpp"
+#include "gpu_profiler.cpp"
+#include "post_process.cpp"
+#include "shader.cpp"
+#include "shader_compiler.cpp"
+#include "single_pass_downsampler.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+
+// Screen space ambient occlusion at half resolution, as passes at the head of the
+// PostProcessGraph: prepare() builds a half resolution depth and its coarser levels from the
+// frame's depth with the SinglePassDownsampler (one dispatch, the nearest depth of each 2x2),
+// "ao" takes the occlusion of every half resolution pixel from taps over a disc in view space
+// (shader_src/ssao.fs), "ao temporal" averages its noise over the frames into a history kept
+// here and "ao apply" upsamples the result along the depth edges and darkens the frame with it.
+// The frame the rest of the graph reads is the darkened one. Quarter the pixels of a full
+// resolution occlusion left 12 taps of a half disc each enough, the turned noise of a frame is
+// what the history smooths over the next ones. Every pass is a zone of the GpuProfiler.
+class AmbientOcclusion
+{
+  public:
+    // levels of the half resolution depth, ssao.fs reads up to MAX_LEVEL
+    static constexpr int DEPTH_LEVELS = 4;
+
+    // of the disc, in view space units
+    float radius = 1.0f;
+    float intensity = 1.0f;
+    // the weight of this frame's occlusion against the history
+    float feedback = 0.1f;
+
+    AmbientOcclusion(ShaderCompiler &compiler, SinglePassDownsampler &downsampler, bool reversedZ)
+        : occlusionShader(compiler.submit("src/shader_src/post.vs", "src/shader_src/ssao.fs")),
+          temporalShader(compiler.submit("src/shader_src/post.vs", "src/shader_src/ao_temporal.fs")),
+          applyShader(compiler.submit("src/shader_src/post.vs", "src/shader_src/ao_apply.fs")),
+          downsampler(downsampler), reversedZ(reversedZ)
+    {
+    }
+
+    AmbientOcclusion(const AmbientOcclusion &) = delete;
+    AmbientOcclusion &operator=(const AmbientOcclusion &) = delete;
+
+    // the half resolution depth is made by the downsampler's compute shader
+    static bool isSupported()
+    {
+        return SinglePassDownsampler::isSupported();
+    }
+
+    // the passes over source into graph, returns the handle of the frame with the occlusion on it
+    int addPasses(PostProcessGraph &graph, int source)
+    {
+        this->graph = &graph;
+        halfDepthInput = graph.addExternal("ao half depth");
+        depthInput = graph.addExternal("ao depth");
+        historyInput = graph.addExternal("ao history");
+        historyOutput = graph.addExternal("ao history next");
+        float z = reversedZ ? 1.0f : 0.0f;
+        occlusionPass =
+            graph.addPass("ao", occlusionShader, {halfDepthInput}, 0.5f, GL_R8, glm::vec4(radius, intensity, z, 0.0f));
+        temporalPass = graph.addPass("ao temporal", temporalShader, {occlusionPass, historyInput, halfDepthInput},
+                                     0.5f, GL_R8, glm::vec4(feedback, 0.0f, z, 0.0f));
+        graph.setTarget(temporalPass, historyOutput);
+        int apply = graph.addPass("ao apply", applyShader, {source, temporalPass, depthInput, halfDepthInput}, 1.0f,
+                                  GL_RGBA16F, glm::vec4(0.0f, 0.0f, z, 0.0f));
+
+        projectionLoc = occlusionShader.uniform("projection");
+        occlusionInverseLoc = occlusionShader.uniform("inverseProjection");
+        reprojectionLoc = temporalShader.uniform("reprojection");
+        applyInverseLoc = applyShader.uniform("inverseProjection");
+        graph.setUniforms(occlusionPass, [this](Shader &shader) {
+            shader.set(projectionLoc, projection);
+            shader.set(occlusionInverseLoc, inverseProjection);
+        });
+        graph.setUniforms(temporalPass, [this](Shader &shader) { shader.set(reprojectionLoc, reprojection); });
+        graph.setUniforms(apply, [this](Shader &shader) { shader.set(applyInverseLoc, inverseProjection); });
+        return apply;
+    }
+
+    // before the graph's execute() over a width x height frame: the half resolution depth of
+    // depth, drawn with projection and viewProjection, and the history to read and write
+    void prepare(const Texture2D &depth, const glm::mat4 &projection, const glm::mat4 &viewProjection, int width,
+                 int height, GpuProfiler &profiler)
+    {
+        if (!graph)
+            return;
+        int halfWidth = std::max(1, depth.width / 2), halfHeight = std::max(1, depth.height / 2);
+        if (halfDepth.width != halfWidth || halfDepth.height != halfHeight)
+            halfDepth.create(halfWidth, halfHeight, GL_R32F,
+                             std::min(DEPTH_LEVELS, Texture2D::mipCount(halfWidth, halfHeight)),
+                             GPU_MEMORY_RENDER_TARGETS);
+        profiler.begin("ao depth");
+        downsampler.generateFromDepth(depth, halfDepth, reversedZ ? DOWNSAMPLE_MAX : DOWNSAMPLE_MIN);
+        profiler.end();
+
+        // the history at the scale of the occlusion pass
+        int historyWidth = std::max(1, (int)(width * 0.5f)), historyHeight = std::max(1, (int)(height * 0.5f));
+        if (!history[0] || history[0]->width != historyWidth || history[0]->height != historyHeight)
+        {
+            for (RenderTargetPool::Target *&target : history)
+            {
+                targets.release(target);
+                target = targets.acquire(historyWidth, historyHeight, GL_R8);
+            }
+            historyValid = false;
+        }
+        targets.endFrame();
+        bool complete = history[0] && history[1];
+        if (!complete)
+            historyValid = false;
+        RenderTargetPool::Target *previous = history[latest], *next = history[1 - latest];
+
+        graph->setExternal(halfDepthInput, &halfDepth);
+        graph->setExternal(depthInput, &depth);
+        graph->setExternal(historyInput, complete ? &previous->color : NULL);
+        graph->setExternal(historyOutput, complete ? &next->color : NULL, complete ? next->FBO : 0);
+        float z = reversedZ ? 1.0f : 0.0f;
+        graph->setParams(occlusionPass, glm::vec4(radius, intensity, z, (float)(frame++ % 64)));
+        graph->setParams(temporalPass, glm::vec4(feedback, historyValid ? 1.0f : 0.0f, z, 0.0f));
+        this->projection = projection;
+        inverseProjection = glm::inverse(projection);
+        reprojection = previousViewProjection * glm::inverse(viewProjection);
+        previousViewProjection = viewProjection;
+
+        latest = 1 - latest;
+        historyValid = complete;
+    }
+
+  private:
+    Shader &occlusionShader;
+    Shader &temporalShader;
+    Shader &applyShader;
+    SinglePassDownsampler &downsampler;
+    bool reversedZ;
+    PostProcessGraph *graph = NULL;
+    int halfDepthInput = 0, depthInput = 0, historyInput = 0, historyOutput = 0;
+    int occlusionPass = 0, temporalPass = 0;
+    UniformHandle projectionLoc, occlusionInverseLoc, reprojectionLoc, applyInverseLoc;
+
+    Texture2D halfDepth;
+    RenderTargetPool targets;
+    RenderTargetPool::Target *history[2] = {NULL, NULL};
+    int latest = 0;
+    bool historyValid = false;
+    unsigned int frame = 0;
+    glm::mat4 projection = glm::mat4(1.0f), inverseProjection = glm::mat4(1.0f);
+    glm::mat4 reprojection = glm::mat4(1.0f), previousViewProjection = glm::mat4(1.0f);
+};
+
+#endif
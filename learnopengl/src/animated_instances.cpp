@@ -0,0 +1,119 @@
+#ifndef ANIMATED_INSTANCES_H
+#define ANIMATED_INSTANCES_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "instance_buffer.cpp"
+#include "mesh.cpp"
+#include "render_stats.cpp"
+#include "transform_system.cpp"
+
+#include <cstddef>
+#include <vector>
+
+// The objects of a TransformSystem drawn with everything their motion needs in a static
+// buffer written once: position and radians per second, the axis and the texture layer
+// of every object, read by the SHADER_ANIMATED vertex variant as per-instance attributes.
+// The vertex stage builds the rotation from FrameData's time, the same matrix as
+// TransformSystem::update(time), so a frame draws all of them with no CPU work and no
+// upload. The draw is not culled, every object is an instance of every frame.
+class AnimatedInstances
+{
+  public:
+    // where the animated vertex shader reads them, the instanced model matrix's locations
+    static const unsigned int POSITION_LOCATION = 2;
+    static const unsigned int AXIS_LOCATION = 3;
+    static const unsigned int LAYER_LOCATION = 6;
+
+    unsigned int VAO = 0;
+    unsigned int buffer = 0;
+    size_t count = 0;
+
+    AnimatedInstances()
+    {
+    }
+
+    ~AnimatedInstances()
+    {
+        if (VAO)
+            glDeleteVertexArrays(1, &VAO);
+        if (buffer)
+            deleteBuffers(1, &buffer);
+    }
+
+    AnimatedInstances(const AnimatedInstances &) = delete;
+    AnimatedInstances &operator=(const AnimatedInstances &) = delete;
+
+    // one instance per object of system with layers[i] as its texture layer, drawing mesh
+    void create(const Mesh &mesh, const TransformSystem &system, const std::vector<int> &layers)
+    {
+        std::vector<Instance> instances(system.size());
+        for (size_t i = 0; i < system.size(); i++)
+        {
+            instances[i].positionSpeed =
+                glm::vec4(system.positionX[i], system.positionY[i], system.positionZ[i], system.angularSpeed[i]);
+            instances[i].axis = glm::vec3(system.axisX[i], system.axisY[i], system.axisZ[i]);
+            instances[i].layer = i < layers.size() ? layers[i] : 0;
+        }
+        count = instances.size();
+        this->mesh = &mesh;
+        // written here once and never again
+        buffer = createBuffer(instances.size() * sizeof(Instance), instances.data(), 0);
+
+        // the mesh's own vertices and indices, the instance stream on the same binding as InstanceBuffer's
+        VAO = createVertexArray();
+        mesh.layout.apply(VAO, mesh.VBO);
+        setElementBuffer(VAO, mesh.EBO);
+        const unsigned int binding = InstanceBuffer::MODEL_BINDING;
+        if (hasDSA())
+        {
+            glVertexArrayVertexBuffer(VAO, binding, buffer, 0, sizeof(Instance));
+            glVertexArrayAttribFormat(VAO, POSITION_LOCATION, 4, GL_FLOAT, GL_FALSE, offsetof(Instance, positionSpeed));
+            glVertexArrayAttribFormat(VAO, AXIS_LOCATION, 3, GL_FLOAT, GL_FALSE, offsetof(Instance, axis));
+            glVertexArrayAttribIFormat(VAO, LAYER_LOCATION, 1, GL_INT, offsetof(Instance, layer));
+            for (unsigned int location : {POSITION_LOCATION, AXIS_LOCATION, LAYER_LOCATION})
+            {
+                glVertexArrayAttribBinding(VAO, location, binding);
+                glEnableVertexArrayAttrib(VAO, location);
+            }
+            glVertexArrayBindingDivisor(VAO, binding, 1);
+            return;
+        }
+        glState.bindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glVertexAttribPointer(POSITION_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                              (void *)offsetof(Instance, positionSpeed));
+        glVertexAttribPointer(AXIS_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)offsetof(Instance, axis));
+        glVertexAttribIPointer(LAYER_LOCATION, 1, GL_INT, sizeof(Instance), (void *)offsetof(Instance, layer));
+        for (unsigned int location : {POSITION_LOCATION, AXIS_LOCATION, LAYER_LOCATION})
+        {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+    }
+
+    // every object in one instanced draw, with a SHADER_ANIMATED program in use
+    void draw() const
+    {
+        if (!VAO || !count)
+            return;
+        glState.bindVertexArray(VAO);
+        renderStats.countDraw(mesh->indexCount, count);
+        glDrawElementsInstanced(GL_TRIANGLES, mesh->indexCount, mesh->indexType, (void *)0, (GLsizei)count);
+    }
+
+  private:
+    struct Instance
+    {
+        glm::vec4 positionSpeed;
+        glm::vec3 axis;
+        int layer;
+    };
+
+    const Mesh *mesh = nullptr;
+};
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef ANTIALIASING_H
+#define ANTIALIASING_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "frame_graph.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "gpu_memory.cpp"
+#include "render_stats.cpp"
+#include "shader.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+enum AntiAliasingMode
+{
+    AA_OFF,
+    AA_MSAA_2X,
+    AA_MSAA_4X,
+    AA_MSAA_8X,
+    AA_FXAA,
+    AA_MODE_COUNT,
+};
+
+inline const char *antiAliasingName(AntiAliasingMode mode)
+{
+    switch (mode)
+    {
+    case AA_MSAA_2X:
+        return "msaa 2x";
+    case AA_MSAA_4X:
+        return "msaa 4x";
+    case AA_MSAA_8X:
+        return "msaa 8x";
+    case AA_FXAA:
+        return "fxaa";
+    default:
+        return "off";
+    }
+}
+
+// of --aa, off when unknown
+inline AntiAliasingMode parseAntiAliasing(const std::string &name)
+{
+    for (int mode = 0; mode < AA_MODE_COUNT; mode++)
+    {
+        std::string option = antiAliasingName((AntiAliasingMode)mode);
+        option.erase(std::remove(option.begin(), option.end(), ' '), option.end());
+        if (option == name)
+            return (AntiAliasingMode)mode;
+    }
+    return AA_OFF;
+}
+
+// samples per pixel of the MSAA modes, 0 for the others
+inline int msaaSamples(AntiAliasingMode mode)
+{
+    return mode == AA_MSAA_2X ? 2 : mode == AA_MSAA_4X ? 4 : mode == AA_MSAA_8X ? 8 : 0;
+}
+
+// Multisampled color and depth renderbuffers the frame is drawn into in place of the scene
+// target, resolve() blits both down into it before anything reads them: the color averaged
+// over the samples, the depth of one sample (a depth can't be averaged), so the Hi-Z, the
+// TAA and the post-processing take the resolved frame as they took the plain one.
+// The sample count is clamped to GL_MAX_SAMPLES.
+class MultisampleTarget
+{
+  public:
+    unsigned int FBO = 0;
+    int width = 0, height = 0;
+    int samples = 0;
+
+    MultisampleTarget()
+    {
+    }
+
+    ~MultisampleTarget()
+    {
+        release();
+    }
+
+    MultisampleTarget(const MultisampleTarget &) = delete;
+    MultisampleTarget &operator=(const MultisampleTarget &) = delete;
+
+    // (re)creates the renderbuffers when the size, sample count or format changed, false when incomplete
+    bool resize(int w, int h, int sampleCount, GLenum colorFormat)
+    {
+        if (w <= 0 || h <= 0 || sampleCount <= 0)
+            return false;
+        GLint maxSamples = 1;
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        sampleCount = std::min(sampleCount, (int)maxSamples);
+        if (FBO && w == width && h == height && sampleCount == samples && colorFormat == format)
+            return complete;
+        release();
+        width = w;
+        height = h;
+        samples = sampleCount;
+        format = colorFormat;
+
+        GLenum status;
+        if (hasDSA())
+        {
+            glCreateFramebuffers(1, &FBO);
+            glCreateRenderbuffers(1, &color);
+            glCreateRenderbuffers(1, &depth);
+            glNamedRenderbufferStorageMultisample(color, samples, format, width, height);
+            glNamedRenderbufferStorageMultisample(depth, samples, GL_DEPTH_COMPONENT32F, width, height);
+            glNamedFramebufferRenderbuffer(FBO, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+            glNamedFramebufferRenderbuffer(FBO, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+            status = glCheckNamedFramebufferStatus(FBO, GL_FRAMEBUFFER);
+        }
+        else
+        {
+            glGenFramebuffers(1, &FBO);
+            glGenRenderbuffers(1, &color);
+            glGenRenderbuffers(1, &depth);
+            glBindRenderbuffer(GL_RENDERBUFFER, color);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, format, width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, depth);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT32F, width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+            status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        gpuMemory.allocate(GPU_MEMORY_RENDER_TARGETS, bytes());
+        complete = status == GL_FRAMEBUFFER_COMPLETE;
+        if (!complete)
+            std::cout << "ERROR::MULTISAMPLE_TARGET::INCOMPLETE: 0x" << std::hex << status << std::dec << '\n';
+        return complete;
+    }
+
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    }
+
+    // the samples down into targetFBO of the same size, leaves that bound
+    void resolve(unsigned int targetFBO) const
+    {
+        if (hasDSA())
+        {
+            glBlitNamedFramebuffer(FBO, targetFBO, 0, 0, width, height, 0, 0, width, height,
+                                   GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        }
+        else
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFBO);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
+                              GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+    }
+
+  private:
+    unsigned int color = 0, depth = 0;
+    GLenum format = 0;
+    bool complete = false;
+
+    uint64_t bytes() const
+    {
+        return (RenderStats::storageBytes(format, width, height, 1, 1) +
+                RenderStats::storageBytes(GL_DEPTH_COMPONENT32F, width, height, 1, 1)) *
+               (uint64_t)samples;
+    }
+
+    void release()
+    {
+        if (!FBO)
+            return;
+        gpuMemory.release(GPU_MEMORY_RENDER_TARGETS, bytes());
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteRenderbuffers(1, &color);
+        glDeleteRenderbuffers(1, &depth);
+        FBO = color = depth = 0;
+    }
+};
+
+// FXAA in one full screen pass over the tone mapped frame (fxaa.fs): edges are found from the
+// luma contrast around each pixel and blended along, no extra samples are drawn. With the
+// post-processing on, its composite goes to inputFramebuffer() first, as FXAA wants the
+// display referred colors.
+class Fxaa
+{
+  public:
+    // the luma contrast below which a pixel isn't an edge, relative and absolute
+    float threshold = 0.125f;
+    float thresholdMin = 0.0312f;
+
+    Fxaa(Shader &program) : program(program), sampler(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)
+    {
+        emptyVAO = createVertexArray();
+        program.use();
+        program.setInt("input0", 0);
+        texelSizeLoc = program.uniform("texelSize");
+        paramsLoc = program.uniform("params");
+    }
+
+    ~Fxaa()
+    {
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    Fxaa(const Fxaa &) = delete;
+    Fxaa &operator=(const Fxaa &) = delete;
+
+    // an RGBA8 target of width x height for the tone mapped frame, draw() it with inputTexture()
+    unsigned int inputFramebuffer(int width, int height)
+    {
+        if (!input || input->width != width || input->height != height)
+        {
+            inputs.release(input);
+            input = inputs.acquire(width, height, GL_RGBA8);
+        }
+        inputs.endFrame();
+        return input ? input->FBO : 0;
+    }
+
+    const Texture2D *inputTexture() const
+    {
+        return input ? &input->color : NULL;
+    }
+
+    // source into targetFBO of the same size, leaves it bound with the viewport on it
+    void draw(const Texture2D &source, unsigned int targetFBO)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+        glViewport(0, 0, source.width, source.height);
+        glState.disable(GL_DEPTH_TEST);
+        glState.setDepthMask(false);
+        glState.disable(GL_BLEND);
+        glState.bindVertexArray(emptyVAO);
+        program.use();
+        source.bind(0);
+        sampler.bind(0);
+        program.set(texelSizeLoc, glm::vec2(1.0f / source.width, 1.0f / source.height));
+        program.set(paramsLoc, glm::vec4(threshold, thresholdMin, 0.0f, 0.0f));
+        renderStats.countDraw(3);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glState.setDepthMask(true);
+        glState.enable(GL_DEPTH_TEST);
+    }
+
+  private:
+    Shader &program;
+    UniformHandle texelSizeLoc, paramsLoc;
+    Sampler sampler;
+    unsigned int emptyVAO = 0;
+    RenderTargetPool inputs;
+    RenderTargetPool::Target *input = NULL;
+};
+
+#endif
@@ -0,0 +1,319 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include "async_io.cpp"
+#include "hash.cpp"
+#include "huge_pages.cpp"
+#include "lz4.cpp"
+#include "mapped_file.cpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Single file archive of the res/ and shader_src/ trees, built by --pack and memory mapped
+// at runtime. Layout: AssetPackHeader, the entries sorted by name hash, the names, then
+// every blob at an ASSET_PACK_ALIGNMENT boundary so it starts on its own page.
+// Stored blobs are handed out as pointers into the mapping, LZ4 ones are decompressed
+// into the caller's buffer. Little endian, read on the kind of machine that wrote it.
+
+#define ASSET_PACK_MAGIC 0x4B415041u // "APAK"
+#define ASSET_PACK_VERSION 1u
+#define ASSET_PACK_ALIGNMENT 4096u
+
+enum AssetCompression : uint32_t
+{
+    ASSET_STORED,
+    ASSET_LZ4
+};
+
+struct AssetPackHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t entriesOffset;
+    uint64_t namesOffset;
+};
+static_assert(sizeof(AssetPackHeader) == 32, "asset pack header is 32 bytes");
+
+struct AssetPackEntry
+{
+    uint64_t nameHash;
+    uint64_t offset;
+    // bytes in the pack and after decompression, the same for stored entries
+    uint64_t storedSize;
+    uint64_t size;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t compression;
+    uint32_t reserved;
+};
+static_assert(sizeof(AssetPackEntry) == 48, "asset pack entry is 48 bytes");
+
+// the key of a path, "./res/a.png", "res\a.png" and "res/a.png" all name the same entry
+inline std::string assetName(const std::string &path)
+{
+    std::string name = std::filesystem::path(path).lexically_normal().generic_string();
+    if (name.compare(0, 2, "./") == 0)
+        name.erase(0, 2);
+    return name;
+}
+
+class AssetPack
+{
+  public:
+    bool open(const std::string &path)
+    {
+        close();
+        if (!file.open(path))
+            return false;
+        AssetPackHeader header;
+        if (file.size < sizeof(header))
+            return fail(path);
+        std::memcpy(&header, file.data, sizeof(header));
+        if (header.magic != ASSET_PACK_MAGIC || header.version != ASSET_PACK_VERSION ||
+            header.entriesOffset % alignof(AssetPackEntry) != 0 ||
+            header.entriesOffset > file.size ||
+            header.entryCount > (file.size - header.entriesOffset) / sizeof(AssetPackEntry) ||
+            header.namesOffset > file.size)
+            return fail(path);
+        entries = (const AssetPackEntry *)(file.data + header.entriesOffset);
+        names = (const char *)(file.data + header.namesOffset);
+        count = header.entryCount;
+        size_t namesEnd = (size_t)header.namesOffset;
+        for (size_t i = 0; i < count; i++)
+        {
+            const AssetPackEntry &entry = entries[i];
+            // read() and view() hand out size bytes of a stored entry, and the sum mustn't wrap;
+            // read() allocates size bytes for an LZ4 one, more than it can decompress to is corrupt
+            if (entry.offset > file.size || entry.storedSize > file.size - entry.offset ||
+                (entry.compression == ASSET_STORED && entry.size != entry.storedSize) ||
+                (entry.compression == ASSET_LZ4 && entry.size > lz4MaxDecompressedSize(entry.storedSize)) ||
+                header.namesOffset + entry.nameOffset + entry.nameLength > file.size ||
+                (i > 0 && entries[i - 1].nameHash > entry.nameHash))
+                return fail(path);
+            namesEnd = std::max(namesEnd, (size_t)(header.namesOffset + entry.nameOffset + entry.nameLength));
+        }
+        // the names are compared on every lookup, the first ones would wait on the disk otherwise
+        file.willNeed((size_t)header.namesOffset, namesEnd - (size_t)header.namesOffset);
+        if (hugePagesEnabled)
+            file.adviseHugePages();
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        entries = NULL;
+        names = NULL;
+        count = 0;
+    }
+
+    bool isOpen() const
+    {
+        return file.isOpen();
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    const AssetPackEntry *find(const std::string &path) const
+    {
+        if (!count)
+            return NULL;
+        std::string name = assetName(path);
+        uint64_t hash = fnv1a64(name.data(), name.size());
+        const AssetPackEntry *first = std::lower_bound(
+            entries, entries + count, hash, [](const AssetPackEntry &entry, uint64_t key) { return entry.nameHash < key; });
+        for (const AssetPackEntry *entry = first; entry < entries + count && entry->nameHash == hash; entry++)
+        {
+            if (entry->nameLength == name.size() && std::memcmp(names + entry->nameOffset, name.data(), name.size()) == 0)
+                return entry;
+        }
+        return NULL;
+    }
+
+    // the bytes of a stored entry inside the mapping, false when missing or compressed
+    bool view(const std::string &path, const unsigned char *&data, size_t &size) const
+    {
+        const AssetPackEntry *entry = find(path);
+        if (!entry || entry->compression != ASSET_STORED)
+            return false;
+        data = file.data + entry->offset;
+        size = (size_t)entry->size;
+        return true;
+    }
+
+    // copies or decompresses an entry, Buffer is std::string or std::vector<unsigned char>
+    template <typename Buffer> bool read(const std::string &path, Buffer &out) const
+    {
+        const AssetPackEntry *entry = find(path);
+        if (!entry)
+            return false;
+        const unsigned char *stored = file.data + entry->offset;
+        out.resize((size_t)entry->size);
+        if (out.empty())
+            return true;
+        if (entry->compression == ASSET_STORED)
+        {
+            std::memcpy(&out[0], stored, out.size());
+            return true;
+        }
+        if (entry->compression == ASSET_LZ4 &&
+            lz4Decompress(stored, (size_t)entry->storedSize, (unsigned char *)&out[0], out.size()))
+            return true;
+        std::cout << "ERROR::ASSET_PACK::CORRUPT_ENTRY: " << path << '\n';
+        out.clear();
+        return false;
+    }
+
+    // readahead for one entry, or every entry with an empty path
+    void willNeed(const std::string &path = "") const
+    {
+        if (path.empty())
+        {
+            file.willNeed(0, file.size);
+            return;
+        }
+        if (const AssetPackEntry *entry = find(path))
+            file.willNeed((size_t)entry->offset, (size_t)entry->storedSize);
+    }
+
+  private:
+    MappedFile file;
+    const AssetPackEntry *entries = NULL;
+    const char *names = NULL;
+    size_t count = 0;
+
+    bool fail(const std::string &path)
+    {
+        std::cout << "ERROR::ASSET_PACK::INVALID: " << path << '\n';
+        close();
+        return false;
+    }
+};
+
+// opened by main() when there is a pack, every loader asks it before the file system
+inline AssetPack assetPack;
+
+// a whole file from disk through the I/O service, Buffer as in AssetPack::read(); the caller
+// waits, so it goes ahead of everything but other waiting reads unless told otherwise
+template <typename Buffer>
+inline bool readFileContents(const std::string &path, Buffer &out, IOPriority priority = IO_HIGH)
+{
+    return asyncIO.read(path, out, priority);
+}
+
+// the pack's copy when it has one, the file otherwise
+template <typename Buffer> inline bool readAsset(const std::string &path, Buffer &out, IOPriority priority = IO_HIGH)
+{
+    return assetPack.read(path, out) || readFileContents(path, out, priority);
+}
+
+// Packs every file under the directories into output, names relative to the working
+// directory like the paths the loaders use. Text sources are LZ4 compressed when that
+// saves at least an eighth, images and cooked files stay stored so they map without a copy.
+inline bool writeAssetPack(const std::string &output, const std::vector<std::string> &directories)
+{
+    struct Source
+    {
+        std::string name;
+        std::vector<unsigned char> data;
+        uint32_t compression;
+        uint64_t size;
+    };
+    std::vector<Source> sources;
+    std::error_code error;
+    std::filesystem::path outputPath = std::filesystem::absolute(output, error).lexically_normal();
+    for (const std::string &directory : directories)
+    {
+        for (const std::filesystem::directory_entry &item :
+             std::filesystem::recursive_directory_iterator(directory, error))
+        {
+            if (!item.is_regular_file() || std::filesystem::absolute(item.path(), error).lexically_normal() == outputPath)
+                continue;
+            Source source;
+            source.name = assetName(item.path().string());
+            if (!readFileContents(item.path().string(), source.data))
+            {
+                std::cout << "ERROR::ASSET_PACK::COULD_NOT_READ: " << source.name << '\n';
+                return false;
+            }
+            source.size = source.data.size();
+            source.compression = ASSET_STORED;
+            std::string extension = item.path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            const char *textExtensions[] = {".vs", ".fs", ".comp", ".glsl", ".obj", ".gltf", ".txt", ".json"};
+            if (std::find(std::begin(textExtensions), std::end(textExtensions), extension) != std::end(textExtensions))
+            {
+                std::vector<unsigned char> compressed = lz4Compress(source.data.data(), source.data.size());
+                if (compressed.size() <= source.data.size() - source.data.size() / 8)
+                {
+                    source.data.swap(compressed);
+                    source.compression = ASSET_LZ4;
+                }
+            }
+            sources.push_back(std::move(source));
+        }
+        if (error)
+        {
+            std::cout << "ERROR::ASSET_PACK::COULD_NOT_OPEN: " << directory << '\n';
+            return false;
+        }
+    }
+    std::sort(sources.begin(), sources.end(), [](const Source &a, const Source &b) {
+        return fnv1a64(a.name.data(), a.name.size()) < fnv1a64(b.name.data(), b.name.size());
+    });
+
+    AssetPackHeader header = {ASSET_PACK_MAGIC, ASSET_PACK_VERSION, (uint32_t)sources.size(), 0, sizeof(header), 0};
+    header.namesOffset = header.entriesOffset + sources.size() * sizeof(AssetPackEntry);
+    std::vector<AssetPackEntry> entries(sources.size());
+    std::string names;
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        entries[i] = {fnv1a64(sources[i].name.data(), sources[i].name.size()), 0, sources[i].data.size(),
+                      sources[i].size, (uint32_t)names.size(), (uint32_t)sources[i].name.size(),
+                      sources[i].compression, 0};
+        names += sources[i].name;
+    }
+    uint64_t offset = header.namesOffset + names.size();
+    for (AssetPackEntry &entry : entries)
+    {
+        offset = (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+        entry.offset = offset;
+        offset += entry.storedSize;
+    }
+
+    std::ofstream out(output, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cout << "ERROR::ASSET_PACK::COULD_NOT_WRITE: " << output << '\n';
+        return false;
+    }
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)entries.data(), entries.size() * sizeof(AssetPackEntry));
+    out.write(names.data(), names.size());
+    uint64_t written = header.namesOffset + names.size();
+    size_t storedBytes = 0;
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        std::vector<char> padding((size_t)(entries[i].offset - written), 0);
+        out.write(padding.data(), padding.size());
+        out.write((const char *)sources[i].data.data(), sources[i].data.size());
+        written = entries[i].offset + entries[i].storedSize;
+        storedBytes += sources[i].data.size();
+    }
+    std::cout << "packed " << sources.size() << " files, " << storedBytes << " bytes stored into " << output << '\n';
+    return (bool)out;
+}
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef ASSET_PREFETCH_H
+#define ASSET_PREFETCH_H
+
+#include "asset_pack.cpp"
+#include "image_convert.cpp"
+#include "image_decoder.cpp"
+#include "startup_graph.cpp"
+#include "stb_image.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Files and images the scene is known to need, read and decoded on the startup graph
+// while the window and context are still being created. Shader and TextureLoader ask
+// here before going to disk: file() and image() wait for the task when it is still
+// running and report a miss for anything that wasn't prefetched, so a caller never
+// has to know whether prefetching happened at all.
+class AssetPrefetch
+{
+  public:
+    ~AssetPrefetch()
+    {
+        stop();
+    }
+
+    // tasks go on graph, which has to outlive every call below until stop(),
+    // readFile() and decodeImage() are only valid in between
+    void start(StartupGraph &graph)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->graph = &graph;
+    }
+
+    // forgets the graph and frees whatever was never taken, tasks still running keep their entry
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        graph = NULL;
+        files.clear();
+        images.clear();
+    }
+
+    StartupGraph::Task readFile(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<FileEntry> &entry = files[path];
+        if (entry)
+            return entry->task;
+        std::shared_ptr<FileEntry> file = std::make_shared<FileEntry>();
+        entry = file;
+        // packed entries start paging in right away, stored ones are then used straight from
+        // the mapping and only compressed ones are worth reading ahead of time
+        assetPack.willNeed(path);
+        const unsigned char *packed;
+        size_t packedSize;
+        if (assetPack.view(path, packed, packedSize))
+            entry->task = graph->add("map " + path, [] {});
+        else
+            // ahead of need, the loads the scene is already waiting on go first
+            entry->task = graph->add("read " + path,
+                                     [file, path] { file->loaded = readAsset(path, file->contents, IO_NORMAL); });
+        return entry->task;
+    }
+
+    // decodes with ::decodeImage() once the file is read, desired channels as in stbi_load.
+    // An image stored in the asset pack is decoded straight from the mapping instead.
+    StartupGraph::Task decodeImage(const std::string &path, bool flipVertically, int desiredChannels)
+    {
+        const unsigned char *packed = NULL;
+        size_t packedSize = 0;
+        std::vector<StartupGraph::Task> dependencies;
+        if (assetPack.view(path, packed, packedSize))
+            assetPack.willNeed(path);
+        else
+            dependencies.push_back(readFile(path));
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<ImageEntry> &entry = images[path];
+        if (entry)
+            return entry->task;
+        std::shared_ptr<ImageEntry> image = std::make_shared<ImageEntry>();
+        image->flip = flipVertically;
+        image->desired = desiredChannels;
+        entry = image;
+        std::shared_ptr<FileEntry> file = packed ? NULL : files[path];
+        entry->task = graph->add(
+            "decode " + path,
+            [image, file, packed, packedSize] {
+                // straight from the read buffer or the mapping, no second copy of the encoded bytes
+                const unsigned char *encoded = file ? (const unsigned char *)file->contents.data() : packed;
+                size_t encodedSize = file ? file->contents.size() : packedSize;
+                image->pixels = ::decodeImage(encoded, encodedSize, &image->width, &image->height, &image->channels,
+                                              image->desired);
+                if (image->desired)
+                    image->channels = image->desired;
+                // the same flip and widening as the loader's own decode
+                image->pixels =
+                    convertDecoded(image->pixels, image->width, image->height, image->channels, image->flip);
+            },
+            dependencies);
+        return entry->task;
+    }
+
+    // the contents of a prefetched file, shared with the prefetch instead of copied,
+    // null when it wasn't prefetched or couldn't be read
+    std::shared_ptr<const std::string> file(const std::string &path)
+    {
+        std::shared_ptr<FileEntry> entry;
+        StartupGraph *owner;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = files.find(path);
+            if (!graph || found == files.end())
+                return NULL;
+            entry = found->second;
+            owner = graph;
+        }
+        owner->wait(entry->task);
+        if (!entry->loaded)
+            return NULL;
+        // aliases the entry, so the text stays alive after stop()
+        return std::shared_ptr<const std::string>(entry, &entry->contents);
+    }
+
+    // hands out a prefetched decode once, the caller frees pixels with stbi_image_free.
+    // A different flip or channel count than prefetched is a miss.
+    bool image(const std::string &path, bool flipVertically, int desiredChannels, int &width, int &height,
+               int &channels, unsigned char *&pixels)
+    {
+        std::shared_ptr<ImageEntry> entry;
+        StartupGraph *owner;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = images.find(path);
+            if (!graph || found == images.end() || found->second->flip != flipVertically ||
+                found->second->desired != desiredChannels)
+                return false;
+            entry = found->second;
+            images.erase(found);
+            owner = graph;
+        }
+        owner->wait(entry->task);
+        if (!entry->pixels)
+            return false;
+        width = entry->width;
+        height = entry->height;
+        channels = entry->channels;
+        pixels = entry->pixels;
+        entry->pixels = NULL;
+        return true;
+    }
+
+  private:
+    struct FileEntry
+    {
+        StartupGraph::Task task = 0;
+        bool loaded = false;
+        std::string contents;
+    };
+    struct ImageEntry
+    {
+        StartupGraph::Task task = 0;
+        bool flip = true;
+        int desired = 0;
+        int width = 0, height = 0, channels = 0;
+        unsigned char *pixels = NULL;
+
+        ~ImageEntry()
+        {
+            if (pixels)
+                stbi_image_free(pixels);
+        }
+    };
+
+    std::mutex mutex;
+    StartupGraph *graph = NULL;
+    std::map<std::string, std::shared_ptr<FileEntry>> files;
+    std::map<std::string, std::shared_ptr<ImageEntry>> images;
+};
+
+// what main() prefetches for this process
+inline AssetPrefetch assetPrefetch;
+
+#endif
@@ -0,0 +1,427 @@
+#ifndef ASSET_TASKS_H
+#define ASSET_TASKS_H
+
+#include "glad/glad.h"
+
+#include "asset_pack.cpp"
+#include "async_io.cpp"
+#include "image_convert.cpp"
+#include "image_decoder.cpp"
+#include "job_system.cpp"
+#include "stb_image.h"
+#include "texture.cpp"
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Asset loads written as C++20 coroutines: a load co_awaits the steps it is made of and the
+// AssetScheduler moves it to the thread each one needs, the I/O thread for reads (see
+// async_io.cpp), a job system worker for decodes and the GL thread, in poll(), for uploads.
+// AssetTask starts running as soon as it is made, so every load created before the first one
+// is awaited is in flight at once, and a load awaiting another continues right where that one
+// finished. Dropping an AssetTask that is still running lets it finish on its own; the
+// scheduler's destructor runs poll() until nothing waits on it, so it goes before what the
+// loads write to and after the tasks.
+
+struct AssetPromiseBase
+{
+    // RUNNING, DONE, DETACHED once the AssetTask let go of it while it ran, or the address of
+    // the coroutine awaiting it
+    static const uintptr_t RUNNING = 0, DONE = 1, DETACHED = 2;
+    std::atomic<uintptr_t> state{RUNNING};
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+        template <typename Promise> std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> self) noexcept
+        {
+            uintptr_t previous = self.promise().state.exchange(DONE, std::memory_order_acq_rel);
+            if (previous == DETACHED)
+                self.destroy();
+            else if (previous != RUNNING)
+                return std::coroutine_handle<>::from_address((void *)previous);
+            return std::noop_coroutine();
+        }
+        void await_resume() noexcept
+        {
+        }
+    };
+
+    std::suspend_never initial_suspend() noexcept
+    {
+        return {};
+    }
+    FinalAwaiter final_suspend() noexcept
+    {
+        return {};
+    }
+    void unhandled_exception()
+    {
+        std::terminate();
+    }
+};
+
+template <typename T> struct AssetResult
+{
+    std::optional<T> value;
+
+    void return_value(T result)
+    {
+        value.emplace(std::move(result));
+    }
+    T take()
+    {
+        return std::move(*value);
+    }
+};
+
+template <> struct AssetResult<void>
+{
+    void return_void()
+    {
+    }
+    void take()
+    {
+    }
+};
+
+template <typename T = void> class AssetTask
+{
+  public:
+    struct promise_type : AssetPromiseBase, AssetResult<T>
+    {
+        AssetTask get_return_object()
+        {
+            return AssetTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    AssetTask() = default;
+
+    ~AssetTask()
+    {
+        release();
+    }
+
+    AssetTask(AssetTask &&other) noexcept : handle(std::exchange(other.handle, {}))
+    {
+    }
+    AssetTask &operator=(AssetTask &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+
+    AssetTask(const AssetTask &) = delete;
+    AssetTask &operator=(const AssetTask &) = delete;
+
+    explicit operator bool() const
+    {
+        return (bool)handle;
+    }
+
+    bool done() const
+    {
+        return handle && handle.promise().state.load(std::memory_order_acquire) == AssetPromiseBase::DONE;
+    }
+
+    // the result, once done(); only once
+    T take()
+    {
+        return handle.promise().take();
+    }
+
+    // co_await, once, from one coroutine
+    struct Awaiter
+    {
+        AssetTask &task;
+        bool await_ready() const
+        {
+            return task.done();
+        }
+        bool await_suspend(std::coroutine_handle<> waiting)
+        {
+            uintptr_t expected = AssetPromiseBase::RUNNING;
+            return task.handle.promise().state.compare_exchange_strong(expected, (uintptr_t)waiting.address(),
+                                                                       std::memory_order_acq_rel);
+        }
+        T await_resume()
+        {
+            return task.take();
+        }
+    };
+    Awaiter operator co_await() &
+    {
+        return Awaiter{*this};
+    }
+    // a temporary lives in the awaiting frame until the full expression is done
+    Awaiter operator co_await() &&
+    {
+        return Awaiter{*this};
+    }
+
+  private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit AssetTask(std::coroutine_handle<promise_type> handle) : handle(handle)
+    {
+    }
+
+    void release()
+    {
+        if (!handle)
+            return;
+        if (handle.promise().state.exchange(AssetPromiseBase::DETACHED, std::memory_order_acq_rel) ==
+            AssetPromiseBase::DONE)
+            handle.destroy();
+        handle = {};
+    }
+};
+
+class AssetScheduler
+{
+  public:
+    explicit AssetScheduler(JobSystem &jobs) : jobs(jobs)
+    {
+    }
+
+    // the GL thread: every load still waiting on this scheduler finished
+    ~AssetScheduler()
+    {
+        while (suspended.load() > 0)
+        {
+            poll();
+            std::this_thread::yield();
+        }
+        jobs.wait(counter);
+    }
+
+    AssetScheduler(const AssetScheduler &) = delete;
+    AssetScheduler &operator=(const AssetScheduler &) = delete;
+
+    // loads suspended on a read, a worker or the GL thread right now
+    int pending() const
+    {
+        return suspended.load();
+    }
+
+    // co_await: continues on a job system worker
+    auto worker()
+    {
+        struct Awaiter
+        {
+            AssetScheduler &scheduler;
+            bool await_ready()
+            {
+                return false;
+            }
+            void await_suspend(std::coroutine_handle<> waiting)
+            {
+                scheduler.suspended++;
+                scheduler.resumeOnWorker(waiting);
+            }
+            void await_resume()
+            {
+            }
+        };
+        return Awaiter{*this};
+    }
+
+    // co_await: continues in the next poll(), on the thread with the GL context
+    auto glThread()
+    {
+        struct Awaiter
+        {
+            AssetScheduler &scheduler;
+            bool await_ready()
+            {
+                return false;
+            }
+            void await_suspend(std::coroutine_handle<> waiting)
+            {
+                scheduler.suspended++;
+                std::lock_guard<std::mutex> lock(scheduler.mutex);
+                scheduler.glQueue.push_back(waiting);
+            }
+            void await_resume()
+            {
+            }
+        };
+        return Awaiter{*this};
+    }
+
+    // co_await: the file's bytes, empty when it can't be read; packed files are copied out of
+    // the pack's mapping right away, loose ones read on the I/O thread and continued on a worker
+    auto read(std::string path, IOPriority priority = IO_NORMAL)
+    {
+        struct Awaiter
+        {
+            AssetScheduler &scheduler;
+            std::string path;
+            IOPriority priority;
+            std::vector<unsigned char> bytes;
+            bool await_ready()
+            {
+                const unsigned char *packed;
+                size_t size;
+                if (!assetPack.view(path, packed, size))
+                    return false;
+                bytes.assign(packed, packed + size);
+                return true;
+            }
+            void await_suspend(std::coroutine_handle<> waiting)
+            {
+                scheduler.suspended++;
+                asyncIO.submit(path, priority, [this, waiting](bool ok, std::vector<unsigned char> &result) {
+                    if (ok)
+                        bytes.swap(result);
+                    scheduler.resumeOnWorker(waiting);
+                });
+            }
+            std::vector<unsigned char> await_resume()
+            {
+                if (bytes.empty())
+                    std::cout << "ERROR::ASSET_TASKS::FAILED_TO_READ: " << path << '\n';
+                return std::move(bytes);
+            }
+        };
+        return Awaiter{*this, std::move(path), priority, {}};
+    }
+
+    // the GL thread, once per frame: continues the loads that asked for it
+    void poll()
+    {
+        std::vector<std::coroutine_handle<>> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.swap(glQueue);
+        }
+        for (std::coroutine_handle<> waiting : ready)
+        {
+            waiting.resume();
+            suspended--;
+        }
+    }
+
+  private:
+    JobSystem &jobs;
+    JobCounter counter;
+    std::mutex mutex;
+    std::vector<std::coroutine_handle<>> glQueue;
+    // counted down once the coroutine suspended again or finished, so it never reads 0 in between
+    std::atomic<int> suspended{0};
+
+    void resumeOnWorker(std::coroutine_handle<> waiting)
+    {
+        jobs.submit(
+            [this, waiting] {
+                waiting.resume();
+                suspended--;
+            },
+            counter);
+    }
+};
+
+struct ImageFree
+{
+    void operator()(unsigned char *pixels) const
+    {
+        stbi_image_free(pixels);
+    }
+};
+
+struct LoadedImage
+{
+    int width = 0, height = 0, channels = 0;
+    // NULL when the file couldn't be read or decoded
+    std::unique_ptr<unsigned char, ImageFree> pixels;
+};
+
+// read, then decoded and converted on a worker like the TextureLoader's (see image_convert.cpp),
+// desired = 4 for RGBA whatever the file has
+inline AssetTask<LoadedImage> loadImage(AssetScheduler &assets, std::string path, bool flip = true, int desired = 0)
+{
+    std::vector<unsigned char> bytes = co_await assets.read(path);
+    co_await assets.worker();
+    LoadedImage image;
+    if (bytes.empty())
+        co_return image;
+    unsigned char *pixels =
+        decodeImage(bytes.data(), bytes.size(), &image.width, &image.height, &image.channels, desired);
+    if (desired)
+        image.channels = desired;
+    image.pixels.reset(convertDecoded(pixels, image.width, image.height, image.channels, flip));
+    if (!image.pixels)
+        std::cout << "ERROR::ASSET_TASKS::FAILED_TO_DECODE: " << path << '\n';
+    co_return image;
+}
+
+// loadImage(), then uploaded with its mip chain on the GL thread; no storage when it failed
+inline AssetTask<Texture2D> loadTexture(AssetScheduler &assets, std::string path, bool flip = true)
+{
+    LoadedImage image = co_await loadImage(assets, path, flip);
+    co_await assets.glThread();
+    Texture2D texture;
+    if (!image.pixels)
+        co_return texture;
+    static const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+    static const GLenum internalFormats[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+    texture.create(image.width, image.height, internalFormats[image.channels - 1]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    texture.upload(0, formats[image.channels - 1], GL_UNSIGNED_BYTE, image.pixels.get());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    texture.generateMipmaps();
+    co_return texture;
+}
+
+// the files into the first layers of array, all read and decoded at once and uploaded in order
+// as they arrive, the mip chain of every layer rebuilt at the end; array has to outlive it
+inline AssetTask<> loadLayers(AssetScheduler &assets, Texture2DArray &array, std::vector<std::string> paths,
+                              bool flip = true)
+{
+    std::vector<AssetTask<LoadedImage>> images;
+    for (const std::string &path : paths)
+        images.push_back(loadImage(assets, path, flip, 4));
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        LoadedImage image = co_await images[i];
+        // halved down to the array's size, which a texture quality tier makes smaller
+        int levels = 0;
+        while (image.width >> levels > array.width || image.height >> levels > array.height)
+            levels++;
+        if (levels > 0)
+            image.pixels.reset(shrinkImage(image.pixels.release(), image.width, image.height, image.channels, levels));
+        co_await assets.glThread();
+        if (!image.pixels)
+            continue;
+        if (image.width != array.width || image.height != array.height || (int)i >= array.layers)
+        {
+            std::cout << "ERROR::ASSET_TASKS::LAYER_MISMATCH: " << paths[i] << '\n';
+            continue;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        array.upload((int)i, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.get());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+    co_await assets.glThread();
+    array.generateMipmaps();
+}
+
+#endif
@@ -0,0 +1,658 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+// glad defines APIENTRY the same way windows.h does
+#undef APIENTRY
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ASYNC_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+#endif
+#ifndef ASYNC_IO_URING
+#define ASYNC_IO_URING 0
+#endif
+
+// the order requests are taken in, a lower one first
+enum IOPriority
+{
+    // someone is blocked on it
+    IO_HIGH,
+    IO_NORMAL,
+    // streaming ahead of need, only what the others leave
+    IO_BACKGROUND,
+    IO_PRIORITIES
+};
+
+// Reads whole files, or a range of one, on a thread of its own that keeps up to MAX_IN_FLIGHT
+// reads with the OS at once. Requests wait in a queue per priority and are taken highest
+// first whenever a read finishes; the ones taken together go to the kernel in one submission.
+// The reads are io_uring ones on Linux when the kernel allows it, overlapped ones completing
+// on an I/O completion port on Windows, and preads one at a time elsewhere. submit() calls
+// back with the bytes on the I/O thread, so the callback should only hand them on; read()
+// waits for its request, filling the caller's buffer directly. cancel() takes back a request
+// that hasn't finished, its callback is then never called. The thread starts with the first
+// request, readFileContents() and the loaders send every file they read from disk here.
+class AsyncIO
+{
+  public:
+    static const unsigned int MAX_IN_FLIGHT = 32;
+
+    typedef std::function<void(bool ok, std::vector<unsigned char> &bytes)> Callback;
+
+    // since the start: requests taken, finished, cancelled before finishing, submissions to the
+    // kernel and the bytes read
+    std::atomic<uint64_t> started{0};
+    std::atomic<uint64_t> finished{0};
+    std::atomic<uint64_t> cancelled{0};
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> bytesRead{0};
+
+    AsyncIO()
+    {
+    }
+
+    ~AsyncIO()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (thread.joinable())
+            thread.join();
+        for (std::deque<Request *> &queue : queues)
+            for (Request *request : queue)
+                delete request;
+    }
+
+    AsyncIO(const AsyncIO &) = delete;
+    AsyncIO &operator=(const AsyncIO &) = delete;
+
+    // what the reads go through, known once the thread has started
+    const char *backend() const
+    {
+        return backendName.load();
+    }
+
+    // the file from offset on, size bytes of it or to the end with SIZE_MAX; returns the id
+    // cancel() takes, never 0
+    uint64_t submit(const std::string &path, IOPriority priority, Callback callback, uint64_t offset = 0,
+                    size_t size = SIZE_MAX)
+    {
+        Request *request = new Request;
+        request->path = path;
+        request->offset = offset;
+        request->size = size;
+        request->callback = std::move(callback);
+        std::lock_guard<std::mutex> lock(mutex);
+        return enqueue(request, priority);
+    }
+
+    // true when the request's callback won't be called, false when it has been or is being
+    bool cancel(uint64_t id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = requests.find(id);
+        if (found == requests.end())
+            return false;
+        Request *request = found->second;
+        requests.erase(found);
+        cancelled++;
+        std::deque<Request *> &queue = queues[request->priority];
+        auto queued = std::find(queue.begin(), queue.end(), request);
+        if (queued != queue.end())
+        {
+            queue.erase(queued);
+            delete request;
+        }
+        else
+            request->cancelled = true;
+        return true;
+    }
+
+    // the whole file into out, Buffer a std::vector<unsigned char> or std::string; waits
+    template <typename Buffer> bool read(const std::string &path, Buffer &out, IOPriority priority = IO_HIGH)
+    {
+        return readInto(path, 0, SIZE_MAX, priority, [&](size_t size) {
+            out.resize(size);
+            return (unsigned char *)&out[0];
+        });
+    }
+
+    // exactly size bytes from offset into out, false when the file is shorter; waits
+    bool read(const std::string &path, uint64_t offset, size_t size, void *out, IOPriority priority = IO_HIGH)
+    {
+        size_t got = 0;
+        bool ok = readInto(path, offset, size, priority, [&](size_t available) {
+            got = available;
+            return (unsigned char *)out;
+        });
+        return ok && got == size;
+    }
+
+  private:
+#ifdef _WIN32
+    typedef HANDLE FileHandle;
+    static inline const HANDLE NO_FILE = INVALID_HANDLE_VALUE;
+#else
+    typedef int FileHandle;
+    static inline const int NO_FILE = -1;
+#endif
+
+    struct Request
+    {
+        std::string path;
+        uint64_t offset;
+        size_t size;
+        IOPriority priority = IO_NORMAL;
+        uint64_t id = 0;
+        Callback callback;
+        // read() waits on these and reads into the buffer allocate gives
+        std::function<unsigned char *(size_t)> allocate;
+        bool waited = false, done = false, ok = false;
+        bool cancelled = false;
+        std::vector<unsigned char> bytes;
+        // while it is in flight
+        FileHandle file = NO_FILE;
+        unsigned char *data = NULL;
+        size_t length = 0, transferred = 0;
+#ifdef _WIN32
+        OVERLAPPED overlapped;
+#else
+        struct iovec vector;
+#endif
+    };
+
+    std::mutex mutex;
+    std::condition_variable wake, completed;
+    std::deque<Request *> queues[IO_PRIORITIES];
+    // the queued and in flight ones by id
+    std::unordered_map<uint64_t, Request *> requests;
+    uint64_t nextId = 1;
+    bool stopping = false;
+    std::thread thread;
+    std::atomic<std::thread::id> threadId{};
+    std::atomic<const char *> backendName{"none"};
+
+    // the I/O thread's
+    unsigned int inFlight = 0;
+    std::vector<Request *> ready;
+#if ASYNC_IO_URING
+    int ring = -1;
+    unsigned char *submissionRing = NULL, *completionRing = NULL;
+    size_t submissionRingSize = 0, completionRingSize = 0;
+    io_uring_sqe *entries = NULL;
+    size_t entriesSize = 0;
+    unsigned *submissionTail = NULL, *submissionMask = NULL, *submissionArray = NULL;
+    unsigned *completionHead = NULL, *completionTail = NULL, *completionMask = NULL;
+    io_uring_cqe *completions = NULL;
+    unsigned unsubmitted = 0;
+#endif
+#ifdef _WIN32
+    HANDLE port = NULL;
+#endif
+
+    uint64_t enqueue(Request *request, IOPriority priority)
+    {
+        if (!thread.joinable())
+            thread = std::thread(&AsyncIO::loop, this);
+        request->priority = priority;
+        request->id = nextId++;
+        requests[request->id] = request;
+        queues[priority].push_back(request);
+        wake.notify_one();
+        return request->id;
+    }
+
+    template <typename Allocate>
+    bool readInto(const std::string &path, uint64_t offset, size_t size, IOPriority priority, Allocate allocate)
+    {
+        // a callback reading a file would wait on itself
+        if (std::this_thread::get_id() == threadId.load())
+            return readBlocking(path, offset, size, allocate);
+        Request request;
+        request.path = path;
+        request.offset = offset;
+        request.size = size;
+        request.allocate = allocate;
+        request.waited = true;
+        std::unique_lock<std::mutex> lock(mutex);
+        enqueue(&request, priority);
+        completed.wait(lock, [&] { return request.done; });
+        return request.ok;
+    }
+
+    template <typename Allocate>
+    static bool readBlocking(const std::string &path, uint64_t offset, size_t size, Allocate allocate)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+        uint64_t end = (uint64_t)file.tellg();
+        if (offset > end)
+            return false;
+        size_t length = (size_t)std::min<uint64_t>(size, end - offset);
+        unsigned char *data = allocate(length);
+        file.seekg((std::streamoff)offset);
+        if (length > 0)
+            file.read((char *)data, (std::streamsize)length);
+        return (bool)file;
+    }
+
+    void loop()
+    {
+        threadId = std::this_thread::get_id();
+        startBackend();
+        std::vector<Request *> taken;
+        for (;;)
+        {
+            taken.clear();
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                // with reads in flight the thread waits on them instead, new requests join after one
+                if (inFlight == 0 && ready.empty())
+                    wake.wait(lock, [this] {
+                        return stopping || std::any_of(std::begin(queues), std::end(queues),
+                                                       [](const std::deque<Request *> &q) { return !q.empty(); });
+                    });
+                if (stopping)
+                    break;
+                for (std::deque<Request *> &queue : queues)
+                    while (!queue.empty() && inFlight + taken.size() < MAX_IN_FLIGHT)
+                    {
+                        taken.push_back(queue.front());
+                        queue.pop_front();
+                    }
+            }
+            for (Request *request : taken)
+            {
+                started++;
+                open(request);
+            }
+            for (Request *request : ready)
+                if (!queueRead(request))
+                    finish(request, false);
+            ready.clear();
+            if (flush())
+                batches++;
+            if (inFlight > 0)
+                reap(taken.empty());
+        }
+        // what is in flight has to land before its buffers go
+        while (inFlight > 0)
+            reap(true);
+        stopBackend();
+    }
+
+    // the file opened and the buffer sized, on ready to read or finished
+    void open(Request *request)
+    {
+        uint64_t end = 0;
+#ifdef _WIN32
+        request->file = CreateFileA(request->path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        LARGE_INTEGER fileSize;
+        if (request->file != NO_FILE && GetFileSizeEx(request->file, &fileSize) &&
+            CreateIoCompletionPort(request->file, port, 0, 0))
+            end = (uint64_t)fileSize.QuadPart;
+        else
+            return finish(request, false);
+#else
+        request->file = ::open(request->path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (request->file == NO_FILE || fstat(request->file, &info) != 0 || !S_ISREG(info.st_mode))
+            return finish(request, false);
+        end = (uint64_t)info.st_size;
+#endif
+        if (request->offset > end)
+            return finish(request, false);
+        request->length = (size_t)std::min<uint64_t>(request->size, end - request->offset);
+        if (request->allocate)
+            request->data = request->allocate(request->length);
+        else
+        {
+            request->bytes.resize(request->length);
+            request->data = request->bytes.data();
+        }
+        request->transferred = 0;
+        if (request->length == 0)
+            return finish(request, true);
+        ready.push_back(request);
+    }
+
+    // the request's file closed and its reader told, unless it was cancelled
+    void finish(Request *request, bool ok)
+    {
+        if (request->file != NO_FILE)
+        {
+#ifdef _WIN32
+            CloseHandle(request->file);
+#else
+            ::close(request->file);
+#endif
+            request->file = NO_FILE;
+        }
+        if (ok)
+            bytesRead += request->length;
+        std::unique_lock<std::mutex> lock(mutex);
+        if (request->waited)
+        {
+            requests.erase(request->id);
+            request->ok = ok;
+            request->done = true;
+            completed.notify_all();
+            return;
+        }
+        bool call = !request->cancelled;
+        if (call)
+            requests.erase(request->id);
+        lock.unlock();
+        finished++;
+        if (call)
+            request->callback(ok, request->bytes);
+        delete request;
+    }
+
+    // a read landed, result bytes or negative on an error
+    void landed(Request *request, int64_t result)
+    {
+        inFlight--;
+        if (result <= 0)
+            return finish(request, false);
+        request->transferred += (size_t)result;
+        if (request->transferred >= request->length)
+            return finish(request, true);
+        // a short read, the rest goes with the next submission
+        ready.push_back(request);
+    }
+
+#if ASYNC_IO_URING
+    void startBackend()
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring = (int)syscall(__NR_io_uring_setup, MAX_IN_FLIGHT, &params);
+        if (ring < 0)
+        {
+            backendName = "pread";
+            return;
+        }
+        submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+            submissionRingSize = completionRingSize = std::max(submissionRingSize, completionRingSize);
+        entriesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void *sq = mmap(NULL, submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring,
+                        IORING_OFF_SQ_RING);
+        void *cq = single ? sq
+                          : mmap(NULL, completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring,
+                                 IORING_OFF_CQ_RING);
+        void *sqes =
+            mmap(NULL, entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+        if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED)
+        {
+            submissionRing = sq == MAP_FAILED ? NULL : (unsigned char *)sq;
+            completionRing = cq == MAP_FAILED ? NULL : (unsigned char *)cq;
+            entries = sqes == MAP_FAILED ? NULL : (io_uring_sqe *)sqes;
+            stopBackend();
+            backendName = "pread";
+            return;
+        }
+        submissionRing = (unsigned char *)sq;
+        completionRing = (unsigned char *)cq;
+        entries = (io_uring_sqe *)sqes;
+        submissionTail = (unsigned *)(submissionRing + params.sq_off.tail);
+        submissionMask = (unsigned *)(submissionRing + params.sq_off.ring_mask);
+        submissionArray = (unsigned *)(submissionRing + params.sq_off.array);
+        completionHead = (unsigned *)(completionRing + params.cq_off.head);
+        completionTail = (unsigned *)(completionRing + params.cq_off.tail);
+        completionMask = (unsigned *)(completionRing + params.cq_off.ring_mask);
+        completions = (io_uring_cqe *)(completionRing + params.cq_off.cqes);
+        backendName = "io_uring";
+    }
+
+    void stopBackend()
+    {
+        if (entries)
+            munmap(entries, entriesSize);
+        if (completionRing && completionRing != submissionRing)
+            munmap(completionRing, completionRingSize);
+        if (submissionRing)
+            munmap(submissionRing, submissionRingSize);
+        if (ring >= 0)
+            ::close(ring);
+        ring = -1;
+        entries = NULL;
+        submissionRing = completionRing = NULL;
+    }
+
+    // an entry for the rest of the request, sent with the next flush()
+    bool queueRead(Request *request)
+    {
+        if (ring < 0)
+            return readNow(request);
+        // only this thread moves the tail, the kernel reads it
+        unsigned tail = *submissionTail;
+        unsigned index = tail & *submissionMask;
+        io_uring_sqe &entry = entries[index];
+        std::memset(&entry, 0, sizeof(entry));
+        request->vector.iov_base = request->data + request->transferred;
+        request->vector.iov_len = request->length - request->transferred;
+        entry.opcode = IORING_OP_READV;
+        entry.fd = request->file;
+        entry.addr = (uint64_t)(uintptr_t)&request->vector;
+        entry.len = 1;
+        entry.off = request->offset + request->transferred;
+        entry.user_data = (uint64_t)(uintptr_t)request;
+        submissionArray[index] = index;
+        __atomic_store_n(submissionTail, tail + 1, __ATOMIC_RELEASE);
+        unsubmitted++;
+        inFlight++;
+        return true;
+    }
+
+    // one system call for everything queued since the last one, true when there was any.
+    // What the kernel won't take is read with pread instead, or reap() would wait on it forever.
+    bool flush()
+    {
+        if (unsubmitted == 0)
+            return false;
+        int retries = 0;
+        while (unsubmitted > 0)
+        {
+            long sent = syscall(__NR_io_uring_enter, ring, unsubmitted, 0, 0, NULL, 0);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            // out of resources or a full completion ring, landed reads free them
+            if (sent < 0 && (errno == EAGAIN || errno == EBUSY) && retries++ < 8)
+            {
+                reap(false);
+                std::this_thread::yield();
+                continue;
+            }
+            if (sent <= 0)
+                break;
+            unsubmitted -= (unsigned)sent;
+        }
+        if (unsubmitted > 0)
+            takeBack();
+        return true;
+    }
+
+    // the entries the kernel hasn't consumed come off the ring, only this thread submits
+    void takeBack()
+    {
+        unsigned tail = *submissionTail;
+        for (unsigned at = tail - unsubmitted; at != tail; at++)
+        {
+            Request *request = (Request *)(uintptr_t)entries[submissionArray[at & *submissionMask]].user_data;
+            inFlight--;
+            readNow(request);
+        }
+        __atomic_store_n(submissionTail, tail - unsubmitted, __ATOMIC_RELEASE);
+        unsubmitted = 0;
+    }
+
+    // the landed reads, waiting for one when asked and none has
+    void reap(bool wait)
+    {
+        if (ring < 0)
+            return reapNow();
+        // reads takeBack() did with pread have landed already
+        if (!immediate.empty())
+        {
+            reapNow();
+            wait = false;
+        }
+        unsigned head = *completionHead;
+        if (wait && head == __atomic_load_n(completionTail, __ATOMIC_ACQUIRE))
+            while (syscall(__NR_io_uring_enter, ring, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno == EINTR)
+                ;
+        unsigned tail = __atomic_load_n(completionTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            const io_uring_cqe &completion = completions[head & *completionMask];
+            Request *request = (Request *)(uintptr_t)completion.user_data;
+            int64_t result = completion.res;
+            __atomic_store_n(completionHead, head + 1, __ATOMIC_RELEASE);
+            landed(request, result);
+        }
+    }
+#elif defined(_WIN32)
+    void startBackend()
+    {
+        port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+        backendName = "overlapped";
+    }
+
+    void stopBackend()
+    {
+        if (port)
+            CloseHandle(port);
+        port = NULL;
+    }
+
+    // ReadFile() starts it right away, its completion is posted to the port either way
+    bool queueRead(Request *request)
+    {
+        uint64_t at = request->offset + request->transferred;
+        std::memset(&request->overlapped, 0, sizeof(request->overlapped));
+        request->overlapped.Offset = (DWORD)at;
+        request->overlapped.OffsetHigh = (DWORD)(at >> 32);
+        DWORD chunk = (DWORD)std::min<size_t>(request->length - request->transferred, (size_t)1 << 30);
+        if (!ReadFile(request->file, request->data + request->transferred, chunk, NULL, &request->overlapped) &&
+            GetLastError() != ERROR_IO_PENDING)
+            return false;
+        inFlight++;
+        return true;
+    }
+
+    bool flush()
+    {
+        return false;
+    }
+
+    void reap(bool wait)
+    {
+        OVERLAPPED_ENTRY landedEntries[MAX_IN_FLIGHT];
+        ULONG count = 0;
+        if (!GetQueuedCompletionStatusEx(port, landedEntries, MAX_IN_FLIGHT, &count, wait ? INFINITE : 0, FALSE))
+            return;
+        for (ULONG i = 0; i < count; i++)
+        {
+            Request *request = CONTAINING_RECORD(landedEntries[i].lpOverlapped, Request, overlapped);
+            // Internal holds the NTSTATUS, nonzero for a failed read
+            bool failed = landedEntries[i].lpOverlapped->Internal != 0;
+            landed(request, failed ? -1 : (int64_t)landedEntries[i].dwNumberOfBytesTransferred);
+        }
+    }
+#else
+    void startBackend()
+    {
+        backendName = "pread";
+    }
+
+    void stopBackend()
+    {
+    }
+
+    bool queueRead(Request *request)
+    {
+        return readNow(request);
+    }
+
+    bool flush()
+    {
+        return false;
+    }
+
+    void reap(bool)
+    {
+        reapNow();
+    }
+#endif
+
+#ifndef _WIN32
+    // without a ring the read happens here and lands on the next reap()
+    std::vector<std::pair<Request *, int64_t>> immediate;
+
+    bool readNow(Request *request)
+    {
+        ssize_t got;
+        do
+            got = pread(request->file, request->data + request->transferred, request->length - request->transferred,
+                        (off_t)(request->offset + request->transferred));
+        while (got < 0 && errno == EINTR);
+        inFlight++;
+        immediate.push_back({request, (int64_t)got});
+        return true;
+    }
+
+    void reapNow()
+    {
+        std::vector<std::pair<Request *, int64_t>> landing;
+        landing.swap(immediate);
+        for (auto &read : landing)
+            landed(read.first, read.second);
+    }
+#endif
+};
+
+// every file read from disk goes through this one
+inline AsyncIO asyncIO;
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef AUTO_EXPOSURE_H
+#define AUTO_EXPOSURE_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "post_process.cpp"
+#include "shader.cpp"
+#include "shader_compiler.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Exposure that follows the frame's brightness, worked out on the GPU and never read back,
+// as passes of the PostProcessGraph: "exposure downsample" averages the lit frame down to a
+// quarter of its size, "exposure histogram" sorts every texel of that into one of BINS bins of
+// log2 luminance between minLog and maxLog (shader_src/luminance_histogram.comp: each group
+// counts its tile with shared memory atomics first and adds only its non-empty bins to the
+// storage buffer), then one group averages the bins (the black bin 0 left out), moves the
+// adapted luminance towards that average by the frame's time and writes key / luminance into
+// a 1x1 texture, clearing the bins for the next frame. The tone map multiplies its exposure
+// by that texel (post_composite.fs with AUTO_EXPOSURE), so the frame is exposed by what the GPU
+// measured one pass before without the CPU waiting on it.
+class AutoExposure
+{
+  public:
+    static const int BINS = 256;
+    // storage binding of the histogram
+    static const unsigned int BINDING = 24;
+    static const int GROUP_SIZE = 16;
+
+    // log2 luminance the bins span, below all goes to the first lit bin and above to the last
+    float minLog = -8.0f;
+    float maxLog = 4.0f;
+    // the luminance the average is brought to
+    float key = 0.18f;
+    // how fast the adapted luminance follows, per second
+    float speed = 1.5f;
+
+    explicit AutoExposure(ShaderCompiler &compiler)
+        : histogramShader(compiler.submitCompute("src/shader_src/luminance_histogram.comp")),
+          adaptShader(compiler.submitCompute("src/shader_src/luminance_histogram.comp", {"ADAPT"}))
+    {
+        std::vector<uint32_t> zeros(BINS, 0);
+        histogram = createBuffer(BINS * sizeof(uint32_t), zeros.data(), 0);
+        // r the exposure, g the adapted luminance, 0 until the first frame is measured
+        exposure.create(1, 1, GL_RG32F, 1, GPU_MEMORY_RENDER_TARGETS);
+        const float start[2] = {1.0f, 0.0f};
+        exposure.upload(0, GL_RG, GL_FLOAT, start);
+    }
+
+    ~AutoExposure()
+    {
+        deleteBuffers(1, &histogram);
+    }
+
+    AutoExposure(const AutoExposure &) = delete;
+    AutoExposure &operator=(const AutoExposure &) = delete;
+
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    // the passes measuring source into graph, downsample is post_downsample.fs; returns the
+    // handle of the exposure texture for the tone map's inputs
+    int addPasses(PostProcessGraph &graph, int source, Shader &downsample)
+    {
+        this->graph = &graph;
+        exposureInput = graph.addExternal("exposure");
+        int quarter = graph.addPass("exposure downsample", downsample, {source}, 0.25f, GL_R11F_G11F_B10F);
+        graph.addCompute("exposure histogram", {quarter}, {exposureInput},
+                         [this](const std::vector<const Texture2D *> &inputs) {
+                             if (inputs[0])
+                                 measure(*inputs[0]);
+                         });
+        return exposureInput;
+    }
+
+    // before the graph's execute(), with the time since the last frame
+    void prepare(float deltaTime)
+    {
+        if (!graph)
+            return;
+        adaptation = 1.0f - std::exp(-std::max(deltaTime, 0.0f) * speed);
+        graph->setExternal(exposureInput, &exposure);
+    }
+
+  private:
+    Shader &histogramShader;
+    Shader &adaptShader;
+    UniformHandle histogramRangeLoc, adaptRangeLoc, adaptParamsLoc;
+    unsigned int histogram = 0;
+    Texture2D exposure;
+    PostProcessGraph *graph = NULL;
+    int exposureInput = 0;
+    float adaptation = 1.0f;
+
+    void measure(const Texture2D &frame)
+    {
+        glm::vec2 range(minLog, 1.0f / std::max(maxLog - minLog, 1e-3f));
+        histogramShader.use();
+        if (!histogramRangeLoc.valid())
+        {
+            histogramRangeLoc = histogramShader.uniform("logRange");
+            histogramShader.setInt("frame", 0);
+        }
+        histogramShader.set(histogramRangeLoc, range);
+        frame.bind(0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, histogram, 0, 0);
+        glDispatchCompute((GLuint)((frame.width + GROUP_SIZE - 1) / GROUP_SIZE),
+                          (GLuint)((frame.height + GROUP_SIZE - 1) / GROUP_SIZE), 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        adaptShader.use();
+        if (!adaptRangeLoc.valid())
+        {
+            adaptRangeLoc = adaptShader.uniform("logRange");
+            adaptParamsLoc = adaptShader.uniform("params");
+        }
+        adaptShader.set(adaptRangeLoc, glm::vec2(minLog, maxLog - minLog));
+        adaptShader.set(adaptParamsLoc, glm::vec4(adaptation, key, (float)frame.width * frame.height, 0.0f));
+        glBindImageTexture(0, exposure.ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
+        glDispatchCompute(1, 1, 1);
+        // the cleared bins, for the next frame's counts
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+};
+
+#endif
@@ -0,0 +1,717 @@
+#ifndef BATCH_MATH_H
+#define BATCH_MATH_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/packing.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include "fast_math.cpp"
+#include "simd_math.cpp"
+
+#if GLM_CONFIG_ALIGNED_GENTYPES == GLM_ENABLE
+#include "glm/gtc/type_aligned.hpp"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Batched vector math for arrays of objects, the kernels TransformSystem and FrustumCuller
+// run on. Data is SoA (one float array per component) for 4 objects per SSE2 register, or 8
+// per AVX register when the build targets it, with a scalar loop for the remainder; the
+// results match the plain GLM expressions they replace. The AoS path works on glm::vec4 and,
+// when GLM_FORCE_INTRINSICS leaves the aligned types on, glm::aligned_vec4 as well.
+
+#if SIMD_SSE2
+// x, y and z of 4 objects
+struct Vec3x4
+{
+    __m128 x, y, z;
+
+    static Vec3x4 load(const float *x, const float *y, const float *z)
+    {
+        return {_mm_loadu_ps(x), _mm_loadu_ps(y), _mm_loadu_ps(z)};
+    }
+
+    static Vec3x4 broadcast(const glm::vec3 &v)
+    {
+        return {_mm_set1_ps(v.x), _mm_set1_ps(v.y), _mm_set1_ps(v.z)};
+    }
+
+    void store(float *outX, float *outY, float *outZ) const
+    {
+        _mm_storeu_ps(outX, x);
+        _mm_storeu_ps(outY, y);
+        _mm_storeu_ps(outZ, z);
+    }
+};
+
+inline Vec3x4 operator+(const Vec3x4 &a, const Vec3x4 &b)
+{
+    return {_mm_add_ps(a.x, b.x), _mm_add_ps(a.y, b.y), _mm_add_ps(a.z, b.z)};
+}
+
+inline Vec3x4 operator-(const Vec3x4 &a, const Vec3x4 &b)
+{
+    return {_mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z)};
+}
+
+inline Vec3x4 operator*(const Vec3x4 &a, __m128 s)
+{
+    return {_mm_mul_ps(a.x, s), _mm_mul_ps(a.y, s), _mm_mul_ps(a.z, s)};
+}
+
+inline __m128 dot(const Vec3x4 &a, const Vec3x4 &b)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+// v / length(v) for 4 vectors, with the square root of Math
+template <typename Math> inline Vec3x4 normalize(const Vec3x4 &v)
+{
+    return v * Math::rsqrt4(dot(v, v));
+}
+
+// m * (point, 1) of 4 points, the w row is left out
+inline Vec3x4 transformPoint(const glm::mat4 &m, const Vec3x4 &p)
+{
+    Vec3x4 result;
+    __m128 *rows[3] = {&result.x, &result.y, &result.z};
+    for (int r = 0; r < 3; r++)
+        *rows[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p.x, _mm_set1_ps(m[0][r])), _mm_mul_ps(p.y, _mm_set1_ps(m[1][r]))),
+                              _mm_add_ps(_mm_mul_ps(p.z, _mm_set1_ps(m[2][r])), _mm_set1_ps(m[3][r])));
+    return result;
+}
+#endif
+
+#if SIMD_AVX
+// x, y and z of 8 objects
+struct Vec3x8
+{
+    __m256 x, y, z;
+
+    static Vec3x8 load(const float *x, const float *y, const float *z)
+    {
+        return {_mm256_loadu_ps(x), _mm256_loadu_ps(y), _mm256_loadu_ps(z)};
+    }
+
+    static Vec3x8 broadcast(const glm::vec3 &v)
+    {
+        return {_mm256_set1_ps(v.x), _mm256_set1_ps(v.y), _mm256_set1_ps(v.z)};
+    }
+
+    void store(float *outX, float *outY, float *outZ) const
+    {
+        _mm256_storeu_ps(outX, x);
+        _mm256_storeu_ps(outY, y);
+        _mm256_storeu_ps(outZ, z);
+    }
+};
+
+inline Vec3x8 operator+(const Vec3x8 &a, const Vec3x8 &b)
+{
+    return {_mm256_add_ps(a.x, b.x), _mm256_add_ps(a.y, b.y), _mm256_add_ps(a.z, b.z)};
+}
+
+inline Vec3x8 operator-(const Vec3x8 &a, const Vec3x8 &b)
+{
+    return {_mm256_sub_ps(a.x, b.x), _mm256_sub_ps(a.y, b.y), _mm256_sub_ps(a.z, b.z)};
+}
+
+inline Vec3x8 operator*(const Vec3x8 &a, __m256 s)
+{
+    return {_mm256_mul_ps(a.x, s), _mm256_mul_ps(a.y, s), _mm256_mul_ps(a.z, s)};
+}
+
+inline __m256 dot(const Vec3x8 &a, const Vec3x8 &b)
+{
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a.x, b.x), _mm256_mul_ps(a.y, b.y)), _mm256_mul_ps(a.z, b.z));
+}
+
+inline Vec3x8 transformPoint(const glm::mat4 &m, const Vec3x8 &p)
+{
+    Vec3x8 result;
+    __m256 *rows[3] = {&result.x, &result.y, &result.z};
+    for (int r = 0; r < 3; r++)
+        *rows[r] = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(p.x, _mm256_set1_ps(m[0][r])), _mm256_mul_ps(p.y, _mm256_set1_ps(m[1][r]))),
+            _mm256_add_ps(_mm256_mul_ps(p.z, _mm256_set1_ps(m[2][r])), _mm256_set1_ps(m[3][r])));
+    return result;
+}
+#endif
+
+// out = m * (in, 1) for count SoA points, e.g. local bounds to world space; out may be in
+inline void batchTransformPoints(const glm::mat4 &m, const float *x, const float *y, const float *z, float *outX,
+                                 float *outY, float *outZ, size_t count)
+{
+    size_t i = 0;
+#if SIMD_AVX
+    for (; i + 8 <= count; i += 8)
+        transformPoint(m, Vec3x8::load(x + i, y + i, z + i)).store(outX + i, outY + i, outZ + i);
+#endif
+#if SIMD_SSE2
+    for (; i + 4 <= count; i += 4)
+        transformPoint(m, Vec3x4::load(x + i, y + i, z + i)).store(outX + i, outY + i, outZ + i);
+#endif
+    for (; i < count; i++)
+    {
+        glm::vec4 p = m * glm::vec4(x[i], y[i], z[i], 1.0f);
+        outX[i] = p.x;
+        outY[i] = p.y;
+        outZ[i] = p.z;
+    }
+}
+
+// out = m * in for count AoS vectors, the matrix columns stay in registers
+inline void batchTransform(const glm::mat4 &m, const glm::vec4 *in, glm::vec4 *out, size_t count)
+{
+#if SIMD_SSE2
+    __m128 c0 = _mm_loadu_ps(&m[0][0]);
+    __m128 c1 = _mm_loadu_ps(&m[1][0]);
+    __m128 c2 = _mm_loadu_ps(&m[2][0]);
+    __m128 c3 = _mm_loadu_ps(&m[3][0]);
+    for (size_t i = 0; i < count; i++)
+    {
+        __m128 v = _mm_loadu_ps(&in[i][0]);
+        __m128 result = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0))),
+                       _mm_mul_ps(c1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)))),
+            _mm_add_ps(_mm_mul_ps(c2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))),
+                       _mm_mul_ps(c3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)))));
+        _mm_storeu_ps(&out[i][0], result);
+    }
+#else
+    for (size_t i = 0; i < count; i++)
+        out[i] = m * in[i];
+#endif
+}
+
+#if GLM_CONFIG_ALIGNED_GENTYPES == GLM_ENABLE
+// the same on GLM's aligned types, whose operators GLM itself runs on SSE
+inline void batchTransform(const glm::aligned_mat4 &m, const glm::aligned_vec4 *in, glm::aligned_vec4 *out,
+                           size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = m * in[i];
+}
+#endif
+
+// A model matrix of translation, rotation and uniform scale in 24 bytes instead of 64: the
+// translation as floats, the rotation as a unit quaternion x y z w and the scale as halves, and
+// the texture array layer of the instance. compact_instances.cpp uploads them and vertex_shader.vs
+// (COMPACT) rebuilds the matrix.
+struct CompactTransform
+{
+    float x, y, z;
+    uint16_t rotation[4];
+    uint16_t scale;
+    uint16_t layer;
+};
+static_assert(sizeof(CompactTransform) == 24, "CompactTransform must match what vertex_shader.vs fetches");
+
+// The translations batchTranslateRotate() reads: float positions as they are, or double ones
+// less an origin, the difference rounded to float, which keeps the digits a float position far
+// from 0 would lose. load4() gives 4 of them from i, at() one.
+struct FloatPositions
+{
+    const float *x, *y, *z;
+
+#if SIMD_SSE2
+    void load4(size_t i, __m128 &outX, __m128 &outY, __m128 &outZ) const
+    {
+        outX = _mm_loadu_ps(&x[i]);
+        outY = _mm_loadu_ps(&y[i]);
+        outZ = _mm_loadu_ps(&z[i]);
+    }
+#endif
+
+    glm::vec3 at(size_t i) const
+    {
+        return glm::vec3(x[i], y[i], z[i]);
+    }
+};
+
+struct RelativePositions
+{
+    const double *x, *y, *z;
+    glm::dvec3 origin;
+
+#if SIMD_SSE2
+    static __m128 relative4(const double *v, __m128d origin)
+    {
+        __m128 low = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(v), origin));
+        __m128 high = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(v + 2), origin));
+        return _mm_movelh_ps(low, high);
+    }
+
+    void load4(size_t i, __m128 &outX, __m128 &outY, __m128 &outZ) const
+    {
+        outX = relative4(&x[i], _mm_set1_pd(origin.x));
+        outY = relative4(&y[i], _mm_set1_pd(origin.y));
+        outZ = relative4(&z[i], _mm_set1_pd(origin.z));
+    }
+#endif
+
+    glm::vec3 at(size_t i) const
+    {
+        return glm::vec3(glm::dvec3(x[i], y[i], z[i]) - origin);
+    }
+};
+
+// out[i] = glm::rotate(glm::translate(I, positions.at(i)), angle[i], axis[i]) for count objects,
+// the axes must be normalized; Math is the sine and cosine policy of fast_math.cpp.
+// With compact the same transforms are written there too, the quaternion of half the angle
+// and a scale of 1, their layers are left as they are
+template <typename Math = TransformMath, typename Positions>
+inline void batchTranslateRotateFrom(const Positions &positions, const float *axisX, const float *axisY,
+                                     const float *axisZ, const float *angles, glm::mat4 *out, size_t count,
+                                     CompactTransform *compact)
+{
+    size_t i = 0;
+    const uint16_t halfOne = glm::packHalf1x16(1.0f);
+#if SIMD_SSE2
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&axisX[i]);
+        __m128 y = _mm_loadu_ps(&axisY[i]);
+        __m128 z = _mm_loadu_ps(&axisZ[i]);
+        __m128 s, c;
+        Math::sinCos4(_mm_loadu_ps(&angles[i]), s, c);
+        __m128 k = _mm_sub_ps(one, c);
+
+        // Rodrigues rotation matrix, m[column][row]
+        __m128 kx = _mm_mul_ps(k, x), ky = _mm_mul_ps(k, y), kz = _mm_mul_ps(k, z);
+        __m128 sx = _mm_mul_ps(s, x), sy = _mm_mul_ps(s, y), sz = _mm_mul_ps(s, z);
+        __m128 kxy = _mm_mul_ps(kx, y), kxz = _mm_mul_ps(kx, z), kyz = _mm_mul_ps(ky, z);
+
+        __m128 m00 = _mm_add_ps(_mm_mul_ps(kx, x), c);
+        __m128 m01 = _mm_add_ps(kxy, sz);
+        __m128 m02 = _mm_sub_ps(kxz, sy);
+        __m128 m10 = _mm_sub_ps(kxy, sz);
+        __m128 m11 = _mm_add_ps(_mm_mul_ps(ky, y), c);
+        __m128 m12 = _mm_add_ps(kyz, sx);
+        __m128 m20 = _mm_add_ps(kxz, sy);
+        __m128 m21 = _mm_sub_ps(kyz, sx);
+        __m128 m22 = _mm_add_ps(_mm_mul_ps(kz, z), c);
+        __m128 m30, m31, m32;
+        positions.load4(i, m30, m31, m32);
+
+        // each transpose turns one matrix column of 4 objects into that column per object
+        __m128 column0[4] = {m00, m01, m02, zero};
+        __m128 column1[4] = {m10, m11, m12, zero};
+        __m128 column2[4] = {m20, m21, m22, zero};
+        __m128 column3[4] = {m30, m31, m32, one};
+        _MM_TRANSPOSE4_PS(column0[0], column0[1], column0[2], column0[3]);
+        _MM_TRANSPOSE4_PS(column1[0], column1[1], column1[2], column1[3]);
+        _MM_TRANSPOSE4_PS(column2[0], column2[1], column2[2], column2[3]);
+        _MM_TRANSPOSE4_PS(column3[0], column3[1], column3[2], column3[3]);
+
+        for (int j = 0; j < 4; j++)
+        {
+            float *matrix = &out[i + j][0][0];
+            _mm_storeu_ps(matrix, column0[j]);
+            _mm_storeu_ps(matrix + 4, column1[j]);
+            _mm_storeu_ps(matrix + 8, column2[j]);
+            _mm_storeu_ps(matrix + 12, column3[j]);
+        }
+
+        if (!compact)
+            continue;
+        __m128 halfSin, halfCos;
+        Math::sinCos4(_mm_mul_ps(_mm_loadu_ps(&angles[i]), half), halfSin, halfCos);
+        __m128 quaternion[4] = {_mm_mul_ps(halfSin, x), _mm_mul_ps(halfSin, y), _mm_mul_ps(halfSin, z), halfCos};
+        _MM_TRANSPOSE4_PS(quaternion[0], quaternion[1], quaternion[2], quaternion[3]);
+        for (int j = 0; j < 4; j++)
+        {
+            CompactTransform &record = compact[i + j];
+            const glm::vec4 &translation = out[i + j][3];
+            record.x = translation.x;
+            record.y = translation.y;
+            record.z = translation.z;
+            _mm_storel_epi64((__m128i *)record.rotation, simdFloatToHalf(quaternion[j]));
+            record.scale = halfOne;
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        float s, c;
+        Math::sinCos(angles[i], s, c);
+        float k = 1.0f - c;
+        float x = axisX[i], y = axisY[i], z = axisZ[i];
+        glm::vec3 position = positions.at(i);
+
+        glm::mat4 &m = out[i];
+        m[0] = glm::vec4(k * x * x + c, k * x * y + s * z, k * x * z - s * y, 0.0f);
+        m[1] = glm::vec4(k * x * y - s * z, k * y * y + c, k * y * z + s * x, 0.0f);
+        m[2] = glm::vec4(k * x * z + s * y, k * y * z - s * x, k * z * z + c, 0.0f);
+        m[3] = glm::vec4(position, 1.0f);
+
+        if (!compact)
+            continue;
+        float halfSin, halfCos;
+        Math::sinCos(angles[i] * 0.5f, halfSin, halfCos);
+        const float quaternion[4] = {halfSin * x, halfSin * y, halfSin * z, halfCos};
+        CompactTransform &record = compact[i];
+        record.x = position.x;
+        record.y = position.y;
+        record.z = position.z;
+        for (int q = 0; q < 4; q++)
+            record.rotation[q] = glm::packHalf1x16(quaternion[q]);
+        record.scale = halfOne;
+    }
+}
+
+// out[i] = glm::rotate(glm::translate(I, position[i]), angle[i], axis[i]), see batchTranslateRotateFrom()
+template <typename Math = TransformMath>
+inline void batchTranslateRotate(const float *positionX, const float *positionY, const float *positionZ,
+                                 const float *axisX, const float *axisY, const float *axisZ, const float *angles,
+                                 glm::mat4 *out, size_t count, CompactTransform *compact = nullptr)
+{
+    batchTranslateRotateFrom<Math>(FloatPositions{positionX, positionY, positionZ}, axisX, axisY, axisZ, angles,
+                                   out, count, compact);
+}
+
+// the same with the translations position[i] - origin, subtracted in double: matrices relative
+// to a floating origin near the camera, precise however far from 0 the objects are
+template <typename Math = TransformMath>
+inline void batchTranslateRotate(const double *positionX, const double *positionY, const double *positionZ,
+                                 const glm::dvec3 &origin, const float *axisX, const float *axisY,
+                                 const float *axisZ, const float *angles, glm::mat4 *out, size_t count,
+                                 CompactTransform *compact = nullptr)
+{
+    batchTranslateRotateFrom<Math>(RelativePositions{positionX, positionY, positionZ, origin}, axisX, axisY, axisZ,
+                                   angles, out, count, compact);
+}
+
+// bit j of mask set means sphere first + j is visible
+inline void appendVisibleMask(std::vector<uint32_t> &out, size_t first, int mask)
+{
+    while (mask)
+    {
+        int lane = 0;
+        while (!(mask & (1 << lane)))
+            lane++;
+        out.push_back((uint32_t)(first + lane));
+        mask &= mask - 1;
+    }
+}
+
+// appends the spheres of first to last - 1 that are on the inner side of (or cross) every
+// one of the planes to out, in ascending order. Planes are normalized, dot(normal, p) + d
+// is the signed distance of p, positive inside.
+inline void batchCullSpheres(const glm::vec4 *planes, int planeCount, const float *centerX, const float *centerY,
+                             const float *centerZ, const float *radius, size_t first, size_t last,
+                             std::vector<uint32_t> &out)
+{
+    size_t i = first;
+#if SIMD_AVX
+    for (; i + 8 <= last; i += 8)
+    {
+        Vec3x8 center = Vec3x8::load(&centerX[i], &centerY[i], &centerZ[i]);
+        __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&radius[i]));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < planeCount; p++)
+        {
+            __m256 distance =
+                _mm256_add_ps(dot(center, Vec3x8::broadcast(glm::vec3(planes[p]))), _mm256_set1_ps(planes[p].w));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+        }
+        appendVisibleMask(out, i, _mm256_movemask_ps(inside));
+    }
+#endif
+#if SIMD_SSE2
+    for (; i + 4 <= last; i += 4)
+    {
+        Vec3x4 center = Vec3x4::load(&centerX[i], &centerY[i], &centerZ[i]);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[i]));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < planeCount; p++)
+        {
+            __m128 distance = _mm_add_ps(dot(center, Vec3x4::broadcast(glm::vec3(planes[p]))), _mm_set1_ps(planes[p].w));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+        appendVisibleMask(out, i, _mm_movemask_ps(inside));
+    }
+#endif
+    for (; i < last; i++)
+    {
+        bool inside = true;
+        for (int p = 0; p < planeCount; p++)
+        {
+            const glm::vec4 &plane = planes[p];
+            float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+            inside = inside && distance >= -radius[i];
+        }
+        if (inside)
+            out.push_back((uint32_t)i);
+    }
+}
+
+// batchCullSpheres() for viewCount views at once: planes holds planeCount planes per view one
+// view after the other, out[v] gets the spheres view v sees. Every sphere is loaded once
+// and tested against all the views while it is in registers.
+inline void batchCullSpheresViews(const glm::vec4 *planes, int planeCount, int viewCount, const float *centerX,
+                                  const float *centerY, const float *centerZ, const float *radius, size_t first,
+                                  size_t last, std::vector<uint32_t> *out)
+{
+    size_t i = first;
+#if SIMD_AVX
+    for (; i + 8 <= last; i += 8)
+    {
+        Vec3x8 center = Vec3x8::load(&centerX[i], &centerY[i], &centerZ[i]);
+        __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&radius[i]));
+        for (int v = 0; v < viewCount; v++)
+        {
+            const glm::vec4 *viewPlanes = planes + v * planeCount;
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < planeCount; p++)
+            {
+                __m256 distance = _mm256_add_ps(dot(center, Vec3x8::broadcast(glm::vec3(viewPlanes[p]))),
+                                                _mm256_set1_ps(viewPlanes[p].w));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+            }
+            appendVisibleMask(out[v], i, _mm256_movemask_ps(inside));
+        }
+    }
+#endif
+#if SIMD_SSE2
+    for (; i + 4 <= last; i += 4)
+    {
+        Vec3x4 center = Vec3x4::load(&centerX[i], &centerY[i], &centerZ[i]);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[i]));
+        for (int v = 0; v < viewCount; v++)
+        {
+            const glm::vec4 *viewPlanes = planes + v * planeCount;
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < planeCount; p++)
+            {
+                __m128 distance = _mm_add_ps(dot(center, Vec3x4::broadcast(glm::vec3(viewPlanes[p]))),
+                                             _mm_set1_ps(viewPlanes[p].w));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+            }
+            appendVisibleMask(out[v], i, _mm_movemask_ps(inside));
+        }
+    }
+#endif
+    for (; i < last; i++)
+    {
+        for (int v = 0; v < viewCount; v++)
+        {
+            const glm::vec4 *viewPlanes = planes + v * planeCount;
+            bool inside = true;
+            for (int p = 0; p < planeCount; p++)
+            {
+                const glm::vec4 &plane = viewPlanes[p];
+                float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+                inside = inside && distance >= -radius[i];
+            }
+            if (inside)
+                out[v].push_back((uint32_t)i);
+        }
+    }
+}
+
+// --math-benchmark [count] [iterations]: every batched kernel against the plain GLM loop it
+// replaces on count random objects, with the largest difference between the two results,
+// then the error of FastMath against ExactMath. Returns the number of kernels that differ
+// by more than 1e-3, plus one when FastMath is outside its documented bounds.
+inline int benchmarkBatchMath(size_t count, int iterations)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<float> x(count), y(count), z(count), ax(count), ay(count), az(count), angles(count), radius(count);
+    std::vector<glm::vec4> vectors(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        x[i] = unit(random) * 100.0f;
+        y[i] = unit(random) * 100.0f;
+        z[i] = unit(random) * 100.0f;
+        glm::vec3 axis = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 2.0f, 0.0f));
+        ax[i] = axis.x;
+        ay[i] = axis.y;
+        az[i] = axis.z;
+        angles[i] = unit(random) * 3.14159265f;
+        radius[i] = (unit(random) + 1.5f) * 2.0f;
+        vectors[i] = glm::vec4(x[i], y[i], z[i], 1.0f);
+    }
+    glm::mat4 matrix = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 3.0f)), 0.7f,
+                                   glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+    glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f) *
+                               glm::lookAt(glm::vec3(0.0f, 0.0f, 150.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::vec4 planes[6];
+    for (int axis = 0; axis < 3; axis++)
+        for (int side = 0; side < 2; side++)
+        {
+            glm::vec4 row(viewProjection[0][axis], viewProjection[1][axis], viewProjection[2][axis],
+                          viewProjection[3][axis]);
+            glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+            glm::vec4 plane = side == 0 ? w + row : w - row;
+            planes[axis * 2 + side] = plane / glm::length(glm::vec3(plane));
+        }
+
+    int failures = 0;
+    // milliseconds per iteration of function
+    auto time = [iterations](auto function) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+            function();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0 / iterations;
+    };
+    auto report = [&failures](const char *name, double glmMs, double batchMs, float difference) {
+        std::cout << name << "  glm " << glmMs << " ms  batch " << batchMs << " ms  x" << glmMs / batchMs
+                  << "  max difference " << difference << "\n";
+        if (!(difference <= 1e-3f))
+            failures++;
+    };
+
+    std::vector<glm::vec4> glmVectors(count), batchVectors(count);
+    double glmMs = time([&] {
+        for (size_t i = 0; i < count; i++)
+            glmVectors[i] = matrix * vectors[i];
+    });
+    double batchMs = time([&] { batchTransform(matrix, vectors.data(), batchVectors.data(), count); });
+    float difference = 0.0f;
+    for (size_t i = 0; i < count; i++)
+        for (int c = 0; c < 4; c++)
+            difference = std::max(difference, std::abs(glmVectors[i][c] - batchVectors[i][c]));
+    report("mat4 * vec4 (AoS)", glmMs, batchMs, difference);
+
+#if GLM_CONFIG_ALIGNED_GENTYPES == GLM_ENABLE
+    {
+        std::vector<glm::aligned_vec4> alignedIn(vectors.begin(), vectors.end()), alignedOut(count);
+        glm::aligned_mat4 alignedMatrix(matrix);
+        double alignedMs =
+            time([&] { batchTransform(alignedMatrix, alignedIn.data(), alignedOut.data(), count); });
+        difference = 0.0f;
+        for (size_t i = 0; i < count; i++)
+            for (int c = 0; c < 4; c++)
+                difference = std::max(difference, std::abs(glmVectors[i][c] - alignedOut[i][c]));
+        report("mat4 * vec4 (GLM aligned)", glmMs, alignedMs, difference);
+    }
+#endif
+
+    std::vector<float> outX(count), outY(count), outZ(count);
+    batchMs = time([&] {
+        batchTransformPoints(matrix, x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), count);
+    });
+    difference = 0.0f;
+    for (size_t i = 0; i < count; i++)
+        difference = std::max({difference, std::abs(glmVectors[i].x - outX[i]), std::abs(glmVectors[i].y - outY[i]),
+                               std::abs(glmVectors[i].z - outZ[i])});
+    report("mat4 * point (SoA)", glmMs, batchMs, difference);
+
+    std::vector<glm::mat4> glmModels(count), batchModels(count);
+    glmMs = time([&] {
+        for (size_t i = 0; i < count; i++)
+            glmModels[i] = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(x[i], y[i], z[i])), angles[i],
+                                       glm::vec3(ax[i], ay[i], az[i]));
+    });
+    batchMs = time([&] {
+        batchTranslateRotate(x.data(), y.data(), z.data(), ax.data(), ay.data(), az.data(), angles.data(),
+                             batchModels.data(), count);
+    });
+    difference = 0.0f;
+    for (size_t i = 0; i < count; i++)
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                difference = std::max(difference, std::abs(glmModels[i][c][r] - batchModels[i][c][r]));
+    report("translate * rotate", glmMs, batchMs, difference);
+
+    // the compact records next to the matrices, against glm::quat_cast() of the glm ones
+    std::vector<CompactTransform> compact(count);
+    double compactMs = time([&] {
+        batchTranslateRotate(x.data(), y.data(), z.data(), ax.data(), ay.data(), az.data(), angles.data(),
+                             batchModels.data(), count, compact.data());
+    });
+    difference = 0.0f;
+    for (size_t i = 0; i < count; i++)
+    {
+        glm::quat expected = glm::quat_cast(glm::mat3(glmModels[i]));
+        glm::vec4 reference(expected.x, expected.y, expected.z, expected.w);
+        glm::vec4 decoded;
+        for (int q = 0; q < 4; q++)
+            decoded[q] = glm::unpackHalf1x16(compact[i].rotation[q]);
+        // q and -q are the same rotation
+        if (glm::dot(reference, decoded) < 0.0f)
+            decoded = -decoded;
+        difference = std::max({difference, glm::length(reference - decoded), std::abs(compact[i].x - x[i]),
+                               std::abs(glm::unpackHalf1x16(compact[i].scale) - 1.0f)});
+    }
+    report("translate * rotate + compact", batchMs, compactMs, difference);
+
+    // the same objects a million units out in double, relative to an origin out there with them
+    const glm::dvec3 farOrigin(1e6, -2e6, 3e6);
+    std::vector<double> farX(count), farY(count), farZ(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        farX[i] = farOrigin.x + x[i];
+        farY[i] = farOrigin.y + y[i];
+        farZ[i] = farOrigin.z + z[i];
+    }
+    double relativeMs = time([&] {
+        batchTranslateRotate(farX.data(), farY.data(), farZ.data(), farOrigin, ax.data(), ay.data(), az.data(),
+                             angles.data(), batchModels.data(), count);
+    });
+    difference = 0.0f;
+    for (size_t i = 0; i < count; i++)
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                difference = std::max(difference, std::abs(glmModels[i][c][r] - batchModels[i][c][r]));
+    report("translate * rotate relative", batchMs, relativeMs, difference);
+
+    std::vector<uint32_t> glmVisible, batchVisible;
+    glmVisible.reserve(count);
+    batchVisible.reserve(count);
+    glmMs = time([&] {
+        glmVisible.clear();
+        for (size_t i = 0; i < count; i++)
+        {
+            bool inside = true;
+            for (const glm::vec4 &plane : planes)
+                inside = inside && glm::dot(glm::vec3(plane), glm::vec3(x[i], y[i], z[i])) + plane.w >= -radius[i];
+            if (inside)
+                glmVisible.push_back((uint32_t)i);
+        }
+    });
+    batchMs = time([&] {
+        batchVisible.clear();
+        batchCullSpheres(planes, 6, x.data(), y.data(), z.data(), radius.data(), 0, count, batchVisible);
+    });
+    report("sphere / frustum planes", glmMs, batchMs, glmVisible == batchVisible ? 0.0f : 1.0f);
+
+    // FastMath against ExactMath over the ranges its bounds are stated for
+    float sinError = 0.0f, rsqrtError = 0.0f, normalizeError = 0.0f;
+    for (size_t i = 0; i < count; i++)
+    {
+        float angle = unit(random) * 1e4f;
+        float fastSin, fastCos, exactSin, exactCos;
+        FastMath::sinCos(angle, fastSin, fastCos);
+        ExactMath::sinCos(angle, exactSin, exactCos);
+        sinError = std::max({sinError, std::abs(fastSin - exactSin), std::abs(fastCos - exactCos)});
+        float value = std::ldexp(unit(random) + 1.5f, (int)(unit(random) * 60.0f));
+        float exact = ExactMath::rsqrt(value);
+        rsqrtError = std::max(rsqrtError, std::abs(FastMath::rsqrt(value) - exact) / exact);
+        glm::vec3 v(x[i], y[i], z[i] + 1e-3f);
+        normalizeError = std::max(normalizeError, std::abs(glm::length(FastMath::normalize(v)) - 1.0f));
+    }
+    std::cout << "fast sincos error " << sinError << "  rsqrt relative error " << rsqrtError
+              << "  normalize length error " << normalizeError << "\n";
+    if (!(sinError < 1e-6f && rsqrtError < 5e-7f && normalizeError < 1e-6f))
+    {
+        std::cout << "ERROR::BATCH_MATH::FAST_MATH_OUT_OF_BOUNDS\n";
+        failures++;
+    }
+    return failures;
+}
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "glm/glm.hpp"
+
+#include "camera.cpp"
+#include "shader_stats.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// a camera pose at a point in time, angles in degrees as in Camera
+struct CameraKey
+{
+    float time;
+    glm::vec3 position;
+    float yaw, pitch;
+};
+
+// Camera poses the benchmark flies through in place of the mouse and keyboard.
+// Positions follow a Catmull-Rom spline through the keys, the angles are interpolated
+// linearly, and the path loops once past its last key.
+class CameraPath
+{
+  public:
+    std::vector<CameraKey> keys;
+
+    // one "time x y z yaw pitch" key per line in increasing time, # starts a comment
+    bool load(const std::string &path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::CAMERA_PATH::FILE_NOT_FOUND: " << path << '\n';
+            return false;
+        }
+        keys.clear();
+        std::string line;
+        while (std::getline(file, line))
+        {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            CameraKey key;
+            if (fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch)
+                keys.push_back(key);
+        }
+        if (keys.size() < 2)
+        {
+            std::cout << "ERROR::CAMERA_PATH::TOO_FEW_KEYS: " << path << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    // a circle around center looking at it, one lap every seconds
+    static CameraPath orbit(const glm::vec3 &center, float radius, float height, float seconds, int steps = 16)
+    {
+        CameraPath path;
+        for (int i = 0; i <= steps; i++)
+        {
+            float angle = glm::radians(360.0f * i / steps);
+            glm::vec3 offset(std::sin(angle) * radius, height, std::cos(angle) * radius);
+            glm::vec3 direction = glm::normalize(-offset);
+            CameraKey key;
+            key.time = seconds * i / steps;
+            key.position = center + offset;
+            // Camera's front is (cos yaw cos pitch, sin pitch, sin yaw cos pitch)
+            key.yaw = glm::degrees(std::atan2(direction.z, direction.x));
+            key.pitch = glm::degrees(std::asin(direction.y));
+            // no wrap between neighbours, so the angles interpolate the short way
+            if (i > 0)
+            {
+                float previous = path.keys.back().yaw;
+                key.yaw = previous + std::remainder(key.yaw - previous, 360.0f);
+            }
+            path.keys.push_back(key);
+        }
+        return path;
+    }
+
+    float duration() const
+    {
+        return keys.empty() ? 0.0f : keys.back().time;
+    }
+
+    void apply(Camera &camera, float time) const
+    {
+        if (keys.empty())
+            return;
+        float length = duration();
+        if (length > 0.0f)
+            time = std::fmod(time, length);
+        size_t next = 1;
+        while (next < keys.size() - 1 && keys[next].time < time)
+            next++;
+        const CameraKey &a = keys[next - 1], &b = keys[std::min(next, keys.size() - 1)];
+        float span = b.time - a.time;
+        float t = span > 0.0f ? glm::clamp((time - a.time) / span, 0.0f, 1.0f) : 0.0f;
+
+        const glm::vec3 &p0 = keys[next >= 2 ? next - 2 : 0].position;
+        const glm::vec3 &p3 = keys[std::min(next + 1, keys.size() - 1)].position;
+        float t2 = t * t, t3 = t2 * t;
+        camera.position = 0.5f * (2.0f * a.position + (b.position - p0) * t +
+                                  (2.0f * p0 - 5.0f * a.position + 4.0f * b.position - p3) * t2 +
+                                  (3.0f * a.position - p0 - 3.0f * b.position + p3) * t3);
+        camera.yaw = glm::mix(a.yaw, b.yaw, t);
+        camera.pitch = glm::mix(a.pitch, b.pitch, t);
+    }
+};
+
+// averages of one benchmark run, what the regression suite compares
+struct BenchmarkResult
+{
+    std::string name;
+    // startup: compiling and linking every program, until the last texture is uploaded
+    float shaderMs = 0.0f, textureMs = 0.0f;
+    // steady state per frame
+    float cpuMs = 0.0f, gpuMs = 0.0f;
+    // CPU time of recording and submitting the draws, and that per draw call
+    float submitMs = 0.0f, microsecondsPerDraw = 0.0f;
+    float drawCalls = 0.0f;
+    // summed over the programs, 0 where the driver doesn't tell
+    float shaderInstructions = 0.0f;
+};
+
+// CPU and GPU frame times of a benchmark run, in milliseconds.
+// GPU times arrive a few frames late from the GpuProfiler, so there can be fewer of them.
+// Next to the whole frame the CPU time of the draw submission is kept with the number of
+// draw calls it made, and the startup times and the programs' costs are filled in by the caller.
+// A run that goes through variants of the renderer (the anti-aliasing modes) keeps the GPU times
+// of each apart.
+class BenchmarkRecorder
+{
+  public:
+    std::vector<float> cpu;
+    std::vector<float> gpu;
+    std::vector<float> submit;
+    std::vector<unsigned int> drawCalls;
+    float shaderMs = 0.0f;
+    float textureMs = 0.0f;
+    std::vector<ShaderStats> shaders;
+    // name and GPU frame times, in the order they were first added to
+    std::vector<std::pair<std::string, std::vector<float>>> variants;
+
+    void addCpu(float milliseconds, float submitMilliseconds = 0.0f, unsigned int draws = 0)
+    {
+        cpu.push_back(milliseconds);
+        submit.push_back(submitMilliseconds);
+        drawCalls.push_back(draws);
+    }
+
+    BenchmarkResult result(const std::string &name) const
+    {
+        BenchmarkResult result;
+        result.name = name;
+        result.shaderMs = shaderMs;
+        result.textureMs = textureMs;
+        result.cpuMs = average(cpu);
+        result.gpuMs = average(gpu);
+        result.submitMs = average(submit);
+        double draws = 0.0;
+        for (unsigned int count : drawCalls)
+            draws += count;
+        result.drawCalls = drawCalls.empty() ? 0.0f : (float)(draws / drawCalls.size());
+        result.microsecondsPerDraw = result.drawCalls > 0.0f ? result.submitMs * 1000.0f / result.drawCalls : 0.0f;
+        result.shaderInstructions = (float)shaderTotals().instructions;
+        return result;
+    }
+
+    void addGpu(float milliseconds)
+    {
+        gpu.push_back(milliseconds);
+    }
+
+    void addVariantGpu(const std::string &variant, float milliseconds)
+    {
+        for (std::pair<std::string, std::vector<float>> &entry : variants)
+        {
+            if (entry.first == variant)
+            {
+                entry.second.push_back(milliseconds);
+                return;
+            }
+        }
+        variants.push_back({variant, {milliseconds}});
+    }
+
+    // prefix.csv gets one row per frame, prefix.json the summary, prefix.shaders.csv one row per
+    // program when there are shaders; description is stored as is
+    bool write(const std::string &prefix, const std::string &description) const
+    {
+        std::ofstream csv(prefix + ".csv");
+        std::ofstream json(prefix + ".json");
+        if (!csv || !json)
+        {
+            std::cout << "ERROR::BENCHMARK::CANNOT_WRITE: " << prefix << '\n';
+            return false;
+        }
+        csv << "frame,cpu_ms,gpu_ms,submit_ms,draw_calls\n";
+        for (size_t i = 0; i < cpu.size(); i++)
+        {
+            csv << i << ',' << cpu[i] << ',';
+            if (i < gpu.size())
+                csv << gpu[i];
+            csv << ',' << submit[i] << ',' << drawCalls[i] << '\n';
+        }
+        json << "{\n  \"description\": \"" << description << "\",\n  \"frames\": " << cpu.size()
+             << ",\n  \"shader_ms\": " << shaderMs << ",\n  \"texture_ms\": " << textureMs
+             << ",\n  \"cpu_ms\": " << summary(cpu) << ",\n  \"gpu_ms\": " << summary(gpu)
+             << ",\n  \"submit_ms\": " << summary(submit);
+        if (!variants.empty())
+        {
+            json << ",\n  \"variants_gpu_ms\": {";
+            for (size_t i = 0; i < variants.size(); i++)
+                json << (i > 0 ? ", " : "") << "\"" << variants[i].first << "\": " << summary(variants[i].second);
+            json << "}";
+        }
+        if (!shaders.empty())
+        {
+            ShaderStats totals = shaderTotals();
+            json << ",\n  \"shaders\": {\"programs\": " << shaders.size() << ", \"link_ms\": " << totals.linkMs
+                 << ", \"uniforms\": " << totals.uniforms << ", \"attributes\": " << totals.attributes
+                 << ", \"instructions\": " << totals.instructions << ", \"max_registers\": " << totals.registers
+                 << "}";
+            std::ofstream programs(prefix + ".shaders.csv");
+            writeShaderStatsCsv(programs, shaders);
+        }
+        json << "\n}\n";
+        return true;
+    }
+
+    // one line for the console
+    std::string report() const
+    {
+        std::vector<float> sortedCpu = sorted(cpu), sortedGpu = sorted(gpu);
+        std::ostringstream out;
+        out << cpu.size() << " frames, cpu avg " << average(cpu) << " ms p99 " << percentile(sortedCpu, 99)
+            << " ms, gpu avg " << average(gpu) << " ms p99 " << percentile(sortedGpu, 99) << " ms";
+        return out.str();
+    }
+
+    // a line per variant with its cost over the first one, empty without variants
+    std::string variantReport() const
+    {
+        std::ostringstream out;
+        for (const std::pair<std::string, std::vector<float>> &entry : variants)
+        {
+            float cost = average(entry.second) - average(variants.front().second);
+            out << entry.first << ": gpu avg " << average(entry.second) << " ms (" << (cost >= 0.0f ? "+" : "")
+                << cost << " ms)\n";
+        }
+        return out.str();
+    }
+
+  private:
+    // instructions and registers stay 0 when no program has them
+    ShaderStats shaderTotals() const
+    {
+        ShaderStats totals;
+        totals.instructions = totals.registers = 0;
+        for (const ShaderStats &program : shaders)
+        {
+            totals.linkMs += program.linkMs;
+            totals.uniforms += program.uniforms;
+            totals.attributes += program.attributes;
+            totals.instructions += std::max(program.instructions, 0);
+            totals.registers = std::max(totals.registers, program.registers);
+        }
+        return totals;
+    }
+
+    static std::vector<float> sorted(const std::vector<float> &samples)
+    {
+        std::vector<float> result(samples);
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    static float average(const std::vector<float> &samples)
+    {
+        if (samples.empty())
+            return 0.0f;
+        double sum = 0.0;
+        for (float sample : samples)
+            sum += sample;
+        return (float)(sum / samples.size());
+    }
+
+    // nearest rank on sorted samples
+    static float percentile(const std::vector<float> &sortedSamples, int percent)
+    {
+        if (sortedSamples.empty())
+            return 0.0f;
+        size_t rank = (sortedSamples.size() * percent + 99) / 100;
+        return sortedSamples[std::min(sortedSamples.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+
+    static std::string summary(const std::vector<float> &samples)
+    {
+        std::vector<float> sortedSamples = sorted(samples);
+        std::ostringstream out;
+        out << "{\"min\": " << (sortedSamples.empty() ? 0.0f : sortedSamples.front())
+            << ", \"avg\": " << average(samples) << ", \"p50\": " << percentile(sortedSamples, 50)
+            << ", \"p95\": " << percentile(sortedSamples, 95) << ", \"p99\": " << percentile(sortedSamples, 99)
+            << ", \"max\": " << (sortedSamples.empty() ? 0.0f : sortedSamples.back()) << "}";
+        return out.str();
+    }
+};
+
+#endif
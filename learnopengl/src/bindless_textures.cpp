@@ -0,0 +1,186 @@
+#ifndef BINDLESS_TEXTURES_H
+#define BINDLESS_TEXTURES_H
+
+#include "glad/glad.h"
+
+#include "gl_extensions.cpp"
+#include "gl_objects.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Optional GL_ARB_bindless_texture path: every material slot holds the 64-bit handle of a
+// texture + sampler pair in a shader storage buffer, so shaders sample through the table
+// and draws never bind textures. The handles are created lazily in update(), which follows
+// the loader replacing a placeholder with the real texture.
+// Only the materials marked with use() during a frame are made resident, resident handles
+// stay around until more than residentBudget exist and are then evicted least recently used first.
+// Without the extension supported stays false and every call is a no-op.
+class BindlessTextures
+{
+  public:
+    // shader storage binding of the material table (see shader_src/bindless.fs)
+    static const unsigned int BINDING = 1;
+
+    bool supported = false;
+    size_t residentBudget;
+
+    // loader is used for the extension entry points, e.g. glfwGetProcAddress
+    BindlessTextures(GLADloadproc loader, unsigned int materialCount, size_t residentBudget = 64)
+        : residentBudget(residentBudget), materials(materialCount), table(materialCount, 0)
+    {
+        if (!hasGLExtension("GL_ARB_bindless_texture") || !GLAD_GL_VERSION_4_3)
+            return;
+        getTextureSamplerHandle = (GetTextureSamplerHandleProc)loader("glGetTextureSamplerHandleARB");
+        makeResident = (MakeHandleResidentProc)loader("glMakeTextureHandleResidentARB");
+        makeNonResident = (MakeHandleResidentProc)loader("glMakeTextureHandleNonResidentARB");
+        supported = getTextureSamplerHandle && makeResident && makeNonResident;
+        if (!supported)
+            return;
+
+        SSBO = createBuffer(table.size() * sizeof(GLuint64), table.data(), GL_DYNAMIC_STORAGE_BIT, GL_DYNAMIC_DRAW);
+    }
+
+    // has to go before the textures and samplers it references
+    ~BindlessTextures()
+    {
+        if (!supported)
+            return;
+        for (auto &entry : handles)
+        {
+            if (entry.second.resident)
+                makeNonResident(entry.second.handle);
+        }
+        deleteBuffers(1, &SSBO);
+    }
+
+    BindlessTextures(const BindlessTextures &) = delete;
+    BindlessTextures &operator=(const BindlessTextures &) = delete;
+
+    // the texture is read through the reference every update(), so it may still be loading
+    void setMaterial(unsigned int slot, const Texture2D &texture, const Sampler &sampler)
+    {
+        if (slot >= materials.size())
+            return;
+        materials[slot] = {&texture, &sampler};
+    }
+
+    // marks a material as drawn this frame
+    void use(unsigned int slot)
+    {
+        if (slot < materials.size())
+            materials[slot].used = true;
+    }
+
+    // GL thread, once per frame before drawing: makes the used materials resident,
+    // evicts old handles and uploads the table when it changed
+    void update()
+    {
+        if (!supported)
+            return;
+        frame++;
+
+        bool dirty = false;
+        for (size_t slot = 0; slot < materials.size(); slot++)
+        {
+            Material &material = materials[slot];
+            if (!material.used || !material.texture || !material.texture->ID)
+                continue;
+            material.used = false;
+
+            Residency &residency = acquire(material.texture->ID, material.sampler->ID);
+            residency.lastUsed = frame;
+            if (table[slot] != residency.handle)
+            {
+                table[slot] = residency.handle;
+                dirty = true;
+            }
+        }
+        evict();
+
+        if (dirty)
+            updateBuffer(SSBO, 0, table.size() * sizeof(GLuint64), table.data());
+    }
+
+    void bind() const
+    {
+        if (supported)
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, SSBO, 0, 0);
+    }
+
+    size_t residentCount() const
+    {
+        return resident;
+    }
+
+  private:
+    typedef GLuint64(APIENTRYP GetTextureSamplerHandleProc)(GLuint texture, GLuint sampler);
+    typedef void(APIENTRYP MakeHandleResidentProc)(GLuint64 handle);
+
+    struct Material
+    {
+        const Texture2D *texture = NULL;
+        const Sampler *sampler = NULL;
+        bool used = false;
+    };
+    struct Residency
+    {
+        GLuint64 handle = 0;
+        bool resident = false;
+        uint64_t lastUsed = 0;
+    };
+
+    GetTextureSamplerHandleProc getTextureSamplerHandle = NULL;
+    MakeHandleResidentProc makeResident = NULL;
+    MakeHandleResidentProc makeNonResident = NULL;
+
+    unsigned int SSBO = 0;
+    std::vector<Material> materials;
+    std::vector<GLuint64> table;
+    // keyed by texture ID << 32 | sampler ID, handles can't be deleted so they are kept
+    std::unordered_map<uint64_t, Residency> handles;
+    size_t resident = 0;
+    uint64_t frame = 0;
+
+    Residency &acquire(unsigned int texture, unsigned int sampler)
+    {
+        Residency &residency = handles[(uint64_t)texture << 32 | sampler];
+        if (!residency.handle)
+            residency.handle = getTextureSamplerHandle(texture, sampler);
+        if (!residency.resident)
+        {
+            makeResident(residency.handle);
+            residency.resident = true;
+            resident++;
+        }
+        return residency;
+    }
+
+    // makes handles over the budget non resident, oldest first, never ones used this frame
+    void evict()
+    {
+        if (resident <= residentBudget)
+            return;
+        std::vector<Residency *> candidates;
+        for (auto &entry : handles)
+        {
+            if (entry.second.resident && entry.second.lastUsed != frame)
+                candidates.push_back(&entry.second);
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Residency *a, const Residency *b) { return a->lastUsed < b->lastUsed; });
+        for (Residency *residency : candidates)
+        {
+            if (resident <= residentBudget)
+                break;
+            makeNonResident(residency->handle);
+            residency->resident = false;
+            resident--;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef BLOCK_LAYOUT_H
+#define BLOCK_LAYOUT_H
+
+#include "glad/glad.h"
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Checks that a C++ struct has exactly the layout of the GLSL block it mirrors, so it can be
+// memcpy'd (or written in place) into a mapped uniform or storage buffer as it is.
+// The struct is described by a table of BLOCK_MEMBER()s in declaration order; at compile time
+// blockLayoutMismatch() lays the members out by the std140 or std430 rules and compares the
+// offsets, at run time Shader::uniformBlock() / storageBlock() reflect what the driver made of
+// the GLSL and checkBlockLayout() compares that too.
+//
+//   constexpr BlockMember FRAME_DATA_LAYOUT[] = {BLOCK_MEMBER(FrameData, view, GL_FLOAT_MAT4), ...};
+//   static_assert(blockLayoutMismatch(FRAME_DATA_LAYOUT, STD140) == -1, "...");
+
+enum BlockPacking
+{
+    STD140,
+    STD430,
+};
+
+// one member of the C++ struct, type is the GLSL type as a GL enum
+struct BlockMember
+{
+    const char *name;
+    size_t offset;
+    GLenum type;
+    // elements of an array, 1 otherwise
+    int arraySize;
+};
+
+#define BLOCK_MEMBER(Struct, member, type) BlockMember{#member, offsetof(Struct, member), type, 1}
+#define BLOCK_ARRAY(Struct, member, type, count) BlockMember{#member, offsetof(Struct, member), type, count}
+
+// columns and rows of a type (1 x n for vectors, 1 x 1 for scalars) and its GLSL name,
+// false for types blocks can't hold here
+constexpr bool blockTypeShape(GLenum type, int &columns, int &rows, const char *&name)
+{
+    struct Shape
+    {
+        GLenum type;
+        int columns, rows;
+        const char *name;
+    };
+    const Shape shapes[] = {
+        {GL_FLOAT, 1, 1, "float"},       {GL_FLOAT_VEC2, 1, 2, "vec2"},        {GL_FLOAT_VEC3, 1, 3, "vec3"},
+        {GL_FLOAT_VEC4, 1, 4, "vec4"},   {GL_INT, 1, 1, "int"},                {GL_INT_VEC2, 1, 2, "ivec2"},
+        {GL_INT_VEC3, 1, 3, "ivec3"},    {GL_INT_VEC4, 1, 4, "ivec4"},         {GL_UNSIGNED_INT, 1, 1, "uint"},
+        {GL_UNSIGNED_INT_VEC2, 1, 2, "uvec2"}, {GL_UNSIGNED_INT_VEC3, 1, 3, "uvec3"}, {GL_UNSIGNED_INT_VEC4, 1, 4, "uvec4"},
+        {GL_BOOL, 1, 1, "bool"},         {GL_FLOAT_MAT2, 2, 2, "mat2"},        {GL_FLOAT_MAT3, 3, 3, "mat3"},
+        {GL_FLOAT_MAT4, 4, 4, "mat4"},
+    };
+    for (const Shape &shape : shapes)
+    {
+        if (shape.type == type)
+        {
+            columns = shape.columns;
+            rows = shape.rows;
+            name = shape.name;
+            return true;
+        }
+    }
+    return false;
+}
+
+constexpr size_t alignBlockOffset(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// where a member goes by the packing rules, in bytes: its alignment, the stride of the columns
+// of a matrix and of the elements of an array, and its whole size
+struct BlockPlacement
+{
+    size_t alignment = 0;
+    size_t columnStride = 0;
+    size_t elementStride = 0;
+    size_t size = 0;
+};
+
+constexpr BlockPlacement placeBlockMember(GLenum type, int arraySize, BlockPacking packing)
+{
+    BlockPlacement placement;
+    int columns = 0, rows = 0;
+    const char *name = "";
+    if (!blockTypeShape(type, columns, rows, name))
+        return placement;
+    // a vector of 3 is aligned like one of 4
+    size_t vectorAlignment = rows == 1 ? 4 : rows == 2 ? 8 : 16;
+    size_t vectorSize = (size_t)rows * 4;
+    if (arraySize == 1 && columns == 1)
+    {
+        placement.alignment = vectorAlignment;
+        placement.size = vectorSize;
+        return placement;
+    }
+    // matrices are arrays of their columns, std140 rounds both up to vec4
+    placement.alignment = packing == STD140 ? alignBlockOffset(vectorAlignment, 16) : vectorAlignment;
+    placement.columnStride = alignBlockOffset(vectorSize, placement.alignment);
+    placement.elementStride = placement.columnStride * (size_t)columns;
+    placement.size = placement.elementStride * (size_t)arraySize;
+    return placement;
+}
+
+// index of the first member not where the packing rules put it, -1 when all of them are
+template <size_t N> constexpr int blockLayoutMismatch(const BlockMember (&members)[N], BlockPacking packing)
+{
+    size_t end = 0;
+    for (size_t i = 0; i < N; i++)
+    {
+        BlockPlacement placement = placeBlockMember(members[i].type, members[i].arraySize, packing);
+        if (placement.alignment == 0 || members[i].offset != alignBlockOffset(end, placement.alignment))
+            return (int)i;
+        end = members[i].offset + placement.size;
+    }
+    return -1;
+}
+
+// the size of the struct as an array element of the block (or sizeof the C++ struct), padded
+// to its largest alignment, which std140 rounds up to vec4
+template <size_t N> constexpr size_t blockLayoutSize(const BlockMember (&members)[N], BlockPacking packing)
+{
+    size_t end = 0, alignment = packing == STD140 ? 16 : 4;
+    for (size_t i = 0; i < N; i++)
+    {
+        BlockPlacement placement = placeBlockMember(members[i].type, members[i].arraySize, packing);
+        end = members[i].offset + placement.size;
+        alignment = placement.alignment > alignment ? placement.alignment : alignment;
+    }
+    return alignBlockOffset(end, alignment);
+}
+
+// the GLSL declarations of the members, what the block should say
+inline std::string glslBlockMembers(const BlockMember *members, size_t count)
+{
+    std::string text;
+    for (size_t i = 0; i < count; i++)
+    {
+        int columns = 0, rows = 0;
+        const char *name = "?";
+        blockTypeShape(members[i].type, columns, rows, name);
+        text += std::string("    ") + name + " " + members[i].name;
+        if (members[i].arraySize > 1)
+            text += "[" + std::to_string(members[i].arraySize) + "]";
+        text += ";\n";
+    }
+    return text;
+}
+
+// one active variable of a block as the driver laid it out
+struct BlockVariable
+{
+    std::string name;
+    int offset = -1;
+    GLenum type = 0;
+    int arraySize = 1;
+    int arrayStride = 0;
+    int matrixStride = 0;
+    // stride of the array of structs a storage block variable is in, 0 otherwise
+    int topLevelArrayStride = 0;
+};
+
+// a reflected uniform or shader storage block, dataSize -1 when the program doesn't have it
+struct BlockInfo
+{
+    int dataSize = -1;
+    std::vector<BlockVariable> variables;
+
+    bool valid() const
+    {
+        return dataSize >= 0;
+    }
+
+    // the variable, arrays also found without their "[0]"
+    const BlockVariable *find(const std::string &name) const
+    {
+        for (const BlockVariable &variable : variables)
+        {
+            if (variable.name == name || variable.name == name + "[0]")
+                return &variable;
+        }
+        return NULL;
+    }
+};
+
+// Compares the reflected block with the C++ description. Variables of a storage block that are
+// members of an array of structs are named like "objects[0].model", prefix is "objects[0]." then
+// and elementSize the sizeof the struct. Prints every difference, true when there is none;
+// a block the program doesn't have is left alone.
+template <size_t N>
+inline bool checkBlockLayout(const char *blockName, const BlockInfo &block, const BlockMember (&members)[N],
+                             BlockPacking packing, const std::string &prefix = "", size_t elementSize = 0)
+{
+    if (!block.valid())
+        return true;
+    bool matches = true;
+    for (const BlockMember &member : members)
+    {
+        std::string name = prefix + member.name;
+        const BlockVariable *variable = block.find(name);
+        BlockPlacement placement = placeBlockMember(member.type, member.arraySize, packing);
+        int columns = 0, rows = 0;
+        const char *typeName = "";
+        blockTypeShape(member.type, columns, rows, typeName);
+        const char *problem = NULL;
+        if (!variable)
+            problem = "is not in the block";
+        else if (variable->type != member.type || variable->arraySize != member.arraySize)
+            problem = "has another type";
+        else if (variable->offset != (int)member.offset)
+            problem = "is at another offset";
+        else if ((columns > 1 && variable->matrixStride != (int)placement.columnStride) ||
+                 (member.arraySize > 1 && variable->arrayStride != (int)placement.elementStride))
+            problem = "has another stride";
+        else if (elementSize && variable->topLevelArrayStride != (int)elementSize)
+            problem = "is in an array of another stride";
+        if (problem)
+        {
+            std::cout << "ERROR::BLOCK_LAYOUT::MISMATCH: " << blockName << "." << name << " " << problem;
+            if (variable)
+                std::cout << " (offset " << variable->offset << ", C++ " << member.offset << ")";
+            std::cout << '\n';
+            matches = false;
+        }
+    }
+    if (!matches)
+        std::cout << "the C++ side expects:\n" << glslBlockMembers(members, N);
+    return matches;
+}
+
+#endif
@@ -0,0 +1,538 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "glm/glm.hpp"
+
+#include "frustum_culler.cpp"
+#include "simd_math.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounding volume hierarchy of axis aligned boxes over the bounding spheres of the scene
+// objects, for frustum culling, ray and sphere casts and overlap queries that don't look at
+// every object.
+// build() splits the objects top down at the median of the longest axis of their centers,
+// LEAF_SIZE objects at most per leaf; the nodes are stored in depth first order, so the
+// objects below any node are one range of order and every child comes after its parent.
+// Moving objects don't rebuild it: setSphere() updates an object and refit() grows or shrinks
+// the boxes of its leaf and the ones above, a reverse pass over the nodes. A refit tree gets
+// looser as objects wander away from where the split put them, once the boxes' surface area
+// is twice what the build gave, refit() builds it again.
+class BoundingVolumeHierarchy
+{
+  public:
+    static const uint32_t LEAF_SIZE = 4;
+
+    // counters of the last cull()
+    size_t tested = 0;
+    size_t visited = 0;
+    // times refit() built the tree again
+    unsigned int rebuilds = 0;
+
+    size_t size() const
+    {
+        return spheres.size();
+    }
+
+    // xyz center and w radius per object
+    void build(const std::vector<glm::vec4> &objectSpheres)
+    {
+        spheres = objectSpheres;
+        rebuild();
+    }
+
+    // takes effect on the next refit(), objects can be set from different threads
+    void setSphere(size_t index, const glm::vec4 &sphere)
+    {
+        spheres[index] = sphere;
+    }
+
+    // the boxes above the objects that changed since the last call
+    void refit(const uint32_t *objects, size_t count)
+    {
+        if (nodes.empty())
+            return;
+        for (size_t i = 0; i < count; i++)
+            dirty[leafOf[objects[i]]] = 1;
+        for (size_t n = nodes.size(); n-- > 0;)
+        {
+            Node &node = nodes[n];
+            if (node.left)
+            {
+                if (!dirty[node.left] && !dirty[node.left + 1])
+                    continue;
+                dirty[node.left] = dirty[node.left + 1] = 0;
+                area -= surfaceArea(node);
+                node.low = glm::min(nodes[node.left].low, nodes[node.left + 1].low);
+                node.high = glm::max(nodes[node.left].high, nodes[node.left + 1].high);
+                area += surfaceArea(node);
+                dirty[n] = 1;
+            }
+            else if (dirty[n])
+            {
+                area -= surfaceArea(node);
+                fitLeaf(node);
+                area += surfaceArea(node);
+            }
+        }
+        dirty[0] = 0;
+        if (area > builtArea * 2.0f)
+        {
+            rebuild();
+            rebuilds++;
+        }
+    }
+
+    // the objects whose spheres touch the frustum, in ascending order
+    void cull(const Frustum &frustum, std::vector<uint32_t> &out)
+    {
+        out.clear();
+        tested = visited = 0;
+        if (nodes.empty())
+            return;
+        stack.clear();
+        stack.push_back({0, 0x3F});
+        while (!stack.empty())
+        {
+            Entry entry = stack.back();
+            stack.pop_back();
+            const Node &node = nodes[entry.node];
+            visited++;
+            uint32_t planes = entry.planes;
+            bool outside = false;
+            glm::vec3 center = (node.low + node.high) * 0.5f, extent = (node.high - node.low) * 0.5f;
+            for (int p = 0; p < 6 && !outside; p++)
+            {
+                if (!(planes & (1u << p)))
+                    continue;
+                const glm::vec4 &plane = frustum.planes[p];
+                float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+                float reach = glm::dot(glm::abs(glm::vec3(plane)), extent);
+                if (distance < -reach)
+                    outside = true;
+                else if (distance >= reach)
+                    planes &= ~(1u << p);
+            }
+            if (outside)
+                continue;
+            if (planes == 0)
+            {
+                // inside every plane, so is everything below
+                out.insert(out.end(), order.begin() + node.first, order.begin() + node.first + node.count);
+                continue;
+            }
+            if (node.left)
+            {
+                stack.push_back({node.left, planes});
+                stack.push_back({node.left + 1, planes});
+                continue;
+            }
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                const glm::vec4 &sphere = spheres[order[i]];
+                tested++;
+                bool inside = true;
+                for (int p = 0; p < 6 && inside; p++)
+                {
+                    if (planes & (1u << p))
+                        inside = glm::dot(glm::vec3(frustum.planes[p]), glm::vec3(sphere)) + frustum.planes[p].w >=
+                                 -sphere.w;
+                }
+                if (inside)
+                    out.push_back(order[i]);
+            }
+        }
+        std::sort(out.begin(), out.end());
+    }
+
+    // the nearest object whose sphere the ray from origin along the unit direction enters
+    // within maxDistance, false when there is none
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, uint32_t &object,
+                 float &distance) const
+    {
+        return cast(origin, direction, 0.0f, maxDistance, false, object, distance);
+    }
+
+    // how far a sphere of radius gets from origin along the unit direction, within maxDistance,
+    // before it touches the nearest object's sphere; one it starts in stops it only when it
+    // moves deeper in, so a sphere that got inside can always leave
+    bool sweepSphere(const glm::vec3 &origin, const glm::vec3 &direction, float radius, float maxDistance,
+                     uint32_t &object, float &distance) const
+    {
+        return cast(origin, direction, radius, maxDistance, true, object, distance);
+    }
+
+    // where a sphere of radius moving from from to to ends up: stopped a little short of the
+    // spheres in its way and sliding along them with what is left of the move, a few times
+    glm::vec3 slideSphere(const glm::vec3 &from, const glm::vec3 &to, float radius) const
+    {
+        const float SKIN = 1e-3f;
+        glm::vec3 position = from, move = to - from;
+        for (int slide = 0; slide < 4; slide++)
+        {
+            float length = glm::length(move);
+            if (length < 1e-6f)
+                break;
+            glm::vec3 direction = move / length;
+            uint32_t object;
+            float distance;
+            if (!sweepSphere(position, direction, radius, length, object, distance))
+                return position + move;
+            float travel = std::max(distance - SKIN, 0.0f);
+            position += direction * travel;
+            glm::vec3 normal = position - glm::vec3(spheres[object]);
+            float away = glm::length(normal);
+            normal = away > 1e-6f ? normal / away : -direction;
+            move = direction * (length - travel);
+            move -= normal * std::min(glm::dot(move, normal), 0.0f);
+        }
+        return position;
+    }
+
+    // the objects whose spheres touch the sphere or the box, in ascending order
+    void overlapSphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &out) const
+    {
+        overlap(center - radius, center + radius, out, [&](const glm::vec4 &sphere) {
+            glm::vec3 offset = glm::vec3(sphere) - center;
+            return glm::dot(offset, offset) <= (sphere.w + radius) * (sphere.w + radius);
+        });
+    }
+
+    void overlapBox(const glm::vec3 &low, const glm::vec3 &high, std::vector<uint32_t> &out) const
+    {
+        overlap(low, high, out, [&](const glm::vec4 &sphere) {
+            glm::vec3 offset = glm::vec3(sphere) - glm::clamp(glm::vec3(sphere), low, high);
+            return glm::dot(offset, offset) <= sphere.w * sphere.w;
+        });
+    }
+
+    struct RayHit
+    {
+        uint32_t object;
+        float distance;
+        bool hit;
+    };
+
+    // raycast() for count rays, four at a time down the tree together: a node is opened when
+    // any of the four enters it nearer than its nearest hit so far, so rays that start close
+    // and point the same way share most of the walk
+    void raycastPacket(const glm::vec3 *origins, const glm::vec3 *directions, size_t count, float maxDistance,
+                       RayHit *hits) const
+    {
+#if SIMD_SSE2
+        for (size_t first = 0; first < count; first += 4)
+            castPacket(origins + first, directions + first, std::min<size_t>(count - first, 4), maxDistance,
+                       hits + first);
+#else
+        for (size_t i = 0; i < count; i++)
+            hits[i].hit = raycast(origins[i], directions[i], maxDistance, hits[i].object, hits[i].distance);
+#endif
+    }
+
+  private:
+    struct Node
+    {
+        glm::vec3 low, high;
+        // the objects below are order[first, first + count)
+        uint32_t first, count;
+        // the children are left and left + 1, 0 for a leaf (the root is nobody's child)
+        uint32_t left;
+    };
+
+    std::vector<glm::vec4> spheres;
+    std::vector<Node> nodes;
+    std::vector<uint32_t> order, leafOf;
+    std::vector<unsigned char> dirty;
+    std::vector<glm::vec3> centers;
+    // sum of the boxes' surface areas, now and right after the last build
+    float area = 0.0f, builtArea = 0.0f;
+    // cull() traversal: a node and the planes it still straddles, a bit per plane
+    struct Entry
+    {
+        uint32_t node, planes;
+    };
+    std::vector<Entry> stack;
+
+    // deep enough for any tree: the median split halves every node, and a depth first walk
+    // holds a node's sibling per level above it
+    static const int STACK_SIZE = 64;
+
+    // the ray's nearest sphere grown by radius; with escapes a sphere the ray starts in is
+    // only hit when the ray heads towards its center
+    bool cast(const glm::vec3 &origin, const glm::vec3 &direction, float radius, float maxDistance, bool escapes,
+              uint32_t &object, float &distance) const
+    {
+        if (nodes.empty())
+            return false;
+        glm::vec3 inverse = 1.0f / direction;
+        float nearest = maxDistance;
+        bool hit = false;
+        uint32_t pending[STACK_SIZE];
+        int top = 0;
+        pending[top++] = 0;
+        while (top > 0)
+        {
+            const Node &node = nodes[pending[--top]];
+            if (enterBox(node, radius, origin, inverse) > nearest)
+                continue;
+            if (node.left)
+            {
+                // the nearer child last, so it is taken first
+                float left = enterBox(nodes[node.left], radius, origin, inverse);
+                float right = enterBox(nodes[node.left + 1], radius, origin, inverse);
+                pending[top++] = left < right ? node.left + 1 : node.left;
+                pending[top++] = left < right ? node.left : node.left + 1;
+                continue;
+            }
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                const glm::vec4 &sphere = spheres[order[i]];
+                float reach = sphere.w + radius;
+                glm::vec3 toCenter = glm::vec3(sphere) - origin;
+                float along = glm::dot(toCenter, direction);
+                float squared = glm::dot(toCenter, toCenter) - along * along;
+                if (squared > reach * reach)
+                    continue;
+                float enter = along - std::sqrt(reach * reach - squared);
+                if (escapes && enter < 0.0f && along <= 0.0f)
+                    continue;
+                // from inside the sphere it counts as hit at the origin
+                enter = std::max(enter, 0.0f);
+                if (along + reach < 0.0f || enter >= nearest)
+                    continue;
+                nearest = enter;
+                object = order[i];
+                hit = true;
+            }
+        }
+        distance = nearest;
+        return hit;
+    }
+
+    template <typename Touches>
+    void overlap(const glm::vec3 &low, const glm::vec3 &high, std::vector<uint32_t> &out, Touches touches) const
+    {
+        out.clear();
+        if (nodes.empty())
+            return;
+        uint32_t pending[STACK_SIZE];
+        int top = 0;
+        pending[top++] = 0;
+        while (top > 0)
+        {
+            const Node &node = nodes[pending[--top]];
+            if (glm::any(glm::greaterThan(node.low, high)) || glm::any(glm::lessThan(node.high, low)))
+                continue;
+            if (node.left)
+            {
+                pending[top++] = node.left + 1;
+                pending[top++] = node.left;
+                continue;
+            }
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+                if (touches(spheres[order[i]]))
+                    out.push_back(order[i]);
+        }
+        std::sort(out.begin(), out.end());
+    }
+
+#if SIMD_SSE2
+    // up to four rays by lanes, the missing lanes have a negative nearest and so never enter
+    void castPacket(const glm::vec3 *origins, const glm::vec3 *directions, size_t count, float maxDistance,
+                    RayHit *hits) const
+    {
+        float lanes[9][4] = {};
+        for (size_t k = 0; k < 4; k++)
+        {
+            glm::vec3 origin = origins[std::min<size_t>(k, count - 1)];
+            glm::vec3 direction = directions[std::min<size_t>(k, count - 1)];
+            for (int c = 0; c < 3; c++)
+            {
+                lanes[c][k] = origin[c];
+                lanes[3 + c][k] = direction[c];
+                lanes[6 + c][k] = 1.0f / direction[c];
+            }
+        }
+        __m128 ox = _mm_loadu_ps(lanes[0]), oy = _mm_loadu_ps(lanes[1]), oz = _mm_loadu_ps(lanes[2]);
+        __m128 dx = _mm_loadu_ps(lanes[3]), dy = _mm_loadu_ps(lanes[4]), dz = _mm_loadu_ps(lanes[5]);
+        __m128 ix = _mm_loadu_ps(lanes[6]), iy = _mm_loadu_ps(lanes[7]), iz = _mm_loadu_ps(lanes[8]);
+        const float missing = -1.0f;
+        __m128 nearest = _mm_setr_ps(maxDistance, count > 1 ? maxDistance : missing,
+                                     count > 2 ? maxDistance : missing, count > 3 ? maxDistance : missing);
+        __m128i objects = _mm_set1_epi32(-1);
+        __m128 zero = _mm_setzero_ps();
+
+        // lanes entering the box before their nearest hit, and where they enter it
+        auto enter = [&](const Node &node, __m128 &at) {
+            __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.low.x), ox), ix);
+            __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.high.x), ox), ix);
+            __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.low.y), oy), iy);
+            __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.high.y), oy), iy);
+            __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.low.z), oz), iz);
+            __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.high.z), oz), iz);
+            at = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), zero));
+            __m128 exit = _mm_min_ps(_mm_max_ps(x0, x1), _mm_min_ps(_mm_max_ps(y0, y1), _mm_max_ps(z0, z1)));
+            return _mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(at, exit), _mm_cmple_ps(at, nearest)));
+        };
+
+        uint32_t pending[STACK_SIZE];
+        int top = 0;
+        if (!nodes.empty())
+            pending[top++] = 0;
+        while (top > 0)
+        {
+            const Node &node = nodes[pending[--top]];
+            __m128 at;
+            if (!enter(node, at))
+                continue;
+            if (node.left)
+            {
+                // the child most of the lanes enter first is taken first
+                __m128 left, right;
+                int leftLanes = enter(nodes[node.left], left), rightLanes = enter(nodes[node.left + 1], right);
+                int leftFirst = _mm_movemask_ps(_mm_cmplt_ps(left, right)) & leftLanes;
+                bool leftNearer = simdLanes(leftFirst) * 2 >= simdLanes(leftLanes | rightLanes);
+                if (rightLanes && leftLanes)
+                {
+                    pending[top++] = leftNearer ? node.left + 1 : node.left;
+                    pending[top++] = leftNearer ? node.left : node.left + 1;
+                }
+                else
+                    pending[top++] = leftLanes ? node.left : node.left + 1;
+                continue;
+            }
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                const glm::vec4 &sphere = spheres[order[i]];
+                __m128 tx = _mm_sub_ps(_mm_set1_ps(sphere.x), ox);
+                __m128 ty = _mm_sub_ps(_mm_set1_ps(sphere.y), oy);
+                __m128 tz = _mm_sub_ps(_mm_set1_ps(sphere.z), oz);
+                __m128 radius = _mm_set1_ps(sphere.w), radiusSquared = _mm_set1_ps(sphere.w * sphere.w);
+                __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, dx), _mm_mul_ps(ty, dy)), _mm_mul_ps(tz, dz));
+                __m128 squared = _mm_sub_ps(
+                    _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz)),
+                    _mm_mul_ps(along, along));
+                __m128 inside = _mm_sub_ps(radiusSquared, squared);
+                __m128 at = _mm_max_ps(_mm_sub_ps(along, _mm_sqrt_ps(_mm_max_ps(inside, zero))), zero);
+                __m128 hit = _mm_and_ps(_mm_cmpge_ps(inside, zero), _mm_cmpge_ps(_mm_add_ps(along, radius), zero));
+                hit = _mm_and_ps(hit, _mm_cmplt_ps(at, nearest));
+                nearest = simdSelect(hit, at, nearest);
+                objects = _mm_or_si128(_mm_and_si128(_mm_castps_si128(hit), _mm_set1_epi32((int)order[i])),
+                                       _mm_andnot_si128(_mm_castps_si128(hit), objects));
+            }
+        }
+
+        float distances[4];
+        uint32_t found[4];
+        _mm_storeu_ps(distances, nearest);
+        _mm_storeu_si128((__m128i *)found, objects);
+        for (size_t k = 0; k < count; k++)
+            hits[k] = {found[k], distances[k], found[k] != UINT32_MAX};
+    }
+
+    static int simdLanes(int mask)
+    {
+        return (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1) + (mask >> 3 & 1);
+    }
+#endif
+
+    static float surfaceArea(const Node &node)
+    {
+        glm::vec3 size = node.high - node.low;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    void fitLeaf(Node &node)
+    {
+        node.low = glm::vec3(1e30f);
+        node.high = glm::vec3(-1e30f);
+        for (uint32_t i = node.first; i < node.first + node.count; i++)
+        {
+            const glm::vec4 &sphere = spheres[order[i]];
+            node.low = glm::min(node.low, glm::vec3(sphere) - sphere.w);
+            node.high = glm::max(node.high, glm::vec3(sphere) + sphere.w);
+        }
+    }
+
+    // distance along the ray to where it enters the box grown by radius, infinite when it misses
+    static float enterBox(const Node &node, float radius, const glm::vec3 &origin, const glm::vec3 &inverse)
+    {
+        glm::vec3 t0 = (node.low - radius - origin) * inverse, t1 = (node.high + radius - origin) * inverse;
+        glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+        float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+        float exit = std::min(far.x, std::min(far.y, far.z));
+        return enter <= exit ? enter : INFINITY;
+    }
+
+    void rebuild()
+    {
+        size_t count = spheres.size();
+        order.resize(count);
+        leafOf.resize(count);
+        centers.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            order[i] = (uint32_t)i;
+            centers[i] = glm::vec3(spheres[i]);
+        }
+        nodes.clear();
+        if (count == 0)
+            return;
+        nodes.push_back({glm::vec3(0.0f), glm::vec3(0.0f), 0, (uint32_t)count, 0});
+        // the nodes still to split, depth first so a subtree's nodes stay together
+        std::vector<uint32_t> pending = {0};
+        while (!pending.empty())
+        {
+            uint32_t index = pending.back();
+            pending.pop_back();
+            Node node = nodes[index];
+            if (node.count <= LEAF_SIZE)
+                continue;
+            glm::vec3 low(1e30f), high(-1e30f);
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                low = glm::min(low, centers[order[i]]);
+                high = glm::max(high, centers[order[i]]);
+            }
+            glm::vec3 size = high - low;
+            int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+            uint32_t half = node.count / 2;
+            std::nth_element(order.begin() + node.first, order.begin() + node.first + half,
+                             order.begin() + node.first + node.count,
+                             [&](uint32_t a, uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+            uint32_t left = (uint32_t)nodes.size();
+            nodes[index].left = left;
+            nodes.push_back({glm::vec3(0.0f), glm::vec3(0.0f), node.first, half, 0});
+            nodes.push_back({glm::vec3(0.0f), glm::vec3(0.0f), node.first + half, node.count - half, 0});
+            pending.push_back(left + 1);
+            pending.push_back(left);
+        }
+
+        // the boxes bottom up, children always come after their parent
+        area = 0.0f;
+        for (size_t n = nodes.size(); n-- > 0;)
+        {
+            Node &node = nodes[n];
+            if (node.left)
+            {
+                node.low = glm::min(nodes[node.left].low, nodes[node.left + 1].low);
+                node.high = glm::max(nodes[node.left].high, nodes[node.left + 1].high);
+            }
+            else
+            {
+                fitLeaf(node);
+                for (uint32_t i = node.first; i < node.first + node.count; i++)
+                    leafOf[order[i]] = (uint32_t)n;
+            }
+            area += surfaceArea(node);
+        }
+        builtArea = area;
+        dirty.assign(nodes.size(), 0);
+    }
+};
+
+#endif
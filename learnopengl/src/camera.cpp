@@ -4,6 +4,12 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "fast_math.cpp"
+#include "frustum_culler.cpp"
+
+#include <cstdint>
 
 enum Camera_Movement
 {
@@ -21,7 +27,13 @@ enum Camera_Movement
 #define DEFAULT_ZOOM 45.0f
 
 // An abstract camera class that processes input and calculates
-// the corresponding Euler Angles, Vectors and Matrices for use in OpenGL
+// the corresponding Euler Angles, Vectors and Matrices for use in OpenGL.
+// The vectors and the view, projection and view-projection matrices and frustum are
+// cached and only recalculated when position, yaw, pitch, zoom or the lens change,
+// version counts the recalculations so other systems can skip work on a still camera.
+// In quaternion mode the orientation is a quaternion instead: the yaw and pitch a frame
+// accumulates are applied as one rotation on the next read, and front, right and up are
+// the columns of its rotation matrix, so a mouse event is only two additions.
 class Camera
 {
   public:
@@ -38,6 +50,17 @@ class Camera
     float movementSpeed;
     float mouseSensitivity;
     float zoom;
+    // lens of the projection, see setLens()
+    float aspectRatio = 1.0f;
+    float zNear = 0.1f;
+    float zFar = 100.0f;
+    // reversed-Z projection with the far plane at infinity, see setReversedZ()
+    bool reversedZ = false;
+    // stereo: distance between the eyes and the distance at which they converge, world units
+    float eyeSeparation = 0.064f;
+    float convergence = 10.0f;
+    // identity looks down -z, the default yaw
+    glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
 
     // constructor with vectors
     // given the camera's position in the world
@@ -48,7 +71,7 @@ class Camera
         : position(position), front(glm::vec3(0.0f, 0.0f, -1.0f)), worldUp(worldUp), yaw(yaw), pitch(pitch),
           movementSpeed(DEFAULT_SPEED), mouseSensitivity(DEFAULT_SENSITIVITY), zoom(DEFAULT_ZOOM)
     {
-        updateCameraVectors();
+        refresh();
     }
 
     // constructor with scalar values
@@ -57,13 +80,95 @@ class Camera
           yaw(yaw), pitch(pitch), movementSpeed(DEFAULT_SPEED), mouseSensitivity(DEFAULT_SENSITIVITY),
           zoom(DEFAULT_ZOOM)
     {
-        updateCameraVectors();
+        refresh();
     }
 
     // returns the view matrix calculated using Euler Angles and the LookAt Matrix
-    glm::mat4 GetViewMatrix()
+    const glm::mat4 &GetViewMatrix()
+    {
+        refresh();
+        return view;
+    }
+
+    // perspective projection with zoom as the vertical field of view
+    const glm::mat4 &GetProjectionMatrix()
+    {
+        refresh();
+        return projection;
+    }
+
+    const glm::mat4 &GetViewProjectionMatrix()
+    {
+        refresh();
+        return viewProjection;
+    }
+
+    // eye 0 is the left one, eye 1 the right one, each half the separation off the position
+    // along right and looking the same way
+    glm::mat4 GetEyeViewMatrix(int eye)
+    {
+        refresh();
+        glm::vec3 eyePosition = position + right * eyeOffset(eye);
+        return glm::lookAt(eyePosition, eyePosition + front, up);
+    }
+
+    // the camera's projection for an eye image of the given aspect ratio, the lens shifted so
+    // that both eyes see a point convergence away in front of the camera at the same spot
+    glm::mat4 GetEyeProjectionMatrix(int eye, float aspect)
+    {
+        refresh();
+        glm::mat4 eyeProjection = projection;
+        eyeProjection[0][0] = projection[1][1] / aspect;
+        eyeProjection[2][0] = -eyeProjection[0][0] * eyeOffset(eye) / convergence;
+        return eyeProjection;
+    }
+
+    const Frustum &GetFrustum()
+    {
+        refresh();
+        return frustum;
+    }
+
+    // bumped every time the cached matrices change
+    uint64_t GetVersion()
+    {
+        refresh();
+        return version;
+    }
+
+    // starts the quaternion from the current yaw and pitch, euler mode recalculates
+    // the vectors from yaw and pitch on the next read
+    void setQuaternionMode(bool enabled)
+    {
+        if (enabled && !quaternionMode)
+        {
+            orientation = glm::angleAxis(glm::radians(-(yaw - DEFAULT_YAW)), worldUp) *
+                          glm::angleAxis(glm::radians(pitch), glm::vec3(1.0f, 0.0f, 0.0f));
+            cachedYaw = yaw;
+            cachedPitch = pitch;
+            updateFromOrientation();
+        }
+        else if (!enabled && quaternionMode)
+        {
+            cachedYaw = NAN;
+        }
+        quaternionMode = enabled;
+    }
+
+    // near maps to depth 1 and infinity to 0, for a [0, 1] clip range
+    // (glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE)) with a float depth buffer cleared to 0
+    // and GL_GREATER, which keeps the precision of the float even at large distances.
+    // zFar no longer clips, the frustum keeps only its near plane along the view axis.
+    void setReversedZ(bool enabled)
+    {
+        reversedZ = enabled;
+    }
+
+    void setLens(float aspect, float nearPlane, float farPlane)
     {
-        return glm::lookAt(position, position + front, up);
+        aspectRatio = aspect;
+        zNear = nearPlane;
+        zFar = farPlane;
     }
 
     // processes input received from any keyboard-like input system
@@ -71,6 +176,7 @@ class Camera
     // from windowing systems)
     void processKeyboard(Camera_Movement direction, float deltaTime)
     {
+        refresh();
         float velocity = movementSpeed * deltaTime;
         if (direction == FORWARD)
             position += front * velocity;
@@ -102,8 +208,7 @@ class Camera
                 pitch = -89.0f;
         }
 
-        // update Front, Right and Up Vectors using the updated Euler angles
-        updateCameraVectors();
+        // Front, Right and Up follow the new Euler angles on the next refresh()
     }
 
     // processes input received from a mouse scroll-wheel event. Only requires
@@ -120,20 +225,102 @@ class Camera
     }
 
   private:
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    Frustum frustum;
+    uint64_t version = 0;
+    bool quaternionMode = false;
+    // inputs the caches were last built from, yaw is NAN until the first refresh()
+    glm::vec3 cachedPosition = glm::vec3(0.0f);
+    float cachedYaw = NAN, cachedPitch = 0.0f;
+    float cachedZoom = 0.0f, cachedAspect = 0.0f, cachedNear = 0.0f, cachedFar = 0.0f;
+    bool cachedReversedZ = false;
+
+    float eyeOffset(int eye) const
+    {
+        return (eye == 0 ? -0.5f : 0.5f) * eyeSeparation;
+    }
+
+    // recalculates whatever depends on a changed input, a no-op on a still camera
+    void refresh()
+    {
+        bool rotated = yaw != cachedYaw || pitch != cachedPitch;
+        bool lensChanged = zoom != cachedZoom || aspectRatio != cachedAspect || zNear != cachedNear ||
+                           zFar != cachedFar || reversedZ != cachedReversedZ;
+        if (!rotated && !lensChanged && position == cachedPosition)
+            return;
+
+        if (rotated && quaternionMode)
+            rotate(yaw - cachedYaw, pitch - cachedPitch);
+        else if (rotated)
+            updateCameraVectors();
+        if (lensChanged)
+            projection = reversedZ ? reversedInfinitePerspective(glm::radians(zoom), aspectRatio, zNear)
+                                   : glm::perspective(glm::radians(zoom), aspectRatio, zNear, zFar);
+        view = glm::lookAt(position, position + front, up);
+        viewProjection = projection * view;
+        frustum = Frustum(viewProjection);
+        version++;
+
+        cachedPosition = position;
+        cachedYaw = yaw;
+        cachedPitch = pitch;
+        cachedZoom = zoom;
+        cachedAspect = aspectRatio;
+        cachedNear = zNear;
+        cachedFar = zFar;
+        cachedReversedZ = reversedZ;
+    }
+
+    // clip z = near and clip w = -view z, so depth is near / distance
+    static glm::mat4 reversedInfinitePerspective(float fovy, float aspect, float nearPlane)
+    {
+        float f = 1.0f / tan(fovy * 0.5f);
+        glm::mat4 result(0.0f);
+        result[0][0] = f / aspect;
+        result[1][1] = f;
+        result[2][3] = -1.0f;
+        result[3][2] = nearPlane;
+        return result;
+    }
+
+    // turns around worldUp and then the camera's own x axis, by the angles in degrees
+    void rotate(float yawDelta, float pitchDelta)
+    {
+        orientation = glm::angleAxis(glm::radians(-yawDelta), worldUp) * orientation *
+                      glm::angleAxis(glm::radians(pitchDelta), glm::vec3(1.0f, 0.0f, 0.0f));
+        orientation = glm::normalize(orientation);
+        updateFromOrientation();
+    }
+
+    // the basis is the rotation matrix, already orthonormal
+    void updateFromOrientation()
+    {
+        glm::mat3 rotation = glm::mat3_cast(orientation);
+        right = rotation[0];
+        up = rotation[1];
+        front = -rotation[2];
+    }
+
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors()
     {
         // calculate the new Front vector
+        // sines, cosines and normalizations of CameraMath, exact unless FAST_MATH says otherwise
+        float sinYaw, cosYaw, sinPitch, cosPitch;
+        CameraMath::sinCos(glm::radians(yaw), sinYaw, cosYaw);
+        CameraMath::sinCos(glm::radians(pitch), sinPitch, cosPitch);
         glm::vec3 new_front;
-        new_front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
-        new_front.y = sin(glm::radians(pitch));
-        new_front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
-        front = glm::normalize(new_front);
+        new_front.x = cosYaw * cosPitch;
+        new_front.y = sinPitch;
+        new_front.z = sinYaw * cosPitch;
+        front = CameraMath::normalize(new_front);
         // also re-calculate the Right and Up vector
         // we should normalize the vectors, because their length gets closer to 0
         // the more you look up or down which results in slower movement.
-        right = glm::normalize(glm::cross(front, worldUp));
-        up = glm::normalize(glm::cross(right, front));
+        right = CameraMath::normalize(glm::cross(front, worldUp));
+        up = CameraMath::normalize(glm::cross(right, front));
     }
 };
 
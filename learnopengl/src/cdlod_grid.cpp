@@ -0,0 +1,224 @@
+#ifndef CDLOD_GRID_H
+#define CDLOD_GRID_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "frustum_culler.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "mesh.cpp"
+#include "ring_buffer.cpp"
+#include "shader.cpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// CDLOD (continuous distance-dependent level of detail) over a square, the quadtree and grid
+// the terrain (see terrain.cpp) and the ocean (see ocean.cpp) are drawn with.
+// The square is a quadtree of nodes, LODS levels from the root down to the leaves, and every
+// level has a distance range that doubles with each level up. select() walks the tree from the
+// root: a node outside its level's range is left to its parent, one whose box is outside the
+// next finer range is drawn whole at its level, any other is split into its four children.
+// All selected nodes are the same grid of GRID x GRID quads scaled to the node, one instanced
+// draw of one shared grid mesh with a node (corner, size, level) per instance through the
+// frame's RingBuffer.
+// The vertex shader displaces the grid and over the far end of each range moves the odd
+// vertices onto the next coarser grid (morphRanges and gridSize, see terrain.vs), so
+// neighbouring levels meet without cracks and a node never pops when it changes level. A
+// child the finer range doesn't reach is drawn at the finer level fully morphed, which is the
+// coarser grid.
+// The nodes drawn per level depend only on the ranges, not on the size of the square, so the
+// cost is bounded for any size. There are no height bounds per node, the boxes span the whole
+// height range.
+class CdlodGrid
+{
+  public:
+    static constexpr int LODS = 8;
+    // quads per side of the shared grid
+    static const int GRID = 32;
+    // vertex buffer binding of the per-node stream, the grid is on VertexLayout::BINDING
+    static const unsigned int NODE_BINDING = 1;
+    static const unsigned int NODE_LOCATION = 2;
+
+    // the square is [origin.x, origin.x + size] x [origin.z, origin.z + size], what is drawn
+    // over it spans heights from origin.y to origin.y + height
+    glm::vec3 origin = glm::vec3(-128.0f, -8.0f, -128.0f);
+    float size = 256.0f;
+    float height = 10.0f;
+    // levels in use, at most LODS
+    int levels = 6;
+    // the finest range in leaf sizes, each level above doubles it
+    float leafRanges = 2.0f;
+    // part of each range over which the vertices morph to the coarser grid
+    float morphFraction = 0.3f;
+
+    // nodes of the last select()
+    size_t selected = 0;
+    size_t nodesPerLevel[LODS] = {};
+
+    CdlodGrid(RingBuffer &ring) : ring(ring)
+    {
+        MeshBuilder builder(2);
+        for (int z = 0; z <= GRID; z++)
+        {
+            for (int x = 0; x <= GRID; x++)
+            {
+                builder.vertices.push_back((float)x / GRID);
+                builder.vertices.push_back((float)z / GRID);
+            }
+        }
+        for (int z = 0; z < GRID; z++)
+        {
+            for (int x = 0; x < GRID; x++)
+            {
+                uint32_t corner = (uint32_t)(z * (GRID + 1) + x);
+                builder.indices.insert(builder.indices.end(), {corner, corner + GRID + 1, corner + 1, corner + 1,
+                                                               corner + GRID + 1, corner + GRID + 2});
+            }
+        }
+        builder.endSubmesh();
+        grid = std::make_unique<Mesh>(builder, VertexLayout({{0, 2, VertexFormat::Float}}));
+
+        // the node attribute has no pointer until the first draw uploads the nodes
+        if (hasDSA())
+        {
+            glVertexArrayAttribFormat(grid->VAO, NODE_LOCATION, 4, GL_FLOAT, GL_FALSE, 0);
+            glVertexArrayAttribBinding(grid->VAO, NODE_LOCATION, NODE_BINDING);
+            glEnableVertexArrayAttrib(grid->VAO, NODE_LOCATION);
+            glVertexArrayBindingDivisor(grid->VAO, NODE_BINDING, 1);
+        }
+        else
+        {
+            glState.bindVertexArray(grid->VAO);
+            glEnableVertexAttribArray(NODE_LOCATION);
+            glVertexAttribDivisor(NODE_LOCATION, 1);
+        }
+    }
+
+    CdlodGrid(const CdlodGrid &) = delete;
+    CdlodGrid &operator=(const CdlodGrid &) = delete;
+
+    // the gridSize of a program over a CDLOD vertex shader, once
+    static void setup(Shader &program)
+    {
+        program.use();
+        program.set(program.uniform("gridSize"), (float)GRID);
+    }
+
+    // the nodes to draw from camera, the ones outside frustum are skipped
+    void select(const glm::vec3 &camera, const Frustum &frustum)
+    {
+        levels = std::max(1, std::min(levels, LODS));
+        float leaf = size / (float)(1 << (levels - 1));
+        for (int level = 0; level < levels; level++)
+            ranges[level] = leaf * leafRanges * (float)(1 << level);
+        nodes.clear();
+        nodesOffset = -1;
+        std::fill(nodesPerLevel, nodesPerLevel + LODS, 0);
+        // the root is drawn however far away the camera is
+        if (!selectNode(glm::vec2(origin.x, origin.z), size, levels - 1, camera, frustum))
+            add(glm::vec2(origin.x, origin.z), size, levels - 1, frustum);
+        selected = nodes.size();
+    }
+
+    // every selected node in one instanced draw of program, which is in use with the rest of
+    // its uniforms set; morphRanges is its uniform of that name
+    void draw(const Shader &program, UniformHandle morphRanges)
+    {
+        if (nodes.empty())
+            return;
+        if (nodesOffset < 0)
+        {
+            nodesOffset = ring.push(nodes.data(), nodes.size() * sizeof(glm::vec4));
+            if (nodesOffset < 0)
+                return;
+            if (hasDSA())
+            {
+                glVertexArrayVertexBuffer(grid->VAO, NODE_BINDING, ring.ID, nodesOffset, sizeof(glm::vec4));
+            }
+            else
+            {
+                glState.bindVertexArray(grid->VAO);
+                glBindBuffer(GL_ARRAY_BUFFER, ring.ID);
+                glVertexAttribPointer(NODE_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *)nodesOffset);
+            }
+        }
+
+        // per level where the morph starts and 1 / its length
+        glm::vec2 morph[LODS];
+        for (int level = 0; level < levels; level++)
+        {
+            float previous = level > 0 ? ranges[level - 1] : 0.0f;
+            float length = std::max((ranges[level] - previous) * morphFraction, 1e-3f);
+            morph[level] = glm::vec2(ranges[level] - length, 1.0f / length);
+        }
+        program.set(morphRanges, morph, levels);
+        grid->bind();
+        grid->drawInstanced((GLsizei)nodes.size());
+    }
+
+  private:
+    RingBuffer &ring;
+    std::unique_ptr<Mesh> grid;
+    float ranges[LODS] = {};
+    // xy corner, z size, w level
+    std::vector<glm::vec4> nodes;
+    // where the draws of this selection read the nodes in the ring, -1 until the first one
+    GLintptr nodesOffset = -1;
+
+    // squared distance from point to the node's box
+    float distanceSquared(const glm::vec3 &point, glm::vec2 corner, float nodeSize) const
+    {
+        glm::vec3 low(corner.x, origin.y, corner.y), high(corner.x + nodeSize, origin.y + height, corner.y + nodeSize);
+        glm::vec3 outside = glm::max(glm::max(low - point, point - high), glm::vec3(0.0f));
+        return glm::dot(outside, outside);
+    }
+
+    bool inFrustum(glm::vec2 corner, float nodeSize, const Frustum &frustum) const
+    {
+        glm::vec3 extent(nodeSize * 0.5f, height * 0.5f, nodeSize * 0.5f);
+        glm::vec3 center = glm::vec3(corner.x, origin.y, corner.y) + extent;
+        for (const glm::vec4 &plane : frustum.planes)
+        {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -glm::dot(glm::abs(glm::vec3(plane)), extent))
+                return false;
+        }
+        return true;
+    }
+
+    void add(glm::vec2 corner, float nodeSize, int level, const Frustum &frustum)
+    {
+        if (!inFrustum(corner, nodeSize, frustum))
+            return;
+        nodes.push_back(glm::vec4(corner, nodeSize, (float)level));
+        nodesPerLevel[level]++;
+    }
+
+    // false when the node is out of its level's range and its parent has to cover it
+    bool selectNode(glm::vec2 corner, float nodeSize, int level, const glm::vec3 &camera, const Frustum &frustum)
+    {
+        if (distanceSquared(camera, corner, nodeSize) > ranges[level] * ranges[level])
+            return false;
+        if (!inFrustum(corner, nodeSize, frustum))
+            return true;
+        if (level == 0 || distanceSquared(camera, corner, nodeSize) > ranges[level - 1] * ranges[level - 1])
+        {
+            add(corner, nodeSize, level, frustum);
+            return true;
+        }
+        float half = nodeSize * 0.5f;
+        for (int child = 0; child < 4; child++)
+        {
+            glm::vec2 childCorner = corner + glm::vec2((child & 1) * half, (child >> 1) * half);
+            // out of the finer range it morphs all the way, which is this level's grid
+            if (!selectNode(childCorner, half, level - 1, camera, frustum))
+                add(childCorner, half, level - 1, frustum);
+        }
+        return true;
+    }
+};
+
+#endif
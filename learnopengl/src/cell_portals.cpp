@@ -0,0 +1,356 @@
+#ifndef CELL_PORTALS_H
+#define CELL_PORTALS_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "asset_pack.cpp"
+#include "frustum_culler.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Cell and portal visibility for indoor levels. A cells file lists boxes and the quads that
+// join them, one per line ('#' starts a comment):
+//     cell minX minY minZ maxX maxY maxZ
+//     portal cellA cellB x0 y0 z0 x1 y1 z1 x2 y2 z2 x3 y3 z3
+// update() finds the camera's cell and walks out through the portals, each one's screen
+// rectangle clipped to the one it was seen through, so a cell is visible only if some chain
+// of portals lines up toward the camera. The walk stays inside the camera cell's row of the
+// potentially visible set when the level has one: bakePVS() walks from points spread over
+// every cell looking along the six axes, and writePVS() stores the rows next to the cells
+// file, where --pack picks them up. Objects belong to every cell their sphere's box touches;
+// the ones in no cell are always drawn.
+class CellPortals
+{
+  public:
+    struct Cell
+    {
+        glm::vec3 low, high;
+        std::vector<uint32_t> portals;
+        // filled by assign()
+        std::vector<uint32_t> objects;
+    };
+
+    struct Portal
+    {
+        uint32_t cells[2];
+        glm::vec3 corners[4];
+    };
+
+    // the longest chain of portals followed
+    static const int MAX_DEPTH = 16;
+    // sample points per cell side and the field of view of the bake
+    static const int PVS_SAMPLES = 3;
+    static constexpr float PVS_FOV = 100.0f;
+
+    std::vector<Cell> cells;
+    std::vector<Portal> portals;
+    // objects outside of every cell
+    std::vector<uint32_t> outside;
+    // one row of cells.size() flags per cell, empty without a baked set
+    std::vector<uint8_t> pvs;
+    // output of update(), a flag per cell
+    std::vector<uint8_t> visible;
+    int cameraCell = -1;
+    size_t visibleCells = 0;
+
+    // the file and its .pvs when there is one, false on a malformed file
+    bool load(const std::string &path)
+    {
+        if (!parse(path))
+            return false;
+        std::vector<unsigned char> bytes;
+        if (readAsset(pvsPath(path), bytes) && !readPVS(bytes))
+        {
+            std::cout << "ERROR::CELL_PORTALS::STALE_PVS: " << pvsPath(path) << '\n';
+            pvs.clear();
+        }
+        return true;
+    }
+
+    static std::string pvsPath(const std::string &path)
+    {
+        size_t dot = path.find_last_of('.');
+        size_t slash = path.find_last_of("/\\");
+        return (dot == std::string::npos || (slash != std::string::npos && dot < slash) ? path : path.substr(0, dot)) +
+               ".pvs";
+    }
+
+    // the first cell containing point, -1 outside of all
+    int findCell(const glm::vec3 &point) const
+    {
+        for (size_t c = 0; c < cells.size(); c++)
+        {
+            const Cell &cell = cells[c];
+            if (glm::all(glm::greaterThanEqual(point, cell.low)) && glm::all(glm::lessThanEqual(point, cell.high)))
+                return (int)c;
+        }
+        return -1;
+    }
+
+    // every sphere of culler into the cells its box overlaps, or outside
+    void assign(const FrustumCuller &culler)
+    {
+        for (Cell &cell : cells)
+            cell.objects.clear();
+        outside.clear();
+        for (size_t i = 0; i < culler.size(); i++)
+        {
+            glm::vec3 center(culler.centerX[i], culler.centerY[i], culler.centerZ[i]);
+            glm::vec3 low = center - culler.radius[i], high = center + culler.radius[i];
+            bool placed = false;
+            for (Cell &cell : cells)
+                if (glm::all(glm::lessThanEqual(low, cell.high)) && glm::all(glm::greaterThanEqual(high, cell.low)))
+                {
+                    cell.objects.push_back((uint32_t)i);
+                    placed = true;
+                }
+            if (!placed)
+                outside.push_back((uint32_t)i);
+        }
+    }
+
+    // the cells seen from eye through viewProjection, false when eye is in none of them
+    bool update(const glm::mat4 &viewProjection, const glm::vec3 &eye)
+    {
+        visible.assign(cells.size(), 0);
+        visibleCells = 0;
+        cameraCell = findCell(eye);
+        if (cameraCell < 0)
+            return false;
+        onPath.assign(cells.size(), 0);
+        const uint8_t *row = pvs.empty() ? nullptr : &pvs[cameraCell * cells.size()];
+        walk((uint32_t)cameraCell, Rect{-1.0f, -1.0f, 1.0f, 1.0f}, 0, viewProjection, row);
+        for (uint8_t flag : visible)
+            visibleCells += flag;
+        return true;
+    }
+
+    // the objects of the visible cells that touch frustum and the ones outside every cell,
+    // ascending and each once
+    void cull(const FrustumCuller &culler, const Frustum &frustum, std::vector<uint32_t> &out, size_t &tested) const
+    {
+        out.clear();
+        tested = 0;
+        auto test = [&](const std::vector<uint32_t> &objects) {
+            tested += objects.size();
+            for (uint32_t i : objects)
+            {
+                glm::vec3 center(culler.centerX[i], culler.centerY[i], culler.centerZ[i]);
+                bool inside = true;
+                for (int p = 0; p < 6 && inside; p++)
+                    inside = glm::dot(glm::vec3(frustum.planes[p]), center) + frustum.planes[p].w >= -culler.radius[i];
+                if (inside)
+                    out.push_back(i);
+            }
+        };
+        for (size_t c = 0; c < cells.size(); c++)
+            if (visible[c])
+                test(cells[c].objects);
+        test(outside);
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+
+    // the potentially visible set from sample points in every cell, the offline part
+    void bakePVS()
+    {
+        const size_t count = cells.size();
+        std::vector<uint8_t> rows(count * count, 0);
+        pvs.clear();
+        const glm::vec3 axes[6] = {glm::vec3(1, 0, 0),  glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+                                   glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),  glm::vec3(0, 0, -1)};
+        glm::mat4 projection = glm::perspective(glm::radians(PVS_FOV), 1.0f, 0.01f, 1000.0f);
+        for (size_t c = 0; c < count; c++)
+        {
+            const Cell &cell = cells[c];
+            for (int s = 0; s < PVS_SAMPLES * PVS_SAMPLES * PVS_SAMPLES; s++)
+            {
+                glm::vec3 t(s % PVS_SAMPLES, s / PVS_SAMPLES % PVS_SAMPLES, s / (PVS_SAMPLES * PVS_SAMPLES));
+                t = (t + 0.5f) / (float)PVS_SAMPLES;
+                glm::vec3 eye = glm::mix(cell.low, cell.high, t);
+                for (const glm::vec3 &axis : axes)
+                {
+                    glm::vec3 up = std::abs(axis.y) > 0.5f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+                    visible.assign(count, 0);
+                    onPath.assign(count, 0);
+                    walk((uint32_t)c, Rect{-1.0f, -1.0f, 1.0f, 1.0f}, 0, projection * glm::lookAt(eye, eye + axis, up),
+                         nullptr);
+                    for (size_t other = 0; other < count; other++)
+                        rows[c * count + other] |= visible[other];
+                }
+            }
+            rows[c * count + c] = 1;
+        }
+        pvs.swap(rows);
+        visible.assign(count, 0);
+    }
+
+    bool writePVS(const std::string &path) const
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cout << "ERROR::CELL_PORTALS::COULD_NOT_WRITE: " << path << '\n';
+            return false;
+        }
+        PVSHeader header = {PVS_MAGIC, PVS_VERSION, (uint32_t)cells.size(), (uint32_t)portals.size()};
+        out.write((const char *)&header, sizeof(header));
+        out.write((const char *)pvs.data(), pvs.size());
+        return (bool)out;
+    }
+
+  private:
+    static const uint32_t PVS_MAGIC = 0x31535650u; // "PVS1"
+    static const uint32_t PVS_VERSION = 1u;
+
+    struct PVSHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        // of the cells file it was baked from, a mismatch means it is out of date
+        uint32_t cellCount;
+        uint32_t portalCount;
+    };
+
+    // normalized device coordinates
+    struct Rect
+    {
+        float minX, minY, maxX, maxY;
+    };
+
+    std::vector<uint8_t> onPath;
+
+    bool parse(const std::string &path)
+    {
+        cells.clear();
+        portals.clear();
+        pvs.clear();
+        std::string text;
+        if (!readAsset(path, text))
+        {
+            std::cout << "ERROR::CELL_PORTALS::FAILED_TO_LOAD: " << path << '\n';
+            return false;
+        }
+        std::istringstream lines(text);
+        std::string line;
+        for (int number = 1; std::getline(lines, line); number++)
+        {
+            std::istringstream words(line.substr(0, line.find('#')));
+            std::string kind;
+            if (!(words >> kind))
+                continue;
+            bool valid = false;
+            if (kind == "cell")
+            {
+                Cell cell;
+                valid = (bool)(words >> cell.low.x >> cell.low.y >> cell.low.z >> cell.high.x >> cell.high.y >>
+                               cell.high.z);
+                cells.push_back(cell);
+            }
+            else if (kind == "portal")
+            {
+                Portal portal;
+                valid = (bool)(words >> portal.cells[0] >> portal.cells[1]);
+                for (glm::vec3 &corner : portal.corners)
+                    valid = valid && (words >> corner.x >> corner.y >> corner.z);
+                portals.push_back(portal);
+            }
+            if (!valid)
+            {
+                std::cout << "ERROR::CELL_PORTALS::BAD_LINE: " << path << ':' << number << '\n';
+                return false;
+            }
+        }
+        for (size_t p = 0; p < portals.size(); p++)
+        {
+            const Portal &portal = portals[p];
+            if (portal.cells[0] >= cells.size() || portal.cells[1] >= cells.size())
+            {
+                std::cout << "ERROR::CELL_PORTALS::BAD_PORTAL: " << path << " portal " << p << '\n';
+                return false;
+            }
+            cells[portal.cells[0]].portals.push_back((uint32_t)p);
+            cells[portal.cells[1]].portals.push_back((uint32_t)p);
+        }
+        visible.assign(cells.size(), 0);
+        return true;
+    }
+
+    bool readPVS(const std::vector<unsigned char> &bytes)
+    {
+        PVSHeader header;
+        if (bytes.size() < sizeof(header))
+            return false;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        size_t size = cells.size() * cells.size();
+        if (header.magic != PVS_MAGIC || header.version != PVS_VERSION || header.cellCount != cells.size() ||
+            header.portalCount != portals.size() || bytes.size() != sizeof(header) + size)
+            return false;
+        pvs.assign(bytes.begin() + sizeof(header), bytes.end());
+        return true;
+    }
+
+    // the screen box of the part of the portal in front of the near plane, false when none is
+    static bool project(const Portal &portal, const glm::mat4 &viewProjection, Rect &rect)
+    {
+        const float nearest = 1e-5f;
+        glm::vec4 clip[4];
+        for (int c = 0; c < 4; c++)
+            clip[c] = viewProjection * glm::vec4(portal.corners[c], 1.0f);
+        rect = Rect{1e30f, 1e30f, -1e30f, -1e30f};
+        bool any = false;
+        auto add = [&](const glm::vec4 &point) {
+            rect.minX = std::min(rect.minX, point.x / point.w);
+            rect.minY = std::min(rect.minY, point.y / point.w);
+            rect.maxX = std::max(rect.maxX, point.x / point.w);
+            rect.maxY = std::max(rect.maxY, point.y / point.w);
+            any = true;
+        };
+        // the corners in front and where the edges cross w = nearest
+        for (int c = 0; c < 4; c++)
+        {
+            const glm::vec4 &from = clip[c], &to = clip[(c + 1) % 4];
+            if (from.w > nearest)
+                add(from);
+            if ((from.w > nearest) != (to.w > nearest))
+                add(glm::mix(from, to, (nearest - from.w) / (to.w - from.w)));
+        }
+        return any;
+    }
+
+    void walk(uint32_t cell, const Rect &rect, int depth, const glm::mat4 &viewProjection, const uint8_t *row)
+    {
+        visible[cell] = 1;
+        if (depth == MAX_DEPTH)
+            return;
+        onPath[cell] = 1;
+        for (uint32_t p : cells[cell].portals)
+        {
+            const Portal &portal = portals[p];
+            uint32_t other = portal.cells[0] == cell ? portal.cells[1] : portal.cells[0];
+            if (onPath[other] || (row && !row[other]))
+                continue;
+            Rect seen;
+            if (!project(portal, viewProjection, seen))
+                continue;
+            seen.minX = std::max(seen.minX, rect.minX);
+            seen.minY = std::max(seen.minY, rect.minY);
+            seen.maxX = std::min(seen.maxX, rect.maxX);
+            seen.maxY = std::min(seen.maxY, rect.maxY);
+            if (seen.minX < seen.maxX && seen.minY < seen.maxY)
+                walk(other, seen, depth + 1, viewProjection, row);
+        }
+        onPath[cell] = 0;
+    }
+};
+
+#endif
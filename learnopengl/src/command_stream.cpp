@@ -0,0 +1,249 @@
+#ifndef COMMAND_STREAM_H
+#define COMMAND_STREAM_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include "gl_state.cpp"
+#include "pipeline_state.cpp"
+#include "render_stats.cpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// GL work recorded by one thread and replayed on the thread that owns the context.
+// Commands are packed back to back in a linear arena, each a small header followed by its
+// arguments, so recording is a few stores and reset() keeps the memory for the next frame.
+// Anything without a command of its own goes through call(), a function run at replay
+// with a copy of its payload.
+// Recording makes no GL calls, so any thread can fill a stream: jobs record secondary
+// streams side by side and the primary one runs them in order with execute().
+class CommandStream
+{
+  public:
+    // payload is the copy made at record time, context is passed through as is
+    typedef void (*CallFunction)(void *context, const void *payload);
+
+    void reset()
+    {
+        arena.clear();
+        count = 0;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    size_t bytes() const
+    {
+        return arena.size();
+    }
+
+    // the state and the table are referenced, not copied
+    void bindPipeline(const PipelineState &state)
+    {
+        push<PointerCommand>(CMD_BIND_PIPELINE).pointer = &state;
+    }
+
+    void bindTable(const BindingTable &table)
+    {
+        push<PointerCommand>(CMD_BIND_TABLE).pointer = &table;
+    }
+
+    // replays another stream at this point, it has to stay untouched until this one has been replayed
+    void execute(const CommandStream &secondary)
+    {
+        push<PointerCommand>(CMD_EXECUTE).pointer = &secondary;
+    }
+
+    void useProgram(unsigned int program)
+    {
+        push<IdCommand>(CMD_USE_PROGRAM).id = program;
+    }
+
+    void bindVertexArray(unsigned int vertexArray)
+    {
+        push<IdCommand>(CMD_BIND_VERTEX_ARRAY).id = vertexArray;
+    }
+
+    void bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+    {
+        TextureCommand &command = push<TextureCommand>(CMD_BIND_TEXTURE);
+        command.unit = unit;
+        command.target = target;
+        command.texture = texture;
+    }
+
+    void uniform(int location, int value)
+    {
+        IntCommand &command = push<IntCommand>(CMD_UNIFORM_INT);
+        command.location = location;
+        command.value = value;
+    }
+
+    void uniform(int location, const glm::mat4 &value)
+    {
+        MatrixCommand &command = push<MatrixCommand>(CMD_UNIFORM_MAT4);
+        command.location = location;
+        command.value = value;
+    }
+
+    void drawElements(GLenum mode, GLsizei indexCount, GLenum indexType)
+    {
+        DrawCommand &command = push<DrawCommand>(CMD_DRAW_ELEMENTS);
+        command.mode = mode;
+        command.indexCount = indexCount;
+        command.indexType = indexType;
+    }
+
+    void call(CallFunction function, void *context, const void *payload = NULL, size_t payloadBytes = 0)
+    {
+        CallCommand &command = push<CallCommand>(CMD_CALL, PAYLOAD_OFFSET - sizeof(CallCommand) + payloadBytes);
+        command.function = function;
+        command.context = context;
+        if (payloadBytes)
+            std::memcpy((unsigned char *)&command + PAYLOAD_OFFSET, payload, payloadBytes);
+    }
+
+    // runs every command in recording order, on the context thread
+    void replay() const
+    {
+        size_t offset = 0;
+        while (offset < arena.size())
+        {
+            const Header *header = (const Header *)&arena[offset];
+            switch (header->type)
+            {
+            case CMD_BIND_PIPELINE:
+                applyPipelineState(*(const PipelineState *)((const PointerCommand *)header)->pointer);
+                break;
+            case CMD_BIND_TABLE:
+                applyBindingTable(*(const BindingTable *)((const PointerCommand *)header)->pointer);
+                break;
+            case CMD_EXECUTE:
+                ((const CommandStream *)((const PointerCommand *)header)->pointer)->replay();
+                break;
+            case CMD_USE_PROGRAM:
+                glState.useProgram(((const IdCommand *)header)->id);
+                break;
+            case CMD_BIND_VERTEX_ARRAY:
+                glState.bindVertexArray(((const IdCommand *)header)->id);
+                break;
+            case CMD_BIND_TEXTURE: {
+                const TextureCommand *command = (const TextureCommand *)header;
+                glState.bindTexture(command->unit, command->target, command->texture);
+                break;
+            }
+            case CMD_UNIFORM_INT: {
+                const IntCommand *command = (const IntCommand *)header;
+                renderStats.uniformUploads++;
+                glState.uniformGeneration++;
+                glUniform1i(command->location, command->value);
+                break;
+            }
+            case CMD_UNIFORM_MAT4: {
+                const MatrixCommand *command = (const MatrixCommand *)header;
+                renderStats.uniformUploads++;
+                glState.uniformGeneration++;
+                glUniformMatrix4fv(command->location, 1, GL_FALSE, glm::value_ptr(command->value));
+                break;
+            }
+            case CMD_DRAW_ELEMENTS: {
+                const DrawCommand *command = (const DrawCommand *)header;
+                renderStats.countDraw(command->indexCount);
+                glDrawElements(command->mode, command->indexCount, command->indexType, (void *)0);
+                break;
+            }
+            case CMD_CALL: {
+                const CallCommand *command = (const CallCommand *)header;
+                command->function(command->context, (const unsigned char *)command + PAYLOAD_OFFSET);
+                break;
+            }
+            }
+            offset += header->size;
+        }
+    }
+
+  private:
+    enum CommandType : uint32_t
+    {
+        CMD_BIND_PIPELINE,
+        CMD_BIND_TABLE,
+        CMD_EXECUTE,
+        CMD_USE_PROGRAM,
+        CMD_BIND_VERTEX_ARRAY,
+        CMD_BIND_TEXTURE,
+        CMD_UNIFORM_INT,
+        CMD_UNIFORM_MAT4,
+        CMD_DRAW_ELEMENTS,
+        CMD_CALL
+    };
+
+    // every command starts with one, size includes the header and any payload
+    struct Header
+    {
+        uint32_t type;
+        uint32_t size;
+    };
+    struct PointerCommand : Header
+    {
+        const void *pointer;
+    };
+    struct IdCommand : Header
+    {
+        unsigned int id;
+    };
+    struct TextureCommand : Header
+    {
+        unsigned int unit;
+        GLenum target;
+        unsigned int texture;
+    };
+    struct IntCommand : Header
+    {
+        int location;
+        int value;
+    };
+    struct MatrixCommand : Header
+    {
+        int location;
+        glm::mat4 value;
+    };
+    struct DrawCommand : Header
+    {
+        GLenum mode;
+        GLsizei indexCount;
+        GLenum indexType;
+    };
+    struct CallCommand : Header
+    {
+        CallFunction function;
+        void *context;
+    };
+
+    // commands stay 16 byte aligned, enough for the matrices and the call payloads
+    static const size_t ALIGNMENT = 16;
+    // call payloads start aligned after their command
+    static const size_t PAYLOAD_OFFSET = (sizeof(CallCommand) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+    std::vector<unsigned char> arena;
+    size_t count = 0;
+
+    template <typename T> T &push(CommandType type, size_t extraBytes = 0)
+    {
+        size_t size = (sizeof(T) + extraBytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        size_t offset = arena.size();
+        arena.resize(offset + size);
+        T *command = (T *)&arena[offset];
+        command->type = type;
+        command->size = (uint32_t)size;
+        count++;
+        return *command;
+    }
+};
+
+#endif
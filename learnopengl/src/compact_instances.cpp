@@ -0,0 +1,199 @@
+#ifndef COMPACT_INSTANCES_H
+#define COMPACT_INSTANCES_H
+
+#include "glad/glad.h"
+
+#include "batch_math.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "instance_buffer.cpp"
+#include "ring_buffer.cpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// The CompactTransform of every object in one buffer that lives as long as the objects, read
+// by the SHADER_COMPACT vertex variant through a GL_RG32UI buffer texture, 3 texels a record.
+// update() compares the records with what the buffer holds and sends the runs that changed
+// through the frame's RingBuffer, copied into place on the GPU: static objects cost nothing
+// after the first frame. A draw then only streams one uint index per instance, the one of its
+// object's record, instead of a mat4 and a layer.
+class CompactInstances
+{
+  public:
+    // the instance index attribute, where the instanced layer is
+    static const unsigned int INDEX_LOCATION = 6;
+    static const unsigned int TEXTURE_UNIT = 11;
+    // clean records between two changed ones below this are sent along, one copy instead of two
+    static const size_t MERGE_GAP = 32;
+
+    unsigned int buffer = 0;
+    unsigned int texture = 0;
+    size_t records = 0;
+    // indices uploaded last
+    size_t count = 0;
+    // bytes and copies of the last update()
+    size_t updatedBytes = 0;
+    size_t copies = 0;
+
+    CompactInstances(RingBuffer &ring) : ring(ring)
+    {
+    }
+
+    ~CompactInstances()
+    {
+        if (texture)
+            glDeleteTextures(1, &texture);
+        if (buffer)
+            deleteBuffers(1, &buffer);
+    }
+
+    CompactInstances(const CompactInstances &) = delete;
+    CompactInstances &operator=(const CompactInstances &) = delete;
+
+    // room for objects records, the first update() sends all of them
+    bool create(size_t objects)
+    {
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        if (objects == 0 || objects * TEXELS > (size_t)maxTexels)
+        {
+            std::cout << "ERROR::COMPACT_INSTANCES::TOO_MANY_OBJECTS " << objects << "\n";
+            return false;
+        }
+        records = objects;
+        buffer = createBuffer(objects * sizeof(CompactTransform), NULL, GL_DYNAMIC_STORAGE_BIT);
+        if (hasDSA())
+        {
+            glCreateTextures(GL_TEXTURE_BUFFER, 1, &texture);
+            glTextureBuffer(texture, GL_RG32UI, buffer);
+        }
+        else
+        {
+            glGenTextures(1, &texture);
+            glState.bindTexture(TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, buffer);
+        }
+        // all bits set is not a record the encoder writes, everything differs the first time
+        uploaded.assign(objects, CompactTransform{});
+        std::memset(uploaded.data(), 0xFF, objects * sizeof(CompactTransform));
+        return true;
+    }
+
+    // the index attribute on vao, the instance stream binding of InstanceBuffer
+    void attach(unsigned int vertexArray)
+    {
+        vao = vertexArray;
+        if (hasDSA())
+        {
+            glVertexArrayAttribIFormat(vao, INDEX_LOCATION, 1, GL_UNSIGNED_INT, 0);
+            glVertexArrayAttribBinding(vao, INDEX_LOCATION, InstanceBuffer::MODEL_BINDING);
+            glEnableVertexArrayAttrib(vao, INDEX_LOCATION);
+            glVertexArrayBindingDivisor(vao, InstanceBuffer::MODEL_BINDING, 1);
+            return;
+        }
+        glState.bindVertexArray(vao);
+        glEnableVertexAttribArray(INDEX_LOCATION);
+        glVertexAttribDivisor(INDEX_LOCATION, 1);
+    }
+
+    // brings the buffer up to date with current, one record per object
+    void update(const CompactTransform *current)
+    {
+        updatedBytes = 0;
+        copies = 0;
+        runs.clear();
+        for (size_t i = 0; i < records;)
+        {
+            if (std::memcmp(&current[i], &uploaded[i], sizeof(CompactTransform)) == 0)
+            {
+                i++;
+                continue;
+            }
+            size_t first = i, last = i + 1, clean = 0;
+            for (size_t j = last; j < records && clean < MERGE_GAP; j++)
+            {
+                if (std::memcmp(&current[j], &uploaded[j], sizeof(CompactTransform)) == 0)
+                {
+                    clean++;
+                    continue;
+                }
+                last = j + 1;
+                clean = 0;
+            }
+            runs.push_back({first, last});
+            i = last;
+        }
+        if (runs.empty())
+            return;
+
+        // every run back to back in one push, then copied to where it belongs
+        staging.clear();
+        for (const Run &run : runs)
+        {
+            staging.insert(staging.end(), current + run.first, current + run.last);
+            std::memcpy(&uploaded[run.first], &current[run.first], (run.last - run.first) * sizeof(CompactTransform));
+        }
+        size_t bytes = staging.size() * sizeof(CompactTransform);
+        GLintptr offset = ring.push(staging.data(), bytes, sizeof(CompactTransform));
+        if (offset < 0)
+        {
+            // sent again next time
+            std::memset(uploaded.data(), 0xFF, records * sizeof(CompactTransform));
+            return;
+        }
+        size_t written = 0;
+        for (const Run &run : runs)
+        {
+            size_t runBytes = (run.last - run.first) * sizeof(CompactTransform);
+            copyBuffer(ring.ID, buffer, (size_t)offset + written, run.first * sizeof(CompactTransform), runBytes);
+            written += runBytes;
+        }
+        updatedBytes = bytes;
+        copies = runs.size();
+    }
+
+    // the records of the next draw's instances, in order
+    void upload(const uint32_t *indices, size_t indexCount)
+    {
+        GLintptr offset = ring.push(indices, indexCount * sizeof(uint32_t), sizeof(uint32_t));
+        count = offset < 0 ? 0 : indexCount;
+        if (offset < 0)
+            return;
+        if (hasDSA())
+        {
+            glVertexArrayVertexBuffer(vao, InstanceBuffer::MODEL_BINDING, ring.ID, offset, sizeof(uint32_t));
+            return;
+        }
+        glState.bindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, ring.ID);
+        glVertexAttribIPointer(INDEX_LOCATION, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void *)offset);
+    }
+
+    // the records for the vertex stage, its compactTransforms sampler is on TEXTURE_UNIT
+    void bind() const
+    {
+        glState.bindTexture(TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+    }
+
+  private:
+    // RG32UI texels per record
+    static const size_t TEXELS = sizeof(CompactTransform) / 8;
+
+    struct Run
+    {
+        size_t first, last;
+    };
+
+    RingBuffer &ring;
+    unsigned int vao = 0;
+    // what the buffer holds
+    std::vector<CompactTransform> uploaded;
+    std::vector<Run> runs;
+    std::vector<CompactTransform> staging;
+};
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+// CPU_PROFILER 0 compiles every PROFILE_ZONE away, TRACY_ENABLE hands the zones to Tracy
+// instead (its client has to be on the include path, it isn't part of deps)
+#ifndef CPU_PROFILER
+#define CPU_PROFILER 1
+#endif
+
+#if defined(TRACY_ENABLE)
+#include "tracy/Tracy.hpp"
+#define PROFILE_ZONE(name) ZoneScopedN(name)
+#elif CPU_PROFILER
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+// times the rest of the enclosing scope, name must be a string literal
+#define PROFILE_ZONE(name) CpuZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPU_PROFILER_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CPU_PROFILER_RDTSC 1
+#else
+#define CPU_PROFILER_RDTSC 0
+#endif
+
+struct CpuZoneEvent
+{
+    const char *name;
+    uint64_t start, end;
+};
+
+// Scoped CPU zones in a fixed ring of events per thread. A thread only ever writes its
+// own ring and publishes each event by bumping an atomic count, so recording takes no
+// lock, the registry mutex is only taken once per thread. Timestamps are raw TSC ticks
+// (steady_clock where there is no rdtsc), converted to microseconds when written out.
+// Once a ring is full the oldest events are overwritten.
+class CpuProfiler
+{
+  public:
+    static const size_t EVENTS_PER_THREAD = 1 << 16;
+
+    struct ThreadEvents
+    {
+        uint32_t id;
+        std::vector<CpuZoneEvent> events;
+        std::atomic<uint64_t> count{0};
+    };
+
+    static CpuProfiler &instance()
+    {
+        static CpuProfiler profiler;
+        return profiler;
+    }
+
+    static uint64_t now()
+    {
+#if CPU_PROFILER_RDTSC
+        return __rdtsc();
+#else
+        return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    // TSC rate from the ticks and the steady_clock time passed since construction
+    double calibrate() const
+    {
+#if CPU_PROFILER_RDTSC
+        double microseconds =
+            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - originTime).count();
+        uint64_t ticks = now() - origin;
+        return microseconds > 0.0 ? (double)ticks / microseconds : 1.0;
+#else
+        return (double)std::chrono::steady_clock::period::den / std::chrono::steady_clock::period::num * 1e-6;
+#endif
+    }
+
+    void record(const char *name, uint64_t start, uint64_t end)
+    {
+        ThreadEvents &thread = threadEvents();
+        uint64_t index = thread.count.load(std::memory_order_relaxed);
+        thread.events[index % EVENTS_PER_THREAD] = {name, start, end};
+        thread.count.store(index + 1, std::memory_order_release);
+    }
+
+    // chrome://tracing / Perfetto "trace_event" JSON of everything still in the rings,
+    // best written while the other threads are idle
+    bool writeChromeTrace(const std::string &path)
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cout << "ERROR::CPU_PROFILER::CANNOT_WRITE: " << path << '\n';
+            return false;
+        }
+        out.precision(3);
+        out << std::fixed << "{\"traceEvents\":[";
+        bool first = true;
+        writeChromeEvents(out, calibrate(), 0, first);
+        out << "\n]}\n";
+        return true;
+    }
+
+    // the events in the rings that ended at or after since as trace_event objects, each
+    // after a comma unless first; events overwritten while this reads them may come out torn
+    void writeChromeEvents(std::ostream &out, double ticksPerMicrosecond, uint64_t since, bool &first)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::unique_ptr<ThreadEvents> &thread : threads)
+        {
+            uint64_t count = thread->count.load(std::memory_order_acquire);
+            uint64_t begin = count > EVENTS_PER_THREAD ? count - EVENTS_PER_THREAD : 0;
+            for (uint64_t i = begin; i < count; i++)
+            {
+                const CpuZoneEvent &event = thread->events[i % EVENTS_PER_THREAD];
+                if (event.end < since)
+                    continue;
+                out << (first ? "" : ",") << "\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                    << thread->id << ",\"ts\":" << microseconds(event.start, ticksPerMicrosecond)
+                    << ",\"dur\":" << (double)(event.end - event.start) / ticksPerMicrosecond << "}";
+                first = false;
+            }
+        }
+    }
+
+    // calls visit(const ThreadEvents &) for the ring of every thread, under the registry lock
+    template <typename Visit> void visitThreads(Visit visit)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::unique_ptr<ThreadEvents> &thread : threads)
+            visit((const ThreadEvents &)*thread);
+    }
+
+    // a timestamp from now() as trace time
+    double microseconds(uint64_t ticks, double ticksPerMicrosecond) const
+    {
+        return (double)(int64_t)(ticks - origin) / ticksPerMicrosecond;
+    }
+
+  private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadEvents>> threads;
+    uint64_t origin;
+    std::chrono::steady_clock::time_point originTime;
+
+    CpuProfiler() : origin(now()), originTime(std::chrono::steady_clock::now())
+    {
+    }
+
+    ThreadEvents &threadEvents()
+    {
+        thread_local ThreadEvents *events = NULL;
+        if (!events)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.push_back(std::make_unique<ThreadEvents>());
+            events = threads.back().get();
+            events->id = (uint32_t)threads.size() - 1;
+            events->events.resize(EVENTS_PER_THREAD);
+        }
+        return *events;
+    }
+};
+
+// records the time between construction and destruction
+class CpuZone
+{
+  public:
+    // the profiler is created first so its origin is never after the start
+    explicit CpuZone(const char *name) : profiler(CpuProfiler::instance()), name(name), start(CpuProfiler::now())
+    {
+    }
+
+    ~CpuZone()
+    {
+        profiler.record(name, start, CpuProfiler::now());
+    }
+
+    CpuZone(const CpuZone &) = delete;
+    CpuZone &operator=(const CpuZone &) = delete;
+
+  private:
+    CpuProfiler &profiler;
+    const char *name;
+    uint64_t start;
+};
+
+#endif
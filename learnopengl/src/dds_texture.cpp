@@ -0,0 +1,117 @@
+#ifndef DDS_TEXTURE_H
+#define DDS_TEXTURE_H
+
+#include "glad/glad.h"
+
+#include "gl_extensions.cpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Minimal DDS container support for block compressed mip chains,
+// written by the texture cooker (texture_cooker.cpp) and read by the TextureLoader.
+// Only the legacy DXT1/DXT5 FourCCs are handled, which is all the cooker emits.
+
+#define DDS_MAGIC 0x20534444u // "DDS "
+#define DDS_FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+struct DDSPixelFormat
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t rBitMask, gBitMask, bBitMask, aBitMask;
+};
+
+struct DDSHeader
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+    uint32_t reserved1[11];
+    DDSPixelFormat pixelFormat;
+    uint32_t caps, caps2, caps3, caps4;
+    uint32_t reserved2;
+};
+static_assert(sizeof(DDSHeader) == 124, "DDS header is 124 bytes");
+
+// one mip level inside the file data
+struct CompressedLevel
+{
+    int width, height;
+    size_t offset, size;
+};
+
+// a parsed DDS file, levels point into data
+struct CompressedImage
+{
+    GLenum format = 0;
+    int width = 0, height = 0;
+    std::vector<CompressedLevel> levels;
+    std::vector<unsigned char> data;
+};
+
+// bytes of one mip level for 4x4 blocks of blockBytes each
+inline size_t compressedLevelSize(int width, int height, size_t blockBytes)
+{
+    size_t blocksX = (width + 3) / 4;
+    size_t blocksY = (height + 3) / 4;
+    return (blocksX ? blocksX : 1) * (blocksY ? blocksY : 1) * blockBytes;
+}
+
+// validates the header and splits the payload into levels, takes ownership of the file bytes
+inline bool parseDDS(std::vector<unsigned char> &&file, CompressedImage &image)
+{
+    if (file.size() < 4 + sizeof(DDSHeader))
+        return false;
+    uint32_t magic;
+    DDSHeader header;
+    std::memcpy(&magic, file.data(), 4);
+    std::memcpy(&header, file.data() + 4, sizeof(DDSHeader));
+    if (magic != DDS_MAGIC || header.size != sizeof(DDSHeader))
+        return false;
+
+    size_t blockBytes;
+    if (header.pixelFormat.fourCC == DDS_FOURCC('D', 'X', 'T', '1'))
+    {
+        image.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        blockBytes = 8;
+    }
+    else if (header.pixelFormat.fourCC == DDS_FOURCC('D', 'X', 'T', '5'))
+    {
+        image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        blockBytes = 16;
+    }
+    else
+    {
+        return false;
+    }
+
+    image.width = (int)header.width;
+    image.height = (int)header.height;
+    image.levels.clear();
+    int levelCount = header.mipMapCount ? (int)header.mipMapCount : 1;
+    size_t offset = 4 + sizeof(DDSHeader);
+    int width = image.width, height = image.height;
+    for (int i = 0; i < levelCount; i++)
+    {
+        CompressedLevel level = {width, height, offset, compressedLevelSize(width, height, blockBytes)};
+        if (level.offset + level.size > file.size())
+            return false;
+        image.levels.push_back(level);
+        offset += level.size;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    image.data = std::move(file);
+    return true;
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef DECAL_SET_H
+#define DECAL_SET_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "block_layout.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// one projected decal as the shaders read it (shader_src/decal.glsl), the same in std430
+struct Decal
+{
+    // world space to the box's -1..1 cube, the decal is projected along its -z
+    glm::mat4 worldToDecal;
+    // xyz center, w radius of the sphere around the box, what the clusters are tested with
+    glm::vec4 sphere;
+    // x layer of the materials array, y opacity, z the cosine of the angle between a surface
+    // and the projection past which the decal fades out, w is unused
+    glm::vec4 params;
+};
+
+constexpr BlockMember DECAL_LAYOUT[] = {
+    BLOCK_MEMBER(Decal, worldToDecal, GL_FLOAT_MAT4),
+    BLOCK_MEMBER(Decal, sphere, GL_FLOAT_VEC4),
+    BLOCK_MEMBER(Decal, params, GL_FLOAT_VEC4),
+};
+static_assert(blockLayoutMismatch(DECAL_LAYOUT, STD430) == -1, "Decal members are not where std430 puts them");
+static_assert(blockLayoutSize(DECAL_LAYOUT, STD430) == sizeof(Decal), "Decal is not padded like std430");
+
+// The projected decals of the clustered path, binned by LightClusters with the lights and
+// applied to the albedo in the forward fragment shader, no geometry of their own. Later decals
+// go over earlier ones. They are made up from anchors, the same decals every run.
+class DecalSet
+{
+  public:
+    std::vector<Decal> decals;
+
+    // a box of halfExtents centered at center projecting along forward, turned by angle
+    // around it, showing layer of the materials array
+    void add(const glm::vec3 &center, const glm::vec3 &halfExtents, const glm::vec3 &forward, float angle, int layer,
+             float opacity = 1.0f)
+    {
+        glm::vec3 z = -glm::normalize(forward);
+        glm::vec3 up = std::abs(z.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 x = glm::normalize(glm::cross(up, z));
+        glm::vec3 y = glm::cross(z, x);
+        float c = std::cos(angle), s = std::sin(angle);
+        glm::mat4 decalToWorld(glm::vec4((c * x + s * y) * halfExtents.x, 0.0f),
+                               glm::vec4((c * y - s * x) * halfExtents.y, 0.0f), glm::vec4(z * halfExtents.z, 0.0f),
+                               glm::vec4(center, 1.0f));
+        Decal decal;
+        decal.worldToDecal = glm::inverse(decalToWorld);
+        decal.sphere = glm::vec4(center, glm::length(halfExtents));
+        // faces turned more than about 70 degrees away from the projection fade out
+        decal.params = glm::vec4((float)layer, opacity, 0.35f, 0.0f);
+        decals.push_back(decal);
+    }
+
+    // count decals of size next to randomly picked anchors, e.g. the objects they go on,
+    // projected along one of the six axes
+    void scatter(size_t count, const std::vector<glm::vec3> &anchors, float size, int layer, uint32_t seed)
+    {
+        decals.clear();
+        if (anchors.empty())
+            return;
+        uint32_t state = seed ? seed : 1u;
+        auto random = [&state]() {
+            // xorshift32, as LightSet
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return (float)(state & 0xFFFFFF) / (float)0x1000000;
+        };
+        static const glm::vec3 axes[6] = {glm::vec3(1.0f, 0.0f, 0.0f),  glm::vec3(-1.0f, 0.0f, 0.0f),
+                                          glm::vec3(0.0f, 1.0f, 0.0f),  glm::vec3(0.0f, -1.0f, 0.0f),
+                                          glm::vec3(0.0f, 0.0f, 1.0f),  glm::vec3(0.0f, 0.0f, -1.0f)};
+        for (size_t i = 0; i < count; i++)
+        {
+            const glm::vec3 &anchor = anchors[std::min((size_t)(random() * anchors.size()), anchors.size() - 1)];
+            glm::vec3 forward = axes[std::min((int)(random() * 6.0f), 5)];
+            glm::vec3 t(random(), random(), random());
+            float extent = size * (0.3f + 0.4f * random());
+            add(anchor + (t - 0.5f) * size * 0.5f, glm::vec3(extent, extent, size), forward,
+                random() * 6.2831853f, layer, 0.6f + 0.4f * random());
+        }
+    }
+
+    // every decal moved by offset
+    void translate(const glm::vec3 &offset)
+    {
+        glm::mat4 back = glm::translate(glm::mat4(1.0f), -offset);
+        for (Decal &decal : decals)
+        {
+            decal.worldToDecal = decal.worldToDecal * back;
+            decal.sphere += glm::vec4(offset, 0.0f);
+        }
+    }
+};
+
+#endif
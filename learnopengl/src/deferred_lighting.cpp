@@ -0,0 +1,147 @@
+#ifndef DEFERRED_LIGHTING_H
+#define DEFERRED_LIGHTING_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "frame_data.cpp"
+#include "gbuffer.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "light_set.cpp"
+#include "render_stats.cpp"
+#include "ring_buffer.cpp"
+#include "shader.cpp"
+
+#include <algorithm>
+#include <vector>
+
+// The lighting passes of the deferred path, over a filled GBuffer: a full screen pass lays
+// down the ambient and the sun (deferred_ambient.fs), then every point light is drawn as an
+// instance of a cube of its radius (light_volume.vs, deferred_light.fs) blended additively,
+// so a light costs only the pixels its volume covers instead of a loop over all lights in
+// every fragment. The volumes draw their back faces without a depth test: that still covers
+// every pixel in reach with the camera inside a volume, and pixels behind or beyond the
+// radius are discarded in the shader from the reconstructed position.
+// The lights live in one uniform buffer written to the RingBuffer every frame.
+class DeferredLighting
+{
+  public:
+    // uniform buffer binding point of the PointLights block
+    static const unsigned int BINDING = 3;
+    static const unsigned int MAX_LIGHTS = 256;
+
+    glm::vec3 ambient = glm::vec3(0.3f);
+    // towards the sun
+    glm::vec3 sunDirection = glm::normalize(glm::vec3(0.3f, 1.0f, 0.5f));
+    glm::vec3 sunColor = glm::vec3(0.6f);
+    glm::vec3 background = glm::vec3(0.2f, 0.3f, 0.3f);
+
+    DeferredLighting(RingBuffer &ring, Shader &ambientShader, Shader &lightShader)
+        : ring(ring), ambientShader(ambientShader), lightShader(lightShader), staging(MAX_LIGHTS, PointLight{})
+    {
+        // both passes make their vertices from gl_VertexID
+        emptyVAO = createVertexArray();
+
+        for (Shader *program : {&ambientShader, &lightShader})
+        {
+            program->use();
+            program->setInt("gAlbedo", GBuffer::ALBEDO_UNIT);
+            program->setInt("gNormal", GBuffer::NORMAL_UNIT);
+            program->setInt("gDepth", GBuffer::DEPTH_UNIT);
+            program->bindUniformBlock("PointLights", BINDING);
+            program->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+        }
+        for (int i = 0; i < 2; i++)
+        {
+            Shader &program = i == 0 ? ambientShader : lightShader;
+            handles[i].inverseViewProjection = program.uniform("inverseViewProjection");
+            handles[i].depthZeroToOne = program.uniform("depthZeroToOne");
+            handles[i].clearDepth = program.uniform("clearDepth");
+        }
+        ambientLoc = ambientShader.uniform("ambient");
+        sunDirectionLoc = ambientShader.uniform("sunDirection");
+        sunColorLoc = ambientShader.uniform("sunColor");
+        backgroundLoc = ambientShader.uniform("background");
+    }
+
+    ~DeferredLighting()
+    {
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    DeferredLighting(const DeferredLighting &) = delete;
+    DeferredLighting &operator=(const DeferredLighting &) = delete;
+
+    // lights the G-buffer into its light buffer (left bound) with the first MAX_LIGHTS lights,
+    // depth is the texture it was drawn with
+    void draw(const GBuffer &gbuffer, const Texture2D &depth, const std::vector<PointLight> &lights,
+              const glm::mat4 &viewProjection, bool reversedZ)
+    {
+        size_t count = std::min(lights.size(), (size_t)MAX_LIGHTS);
+        std::copy(lights.begin(), lights.begin() + count, staging.begin());
+        GLintptr offset = ring.push(staging.data(), staging.size() * sizeof(PointLight), ring.uniformAlignment);
+        if (offset < 0)
+            count = 0;
+        else
+            glState.bindBufferRange(GL_UNIFORM_BUFFER, BINDING, ring.ID, offset, staging.size() * sizeof(PointLight));
+
+        gbuffer.bindLighting(depth);
+        glState.disable(GL_DEPTH_TEST);
+        glState.setDepthMask(false);
+        glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+        for (int i = 0; i < 2; i++)
+        {
+            Shader &program = i == 0 ? ambientShader : lightShader;
+            program.use();
+            program.set(handles[i].inverseViewProjection, inverseViewProjection);
+            // reversed-Z goes with glClipControl(GL_ZERO_TO_ONE) and a cleared depth of 0
+            program.set(handles[i].depthZeroToOne, reversedZ);
+            program.set(handles[i].clearDepth, reversedZ ? 0.0f : 1.0f);
+        }
+
+        ambientShader.use();
+        ambientShader.set(ambientLoc, ambient);
+        ambientShader.set(sunDirectionLoc, sunDirection);
+        ambientShader.set(sunColorLoc, sunColor);
+        ambientShader.set(backgroundLoc, background);
+        glState.bindVertexArray(emptyVAO);
+        renderStats.countDraw(3);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        if (count > 0)
+        {
+            lightShader.use();
+            glState.enable(GL_BLEND);
+            glState.setBlendFunc(GL_ONE, GL_ONE);
+            // the back faces, the shader's cube winds counter clockwise
+            glState.enable(GL_CULL_FACE);
+            glCullFace(GL_FRONT);
+            renderStats.countDraw(36, count);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 36, (GLsizei)count);
+            glCullFace(GL_BACK);
+            glState.disable(GL_CULL_FACE);
+            glState.disable(GL_BLEND);
+            // the alpha blending everything else expects
+            glState.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
+        glState.setDepthMask(true);
+        glState.enable(GL_DEPTH_TEST);
+    }
+
+  private:
+    RingBuffer &ring;
+    Shader &ambientShader;
+    Shader &lightShader;
+    unsigned int emptyVAO = 0;
+    std::vector<PointLight> staging;
+
+    // the uniforms both programs have, ambientShader's first
+    struct Handles
+    {
+        UniformHandle inverseViewProjection, depthZeroToOne, clearDepth;
+    } handles[2];
+    UniformHandle ambientLoc, sunDirectionLoc, sunColorLoc, backgroundLoc;
+};
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef DELETION_QUEUE_H
+#define DELETION_QUEUE_H
+
+#include "glad/glad.h"
+
+#include "texture.cpp"
+
+#include <cstdint>
+#include <vector>
+
+// Holds GL objects the frames in flight may still use until the GPU is past them. The
+// objects given up during a frame form its batch, endFrame() closes the batch with a fence
+// after the frame's last command and collect() deletes every batch whose fence signaled,
+// oldest first and one glDelete* call per kind of object, without waiting. The fence goes
+// in every frame, empty batches included, so completedFrame also tells ResourcePool::collect()
+// how far the GPU got.
+class DeletionQueue
+{
+  public:
+    // the frame being recorded, and the newest one the GPU finished
+    uint64_t frame = 1;
+    uint64_t completedFrame = 0;
+    // objects deleted so far
+    size_t deleted = 0;
+
+    DeletionQueue()
+    {
+    }
+
+    // everything still queued is deleted, waiting for the GPU first
+    ~DeletionQueue()
+    {
+        flush();
+    }
+
+    DeletionQueue(const DeletionQueue &) = delete;
+    DeletionQueue &operator=(const DeletionQueue &) = delete;
+
+    void deleteBuffer(unsigned int buffer)
+    {
+        if (buffer)
+            recording.buffers.push_back(buffer);
+    }
+
+    void deleteTexture(unsigned int texture)
+    {
+        if (texture)
+            recording.textures.push_back(texture);
+    }
+
+    void deleteVertexArray(unsigned int vertexArray)
+    {
+        if (vertexArray)
+            recording.vertexArrays.push_back(vertexArray);
+    }
+
+    void deleteFramebuffer(unsigned int framebuffer)
+    {
+        if (framebuffer)
+            recording.framebuffers.push_back(framebuffer);
+    }
+
+    void deleteProgram(unsigned int program)
+    {
+        if (program)
+            recording.programs.push_back(program);
+    }
+
+    // takes the texture's storage, texture is left empty; aliases only lose their borrowed ID
+    void deleteTexture(Texture2D &&texture)
+    {
+        if (texture.ID && texture.owner)
+        {
+            deleteTexture(texture.ID);
+            gpuMemory.release(texture.category, RenderStats::storageBytes(texture.internalFormat, texture.width,
+                                                                          texture.height, 1, texture.levels));
+        }
+        texture.ID = 0;
+    }
+
+    // after the frame's last command that may use the queued objects
+    void endFrame()
+    {
+        recording.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        recording.frame = frame++;
+        batches.push_back(std::move(recording));
+        // a spent batch keeps its capacity, the steady state doesn't allocate
+        if (spare.empty())
+        {
+            recording = Batch();
+            return;
+        }
+        recording = std::move(spare.back());
+        spare.pop_back();
+    }
+
+    // deletes the batches the GPU is done with, never blocks
+    void collect()
+    {
+        size_t done = 0;
+        while (done < batches.size())
+        {
+            GLenum status = glClientWaitSync(batches[done].fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            release(batches[done]);
+            spare.push_back(std::move(batches[done]));
+            done++;
+        }
+        // a few frames at most, moving them is cheap
+        batches.erase(batches.begin(), batches.begin() + done);
+    }
+
+    // waits for every batch and deletes it, the objects not in a batch yet as well
+    void flush()
+    {
+        for (Batch &batch : batches)
+        {
+            GLenum status = glClientWaitSync(batch.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            while (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED && status != GL_WAIT_FAILED)
+                status = glClientWaitSync(batch.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            release(batch);
+        }
+        batches.clear();
+        // no frame closed these yet, the driver defers the deletion if the GPU still uses them
+        recording.frame = 0;
+        release(recording);
+    }
+
+    // objects waiting for their frame
+    size_t pending() const
+    {
+        size_t count = recording.count();
+        for (const Batch &batch : batches)
+            count += batch.count();
+        return count;
+    }
+
+  private:
+    struct Batch
+    {
+        uint64_t frame = 0;
+        GLsync fence = 0;
+        std::vector<unsigned int> buffers, textures, vertexArrays, framebuffers, programs;
+
+        size_t count() const
+        {
+            return buffers.size() + textures.size() + vertexArrays.size() + framebuffers.size() + programs.size();
+        }
+    };
+
+    Batch recording;
+    // oldest first
+    std::vector<Batch> batches;
+    std::vector<Batch> spare;
+
+    void release(Batch &batch)
+    {
+        if (!batch.buffers.empty())
+            deleteBuffers((GLsizei)batch.buffers.size(), batch.buffers.data());
+        if (!batch.textures.empty())
+            glDeleteTextures((GLsizei)batch.textures.size(), batch.textures.data());
+        if (!batch.vertexArrays.empty())
+            glDeleteVertexArrays((GLsizei)batch.vertexArrays.size(), batch.vertexArrays.data());
+        if (!batch.framebuffers.empty())
+            glDeleteFramebuffers((GLsizei)batch.framebuffers.size(), batch.framebuffers.data());
+        for (unsigned int program : batch.programs)
+            glDeleteProgram(program);
+        deleted += batch.count();
+        batch.buffers.clear();
+        batch.textures.clear();
+        batch.vertexArrays.clear();
+        batch.framebuffers.clear();
+        batch.programs.clear();
+        if (batch.fence)
+            glDeleteSync(batch.fence);
+        batch.fence = 0;
+        if (batch.frame > completedFrame)
+            completedFrame = batch.frame;
+    }
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef DEPTH_PREPASS_H
+#define DEPTH_PREPASS_H
+
+#include "glad/glad.h"
+
+#include "gl_state.cpp"
+
+#include <cstdint>
+
+enum DepthPrepassMode
+{
+    PREPASS_OFF,
+    PREPASS_ON,
+    // on while the measured overdraw is high
+    PREPASS_AUTO,
+};
+
+// Draws the opaque geometry twice: a depth only pass with the color writes masked
+// (depth_only.fs, no texture reads) and then the shading pass with GL_EQUAL and the depth
+// writes off, so the fragment shader runs once per covered pixel however the draws overlap.
+// Both passes have to produce bit identical depth, the vertex shaders declare
+// invariant gl_Position for that.
+// The pass that writes the depth first is wrapped in a GL_SAMPLES_PASSED query: its
+// samples per target pixel are the fragments the shading would run for without a prepass.
+// PREPASS_AUTO turns the prepass on above enableOverdraw and off again below
+// disableOverdraw. Results are read FRAMES frames later and only once they are there.
+class DepthPrepass
+{
+  public:
+    static const unsigned int FRAMES = 3;
+
+    DepthPrepassMode mode = PREPASS_AUTO;
+    float enableOverdraw = 1.5f;
+    float disableOverdraw = 1.1f;
+    // shaded fragments per pixel, last measured
+    float overdraw = 0.0f;
+    // GL_LESS, or GL_GREATER with reversed Z
+    GLenum depthFunc = GL_LESS;
+
+    DepthPrepass()
+    {
+        glGenQueries(FRAMES, queries);
+    }
+
+    ~DepthPrepass()
+    {
+        glDeleteQueries(FRAMES, queries);
+    }
+
+    DepthPrepass(const DepthPrepass &) = delete;
+    DepthPrepass &operator=(const DepthPrepass &) = delete;
+
+    bool active() const
+    {
+        return mode == PREPASS_ON || (mode == PREPASS_AUTO && autoActive);
+    }
+
+    // before the depth pass, or before the only pass when the prepass is off;
+    // pixels is the size of the target the samples are counted against
+    void begin(uint64_t targetPixels)
+    {
+        current = (current + 1) % FRAMES;
+        collect(current);
+        pixels[current] = targetPixels;
+        glBeginQuery(GL_SAMPLES_PASSED, queries[current]);
+        pending[current] = true;
+        if (active())
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    }
+
+    // between the depth pass and the shading pass, the query stops here when there is a depth pass
+    void beginShading()
+    {
+        if (!active())
+            return;
+        glEndQuery(GL_SAMPLES_PASSED);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glState.setDepthFunc(GL_EQUAL);
+        glState.setDepthMask(false);
+    }
+
+    // after the shading pass, ends the query when it was the only one
+    void end()
+    {
+        if (!active())
+        {
+            glEndQuery(GL_SAMPLES_PASSED);
+            return;
+        }
+        glState.setDepthFunc(depthFunc);
+        glState.setDepthMask(true);
+    }
+
+  private:
+    unsigned int queries[FRAMES] = {};
+    uint64_t pixels[FRAMES] = {};
+    bool pending[FRAMES] = {};
+    unsigned int current = 0;
+    bool autoActive = false;
+
+    void collect(unsigned int index)
+    {
+        if (!pending[index])
+            return;
+        pending[index] = false;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available || pixels[index] == 0)
+            return;
+        GLuint64 samples = 0;
+        glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &samples);
+        overdraw = (float)((double)samples / (double)pixels[index]);
+        if (overdraw > enableOverdraw)
+            autoActive = true;
+        else if (overdraw < disableOverdraw)
+            autoActive = false;
+    }
+};
+
+#endif
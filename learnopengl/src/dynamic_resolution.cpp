@@ -0,0 +1,199 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "frame_graph.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "gpu_profiler.cpp"
+#include "render_stats.cpp"
+#include "shader.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+enum UpscaleFilter
+{
+    UPSCALE_BILINEAR,
+    // edge adaptive upsampling and contrast adaptive sharpening after it, after FSR 1's EASU and RCAS
+    UPSCALE_SHARPEN,
+};
+
+// Renders the 3D scene at a fraction of the window's size and brings it up to the window.
+// The fraction follows the GPU time of the whole frame (the GpuProfiler's "frame" zone): the
+// time goes with the pixels, so a frame of t ms at scale s is expected to take target ms at
+// s * sqrt(target / t). update() moves the scale there in steps of STEP, a smaller scale as
+// soon as the average of SAMPLES frames is over the target and a larger one only while it is
+// below headroom x the target, so it doesn't flip between two steps. The samples are a
+// few frames late, the ones of frames still drawn at the old scale are skipped.
+// The steps keep the render targets from being reallocated every frame.
+// upscale() is one bilinear pass, or an edge adaptive pass (upscale_easu.fs) and a sharpening
+// one (upscale_rcas.fs) at the window's size. Both want a tone mapped frame, with the
+// post-processing on its composite goes to inputFramebuffer() at the scaled size first.
+class DynamicResolution
+{
+  public:
+    static const size_t SAMPLES = 8;
+    static constexpr float STEP = 0.05f;
+
+    // GPU milliseconds per frame to hold
+    float targetFrameTime = 16.0f;
+    float minScale = 0.5f, maxScale = 1.0f;
+    float headroom = 0.85f;
+    UpscaleFilter filter = UPSCALE_SHARPEN;
+    // RCAS in stops, 0 is the sharpest
+    float sharpness = 0.25f;
+    // of the window's width and height
+    float scale = 1.0f;
+
+    DynamicResolution(Shader &bilinearProgram, Shader &easuProgram, Shader &rcasProgram)
+        : bilinear(bilinearProgram), easu(easuProgram), rcas(rcasProgram),
+          sampler(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)
+    {
+        emptyVAO = createVertexArray();
+        for (Shader *program : {&bilinear, &easu, &rcas})
+        {
+            program->use();
+            program->setInt("input0", 0);
+        }
+        easuTexelSizeLoc = easu.uniform("texelSize");
+        rcasParamsLoc = rcas.uniform("params");
+    }
+
+    ~DynamicResolution()
+    {
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    DynamicResolution(const DynamicResolution &) = delete;
+    DynamicResolution &operator=(const DynamicResolution &) = delete;
+
+    // once a frame before the scene is drawn, takes the newest whole frame GPU time
+    void update(const GpuProfiler &profiler)
+    {
+        for (const GpuPassStats &pass : profiler.passes)
+        {
+            if (pass.name != "frame" || pass.count == seenSamples)
+                continue;
+            seenSamples = pass.count;
+            // drawn before the last change
+            if (skipSamples > 0)
+            {
+                skipSamples--;
+                continue;
+            }
+            total += pass.last;
+            if (++samples < SAMPLES)
+                continue;
+            float average = total / (float)samples;
+            total = 0.0f;
+            samples = 0;
+            if (average <= 0.0f || (average <= targetFrameTime && average >= targetFrameTime * headroom))
+                continue;
+            float wanted = scale * std::sqrt(targetFrameTime * (average > targetFrameTime ? 1.0f : headroom) / average);
+            // up by at most two steps at once, growing is where it would overshoot
+            wanted = std::min(wanted, scale + 2.0f * STEP);
+            float next = std::clamp(std::floor(wanted / STEP + 0.5f) * STEP, minScale, maxScale);
+            if (next != scale)
+            {
+                scale = next;
+                skipSamples = GpuProfiler::FRAMES;
+            }
+        }
+    }
+
+    // the size the scene is drawn at for a window of width x height
+    glm::ivec2 renderSize(int width, int height) const
+    {
+        return glm::ivec2(std::max(1, (int)(width * scale + 0.5f)), std::max(1, (int)(height * scale + 0.5f)));
+    }
+
+    // an RGBA8 target of width x height for the tone mapped frame, upscale() it with inputTexture()
+    unsigned int inputFramebuffer(int width, int height)
+    {
+        if (!input || input->width != width || input->height != height)
+        {
+            inputs.release(input);
+            input = inputs.acquire(width, height, GL_RGBA8);
+        }
+        return input ? input->FBO : 0;
+    }
+
+    const Texture2D *inputTexture() const
+    {
+        return input ? &input->color : NULL;
+    }
+
+    // source up to the width x height window, leaves it bound with the viewport on it
+    void upscale(const Texture2D &source, int width, int height, GpuProfiler &profiler)
+    {
+        if (width <= 0 || height <= 0)
+            return;
+        FrameGraph::Resource frame = graph.importTexture("frame", source);
+        FrameGraph::Resource window = graph.importFramebuffer("window", 0, width, height);
+        if (filter == UPSCALE_BILINEAR)
+        {
+            FrameGraph::Pass pass = graph.addPass("upscale", [this, frame](FrameGraph &frameGraph) {
+                draw(bilinear, *frameGraph.texture(frame));
+            });
+            graph.read(pass, frame);
+            graph.write(pass, window);
+        }
+        else
+        {
+            FrameGraph::Resource upscaled = graph.createTexture("easu", width, height, GL_RGBA8);
+            FrameGraph::Pass pass = graph.addPass("easu", [this, frame](FrameGraph &frameGraph) {
+                const Texture2D &texture = *frameGraph.texture(frame);
+                easu.use();
+                easu.set(easuTexelSizeLoc, glm::vec2(1.0f / texture.width, 1.0f / texture.height));
+                draw(easu, texture);
+            });
+            graph.read(pass, frame);
+            graph.write(pass, upscaled);
+            pass = graph.addPass("rcas", [this, upscaled](FrameGraph &frameGraph) {
+                rcas.use();
+                rcas.set(rcasParamsLoc, glm::vec4(std::exp2(-sharpness), 0.0f, 0.0f, 0.0f));
+                draw(rcas, *frameGraph.texture(upscaled));
+            });
+            graph.read(pass, upscaled);
+            graph.write(pass, window);
+        }
+
+        glState.disable(GL_DEPTH_TEST);
+        glState.setDepthMask(false);
+        glState.disable(GL_BLEND);
+        glState.bindVertexArray(emptyVAO);
+        graph.execute(profiler);
+        inputs.endFrame();
+        glState.setDepthMask(true);
+        glState.enable(GL_DEPTH_TEST);
+    }
+
+  private:
+    Shader &bilinear, &easu, &rcas;
+    UniformHandle easuTexelSizeLoc, rcasParamsLoc;
+    Sampler sampler;
+    unsigned int emptyVAO = 0;
+    FrameGraph graph;
+    RenderTargetPool inputs;
+    RenderTargetPool::Target *input = NULL;
+
+    size_t seenSamples = 0, skipSamples = 0;
+    size_t samples = 0;
+    float total = 0.0f;
+
+    void draw(Shader &program, const Texture2D &texture)
+    {
+        program.use();
+        texture.bind(0);
+        sampler.bind(0);
+        renderStats.countDraw(3);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+};
+
+#endif
@@ -0,0 +1,412 @@
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include "glm/glm.hpp"
+
+#include "huge_pages.cpp"
+#include "scene_snapshot.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+#include <vector>
+
+// Archetype based entity/component storage. Every distinct set of components is one
+// archetype, which keeps one contiguous array per component plus the entities, row by row,
+// so a system that wants A and B walks a few tightly packed arrays front to back instead of
+// looking every entity up. eachChunk() hands over those arrays of every archetype that has
+// the components asked for, each() calls a function per entity on top of it.
+// Components are plain structs, copied around with memcpy. Entities are dense ids that are
+// never reused; destroy() moves the last row of the archetype into the hole.
+// save() writes the archetypes' arrays as they are to a scene snapshot and restore() puts
+// them back; component ids only mean the same types in the build that wrote them.
+
+typedef uint32_t Entity;
+
+// a bit per component type, so at most 32 of them
+typedef uint32_t ComponentMask;
+
+namespace entities
+{
+inline uint32_t nextComponentId()
+{
+    static uint32_t next = 0;
+    return next++;
+}
+
+// one id per component type, in the order the types are first used
+template <typename T> uint32_t componentId()
+{
+    static const uint32_t id = nextComponentId();
+    return id;
+}
+
+template <typename... Ts> ComponentMask maskOf()
+{
+    ComponentMask mask = 0;
+    ((mask |= 1u << componentId<Ts>()), ...);
+    return mask;
+}
+} // namespace entities
+
+class EntityStore
+{
+  public:
+    EntityStore()
+    {
+    }
+
+    ~EntityStore()
+    {
+        for (Archetype *archetype : archetypes)
+            delete archetype;
+    }
+
+    EntityStore(const EntityStore &) = delete;
+    EntityStore &operator=(const EntityStore &) = delete;
+
+    // a new entity with these components, one of each type at most
+    template <typename... Ts> Entity create(const Ts &...components)
+    {
+        static_assert(sizeof...(Ts) > 0, "an entity needs a component");
+        Archetype &archetype = archetypeOf(entities::maskOf<Ts...>(), {Layout::of<Ts>()...});
+        Entity entity = (Entity)locations.size();
+        uint32_t row = (uint32_t)archetype.entities.size();
+        archetype.entities.push_back(entity);
+        (archetype.column(entities::componentId<Ts>()).push(&components), ...);
+        locations.push_back({&archetype, row});
+        return entity;
+    }
+
+    void destroy(Entity entity)
+    {
+        Location &location = locations[entity];
+        Archetype *archetype = location.archetype;
+        if (!archetype)
+            return;
+        uint32_t last = (uint32_t)archetype->entities.size() - 1;
+        if (location.row != last)
+        {
+            Entity moved = archetype->entities[last];
+            archetype->entities[location.row] = moved;
+            for (Column &column : archetype->columns)
+                column.copy(last, location.row);
+            locations[moved].row = location.row;
+        }
+        archetype->entities.pop_back();
+        for (Column &column : archetype->columns)
+            column.pop();
+        location = {NULL, 0};
+    }
+
+    // NULL when the entity doesn't have T, valid until the next create() or destroy()
+    template <typename T> T *get(Entity entity)
+    {
+        const Location &location = locations[entity];
+        if (!location.archetype)
+            return NULL;
+        Column *column = location.archetype->find(entities::componentId<T>());
+        return column ? (T *)column->at(location.row) : NULL;
+    }
+
+    template <typename T> const T *get(Entity entity) const
+    {
+        return const_cast<EntityStore *>(this)->get<T>(entity);
+    }
+
+    // every entity and archetype goes, ids start over at 0
+    void clear()
+    {
+        for (Archetype *archetype : archetypes)
+            delete archetype;
+        archetypes.clear();
+        locations.clear();
+    }
+
+    // entities ever created, the destroyed ones included
+    size_t capacity() const
+    {
+        return locations.size();
+    }
+
+    // entities with every one of Ts
+    template <typename... Ts> size_t count() const
+    {
+        ComponentMask mask = entities::maskOf<Ts...>();
+        size_t total = 0;
+        for (const Archetype *archetype : archetypes)
+        {
+            if ((archetype->mask & mask) == mask)
+                total += archetype->entities.size();
+        }
+        return total;
+    }
+
+    // function(count, entities, Ts *...) once per archetype with every one of Ts, the
+    // arrays are that archetype's rows
+    template <typename... Ts, typename Function> void eachChunk(Function function)
+    {
+        ComponentMask mask = entities::maskOf<Ts...>();
+        for (Archetype *archetype : archetypes)
+        {
+            if ((archetype->mask & mask) != mask || archetype->entities.empty())
+                continue;
+            function(archetype->entities.size(), archetype->entities.data(),
+                     (Ts *)archetype->find(entities::componentId<Ts>())->data()...);
+        }
+    }
+
+    // function(entity, Ts &...) for every entity with every one of Ts, archetype by archetype
+    template <typename... Ts, typename Function> void each(Function function)
+    {
+        eachChunk<Ts...>([&](size_t count, const Entity *ids, Ts *...arrays) {
+            for (size_t i = 0; i < count; i++)
+                function(ids[i], arrays[i]...);
+        });
+    }
+
+    // every archetype's rows and where each entity is, see scene_snapshot.cpp
+    void save(SceneSnapshotWriter &snapshot) const
+    {
+        std::vector<SavedArchetype> saved;
+        std::vector<SavedColumn> columns;
+        std::vector<Entity> ids;
+        std::vector<unsigned char> bytes;
+        for (const Archetype *archetype : archetypes)
+        {
+            saved.push_back(
+                {archetype->mask, (uint32_t)archetype->columns.size(), (uint32_t)archetype->entities.size()});
+            ids.insert(ids.end(), archetype->entities.begin(), archetype->entities.end());
+            for (const Column &column : archetype->columns)
+            {
+                columns.push_back({column.id, (uint32_t)column.size});
+                bytes.insert(bytes.end(), column.bytes.begin(), column.bytes.end());
+            }
+        }
+        std::vector<SavedLocation> savedLocations;
+        for (const Location &location : locations)
+        {
+            uint32_t index = NO_ARCHETYPE;
+            for (size_t a = 0; a < archetypes.size() && location.archetype; a++)
+            {
+                if (archetypes[a] == location.archetype)
+                    index = (uint32_t)a;
+            }
+            savedLocations.push_back({index, location.row});
+        }
+        snapshot.add("entities/archetypes", saved);
+        snapshot.add("entities/columns", columns);
+        snapshot.add("entities/ids", ids);
+        snapshot.add("entities/bytes", bytes);
+        snapshot.add("entities/locations", savedLocations);
+    }
+
+    // replaces every entity with the saved ones; false leaves the store empty
+    bool restore(const SceneSnapshot &snapshot)
+    {
+        clear();
+        std::vector<SavedArchetype> saved;
+        std::vector<SavedColumn> columns;
+        std::vector<Entity> ids;
+        std::vector<SavedLocation> savedLocations;
+        const unsigned char *bytes;
+        size_t byteCount;
+        if (!snapshot.read("entities/archetypes", saved) || !snapshot.read("entities/columns", columns) ||
+            !snapshot.read("entities/ids", ids) || !snapshot.view("entities/bytes", bytes, byteCount) ||
+            !snapshot.read("entities/locations", savedLocations))
+            return false;
+        size_t column = 0, id = 0, byte = 0;
+        for (const SavedArchetype &entry : saved)
+        {
+            if (column + entry.columnCount > columns.size() || id + entry.rows > ids.size())
+                return fail();
+            Archetype *archetype = new Archetype();
+            archetypes.push_back(archetype);
+            archetype->mask = entry.mask;
+            archetype->entities.assign(ids.begin() + id, ids.begin() + id + entry.rows);
+            id += entry.rows;
+            for (uint32_t c = 0; c < entry.columnCount; c++, column++)
+            {
+                size_t size = (size_t)columns[column].size * entry.rows;
+                if (size > byteCount - byte)
+                    return fail();
+                archetype->columns.push_back({columns[column].id, columns[column].size,
+                                              Column::Bytes(bytes + byte, bytes + byte + size)});
+                byte += size;
+            }
+        }
+        for (const SavedLocation &location : savedLocations)
+        {
+            if (location.archetype == NO_ARCHETYPE)
+            {
+                locations.push_back({NULL, 0});
+                continue;
+            }
+            if (location.archetype >= archetypes.size() ||
+                location.row >= archetypes[location.archetype]->entities.size())
+                return fail();
+            locations.push_back({archetypes[location.archetype], location.row});
+        }
+        return true;
+    }
+
+  private:
+    static const uint32_t NO_ARCHETYPE = 0xFFFFFFFFu;
+
+    // how save() stores the archetypes, their columns and ids one after the other
+    struct SavedArchetype
+    {
+        ComponentMask mask;
+        uint32_t columnCount;
+        uint32_t rows;
+    };
+    struct SavedColumn
+    {
+        uint32_t id;
+        uint32_t size;
+    };
+    struct SavedLocation
+    {
+        uint32_t archetype;
+        uint32_t row;
+    };
+
+    // size and id of a component type
+    struct Layout
+    {
+        uint32_t id;
+        size_t size;
+
+        template <typename T> static Layout of()
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "components are copied with memcpy");
+            return {entities::componentId<T>(), sizeof(T)};
+        }
+    };
+
+    // the rows of one component type in an archetype, in huge pages once large with --huge-pages
+    struct Column
+    {
+        typedef std::vector<unsigned char, HugePageAllocator<unsigned char>> Bytes;
+
+        uint32_t id;
+        size_t size;
+        Bytes bytes;
+
+        void *at(size_t row)
+        {
+            return &bytes[row * size];
+        }
+
+        void *data()
+        {
+            return bytes.data();
+        }
+
+        void push(const void *component)
+        {
+            size_t offset = bytes.size();
+            bytes.resize(offset + size);
+            std::memcpy(&bytes[offset], component, size);
+        }
+
+        void copy(size_t from, size_t to)
+        {
+            std::memcpy(&bytes[to * size], &bytes[from * size], size);
+        }
+
+        void pop()
+        {
+            bytes.resize(bytes.size() - size);
+        }
+    };
+
+    struct Archetype
+    {
+        ComponentMask mask;
+        std::vector<Entity> entities;
+        // sorted by id
+        std::vector<Column> columns;
+
+        Column *find(uint32_t id)
+        {
+            for (Column &column : columns)
+            {
+                if (column.id == id)
+                    return &column;
+            }
+            return NULL;
+        }
+
+        Column &column(uint32_t id)
+        {
+            return *find(id);
+        }
+    };
+
+    struct Location
+    {
+        Archetype *archetype;
+        uint32_t row;
+    };
+
+    // heap allocated so locations stay valid while the list grows
+    std::vector<Archetype *> archetypes;
+    std::vector<Location> locations;
+
+    bool fail()
+    {
+        clear();
+        return false;
+    }
+
+    Archetype &archetypeOf(ComponentMask mask, std::initializer_list<Layout> layouts)
+    {
+        for (Archetype *archetype : archetypes)
+        {
+            if (archetype->mask == mask)
+                return *archetype;
+        }
+        Archetype *archetype = new Archetype();
+        archetype->mask = mask;
+        for (const Layout &layout : layouts)
+            archetype->columns.push_back({layout.id, layout.size, {}});
+        std::sort(archetype->columns.begin(), archetype->columns.end(),
+                  [](const Column &a, const Column &b) { return a.id < b.id; });
+        archetypes.push_back(archetype);
+        return *archetype;
+    }
+};
+
+// the components of the scene objects
+
+// placement: the node in the SceneGraph and its world matrix as of the last transform stage
+struct Transform
+{
+    glm::mat4 world;
+    uint32_t node;
+};
+
+// how the object is drawn: the material layer and its index in the culling and draw lists
+struct Renderable
+{
+    int layer;
+    uint32_t drawIndex;
+};
+
+// world space bounding sphere, xyz center and w radius
+struct Bounds
+{
+    glm::vec4 sphere;
+};
+
+// a simulated object, its body in the TransformSystem; objects without one never move
+struct Motion
+{
+    uint32_t body;
+};
+
+#endif
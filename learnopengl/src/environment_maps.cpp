@@ -0,0 +1,311 @@
+#ifndef ENVIRONMENT_MAPS_H
+#define ENVIRONMENT_MAPS_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "asset_pack.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "hash.cpp"
+#include "render_stats.cpp"
+#include "shader.cpp"
+#include "shader_compiler.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// the procedural sky the environment is made from, the whole of it goes into the cache key
+struct SkyDesc
+{
+    glm::vec3 zenith = glm::vec3(0.25f, 0.4f, 0.7f);
+    glm::vec3 horizon = glm::vec3(0.55f, 0.6f, 0.65f);
+    glm::vec3 ground = glm::vec3(0.2f, 0.18f, 0.15f);
+    // towards the sun
+    glm::vec3 sunDirection = glm::normalize(glm::vec3(0.3f, 1.0f, 0.5f));
+    glm::vec3 sunColor = glm::vec3(20.0f, 18.0f, 15.0f);
+    // of the disc, in radians
+    float sunRadius = 0.02f;
+    // of the disc's radiance in the glow around it
+    float sunGlow = 0.02f;
+};
+
+// Image based lighting and the skybox from one environment: build() draws the sky into a cube
+// map (shader_src/env_sky.comp), then integrates it into a small irradiance map for the
+// diffuse light (env_irradiance.comp) and prefilters it into a specular map whose levels are
+// the reflection at growing roughness (env_specular.comp), once, and stores both in a cache
+// entry named by the SkyDesc, so later launches upload them without a single dispatch.
+// Programs built with SHADER_ENVIRONMENT_LIGHTING read them through environment.glsl once
+// attached; drawSky() fills what the opaque draws left at the cleared depth, after them, so
+// the pixels the scene covers are never shaded twice.
+class EnvironmentMaps
+{
+  public:
+    static const int SOURCE_SIZE = 256;
+    static const int SPECULAR_SIZE = 128;
+    // roughness 0 to 1, environment.glsl's SPECULAR_LEVELS
+    static const int SPECULAR_LEVELS = 6;
+    static const int IRRADIANCE_SIZE = 32;
+    static const unsigned int IRRADIANCE_UNIT = 13;
+    static const unsigned int SPECULAR_UNIT = 14;
+    // invocations per group side of the env_*.comp shaders
+    static const int GROUP_SIZE = 8;
+    // bumped whenever the file layout or what the shaders compute changes
+    static const uint32_t VERSION = 1;
+
+    std::string directory;
+
+    EnvironmentMaps(ShaderCompiler &compiler, const std::string &directory = "cache/environment")
+        : directory(directory), compiler(compiler),
+          skyShader(compiler.submit("src/shader_src/skybox.vs", "src/shader_src/skybox.fs")),
+          sampler(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)
+    {
+        emptyVAO = createVertexArray();
+    }
+
+    ~EnvironmentMaps()
+    {
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    EnvironmentMaps(const EnvironmentMaps &) = delete;
+    EnvironmentMaps &operator=(const EnvironmentMaps &) = delete;
+
+    // the maps are computed with image stores into cube maps
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_3;
+    }
+
+    // the maps of sky, from the cache when it was built before
+    void build(const SkyDesc &sky)
+    {
+        // the filtered levels average across the edges of the faces
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+        irradiance.create(IRRADIANCE_SIZE, GL_RGBA16F, 1);
+        specular.create(SPECULAR_SIZE, GL_RGBA16F, SPECULAR_LEVELS);
+        std::string entryPath = path(sky);
+        if (load(entryPath))
+            return;
+        compute(sky);
+        store(entryPath);
+    }
+
+    // points the environment.glsl samplers of program at the maps' units
+    void attach(Shader &program) const
+    {
+        program.use();
+        program.setInt("irradianceMap", IRRADIANCE_UNIT);
+        program.setInt("specularMap", SPECULAR_UNIT);
+    }
+
+    // every frame, the units may have been taken in between
+    void bind() const
+    {
+        irradiance.bind(IRRADIANCE_UNIT);
+        specular.bind(SPECULAR_UNIT);
+        sampler.bind(IRRADIANCE_UNIT);
+        sampler.bind(SPECULAR_UNIT);
+    }
+
+    // the sky where the depth buffer still holds the clear depth, after the opaque draws; the
+    // triangle is at the far plane and passes the test only against the cleared depth itself
+    void drawSky(const glm::mat4 &viewProjection, bool reversedZ)
+    {
+        bind();
+        skyShader.use();
+        if (!inverseViewProjectionLoc.valid())
+        {
+            attach(skyShader);
+            inverseViewProjectionLoc = skyShader.uniform("inverseViewProjection");
+            depthZeroToOneLoc = skyShader.uniform("depthZeroToOne");
+            farDepthLoc = skyShader.uniform("farDepth");
+        }
+        skyShader.set(inverseViewProjectionLoc, glm::inverse(viewProjection));
+        // reversed-Z goes with glClipControl(GL_ZERO_TO_ONE) and a cleared depth of 0
+        skyShader.set(depthZeroToOneLoc, reversedZ);
+        skyShader.set(farDepthLoc, reversedZ ? 0.0f : 1.0f);
+        glState.setDepthFunc(reversedZ ? GL_GEQUAL : GL_LEQUAL);
+        glState.setDepthMask(false);
+        glState.bindVertexArray(emptyVAO);
+        renderStats.countDraw(3);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glState.setDepthMask(true);
+        glState.setDepthFunc(reversedZ ? GL_GREATER : GL_LESS);
+    }
+
+  private:
+    static const uint32_t MAGIC = 0x564e4545; // "EENV"
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t irradianceSize;
+        uint32_t specularSize;
+        uint32_t specularLevels;
+        uint32_t padding;
+    };
+
+    ShaderCompiler &compiler;
+    Shader &skyShader;
+    // submitted on a cache miss only
+    Shader *sourceShader = NULL;
+    Shader *irradianceShader = NULL;
+    Shader *specularShader = NULL;
+    Sampler sampler;
+    TextureCube irradiance;
+    TextureCube specular;
+    unsigned int emptyVAO = 0;
+    UniformHandle inverseViewProjectionLoc, depthZeroToOneLoc, farDepthLoc;
+
+    static size_t faceBytes(int size)
+    {
+        // RGBA16F
+        return (size_t)size * size * 8;
+    }
+
+    size_t entryBytes() const
+    {
+        size_t bytes = sizeof(Header) + faceBytes(IRRADIANCE_SIZE) * TextureCube::FACES;
+        for (int level = 0; level < SPECULAR_LEVELS; level++)
+            bytes += faceBytes(std::max(1, SPECULAR_SIZE >> level)) * TextureCube::FACES;
+        return bytes;
+    }
+
+    std::string path(const SkyDesc &sky) const
+    {
+        const float fields[] = {sky.zenith.x,       sky.zenith.y,       sky.zenith.z,       sky.horizon.x,
+                                sky.horizon.y,      sky.horizon.z,      sky.ground.x,       sky.ground.y,
+                                sky.ground.z,       sky.sunDirection.x, sky.sunDirection.y, sky.sunDirection.z,
+                                sky.sunColor.x,     sky.sunColor.y,     sky.sunColor.z,     sky.sunRadius,
+                                sky.sunGlow,        (float)SOURCE_SIZE};
+        uint64_t key = fnv1a64(fields, sizeof(fields));
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.env", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+
+    bool load(const std::string &entryPath)
+    {
+        std::error_code error;
+        if (!std::filesystem::exists(entryPath, error))
+            return false;
+        std::vector<unsigned char> bytes;
+        if (!readFileContents(entryPath, bytes) || bytes.size() != entryBytes())
+            return false;
+        Header header;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        if (header.magic != MAGIC || header.version != VERSION || header.irradianceSize != IRRADIANCE_SIZE ||
+            header.specularSize != SPECULAR_SIZE || header.specularLevels != SPECULAR_LEVELS)
+            return false;
+        const unsigned char *data = bytes.data() + sizeof(Header);
+        for (int face = 0; face < TextureCube::FACES; face++, data += faceBytes(IRRADIANCE_SIZE))
+            irradiance.upload(face, 0, GL_RGBA, GL_HALF_FLOAT, data);
+        for (int level = 0; level < SPECULAR_LEVELS; level++)
+        {
+            size_t levelBytes = faceBytes(std::max(1, SPECULAR_SIZE >> level));
+            for (int face = 0; face < TextureCube::FACES; face++, data += levelBytes)
+                specular.upload(face, level, GL_RGBA, GL_HALF_FLOAT, data);
+        }
+        return true;
+    }
+
+    void dispatch(const TextureCube &target, int level)
+    {
+        int size = std::max(1, target.size >> level);
+        // layered, the z of the dispatch is the face
+        glBindImageTexture(0, target.ID, level, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glDispatchCompute((size + GROUP_SIZE - 1) / GROUP_SIZE, (size + GROUP_SIZE - 1) / GROUP_SIZE,
+                          TextureCube::FACES);
+    }
+
+    void compute(const SkyDesc &sky)
+    {
+        if (!sourceShader)
+        {
+            sourceShader = &compiler.submitCompute("src/shader_src/env_sky.comp");
+            irradianceShader = &compiler.submitCompute("src/shader_src/env_irradiance.comp");
+            specularShader = &compiler.submitCompute("src/shader_src/env_specular.comp");
+        }
+        TextureCube source;
+        source.create(SOURCE_SIZE, GL_RGBA16F);
+
+        sourceShader->use();
+        sourceShader->setVec3("zenith", sky.zenith);
+        sourceShader->setVec3("horizon", sky.horizon);
+        sourceShader->setVec3("ground", sky.ground);
+        sourceShader->setVec4("sunDirection", glm::vec4(glm::normalize(sky.sunDirection), std::cos(sky.sunRadius)));
+        sourceShader->setVec4("sunColor", glm::vec4(sky.sunColor, sky.sunGlow));
+        dispatch(source, 0);
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        // the coarse levels the filters read instead of many texels
+        source.generateMipmaps();
+        source.bind(0);
+        sampler.bind(0);
+
+        irradianceShader->use();
+        irradianceShader->setFloat("sourceLevel", (float)(Texture2D::mipCount(SOURCE_SIZE, SOURCE_SIZE) -
+                                                          Texture2D::mipCount(IRRADIANCE_SIZE, IRRADIANCE_SIZE)));
+        dispatch(irradiance, 0);
+
+        specularShader->use();
+        for (int level = 0; level < SPECULAR_LEVELS; level++)
+        {
+            specularShader->setFloat("roughness", (float)level / (SPECULAR_LEVELS - 1));
+            dispatch(specular, level);
+        }
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        glState.bindSampler(0, 0);
+    }
+
+    // read back and written aside and renamed, a reader never sees half an entry
+    void store(const std::string &entryPath)
+    {
+        Header header = {};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.irradianceSize = IRRADIANCE_SIZE;
+        header.specularSize = SPECULAR_SIZE;
+        header.specularLevels = SPECULAR_LEVELS;
+        std::vector<unsigned char> bytes(entryBytes());
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        unsigned char *data = bytes.data() + sizeof(Header);
+        for (int face = 0; face < TextureCube::FACES; face++, data += faceBytes(IRRADIANCE_SIZE))
+            irradiance.download(face, 0, GL_RGBA, GL_HALF_FLOAT, faceBytes(IRRADIANCE_SIZE), data);
+        for (int level = 0; level < SPECULAR_LEVELS; level++)
+        {
+            size_t levelBytes = faceBytes(std::max(1, SPECULAR_SIZE >> level));
+            for (int face = 0; face < TextureCube::FACES; face++, data += levelBytes)
+                specular.download(face, level, GL_RGBA, GL_HALF_FLOAT, levelBytes, data);
+        }
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::string temporary = entryPath + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (file)
+                file.write((const char *)bytes.data(), bytes.size());
+            if (!file)
+            {
+                std::cout << "ERROR::ENVIRONMENT_MAPS::COULD_NOT_WRITE: " << entryPath << '\n';
+                return;
+            }
+        }
+        std::filesystem::rename(temporary, entryPath, error);
+        if (error)
+            std::filesystem::remove(temporary, error);
+    }
+};
+
+#endif
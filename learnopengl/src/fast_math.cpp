@@ -0,0 +1,115 @@
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+#include "glm/glm.hpp"
+
+#include "simd_math.cpp"
+
+#include <cmath>
+
+// Math policies for hot updates, passed as a template argument to the code that computes
+// sines, cosines and normalizations. Both have the same static functions, on floats and on
+// 4 lanes at a time:
+//   ExactMath: libm sin/cos and 1 / sqrt, what glm::rotate and glm::normalize do
+//   FastMath:  simdSin()'s polynomial, absolute error below 1e-6 for |x| < 1e4, and the
+//              rsqrtps estimate refined by one Newton step, relative error below 5e-7
+//              (normalized vectors are unit length within 1e-6)
+// --math-benchmark checks FastMath against ExactMath with these bounds.
+//
+// FAST_MATH picks the policy of the camera and the transform system: undefined keeps the
+// exact camera and the polynomial transforms they always had, FAST_MATH=1 makes both fast
+// and FAST_MATH=0 both exact.
+struct ExactMath
+{
+    static void sinCos(float x, float &s, float &c)
+    {
+        s = std::sin(x);
+        c = std::cos(x);
+    }
+
+    static float rsqrt(float x)
+    {
+        return 1.0f / std::sqrt(x);
+    }
+
+    static glm::vec3 normalize(const glm::vec3 &v)
+    {
+        return glm::normalize(v);
+    }
+
+#if SIMD_SSE2
+    static void sinCos4(__m128 x, __m128 &s, __m128 &c)
+    {
+        alignas(16) float angles[4], sines[4], cosines[4];
+        _mm_store_ps(angles, x);
+        for (int i = 0; i < 4; i++)
+            sinCos(angles[i], sines[i], cosines[i]);
+        s = _mm_load_ps(sines);
+        c = _mm_load_ps(cosines);
+    }
+
+    static __m128 rsqrt4(__m128 x)
+    {
+        return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(x));
+    }
+#endif
+};
+
+struct FastMath
+{
+#if SIMD_SSE2
+    static void sinCos4(__m128 x, __m128 &s, __m128 &c)
+    {
+        simdSinCos(x, s, c);
+    }
+
+    // y = y * (1.5 - 0.5 * x * y * y) squares the estimate's 1.5 * 2^-12 relative error
+    static __m128 rsqrt4(__m128 x)
+    {
+        __m128 y = _mm_rsqrt_ps(x);
+        __m128 halfX = _mm_mul_ps(x, _mm_set1_ps(0.5f));
+        return _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(halfX, _mm_mul_ps(y, y))));
+    }
+
+    static void sinCos(float x, float &s, float &c)
+    {
+        __m128 sines, cosines;
+        simdSinCos(_mm_set_ss(x), sines, cosines);
+        s = _mm_cvtss_f32(sines);
+        c = _mm_cvtss_f32(cosines);
+    }
+
+    static float rsqrt(float x)
+    {
+        return _mm_cvtss_f32(rsqrt4(_mm_set_ss(x)));
+    }
+#else
+    static void sinCos(float x, float &s, float &c)
+    {
+        ExactMath::sinCos(x, s, c);
+    }
+
+    static float rsqrt(float x)
+    {
+        return ExactMath::rsqrt(x);
+    }
+#endif
+
+    static glm::vec3 normalize(const glm::vec3 &v)
+    {
+        return v * rsqrt(glm::dot(v, v));
+    }
+};
+
+#if !defined(FAST_MATH)
+using CameraMath = ExactMath;
+using TransformMath = FastMath;
+#elif FAST_MATH
+using CameraMath = FastMath;
+using TransformMath = FastMath;
+#else
+using CameraMath = ExactMath;
+using TransformMath = ExactMath;
+#endif
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+// glad defines APIENTRY the same way windows.h does
+#undef APIENTRY
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Reports files that were written in a set of directories (not recursive), through
+// inotify or ReadDirectoryChangesW. poll() never blocks, it is meant to be called once a
+// frame. A file is only reported after it has been quiet for settleMilliseconds, editors
+// write in several steps and the first event often comes before the file is complete.
+class FileWatcher
+{
+  public:
+    double settleMilliseconds = 100.0;
+
+    FileWatcher()
+    {
+    }
+
+    ~FileWatcher()
+    {
+        close();
+    }
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    // paths are reported as directory + "/" + file name
+    bool watch(const std::string &directory)
+    {
+#ifdef _WIN32
+        Directory *entry = new Directory();
+        entry->path = directory;
+        entry->handle = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                                    FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+        if (entry->handle == INVALID_HANDLE_VALUE)
+        {
+            delete entry;
+            return fail(directory);
+        }
+        entry->overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+        directories.push_back(entry);
+        return request(*entry) || fail(directory);
+#else
+        if (descriptor < 0)
+            descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (descriptor < 0)
+            return fail(directory);
+        // written in place or saved through a rename, both end up as one of these
+        int watchDescriptor = inotify_add_watch(descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (watchDescriptor < 0)
+            return fail(directory);
+        directories[watchDescriptor] = directory;
+        return true;
+#endif
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        for (Directory *entry : directories)
+        {
+            CancelIo(entry->handle);
+            CloseHandle(entry->handle);
+            CloseHandle(entry->overlapped.hEvent);
+            delete entry;
+        }
+        directories.clear();
+#else
+        if (descriptor >= 0)
+            ::close(descriptor);
+        descriptor = -1;
+        directories.clear();
+#endif
+        changed.clear();
+    }
+
+    // files whose last change settled since the previous call, each reported once
+    std::vector<std::string> poll()
+    {
+        Clock::time_point now = Clock::now();
+        readEvents(now);
+        std::vector<std::string> settled;
+        for (auto it = changed.begin(); it != changed.end();)
+        {
+            if (std::chrono::duration<double, std::milli>(now - it->second).count() >= settleMilliseconds)
+            {
+                settled.push_back(it->first);
+                it = changed.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        return settled;
+    }
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+    // path to the time of its latest event
+    std::map<std::string, Clock::time_point> changed;
+
+#ifdef _WIN32
+    struct Directory
+    {
+        std::string path;
+        HANDLE handle = INVALID_HANDLE_VALUE;
+        OVERLAPPED overlapped = {};
+        // ReadDirectoryChangesW wants DWORD alignment
+        DWORD buffer[4096];
+    };
+    // heap allocated, the pending read keeps pointers into each entry
+    std::vector<Directory *> directories;
+
+    bool request(Directory &entry)
+    {
+        return ReadDirectoryChangesW(entry.handle, entry.buffer, sizeof(entry.buffer), FALSE,
+                                     FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, NULL,
+                                     &entry.overlapped, NULL) != 0;
+    }
+
+    void readEvents(Clock::time_point now)
+    {
+        for (Directory *entry : directories)
+        {
+            DWORD bytes = 0;
+            if (!GetOverlappedResult(entry->handle, &entry->overlapped, &bytes, FALSE))
+                continue;
+            // bytes is 0 when the buffer overflowed, the changes are lost then
+            const unsigned char *event = (const unsigned char *)entry->buffer;
+            while (bytes > 0)
+            {
+                const FILE_NOTIFY_INFORMATION *info = (const FILE_NOTIFY_INFORMATION *)event;
+                if (info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_ADDED ||
+                    info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+                {
+                    int wideLength = (int)(info->FileNameLength / sizeof(WCHAR));
+                    int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, wideLength, NULL, 0, NULL, NULL);
+                    std::string name(length, '\0');
+                    WideCharToMultiByte(CP_UTF8, 0, info->FileName, wideLength, &name[0], length, NULL, NULL);
+                    changed[entry->path + "/" + name] = now;
+                }
+                if (info->NextEntryOffset == 0)
+                    break;
+                event += info->NextEntryOffset;
+            }
+            ResetEvent(entry->overlapped.hEvent);
+            request(*entry);
+        }
+    }
+#else
+    int descriptor = -1;
+    std::map<int, std::string> directories;
+
+    void readEvents(Clock::time_point now)
+    {
+        if (descriptor < 0)
+            return;
+        alignas(inotify_event) char buffer[4096];
+        ssize_t bytes;
+        while ((bytes = read(descriptor, buffer, sizeof(buffer))) > 0)
+        {
+            for (char *event = buffer; event < buffer + bytes;)
+            {
+                const inotify_event *info = (const inotify_event *)event;
+                auto directory = directories.find(info->wd);
+                if (info->len > 0 && directory != directories.end())
+                    changed[directory->second + "/" + info->name] = now;
+                event += sizeof(inotify_event) + info->len;
+            }
+        }
+    }
+#endif
+
+    bool fail(const std::string &directory)
+    {
+        std::cout << "ERROR::FILE_WATCHER::COULD_NOT_WATCH: " << directory << '\n';
+        return false;
+    }
+};
+
+#endif
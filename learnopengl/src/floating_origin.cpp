@@ -0,0 +1,52 @@
+#ifndef FLOATING_ORIGIN_H
+#define FLOATING_ORIGIN_H
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+// The point a large world is drawn relative to. World positions are doubles (TransformSystem
+// keeps them so), the camera and everything the GPU gets are floats relative to origin, which
+// keeps their precision near the camera however far from 0 it is. Once the camera is more than
+// rebaseDistance from the origin on an axis, recenter() moves the origin under it by whole
+// multiples of rebaseDistance, so the camera's own float position moves exactly, and the
+// caller moves what else it holds relative to the origin by -shift. A move is a cut for the
+// temporal effects, their history is one frame off, rebaseDistance keeps them rare.
+class FloatingOrigin
+{
+  public:
+    glm::dvec3 origin = glm::dvec3(0.0);
+    double rebaseDistance = 1024.0;
+    // what the last recenter() moved the origin by
+    glm::vec3 shift = glm::vec3(0.0f);
+    size_t rebases = 0;
+
+    glm::dvec3 toWorld(const glm::vec3 &relative) const
+    {
+        return origin + glm::dvec3(relative);
+    }
+
+    glm::vec3 toRelative(const glm::dvec3 &world) const
+    {
+        return glm::vec3(world - origin);
+    }
+
+    // false when camera, relative to the origin, is close enough to it; otherwise moves the
+    // origin next to it and camera by the same, and returns true
+    bool recenter(glm::vec3 &camera)
+    {
+        glm::dvec3 relative(camera);
+        glm::dvec3 reach = glm::abs(relative);
+        if (std::max(reach.x, std::max(reach.y, reach.z)) <= rebaseDistance)
+            return false;
+        glm::dvec3 step = glm::round(relative / rebaseDistance) * rebaseDistance;
+        origin += step;
+        shift = glm::vec3(step);
+        camera -= shift;
+        rebases++;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include "huge_pages.cpp"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <vector>
+
+// Linear allocator for data that lives one frame, split into FRAMES regions used in turn
+// like RingBuffer's, so what a frame allocated still holds while the render thread replays
+// it and the next frames record. beginFrame() frees the region in O(1): nothing is destroyed,
+// only trivially destructible data (or data whose destructor doesn't matter) belongs here.
+// A frame that outgrows its region spills into heap blocks, and the region is reallocated
+// to the frame's whole size at its next beginFrame(), so once every region has seen the
+// largest frame the loop doesn't touch the heap. With --huge-pages a large region is a block
+// of huge pages (see huge_pages.cpp) so walking it doesn't miss the TLB every 4 KB.
+class FrameArena
+{
+  public:
+    static const unsigned int FRAMES = 3;
+
+    // bytes spilled into heap blocks since the last beginFrame() of the current region
+    size_t spilled = 0;
+
+    FrameArena(size_t bytesPerFrame = 256 * 1024)
+    {
+        for (Region &region : regions)
+            region.resize(bytesPerFrame);
+    }
+
+    ~FrameArena()
+    {
+        for (Region &region : regions)
+        {
+            region.releaseSpills();
+            hugePages.free(region.memory);
+        }
+    }
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    // moves to the next region and frees everything allocated in it FRAMES frames ago
+    void beginFrame()
+    {
+        current = (current + 1) % FRAMES;
+        Region &region = regions[current];
+        if (!region.spills.empty())
+        {
+            // grown to what the frame needed in all, for the next time around
+            size_t needed = region.head + region.spilledBytes;
+            region.releaseSpills();
+            region.resize(needed + needed / 4);
+        }
+        region.head = 0;
+        spilled = 0;
+    }
+
+    // size bytes aligned to alignment (a power of two), valid until this region comes around again
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        Region &region = regions[current];
+        size_t offset = (region.head + alignment - 1) & ~(alignment - 1);
+        if (offset + size <= region.capacity)
+        {
+            region.head = offset + size;
+            return region.memory + offset;
+        }
+        // over this frame's region, the extra goes into a block of its own
+        void *block = std::malloc(size + alignment);
+        if (!block)
+            throw std::bad_alloc();
+        region.spills.push_back(block);
+        region.spilledBytes += size + alignment;
+        spilled += size;
+        size_t address = ((size_t)block + alignment - 1) & ~(alignment - 1);
+        return (void *)address;
+    }
+
+    // count uninitialized Ts
+    template <typename T> T *allocateArray(size_t count)
+    {
+        return (T *)allocate(sizeof(T) * count, alignof(T));
+    }
+
+    // printf into the arena, the view stays valid like any other allocation
+    std::string_view format(const char *pattern, ...)
+    {
+        va_list arguments;
+        va_start(arguments, pattern);
+        va_list measure;
+        va_copy(measure, arguments);
+        int length = std::vsnprintf(NULL, 0, pattern, measure);
+        va_end(measure);
+        if (length < 0)
+        {
+            va_end(arguments);
+            return std::string_view();
+        }
+        char *text = allocateArray<char>((size_t)length + 1);
+        std::vsnprintf(text, (size_t)length + 1, pattern, arguments);
+        va_end(arguments);
+        return std::string_view(text, (size_t)length);
+    }
+
+    // bytes the current frame allocated so far, spills included
+    size_t used() const
+    {
+        return regions[current].head + spilled;
+    }
+
+  private:
+    struct Region
+    {
+        unsigned char *memory = NULL;
+        size_t capacity = 0;
+        size_t head = 0;
+        // heap blocks of the frame that overflowed, freed at the region's next beginFrame()
+        std::vector<void *> spills;
+        size_t spilledBytes = 0;
+
+        void resize(size_t bytes)
+        {
+            hugePages.free(memory);
+            // rounded up to whole pages when they are huge
+            memory = (unsigned char *)hugePages.allocate(bytes, &capacity);
+        }
+
+        void releaseSpills()
+        {
+            for (void *block : spills)
+                std::free(block);
+            // keeps its capacity, the next overflow doesn't reallocate the list
+            spills.clear();
+            spilledBytes = 0;
+        }
+    };
+
+    Region regions[FRAMES];
+    unsigned int current = 0;
+};
+
+// STL allocator over a FrameArena: deallocate does nothing, a container's memory goes back
+// with its frame. Containers must not outlive the region they were filled in, and growing
+// one leaves its older buffers behind in the arena, so reserve() what is known up front.
+template <typename T> class FrameAllocator
+{
+  public:
+    using value_type = T;
+
+    FrameArena *arena;
+
+    FrameAllocator(FrameArena &arena) noexcept : arena(&arena)
+    {
+    }
+
+    template <typename U> FrameAllocator(const FrameAllocator<U> &other) noexcept : arena(other.arena)
+    {
+    }
+
+    T *allocate(size_t count)
+    {
+        return arena->allocateArray<T>(count);
+    }
+
+    void deallocate(T *, size_t) noexcept
+    {
+    }
+
+    template <typename U> bool operator==(const FrameAllocator<U> &other) const noexcept
+    {
+        return arena == other.arena;
+    }
+
+    template <typename U> bool operator!=(const FrameAllocator<U> &other) const noexcept
+    {
+        return arena != other.arena;
+    }
+};
+
+// a vector of the frame, e.g. FrameVector<uint32_t> visible{FrameAllocator<uint32_t>(arena)}
+template <typename T> using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+#endif
@@ -0,0 +1,290 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+#include "gl_objects.cpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records the frames into a raw Y4M video (YUV 4:2:0, BT.601) without stalling the frame.
+// capture() queues a glReadPixels of the finished frame into one of DEPTH pixel pack buffers
+// with a fence behind it and takes the buffer filled DEPTH - 1 frames earlier, which the GPU
+// is long done with: its RGBA pixels are copied out and handed to an encoder thread that
+// converts and writes them, so the frame only pays for the copy.
+// Only when the oldest copy still isn't finished by the time its buffer comes round again
+// does capture() wait for it. When the encoder falls more than MAX_QUEUED frames behind, new
+// frames are dropped rather than queued. The first frame sets the size of the video, frames
+// of another size (after a resize) are dropped too.
+class FrameCapture
+{
+  public:
+    static const unsigned int DEPTH = 3;
+    static const size_t MAX_QUEUED = 8;
+
+    // frames written, dropped and the waits for a copy that wasn't done
+    unsigned long frames = 0;
+    unsigned long dropped = 0;
+    unsigned long stalls = 0;
+    // CPU time capture() took, all frames
+    double captureSeconds = 0.0;
+
+    FrameCapture()
+    {
+    }
+
+    ~FrameCapture()
+    {
+        stop();
+    }
+
+    FrameCapture(const FrameCapture &) = delete;
+    FrameCapture &operator=(const FrameCapture &) = delete;
+
+    bool recording() const
+    {
+        return file != NULL;
+    }
+
+    // opens path for a video of framesPerSecond, false when it can't be written
+    bool start(const std::string &path, int framesPerSecond)
+    {
+        stop();
+        file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            std::cout << "ERROR::FRAME_CAPTURE::OPEN: " << path << '\n';
+            return false;
+        }
+        fps = framesPerSecond > 0 ? framesPerSecond : 60;
+        width = height = 0;
+        frames = dropped = stalls = 0;
+        captureSeconds = 0.0;
+        stopping = false;
+        encoder = std::thread(&FrameCapture::encodeLoop, this);
+        return true;
+    }
+
+    // after the frame is drawn into framebuffer (0 for the window's back buffer), before the swap
+    void capture(unsigned int framebuffer, int frameWidth, int frameHeight)
+    {
+        if (!file || frameWidth <= 0 || frameHeight <= 0)
+            return;
+        double start = glfwGetTime();
+        if (width == 0)
+        {
+            width = frameWidth;
+            height = frameHeight;
+            for (unsigned int i = 0; i < DEPTH; i++)
+                buffers[i] = createBuffer(bytes(), NULL, GL_MAP_READ_BIT, GL_STREAM_READ);
+        }
+        unsigned int next = (current + 1) % DEPTH;
+        if (fences[next])
+            collect(next, true);
+        current = next;
+        if (frameWidth != width || frameHeight != height)
+        {
+            dropped++;
+        }
+        else
+        {
+            GLint savedRead = 0;
+            glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &savedRead);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+            if (framebuffer == 0)
+                glReadBuffer(GL_BACK);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[current]);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, (unsigned int)savedRead);
+            fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        // the copies queued in between that are done already, oldest first
+        for (unsigned int k = 1; k < DEPTH; k++)
+        {
+            unsigned int i = (current + k) % DEPTH;
+            if (fences[i] && !collect(i, false))
+                break;
+        }
+        captureSeconds += glfwGetTime() - start;
+    }
+
+    // waits for the copies in flight and the encoder, then closes the file
+    void stop()
+    {
+        if (!file)
+            return;
+        for (unsigned int k = 1; k <= DEPTH; k++)
+        {
+            unsigned int i = (current + k) % DEPTH;
+            if (fences[i])
+                collect(i, true);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        encoder.join();
+        std::fclose(file);
+        file = NULL;
+        if (width)
+            deleteBuffers(DEPTH, buffers);
+        for (unsigned int i = 0; i < DEPTH; i++)
+            buffers[i] = 0;
+        queued.clear();
+        spare.clear();
+    }
+
+  private:
+    std::FILE *file = NULL;
+    int fps = 60;
+    int width = 0, height = 0;
+    unsigned int buffers[DEPTH] = {};
+    GLsync fences[DEPTH] = {};
+    unsigned int current = 0;
+
+    // written by capture(), converted and written out by the encoder
+    std::thread encoder;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::vector<unsigned char>> queued;
+    // buffers the encoder is done with, so the frames don't allocate
+    std::vector<std::vector<unsigned char>> spare;
+    bool stopping = false;
+
+    size_t bytes() const
+    {
+        return (size_t)width * height * 4;
+    }
+
+    // hands buffer index to the encoder once its copy is done, false when it isn't and wait is off
+    bool collect(unsigned int index, bool wait)
+    {
+        GLenum state = glClientWaitSync(fences[index], 0, 0);
+        if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+        {
+            if (!wait)
+                return false;
+            stalls++;
+            glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        }
+        glDeleteSync(fences[index]);
+        fences[index] = NULL;
+
+        std::vector<unsigned char> pixels;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queued.size() >= MAX_QUEUED)
+            {
+                dropped++;
+                return true;
+            }
+            if (!spare.empty())
+            {
+                pixels.swap(spare.back());
+                spare.pop_back();
+            }
+        }
+        const void *mapped = mapBuffer(buffers[index], 0, bytes(), GL_MAP_READ_BIT);
+        if (!mapped)
+            return true;
+        pixels.resize(bytes());
+        std::memcpy(pixels.data(), mapped, bytes());
+        unmapBuffer(buffers[index]);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.push_back(std::move(pixels));
+        }
+        wake.notify_one();
+        return true;
+    }
+
+    void encodeLoop()
+    {
+        bool header = false;
+        std::vector<unsigned char> planes;
+        while (true)
+        {
+            std::vector<unsigned char> pixels;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !queued.empty(); });
+                if (queued.empty())
+                    break;
+                pixels.swap(queued.front());
+                queued.pop_front();
+            }
+            if (!header)
+            {
+                std::fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+                header = true;
+            }
+            convert(pixels.data(), planes);
+            std::fputs("FRAME\n", file);
+            std::fwrite(planes.data(), 1, planes.size(), file);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                frames++;
+                spare.push_back(std::move(pixels));
+            }
+        }
+    }
+
+    // bottom up RGBA to top down Y, U and V planes, the chroma averaged over 2x2 pixels
+    void convert(const unsigned char *rgba, std::vector<unsigned char> &planes) const
+    {
+        int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+        size_t lumaSize = (size_t)width * height, chromaSize = (size_t)chromaWidth * chromaHeight;
+        planes.resize(lumaSize + 2 * chromaSize);
+        unsigned char *y = planes.data(), *u = y + lumaSize, *v = u + chromaSize;
+        for (int row = 0; row < height; row++)
+        {
+            const unsigned char *source = rgba + (size_t)(height - 1 - row) * width * 4;
+            for (int x = 0; x < width; x++, source += 4)
+            {
+                int luma = 66 * source[0] + 129 * source[1] + 25 * source[2];
+                y[(size_t)row * width + x] = (unsigned char)(((luma + 128) >> 8) + 16);
+            }
+        }
+        for (int row = 0; row < chromaHeight; row++)
+        {
+            for (int x = 0; x < chromaWidth; x++)
+            {
+                int r = 0, g = 0, b = 0, count = 0;
+                for (int dy = 0; dy < 2; dy++)
+                {
+                    int sourceRow = std::min(row * 2 + dy, height - 1);
+                    for (int dx = 0; dx < 2; dx++)
+                    {
+                        int sourceX = std::min(x * 2 + dx, width - 1);
+                        const unsigned char *p = rgba + ((size_t)(height - 1 - sourceRow) * width + sourceX) * 4;
+                        r += p[0];
+                        g += p[1];
+                        b += p[2];
+                        count++;
+                    }
+                }
+                r /= count;
+                g /= count;
+                b /= count;
+                // offset by 128 * 256 before the shift, so it never shifts a negative sum
+                u[(size_t)row * chromaWidth + x] = (unsigned char)((-38 * r - 74 * g + 112 * b + 32896) >> 8);
+                v[(size_t)row * chromaWidth + x] = (unsigned char)((112 * r - 94 * g - 18 * b + 32896) >> 8);
+            }
+        }
+    }
+};
+
+#endif
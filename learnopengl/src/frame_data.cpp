@@ -0,0 +1,64 @@
+#ifndef FRAME_DATA_H
+#define FRAME_DATA_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "block_layout.cpp"
+#include "gl_state.cpp"
+#include "ring_buffer.cpp"
+
+// Per-frame camera data shared by every program through one uniform buffer,
+// uploaded once per frame instead of once per program.
+// Mirrors the std140 layout of the FrameData block in shader_src/frame_data.glsl.
+struct FrameData
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    // w is unused
+    glm::vec4 cameraPosition;
+    float time;
+    float padding[3];
+};
+static_assert(sizeof(FrameData) == 224, "FrameData must match the std140 block layout");
+
+// the members of the block, checked against the program with checkBlockLayout() (see block_layout.cpp)
+constexpr BlockMember FRAME_DATA_LAYOUT[] = {
+    BLOCK_MEMBER(FrameData, view, GL_FLOAT_MAT4),           BLOCK_MEMBER(FrameData, projection, GL_FLOAT_MAT4),
+    BLOCK_MEMBER(FrameData, viewProjection, GL_FLOAT_MAT4), BLOCK_MEMBER(FrameData, cameraPosition, GL_FLOAT_VEC4),
+    BLOCK_MEMBER(FrameData, time, GL_FLOAT),
+};
+static_assert(blockLayoutMismatch(FRAME_DATA_LAYOUT, STD140) == -1, "FrameData members are not where std140 puts them");
+static_assert(blockLayoutSize(FRAME_DATA_LAYOUT, STD140) == sizeof(FrameData), "FrameData is not padded like std140");
+
+// the block is written into the frame's RingBuffer region and bound from there, a block the
+// same as one already written this frame is bound where it is
+class FrameDataBuffer
+{
+  public:
+    // fixed uniform buffer binding point of the FrameData block
+    static const unsigned int BINDING = 0;
+
+    FrameDataBuffer(RingBuffer &ring) : ring(ring)
+    {
+    }
+
+    FrameDataBuffer(const FrameDataBuffer &) = delete;
+    FrameDataBuffer &operator=(const FrameDataBuffer &) = delete;
+
+    // fills in viewProjection and uploads the whole block, once per frame after RingBuffer::beginFrame()
+    void update(FrameData &data)
+    {
+        data.viewProjection = data.projection * data.view;
+        GLintptr offset = ring.pushUnique(&data, sizeof(FrameData), ring.uniformAlignment, pushed);
+        if (offset >= 0)
+            glState.bindBufferRange(GL_UNIFORM_BUFFER, BINDING, ring.ID, offset, sizeof(FrameData));
+    }
+
+  private:
+    RingBuffer &ring;
+    RingBuffer::PushCache pushed;
+};
+
+#endif
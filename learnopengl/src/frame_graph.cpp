@@ -0,0 +1,434 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "gl_objects.cpp"
+#include "gpu_profiler.cpp"
+#include "render_stats.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Color targets handed out for one use and given back afterwards, a released target is the
+// next acquire() of the same size and format, so passes that follow each other share a
+// handful of textures instead of owning one each. Targets nobody asked for in
+// UNUSED_FRAMES frames (e.g. of the size before a resize) are deleted by endFrame().
+class RenderTargetPool
+{
+  public:
+    static const uint64_t UNUSED_FRAMES = 60;
+
+    struct Target
+    {
+        Texture2D color;
+        unsigned int FBO = 0;
+        int width = 0, height = 0;
+        GLenum format = 0;
+        bool inUse = false;
+        uint64_t lastUsed = 0;
+    };
+
+    RenderTargetPool()
+    {
+    }
+
+    ~RenderTargetPool()
+    {
+        for (std::unique_ptr<Target> &target : targets)
+            glDeleteFramebuffers(1, &target->FBO);
+    }
+
+    RenderTargetPool(const RenderTargetPool &) = delete;
+    RenderTargetPool &operator=(const RenderTargetPool &) = delete;
+
+    // a free target of that size and format, created when there is none; NULL when incomplete
+    Target *acquire(int width, int height, GLenum format)
+    {
+        for (std::unique_ptr<Target> &target : targets)
+        {
+            if (!target->inUse && target->width == width && target->height == height && target->format == format)
+            {
+                target->inUse = true;
+                target->lastUsed = frame;
+                return target.get();
+            }
+        }
+
+        std::unique_ptr<Target> target = std::make_unique<Target>();
+        target->width = width;
+        target->height = height;
+        target->format = format;
+        target->color.create(width, height, format, 1, GPU_MEMORY_RENDER_TARGETS);
+        target->FBO = createFramebuffer();
+        GLenum status;
+        if (hasDSA())
+        {
+            glNamedFramebufferTexture(target->FBO, GL_COLOR_ATTACHMENT0, target->color.ID, 0);
+            status = glCheckNamedFramebufferStatus(target->FBO, GL_FRAMEBUFFER);
+        }
+        else
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, target->FBO);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->color.ID, 0);
+            status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::RENDER_TARGET_POOL::INCOMPLETE: 0x" << std::hex << status << std::dec << '\n';
+            glDeleteFramebuffers(1, &target->FBO);
+            return NULL;
+        }
+        target->inUse = true;
+        target->lastUsed = frame;
+        targets.push_back(std::move(target));
+        return targets.back().get();
+    }
+
+    void release(Target *target)
+    {
+        if (target)
+            target->inUse = false;
+    }
+
+    // deletes the targets that went unused for UNUSED_FRAMES
+    void endFrame()
+    {
+        frame++;
+        targets.erase(std::remove_if(targets.begin(), targets.end(),
+                                     [this](std::unique_ptr<Target> &target) {
+                                         if (target->inUse || frame - target->lastUsed < UNUSED_FRAMES)
+                                             return false;
+                                         glDeleteFramebuffers(1, &target->FBO);
+                                         return true;
+                                     }),
+                      targets.end());
+    }
+
+    size_t size() const
+    {
+        return targets.size();
+    }
+
+    // bytes of all targets, see RenderStats::storageBytes()
+    uint64_t bytes() const
+    {
+        uint64_t total = 0;
+        for (const std::unique_ptr<Target> &target : targets)
+            total += RenderStats::storageBytes(target->format, target->width, target->height, 1, 1);
+        return total;
+    }
+
+  private:
+    std::vector<std::unique_ptr<Target>> targets;
+    uint64_t frame = 0;
+};
+
+// how a pass touches a resource
+enum FrameGraphAccess
+{
+    // read through a sampler
+    FRAME_GRAPH_SAMPLED,
+    // imageLoad() / imageStore()
+    FRAME_GRAPH_IMAGE_READ,
+    FRAME_GRAPH_IMAGE_WRITE,
+    // drawn into as the color attachment, the graph binds its framebuffer and viewport
+    FRAME_GRAPH_COLOR,
+};
+
+// The passes of a frame and the textures they read and write, declared anew every frame and
+// run by execute() in the order they were added. compile() works out from the declarations:
+// - which passes to skip: a pass whose outputs nobody reads is culled, and the passes that
+//   only fed it after it, unless it writes an imported resource (the window, the frame)
+// - the lifetime of each transient texture, from the first to the last pass that runs and
+//   touches it. A texture only exists as a RenderTargetPool target over that span, the
+//   target is free for the next texture of the same size and format afterwards, so
+//   transients that never live at once alias one texture and the memory grows with the
+//   widest point of the frame instead of with the number of passes
+// - the memory barriers: writes with imageStore() are incoherent, the first later pass that
+//   samples, loads or draws into that texture gets the one glMemoryBarrier() bit it needs,
+//   issued once for all of them. Framebuffer writes read by sampling need none in GL.
+class FrameGraph
+{
+  public:
+    typedef int Resource;
+    typedef size_t Pass;
+
+    // stats of the last compile()
+    size_t passCount = 0, culledPasses = 0;
+    size_t transientTextures = 0;
+    size_t barriers = 0;
+
+    // a texture that only lives within the frame
+    Resource createTexture(const std::string &name, int width, int height, GLenum format)
+    {
+        ResourceNode resource;
+        resource.name = name;
+        resource.width = std::max(1, width);
+        resource.height = std::max(1, height);
+        resource.format = format;
+        resources.push_back(resource);
+        return (Resource)resources.size() - 1;
+    }
+
+    // a texture from outside, writable as a color target through fbo when that isn't 0
+    Resource importTexture(const std::string &name, const Texture2D &texture, unsigned int fbo = 0)
+    {
+        ResourceNode resource;
+        resource.name = name;
+        resource.width = texture.width;
+        resource.height = texture.height;
+        resource.imported = true;
+        resource.texture = &texture;
+        resource.FBO = fbo;
+        resources.push_back(resource);
+        return (Resource)resources.size() - 1;
+    }
+
+    // a framebuffer without a texture to read, e.g. the window's 0
+    Resource importFramebuffer(const std::string &name, unsigned int fbo, int width, int height)
+    {
+        ResourceNode resource;
+        resource.name = name;
+        resource.width = width;
+        resource.height = height;
+        resource.imported = true;
+        resource.FBO = fbo;
+        resources.push_back(resource);
+        return (Resource)resources.size() - 1;
+    }
+
+    // the function runs in execute() with the pass's framebuffer bound, the accesses are declared with read() / write()
+    Pass addPass(const std::string &name, std::function<void(FrameGraph &)> function)
+    {
+        PassNode pass;
+        pass.name = name;
+        pass.function = std::move(function);
+        passes.push_back(std::move(pass));
+        return passes.size() - 1;
+    }
+
+    void read(Pass pass, Resource resource, FrameGraphAccess access = FRAME_GRAPH_SAMPLED)
+    {
+        passes[pass].reads.push_back({resource, access});
+    }
+
+    void write(Pass pass, Resource resource, FrameGraphAccess access = FRAME_GRAPH_COLOR)
+    {
+        passes[pass].writes.push_back({resource, access});
+    }
+
+    // culls, places the lifetimes and the barriers, after the last pass is declared
+    void compile()
+    {
+        passCount = passes.size();
+        culledPasses = 0;
+        transientTextures = 0;
+        barriers = 0;
+
+        // a pass stays while something outside or a staying pass reads what it writes
+        std::vector<Resource> unread;
+        for (PassNode &pass : passes)
+        {
+            pass.references = pass.writes.size();
+            for (const Access &access : pass.writes)
+            {
+                if (resources[access.resource].imported)
+                    pass.sideEffect = true;
+                resources[access.resource].writers.push_back(&pass - passes.data());
+            }
+            for (const Access &access : pass.reads)
+                resources[access.resource].readers++;
+        }
+        for (size_t i = 0; i < resources.size(); i++)
+        {
+            if (resources[i].readers == 0 && !resources[i].imported)
+                unread.push_back((Resource)i);
+        }
+        while (!unread.empty())
+        {
+            ResourceNode &resource = resources[unread.back()];
+            unread.pop_back();
+            for (Pass writer : resource.writers)
+            {
+                PassNode &pass = passes[writer];
+                if (pass.culled || pass.sideEffect || --pass.references > 0)
+                    continue;
+                pass.culled = true;
+                culledPasses++;
+                for (const Access &access : pass.reads)
+                {
+                    ResourceNode &input = resources[access.resource];
+                    if (--input.readers == 0 && !input.imported)
+                        unread.push_back(access.resource);
+                }
+            }
+        }
+
+        // lifetimes and the barrier bits over the passes that run
+        std::vector<GLbitfield> pending(resources.size(), 0);
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            PassNode &pass = passes[i];
+            if (pass.culled)
+                continue;
+            for (const std::vector<Access> *accesses : {&pass.reads, &pass.writes})
+            {
+                for (const Access &access : *accesses)
+                {
+                    ResourceNode &resource = resources[access.resource];
+                    if (resource.first < 0)
+                        resource.first = (int)i;
+                    resource.last = (int)i;
+                    pass.barrier |= pending[access.resource] & barrierBit(access.access);
+                }
+            }
+            if (pass.barrier)
+            {
+                // one barrier covers the earlier writes of every resource
+                for (GLbitfield &bits : pending)
+                    bits &= ~pass.barrier;
+                barriers++;
+            }
+            for (const Access &access : pass.writes)
+            {
+                if (access.access == FRAME_GRAPH_IMAGE_WRITE)
+                    pending[access.resource] = GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT |
+                                               GL_FRAMEBUFFER_BARRIER_BIT;
+            }
+        }
+        for (const ResourceNode &resource : resources)
+        {
+            if (!resource.imported && resource.first >= 0)
+                transientTextures++;
+        }
+        compiled = true;
+    }
+
+    // runs the passes that weren't culled and forgets the frame's declarations
+    void execute(GpuProfiler &profiler)
+    {
+        if (!compiled)
+            compile();
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            PassNode &pass = passes[i];
+            if (pass.culled)
+                continue;
+            for (ResourceNode &resource : resources)
+            {
+                if (!resource.imported && resource.first == (int)i)
+                    resource.target = pool.acquire(resource.width, resource.height, resource.format);
+            }
+            if (pass.barrier)
+                glMemoryBarrier(pass.barrier);
+            for (const Access &access : pass.writes)
+            {
+                if (access.access != FRAME_GRAPH_COLOR)
+                    continue;
+                const ResourceNode &resource = resources[access.resource];
+                glBindFramebuffer(GL_FRAMEBUFFER, resource.target ? resource.target->FBO : resource.FBO);
+                glViewport(0, 0, resource.width, resource.height);
+                break;
+            }
+
+            profiler.begin(pass.name.c_str());
+            pass.function(*this);
+            profiler.end();
+
+            for (ResourceNode &resource : resources)
+            {
+                if (!resource.imported && resource.last == (int)i)
+                {
+                    pool.release(resource.target);
+                    resource.target = NULL;
+                }
+            }
+        }
+        pool.endFrame();
+        passes.clear();
+        resources.clear();
+        compiled = false;
+    }
+
+    // the texture of a resource, valid inside the passes that declared it
+    const Texture2D *texture(Resource resource) const
+    {
+        const ResourceNode &node = resources[resource];
+        return node.target ? &node.target->color : node.texture;
+    }
+
+    glm::ivec2 size(Resource resource) const
+    {
+        return glm::ivec2(resources[resource].width, resources[resource].height);
+    }
+
+    // the textures behind the transients, they outlive the frames
+    const RenderTargetPool &targets() const
+    {
+        return pool;
+    }
+
+  private:
+    struct Access
+    {
+        Resource resource;
+        FrameGraphAccess access;
+    };
+    struct PassNode
+    {
+        std::string name;
+        std::function<void(FrameGraph &)> function;
+        std::vector<Access> reads, writes;
+        size_t references = 0;
+        bool sideEffect = false;
+        bool culled = false;
+        GLbitfield barrier = 0;
+    };
+    struct ResourceNode
+    {
+        std::string name;
+        int width = 0, height = 0;
+        GLenum format = 0;
+        bool imported = false;
+        const Texture2D *texture = NULL;
+        unsigned int FBO = 0;
+        std::vector<Pass> writers;
+        size_t readers = 0;
+        // passes of the lifetime, -1 when no pass that runs touches it
+        int first = -1, last = -1;
+        RenderTargetPool::Target *target = NULL;
+    };
+
+    std::vector<PassNode> passes;
+    std::vector<ResourceNode> resources;
+    RenderTargetPool pool;
+    bool compiled = false;
+
+    // what an access needs to see an earlier imageStore()
+    static GLbitfield barrierBit(FrameGraphAccess access)
+    {
+        switch (access)
+        {
+        case FRAME_GRAPH_SAMPLED:
+            return GL_TEXTURE_FETCH_BARRIER_BIT;
+        case FRAME_GRAPH_IMAGE_READ:
+        case FRAME_GRAPH_IMAGE_WRITE:
+            return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        case FRAME_GRAPH_COLOR:
+            return GL_FRAMEBUFFER_BARRIER_BIT;
+        }
+        return 0;
+    }
+};
+
+#endif
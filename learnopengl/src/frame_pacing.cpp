@@ -0,0 +1,165 @@
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+enum VsyncMode
+{
+    VSYNC_OFF,
+    VSYNC_ON,
+    // swaps late frames right away instead of waiting another refresh, needs swap_control_tear
+    VSYNC_ADAPTIVE
+};
+
+// One fence per frame, put in after the swap. What reuses per-frame memory (see
+// RingBuffer::frameFences) waits for the frame that last used it instead of fencing on its own,
+// and the pacer waits for the frame maxFramesInFlight back. A fence is kept for CAPACITY
+// frames; the frames before are waited for as their slot is taken, so they are done.
+class FrameFences
+{
+  public:
+    static const unsigned int CAPACITY = 8;
+
+    // the frame being recorded, from 1; frame 0 is complete from the start
+    uint64_t frame = 1;
+
+    FrameFences() = default;
+    FrameFences(const FrameFences &) = delete;
+    FrameFences &operator=(const FrameFences &) = delete;
+
+    ~FrameFences()
+    {
+        for (GLsync fence : fences)
+        {
+            if (fence)
+                glDeleteSync(fence);
+        }
+    }
+
+    // after the frame's last command, moves on to the next frame
+    void endFrame()
+    {
+        if (frame >= CAPACITY)
+            wait(frame - CAPACITY);
+        GLsync &fence = fences[frame % CAPACITY];
+        if (fence)
+            glDeleteSync(fence);
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        frame++;
+    }
+
+    // blocks until the GPU is done with every command of frame (an ended one)
+    void wait(uint64_t of)
+    {
+        if (of <= completed || of >= frame)
+            return;
+        GLsync fence = fences[of % CAPACITY];
+        if (fence && frame - of <= CAPACITY)
+        {
+            GLenum status = glClientWaitSync(fence, 0, 0);
+            while (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED && status != GL_WAIT_FAILED)
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        completed = of;
+    }
+
+  private:
+    GLsync fences[CAPACITY] = {};
+    uint64_t completed = 0;
+};
+
+// Swap interval and frame rate control for the main loop.
+// The limiter sleeps until shortly before the frame's deadline and spins the rest of the
+// way, because a plain sleep overshoots by up to a scheduler tick.
+// In low latency mode the wait happens before input is sampled instead of after the swap,
+// and the swap is followed by glFinish so the driver can't queue frames ahead: the frame
+// then starts from the newest input the deadline allows.
+// With fences, maxFramesInFlight bounds how far the driver may queue frames ahead of the
+// GPU: after the swap the CPU waits until no more than that many frames are unfinished, so
+// the camera moves by input at most that many frames old. 1 is close to the glFinish of the
+// low latency mode without stalling on the frame's swap.
+class FramePacer
+{
+  public:
+    VsyncMode vsync = VSYNC_ON;
+    // 0 leaves the rate to vsync
+    double targetFps = 0.0;
+    bool lowLatency = false;
+    // sleeping stops this long before the deadline, the rest is spun
+    double spinSeconds = 0.002;
+    // set by the loop that fences its frames, 0 leaves the queue to the driver
+    FrameFences *fences = nullptr;
+    unsigned int maxFramesInFlight = 0;
+
+    // needs the current context, falls back to plain vsync without tear control
+    void setVsync(VsyncMode mode)
+    {
+        if (mode == VSYNC_ADAPTIVE && !glfwExtensionSupported("WGL_EXT_swap_control_tear") &&
+            !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+            mode = VSYNC_ON;
+        vsync = mode;
+        glfwSwapInterval(mode == VSYNC_ADAPTIVE ? -1 : mode == VSYNC_ON ? 1 : 0);
+    }
+
+    void setTargetFps(double fps)
+    {
+        targetFps = fps;
+        next = Clock::time_point();
+    }
+
+    // right before processInput, polls again (after the wait of the low latency mode) so
+    // the frame reads the input as late as it can
+    void beforeInput()
+    {
+        if (lowLatency)
+            limit();
+        glfwPollEvents();
+    }
+
+    // right after glfwSwapBuffers
+    void afterSwap()
+    {
+        if (fences)
+        {
+            fences->endFrame();
+            if (maxFramesInFlight > 0 && fences->frame > maxFramesInFlight)
+                fences->wait(fences->frame - maxFramesInFlight);
+        }
+        if (lowLatency)
+            glFinish();
+        else
+            limit();
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point next;
+
+    void limit()
+    {
+        if (targetFps <= 0.0)
+            return;
+        Clock::duration interval =
+            std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+        Clock::time_point now = Clock::now();
+        // first frame, or too far behind to catch up
+        if (next == Clock::time_point() || now > next + interval)
+            next = now;
+
+        Clock::time_point sleepUntil =
+            next - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(spinSeconds));
+        if (now < sleepUntil)
+            std::this_thread::sleep_until(sleepUntil);
+        while (Clock::now() < next)
+            std::this_thread::yield();
+        next += interval;
+    }
+};
+
+#endif
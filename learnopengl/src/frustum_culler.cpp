@@ -0,0 +1,119 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include "glm/glm.hpp"
+
+#include "batch_math.cpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// the six planes of a view-projection matrix, normalized so that
+// dot(normal, p) + d is the signed distance of p, positive inside
+struct Frustum
+{
+    // left, right, bottom, top, near, far
+    glm::vec4 planes[6];
+
+    Frustum()
+    {
+    }
+
+    // Gribb/Hartmann extraction for OpenGL clip space (-w <= z <= w)
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        glm::vec4 row[4];
+        for (int r = 0; r < 4; r++)
+            row[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            planes[axis * 2] = row[3] + row[axis];
+            planes[axis * 2 + 1] = row[3] - row[axis];
+        }
+        for (glm::vec4 &plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    // this frustum with the far plane at distance from eye along forward, a draw distance
+    Frustum limited(const glm::vec3 &eye, const glm::vec3 &forward, float distance) const
+    {
+        Frustum frustum = *this;
+        frustum.planes[5] = glm::vec4(-forward, glm::dot(forward, eye) + distance);
+        return frustum;
+    }
+};
+
+// Bounding spheres in SoA arrays tested against a frustum 4 at a time with SSE2,
+// or 8 at a time when the build targets AVX. cull() fills visible with the indices
+// of the spheres that touch the frustum, in ascending order, for the draw loop to iterate.
+class FrustumCuller
+{
+  public:
+    std::vector<float> centerX, centerY, centerZ, radius;
+    // output of cull()
+    std::vector<uint32_t> visible;
+    // counters of the last cull()
+    size_t tested = 0;
+    size_t visibleCount = 0;
+
+    size_t size() const
+    {
+        return radius.size();
+    }
+
+    void resize(size_t count)
+    {
+        centerX.resize(count);
+        centerY.resize(count);
+        centerZ.resize(count);
+        radius.resize(count);
+        visible.reserve(count);
+    }
+
+    void setSphere(size_t index, const glm::vec3 &center, float sphereRadius)
+    {
+        centerX[index] = center.x;
+        centerY[index] = center.y;
+        centerZ[index] = center.z;
+        radius[index] = sphereRadius;
+    }
+
+    void cull(const Frustum &frustum)
+    {
+        visible.clear();
+        cull(frustum, 0, size(), visible);
+        tested = size();
+        visibleCount = visible.size();
+    }
+
+    // appends the visible spheres of first to last - 1 to out, disjoint ranges can run on
+    // different threads, the counters are left alone
+    void cull(const Frustum &frustum, size_t first, size_t last, std::vector<uint32_t> &out) const
+    {
+        batchCullSpheres(frustum.planes, 6, centerX.data(), centerY.data(), centerZ.data(), radius.data(), first, last,
+                         out);
+    }
+
+    // the ranged cull() for viewCount frustums in one pass over the spheres, out[v] gets the
+    // visible spheres of frustums[v]
+    void cull(const Frustum *frustums, int viewCount, size_t first, size_t last, std::vector<uint32_t> *out) const
+    {
+        static_assert(sizeof(Frustum) == 6 * sizeof(glm::vec4), "the planes of the frustums must be contiguous");
+        batchCullSpheresViews(frustums[0].planes, 6, viewCount, centerX.data(), centerY.data(), centerZ.data(),
+                              radius.data(), first, last, out);
+    }
+
+    // joins the outputs of ranged cull() calls, in range order
+    void gather(const std::vector<std::vector<uint32_t>> &ranges)
+    {
+        visible.clear();
+        for (const std::vector<uint32_t> &range : ranges)
+            visible.insert(visible.end(), range.begin(), range.end());
+        tested = size();
+        visibleCount = visible.size();
+    }
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include "glad/glad.h"
+
+#include "gl_objects.cpp"
+#include "texture.cpp"
+
+#include <iostream>
+
+// how many bits the G-buffer spends per pixel, --gbuffer compact|full
+enum GBufferPrecision
+{
+    // RG8 normals and an R11G11B10F light buffer, 14 bytes per pixel with the albedo and depth
+    GBUFFER_COMPACT,
+    // RG16 normals and an RGBA16F light buffer, 20 bytes per pixel with the albedo and depth
+    GBUFFER_FULL,
+};
+
+// The render targets of the deferred path. The geometry pass writes RGBA8 albedo and the
+// world normal, folded to two channels by octahedral encoding (shader_src/octahedral.glsl),
+// while depth goes to a depth texture borrowed from the frame's RenderTarget, so depth tests,
+// the Hi-Z copy and the blit later in the frame see it as they always do. Positions come back
+// from that depth, nothing else of the surface is stored.
+// The lighting passes read all three with texelFetch and add into the light buffer, which
+// has a framebuffer of its own without the depth, so the depth is never sampled while it
+// is attached to the target being drawn. resolve() copies the light to the frame's color.
+class GBuffer
+{
+  public:
+    // texture units the lighting passes read from, clear of the material units
+    static const unsigned int ALBEDO_UNIT = 4;
+    static const unsigned int NORMAL_UNIT = 5;
+    static const unsigned int DEPTH_UNIT = 6;
+
+    GBufferPrecision precision = GBUFFER_COMPACT;
+    unsigned int geometryFBO = 0;
+    unsigned int lightFBO = 0;
+    Texture2D albedo;
+    Texture2D normal;
+    Texture2D light;
+    int width = 0, height = 0;
+
+    ~GBuffer()
+    {
+        if (geometryFBO)
+            glDeleteFramebuffers(1, &geometryFBO);
+        if (lightFBO)
+            glDeleteFramebuffers(1, &lightFBO);
+    }
+
+    // bytes per pixel of all targets, the depth included
+    int bytesPerPixel() const
+    {
+        return precision == GBUFFER_FULL ? 4 + 4 + 8 + 4 : 4 + 2 + 4 + 4;
+    }
+
+    // (re)creates the targets when the size or the depth texture changed, false when incomplete
+    bool resize(int w, int h, const Texture2D &depth)
+    {
+        if (w <= 0 || h <= 0)
+            return false;
+        if (geometryFBO && w == width && h == height && depth.ID == depthID)
+            return true;
+        width = w;
+        height = h;
+        depthID = depth.ID;
+        albedo.create(width, height, GL_RGBA8, 1, GPU_MEMORY_RENDER_TARGETS);
+        normal.create(width, height, precision == GBUFFER_FULL ? GL_RG16 : GL_RG8, 1, GPU_MEMORY_RENDER_TARGETS);
+        light.create(width, height, precision == GBUFFER_FULL ? GL_RGBA16F : GL_R11F_G11F_B10F, 1,
+                     GPU_MEMORY_RENDER_TARGETS);
+
+        if (!geometryFBO)
+        {
+            geometryFBO = createFramebuffer();
+            lightFBO = createFramebuffer();
+        }
+        const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        GLenum geometryStatus, lightStatus;
+        if (hasDSA())
+        {
+            glNamedFramebufferTexture(geometryFBO, GL_COLOR_ATTACHMENT0, albedo.ID, 0);
+            glNamedFramebufferTexture(geometryFBO, GL_COLOR_ATTACHMENT1, normal.ID, 0);
+            glNamedFramebufferTexture(geometryFBO, GL_DEPTH_ATTACHMENT, depthID, 0);
+            glNamedFramebufferDrawBuffers(geometryFBO, 2, drawBuffers);
+            glNamedFramebufferTexture(lightFBO, GL_COLOR_ATTACHMENT0, light.ID, 0);
+            geometryStatus = glCheckNamedFramebufferStatus(geometryFBO, GL_FRAMEBUFFER);
+            lightStatus = glCheckNamedFramebufferStatus(lightFBO, GL_FRAMEBUFFER);
+        }
+        else
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, geometryFBO);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo.ID, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal.ID, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthID, 0);
+            glDrawBuffers(2, drawBuffers);
+            geometryStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, lightFBO);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, light.ID, 0);
+            lightStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        if (geometryStatus != GL_FRAMEBUFFER_COMPLETE || lightStatus != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::GBUFFER::INCOMPLETE: 0x" << std::hex << geometryStatus << " 0x" << lightStatus
+                      << std::dec << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    // binds the geometry targets and clears the colors, the depth is the RenderTarget's to clear
+    void bindGeometry() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, geometryFBO);
+        const float zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, zero);
+        glClearBufferfv(GL_COLOR, 1, zero);
+    }
+
+    // binds the light buffer and the G-buffer textures for the lighting passes
+    void bindLighting(const Texture2D &depth) const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, lightFBO);
+        albedo.bind(ALBEDO_UNIT);
+        normal.bind(NORMAL_UNIT);
+        depth.bind(DEPTH_UNIT);
+    }
+
+    // copies the light buffer to the color of targetFBO and leaves that bound
+    void resolve(unsigned int targetFBO) const
+    {
+        if (hasDSA())
+        {
+            glBlitNamedFramebuffer(lightFBO, targetFBO, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT,
+                                   GL_NEAREST);
+        }
+        else
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, lightFBO);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFBO);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+    }
+
+  private:
+    unsigned int depthID = 0;
+};
+
+#endif
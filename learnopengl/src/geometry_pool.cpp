@@ -0,0 +1,291 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "mesh.cpp"
+#include "mesh_file.cpp"
+#include "meshlets.cpp"
+#include "range_allocator.cpp"
+#include "render_stats.cpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// where a mesh lives inside a GeometryPool, the fields of a DrawElementsIndirectCommand
+// plus the decode of its boundsRelative elements
+struct MeshRange
+{
+    uint32_t firstIndex = 0;
+    // of every level together, drawn are the ranges of the pool's lods
+    uint32_t indexCount = 0;
+    int32_t baseVertex = 0;
+    uint32_t vertexCount = 0;
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    glm::vec3 boundsExtent = glm::vec3(1.0f);
+    // the mesh's levels of detail in GeometryPool::lods
+    uint32_t firstLod = 0;
+    uint32_t lodCount = 0;
+    // the meshlets of level 0 in GeometryPool::meshlets
+    uint32_t firstMeshlet = 0;
+    uint32_t meshletCount = 0;
+};
+
+// Many meshes sub-allocated in one vertex and one index buffer behind a single VAO,
+// so all of them can be drawn by one multi-draw call (see indirect_renderer.cpp) or one
+// glDrawElementsBaseVertex each without rebinding buffers.
+// Every mesh has to use the pool's layout. Indices are stored 32-bit and stay local
+// to their mesh, the draw adds baseVertex. Ranges come from a RangeAllocator per buffer,
+// remove() gives them back for reuse and defragment() packs the live ones again.
+// When no free block fits, the buffers grow by doubling and the old contents are copied
+// on the GPU. With GL 4.4 the buffers are immutable glBufferStorage allocations.
+// The levels of detail and the meshlets of every mesh are kept in one table each, on the CPU
+// and in lodBuffer and meshletBuffer for the cull passes; their index ranges are relative to
+// the mesh, so defragment() leaves the tables alone. A removed mesh's entries aren't reused.
+// A mesh added without meshlets gets a single one over all of level 0.
+class GeometryPool
+{
+  public:
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    VertexLayout layout;
+    // in vertices and indices, capacity and used space live in the allocators
+    RangeAllocator vertices, indices;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+    // the MeshLod and Meshlet tables as shader storage buffers
+    unsigned int lodBuffer = 0, meshletBuffer = 0;
+
+    GeometryPool(const VertexLayout &layout, size_t vertexCapacity = 4096, size_t indexCapacity = 16384)
+        : layout(layout)
+    {
+        VAO = createVertexArray();
+        vertices.grow(vertexCapacity);
+        indices.grow(indexCapacity);
+        resize(0, 0);
+    }
+
+    ~GeometryPool()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        deleteBuffers(1, &VBO);
+        deleteBuffers(1, &EBO);
+        deleteBuffers(1, &lodBuffer);
+        deleteBuffers(1, &meshletBuffer);
+    }
+
+    GeometryPool(const GeometryPool &) = delete;
+    GeometryPool &operator=(const GeometryPool &) = delete;
+
+    // quantizes the builder into the pool layout
+    MeshRange add(const MeshBuilder &builder)
+    {
+        PackedVertices packed = packVertices(builder, layout);
+        return add(packed.data.data(), builder.vertexCount(), builder.indices.data(), builder.indices.size(), 4,
+                   packed.boundsCenter, packed.boundsExtent, builder.levels(), builder.meshlets);
+    }
+
+    // adds vertices already in the pool layout, indexSize is 2 or 4; without levels
+    // the mesh has one over every index
+    MeshRange add(const void *vertexData, size_t count, const void *indexData, size_t indexTotal, size_t indexSize,
+                  glm::vec3 boundsCenter, glm::vec3 boundsExtent, std::vector<MeshLod> levels = {},
+                  std::vector<Meshlet> clusters = {})
+    {
+        size_t vertexCapacity = vertices.capacity, indexCapacity = indices.capacity;
+        size_t vertexOffset, indexOffset;
+        while (!vertices.allocate(count, vertexOffset))
+            vertices.grow(std::max<size_t>(vertices.capacity * 2, 1));
+        while (!indices.allocate(indexTotal, indexOffset))
+            indices.grow(std::max<size_t>(indices.capacity * 2, 1));
+        if (vertices.capacity != vertexCapacity || indices.capacity != indexCapacity)
+            resize(vertexCapacity, indexCapacity);
+
+        MeshRange range;
+        range.firstIndex = (uint32_t)indexOffset;
+        range.indexCount = (uint32_t)indexTotal;
+        range.baseVertex = (int32_t)vertexOffset;
+        range.vertexCount = (uint32_t)count;
+        range.boundsCenter = boundsCenter;
+        range.boundsExtent = boundsExtent;
+        if (levels.empty())
+            levels.push_back({0, (uint32_t)indexTotal, 0.0f, 0});
+        range.firstLod = (uint32_t)lods.size();
+        range.lodCount = (uint32_t)levels.size();
+        lods.insert(lods.end(), levels.begin(), levels.end());
+        uploadTable(lodBuffer, lodCapacity, lods.data(), lods.size(), sizeof(MeshLod));
+        if (clusters.empty())
+            clusters.push_back(wholeMeshlet(levels[0].indexCount, boundsCenter, boundsExtent));
+        range.firstMeshlet = (uint32_t)meshlets.size();
+        range.meshletCount = (uint32_t)clusters.size();
+        meshlets.insert(meshlets.end(), clusters.begin(), clusters.end());
+        uploadTable(meshletBuffer, meshletCapacity, meshlets.data(), meshlets.size(), sizeof(Meshlet));
+
+        std::vector<uint32_t> wide;
+        if (indexSize == 2)
+        {
+            wide.resize(indexTotal);
+            const uint16_t *narrow = (const uint16_t *)indexData;
+            for (size_t i = 0; i < indexTotal; i++)
+                wide[i] = narrow[i];
+            indexData = wide.data();
+        }
+
+        updateBuffer(VBO, vertexOffset * layout.stride, count * layout.stride, vertexData);
+        updateBuffer(EBO, indexOffset * 4, indexTotal * 4, indexData);
+        return range;
+    }
+
+    // copies a cooked mesh file straight from the mapping, false when it is missing,
+    // invalid or stored in a different layout; encoded ones decode on jobs when there is one
+    bool addMeshFile(const std::string &path, MeshRange &range, JobSystem *jobs = NULL)
+    {
+        MappedFile file;
+        MeshFileView view;
+        if (!openMeshFile(path, file, view))
+            return false;
+        if (!(view.layout == layout))
+        {
+            std::cout << "ERROR::GEOMETRY_POOL::LAYOUT_MISMATCH: " << path << '\n';
+            return false;
+        }
+        const MeshFileHeader &header = view.header;
+        const void *vertexData = view.vertices, *indexData = view.indices;
+        size_t indexSize = header.indexSize;
+        // encoded blobs are decoded first, the indices straight to the pool's 32 bits
+        std::vector<unsigned char> decodedVertices, decodedIndices;
+        if (header.encoding != 0)
+        {
+            decodedVertices.resize((size_t)header.vertexCount * header.vertexStride);
+            decodedIndices.resize((size_t)header.indexCount * 4);
+            if (!decodeMeshFile(view, decodedVertices.data(), decodedIndices.data(), 4, jobs))
+            {
+                std::cout << "ERROR::GEOMETRY_POOL::CORRUPT_MESH_FILE: " << path << '\n';
+                return false;
+            }
+            vertexData = decodedVertices.data();
+            indexData = decodedIndices.data();
+            indexSize = 4;
+        }
+        range = add(vertexData, header.vertexCount, indexData, header.indexCount, indexSize,
+                    glm::vec3(header.boundsCenter[0], header.boundsCenter[1], header.boundsCenter[2]),
+                    glm::vec3(header.boundsExtent[0], header.boundsExtent[1], header.boundsExtent[2]), view.lods,
+                    view.meshlets);
+        return true;
+    }
+
+    // frees the space of a mesh, its range must not be drawn anymore
+    void remove(MeshRange &range)
+    {
+        vertices.free((size_t)range.baseVertex, range.vertexCount);
+        indices.free(range.firstIndex, range.indexCount);
+        range.vertexCount = range.indexCount = 0;
+    }
+
+    // moves every live mesh to the front of fresh buffers, in their current order, and
+    // updates the ranges, which must be all the meshes still in the pool.
+    // Indices are local to their mesh, so only the offsets change.
+    void defragment(const std::vector<MeshRange *> &ranges)
+    {
+        std::vector<MeshRange *> sorted(ranges);
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const MeshRange *a, const MeshRange *b) { return a->baseVertex < b->baseVertex; });
+
+        unsigned int newVBO = createPoolBuffer(vertices.capacity * layout.stride);
+        unsigned int newEBO = createPoolBuffer(indices.capacity * 4);
+        vertices.reset();
+        indices.reset();
+        for (MeshRange *range : sorted)
+        {
+            size_t vertexOffset, indexOffset;
+            vertices.allocate(range->vertexCount, vertexOffset);
+            indices.allocate(range->indexCount, indexOffset);
+            copyBuffer(VBO, newVBO, (size_t)range->baseVertex * layout.stride, vertexOffset * layout.stride,
+                       range->vertexCount * layout.stride);
+            copyBuffer(EBO, newEBO, (size_t)range->firstIndex * 4, indexOffset * 4, range->indexCount * 4);
+            range->baseVertex = (int32_t)vertexOffset;
+            range->firstIndex = (uint32_t)indexOffset;
+        }
+        deleteBuffers(1, &VBO);
+        deleteBuffers(1, &EBO);
+        VBO = newVBO;
+        EBO = newEBO;
+        attach();
+    }
+
+    void bind() const
+    {
+        glState.bindVertexArray(VAO);
+    }
+
+    // a level of detail of a mesh, clamped to its coarsest one
+    const MeshLod &lod(const MeshRange &range, uint32_t level) const
+    {
+        return lods[range.firstLod + std::min(level, range.lodCount - 1)];
+    }
+
+    // one mesh on its own at a level of detail, the pool has to be bound
+    void draw(const MeshRange &range, uint32_t level = 0) const
+    {
+        const MeshLod &drawn = lod(range, level);
+        renderStats.countDraw(drawn.indexCount);
+        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)drawn.indexCount, GL_UNSIGNED_INT,
+                                 (void *)((size_t)(range.firstIndex + drawn.firstIndex) * 4), range.baseVertex);
+    }
+
+  private:
+    // in entries
+    size_t lodCapacity = 0, meshletCapacity = 0;
+
+    // the tables are small, they are rewritten whole and reallocated by doubling
+    static void uploadTable(unsigned int &buffer, size_t &capacity, const void *data, size_t count, size_t stride)
+    {
+        if (count > capacity)
+        {
+            capacity = std::max<size_t>(capacity * 2, std::max<size_t>(count, 64));
+            deleteBuffers(1, &buffer);
+            buffer = createPoolBuffer(capacity * stride);
+        }
+        updateBuffer(buffer, 0, count * stride, data);
+    }
+
+    // moves both buffers to the allocators' capacities, keeping the old contents,
+    // and rebuilds the VAO around them
+    void resize(size_t oldVertexCapacity, size_t oldIndexCapacity)
+    {
+        VBO = grow(VBO, oldVertexCapacity * layout.stride, vertices.capacity * layout.stride);
+        EBO = grow(EBO, oldIndexCapacity * 4, indices.capacity * 4);
+        attach();
+    }
+
+    void attach()
+    {
+        layout.apply(VAO, VBO);
+        setElementBuffer(VAO, EBO);
+    }
+
+    // updateBuffer() still works on the immutable store through GL_DYNAMIC_STORAGE_BIT
+    static unsigned int createPoolBuffer(size_t bytes)
+    {
+        return createBuffer(bytes, NULL, GL_DYNAMIC_STORAGE_BIT, GL_STATIC_DRAW, GPU_MEMORY_GEOMETRY);
+    }
+
+    // a bigger buffer holding the first used bytes of the old one, which is deleted
+    static unsigned int grow(unsigned int old, size_t used, size_t bytes)
+    {
+        unsigned int buffer = createPoolBuffer(bytes);
+        if (old)
+        {
+            copyBuffer(old, buffer, 0, 0, used);
+            deleteBuffers(1, &old);
+        }
+        return buffer;
+    }
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef GL_CONTEXT_H
+#define GL_CONTEXT_H
+
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+#include "gl_debug.cpp"
+
+#include <iostream>
+
+// Window and context creation. Only core profile contexts are asked for, so the driver
+// doesn't carry and validate the compatibility profile state, newest version first:
+// 4.6 has SPIR-V and the indirect count draws built in, 4.5 has DSA (gl_objects.cpp),
+// and 3.3 is what the sources need at least, every path above it checks for itself.
+struct GLContextVersion
+{
+    int major;
+    int minor;
+
+    bool operator<=(const GLContextVersion &other) const
+    {
+        return major < other.major || (major == other.major && minor <= other.minor);
+    }
+};
+
+const GLContextVersion GL_CONTEXT_VERSIONS[] = {{4, 6}, {4, 5}, {3, 3}};
+
+// the first version up to limit the driver makes a window for, NULL when none of them works
+inline GLFWwindow *createGLWindow(int width, int height, const char *title, GLContextVersion limit,
+                                  GLContextVersion &created)
+{
+    for (const GLContextVersion &version : GL_CONTEXT_VERSIONS)
+    {
+        if (!(version <= limit))
+            continue;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version.major);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version.minor);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        // macOS only makes core contexts forward compatible, elsewhere it drops nothing core has
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+        // the driver reports everything to installDebugOutput()'s callback in debug builds
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_DEBUG ? GLFW_TRUE : GLFW_FALSE);
+        if (GLFWwindow *window = glfwCreateWindow(width, height, title, NULL, NULL))
+        {
+            created = version;
+            return window;
+        }
+    }
+    std::cout << "ERROR::GL_CONTEXT::NO_CORE_CONTEXT: up to " << limit.major << "." << limit.minor << '\n';
+    return NULL;
+}
+
+#endif
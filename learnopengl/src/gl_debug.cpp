@@ -0,0 +1,163 @@
+#ifndef GL_DEBUG_H
+#define GL_DEBUG_H
+
+#include "glad/glad.h"
+
+#include "cpu_profiler.cpp"
+
+#include <iostream>
+#include <string>
+
+// GL_DEBUG 1 makes GL_CHECK read glGetError after the call it wraps, GL_CHECK_ERRORS sweep
+// whatever is left and installDebugOutput() register the driver's message callback; it
+// defaults to 1 in builds without NDEBUG. Release builds compile all three away, so the frame
+// pays nothing for them there. Debug groups and object labels are for GPU captures (RenderDoc,
+// Nsight) and cost a branch on glDebugMarkers while they are off, in any build.
+#ifndef GL_DEBUG
+#ifdef NDEBUG
+#define GL_DEBUG 0
+#else
+#define GL_DEBUG 1
+#endif
+#endif
+
+inline const char *glErrorName(GLenum error)
+{
+    switch (error)
+    {
+    case GL_INVALID_ENUM:
+        return "INVALID_ENUM";
+    case GL_INVALID_VALUE:
+        return "INVALID_VALUE";
+    case GL_INVALID_OPERATION:
+        return "INVALID_OPERATION";
+    case GL_INVALID_FRAMEBUFFER_OPERATION:
+        return "INVALID_FRAMEBUFFER_OPERATION";
+    case GL_OUT_OF_MEMORY:
+        return "OUT_OF_MEMORY";
+    case GL_STACK_OVERFLOW:
+        return "STACK_OVERFLOW";
+    case GL_STACK_UNDERFLOW:
+        return "STACK_UNDERFLOW";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+// prints every error flag set since the last check with where it was found, false when there was one
+inline bool checkGLErrors(const char *what, const char *file, int line)
+{
+    bool clean = true;
+    for (GLenum error = glGetError(); error != GL_NO_ERROR; error = glGetError())
+    {
+        std::cout << "ERROR::GL::" << glErrorName(error) << ": " << what << " at " << file << ":" << line << '\n';
+        clean = false;
+    }
+    return clean;
+}
+
+#if GL_DEBUG
+// wraps a GL call statement
+#define GL_CHECK(call)                                                                                                 \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        call;                                                                                                          \
+        checkGLErrors(#call, __FILE__, __LINE__);                                                                      \
+    } while (0)
+// what the calls since the last check left, e.g. once per frame
+#define GL_CHECK_ERRORS(what) checkGLErrors(what, __FILE__, __LINE__)
+#else
+#define GL_CHECK(call) call
+#define GL_CHECK_ERRORS(what) ((void)0)
+#endif
+
+// whether debug groups and object labels reach the driver, set by enableDebugMarkers()
+inline bool glDebugMarkers = false;
+
+// on when the context has KHR_debug in core (GL 4.3), returns whether it is
+inline bool enableDebugMarkers()
+{
+    glDebugMarkers = GLAD_GL_VERSION_4_3 && glPushDebugGroup != NULL;
+    return glDebugMarkers;
+}
+
+inline void pushDebugGroup(const char *name)
+{
+    if (glDebugMarkers)
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+}
+
+inline void popDebugGroup()
+{
+    if (glDebugMarkers)
+        glPopDebugGroup();
+}
+
+// identifier is GL_TEXTURE, GL_BUFFER, GL_PROGRAM, GL_FRAMEBUFFER, ...
+inline void labelObject(GLenum identifier, unsigned int name, const std::string &label)
+{
+    if (glDebugMarkers && name)
+        glObjectLabel(identifier, name, (GLsizei)label.size(), label.data());
+}
+
+// a debug group around the rest of the scope
+class GLDebugGroup
+{
+  public:
+    explicit GLDebugGroup(const char *name)
+    {
+        pushDebugGroup(name);
+    }
+
+    ~GLDebugGroup()
+    {
+        popDebugGroup();
+    }
+
+    GLDebugGroup(const GLDebugGroup &) = delete;
+    GLDebugGroup &operator=(const GLDebugGroup &) = delete;
+};
+
+#define GL_DEBUG_CONCAT_(a, b) a##b
+#define GL_DEBUG_CONCAT(a, b) GL_DEBUG_CONCAT_(a, b)
+// a PROFILE_ZONE that shows up as a debug group of the same name in GPU captures, GL thread only
+#define GL_ZONE(name)                                                                                                  \
+    PROFILE_ZONE(name);                                                                                                \
+    GLDebugGroup GL_DEBUG_CONCAT(glDebugGroup, __LINE__)(name)
+
+#if GL_DEBUG
+inline void APIENTRY printDebugMessage(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                       const GLchar *message, const void *userParam)
+{
+    (void)source;
+    (void)length;
+    (void)userParam;
+    const char *kind = type == GL_DEBUG_TYPE_ERROR                 ? "ERROR"
+                       : type == GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR ? "DEPRECATED"
+                       : type == GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR  ? "UNDEFINED_BEHAVIOR"
+                       : type == GL_DEBUG_TYPE_PERFORMANCE         ? "PERFORMANCE"
+                       : type == GL_DEBUG_TYPE_PORTABILITY         ? "PORTABILITY"
+                                                                   : "OTHER";
+    const char *level = severity == GL_DEBUG_SEVERITY_HIGH     ? "HIGH"
+                        : severity == GL_DEBUG_SEVERITY_MEDIUM ? "MEDIUM"
+                                                               : "LOW";
+    std::cout << "ERROR::GL_DEBUG::" << kind << " (" << level << ", " << id << "): " << message << '\n';
+}
+#endif
+
+// Debug builds only: the driver's messages printed as they come, synchronously so a
+// breakpoint in the callback stops at the call. A debug context (see createGLWindow())
+// reports everything, others what the driver chooses to. Notifications are left out.
+inline void installDebugOutput()
+{
+#if GL_DEBUG
+    if (!GLAD_GL_VERSION_4_3)
+        return;
+    glEnable(GL_DEBUG_OUTPUT);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    glDebugMessageCallback(printDebugMessage, NULL);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+#endif
+}
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef GL_OBJECTS_H
+#define GL_OBJECTS_H
+
+#include "glad/glad.h"
+
+#include "gl_debug.cpp"
+#include "gl_state.cpp"
+#include "gpu_memory.cpp"
+
+#include <cstddef>
+
+// Creation and editing of buffer, vertex array and framebuffer objects. On GL 4.5 they go
+// through DSA (glCreateBuffers, glNamedBufferSubData, glVertexArrayAttribFormat, ...), name
+// the object they change and never touch a binding point, so nothing the draws depend on
+// is disturbed and the driver has no bind to validate. Older contexts bind to edit, buffers
+// on GL_COPY_WRITE_BUFFER, which no draw reads, like Texture2D does on the texture units.
+
+inline bool hasDSA()
+{
+    return GLAD_GL_VERSION_4_5 != 0;
+}
+
+// A buffer of bytes holding data (or undefined contents when NULL). With GL 4.4 it is an
+// immutable glBufferStorage allocation with flags, otherwise a glBufferData one with usage.
+// Pass GL_DYNAMIC_STORAGE_BIT to update it with updateBuffer() later. It counts towards
+// category in gpuMemory until deleteBuffers() deletes it.
+inline unsigned int createBuffer(size_t bytes, const void *data, GLbitfield flags, GLenum usage = GL_STATIC_DRAW,
+                                 GpuMemoryCategory category = GPU_MEMORY_BUFFERS)
+{
+    unsigned int buffer = 0;
+    if (hasDSA())
+    {
+        glCreateBuffers(1, &buffer);
+        GL_CHECK(glNamedBufferStorage(buffer, (GLsizeiptr)bytes, data, flags));
+    }
+    else
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        if (GLAD_GL_VERSION_4_4)
+            GL_CHECK(glBufferStorage(GL_COPY_WRITE_BUFFER, (GLsizeiptr)bytes, data, flags));
+        else
+            GL_CHECK(glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)bytes, data, usage));
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    gpuMemory.trackBuffer(buffer, bytes, category);
+    return buffer;
+}
+
+// glDeleteBuffers, and the buffers no longer count in gpuMemory
+inline void deleteBuffers(GLsizei count, const unsigned int *buffers)
+{
+    gpuMemory.releaseBuffers(count, buffers);
+    glDeleteBuffers(count, buffers);
+}
+
+inline void updateBuffer(unsigned int buffer, size_t offset, size_t bytes, const void *data)
+{
+    if (hasDSA())
+    {
+        glNamedBufferSubData(buffer, (GLintptr)offset, (GLsizeiptr)bytes, data);
+        return;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)offset, (GLsizeiptr)bytes, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+// NULL when the driver can't map it
+inline void *mapBuffer(unsigned int buffer, size_t offset, size_t bytes, GLbitfield access)
+{
+    if (hasDSA())
+        return glMapNamedBufferRange(buffer, (GLintptr)offset, (GLsizeiptr)bytes, access);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    void *memory = glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr)offset, (GLsizeiptr)bytes, access);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return memory;
+}
+
+inline void unmapBuffer(unsigned int buffer)
+{
+    if (hasDSA())
+    {
+        glUnmapNamedBuffer(buffer);
+        return;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+inline void copyBuffer(unsigned int from, unsigned int to, size_t fromOffset, size_t toOffset, size_t bytes)
+{
+    if (bytes == 0)
+        return;
+    if (hasDSA())
+    {
+        glCopyNamedBufferSubData(from, to, (GLintptr)fromOffset, (GLintptr)toOffset, (GLsizeiptr)bytes);
+        return;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, from);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, to);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)fromOffset, (GLintptr)toOffset,
+                        (GLsizeiptr)bytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+// without DSA the VAO is bound, glCreateVertexArrays makes it complete without a bind
+inline unsigned int createVertexArray()
+{
+    unsigned int vertexArray = 0;
+    if (hasDSA())
+    {
+        glCreateVertexArrays(1, &vertexArray);
+        return vertexArray;
+    }
+    glGenVertexArrays(1, &vertexArray);
+    glState.bindVertexArray(vertexArray);
+    return vertexArray;
+}
+
+// the index buffer of the VAO's draws
+inline void setElementBuffer(unsigned int vertexArray, unsigned int buffer)
+{
+    if (hasDSA())
+    {
+        glVertexArrayElementBuffer(vertexArray, buffer);
+        return;
+    }
+    glState.bindVertexArray(vertexArray);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+}
+
+inline unsigned int createFramebuffer()
+{
+    unsigned int framebuffer = 0;
+    if (hasDSA())
+        glCreateFramebuffers(1, &framebuffer);
+    else
+        glGenFramebuffers(1, &framebuffer);
+    return framebuffer;
+}
+
+#endif
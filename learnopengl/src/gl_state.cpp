@@ -0,0 +1,370 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include "glad/glad.h"
+
+// Shadow copy of the GL state we touch every frame, so setting something
+// that is already set never reaches the driver.
+// Code that changes the same state with raw GL calls has to call invalidate() afterwards.
+class GLStateCache
+{
+  public:
+    // calls that reached the driver / calls skipped as no-ops, reset each frame with resetStats()
+    unsigned int issued = 0;
+    unsigned int filtered = 0;
+
+    // bumped by uniform writes that go around Shader::set() (CommandStream's replay) and by
+    // invalidate(), the values the programs remember are stale after it
+    unsigned int uniformGeneration = 0;
+
+    static const unsigned int MAX_TEXTURE_UNITS = 32;
+    // indexed uniform and storage buffer bindings below this are cached
+    static const unsigned int MAX_BUFFER_BINDINGS = 16;
+
+    GLStateCache()
+    {
+        invalidate();
+    }
+
+    // forget everything, the next call of each kind goes to the driver
+    void invalidate()
+    {
+        program = UNKNOWN;
+        pipeline = UNKNOWN;
+        vertexArray = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+        {
+            textureTargets[i] = UNKNOWN;
+            textures[i] = UNKNOWN;
+            samplers[i] = UNKNOWN;
+        }
+        for (unsigned int i = 0; i < CAP_COUNT; i++)
+            caps[i] = -1;
+        for (unsigned int i = 0; i < 2 * MAX_BUFFER_BINDINGS; i++)
+            bufferRanges[i] = {UNKNOWN, 0, 0};
+        depthMask = -1;
+        depthFunc = UNKNOWN;
+        blendSource = blendDestination = UNKNOWN;
+        uniformGeneration++;
+    }
+
+    void resetStats()
+    {
+        issued = 0;
+        filtered = 0;
+    }
+
+    void useProgram(unsigned int id)
+    {
+        if (program == id)
+        {
+            filtered++;
+            return;
+        }
+        program = id;
+        issued++;
+        glUseProgram(id);
+    }
+
+    // a program pipeline only takes effect while no program is in use
+    void bindProgramPipeline(unsigned int id)
+    {
+        useProgram(0);
+        if (pipeline == id)
+        {
+            filtered++;
+            return;
+        }
+        pipeline = id;
+        issued++;
+        glBindProgramPipeline(id);
+    }
+
+    void bindVertexArray(unsigned int id)
+    {
+        if (vertexArray == id)
+        {
+            filtered++;
+            return;
+        }
+        vertexArray = id;
+        issued++;
+        glBindVertexArray(id);
+    }
+
+    void activeTexture(unsigned int unit)
+    {
+        if (activeUnit == unit)
+        {
+            filtered++;
+            return;
+        }
+        activeUnit = unit;
+        issued++;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // binds a texture to a unit, only switching the active unit if the binding changes
+    void bindTexture(unsigned int unit, GLenum target, unsigned int id)
+    {
+        if (unit < MAX_TEXTURE_UNITS && textures[unit] == id && textureTargets[unit] == target)
+        {
+            filtered++;
+            return;
+        }
+        activeTexture(unit);
+        if (unit < MAX_TEXTURE_UNITS)
+        {
+            textures[unit] = id;
+            textureTargets[unit] = target;
+        }
+        issued++;
+        glBindTexture(target, id);
+    }
+
+    // sampler objects are bound per unit without touching the active unit
+    void bindSampler(unsigned int unit, unsigned int id)
+    {
+        if (unit < MAX_TEXTURE_UNITS && samplers[unit] == id)
+        {
+            filtered++;
+            return;
+        }
+        if (unit < MAX_TEXTURE_UNITS)
+            samplers[unit] = id;
+        issued++;
+        glBindSampler(unit, id);
+    }
+
+    // count samplers on the units from first on, one glBindSamplers (GL 4.4) for the ones that changed
+    void bindSamplers(unsigned int first, unsigned int count, const unsigned int *ids)
+    {
+        unsigned int begin = 0, end = count;
+        while (begin < end && first + begin < MAX_TEXTURE_UNITS && samplers[first + begin] == ids[begin])
+            begin++;
+        while (end > begin && first + end - 1 < MAX_TEXTURE_UNITS && samplers[first + end - 1] == ids[end - 1])
+            end--;
+        filtered += count - (end - begin);
+        if (begin == end)
+            return;
+        for (unsigned int i = begin; i < end && first + i < MAX_TEXTURE_UNITS; i++)
+            samplers[first + i] = ids[i];
+        if (!GLAD_GL_VERSION_4_4)
+        {
+            for (unsigned int i = begin; i < end; i++)
+                glBindSampler(first + i, ids[i]);
+            issued += end - begin;
+            return;
+        }
+        issued++;
+        glBindSamplers(first + begin, (GLsizei)(end - begin), ids + begin);
+    }
+
+    // glEnable/glDisable for the capabilities listed in capIndex()
+    void setCapability(GLenum cap, bool enabled)
+    {
+        int index = capIndex(cap);
+        if (index >= 0 && caps[index] == (int)enabled)
+        {
+            filtered++;
+            return;
+        }
+        if (index >= 0)
+            caps[index] = (int)enabled;
+        issued++;
+        if (enabled)
+            glEnable(cap);
+        else
+            glDisable(cap);
+    }
+    void enable(GLenum cap)
+    {
+        setCapability(cap, true);
+    }
+    void disable(GLenum cap)
+    {
+        setCapability(cap, false);
+    }
+
+    void setDepthMask(bool write)
+    {
+        if (depthMask == (int)write)
+        {
+            filtered++;
+            return;
+        }
+        depthMask = (int)write;
+        issued++;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    void setDepthFunc(GLenum func)
+    {
+        if (depthFunc == func)
+        {
+            filtered++;
+            return;
+        }
+        depthFunc = func;
+        issued++;
+        glDepthFunc(func);
+    }
+
+    void setBlendFunc(GLenum source, GLenum destination)
+    {
+        if (blendSource == source && blendDestination == destination)
+        {
+            filtered++;
+            return;
+        }
+        blendSource = source;
+        blendDestination = destination;
+        issued++;
+        glBlendFunc(source, destination);
+    }
+
+    // one draw buffer's blend function (GL 4.0), always issued, the next setBlendFunc() then
+    // sets every draw buffer again
+    void setBlendFunci(unsigned int buffer, GLenum source, GLenum destination)
+    {
+        blendSource = blendDestination = UNKNOWN;
+        issued++;
+        glBlendFunci(buffer, source, destination);
+    }
+
+    // glBindBufferRange for GL_UNIFORM_BUFFER and GL_SHADER_STORAGE_BUFFER, size 0 binds the whole buffer
+    void bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size)
+    {
+        BufferRange *cached = NULL;
+        if (index < MAX_BUFFER_BINDINGS && (target == GL_UNIFORM_BUFFER || target == GL_SHADER_STORAGE_BUFFER))
+            cached = &bufferRanges[(target == GL_SHADER_STORAGE_BUFFER ? MAX_BUFFER_BINDINGS : 0) + index];
+        if (cached && cached->buffer == buffer && cached->offset == offset && cached->size == size)
+        {
+            filtered++;
+            return;
+        }
+        if (cached)
+            *cached = {buffer, offset, size};
+        issued++;
+        if (size == 0)
+            glBindBufferBase(target, index, buffer);
+        else
+            glBindBufferRange(target, index, buffer, offset, size);
+    }
+
+    // what a draw issued now would use, for recording it (see pipeline_warmup.cpp); whatever
+    // the cache doesn't know is read back from the driver, once until the next invalidate()
+    struct DrawState
+    {
+        unsigned int program, pipeline, vertexArray;
+        bool depthTest, depthWrite, blend, cullFace;
+        GLenum depthFunc, blendSource, blendDestination;
+    };
+    DrawState drawState()
+    {
+        int value = 0;
+        if (program == UNKNOWN)
+        {
+            glGetIntegerv(GL_CURRENT_PROGRAM, &value);
+            program = (unsigned int)value;
+        }
+        if (pipeline == UNKNOWN)
+        {
+            glGetIntegerv(GL_PROGRAM_PIPELINE_BINDING, &value);
+            pipeline = (unsigned int)value;
+        }
+        if (vertexArray == UNKNOWN)
+        {
+            glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &value);
+            vertexArray = (unsigned int)value;
+        }
+        const GLenum drawCaps[] = {GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE};
+        for (GLenum cap : drawCaps)
+        {
+            if (caps[capIndex(cap)] < 0)
+                caps[capIndex(cap)] = glIsEnabled(cap) ? 1 : 0;
+        }
+        if (depthMask < 0)
+        {
+            GLboolean mask = GL_TRUE;
+            glGetBooleanv(GL_DEPTH_WRITEMASK, &mask);
+            depthMask = mask ? 1 : 0;
+        }
+        if (depthFunc == UNKNOWN)
+        {
+            glGetIntegerv(GL_DEPTH_FUNC, &value);
+            depthFunc = (GLenum)value;
+        }
+        if (blendSource == UNKNOWN || blendDestination == UNKNOWN)
+        {
+            glGetIntegerv(GL_BLEND_SRC_RGB, &value);
+            blendSource = (GLenum)value;
+            glGetIntegerv(GL_BLEND_DST_RGB, &value);
+            blendDestination = (GLenum)value;
+        }
+        return {program,
+                pipeline,
+                vertexArray,
+                caps[capIndex(GL_DEPTH_TEST)] == 1,
+                depthMask == 1,
+                caps[capIndex(GL_BLEND)] == 1,
+                caps[capIndex(GL_CULL_FACE)] == 1,
+                depthFunc,
+                blendSource,
+                blendDestination};
+    }
+
+  private:
+    static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+    static const unsigned int CAP_COUNT = 7;
+
+    unsigned int program;
+    unsigned int pipeline;
+    unsigned int vertexArray;
+    unsigned int activeUnit;
+    GLenum textureTargets[MAX_TEXTURE_UNITS];
+    unsigned int textures[MAX_TEXTURE_UNITS];
+    unsigned int samplers[MAX_TEXTURE_UNITS];
+    // -1 unknown, 0 disabled, 1 enabled
+    int caps[CAP_COUNT];
+    int depthMask;
+    GLenum depthFunc;
+    GLenum blendSource, blendDestination;
+    struct BufferRange
+    {
+        unsigned int buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+    // the uniform buffer bindings, then the storage buffer ones
+    BufferRange bufferRanges[2 * MAX_BUFFER_BINDINGS];
+
+    static int capIndex(GLenum cap)
+    {
+        switch (cap)
+        {
+        case GL_DEPTH_TEST:
+            return 0;
+        case GL_BLEND:
+            return 1;
+        case GL_CULL_FACE:
+            return 2;
+        case GL_STENCIL_TEST:
+            return 3;
+        case GL_SCISSOR_TEST:
+            return 4;
+        case GL_MULTISAMPLE:
+            return 5;
+        case GL_FRAMEBUFFER_SRGB:
+            return 6;
+        default:
+            return -1;
+        }
+    }
+};
+
+// the one cache of the main context
+inline GLStateCache glState;
+
+#endif
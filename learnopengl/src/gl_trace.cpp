@@ -0,0 +1,1519 @@
+#ifndef GL_TRACE_H
+#define GL_TRACE_H
+
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+#include "gl_call_counter.cpp"
+#include "gl_context.cpp"
+#include "lz4.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// GL command stream traces: every call the app makes from right after gladLoadGL() on, with the
+// memory its pointer arguments read, written for the first frames into a compact file that
+// GLTraceReplay plays back on another machine without the app, to compare what the drivers
+// make of the same frames. Like GLCallCounter (gl_call_counter.cpp) the trace swaps glad's
+// function pointers for trampolines, these ones append each call to an LZ4 compressed stream.
+// How big the memory behind a pointer is comes from the rules below by entry point; a pointer
+// argument without a rule is recorded as unknown and its call left out of the replay, which
+// lists them. Offsets into bound buffers (indices, vertex attributes, indirect commands, pixel
+// buffers) are kept as they are, the core profile has no client arrays.
+// Buffers mapped for writing hand the app a shadow copy instead of the driver's memory: before
+// each call that may read them (draws, dispatches, copies, uploads, unmaps) the bytes changed
+// since the last one are copied to the mapping and into the trace, so persistently mapped ring
+// buffers replay too and the driver's memory is never read back.
+// Only one thread and one context may make GL calls and extension entry points the app loads
+// itself aren't seen, main.cpp turns the upload thread, the render thread, the debug window,
+// program binaries and extension loading off while it traces.
+
+enum GLTraceRecord : uint8_t
+{
+    TRACE_CALL = 1,
+    TRACE_MEMORY = 2,
+    TRACE_FRAME = 3
+};
+
+// what follows a call for one of its pointer arguments; one without any keeps its value
+enum GLTracePayload : uint8_t
+{
+    // the bytes it points to
+    TRACE_DATA = 1,
+    // an array of NUL terminated strings
+    TRACE_STRINGS = 2,
+    // written by the call, replayed into scratch memory of at least the given size
+    TRACE_OUTPUT = 3,
+    // object names the call generated, the replay compares its own with them
+    TRACE_NAMES = 4,
+    // memory of a size there is no rule for, the call isn't replayed
+    TRACE_UNKNOWN = 5,
+    // replayed as NULL
+    TRACE_NULLED = 6
+};
+
+// an argument by its type in the entry point's prototype
+enum GLTraceArg : uint8_t
+{
+    TRACE_SCALAR,
+    TRACE_INPUT,
+    TRACE_OUTPUT_POINTER,
+    TRACE_SYNC,
+    TRACE_CALLBACK
+};
+
+template <typename T> constexpr GLTraceArg traceArgKind()
+{
+    if constexpr (std::is_same_v<T, GLsync>)
+        return TRACE_SYNC;
+    else if constexpr (std::is_pointer_v<T>)
+    {
+        using Pointee = std::remove_pointer_t<T>;
+        if constexpr (std::is_function_v<Pointee>)
+            return TRACE_CALLBACK;
+        else if constexpr (std::is_const_v<Pointee>)
+            return TRACE_INPUT;
+        else
+            return TRACE_OUTPUT_POINTER;
+    }
+    else
+        return TRACE_SCALAR;
+}
+
+// any argument or result in 64 bits and back, signed integers sign extended
+template <typename T> uint64_t traceWord(T value)
+{
+    if constexpr (std::is_pointer_v<T>)
+        return (uint64_t)(uintptr_t)value;
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, &value, sizeof(T));
+        return word;
+    }
+    else if constexpr (std::is_signed_v<T>)
+        return (uint64_t)(int64_t)value;
+    else
+        return (uint64_t)value;
+}
+
+template <typename T> T traceValue(uint64_t word)
+{
+    if constexpr (std::is_pointer_v<T>)
+        return (T)(uintptr_t)word;
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+        T value;
+        std::memcpy(&value, &word, sizeof(T));
+        return value;
+    }
+    else
+        return (T)word;
+}
+
+// how big the memory behind one pointer argument is, from the call's other arguments
+enum GLTraceRuleKind : uint8_t
+{
+    // count argument a (1 when a is -1) times scale bytes
+    RULE_BYTES,
+    // NUL terminated, or as long as argument a when that is given and not negative
+    RULE_STRING,
+    // a strings, their optional lengths in argument b, which is replayed as NULL
+    RULE_STRINGS,
+    // pixels of width a, height b and depth c (-1 for 1), format d and type e by the unpack
+    // state, or an offset into the bound pixel unpack buffer
+    RULE_IMAGE,
+    // compressed pixels of argument a bytes, or an offset into the bound pixel unpack buffer
+    RULE_COMPRESSED,
+    // written pixels, or an offset into the bound pixel pack buffer
+    RULE_PACK,
+    // always an offset into a bound buffer
+    RULE_OFFSET,
+    // a object names the call writes
+    RULE_NAMES,
+    // a clear value, 4 components when argument a is GL_COLOR
+    RULE_CLEAR,
+    // a parameter value, 4 components for the colors and swizzles of pname a
+    RULE_PARAMETER,
+    // one texel of format a and type b
+    RULE_TEXEL,
+    // replayed as NULL
+    RULE_NULL
+};
+
+struct GLTraceRule
+{
+    int8_t arg = -1;
+    GLTraceRuleKind kind = RULE_BYTES;
+    int8_t a = -1, b = -1, c = -1, d = -1, e = -1;
+    uint32_t scale = 1;
+};
+
+struct GLTraceRules
+{
+    const char *name;
+    GLTraceRule rules[3];
+};
+
+// the entry points taking memory other than object names and uniforms, see traceRules()
+inline const GLTraceRules GL_TRACE_RULES[] = {
+    {"glBufferData", {{2, RULE_BYTES, 1}}},
+    {"glBufferSubData", {{3, RULE_BYTES, 2}}},
+    {"glBufferStorage", {{2, RULE_BYTES, 1}}},
+    {"glNamedBufferData", {{2, RULE_BYTES, 1}}},
+    {"glNamedBufferSubData", {{3, RULE_BYTES, 2}}},
+    {"glNamedBufferStorage", {{2, RULE_BYTES, 1}}},
+    {"glClearBufferData", {{4, RULE_TEXEL, 2, 3}}},
+    {"glClearBufferSubData", {{6, RULE_TEXEL, 4, 5}}},
+    {"glClearNamedBufferData", {{4, RULE_TEXEL, 2, 3}}},
+    {"glClearNamedBufferSubData", {{6, RULE_TEXEL, 4, 5}}},
+    {"glClearTexImage", {{4, RULE_TEXEL, 2, 3}}},
+    {"glClearTexSubImage", {{10, RULE_TEXEL, 8, 9}}},
+    {"glTexImage1D", {{7, RULE_IMAGE, 3, -1, -1, 5, 6}}},
+    {"glTexImage2D", {{8, RULE_IMAGE, 3, 4, -1, 6, 7}}},
+    {"glTexImage3D", {{9, RULE_IMAGE, 3, 4, 5, 7, 8}}},
+    {"glTexSubImage1D", {{6, RULE_IMAGE, 3, -1, -1, 4, 5}}},
+    {"glTexSubImage2D", {{8, RULE_IMAGE, 4, 5, -1, 6, 7}}},
+    {"glTexSubImage3D", {{10, RULE_IMAGE, 5, 6, 7, 8, 9}}},
+    {"glTextureSubImage1D", {{6, RULE_IMAGE, 3, -1, -1, 4, 5}}},
+    {"glTextureSubImage2D", {{8, RULE_IMAGE, 4, 5, -1, 6, 7}}},
+    {"glTextureSubImage3D", {{10, RULE_IMAGE, 5, 6, 7, 8, 9}}},
+    {"glCompressedTexImage1D", {{6, RULE_COMPRESSED, 5}}},
+    {"glCompressedTexImage2D", {{7, RULE_COMPRESSED, 6}}},
+    {"glCompressedTexImage3D", {{8, RULE_COMPRESSED, 7}}},
+    {"glCompressedTexSubImage1D", {{6, RULE_COMPRESSED, 5}}},
+    {"glCompressedTexSubImage2D", {{8, RULE_COMPRESSED, 7}}},
+    {"glCompressedTexSubImage3D", {{10, RULE_COMPRESSED, 9}}},
+    {"glCompressedTextureSubImage1D", {{6, RULE_COMPRESSED, 5}}},
+    {"glCompressedTextureSubImage2D", {{8, RULE_COMPRESSED, 7}}},
+    {"glCompressedTextureSubImage3D", {{10, RULE_COMPRESSED, 9}}},
+    {"glReadPixels", {{6, RULE_PACK, 2, 3, -1, 4, 5}}},
+    {"glReadnPixels", {{7, RULE_PACK, 2, 3, -1, 4, 5}}},
+    {"glGetTexImage", {{4, RULE_PACK}}},
+    {"glGetnTexImage", {{5, RULE_PACK}}},
+    {"glGetTextureImage", {{5, RULE_PACK}}},
+    {"glGetTextureSubImage", {{11, RULE_PACK}}},
+    {"glGetCompressedTexImage", {{2, RULE_PACK}}},
+    {"glGetnCompressedTexImage", {{3, RULE_PACK}}},
+    {"glGetCompressedTextureImage", {{3, RULE_PACK}}},
+    {"glGetCompressedTextureSubImage", {{9, RULE_PACK}}},
+    {"glDrawElements", {{3, RULE_OFFSET}}},
+    {"glDrawElementsBaseVertex", {{3, RULE_OFFSET}}},
+    {"glDrawElementsInstanced", {{3, RULE_OFFSET}}},
+    {"glDrawElementsInstancedBaseVertex", {{3, RULE_OFFSET}}},
+    {"glDrawElementsInstancedBaseInstance", {{3, RULE_OFFSET}}},
+    {"glDrawElementsInstancedBaseVertexBaseInstance", {{3, RULE_OFFSET}}},
+    {"glDrawRangeElements", {{5, RULE_OFFSET}}},
+    {"glDrawRangeElementsBaseVertex", {{5, RULE_OFFSET}}},
+    {"glDrawArraysIndirect", {{1, RULE_OFFSET}}},
+    {"glDrawElementsIndirect", {{2, RULE_OFFSET}}},
+    {"glMultiDrawArraysIndirect", {{1, RULE_OFFSET}}},
+    {"glMultiDrawElementsIndirect", {{2, RULE_OFFSET}}},
+    {"glMultiDrawArraysIndirectCount", {{1, RULE_OFFSET}}},
+    {"glMultiDrawElementsIndirectCount", {{2, RULE_OFFSET}}},
+    {"glMultiDrawArrays", {{1, RULE_BYTES, 3, -1, -1, -1, -1, 4}, {2, RULE_BYTES, 3, -1, -1, -1, -1, 4}}},
+    {"glMultiDrawElements",
+     {{1, RULE_BYTES, 4, -1, -1, -1, -1, 4}, {3, RULE_BYTES, 4, -1, -1, -1, -1, sizeof(void *)}}},
+    {"glMultiDrawElementsBaseVertex",
+     {{1, RULE_BYTES, 4, -1, -1, -1, -1, 4},
+      {3, RULE_BYTES, 4, -1, -1, -1, -1, sizeof(void *)},
+      {5, RULE_BYTES, 4, -1, -1, -1, -1, 4}}},
+    {"glVertexAttribPointer", {{5, RULE_OFFSET}}},
+    {"glVertexAttribIPointer", {{4, RULE_OFFSET}}},
+    {"glVertexAttribLPointer", {{4, RULE_OFFSET}}},
+    {"glDrawBuffers", {{1, RULE_BYTES, 0, -1, -1, -1, -1, 4}}},
+    {"glNamedFramebufferDrawBuffers", {{2, RULE_BYTES, 1, -1, -1, -1, -1, 4}}},
+    {"glInvalidateFramebuffer", {{2, RULE_BYTES, 1, -1, -1, -1, -1, 4}}},
+    {"glInvalidateSubFramebuffer", {{2, RULE_BYTES, 1, -1, -1, -1, -1, 4}}},
+    {"glInvalidateNamedFramebufferData", {{2, RULE_BYTES, 1, -1, -1, -1, -1, 4}}},
+    {"glInvalidateNamedFramebufferSubData", {{2, RULE_BYTES, 1, -1, -1, -1, -1, 4}}},
+    {"glClearBufferiv", {{2, RULE_CLEAR, 0}}},
+    {"glClearBufferuiv", {{2, RULE_CLEAR, 0}}},
+    {"glClearBufferfv", {{2, RULE_CLEAR, 0}}},
+    {"glClearNamedFramebufferiv", {{3, RULE_CLEAR, 1}}},
+    {"glClearNamedFramebufferuiv", {{3, RULE_CLEAR, 1}}},
+    {"glClearNamedFramebufferfv", {{3, RULE_CLEAR, 1}}},
+    {"glTexParameterfv", {{2, RULE_PARAMETER, 1}}},
+    {"glTexParameteriv", {{2, RULE_PARAMETER, 1}}},
+    {"glTexParameterIiv", {{2, RULE_PARAMETER, 1}}},
+    {"glTexParameterIuiv", {{2, RULE_PARAMETER, 1}}},
+    {"glTextureParameterfv", {{2, RULE_PARAMETER, 1}}},
+    {"glTextureParameteriv", {{2, RULE_PARAMETER, 1}}},
+    {"glTextureParameterIiv", {{2, RULE_PARAMETER, 1}}},
+    {"glTextureParameterIuiv", {{2, RULE_PARAMETER, 1}}},
+    {"glSamplerParameterfv", {{2, RULE_PARAMETER, 1}}},
+    {"glSamplerParameteriv", {{2, RULE_PARAMETER, 1}}},
+    {"glSamplerParameterIiv", {{2, RULE_PARAMETER, 1}}},
+    {"glSamplerParameterIuiv", {{2, RULE_PARAMETER, 1}}},
+    {"glShaderSource", {{2, RULE_STRINGS, 1, 3}, {3, RULE_NULL}}},
+    {"glCreateShaderProgramv", {{2, RULE_STRINGS, 1}}},
+    {"glTransformFeedbackVaryings", {{2, RULE_STRINGS, 1}}},
+    {"glGetUniformIndices", {{2, RULE_STRINGS, 1}}},
+    {"glGetUniformLocation", {{1, RULE_STRING}}},
+    {"glGetUniformBlockIndex", {{1, RULE_STRING}}},
+    {"glGetAttribLocation", {{1, RULE_STRING}}},
+    {"glGetFragDataLocation", {{1, RULE_STRING}}},
+    {"glGetFragDataIndex", {{1, RULE_STRING}}},
+    {"glBindAttribLocation", {{2, RULE_STRING}}},
+    {"glBindFragDataLocation", {{2, RULE_STRING}}},
+    {"glBindFragDataLocationIndexed", {{3, RULE_STRING}}},
+    {"glGetProgramResourceIndex", {{2, RULE_STRING}}},
+    {"glGetProgramResourceLocation", {{2, RULE_STRING}}},
+    {"glGetProgramResourceLocationIndex", {{2, RULE_STRING}}},
+    {"glGetSubroutineIndex", {{2, RULE_STRING}}},
+    {"glGetSubroutineUniformLocation", {{2, RULE_STRING}}},
+    {"glPushDebugGroup", {{3, RULE_STRING, 2}}},
+    {"glObjectLabel", {{3, RULE_STRING, 2}}},
+    {"glDebugMessageInsert", {{5, RULE_STRING, 4}}},
+    {"glDebugMessageControl", {{4, RULE_BYTES, 3, -1, -1, -1, -1, 4}}},
+    {"glDebugMessageCallback", {{1, RULE_NULL}}},
+    {"glProgramBinary", {{2, RULE_BYTES, 3}}},
+    {"glShaderBinary", {{1, RULE_BYTES, 0, -1, -1, -1, -1, 4}, {3, RULE_BYTES, 4}}},
+    {"glSpecializeShader",
+     {{1, RULE_STRING}, {3, RULE_BYTES, 2, -1, -1, -1, -1, 4}, {4, RULE_BYTES, 2, -1, -1, -1, -1, 4}}},
+    {"glUniformSubroutinesuiv", {{2, RULE_BYTES, 1, -1, -1, -1, -1, 4}}},
+    {"glGetActiveUniformsiv", {{2, RULE_BYTES, 1, -1, -1, -1, -1, 4}}},
+    {"glGetProgramResourceiv", {{4, RULE_BYTES, 3, -1, -1, -1, -1, 4}}},
+    {"glBindBuffersBase", {{3, RULE_BYTES, 2, -1, -1, -1, -1, 4}}},
+    {"glBindBuffersRange",
+     {{3, RULE_BYTES, 2, -1, -1, -1, -1, 4},
+      {4, RULE_BYTES, 2, -1, -1, -1, -1, sizeof(GLintptr)},
+      {5, RULE_BYTES, 2, -1, -1, -1, -1, sizeof(GLsizeiptr)}}},
+    {"glBindTextures", {{2, RULE_BYTES, 1, -1, -1, -1, -1, 4}}},
+    {"glBindSamplers", {{2, RULE_BYTES, 1, -1, -1, -1, -1, 4}}},
+    {"glBindImageTextures", {{2, RULE_BYTES, 1, -1, -1, -1, -1, 4}}},
+    {"glBindVertexBuffers",
+     {{2, RULE_BYTES, 1, -1, -1, -1, -1, 4},
+      {3, RULE_BYTES, 1, -1, -1, -1, -1, sizeof(GLintptr)},
+      {4, RULE_BYTES, 1, -1, -1, -1, -1, 4}}},
+    {"glVertexArrayVertexBuffers",
+     {{3, RULE_BYTES, 2, -1, -1, -1, -1, 4},
+      {4, RULE_BYTES, 2, -1, -1, -1, -1, sizeof(GLintptr)},
+      {5, RULE_BYTES, 2, -1, -1, -1, -1, 4}}},
+    {"glViewportArrayv", {{2, RULE_BYTES, 1, -1, -1, -1, -1, 16}}},
+    {"glScissorArrayv", {{2, RULE_BYTES, 1, -1, -1, -1, -1, 16}}},
+    {"glDepthRangeArrayv", {{2, RULE_BYTES, 1, -1, -1, -1, -1, 16}}},
+    {"glViewportIndexedfv", {{1, RULE_BYTES, -1, -1, -1, -1, -1, 16}}},
+    {"glScissorIndexedv", {{1, RULE_BYTES, -1, -1, -1, -1, -1, 16}}},
+    {"glPatchParameterfv", {{1, RULE_BYTES, -1, -1, -1, -1, -1, 16}}},
+    {"glPointParameterfv", {{1, RULE_BYTES, -1, -1, -1, -1, -1, 4}}},
+    {"glPointParameteriv", {{1, RULE_BYTES, -1, -1, -1, -1, -1, 4}}},
+};
+
+// glUniform3fv, glProgramUniformMatrix4x3fv, ...: count times the value's bytes
+inline bool traceUniformRule(std::string_view name, GLTraceRule &rule)
+{
+    int first = 0;
+    if (name.substr(0, 16) == "glProgramUniform")
+    {
+        name.remove_prefix(16);
+        first = 1;
+    }
+    else if (name.substr(0, 9) == "glUniform")
+        name.remove_prefix(9);
+    else
+        return false;
+    if (name.size() < 3 || name.back() != 'v')
+        return false;
+    name.remove_suffix(1);
+    uint32_t elementBytes;
+    if (name.size() > 2 && name.substr(name.size() - 2) == "ui")
+    {
+        elementBytes = 4;
+        name.remove_suffix(2);
+    }
+    else if (name.back() == 'f' || name.back() == 'i' || name.back() == 'd')
+    {
+        elementBytes = name.back() == 'd' ? 8 : 4;
+        name.remove_suffix(1);
+    }
+    else
+        return false;
+    bool matrix = name.substr(0, 6) == "Matrix";
+    if (matrix)
+        name.remove_prefix(6);
+    if (name.empty() || name[0] < '1' || name[0] > '4')
+        return false;
+    uint32_t columns = (uint32_t)(name[0] - '0'), rows = matrix ? columns : 1;
+    if (matrix && name.size() == 3 && name[1] == 'x' && name[2] >= '2' && name[2] <= '4')
+        rows = (uint32_t)(name[2] - '0');
+    else if (name.size() != 1)
+        return false;
+    rule = GLTraceRule{};
+    rule.arg = (int8_t)(first + (matrix ? 3 : 2));
+    rule.kind = RULE_BYTES;
+    rule.a = (int8_t)(first + 1);
+    rule.scale = columns * rows * elementBytes;
+    return true;
+}
+
+// the pointer rules of an entry point by its name
+inline std::vector<GLTraceRule> traceRules(std::string_view name)
+{
+    std::vector<GLTraceRule> rules;
+    for (const GLTraceRules &entry : GL_TRACE_RULES)
+    {
+        if (name != entry.name)
+            continue;
+        for (const GLTraceRule &rule : entry.rules)
+        {
+            if (rule.arg >= 0)
+                rules.push_back(rule);
+        }
+        return rules;
+    }
+    GLTraceRule rule;
+    if (traceUniformRule(name, rule))
+        rules.push_back(rule);
+    // glGenTextures(n, names), glCreateTextures(target, n, names), ...
+    else if (name.substr(0, 5) == "glGen" || name.substr(0, 8) == "glCreate")
+    {
+        bool targeted = name == "glCreateTextures" || name == "glCreateQueries";
+        rule.arg = targeted ? 2 : 1;
+        rule.kind = RULE_NAMES;
+        rule.a = targeted ? 1 : 0;
+        rules.push_back(rule);
+    }
+    // glDeleteTextures(n, names), ...
+    else if (name.substr(0, 8) == "glDelete")
+    {
+        rule.arg = 1;
+        rule.kind = RULE_BYTES;
+        rule.a = 0;
+        rule.scale = 4;
+        rules.push_back(rule);
+    }
+    return rules;
+}
+
+inline size_t tracePixelBytes(GLenum format, GLenum type)
+{
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE_3_3_2:
+    case GL_UNSIGNED_BYTE_2_3_3_REV:
+        return 1;
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_5_6_5_REV:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+    case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+        return 2;
+    case GL_UNSIGNED_INT_8_8_8_8:
+    case GL_UNSIGNED_INT_8_8_8_8_REV:
+    case GL_UNSIGNED_INT_10_10_10_2:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_24_8:
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_5_9_9_9_REV:
+        return 4;
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+        return 8;
+    }
+    size_t components;
+    switch (format)
+    {
+    case GL_RED:
+    case GL_GREEN:
+    case GL_BLUE:
+    case GL_RED_INTEGER:
+    case GL_GREEN_INTEGER:
+    case GL_BLUE_INTEGER:
+    case GL_DEPTH_COMPONENT:
+    case GL_STENCIL_INDEX:
+        components = 1;
+        break;
+    case GL_RG:
+    case GL_RG_INTEGER:
+        components = 2;
+        break;
+    case GL_RGB:
+    case GL_BGR:
+    case GL_RGB_INTEGER:
+    case GL_BGR_INTEGER:
+        components = 3;
+        break;
+    default:
+        components = 4;
+    }
+    switch (type)
+    {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return components;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+        return components * 2;
+    case GL_DOUBLE:
+        return components * 8;
+    default:
+        return components * 4;
+    }
+}
+
+// playback of a trace written by GLTrace, on the thread with a fresh context current
+class GLTraceReplay
+{
+  public:
+    // the framebuffer the trace began with, then the one of the last frame played
+    int width = 0, height = 0;
+    uint64_t calls = 0, skipped = 0;
+    // generated object names that came out differently than in the trace, the calls using
+    // them may not do the same things then
+    uint64_t mismatches = 0;
+
+    // reads and decompresses all of it up front, so playing it only costs the calls
+    bool load(const std::string &path);
+
+    // runs the calls up to the end of the next frame, false once there is none
+    bool playFrame();
+
+    // the entry points whose calls were left out, with how many
+    std::string skippedReport() const;
+
+  private:
+    enum Special : uint8_t
+    {
+        SPECIAL_NONE,
+        SPECIAL_USE_PROGRAM,
+        SPECIAL_UNIFORM,
+        SPECIAL_PROGRAM_UNIFORM,
+        SPECIAL_UNIFORM_LOCATION,
+        SPECIAL_RESOURCE_LOCATION,
+        SPECIAL_UNIFORM_BLOCK_INDEX,
+        SPECIAL_RESOURCE_INDEX,
+        SPECIAL_UNIFORM_BLOCK_BINDING,
+        SPECIAL_STORAGE_BLOCK_BINDING,
+        SPECIAL_FENCE,
+        SPECIAL_MAP,
+        SPECIAL_MAP_RANGE,
+        SPECIAL_NAMED_OBJECT
+    };
+
+    std::vector<std::vector<unsigned char>> chunks;
+    size_t chunk = 0, cursor = 0;
+    // this build's entry point, or -1, of each of the trace's, by the trace's index
+    std::vector<int> entries;
+    std::vector<std::string> names;
+    std::vector<uint64_t> skippedCalls;
+    std::vector<Special> specials;
+    // the trace's sync objects, mappings, uniform locations and block indices to this
+    // context's, the latter two by program in the upper half of the key
+    std::unordered_map<uint64_t, uint64_t> syncs, mappings, locations, uniformBlocks, storageBlocks;
+    uint64_t program = 0;
+    std::vector<unsigned char> scratch;
+    std::vector<const char *> strings;
+
+    static uint64_t key(uint64_t program, uint64_t index)
+    {
+        return program << 32 | (index & 0xFFFFFFFFu);
+    }
+
+    static uint64_t remap(const std::unordered_map<uint64_t, uint64_t> &map, uint64_t from)
+    {
+        auto found = map.find(from);
+        return found == map.end() ? from : found->second;
+    }
+
+    bool playCall(const std::vector<unsigned char> &data);
+};
+
+// writes every GL call of the thread it starts on into a trace file, see the top
+class GLTrace
+{
+  public:
+    static const size_t CHUNK_BYTES = 4 << 20;
+
+    uint64_t calls = 0, frames = 0;
+    // calls with memory of a size the rules don't know, left out of the replay
+    uint64_t unknown = 0;
+    // compressed bytes written so far
+    size_t bytes = 0;
+
+    ~GLTrace()
+    {
+        stop();
+    }
+
+    bool recording() const
+    {
+        return file != NULL;
+    }
+
+    // right after gladLoadGL(), on the thread with the context: the calls from now on to path,
+    // with the framebuffer size for the replay's window; stops by itself after maxFrames
+    bool start(const std::string &path, int maxFrames, int width, int height);
+
+    // after the swap, false once the last frame is in and the trace closed
+    bool endFrame(int width, int height);
+
+    // writes out what is left, the calls after it go straight to the driver
+    void stop();
+
+    // from the trampolines
+    void beforeCall(size_t entry);
+    uint64_t afterCall(size_t entry, const uint64_t *words, size_t count, const GLTraceArg *kinds, bool returns,
+                       uint64_t result);
+
+  private:
+    enum Flags : uint8_t
+    {
+        // may read mapped memory, the shadows are copied over first
+        FLAG_CONSUMES = 1,
+        FLAG_MAP = 2,
+        FLAG_MAP_NAMED = 4,
+        FLAG_MAP_RANGE = 8,
+        FLAG_UNMAP = 16,
+        FLAG_UNMAP_NAMED = 32,
+        FLAG_DELETE_BUFFERS = 64
+    };
+
+    struct Mapping
+    {
+        unsigned int buffer;
+        unsigned char *memory;
+        // what the app writes, and what of it the driver's memory and the trace have
+        std::vector<unsigned char> shadow, sent;
+    };
+
+    FILE *file = NULL;
+    std::string path;
+    uint64_t maxFrames = 0;
+    std::vector<unsigned char> chunk;
+    std::vector<std::vector<GLTraceRule>> rules;
+    std::vector<uint8_t> flags;
+    std::vector<Mapping> mappings;
+
+    template <typename T> void put(T value)
+    {
+        put(&value, sizeof(T));
+    }
+    void put(const void *data, size_t size)
+    {
+        const unsigned char *bytes = (const unsigned char *)data;
+        chunk.insert(chunk.end(), bytes, bytes + size);
+    }
+    // payload data starts 8 byte aligned in its chunk, so the replay can pass it as it is
+    void beginData(GLTracePayload payload, size_t arg, size_t size);
+    void putData(GLTracePayload payload, size_t arg, const void *data, size_t size);
+
+    bool payload(size_t entry, size_t arg, const uint64_t *words, bool input);
+    uint64_t map(size_t entry, const uint64_t *words, uint64_t result);
+    void syncMappings();
+    void flushChunk();
+};
+
+inline GLTrace glTrace;
+
+// extension entry points are outside glad's pointers and so outside the trace, there are none
+// for the app while it traces
+inline void *noGLExtensions(const char *name)
+{
+    (void)name;
+    return NULL;
+}
+
+template <auto *Slot, typename Function = std::remove_pointer_t<decltype(Slot)>> struct GLTraceHook;
+
+// the trampoline of the function pointer at Slot while tracing, and its call when replaying
+template <auto *Slot, typename R, typename... Args> struct GLTraceHook<Slot, R(APIENTRY *)(Args...)>
+{
+    using Function = R(APIENTRY *)(Args...);
+    static const size_t ARGS = sizeof...(Args);
+    // one more, so there is an array for the entry points without arguments
+    static constexpr GLTraceArg kinds[ARGS + 1] = {traceArgKind<Args>()..., TRACE_SCALAR};
+    static inline Function real = NULL;
+    static inline size_t index = 0;
+
+    static R APIENTRY call(Args... args)
+    {
+        if (!glTrace.recording())
+            return real(args...);
+        const uint64_t words[ARGS + 1] = {traceWord(args)..., 0};
+        glTrace.beforeCall(index);
+        if constexpr (std::is_void_v<R>)
+        {
+            real(args...);
+            glTrace.afterCall(index, words, ARGS, kinds, false, 0);
+        }
+        else
+        {
+            R result = real(args...);
+            uint64_t word = glTrace.afterCall(index, words, ARGS, kinds, true, traceWord(result));
+            // mapped memory comes back as its shadow
+            if constexpr (std::is_pointer_v<R>)
+                result = traceValue<R>(word);
+            return result;
+        }
+    }
+
+    static void install(bool on, size_t entry)
+    {
+        if (on && *Slot != NULL && *Slot != &call)
+        {
+            real = *Slot;
+            index = entry;
+            *Slot = &call;
+        }
+        else if (!on && *Slot == &call)
+            *Slot = real;
+    }
+
+    // false when the driver doesn't have the entry point
+    static bool replay(const uint64_t *words, uint64_t &result)
+    {
+        if (*Slot == NULL)
+            return false;
+        result = invoke(words, std::index_sequence_for<Args...>{});
+        return true;
+    }
+
+    template <size_t... I> static uint64_t invoke(const uint64_t *words, std::index_sequence<I...>)
+    {
+        (void)words;
+        if constexpr (std::is_void_v<R>)
+        {
+            (*Slot)(traceValue<Args>(words[I])...);
+            return 0;
+        }
+        else
+            return traceWord((*Slot)(traceValue<Args>(words[I])...));
+    }
+};
+
+struct GLTraceEntry
+{
+    const char *name;
+    void (*install)(bool on, size_t entry);
+    bool (*replay)(const uint64_t *words, uint64_t &result);
+    const GLTraceArg *kinds;
+    size_t args;
+};
+
+#define GL_TRACE_ENTRY(name)                                                                                           \
+    {#name, &GLTraceHook<&glad_##name>::install, &GLTraceHook<&glad_##name>::replay,                                   \
+     GLTraceHook<&glad_##name>::kinds, GLTraceHook<&glad_##name>::ARGS},
+inline const GLTraceEntry glTraceEntries[GLCallCounter::ENTRY_POINTS] = {GL_ENTRY_POINTS(GL_TRACE_ENTRY)};
+#undef GL_TRACE_ENTRY
+
+// the most arguments a GL entry point has (glCopyImageSubData)
+const size_t GL_TRACE_MAX_ARGS = 15;
+
+const char GL_TRACE_MAGIC[4] = {'G', 'L', 'T', 'R'};
+const uint32_t GL_TRACE_VERSION = 1;
+
+// the driver's answer while tracing, without the query landing in the trace
+inline GLint tracedInteger(GLenum pname)
+{
+    GLint value = 0;
+    GLTraceHook<&glad_glGetIntegerv>::real(pname, &value);
+    return value;
+}
+
+// the binding query of a buffer target, 0 for the ones without
+inline GLenum traceBufferBinding(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER:
+        return GL_ARRAY_BUFFER_BINDING;
+    case GL_ELEMENT_ARRAY_BUFFER:
+        return GL_ELEMENT_ARRAY_BUFFER_BINDING;
+    case GL_COPY_READ_BUFFER:
+        return GL_COPY_READ_BUFFER_BINDING;
+    case GL_COPY_WRITE_BUFFER:
+        return GL_COPY_WRITE_BUFFER_BINDING;
+    case GL_PIXEL_PACK_BUFFER:
+        return GL_PIXEL_PACK_BUFFER_BINDING;
+    case GL_PIXEL_UNPACK_BUFFER:
+        return GL_PIXEL_UNPACK_BUFFER_BINDING;
+    case GL_UNIFORM_BUFFER:
+        return GL_UNIFORM_BUFFER_BINDING;
+    case GL_SHADER_STORAGE_BUFFER:
+        return GL_SHADER_STORAGE_BUFFER_BINDING;
+    case GL_DRAW_INDIRECT_BUFFER:
+        return GL_DRAW_INDIRECT_BUFFER_BINDING;
+    case GL_DISPATCH_INDIRECT_BUFFER:
+        return GL_DISPATCH_INDIRECT_BUFFER_BINDING;
+    case GL_ATOMIC_COUNTER_BUFFER:
+        return GL_ATOMIC_COUNTER_BUFFER_BINDING;
+    case GL_QUERY_BUFFER:
+        return GL_QUERY_BUFFER_BINDING;
+    case GL_TRANSFORM_FEEDBACK_BUFFER:
+        return GL_TRANSFORM_FEEDBACK_BUFFER_BINDING;
+    default:
+        return 0;
+    }
+}
+
+// invalidated ranges start out zeroed on both sides, the others as the driver had them
+inline bool traceZeroesMapping(GLbitfield access)
+{
+    return (access & (GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT)) != 0;
+}
+
+inline bool GLTrace::start(const std::string &tracePath, int frameLimit, int width, int height)
+{
+    if (file)
+        return false;
+    file = std::fopen(tracePath.c_str(), "wb");
+    if (!file)
+    {
+        std::cout << "ERROR::GL_TRACE::CANNOT_WRITE: " << tracePath << '\n';
+        return false;
+    }
+    path = tracePath;
+    maxFrames = (uint64_t)std::max(1, frameLimit);
+    uint32_t header[4] = {GL_TRACE_VERSION, (uint32_t)width, (uint32_t)height, (uint32_t)GLCallCounter::ENTRY_POINTS};
+    std::fwrite(GL_TRACE_MAGIC, 1, sizeof(GL_TRACE_MAGIC), file);
+    std::fwrite(header, sizeof(header), 1, file);
+
+    static const char *const consuming[] = {"glDraw",         "glMultiDraw",     "glDispatch",      "glCopy",
+                                            "glTexImage",     "glTexSubImage",   "glTextureSubImage", "glCompressedTex",
+                                            "glUnmap",        "glFlushMapped",   "glFlush",         "glFinish",
+                                            "glMemoryBarrier", "glFenceSync",    "glBlit",          "glReadPixels",
+                                            "glGetBufferSubData", "glGetNamedBufferSubData"};
+    rules.resize(GLCallCounter::ENTRY_POINTS);
+    flags.assign(GLCallCounter::ENTRY_POINTS, 0);
+    for (size_t i = 0; i < GLCallCounter::ENTRY_POINTS; i++)
+    {
+        std::string_view name = glTraceEntries[i].name;
+        uint16_t length = (uint16_t)name.size();
+        std::fwrite(&length, sizeof(length), 1, file);
+        std::fwrite(name.data(), 1, name.size(), file);
+        rules[i] = traceRules(name);
+        for (const char *prefix : consuming)
+        {
+            if (name.substr(0, std::strlen(prefix)) == prefix)
+                flags[i] |= FLAG_CONSUMES;
+        }
+        if (name == "glMapBuffer" || name == "glMapBufferRange")
+            flags[i] |= FLAG_MAP;
+        if (name == "glMapNamedBuffer" || name == "glMapNamedBufferRange")
+            flags[i] |= FLAG_MAP | FLAG_MAP_NAMED;
+        if (name == "glMapBufferRange" || name == "glMapNamedBufferRange")
+            flags[i] |= FLAG_MAP_RANGE;
+        if (name == "glUnmapBuffer")
+            flags[i] |= FLAG_UNMAP;
+        if (name == "glUnmapNamedBuffer")
+            flags[i] |= FLAG_UNMAP | FLAG_UNMAP_NAMED;
+        if (name == "glDeleteBuffers")
+            flags[i] |= FLAG_DELETE_BUFFERS;
+    }
+    for (size_t i = 0; i < GLCallCounter::ENTRY_POINTS; i++)
+        glTraceEntries[i].install(true, i);
+    std::cout << "gl trace: recording " << maxFrames << " frames to " << path << '\n';
+    return true;
+}
+
+inline bool GLTrace::endFrame(int width, int height)
+{
+    if (!file)
+        return false;
+    syncMappings();
+    put<uint8_t>(TRACE_FRAME);
+    put<uint32_t>((uint32_t)width);
+    put<uint32_t>((uint32_t)height);
+    if (++frames < maxFrames)
+        return true;
+    stop();
+    return false;
+}
+
+inline void GLTrace::stop()
+{
+    if (!file)
+        return;
+    syncMappings();
+    flushChunk();
+    std::fclose(file);
+    file = NULL;
+    // the trampolines stay, forwarding, the mappings' shadows are still the app's memory
+    std::cout << "gl trace: " << frames << " frames, " << calls << " calls, " << bytes / (1024 * 1024) << " mb to "
+              << path << '\n';
+    if (unknown)
+        std::cout << "ERROR::GL_TRACE::UNKNOWN_MEMORY: " << unknown << " calls won't replay\n";
+}
+
+inline void GLTrace::beforeCall(size_t entry)
+{
+    if (flags[entry] & FLAG_CONSUMES)
+        syncMappings();
+}
+
+inline uint64_t GLTrace::afterCall(size_t entry, const uint64_t *words, size_t count, const GLTraceArg *kinds,
+                                   bool returns, uint64_t result)
+{
+    uint8_t entryFlags = flags[entry];
+    if ((entryFlags & FLAG_MAP) && result)
+        result = map(entry, words, result);
+
+    put<uint8_t>(TRACE_CALL);
+    put<uint16_t>((uint16_t)entry);
+    put<uint8_t>((uint8_t)count);
+    put<uint8_t>(returns ? 1 : 0);
+    put(words, count * sizeof(uint64_t));
+    if (returns)
+        put(result);
+    size_t payloadsAt = chunk.size();
+    put<uint8_t>(0);
+    uint8_t payloads = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if ((kinds[i] == TRACE_INPUT || kinds[i] == TRACE_OUTPUT_POINTER) && words[i] &&
+            payload(entry, i, words, kinds[i] == TRACE_INPUT))
+            payloads++;
+    }
+    chunk[payloadsAt] = payloads;
+
+    // the shadows went to the driver before the call
+    if (entryFlags & FLAG_UNMAP)
+    {
+        unsigned int buffer = (entryFlags & FLAG_UNMAP_NAMED)
+                                  ? (unsigned int)words[0]
+                                  : (unsigned int)tracedInteger(traceBufferBinding((GLenum)words[0]));
+        mappings.erase(std::remove_if(mappings.begin(), mappings.end(),
+                                      [&](const Mapping &mapping) { return mapping.buffer == buffer; }),
+                       mappings.end());
+    }
+    // deleting a buffer unmaps it
+    if ((entryFlags & FLAG_DELETE_BUFFERS) && words[1])
+    {
+        const GLuint *deleted = (const GLuint *)(uintptr_t)words[1];
+        for (GLsizei i = 0; i < (GLsizei)words[0]; i++)
+            mappings.erase(std::remove_if(mappings.begin(), mappings.end(),
+                                          [&](const Mapping &mapping) { return mapping.buffer == deleted[i]; }),
+                           mappings.end());
+    }
+    calls++;
+    if (chunk.size() >= CHUNK_BYTES)
+        flushChunk();
+    return result;
+}
+
+inline void GLTrace::beginData(GLTracePayload kind, size_t arg, size_t size)
+{
+    put<uint8_t>((uint8_t)arg);
+    put<uint8_t>(kind);
+    put<uint32_t>((uint32_t)size);
+    chunk.resize((chunk.size() + 7) & ~(size_t)7, 0);
+}
+
+inline void GLTrace::putData(GLTracePayload kind, size_t arg, const void *data, size_t size)
+{
+    beginData(kind, arg, size);
+    put(data, size);
+}
+
+// writes the payload of one pointer argument, false when it has none
+inline bool GLTrace::payload(size_t entry, size_t arg, const uint64_t *words, bool input)
+{
+    const GLTraceRule *rule = NULL;
+    for (const GLTraceRule &candidate : rules[entry])
+    {
+        if ((size_t)candidate.arg == arg)
+            rule = &candidate;
+    }
+    const void *pointer = (const void *)(uintptr_t)words[arg];
+    auto count = [&](int8_t index) { return index >= 0 ? (size_t)(int64_t)words[index] : 1; };
+    if (!rule)
+    {
+        put<uint8_t>((uint8_t)arg);
+        if (input)
+        {
+            put<uint8_t>(TRACE_UNKNOWN);
+            unknown++;
+        }
+        else
+        {
+            put<uint8_t>(TRACE_OUTPUT);
+            put<uint32_t>(0);
+        }
+        return true;
+    }
+    switch (rule->kind)
+    {
+    case RULE_BYTES:
+        putData(TRACE_DATA, arg, pointer, count(rule->a) * rule->scale);
+        return true;
+    case RULE_STRING:
+    {
+        int64_t length = rule->a >= 0 ? (int64_t)words[rule->a] : -1;
+        size_t size = length >= 0 ? (size_t)length : std::strlen((const char *)pointer);
+        // with a NUL after it, in case it had none
+        beginData(TRACE_DATA, arg, size + 1);
+        put(pointer, size);
+        put<char>('\0');
+        return true;
+    }
+    case RULE_STRINGS:
+    {
+        const char *const *sources = (const char *const *)pointer;
+        const GLint *lengths = rule->b >= 0 ? (const GLint *)(uintptr_t)words[rule->b] : NULL;
+        uint32_t sourceCount = (uint32_t)count(rule->a);
+        put<uint8_t>((uint8_t)arg);
+        put<uint8_t>(TRACE_STRINGS);
+        put<uint32_t>(sourceCount);
+        for (uint32_t i = 0; i < sourceCount; i++)
+        {
+            uint32_t length =
+                lengths && lengths[i] >= 0 ? (uint32_t)lengths[i] : (uint32_t)std::strlen(sources[i]);
+            put<uint32_t>(length);
+            put(sources[i], length);
+            put<char>('\0');
+        }
+        return true;
+    }
+    case RULE_IMAGE:
+    case RULE_COMPRESSED:
+    {
+        if (tracedInteger(GL_PIXEL_UNPACK_BUFFER_BINDING))
+            return false;
+        size_t size = 0;
+        if (rule->kind == RULE_COMPRESSED)
+            size = (size_t)words[rule->a];
+        else
+        {
+            size_t width = count(rule->a), height = count(rule->b), depth = count(rule->c);
+            size_t pixel = tracePixelBytes((GLenum)words[rule->d], (GLenum)words[rule->e]);
+            // the skip parameters are taken to be 0
+            size_t alignment = (size_t)std::max(1, tracedInteger(GL_UNPACK_ALIGNMENT));
+            GLint rowLength = tracedInteger(GL_UNPACK_ROW_LENGTH), imageHeight = tracedInteger(GL_UNPACK_IMAGE_HEIGHT);
+            size_t row = ((rowLength > 0 ? (size_t)rowLength : width) * pixel + alignment - 1) / alignment * alignment;
+            size_t slice = row * (imageHeight > 0 ? (size_t)imageHeight : height);
+            if (width && height && depth)
+                size = slice * (depth - 1) + row * (height - 1) + width * pixel;
+        }
+        putData(TRACE_DATA, arg, pointer, size);
+        return true;
+    }
+    case RULE_PACK:
+    {
+        if (tracedInteger(GL_PIXEL_PACK_BUFFER_BINDING))
+            return false;
+        // generous for the pack state, it only sizes the replay's scratch memory
+        size_t size = rule->a >= 0 ? (count(rule->a) + 4) * count(rule->b) *
+                                         tracePixelBytes((GLenum)words[rule->d], (GLenum)words[rule->e])
+                                   : 0;
+        put<uint8_t>((uint8_t)arg);
+        put<uint8_t>(TRACE_OUTPUT);
+        put<uint32_t>((uint32_t)size);
+        return true;
+    }
+    case RULE_OFFSET:
+        return false;
+    case RULE_NAMES:
+        putData(TRACE_NAMES, arg, pointer, count(rule->a) * sizeof(GLuint));
+        return true;
+    case RULE_CLEAR:
+        putData(TRACE_DATA, arg, pointer, (GLenum)words[rule->a] == GL_COLOR ? 16 : 4);
+        return true;
+    case RULE_PARAMETER:
+    {
+        GLenum pname = (GLenum)words[rule->a];
+        bool vector = pname == GL_TEXTURE_BORDER_COLOR || pname == GL_TEXTURE_SWIZZLE_RGBA;
+        putData(TRACE_DATA, arg, pointer, vector ? 16 : 4);
+        return true;
+    }
+    case RULE_TEXEL:
+        putData(TRACE_DATA, arg, pointer, tracePixelBytes((GLenum)words[rule->a], (GLenum)words[rule->b]));
+        return true;
+    case RULE_NULL:
+        put<uint8_t>((uint8_t)arg);
+        put<uint8_t>(TRACE_NULLED);
+        return true;
+    }
+    return false;
+}
+
+// a mapping for writing gets a shadow, the app writes that and syncMappings() sends it on
+inline uint64_t GLTrace::map(size_t entry, const uint64_t *words, uint64_t result)
+{
+    uint8_t entryFlags = flags[entry];
+    GLenum target = (GLenum)words[0];
+    unsigned int buffer = (entryFlags & FLAG_MAP_NAMED) ? (unsigned int)words[0]
+                                                        : (unsigned int)tracedInteger(traceBufferBinding(target));
+    GLbitfield access;
+    size_t size;
+    if (entryFlags & FLAG_MAP_RANGE)
+    {
+        size = (size_t)words[2];
+        access = (GLbitfield)words[3];
+    }
+    else
+    {
+        GLenum mode = (GLenum)words[1];
+        access = mode == GL_READ_ONLY ? GL_MAP_READ_BIT
+                 : mode == GL_WRITE_ONLY ? GL_MAP_WRITE_BIT
+                                         : GL_MAP_READ_BIT | GL_MAP_WRITE_BIT;
+        GLint64 bufferSize = 0;
+        if (entryFlags & FLAG_MAP_NAMED)
+            GLTraceHook<&glad_glGetNamedBufferParameteri64v>::real(buffer, GL_BUFFER_SIZE, &bufferSize);
+        else
+            GLTraceHook<&glad_glGetBufferParameteri64v>::real(target, GL_BUFFER_SIZE, &bufferSize);
+        size = (size_t)bufferSize;
+    }
+    if (!(access & GL_MAP_WRITE_BIT) || size == 0)
+        return result;
+    Mapping mapping;
+    mapping.buffer = buffer;
+    mapping.memory = (unsigned char *)(uintptr_t)result;
+    if (traceZeroesMapping(access))
+    {
+        std::memset(mapping.memory, 0, size);
+        mapping.shadow.assign(size, 0);
+    }
+    else
+        mapping.shadow.assign(mapping.memory, mapping.memory + size);
+    mapping.sent = mapping.shadow;
+    mappings.push_back(std::move(mapping));
+    return (uint64_t)(uintptr_t)mappings.back().shadow.data();
+}
+
+// the bytes of every shadow changed since the last time to the driver and the trace
+inline void GLTrace::syncMappings()
+{
+    const size_t BLOCK = 64;
+    for (Mapping &mapping : mappings)
+    {
+        size_t size = mapping.shadow.size();
+        const unsigned char *shadow = mapping.shadow.data();
+        unsigned char *sent = mapping.sent.data();
+        for (size_t offset = 0; offset < size;)
+        {
+            size_t block = std::min(BLOCK, size - offset);
+            if (std::memcmp(shadow + offset, sent + offset, block) == 0)
+            {
+                offset += block;
+                continue;
+            }
+            size_t end = offset + block;
+            while (end < size)
+            {
+                size_t next = std::min(BLOCK, size - end);
+                if (std::memcmp(shadow + end, sent + end, next) == 0)
+                    break;
+                end += next;
+            }
+            std::memcpy(sent + offset, shadow + offset, end - offset);
+            std::memcpy(mapping.memory + offset, shadow + offset, end - offset);
+            put<uint8_t>(TRACE_MEMORY);
+            put<uint64_t>((uint64_t)(uintptr_t)shadow);
+            put<uint64_t>((uint64_t)offset);
+            put<uint32_t>((uint32_t)(end - offset));
+            put(shadow + offset, end - offset);
+            offset = end;
+        }
+    }
+    if (chunk.size() >= CHUNK_BYTES)
+        flushChunk();
+}
+
+// chunks are LZ4 blocks of whole records: raw size, stored size, then the bytes, stored as
+// they are when they don't compress
+inline void GLTrace::flushChunk()
+{
+    if (chunk.empty() || !file)
+        return;
+    std::vector<unsigned char> packed = lz4Compress(chunk.data(), chunk.size());
+    bool stored = packed.size() >= chunk.size();
+    uint32_t sizes[2] = {(uint32_t)chunk.size(), stored ? (uint32_t)chunk.size() : (uint32_t)packed.size()};
+    std::fwrite(sizes, sizeof(sizes), 1, file);
+    std::fwrite(stored ? chunk.data() : packed.data(), 1, sizes[1], file);
+    bytes += sizeof(sizes) + sizes[1];
+    chunk.clear();
+}
+
+inline bool GLTraceReplay::load(const std::string &path)
+{
+    FILE *in = std::fopen(path.c_str(), "rb");
+    if (!in)
+    {
+        std::cout << "ERROR::GL_TRACE::CANNOT_READ: " << path << '\n';
+        return false;
+    }
+    char magic[4] = {};
+    uint32_t header[4] = {};
+    if (std::fread(magic, 1, sizeof(magic), in) != sizeof(magic) || std::fread(header, sizeof(header), 1, in) != 1 ||
+        std::memcmp(magic, GL_TRACE_MAGIC, sizeof(magic)) != 0 || header[0] != GL_TRACE_VERSION)
+    {
+        std::cout << "ERROR::GL_TRACE::NOT_A_TRACE: " << path << '\n';
+        std::fclose(in);
+        return false;
+    }
+    width = (int)header[1];
+    height = (int)header[2];
+
+    std::unordered_map<std::string_view, int> built;
+    for (size_t i = 0; i < GLCallCounter::ENTRY_POINTS; i++)
+        built[glTraceEntries[i].name] = (int)i;
+    names.resize(header[3]);
+    entries.assign(header[3], -1);
+    skippedCalls.assign(header[3], 0);
+    for (uint32_t i = 0; i < header[3]; i++)
+    {
+        uint16_t length = 0;
+        if (std::fread(&length, sizeof(length), 1, in) != 1)
+            break;
+        names[i].resize(length);
+        if (std::fread(names[i].data(), 1, length, in) != length)
+            break;
+        auto found = built.find(names[i]);
+        if (found != built.end())
+            entries[i] = found->second;
+    }
+
+    static const std::pair<const char *, Special> named[] = {
+        {"glUseProgram", SPECIAL_USE_PROGRAM},
+        {"glGetUniformLocation", SPECIAL_UNIFORM_LOCATION},
+        {"glGetProgramResourceLocation", SPECIAL_RESOURCE_LOCATION},
+        {"glGetUniformBlockIndex", SPECIAL_UNIFORM_BLOCK_INDEX},
+        {"glGetProgramResourceIndex", SPECIAL_RESOURCE_INDEX},
+        {"glUniformBlockBinding", SPECIAL_UNIFORM_BLOCK_BINDING},
+        {"glShaderStorageBlockBinding", SPECIAL_STORAGE_BLOCK_BINDING},
+        {"glFenceSync", SPECIAL_FENCE},
+        {"glMapBuffer", SPECIAL_MAP},
+        {"glMapNamedBuffer", SPECIAL_MAP},
+        {"glMapBufferRange", SPECIAL_MAP_RANGE},
+        {"glMapNamedBufferRange", SPECIAL_MAP_RANGE},
+        {"glCreateProgram", SPECIAL_NAMED_OBJECT},
+        {"glCreateShader", SPECIAL_NAMED_OBJECT},
+        {"glCreateShaderProgramv", SPECIAL_NAMED_OBJECT}};
+    specials.assign(GLCallCounter::ENTRY_POINTS, SPECIAL_NONE);
+    for (size_t i = 0; i < GLCallCounter::ENTRY_POINTS; i++)
+    {
+        std::string_view name = glTraceEntries[i].name;
+        GLTraceRule rule;
+        if (name != "glUniformBlockBinding" && traceUniformRule(name, rule))
+            specials[i] = name.substr(0, 9) == "glProgram" ? SPECIAL_PROGRAM_UNIFORM : SPECIAL_UNIFORM;
+        for (const auto &[special, kind] : named)
+        {
+            if (name == special)
+                specials[i] = kind;
+        }
+    }
+    // glUniform1i and the other uniforms without a pointer
+    for (size_t i = 0; i < GLCallCounter::ENTRY_POINTS; i++)
+    {
+        std::string_view name = glTraceEntries[i].name;
+        if (specials[i] != SPECIAL_NONE || name.size() < 11 || name == "glUniformBlockBinding" ||
+            name.substr(0, 18) == "glUniformSubroutin")
+            continue;
+        if (name.substr(0, 9) == "glUniform" && name[9] >= '1' && name[9] <= '4')
+            specials[i] = SPECIAL_UNIFORM;
+        else if (name.substr(0, 16) == "glProgramUniform" && name[16] >= '1' && name[16] <= '4')
+            specials[i] = SPECIAL_PROGRAM_UNIFORM;
+    }
+
+    uint32_t sizes[2];
+    while (std::fread(sizes, sizeof(sizes), 1, in) == 1)
+    {
+        std::vector<unsigned char> stored(sizes[1]);
+        if (std::fread(stored.data(), 1, stored.size(), in) != stored.size())
+            break;
+        if (sizes[0] == sizes[1])
+            chunks.push_back(std::move(stored));
+        else
+        {
+            std::vector<unsigned char> raw(sizes[0]);
+            if (!lz4Decompress(stored.data(), stored.size(), raw.data(), raw.size()))
+            {
+                std::cout << "ERROR::GL_TRACE::CORRUPT_CHUNK: " << chunks.size() << '\n';
+                break;
+            }
+            chunks.push_back(std::move(raw));
+        }
+    }
+    std::fclose(in);
+    return !chunks.empty();
+}
+
+inline bool GLTraceReplay::playFrame()
+{
+    while (chunk < chunks.size())
+    {
+        const std::vector<unsigned char> &data = chunks[chunk];
+        if (cursor >= data.size())
+        {
+            chunk++;
+            cursor = 0;
+            continue;
+        }
+        uint8_t record = data[cursor++];
+        if (record == TRACE_CALL)
+        {
+            if (!playCall(data))
+                return false;
+        }
+        else if (record == TRACE_MEMORY)
+        {
+            uint64_t id, offset;
+            uint32_t size;
+            std::memcpy(&id, &data[cursor], sizeof(id));
+            std::memcpy(&offset, &data[cursor + 8], sizeof(offset));
+            std::memcpy(&size, &data[cursor + 16], sizeof(size));
+            cursor += 20;
+            auto found = mappings.find(id);
+            if (found != mappings.end() && found->second)
+                std::memcpy((unsigned char *)(uintptr_t)found->second + offset, &data[cursor], size);
+            cursor += size;
+        }
+        else if (record == TRACE_FRAME)
+        {
+            uint32_t size[2];
+            std::memcpy(size, &data[cursor], sizeof(size));
+            cursor += sizeof(size);
+            width = (int)size[0];
+            height = (int)size[1];
+            return true;
+        }
+        else
+        {
+            std::cout << "ERROR::GL_TRACE::CORRUPT_RECORD: " << (int)record << '\n';
+            chunk = chunks.size();
+            return false;
+        }
+    }
+    return false;
+}
+
+// one TRACE_CALL record after its type, false when it doesn't parse
+inline bool GLTraceReplay::playCall(const std::vector<unsigned char> &data)
+{
+    uint16_t traced;
+    std::memcpy(&traced, &data[cursor], sizeof(traced));
+    uint8_t count = data[cursor + 2], returns = data[cursor + 3];
+    cursor += 4;
+    if (count > GL_TRACE_MAX_ARGS || traced >= entries.size())
+    {
+        std::cout << "ERROR::GL_TRACE::CORRUPT_CALL: " << traced << '\n';
+        chunk = chunks.size();
+        return false;
+    }
+    uint64_t words[GL_TRACE_MAX_ARGS] = {}, recorded = 0;
+    std::memcpy(words, &data[cursor], count * sizeof(uint64_t));
+    cursor += count * sizeof(uint64_t);
+    if (returns)
+    {
+        std::memcpy(&recorded, &data[cursor], sizeof(recorded));
+        cursor += sizeof(recorded);
+    }
+
+    bool skip = entries[traced] < 0;
+    const unsigned char *names = NULL;
+    size_t nameCount = 0;
+    uint8_t payloads = data[cursor++];
+    strings.clear();
+    for (uint8_t i = 0; i < payloads; i++)
+    {
+        uint8_t arg = data[cursor], payload = data[cursor + 1];
+        cursor += 2;
+        uint32_t size = 0;
+        if (payload == TRACE_DATA || payload == TRACE_NAMES || payload == TRACE_OUTPUT || payload == TRACE_STRINGS)
+        {
+            std::memcpy(&size, &data[cursor], sizeof(size));
+            cursor += sizeof(size);
+        }
+        switch (payload)
+        {
+        case TRACE_DATA:
+        case TRACE_NAMES:
+            cursor = (cursor + 7) & ~(size_t)7;
+            if (payload == TRACE_NAMES)
+            {
+                names = &data[cursor];
+                nameCount = size / sizeof(GLuint);
+                if (scratch.size() < size)
+                    scratch.resize(size);
+                words[arg] = (uint64_t)(uintptr_t)scratch.data();
+            }
+            else
+                words[arg] = (uint64_t)(uintptr_t)&data[cursor];
+            cursor += size;
+            break;
+        case TRACE_STRINGS:
+            for (uint32_t s = 0; s < size; s++)
+            {
+                uint32_t length;
+                std::memcpy(&length, &data[cursor], sizeof(length));
+                cursor += sizeof(length);
+                strings.push_back((const char *)&data[cursor]);
+                cursor += length + 1;
+            }
+            words[arg] = (uint64_t)(uintptr_t)strings.data();
+            break;
+        case TRACE_OUTPUT:
+            if (scratch.size() < std::max<size_t>(size, 1 << 20))
+                scratch.resize(std::max<size_t>(size, 1 << 20));
+            words[arg] = (uint64_t)(uintptr_t)scratch.data();
+            break;
+        case TRACE_NULLED:
+            words[arg] = 0;
+            break;
+        default:
+            skip = true;
+        }
+    }
+    calls++;
+    if (skip)
+    {
+        skipped++;
+        skippedCalls[traced]++;
+        return true;
+    }
+
+    int entry = entries[traced];
+    const GLTraceEntry &target = glTraceEntries[entry];
+    for (size_t i = 0; i < target.args && i < count; i++)
+    {
+        if (target.kinds[i] == TRACE_SYNC)
+            words[i] = remap(syncs, words[i]);
+        else if (target.kinds[i] == TRACE_CALLBACK)
+            words[i] = 0;
+    }
+    Special special = specials[entry];
+    if (special == SPECIAL_UNIFORM)
+        words[0] = remap(locations, key(program, words[0])) & 0xFFFFFFFFu;
+    else if (special == SPECIAL_PROGRAM_UNIFORM)
+        words[1] = remap(locations, key(words[0], words[1])) & 0xFFFFFFFFu;
+    else if (special == SPECIAL_UNIFORM_BLOCK_BINDING)
+        words[1] = remap(uniformBlocks, key(words[0], words[1])) & 0xFFFFFFFFu;
+    else if (special == SPECIAL_STORAGE_BLOCK_BINDING)
+        words[1] = remap(storageBlocks, key(words[0], words[1])) & 0xFFFFFFFFu;
+    else if (special == SPECIAL_USE_PROGRAM)
+        program = words[0];
+
+    uint64_t result = 0;
+    if (!target.replay(words, result))
+    {
+        skipped++;
+        skippedCalls[traced]++;
+        return true;
+    }
+
+    switch (special)
+    {
+    case SPECIAL_UNIFORM_LOCATION:
+        locations[key(words[0], recorded)] = result;
+        break;
+    case SPECIAL_RESOURCE_LOCATION:
+        if ((GLenum)words[1] == GL_UNIFORM)
+            locations[key(words[0], recorded)] = result;
+        break;
+    case SPECIAL_UNIFORM_BLOCK_INDEX:
+        uniformBlocks[key(words[0], recorded)] = result;
+        break;
+    case SPECIAL_RESOURCE_INDEX:
+        if ((GLenum)words[1] == GL_UNIFORM_BLOCK)
+            uniformBlocks[key(words[0], recorded)] = result;
+        else if ((GLenum)words[1] == GL_SHADER_STORAGE_BLOCK)
+            storageBlocks[key(words[0], recorded)] = result;
+        break;
+    case SPECIAL_FENCE:
+        syncs[recorded] = result;
+        break;
+    case SPECIAL_MAP:
+    case SPECIAL_MAP_RANGE:
+        mappings[recorded] = result;
+        if (result && special == SPECIAL_MAP_RANGE && traceZeroesMapping((GLbitfield)words[3]))
+            std::memset((void *)(uintptr_t)result, 0, (size_t)words[2]);
+        break;
+    case SPECIAL_NAMED_OBJECT:
+        mismatches += result != recorded;
+        break;
+    default:
+        break;
+    }
+    if (names && std::memcmp(names, scratch.data(), nameCount * sizeof(GLuint)) != 0)
+        mismatches++;
+    return true;
+}
+
+inline std::string GLTraceReplay::skippedReport() const
+{
+    std::string report;
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        if (skippedCalls[i])
+            report += "  " + names[i] + ": " + std::to_string(skippedCalls[i]) + "\n";
+    }
+    return report;
+}
+
+// --replay-gl: plays a trace in a window of its own as fast as it goes and prints the time
+// each frame took to issue and to finish on the GPU (glFinish after its calls); frame 0 has the
+// startup's calls, creating and filling every object, in it as well
+inline int replayGLTrace(const std::string &path)
+{
+    GLTraceReplay replay;
+    if (!replay.load(path))
+        return 1;
+    GLContextVersion created;
+    GLFWwindow *window = createGLWindow(replay.width, replay.height, "gl trace replay", {4, 6}, created);
+    if (!window)
+        return 1;
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD\n";
+        glfwDestroyWindow(window);
+        return 1;
+    }
+    std::cout << "replaying " << path << " on " << (const char *)glGetString(GL_RENDERER) << ", OpenGL "
+              << created.major << "." << created.minor << '\n';
+
+    using Clock = std::chrono::steady_clock;
+    std::vector<double> issued, finished;
+    while (!glfwWindowShouldClose(window))
+    {
+        Clock::time_point start = Clock::now();
+        uint64_t callsBefore = replay.calls;
+        if (!replay.playFrame())
+            break;
+        double issue = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        glFinish();
+        double finish = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::cout << "frame " << issued.size() << ": " << replay.calls - callsBefore << " calls, issued in " << issue
+                  << " ms, finished in " << finish << " ms\n";
+        issued.push_back(issue);
+        finished.push_back(finish);
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+    // the frames after the first are the steady state
+    if (issued.size() > 1)
+    {
+        double issueSum = 0.0, finishSum = 0.0, finishMin = finished[1], finishMax = finished[1];
+        for (size_t i = 1; i < issued.size(); i++)
+        {
+            issueSum += issued[i];
+            finishSum += finished[i];
+            finishMin = std::min(finishMin, finished[i]);
+            finishMax = std::max(finishMax, finished[i]);
+        }
+        double frames = (double)(issued.size() - 1);
+        std::cout << "frames 1-" << issued.size() - 1 << ": issued in " << issueSum / frames << " ms, finished in "
+                  << finishSum / frames << " ms (min " << finishMin << ", max " << finishMax << ")\n";
+    }
+    std::cout << replay.calls << " calls, " << replay.skipped << " skipped, " << replay.mismatches
+              << " object names differing\n"
+              << replay.skippedReport();
+    glfwDestroyWindow(window);
+    return 0;
+}
+
+#endif
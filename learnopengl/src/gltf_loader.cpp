@@ -0,0 +1,1012 @@
+#ifndef GLTF_LOADER_H
+#define GLTF_LOADER_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include "asset_pack.cpp"
+#include "hash.cpp"
+#include "job_system.cpp"
+#include "json.cpp"
+#include "mesh.cpp"
+#include "mesh_cooker.cpp"
+#include "resource_registry.cpp"
+#include "scene_graph.cpp"
+#include "texture.cpp"
+#include "texture_loader.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// one primitive of the scene placed by a node
+struct GltfDraw
+{
+    // index into the scene's primitives, counted over all meshes
+    size_t primitive;
+    // -1 for the default material
+    int material;
+    // handle in the scene's hierarchy
+    uint32_t node;
+    glm::mat4 model;
+    // index into the scene's skins, -1 for a rigid mesh
+    int skin;
+};
+
+struct GltfMaterial
+{
+    // -1 when there is no base color texture
+    int image = -1;
+    glm::vec4 baseColorFactor = glm::vec4(1.0f);
+    // alphaMode BLEND, drawn back to front after the opaque geometry
+    bool blend = false;
+    // alphaMode MASK discards below this, negative for the other modes
+    float alphaCutoff = -1.0f;
+};
+
+// a node's transform split up the way animations address it, matrix nodes decomposed
+struct GltfNodePose
+{
+    // handle of the parent in the scene's hierarchy, SceneGraph::NO_PARENT for a root
+    uint32_t parent;
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+};
+
+struct GltfSkin
+{
+    // hierarchy handles of the joints, the mesh's JOINTS_0 index into this
+    std::vector<uint32_t> joints;
+    // from the mesh to each joint's space in the bind pose
+    std::vector<glm::mat4> inverseBindMatrices;
+};
+
+enum GltfAnimationPath
+{
+    GLTF_TRANSLATION,
+    GLTF_ROTATION,
+    GLTF_SCALE
+};
+
+// the keys of one animated property of one node, rotations as xyzw quaternions
+struct GltfChannel
+{
+    uint32_t node;
+    GltfAnimationPath path;
+    // STEP holds a key until the next one, LINEAR interpolates; CUBICSPLINE keeps its values
+    // and drops the tangents, so it is played as LINEAR
+    bool step;
+    std::vector<float> times;
+    std::vector<glm::vec4> values;
+};
+
+struct GltfAnimation
+{
+    std::string name;
+    // the last key of any channel
+    float duration = 0.0f;
+    std::vector<GltfChannel> channels;
+};
+
+// Streaming glTF 2.0 importer for .gltf (external or data URI buffers) and .glb files.
+// load() returns right away: a background thread parses the JSON once, reads the buffers
+// in parallel and then decodes the meshes in parallel, handing every finished primitive over
+// as soon as it is done. update() on the GL thread uploads at most uploadBudget primitives
+// per frame and passes the images to the TextureLoader, so the scene fills in over a few
+// frames while everything that arrived is already drawn.
+// Primitives are quantized to cookedMeshLayout() (position, texcoord 0, normal), or
+// skinnedMeshLayout() when they have JOINTS_0 and WEIGHTS_0; skins and the node animations
+// are parsed for the SkinningSystem, which plays them (see skinning.cpp).
+// Exporters repeat content: images referenced twice, materials with the same parameters and
+// meshes copied under other names. Images and materials are merged while the document is
+// built, primitives with the same vertices and indices upload once and share their Mesh
+// through a ResourceRegistry, and the TextureLoader shares identical texture files.
+// Compressed geometry (KHR_draco_mesh_compression, EXT_meshopt_compression) is not decoded:
+// files that require it are rejected, optional uses fall back to the uncompressed data if present.
+class GltfScene
+{
+  public:
+    std::vector<GltfDraw> draws;
+    std::vector<GltfMaterial> materials;
+    // the node transforms in their rest pose, all static
+    SceneGraph hierarchy;
+    // per hierarchy handle
+    std::vector<GltfNodePose> poses;
+    std::vector<GltfSkin> skins;
+    std::vector<GltfAnimation> animations;
+    // primitives uploaded per update()
+    size_t uploadBudget = 4;
+
+    // the buffers are read and the meshes decoded on jobs, which has to outlive the scene
+    GltfScene(TextureLoader &textureLoader, JobSystem &jobs) : textureLoader(textureLoader), jobs(jobs)
+    {
+        const unsigned char white[4] = {255, 255, 255, 255};
+        whiteTexture.create(1, 1, GL_RGBA8, 1);
+        whiteTexture.upload(0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    }
+
+    ~GltfScene()
+    {
+        cancelled = true;
+        if (worker.joinable())
+            worker.join();
+    }
+
+    GltfScene(const GltfScene &) = delete;
+    GltfScene &operator=(const GltfScene &) = delete;
+
+    void load(const std::string &path)
+    {
+        worker = std::thread(&GltfScene::loadDocument, this, path);
+    }
+
+    // GL thread, once per frame; completedFrame is the newest frame the GPU finished
+    // (DeletionQueue::completedFrame), the released meshes up to it are destroyed
+    void update(uint64_t completedFrame)
+    {
+        meshRegistry.pool.collect(completedFrame);
+        std::vector<Primitive> arrived;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (documentReady && !adopted)
+            {
+                adopted = true;
+                draws = std::move(document.draws);
+                hierarchy.reserve(document.nodes.size());
+                for (const Node &node : document.nodes)
+                    hierarchy.add(node.parent, node.local, true);
+                hierarchy.build();
+                for (GltfDraw &draw : draws)
+                    draw.model = hierarchy.world(draw.node);
+                materials = std::move(document.materials);
+                poses.reserve(document.nodes.size());
+                for (const Node &node : document.nodes)
+                    poses.push_back(node.pose);
+                skins = std::move(document.skins);
+                animations = std::move(document.animations);
+                meshes.resize(document.primitiveCount);
+                for (ImageSource &image : document.images)
+                {
+                    // streamed when the loader has a TextureResidency
+                    if (image.bytes.empty())
+                        images.push_back(&textureLoader.load(image.path.c_str(), false, true));
+                    else
+                        images.push_back(&textureLoader.loadMemory(std::move(image.bytes), image.path, false, true));
+                }
+            }
+            size_t count = std::min(uploadBudget, ready.size());
+            arrived.assign(std::make_move_iterator(ready.begin()), std::make_move_iterator(ready.begin() + count));
+            ready.erase(ready.begin(), ready.begin() + count);
+        }
+        for (Primitive &primitive : arrived)
+        {
+            if (primitive.index >= meshes.size())
+                continue;
+            ResourceHandle<Mesh> shared = meshRegistry.find(primitive.hash);
+            meshes[primitive.index] =
+                shared.valid() ? shared
+                               : meshRegistry.create(primitive.hash, primitive.builder,
+                                                     primitive.skinned ? skinnedMeshLayout() : cookedMeshLayout());
+        }
+    }
+
+    // drops the scene's references to its meshes, mesh() is NULL from now on; the last one of a
+    // shared Mesh destroys it once update() sees frame completed, or with the scene
+    void unload(uint64_t frame)
+    {
+        for (ResourceHandle<Mesh> &handle : meshes)
+        {
+            meshRegistry.release(handle, frame);
+            handle = {};
+        }
+    }
+
+    // NULL until the primitive is uploaded
+    const Mesh *mesh(size_t primitive) const
+    {
+        return primitive < meshes.size() ? meshRegistry.get(meshes[primitive]) : NULL;
+    }
+
+    // primitives that reused the Mesh of an identical one, and Meshes uploaded
+    size_t sharedMeshes() const
+    {
+        return meshRegistry.hits;
+    }
+
+    size_t uniqueMeshes() const
+    {
+        return meshRegistry.misses;
+    }
+
+    // white when the material has no texture
+    const Texture2D &baseColorTexture(int material) const
+    {
+        if (material < 0 || material >= (int)materials.size())
+            return whiteTexture;
+        int image = materials[material].image;
+        return image >= 0 && image < (int)images.size() ? *images[image] : whiteTexture;
+    }
+
+    glm::vec4 baseColorFactor(int material) const
+    {
+        if (material < 0 || material >= (int)materials.size())
+            return glm::vec4(1.0f);
+        return materials[material].baseColorFactor;
+    }
+
+    bool isBlended(int material) const
+    {
+        return material >= 0 && material < (int)materials.size() && materials[material].blend;
+    }
+
+    bool isMasked(int material) const
+    {
+        return material >= 0 && material < (int)materials.size() && materials[material].alphaCutoff >= 0.0f;
+    }
+
+    float alphaCutoff(int material) const
+    {
+        return isMasked(material) ? materials[material].alphaCutoff : 0.0f;
+    }
+
+    // every primitive is uploaded, textures may still be decoding in the TextureLoader
+    bool finished() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return (decoded || failed) && ready.empty();
+    }
+
+  private:
+    struct ImageSource
+    {
+        // a file, or only a name when bytes holds the encoded image
+        std::string path;
+        std::vector<unsigned char> bytes;
+        // of bytes, 0 for a file
+        uint64_t hash = 0;
+    };
+    // a placed glTF node, parents come before their children
+    struct Node
+    {
+        uint32_t parent;
+        glm::mat4 local;
+        GltfNodePose pose;
+    };
+    struct Document
+    {
+        std::vector<Node> nodes;
+        std::vector<GltfDraw> draws;
+        std::vector<GltfMaterial> materials;
+        std::vector<ImageSource> images;
+        std::vector<GltfSkin> skins;
+        std::vector<GltfAnimation> animations;
+        size_t primitiveCount = 0;
+        // from a glTF material index to the merged one in materials
+        std::vector<int> materialIndex;
+        // the first place of each glTF node, NO_PARENT when the scene doesn't use it
+        std::vector<uint32_t> placed;
+    };
+    struct Primitive
+    {
+        size_t index;
+        // of the vertices and indices, the stride tells skinned ones apart
+        uint64_t hash = 0;
+        bool skinned = false;
+        MeshBuilder builder = MeshBuilder(OBJ_VERTEX_FLOATS);
+    };
+
+    TextureLoader &textureLoader;
+    JobSystem &jobs;
+    Texture2D whiteTexture;
+    // per primitive, null until uploaded, identical primitives share a handle
+    ResourceRegistry<Mesh> meshRegistry;
+    std::vector<ResourceHandle<Mesh>> meshes;
+    std::vector<const Texture2D *> images;
+
+    std::thread worker;
+    std::atomic<bool> cancelled{false};
+    mutable std::mutex mutex;
+    Document document;
+    bool documentReady = false;
+    bool adopted = false;
+    bool decoded = false;
+    bool failed = false;
+    std::vector<Primitive> ready;
+
+    // the parsed file, only touched by the worker and its tasks
+    JsonValue json;
+    std::vector<std::vector<unsigned char>> buffers;
+    std::filesystem::path directory;
+
+    void fail(const std::string &message)
+    {
+        std::cout << "ERROR::GLTF::" << message << '\n';
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = true;
+    }
+
+    static bool readFile(const std::filesystem::path &path, std::vector<unsigned char> &bytes)
+    {
+        return readFileContents(path.string(), bytes);
+    }
+
+    static bool decodeBase64(const char *text, size_t size, std::vector<unsigned char> &out)
+    {
+        uint32_t bits = 0;
+        int count = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            char c = text[i];
+            int value;
+            if (c >= 'A' && c <= 'Z')
+                value = c - 'A';
+            else if (c >= 'a' && c <= 'z')
+                value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9')
+                value = c - '0' + 52;
+            else if (c == '+')
+                value = 62;
+            else if (c == '/')
+                value = 63;
+            else if (c == '=')
+                break;
+            else
+                return false;
+            bits = bits << 6 | (uint32_t)value;
+            count += 6;
+            if (count >= 8)
+            {
+                count -= 8;
+                out.push_back((unsigned char)(bits >> count));
+            }
+        }
+        return true;
+    }
+
+    // data URIs are decoded, everything else is a %-escaped path relative to the file
+    bool readURI(const std::string &uri, std::vector<unsigned char> &bytes) const
+    {
+        if (uri.compare(0, 5, "data:") == 0)
+        {
+            size_t comma = uri.find(',');
+            if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos)
+                return false;
+            return decodeBase64(uri.c_str() + comma + 1, uri.size() - comma - 1, bytes);
+        }
+        return readFile(directory / std::filesystem::u8path(unescapeURI(uri)), bytes);
+    }
+
+    static std::string unescapeURI(const std::string &uri)
+    {
+        std::string result;
+        for (size_t i = 0; i < uri.size(); i++)
+        {
+            if (uri[i] == '%' && i + 2 < uri.size())
+            {
+                result += (char)std::strtol(uri.substr(i + 1, 2).c_str(), NULL, 16);
+                i += 2;
+            }
+            else
+            {
+                result += uri[i];
+            }
+        }
+        return result;
+    }
+
+    // worker thread
+    void loadDocument(std::string path)
+    {
+        directory = std::filesystem::u8path(path).parent_path();
+        std::vector<unsigned char> file;
+        if (!readFile(std::filesystem::u8path(path), file))
+        {
+            fail("FAILED_TO_LOAD: " + path);
+            return;
+        }
+
+        // .glb: 12 byte header, a JSON chunk and an optional BIN chunk
+        const char *text = (const char *)file.data();
+        size_t textSize = file.size();
+        std::vector<unsigned char> binaryChunk;
+        bool binary = false;
+        if (file.size() >= 20 && std::memcmp(file.data(), "glTF", 4) == 0)
+        {
+            binary = true;
+            size_t offset = 12;
+            while (offset + 8 <= file.size())
+            {
+                uint32_t length, type;
+                std::memcpy(&length, &file[offset], 4);
+                std::memcpy(&type, &file[offset + 4], 4);
+                offset += 8;
+                if (offset + length > file.size())
+                {
+                    fail("TRUNCATED_GLB: " + path);
+                    return;
+                }
+                if (type == 0x4E4F534Au) // JSON
+                {
+                    text = (const char *)&file[offset];
+                    textSize = length;
+                }
+                else if (type == 0x004E4942u) // BIN
+                {
+                    binaryChunk.assign(file.begin() + offset, file.begin() + offset + length);
+                }
+                offset += (length + 3) & ~3u;
+            }
+        }
+
+        std::string error;
+        if (!parseJson(text, textSize, json, error))
+        {
+            fail("INVALID_JSON: " + path + ": " + error);
+            return;
+        }
+        for (const JsonValue &extension : json["extensionsRequired"].array)
+        {
+            // quantized attributes are read like any normalized accessor
+            if (extension.asString() == "KHR_mesh_quantization")
+                continue;
+            fail("UNSUPPORTED_REQUIRED_EXTENSION: " + extension.asString() + " in " + path);
+            return;
+        }
+
+        // buffers in parallel on the job system, the first one of a .glb without uri is the BIN chunk
+        const JsonValue &bufferList = json["buffers"];
+        buffers.resize(bufferList.size());
+        if (binary && bufferList.size() > 0 && !bufferList[0].has("uri"))
+            buffers[0] = std::move(binaryChunk);
+        std::vector<char> readFailed(bufferList.size(), 0);
+        jobs.parallelFor(0, bufferList.size(), 1, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+            {
+                if (bufferList[i].has("uri") && !readURI(bufferList[i]["uri"].asString(), buffers[i]))
+                    readFailed[i] = 1;
+            }
+        });
+        for (char failed : readFailed)
+        {
+            if (failed)
+                std::cout << "ERROR::GLTF::FAILED_TO_READ_BUFFER in " << path << '\n';
+        }
+        if (cancelled)
+            return;
+
+        Document parsed = buildDocument();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            document = std::move(parsed);
+            documentReady = true;
+        }
+
+        // meshes in parallel on the job system, each primitive is handed to the GL thread when it is done
+        const JsonValue &meshList = json["meshes"];
+        std::vector<size_t> firstPrimitives(meshList.size());
+        size_t primitiveCount = 0;
+        for (size_t i = 0; i < meshList.size(); i++)
+        {
+            firstPrimitives[i] = primitiveCount;
+            primitiveCount += meshList[i]["primitives"].size();
+        }
+        jobs.parallelFor(0, meshList.size(), 1, [this, &firstPrimitives](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                decodeMesh(i, firstPrimitives[i]);
+        });
+
+        std::lock_guard<std::mutex> lock(mutex);
+        decoded = true;
+    }
+
+    Document buildDocument()
+    {
+        Document result;
+
+        for (const JsonValue &material : json["materials"].array)
+        {
+            GltfMaterial parsed;
+            const JsonValue &pbr = material["pbrMetallicRoughness"];
+            const JsonValue &factor = pbr["baseColorFactor"];
+            if (factor.size() == 4)
+                parsed.baseColorFactor = glm::vec4(factor[0].asNumber(), factor[1].asNumber(), factor[2].asNumber(),
+                                                   factor[3].asNumber());
+            parsed.blend = material["alphaMode"].asString() == "BLEND";
+            if (material["alphaMode"].asString() == "MASK")
+                parsed.alphaCutoff = (float)material["alphaCutoff"].asNumber(0.5);
+            int texture = pbr["baseColorTexture"]["index"].asInt(-1);
+            if (texture >= 0)
+                parsed.image = json["textures"][texture]["source"].asInt(-1);
+            result.materials.push_back(parsed);
+        }
+
+        for (const JsonValue &image : json["images"].array)
+        {
+            ImageSource source;
+            if (image.has("uri") && image["uri"].asString().compare(0, 5, "data:") != 0)
+            {
+                source.path = (directory / std::filesystem::u8path(unescapeURI(image["uri"].asString()))).string();
+            }
+            else if (image.has("uri"))
+            {
+                source.path = "data URI image";
+                readURI(image["uri"].asString(), source.bytes);
+            }
+            else
+            {
+                source.path = "buffer view image";
+                const std::vector<unsigned char> *view = NULL;
+                size_t offset = 0, length = 0;
+                if (bufferView(image["bufferView"].asInt(-1), view, offset, length))
+                    source.bytes.assign(view->begin() + offset, view->begin() + offset + length);
+            }
+            if (!source.bytes.empty())
+                source.hash = fnv1a64(source.bytes.data(), source.bytes.size());
+            result.images.push_back(std::move(source));
+        }
+
+        // images of the same file or the same bytes, then materials equal once their images are
+        std::vector<int> imageIndex(result.images.size());
+        std::unordered_map<std::string, int> imageFiles;
+        std::unordered_map<uint64_t, int> imageBytes;
+        size_t uniqueImages = 0;
+        for (size_t i = 0; i < result.images.size(); i++)
+        {
+            ImageSource &source = result.images[i];
+            int next = (int)uniqueImages;
+            int index = source.bytes.empty() ? imageFiles.emplace(source.path, next).first->second
+                                             : imageBytes.emplace(source.hash, next).first->second;
+            imageIndex[i] = index;
+            if (index == next)
+                result.images[uniqueImages++] = std::move(source);
+        }
+        result.images.resize(uniqueImages);
+        std::vector<GltfMaterial> parsedMaterials = std::move(result.materials);
+        result.materials.clear();
+        for (GltfMaterial &material : parsedMaterials)
+        {
+            if (material.image >= (int)imageIndex.size())
+                material.image = -1;
+            if (material.image >= 0)
+                material.image = imageIndex[material.image];
+            auto same = std::find_if(result.materials.begin(), result.materials.end(), [&](const GltfMaterial &other) {
+                return other.image == material.image && other.baseColorFactor == material.baseColorFactor &&
+                       other.blend == material.blend && other.alphaCutoff == material.alphaCutoff;
+            });
+            result.materialIndex.push_back((int)(same - result.materials.begin()));
+            if (same == result.materials.end())
+                result.materials.push_back(material);
+        }
+
+        const JsonValue &meshList = json["meshes"];
+        std::vector<size_t> firstPrimitive;
+        for (size_t i = 0; i < meshList.size(); i++)
+        {
+            firstPrimitive.push_back(result.primitiveCount);
+            result.primitiveCount += meshList[i]["primitives"].size();
+        }
+
+        // the default scene, or every root of the first one
+        result.placed.assign(json["nodes"].size(), (uint32_t)SceneGraph::NO_PARENT);
+        const JsonValue &scene = json["scenes"][(size_t)json["scene"].asInt(0)];
+        for (const JsonValue &node : scene["nodes"].array)
+            addNode(node.asInt(-1), SceneGraph::NO_PARENT, firstPrimitive, result, 0);
+
+        // joints and animated nodes refer to the first place of their node
+        for (const JsonValue &skin : json["skins"].array)
+        {
+            GltfSkin parsed;
+            for (const JsonValue &joint : skin["joints"].array)
+            {
+                int index = joint.asInt(-1);
+                bool placed = index >= 0 && index < (int)result.placed.size();
+                parsed.joints.push_back(placed ? result.placed[index] : (uint32_t)SceneGraph::NO_PARENT);
+            }
+            parsed.inverseBindMatrices.assign(parsed.joints.size(), glm::mat4(1.0f));
+            std::vector<double> values;
+            int components;
+            size_t count;
+            if (skin.has("inverseBindMatrices") &&
+                readAccessor(skin["inverseBindMatrices"].asInt(), values, components, count) && components == 16)
+            {
+                for (size_t j = 0; j < count && j < parsed.joints.size(); j++)
+                {
+                    for (int c = 0; c < 16; c++)
+                        glm::value_ptr(parsed.inverseBindMatrices[j])[c] = (float)values[j * 16 + c];
+                }
+            }
+            result.skins.push_back(std::move(parsed));
+        }
+        for (const JsonValue &animation : json["animations"].array)
+            result.animations.push_back(parseAnimation(animation, result.placed));
+        return result;
+    }
+
+    GltfAnimation parseAnimation(const JsonValue &animation, const std::vector<uint32_t> &placed) const
+    {
+        GltfAnimation result;
+        result.name = animation["name"].asString();
+        for (const JsonValue &channel : animation["channels"].array)
+        {
+            const JsonValue &target = channel["target"];
+            const JsonValue &sampler = animation["samplers"][(size_t)channel["sampler"].asInt(-1)];
+            int node = target["node"].asInt(-1);
+            std::string path = target["path"].asString();
+            if (sampler.isNull() || node < 0 || node >= (int)placed.size() || placed[node] == SceneGraph::NO_PARENT)
+                continue;
+            // morph target weights are not supported
+            GltfChannel parsed;
+            if (path == "translation")
+                parsed.path = GLTF_TRANSLATION;
+            else if (path == "rotation")
+                parsed.path = GLTF_ROTATION;
+            else if (path == "scale")
+                parsed.path = GLTF_SCALE;
+            else
+                continue;
+            parsed.node = placed[node];
+            std::string interpolation = sampler["interpolation"].asString();
+            parsed.step = interpolation == "STEP";
+            bool cubic = interpolation == "CUBICSPLINE";
+
+            std::vector<double> times, values;
+            int timeComponents, valueComponents;
+            size_t keys, valueCount;
+            if (!readAccessor(sampler["input"].asInt(-1), times, timeComponents, keys) || timeComponents != 1 ||
+                !readAccessor(sampler["output"].asInt(-1), values, valueComponents, valueCount) ||
+                valueComponents != (parsed.path == GLTF_ROTATION ? 4 : 3) || valueCount != keys * (cubic ? 3 : 1))
+            {
+                std::cout << "ERROR::GLTF::INVALID_ANIMATION_SAMPLER in " << result.name << '\n';
+                continue;
+            }
+            for (size_t k = 0; k < keys; k++)
+            {
+                // a cubic spline key is an in tangent, the value and an out tangent
+                const double *value = &values[(cubic ? k * 3 + 1 : k) * valueComponents];
+                parsed.times.push_back((float)times[k]);
+                parsed.values.push_back(glm::vec4((float)value[0], (float)value[1], (float)value[2],
+                                                  valueComponents == 4 ? (float)value[3] : 0.0f));
+            }
+            if (!parsed.times.empty())
+                result.duration = std::max(result.duration, parsed.times.back());
+            result.channels.push_back(std::move(parsed));
+        }
+        return result;
+    }
+
+    // a node used from several places is added once per place
+    void addNode(int index, uint32_t parent, const std::vector<size_t> &firstPrimitive, Document &result, int depth)
+    {
+        const JsonValue &node = json["nodes"][(size_t)index];
+        // bad files can contain cycles
+        if (index < 0 || node.isNull() || depth > 64)
+            return;
+
+        glm::mat4 local(1.0f);
+        GltfNodePose pose = {parent, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f)};
+        const JsonValue &matrix = node["matrix"];
+        if (matrix.size() == 16)
+        {
+            for (int i = 0; i < 16; i++)
+                glm::value_ptr(local)[i] = (float)matrix[i].asNumber();
+            // without shear, which a pose can't hold
+            pose.translation = glm::vec3(local[3]);
+            pose.scale = glm::vec3(glm::length(glm::vec3(local[0])), glm::length(glm::vec3(local[1])),
+                                   glm::length(glm::vec3(local[2])));
+            if (pose.scale.x > 0.0f && pose.scale.y > 0.0f && pose.scale.z > 0.0f)
+                pose.rotation = glm::quat_cast(glm::mat3(glm::vec3(local[0]) / pose.scale.x,
+                                                         glm::vec3(local[1]) / pose.scale.y,
+                                                         glm::vec3(local[2]) / pose.scale.z));
+        }
+        else
+        {
+            const JsonValue &t = node["translation"], &r = node["rotation"], &s = node["scale"];
+            if (t.size() == 3)
+                pose.translation = glm::vec3(t[0].asNumber(), t[1].asNumber(), t[2].asNumber());
+            if (r.size() == 4)
+                pose.rotation =
+                    glm::quat((float)r[3].asNumber(), (float)r[0].asNumber(), (float)r[1].asNumber(), (float)r[2].asNumber());
+            if (s.size() == 3)
+                pose.scale = glm::vec3(s[0].asNumber(), s[1].asNumber(), s[2].asNumber());
+            local = glm::translate(local, pose.translation) * glm::mat4_cast(pose.rotation);
+            local = glm::scale(local, pose.scale);
+        }
+        uint32_t placed = (uint32_t)result.nodes.size();
+        result.nodes.push_back({parent, local, pose});
+        if (result.placed[index] == SceneGraph::NO_PARENT)
+            result.placed[index] = placed;
+
+        int mesh = node["mesh"].asInt(-1);
+        int skin = node["skin"].asInt(-1);
+        if (skin >= (int)json["skins"].size())
+            skin = -1;
+        if (mesh >= 0 && mesh < (int)firstPrimitive.size())
+        {
+            const JsonValue &primitives = json["meshes"][(size_t)mesh]["primitives"];
+            for (size_t i = 0; i < primitives.size(); i++)
+            {
+                int material = primitives[i]["material"].asInt(-1);
+                if (material >= 0 && material < (int)result.materialIndex.size())
+                    material = result.materialIndex[material];
+                else
+                    material = -1;
+                result.draws.push_back({firstPrimitive[mesh] + i, material, placed, glm::mat4(1.0f), skin});
+            }
+        }
+        for (const JsonValue &child : node["children"].array)
+            addNode(child.asInt(-1), placed, firstPrimitive, result, depth + 1);
+    }
+
+    // resolves a buffer view to its buffer and byte range
+    bool bufferView(int index, const std::vector<unsigned char> *&buffer, size_t &offset, size_t &length) const
+    {
+        const JsonValue &view = json["bufferViews"][(size_t)index];
+        int bufferIndex = view["buffer"].asInt(-1);
+        if (index < 0 || bufferIndex < 0 || bufferIndex >= (int)buffers.size())
+            return false;
+        buffer = &buffers[bufferIndex];
+        offset = (size_t)view["byteOffset"].asNumber(0);
+        length = (size_t)view["byteLength"].asNumber(0);
+        if (buffer->empty() && view["extensions"].has("EXT_meshopt_compression"))
+        {
+            std::cout << "ERROR::GLTF::MESHOPT_NOT_SUPPORTED and no fallback data\n";
+            return false;
+        }
+        return offset + length <= buffer->size();
+    }
+
+    static int componentCount(const std::string &type)
+    {
+        if (type == "SCALAR")
+            return 1;
+        if (type == "VEC2")
+            return 2;
+        if (type == "VEC3")
+            return 3;
+        if (type == "VEC4" || type == "MAT2")
+            return 4;
+        if (type == "MAT3")
+            return 9;
+        if (type == "MAT4")
+            return 16;
+        return 0;
+    }
+
+    static size_t componentSize(int componentType)
+    {
+        switch (componentType)
+        {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+            return 2;
+        case GL_UNSIGNED_INT:
+        case GL_FLOAT:
+            return 4;
+        default:
+            return 0;
+        }
+    }
+
+    static double readComponent(const unsigned char *source, int componentType, bool normalized)
+    {
+        switch (componentType)
+        {
+        case GL_BYTE:
+        {
+            int8_t value;
+            std::memcpy(&value, source, 1);
+            return normalized ? std::max(value / 127.0, -1.0) : value;
+        }
+        case GL_UNSIGNED_BYTE:
+            return normalized ? source[0] / 255.0 : source[0];
+        case GL_SHORT:
+        {
+            int16_t value;
+            std::memcpy(&value, source, 2);
+            return normalized ? std::max(value / 32767.0, -1.0) : value;
+        }
+        case GL_UNSIGNED_SHORT:
+        {
+            uint16_t value;
+            std::memcpy(&value, source, 2);
+            return normalized ? value / 65535.0 : value;
+        }
+        case GL_UNSIGNED_INT:
+        {
+            uint32_t value;
+            std::memcpy(&value, source, 4);
+            return value;
+        }
+        default:
+        {
+            float value;
+            std::memcpy(&value, source, 4);
+            return value;
+        }
+        }
+    }
+
+    // reads an accessor as doubles, components per element as stored, empty on failure
+    bool readAccessor(int index, std::vector<double> &values, int &components, size_t &count) const
+    {
+        const JsonValue &accessor = json["accessors"][(size_t)index];
+        if (index < 0 || accessor.isNull())
+            return false;
+        if (accessor.has("sparse"))
+        {
+            std::cout << "ERROR::GLTF::SPARSE_ACCESSORS_NOT_SUPPORTED\n";
+            return false;
+        }
+        int componentType = accessor["componentType"].asInt();
+        bool normalized = accessor["normalized"].asBool();
+        components = componentCount(accessor["type"].asString());
+        count = (size_t)accessor["count"].asNumber(0);
+        size_t size = componentSize(componentType);
+        if (!components || !size)
+            return false;
+
+        values.assign(count * components, 0.0);
+        // accessors without a buffer view are all zeros
+        if (!accessor.has("bufferView"))
+            return true;
+
+        const std::vector<unsigned char> *buffer;
+        size_t offset, length;
+        int viewIndex = accessor["bufferView"].asInt(-1);
+        if (!bufferView(viewIndex, buffer, offset, length))
+            return false;
+        size_t elementSize = size * components;
+        size_t stride = (size_t)json["bufferViews"][(size_t)viewIndex]["byteStride"].asNumber(0);
+        if (stride == 0)
+            stride = elementSize;
+        offset += (size_t)accessor["byteOffset"].asNumber(0);
+        if (count > 0 && offset + (count - 1) * stride + elementSize > buffer->size())
+            return false;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const unsigned char *element = buffer->data() + offset + i * stride;
+            for (int c = 0; c < components; c++)
+                values[i * components + c] = readComponent(element + c * size, componentType, normalized);
+        }
+        return true;
+    }
+
+    // worker task: converts every triangle list primitive of one mesh
+    void decodeMesh(size_t meshIndex, size_t firstPrimitive)
+    {
+        const JsonValue &primitives = json["meshes"][meshIndex]["primitives"];
+        for (size_t p = 0; p < primitives.size() && !cancelled; p++)
+        {
+            const JsonValue &primitive = primitives[p];
+            const JsonValue &attributes = primitive["attributes"];
+            // mode 4 is triangles, the default
+            if (primitive["mode"].asInt(4) != 4)
+                continue;
+            // compressed primitives only work through their fallback accessors
+            int positionAccessor = attributes["POSITION"].asInt(-1);
+            if (primitive["extensions"].has("KHR_draco_mesh_compression") &&
+                !json["accessors"][(size_t)positionAccessor].has("bufferView"))
+            {
+                std::cout << "ERROR::GLTF::DRACO_NOT_SUPPORTED, skipping a primitive\n";
+                continue;
+            }
+
+            std::vector<double> positions, texCoords, normals, indexValues;
+            int positionComponents, texCoordComponents = 0, normalComponents = 0, indexComponents;
+            size_t vertexCount, texCoordCount = 0, normalCount = 0, indexCount;
+            if (!readAccessor(positionAccessor, positions, positionComponents, vertexCount) ||
+                positionComponents != 3)
+            {
+                std::cout << "ERROR::GLTF::INVALID_POSITIONS, skipping a primitive\n";
+                continue;
+            }
+            if (attributes.has("TEXCOORD_0"))
+                readAccessor(attributes["TEXCOORD_0"].asInt(), texCoords, texCoordComponents, texCoordCount);
+            if (attributes.has("NORMAL"))
+                readAccessor(attributes["NORMAL"].asInt(), normals, normalComponents, normalCount);
+
+            // 4 influences per vertex, the joints have to fit the 8 bit indices
+            std::vector<double> joints, weights;
+            int jointComponents = 0, weightComponents = 0;
+            size_t jointCount = 0, weightCount = 0;
+            bool skinned = attributes.has("JOINTS_0") && attributes.has("WEIGHTS_0") &&
+                           readAccessor(attributes["JOINTS_0"].asInt(), joints, jointComponents, jointCount) &&
+                           readAccessor(attributes["WEIGHTS_0"].asInt(), weights, weightComponents, weightCount) &&
+                           jointComponents == 4 && weightComponents == 4 && jointCount == vertexCount &&
+                           weightCount == vertexCount;
+            if (skinned && !joints.empty() && *std::max_element(joints.begin(), joints.end()) > 255.0)
+            {
+                std::cout << "ERROR::GLTF::TOO_MANY_JOINTS, the primitive is drawn rigid\n";
+                skinned = false;
+            }
+
+            Primitive result;
+            result.index = firstPrimitive + p;
+            result.skinned = skinned;
+            if (skinned)
+                result.builder = MeshBuilder(SKINNED_VERTEX_FLOATS);
+            MeshBuilder &builder = result.builder;
+            builder.vertices.resize(vertexCount * builder.stride, 0.0f);
+            for (size_t v = 0; v < vertexCount; v++)
+            {
+                float *vertex = &builder.vertices[v * builder.stride];
+                for (int c = 0; c < 3; c++)
+                    vertex[c] = (float)positions[v * 3 + c];
+                if (texCoordComponents == 2 && v < texCoordCount)
+                {
+                    vertex[3] = (float)texCoords[v * 2];
+                    vertex[4] = (float)texCoords[v * 2 + 1];
+                }
+                if (normalComponents == 3 && v < normalCount)
+                {
+                    for (int c = 0; c < 3; c++)
+                        vertex[5 + c] = (float)normals[v * 3 + c];
+                }
+                if (skinned)
+                {
+                    // the weights are meant to add up to 1, quantized ones rarely do exactly
+                    double sum = weights[v * 4] + weights[v * 4 + 1] + weights[v * 4 + 2] + weights[v * 4 + 3];
+                    for (int c = 0; c < 4; c++)
+                    {
+                        vertex[OBJ_VERTEX_FLOATS + c] = (float)joints[v * 4 + c];
+                        vertex[OBJ_VERTEX_FLOATS + 4 + c] = sum > 0.0 ? (float)(weights[v * 4 + c] / sum) : c == 0;
+                    }
+                }
+            }
+
+            if (primitive.has("indices"))
+            {
+                if (!readAccessor(primitive["indices"].asInt(), indexValues, indexComponents, indexCount) ||
+                    indexComponents != 1)
+                {
+                    std::cout << "ERROR::GLTF::INVALID_INDICES, skipping a primitive\n";
+                    continue;
+                }
+                builder.indices.reserve(indexCount);
+                bool valid = true;
+                for (double value : indexValues)
+                {
+                    valid = valid && value < vertexCount;
+                    builder.indices.push_back((uint32_t)value);
+                }
+                if (!valid)
+                {
+                    std::cout << "ERROR::GLTF::INDEX_OUT_OF_RANGE, skipping a primitive\n";
+                    continue;
+                }
+            }
+            else
+            {
+                for (size_t v = 0; v < vertexCount; v++)
+                    builder.indices.push_back((uint32_t)v);
+            }
+            builder.endSubmesh();
+            result.hash = fnv1a64(&builder.stride, sizeof(builder.stride));
+            result.hash = fnv1a64(builder.vertices.data(), builder.vertices.size() * sizeof(float), result.hash);
+            result.hash = fnv1a64(builder.indices.data(), builder.indices.size() * sizeof(uint32_t), result.hash);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(std::move(result));
+        }
+    }
+};
+
+#endif
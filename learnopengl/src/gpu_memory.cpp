@@ -0,0 +1,204 @@
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+
+#include "glad/glad.h"
+
+#include "gl_extensions.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// GL_NVX_gpu_memory_info, in KiB
+#ifndef GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX
+#define GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX 0x9047
+#endif
+#ifndef GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX
+#define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#endif
+#ifndef GL_GPU_MEMORY_INFO_EVICTION_COUNT_NVX
+#define GL_GPU_MEMORY_INFO_EVICTION_COUNT_NVX 0x904A
+#endif
+// GL_ATI_meminfo, free KiB first of four values
+#ifndef GL_TEXTURE_FREE_MEMORY_ATI
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#endif
+
+enum GpuMemoryCategory
+{
+    // sampled images with their mip chains
+    GPU_MEMORY_TEXTURES,
+    // framebuffer attachments, recreated with the window size
+    GPU_MEMORY_RENDER_TARGETS,
+    // vertex and index buffers
+    GPU_MEMORY_GEOMETRY,
+    // uniform, storage, indirect, staging and readback buffers
+    GPU_MEMORY_BUFFERS,
+    GPU_MEMORY_CATEGORIES
+};
+
+inline const char *gpuMemoryCategoryName(GpuMemoryCategory category)
+{
+    static const char *const names[GPU_MEMORY_CATEGORIES] = {"textures", "render targets", "geometry", "buffers"};
+    return names[category];
+}
+
+// What the app's textures and buffers take of video memory by category, kept up to date by
+// Texture2D, Texture2DArray and MultisampleTarget as they create and release their storage and
+// by createBuffer() and deleteBuffers() (see gl_objects.cpp), which remember each buffer's size.
+// These are the sizes asked for, drivers pad and align on top. Where the driver tells,
+// queryDriver() reads the free video memory (NVIDIA's GL_NVX_gpu_memory_info, AMD's
+// GL_ATI_meminfo) and textureBudget() keeps the texture streaming below what is left.
+// Textures and buffers may be made on the upload thread, the counters are atomic for it.
+class GpuMemory
+{
+  public:
+    // queryDriver() reads again after this many calls, once per frame that's twice a second
+    static const unsigned int QUERY_INTERVAL = 30;
+
+    std::atomic<uint64_t> bytes[GPU_MEMORY_CATEGORIES] = {};
+    // the driver's numbers, 0 when it has no extension for them; total is only known on NVIDIA
+    uint64_t driverTotal = 0, driverFree = 0;
+    // times the driver moved allocations out of video memory to make room, NVIDIA only
+    int evictions = 0;
+
+    void allocate(GpuMemoryCategory category, uint64_t size)
+    {
+        bytes[category] += size;
+    }
+
+    void release(GpuMemoryCategory category, uint64_t size)
+    {
+        bytes[category] -= size;
+    }
+
+    uint64_t total() const
+    {
+        uint64_t sum = 0;
+        for (const std::atomic<uint64_t> &category : bytes)
+            sum += category.load();
+        return sum;
+    }
+
+    void trackBuffer(unsigned int buffer, uint64_t size, GpuMemoryCategory category)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto [found, inserted] = buffers.try_emplace(buffer, TrackedBuffer{size, category});
+        // a name glDeleteBuffers freed without deleteBuffers() seeing it
+        if (!inserted)
+        {
+            release(found->second.category, found->second.size);
+            found->second = TrackedBuffer{size, category};
+        }
+        allocate(category, size);
+    }
+
+    // before glDeleteBuffers, names createBuffer() didn't make are skipped
+    void releaseBuffers(int count, const unsigned int *names)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < count; i++)
+        {
+            auto found = buffers.find(names[i]);
+            if (found == buffers.end())
+                continue;
+            release(found->second.category, found->second.size);
+            buffers.erase(found);
+        }
+    }
+
+    // on the GL thread, once per frame; reads free video memory every QUERY_INTERVAL calls,
+    // false when the driver has no way to tell
+    bool queryDriver()
+    {
+        if (support == SUPPORT_UNKNOWN)
+            support = hasGLExtension("GL_NVX_gpu_memory_info") ? SUPPORT_NVX
+                      : hasGLExtension("GL_ATI_meminfo")       ? SUPPORT_ATI
+                                                               : SUPPORT_NONE;
+        if (support == SUPPORT_NONE)
+            return false;
+        if (queries++ % QUERY_INTERVAL != 0)
+            return true;
+        if (support == SUPPORT_NVX)
+        {
+            GLint total = 0, available = 0;
+            glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &total);
+            glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+            glGetIntegerv(GL_GPU_MEMORY_INFO_EVICTION_COUNT_NVX, &evictions);
+            driverTotal = (uint64_t)total * 1024;
+            driverFree = (uint64_t)available * 1024;
+        }
+        else
+        {
+            GLint info[4] = {};
+            glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, info);
+            driverFree = (uint64_t)info[0] * 1024;
+        }
+        return true;
+    }
+
+    // what the streamed textures, taking streamed bytes now, may grow to: configured, or less
+    // when the driver says there isn't that much free; keeps a sixteenth of the card, at least
+    // 64 MiB, for render targets that grow with the window and for the rest of the system
+    uint64_t textureBudget(uint64_t configured, uint64_t streamed) const
+    {
+        if (support == SUPPORT_NONE || support == SUPPORT_UNKNOWN || driverFree == 0)
+            return configured;
+        uint64_t headroom = std::max<uint64_t>(64ull * 1024 * 1024, driverTotal / 16);
+        uint64_t available = driverFree > headroom ? driverFree - headroom : 0;
+        return std::min(configured, streamed + available);
+    }
+
+    // the texture quality tier for this card, top mip levels to leave out of the textures: one
+    // at 2 GiB of video memory or less, two at 1 GiB or less, by the total where the driver
+    // tells it and the free memory otherwise; 0 when it tells neither
+    int textureMipSkip() const
+    {
+        const uint64_t GB = 1024ull * 1024 * 1024;
+        uint64_t memory = driverTotal ? driverTotal : driverFree;
+        if (memory == 0)
+            return 0;
+        return memory <= GB ? 2 : memory <= 2 * GB ? 1 : 0;
+    }
+
+    std::string report() const
+    {
+        const uint64_t MB = 1024 * 1024;
+        std::string text = "gpu memory: " + std::to_string(total() / MB) + " mb";
+        for (int i = 0; i < GPU_MEMORY_CATEGORIES; i++)
+            text += std::string(i ? ", " : " (") + gpuMemoryCategoryName((GpuMemoryCategory)i) + " " +
+                    std::to_string(bytes[i].load() / MB);
+        text += ")";
+        if (driverFree)
+            text += ", driver free " + std::to_string(driverFree / MB) + " mb";
+        if (driverTotal)
+            text += " of " + std::to_string(driverTotal / MB) + ", " + std::to_string(evictions) + " evictions";
+        return text + "\n";
+    }
+
+  private:
+    enum Support
+    {
+        SUPPORT_UNKNOWN,
+        SUPPORT_NONE,
+        SUPPORT_NVX,
+        SUPPORT_ATI
+    };
+    struct TrackedBuffer
+    {
+        uint64_t size;
+        GpuMemoryCategory category;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<unsigned int, TrackedBuffer> buffers;
+    Support support = SUPPORT_UNKNOWN;
+    unsigned int queries = 0;
+};
+
+inline GpuMemory gpuMemory;
+
+#endif
@@ -0,0 +1,319 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "glad/glad.h"
+
+#include "cpu_profiler.cpp"
+#include "gl_debug.cpp"
+#include "gl_extensions.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// one collected zone of a pass on the CPU's clock, in CpuProfiler::now() ticks
+struct GpuZoneEvent
+{
+    size_t pass;
+    uint64_t start, end;
+};
+
+// rolling statistics of one pass, in milliseconds
+struct GpuPassStats
+{
+    std::string name;
+    float min = 0.0f, average = 0.0f, p99 = 0.0f, last = 0.0f;
+    // newest samples, at most GpuProfiler::HISTORY
+    std::vector<float> samples;
+    size_t next = 0;
+    // samples added so far, last changes whenever this does
+    size_t count = 0;
+    // the last collected frame's pipeline statistics, summed over the pass's zones, with
+    // GpuProfiler::statistics on and only for passes begun right inside the frame's zone
+    bool hasStatistics = false;
+    uint64_t vertexInvocations = 0, fragmentInvocations = 0;
+    // primitives going into clipping and coming out of it, fewer out means culled or clipped away
+    uint64_t clippingInput = 0, clippingOutput = 0;
+};
+
+// Per-pass GPU timings from GL_TIMESTAMP queries (core since 3.3).
+// begin()/end() put a timestamp before and after a pass, passes may nest or repeat.
+// The queries of a frame are read FRAMES frames later, and only once the GPU has written
+// them, so reading never stalls; a frame whose results still aren't there is dropped.
+// Each pass keeps its last HISTORY samples for min/average/p99.
+// With statistics on, the zones begun directly inside the outermost one (the passes of the
+// frame) also get pipeline statistics queries (GL 4.6 or ARB_pipeline_statistics_query): how
+// many vertex and fragment shader invocations and primitives in and out of clipping the pass
+// cost. Queries of one kind can't nest, deeper zones go without them.
+// With history on, every collected zone also goes into a ring of EVENTS on the CPU profiler's
+// clock, for traces that show both (see hitch_detector.cpp): each frame reads the GPU's clock
+// once with GL_TIMESTAMP next to CpuProfiler::now(), its zones are placed relative to that.
+class GpuProfiler
+{
+  public:
+    static const unsigned int FRAMES = 4;
+    static const size_t HISTORY = 240;
+    static const size_t STATISTICS = 4;
+    static const size_t EVENTS = 1 << 14;
+
+    std::vector<GpuPassStats> passes;
+    bool statistics = false;
+    bool history = false;
+    // the newest collected zones with history on, zone i at events[i % EVENTS], eventCount in all
+    std::vector<GpuZoneEvent> events;
+    uint64_t eventCount = 0;
+
+    // on a context with the queries, returns whether it has them
+    bool enableStatistics()
+    {
+        statistics = GLAD_GL_VERSION_4_6 || hasGLExtension("GL_ARB_pipeline_statistics_query");
+        return statistics;
+    }
+
+    ~GpuProfiler()
+    {
+        for (Frame &frame : frames)
+        {
+            if (!frame.queries.empty())
+                glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+            if (!frame.statisticsQueries.empty())
+                glDeleteQueries((GLsizei)frame.statisticsQueries.size(), frame.statisticsQueries.data());
+        }
+    }
+
+    void beginFrame()
+    {
+        // a pass left open still has to end its queries before the next one begins them
+        for (size_t index : open)
+        {
+            if (frames[current].zones[index].statistics != NO_STATISTICS)
+                endStatistics();
+        }
+        current = (current + 1) % FRAMES;
+        Frame &frame = frames[current];
+        if (frame.used)
+            collect(frame);
+        frame.used = 0;
+        frame.statisticsUsed = 0;
+        frame.zones.clear();
+        open.clear();
+        if (history)
+        {
+            GLint64 gpuTime = 0;
+            glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+            frame.cpuTicks = CpuProfiler::now();
+            frame.gpuTime = (uint64_t)gpuTime;
+        }
+        // history may be turned on before this frame is collected
+        else
+            frame.cpuTicks = 0;
+    }
+
+    void begin(const char *name)
+    {
+        Frame &frame = frames[current];
+        Zone zone;
+        zone.pass = passIndex(name);
+        zone.first = timestamp(frame);
+        if (statistics && open.size() == 1)
+            zone.statistics = beginStatistics(frame);
+        open.push_back(frame.zones.size());
+        frame.zones.push_back(zone);
+        pushDebugGroup(name);
+    }
+
+    void end()
+    {
+        if (open.empty())
+            return;
+        Frame &frame = frames[current];
+        Zone &zone = frame.zones[open.back()];
+        if (zone.statistics != NO_STATISTICS)
+            endStatistics();
+        zone.last = timestamp(frame);
+        open.pop_back();
+        popDebugGroup();
+    }
+
+    // one line per pass, e.g. for the console or an overlay
+    std::string report() const
+    {
+        std::ostringstream out;
+        out.precision(3);
+        out << std::fixed;
+        for (const GpuPassStats &pass : passes)
+        {
+            out << pass.name << ": avg " << pass.average << " ms, min " << pass.min << ", p99 " << pass.p99;
+            if (pass.hasStatistics)
+                out << ", vs " << pass.vertexInvocations << ", fs " << pass.fragmentInvocations << ", primitives "
+                    << pass.clippingInput << " -> " << pass.clippingOutput;
+            out << '\n';
+        }
+        return out.str();
+    }
+
+  private:
+    static constexpr size_t NO_STATISTICS = (size_t)-1;
+    static constexpr GLenum STATISTICS_TARGETS[STATISTICS] = {GL_VERTEX_SHADER_INVOCATIONS,
+                                                              GL_FRAGMENT_SHADER_INVOCATIONS,
+                                                              GL_CLIPPING_INPUT_PRIMITIVES,
+                                                              GL_CLIPPING_OUTPUT_PRIMITIVES};
+
+    struct Zone
+    {
+        size_t pass;
+        size_t first = 0, last = 0;
+        // the first of its STATISTICS queries in statisticsQueries
+        size_t statistics = NO_STATISTICS;
+    };
+    struct Frame
+    {
+        std::vector<unsigned int> queries;
+        size_t used = 0;
+        std::vector<unsigned int> statisticsQueries;
+        size_t statisticsUsed = 0;
+        std::vector<Zone> zones;
+        // both clocks at beginFrame(), with history on
+        uint64_t cpuTicks = 0, gpuTime = 0;
+    };
+
+    Frame frames[FRAMES];
+    unsigned int current = 0;
+    // zones begun but not ended, innermost last
+    std::vector<size_t> open;
+
+    size_t passIndex(const char *name)
+    {
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            if (passes[i].name == name)
+                return i;
+        }
+        passes.emplace_back();
+        passes.back().name = name;
+        return passes.size() - 1;
+    }
+
+    size_t timestamp(Frame &frame)
+    {
+        if (frame.used == frame.queries.size())
+        {
+            frame.queries.push_back(0);
+            glGenQueries(1, &frame.queries.back());
+        }
+        glQueryCounter(frame.queries[frame.used], GL_TIMESTAMP);
+        return frame.used++;
+    }
+
+    size_t beginStatistics(Frame &frame)
+    {
+        if (frame.statisticsUsed == frame.statisticsQueries.size())
+        {
+            frame.statisticsQueries.resize(frame.statisticsUsed + STATISTICS);
+            glGenQueries((GLsizei)STATISTICS, frame.statisticsQueries.data() + frame.statisticsUsed);
+        }
+        for (size_t i = 0; i < STATISTICS; i++)
+            glBeginQuery(STATISTICS_TARGETS[i], frame.statisticsQueries[frame.statisticsUsed + i]);
+        size_t first = frame.statisticsUsed;
+        frame.statisticsUsed += STATISTICS;
+        return first;
+    }
+
+    static void endStatistics()
+    {
+        for (GLenum target : STATISTICS_TARGETS)
+            glEndQuery(target);
+    }
+
+    void collect(Frame &frame)
+    {
+        // queries finish in order, the last one being there means all are
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+
+        std::vector<float> totals(passes.size(), -1.0f);
+        double ticksPerNanosecond = history && frame.cpuTicks ? CpuProfiler::instance().calibrate() * 1e-3 : 0.0;
+        for (const Zone &zone : frame.zones)
+        {
+            if (zone.last == 0)
+                continue;
+            GLuint64 first = 0, last = 0;
+            glGetQueryObjectui64v(frame.queries[zone.first], GL_QUERY_RESULT, &first);
+            glGetQueryObjectui64v(frame.queries[zone.last], GL_QUERY_RESULT, &last);
+            float milliseconds = (float)((double)(last - first) * 1e-6);
+            totals[zone.pass] = std::max(totals[zone.pass], 0.0f) + milliseconds;
+            if (ticksPerNanosecond > 0.0)
+            {
+                if (events.size() < EVENTS)
+                    events.resize(EVENTS);
+                double start = (double)(int64_t)(first - frame.gpuTime) * ticksPerNanosecond;
+                GpuZoneEvent &event = events[eventCount++ % EVENTS];
+                event.pass = zone.pass;
+                event.start = frame.cpuTicks + (uint64_t)(int64_t)start;
+                event.end = event.start + (uint64_t)((double)(last - first) * ticksPerNanosecond);
+            }
+        }
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            if (totals[i] >= 0.0f)
+                addSample(passes[i], totals[i]);
+        }
+        if (frame.statisticsUsed)
+            collectStatistics(frame);
+    }
+
+    void collectStatistics(Frame &frame)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(frame.statisticsQueries[frame.statisticsUsed - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        std::vector<bool> seen(passes.size(), false);
+        for (const Zone &zone : frame.zones)
+        {
+            if (zone.statistics == NO_STATISTICS || zone.last == 0)
+                continue;
+            GLuint64 results[STATISTICS] = {};
+            for (size_t i = 0; i < STATISTICS; i++)
+                glGetQueryObjectui64v(frame.statisticsQueries[zone.statistics + i], GL_QUERY_RESULT, &results[i]);
+            GpuPassStats &pass = passes[zone.pass];
+            if (!seen[zone.pass])
+            {
+                seen[zone.pass] = true;
+                pass.hasStatistics = true;
+                pass.vertexInvocations = pass.fragmentInvocations = pass.clippingInput = pass.clippingOutput = 0;
+            }
+            pass.vertexInvocations += results[0];
+            pass.fragmentInvocations += results[1];
+            pass.clippingInput += results[2];
+            pass.clippingOutput += results[3];
+        }
+    }
+
+    static void addSample(GpuPassStats &pass, float milliseconds)
+    {
+        if (pass.samples.size() < HISTORY)
+            pass.samples.push_back(milliseconds);
+        else
+            pass.samples[pass.next] = milliseconds;
+        pass.next = (pass.next + 1) % HISTORY;
+        pass.last = milliseconds;
+        pass.count++;
+
+        std::vector<float> sorted(pass.samples);
+        std::sort(sorted.begin(), sorted.end());
+        float sum = 0.0f;
+        for (float sample : sorted)
+            sum += sample;
+        pass.min = sorted.front();
+        pass.average = sum / (float)sorted.size();
+        pass.p99 = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+    }
+};
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef GPU_SORT_H
+#define GPU_SORT_H
+
+#include "glad/glad.h"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "shader.cpp"
+#include "shader_compiler.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Sorting and its building blocks on the GPU, over storage buffers of uints, for whatever
+// has its data there already (particles, transparent fragments, queued draws, binned lights):
+// - sort() is an LSD radix sort of 32 or 64 bit keys, optionally with a uint value each,
+//   4 bits per pass (shader_src/radix_sort.comp): every group counts the digits of its tile of
+//   TILE keys, the counts are prefix summed digit major and every group moves its keys to
+//   the offsets that gives, stable within the tile. Passes ping-pong between the caller's
+//   buffers and scratch ones, the result ends up in the caller's.
+// - scan() is an exclusive prefix sum in place (shader_src/prefix_sum.comp), blocks of 512
+//   scanned in shared memory, their totals scanned the same way one level down and added back.
+// - compact() packs the values flagged 1 to the front of a buffer and writes how many there
+//   are where an indirect dispatch or draw can read it (shader_src/stream_compact.comp).
+// Every call ends with a barrier for storage, buffer update and indirect command reads; other
+// uses of the results need their own. Storage bindings 18 to 22 are free for the dispatches.
+// Tiles are dispatched in one dimension, so at most 65535 tiles (some 67M keys) per call.
+class GpuSort
+{
+  public:
+    static const int RADIX_BITS = 4;
+    // keys per group of radix_sort.comp, and values per group of prefix_sum.comp
+    static const size_t TILE = 1024;
+    static const size_t SCAN_BLOCK = 512;
+
+    explicit GpuSort(ShaderCompiler &compiler) : compiler(compiler)
+    {
+    }
+
+    ~GpuSort()
+    {
+        for (Scratch *scratch : {&keyScratch, &valueScratch, &counts, &offsets})
+            deleteBuffers(1, &scratch->buffer);
+        for (Scratch &level : sums)
+            deleteBuffers(1, &level.buffer);
+    }
+
+    GpuSort(const GpuSort &) = delete;
+    GpuSort &operator=(const GpuSort &) = delete;
+
+    // compute shaders and storage buffers are core since 4.3
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    // sorts count keys of keyWords uints each (1 or 2, the low word first) in keys, moving the
+    // values along when values isn't 0; only the low keyBits bits are compared, 0 for all
+    void sort(unsigned int keys, unsigned int values, size_t count, int keyWords = 1, int keyBits = 0)
+    {
+        keyWords = std::clamp(keyWords, 1, 2);
+        if (keyBits <= 0 || keyBits > 32 * keyWords)
+            keyBits = 32 * keyWords;
+        if (count < 2)
+            return;
+        size_t groups = (count + TILE - 1) / TILE;
+        unsigned int sortedKeys = grow(keyScratch, count * keyWords * sizeof(uint32_t));
+        unsigned int sortedValues = values ? grow(valueScratch, count * sizeof(uint32_t)) : 0;
+        unsigned int digitCounts = grow(counts, groups * ((size_t)1 << RADIX_BITS) * sizeof(uint32_t));
+        Program &countPass = program(keyWords == 2 ? COUNT_64 : COUNT_32);
+        Program &scatterPass = program(keyWords == 2 ? (values ? SCATTER_64_VALUES : SCATTER_64)
+                                                     : (values ? SCATTER_32_VALUES : SCATTER_32));
+
+        int passes = 0;
+        for (int shift = 0; shift < keyBits; shift += RADIX_BITS, passes++)
+        {
+            countPass.shader->use();
+            countPass.shader->set(countPass.count, (unsigned int)count);
+            countPass.shader->set(countPass.shift, (unsigned int)shift);
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 18, keys, 0, 0);
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 19, digitCounts, 0, 0);
+            glDispatchCompute((GLuint)groups, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            scanBlocks(digitCounts, groups << RADIX_BITS, 0);
+
+            scatterPass.shader->use();
+            scatterPass.shader->set(scatterPass.count, (unsigned int)count);
+            scatterPass.shader->set(scatterPass.shift, (unsigned int)shift);
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 18, keys, 0, 0);
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 19, digitCounts, 0, 0);
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 22, sortedKeys, 0, 0);
+            if (values)
+            {
+                glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 20, values, 0, 0);
+                glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 21, sortedValues, 0, 0);
+            }
+            glDispatchCompute((GLuint)groups, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            std::swap(keys, sortedKeys);
+            std::swap(values, sortedValues);
+        }
+        // an odd number of passes left the keys in the scratch buffers
+        if (passes % 2)
+        {
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            copyBuffer(keys, sortedKeys, 0, 0, count * keyWords * sizeof(uint32_t));
+            if (values)
+                copyBuffer(values, sortedValues, 0, 0, count * sizeof(uint32_t));
+        }
+        finish();
+    }
+
+    // exclusive prefix sum of count uints of buffer, in place
+    void scan(unsigned int buffer, size_t count)
+    {
+        if (count == 0)
+            return;
+        scanBlocks(buffer, count, 0);
+        finish();
+    }
+
+    // the values whose flag is 1 (flags are 0 or 1) to the front of compacted in their order,
+    // how many to the first uint of compactedCount
+    void compact(unsigned int values, unsigned int flags, size_t count, unsigned int compacted,
+                 unsigned int compactedCount)
+    {
+        if (count == 0)
+            return;
+        unsigned int scanned = grow(offsets, count * sizeof(uint32_t));
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        copyBuffer(flags, scanned, 0, 0, count * sizeof(uint32_t));
+        scanBlocks(scanned, count, 0);
+        Program &pass = program(COMPACT);
+        pass.shader->use();
+        pass.shader->set(pass.count, (unsigned int)count);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 18, values, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 19, flags, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 20, scanned, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 21, compacted, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 22, compactedCount, 0, 0);
+        glDispatchCompute((GLuint)((count + 255) / 256), 1, 1);
+        finish();
+    }
+
+    // submits every program ahead of its first use, which would otherwise build it then
+    void prepare()
+    {
+        for (int i = 0; i < PROGRAMS; i++)
+            program((ProgramIndex)i, false);
+    }
+
+  private:
+    enum ProgramIndex
+    {
+        COUNT_32,
+        COUNT_64,
+        SCATTER_32,
+        SCATTER_64,
+        SCATTER_32_VALUES,
+        SCATTER_64_VALUES,
+        SCAN,
+        ADD_BLOCK_SUMS,
+        COMPACT,
+        PROGRAMS
+    };
+    struct Program
+    {
+        Shader *shader = NULL;
+        UniformHandle count, shift;
+    };
+    // a buffer that only grows
+    struct Scratch
+    {
+        unsigned int buffer = 0;
+        size_t bytes = 0;
+    };
+
+    ShaderCompiler &compiler;
+    Program programs[PROGRAMS];
+    Scratch keyScratch, valueScratch, counts, offsets;
+    // the block totals of every level of a scan
+    std::vector<Scratch> sums;
+
+    // with lookup the program is linked and its uniforms found, prepare() doesn't wait for that
+    Program &program(ProgramIndex index, bool lookup = true)
+    {
+        Program &entry = programs[index];
+        if (!entry.shader)
+        {
+            switch (index)
+            {
+            case SCAN:
+                entry.shader = &compiler.submitCompute("src/shader_src/prefix_sum.comp");
+                break;
+            case ADD_BLOCK_SUMS:
+                entry.shader = &compiler.submitCompute("src/shader_src/prefix_sum.comp", {"ADD_BLOCK_SUMS"});
+                break;
+            case COMPACT:
+                entry.shader = &compiler.submitCompute("src/shader_src/stream_compact.comp");
+                break;
+            default:
+            {
+                bool wide = index == COUNT_64 || index == SCATTER_64 || index == SCATTER_64_VALUES;
+                std::vector<std::string> defines = {wide ? "KEY_WORDS 2" : "KEY_WORDS 1"};
+                if (index == COUNT_32 || index == COUNT_64)
+                    defines.push_back("COUNT_DIGITS");
+                if (index == SCATTER_32_VALUES || index == SCATTER_64_VALUES)
+                    defines.push_back("VALUES");
+                entry.shader = &compiler.submitCompute("src/shader_src/radix_sort.comp", defines);
+            }
+            }
+        }
+        if (lookup && !entry.count.valid())
+        {
+            entry.shader->use();
+            entry.count = entry.shader->uniform("count");
+            entry.shift = entry.shader->uniform("shift");
+        }
+        return entry;
+    }
+
+    unsigned int grow(Scratch &scratch, size_t bytes)
+    {
+        if (scratch.bytes < bytes)
+        {
+            deleteBuffers(1, &scratch.buffer);
+            // a little over, so a count creeping up doesn't reallocate every frame
+            scratch.bytes = bytes + bytes / 4;
+            scratch.buffer = createBuffer(scratch.bytes, NULL, 0);
+        }
+        return scratch.buffer;
+    }
+
+    void scanBlocks(unsigned int buffer, size_t count, size_t level)
+    {
+        size_t blocks = (count + SCAN_BLOCK - 1) / SCAN_BLOCK;
+        if (sums.size() <= level)
+            sums.resize(level + 1);
+        unsigned int blockSums = grow(sums[level], blocks * sizeof(uint32_t));
+        Program &scanPass = program(SCAN);
+        scanPass.shader->use();
+        scanPass.shader->set(scanPass.count, (unsigned int)count);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 18, buffer, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 19, blockSums, 0, 0);
+        glDispatchCompute((GLuint)blocks, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        if (blocks < 2)
+            return;
+        scanBlocks(blockSums, blocks, level + 1);
+        Program &addPass = program(ADD_BLOCK_SUMS);
+        addPass.shader->use();
+        addPass.shader->set(addPass.count, (unsigned int)count);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 18, buffer, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 19, blockSums, 0, 0);
+        glDispatchCompute((GLuint)blocks, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    static void finish()
+    {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+};
+
+#endif
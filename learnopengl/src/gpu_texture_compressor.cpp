@@ -0,0 +1,104 @@
+#ifndef GPU_TEXTURE_COMPRESSOR_H
+#define GPU_TEXTURE_COMPRESSOR_H
+
+#include "glad/glad.h"
+
+#include "gl_extensions.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "shader.cpp"
+#include "shader_compiler.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+// Block compresses textures made on the GPU at run time, which never pass the texture cooker:
+// shader_src/bc_compress.comp encodes every 4x4 block of a level into a buffer, BC1 or BC3 with
+// alpha the way texture_cooker.cpp does on the CPU, the buffer is uploaded to a new texture as
+// the GL_PIXEL_UNPACK_BUFFER and the new texture replaces the RGBA8 one. One dispatch per level
+// covers every layer. BC3 is a quarter of RGBA8 and BC1 an eighth, in memory and in what the
+// samplers read.
+class GpuTextureCompressor
+{
+  public:
+    // blocks one group encodes per side
+    static const int GROUP_SIZE = 8;
+    // unit the source is read from while compressing
+    static const unsigned int TEXTURE_UNIT = 0;
+
+    explicit GpuTextureCompressor(ShaderCompiler &compiler)
+        : shader(compiler.submitCompute("src/shader_src/bc_compress.comp"))
+    {
+    }
+
+    // compute shaders since 4.3, and a driver that samples S3TC
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_3 && hasGLExtension("GL_EXT_texture_compression_s3tc");
+    }
+
+    // every level of every layer of an RGBA8 array as BC1, or BC3 with alpha; false leaves it as it was
+    bool compress(Texture2DArray &texture, bool alpha)
+    {
+        if (texture.internalFormat != GL_RGBA8)
+        {
+            std::cout << "ERROR::GPU_TEXTURE_COMPRESSOR::UNSUPPORTED_FORMAT: " << texture.internalFormat << '\n';
+            return false;
+        }
+        size_t blockBytes = alpha ? 16 : 8;
+        std::vector<size_t> offsets, sizes;
+        size_t total = 0;
+        for (int level = 0; level < texture.levels; level++)
+        {
+            size_t blocksX = (size_t)(std::max(1, texture.width >> level) + 3) / 4;
+            size_t blocksY = (size_t)(std::max(1, texture.height >> level) + 3) / 4;
+            offsets.push_back(total);
+            sizes.push_back(blocksX * blocksY * texture.layers * blockBytes);
+            total += sizes.back();
+        }
+        unsigned int blocks = createBuffer(total, NULL, 0);
+
+        shader.use();
+        if (!levelLoc.valid())
+        {
+            levelLoc = shader.uniform("level");
+            alphaLoc = shader.uniform("alpha");
+            firstWordLoc = shader.uniform("firstWord");
+        }
+        shader.set(alphaLoc, alpha);
+        texture.bind(TEXTURE_UNIT);
+        glState.bindSampler(TEXTURE_UNIT, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, blocks, 0, 0);
+        for (int level = 0; level < texture.levels; level++)
+        {
+            int blocksX = (std::max(1, texture.width >> level) + 3) / 4;
+            int blocksY = (std::max(1, texture.height >> level) + 3) / 4;
+            shader.set(levelLoc, level);
+            shader.set(firstWordLoc, (unsigned int)(offsets[level] / 4));
+            glDispatchCompute((blocksX + GROUP_SIZE - 1) / GROUP_SIZE, (blocksY + GROUP_SIZE - 1) / GROUP_SIZE,
+                              texture.layers);
+        }
+        glMemoryBarrier(GL_PIXEL_BUFFER_BARRIER_BIT);
+
+        Texture2DArray compressed(texture.width, texture.height, texture.layers,
+                                  alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                                  texture.levels, texture.category);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, blocks);
+        for (int level = 0; level < texture.levels; level++)
+            compressed.uploadCompressed(level, sizes[level], (const void *)offsets[level]);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        // the driver keeps it until the uploads are done
+        deleteBuffers(1, &blocks);
+        texture = std::move(compressed);
+        return true;
+    }
+
+  private:
+    Shader &shader;
+    UniformHandle levelLoc, alphaLoc, firstWordLoc;
+};
+
+#endif
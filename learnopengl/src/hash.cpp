@@ -0,0 +1,47 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// 64-bit FNV-1a, good enough to key cache files and asset names
+inline uint64_t fnv1a64(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// A multiply and xor-shift over 8 byte words, several times faster than fnv1a64 on large
+// blocks, for telling whether uploaded data changed; the tail is mixed in byte by byte
+inline uint64_t hashWords64(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i * 8, 8);
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    }
+    return fnv1a64(bytes + words * 8, size - words * 8, hash);
+}
+
+// the same hash of text, usable in constant expressions, e.g. to hash a literal at compile time
+constexpr uint64_t fnv1a64(const char *text, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef HITCH_DETECTOR_H
+#define HITCH_DETECTOR_H
+
+#include "cpu_profiler.cpp"
+#include "gpu_profiler.cpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// what the renderer counted over one frame
+struct FrameCounters
+{
+    unsigned int drawCalls = 0;
+    uint64_t triangles = 0;
+    unsigned int uniformUploads = 0;
+    unsigned int stateChanges = 0;
+    // 0 unless the GL call counter is on
+    uint64_t glCalls = 0;
+};
+
+// Catches the rare slow frame an average hides. Every frame's time and counters go into a
+// rolling window next to the CPU profiler's per thread rings and, with GpuProfiler::history
+// on, the GPU zones; a frame over threshold times the median of the last MEDIAN_FRAMES (and
+// over minimumMs) has the last windowSeconds of all of it written as a chrome://tracing /
+// Perfetto trace, the frames as counter tracks and the hitch as a marker. The trace is
+// written GpuProfiler::FRAMES + 1 frames later, once the GPU zones of the frame are in, and
+// since writing it is a hitch of its own nothing is caught for cooldownSeconds after.
+class HitchDetector
+{
+  public:
+    static const size_t MEDIAN_FRAMES = 300;
+    static const size_t RECORDS = 2048;
+    // the thread id the GPU zones show up as
+    static const int GPU_TRACK = 1000;
+
+    float threshold = 2.0f;
+    float minimumMs = 5.0f;
+    double windowSeconds = 3.0;
+    double cooldownSeconds = 10.0;
+    int maxCaptures = 20;
+    // traces go to <prefix>_<n>.json
+    std::string prefix = "hitch";
+    int captures = 0;
+
+    // right after the swap, with the counters of the frame it ended
+    void endFrame(const FrameCounters &counters, const GpuProfiler &gpu)
+    {
+        uint64_t now = CpuProfiler::now();
+        double ticksPerMicrosecond = CpuProfiler::instance().calibrate();
+        if (lastEnd == 0)
+        {
+            lastEnd = now;
+            return;
+        }
+        Record &record = records[recordCount++ % RECORDS];
+        record = {lastEnd, now, counters};
+        lastEnd = now;
+        float milliseconds = (float)((double)(record.end - record.start) / ticksPerMicrosecond * 1e-3);
+
+        if (pending > 0 && --pending == 0)
+            write(gpu, ticksPerMicrosecond);
+        bool warm = durations.size() == MEDIAN_FRAMES;
+        if (warm && pending == 0 && captures < maxCaptures && now >= cooldownUntil)
+        {
+            float median = this->median();
+            if (milliseconds > std::max(minimumMs, threshold * median))
+            {
+                hitch = record;
+                hitchMs = milliseconds;
+                hitchMedian = median;
+                pending = GpuProfiler::FRAMES + 1;
+                cooldownUntil = now + (uint64_t)(cooldownSeconds * 1e6 * ticksPerMicrosecond);
+            }
+        }
+        if (durations.size() < MEDIAN_FRAMES)
+            durations.push_back(milliseconds);
+        else
+            durations[nextDuration] = milliseconds;
+        nextDuration = (nextDuration + 1) % MEDIAN_FRAMES;
+    }
+
+  private:
+    struct Record
+    {
+        uint64_t start, end;
+        FrameCounters counters;
+    };
+
+    Record records[RECORDS] = {};
+    uint64_t recordCount = 0;
+    uint64_t lastEnd = 0;
+    std::vector<float> durations, sorted;
+    size_t nextDuration = 0;
+    // frames until the caught hitch is written, 0 when none is
+    unsigned int pending = 0;
+    Record hitch = {};
+    float hitchMs = 0.0f, hitchMedian = 0.0f;
+    uint64_t cooldownUntil = 0;
+
+    float median()
+    {
+        sorted.assign(durations.begin(), durations.end());
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        return sorted[sorted.size() / 2];
+    }
+
+    void write(const GpuProfiler &gpu, double ticksPerMicrosecond)
+    {
+        CpuProfiler &profiler = CpuProfiler::instance();
+        std::string path = prefix + "_" + std::to_string(++captures) + ".json";
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cout << "ERROR::HITCH_DETECTOR::CANNOT_WRITE: " << path << '\n';
+            return;
+        }
+        uint64_t window = (uint64_t)(windowSeconds * 1e6 * ticksPerMicrosecond);
+        uint64_t since = hitch.end > window ? hitch.end - window : 0;
+        out.precision(3);
+        out << std::fixed << "{\"traceEvents\":[";
+        out << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << GPU_TRACK
+            << ",\"args\":{\"name\":\"GPU\"}}";
+        bool first = false;
+        profiler.writeChromeEvents(out, ticksPerMicrosecond, since, first);
+
+        uint64_t gpuBegin = gpu.eventCount > GpuProfiler::EVENTS ? gpu.eventCount - GpuProfiler::EVENTS : 0;
+        for (uint64_t i = gpuBegin; i < gpu.eventCount; i++)
+        {
+            const GpuZoneEvent &event = gpu.events[i % GpuProfiler::EVENTS];
+            if (event.end < since)
+                continue;
+            out << ",\n{\"name\":\"" << gpu.passes[event.pass].name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                << GPU_TRACK << ",\"ts\":" << profiler.microseconds(event.start, ticksPerMicrosecond)
+                << ",\"dur\":" << (double)(event.end - event.start) / ticksPerMicrosecond << "}";
+        }
+
+        uint64_t recordBegin = recordCount > RECORDS ? recordCount - RECORDS : 0;
+        for (uint64_t i = recordBegin; i < recordCount; i++)
+        {
+            const Record &record = records[i % RECORDS];
+            if (record.end < since)
+                continue;
+            out << ",\n{\"name\":\"frame\",\"ph\":\"C\",\"pid\":0,\"ts\":"
+                << profiler.microseconds(record.start, ticksPerMicrosecond) << ",\"args\":{\"ms\":"
+                << (double)(record.end - record.start) / ticksPerMicrosecond * 1e-3
+                << ",\"draws\":" << record.counters.drawCalls << ",\"triangles\":" << record.counters.triangles
+                << ",\"uniforms\":" << record.counters.uniformUploads
+                << ",\"state changes\":" << record.counters.stateChanges
+                << ",\"gl calls\":" << record.counters.glCalls << "}}";
+        }
+        out << ",\n{\"name\":\"hitch\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"ts\":"
+            << profiler.microseconds(hitch.start, ticksPerMicrosecond) << ",\"args\":{\"ms\":" << hitchMs
+            << ",\"median ms\":" << hitchMedian << ",\"draws\":" << hitch.counters.drawCalls
+            << ",\"triangles\":" << hitch.counters.triangles << ",\"gl calls\":" << hitch.counters.glCalls << "}}";
+        out << "\n]}\n";
+        std::cout << "hitch: " << hitchMs << " ms (median " << hitchMedian << " ms), the last " << windowSeconds
+                  << " s written to " << path << '\n';
+    }
+};
+
+#endif
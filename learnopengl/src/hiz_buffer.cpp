@@ -0,0 +1,255 @@
+#ifndef HIZ_BUFFER_H
+#define HIZ_BUFFER_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "gl_state.cpp"
+#include "shader.cpp"
+#include "single_pass_downsampler.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <vector>
+
+// Hierarchical depth pyramid of the previous frame for occlusion culling.
+// build() copies the depth buffer of the bound read framebuffer and reduces it with
+// shader_src/hiz_reduce.comp, every texel of level n holding the farthest depth of the
+// texels it covers in level n - 1. An object whose nearest depth is behind the farthest
+// depth under its screen rectangle was hidden last frame, see cull.comp.
+// With a SinglePassDownsampler the levels below 0 are one dispatch of it instead of one each.
+// The pyramid is paired with the viewProjection it was rendered with. Given a second reduce
+// program of the opposite order with keepNearest(), the same build() also reduces the depth copy
+// into a pyramid of the nearest depths, which screen space rays skip empty space with
+// (see screen_space_reflections.cpp).
+class HiZBuffer
+{
+  public:
+    // texture unit the pyramid (and the depth copy while reducing) is sampled from
+    static const unsigned int TEXTURE_UNIT = 7;
+    // local size of hiz_reduce.comp in both dimensions
+    static const int GROUP_SIZE = 8;
+
+    Texture2D depth;
+    Texture2D pyramid;
+    // the nearest depth of the texels each covers, after keepNearest()
+    Texture2D nearest;
+    int width = 0, height = 0;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    // false until the first build(), the cull pass skips the occlusion test until then
+    bool valid = false;
+    // the depth was drawn reversed (near 1, far 0), the pyramid keeps the smallest depth then
+    bool reversedZ = false;
+
+    HiZBuffer(Shader &reduceShader, SinglePassDownsampler *downsampler = NULL)
+        : reduceShader(reduceShader), downsampler(downsampler)
+    {
+    }
+
+    // compute shaders and image load/store are core since 4.3
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    // builds the nearest pyramid as well from now on, nearestReduceShader being hiz_reduce.comp
+    // with the reversedZ constant the other way round
+    void keepNearest(Shader &nearestReduceShader)
+    {
+        nearestShader = &nearestReduceShader;
+        width = height = 0;
+    }
+
+    // call after the opaque geometry of a frame is drawn, w x h is the framebuffer size
+    void build(int w, int h, const glm::mat4 &frameViewProjection)
+    {
+        if (w <= 0 || h <= 0)
+            return;
+        if (w != width || h != height)
+        {
+            width = w;
+            height = h;
+            depth.create(width, height, GL_DEPTH_COMPONENT32F, 1, GPU_MEMORY_RENDER_TARGETS);
+            pyramid.create(width, height, GL_R32F, 0, GPU_MEMORY_RENDER_TARGETS);
+            sourceLoc = reduceShader.uniform("fromDepth");
+            reversedLoc = reduceShader.uniform("reversedZ");
+            if (nearestShader)
+            {
+                nearest.create(width, height, GL_R32F, 0, GPU_MEMORY_RENDER_TARGETS);
+                nearestSourceLoc = nearestShader->uniform("fromDepth");
+                nearestReversedLoc = nearestShader->uniform("reversedZ");
+            }
+        }
+
+        // the depth buffer lands in a texture, converted to 32-bit float
+        if (Texture2D::hasDSA())
+        {
+            glCopyTextureSubImage2D(depth.ID, 0, 0, 0, 0, 0, width, height);
+        }
+        else
+        {
+            depth.bind(TEXTURE_UNIT);
+            glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+        }
+
+        reduce(reduceShader, sourceLoc, reversedLoc, reversedZ, pyramid);
+        if (nearestShader)
+            reduce(*nearestShader, nearestSourceLoc, nearestReversedLoc, !reversedZ, nearest);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        viewProjection = frameViewProjection;
+        valid = true;
+    }
+
+    void bind() const
+    {
+        pyramid.bind(TEXTURE_UNIT);
+    }
+
+  private:
+    Shader &reduceShader;
+    SinglePassDownsampler *downsampler;
+    UniformHandle sourceLoc, reversedLoc;
+    Shader *nearestShader = NULL;
+    UniformHandle nearestSourceLoc, nearestReversedLoc;
+
+    // the depth copy into every level of target, keeping the smallest depth when smallest
+    void reduce(Shader &shader, UniformHandle source, UniformHandle reversed, bool smallest, Texture2D &target)
+    {
+        shader.use();
+        shader.set(reversed, smallest);
+        depth.bind(TEXTURE_UNIT);
+        for (int level = 0; level < (downsampler ? 1 : target.levels); level++)
+        {
+            // level 0 is read from the depth copy, every other level from the one above it
+            shader.set(source, level == 0);
+            if (level > 0)
+                glBindImageTexture(0, target.ID, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+            glBindImageTexture(1, target.ID, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            int levelWidth = std::max(1, width >> level), levelHeight = std::max(1, height >> level);
+            glDispatchCompute((levelWidth + GROUP_SIZE - 1) / GROUP_SIZE, (levelHeight + GROUP_SIZE - 1) / GROUP_SIZE,
+                              1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+        if (downsampler)
+            downsampler->generate(target, smallest ? DOWNSAMPLE_MIN : DOWNSAMPLE_MAX);
+    }
+};
+
+// Fallback occlusion culling for the per-draw path with GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+// queries (GL_ANY_SAMPLES_PASSED before 4.3). Every object keeps the last result it got: a
+// visible object is drawn inside its query, a hidden one only has its bounds drawn inside it,
+// with color and depth writes off. Results are read once they are available, never waited
+// on, so visibility lags a frame or two behind. With conditional rendering a hidden object's
+// draw is also sent, inside glBeginConditionalRender on its newest query, and the GPU skips
+// it or not by itself with no lag; visible objects then only query every RECHECK_FRAMES.
+class OcclusionQueries
+{
+  public:
+    // frames between the queries of an object that stays visible, in conditional mode
+    static const unsigned int RECHECK_FRAMES = 8;
+
+    // objects skipped since the last resetStats()
+    unsigned int occluded = 0;
+
+    ~OcclusionQueries()
+    {
+        if (!queries.empty())
+            glDeleteQueries((GLsizei)queries.size(), queries.data());
+    }
+
+    void resize(size_t count)
+    {
+        size_t old = queries.size();
+        if (count <= old)
+            return;
+        queries.resize(count);
+        glGenQueries((GLsizei)(count - old), &queries[old]);
+        target = GLAD_GL_VERSION_4_3 ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+        visible.resize(count, 1);
+        pending.resize(count, 0);
+    }
+
+    // once a frame
+    void resetStats()
+    {
+        occluded = 0;
+        frame++;
+    }
+
+    // picks up a finished result and returns whether the object was visible last time
+    bool isVisible(size_t index)
+    {
+        if (pending[index])
+        {
+            GLuint available = 0;
+            glGetQueryObjectuiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint samples = 0;
+                glGetQueryObjectuiv(queries[index], GL_QUERY_RESULT, &samples);
+                visible[index] = samples != 0;
+                pending[index] = 0;
+            }
+        }
+        if (!visible[index])
+            occluded++;
+        return visible[index] != 0;
+    }
+
+    // the draws between begin() and end() decide the next result, an object whose last
+    // query is still in flight is drawn without a new one
+    bool begin(size_t index)
+    {
+        if (pending[index])
+            return false;
+        glBeginQuery(target, queries[index]);
+        pending[index] = 1;
+        return true;
+    }
+
+    void end()
+    {
+        glEndQuery(target);
+    }
+
+    // whether a visible object queries again this frame, the objects take turns
+    bool recheck(size_t index) const
+    {
+        return (frame + index) % RECHECK_FRAMES == 0;
+    }
+
+    // the draws until endConditional() only happen if the object's newest query passed, one
+    // still in flight from an earlier frame included; GL_QUERY_NO_WAIT draws if it isn't done
+    void beginConditional(size_t index) const
+    {
+        glBeginConditionalRender(queries[index], GL_QUERY_NO_WAIT);
+    }
+
+    static void endConditional()
+    {
+        glEndConditionalRender();
+    }
+
+    // bounds of hidden objects are drawn invisibly
+    static void beginProxy()
+    {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glState.setDepthMask(false);
+    }
+
+    static void endProxy()
+    {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glState.setDepthMask(true);
+    }
+
+  private:
+    GLenum target = GL_ANY_SAMPLES_PASSED_CONSERVATIVE;
+    size_t frame = 0;
+    std::vector<unsigned int> queries;
+    std::vector<char> visible;
+    std::vector<char> pending;
+};
+
+#endif
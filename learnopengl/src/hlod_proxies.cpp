@@ -0,0 +1,179 @@
+#ifndef HLOD_PROXIES_H
+#define HLOD_PROXIES_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "frustum_culler.cpp"
+#include "mesh.cpp"
+#include "mesh_cooker.cpp"
+#include "mesh_simplifier.cpp"
+#include "static_batches.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+// Hierarchical levels of detail for the cells of a streamed world (see world_partition.cpp):
+// the objects of a cell merged into one proxy mesh, drawn in place of all of them once the cell
+// is past the ones whose objects are resident. buildHlodProxy() runs on the streaming thread
+// when a cell is read or generated: it places the source mesh at every object, groups them by
+// material into one submesh each and simplifies those with simplifyMesh() within maxError, so a
+// proxy is a draw per material instead of one per object, all of them textured from the one
+// materials array. A proxy is relative to its cell's corner and HlodProxies places it with a
+// model matrix relative to the floating origin, as precise as the cubes far from 0.
+struct HlodProxy
+{
+    glm::ivec2 cell = glm::ivec2(0);
+    // in world units, what the vertices are relative to
+    glm::dvec3 corner = glm::dvec3(0.0);
+    std::unique_ptr<MeshBuilder> mesh;
+    // of each submesh
+    std::vector<int> materials;
+    // the bounding sphere, relative to corner
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
+
+// the proxy of count objects of source (OBJ_VERTEX_FLOATS, as parseOBJ() writes it) placed with
+// models and textured with materials, in the mesh's builder; false when there is nothing to merge
+inline bool buildHlodProxy(const MeshBuilder &source, const glm::mat4 *models, const int *materials, size_t count,
+                           float maxError, HlodProxy &proxy)
+{
+    proxy.mesh.reset();
+    proxy.materials.clear();
+    if (count == 0 || source.stride != OBJ_VERTEX_FLOATS || source.indices.empty())
+        return false;
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return materials[a] < materials[b]; });
+
+    auto merged = std::make_unique<MeshBuilder>(OBJ_VERTEX_FLOATS);
+    merged->vertices.reserve(count * source.vertices.size());
+    merged->indices.reserve(count * source.indices.size());
+    glm::vec3 low(1e30f), high(-1e30f);
+    for (size_t first = 0; first < count;)
+    {
+        size_t last = first + 1;
+        while (last < count && materials[order[last]] == materials[order[first]])
+            last++;
+        uint32_t firstIndex = (uint32_t)merged->indices.size();
+        for (size_t o = first; o < last; o++)
+            appendTransformedMesh(source, models[order[o]], *merged, low, high);
+
+        // half the triangles, unless that moves the surface by more than maxError; the
+        // vertices the dropped ones leave behind stay in the buffer
+        std::vector<uint32_t> group(merged->indices.begin() + firstIndex, merged->indices.end());
+        float error = 0.0f;
+        std::vector<uint32_t> simplified = simplifyMesh(*merged, group, group.size() / 6 * 3, maxError, error);
+        if (!simplified.empty() && simplified.size() < group.size())
+        {
+            merged->indices.resize(firstIndex);
+            merged->indices.insert(merged->indices.end(), simplified.begin(), simplified.end());
+        }
+        merged->submeshes.push_back({firstIndex, (uint32_t)merged->indices.size() - firstIndex});
+        proxy.materials.push_back(materials[order[first]]);
+        first = last;
+    }
+    proxy.center = (low + high) * 0.5f;
+    proxy.radius = glm::length(high - proxy.center);
+    proxy.mesh = std::move(merged);
+    return true;
+}
+
+// The proxies uploaded for drawing, on the GL thread: add() the ones the streaming built,
+// remove() the ones it let go, cull() the ones to draw this frame into visible.
+class HlodProxies
+{
+  public:
+    struct Proxy
+    {
+        glm::ivec2 cell;
+        glm::dvec3 corner;
+        std::unique_ptr<Mesh> mesh;
+        std::vector<int> materials;
+        glm::vec3 center;
+        float radius;
+        // of the last cull(), relative to its origin
+        glm::mat4 model;
+    };
+
+    // one submesh of a proxy
+    struct Draw
+    {
+        uint32_t proxy;
+        uint32_t submesh;
+        // from the camera to the nearest point of the proxy's sphere, of the last cull()
+        float nearest;
+    };
+
+    std::vector<Proxy> proxies;
+    // filled by cull()
+    std::vector<Draw> visible;
+    size_t visibleProxies = 0;
+    // of all the proxies' vertex buffers
+    size_t vertexBytes = 0;
+
+    // uploads a proxy buildHlodProxy() filled in
+    void add(const HlodProxy &built, const VertexLayout &layout)
+    {
+        if (!built.mesh)
+            return;
+        remove(built.cell);
+        Proxy proxy = {built.cell,   built.corner, std::make_unique<Mesh>(*built.mesh, layout), built.materials,
+                       built.center, built.radius, glm::mat4(1.0f)};
+        vertexBytes += proxy.mesh->vertexBytes;
+        proxies.push_back(std::move(proxy));
+    }
+
+    void remove(glm::ivec2 cell)
+    {
+        for (size_t i = 0; i < proxies.size(); i++)
+        {
+            if (proxies[i].cell != cell)
+                continue;
+            vertexBytes -= proxies[i].mesh->vertexBytes;
+            proxies[i] = std::move(proxies.back());
+            proxies.pop_back();
+            return;
+        }
+    }
+
+    // the submeshes of the proxies whose sphere touches the frustum, in the space relative to
+    // origin, unless hidden(cell) says their cell's own objects are in
+    template <typename Hidden>
+    void cull(const Frustum &frustum, const glm::dvec3 &origin, const glm::vec3 &eye, Hidden hidden)
+    {
+        visible.clear();
+        visibleProxies = 0;
+        for (size_t i = 0; i < proxies.size(); i++)
+        {
+            Proxy &proxy = proxies[i];
+            if (hidden(proxy.cell))
+                continue;
+            glm::vec3 offset(proxy.corner - origin);
+            glm::vec3 center = offset + proxy.center;
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; p++)
+                inside = glm::dot(glm::vec3(frustum.planes[p]), center) + frustum.planes[p].w >= -proxy.radius;
+            if (!inside)
+                continue;
+            proxy.model = glm::translate(glm::mat4(1.0f), offset);
+            float nearest = std::max(glm::distance(eye, center) - proxy.radius, 0.0f);
+            for (size_t s = 0; s < proxy.materials.size(); s++)
+                visible.push_back({(uint32_t)i, (uint32_t)s, nearest});
+            visibleProxies++;
+        }
+    }
+
+    // visible[d], with its proxy's mesh bound and its bounds and model set on the program
+    void draw(size_t d) const
+    {
+        proxies[visible[d].proxy].mesh->drawSubmesh(visible[d].submesh);
+    }
+};
+
+#endif
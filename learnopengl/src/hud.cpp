@@ -0,0 +1,304 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "render_stats.cpp"
+#include "ring_buffer.cpp"
+#include "shader.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 5x7 glyphs of ASCII ' ' to 'Z', one byte per row with the leftmost column in bit 4,
+// lowercase letters are drawn with the uppercase ones
+static const uint8_t HUD_FONT[59][7] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}, // '!'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '"'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '#'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '$'
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, // '%'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '&'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '''
+    {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}, // '('
+    {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}, // ')'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '*'
+    {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00}, // '+'
+    {0x00, 0x00, 0x00, 0x00, 0x06, 0x04, 0x08}, // ','
+    {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}, // '-'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}, // '.'
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, // '/'
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // '0'
+    {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // '1'
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, // '2'
+    {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}, // '3'
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // '4'
+    {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // '5'
+    {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // '6'
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // '7'
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // '8'
+    {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}, // '9'
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}, // ':'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ';'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '<'
+    {0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00}, // '='
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '>'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '?'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '@'
+    {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // 'A'
+    {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}, // 'B'
+    {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}, // 'C'
+    {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}, // 'D'
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}, // 'E'
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}, // 'F'
+    {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}, // 'G'
+    {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // 'H'
+    {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 'I'
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}, // 'J'
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // 'K'
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}, // 'L'
+    {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}, // 'M'
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // 'N'
+    {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // 'O'
+    {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}, // 'P'
+    {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}, // 'Q'
+    {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}, // 'R'
+    {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}, // 'S'
+    {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // 'T'
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // 'U'
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}, // 'V'
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}, // 'W'
+    {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}, // 'X'
+    {0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04}, // 'Y'
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}, // 'Z'
+};
+
+// Overlay of text, rectangles and a frame time graph in window pixels, origin top left.
+// Everything added during a frame is batched into quads whose vertices go through the
+// frame's RingBuffer region, then drawn with a single glDrawArrays using one R8 glyph
+// atlas built from HUD_FONT at startup. Rectangles sample a solid cell of the same atlas.
+class Hud
+{
+  public:
+    static const size_t HISTORY = 240;
+    // screen pixels per font pixel
+    static const int SCALE = 2;
+    static const unsigned int TEXTURE_UNIT = 7;
+
+    // frame times in milliseconds, oldest first once HISTORY are there
+    std::vector<float> frameTimes;
+
+    Hud(Shader &program, RingBuffer &ring)
+        : program(program), ring(ring), atlas(ATLAS_WIDTH, ATLAS_HEIGHT, GL_R8, 1),
+          sampler(GL_NEAREST, GL_NEAREST, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)
+    {
+        std::vector<uint8_t> texels(ATLAS_WIDTH * ATLAS_HEIGHT, 0);
+        for (int glyph = 0; glyph < GLYPHS; glyph++)
+        {
+            int cellX = glyph % COLUMNS * CELL_WIDTH, cellY = glyph / COLUMNS * CELL_HEIGHT;
+            for (int row = 0; row < GLYPH_HEIGHT; row++)
+            {
+                for (int column = 0; column < GLYPH_WIDTH; column++)
+                {
+                    if (HUD_FONT[glyph][row] & (0x10 >> column))
+                        texels[(cellY + row) * ATLAS_WIDTH + cellX + column] = 255;
+                }
+            }
+        }
+        int solidX = SOLID_CELL % COLUMNS * CELL_WIDTH, solidY = SOLID_CELL / COLUMNS * CELL_HEIGHT;
+        for (int row = 0; row < CELL_HEIGHT; row++)
+            std::fill_n(&texels[(solidY + row) * ATLAS_WIDTH + solidX], CELL_WIDTH, 255);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        atlas.upload(0, GL_RED, GL_UNSIGNED_BYTE, texels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        VAO = createVertexArray();
+        if (hasDSA())
+        {
+            // the formats stay, draw() only moves the binding to this frame's vertices
+            glVertexArrayAttribFormat(VAO, 0, 2, GL_FLOAT, GL_FALSE, 0);
+            glVertexArrayAttribFormat(VAO, 1, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, u));
+            glVertexArrayAttribFormat(VAO, 2, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Vertex, color));
+            for (unsigned int location = 0; location < 3; location++)
+            {
+                glVertexArrayAttribBinding(VAO, location, 0);
+                glEnableVertexArrayAttrib(VAO, location);
+            }
+        }
+        else
+        {
+            for (unsigned int location = 0; location < 3; location++)
+                glEnableVertexAttribArray(location);
+        }
+
+        program.use();
+        program.setInt("glyphs", TEXTURE_UNIT);
+        screenSizeLoc = program.uniform("screenSize");
+    }
+
+    ~Hud()
+    {
+        glDeleteVertexArrays(1, &VAO);
+    }
+
+    Hud(const Hud &) = delete;
+    Hud &operator=(const Hud &) = delete;
+
+    static uint32_t rgba(int r, int g, int b, int a = 255)
+    {
+        return (uint32_t)r | (uint32_t)g << 8 | (uint32_t)b << 16 | (uint32_t)a << 24;
+    }
+
+    static float lineHeight()
+    {
+        return (float)((GLYPH_HEIGHT + 3) * SCALE);
+    }
+
+    static float textWidth(std::string_view text)
+    {
+        return (float)(text.size() * CELL_WIDTH * SCALE);
+    }
+
+    void addFrameTime(float milliseconds)
+    {
+        if (frameTimes.size() == HISTORY)
+            frameTimes.erase(frameTimes.begin());
+        frameTimes.push_back(milliseconds);
+    }
+
+    float averageFrameTime() const
+    {
+        if (frameTimes.empty())
+            return 0.0f;
+        float sum = 0.0f;
+        for (float milliseconds : frameTimes)
+            sum += milliseconds;
+        return sum / (float)frameTimes.size();
+    }
+
+    void rect(float x, float y, float width, float height, uint32_t color)
+    {
+        float u = (SOLID_CELL % COLUMNS * CELL_WIDTH + 0.5f * CELL_WIDTH) / ATLAS_WIDTH;
+        float v = (SOLID_CELL / COLUMNS * CELL_HEIGHT + 0.5f * CELL_HEIGHT) / ATLAS_HEIGHT;
+        quad(x, y, x + width, y + height, u, v, u, v, color);
+    }
+
+    void text(float x, float y, std::string_view text, uint32_t color)
+    {
+        for (char c : text)
+        {
+            if (c >= 'a' && c <= 'z')
+                c = (char)(c - 'a' + 'A');
+            int glyph = c >= ' ' && c < ' ' + GLYPHS ? c - ' ' : 0;
+            if (glyph)
+            {
+                float u = (float)(glyph % COLUMNS * CELL_WIDTH) / ATLAS_WIDTH;
+                float v = (float)(glyph / COLUMNS * CELL_HEIGHT) / ATLAS_HEIGHT;
+                quad(x, y, x + GLYPH_WIDTH * SCALE, y + GLYPH_HEIGHT * SCALE, u, v,
+                     u + (float)GLYPH_WIDTH / ATLAS_WIDTH, v + (float)GLYPH_HEIGHT / ATLAS_HEIGHT, color);
+            }
+            x += CELL_WIDTH * SCALE;
+        }
+    }
+
+    // one bar per recorded frame, newest on the right, green up to 60 fps, yellow up to 30, red above,
+    // with a line at one 60 Hz frame
+    void graph(float x, float y, float width, float height, float maxMilliseconds)
+    {
+        rect(x, y, width, height, rgba(0, 0, 0, 160));
+        float barWidth = width / (float)HISTORY;
+        float left = x + width - barWidth * (float)frameTimes.size();
+        for (size_t i = 0; i < frameTimes.size(); i++)
+        {
+            float milliseconds = frameTimes[i];
+            float barHeight = std::min(milliseconds / maxMilliseconds, 1.0f) * height;
+            uint32_t color = milliseconds <= 17.0f   ? rgba(80, 220, 80)
+                             : milliseconds <= 34.0f ? rgba(230, 200, 60)
+                                                     : rgba(230, 70, 60);
+            rect(left + barWidth * (float)i, y + height - barHeight, barWidth, barHeight, color);
+        }
+        float target = y + height - std::min(16.667f / maxMilliseconds, 1.0f) * height;
+        rect(x, target, width, 1.0f, rgba(255, 255, 255, 120));
+    }
+
+    // draws everything added since the last call into the bound framebuffer
+    void draw(int width, int height)
+    {
+        if (vertices.empty() || width <= 0 || height <= 0)
+            return;
+        GLintptr offset = ring.push(vertices.data(), vertices.size() * sizeof(Vertex), 4);
+        size_t count = vertices.size();
+        vertices.clear();
+        if (offset < 0)
+            return;
+
+        glState.bindVertexArray(VAO);
+        if (hasDSA())
+        {
+            glVertexArrayVertexBuffer(VAO, 0, ring.ID, offset, sizeof(Vertex));
+        }
+        else
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, ring.ID);
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offset);
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)(offset + offsetof(Vertex, u)));
+            glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                                  (void *)(offset + offsetof(Vertex, color)));
+        }
+
+        program.use();
+        program.set(screenSizeLoc, glm::vec2((float)width, (float)height));
+        atlas.bind(TEXTURE_UNIT);
+        sampler.bind(TEXTURE_UNIT);
+        glState.disable(GL_DEPTH_TEST);
+        glState.enable(GL_BLEND);
+        renderStats.countDraw(count);
+        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)count);
+        glState.disable(GL_BLEND);
+        glState.enable(GL_DEPTH_TEST);
+    }
+
+  private:
+    struct Vertex
+    {
+        float x, y;
+        float u, v;
+        uint32_t color;
+    };
+
+    static const int GLYPHS = 59;
+    static const int GLYPH_WIDTH = 5, GLYPH_HEIGHT = 7;
+    // a column and a row of spacing around each glyph
+    static const int CELL_WIDTH = 6, CELL_HEIGHT = 8;
+    static const int COLUMNS = 16;
+    static const int ATLAS_WIDTH = COLUMNS * CELL_WIDTH, ATLAS_HEIGHT = 4 * CELL_HEIGHT;
+    // the last cell is filled, for rectangles
+    static const int SOLID_CELL = 4 * COLUMNS - 1;
+
+    Shader &program;
+    RingBuffer &ring;
+    Texture2D atlas;
+    Sampler sampler;
+    unsigned int VAO = 0;
+    UniformHandle screenSizeLoc;
+    std::vector<Vertex> vertices;
+
+    // two triangles, counter-clockwise on screen
+    void quad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, uint32_t color)
+    {
+        Vertex topLeft = {x0, y0, u0, v0, color}, bottomLeft = {x0, y1, u0, v1, color};
+        Vertex bottomRight = {x1, y1, u1, v1, color}, topRight = {x1, y0, u1, v0, color};
+        vertices.insert(vertices.end(), {topLeft, bottomLeft, bottomRight, topLeft, bottomRight, topRight});
+    }
+};
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef HUGE_PAGES_H
+#define HUGE_PAGES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+// glad defines APIENTRY the same way windows.h does
+#undef APIENTRY
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// on backs the large FrameArena regions and EntityStore component arrays with huge pages,
+// see --huge-pages in main.cpp; set before the first allocation
+inline bool hugePagesEnabled = false;
+
+const size_t HUGE_PAGE_SIZE = (size_t)2 << 20;
+const size_t GIANT_PAGE_SIZE = (size_t)1 << 30;
+// smaller blocks stay on the heap, most of a huge page would go unused
+const size_t HUGE_PAGE_MIN_BLOCK = HUGE_PAGE_SIZE / 2;
+
+// what backs a block of HugePages::allocate()
+enum PageKind
+{
+    PAGES_HEAP,
+    // 4 KB pages of the OS, a reservation of huge pages was refused
+    PAGES_SMALL,
+    // 2 MB aligned 4 KB pages the kernel is asked to fold into huge ones (MADV_HUGEPAGE)
+    PAGES_TRANSPARENT,
+    PAGES_HUGE,
+    PAGES_GIANT
+};
+
+// Blocks in huge pages. Linux takes them out of the reserved pool (MAP_HUGETLB, 1 GB pages
+// for blocks of at least that) and falls back to transparent huge pages; Windows needs the
+// "Lock pages in memory" privilege for MEM_LARGE_PAGES and falls back to 4 KB pages. A block is
+// rounded up to whole pages of its kind; the mappings are remembered so free() tells them from
+// heap blocks.
+class HugePages
+{
+  public:
+    struct Block
+    {
+        void *memory = NULL;
+        size_t size = 0;
+        PageKind kind = PAGES_HEAP;
+    };
+
+    // at least bytes, capacity gets what the block holds; throws std::bad_alloc like new
+    void *allocate(size_t bytes, size_t *capacity = NULL)
+    {
+        Block block;
+        if (hugePagesEnabled && bytes >= HUGE_PAGE_MIN_BLOCK)
+            block = map(bytes);
+        if (!block.memory)
+        {
+            block.memory = std::malloc(bytes > 0 ? bytes : 1);
+            if (!block.memory)
+                throw std::bad_alloc();
+            block.size = bytes;
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            blocks[block.memory] = block;
+            bytesByKind[block.kind] += block.size;
+        }
+        if (capacity)
+            *capacity = block.size;
+        return block.memory;
+    }
+
+    void free(void *memory)
+    {
+        if (!memory)
+            return;
+        Block block;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = blocks.find(memory);
+            if (found != blocks.end())
+            {
+                block = found->second;
+                bytesByKind[block.kind] -= block.size;
+                blocks.erase(found);
+            }
+        }
+        if (block.kind == PAGES_HEAP)
+            std::free(memory);
+        else
+            unmap(block);
+    }
+
+    // bytes in blocks of that kind now, heap blocks aren't counted
+    size_t bytes(PageKind kind) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return bytesByKind[kind];
+    }
+
+  private:
+    mutable std::mutex mutex;
+    std::unordered_map<void *, Block> blocks;
+    size_t bytesByKind[PAGES_GIANT + 1] = {};
+    bool warned = false;
+
+    static size_t roundUp(size_t bytes, size_t page)
+    {
+        return (bytes + page - 1) / page * page;
+    }
+
+    // once, the first time the huge pages are refused
+    void warn(const char *message)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!warned)
+            std::cout << "ERROR::HUGE_PAGES::" << message << '\n';
+        warned = true;
+    }
+
+#ifdef _WIN32
+    static bool lockPagesPrivilege()
+    {
+        static bool granted = [] {
+            HANDLE token;
+            if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+                return false;
+            TOKEN_PRIVILEGES privileges = {};
+            privileges.PrivilegeCount = 1;
+            privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            bool found = LookupPrivilegeValueA(NULL, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid);
+            // succeeds without granting anything unless the account holds the privilege
+            bool adjusted = found && AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) &&
+                            GetLastError() == ERROR_SUCCESS;
+            CloseHandle(token);
+            return adjusted;
+        }();
+        return granted;
+    }
+
+    Block map(size_t bytes)
+    {
+        Block block;
+        size_t large = GetLargePageMinimum();
+        if (large > 0 && lockPagesPrivilege())
+        {
+            block.size = roundUp(bytes, large);
+            block.memory =
+                VirtualAlloc(NULL, block.size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            block.kind = PAGES_HUGE;
+        }
+        if (!block.memory)
+        {
+            warn("NO_LARGE_PAGES: MEM_LARGE_PAGES needs the \"Lock pages in memory\" privilege, using 4 KB pages");
+            block.size = roundUp(bytes, 64 * 1024);
+            block.memory = VirtualAlloc(NULL, block.size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+            block.kind = PAGES_SMALL;
+        }
+        if (!block.memory)
+            block = Block();
+        return block;
+    }
+
+    static void unmap(const Block &block)
+    {
+        VirtualFree(block.memory, 0, MEM_RELEASE);
+    }
+#elif defined(__linux__)
+    Block map(size_t bytes)
+    {
+        Block block;
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_HUGETLB
+#ifdef MAP_HUGE_1GB
+        if (bytes >= GIANT_PAGE_SIZE)
+        {
+            block.size = roundUp(bytes, GIANT_PAGE_SIZE);
+            void *memory =
+                mmap(NULL, block.size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+            if (memory != MAP_FAILED)
+            {
+                block.memory = memory;
+                block.kind = PAGES_GIANT;
+                return block;
+            }
+        }
+#endif
+        block.size = roundUp(bytes, HUGE_PAGE_SIZE);
+        void *memory = mmap(NULL, block.size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED)
+        {
+            block.memory = memory;
+            block.kind = PAGES_HUGE;
+            return block;
+        }
+        warn("NO_RESERVED_PAGES: vm.nr_hugepages is 0 or used up, asking for transparent huge pages");
+#endif
+        // mapped a huge page over and trimmed to a 2 MB boundary, the kernel only folds whole
+        // aligned huge pages
+        block.size = roundUp(bytes, HUGE_PAGE_SIZE);
+        unsigned char *mapped = (unsigned char *)mmap(NULL, block.size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                                                      flags, -1, 0);
+        if ((void *)mapped == MAP_FAILED)
+            return Block();
+        size_t head = roundUp((size_t)mapped, HUGE_PAGE_SIZE) - (size_t)mapped;
+        if (head > 0)
+            munmap(mapped, head);
+        munmap(mapped + head + block.size, HUGE_PAGE_SIZE - head);
+        block.memory = mapped + head;
+        block.kind = PAGES_TRANSPARENT;
+#ifdef MADV_HUGEPAGE
+        madvise(block.memory, block.size, MADV_HUGEPAGE);
+#endif
+        return block;
+    }
+
+    static void unmap(const Block &block)
+    {
+        munmap(block.memory, block.size);
+    }
+#else
+    Block map(size_t)
+    {
+        return Block();
+    }
+
+    static void unmap(const Block &)
+    {
+    }
+#endif
+};
+
+inline HugePages hugePages;
+
+// STL allocator over hugePages, for containers that grow large and are walked every frame
+template <typename T> class HugePageAllocator
+{
+  public:
+    using value_type = T;
+
+    HugePageAllocator() noexcept
+    {
+    }
+
+    template <typename U> HugePageAllocator(const HugePageAllocator<U> &) noexcept
+    {
+    }
+
+    T *allocate(size_t count)
+    {
+        return (T *)hugePages.allocate(sizeof(T) * count);
+    }
+
+    void deallocate(T *memory, size_t count) noexcept
+    {
+        // what allocate() left on the heap skips the lookup
+        if (!hugePagesEnabled || sizeof(T) * count < HUGE_PAGE_MIN_BLOCK)
+            std::free(memory);
+        else
+            hugePages.free(memory);
+    }
+
+    template <typename U> bool operator==(const HugePageAllocator<U> &) const noexcept
+    {
+        return true;
+    }
+
+    template <typename U> bool operator!=(const HugePageAllocator<U> &) const noexcept
+    {
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef IMAGE_CONVERT_H
+#define IMAGE_CONVERT_H
+
+#include "simd_math.cpp"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+// The stage between stb_image and the upload. Images are decoded unflipped and flipped here,
+// 16 bytes at a time, rather than by stb_image's row copy through a small buffer, and RGB
+// images are widened to RGBA so the driver gets the layout it stores RGB8 textures in anyway
+// and uploads them without a conversion of its own. Texture quality tiers shrink them here too,
+// a 2x2 box filter 16 bytes at a time, before the upload ever sees the levels they leave out.
+
+// swaps row y with row height - 1 - y in place, rows are tightly packed
+inline void flipRows(unsigned char *pixels, int width, int height, int channels)
+{
+    size_t stride = (size_t)width * channels;
+    for (int y = 0; y < height / 2; y++)
+    {
+        unsigned char *top = pixels + (size_t)y * stride;
+        unsigned char *bottom = pixels + (size_t)(height - 1 - y) * stride;
+        size_t i = 0;
+#if SIMD_SSE2
+        for (; i + 16 <= stride; i += 16)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(top + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(bottom + i));
+            _mm_storeu_si128((__m128i *)(top + i), b);
+            _mm_storeu_si128((__m128i *)(bottom + i), a);
+        }
+#endif
+        for (; i < stride; i++)
+            std::swap(top[i], bottom[i]);
+    }
+}
+
+// count RGB pixels into count RGBA pixels with an opaque alpha, the two must not overlap
+inline void expandToRGBA(const unsigned char *rgb, unsigned char *rgba, size_t count)
+{
+    size_t i = 0;
+#if SIMD_SSSE3
+    // 4 pixels a step out of a 16 byte load, so it stops while 4 more bytes are left to read
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+    for (; i + 6 <= count; i += 4)
+    {
+        __m128i source = _mm_loadu_si128((const __m128i *)(rgb + i * 3));
+        _mm_storeu_si128((__m128i *)(rgba + i * 4), _mm_or_si128(_mm_shuffle_epi8(source, shuffle), alpha));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        rgba[i * 4 + 0] = rgb[i * 3 + 0];
+        rgba[i * 4 + 1] = rgb[i * 3 + 1];
+        rgba[i * 4 + 2] = rgb[i * 3 + 2];
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+// pixels freshly out of stbi_load*() with flipping off: flips them when asked and widens
+// RGB to RGBA, updating channels. Returns the pixels to use from now on, still freed with
+// stbi_image_free (which is free() unless STBI_FREE is overridden, and it isn't here);
+// NULL stays NULL
+inline unsigned char *convertDecoded(unsigned char *pixels, int width, int height, int &channels, bool flip)
+{
+    if (!pixels)
+        return NULL;
+    if (flip)
+        flipRows(pixels, width, height, channels);
+    if (channels != 3)
+        return pixels;
+    unsigned char *rgba = (unsigned char *)std::malloc((size_t)width * height * 4);
+    if (!rgba)
+        return pixels;
+    expandToRGBA(pixels, rgba, (size_t)width * height);
+    stbi_image_free(pixels);
+    channels = 4;
+    return rgba;
+}
+
+// the 2x2 box filter of an image of tightly packed rows into out, max(1, width / 2) by
+// max(1, height / 2); odd sizes clamp the last texel
+inline void halveImage(const unsigned char *pixels, int width, int height, int channels, unsigned char *out)
+{
+    int w = std::max(1, width / 2), h = std::max(1, height / 2);
+    size_t stride = (size_t)width * channels;
+    for (int y = 0; y < h; y++)
+    {
+        const unsigned char *row0 = pixels + (size_t)std::min(y * 2, height - 1) * stride;
+        const unsigned char *row1 = pixels + (size_t)std::min(y * 2 + 1, height - 1) * stride;
+        unsigned char *target = out + (size_t)y * w * channels;
+        int x = 0;
+#if SIMD_SSE2
+        // two RGBA texels out of every four in, summed in 16 bits and rounded like the loop below
+        if (channels == 4)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i round = _mm_set1_epi16(2);
+            for (; x + 2 <= w; x += 2)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i *)(row0 + x * 8));
+                __m128i b = _mm_loadu_si128((const __m128i *)(row1 + x * 8));
+                __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+                high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+                __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(low, high), round), 2);
+                _mm_storel_epi64((__m128i *)(target + x * 4), _mm_packus_epi16(sum, sum));
+            }
+        }
+#endif
+        for (; x < w; x++)
+        {
+            size_t x0 = (size_t)std::min(x * 2, width - 1) * channels;
+            size_t x1 = (size_t)std::min(x * 2 + 1, width - 1) * channels;
+            for (int c = 0; c < channels; c++)
+            {
+                int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                target[(size_t)x * channels + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+// pixels as convertDecoded() returns them, halved levels times (or until 1x1) with width and
+// height updated; returns the pixels to use from now on, freed the same way, the last ones
+// made when memory runs out
+inline unsigned char *shrinkImage(unsigned char *pixels, int &width, int &height, int channels, int levels)
+{
+    for (; pixels && levels > 0 && (width > 1 || height > 1); levels--)
+    {
+        int w = std::max(1, width / 2), h = std::max(1, height / 2);
+        unsigned char *half = (unsigned char *)std::malloc((size_t)w * h * channels);
+        if (!half)
+            break;
+        halveImage(pixels, width, height, channels, half);
+        stbi_image_free(pixels);
+        pixels = half;
+        width = w;
+        height = h;
+    }
+    return pixels;
+}
+
+#endif
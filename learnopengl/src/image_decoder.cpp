@@ -0,0 +1,244 @@
+#ifndef IMAGE_DECODER_H
+#define IMAGE_DECODER_H
+
+// IMAGE_DECODER_TURBOJPEG and IMAGE_DECODER_SPNG add libjpeg-turbo's (SIMD) JPEG decoder and
+// libspng's PNG decoder, their headers and libraries have to be on the paths, they aren't
+// part of deps. Without them stb_image decodes everything.
+#if defined(IMAGE_DECODER_TURBOJPEG)
+#include "turbojpeg.h"
+#endif
+#if defined(IMAGE_DECODER_SPNG)
+#include "spng.h"
+#endif
+
+#include "asset_pack.cpp"
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// One way of decoding encoded images (png, jpg, ...) into 8 bit pixels. decode() follows
+// stbi_load_from_memory: pixels have desired channels (the file's own when 0, only 1, 3 and
+// 4 need to be handled), channels is set to the file's, and rows are top-down, flipping is
+// up to the caller (see image_convert.cpp). Pixels are allocated with malloc, so
+// stbi_image_free frees them whichever decoder made them. NULL leaves the image to the next
+// decoder that accepts it.
+struct ImageDecoder
+{
+    const char *name;
+    // whether the bytes look like a format the decoder reads, from the signature only
+    bool (*accepts)(const unsigned char *bytes, size_t size);
+    unsigned char *(*decode)(const unsigned char *bytes, size_t size, int *width, int *height, int *channels,
+                             int desired);
+};
+
+namespace imagedecoder
+{
+inline bool isJpeg(const unsigned char *bytes, size_t size)
+{
+    return size >= 3 && bytes[0] == 0xff && bytes[1] == 0xd8 && bytes[2] == 0xff;
+}
+
+inline bool isPng(const unsigned char *bytes, size_t size)
+{
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    return size >= 8 && std::memcmp(bytes, signature, 8) == 0;
+}
+
+inline bool acceptsAnything(const unsigned char *, size_t)
+{
+    return true;
+}
+
+inline unsigned char *decodeStb(const unsigned char *bytes, size_t size, int *width, int *height, int *channels,
+                                int desired)
+{
+    stbi_set_flip_vertically_on_load_thread(0);
+    return stbi_load_from_memory(bytes, (int)size, width, height, channels, desired);
+}
+
+#if defined(IMAGE_DECODER_TURBOJPEG)
+inline unsigned char *decodeTurboJpeg(const unsigned char *bytes, size_t size, int *width, int *height,
+                                      int *channels, int desired)
+{
+    tjhandle handle = tjInitDecompress();
+    if (!handle)
+        return NULL;
+    int w, h, subsampling, colorspace;
+    unsigned char *pixels = NULL;
+    if (tjDecompressHeader3(handle, bytes, (unsigned long)size, &w, &h, &subsampling, &colorspace) == 0)
+    {
+        int fileChannels = colorspace == TJCS_GRAY ? 1 : 3;
+        int outChannels = desired ? desired : fileChannels;
+        int pixelFormat = outChannels == 1 ? TJPF_GRAY : outChannels == 3 ? TJPF_RGB : outChannels == 4 ? TJPF_RGBA : -1;
+        if (pixelFormat >= 0)
+            pixels = (unsigned char *)std::malloc((size_t)w * h * outChannels);
+        if (pixels && tjDecompress2(handle, bytes, (unsigned long)size, pixels, w, 0, h, pixelFormat,
+                                    TJFLAG_FASTDCT) != 0)
+        {
+            std::free(pixels);
+            pixels = NULL;
+        }
+        *width = w;
+        *height = h;
+        *channels = fileChannels;
+    }
+    tjDestroy(handle);
+    return pixels;
+}
+#endif
+
+#if defined(IMAGE_DECODER_SPNG)
+inline unsigned char *decodeSpng(const unsigned char *bytes, size_t size, int *width, int *height, int *channels,
+                                 int desired)
+{
+    spng_ctx *context = spng_ctx_new(0);
+    if (!context)
+        return NULL;
+    unsigned char *pixels = NULL;
+    spng_ihdr header;
+    if (spng_set_png_buffer(context, bytes, size) == 0 && spng_get_ihdr(context, &header) == 0)
+    {
+        spng_trns transparency;
+        bool hasTransparency = spng_get_trns(context, &transparency) == 0;
+        int fileChannels = 3;
+        if (header.color_type == SPNG_COLOR_TYPE_GRAYSCALE)
+            fileChannels = hasTransparency ? 2 : 1;
+        else if (header.color_type == SPNG_COLOR_TYPE_GRAYSCALE_ALPHA)
+            fileChannels = 2;
+        else if (header.color_type == SPNG_COLOR_TYPE_TRUECOLOR_ALPHA || hasTransparency)
+            fileChannels = 4;
+        int outChannels = desired ? desired : fileChannels;
+        // gray out only from 8 bit gray files, two channels are left to stb_image
+        int format = -1;
+        if (outChannels == 4)
+            format = SPNG_FMT_RGBA8;
+        else if (outChannels == 3)
+            format = SPNG_FMT_RGB8;
+        else if (outChannels == 1 && header.color_type == SPNG_COLOR_TYPE_GRAYSCALE && header.bit_depth == 8)
+            format = SPNG_FMT_G8;
+        size_t decodedSize = 0;
+        if (format >= 0 && spng_decoded_image_size(context, format, &decodedSize) == 0)
+            pixels = (unsigned char *)std::malloc(decodedSize);
+        if (pixels && spng_decode_image(context, pixels, decodedSize, format, SPNG_DECODE_TRNS) != 0)
+        {
+            std::free(pixels);
+            pixels = NULL;
+        }
+        *width = (int)header.width;
+        *height = (int)header.height;
+        *channels = fileChannels;
+    }
+    spng_ctx_free(context);
+    return pixels;
+}
+#endif
+} // namespace imagedecoder
+
+// The decoders built in, fastest first, stb_image last since it reads everything
+inline const std::vector<ImageDecoder> &imageDecoders()
+{
+    static const std::vector<ImageDecoder> decoders = {
+#if defined(IMAGE_DECODER_TURBOJPEG)
+        {"turbojpeg", imagedecoder::isJpeg, imagedecoder::decodeTurboJpeg},
+#endif
+#if defined(IMAGE_DECODER_SPNG)
+        {"spng", imagedecoder::isPng, imagedecoder::decodeSpng},
+#endif
+        {"stb", imagedecoder::acceptsAnything, imagedecoder::decodeStb},
+    };
+    return decoders;
+}
+
+// --image-decoder <name> limits decoding to that decoder, stb_image still takes what it
+// refuses; empty uses every decoder in order
+inline std::string &preferredImageDecoder()
+{
+    static std::string name;
+    return name;
+}
+
+// decodes with the first decoder that accepts the bytes and succeeds, see ImageDecoder
+inline unsigned char *decodeImage(const unsigned char *bytes, size_t size, int *width, int *height, int *channels,
+                                  int desired)
+{
+    const std::string &preferred = preferredImageDecoder();
+    for (const ImageDecoder &decoder : imageDecoders())
+    {
+        bool last = &decoder == &imageDecoders().back();
+        if (!last && !preferred.empty() && preferred != decoder.name)
+            continue;
+        if (!decoder.accepts(bytes, size))
+            continue;
+        if (unsigned char *pixels = decoder.decode(bytes, size, width, height, channels, desired))
+            return pixels;
+    }
+    return NULL;
+}
+
+// decodeImage() of a file, out of the asset pack's mapping when the file is packed
+inline unsigned char *decodeImageFile(const std::string &path, int *width, int *height, int *channels, int desired)
+{
+    const unsigned char *packed;
+    size_t size;
+    if (assetPack.view(path, packed, size))
+        return decodeImage(packed, size, width, height, channels, desired);
+    std::vector<unsigned char> bytes;
+    if (!readFileContents(path, bytes))
+        return NULL;
+    return decodeImage(bytes.data(), bytes.size(), width, height, channels, desired);
+}
+
+// --decode-benchmark [directory] [iterations]: decodes every jpg and png in the directory
+// with each decoder that accepts it, as RGBA like the texture array, and prints the
+// throughput in decoded megabytes per second. Returns the number of files that failed.
+inline int benchmarkImageDecoders(const std::string &directory, int iterations)
+{
+    int failures = 0;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(directory, error))
+    {
+        std::string extension = entry.path().extension().string();
+        if (extension != ".jpg" && extension != ".jpeg" && extension != ".png")
+            continue;
+        std::string path = entry.path().string();
+        std::vector<unsigned char> bytes;
+        if (!readFileContents(path, bytes))
+        {
+            failures++;
+            continue;
+        }
+        for (const ImageDecoder &decoder : imageDecoders())
+        {
+            if (!decoder.accepts(bytes.data(), bytes.size()))
+                continue;
+            int width = 0, height = 0, channels = 0;
+            auto start = std::chrono::steady_clock::now();
+            bool decoded = true;
+            for (int i = 0; i < iterations && decoded; i++)
+            {
+                unsigned char *pixels = decoder.decode(bytes.data(), bytes.size(), &width, &height, &channels, 4);
+                decoded = pixels != NULL;
+                stbi_image_free(pixels);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (!decoded)
+            {
+                std::cout << path << "  " << decoder.name << "  failed\n";
+                failures++;
+                continue;
+            }
+            double megabytes = (double)width * height * 4 * iterations / (1024.0 * 1024.0);
+            std::cout << path << "  " << decoder.name << "  " << width << "x" << height << "  "
+                      << seconds * 1000.0 / iterations << " ms  " << megabytes / seconds << " MB/s\n";
+        }
+    }
+    return failures;
+}
+
+#endif
@@ -0,0 +1,244 @@
+#ifndef IMPOSTORS_H
+#define IMPOSTORS_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "gpu_texture_compressor.cpp"
+#include "instance_buffer.cpp"
+#include "mesh.cpp"
+#include "render_stats.cpp"
+#include "ring_buffer.cpp"
+#include "shader.cpp"
+#include "texture.cpp"
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Octahedral impostors of one mesh: bake() draws it from GRID x GRID directions around its
+// bounding sphere, spread over the sphere by the octahedral mapping, into the cells of an
+// atlas with one layer per material layer. Far away the mesh is then a single quad per
+// object: impostor.vs picks the cell whose direction is nearest to the camera's in the
+// object's own space (so spinning objects turn with their images) and faces the quad the way
+// that image was taken. select() splits a draw list by distance, the near objects stay
+// meshes and draw() sends the far ones as instances of one 4 vertex strip, their model
+// matrices and layers streamed through InstanceBuffer. The nearest cell is taken, there is
+// no blending between neighbouring ones, and the baked images are unlit like the forward
+// cube shading.
+class Impostors
+{
+  public:
+    // directions per side of the octahedral grid and pixels per cell side
+    static const int GRID = 16;
+    static const int CELL = 64;
+    // the mips stop at 4 pixels a cell, smaller ones would average neighbouring cells
+    static const int LEVELS = 5;
+    static const unsigned int TEXTURE_UNIT = 12;
+
+    Texture2DArray atlas;
+    bool baked = false;
+    // objects closer than this are drawn as meshes
+    float distance;
+    // drawn by the last draw()
+    size_t count = 0;
+    // the frame's depth test, put back after bake()
+    GLenum depthFunc = GL_LESS;
+    // makes the baked atlas BC3 when set
+    GpuTextureCompressor *compressor = NULL;
+
+    Impostors(Shader &bakeProgram, Shader &program, RingBuffer &ring, float distance)
+        : distance(distance), bakeProgram(bakeProgram), program(program), instances(ring),
+          sampler(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)
+    {
+        VAO = createVertexArray();
+        instances.attach(VAO, 2);
+        instances.attachLayers(6);
+    }
+
+    ~Impostors()
+    {
+        glDeleteVertexArrays(1, &VAO);
+    }
+
+    Impostors(const Impostors &) = delete;
+    Impostors &operator=(const Impostors &) = delete;
+
+    // the octahedral mapping of both sides: p in [-1, 1]^2 to a unit direction and back,
+    // the upper half of the sphere is the inner diamond, the lower one folded over its edges
+    static glm::vec3 octahedralDirection(glm::vec2 p)
+    {
+        glm::vec3 n(p.x, 1.0f - std::abs(p.x) - std::abs(p.y), p.y);
+        if (n.y < 0.0f)
+        {
+            float x = (1.0f - std::abs(n.z)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+            float z = (1.0f - std::abs(n.x)) * (n.z >= 0.0f ? 1.0f : -1.0f);
+            n.x = x;
+            n.z = z;
+        }
+        return glm::normalize(n);
+    }
+
+    // the direction cell x y of the grid was baked from
+    static glm::vec3 cellDirection(int x, int y)
+    {
+        return octahedralDirection(glm::vec2((x + 0.5f) / GRID, (y + 0.5f) / GRID) * 2.0f - 1.0f);
+    }
+
+    // draws mesh into every cell of every layer, textured with the materials and decalLayer as
+    // the forward cube shading does; the target, the viewport and depthFunc are put back after
+    bool bake(const Mesh &mesh, const Texture2DArray &materials, const Sampler &materialSampler, int layers,
+              int decalLayer)
+    {
+        const int size = GRID * CELL;
+        atlas.create(size, size, layers, GL_RGBA8, LEVELS);
+        Texture2D depth(size, size, GL_DEPTH_COMPONENT24, 1);
+        unsigned int framebuffer = createFramebuffer();
+        GLint savedFramebuffer = 0, savedViewport[4];
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &savedFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
+
+        center = mesh.boundsCenter;
+        radius = glm::length(mesh.boundsExtent);
+        // the frame's glClipControl stays, under GL_ZERO_TO_ONE z goes from [-1, 1] to [0, 1]
+        GLint clipDepth = GL_NEGATIVE_ONE_TO_ONE;
+        if (GLAD_GL_VERSION_4_5)
+            glGetIntegerv(GL_CLIP_DEPTH_MODE, &clipDepth);
+        glm::mat4 depthRange(1.0f);
+        if (clipDepth == GL_ZERO_TO_ONE)
+            depthRange = glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, 1.0f, 0.5f)),
+                                        glm::vec3(0.0f, 0.0f, 1.0f));
+        // the sphere from outside, depth from the nearest point of it to the farthest
+        std::vector<glm::mat4> cameras(GRID * GRID);
+        for (int y = 0; y < GRID; y++)
+            for (int x = 0; x < GRID; x++)
+            {
+                glm::vec3 direction = cellDirection(x, y);
+                glm::mat4 view = glm::lookAt(center + direction * radius, center, cellUp(direction));
+                cameras[y * GRID + x] =
+                    depthRange * glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius) * view;
+            }
+
+        bakeProgram.use();
+        bakeProgram.setInt("materials", 0);
+        bakeProgram.setInt("decalLayer", decalLayer);
+        bakeProgram.setVec3("boundsCenter", mesh.boundsCenter);
+        bakeProgram.setVec3("boundsExtent", mesh.boundsExtent);
+        UniformHandle viewProjectionLoc = bakeProgram.uniform("bakeViewProjection");
+        UniformHandle layerLoc = bakeProgram.uniform("layer");
+        materials.bind(0);
+        materialSampler.bind(0);
+        mesh.bind();
+        glState.enable(GL_DEPTH_TEST);
+        glState.setDepthMask(true);
+        glState.disable(GL_BLEND);
+        glState.disable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glState.setDepthFunc(GL_LESS);
+
+        bool complete = true;
+        const float transparent[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        const float farthest = 1.0f;
+        for (int layer = 0; layer < layers && complete; layer++)
+        {
+            if (hasDSA())
+            {
+                glNamedFramebufferTextureLayer(framebuffer, GL_COLOR_ATTACHMENT0, atlas.ID, 0, layer);
+                glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, depth.ID, 0);
+            }
+            else
+            {
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, atlas.ID, 0, layer);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth.ID, 0);
+            }
+            complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+            if (!complete)
+                break;
+            glClearBufferfv(GL_COLOR, 0, transparent);
+            glClearBufferfv(GL_DEPTH, 0, &farthest);
+            bakeProgram.set(layerLoc, layer);
+            for (int cell = 0; cell < GRID * GRID; cell++)
+            {
+                glViewport(cell % GRID * CELL, cell / GRID * CELL, CELL, CELL);
+                bakeProgram.set(viewProjectionLoc, cameras[cell]);
+                mesh.draw();
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)savedFramebuffer);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+        glDeleteFramebuffers(1, &framebuffer);
+        glState.setDepthFunc(depthFunc);
+        if (!complete)
+        {
+            std::cout << "ERROR::IMPOSTORS::INCOMPLETE_FRAMEBUFFER\n";
+            return false;
+        }
+        atlas.generateMipmaps();
+        if (compressor)
+            compressor->compress(atlas, true);
+
+        program.use();
+        program.setInt("impostors", TEXTURE_UNIT);
+        program.setVec3("boundsCenter", center);
+        program.setFloat("boundsRadius", radius);
+        program.setFloat("grid", (float)GRID);
+        baked = true;
+        return true;
+    }
+
+    // indices split into the ones closer than distance to eye and the rest, in their order
+    template <typename Center>
+    void select(const std::vector<uint32_t> &indices, const glm::vec3 &eye, Center centerOf,
+                std::vector<uint32_t> &nearIndices, std::vector<uint32_t> &farIndices) const
+    {
+        nearIndices.clear();
+        farIndices.clear();
+        float limit = distance * distance;
+        for (uint32_t i : indices)
+        {
+            glm::vec3 offset = centerOf(i) - eye;
+            (glm::dot(offset, offset) < limit ? nearIndices : farIndices).push_back(i);
+        }
+    }
+
+    // one quad per model matrix, with the layers of the atlas they are textured with
+    void draw(const glm::mat4 *models, const int *layers, size_t modelCount)
+    {
+        count = 0;
+        if (!baked || modelCount == 0)
+            return;
+        instances.upload(models, modelCount);
+        instances.uploadLayers(layers, modelCount);
+        if (!instances.count)
+            return;
+        count = instances.count;
+        program.use();
+        glState.bindTexture(TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, atlas.ID);
+        sampler.bind(TEXTURE_UNIT);
+        glState.bindVertexArray(VAO);
+        renderStats.countDraw(6, count);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)count);
+    }
+
+  private:
+    Shader &bakeProgram;
+    Shader &program;
+    InstanceBuffer instances;
+    Sampler sampler;
+    unsigned int VAO = 0;
+    // the bounding sphere of the baked mesh, in its own space
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 1.0f;
+
+    // the up of a cell's image, impostor.vs picks it the same way
+    static glm::vec3 cellUp(const glm::vec3 &direction)
+    {
+        return std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+};
+
+#endif
@@ -0,0 +1,461 @@
+#ifndef INDIRECT_RENDERER_H
+#define INDIRECT_RENDERER_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "block_layout.cpp"
+#include "geometry_pool.cpp"
+#include "gl_extensions.cpp"
+#include "gl_objects.cpp"
+#include "hiz_buffer.cpp"
+#include "render_stats.cpp"
+#include "shader.cpp"
+#include "triangle_filter.cpp"
+
+#include <cstdint>
+#include <cstring>
+
+// the command layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand
+{
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "indirect commands are 5 tightly packed ints");
+
+// Mirrors the std430 ObjectData entries in shader_src/indirect.vs
+struct ObjectData
+{
+    glm::mat4 model;
+    // xyz decode the quantized positions of the mesh, w unused
+    glm::vec4 boundsCenter;
+    glm::vec4 boundsExtent;
+    // x is the texture array layer, y and z the first and the number of the mesh's levels
+    // of detail in the pool, w the bits of the float cross-fade the cull pass writes
+    glm::ivec4 material;
+};
+static_assert(sizeof(ObjectData) == 112, "ObjectData must match the std430 layout");
+
+constexpr BlockMember OBJECT_DATA_LAYOUT[] = {
+    BLOCK_MEMBER(ObjectData, model, GL_FLOAT_MAT4),
+    BLOCK_MEMBER(ObjectData, boundsCenter, GL_FLOAT_VEC4),
+    BLOCK_MEMBER(ObjectData, boundsExtent, GL_FLOAT_VEC4),
+    BLOCK_MEMBER(ObjectData, material, GL_INT_VEC4),
+};
+static_assert(blockLayoutMismatch(OBJECT_DATA_LAYOUT, STD430) == -1, "ObjectData members are not where std430 puts them");
+static_assert(blockLayoutSize(OBJECT_DATA_LAYOUT, STD430) == sizeof(ObjectData), "ObjectData is not padded like std430");
+
+// Draws any number of meshes out of a GeometryPool with one glMultiDrawElementsIndirect call.
+// Each frame add() writes one command and one ObjectData entry straight into persistently
+// mapped buffers, the vertex shader finds its entry through gl_DrawIDARB.
+// The buffers hold FRAMES regions that are written in turn, a fence per region makes sure
+// the GPU is done with a region before the CPU writes it again.
+// Needs GL 4.4 buffer storage and GL_ARB_shader_draw_parameters, otherwise supported stays false.
+//
+// With a cull program set (shader_src/cull.comp) the added draws are only candidates: before
+// drawing, a compute pass tests their bounds against the frustum of the FrameData viewProjection
+// and writes the visible ones into GPU side command and ObjectData buffers, so the CPU never
+// decides visibility. With GL 4.6 or GL_ARB_indirect_parameters the pass compacts the
+// visible draws and glMultiDrawElementsIndirectCount reads the count it wrote, otherwise
+// every candidate keeps its slot and culled ones get an instance count of 0.
+// With a HiZBuffer set, draws hidden behind last frame's depth are dropped as well.
+// The cull pass also picks each draw's level of detail out of the pool's table, the coarsest
+// whose simplification error covers at most lodThreshold pixels from the camera set with
+// setLodView(). Close to the switch to the next level, within lodFadeRange of the threshold,
+// the draw is written twice, once per level, and the two are dithered against each other
+// (lod_fade.glsl), so the culled buffers have room for two commands per candidate.
+// Without the cull pass every draw is level 0.
+//
+// With a meshlet program set (shader_src/meshlet_cull.comp) the cull pass works on the meshlets
+// of the draws instead: add() queues one work item per meshlet of the mesh, each is tested on
+// its own against the frustum, the Hi-Z and its normal cone, and every visible one becomes a
+// command of its own whose base instance points the vertex shader (indirect.vs built with
+// MESHLETS) at the draw's ObjectData. Meshlets are made of level 0, there is no level of
+// detail selection in that mode. A TriangleFilter set as well goes over the triangles of the
+// visible meshlets of the camera's pass, the cascades draw the meshlets whole.
+class IndirectRenderer
+{
+  public:
+    // shader storage bindings of the ObjectData array, the candidates read by the cull pass,
+    // the culled commands and the draw count
+    static const unsigned int BINDING = 2;
+    static const unsigned int CANDIDATE_OBJECTS_BINDING = 3;
+    static const unsigned int CANDIDATE_COMMANDS_BINDING = 4;
+    static const unsigned int CULLED_COMMANDS_BINDING = 5;
+    static const unsigned int DRAW_COUNT_BINDING = 6;
+    // the pool's MeshLod table, in the cull pass only
+    static const unsigned int LOD_BINDING = 1;
+    // in the meshlet cull pass, the pool's Meshlet table and the work items in place
+    // of the LOD table and the candidate commands
+    static const unsigned int MESHLETS_BINDING = 1;
+    static const unsigned int MESHLET_WORK_BINDING = 4;
+    static const unsigned int FRAMES = 3;
+    // local size of cull.comp
+    static const unsigned int CULL_GROUP_SIZE = 64;
+
+    bool supported = false;
+    // true when the cull pass can hand its count to glMultiDrawElementsIndirectCount
+    bool drawCountSupported = false;
+    size_t maxDraws;
+    // draws added since begin()
+    size_t drawCount = 0;
+    // indices of those draws together, at level 0
+    size_t indexCount = 0;
+    // meshlets of those draws, with a meshlet program
+    size_t meshletCount = 0;
+    size_t maxMeshlets = 0;
+    // the projected simplification error in pixels a level of detail may have, 0 keeps level 0
+    float lodThreshold = 1.0f;
+    // how far past lodThreshold, as a fraction of it, the next level starts fading in
+    float lodFadeRange = 0.25f;
+
+    // loader is used for the GL_ARB_indirect_parameters entry point, e.g. glfwGetProcAddress
+    IndirectRenderer(const GeometryPool &pool, size_t maxDraws, GLADloadproc loader)
+        : maxDraws(maxDraws), pool(pool)
+    {
+        supported = isSupported();
+        if (!supported)
+            return;
+
+        if (GLAD_GL_VERSION_4_6)
+            multiDrawElementsIndirectCount = glMultiDrawElementsIndirectCount;
+        else if (hasGLExtension("GL_ARB_indirect_parameters"))
+            multiDrawElementsIndirectCount =
+                (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)loader("glMultiDrawElementsIndirectCountARB");
+        drawCountSupported = multiDrawElementsIndirectCount != NULL;
+
+        // regions are bound with glBindBufferRange, so they start aligned
+        GLint alignment = 1;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        objectRegionBytes = maxDraws * sizeof(ObjectData);
+        objectRegionBytes = (objectRegionBytes + alignment - 1) / alignment * alignment;
+        commandRegionBytes = maxDraws * sizeof(DrawElementsIndirectCommand);
+        commandRegionBytes = (commandRegionBytes + alignment - 1) / alignment * alignment;
+
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        commandBuffer = createBuffer(commandRegionBytes * FRAMES, NULL, flags);
+        commands = (unsigned char *)mapBuffer(commandBuffer, 0, commandRegionBytes * FRAMES, flags);
+        objectBuffer = createBuffer(objectRegionBytes * FRAMES, NULL, flags);
+        objects = (unsigned char *)mapBuffer(objectBuffer, 0, objectRegionBytes * FRAMES, flags);
+
+        // outputs of the cull pass, only ever touched by the GPU
+        culledObjectBuffer = createBuffer(2 * maxDraws * sizeof(ObjectData), NULL, 0);
+        culledCommandBuffer = createBuffer(2 * maxDraws * sizeof(DrawElementsIndirectCommand), NULL, 0);
+        drawCountBuffer = createBuffer(sizeof(uint32_t), NULL, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_4 && hasGLExtension("GL_ARB_shader_draw_parameters");
+    }
+
+    ~IndirectRenderer()
+    {
+        if (!supported)
+            return;
+        for (GLsync fence : fences)
+        {
+            if (fence)
+                glDeleteSync(fence);
+        }
+        // deleting a buffer unmaps it
+        deleteBuffers(1, &commandBuffer);
+        deleteBuffers(1, &objectBuffer);
+        deleteBuffers(1, &culledObjectBuffer);
+        deleteBuffers(1, &culledCommandBuffer);
+        deleteBuffers(1, &drawCountBuffer);
+        deleteBuffers(1, &workBuffer);
+        deleteBuffers(1, &meshletCommandBuffer);
+    }
+
+    // turns on the GPU cull pass, NULL turns it off again
+    void setCullShader(Shader *shader)
+    {
+        cullShader = shader;
+        if (!cullShader)
+            return;
+        candidateCountLoc = cullShader->uniform("candidateCount");
+        compactLoc = cullShader->uniform("compact");
+        hiZEnabledLoc = cullShader->uniform("hiZEnabled");
+        hiZViewProjectionLoc = cullShader->uniform("hiZViewProjection");
+        hiZReversedLoc = cullShader->uniform("hiZReversed");
+        lodViewLoc = cullShader->uniform("lodView");
+        lodParamsLoc = cullShader->uniform("lodParams");
+        // the candidates are copied into the culled buffer as they are, both are ObjectData arrays
+        checkBlockLayout("CandidateObjects", cullShader->storageBlock("CandidateObjects"), OBJECT_DATA_LAYOUT, STD430,
+                         "candidates[0].", sizeof(ObjectData));
+    }
+
+    // culls and draws meshlets instead of whole draws, room for up to maxMeshletDraws meshlets
+    // per frame; NULL turns it off again. program is indirect.vs built with MESHLETS
+    void setMeshletShader(Shader *shader, size_t maxMeshletDraws)
+    {
+        meshletShader = supported ? shader : NULL;
+        if (!meshletShader)
+            return;
+        meshletWorkCountLoc = meshletShader->uniform("workCount");
+        meshletHiZEnabledLoc = meshletShader->uniform("hiZEnabled");
+        meshletHiZViewProjectionLoc = meshletShader->uniform("hiZViewProjection");
+        meshletCompactLoc = meshletShader->uniform("compact");
+        meshletHiZReversedLoc = meshletShader->uniform("hiZReversed");
+        coneCullingLoc = meshletShader->uniform("coneCulling");
+        if (maxMeshletDraws <= maxMeshlets)
+            return;
+        deleteBuffers(1, &workBuffer);
+        deleteBuffers(1, &meshletCommandBuffer);
+        maxMeshlets = maxMeshletDraws;
+        GLint alignment = 1;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        workRegionBytes = maxMeshlets * sizeof(glm::uvec4);
+        workRegionBytes = (workRegionBytes + alignment - 1) / alignment * alignment;
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        workBuffer = createBuffer(workRegionBytes * FRAMES, NULL, flags);
+        work = (unsigned char *)mapBuffer(workBuffer, 0, workRegionBytes * FRAMES, flags);
+        meshletCommandBuffer = createBuffer(maxMeshlets * sizeof(DrawElementsIndirectCommand), NULL, 0);
+    }
+
+    // filters the triangles of the meshlets the camera sees, NULL turns it off again
+    void setTriangleFilter(TriangleFilter *filter)
+    {
+        triangleFilter = filter;
+    }
+
+    // adds the occlusion test to the cull pass, NULL turns it off again
+    void setHiZ(const HiZBuffer *buffer)
+    {
+        hiZ = buffer;
+    }
+
+    // where the levels of detail are picked from, pixelsPerUnit is how many pixels a unit at a
+    // distance of 1 covers, projection[1][1] * half the height of the frame
+    void setLodView(const glm::vec3 &position, float pixelsPerUnit)
+    {
+        lodView = glm::vec4(position, pixelsPerUnit);
+    }
+
+    IndirectRenderer(const IndirectRenderer &) = delete;
+    IndirectRenderer &operator=(const IndirectRenderer &) = delete;
+
+    // starts the next frame's region, blocks only if the GPU is still FRAMES frames behind
+    void begin()
+    {
+        if (!supported)
+            return;
+        region = (region + 1) % FRAMES;
+        drawCount = 0;
+        indexCount = 0;
+        meshletCount = 0;
+        GLsync &fence = fences[region];
+        if (fence)
+        {
+            GLenum status = glClientWaitSync(fence, 0, 0);
+            while (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED && status != GL_WAIT_FAILED)
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+
+    // queues one mesh, layer is the texture array layer it samples
+    void add(const MeshRange &range, const glm::mat4 &model, int layer)
+    {
+        if (!supported || drawCount >= maxDraws)
+            return;
+        // level 0, the cull pass moves it to the level it picks
+        const MeshLod &lod = pool.lod(range, 0);
+        DrawElementsIndirectCommand command = {lod.indexCount, 1, range.firstIndex + lod.firstIndex,
+                                               range.baseVertex, 0};
+        std::memcpy(commands + region * commandRegionBytes + drawCount * sizeof(command), &command, sizeof(command));
+
+        ObjectData object;
+        object.model = model;
+        object.boundsCenter = glm::vec4(range.boundsCenter, 0.0f);
+        object.boundsExtent = glm::vec4(range.boundsExtent, 0.0f);
+        object.material = glm::ivec4(layer, (int)range.firstLod, (int)range.lodCount, 0);
+        std::memcpy(objects + region * objectRegionBytes + drawCount * sizeof(object), &object, sizeof(object));
+        if (meshletShader)
+        {
+            glm::uvec4 *items = (glm::uvec4 *)(work + region * workRegionBytes);
+            for (uint32_t i = 0; i < range.meshletCount && meshletCount < maxMeshlets; i++)
+                items[meshletCount++] = glm::uvec4((uint32_t)drawCount, range.firstMeshlet + i, range.firstIndex,
+                                                   (uint32_t)range.baseVertex);
+        }
+        drawCount++;
+        indexCount += lod.indexCount;
+    }
+
+    // submits everything added since begin() with program and fences the region,
+    // culls first when a cull program is set
+    void draw(Shader &program)
+    {
+        prepare();
+        submit(program);
+        finish();
+    }
+
+    // draw() in steps, to submit the same commands more than once (the depth prepass):
+    // prepare() culls, submit() draws with a program, finish() fences the region.
+    // prepare() can cull for another view (a shadow cascade) in between, without the Hi-Z test
+    void prepare(bool occlusion = true)
+    {
+        if (supported && drawCount > 0 && meshletShader)
+            cullMeshlets(occlusion);
+        else if (supported && drawCount > 0 && cullShader)
+            cull(occlusion);
+    }
+
+    void submit(Shader &program)
+    {
+        if (!supported || drawCount == 0)
+            return;
+        program.use();
+        if (filtered)
+            triangleFilter->bind();
+        else
+            pool.bind();
+        renderStats.countDraw(indexCount);
+        if (meshletShader)
+        {
+            // the candidates as they were added, the commands index them by base instance
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, objectBuffer, region * objectRegionBytes,
+                                    drawCount * sizeof(ObjectData));
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, meshletCommandBuffer);
+            if (drawCountSupported)
+            {
+                glBindBuffer(GL_PARAMETER_BUFFER, drawCountBuffer);
+                multiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)0, 0, (GLsizei)meshletCount, 0);
+            }
+            else
+            {
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)0, (GLsizei)meshletCount, 0);
+            }
+        }
+        else if (cullShader)
+        {
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, culledObjectBuffer, 0, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culledCommandBuffer);
+            // a cross-fading draw takes two commands
+            if (drawCountSupported)
+            {
+                glBindBuffer(GL_PARAMETER_BUFFER, drawCountBuffer);
+                multiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)0, 0, (GLsizei)(2 * drawCount),
+                                               0);
+            }
+            else
+            {
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)0, (GLsizei)(2 * drawCount), 0);
+            }
+        }
+        else
+        {
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, objectBuffer, region * objectRegionBytes,
+                                    drawCount * sizeof(ObjectData));
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)(region * commandRegionBytes),
+                                        (GLsizei)drawCount, 0);
+        }
+    }
+
+    void finish()
+    {
+        if (supported && drawCount > 0)
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+  private:
+    const GeometryPool &pool;
+    unsigned int commandBuffer = 0, objectBuffer = 0;
+    unsigned int culledObjectBuffer = 0, culledCommandBuffer = 0, drawCountBuffer = 0;
+    PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC multiDrawElementsIndirectCount = NULL;
+    Shader *cullShader = NULL;
+    Shader *meshletShader = NULL;
+    TriangleFilter *triangleFilter = NULL;
+    // the last prepare() filtered the triangles of its commands
+    bool filtered = false;
+    UniformHandle meshletWorkCountLoc, meshletCompactLoc, meshletHiZEnabledLoc, meshletHiZViewProjectionLoc;
+    UniformHandle meshletHiZReversedLoc, coneCullingLoc;
+    unsigned int workBuffer = 0, meshletCommandBuffer = 0;
+    unsigned char *work = NULL;
+    size_t workRegionBytes = 0;
+    UniformHandle candidateCountLoc, compactLoc, hiZEnabledLoc, hiZViewProjectionLoc, hiZReversedLoc;
+    UniformHandle lodViewLoc, lodParamsLoc;
+    glm::vec4 lodView = glm::vec4(0.0f);
+    const HiZBuffer *hiZ = NULL;
+    unsigned char *commands = NULL;
+    unsigned char *objects = NULL;
+    size_t commandRegionBytes = 0, objectRegionBytes = 0;
+    unsigned int region = 0;
+    GLsync fences[FRAMES] = {};
+
+    // one invocation per candidate, the draw commands wait for its writes
+    void cull(bool occlusionAllowed)
+    {
+        uint32_t zero = 0;
+        updateBuffer(drawCountBuffer, 0, sizeof(zero), &zero);
+
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, CANDIDATE_OBJECTS_BINDING, objectBuffer,
+                                  region * objectRegionBytes, drawCount * sizeof(ObjectData));
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, CANDIDATE_COMMANDS_BINDING, commandBuffer,
+                                  region * commandRegionBytes, drawCount * sizeof(DrawElementsIndirectCommand));
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, culledObjectBuffer, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, CULLED_COMMANDS_BINDING, culledCommandBuffer, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_COUNT_BINDING, drawCountBuffer, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, LOD_BINDING, pool.lodBuffer, 0, 0);
+
+        cullShader->use();
+        cullShader->set(candidateCountLoc, (unsigned int)drawCount);
+        cullShader->set(compactLoc, drawCountSupported);
+        cullShader->set(lodViewLoc, lodView);
+        cullShader->set(lodParamsLoc, glm::vec2(lodView.w > 0.0f ? lodThreshold : 0.0f, lodFadeRange));
+        bool occlusion = occlusionAllowed && hiZ && hiZ->valid;
+        cullShader->set(hiZEnabledLoc, occlusion);
+        if (occlusion)
+        {
+            hiZ->bind();
+            cullShader->set(hiZViewProjectionLoc, hiZ->viewProjection);
+            cullShader->set(hiZReversedLoc, hiZ->reversedZ);
+        }
+        glDispatchCompute((GLuint)((drawCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // one invocation per meshlet work item, like cull()
+    void cullMeshlets(bool occlusionAllowed)
+    {
+        uint32_t zero = 0;
+        updateBuffer(drawCountBuffer, 0, sizeof(zero), &zero);
+
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, CANDIDATE_OBJECTS_BINDING, objectBuffer,
+                                region * objectRegionBytes, drawCount * sizeof(ObjectData));
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, MESHLET_WORK_BINDING, workBuffer, region * workRegionBytes,
+                                meshletCount * sizeof(glm::uvec4));
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, MESHLETS_BINDING, pool.meshletBuffer, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, CULLED_COMMANDS_BINDING, meshletCommandBuffer, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_COUNT_BINDING, drawCountBuffer, 0, 0);
+
+        meshletShader->use();
+        meshletShader->set(meshletWorkCountLoc, (unsigned int)meshletCount);
+        meshletShader->set(meshletCompactLoc, drawCountSupported);
+        // the cascades cull without the camera's depth and facing
+        meshletShader->set(coneCullingLoc, occlusionAllowed);
+        bool occlusion = occlusionAllowed && hiZ && hiZ->valid;
+        meshletShader->set(meshletHiZEnabledLoc, occlusion);
+        if (occlusion)
+        {
+            hiZ->bind();
+            meshletShader->set(meshletHiZViewProjectionLoc, hiZ->viewProjection);
+            meshletShader->set(meshletHiZReversedLoc, hiZ->reversedZ);
+        }
+        glDispatchCompute((GLuint)((meshletCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        filtered = triangleFilter && occlusionAllowed;
+        if (filtered)
+            triangleFilter->run(meshletCount, indexCount);
+    }
+};
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "GLFW/glfw3.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Input recording file: InputFileHeader, then per frame an InputFrameHeader followed by
+// its events. Little endian, read back on the kind of machine that wrote it.
+#define INPUT_FILE_MAGIC 0x54504E49u // "INPT"
+#define INPUT_FILE_VERSION 1u
+
+enum InputEventType : uint32_t
+{
+    INPUT_KEY,
+    INPUT_MOUSE_BUTTON,
+    INPUT_CURSOR,
+    INPUT_SCROLL
+};
+
+struct InputEvent
+{
+    uint32_t type;
+    // key or mouse button, and GLFW_PRESS / GLFW_RELEASE / GLFW_REPEAT
+    int32_t code;
+    int32_t action;
+    int32_t mods;
+    // cursor position or scroll offsets
+    double x, y;
+    // glfwGetTime() when the event arrived
+    double time;
+};
+static_assert(sizeof(InputEvent) == 40, "input event is 40 bytes");
+
+struct InputFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+};
+
+struct InputFrameHeader
+{
+    // the frame's deltaTime, replayed as is
+    float deltaTime;
+    uint32_t eventCount;
+};
+
+// All window input goes through here instead of being read from GLFW directly.
+// The GLFW callbacks queue timestamped events, beginFrame() hands a frame its events and
+// applies them to the key table, in order. Mouse motion is coalesced: back to back cursor
+// events are merged into the newest one as they arrive (a 1000 Hz mouse sends a dozen a
+// frame) and scroll offsets add up, and beginFrame() keeps the frame's last position and
+// total scroll so the camera turns once per frame whatever was queued. While recording, endFrame() writes the frame's
+// events and deltaTime to a file; while replaying, the frames come from that file instead
+// of the window and deltaTime is the recorded one, so a session repeats frame for frame.
+class InputSystem
+{
+  public:
+    static const int KEY_COUNT = GLFW_KEY_LAST + 1;
+
+    ~InputSystem()
+    {
+        if (recording)
+            std::cout << "input: recorded " << recordedFrames << " frames\n";
+    }
+
+    // installs the callbacks, the window's user pointer is taken. Raw motion skips the
+    // desktop's pointer acceleration while the cursor is disabled, where GLFW supports it.
+    void attach(GLFWwindow *window, bool rawMotion = true)
+    {
+        if (rawMotion && glfwRawMouseMotionSupported())
+            glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+        glfwSetWindowUserPointer(window, this);
+        glfwSetKeyCallback(window, [](GLFWwindow *window, int key, int, int action, int mods) {
+            from(window).push(INPUT_KEY, key, action, mods, 0.0, 0.0);
+        });
+        glfwSetMouseButtonCallback(window, [](GLFWwindow *window, int button, int action, int mods) {
+            from(window).push(INPUT_MOUSE_BUTTON, button, action, mods, 0.0, 0.0);
+        });
+        glfwSetCursorPosCallback(window, [](GLFWwindow *window, double x, double y) {
+            from(window).push(INPUT_CURSOR, 0, 0, 0, x, y);
+        });
+        glfwSetScrollCallback(window, [](GLFWwindow *window, double x, double y) {
+            from(window).push(INPUT_SCROLL, 0, 0, 0, x, y);
+        });
+    }
+
+    bool record(const std::string &path)
+    {
+        file.open(path, std::ios::binary);
+        if (!file)
+        {
+            std::cout << "ERROR::INPUT::CANNOT_WRITE: " << path << '\n';
+            return false;
+        }
+        InputFileHeader header = {INPUT_FILE_MAGIC, INPUT_FILE_VERSION};
+        file.write((const char *)&header, sizeof(header));
+        recording = true;
+        return true;
+    }
+
+    // reads the whole recording, live input is ignored from now on
+    bool replay(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        InputFileHeader header = {};
+        if (!in || !in.read((char *)&header, sizeof(header)) || header.magic != INPUT_FILE_MAGIC ||
+            header.version != INPUT_FILE_VERSION)
+        {
+            std::cout << "ERROR::INPUT::INVALID_RECORDING: " << path << '\n';
+            return false;
+        }
+        InputFrameHeader frame;
+        while (in.read((char *)&frame, sizeof(frame)))
+        {
+            size_t first = replayEvents.size();
+            replayEvents.resize(first + frame.eventCount);
+            if (frame.eventCount && !in.read((char *)&replayEvents[first], frame.eventCount * sizeof(InputEvent)))
+            {
+                std::cout << "ERROR::INPUT::TRUNCATED_RECORDING: " << path << '\n';
+                replayEvents.resize(first);
+                break;
+            }
+            replayFrames.push_back(frame);
+        }
+        replaying = true;
+        return true;
+    }
+
+    bool isReplaying() const
+    {
+        return replaying;
+    }
+
+    // events arrived since the last beginFrame(), for a loop that sleeps until there are some
+    bool hasQueuedEvents() const
+    {
+        return !queue.empty();
+    }
+
+    // true once every recorded frame was handed out
+    bool finished() const
+    {
+        return replaying && replayFrame >= replayFrames.size();
+    }
+
+    // the recorded deltaTime of the current frame while replaying, measured otherwise
+    float frameDelta(float measured) const
+    {
+        return replaying && replayFrame > 0 ? replayFrames[replayFrame - 1].deltaTime : measured;
+    }
+
+    // takes the events of the next frame and updates the key table
+    void beginFrame()
+    {
+        frameEvents.clear();
+        if (replaying)
+        {
+            queue.clear();
+            if (replayFrame < replayFrames.size())
+            {
+                frameEvents.assign(replayEvents.begin() + replayOffset,
+                                   replayEvents.begin() + replayOffset + replayFrames[replayFrame].eventCount);
+                replayOffset += replayFrames[replayFrame].eventCount;
+                replayFrame++;
+            }
+        }
+        else
+        {
+            frameEvents.swap(queue);
+        }
+        cursorMoved = false;
+        scrollX = scrollY = 0.0;
+        for (const InputEvent &event : frameEvents)
+        {
+            if (event.type == INPUT_KEY && event.code >= 0 && event.code < KEY_COUNT)
+                keys[event.code] = event.action != GLFW_RELEASE;
+            else if (event.type == INPUT_CURSOR)
+            {
+                cursorMoved = true;
+                cursorX = event.x;
+                cursorY = event.y;
+            }
+            else if (event.type == INPUT_SCROLL)
+            {
+                scrollX += event.x;
+                scrollY += event.y;
+            }
+        }
+    }
+
+    // writes the frame out when recording
+    void endFrame(float deltaTime)
+    {
+        if (!recording)
+            return;
+        InputFrameHeader frame = {deltaTime, (uint32_t)frameEvents.size()};
+        file.write((const char *)&frame, sizeof(frame));
+        if (!frameEvents.empty())
+            file.write((const char *)frameEvents.data(), frameEvents.size() * sizeof(InputEvent));
+        recordedFrames++;
+    }
+
+    // this frame's events in arrival order
+    const std::vector<InputEvent> &events() const
+    {
+        return frameEvents;
+    }
+
+    // where the cursor ended up this frame, false when it didn't move
+    bool cursor(double &x, double &y) const
+    {
+        x = cursorX;
+        y = cursorY;
+        return cursorMoved;
+    }
+
+    // scroll offsets of the whole frame
+    double scrolledX() const
+    {
+        return scrollX;
+    }
+
+    double scrolledY() const
+    {
+        return scrollY;
+    }
+
+    // cursor and scroll events merged into the one before them so far
+    unsigned long coalescedEvents() const
+    {
+        return coalesced;
+    }
+
+    bool isDown(int key) const
+    {
+        return key >= 0 && key < KEY_COUNT && keys[key];
+    }
+
+    bool pressed(int key) const
+    {
+        for (const InputEvent &event : frameEvents)
+        {
+            if (event.type == INPUT_KEY && event.code == key && event.action == GLFW_PRESS)
+                return true;
+        }
+        return false;
+    }
+
+  private:
+    std::vector<InputEvent> queue;
+    std::vector<InputEvent> frameEvents;
+    bool keys[KEY_COUNT] = {};
+    bool cursorMoved = false;
+    double cursorX = 0.0, cursorY = 0.0;
+    double scrollX = 0.0, scrollY = 0.0;
+    unsigned long coalesced = 0;
+
+    std::ofstream file;
+    bool recording = false;
+    unsigned long recordedFrames = 0;
+
+    bool replaying = false;
+    std::vector<InputFrameHeader> replayFrames;
+    std::vector<InputEvent> replayEvents;
+    size_t replayFrame = 0;
+    size_t replayOffset = 0;
+
+    static InputSystem &from(GLFWwindow *window)
+    {
+        return *(InputSystem *)glfwGetWindowUserPointer(window);
+    }
+
+    void push(InputEventType type, int code, int action, int mods, double x, double y)
+    {
+        InputEvent event;
+        std::memset(&event, 0, sizeof(event));
+        event.type = type;
+        event.code = code;
+        event.action = action;
+        event.mods = mods;
+        event.x = x;
+        event.y = y;
+        event.time = glfwGetTime();
+        // the previous cursor position is of no use once a newer one is in, scrolls add up
+        if (!queue.empty() && queue.back().type == (uint32_t)type && (type == INPUT_CURSOR || type == INPUT_SCROLL))
+        {
+            InputEvent &previous = queue.back();
+            if (type == INPUT_SCROLL)
+            {
+                event.x += previous.x;
+                event.y += previous.y;
+            }
+            previous = event;
+            coalesced++;
+            return;
+        }
+        queue.push_back(event);
+    }
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "ring_buffer.cpp"
+
+#include <cstddef>
+
+// Per-instance model matrices fed to the vertex shader as a mat4 attribute with divisor 1,
+// so a whole set of objects is drawn with one instanced draw call.
+// An optional second stream carries a texture array layer per instance.
+// Both streams are written into the frame's RingBuffer region each upload and the
+// attributes of the VAO are pointed at the new offsets, on DSA by moving the streams'
+// vertex buffer bindings while the attribute formats stay as they are. Uploading the same
+// streams again in a frame (casters every cascade sees) points at the first copy.
+class InstanceBuffer
+{
+  public:
+    // vertex buffer bindings of the two streams, the mesh's own vertices are on VertexLayout::BINDING
+    static const unsigned int MODEL_BINDING = 1;
+    static const unsigned int LAYER_BINDING = 2;
+
+    // number of matrices uploaded last
+    size_t count = 0;
+
+    InstanceBuffer(RingBuffer &ring) : ring(ring)
+    {
+    }
+
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+    // the mat4 attribute takes 4 consecutive vec4 locations of vao
+    void attach(unsigned int vertexArray, unsigned int firstLocation)
+    {
+        vao = vertexArray;
+        modelLocation = firstLocation;
+        if (hasDSA())
+        {
+            for (unsigned int column = 0; column < 4; column++)
+            {
+                glVertexArrayAttribFormat(vao, firstLocation + column, 4, GL_FLOAT, GL_FALSE,
+                                          (GLuint)(column * sizeof(glm::vec4)));
+                glVertexArrayAttribBinding(vao, firstLocation + column, MODEL_BINDING);
+                glEnableVertexArrayAttrib(vao, firstLocation + column);
+            }
+            glVertexArrayBindingDivisor(vao, MODEL_BINDING, 1);
+            return;
+        }
+        glState.bindVertexArray(vao);
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(firstLocation + column);
+            glVertexAttribDivisor(firstLocation + column, 1);
+        }
+    }
+
+    // the per-instance int layer attribute, on the same VAO
+    void attachLayers(unsigned int location)
+    {
+        layerLocation = location;
+        if (hasDSA())
+        {
+            glVertexArrayAttribIFormat(vao, location, 1, GL_INT, 0);
+            glVertexArrayAttribBinding(vao, location, LAYER_BINDING);
+            glEnableVertexArrayAttrib(vao, location);
+            glVertexArrayBindingDivisor(vao, LAYER_BINDING, 1);
+            return;
+        }
+        glState.bindVertexArray(vao);
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+
+    // instances drawn per matrix and layer, more than 1 for the views of one draw (see multi_view.cpp)
+    void setDivisor(unsigned int divisor)
+    {
+        if (hasDSA())
+        {
+            glVertexArrayBindingDivisor(vao, MODEL_BINDING, divisor);
+            glVertexArrayBindingDivisor(vao, LAYER_BINDING, divisor);
+            return;
+        }
+        glState.bindVertexArray(vao);
+        for (unsigned int column = 0; column < 4; column++)
+            glVertexAttribDivisor(modelLocation + column, divisor);
+        glVertexAttribDivisor(layerLocation, divisor);
+    }
+
+    // one layer per matrix of the next draw, in the same order
+    void uploadLayers(const int *layers, size_t layerCount)
+    {
+        GLintptr offset = ring.pushUnique(layers, layerCount * sizeof(int), sizeof(int), layersPushed);
+        if (offset < 0)
+            return;
+        if (hasDSA())
+        {
+            glVertexArrayVertexBuffer(vao, LAYER_BINDING, ring.ID, offset, sizeof(int));
+            return;
+        }
+        glState.bindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, ring.ID);
+        glVertexAttribIPointer(layerLocation, 1, GL_INT, sizeof(int), (void *)offset);
+    }
+
+    // copies the matrices into this frame's ring buffer region
+    void upload(const glm::mat4 *models, size_t modelCount)
+    {
+        GLintptr offset = ring.pushUnique(models, modelCount * sizeof(glm::mat4), 16, modelsPushed);
+        count = offset < 0 ? 0 : modelCount;
+        if (offset < 0)
+            return;
+        if (hasDSA())
+        {
+            glVertexArrayVertexBuffer(vao, MODEL_BINDING, ring.ID, offset, sizeof(glm::mat4));
+            return;
+        }
+        glState.bindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, ring.ID);
+        for (unsigned int column = 0; column < 4; column++)
+            glVertexAttribPointer(modelLocation + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                  (void *)(offset + column * sizeof(glm::vec4)));
+    }
+
+  private:
+    RingBuffer &ring;
+    RingBuffer::PushCache modelsPushed, layersPushed;
+    unsigned int vao = 0;
+    unsigned int modelLocation = 0, layerLocation = 0;
+};
+
+#endif
@@ -0,0 +1,312 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include "alloc_tracker.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// counts the unfinished jobs of a group, a job can add children to the group it runs in
+struct JobCounter
+{
+    std::atomic<int> pending{0};
+};
+
+// Work stealing scheduler for per-frame tasks.
+// Every worker has its own deque: it pushes and pops its jobs at the back, newest first
+// while the data is still in cache, and an idle worker steals from the front of another
+// one's deque. Threads outside the pool push to a shared deque. wait() runs jobs while
+// the counter isn't zero, so waiting never blocks a thread the jobs depend on.
+class JobSystem
+{
+  public:
+    // workers default to one per hardware thread minus the calling one, pinned workers are
+    // bound to one core each, the cores of the calling thread's NUMA node first (see coreOrder())
+    JobSystem(unsigned int threadCount = 0, bool pin = false)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        queues.resize(threadCount + 1);
+        for (std::unique_ptr<Queue> &queue : queues)
+            queue = std::make_unique<Queue>();
+        std::vector<unsigned int> cores;
+        if (pin)
+            cores = coreOrder();
+        for (unsigned int i = 0; i < threadCount; i++)
+        {
+            threads.emplace_back(&JobSystem::run, this, i);
+            // the first core is the calling thread's
+            if (pin)
+                pinThread(threads.back(), cores[(i + 1) % cores.size()]);
+        }
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    unsigned int workerCount() const
+    {
+        return (unsigned int)threads.size();
+    }
+
+    void submit(std::function<void()> function, JobCounter &counter)
+    {
+        counter.pending.fetch_add(1);
+        Queue &queue = *queues[ownQueue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back({std::move(function), &counter});
+        }
+        queued.fetch_add(1);
+        // a worker between its empty check and its sleep holds sleepMutex, so it can't miss this
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    // helps with any queued job until every job of counter is done
+    void wait(JobCounter &counter)
+    {
+        while (counter.pending.load() > 0)
+        {
+            if (!runOne(ownQueue()))
+                std::this_thread::yield();
+        }
+    }
+
+    // splits [begin, end) into ranges of about grain elements and calls function(first, last)
+    // for each, the calling thread takes part. A range smaller than grain runs inline.
+    template <typename Function> void parallelFor(size_t begin, size_t end, size_t grain, Function function)
+    {
+        grain = std::max<size_t>(grain, 1);
+        if (end - begin <= grain || threads.empty())
+        {
+            if (begin < end)
+                function(begin, end);
+            return;
+        }
+        JobCounter counter;
+        for (size_t first = begin + grain; first < end; first += grain)
+        {
+            size_t last = std::min(first + grain, end);
+            submit([&function, first, last] { function(first, last); }, counter);
+        }
+        function(begin, begin + grain);
+        wait(counter);
+    }
+
+  private:
+    struct Job
+    {
+        std::function<void()> function;
+        JobCounter *counter;
+    };
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<int> queued{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    // index of the calling worker, -1 on threads outside the pool
+    static int &workerIndex()
+    {
+        thread_local int index = -1;
+        return index;
+    }
+
+    // workers own a deque each, every other thread shares the last one
+    size_t ownQueue() const
+    {
+        int index = workerIndex();
+        return index >= 0 ? (size_t)index : queues.size() - 1;
+    }
+
+    // own jobs newest first, then the oldest job of another queue
+    bool runOne(size_t own)
+    {
+        Job job;
+        bool found = false;
+        {
+            Queue &queue = *queues[own];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.jobs.empty())
+            {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+                found = true;
+            }
+        }
+        for (size_t i = 1; !found && i < queues.size(); i++)
+        {
+            Queue &queue = *queues[(own + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.jobs.empty())
+            {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+                found = true;
+            }
+        }
+        if (!found)
+            return false;
+        queued.fetch_sub(1);
+        job.function();
+        job.counter->pending.fetch_sub(1);
+        return true;
+    }
+
+    void run(unsigned int index)
+    {
+        ALLOC_TAG("jobs");
+        workerIndex() = (int)index;
+        while (true)
+        {
+            if (runOne(index))
+                continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+            if (stopping)
+                return;
+        }
+    }
+
+    // The cores in the order workers are pinned to them: the calling thread's, the rest of its
+    // NUMA node, then the other nodes. On a multi-socket machine the workers fill the socket
+    // whose memory the calling thread touched first (the arenas, the component arrays) before
+    // they cross to another one. Without NUMA information the cores in their own order.
+    static std::vector<unsigned int> coreOrder()
+    {
+        unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::vector<unsigned int>> nodes;
+        int current = -1;
+#ifdef _WIN32
+        ULONG highest = 0;
+        if (GetNumaHighestNodeNumber(&highest))
+        {
+            for (ULONG node = 0; node <= highest; node++)
+            {
+                ULONGLONG mask = 0;
+                nodes.emplace_back();
+                if (!GetNumaNodeProcessorMask((UCHAR)node, &mask))
+                    continue;
+                for (unsigned int core = 0; core < 64 && core < cores; core++)
+                {
+                    if (mask & ((ULONGLONG)1 << core))
+                        nodes.back().push_back(core);
+                }
+            }
+        }
+        current = (int)GetCurrentProcessorNumber();
+#elif defined(__linux__)
+        // "0-7,16-23" per node, the numbers of the nodes can have gaps
+        for (unsigned int node = 0; node < 64; node++)
+        {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string list;
+            if (!file || !std::getline(file, list))
+                continue;
+            nodes.emplace_back();
+            size_t at = 0;
+            while (at < list.size())
+            {
+                size_t end = list.find(',', at);
+                std::string range = list.substr(at, end == std::string::npos ? std::string::npos : end - at);
+                size_t dash = range.find('-');
+                unsigned long first = std::strtoul(range.c_str(), NULL, 10);
+                unsigned long last = first;
+                if (dash != std::string::npos)
+                    last = std::strtoul(range.c_str() + dash + 1, NULL, 10);
+                for (unsigned long core = first; core <= last && core < cores; core++)
+                    nodes.back().push_back((unsigned int)core);
+                at = end == std::string::npos ? list.size() : end + 1;
+            }
+        }
+        current = sched_getcpu();
+#endif
+        std::vector<unsigned int> order;
+        std::vector<bool> taken(cores, false);
+        auto take = [&](unsigned int core) {
+            if (core < cores && !taken[core])
+            {
+                taken[core] = true;
+                order.push_back(core);
+            }
+        };
+        if (current >= 0)
+            take((unsigned int)current);
+        for (const std::vector<unsigned int> &node : nodes)
+        {
+            if (std::find(node.begin(), node.end(), (unsigned int)current) != node.end())
+                for (unsigned int core : node)
+                    take(core);
+        }
+        for (const std::vector<unsigned int> &node : nodes)
+            for (unsigned int core : node)
+                take(core);
+        // cores no node listed, and every core without NUMA information
+        for (unsigned int core = 0; core < cores; core++)
+            take(core);
+        return order;
+    }
+
+    static void pinThread(std::thread &thread, unsigned int core)
+    {
+        unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+        core %= cores;
+#ifdef _WIN32
+        SetThreadAffinityMask((HANDLE)thread.native_handle(), (DWORD_PTR)1 << core);
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+        (void)thread;
+#endif
+    }
+};
+
+#endif
@@ -0,0 +1,395 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Small DOM style JSON reader for asset files (glTF), parsed once at load time.
+// Lookups of missing keys or indices return a shared null value,
+// so chains like doc["meshes"][0]["name"] never need to check each step.
+class JsonValue
+{
+  public:
+    enum Type
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    Type type = Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    // members in file order, objects in asset files are small enough for a linear search
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue &operator[](const char *key) const
+    {
+        for (const auto &member : object)
+        {
+            if (member.first == key)
+                return member.second;
+        }
+        return null();
+    }
+
+    const JsonValue &operator[](size_t index) const
+    {
+        return index < array.size() ? array[index] : null();
+    }
+
+    // keeps literal 0 from converting to a null key
+    const JsonValue &operator[](int index) const
+    {
+        return index >= 0 ? (*this)[(size_t)index] : null();
+    }
+
+    bool has(const char *key) const
+    {
+        return &(*this)[key] != &null();
+    }
+
+    bool isNull() const
+    {
+        return type == Null;
+    }
+
+    size_t size() const
+    {
+        return type == Array ? array.size() : type == Object ? object.size() : 0;
+    }
+
+    double asNumber(double fallback = 0.0) const
+    {
+        return type == Number ? number : fallback;
+    }
+
+    int asInt(int fallback = 0) const
+    {
+        return type == Number ? (int)number : fallback;
+    }
+
+    bool asBool(bool fallback = false) const
+    {
+        return type == Bool ? boolean : fallback;
+    }
+
+    const std::string &asString() const
+    {
+        return string;
+    }
+
+    static const JsonValue &null()
+    {
+        static const JsonValue value;
+        return value;
+    }
+};
+
+namespace json
+{
+class Parser
+{
+  public:
+    std::string error;
+
+    Parser(const char *text, size_t size) : cursor(text), begin(text), end(text + size)
+    {
+    }
+
+    bool parse(JsonValue &value)
+    {
+        if (!parseValue(value, 0))
+            return false;
+        skipWhitespace();
+        if (cursor != end)
+            return fail("trailing characters");
+        return true;
+    }
+
+  private:
+    // deep enough for any asset file, protects the stack from hostile input
+    static const int MAX_DEPTH = 256;
+
+    const char *cursor;
+    const char *begin;
+    const char *end;
+
+    bool fail(const char *message)
+    {
+        error = std::string(message) + " at offset " + std::to_string(cursor - begin);
+        return false;
+    }
+
+    void skipWhitespace()
+    {
+        while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r'))
+            cursor++;
+    }
+
+    bool literal(const char *word)
+    {
+        size_t length = std::strlen(word);
+        if ((size_t)(end - cursor) < length || std::strncmp(cursor, word, length) != 0)
+            return fail("invalid literal");
+        cursor += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue &value, int depth)
+    {
+        if (depth > MAX_DEPTH)
+            return fail("nesting too deep");
+        skipWhitespace();
+        if (cursor >= end)
+            return fail("unexpected end");
+
+        switch (*cursor)
+        {
+        case '{':
+            return parseObject(value, depth);
+        case '[':
+            return parseArray(value, depth);
+        case '"':
+            value.type = JsonValue::String;
+            return parseString(value.string);
+        case 't':
+            value.type = JsonValue::Bool;
+            value.boolean = true;
+            return literal("true");
+        case 'f':
+            value.type = JsonValue::Bool;
+            value.boolean = false;
+            return literal("false");
+        case 'n':
+            value.type = JsonValue::Null;
+            return literal("null");
+        default:
+            return parseNumber(value);
+        }
+    }
+
+    bool parseNumber(JsonValue &value)
+    {
+        // strtod needs a terminated string, numbers are short
+        char buffer[64];
+        size_t length = 0;
+        while (cursor + length < end && length < sizeof(buffer) - 1 &&
+               cursor[length] && std::strchr("+-0123456789.eE", cursor[length]))
+        {
+            buffer[length] = cursor[length];
+            length++;
+        }
+        buffer[length] = '\0';
+        char *parsedEnd;
+        value.number = std::strtod(buffer, &parsedEnd);
+        if (length == 0 || parsedEnd != buffer + length)
+            return fail("invalid number");
+        value.type = JsonValue::Number;
+        cursor += length;
+        return true;
+    }
+
+    static void appendUTF8(std::string &out, unsigned int code)
+    {
+        if (code < 0x80)
+        {
+            out += (char)code;
+        }
+        else if (code < 0x800)
+        {
+            out += (char)(0xC0 | (code >> 6));
+            out += (char)(0x80 | (code & 0x3F));
+        }
+        else if (code < 0x10000)
+        {
+            out += (char)(0xE0 | (code >> 12));
+            out += (char)(0x80 | ((code >> 6) & 0x3F));
+            out += (char)(0x80 | (code & 0x3F));
+        }
+        else
+        {
+            out += (char)(0xF0 | (code >> 18));
+            out += (char)(0x80 | ((code >> 12) & 0x3F));
+            out += (char)(0x80 | ((code >> 6) & 0x3F));
+            out += (char)(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool parseHex4(unsigned int &code)
+    {
+        if (end - cursor < 4)
+            return fail("truncated escape");
+        code = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            char c = *cursor++;
+            code <<= 4;
+            if (c >= '0' && c <= '9')
+                code |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                code |= c - 'A' + 10;
+            else
+                return fail("invalid escape");
+        }
+        return true;
+    }
+
+    bool parseString(std::string &out)
+    {
+        // opening quote
+        cursor++;
+        while (cursor < end && *cursor != '"')
+        {
+            char c = *cursor++;
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if (cursor >= end)
+                break;
+            c = *cursor++;
+            switch (c)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                out += c;
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u':
+            {
+                unsigned int code = 0;
+                if (!parseHex4(code))
+                    return false;
+                // surrogate pair
+                if (code >= 0xD800 && code < 0xDC00 && end - cursor >= 6 && cursor[0] == '\\' && cursor[1] == 'u')
+                {
+                    cursor += 2;
+                    unsigned int low = 0;
+                    if (!parseHex4(low))
+                        return false;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUTF8(out, code);
+                break;
+            }
+            default:
+                return fail("invalid escape");
+            }
+        }
+        if (cursor >= end)
+            return fail("unterminated string");
+        // closing quote
+        cursor++;
+        return true;
+    }
+
+    bool parseArray(JsonValue &value, int depth)
+    {
+        value.type = JsonValue::Array;
+        cursor++;
+        skipWhitespace();
+        if (cursor < end && *cursor == ']')
+        {
+            cursor++;
+            return true;
+        }
+        for (;;)
+        {
+            value.array.emplace_back();
+            if (!parseValue(value.array.back(), depth + 1))
+                return false;
+            skipWhitespace();
+            if (cursor < end && *cursor == ',')
+            {
+                cursor++;
+                continue;
+            }
+            if (cursor < end && *cursor == ']')
+            {
+                cursor++;
+                return true;
+            }
+            return fail("expected , or ]");
+        }
+    }
+
+    bool parseObject(JsonValue &value, int depth)
+    {
+        value.type = JsonValue::Object;
+        cursor++;
+        skipWhitespace();
+        if (cursor < end && *cursor == '}')
+        {
+            cursor++;
+            return true;
+        }
+        for (;;)
+        {
+            skipWhitespace();
+            if (cursor >= end || *cursor != '"')
+                return fail("expected key");
+            value.object.emplace_back();
+            if (!parseString(value.object.back().first))
+                return false;
+            skipWhitespace();
+            if (cursor >= end || *cursor != ':')
+                return fail("expected :");
+            cursor++;
+            if (!parseValue(value.object.back().second, depth + 1))
+                return false;
+            skipWhitespace();
+            if (cursor < end && *cursor == ',')
+            {
+                cursor++;
+                continue;
+            }
+            if (cursor < end && *cursor == '}')
+            {
+                cursor++;
+                return true;
+            }
+            return fail("expected , or }");
+        }
+    }
+};
+} // namespace json
+
+// parses a whole document, error describes the first problem on failure
+inline bool parseJson(const char *text, size_t size, JsonValue &value, std::string &error)
+{
+    json::Parser parser(text, size);
+    value = JsonValue();
+    if (parser.parse(value))
+        return true;
+    error = parser.error;
+    return false;
+}
+
+#endif
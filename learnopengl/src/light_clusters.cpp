@@ -0,0 +1,173 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "block_layout.cpp"
+#include "decal_set.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "light_set.cpp"
+#include "ring_buffer.cpp"
+#include "shader.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Mirrors the std140 ClusterData block in shader_src/clustered_lights.glsl
+struct ClusterData
+{
+    // clusters along x, y and z, w is the number of lights
+    glm::uvec4 grid;
+    // x is the number of decals
+    glm::uvec4 decalCount;
+    // xy tile size in pixels, zw scale and bias from log(view depth) to the slice
+    glm::vec4 tile;
+    // x zNear, y zFar, zw the target size in pixels
+    glm::vec4 depthRange;
+    glm::vec4 ambient;
+    // towards the sun
+    glm::vec4 sunDirection;
+    glm::vec4 sunColor;
+};
+
+constexpr BlockMember CLUSTER_DATA_LAYOUT[] = {
+    BLOCK_MEMBER(ClusterData, grid, GL_UNSIGNED_INT_VEC4),  BLOCK_MEMBER(ClusterData, decalCount, GL_UNSIGNED_INT_VEC4),
+    BLOCK_MEMBER(ClusterData, tile, GL_FLOAT_VEC4),         BLOCK_MEMBER(ClusterData, depthRange, GL_FLOAT_VEC4),
+    BLOCK_MEMBER(ClusterData, ambient, GL_FLOAT_VEC4),      BLOCK_MEMBER(ClusterData, sunDirection, GL_FLOAT_VEC4),
+    BLOCK_MEMBER(ClusterData, sunColor, GL_FLOAT_VEC4),
+};
+static_assert(blockLayoutMismatch(CLUSTER_DATA_LAYOUT, STD140) == -1, "ClusterData members are not where std140 puts them");
+static_assert(blockLayoutSize(CLUSTER_DATA_LAYOUT, STD140) == sizeof(ClusterData), "ClusterData is not padded like std140");
+
+// Clustered forward lighting: the view frustum is cut into GRID_X x GRID_Y screen tiles and
+// GRID_Z slices spaced logarithmically in view depth from zNear to zFar (froxels), and every
+// frame a compute pass (cluster_lights.comp) tests the lights against each cluster's view space
+// box and writes the indices of the ones touching it to one compact list, a cluster keeping
+// the offset and count of its run. The forward fragment shader (clustered.fs) finds its
+// cluster from the pixel and its view depth and loops over that run only, so thousands of
+// lights cost what the few in reach of a pixel cost, and blending and MSAA keep working.
+// The DecalSet's boxes are binned the same pass by their bounding spheres into a second run of
+// every cluster, and the fragment shader lays them over the albedo before the lighting, so a
+// decal costs only the pixels of the clusters it touches and no draw or overdraw of its own.
+// Beyond zFar (the projection's far plane is infinite with reversed-Z) pixels use the last slice.
+// A cluster keeps its first 128 lights and 32 decals (MAX_LIGHTS_PER_CLUSTER and
+// MAX_DECALS_PER_CLUSTER in the compute shader) and the list its first INDEX_CAPACITY entries,
+// lights and decals past either are dropped from that cluster.
+// Needs GL 4.3 for the compute pass and storage blocks in the fragment stage.
+class LightClusters
+{
+  public:
+    static const unsigned int GRID_X = 16;
+    static const unsigned int GRID_Y = 9;
+    static const unsigned int GRID_Z = 24;
+    static const unsigned int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+    // of the list shared by all clusters, 64 lights per cluster on average
+    static const unsigned int INDEX_CAPACITY = CLUSTER_COUNT * 64;
+    static const unsigned int MAX_LIGHTS = 8192;
+    static const unsigned int MAX_DECALS = 1024;
+    // same as local_size_x in cluster_lights.comp
+    static const unsigned int GROUP_SIZE = 64;
+
+    static const unsigned int DATA_BINDING = 4;
+    static const unsigned int LIGHTS_BINDING = 12;
+    static const unsigned int CLUSTERS_BINDING = 13;
+    static const unsigned int INDICES_BINDING = 14;
+    static const unsigned int COUNTER_BINDING = 15;
+    static const unsigned int DECALS_BINDING = 16;
+
+    glm::vec3 ambient = glm::vec3(0.3f);
+    glm::vec3 sunDirection = glm::normalize(glm::vec3(0.3f, 1.0f, 0.5f));
+    glm::vec3 sunColor = glm::vec3(0.6f);
+
+    LightClusters(RingBuffer &ring, Shader &buildShader) : ring(ring), buildShader(buildShader)
+    {
+        clusters = createBuffer(CLUSTER_COUNT * 4 * sizeof(unsigned int), NULL, 0);
+        indices = createBuffer(INDEX_CAPACITY * sizeof(unsigned int), NULL, 0);
+        counter = createBuffer(sizeof(unsigned int), NULL, GL_DYNAMIC_STORAGE_BIT, GL_DYNAMIC_DRAW);
+        indexCapacityLoc = buildShader.uniform("indexCapacity");
+    }
+
+    ~LightClusters()
+    {
+        deleteBuffers(1, &clusters);
+        deleteBuffers(1, &indices);
+        deleteBuffers(1, &counter);
+    }
+
+    LightClusters(const LightClusters &) = delete;
+    LightClusters &operator=(const LightClusters &) = delete;
+
+    static bool isSupported()
+    {
+        if (!GLAD_GL_VERSION_4_3)
+            return false;
+        GLint blocks = 0, bindings = 0;
+        glGetIntegerv(GL_MAX_FRAGMENT_SHADER_STORAGE_BLOCKS, &blocks);
+        glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &bindings);
+        return blocks >= 4 && bindings > (GLint)DECALS_BINDING;
+    }
+
+    // bins the first MAX_LIGHTS lights and MAX_DECALS decals for a width x height target, after
+    // FrameDataBuffer::update(); leaves the data, lights, decals, clusters and indices bound for the draws
+    void build(const std::vector<PointLight> &lights, const std::vector<Decal> &decals, int width, int height,
+               float zNear, float zFar)
+    {
+        unsigned int count = (unsigned int)std::min(lights.size(), (size_t)MAX_LIGHTS);
+        GLintptr lightsOffset = -1;
+        if (count > 0)
+            lightsOffset = ring.push(lights.data(), count * sizeof(PointLight), ring.storageAlignment);
+        if (lightsOffset < 0)
+            count = 0;
+        else
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHTS_BINDING, ring.ID, lightsOffset,
+                                    count * sizeof(PointLight));
+        unsigned int decalCount = (unsigned int)std::min(decals.size(), (size_t)MAX_DECALS);
+        GLintptr decalsOffset = -1;
+        if (decalCount > 0)
+            decalsOffset = ring.push(decals.data(), decalCount * sizeof(Decal), ring.storageAlignment);
+        if (decalsOffset < 0)
+            decalCount = 0;
+        else
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, DECALS_BINDING, ring.ID, decalsOffset,
+                                    decalCount * sizeof(Decal));
+
+        ClusterData data;
+        data.grid = glm::uvec4(GRID_X, GRID_Y, GRID_Z, count);
+        data.decalCount = glm::uvec4(decalCount, 0, 0, 0);
+        float logRange = std::log(zFar / zNear);
+        data.tile = glm::vec4((float)((width + GRID_X - 1) / GRID_X), (float)((height + GRID_Y - 1) / GRID_Y),
+                              GRID_Z / logRange, -(float)GRID_Z * std::log(zNear) / logRange);
+        data.depthRange = glm::vec4(zNear, zFar, (float)width, (float)height);
+        data.ambient = glm::vec4(ambient, 0.0f);
+        data.sunDirection = glm::vec4(sunDirection, 0.0f);
+        data.sunColor = glm::vec4(sunColor, 0.0f);
+        GLintptr dataOffset = ring.push(&data, sizeof(ClusterData), ring.uniformAlignment);
+        if (dataOffset < 0)
+            return;
+        glState.bindBufferRange(GL_UNIFORM_BUFFER, DATA_BINDING, ring.ID, dataOffset, sizeof(ClusterData));
+
+        // the clusters append their runs behind this
+        const unsigned int zero = 0;
+        updateBuffer(counter, 0, sizeof(zero), &zero);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, CLUSTERS_BINDING, clusters, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, INDICES_BINDING, indices, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, COUNTER_BINDING, counter, 0, 0);
+        buildShader.use();
+        buildShader.set(indexCapacityLoc, INDEX_CAPACITY);
+        glDispatchCompute((CLUSTER_COUNT + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+  private:
+    RingBuffer &ring;
+    Shader &buildShader;
+    unsigned int clusters = 0;
+    unsigned int indices = 0;
+    unsigned int counter = 0;
+    UniformHandle indexCapacityLoc;
+};
+
+#endif
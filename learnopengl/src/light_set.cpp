@@ -0,0 +1,94 @@
+#ifndef LIGHT_SET_H
+#define LIGHT_SET_H
+
+#include "glm/glm.hpp"
+
+#include "block_layout.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// one point light as the shaders read it (shader_src/point_light.glsl), the same in std140 and std430
+struct PointLight
+{
+    // xyz position, w radius of influence
+    glm::vec4 positionRadius;
+    // rgb color times intensity, w the index + 1 of its PointShadowAtlas shadow, 0 for none
+    glm::vec4 color;
+};
+
+constexpr BlockMember POINT_LIGHT_LAYOUT[] = {
+    BLOCK_MEMBER(PointLight, positionRadius, GL_FLOAT_VEC4),
+    BLOCK_MEMBER(PointLight, color, GL_FLOAT_VEC4),
+};
+static_assert(blockLayoutMismatch(POINT_LIGHT_LAYOUT, STD140) == -1, "PointLight members are not where std140 puts them");
+static_assert(blockLayoutMismatch(POINT_LIGHT_LAYOUT, STD430) == -1, "PointLight members are not where std430 puts them");
+static_assert(blockLayoutSize(POINT_LIGHT_LAYOUT, STD140) == sizeof(PointLight), "PointLight is not padded like std140");
+
+// The dynamic point lights of the scene, shared by the deferred and the clustered path.
+// They are made up from anchors and drift around them, the same lights every run.
+class LightSet
+{
+  public:
+    std::vector<PointLight> lights;
+
+    // count lights of radius circling next to randomly picked anchors, e.g. the objects they light
+    void scatter(size_t count, const std::vector<glm::vec3> &anchors, float radius, uint32_t seed)
+    {
+        if (anchors.empty())
+            count = 0;
+        lights.resize(count);
+        orbits.resize(lights.size());
+        uint32_t state = seed ? seed : 1u;
+        auto random = [&state]() {
+            // xorshift32, the same lights every run
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return (float)(state & 0xFFFFFF) / (float)0x1000000;
+        };
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            const glm::vec3 &anchor = anchors[std::min((size_t)(random() * anchors.size()), anchors.size() - 1)];
+            glm::vec3 t(random(), random(), random());
+            orbits[i] = glm::vec4(anchor + (t - 0.5f) * radius * 0.5f, random() * 6.2831853f);
+            // a bright hue, each channel between 0.2 and 1
+            float hue = random() * 6.0f;
+            glm::vec3 color = glm::clamp(glm::abs(glm::mod(glm::vec3(hue, hue + 4.0f, hue + 2.0f), 6.0f) - 3.0f) - 1.0f,
+                                         0.0f, 1.0f);
+            lights[i].color = glm::vec4((0.2f + 0.8f * color) * radius * 0.5f, 0.0f);
+            lights[i].positionRadius.w = radius;
+        }
+        animate(0.0f);
+    }
+
+    // moves the scattered lights along their circles
+    void animate(float time)
+    {
+        for (size_t i = 0; i < orbits.size(); i++)
+        {
+            float angle = orbits[i].w + time * 0.5f;
+            float reach = lights[i].positionRadius.w * 0.3f;
+            glm::vec3 offset(std::cos(angle) * reach, std::sin(angle * 1.3f) * reach * 0.5f, std::sin(angle) * reach);
+            lights[i].positionRadius = glm::vec4(glm::vec3(orbits[i]) + offset, lights[i].positionRadius.w);
+        }
+    }
+
+    // every light moved by offset, with its circle
+    void translate(const glm::vec3 &offset)
+    {
+        for (size_t i = 0; i < orbits.size(); i++)
+        {
+            orbits[i] += glm::vec4(offset, 0.0f);
+            lights[i].positionRadius += glm::vec4(offset, 0.0f);
+        }
+    }
+
+  private:
+    // xyz center, w phase of each scattered light
+    std::vector<glm::vec4> orbits;
+};
+
+#endif
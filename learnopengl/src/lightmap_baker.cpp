@@ -0,0 +1,528 @@
+#ifndef LIGHTMAP_BAKER_H
+#define LIGHTMAP_BAKER_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "asset_pack.cpp"
+#include "gl_extensions.cpp"
+#include "hash.cpp"
+#include "mesh.cpp"
+#include "mesh_cooker.cpp"
+#include "shader.cpp"
+#include "shader_compiler.cpp"
+#include "texture.cpp"
+#include "texture_atlas.cpp"
+#include "texture_cooker.cpp"
+#include "triangle_bvh.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Baked lighting for geometry that never moves, the static batches (see static_batches.cpp):
+// - unwrapLightmap() gives a mesh a second texture coordinate into one square atlas. Triangles
+//   that share a corner position and face the same way are one chart, projected flat onto
+//   their plane at texelsPerUnit, and the charts are shelf packed tallest first with
+//   LIGHTMAP_PADDING texels between them (see texture_atlas.cpp). When they don't fit the
+//   density goes down until they do. A curved surface comes out as a chart per triangle.
+// - LightmapBaker::bake() finds the world position and normal of every texel a triangle
+//   covers or grazes, then path traces them on the GPU against the TriangleBvh
+//   (shader_src/lightmap_bake.comp): the sun through its disc, the sky where a cosine
+//   weighted ray escapes and the sun's light off the surface it hits where it doesn't, one
+//   diffuse bounce. Passes of SAMPLES_PER_PASS paths add up until samples are in. The sums
+//   are read back, the empty texels next to the charts take their neighbours' light so
+//   bilinear filtering and the few mip levels don't darken the edges, and the result is
+//   RGBM encoded and BC3 compressed into a cooked DDS.
+// The DDS sits where the TextureLoader looks for the cooked version of sourcePath(key), an
+// image that doesn't exist, so the lightmap loads like any cooked texture, from the asset
+// pack when it was packed (see asset_pack.cpp). The key is the hash of the unwrapped geometry
+// and the bake settings, a change to either bakes again under a new name.
+// The shaders (SHADER_LIGHTMAP) multiply the albedo by rgb * a * RANGE.
+
+// texels around each chart, which the dilation fills
+const int LIGHTMAP_PADDING = 4;
+// what the padding keeps apart without the charts bleeding into each other
+const int LIGHTMAP_LEVELS = 3;
+
+namespace lightmap
+{
+// a corner of a triangle, by position and the quantized direction of its triangle
+struct Corner
+{
+    float position[3];
+    int direction[3];
+
+    bool operator==(const Corner &other) const
+    {
+        return std::memcmp(this, &other, sizeof(Corner)) == 0;
+    }
+};
+
+struct CornerHash
+{
+    size_t operator()(const Corner &corner) const
+    {
+        return (size_t)fnv1a64(&corner, sizeof(corner));
+    }
+};
+
+struct Chart
+{
+    // the plane the chart is projected onto
+    glm::vec3 axisU = glm::vec3(1.0f, 0.0f, 0.0f), axisV = glm::vec3(0.0f, 0.0f, 1.0f);
+    glm::vec3 normal = glm::vec3(0.0f);
+    glm::vec2 low = glm::vec2(1e30f), high = glm::vec2(-1e30f);
+    // in texels, inside the padding
+    int width = 0, height = 0;
+    int x = 0, y = 0;
+};
+
+inline uint32_t findRoot(std::vector<uint32_t> &parents, uint32_t t)
+{
+    while (parents[t] != t)
+    {
+        parents[t] = parents[parents[t]];
+        t = parents[t];
+    }
+    return t;
+}
+
+inline glm::vec3 vertexPosition(const MeshBuilder &mesh, uint32_t index)
+{
+    const float *vertex = &mesh.vertices[(size_t)index * mesh.stride];
+    return glm::vec3(vertex[0], vertex[1], vertex[2]);
+}
+
+// p's barycentric coordinates in the 2D triangle a b c of twice the signed area
+inline glm::vec3 barycentric(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c, float area)
+{
+    float u = ((b.x - p.x) * (c.y - p.y) - (c.x - p.x) * (b.y - p.y)) / area;
+    float v = ((c.x - p.x) * (a.y - p.y) - (a.x - p.x) * (c.y - p.y)) / area;
+    return glm::vec3(u, v, 1.0f - u - v);
+}
+
+// the point of segment a b nearest to p, t along it
+inline glm::vec2 nearestOnSegment(glm::vec2 p, glm::vec2 a, glm::vec2 b, float &t)
+{
+    glm::vec2 ab = b - a;
+    float length = glm::dot(ab, ab);
+    t = length > 0.0f ? glm::clamp(glm::dot(p - a, ab) / length, 0.0f, 1.0f) : 0.0f;
+    return a + ab * t;
+}
+
+// a 2x2 box filter of a size x size level over the texels with light, w 1 where there is
+inline std::vector<glm::vec4> halve(const std::vector<glm::vec4> &light, int size)
+{
+    int half = std::max(1, size / 2);
+    std::vector<glm::vec4> result((size_t)half * half, glm::vec4(0.0f));
+    for (int y = 0; y < half; y++)
+    {
+        for (int x = 0; x < half; x++)
+        {
+            glm::vec4 sum(0.0f);
+            for (int s = 0; s < 4; s++)
+            {
+                const glm::vec4 &texel = light[(size_t)std::min(y * 2 + s / 2, size - 1) * size +
+                                               std::min(x * 2 + s % 2, size - 1)];
+                sum += glm::vec4(glm::vec3(texel) * texel.w, texel.w);
+            }
+            if (sum.w > 0.0f)
+                result[(size_t)y * half + x] = glm::vec4(glm::vec3(sum) / sum.w, 1.0f);
+        }
+    }
+    return result;
+}
+} // namespace lightmap
+
+// mesh (OBJ_VERTEX_FLOATS) with a lightmap coordinate behind every vertex into out
+// (LIGHTMAPPED_VERTEX_FLOATS) for a size x size atlas; the indices keep their order, so the
+// submeshes stay as they are. Returns the texels per world unit the charts fit at, 0 when
+// nothing fits.
+inline float unwrapLightmap(const MeshBuilder &mesh, int size, float texelsPerUnit, MeshBuilder &out)
+{
+    using namespace lightmap;
+    if (mesh.stride != OBJ_VERTEX_FLOATS || mesh.indices.size() < 3 || size <= 2 * LIGHTMAP_PADDING)
+        return 0.0f;
+    size_t triangleCount = mesh.indices.size() / 3;
+    std::vector<glm::vec3> areaNormals(triangleCount);
+    std::vector<uint32_t> parents(triangleCount);
+    std::iota(parents.begin(), parents.end(), 0u);
+    std::unordered_map<Corner, uint32_t, CornerHash> corners;
+    corners.reserve(mesh.indices.size());
+    for (uint32_t t = 0; t < (uint32_t)triangleCount; t++)
+    {
+        glm::vec3 a = vertexPosition(mesh, mesh.indices[t * 3]), b = vertexPosition(mesh, mesh.indices[t * 3 + 1]),
+                  c = vertexPosition(mesh, mesh.indices[t * 3 + 2]);
+        areaNormals[t] = glm::cross(b - a, c - a);
+        float length = glm::length(areaNormals[t]);
+        glm::vec3 direction = length > 0.0f ? areaNormals[t] / length : glm::vec3(0.0f);
+        for (int k = 0; k < 3; k++)
+        {
+            glm::vec3 p = vertexPosition(mesh, mesh.indices[t * 3 + k]);
+            // + 0 folds -0 into 0, the bits are the key
+            Corner corner = {{p.x + 0.0f, p.y + 0.0f, p.z + 0.0f},
+                             {(int)std::lround(direction.x * 256.0f), (int)std::lround(direction.y * 256.0f),
+                              (int)std::lround(direction.z * 256.0f)}};
+            auto found = corners.emplace(corner, t);
+            if (!found.second)
+                parents[findRoot(parents, t)] = findRoot(parents, found.first->second);
+        }
+    }
+
+    std::vector<Chart> charts;
+    std::vector<uint32_t> chartOf(triangleCount), rootChart(triangleCount, UINT32_MAX);
+    for (uint32_t t = 0; t < (uint32_t)triangleCount; t++)
+    {
+        uint32_t root = findRoot(parents, t);
+        if (rootChart[root] == UINT32_MAX)
+        {
+            rootChart[root] = (uint32_t)charts.size();
+            charts.emplace_back();
+        }
+        chartOf[t] = rootChart[root];
+        charts[chartOf[t]].normal += areaNormals[t];
+    }
+    for (Chart &chart : charts)
+    {
+        float length = glm::length(chart.normal);
+        glm::vec3 normal = length > 0.0f ? chart.normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 helper = std::abs(normal.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        chart.axisU = glm::normalize(glm::cross(helper, normal));
+        chart.axisV = glm::cross(normal, chart.axisU);
+    }
+    for (size_t i = 0; i < mesh.indices.size(); i++)
+    {
+        Chart &chart = charts[chartOf[i / 3]];
+        glm::vec3 p = vertexPosition(mesh, mesh.indices[i]);
+        glm::vec2 uv(glm::dot(p, chart.axisU), glm::dot(p, chart.axisV));
+        chart.low = glm::min(chart.low, uv);
+        chart.high = glm::max(chart.high, uv);
+    }
+
+    // a quarter fewer texels a try, down to a texel a chart
+    std::vector<uint32_t> order(charts.size());
+    std::iota(order.begin(), order.end(), 0u);
+    float scale = texelsPerUnit;
+    for (;; scale *= 0.75f)
+    {
+        bool smallest = true;
+        for (Chart &chart : charts)
+        {
+            glm::vec2 extent = (chart.high - chart.low) * scale;
+            chart.width = (int)std::ceil(extent.x) + 1;
+            chart.height = (int)std::ceil(extent.y) + 1;
+            smallest = smallest && chart.width <= 2 && chart.height <= 2;
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [&](uint32_t a, uint32_t b) { return charts[a].height > charts[b].height; });
+        ShelfPacker shelves(size, size, LIGHTMAP_PADDING);
+        bool fits = true;
+        for (uint32_t c = 0; c < (uint32_t)order.size() && fits; c++)
+        {
+            Chart &chart = charts[order[c]];
+            fits = shelves.pack(chart.width, chart.height, chart.x, chart.y);
+        }
+        if (fits)
+            break;
+        if (smallest)
+        {
+            std::cout << "ERROR::LIGHTMAP::CHARTS_DO_NOT_FIT: " << charts.size() << " charts in " << size << " x "
+                      << size << '\n';
+            return 0.0f;
+        }
+    }
+
+    // a vertex on the seam of two charts is one per chart
+    out = MeshBuilder(LIGHTMAPPED_VERTEX_FLOATS);
+    out.submeshes = mesh.submeshes;
+    out.vertices.reserve(mesh.vertices.size() / OBJ_VERTEX_FLOATS * LIGHTMAPPED_VERTEX_FLOATS);
+    out.indices.reserve(mesh.indices.size());
+    std::vector<uint32_t> remap(mesh.vertexCount(), UINT32_MAX), remapChart(mesh.vertexCount(), UINT32_MAX);
+    for (size_t i = 0; i < mesh.indices.size(); i++)
+    {
+        uint32_t index = mesh.indices[i], chartIndex = chartOf[i / 3];
+        if (remapChart[index] != chartIndex)
+        {
+            const Chart &chart = charts[chartIndex];
+            glm::vec3 p = vertexPosition(mesh, index);
+            glm::vec2 local = (glm::vec2(glm::dot(p, chart.axisU), glm::dot(p, chart.axisV)) - chart.low) * scale;
+            // the chart's corner is the center of its first texel
+            glm::vec2 uv = (glm::vec2((float)chart.x, (float)chart.y) + 0.5f + local) / (float)size;
+            const float *vertex = &mesh.vertices[(size_t)index * OBJ_VERTEX_FLOATS];
+            remapChart[index] = chartIndex;
+            remap[index] = (uint32_t)out.vertexCount();
+            out.vertices.insert(out.vertices.end(), vertex, vertex + OBJ_VERTEX_FLOATS);
+            out.vertices.push_back(uv.x);
+            out.vertices.push_back(uv.y);
+        }
+        out.indices.push_back(remap[index]);
+    }
+    return scale;
+}
+
+class LightmapBaker
+{
+  public:
+    static const unsigned int TEXTURE_UNIT = 19;
+    // of the RGBM encoding, the brightest light a texel holds
+    static constexpr float RANGE = 4.0f;
+    // paths per texel of one dispatch, short enough that the driver doesn't time it out
+    static const int SAMPLES_PER_PASS = 16;
+
+    // what deferred_lighting.cpp lights with
+    glm::vec3 sunDirection = glm::normalize(glm::vec3(0.3f, 1.0f, 0.5f));
+    glm::vec3 sunColor = glm::vec3(0.6f);
+    glm::vec3 skyColor = glm::vec3(0.3f);
+    // of the sun's disc, in radians
+    float sunRadius = 0.02f;
+    // of the surfaces the bounce is off
+    float bounceAlbedo = 0.5f;
+    // the rays start this far off the surface along its normal, in world units
+    float bias = 0.02f;
+    float maxDistance = 200.0f;
+    // paths per texel, rounded up to whole passes
+    int samples = 256;
+    // of the last bake()
+    double bakeMs = 0.0;
+    size_t texels = 0;
+
+    LightmapBaker(ShaderCompiler &compiler) : bakeShader(compiler.submitCompute("src/shader_src/lightmap_bake.comp"))
+    {
+    }
+
+    LightmapBaker(const LightmapBaker &) = delete;
+    LightmapBaker &operator=(const LightmapBaker &) = delete;
+
+    // the hierarchy's ray queries, BC3 for the result and a unit past the 19 in use
+    static bool isSupported()
+    {
+        if (!TriangleBvh::isSupported() || !hasGLExtension("GL_EXT_texture_compression_s3tc"))
+            return false;
+        GLint units = 0;
+        glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &units);
+        return units > (GLint)TEXTURE_UNIT;
+    }
+
+    // the key of a bake of the geometry of key geometry with these settings
+    uint64_t key(uint64_t geometry) const
+    {
+        const float settings[] = {sunDirection.x, sunDirection.y, sunDirection.z, sunColor.x,   sunColor.y,
+                                  sunColor.z,     skyColor.x,     skyColor.y,     skyColor.z,   sunRadius,
+                                  bounceAlbedo,   bias,           maxDistance,    (float)samples, RANGE};
+        return fnv1a64(settings, sizeof(settings), geometry);
+    }
+
+    // the image the lightmap of key is the cooked version of, main() loads it by this path
+    static std::string sourcePath(uint64_t key)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.png", (unsigned long long)key);
+        return std::string("res/lightmaps/") + name;
+    }
+
+    // whether the lightmap of key is baked, in the asset pack or on disk
+    static bool exists(uint64_t key)
+    {
+        std::string path = cookedTexturePath(sourcePath(key));
+        std::error_code error;
+        return assetPack.find(path) != NULL || std::filesystem::exists(path, error);
+    }
+
+    // mesh's lighting (LIGHTMAPPED_VERTEX_FLOATS, unwrapped for a size x size atlas) against
+    // bvh, written as the cooked DDS outputPath
+    bool bake(const MeshBuilder &mesh, int size, const TriangleBvh &bvh, const std::string &outputPath)
+    {
+        if (mesh.stride != LIGHTMAPPED_VERTEX_FLOATS || bvh.nodes.empty())
+            return false;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<glm::vec4> positions, normals;
+        rasterize(mesh, size, positions, normals);
+
+        Texture2D positionMap, normalMap, accumulation;
+        positionMap.create(size, size, GL_RGBA32F, 1);
+        positionMap.upload(0, GL_RGBA, GL_FLOAT, positions.data());
+        normalMap.create(size, size, GL_RGBA32F, 1);
+        normalMap.upload(0, GL_RGBA, GL_FLOAT, normals.data());
+        // the sums start at 0, positions is read back into after this
+        std::fill(positions.begin(), positions.end(), glm::vec4(0.0f));
+        accumulation.create(size, size, GL_RGBA32F, 1);
+        accumulation.upload(0, GL_RGBA, GL_FLOAT, positions.data());
+
+        bvh.bind();
+        bakeShader.use();
+        bakeShader.set(bakeShader.uniform("sunDirection"), glm::normalize(sunDirection));
+        bakeShader.set(bakeShader.uniform("sunColor"), sunColor);
+        bakeShader.set(bakeShader.uniform("skyColor"), skyColor);
+        bakeShader.set(bakeShader.uniform("params"), glm::vec4(sunRadius, bias, maxDistance, bounceAlbedo));
+        bakeShader.set(bakeShader.uniform("samples"), SAMPLES_PER_PASS);
+        UniformHandle passLoc = bakeShader.uniform("pass");
+        glBindImageTexture(0, positionMap.ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+        glBindImageTexture(1, normalMap.ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+        glBindImageTexture(2, accumulation.ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+        int passes = std::max(1, (samples + SAMPLES_PER_PASS - 1) / SAMPLES_PER_PASS);
+        for (int pass = 0; pass < passes; pass++)
+        {
+            bakeShader.set(passLoc, (unsigned int)pass);
+            glDispatchCompute((GLuint)(size + 7) / 8, (GLuint)(size + 7) / 8, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            glFlush();
+        }
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+        accumulation.download(0, GL_RGBA, GL_FLOAT, positions.size() * sizeof(glm::vec4), positions.data());
+
+        // the average of each texel's paths, w 1 where there is a surface
+        std::vector<glm::vec4> &light = positions;
+        texels = 0;
+        for (glm::vec4 &texel : light)
+        {
+            texel = texel.w > 0.0f ? glm::vec4(glm::vec3(texel) / texel.w, 1.0f) : glm::vec4(0.0f);
+            texels += texel.w > 0.0f;
+        }
+        dilate(light, size, LIGHTMAP_PADDING);
+
+        std::vector<unsigned char> payload, rgbm;
+        uint32_t levelCount = 0;
+        for (int w = size; levelCount < (uint32_t)LIGHTMAP_LEVELS; levelCount++)
+        {
+            encodeRGBM(light, rgbm);
+            cooker::compressLevel(rgbm.data(), w, w, true, payload);
+            if (w == 1)
+            {
+                levelCount++;
+                break;
+            }
+            light = lightmap::halve(light, w);
+            w = std::max(1, w / 2);
+        }
+        bool written = cooker::writeDDS(outputPath, size, size, true, levelCount, payload);
+        bakeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return written;
+    }
+
+  private:
+    Shader &bakeShader;
+
+    // the world position and normal at the center of every texel a triangle of mesh covers, or
+    // comes within 0.75 texels of so thin charts have texels at all; w 1 where there is one
+    static void rasterize(const MeshBuilder &mesh, int size, std::vector<glm::vec4> &positions,
+                          std::vector<glm::vec4> &normals)
+    {
+        using namespace lightmap;
+        const float REACH = 0.75f;
+        positions.assign((size_t)size * size, glm::vec4(0.0f));
+        normals.assign((size_t)size * size, glm::vec4(0.0f));
+        // the distance of the texel's center to the triangle it took, inside ones win
+        std::vector<float> nearest((size_t)size * size, REACH + 1e-3f);
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            glm::vec3 p[3], n[3];
+            glm::vec2 t[3];
+            for (int k = 0; k < 3; k++)
+            {
+                const float *vertex = &mesh.vertices[(size_t)mesh.indices[i + k] * mesh.stride];
+                p[k] = glm::vec3(vertex[0], vertex[1], vertex[2]);
+                n[k] = glm::vec3(vertex[5], vertex[6], vertex[7]);
+                t[k] = glm::vec2(vertex[OBJ_VERTEX_FLOATS], vertex[OBJ_VERTEX_FLOATS + 1]) * (float)size;
+            }
+            float area = (t[1].x - t[0].x) * (t[2].y - t[0].y) - (t[2].x - t[0].x) * (t[1].y - t[0].y);
+            if (std::abs(area) < 1e-12f)
+                continue;
+            glm::vec2 low = glm::min(t[0], glm::min(t[1], t[2])) - REACH;
+            glm::vec2 high = glm::max(t[0], glm::max(t[1], t[2])) + REACH;
+            int x0 = std::max(0, (int)std::floor(low.x)), y0 = std::max(0, (int)std::floor(low.y));
+            int x1 = std::min(size - 1, (int)std::floor(high.x)), y1 = std::min(size - 1, (int)std::floor(high.y));
+            for (int y = y0; y <= y1; y++)
+            {
+                for (int x = x0; x <= x1; x++)
+                {
+                    glm::vec2 center((float)x + 0.5f, (float)y + 0.5f);
+                    glm::vec3 b = barycentric(center, t[0], t[1], t[2], area);
+                    float distance = 0.0f;
+                    if (b.x < 0.0f || b.y < 0.0f || b.z < 0.0f)
+                    {
+                        // onto the nearest edge
+                        distance = 1e30f;
+                        for (int e = 0; e < 3; e++)
+                        {
+                            float along;
+                            glm::vec2 q = nearestOnSegment(center, t[e], t[(e + 1) % 3], along);
+                            float d = glm::length(center - q);
+                            if (d < distance)
+                            {
+                                distance = d;
+                                b = glm::vec3(0.0f);
+                                b[e] = 1.0f - along;
+                                b[(e + 1) % 3] = along;
+                            }
+                        }
+                    }
+                    size_t texel = (size_t)y * size + x;
+                    if (distance >= nearest[texel])
+                        continue;
+                    nearest[texel] = distance;
+                    positions[texel] = glm::vec4(p[0] * b.x + p[1] * b.y + p[2] * b.z, 1.0f);
+                    glm::vec3 normal = n[0] * b.x + n[1] * b.y + n[2] * b.z;
+                    float length = glm::length(normal);
+                    normals[texel] = glm::vec4(length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
+                }
+            }
+        }
+    }
+
+    // passes rings of the empty texels next to ones with light take the average of those
+    static void dilate(std::vector<glm::vec4> &light, int size, int passes)
+    {
+        std::vector<glm::vec4> previous;
+        for (int pass = 0; pass < passes; pass++)
+        {
+            previous = light;
+            for (int y = 0; y < size; y++)
+            {
+                for (int x = 0; x < size; x++)
+                {
+                    if (previous[(size_t)y * size + x].w > 0.0f)
+                        continue;
+                    glm::vec4 sum(0.0f);
+                    const int offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+                    for (const int *offset : offsets)
+                    {
+                        int nx = x + offset[0], ny = y + offset[1];
+                        if (nx >= 0 && ny >= 0 && nx < size && ny < size && previous[(size_t)ny * size + nx].w > 0.0f)
+                            sum += glm::vec4(glm::vec3(previous[(size_t)ny * size + nx]), 1.0f);
+                    }
+                    if (sum.w > 0.0f)
+                        light[(size_t)y * size + x] = glm::vec4(glm::vec3(sum) / sum.w, 1.0f);
+                }
+            }
+        }
+    }
+
+    // rgb over a shared multiplier in a, which is rounded up so the rgb never clip
+    static void encodeRGBM(const std::vector<glm::vec4> &light, std::vector<unsigned char> &out)
+    {
+        out.resize(light.size() * 4);
+        for (size_t i = 0; i < light.size(); i++)
+        {
+            glm::vec3 color = glm::max(glm::vec3(light[i]), glm::vec3(0.0f)) / RANGE;
+            float m = std::min(std::max(std::max(color.r, std::max(color.g, color.b)), 1e-6f), 1.0f);
+            m = std::ceil(m * 255.0f) / 255.0f;
+            glm::vec3 scaled = glm::min(color / m, glm::vec3(1.0f));
+            out[i * 4] = (unsigned char)std::lround(scaled.r * 255.0f);
+            out[i * 4 + 1] = (unsigned char)std::lround(scaled.g * 255.0f);
+            out[i * 4 + 2] = (unsigned char)std::lround(scaled.b * 255.0f);
+            out[i * 4 + 3] = (unsigned char)std::lround(m * 255.0f);
+        }
+    }
+};
+
+#endif
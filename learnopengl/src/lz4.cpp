@@ -0,0 +1,139 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// LZ4 block format (no frame header), compatible with LZ4_decompress_safe. The compressor
+// is the greedy single hash table kind, fine for the offline packer; the decompressor
+// checks every length against both buffers, so a corrupt block fails instead of overrunning.
+
+namespace lz4
+{
+inline void writeLength(std::vector<unsigned char> &out, size_t length)
+{
+    while (length >= 255)
+    {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back((unsigned char)length);
+}
+
+// one sequence: token, literals, then the match unless this is the last one
+inline void writeSequence(std::vector<unsigned char> &out, const unsigned char *literals, size_t literalCount,
+                          size_t offset, size_t matchLength)
+{
+    size_t token = out.size();
+    out.push_back((unsigned char)(std::min<size_t>(literalCount, 15) << 4));
+    if (literalCount >= 15)
+        writeLength(out, literalCount - 15);
+    out.insert(out.end(), literals, literals + literalCount);
+    if (matchLength == 0)
+        return;
+    out.push_back((unsigned char)(offset & 0xFF));
+    out.push_back((unsigned char)(offset >> 8));
+    size_t extra = matchLength - 4;
+    out[token] |= (unsigned char)std::min<size_t>(extra, 15);
+    if (extra >= 15)
+        writeLength(out, extra - 15);
+}
+
+inline bool readLength(const unsigned char *src, size_t size, size_t &in, size_t &length)
+{
+    unsigned char byte;
+    do
+    {
+        if (in >= size)
+            return false;
+        byte = src[in++];
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+} // namespace lz4
+
+inline std::vector<unsigned char> lz4Compress(const unsigned char *src, size_t size)
+{
+    const int HASH_BITS = 12;
+    const size_t NONE = SIZE_MAX;
+    std::vector<unsigned char> out;
+    out.reserve(size + size / 255 + 16);
+    std::vector<size_t> table((size_t)1 << HASH_BITS, NONE);
+
+    // the format wants the last 5 bytes as literals and no match starting in the last 12
+    size_t matchStartLimit = size > 12 ? size - 12 : 0;
+    size_t matchEndLimit = size > 5 ? size - 5 : 0;
+    size_t anchor = 0, pos = 0;
+    while (pos < matchStartLimit)
+    {
+        uint32_t sequence;
+        std::memcpy(&sequence, src + pos, 4);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        size_t candidate = table[hash];
+        table[hash] = pos;
+        if (candidate == NONE || pos - candidate > 65535 || std::memcmp(src + candidate, src + pos, 4) != 0)
+        {
+            pos++;
+            continue;
+        }
+        size_t length = 4;
+        while (pos + length < matchEndLimit && src[candidate + length] == src[pos + length])
+            length++;
+        lz4::writeSequence(out, src + anchor, pos - anchor, pos - candidate, length);
+        pos += length;
+        anchor = pos;
+    }
+    lz4::writeSequence(out, src + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+// the most a block of srcSize bytes can decompress to: every byte of a match length adds 255,
+// nothing else comes close
+inline uint64_t lz4MaxDecompressedSize(uint64_t srcSize)
+{
+    return srcSize * 255;
+}
+
+// false when the block is corrupt or doesn't decompress to exactly dstSize bytes
+inline bool lz4Decompress(const unsigned char *src, size_t srcSize, unsigned char *dst, size_t dstSize)
+{
+    size_t in = 0, out = 0;
+    while (in < srcSize)
+    {
+        unsigned char token = src[in++];
+        size_t literals = token >> 4;
+        if (literals == 15 && !lz4::readLength(src, srcSize, in, literals))
+            return false;
+        if (literals > srcSize - in || literals > dstSize - out)
+            return false;
+        std::memcpy(dst + out, src + in, literals);
+        in += literals;
+        out += literals;
+        // the last sequence has no match
+        if (in == srcSize)
+            break;
+
+        if (srcSize - in < 2)
+            return false;
+        size_t offset = (size_t)src[in] | ((size_t)src[in + 1] << 8);
+        in += 2;
+        if (offset == 0 || offset > out)
+            return false;
+        size_t length = token & 15;
+        if (length == 15 && !lz4::readLength(src, srcSize, in, length))
+            return false;
+        length += 4;
+        if (length > dstSize - out)
+            return false;
+        // byte by byte, the match may overlap what it writes
+        for (size_t i = 0; i < length; i++, out++)
+            dst[out] = dst[out - offset];
+    }
+    return out == dstSize;
+}
+
+#endif
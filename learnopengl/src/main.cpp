@@ -1,3 +1,6 @@
+// GLM runs the operators of its aligned types on SSE, used by the AoS path of batch_math.cpp
+#define GLM_FORCE_INTRINSICS
+
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
 
@@ -5,16 +8,152 @@
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
+#include "batch_math.cpp"
+#include "benchmark.cpp"
+#include "asset_pack.cpp"
+#include "asset_prefetch.cpp"
+#include "asset_tasks.cpp"
+#include "auto_exposure.cpp"
+#include "alloc_tracker.cpp"
+#include "ambient_occlusion.cpp"
+#include "animated_instances.cpp"
+#include "antialiasing.cpp"
+#include "bindless_textures.cpp"
+#include "bvh.cpp"
 #include "camera.cpp"
+#include "cell_portals.cpp"
+#include "compact_instances.cpp"
+#include "cpu_profiler.cpp"
+#include "decal_set.cpp"
+#include "deferred_lighting.cpp"
+#include "deletion_queue.cpp"
+#include "depth_prepass.cpp"
+#include "dynamic_resolution.cpp"
+#include "entity_store.cpp"
+#include "environment_maps.cpp"
+#include "frame_capture.cpp"
+#include "frame_data.cpp"
+#include "file_watcher.cpp"
+#include "floating_origin.cpp"
+#include "frame_arena.cpp"
+#include "frame_pacing.cpp"
+#include "frustum_culler.cpp"
+#include "gbuffer.cpp"
+#include "gl_call_counter.cpp"
+#include "gl_context.cpp"
+#include "gl_debug.cpp"
+#include "gl_state.cpp"
+#include "gl_trace.cpp"
+#include "geometry_pool.cpp"
+#include "gpu_memory.cpp"
+#include "gpu_profiler.cpp"
+#include "gpu_texture_compressor.cpp"
+#include "gltf_loader.cpp"
+#include "hitch_detector.cpp"
+#include "hiz_buffer.cpp"
+#include "hlod_proxies.cpp"
+#include "hud.cpp"
+#include "image_decoder.cpp"
+#include "impostors.cpp"
+#include "input.cpp"
+#include "indirect_renderer.cpp"
+#include "job_system.cpp"
+#include "light_clusters.cpp"
+#include "light_set.cpp"
+#include "lightmap_baker.cpp"
+#include "material_table.cpp"
+#include "instance_buffer.cpp"
+#include "mesh.cpp"
+#include "mesh_codec.cpp"
+#include "mesh_cooker.cpp"
+#include "mesh_file.cpp"
+#include "micro_benchmarks.cpp"
+#include "multi_view.cpp"
+#include "ocean.cpp"
+#include "oit.cpp"
+#include "overdraw.cpp"
+#include "particles.cpp"
+#include "path_calibration.cpp"
+#include "picking.cpp"
+#include "pipeline_state.cpp"
+#include "pipeline_warmup.cpp"
+#include "post_process.cpp"
+#include "procedural_scatter.cpp"
+#include "quality_governor.cpp"
+#include "quadtree_allocator.cpp"
+#include "ray_traced_shadows.cpp"
+#include "redraw_scheduler.cpp"
+#include "regression.cpp"
+#include "rigid_bodies.cpp"
+#include "render_queue.cpp"
+#include "render_stats.cpp"
+#include "render_thread.cpp"
+#include "render_target.cpp"
+#include "resize_manager.cpp"
+#include "ring_buffer.cpp"
+#include "sampler_cache.cpp"
+#include "scene_graph.cpp"
+#include "scene_snapshot.cpp"
+#include "screen_space_reflections.cpp"
+#include "sdf_text.cpp"
+#include "sprite_batch.cpp"
+#include "static_batches.cpp"
+#include "stereo.cpp"
+#include "telemetry_server.cpp"
+#include "texture.cpp"
+#include "texture_atlas.cpp"
+#include "texture_cache.cpp"
+#include "texture_cooker.cpp"
+#include "texture_loader.cpp"
+#include "texture_residency.cpp"
+#include "transform_system.cpp"
+#include "triangle_bvh.cpp"
+#include "triangle_filter.cpp"
+#include "upload_context.cpp"
+#include "variable_rate_shading.cpp"
+#include "vertex_animation.cpp"
+#include "vertex_puller.cpp"
+#include "virtual_texture.cpp"
+#include "volumetric_fog.cpp"
+#include "voxel_streaming.cpp"
+#include "voxel_world.cpp"
+#include "world_partition.cpp"
+#include "shadow_maps.cpp"
+#include "skinning.cpp"
+#include "software_occlusion.cpp"
+#include "simulation.cpp"
+#include "single_pass_downsampler.cpp"
 #include "shader.cpp"
+#include "terrain.cpp"
+#include "shader_compiler.cpp"
+#include "shader_cooker.cpp"
+#include "shader_variants.cpp"
+#include "shadow_atlas.cpp"
+#include "startup_timeline.cpp"
+#include "stress_scene.cpp"
+#include "temporal_aa.cpp"
 #include "stb_image.h"
 
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 // Functions declarations
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
+bool commitWindowSize();
 void processInput(GLFWwindow *window);
-void mouse_callback(GLFWwindow *window, double xpos, double ypos);
+void processCursor(double xpos, double ypos);
+void runScene(GLFWwindow *window, JobSystem &jobs);
+void prefetchStartupAssets();
+void finishStartup();
+int runRegression(GLFWwindow *window, JobSystem &jobs);
+void selectRendererPath(GLFWwindow *window, JobSystem &jobs, VsyncMode vsync);
+GLADloadproc glExtensionLoader();
 
 // Viewport dimensions
 #define WIDTH 600
@@ -26,9 +165,27 @@ float aspectRatio = float(WIDTH) / float(HEIGHT);
 float zNear = 0.1f;
 float zFar = 100.0f;
 
+// the framebuffer size the frames render at, window resizes are committed once they settle
+ResizeManager windowSize;
+
 // Camera Positions
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
+// Window input goes through here, recorded with --record <file> and replayed with --replay <file>
+InputSystem input;
+std::string inputRecordPath, inputReplayPath;
+// unaccelerated mouse motion where GLFW has it, --no-raw-mouse leaves the desktop's curve on
+bool rawMouseMotion = true;
+// --debug-view adds a camera behind and above the main one in an inset, --debug-window shows
+// it in a second window instead (see multi_view.cpp)
+bool debugView = false;
+bool debugWindow = false;
+// --stereo draws both eyes of the camera in one pass and shows them side by side (see stereo.cpp)
+bool stereoRendering = false;
+// --vrs shades the low contrast, fast moving and, with --stereo, outer parts of the scene at
+// coarser rates with GL_NV_shading_rate_image (see variable_rate_shading.cpp)
+bool variableRateShading = false;
+
 // Keeping track of time
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
@@ -36,20 +193,892 @@ float lastFrame = 0.0f;
 // Is it the first time capturing the mouse
 bool firstMouse = true;
 
-int main()
+// Draw all cubes with one instanced call instead of one draw per cube
+bool instancedRendering = true;
+// Spin the instanced cubes in the vertex shader from parameters uploaded once instead of
+// simulating them and uploading their matrices every frame, --gpu-animation (see animated_instances.cpp)
+bool gpuAnimation = false;
+// Give the instanced draws 24 byte transforms kept on the GPU and updated where they changed, and
+// a 4 byte index per instance instead of a matrix and a layer, --compact-instances (see compact_instances.cpp)
+bool compactInstances = false;
+// Draw all cubes with one multi-draw indirect call out of a shared geometry pool when supported,
+// takes precedence over the instanced path
+bool indirectRendering = true;
+// Let a compute pass frustum cull the indirect draws on the GPU
+bool gpuCulling = true;
+// Cull and draw the indirect cubes per meshlet (clusters of up to 124 triangles, see meshlets.cpp)
+// instead of per cube, turned on with --meshlets; needs the GPU cull pass
+bool meshletRendering = false;
+// Drop the back facing, off screen and sub-pixel triangles of the visible meshlets in a compute
+// pass before they are drawn (see triangle_filter.cpp), with --triangle-filter; implies --meshlets
+bool triangleFiltering = false;
+// Skip cubes hidden behind last frame's depth: a Hi-Z pyramid in the GPU cull pass,
+// occlusion queries on the per-draw path
+bool occlusionCulling = true;
+// Rasterize the boxes of the largest visible cubes into a small depth buffer on the CPU and drop
+// the cubes behind them before the instanced and per-draw paths submit anything,
+// --software-occlusion (see software_occlusion.cpp)
+bool softwareOcclusion = false;
+// Let the per-draw occlusion queries gate the draws of the hidden cubes on the GPU with
+// conditional rendering instead of skipping them, and only recheck the visible ones every few
+// frames, --conditional-render (see OcclusionQueries)
+bool conditionalRendering = false;
+// Build the Hi-Z pyramid and the mip chains of textures loaded on the GL thread with one compute
+// dispatch each instead of one per level or glGenerateMipmap, --no-single-pass-mips turns it off
+// (see single_pass_downsampler.cpp)
+bool singlePassMips = true;
+// Frustum cull the CPU paths and their shadow casters through a bounding volume hierarchy
+// over the cube spheres, refit as the cubes spin, instead of testing every sphere; it also
+// picks the cube in the middle of the view (see bvh.cpp). --no-bvh tests them all
+bool bvhCulling = true;
+// The camera is a sphere of this radius that stops at the cube spheres in the hierarchy and
+// slides along them instead of moving through, --camera-collision
+bool cameraCollision = false;
+float cameraRadius = 0.3f;
+// Bake the cubes that don't spin into merged per chunk and material meshes at load, so the
+// per-draw path (--per-draw turns off the indirect and instanced ones) draws static scenery in
+// a few draws, --static-batching (see static_batches.cpp)
+bool staticBatching = false;
+// Build a binned surface area heuristic hierarchy over the triangles of the cubes that don't
+// spin at load, on the job threads, for the compute shaders' ray queries (see triangle_bvh.cpp),
+// --ray-bvh, needs GL 4.3
+bool rayBvh = false;
+// Light the static batches from a lightmap instead of leaving them unlit, --lightmap: their merged
+// mesh is unwrapped at --lightmap-texels <n> per world unit into a --lightmap-size <n> atlas and
+// path traced against the ray hierarchy with --lightmap-samples <n> paths per texel, once per
+// geometry and settings, then read back compressed from res/lightmaps/cooked or the asset pack
+// (see lightmap_baker.cpp). Turns on --static-batching and --ray-bvh, needs GL 4.3
+bool lightmapping = false;
+float lightmapTexels = 8.0f;
+int lightmapSize = 2048;
+int lightmapSamples = 256;
+// Pick the cube in the middle of the view (under the cursor while it isn't captured) on the GPU
+// too, turned on with --gpu-pick: the cubes near it are drawn into a small ID target that is
+// read back through a pixel pack buffer a frame or more later (see picking.cpp)
+bool gpuPicking = false;
+// Let the instanced path fetch the cube's vertices, indices and instance data from storage buffers
+// in the vertex shader (vertex_pulling.vs) instead of through vertex attributes, needs GL 4.3
+bool vertexPulling = true;
+// Sample the instanced cubes through bindless handles when GL_ARB_bindless_texture is there
+bool bindlessRendering = true;
+// The cube fragment shaders read their material (layer, the layer blended over it and how much,
+// a tint) from one storage buffer indexed by the instance's layer (see material_table.cpp)
+// instead of uniforms, needs GL 4.3; --no-material-table goes back to the uniforms
+bool materialTable = true;
+// Lay down the depth of the indirect and instanced cubes in a depth only pass first, so they are
+// shaded once per pixel; auto keeps it on while the measured overdraw is high, set with
+// --prepass off|on|auto
+DepthPrepassMode depthPrepassMode = PREPASS_AUTO;
+// Shade the indirect and instanced cubes deferred, turned on with --deferred: the materials go
+// to a G-buffer of --gbuffer compact|full precision, then the sun and the point lights
+// are added as light volumes (see deferred_lighting.cpp). Not with a scene or bindless textures
+bool deferredShading = false;
+GBufferPrecision gbufferPrecision = GBUFFER_COMPACT;
+// Or light them forward from per-cluster light lists a compute pass builds every frame
+// (see light_clusters.cpp), turned on with --clustered, needs GL 4.3; --deferred comes first
+bool clusteredShading = false;
+// point lights of either path, set with --lights <n>
+int lightCount = 32;
+// projected decals of the clustered path, binned with its lights (see decal_set.cpp), set with --decals <n>
+int decalCount = 0;
+// Shadow the sun of either path with cascaded shadow maps of --shadow-size <n> texels, turned on
+// with --shadows; the casters are the indirect or instanced cubes (see shadow_maps.cpp)
+bool sunShadows = false;
+int shadowMapSize = 2048;
+// Shadow the deferred path's sun by rays traced at half resolution against the --ray-bvh
+// hierarchy of the static cubes instead, no cascades are drawn, turned on with --rt-shadows
+// (see ray_traced_shadows.cpp)
+bool rayTracedShadows = false;
+// Shadow the clustered point lights that cover the most of the screen from pages of one depth
+// atlas, drawn again only when their light or a caster in view moved, turned on with
+// --point-shadows (see shadow_atlas.cpp); the atlas is --point-shadow-size texels square and
+// at most --point-shadow-faces cube faces are drawn per frame
+bool pointShadows = false;
+int pointShadowAtlasSize = 4096;
+int pointShadowFaces = 6;
+// Fog the clustered path through a froxel volume of the light clusters' frustum grid, lit and
+// integrated by compute passes every frame and fetched once per pixel (see volumetric_fog.cpp),
+// turned on with --fog <density>
+bool volumetricFog = false;
+float fogDensity = 0.02f;
+
+// A fountain of up to --particles <n> particles among the cubes, emitted, simulated and drawn
+// by compute passes and an indirect draw without the CPU touching them (see particles.cpp),
+// needs GL 4.3
+unsigned int particleCount = 0;
+
+// Draw the frame into an RGBA16F target and bring it to the window through the post-processing
+// graph (see post_process.cpp): a bloom at half and quarter resolution and ACES tone mapping,
+// turned on with --post, --bloom <strength> and --exposure <scale> set the composite
+bool postProcessing = false;
+float bloomStrength = 0.3f;
+float exposure = 1.0f;
+// Darken the frame by a half resolution screen space ambient occlusion at the head of the
+// post-processing graph (see ambient_occlusion.cpp), turned on with --ssao, needs --post
+bool ambientOcclusion = false;
+// Reflect what is on screen by rays traced over the Hi-Z depth pyramid at half resolution, after
+// the ambient occlusion in the post-processing graph (see screen_space_reflections.cpp), turned
+// on with --ssr, needs --post and GL 4.3; misses keep the environment's reflection
+bool screenSpaceReflections = false;
+// Expose the frame by a luminance histogram the GPU builds of a quarter resolution copy and
+// adapts to over time (see auto_exposure.cpp), turned on with --auto-exposure, needs --post and
+// GL 4.3; --exposure then scales what it measured
+bool autoExposure = false;
+// Light the clustered and deferred paths by a procedural sky's prefiltered environment instead of
+// a constant ambient and draw the sky where nothing else is, turned on with --environment, the
+// maps are cached under cache/environment (see environment_maps.cpp)
+bool environmentLighting = false;
+// Draw the 3D scene at a fraction of the window's size that holds --target-ms GPU milliseconds per
+// frame and upscale it to the window, --upscale bilinear|sharpen, turned on with --dynamic-resolution
+// (see dynamic_resolution.cpp)
+bool dynamicResolution = false;
+float targetFrameTime = 16.0f;
+UpscaleFilter upscaleFilter = UPSCALE_SHARPEN;
+// Hold --target-ms by turning down the anisotropy, bloom, particles, shadow cascades and levels of detail
+// while the GPU is over it, the simulation rate and the draw distance while the CPU is,
+// --quality-governor; the GPU side waits for the dynamic resolution to reach its smallest
+// scale first (see quality_governor.cpp)
+bool qualityGovernor = false;
+// Jitter the projection and accumulate the frames into a history at the window's size with
+// motion vectors of the moving cubes, turned on with --taa, needs GL 4.3 (see temporal_aa.cpp);
+// it takes over the upscale of --dynamic-resolution
+bool temporalAA = false;
+// Anti-alias the frame with --aa off|msaa2x|msaa4x|msaa8x|fxaa, F2 switches to the next one while
+// running (see antialiasing.cpp); not with the TAA, and MSAA not on the deferred path.
+// The benchmark splits its frames between all of them with --benchmark-aa and reports each one's
+// GPU frame time
+AntiAliasingMode antiAliasing = AA_OFF;
+bool benchmarkAntiAliasing = false;
+
+// Let the GPU cull pass draw the simplified levels of detail of the cooked meshes (--cook) from
+// the distance the simplification error of one covers at most this many pixels, 0 keeps the
+// full meshes; --lod-threshold <pixels>
+float lodThreshold = 1.0f;
+
+// Draw the instanced cubes farther than this from the camera as octahedral impostors, quads
+// textured from an atlas baked once, 0 keeps the meshes; --impostors <distance> (see impostors.cpp)
+float impostorDistance = 0.0f;
+// A voxel world of n x n columns of two 32^3 chunks under the cubes, greedy meshed on the job
+// system and drawn by the indirect path, --voxels <n>; E digs where the camera looks, Q fills
+// (see voxel_world.cpp)
+int voxelChunks = 0;
+// Stream the voxel world around the camera instead: the n x n chunks follow it over unbounded
+// hills, generated or loaded from cache/voxels on a worker thread, the far ones meshed coarser,
+// with up to this many MB of chunks that left kept in memory; --voxel-stream <MB>
+// (see voxel_streaming.cpp)
+int voxelCacheMB = 0;
+// Replace the cubes with an unbounded world of them in cells streamed around the camera and
+// where it is heading, the ones within n cells kept, read from cache/world or generated there
+// on a worker thread and installed within per-frame time and upload budgets; --world <n>
+// (see world_partition.cpp)
+int worldRadius = 0;
+// Draw the --world cubes relative to an origin that follows the camera, their positions kept in
+// double, so nothing jitters however far it goes; not with terrain or voxels, which stay at 0;
+// --floating-origin (see floating_origin.cpp)
+bool floatingOrigin = false;
+// Past the --world cells with cubes, keep the cells out to n of the camera's as one merged and
+// simplified proxy each, a draw per material in place of their cubes; --hlod <n>, not in
+// render thread mode (see hlod_proxies.cpp)
+int hlodRadius = 0;
+
+// Keep the camera orientation as a quaternion, mouse deltas are applied once per frame
+bool quaternionCamera = true;
+
+// Reversed-Z depth with an infinite far plane into a float depth buffer, needs GL 4.5 glClipControl
+bool reversedZ = true;
+
+// The cubes are simulated at a fixed rate and drawn interpolated between steps,
+// on a thread of their own with threadedSimulation
+double simulationHz = 60.0;
+bool threadedSimulation = false;
+// The cubes fall as rigid bodies onto a ground below them and onto each other instead of
+// spinning in place, --physics (see rigid_bodies.cpp)
+bool rigidBodyPhysics = false;
+
+// Newest core profile context asked for, set with --gl <major>.<minor>, older ones are tried
+// when the driver can't make it (see gl_context.cpp)
+GLContextVersion glVersionLimit = {4, 6};
+
+// Swap interval, frame limiter and latency mode, set with --vsync off|on|adaptive, --fps <n>,
+// --low-latency and --frames-in-flight <n>, the frames the driver may queue ahead of the GPU
+FramePacer framePacer;
+// Frames drawn only when input, animation, loads or a resize ask for them, --on-demand; with
+// --idle-fps <n> they come at n per second once there was no input for --idle-after <seconds>
+// (see redraw_scheduler.cpp). Not in render thread mode, benchmarks or input replays.
+RedrawScheduler redraw;
+
+// Record the per-draw cube path on this thread and replay it on a render thread owning the context,
+// only used when the indirect and instanced paths are off and there is no scene
+bool renderThreadMode = false;
+
+// Worker threads of the job system, --job-threads <n>, 0 for one per hardware thread, optionally
+// pinned to a core each with --pin-jobs, those of the main thread's NUMA node first
+unsigned int jobThreads = 0;
+bool pinJobThreads = false;
+
+// Back the large frame arena regions and component arrays with 2 MB (1 GB for blocks that big)
+// pages and ask for huge pages on the asset pack's mapping, --huge-pages (see huge_pages.cpp).
+// Linux takes them from vm.nr_hugepages and falls back to transparent huge pages, Windows needs
+// the "Lock pages in memory" privilege
+bool hugePageArenas = false;
+
+// Build the cube and scene shader permutations as separate vertex and fragment programs put together
+// in program pipelines, where GL 4.1 or GL_ARB_separate_shader_objects is there. The render thread
+// records raw program IDs, so it keeps linked programs.
+bool separablePrograms = true;
+
+// Load the compute programs from the SPIR-V modules cooked by --spirv (GL 4.6 or GL_ARB_gl_spirv)
+// instead of compiling their GLSL, with the values fixed at startup as specialization constants
+bool spirvShaders = true;
+
+// Rebuild a program when one of its files in src/shader_src is saved, swapped in once it links,
+// --no-hot-reload turns it off and benchmarks never watch
+bool shaderHotReload = true;
+
+// Decoded source textures and their mip chains are kept in cache/textures and mapped on the
+// next launch (see texture_cache.cpp), --no-texture-cache decodes every time and
+// --compress-texture-cache stores them BC1/BC3 compressed when the driver samples S3TC
+bool textureCacheEnabled = true;
+bool compressTextureCache = false;
+// Block compress the textures baked at run time, the impostor atlas, on the GPU once they are
+// made, --compress-generated (see gpu_texture_compressor.cpp)
+bool compressGenerated = false;
+// The most anisotropic filtering any sampler gets, --anisotropy 1|2|4|8|16, 1 turns it off; the
+// quality governor halves it on a GPU that can't keep up (see sampler_cache.cpp)
+float anisotropy = 8.0f;
+// Fill whole textures and build their mipmaps on a second GL context shared with the window's,
+// on a thread of its own, --upload-thread (see upload_context.cpp); not in render thread mode
+bool uploadThread = false;
+// Load the material layers as one coroutine that reads and decodes them all at once and uploads
+// each as it arrives, --coroutine-loading (see asset_tasks.cpp); not in render thread mode
+bool coroutineLoading = false;
+// Record the program, vertex layout and depth/blend state combinations drawn into
+// cache/pipelines.bin and draw the ones of earlier runs off screen while loading, so the
+// driver's first-use work never lands in a real frame, --pipeline-warmup (see
+// pipeline_warmup.cpp); not in render thread mode
+bool warmPipelines = false;
+
+// Heap allocations by tag, printed at exit with --alloc-stats (see alloc_tracker.cpp).
+// --assert-no-alloc flags every allocation of the main thread once the loop is in its
+// steady state: the cold start is over and STEADY_STATE_FRAMES more frames went by
+bool printAllocations = false;
+bool assertNoAllocations = false;
+const int STEADY_STATE_FRAMES = 240;
+
+// GPU time per pass, printed every few seconds with --gpu-profile; --pipeline-stats adds the
+// shader invocations and primitives of each pass where the driver has the queries
+bool printGpuProfile = false;
+bool pipelineStatistics = false;
+// The profiler's passes as debug groups and the textures and programs labeled by their files in
+// GPU captures (see gl_debug.cpp), on in debug builds, --gl-markers turns them on in release ones
+bool debugMarkers = GL_DEBUG;
+// Every GL call counted and timed per entry point (see gl_call_counter.cpp), F4 toggles it,
+// --gl-calls starts with it on and prints the last frame's calls every few seconds; not in
+// render thread mode
+bool countGLCalls = false;
+bool printGLCalls = false;
+// What textures, render targets and buffers take of video memory and what the driver says is
+// free (see gpu_memory.cpp), in the HUD; --gpu-memory prints it by category every few seconds
+bool printGpuMemory = false;
+// A frame over --hitch-threshold times the median (2 by default) has the last seconds of CPU and
+// GPU zones and frame counters written to hitch_<n>.json (see hitch_detector.cpp), with --hitches
+bool detectHitches = false;
+float hitchThreshold = 2.0f;
+// Frame times, counters, memory and the CPU and GPU zones streamed to a client over TCP while one
+// is connected (see telemetry_server.cpp), --telemetry <port>; --telemetry-connect <host:port>
+// is the client, the stream goes to --telemetry-trace <file> (telemetry.json) as a trace for
+// chrome://tracing / Perfetto, for --telemetry-frames <n> frames or until the app closes
+int telemetryPort = 0;
+std::string telemetryAddress;
+std::string telemetryTracePath = "telemetry.json";
+int telemetryFrames = 0;
+// The first frames' GL calls written to a file (see gl_trace.cpp), --gl-trace <file>, with
+// --gl-trace-frames <n> of them; --replay-gl <file> plays one back without the app and times it.
+// Tracing runs everything on the main thread and leaves out extensions and program binaries.
+std::string glTracePath;
+int glTraceFrames = 10;
+std::string glReplayPath;
+
+// Frame time graph and renderer counters over the frame, F1 toggles it, --no-hud starts without
+bool showHud = true;
+
+// How many fragments the instanced cubes put on each pixel as a heatmap in place of the frame
+// (see overdraw.cpp), --overdraw builds it and starts with it shown, F3 toggles it
+bool overdrawView = false;
+bool showOverdraw = false;
+
+// A field of moving sprites over the frame, --sprites <count>, to measure the sprite batcher
+int spriteCount = 0;
+// The index of every CPU-culled visible cube over it in distance field text, --labels
+bool showLabels = false;
+const size_t MAX_LABELS = 4096;
+
+// Benchmark mode, --benchmark <frames>: a hidden window, the frame drawn offscreen at
+// --benchmark-size <w>x<h>, the camera flown along --camera-path <file> (an orbit by default)
+// at a fixed 60 Hz step, no vsync, frame times written to <prefix>.csv and <prefix>.json
+// of --benchmark-out <prefix>
+int benchmarkFrames = 0;
+int benchmarkWidth = 1280, benchmarkHeight = 720;
+std::string cameraPathFile;
+std::string benchmarkOutput = "benchmark";
+// frames left out once the textures are in, --benchmark-warmup <frames>
+int benchmarkWarmup = 0;
+// averages of the last benchmark run
+BenchmarkResult benchmarkResult;
+// A table of what the programs built at load cost, --shader-stats: compile and link times,
+// active uniforms and attributes, and the instruction and register counts where the driver's
+// program binary has them (see shader_stats.cpp). The benchmarks write every program's to
+// <prefix>.shaders.csv either way
+bool shaderStats = false;
+
+// Regression suite, --regression <baseline.json>: benchmarks every scene, renderer path and
+// resolution of runRegression() and compares against the baseline, or writes it when there is
+// none yet or with --update-baseline. --regression-threshold <fraction> sets the allowed slowdown.
+std::string regressionBaseline;
+bool updateRegressionBaseline = false;
+float regressionThreshold = 0.1f;
+// Start on the renderer path that was the fastest on this GPU and driver, racing them all in short
+// offscreen benchmarks the first time (see path_calibration.cpp). On when started without
+// arguments, --auto-path turns it on next to others and --calibrate races them again
+bool autoPath = false;
+bool recalibratePath = false;
+
+// Procedural scene of many cubes in place of the ten below, --stress <count> with
+// --stress-layout grid|sphere|clusters, --stress-static, --stress-materials <n>, --stress-textures <n>
+// and --stress-seed <n>
+bool stressScene = false;
+StressSceneSettings stressSettings;
+
+// Chrome trace of the CPU zones written at exit, set with --trace <file.json>
+std::string tracePath;
+
+// Video of the frames as they are shown (or as the benchmark draws them), --record-video <file.y4m>
+// at --record-fps <n>, read back asynchronously and encoded on a thread of its own
+std::string videoPath;
+int recordFps = 60;
+
+// Cold start phases up to the first frame and the last texture, printed with --startup
+// and written as a Chrome trace with --startup-trace <file.json>
+bool printStartup = false;
+std::string startupTracePath;
+// Runtime ready scene state (the cubes' transforms, hierarchy, entities and static batches)
+// mapped from --scene-snapshot <file> instead of being built, and written there when it is
+// missing or was built with other settings (see scene_snapshot.cpp); not with --world
+std::string sceneSnapshotPath;
+
+// glTF scene drawn next to the cubes, set with --scene <file.gltf|file.glb>
+std::string scenePath;
+// Cells and portals of an indoor level, --cells <file>: the CPU paths only cull and draw the
+// cubes in the cells seen through the portals (see cell_portals.cpp), --bake-pvs <file> writes
+// the potentially visible set they are limited to
+std::string cellsPath;
+// Its skins are played on the GPU (see skinning.cpp) as --skinned-instances <n> copies each,
+// skinned once per frame by a compute pass with --pre-skinning instead of in every vertex
+// shader that draws them; needs GL 4.3
+unsigned int skinnedInstances = 1;
+bool preSkinning = false;
+// and as a crowd of --crowd <n> more copies each, posed from vertex animation textures baked
+// from its clips once, drawn instanced with no skinning at all (see vertex_animation.cpp)
+unsigned int crowdSize = 0;
+// Its blended materials are composited order-independently (see oit.cpp), --sorted-transparency
+// draws them back to front instead, the reference the approximation is compared against
+bool weightedTransparency = true;
+// Its textures are streamed within --texture-budget <MiB> of video memory, the levels each one
+// needs from its size on screen (see texture_residency.cpp), less when the driver reports less
+// video memory free (see gpu_memory.cpp); 0 loads them whole
+int textureBudget = 0;
+// The textures leave out their --texture-quality <n> top mip levels, a quarter of their memory
+// and upload each; by default the level count GpuMemory::textureMipSkip() picks for the card
+int textureQuality = -1;
+
+// Height map terrain under the cubes, --terrain <image> read through the texture loader and drawn
+// with CDLOD (see terrain.cpp) over --terrain-size <n> world units
+std::string terrainPath;
+float terrainSize = 256.0f;
+// The terrain's color from a virtual texture cooked by --cook-virtual, --virtual-texture <file.vt>,
+// with a page cache of --virtual-cache <n> x n pages (see virtual_texture.cpp)
+std::string virtualTexturePath;
+int virtualCacheSlots = 16;
+// Grass over the terrain, --scatter <n> candidates per tile placed, culled and split into levels
+// of detail by a compute pass and drawn indirectly, nothing per instance on the CPU (see
+// procedural_scatter.cpp); --scatter-density <image> thins it where the image is dark
+unsigned int scatterPerTile = 0;
+std::string scatterDensityPath;
+// Open water, --ocean <n> an FFT wave simulation of n x n frequencies run in compute every
+// frame and drawn on a CDLOD grid --ocean-size <n> world units across around the camera
+// (see ocean.cpp); at a quarter of the terrain's height with --terrain
+int oceanResolution = 0;
+float oceanSize = 4096.0f;
+
+// Asset pack built by --pack, every file in it is read from the mapping instead of the disk,
+// --assets <file.pak> picks another one
+std::string assetPackPath = "assets.pak";
+
+int main(int argc, char **argv)
 {
+    // offline tools, these run without a window
+    if (argc > 1 && std::string(argv[1]) == "--cook")
+    {
+        // compresses the source textures and converts the OBJ meshes into res/cooked,
+        // the cooked files are preferred at runtime: --cook [directory] [--force], the meshes
+        // unchanged since the last cook are skipped unless forced
+        std::string directory = "./res";
+        bool force = false;
+        for (int i = 2; i < argc; i++)
+        {
+            if (std::string(argv[i]) == "--force")
+                force = true;
+            else
+                directory = argv[i];
+        }
+        JobSystem jobs;
+        int failures = cookDirectory(directory) + cookMeshDirectory(directory, jobs, force);
+        return failures == 0 ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--cook-virtual" && argc > 2)
+    {
+        // pages every level of one large image into a virtual texture, next to the cooked files
+        // by default: --cook-virtual <image> [output.vt] [page size]
+        std::string source = argv[2];
+        std::filesystem::path path(source);
+        std::string output = argc > 3 ? argv[3] : (path.parent_path() / "cooked" / path.stem()).string() + ".vt";
+        int pageSize = argc > 4 ? std::max(16, std::atoi(argv[4])) : 128;
+        return cookVirtualTexture(source, output, pageSize) ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--decode-benchmark")
+    {
+        // decode throughput of every image decoder built in on the images of a directory,
+        // --decode-benchmark [directory] [iterations]
+        std::string directory = argc > 2 ? argv[2] : "./res";
+        int iterations = argc > 3 ? std::max(1, std::atoi(argv[3])) : 20;
+        return benchmarkImageDecoders(directory, iterations) == 0 ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--math-benchmark")
+    {
+        // the batched math kernels against plain GLM, --math-benchmark [count] [iterations]
+        size_t count = argc > 2 ? (size_t)std::max(1, std::atoi(argv[2])) : 100000;
+        int iterations = argc > 3 ? std::max(1, std::atoi(argv[3])) : 50;
+        return benchmarkBatchMath(count, iterations) == 0 ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--micro-benchmark")
+    {
+        // uniform setters, camera matrices, model matrices, image decodes and the render queue
+        // sort, each on its own, --micro-benchmark [filter]
+        std::string filter = argc > 2 ? argv[2] : "";
+        return runMicroBenchmarks(filter, "./res");
+    }
+    if (argc > 1 && std::string(argv[1]) == "--spirv")
+    {
+        // compiles the listed GLSL stages into SPIR-V modules under <directory>/cooked with
+        // glslangValidator, the compute shaders by default
+        std::vector<std::string> sources;
+        for (int i = 2; i < argc; i++)
+            sources.push_back(argv[i]);
+        if (sources.empty())
+            sources = {"src/shader_src/cull.comp", "src/shader_src/meshlet_cull.comp", "src/shader_src/hiz_reduce.comp"};
+        return cookShaders(sources) == 0 ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bake-pvs" && argc > 2)
+    {
+        // the cells every cell of a level can see, next to it for --cells and --pack to pick up:
+        // --bake-pvs <cells file> [output.pvs]
+        CellPortals level;
+        if (!level.load(argv[2]))
+            return 1;
+        level.bakePVS();
+        std::string output = argc > 3 ? argv[3] : CellPortals::pvsPath(argv[2]);
+        size_t pairs = 0;
+        for (uint8_t flag : level.pvs)
+            pairs += flag;
+        std::cout << "baked " << level.cells.size() << " cells, " << pairs << " visible pairs into " << output << '\n';
+        return level.writePVS(output) ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--pack")
+    {
+        // res/ (cooked files included, best cooked first) and the shader sources in one
+        // archive that is used in place of the loose files when it exists
+        std::string output = argc > 2 ? argv[2] : assetPackPath;
+        std::vector<std::string> directories;
+        for (int i = 3; i < argc; i++)
+            directories.push_back(argv[i]);
+        if (directories.empty())
+            directories = {"./res", "src/shader_src"};
+        return writeAssetPack(output, directories) ? 0 : 1;
+    }
 
-    if (!glfwInit())
+    VsyncMode vsyncMode = VSYNC_ON;
+    autoPath = argc == 1;
+    for (int i = 1; i < argc; i++)
     {
-        std::cout << "Couldnt initialize glfw\n";
-        return -1;
+        std::string arg = argv[i];
+        if (arg == "--low-latency")
+            framePacer.lowLatency = true;
+        else if (arg == "--no-material-table")
+            materialTable = false;
+        if (arg == "--on-demand")
+            redraw.onDemand = true;
+        if (arg == "--gl-markers")
+            debugMarkers = true;
+        if (arg == "--pin-jobs")
+            pinJobThreads = true;
+        if (arg == "--gpu-profile")
+            printGpuProfile = true;
+        if (arg == "--gl-calls")
+            countGLCalls = printGLCalls = true;
+        if (arg == "--gpu-memory")
+            printGpuMemory = true;
+        if (arg == "--hitches")
+            detectHitches = true;
+        if (arg == "--pipeline-stats")
+            pipelineStatistics = true;
+        if (arg == "--overdraw")
+            overdrawView = showOverdraw = true;
+        if (arg == "--alloc-stats")
+            printAllocations = true;
+        if (arg == "--assert-no-alloc")
+            assertNoAllocations = true;
+        if (arg == "--no-hud")
+            showHud = false;
+        if (arg == "--no-bvh")
+            bvhCulling = false;
+        if (arg == "--no-single-pass-mips")
+            singlePassMips = false;
+        if (arg == "--camera-collision")
+            cameraCollision = true;
+        if (arg == "--static-batching")
+            staticBatching = true;
+        if (arg == "--ray-bvh")
+            rayBvh = true;
+        if (arg == "--lightmap")
+            lightmapping = staticBatching = rayBvh = true;
+        if (arg == "--shader-stats")
+            shaderStats = true;
+        if (arg == "--huge-pages")
+            hugePageArenas = true;
+        if (arg == "--floating-origin")
+            floatingOrigin = true;
+        if (arg == "--rt-shadows")
+            rayTracedShadows = rayBvh = true;
+        if (arg == "--gpu-animation")
+            gpuAnimation = true;
+        if (arg == "--physics")
+            rigidBodyPhysics = true;
+        if (arg == "--compact-instances")
+            compactInstances = true;
+        if (arg == "--software-occlusion")
+            softwareOcclusion = true;
+        if (arg == "--conditional-render")
+            conditionalRendering = true;
+        if (arg == "--per-draw")
+            indirectRendering = instancedRendering = false;
+        if (arg == "--gpu-pick")
+            gpuPicking = true;
+        if (arg == "--stress-static")
+            stressSettings.spin = false;
+        if (arg == "--update-baseline")
+            updateRegressionBaseline = true;
+        if (arg == "--auto-path")
+            autoPath = true;
+        if (arg == "--calibrate")
+            autoPath = recalibratePath = true;
+        if (arg == "--startup")
+            printStartup = true;
+        if (arg == "--no-hot-reload")
+            shaderHotReload = false;
+        if (arg == "--no-raw-mouse")
+            rawMouseMotion = false;
+        if (arg == "--debug-view")
+            debugView = true;
+        if (arg == "--debug-window")
+            debugWindow = true;
+        if (arg == "--stereo")
+            stereoRendering = true;
+        if (arg == "--vrs")
+            variableRateShading = true;
+        if (arg == "--no-texture-cache")
+            textureCacheEnabled = false;
+        if (arg == "--compress-texture-cache")
+            compressTextureCache = true;
+        if (arg == "--compress-generated")
+            compressGenerated = true;
+        if (arg == "--upload-thread")
+            uploadThread = true;
+        if (arg == "--coroutine-loading")
+            coroutineLoading = true;
+        if (arg == "--pipeline-warmup")
+            warmPipelines = true;
+        if (arg == "--deferred")
+            deferredShading = true;
+        if (arg == "--clustered")
+            clusteredShading = true;
+        if (arg == "--shadows")
+            sunShadows = true;
+        if (arg == "--point-shadows")
+            pointShadows = true;
+        if (arg == "--pre-skinning")
+            preSkinning = true;
+        if (arg == "--labels")
+            showLabels = true;
+        if (arg == "--sorted-transparency")
+            weightedTransparency = false;
+        if (arg == "--post")
+            postProcessing = true;
+        if (arg == "--ssao")
+            ambientOcclusion = true;
+        else if (arg == "--auto-exposure")
+            autoExposure = true;
+        if (arg == "--ssr")
+            screenSpaceReflections = true;
+        if (arg == "--environment")
+            environmentLighting = true;
+        if (arg == "--meshlets")
+            meshletRendering = true;
+        if (arg == "--triangle-filter")
+            triangleFiltering = meshletRendering = true;
+        if (arg == "--dynamic-resolution")
+            dynamicResolution = true;
+        if (arg == "--quality-governor")
+            qualityGovernor = true;
+        if (arg == "--taa")
+            temporalAA = true;
+        if (arg == "--benchmark-aa")
+            benchmarkAntiAliasing = true;
+        if (i + 1 >= argc)
+            continue;
+        if (arg == "--scene")
+            scenePath = argv[++i];
+        else if (arg == "--trace")
+            tracePath = argv[++i];
+        else if (arg == "--record-video")
+            videoPath = argv[++i];
+        else if (arg == "--record-fps")
+            recordFps = std::atoi(argv[++i]);
+        else if (arg == "--job-threads")
+            jobThreads = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--startup-trace")
+            startupTracePath = argv[++i];
+        else if (arg == "--scene-snapshot")
+            sceneSnapshotPath = argv[++i];
+        else if (arg == "--assets")
+            assetPackPath = argv[++i];
+        else if (arg == "--cells")
+            cellsPath = argv[++i];
+        else if (arg == "--benchmark")
+            benchmarkFrames = std::atoi(argv[++i]);
+        else if (arg == "--benchmark-size")
+            std::sscanf(argv[++i], "%dx%d", &benchmarkWidth, &benchmarkHeight);
+        else if (arg == "--benchmark-out")
+            benchmarkOutput = argv[++i];
+        else if (arg == "--benchmark-warmup")
+            benchmarkWarmup = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--sprites")
+            spriteCount = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--regression")
+            regressionBaseline = argv[++i];
+        else if (arg == "--regression-threshold")
+            regressionThreshold = (float)std::atof(argv[++i]);
+        else if (arg == "--camera-path")
+            cameraPathFile = argv[++i];
+        else if (arg == "--record")
+            inputRecordPath = argv[++i];
+        else if (arg == "--replay")
+            inputReplayPath = argv[++i];
+        else if (arg == "--hitch-threshold")
+            hitchThreshold = std::max(1.0f, (float)std::atof(argv[++i]));
+        else if (arg == "--telemetry")
+            telemetryPort = std::atoi(argv[++i]);
+        else if (arg == "--telemetry-connect")
+            telemetryAddress = argv[++i];
+        else if (arg == "--telemetry-trace")
+            telemetryTracePath = argv[++i];
+        else if (arg == "--telemetry-frames")
+            telemetryFrames = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--gl-trace")
+            glTracePath = argv[++i];
+        else if (arg == "--gl-trace-frames")
+            glTraceFrames = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--replay-gl")
+            glReplayPath = argv[++i];
+        else if (arg == "--particles")
+            particleCount = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--skinned-instances")
+            skinnedInstances = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--crowd")
+            crowdSize = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--image-decoder")
+            preferredImageDecoder() = argv[++i];
+        else if (arg == "--texture-budget")
+            textureBudget = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--texture-quality")
+            textureQuality = std::clamp(std::atoi(argv[++i]), 0, 8);
+        else if (arg == "--anisotropy")
+            anisotropy = std::clamp((float)std::atof(argv[++i]), 1.0f, 16.0f);
+        else if (arg == "--terrain")
+            terrainPath = argv[++i];
+        else if (arg == "--terrain-size")
+            terrainSize = std::max(1.0f, (float)std::atof(argv[++i]));
+        else if (arg == "--scatter")
+            scatterPerTile = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--scatter-density")
+            scatterDensityPath = argv[++i];
+        else if (arg == "--lightmap-texels")
+            lightmapTexels = std::max(0.01f, (float)std::atof(argv[++i]));
+        else if (arg == "--lightmap-size")
+            lightmapSize = std::clamp(std::atoi(argv[++i]), 64, 8192);
+        else if (arg == "--lightmap-samples")
+            lightmapSamples = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--ocean")
+            oceanResolution = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--ocean-size")
+            oceanSize = std::max(1.0f, (float)std::atof(argv[++i]));
+        else if (arg == "--virtual-texture")
+            virtualTexturePath = argv[++i];
+        else if (arg == "--virtual-cache")
+            virtualCacheSlots = std::max(2, std::atoi(argv[++i]));
+        else if (arg == "--stress")
+        {
+            stressScene = true;
+            stressSettings.count = (size_t)std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--stress-layout")
+            stressSettings.layout = parseStressLayout(argv[++i]);
+        else if (arg == "--stress-materials")
+            stressSettings.materials = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--stress-textures")
+            stressSettings.textures = std::max(2, std::atoi(argv[++i]));
+        else if (arg == "--stress-seed")
+            stressSettings.seed = (uint32_t)std::atoi(argv[++i]);
+        else if (arg == "--gl")
+            std::sscanf(argv[++i], "%d.%d", &glVersionLimit.major, &glVersionLimit.minor);
+        else if (arg == "--prepass")
+        {
+            std::string mode = argv[++i];
+            depthPrepassMode = mode == "off" ? PREPASS_OFF : mode == "on" ? PREPASS_ON : PREPASS_AUTO;
+        }
+        else if (arg == "--gbuffer")
+            gbufferPrecision = std::string(argv[++i]) == "full" ? GBUFFER_FULL : GBUFFER_COMPACT;
+        else if (arg == "--lights")
+            lightCount = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--decals")
+            decalCount = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--shadow-size")
+            shadowMapSize = std::max(64, std::atoi(argv[++i]));
+        else if (arg == "--point-shadow-size")
+            pointShadowAtlasSize = std::max(512, std::atoi(argv[++i]));
+        else if (arg == "--point-shadow-faces")
+            pointShadowFaces = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--fog")
+        {
+            volumetricFog = true;
+            fogDensity = std::max(0.0f, (float)std::atof(argv[++i]));
+        }
+        else if (arg == "--bloom")
+            bloomStrength = (float)std::atof(argv[++i]);
+        else if (arg == "--exposure")
+            exposure = (float)std::atof(argv[++i]);
+        else if (arg == "--target-ms")
+            targetFrameTime = std::max(1.0f, (float)std::atof(argv[++i]));
+        else if (arg == "--aa")
+            antiAliasing = parseAntiAliasing(argv[++i]);
+        else if (arg == "--lod-threshold")
+            lodThreshold = std::max(0.0f, (float)std::atof(argv[++i]));
+        else if (arg == "--impostors")
+            impostorDistance = std::max(0.0f, (float)std::atof(argv[++i]));
+        else if (arg == "--voxels")
+            voxelChunks = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--voxel-stream")
+            voxelCacheMB = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--world")
+            worldRadius = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--hlod")
+            hlodRadius = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--upscale")
+            upscaleFilter = std::string(argv[++i]) == "bilinear" ? UPSCALE_BILINEAR : UPSCALE_SHARPEN;
+        else if (arg == "--fps")
+            framePacer.setTargetFps(std::atof(argv[++i]));
+        else if (arg == "--frames-in-flight")
+            framePacer.maxFramesInFlight =
+                (unsigned int)std::clamp(std::atoi(argv[++i]), 0, (int)FrameFences::CAPACITY);
+        else if (arg == "--idle-fps")
+            redraw.idleFps = std::max(0.0, std::atof(argv[++i]));
+        else if (arg == "--idle-after")
+            redraw.idleSeconds = std::max(0.0, std::atof(argv[++i]));
+        else if (arg == "--vsync")
+        {
+            std::string mode = argv[++i];
+            vsyncMode = mode == "off" ? VSYNC_OFF : mode == "adaptive" ? VSYNC_ADAPTIVE : VSYNC_ON;
+        }
     }
 
-    glfwWindowHint(GLFW_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_VERSION_MINOR, 3);
-    // glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // the telemetry client needs neither a window nor the scene
+    if (!telemetryAddress.empty())
+        return telemetryToChromeTrace(telemetryAddress, telemetryTracePath, telemetryFrames);
+    // a GL trace replays in a window of its own, without the app's scene
+    if (!glReplayPath.empty())
+    {
+        if (!glfwInit())
+        {
+            std::cout << "Couldnt initialize glfw\n";
+            return -1;
+        }
+        int replayed = replayGLTrace(glReplayPath);
+        glfwTerminate();
+        return replayed;
+    }
+    shaderStatsEnabled = shaderStats || benchmarkFrames > 0;
+    hugePagesEnabled = hugePageArenas;
+    // one thread and one context make every call the trace sees
+    if (!glTracePath.empty())
+    {
+        renderThreadMode = false;
+        uploadThread = false;
+        debugWindow = false;
+        programBinaryCacheEnabled = false;
+    }
+
+    // the workers outlive every scene, at startup they read and decode the assets below
+    // while the window and context are created
+    JobSystem jobs(jobThreads, pinJobThreads);
+    if (std::filesystem::exists(assetPackPath))
+    {
+        StartupScope startup("open asset pack");
+        if (assetPack.open(assetPackPath))
+            std::cout << "assets: " << assetPack.size() << " files from " << assetPackPath << '\n';
+    }
+    StartupGraph startupGraph(jobs);
+    assetPrefetch.start(startupGraph);
+    prefetchStartupAssets();
 
-    GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, "Binbow", NULL, NULL);
+    {
+        StartupScope startup("glfwInit");
+        if (!glfwInit())
+        {
+            std::cout << "Couldnt initialize glfw\n";
+            return -1;
+        }
+    }
+
+    // the suite is a set of benchmark runs, 300 frames each unless --benchmark says otherwise
+    if (!regressionBaseline.empty() && benchmarkFrames <= 0)
+        benchmarkFrames = 300;
+
+    if (benchmarkFrames > 0)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        vsyncMode = VSYNC_OFF;
+        framePacer.setTargetFps(0.0);
+        showHud = false;
+    }
+    // a replay needs every recorded frame
+    if (benchmarkFrames > 0 || !inputReplayPath.empty())
+    {
+        redraw.onDemand = false;
+        redraw.idleFps = 0.0;
+    }
+
+    double contextStart = startupTimeline.now();
+    GLContextVersion contextVersion;
+    GLFWwindow *window = createGLWindow(WIDTH, HEIGHT, "Binbow", glVersionLimit, contextVersion);
     if (window == NULL)
     {
         std::cout << "Error creating the window\n";
@@ -57,94 +1086,492 @@ int main()
         return -1;
     }
     glfwMakeContextCurrent(window);
+    framePacer.setVsync(vsyncMode);
+    startupTimeline.record("window and context", contextStart, startupTimeline.now());
+    if (printStartup)
+        std::cout << "OpenGL " << contextVersion.major << "." << contextVersion.minor << " core profile\n";
 
     // Capture the cursor in the middle of the screen
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+    double gladStart = startupTimeline.now();
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     {
         std::cout << "Failed to initialize GLAD\n";
         return -1;
     }
+    startupTimeline.record("gladLoadGLLoader", gladStart, startupTimeline.now());
+    if (!glTracePath.empty())
+    {
+        int traceWidth, traceHeight;
+        glfwGetFramebufferSize(window, &traceWidth, &traceHeight);
+        glTrace.start(glTracePath, glTraceFrames, traceWidth, traceHeight);
+    }
+    installDebugOutput();
+    if (debugMarkers)
+        enableDebugMarkers();
 
-    glViewport(0, 0, WIDTH, HEIGHT);
+    int initialWidth, initialHeight;
+    glfwGetFramebufferSize(window, &initialWidth, &initialHeight);
+    windowSize.init(initialWidth, initialHeight);
+    glViewport(0, 0, initialWidth, initialHeight);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glEnable(GL_DEPTH_TEST);
+    glState.enable(GL_DEPTH_TEST);
 
     // Setting up camera settings
     camera.mouseSensitivity = 0.2f;
     camera.movementSpeed = 2.0f;
-    glfwSetCursorPosCallback(window, mouse_callback);
-    // Creating a wrapper lambda to match the signatures
-    glfwSetScrollCallback(
-        window, [](GLFWwindow *window, double xoffset, double yoffset) { camera.processMouseScroll(yoffset, false); });
+    camera.setLens(aspectRatio, zNear, zFar);
+    camera.setQuaternionMode(quaternionCamera);
+    input.attach(window, rawMouseMotion);
+    if (!inputReplayPath.empty())
+        input.replay(inputReplayPath);
+    else if (!inputRecordPath.empty())
+        input.record(inputRecordPath);
 
-    Shader shader("src/shader_src/vertex_shader.vs", "src/shader_src/fragment_shader.fs");
+    // every GL object of the scene is released inside, while the context still exists
+    int result = 0;
+    if (!regressionBaseline.empty())
+        result = runRegression(window, jobs);
+    else
+    {
+        if (autoPath && benchmarkFrames == 0 && inputReplayPath.empty())
+            selectRendererPath(window, jobs, vsyncMode);
+        runScene(window, jobs);
+    }
+    assetPrefetch.stop();
+    if (!tracePath.empty())
+        CpuProfiler::instance().writeChromeTrace(tracePath);
+    if (printAllocations)
+        AllocTracker::instance().print();
 
-    // Creating the texture
-    unsigned int texture1, texture2;
-    glGenTextures(1, &texture1);
-    glGenTextures(1, &texture2);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    glBindTexture(GL_TEXTURE_2D, texture2);
+    glfwTerminate();
+    return result;
+}
 
-    // Setting the texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+// benchmarks every combination below into a RegressionSuite, 1 when something regressed
+int runRegression(GLFWwindow *window, JobSystem &jobs)
+{
+    // real compiles every run, the startup times would only measure the cache otherwise
+    programBinaryCacheEnabled = false;
+    shaderStatsEnabled = true;
+    if (benchmarkWarmup == 0)
+        benchmarkWarmup = 30;
+    // only the suite's own baseline is written
+    benchmarkOutput.clear();
 
-    glBindTexture(GL_TEXTURE_2D, texture1);
+    struct RegressionScene
+    {
+        const char *name;
+        size_t stressCount;
+    };
+    const RegressionScene scenes[] = {{"cubes", 0}, {"stress10k", 10000}};
+    const char *paths[] = {"indirect", "instanced", "per draw"};
+    const int resolutions[][2] = {{640, 360}, {1280, 720}};
+    Camera initialCamera = camera;
+
+    RegressionSuite suite;
+    suite.threshold = regressionThreshold;
+    for (const RegressionScene &scene : scenes)
+    {
+        for (const char *path : paths)
+        {
+            std::string pathName = path;
+            if (pathName == "indirect" && !IndirectRenderer::isSupported())
+                continue;
+            for (const int *resolution : resolutions)
+            {
+                indirectRendering = pathName == "indirect";
+                instancedRendering = pathName == "instanced";
+                stressScene = scene.stressCount > 0;
+                if (stressScene)
+                    stressSettings.count = scene.stressCount;
+                benchmarkWidth = resolution[0];
+                benchmarkHeight = resolution[1];
+                // runScene leaves these behind
+                camera = initialCamera;
+                zFar = 100.0f;
+                lastFrame = (float)glfwGetTime();
+                glfwSetWindowShouldClose(window, false);
 
-    // Loading all the textures
-    stbi_set_flip_vertically_on_load(1);
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load("./res/container.jpg", &width, &height, &nrChannels, 0);
+                std::string name = std::string(scene.name) + "/" + pathName + "/" + std::to_string(resolution[0]) +
+                                   "x" + std::to_string(resolution[1]);
+                std::cout << "regression: " << name << '\n';
+                runScene(window, jobs);
+                benchmarkResult.name = name;
+                suite.results.push_back(benchmarkResult);
+            }
+        }
+    }
 
-    if (data)
+    std::ifstream existing(regressionBaseline);
+    if (!existing || updateRegressionBaseline)
     {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        // freeing the image memory
-        stbi_image_free(data);
+        existing.close();
+        std::cout << "regression: baseline written to " << regressionBaseline << '\n';
+        return suite.writeBaseline(regressionBaseline) ? 0 : 1;
     }
-    else
+    existing.close();
+    return suite.compare(regressionBaseline) == 0 ? 0 : 1;
+}
+
+// the renderer path stored for this GPU and driver, or the fastest of a short benchmark of each
+// when there is none yet or with --calibrate, which is then stored
+void selectRendererPath(GLFWwindow *window, JobSystem &jobs, VsyncMode vsync)
+{
+    PathCalibration calibration;
+    std::string renderer = PathCalibration::rendererKey();
+    const RendererPath *chosen = recalibratePath ? NULL : calibration.find(renderer);
+    if (!chosen)
     {
-        std::cout << "Failed to load the textures\n";
+        // what the runs change, put back for the scene that follows
+        int frames = benchmarkFrames, warmup = benchmarkWarmup;
+        std::string output = benchmarkOutput;
+        bool hud = showHud, onDemand = redraw.onDemand;
+        double targetFps = framePacer.targetFps;
+        Camera initialCamera = camera;
+        float initialFar = zFar;
+        benchmarkFrames = 120;
+        benchmarkWarmup = 30;
+        benchmarkOutput.clear();
+        showHud = false;
+        redraw.onDemand = false;
+        framePacer.setTargetFps(0.0);
+        framePacer.setVsync(VSYNC_OFF);
+
+        float best = 0.0f;
+        for (const RendererPath &path : rendererPaths())
+        {
+            if (path.indirect && !IndirectRenderer::isSupported())
+                continue;
+            // the deferred and clustered paths never go bindless
+            if (path.bindless && (!hasGLExtension("GL_ARB_bindless_texture") || !GLAD_GL_VERSION_4_3 ||
+                                  deferredShading || clusteredShading))
+                continue;
+            indirectRendering = path.indirect;
+            gpuCulling = path.gpuCulling;
+            instancedRendering = path.instanced;
+            bindlessRendering = path.bindless;
+            camera = initialCamera;
+            zFar = initialFar;
+            lastFrame = (float)glfwGetTime();
+            glfwSetWindowShouldClose(window, false);
+            runScene(window, jobs);
+            float ms = PathCalibration::frameMs(benchmarkResult);
+            std::cout << "calibration: " << path.name << " " << ms << " ms per frame\n";
+            if (ms > 0.0f && (!chosen || ms < best))
+            {
+                chosen = &path;
+                best = ms;
+            }
+        }
+
+        benchmarkFrames = frames;
+        benchmarkWarmup = warmup;
+        benchmarkOutput = output;
+        showHud = hud;
+        redraw.onDemand = onDemand;
+        camera = initialCamera;
+        zFar = initialFar;
+        lastFrame = (float)glfwGetTime();
+        glfwSetWindowShouldClose(window, false);
+        framePacer.setTargetFps(targetFps);
+        framePacer.setVsync(vsync);
+        if (!chosen)
+        {
+            std::cout << "ERROR::PATH_CALIBRATION::NO_RESULT\n";
+            return;
+        }
+        calibration.store(renderer, *chosen);
     }
+    indirectRendering = chosen->indirect;
+    gpuCulling = chosen->gpuCulling;
+    instancedRendering = chosen->instanced;
+    bindlessRendering = chosen->bindless;
+    std::cout << "renderer path: " << chosen->name << " on " << renderer << '\n';
+}
 
-    glBindTexture(GL_TEXTURE_2D, texture2);
-    data = stbi_load("./res/awesomeface.png", &width, &height, &nrChannels, 0);
-    if (data)
+// the files runScene() reads first, queued on the startup graph before there is a window
+void prefetchStartupAssets()
+{
+    const char *shaderSources[] = {
+        "src/shader_src/vertex_shader.vs", "src/shader_src/fragment_shader.fs", "src/shader_src/frame_data.glsl",
+        "src/shader_src/interface.glsl",   "src/shader_src/hud.vs",             "src/shader_src/hud.fs",
+        "src/shader_src/bindless.fs",      "src/shader_src/indirect.vs",        "src/shader_src/cull.comp",
+        "src/shader_src/hiz_reduce.comp",  "src/shader_src/specialization.glsl", "src/shader_src/vertex_pulling.vs",
+        "src/shader_src/depth_only.fs",    "src/shader_src/gbuffer.fs",         "src/shader_src/gbuffer.glsl",
+        "src/shader_src/octahedral.glsl",  "src/shader_src/point_lights.glsl",  "src/shader_src/fullscreen.vs",
+        "src/shader_src/deferred_ambient.fs", "src/shader_src/light_volume.vs", "src/shader_src/deferred_light.fs",
+        "src/shader_src/point_light.glsl", "src/shader_src/clustered_lights.glsl", "src/shader_src/clustered.fs",
+        "src/shader_src/cluster_lights.comp", "src/shader_src/shadows.glsl",
+        "src/shader_src/post.vs",          "src/shader_src/post_downsample.fs", "src/shader_src/post_blur.fs",
+        "src/shader_src/post_composite.fs", "src/shader_src/upscale_bilinear.fs", "src/shader_src/upscale_easu.fs",
+        "src/shader_src/upscale_rcas.fs", "src/shader_src/catmull_rom.glsl", "src/shader_src/velocity.vs",
+        "src/shader_src/velocity.fs", "src/shader_src/taa_resolve.fs", "src/shader_src/fxaa.fs",
+        "src/shader_src/lod_fade.glsl", "src/shader_src/culling.glsl", "src/shader_src/meshlet_cull.comp",
+        "src/shader_src/triangle_filter.comp",
+        "src/shader_src/material.glsl", "src/shader_src/luminance_histogram.comp", "src/shader_src/volumetric_fog.comp",
+        "src/shader_src/pick.vs", "src/shader_src/pick.fs", "src/shader_src/particles.glsl",
+        "src/shader_src/particle_emit.comp", "src/shader_src/particle_prepare.comp",
+        "src/shader_src/particle_simulate.comp", "src/shader_src/particle.vs", "src/shader_src/particle.fs",
+        "src/shader_src/spd.comp", "src/shader_src/bc_compress.comp", "src/shader_src/ssao.fs",
+        "src/shader_src/ao_temporal.fs", "src/shader_src/ao_apply.fs", "src/shader_src/shading_rate.comp",
+        "src/shader_src/skybox.vs", "src/shader_src/skybox.fs", "src/shader_src/env_sky.comp",
+        "src/shader_src/env_irradiance.comp", "src/shader_src/env_specular.comp", "src/shader_src/reflections.glsl",
+        "src/shader_src/ssr_trace.fs", "src/shader_src/ssr_temporal.fs", "src/shader_src/ssr_apply.fs",
+        "src/shader_src/ray_bvh.glsl", "src/shader_src/rt_shadows.comp"};
+    for (const char *path : shaderSources)
+        assetPrefetch.readFile(path);
+    if (!terrainPath.empty())
     {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        stbi_image_free(data);
+        for (const char *path : {"src/shader_src/terrain.vs", "src/shader_src/terrain.fs",
+                                 "src/shader_src/virtual_texture.glsl", "src/shader_src/virtual_feedback.fs",
+                                 "src/shader_src/scatter.comp", "src/shader_src/scatter.vs",
+                                 "src/shader_src/scatter.fs"})
+            assetPrefetch.readFile(path);
     }
-    else
+    if (oceanResolution > 0)
     {
-        std::cout << "Failed to load the textures\n";
+        for (const char *path : {"src/shader_src/ocean_spectrum.comp", "src/shader_src/ocean_fft.comp",
+                                 "src/shader_src/ocean_resolve.comp", "src/shader_src/ocean.vs",
+                                 "src/shader_src/ocean.fs"})
+            assetPrefetch.readFile(path);
     }
+    if (lightmapping)
+        assetPrefetch.readFile("src/shader_src/lightmap_bake.comp");
+    if (voxelChunks > 0)
+        assetPrefetch.readFile("src/shader_src/voxel.vs");
+    if (!scenePath.empty())
+    {
+        for (const char *path : {"src/shader_src/scene.fs", "src/shader_src/skinned.vs", "src/shader_src/skinning.glsl",
+                                 "src/shader_src/skin.comp", "src/shader_src/crowd.vs"})
+            assetPrefetch.readFile(path);
+    }
+    // the material layers of the texture array, flipped RGBA like TextureLoader::loadLayer()
+    for (const char *path : {"./res/container.jpg", "./res/wall.jpg", "./res/awesomeface.png"})
+        assetPrefetch.decodeImage(path, true, 4);
+}
 
-    // 3d cube
-    float vertices[] = {
-        -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, 0.5f,  -0.5f, -0.5f, 1.0f, 0.0f, 0.5f,  0.5f,  -0.5f, 1.0f, 1.0f,
-        0.5f,  0.5f,  -0.5f, 1.0f, 1.0f, -0.5f, 0.5f,  -0.5f, 0.0f, 1.0f, -0.5f, -0.5f, -0.5f, 0.0f, 0.0f,
+// where the modules with extension entry points outside glad's load them, none while tracing
+GLADloadproc glExtensionLoader()
+{
+    return glTracePath.empty() ? (GLADloadproc)glfwGetProcAddress : (GLADloadproc)noGLExtensions;
+}
 
-        -0.5f, -0.5f, 0.5f,  0.0f, 0.0f, 0.5f,  -0.5f, 0.5f,  1.0f, 0.0f, 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-        0.5f,  0.5f,  0.5f,  1.0f, 1.0f, -0.5f, 0.5f,  0.5f,  0.0f, 1.0f, -0.5f, -0.5f, 0.5f,  0.0f, 0.0f,
+void runScene(GLFWwindow *window, JobSystem &jobs)
+{
+    // the benchmark times the texture loads from here
+    double sceneStart = glfwGetTime();
 
-        -0.5f, 0.5f,  0.5f,  1.0f, 0.0f, -0.5f, 0.5f,  -0.5f, 1.0f, 1.0f, -0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f, 0.0f, 1.0f, -0.5f, -0.5f, 0.5f,  0.0f, 0.0f, -0.5f, 0.5f,  0.5f,  1.0f, 0.0f,
+    // the programs compile while the textures below are loaded,
+    // each one is checked on its first use()
+    ShaderCompiler shaderCompiler(glExtensionLoader());
+    PipelineWarmup pipelineWarmup;
+    if (warmPipelines && !renderThreadMode)
+    {
+        pipelineWarmup.load();
+        pipelineWarmup.startRecording();
+    }
+    shaderCompiler.separable = separablePrograms && shaderCompiler.separableSupported && !renderThreadMode;
+    shaderCompiler.spirv = spirvShaders && shaderCompiler.spirvSupported;
+    std::unique_ptr<SinglePassDownsampler> downsampler;
+    if (singlePassMips && SinglePassDownsampler::isSupported() && !renderThreadMode)
+    {
+        downsampler = std::make_unique<SinglePassDownsampler>(shaderCompiler);
+        downsampler->prepare(GL_RGBA8);
+    }
+    // the cubes and glTF primitives are CookedVertex meshes, the vertex shaders declare its attributes
+    const std::vector<std::string> cookedInputs = {CookedVertex::glslDefine()};
+    bool useMaterialTable = materialTable && MaterialTable::isSupported();
+    uint32_t materialFeature = useMaterialTable ? SHADER_MATERIAL_TABLE : 0;
+    ShaderVariants cubeShaders(shaderCompiler, "src/shader_src/vertex_shader.vs", "src/shader_src/fragment_shader.fs",
+                               cookedInputs);
+    Shader &shader = cubeShaders.get(materialFeature);
+    // the pulling vertex shader always reads per-instance data
+    bool useIndirect = indirectRendering && IndirectRenderer::isSupported();
+    bool usePulling = vertexPulling && instancedRendering && !useIndirect && VertexPuller::isSupported();
+    const char *instancedVertexPath = usePulling ? "src/shader_src/vertex_pulling.vs" : "src/shader_src/vertex_shader.vs";
+    // the passes that go through uploadCubes() and drawCubes() only, every cube's record is the
+    // one of its TransformSystem object
+    bool useCompact = compactInstances && instancedRendering && !useIndirect && !usePulling;
+    uint32_t instanceFeature = useCompact ? SHADER_COMPACT : SHADER_INSTANCED;
+    // the deferred path draws the indirect and instanced cubes into the G-buffer instead
+    bool useDeferred = deferredShading && (useIndirect || instancedRendering) && scenePath.empty();
+    // or lights them forward through the clusters
+    bool useClustered = clusteredShading && !useDeferred && (useIndirect || instancedRendering) && scenePath.empty() &&
+                        LightClusters::isSupported();
+    const char *cubeFragmentPath = useDeferred    ? "src/shader_src/gbuffer.fs"
+                                   : useClustered ? "src/shader_src/clustered.fs"
+                                                  : "src/shader_src/fragment_shader.fs";
+    // the sun of either path can be shadowed, the deferred one in its ambient pass, where the
+    // traced rays take the cascades' place
+    bool useRayShadows = rayTracedShadows && useDeferred && RayTracedShadows::isSupported();
+    bool useShadows = sunShadows && !useRayShadows && (useDeferred || useClustered);
+    uint32_t cubeFragmentFeatures = materialFeature | (useClustered && useShadows ? SHADER_SUN_SHADOWS : 0);
+    bool usePointShadows = pointShadows && useClustered && PointShadowAtlas::isSupported();
+    if (usePointShadows)
+        cubeFragmentFeatures |= SHADER_POINT_SHADOWS;
+    bool useFog = volumetricFog && useClustered && VolumetricFog::isSupported();
+    if (useFog)
+        cubeFragmentFeatures |= SHADER_VOLUMETRIC_FOG;
+    // the image based lighting goes in place of the ambient the two lit paths have
+    std::unique_ptr<EnvironmentMaps> environment;
+    if (environmentLighting && (useDeferred || useClustered) && EnvironmentMaps::isSupported())
+    {
+        environment = std::make_unique<EnvironmentMaps>(shaderCompiler);
+        if (useClustered)
+            cubeFragmentFeatures |= SHADER_ENVIRONMENT_LIGHTING;
+    }
+    Shader &instancedShader = usePulling || useDeferred || useClustered
+                                  ? ShaderVariants(shaderCompiler, instancedVertexPath, cubeFragmentPath, cookedInputs)
+                                        .get((usePulling ? 0 : instanceFeature) | cubeFragmentFeatures)
+                                  : cubeShaders.get(instanceFeature | cubeFragmentFeatures);
+    // the same vertex stage without any shading for the depth prepass
+    Shader &instancedDepthShader =
+        ShaderVariants(shaderCompiler, instancedVertexPath, "src/shader_src/depth_only.fs", cookedInputs)
+            .get(usePulling ? 0 : instanceFeature);
+    // and one adding up the fragments for the overdraw view
+    Shader *overdrawShader =
+        overdrawView
+            ? &ShaderVariants(shaderCompiler, instancedVertexPath, "src/shader_src/overdraw.fs", cookedInputs)
+                   .get(usePulling ? 0 : instanceFeature)
+            : nullptr;
+    std::unique_ptr<OverdrawView> overdraw;
+    if (overdrawView)
+        overdraw = std::make_unique<OverdrawView>(
+            shaderCompiler.submit("src/shader_src/fullscreen.vs", "src/shader_src/overdraw_heatmap.fs"));
+    Shader &hudShader = shaderCompiler.submit("src/shader_src/hud.vs", "src/shader_src/hud.fs");
+    Shader *spriteShader =
+        spriteCount ? &shaderCompiler.submit("src/shader_src/sprite.vs", "src/shader_src/sprite.fs") : nullptr;
+    Shader *textShader =
+        showLabels ? &shaderCompiler.submit("src/shader_src/sprite.vs", "src/shader_src/sdf_text.fs") : nullptr;
 
-        0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.5f,  0.5f,  -0.5f, 1.0f, 1.0f, 0.5f,  -0.5f, -0.5f, 0.0f, 1.0f,
-        0.5f,  -0.5f, -0.5f, 0.0f, 1.0f, 0.5f,  -0.5f, 0.5f,  0.0f, 0.0f, 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+    double phaseStart = startupTimeline.now();
+    // Creating the textures, they are decoded on worker threads and
+    // uploaded in the render loop. All materials are layers of one array,
+    // so cubes with different textures still share a single bind and draw call
+    // GL objects given up while frames in flight may still use them (see deletion_queue.cpp)
+    DeletionQueue deletionQueue;
+    TextureResidency residency;
+    residency.deletions = &deletionQueue;
+    TextureCache textureCache;
+    textureCache.compress = compressTextureCache && hasGLExtension("GL_EXT_texture_compression_s3tc");
+    TextureLoader textureLoader;
+    textureLoader.downsampler = downsampler.get();
+    if (textureQuality < 0)
+        textureQuality = gpuMemory.queryDriver() ? gpuMemory.textureMipSkip() : 0;
+    textureLoader.skipMips = textureQuality;
+    if (textureCacheEnabled)
+        textureLoader.cache = &textureCache;
+    if (textureBudget > 0)
+    {
+        residency.budget = (uint64_t)textureBudget * 1024 * 1024;
+        textureLoader.residency = &residency;
+    }
+    // after the loader, so the uploads still in flight are called back before it goes
+    UploadContext uploadContext;
+    if (uploadThread && !renderThreadMode && uploadContext.start(window))
+        textureLoader.uploads = &uploadContext;
+    enum MaterialLayer
+    {
+        LAYER_CONTAINER,
+        LAYER_WALL,
+        LAYER_FACE,
+        LAYER_COUNT
+    };
+    const char *materialPaths[LAYER_COUNT] = {"./res/container.jpg", "./res/wall.jpg", "./res/awesomeface.png"};
+
+    // the stress scene can add generated textures as layers after these
+    int generatedTextures = stressScene ? stressSettings.textures - 2 : 0;
 
-        -0.5f, -0.5f, -0.5f, 0.0f, 1.0f, 0.5f,  -0.5f, -0.5f, 1.0f, 1.0f, 0.5f,  -0.5f, 0.5f,  1.0f, 0.0f,
-        0.5f,  -0.5f, 0.5f,  1.0f, 0.0f, -0.5f, -0.5f, 0.5f,  0.0f, 0.0f, -0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
+    // Setting the texture parameters through sampler objects out of one cache, the materials keep
+    // their texels up close and filter their mips far away
+    SamplerCache samplerCache;
+    samplerCache.setAnisotropyTier(anisotropy);
+    const SamplerDesc materialSamplerDesc = {GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, GL_MIRRORED_REPEAT, GL_REPEAT, 16.0f};
+    const Sampler *sampler = &samplerCache.get(materialSamplerDesc);
+
+    // the bindless path replaces the array with separate textures whose handles
+    // live in a material table, slots use the same numbers as the layers
+    // the indirect path samples the texture array, so it never goes bindless
+    BindlessTextures bindless(glExtensionLoader(), LAYER_COUNT);
+    bool useBindless =
+        bindlessRendering && instancedRendering && !useIndirect && !useDeferred && !useClustered && !useCompact &&
+        bindless.supported && generatedTextures == 0;
+    Shader *bindlessShader = NULL;
+    Texture2DArray materials;
+    // after what the loads write to and before the tasks, so it waits for them on the way out
+    AssetScheduler assets(jobs);
+    AssetTask<> materialLoad;
+    // the eyes are drawn with the forward instanced programs, by one draw call for both
+    StereoTarget stereo(glExtensionLoader());
+    bool useStereo = stereoRendering && instancedRendering && !useIndirect && !usePulling && !useDeferred &&
+                     !useClustered && !useCompact && stereo.supported();
+    Shader *stereoShader = NULL;
+    if (useStereo)
+    {
+        std::vector<std::string> stereoDefines = cookedInputs;
+        if (stereo.mode == StereoTarget::Mode::Multiview)
+            stereoDefines.push_back("OVR_MULTIVIEW");
+        stereoShader = &ShaderVariants(shaderCompiler, instancedVertexPath,
+                                       useBindless ? "src/shader_src/bindless.fs" : cubeFragmentPath, stereoDefines)
+                            .get(SHADER_INSTANCED | SHADER_STEREO);
+    }
+    // the rates come from the last frame, which needs the offscreen scene target to read
+    std::unique_ptr<VariableRateShading> shadingRates;
+    if (variableRateShading && !renderThreadMode)
+    {
+        shadingRates = std::make_unique<VariableRateShading>(glExtensionLoader(), shaderCompiler);
+        if (!shadingRates->supported)
+        {
+            std::cout << "ERROR::MAIN::NO_SHADING_RATE_IMAGE\n";
+            shadingRates.reset();
+        }
+    }
+    // the debug camera is drawn with the forward instanced programs, the inset's views in one
+    // draw when the vertex stage can pick the viewport
+    bool useDebugView = (debugView || debugWindow) && instancedRendering && !useIndirect && !usePulling &&
+                        !useDeferred && !useClustered && !useStereo && !useCompact;
+    Shader *multiViewShader = NULL;
+    if (useDebugView && !debugWindow && MultiView::viewportArraySupported())
+        multiViewShader = &ShaderVariants(shaderCompiler, instancedVertexPath,
+                                          useBindless ? "src/shader_src/bindless.fs" : cubeFragmentPath, cookedInputs)
+                               .get(SHADER_INSTANCED | SHADER_MULTI_VIEW);
+    if (useBindless)
+    {
+        bindlessShader =
+            &ShaderVariants(shaderCompiler, instancedVertexPath, "src/shader_src/bindless.fs", cookedInputs)
+                 .get(usePulling ? 0 : SHADER_INSTANCED);
+        for (int i = 0; i < LAYER_COUNT; i++)
+            bindless.setMaterial(i, textureLoader.load(materialPaths[i]), *sampler);
+    }
+    else
+    {
+        int materialSize = std::max(1, 512 >> textureQuality);
+        materials.create(materialSize, materialSize, LAYER_COUNT + generatedTextures, GL_RGBA8);
+        if (coroutineLoading && !renderThreadMode)
+            materialLoad = loadLayers(assets, materials, {materialPaths, materialPaths + LAYER_COUNT});
+        else
+            for (int i = 0; i < LAYER_COUNT; i++)
+                textureLoader.loadLayer(materials, i, materialPaths[i]);
+        for (int i = 0; i < generatedTextures; i++)
+            materials.upload(LAYER_COUNT + i, 0, GL_RGBA, GL_UNSIGNED_BYTE, makeStressTexture(i, materialSize).data());
+        // the coroutine rebuilds them once its layers are in
+        if (generatedTextures > 0 && !materialLoad && downsampler)
+            downsampler->generate(materials);
+        else if (generatedTextures > 0 && !materialLoad)
+            materials.generateMipmaps();
+    }
+    // a row per layer, each the layer under the face at 0.3 as the shaders had it written in
+    MaterialTable materialRows;
+    if (useMaterialTable)
+    {
+        for (int i = 0; i < LAYER_COUNT + generatedTextures; i++)
+            materialRows.add(i, LAYER_FACE, 0.3f);
+        materialRows.upload();
+    }
 
-        -0.5f, 0.5f,  -0.5f, 0.0f, 1.0f, 0.5f,  0.5f,  -0.5f, 1.0f, 1.0f, 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-        0.5f,  0.5f,  0.5f,  1.0f, 0.0f, -0.5f, 0.5f,  0.5f,  0.0f, 0.0f, -0.5f, 0.5f,  -0.5f, 0.0f, 1.0f};
+    phaseStart = startupTimeline.phase("texture setup", phaseStart);
 
     // cube positions
     glm::vec3 cubePositions[] = {glm::vec3(0.0f, 0.0f, 0.0f),    glm::vec3(2.0f, 5.0f, -15.0f),
@@ -153,48 +1580,1125 @@ int main()
                                  glm::vec3(1.3f, -2.0f, -2.5f),  glm::vec3(1.5f, 2.0f, -2.5f),
                                  glm::vec3(1.5f, 0.2f, -1.5f),   glm::vec3(-1.3f, 1.0f, -1.5f)};
 
-    unsigned int indices[] = {
-        0, 1, 3, // first triangle
-        1, 2, 3  // second triangle
+    // the cube comes from res/cube.obj, ideally cooked by --cook into a binary mesh that
+    // is memory mapped and uploaded as is, otherwise the OBJ is parsed here
+    std::unique_ptr<Mesh> cube = loadMeshFile(cookedMeshPath("./res/cube.obj"), &jobs);
+    if (!cube)
+    {
+        MeshBuilder cubeBuilder(OBJ_VERTEX_FLOATS);
+        if (parseOBJ("./res/cube.obj", cubeBuilder))
+        {
+            optimizeMesh(cubeBuilder);
+            cube = std::make_unique<Mesh>(cubeBuilder, cookedMeshLayout());
+        }
+    }
+    if (!cube)
+    {
+        std::cout << "ERROR::MAIN::NO_CUBE_MESH\n";
+        return;
+    }
+    phaseStart = startupTimeline.phase("cube mesh", phaseStart);
+
+    // the indirect path draws the cube out of a pool that could hold every mesh of the scene
+    GeometryPool geometry(cookedMeshLayout());
+    MeshRange cubeRange;
+    if (useIndirect && !geometry.addMeshFile(cookedMeshPath("./res/cube.obj"), cubeRange, &jobs))
+    {
+        MeshBuilder cubeBuilder(OBJ_VERTEX_FLOATS);
+        if (parseOBJ("./res/cube.obj", cubeBuilder))
+        {
+            buildMeshlets(cubeBuilder);
+            optimizeMesh(cubeBuilder);
+            cubeRange = geometry.add(cubeBuilder);
+        }
+    }
+    phaseStart = startupTimeline.phase("geometry pool", phaseStart);
+    size_t cubeCount = worldRadius > 0  ? WorldPartition::slotsFor(worldRadius)
+                       : stressScene ? stressSettings.count
+                                     : 10;
+    IndirectRenderer indirect(geometry, std::max<size_t>(1024, cubeCount), glExtensionLoader());
+    Shader *indirectShader = NULL;
+    Shader *indirectDepthShader = NULL;
+    Shader *cullShader = NULL;
+    Shader *meshletCullShader = NULL;
+    std::unique_ptr<TriangleFilter> triangleFilter;
+    bool useMeshlets = meshletRendering && useIndirect && gpuCulling;
+
+    // the default framebuffer has no float depth, a reversed-Z frame is drawn offscreen
+    // and blitted to the window
+    bool useReversedZ = reversedZ && GLAD_GL_VERSION_4_5;
+    if (useIndirect)
+    {
+        // LOD_FADE, the cull pass cross-fades the levels of detail (see lod_fade.glsl)
+        // or MESHLETS, a command per visible meshlet (see meshlet_cull.comp)
+        std::vector<std::string> indirectDefines = shaderFeatureDefines(cubeFragmentFeatures);
+        indirectDefines.push_back(useMeshlets ? "MESHLETS" : "LOD_FADE");
+        indirectShader = &shaderCompiler.submit("src/shader_src/indirect.vs", cubeFragmentPath, indirectDefines);
+        indirectShader->use();
+        indirectShader->setInt("materials", 0);
+        indirectShader->setInt("decalLayer", LAYER_FACE);
+        indirectDepthShader = &shaderCompiler.submit("src/shader_src/indirect.vs", "src/shader_src/depth_only.fs",
+                                                     {useMeshlets ? "MESHLETS" : "LOD_FADE"});
+        if (useMeshlets)
+        {
+            meshletCullShader = &shaderCompiler.submitCompute("src/shader_src/meshlet_cull.comp", {},
+                                                              {{0, indirect.drawCountSupported}, {1, useReversedZ}});
+            indirect.setMeshletShader(meshletCullShader, cubeCount * std::max<uint32_t>(cubeRange.meshletCount, 1));
+            if (triangleFiltering && TriangleFilter::supports(geometry.layout))
+            {
+                // compact, the specialization constant
+                triangleFilter = std::make_unique<TriangleFilter>(
+                    geometry, shaderCompiler.submitCompute("src/shader_src/triangle_filter.comp", {},
+                                                           {{0, indirect.drawCountSupported}}));
+                indirect.setTriangleFilter(triangleFilter.get());
+            }
+        }
+        else if (gpuCulling)
+        {
+            // the specialization constants compact and hiZReversed, cull() sets them as uniforms too
+            cullShader = &shaderCompiler.submitCompute("src/shader_src/cull.comp", {},
+                                                       {{0, indirect.drawCountSupported}, {1, useReversedZ}});
+            indirect.setCullShader(cullShader);
+        }
+    }
+    std::unique_ptr<HiZBuffer> hiZ;
+    if ((cullShader || meshletCullShader) && occlusionCulling && HiZBuffer::isSupported())
+    {
+        // reversedZ, the specialization constant
+        hiZ = std::make_unique<HiZBuffer>(
+            shaderCompiler.submitCompute("src/shader_src/hiz_reduce.comp", {}, {{0, useReversedZ}}), downsampler.get());
+        if (downsampler)
+            downsampler->prepare(GL_R32F);
+        indirect.setHiZ(hiZ.get());
+    }
+    // the reflections trace over the nearest depths, with culling or without
+    bool useReflections = screenSpaceReflections && postProcessing && ScreenSpaceReflections::isSupported() &&
+                          !useStereo;
+    if (useReflections)
+    {
+        if (!hiZ)
+            hiZ = std::make_unique<HiZBuffer>(
+                shaderCompiler.submitCompute("src/shader_src/hiz_reduce.comp", {}, {{0, useReversedZ}}),
+                downsampler.get());
+        hiZ->keepNearest(shaderCompiler.submitCompute("src/shader_src/hiz_reduce.comp", {}, {{0, !useReversedZ}}));
+        if (downsampler)
+            downsampler->prepare(GL_R32F);
+    }
+
+    // the voxel chunks are draws of their own pool, culled by the same pass as the cubes
+    std::unique_ptr<VoxelWorld> voxels;
+    std::unique_ptr<VoxelStreamer> voxelStreamer;
+    std::unique_ptr<IndirectRenderer> voxelIndirect;
+    Shader *voxelShader = NULL;
+    if (voxelChunks > 0 && !useIndirect)
+        std::cout << "ERROR::MAIN::VOXELS_NEED_INDIRECT\n";
+    else if (voxelChunks > 0)
+    {
+        float half = voxelChunks * VoxelWorld::CHUNK * 0.5f;
+        voxels = std::make_unique<VoxelWorld>(glm::ivec3(voxelChunks, 2, voxelChunks), glm::vec3(-half, -48.0f, -half));
+        if (voxelCacheMB > 0)
+            voxelStreamer = std::make_unique<VoxelStreamer>(*voxels, LAYER_COUNT, (size_t)voxelCacheMB << 20);
+        else
+        {
+            voxels->generate(jobs, LAYER_COUNT);
+            voxels->remesh(jobs);
+        }
+        voxelIndirect = std::make_unique<IndirectRenderer>(voxels->pool, voxels->grid.size(),
+                                                           glExtensionLoader());
+        voxelIndirect->setCullShader(cullShader);
+        voxelIndirect->setHiZ(hiZ.get());
+        std::vector<std::string> voxelDefines = shaderFeatureDefines(cubeFragmentFeatures);
+        voxelDefines.push_back("LOD_FADE");
+        voxelShader = &shaderCompiler.submit("src/shader_src/voxel.vs", cubeFragmentPath, voxelDefines);
+        voxelShader->use();
+        voxelShader->setInt("materials", 0);
+        voxelShader->setInt("decalLayer", LAYER_FACE);
+        zFar = std::max(zFar, half * 1.5f);
+        if (voxelStreamer)
+            std::cout << "voxels: streaming " << voxels->grid.size() << " chunks around the camera, " << voxelCacheMB
+                      << " MB cache\n";
+        else
+            std::cout << "voxels: " << voxels->grid.size() << " chunks in " << voxels->bytes() << " bytes, "
+                      << voxels->quads << " quads\n";
+        phaseStart = startupTimeline.phase("voxel world", phaseStart);
+    }
+
+    RenderTarget sceneTarget;
+    if (postProcessing)
+        sceneTarget.colorFormat = GL_RGBA16F;
+    if (useReversedZ)
+    {
+        glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+        glClearDepth(0.0);
+        glState.setDepthFunc(GL_GREATER);
+        camera.setReversedZ(true);
+        if (hiZ)
+            hiZ->reversedZ = true;
+    }
+
+    // the benchmark draws offscreen at its own size in either depth mode and records every frame
+    bool benchmarking = benchmarkFrames > 0;
+    CameraPath cameraPath = CameraPath::orbit(glm::vec3(0.0f, 0.0f, -6.0f), 12.0f, 2.0f, 20.0f);
+    BenchmarkRecorder benchmark;
+    int benchmarkFrame = 0;
+    // frames are recorded once the textures are in and the warmup is over
+    bool texturesLoaded = false;
+    int warmupFrames = benchmarkWarmup;
+    size_t gpuFrameSamples = 0;
+    if (benchmarking)
+    {
+        CameraPath loaded;
+        if (!cameraPathFile.empty() && loaded.load(cameraPathFile))
+            cameraPath = loaded;
+        camera.setLens(float(benchmarkWidth) / float(benchmarkHeight), zNear, zFar);
+    }
+
+    // per-frame uniform and instance data is streamed through one persistently mapped buffer
+    // with room for every cube's instance matrix and layer, once more per shadow cascade and
+    // per point shadow face drawn in a frame
+    size_t instanceUploads = useShadows ? 1 + CascadedShadowMaps::CASCADES : 1;
+    if (usePointShadows)
+        instanceUploads += pointShadowFaces;
+    bool useTemporalAA = temporalAA && TemporalAA::isSupported();
+    // the plain forward instanced draw only: the other passes and paths read the CPU matrices
+    bool useGpuAnimation = gpuAnimation && instancedRendering && !useIndirect && !usePulling && !useDeferred &&
+                           !useClustered && !useBindless && !useStereo && !useDebugView && !useTemporalAA &&
+                           !useCompact;
+    // the bodies move the CPU matrices, the vertex shader's spin would ignore them
+    // the streamed cubes come and go in the CPU matrices as well
+    bool useWorld = worldRadius > 0 && !useGpuAnimation && !useCompact;
+    bool usePhysics = rigidBodyPhysics && !useGpuAnimation && !useWorld;
+    Shader *animatedShader = NULL, *animatedDepthShader = NULL;
+    if (useGpuAnimation)
+    {
+        animatedShader = &cubeShaders.get(SHADER_ANIMATED);
+        animatedDepthShader =
+            &ShaderVariants(shaderCompiler, instancedVertexPath, "src/shader_src/depth_only.fs", cookedInputs)
+                 .get(SHADER_ANIMATED);
+    }
+    // the far cubes of the forward instanced draw as quads, baked unlit as fragment_shader.fs shades
+    bool useImpostors = impostorDistance > 0.0f && instancedRendering && !useIndirect && !usePulling &&
+                        !useDeferred && !useClustered && !useBindless && !useStereo && !useGpuAnimation;
+    Shader *impostorBakeShader = NULL, *impostorShader = NULL;
+    if (useImpostors)
+    {
+        std::vector<std::string> bakeDefines = cookedInputs;
+        if (useMaterialTable)
+            bakeDefines.push_back("MATERIAL_TABLE");
+        impostorBakeShader =
+            &shaderCompiler.submit("src/shader_src/impostor_bake.vs", "src/shader_src/impostor_bake.fs", bakeDefines);
+        impostorShader = &shaderCompiler.submit("src/shader_src/impostor.vs", "src/shader_src/impostor.fs");
+    }
+    // the main loop's frames, after the swap; the ring waits on them too
+    FrameFences frameFences;
+    RingBuffer ring(4 * 1024 * 1024 + instanceUploads * cubeCount * (sizeof(glm::mat4) + sizeof(int)) +
+                    (useTemporalAA ? cubeCount * sizeof(InstanceMotion) : 0) + SpriteBatch::bytesFor(spriteCount) +
+                    (showLabels ? SpriteBatch::bytesFor(MAX_LABELS * 10) : 0));
+    Hud hud(hudShader, ring);
+    // baked once the materials are in, see the texture loader's update in the render loop
+    std::unique_ptr<GpuTextureCompressor> textureCompressor;
+    std::unique_ptr<Impostors> impostors;
+    if (useImpostors)
+    {
+        impostors = std::make_unique<Impostors>(*impostorBakeShader, *impostorShader, ring, impostorDistance);
+        impostors->depthFunc = useReversedZ ? GL_GREATER : GL_LESS;
+        if (compressGenerated && GpuTextureCompressor::isSupported())
+        {
+            textureCompressor = std::make_unique<GpuTextureCompressor>(shaderCompiler);
+            impostors->compressor = textureCompressor.get();
+        }
+    }
+    // --sprites: the batcher and a few small textures for it to sort the sprites by
+    std::unique_ptr<SpriteBatch> spriteBatch;
+    std::unique_ptr<TextRenderer> labels;
+    if (textShader)
+        labels = std::make_unique<TextRenderer>(*textShader, ring);
+    std::vector<Texture2D> spriteTextures;
+    if (spriteShader)
+    {
+        spriteBatch = std::make_unique<SpriteBatch>(*spriteShader, ring);
+        for (int t = 0; t < 4; t++)
+        {
+            uint32_t texels[8 * 8];
+            for (int i = 0; i < 8 * 8; i++)
+                texels[i] = (i / 8 + i % 8 + t) % 2 ? SpriteBatch::rgba(255, 255, 255)
+                                                    : SpriteBatch::rgba(60 * t, 160, 255 - 60 * t, 200);
+            spriteTextures.emplace_back(8, 8, GL_RGBA8, 1);
+            spriteTextures.back().upload(0, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+        }
+    }
+    // CPU side transient data of a frame, the HUD's text so far (see frame_arena.cpp)
+    FrameArena frameArena;
+
+    // per-instance model matrices for the instanced path
+    InstanceBuffer instanceBuffer(ring);
+    // or an index per instance into the cubes' compact transforms
+    CompactInstances compactCubes(ring);
+    if (useCompact)
+    {
+        compactCubes.attach(cube->VAO);
+    }
+    else
+    {
+        instanceBuffer.attach(cube->VAO, 2);
+        instanceBuffer.attachLayers(6);
+    }
+    // or the same data as storage for vertex_pulling.vs
+    VertexPuller vertexPuller(ring);
+    // the per-draw path is sorted front to back already and left out
+    DepthPrepass prepass;
+    prepass.mode = depthPrepassMode;
+    prepass.depthFunc = useReversedZ ? GL_GREATER : GL_LESS;
+
+    // the cubes spin in place, cube i at 10 * (i + 1) degrees per second,
+    // alternating between the container and wall materials
+    TransformSystem cubes;
+    std::vector<int> cubeLayers;
+    // the snapshot only holds what these settings build, anything else makes its key differ
+    SceneSnapshot snapshot;
+    uint64_t snapshotKey = 0;
+    bool snapshotRestored = false;
+    if (!sceneSnapshotPath.empty() && !useWorld)
+    {
+        const uint32_t settings[] = {stressScene,
+                                     (uint32_t)stressSettings.count,
+                                     (uint32_t)stressSettings.layout,
+                                     stressSettings.spin,
+                                     (uint32_t)stressSettings.materials,
+                                     (uint32_t)stressSettings.textures,
+                                     stressSettings.seed,
+                                     usePhysics,
+                                     LAYER_COUNT,
+                                     entities::componentId<Transform>(),
+                                     entities::componentId<Renderable>(),
+                                     entities::componentId<Bounds>(),
+                                     entities::componentId<Motion>()};
+        uint64_t key = fnv1a64(settings, sizeof(settings));
+        key = fnv1a64(&stressSettings.spacing, sizeof(stressSettings.spacing), key);
+        key = fnv1a64(&cube->boundsCenter, sizeof(cube->boundsCenter), key);
+        key = fnv1a64(&cube->boundsExtent, sizeof(cube->boundsExtent), key);
+        snapshotKey = key;
+        snapshotRestored = snapshot.open(sceneSnapshotPath, key) && cubes.restore(snapshot) &&
+                           snapshot.read("cube layers", cubeLayers) && cubeLayers.size() == cubes.size();
+        if (!snapshotRestored)
+        {
+            cubes = TransformSystem();
+            cubeLayers.clear();
+        }
+    }
+    // the cube the world's proxies merge, read by its worker until the world is gone
+    MeshBuilder proxySource(OBJ_VERTEX_FLOATS);
+    std::unique_ptr<HlodProxies> hlod;
+    std::unique_ptr<WorldPartition> world;
+    if (useWorld)
+    {
+        // every slot parked until its cell comes in, far enough to see the next cells arriving
+        world = std::make_unique<WorldPartition>(cubes, worldRadius);
+        cubeLayers.assign(cubes.size(), LAYER_CONTAINER);
+        int seenRadius = worldRadius;
+        if (hlodRadius > worldRadius && renderThreadMode)
+            std::cout << "ERROR::MAIN::HLOD_NEEDS_GL_THREAD\n";
+        else if (hlodRadius > worldRadius && parseOBJ("./res/cube.obj", proxySource))
+        {
+            world->proxySource = &proxySource;
+            world->proxyRadius = hlodRadius;
+            hlod = std::make_unique<HlodProxies>();
+            seenRadius = hlodRadius;
+            std::cout << "hlod: proxies for the cells within " << hlodRadius << " of the camera\n";
+        }
+        zFar = std::max(zFar, (seenRadius + 1) * WorldPartition::CELL_SIZE * 1.5f);
+        camera.setLens(camera.aspectRatio, zNear, zFar);
+        std::cout << "world: " << cubes.size() << " cube slots for the cells within " << worldRadius
+                  << " of the camera, " << WorldPartition::CELL_SIZE << " units wide\n";
+    }
+    bool useFloatingOrigin = floatingOrigin && useWorld && terrainPath.empty() && !voxels;
+    if (floatingOrigin && !useFloatingOrigin)
+        std::cout << "ERROR::MAIN::FLOATING_ORIGIN_NEEDS_WORLD\n";
+    else if (stressScene)
+    {
+        // material 0 and 1 are the loaded images, the others the generated layers
+        if (!snapshotRestored)
+        {
+            generateStressScene(stressSettings, cubes, cubeLayers);
+            for (int &layer : cubeLayers)
+                layer = layer == 0 ? LAYER_CONTAINER : layer == 1 ? LAYER_WALL : LAYER_COUNT + layer - 2;
+        }
+        // everything in view from outside the volume
+        float radius = stressSceneRadius(stressSettings);
+        zFar = std::max(zFar, radius * 4.0f);
+        camera.position = glm::vec3(0.0f, 0.0f, radius * 1.5f);
+        camera.setLens(camera.aspectRatio, zNear, zFar);
+        if (cameraPathFile.empty())
+            cameraPath = CameraPath::orbit(glm::vec3(0.0f), radius * 1.5f, radius * 0.3f, 20.0f);
+    }
+    else if (!snapshotRestored)
+    {
+        for (int i = 0; i < 10; i++)
+        {
+            cubes.add(cubePositions[i], glm::vec3(1.0f, 0.3f, 0.5f), 10.0f * (i + 1));
+            cubeLayers.push_back(i % 2 ? LAYER_WALL : LAYER_CONTAINER);
+        }
+    }
+    // the per-frame CPU work is split into jobs of this many cubes
+    const size_t JOB_GRAIN = 1024;
+    // with --physics the cubes drop onto a ground a little below the lowest one
+    std::unique_ptr<RigidBodies> physics;
+    if (usePhysics && cubes.size() > 0)
+    {
+        physics = std::make_unique<RigidBodies>(cubes, cube->boundsExtent);
+        float lowest = (float)*std::min_element(cubes.positionY.begin(), cubes.positionY.end());
+        physics->groundHeight = lowest - glm::length(cube->boundsExtent) - 1.0f;
+        std::cout << "physics: " << physics->size() << " bodies over a ground at y = " << physics->groundHeight
+                  << '\n';
+    }
+    auto stepCubes = [&](float dt) {
+        if (physics)
+            physics->step(jobs, dt, JOB_GRAIN);
+        else
+            cubes.step(dt);
     };
-    // Texture coordinates
-    float texCoords[] = {
-        0.0f, 0.0f, // lower-left corner
-        1.0f, 0.0f, // lower-right corner
-        0.5f, 1.0f  // top-center corner
+    // every cube is a node under one root, the spinning ones get their rotation as the local
+    // matrix each frame, the others are placed once (see scene_graph.cpp)
+    SceneGraph sceneGraph;
+    // and an entity, cube i is entity i and at index i of the culling and draw lists; the
+    // spinning ones have a Motion and are one archetype, the others another (see entity_store.cpp)
+    EntityStore objects;
+    float cubeRadius = glm::length(cube->boundsExtent);
+    auto cubeSphere = [&](const glm::mat4 &model) {
+        return glm::vec4(glm::vec3(model * glm::vec4(cube->boundsCenter, 1.0f)), cubeRadius);
     };
+    cubes.interpolate(0.0f);
+    bool objectsRestored = snapshotRestored && sceneGraph.restore(snapshot) && objects.restore(snapshot) &&
+                           objects.capacity() == cubes.size();
+    if (!objectsRestored)
+    {
+        sceneGraph = SceneGraph();
+        objects.clear();
+        snapshotRestored = false;
+        sceneGraph.reserve(cubes.size() + 1);
+        uint32_t cubesRoot = sceneGraph.add(SceneGraph::NO_PARENT, glm::mat4(1.0f), true);
+        for (size_t i = 0; i < cubes.size(); i++)
+        {
+            bool spins = cubes.angularSpeed[i] != 0.0f || usePhysics || useWorld;
+            Transform transform = {cubes.models[i], sceneGraph.add(cubesRoot, cubes.models[i], !spins)};
+            Renderable renderable = {cubeLayers[i], (uint32_t)i};
+            Bounds bounds = {cubeSphere(cubes.models[i])};
+            if (spins)
+                objects.create(transform, renderable, bounds, Motion{(uint32_t)i});
+            else
+                objects.create(transform, renderable, bounds);
+        }
+    }
+    sceneGraph.build();
+    auto cubeModel = [&](size_t i) -> const glm::mat4 & { return objects.get<Transform>((Entity)i)->world; };
+    auto cubeLayer = [&](size_t i) { return objects.get<Renderable>((Entity)i)->layer; };
 
-    unsigned int VAO;
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    // the render thread records its cubes one by one, the other per-draw frames bake the static ones
+    StaticBatches staticBatches;
+    std::vector<bool> cubeBaked;
+    bool batching = staticBatching && !useIndirect && !instancedRendering && !renderThreadMode;
+    std::string batchesPath = sceneSnapshotPath + ".batches.mesh";
+    // the batches' lighting, baked at load unless a bake of the same geometry and settings is there
+    std::unique_ptr<LightmapBaker> lightmapBaker;
+    if (lightmapping && batching && LightmapBaker::isSupported())
+    {
+        lightmapBaker = std::make_unique<LightmapBaker>(shaderCompiler);
+        lightmapBaker->samples = lightmapSamples;
+        staticBatches.lightmapTexels = lightmapTexels;
+        staticBatches.lightmapSize = lightmapSize;
+    }
+    VertexLayout batchLayout = lightmapBaker ? lightmappedMeshLayout() : cookedMeshLayout();
+    // a snapshot's merged mesh has no lightmap coordinates for a lightmap it has no bake of
+    if (batching && snapshotRestored && staticBatches.restore(snapshot, batchesPath, &jobs) &&
+        (!lightmapBaker ||
+         (staticBatches.lightmapKey != 0 && LightmapBaker::exists(lightmapBaker->key(staticBatches.lightmapKey)))))
+    {
+        cubeBaked.assign(cubes.size(), false);
+        for (size_t i = 0; i < cubes.size() && staticBatches.mesh; i++)
+            cubeBaked[i] = cubes.angularSpeed[i] == 0.0f && !usePhysics;
+        std::cout << "static batching: " << staticBatches.objects << " cubes in " << staticBatches.batches.size()
+                  << " batches, from the scene snapshot\n";
+        phaseStart = startupTimeline.phase("static batches", phaseStart);
+    }
+    else if (batching)
+    {
+        // a snapshot without the batches is written again with them
+        snapshotRestored = false;
+        staticBatches.keepMerged = !sceneSnapshotPath.empty() && !useWorld;
+        MeshBuilder cubeSource(OBJ_VERTEX_FLOATS);
+        if (parseOBJ("./res/cube.obj", cubeSource))
+        {
+            cubeBaked.assign(cubes.size(), false);
+            for (size_t i = 0; i < cubes.size(); i++)
+            {
+                if (cubes.angularSpeed[i] != 0.0f || usePhysics || useWorld)
+                    continue;
+                staticBatches.add(cubeModel(i), cubeLayer(i));
+                cubeBaked[i] = true;
+            }
+            if (!staticBatches.build(cubeSource, batchLayout))
+                cubeBaked.assign(cubes.size(), false);
+            std::cout << "static batching: " << staticBatches.objects << " cubes in " << staticBatches.batches.size()
+                      << " batches\n";
+        }
+        phaseStart = startupTimeline.phase("static batches", phaseStart);
+    }
+    if (snapshotKey != 0 && !snapshotRestored)
+    {
+        SceneSnapshotWriter written(snapshotKey);
+        cubes.save(written);
+        written.add("cube layers", cubeLayers);
+        sceneGraph.save(written);
+        objects.save(written);
+        if ((batching && !staticBatches.save(written, batchesPath, batchLayout)) ||
+            !written.write(sceneSnapshotPath))
+            std::cout << "ERROR::SCENE_SNAPSHOT::NOT_WRITTEN: " << sceneSnapshotPath << '\n';
+        else
+            std::cout << "scene snapshot: " << cubes.size() << " cubes written to " << sceneSnapshotPath << '\n';
+        phaseStart = startupTimeline.phase("scene snapshot", phaseStart);
+    }
+    else if (snapshotRestored)
+    {
+        std::cout << "scene snapshot: " << cubes.size() << " cubes from " << sceneSnapshotPath << '\n';
+    }
+    // the static cubes' triangles in world space, instance i of cube i
+    std::unique_ptr<TriangleBvh> triangleBvh;
+    if (rayBvh && TriangleBvh::isSupported())
+    {
+        MeshBuilder cubeSource(OBJ_VERTEX_FLOATS);
+        if (parseOBJ("./res/cube.obj", cubeSource))
+        {
+            triangleBvh = std::make_unique<TriangleBvh>();
+            for (size_t i = 0; i < cubes.size(); i++)
+            {
+                if (cubes.angularSpeed[i] == 0.0f && !usePhysics && !useWorld)
+                    triangleBvh->add(cubeSource, cubeModel(i), (uint32_t)i);
+            }
+            double buildStart = glfwGetTime();
+            triangleBvh->build(jobs);
+            std::cout << "ray bvh: " << triangleBvh->triangles.size() << " triangles in " << triangleBvh->nodes.size()
+                      << " nodes, cost " << triangleBvh->cost() << ", built in "
+                      << (glfwGetTime() - buildStart) * 1000.0 << " ms\n";
+            triangleBvh->upload();
+        }
+        phaseStart = startupTimeline.phase("ray bvh", phaseStart);
+    }
+    const Texture2D *lightmap = NULL;
+    if (lightmapBaker && staticBatches.mesh && staticBatches.lightmapKey != 0)
+    {
+        uint64_t key = lightmapBaker->key(staticBatches.lightmapKey);
+        std::string lightmapPath = LightmapBaker::sourcePath(key);
+        if (!LightmapBaker::exists(key) && triangleBvh && staticBatches.merged())
+        {
+            std::string bakedPath = cookedTexturePath(lightmapPath);
+            if (lightmapBaker->bake(*staticBatches.merged(), lightmapSize, *triangleBvh, bakedPath))
+                std::cout << "lightmap: " << lightmapBaker->texels << " texels baked in " << lightmapBaker->bakeMs
+                          << " ms to " << bakedPath << '\n';
+            else
+                std::cout << "ERROR::LIGHTMAP::NOT_BAKED: " << bakedPath << '\n';
+        }
+        staticBatches.releaseMerged();
+        if (LightmapBaker::exists(key))
+            lightmap = &textureLoader.load(lightmapPath.c_str());
+        phaseStart = startupTimeline.phase("lightmap", phaseStart);
+    }
+    // the batches with a lightmap draw with the lightmapped variant of the cubes' program
+    std::unique_ptr<ShaderVariants> lightmapShaders;
+    Shader *lightmapShader = NULL;
+    const SamplerDesc lightmapSamplerDesc = {GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE,
+                                             1.0f};
+    if (lightmap)
+    {
+        lightmapShaders = std::make_unique<ShaderVariants>(shaderCompiler, "src/shader_src/vertex_shader.vs",
+                                                           "src/shader_src/fragment_shader.fs",
+                                                           std::vector<std::string>{LightmappedVertex::glslDefine()});
+        lightmapShader = &lightmapShaders->get(materialFeature | SHADER_LIGHTMAP);
+    }
+    std::vector<std::vector<uint32_t>> visibleRanges;
+    AnimatedInstances animatedCubes;
+    if (useGpuAnimation)
+        animatedCubes.create(*cube, cubes, cubeLayers);
+    // the cubes hang under an identity root, their TransformSystem matrices are their world ones
+    if (useCompact)
+    {
+        cubes.writeCompact();
+        for (size_t i = 0; i < cubes.size(); i++)
+            cubes.compact[i].layer = (uint16_t)cubeLayers[i];
+        compactCubes.create(cubes.size());
+    }
 
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
+    FixedTimestep simulationClock(simulationHz);
+    SimulationThread simulationThread;
+    if (threadedSimulation && !useGpuAnimation)
+        simulationThread.start(simulationHz, [&](double dt) { stepCubes((float)dt); });
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    // the lights circle around random cubes, the decals go on them
+    LightSet lightSet;
+    DecalSet decalSet;
+    if (useDeferred || useClustered)
+    {
+        std::vector<glm::vec3> anchors;
+        for (size_t i = 0; i < cubes.size(); i++)
+            anchors.push_back(glm::vec3(cubes.positionX[i], cubes.positionY[i], cubes.positionZ[i]));
+        // the streamed cubes aren't in yet, the lights go around the first cells' centers
+        if (world)
+        {
+            anchors.clear();
+            for (int z = -worldRadius; z <= worldRadius; z++)
+                for (int x = -worldRadius; x <= worldRadius; x++)
+                    anchors.push_back(glm::vec3(x + 0.5f, 0.0f, z + 0.5f) * WorldPartition::CELL_SIZE);
+        }
+        lightSet.scatter((size_t)lightCount, anchors, 4.0f, 1);
+        if (useClustered)
+            decalSet.scatter((size_t)decalCount, anchors, 1.5f, LAYER_FACE, 2);
+    }
+    GBuffer gbuffer;
+    gbuffer.precision = gbufferPrecision;
+    std::unique_ptr<DeferredLighting> lighting;
+    Shader *ambientShader = NULL;
+    std::unique_ptr<RayTracedShadows> rayShadows;
+    if (useDeferred)
+    {
+        uint32_t ambientFeatures = (useShadows ? SHADER_SUN_SHADOWS : 0) |
+                                   (environment ? SHADER_ENVIRONMENT_LIGHTING : 0) |
+                                   (useRayShadows && triangleBvh ? SHADER_RAY_TRACED_SHADOWS : 0);
+        ambientShader = &shaderCompiler.submit("src/shader_src/fullscreen.vs", "src/shader_src/deferred_ambient.fs",
+                                               shaderFeatureDefines(ambientFeatures));
+        lighting = std::make_unique<DeferredLighting>(
+            ring, *ambientShader,
+            shaderCompiler.submit("src/shader_src/light_volume.vs", "src/shader_src/deferred_light.fs"));
+        if (ambientFeatures & SHADER_RAY_TRACED_SHADOWS)
+        {
+            rayShadows = std::make_unique<RayTracedShadows>(shaderCompiler, *triangleBvh);
+            rayShadows->attach(*ambientShader);
+        }
+    }
+    std::unique_ptr<ParticleSystem> particles;
+    if (particleCount > 0 && ParticleSystem::isSupported())
+    {
+        particles = std::make_unique<ParticleSystem>(
+            particleCount, shaderCompiler.submitCompute("src/shader_src/particle_emit.comp"),
+            shaderCompiler.submitCompute("src/shader_src/particle_prepare.comp"),
+            shaderCompiler.submitCompute("src/shader_src/particle_simulate.comp"),
+            shaderCompiler.submit("src/shader_src/particle.vs", "src/shader_src/particle.fs"));
+        // as many emitted per second as die, so the fountain stays full
+        particles->emitRate = particleCount / ((particles->minLife + particles->maxLife) * 0.5f);
+        particles->emitter = glm::vec3(0.0f, -2.0f, -4.0f);
+        particles->floorHeight = -3.0f;
+    }
+    std::unique_ptr<Terrain> terrain;
+    std::unique_ptr<VirtualTexture> virtualTexture;
+    if (!terrainPath.empty())
+    {
+        if (!virtualTexturePath.empty())
+        {
+            virtualTexture = std::make_unique<VirtualTexture>();
+            if (!virtualTexture->open(virtualTexturePath, virtualCacheSlots))
+                virtualTexture.reset();
+        }
+        std::vector<std::string> defines;
+        if (virtualTexture)
+            defines.push_back("VIRTUAL_TEXTURE");
+        Shader &terrainShader = shaderCompiler.submit("src/shader_src/terrain.vs", "src/shader_src/terrain.fs", defines);
+        terrain = std::make_unique<Terrain>(ring, terrainShader, textureLoader.load(terrainPath.c_str(), false));
+        if (virtualTexture)
+        {
+            Shader &feedbackShader =
+                shaderCompiler.submit("src/shader_src/terrain.vs", "src/shader_src/virtual_feedback.fs");
+            virtualTexture->setup(terrainShader, false);
+            virtualTexture->setup(feedbackShader, true);
+            virtualTexture->depthFunc = useReversedZ ? GL_GREATER : GL_LESS;
+            terrain->setFeedbackProgram(feedbackShader);
+        }
+        terrain->size = terrainSize;
+        terrain->origin = glm::vec3(-terrainSize * 0.5f, -8.0f, -terrainSize * 0.5f);
+        terrain->heightScale = terrainSize / 25.0f;
+        // the far corners of the terrain still in view
+        zFar = std::max(zFar, terrainSize * 1.5f);
+        camera.setLens(camera.aspectRatio, zNear, zFar);
+    }
+    std::unique_ptr<ProceduralScatter> scatter;
+    if (scatterPerTile > 0 && !terrain)
+        std::cout << "ERROR::MAIN::SCATTER_NEEDS_TERRAIN\n";
+    else if (scatterPerTile > 0 && ProceduralScatter::isSupported())
+    {
+        scatter = std::make_unique<ProceduralScatter>(
+            *terrain, scatterPerTile, shaderCompiler.submitCompute("src/shader_src/scatter.comp"),
+            shaderCompiler.submit("src/shader_src/scatter.vs", "src/shader_src/scatter.fs"));
+        scatter->setHiZ(hiZ.get());
+        if (!scatterDensityPath.empty())
+            scatter->setDensityMap(&textureLoader.load(scatterDensityPath.c_str(), false));
+    }
+    std::unique_ptr<Ocean> ocean;
+    if (oceanResolution > 0 && Ocean::isSupported())
+    {
+        ocean = std::make_unique<Ocean>(ring, oceanResolution,
+                                        shaderCompiler.submitCompute("src/shader_src/ocean_spectrum.comp"),
+                                        shaderCompiler.submitCompute("src/shader_src/ocean_fft.comp"),
+                                        shaderCompiler.submitCompute("src/shader_src/ocean_resolve.comp"),
+                                        shaderCompiler.submit("src/shader_src/ocean.vs", "src/shader_src/ocean.fs"));
+        ocean->size = oceanSize;
+        if (terrain)
+        {
+            ocean->seaLevel = terrain->origin.y + terrain->heightScale * 0.25f;
+            ocean->sunDirection = terrain->sunDirection;
+        }
+        // the grid's far edge from its center, which trails the camera by up to a step
+        zFar = std::max(zFar, oceanSize * 0.75f);
+        camera.setLens(camera.aspectRatio, zNear, zFar);
+    }
+    std::unique_ptr<LightClusters> clusters;
+    if (useClustered)
+        clusters = std::make_unique<LightClusters>(ring, shaderCompiler.submitCompute("src/shader_src/cluster_lights.comp"));
+    // lit with the shadows the cubes are
+    std::unique_ptr<VolumetricFog> fog;
+    if (useFog)
+    {
+        fog = std::make_unique<VolumetricFog>(
+            shaderCompiler, shaderFeatureDefines(cubeFragmentFeatures & (SHADER_SUN_SHADOWS | SHADER_POINT_SHADOWS)));
+        fog->density = fogDensity;
+        for (Shader *program : {&instancedShader, indirectShader, voxelShader})
+        {
+            if (program)
+                fog->attach(*program);
+        }
+    }
+    // the HDR frame to a bright half resolution copy, a quarter one blurred along x and then y
+    // (ping-ponging between two pooled targets) and the composite into the window
+    std::unique_ptr<PostProcessGraph> post;
+    // the bloom's passes and their scales, for the quality governor
+    std::vector<std::pair<int, float>> bloomPasses;
+    // the occlusion passes go first, bloom and composite read the occluded frame; the stereo
+    // eyes would each need their own projection
+    std::unique_ptr<AmbientOcclusion> ssao;
+    // the reflections after them, of the occluded frame
+    std::unique_ptr<ScreenSpaceReflections> reflections;
+    // measures the frame the bloom and composite read, its texture goes last into the composite
+    std::unique_ptr<AutoExposure> exposureMeter;
+    if (postProcessing)
+    {
+        Shader &downsample = shaderCompiler.submit("src/shader_src/post.vs", "src/shader_src/post_downsample.fs");
+        Shader &blur = shaderCompiler.submit("src/shader_src/post.vs", "src/shader_src/post_blur.fs");
+        bool useAutoExposure = autoExposure && AutoExposure::isSupported();
+        std::vector<std::string> compositeDefines;
+        if (useAutoExposure)
+            compositeDefines = {"AUTO_EXPOSURE", bloomStrength > 0.0f ? "EXPOSURE_INPUT 2" : "EXPOSURE_INPUT 1"};
+        Shader &composite =
+            shaderCompiler.submit("src/shader_src/post.vs", "src/shader_src/post_composite.fs", compositeDefines);
+        post = std::make_unique<PostProcessGraph>();
+        int lit = PostProcessGraph::SOURCE;
+        if (ambientOcclusion && downsampler && AmbientOcclusion::isSupported() && !useStereo)
+        {
+            ssao = std::make_unique<AmbientOcclusion>(shaderCompiler, *downsampler, useReversedZ);
+            lit = ssao->addPasses(*post, PostProcessGraph::SOURCE);
+        }
+        if (useReflections && hiZ)
+        {
+            reflections = std::make_unique<ScreenSpaceReflections>(shaderCompiler, environment.get(), useReversedZ);
+            lit = reflections->addPasses(*post, lit);
+        }
+        int bright = post->addPass("bloom threshold", downsample, {lit}, 0.5f, GL_R11F_G11F_B10F,
+                                   glm::vec4(0.8f, 0.4f, 0.0f, 0.0f));
+        int quarter = post->addPass("bloom downsample", downsample, {bright}, 0.25f, GL_R11F_G11F_B10F);
+        int blurX = post->addPass("bloom blur x", blur, {quarter}, 0.25f, GL_R11F_G11F_B10F,
+                                  glm::vec4(1.0f, 0.0f, 0.0f, 0.0f));
+        int blurY = post->addPass("bloom blur y", blur, {blurX}, 0.25f, GL_R11F_G11F_B10F,
+                                  glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+        bloomPasses = {{bright, 0.5f}, {quarter, 0.25f}, {blurX, 0.25f}, {blurY, 0.25f}};
+        // without the bloom in the composite nothing reads the bloom passes, the frame graph culls them
+        std::vector<int> composited = {lit};
+        if (bloomStrength > 0.0f)
+            composited.push_back(blurY);
+        if (useAutoExposure)
+        {
+            exposureMeter = std::make_unique<AutoExposure>(shaderCompiler);
+            composited.push_back(exposureMeter->addPasses(*post, lit, downsample));
+        }
+        post->addOutput("tone map", composite, composited, glm::vec4(exposure, bloomStrength, 0.0f, 0.0f));
+    }
+    // the scale of the scene follows the GPU frame time, the frame is upscaled in place of the blit
+    std::unique_ptr<DynamicResolution> dynamicScale;
+    if (dynamicResolution)
+    {
+        dynamicScale = std::make_unique<DynamicResolution>(
+            shaderCompiler.submit("src/shader_src/post.vs", "src/shader_src/upscale_bilinear.fs"),
+            shaderCompiler.submit("src/shader_src/post.vs", "src/shader_src/upscale_easu.fs"),
+            shaderCompiler.submit("src/shader_src/post.vs", "src/shader_src/upscale_rcas.fs"));
+        dynamicScale->targetFrameTime = targetFrameTime;
+        dynamicScale->filter = upscaleFilter;
+    }
+    // the cubes whose model matrix changed since the last frame get motion vectors of their own
+    std::unique_ptr<TemporalAA> taa;
+    std::vector<glm::mat4> previousModels;
+    std::vector<InstanceMotion> motions;
+    // the side by side eyes would reproject with the camera's matrices
+    if (useTemporalAA && !useStereo)
+    {
+        taa = std::make_unique<TemporalAA>(
+            ring, shaderCompiler.submit("src/shader_src/velocity.vs", "src/shader_src/velocity.fs"),
+            shaderCompiler.submit("src/shader_src/post.vs", "src/shader_src/taa_resolve.fs"));
+        taa->reversedZ = useReversedZ;
+    }
+    // the frame is drawn into the multisampled target while an MSAA mode is on
+    MultisampleTarget msaaTarget;
+    Fxaa fxaa(shaderCompiler.submit("src/shader_src/post.vs", "src/shader_src/fxaa.fs"));
+    FrameCapture capture;
+    if (!videoPath.empty())
+        capture.start(videoPath, recordFps);
+    std::unique_ptr<GpuPicker> picker;
+    // the cubes inside the pick region
+    std::vector<uint32_t> pickCandidates;
+    if (gpuPicking)
+    {
+        picker = std::make_unique<GpuPicker>(shaderCompiler.submit("src/shader_src/pick.vs", "src/shader_src/pick.fs"));
+        picker->depthFunc = useReversedZ ? GL_GREATER : GL_LESS;
+    }
+    // --benchmark-aa: the GPU frame times of every mode, the frames are split evenly between the modes
+    int benchmarkModeFrames = std::max(1, benchmarkFrames / AA_MODE_COUNT);
+    int modeFrame = 0;
+    if (benchmarking && benchmarkAntiAliasing)
+        antiAliasing = AA_OFF;
+    // the cubes that spin change their shadows every frame, the cached cascades look for them
+    std::unique_ptr<CascadedShadowMaps> shadows;
+    std::vector<glm::vec4> dynamicCasters;
+    if (useShadows)
+    {
+        shadows = std::make_unique<CascadedShadowMaps>(ring, shadowMapSize);
+        shadows->depthFunc = useReversedZ ? GL_GREATER : GL_LESS;
+        shadows->lightDirection = lighting ? lighting->sunDirection : clusters->sunDirection;
+        Shader *receivers[] = {ambientShader, useClustered ? &instancedShader : NULL,
+                               useClustered ? indirectShader : NULL, fog ? &fog->lightingProgram() : NULL};
+        for (Shader *program : receivers)
+        {
+            if (program)
+                shadows->attach(*program);
+        }
+    }
+    std::unique_ptr<PointShadowAtlas> pointShadowAtlas;
+    if (usePointShadows)
+    {
+        pointShadowAtlas = std::make_unique<PointShadowAtlas>(ring, pointShadowAtlasSize);
+        pointShadowAtlas->faceBudget = pointShadowFaces;
+        pointShadowAtlas->depthFunc = useReversedZ ? GL_GREATER : GL_LESS;
+        for (Shader *program : {&instancedShader, indirectShader, voxelShader, fog ? &fog->lightingProgram() : NULL})
+        {
+            if (program)
+                pointShadowAtlas->attach(*program);
+        }
+    }
+    if (environment)
+    {
+        SkyDesc sky;
+        sky.sunDirection = lighting ? lighting->sunDirection : clusters->sunDirection;
+        environment->build(sky);
+        Shader *programs[] = {ambientShader, useClustered ? &instancedShader : NULL,
+                              useClustered ? indirectShader : NULL, useClustered ? voxelShader : NULL};
+        for (Shader *program : programs)
+        {
+            if (program)
+                environment->attach(*program);
+        }
+    }
 
-    // vertex positions
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
-    // glVertexAttribPointer()
-    glEnableVertexAttribArray(0);
+    // the CPU paths draw only the cubes whose bounding spheres touch the frustum
+    FrustumCuller culler;
+    culler.resize(cubes.size());
+    // the same spheres in a hierarchy, the draw indices of the moving ones refit it every frame
+    BoundingVolumeHierarchy bvh;
+    std::vector<glm::vec4> cubeSpheres(cubes.size());
+    std::vector<uint32_t> movingCubes;
+    objects.each<Renderable, Bounds>([&](Entity entity, const Renderable &renderable, const Bounds &bounds) {
+        culler.setSphere(renderable.drawIndex, glm::vec3(bounds.sphere), bounds.sphere.w);
+        cubeSpheres[renderable.drawIndex] = bounds.sphere;
+        if (objects.get<Motion>(entity))
+            movingCubes.push_back(renderable.drawIndex);
+    });
+    if (bvhCulling)
+        bvh.build(cubeSpheres);
+    // the move input made this frame, from where the camera was before it
+    auto collideCamera = [&](const glm::vec3 &from) {
+        if (cameraCollision && bvhCulling)
+            camera.position = bvh.slideSphere(from, camera.position, cameraRadius);
+    };
+    // the cubes don't leave the spheres they were placed with, so they keep their cells
+    std::unique_ptr<CellPortals> cells;
+    if (!cellsPath.empty() && (usePhysics || useWorld))
+        std::cout << "ERROR::MAIN::CELLS_NEED_STATIC_CUBES\n";
+    else if (!cellsPath.empty())
+    {
+        cells = std::make_unique<CellPortals>();
+        if (cells->load(cellsPath))
+        {
+            cells->assign(culler);
+            std::cout << "cells: " << cells->cells.size() << ", portals: " << cells->portals.size()
+                      << (cells->pvs.empty() ? ", no PVS\n" : ", with PVS\n");
+        }
+        else
+            cells.reset();
+    }
+    // the moving objects only, array by array: their rotations into the hierarchy, then their
+    // world matrices and bounding spheres back out, the static ones were placed once above
+    auto updateObjects = [&]() {
+        objects.eachChunk<Motion, Transform>([&](size_t count, const Entity *, Motion *motion, Transform *transform) {
+            jobs.parallelFor(0, count, JOB_GRAIN, [&](size_t first, size_t last) {
+                for (size_t n = first; n < last; n++)
+                    sceneGraph.setLocal(transform[n].node, cubes.models[motion[n].body]);
+            });
+        });
+        sceneGraph.update(jobs, JOB_GRAIN);
+        objects.eachChunk<Motion, Transform, Bounds, Renderable>(
+            [&](size_t count, const Entity *, Motion *, Transform *transform, Bounds *bounds, Renderable *renderable) {
+                jobs.parallelFor(0, count, JOB_GRAIN, [&](size_t first, size_t last) {
+                    for (size_t n = first; n < last; n++)
+                    {
+                        transform[n].world = sceneGraph.world(transform[n].node);
+                        bounds[n].sphere = cubeSphere(transform[n].world);
+                        culler.setSphere(renderable[n].drawIndex, glm::vec3(bounds[n].sphere), cubeRadius);
+                        if (bvhCulling)
+                            bvh.setSphere(renderable[n].drawIndex, bounds[n].sphere);
+                    }
+                });
+            });
+        if (bvhCulling)
+            bvh.refit(movingCubes.data(), movingCubes.size());
+    };
+    // the cells around the camera after dt seconds, the simulation thread off the cubes meanwhile;
+    // the slots they filled get their material's layer, updateObjects() picks up the rest
+    // the camera and the cubes' models relative to it, world positions are renderOrigin.toWorld()
+    FloatingOrigin renderOrigin;
+    auto streamWorld = [&](float dt) {
+        if (!world)
+            return;
+        std::lock_guard<std::mutex> lock(simulationThread.mutex);
+        world->update(renderOrigin.toWorld(camera.position), dt);
+        for (uint32_t slot : world->changed)
+            objects.get<Renderable>((Entity)slot)->layer = world->materials[slot] ? LAYER_WALL : LAYER_CONTAINER;
+        if (hlod)
+        {
+            for (glm::ivec2 cell : world->droppedProxies)
+                hlod->remove(cell);
+            for (const HlodProxy &proxy : world->newProxies)
+                hlod->add(proxy, cookedMeshLayout());
+        }
+    };
+    // with --floating-origin the origin moves along once the camera is far from it: the models
+    // are rebuilt relative to the new one and the lights and decals taken along, updateObjects()
+    // brings the spheres the culling and the hierarchy test after
+    auto recenterOrigin = [&]() {
+        if (!useFloatingOrigin || !renderOrigin.recenter(camera.position))
+            return;
+        std::lock_guard<std::mutex> lock(simulationThread.mutex);
+        cubes.setOrigin(renderOrigin.origin);
+        lightSet.translate(-renderOrigin.shift);
+        decalSet.translate(-renderOrigin.shift);
+    };
+    // the cube in the middle of the view, the ray cast along camera.front
+    uint32_t pickedCube = 0;
+    float pickedDistance = 0.0f;
+    bool cubePicked = false;
+    std::vector<glm::mat4> visibleModels;
+    // culler.visible split by the impostor distance
+    std::vector<uint32_t> nearCubes, farCubes;
+    std::vector<uint32_t> shadowCasters;
+    std::vector<int> visibleLayers;
+    // only the per-draw path queries
+    OcclusionQueries occlusion;
+    if (!useIndirect && !instancedRendering)
+        occlusion.resize(cubes.size());
+    // the indirect path culls on the GPU
+    bool useSoftwareOcclusion = softwareOcclusion && !useIndirect;
+    SoftwareOcclusion occluders;
 
-    //// vertex colors
-    // glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    // glEnableVertexAttribArray(1);
+    instancedShader.use();
+    instancedShader.setInt("materials", 0);
+    instancedShader.setInt("decalLayer", LAYER_FACE);
 
-    // textures st-s
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    shader.use();
+    shader.setInt("materials", 0);
+    shader.setInt("decalLayer", LAYER_FACE);
 
-    unsigned int EBO;
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    if (lightmapShader)
+    {
+        lightmapShader->use();
+        lightmapShader->setInt("materials", 0);
+        lightmapShader->setInt("decalLayer", LAYER_FACE);
+        lightmapShader->setInt("lightmap", LightmapBaker::TEXTURE_UNIT);
+    }
 
-    shader.use();
-    glUniform1i(glGetUniformLocation(shader.ID, "texture1"), 0);
-    shader.setInt("texture2", 1);
+    if (bindlessShader)
+    {
+        bindlessShader->use();
+        bindlessShader->setInt("decalLayer", LAYER_FACE);
+    }
+    if (animatedShader)
+    {
+        animatedShader->use();
+        animatedShader->setInt("materials", 0);
+        animatedShader->setInt("decalLayer", LAYER_FACE);
+        animatedShader->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+        animatedDepthShader->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+    }
+    if (useCompact)
+    {
+        for (Shader *program : {&instancedShader, &instancedDepthShader, overdrawShader})
+        {
+            if (!program)
+                continue;
+            program->use();
+            program->setInt("compactTransforms", CompactInstances::TEXTURE_UNIT);
+        }
+    }
+
+    for (Shader *program : {&shader, &instancedShader, bindlessShader, &instancedDepthShader, animatedShader,
+                            animatedDepthShader, overdrawShader})
+    {
+        if (!program)
+            continue;
+        program->use();
+        program->setVec3("boundsCenter", cube->boundsCenter);
+        program->setVec3("boundsExtent", cube->boundsExtent);
+    }
+
+    // resolving the per-object uniforms once, outside of the render loop
+    UniformHandle modelLoc = shader.uniform("model");
+    UniformHandle layerLoc = shader.uniform("layer");
+    // the cube bounds are set once, but with separable programs the scene's pipeline shares the
+    // vertex program and its draws overwrite them, so they are put back after a scene draw
+    UniformHandle boundsCenterLoc = shader.uniform("boundsCenter");
+    UniformHandle boundsExtentLoc = shader.uniform("boundsExtent");
+    bool cubeBoundsCurrent = true;
+    // the static batches' program and its handles, the cubes' one without a lightmap
+    Shader &batchShader = lightmapShader ? *lightmapShader : shader;
+    UniformHandle batchModelLoc = batchShader.uniform("model");
+    UniformHandle batchLayerLoc = batchShader.uniform("layer");
+    UniformHandle batchBoundsCenterLoc = batchShader.uniform("boundsCenter");
+    UniformHandle batchBoundsExtentLoc = batchShader.uniform("boundsExtent");
+
+    // the scene streams in over the first frames, each primitive is drawn once it arrives
+    std::unique_ptr<GltfScene> scene;
+    std::unique_ptr<ShaderVariants> sceneShaders, skinnedShaders;
+    std::unique_ptr<SkinningSystem> skinning;
+    std::unique_ptr<ShaderVariants> crowdShaders;
+    std::unique_ptr<VertexAnimations> crowd;
+    const SamplerDesc sceneSamplerDesc = {GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_REPEAT, GL_REPEAT, 16.0f};
+    const Sampler *sceneSampler = &samplerCache.get(sceneSamplerDesc);
+    // one per variant of scene.fs, the alpha tested one is only built once a MASK material shows up,
+    // the skinned ones once a skin plays without pre-skinning, the crowd ones once a crowd is baked,
+    // the weighted ones once a BLEND one does
+    enum SceneVertices
+    {
+        SCENE_RIGID,
+        SCENE_SKINNED,
+        SCENE_CROWD
+    };
+    struct SceneProgram
+    {
+        Shader *shader = NULL;
+        UniformHandle model, boundsCenter, boundsExtent, baseColor, alphaCutoff, firstJoint, firstTexel, frameTexels;
+    };
+    SceneProgram scenePrograms[3][2][2];
+    std::unique_ptr<WeightedBlendedOIT> oit;
+    if (!scenePath.empty())
+    {
+        scene = std::make_unique<GltfScene>(textureLoader, jobs);
+        scene->load(scenePath);
+        sceneShaders =
+            std::make_unique<ShaderVariants>(shaderCompiler, "src/shader_src/vertex_shader.vs", "src/shader_src/scene.fs",
+                                             cookedInputs);
+        // without it the skinned primitives are drawn rigid, in their bind pose
+        if (SkinningSystem::isSupported())
+        {
+            skinnedShaders =
+                std::make_unique<ShaderVariants>(shaderCompiler, "src/shader_src/skinned.vs", "src/shader_src/scene.fs",
+                                                 std::vector<std::string>{SkinnedVertex::glslDefine()});
+            skinning = std::make_unique<SkinningSystem>(*scene, ring,
+                                                        shaderCompiler.submitCompute("src/shader_src/skin.comp"));
+            skinning->preSkinning = preSkinning;
+            if (crowdSize > 0)
+            {
+                crowdShaders = std::make_unique<ShaderVariants>(
+                    shaderCompiler, "src/shader_src/crowd.vs", "src/shader_src/scene.fs",
+                    std::vector<std::string>{SkinnedVertex::glslDefine()});
+                crowd = std::make_unique<VertexAnimations>(*scene,
+                                                           shaderCompiler.submitCompute("src/shader_src/skin.comp"));
+            }
+        }
+        if (weightedTransparency && WeightedBlendedOIT::isSupported())
+            oit = std::make_unique<WeightedBlendedOIT>(
+                shaderCompiler.submit("src/shader_src/fullscreen.vs", "src/shader_src/oit_composite.fs"));
+    }
+    // vertices is a SceneVertices, a bool for the rigid and skinned ones
+    auto sceneProgram = [&](bool masked, int vertices, bool weighted = false) -> SceneProgram & {
+        SceneProgram &program = scenePrograms[vertices][masked][weighted];
+        if (program.shader)
+            return program;
+        ShaderVariants &variants = vertices == SCENE_CROWD     ? *crowdShaders
+                                   : vertices == SCENE_SKINNED ? *skinnedShaders
+                                                               : *sceneShaders;
+        program.shader = &variants.get((masked ? SHADER_ALPHA_TEST : 0) | (weighted ? SHADER_WEIGHTED_OIT : 0));
+        program.shader->use();
+        program.shader->setInt("baseColorTexture", 1);
+        program.shader->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+        program.model = program.shader->uniform("model");
+        program.boundsCenter = program.shader->uniform("boundsCenter");
+        program.boundsExtent = program.shader->uniform("boundsExtent");
+        program.baseColor = program.shader->uniform("baseColorFactor");
+        program.alphaCutoff = program.shader->uniform("alphaCutoff");
+        program.firstJoint = program.shader->uniform("firstJoint");
+        program.firstTexel = program.shader->uniform("firstTexel");
+        program.frameTexels = program.shader->uniform("frameTexels");
+        if (vertices == SCENE_CROWD)
+            crowd->attach(*program.shader);
+        return program;
+    };
+    if (scene)
+        sceneProgram(false, false);
+    if (skinning && !preSkinning)
+        sceneProgram(false, true);
+
+    // every program is submitted by now, the benchmark waits for them
+    // so their creation time is measured in one piece
+    if (benchmarking)
+    {
+        shaderCompiler.finishAll();
+        benchmark.shaderMs = (float)shaderCompiler.buildMilliseconds();
+    }
+    if (shaderStats)
+        printShaderStats(std::cout, shaderCompiler.stats(), 24);
+
+    // camera matrices reach every program through one uniform buffer
+    FrameDataBuffer frameDataBuffer(ring);
+    FrameData frameData = {};
+    shader.bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+    if (lightmapShader)
+        lightmapShader->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+    instancedShader.bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+    if (bindlessShader)
+        bindlessShader->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+    if (indirectShader)
+        indirectShader->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+    instancedDepthShader.bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+    if (overdrawShader)
+        overdrawShader->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+    if (indirectDepthShader)
+        indirectDepthShader->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+    if (voxelShader)
+        voxelShader->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+    if (cullShader)
+        cullShader->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+    if (meshletCullShader)
+        meshletCullShader->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+    if (impostorShader)
+        impostorShader->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+    for (Shader *viewsShader : {multiViewShader, stereoShader})
+    {
+        if (!viewsShader)
+            continue;
+        viewsShader->bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+        viewsShader->bindUniformBlock("Views", MultiView::BINDING);
+    }
+    // the programs share frame_data.glsl, so one of them tells whether the struct still matches it
+    checkBlockLayout("FrameData", shader.uniformBlock("FrameData"), FRAME_DATA_LAYOUT, STD140);
 
     // GLM TESTING
     glm::mat4 model = glm::mat4(1.0f);
@@ -205,90 +2709,1739 @@ int main()
     model = glm::rotate(model, glm::radians(-55.0f), glm::vec3(1.0f, 0.0f, 0.0f));
     projection = glm::perspective(glm::radians(fov), aspectRatio, zNear, zFar);
 
-    shader.setMat4("model", model);
-    shader.setMat4("view", view);
-    shader.setMat4("projection", projection);
+    shader.use();
+    shader.set(modelLoc, model);
+
+    // draws that go through the render queue, sorted every frame
+    RenderQueue renderQueue;
+    enum DrawSource
+    {
+        DRAW_CUBE,
+        DRAW_SCENE,
+        DRAW_SKINNED,
+        DRAW_CROWD,
+        DRAW_STATIC,
+        DRAW_HLOD
+    };
+    glState.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // state cache counters are shown in the window title once per second
+    double lastTitleUpdate = 0.0;
+    GpuProfiler gpuProfiler;
+    if (pipelineStatistics && !gpuProfiler.enableStatistics())
+        std::cout << "ERROR::GPU_PROFILER::NO_PIPELINE_STATISTICS\n";
+    double lastProfileReport = 0.0;
+    HitchDetector hitchDetector;
+    hitchDetector.threshold = hitchThreshold;
+    gpuProfiler.history = detectHitches;
+    TelemetryServer telemetry;
+    if (telemetryPort > 0)
+        telemetry.listen(telemetryPort);
+
+    FileWatcher shaderWatcher;
+    bool watchingShaders = shaderHotReload && !benchmarking && shaderWatcher.watch("src/shader_src");
+
+    startupTimeline.phase("scene setup", phaseStart);
 
+    // Render thread mode: this thread polls input, simulates, culls and records the frame,
+    // the render thread replays it while the next one is recorded. Occlusion queries and
+    // Hi-Z read GL results back, so they are left out here.
+    if (renderThreadMode && !useIndirect && !instancedRendering && !scene && !benchmarking)
+    {
+        // everything the recorded calls reach on the render thread
+        struct FrameContext
+        {
+            TextureLoader *textureLoader;
+            RingBuffer *ring;
+            FrameDataBuffer *frameDataBuffer;
+            RenderTarget *sceneTarget;
+            bool reversedZ;
+        } context = {&textureLoader, &ring, &frameDataBuffer, &sceneTarget, useReversedZ};
+        struct FrameBegin
+        {
+            FrameData frameData;
+            int width, height;
+        };
+
+        // every cube draw binds the same pipeline and material table
+        PipelineState cubePipeline;
+        cubePipeline.shader = &shader;
+        cubePipeline.vertexArray = cube->VAO;
+        cubePipeline.depthFunc = useReversedZ ? GL_GREATER : GL_LESS;
+        BindingTable cubeBindings;
+        cubeBindings.texture(0, GL_TEXTURE_2D_ARRAY, materials.ID, sampler->ID);
+        // the jobs record the draws into one secondary stream per JOB_GRAIN items, a set for
+        // the frame being recorded and one for the frame being replayed
+        std::vector<CommandStream> drawStreams[2];
+        unsigned long framesRecorded = 0;
+
+        RenderThread renderThread;
+        renderThread.start(window);
+        while (!glfwWindowShouldClose(window))
+        {
+            if (glfwGetTime() - lastTitleUpdate >= 1.0)
+            {
+                lastTitleUpdate = glfwGetTime();
+                char title[128];
+                std::snprintf(title, sizeof(title), "Binbow | render thread frames: %llu | visible: %zu/%zu",
+                              (unsigned long long)renderThread.framesRendered, culler.visibleCount, culler.tested);
+                glfwSetWindowTitle(window, title);
+            }
+
+            framePacer.beforeInput();
+            glm::vec3 cameraFrom = camera.position;
+            processInput(window);
+            collideCamera(cameraFrom);
+            recenterOrigin();
+
+            float currentFrame = glfwGetTime();
+            deltaTime = input.frameDelta(currentFrame - lastFrame);
+            lastFrame = currentFrame;
+            streamWorld(deltaTime);
+            for (int steps = simulationClock.advance(deltaTime); steps > 0; steps--)
+                stepCubes((float)simulationClock.step);
+            cubes.interpolate(simulationClock.alpha());
+            updateObjects();
+
+            FrameBegin begin;
+            begin.frameData = {};
+            begin.frameData.view = camera.GetViewMatrix();
+            begin.frameData.projection = camera.GetProjectionMatrix();
+            begin.frameData.cameraPosition = glm::vec4(camera.position, 1.0f);
+            begin.frameData.time = currentFrame;
+            commitWindowSize();
+            begin.width = windowSize.width;
+            begin.height = windowSize.height;
+
+            CommandStream &stream = renderThread.record();
+            stream.call(
+                [](void *data, const void *payload) {
+                    FrameContext &frame = *(FrameContext *)data;
+                    FrameBegin begin = *(const FrameBegin *)payload;
+                    frame.textureLoader->update();
+                    frame.ring->beginFrame();
+                    frame.frameDataBuffer->update(begin.frameData);
+                    // the context is the render thread's, the viewport of the window is set here
+                    glViewport(0, 0, begin.width, begin.height);
+                    if (frame.reversedZ && frame.sceneTarget->resize(begin.width, begin.height))
+                        frame.sceneTarget->bind();
+                    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                },
+                &context, &begin, sizeof(begin));
+
+            // the same front to back order as the per-draw path of the loop below
+            if (cells && cells->update(camera.GetProjectionMatrix() * camera.GetViewMatrix(), camera.position))
+            {
+                // only the cubes of the cells seen through the portals
+                cells->cull(culler, camera.GetFrustum(), culler.visible, culler.tested);
+                culler.visibleCount = culler.visible.size();
+            }
+            else if (bvhCulling)
+            {
+                bvh.cull(camera.GetFrustum(), culler.visible);
+                culler.tested = bvh.tested;
+                culler.visibleCount = culler.visible.size();
+            }
+            else
+                culler.cull(camera.GetFrustum());
+            // the keys on the workers, a bucket per job, merged and sorted over them as well
+            renderQueue.record(jobs, culler.visible.size(), JOB_GRAIN, [&](size_t n, RenderBucket &bucket) {
+                uint32_t i = culler.visible[n];
+                float depth = glm::distance(camera.position, glm::vec3(cubeModel(i)[3])) / zFar;
+                bucket.add(RenderQueue::makeKey(RENDER_LAYER_OPAQUE, shader.ID, cubeLayer(i), cube->VAO, depth),
+                           DRAW_CUBE, i);
+            });
+            renderQueue.sort(jobs);
+            std::vector<CommandStream> &secondaries = drawStreams[framesRecorded++ & 1];
+            secondaries.resize((renderQueue.items.size() + JOB_GRAIN - 1) / JOB_GRAIN);
+            for (CommandStream &draws : secondaries)
+                draws.reset();
+            jobs.parallelFor(0, renderQueue.items.size(), JOB_GRAIN, [&](size_t first, size_t last) {
+                CommandStream &draws = secondaries[first / JOB_GRAIN];
+                for (size_t n = first; n < last; n++)
+                {
+                    const RenderItem &item = renderQueue.items[n];
+                    draws.uniform(modelLoc.location, cubeModel(item.index));
+                    draws.uniform(layerLoc.location, cubeLayer(item.index));
+                    draws.drawElements(GL_TRIANGLES, cube->indexCount, cube->indexType);
+                }
+            });
+            stream.bindPipeline(cubePipeline);
+            stream.bindTable(cubeBindings);
+            for (const CommandStream &draws : secondaries)
+                stream.execute(draws);
+            renderQueue.clear();
+
+            stream.call(
+                [](void *data, const void *) {
+                    FrameContext &frame = *(FrameContext *)data;
+                    if (frame.reversedZ && frame.sceneTarget->FBO)
+                        frame.sceneTarget->blitToDefault();
+                    frame.ring->endFrame();
+                },
+                &context);
+            renderThread.submit();
+
+            // glFinish of the low latency mode belongs to the render thread, the limiter doesn't
+            if (!framePacer.lowLatency)
+                framePacer.afterSwap();
+            input.endFrame(deltaTime);
+            if (input.finished())
+                glfwSetWindowShouldClose(window, true);
+            glfwPollEvents();
+        }
+        if (!startupTimeline.finished())
+            finishStartup();
+        return;
+    }
+
+    // the render thread swaps on its own, only this loop fences its frames
+    ring.frameFences = &frameFences;
+    framePacer.fences = &frameFences;
+
+    // the main camera and the debug one, culled together every frame
+    MultiView multiView(ring);
+    RenderTarget debugTarget;
+    SecondaryWindow secondaryWindow;
+    if (useDebugView && debugWindow && !secondaryWindow.create(window, 640, 360, "debug view"))
+        useDebugView = false;
+
+    double frameStart = glfwGetTime();
+    // frames since the cold start ended, for --assert-no-alloc
+    int steadyFrames = 0;
+    bool allocationsGuarded = false;
+    // what keeps frames coming with --on-demand besides input, loads and resizes
+    bool sceneAnimates = usePhysics || useGpuAnimation || particles || spriteCount > 0 || skinning || useDeferred ||
+                         useClustered || std::any_of(cubes.angularSpeed.begin(), cubes.angularSpeed.end(),
+                                                     [](float speed) { return speed != 0.0f; });
+    // the temporal history converges over its jittered frames
+    if (taa)
+        redraw.settleFrames = 16;
+    // the knobs of this renderer, at full quality until the frame time says otherwise
+    QualityGovernor governor;
+    governor.targetFrameTime = targetFrameTime;
+    if (samplerCache.anisotropyLimit() <= 1.0f)
+        governor.disable(QUALITY_ANISOTROPY);
+    if (!post || bloomStrength <= 0.0f)
+        governor.disable(QUALITY_POST);
+    if (!reflections)
+        governor.disable(QUALITY_REFLECTIONS);
+    if (!particles)
+        governor.disable(QUALITY_PARTICLES);
+    if (!shadows)
+        governor.disable(QUALITY_SHADOWS);
+    if (!useIndirect || lodThreshold <= 0.0f)
+        governor.disable(QUALITY_LOD);
+    if (useGpuAnimation || threadedSimulation)
+        governor.disable(QUALITY_SIMULATION);
+    // the GPU culls the indirect path's draws, it doesn't cost the CPU by distance
+    if (useIndirect)
+        governor.disable(QUALITY_DRAW_DISTANCE);
+    float particleRate = particles ? particles->emitRate : 0.0f;
+    auto applyQuality = [&]() {
+        samplerCache.setAnisotropyTier(anisotropy * governor.anisotropyScale());
+        for (const auto &[handle, scale] : bloomPasses)
+            post->setScale(handle, scale * governor.postScale());
+        if (reflections)
+            reflections->setTier(governor.reflectionTier());
+        if (particles)
+            particles->emitRate = particleRate * governor.particleScale();
+        if (shadows)
+            shadows->setQuality(governor.shadowCascades(CascadedShadowMaps::CASCADES), governor.shadowResolution());
+        simulationClock.step = 1.0 / (simulationHz * governor.simulationScale());
+    };
+    // what the frame before left going, and the view it was drawn with
+    unsigned int redrawBusy = REDRAW_NONE;
+    glm::mat4 redrawView = camera.GetViewMatrix();
+    double redrawStart = glfwGetTime();
     while (!glfwWindowShouldClose(window))
     {
-        processInput(window);
+        redraw.waitForFrame(redrawBusy, input);
+        PROFILE_ZONE("frame");
+        ALLOC_TAG("frame");
+        double frameBegin = startupTimeline.now();
+        ring.beginFrame();
+        frameArena.beginFrame();
+        deletionQueue.collect();
+        AllocTracker::instance().beginFrame();
+        // the CPU's part of the frame, after the wait for a free region
+        double cpuFrameStart = glfwGetTime();
+        if (assertNoAllocations && !allocationsGuarded && startupTimeline.finished() &&
+            ++steadyFrames >= STEADY_STATE_FRAMES)
+        {
+            AllocTracker::guard(true);
+            allocationsGuarded = true;
+        }
+        gpuProfiler.beginFrame();
+        if (benchmarking)
+        {
+            // whole frame GPU times come in a few frames late
+            for (const GpuPassStats &pass : gpuProfiler.passes)
+            {
+                if (pass.name == "frame" && pass.count > gpuFrameSamples)
+                {
+                    if (texturesLoaded && warmupFrames == 0)
+                        benchmark.addGpu(pass.last);
+                    // a sample is of a frame GpuProfiler::FRAMES back, the first ones after a switch are of the last mode
+                    if (texturesLoaded && warmupFrames == 0 && benchmarkAntiAliasing &&
+                        modeFrame > (int)GpuProfiler::FRAMES)
+                        benchmark.addVariantGpu(antiAliasingName(antiAliasing), pass.last);
+                    gpuFrameSamples = pass.count;
+                }
+            }
+        }
+        gpuProfiler.begin("frame");
+        if (watchingShaders)
+        {
+            for (const std::string &path : shaderWatcher.poll())
+                shaderCompiler.reload(path);
+            shaderCompiler.pollReloads();
+        }
+        if ((printGpuProfile || printGLCalls || printGpuMemory) && glfwGetTime() - lastProfileReport >= 5.0)
+        {
+            lastProfileReport = glfwGetTime();
+            if (printGpuProfile)
+                std::cout << gpuProfiler.report();
+            if (printGLCalls && glCalls.enabled())
+                std::cout << glCalls.report();
+            if (printGpuMemory)
+                std::cout << gpuMemory.report();
+        }
+        if (glfwGetTime() - lastTitleUpdate >= 1.0)
+        {
+            lastTitleUpdate = glfwGetTime();
+            // on the stack, --assert-no-alloc guards this loop
+            char title[128];
+            std::snprintf(title, sizeof(title),
+                          "Binbow | state changes issued: %u, filtered: %u | visible: %zu/%zu, occluded: %zu",
+                          glState.issued, glState.filtered, culler.visibleCount, culler.tested,
+                          (size_t)(occlusion.occluded + occluders.culled));
+            glfwSetWindowTitle(window, title);
+        }
+        glState.resetStats();
+        renderStats.resetFrame();
+        occlusion.resetStats();
+
+        {
+            PROFILE_ZONE("input");
+            framePacer.beforeInput();
+            if (benchmarking)
+            {
+                // the path is in world space
+                cameraPath.apply(camera, benchmarkFrame / 60.0f);
+                camera.position = renderOrigin.toRelative(glm::dvec3(camera.position));
+            }
+            else
+            {
+                glm::vec3 cameraFrom = camera.position;
+                processInput(window);
+                collideCamera(cameraFrom);
+            }
+            recenterOrigin();
+        }
+        if (voxels && (input.pressed(GLFW_KEY_E) || input.pressed(GLFW_KEY_Q)))
+        {
+            // a ball dug out of the voxel looked at or filled in front of it, remeshed this frame
+            glm::ivec3 hit, before;
+            if (voxels->raycast(camera.position, camera.front, zFar, hit, before))
+            {
+                bool dig = input.pressed(GLFW_KEY_E);
+                voxels->fillSphere(glm::vec3(dig ? hit : before) + 0.5f, 3.0f, dig ? 0 : LAYER_WALL + 1);
+            }
+        }
+
+        // finished texture decodes and scene primitives are uploaded here
+        uploadContext.poll();
+        assets.poll();
+        textureLoader.update();
+        // the impostors show the materials, they wait for all of them
+        if (impostors && !impostors->baked && textureLoader.pending() == 0 && assets.pending() == 0 &&
+            !impostors->bake(*cube, materials, *sampler, materials.layers, LAYER_FACE))
+            impostors.reset();
+        // the driver's work for what earlier runs drew, a millisecond a frame while loading
+        if (warmPipelines && !renderThreadMode)
+            pipelineWarmup.warm(shaderCompiler, 1.0);
+        if (scene)
+            scene->update(deletionQueue.completedFrame);
+        // the streaming budget shrinks to what the driver has free, where it tells
+        if (gpuMemory.queryDriver() && textureLoader.residency)
+            residency.budget =
+                gpuMemory.textureBudget((uint64_t)textureBudget * 1024 * 1024, residency.residentBytes);
+        // with the requests of the frame before
+        if (textureLoader.residency)
+            residency.update();
+
+        if (commitWindowSize())
+            glViewport(0, 0, windowSize.width, windowSize.height);
+        int framebufferWidth = windowSize.width, framebufferHeight = windowSize.height;
+        if (benchmarking)
+        {
+            framebufferWidth = benchmarkWidth;
+            framebufferHeight = benchmarkHeight;
+        }
+        // the scene's own size, the window's without the dynamic resolution
+        int renderWidth = framebufferWidth, renderHeight = framebufferHeight;
+        // the eyes are blitted into the frame, which a multisampled target can't take
+        bool useMsaa = msaaSamples(antiAliasing) > 0 && !taa && !useDeferred && !useStereo;
+        bool useFxaa = antiAliasing == AA_FXAA && !taa;
+        if (dynamicScale)
+        {
+            dynamicScale->update(gpuProfiler);
+            glm::ivec2 size = dynamicScale->renderSize(framebufferWidth, framebufferHeight);
+            renderWidth = size.x;
+            renderHeight = size.y;
+        }
+        // the deferred path lights into its own target, the frame is resolved to an offscreen one too,
+        // and the post-processing and the upscale read the frame from one
+        if ((useReversedZ || benchmarking || useDeferred || post || dynamicScale || taa || useMsaa || useFxaa || oit) &&
+            sceneTarget.resize(renderWidth, renderHeight))
+        {
+            sceneTarget.bind();
+            if (benchmarking || dynamicScale || taa || useMsaa || useFxaa)
+                glViewport(0, 0, renderWidth, renderHeight);
+        }
+        // resolved into the scene target before the Hi-Z reads the depth
+        useMsaa = useMsaa && sceneTarget.FBO &&
+                  msaaTarget.resize(renderWidth, renderHeight, msaaSamples(antiAliasing), sceneTarget.colorFormat);
+        if (useMsaa)
+            msaaTarget.bind();
+        // the scene's blended draws go to the OIT targets, which share the scene target's depth;
+        // the multisampled frame has a depth of its own, so they are sorted then
+        bool useOit = oit && !useMsaa && sceneTarget.FBO && oit->resize(renderWidth, renderHeight, sceneTarget.depth);
 
+        gpuProfiler.begin("clear");
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // the geometry pass shares the depth just cleared
+        if (useDeferred && gbuffer.resize(renderWidth, renderHeight, sceneTarget.depth))
+            gbuffer.bindGeometry();
+        gpuProfiler.end();
 
         // Actual Drawing
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
+        // again every frame, the anisotropy tier may have changed
+        sampler = &samplerCache.get(materialSamplerDesc);
+        sceneSampler = &samplerCache.get(sceneSamplerDesc);
+        if (environment)
+            environment->bind();
+        if (useBindless)
+        {
+            // no texture binds at all, the handles are made resident here
+            for (int i = 0; i < LAYER_COUNT; i++)
+                bindless.use(i);
+            bindless.update();
+            bindless.bind();
+        }
+        else
+        {
+            materials.bind(0);
+            // the materials' and the glTF base colors' units in one call
+            unsigned int samplerIDs[] = {sampler->ID, sceneSampler->ID};
+            glState.bindSamplers(0, 2, samplerIDs);
+        }
 
-        glBindVertexArray(VAO);
+        cube->bind();
 
         // "Physics"
         // calculating deltaTime
         float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
+        deltaTime = input.frameDelta(currentFrame - lastFrame);
         lastFrame = currentFrame;
+        // the frame after a wait doesn't make up the time slept in one step
+        if (redraw.enabled())
+            deltaTime = std::min(deltaTime, redraw.deltaLimit());
+        // the benchmark advances by the same step every run
+        if (benchmarking)
+            deltaTime = 1.0f / 60.0f;
 
-        // Zooming
-        projection = glm::perspective(glm::radians(camera.zoom), aspectRatio, zNear, zFar);
-        shader.setMat4("projection", projection);
-
-        // Camera rotation
+        // Zooming and camera rotation, recalculated only when the camera changed
+        projection = camera.GetProjectionMatrix();
         view = camera.GetViewMatrix();
-        shader.setMat4("view", view);
+        if (taa)
+        {
+            taa->beginFrame(camera.GetViewProjectionMatrix(), renderWidth, renderHeight, framebufferWidth,
+                            framebufferHeight);
+            projection = taa->jitter(projection);
+        }
 
-        for (int i = 0; i < 10; i++)
+        // one upload per frame for all programs
+        frameData.view = view;
+        frameData.projection = projection;
+        frameData.cameraPosition = glm::vec4(camera.position, 1.0f);
+        frameData.time = currentFrame;
+        frameDataBuffer.update(frameData);
+        hud.addFrameTime(deltaTime * 1000.0f);
+
+        {
+            PROFILE_ZONE("world streaming");
+            streamWorld(deltaTime);
+        }
+        // as many fixed steps as the frame took, then all model matrices in one batched pass
+        PROFILE_ZONE("simulation");
+        // with --gpu-animation the vertex shader spins the cubes, their matrices and spheres stay as placed
+        if (!useGpuAnimation)
+        {
+            if (threadedSimulation)
+            {
+                std::lock_guard<std::mutex> lock(simulationThread.mutex);
+                float alpha = simulationThread.alpha();
+                jobs.parallelFor(0, cubes.size(), JOB_GRAIN,
+                                 [&](size_t first, size_t last) { cubes.interpolate(alpha, first, last); });
+            }
+            else
+            {
+                for (int steps = simulationClock.advance(deltaTime); steps > 0; steps--)
+                    stepCubes((float)simulationClock.step);
+                float alpha = simulationClock.alpha();
+                jobs.parallelFor(0, cubes.size(), JOB_GRAIN,
+                                 [&](size_t first, size_t last) { cubes.interpolate(alpha, first, last); });
+            }
+            updateObjects();
+        }
+        if (bvhCulling)
+            cubePicked = bvh.raycast(camera.position, camera.front, zFar, pickedCube, pickedDistance);
+        if (picker)
+        {
+            // the ids of an earlier frame, then this frame's region around the point
+            picker->poll();
+            float pickX = renderWidth * 0.5f, pickY = renderHeight * 0.5f;
+            if (glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_DISABLED)
+            {
+                double cursorX, cursorY;
+                int windowWidth, windowHeight;
+                glfwGetCursorPos(window, &cursorX, &cursorY);
+                glfwGetWindowSize(window, &windowWidth, &windowHeight);
+                if (windowWidth > 0 && windowHeight > 0)
+                {
+                    pickX = (float)(cursorX * renderWidth / windowWidth);
+                    pickY = (float)((windowHeight - cursorY) * renderHeight / windowHeight);
+                }
+            }
+            if (picker->begin(camera.GetViewProjectionMatrix(), pickX, pickY, renderWidth, renderHeight))
+            {
+                gpuProfiler.begin("gpu pick");
+                pickCandidates.clear();
+                if (bvhCulling)
+                    bvh.cull(picker->frustum(), pickCandidates);
+                else
+                    culler.cull(picker->frustum(), 0, cubes.size(), pickCandidates);
+                for (uint32_t i : pickCandidates)
+                    picker->draw(*cube, cubeModel(i), i);
+                picker->end();
+                gpuProfiler.end();
+            }
+        }
+
+        if (useDeferred || useClustered)
+            lightSet.animate(currentFrame);
+        if (particles)
+        {
+            gpuProfiler.begin("particle simulation");
+            particles->update(deltaTime);
+            gpuProfiler.end();
+        }
+        if (skinning)
+        {
+            if (!skinning->ready() && scene->finished())
+            {
+                skinning->build();
+                skinning->addInstances(skinnedInstances);
+            }
+            // in front of the skinned instances, which go away from the camera
+            if (crowd && skinning->ready() && !crowd->ready())
+            {
+                gpuProfiler.begin("bake crowd");
+                crowd->bake(*skinning, crowdSize, glm::vec3(0.0f, 0.0f, 4.0f));
+                gpuProfiler.end();
+            }
+            // every instance sways between its clip and the next one
+            for (size_t i = 0; i < skinning->instances.size(); i++)
+                skinning->instances[i].blendWeight = 0.5f + 0.5f * std::sin(currentFrame * 0.5f + (float)i);
+            gpuProfiler.begin("skinning");
+            skinning->update(deltaTime, jobs);
+            gpuProfiler.end();
+        }
+        if (shadows || pointShadowAtlas)
+        {
+            dynamicCasters.clear();
+            objects.each<Motion, Bounds>(
+                [&](Entity, const Motion &, const Bounds &bounds) { dynamicCasters.push_back(bounds.sphere); });
+        }
+        // the lights' shadows go with them into the clusters
+        if (pointShadowAtlas)
+            pointShadowAtlas->update(lightSet.lights, camera, renderHeight, dynamicCasters, useReversedZ);
+        if (clusters)
+        {
+            gpuProfiler.begin("light clusters");
+            clusters->build(lightSet.lights, decalSet.decals, renderWidth, renderHeight, zNear, zFar);
+            gpuProfiler.end();
+        }
+        if (shadows)
+            shadows->update(camera, dynamicCasters, useReversedZ);
+        // the casters of every cascade and point shadow face that is due, drawn from the light with
+        // the depth only programs and culled by its view
+        auto renderShadows = [&](auto &&drawCasters) {
+            // the rate image covers the scene's framebuffer, not the shadow maps
+            bool coarse = shadingRates && shadingRates->isActive();
+            if (coarse && ((shadows && shadows->renderedCascades > 0) ||
+                           (pointShadowAtlas && pointShadowAtlas->renderedFaces > 0)))
+                shadingRates->end();
+            if (shadows && shadows->renderedCascades > 0)
+            {
+                gpuProfiler.begin("shadow maps");
+                shadows->begin();
+                for (int i = 0; i < CascadedShadowMaps::CASCADES; i++)
+                {
+                    if (!shadows->stale(i))
+                        continue;
+                    shadows->beginCascade(i, frameDataBuffer, frameData);
+                    drawCasters(shadows->frustum(i));
+                }
+                shadows->end(frameDataBuffer, frameData);
+                gpuProfiler.end();
+            }
+            if (pointShadowAtlas && pointShadowAtlas->renderedFaces > 0)
+            {
+                gpuProfiler.begin("point shadows");
+                pointShadowAtlas->begin();
+                for (int i = 0; i < pointShadowAtlas->renderedFaces; i++)
+                {
+                    pointShadowAtlas->beginFace(i, frameDataBuffer, frameData);
+                    drawCasters(pointShadowAtlas->frustum(i));
+                }
+                pointShadowAtlas->end(frameDataBuffer, frameData);
+                gpuProfiler.end();
+            }
+            if (coarse && !shadingRates->isActive())
+                shadingRates->begin();
+            if (shadows)
+                shadows->bind();
+            if (pointShadowAtlas)
+                pointShadowAtlas->bind();
+            // the froxels are lit with the maps just bound, before the first draw fetches them
+            if (fog)
+            {
+                gpuProfiler.begin("volumetric fog");
+                fog->update(view, frameData.viewProjection);
+                gpuProfiler.end();
+            }
+        };
+
+        // CPU cost of culling, recording and submitting the draws, up to the end of the render queue
+        double submitStart = glfwGetTime();
+        // the scene's draws up to the end of the render queue at the rates of the last frame
+        if (shadingRates && sceneTarget.FBO)
+        {
+            gpuProfiler.begin("shading rates");
+            shadingRates->update(sceneTarget.color, taa ? &taa->velocities() : NULL,
+                                 useStereo ? std::max(renderWidth / 2, 1) : renderWidth, renderHeight,
+                                 useStereo ? 2 : 1);
+            gpuProfiler.end();
+            shadingRates->begin();
+        }
+        if (useIndirect)
+        {
+            // one command per cube, all of them submitted by a single call,
+            // the cull pass drops the ones outside the frustum on the GPU
+            indirect.begin();
+            // the levels of detail are picked for the camera in the cascades too
+            indirect.lodThreshold = lodThreshold * governor.lodScale();
+            indirect.setLodView(camera.position, camera.GetProjectionMatrix()[1][1] * renderHeight * 0.5f);
+            if (triangleFilter)
+            {
+                triangleFilter->setViewport(renderWidth, renderHeight);
+                triangleFilter->keepSmallTriangles = useMsaa;
+            }
+            objects.each<Transform, Renderable>([&](Entity, const Transform &transform, const Renderable &renderable) {
+                indirect.add(cubeRange, transform.world, renderable.layer);
+            });
+            // the cull pass tests the casters against the cascade, last frame's depth is the camera's
+            renderShadows([&](const Frustum &) {
+                indirect.prepare(false);
+                indirect.submit(*indirectDepthShader);
+            });
+            indirect.prepare();
+            if (voxels)
+            {
+                // the chunks whose voxels changed, then one command per chunk with faces
+                PROFILE_ZONE("voxels");
+                if (voxelStreamer)
+                    voxelStreamer->update(jobs, camera.position, camera.front);
+                else
+                    voxels->remesh(jobs);
+                voxelIndirect->begin();
+                voxelIndirect->lodThreshold = 0.0f;
+                voxels->draw(*voxelIndirect);
+                voxelIndirect->prepare();
+            }
+            prepass.begin((uint64_t)renderWidth * renderHeight);
+            if (prepass.active())
+            {
+                gpuProfiler.begin("depth prepass");
+                indirect.submit(*indirectDepthShader);
+                gpuProfiler.end();
+            }
+            prepass.beginShading();
+            gpuProfiler.begin("indirect cubes");
+            indirect.submit(*indirectShader);
+            gpuProfiler.end();
+            prepass.end();
+            indirect.finish();
+            if (voxels)
+            {
+                gpuProfiler.begin("voxels");
+                voxelIndirect->submit(*voxelShader);
+                gpuProfiler.end();
+                voxelIndirect->finish();
+            }
+        }
+        else
+        {
+            // the spheres follow the spinning cubes (see updateObjects), the radius covers any
+            // rotation, each job tests its own range and the results are joined in order
+            Frustum frustum = camera.GetFrustum();
+            if (governor.drawDistanceScale() < 1.0f)
+                frustum = frustum.limited(camera.position, camera.front, zFar * governor.drawDistanceScale());
+            multiView.clear();
+            int eyeWidth = std::max(renderWidth / 2, 1);
+            if (useStereo && stereo.resize(eyeWidth, renderHeight))
+            {
+                // the eyes are the views after the camera's, they all draw into the stereo target
+                float eyeAspect = (float)eyeWidth / renderHeight;
+                multiView.add(camera.GetViewMatrix(), camera.GetProjectionMatrix(), camera.position, 0, 0, renderWidth,
+                              renderHeight);
+                for (int eye = 0; eye < 2; eye++)
+                    multiView.add(camera.GetEyeViewMatrix(eye), camera.GetEyeProjectionMatrix(eye, eyeAspect),
+                                  camera.position, 0, 0, eyeWidth, renderHeight, stereo.FBO);
+            }
+            else if (useDebugView)
+            {
+                // behind and above the main camera, looking past it, with the main lens
+                glm::vec3 debugPosition = camera.position - camera.front * 20.0f + camera.worldUp * 12.0f;
+                glm::mat4 debugViewMatrix =
+                    glm::lookAt(debugPosition, camera.position + camera.front * 10.0f, camera.worldUp);
+                glm::mat4 debugProjection = camera.GetProjectionMatrix();
+                multiView.add(camera.GetViewMatrix(), camera.GetProjectionMatrix(), camera.position, 0, 0, renderWidth,
+                              renderHeight);
+                if (secondaryWindow.open())
+                {
+                    int width, height;
+                    secondaryWindow.framebufferSize(width, height);
+                    if (debugTarget.resize(width, height))
+                    {
+                        debugProjection[0][0] = debugProjection[1][1] * height / width;
+                        multiView.add(debugViewMatrix, debugProjection, debugPosition, 0, 0, width, height,
+                                      debugTarget.FBO);
+                    }
+                }
+                else if (!debugWindow)
+                {
+                    int width = renderWidth / 4, height = renderHeight / 4;
+                    debugProjection[0][0] = debugProjection[1][1] * height / std::max(width, 1);
+                    multiView.add(debugViewMatrix, debugProjection, debugPosition, renderWidth - width - 16,
+                                  renderHeight - height - 16, width, height);
+                }
+            }
+            if (multiView.size() > 1)
+            {
+                // one pass over the spheres tests them against every view, in place of a walk
+                // of the hierarchy per view
+                PROFILE_ZONE("multi-view cull");
+                size_t rangeCount = (cubes.size() + JOB_GRAIN - 1) / JOB_GRAIN;
+                multiView.beginCull(rangeCount);
+                jobs.parallelFor(0, cubes.size(), JOB_GRAIN, [&](size_t first, size_t last) {
+                    PROFILE_ZONE("cull job");
+                    multiView.cull(culler, first / JOB_GRAIN, first, last);
+                });
+                multiView.gather();
+                culler.gather(multiView.mainRanges());
+            }
+            else if (cells && cells->update(camera.GetProjectionMatrix() * camera.GetViewMatrix(), camera.position))
+            {
+                // the cubes of the cells the camera sees through the portals, the rest aren't tested
+                PROFILE_ZONE("cell cull");
+                cells->cull(culler, frustum, culler.visible, culler.tested);
+                culler.visibleCount = culler.visible.size();
+            }
+            else if (bvhCulling)
+            {
+                // the hierarchy skips whole groups of cubes, tested counts the spheres it did look at
+                PROFILE_ZONE("bvh cull");
+                bvh.cull(frustum, culler.visible);
+                culler.tested = bvh.tested;
+                culler.visibleCount = culler.visible.size();
+            }
+            else
+            {
+                visibleRanges.resize((cubes.size() + JOB_GRAIN - 1) / JOB_GRAIN);
+                jobs.parallelFor(0, cubes.size(), JOB_GRAIN, [&](size_t first, size_t last) {
+                    PROFILE_ZONE("cull job");
+                    std::vector<uint32_t> &range = visibleRanges[first / JOB_GRAIN];
+                    range.clear();
+                    culler.cull(frustum, first, last, range);
+                });
+                culler.gather(visibleRanges);
+            }
+            if (useSoftwareOcclusion)
+            {
+                // this frame's matrices, so after the update and the frustum cull
+                PROFILE_ZONE("software occlusion");
+                occluders.begin(camera.GetProjectionMatrix() * camera.GetViewMatrix());
+                for (uint32_t i : occluders.chooseOccluders(culler, culler.visible, camera.position))
+                    occluders.addBox(cubeModel(i), cube->boundsCenter, cube->boundsExtent);
+                occluders.rasterize(jobs);
+                occluders.cull(jobs, culler, culler.visible);
+                culler.visibleCount = culler.visible.size();
+            }
+
+            if (instancedRendering)
+            {
+                // the records that changed since the last frame, before any pass reads them
+                if (useCompact)
+                    compactCubes.update(cubes.compact.data());
+                // all visible cubes in a single draw
+                auto uploadCubes = [&](const std::vector<uint32_t> &indices) {
+                    if (useCompact)
+                    {
+                        compactCubes.upload(indices.data(), indices.size());
+                        return;
+                    }
+                    visibleModels.clear();
+                    visibleLayers.clear();
+                    for (uint32_t i : indices)
+                    {
+                        visibleModels.push_back(cubeModel(i));
+                        visibleLayers.push_back(cubeLayer(i));
+                    }
+                    if (usePulling)
+                        vertexPuller.upload(visibleModels.data(), visibleLayers.data(), visibleModels.size());
+                    else
+                    {
+                        instanceBuffer.upload(visibleModels.data(), visibleModels.size());
+                        instanceBuffer.uploadLayers(visibleLayers.data(), visibleLayers.size());
+                    }
+                };
+                auto drawCubes = [&](Shader &program) {
+                    program.use();
+                    if (usePulling)
+                        vertexPuller.draw(program, *cube);
+                    else if (useCompact)
+                    {
+                        compactCubes.bind();
+                        cube->drawInstanced((GLsizei)compactCubes.count);
+                    }
+                    else
+                        cube->drawInstanced((GLsizei)instanceBuffer.count);
+                };
+                // the casters of a cascade or face are the spheres in its view from the light
+                renderShadows([&](const Frustum &frustum) {
+                    shadowCasters.clear();
+                    if (bvhCulling)
+                        bvh.cull(frustum, shadowCasters);
+                    else
+                        culler.cull(frustum, 0, cubes.size(), shadowCasters);
+                    uploadCubes(shadowCasters);
+                    drawCubes(instancedDepthShader);
+                });
+                if (useStereo && multiView.size() == 3)
+                {
+                    // the objects either eye sees, in one draw for both
+                    uploadCubes(multiView.combined);
+                    instanceBuffer.setDivisor((unsigned int)stereo.instancesPerObject());
+                    stereo.begin(ring, multiView.view(1).frame.viewProjection, multiView.view(2).frame.viewProjection);
+                    gpuProfiler.begin("stereo cubes");
+                    stereoShader->use();
+                    cube->drawInstanced((GLsizei)(instanceBuffer.count * stereo.instancesPerObject()));
+                    gpuProfiler.end();
+                    instanceBuffer.setDivisor(1);
+                    stereo.end(renderWidth, renderHeight);
+                }
+                else if (useGpuAnimation)
+                {
+                    // nothing uploaded, every cube from the static instance buffer
+                    prepass.begin((uint64_t)renderWidth * renderHeight);
+                    if (prepass.active())
+                    {
+                        gpuProfiler.begin("depth prepass");
+                        animatedDepthShader->use();
+                        animatedCubes.draw();
+                        gpuProfiler.end();
+                    }
+                    prepass.beginShading();
+                    gpuProfiler.begin("animated cubes");
+                    animatedShader->use();
+                    animatedCubes.draw();
+                    gpuProfiler.end();
+                    prepass.end();
+                }
+                else
+                {
+                    bool drawImpostors = impostors && impostors->baked;
+                    if (drawImpostors)
+                        impostors->select(culler.visible, camera.position,
+                                          [&](uint32_t i) { return glm::vec3(cubeModel(i)[3]); }, nearCubes, farCubes);
+                    uploadCubes(drawImpostors ? nearCubes : culler.visible);
+                    prepass.begin((uint64_t)renderWidth * renderHeight);
+                    if (prepass.active())
+                    {
+                        gpuProfiler.begin("depth prepass");
+                        drawCubes(instancedDepthShader);
+                        gpuProfiler.end();
+                    }
+                    prepass.beginShading();
+                    gpuProfiler.begin("instanced cubes");
+                    drawCubes(useBindless ? *bindlessShader : instancedShader);
+                    gpuProfiler.end();
+                    prepass.end();
+                    if (showOverdraw && overdraw->resize(renderWidth, renderHeight))
+                    {
+                        gpuProfiler.begin("overdraw");
+                        overdraw->begin();
+                        drawCubes(*overdrawShader);
+                        overdraw->composite();
+                        gpuProfiler.end();
+                    }
+                    if (drawImpostors && !farCubes.empty())
+                    {
+                        visibleModels.clear();
+                        visibleLayers.clear();
+                        for (uint32_t i : farCubes)
+                        {
+                            visibleModels.push_back(cubeModel(i));
+                            visibleLayers.push_back(cubeLayer(i));
+                        }
+                        gpuProfiler.begin("impostors");
+                        impostors->draw(visibleModels.data(), visibleLayers.data(), visibleModels.size());
+                        gpuProfiler.end();
+                    }
+                    if (multiView.size() > 1)
+                    {
+                        gpuProfiler.begin("debug views");
+                        multiView.beginExtraViews();
+                        if (multiView.layered)
+                        {
+                            // every object once per view in a single draw
+                            uploadCubes(multiView.combined);
+                            instanceBuffer.setDivisor((unsigned int)multiView.extraViews());
+                            multiView.beginLayered();
+                            multiViewShader->use();
+                            cube->drawInstanced((GLsizei)(instanceBuffer.count * multiView.extraViews()));
+                            instanceBuffer.setDivisor(1);
+                        }
+                        else
+                        {
+                            for (int v = 1; v < multiView.size(); v++)
+                            {
+                                uploadCubes(multiView.visible[v]);
+                                multiView.beginView(v, frameDataBuffer, currentFrame);
+                                drawCubes(useBindless ? *bindlessShader : instancedShader);
+                            }
+                        }
+                        multiView.endExtraViews(frameDataBuffer, frameData, renderWidth, renderHeight);
+                        gpuProfiler.end();
+                    }
+                }
+            }
+            else
+            {
+                // drawn through the render queue below, front to back per layer, the keys made
+                // on the workers
+                renderQueue.record(jobs, culler.visible.size(), JOB_GRAIN, [&](size_t n, RenderBucket &bucket) {
+                    uint32_t i = culler.visible[n];
+                    if (!cubeBaked.empty() && cubeBaked[i])
+                        return;
+                    float depth = glm::distance(camera.position, glm::vec3(cubeModel(i)[3])) / zFar;
+                    bucket.add(RenderQueue::makeKey(RENDER_LAYER_OPAQUE, shader.ID, cubeLayer(i), cube->VAO, depth),
+                               DRAW_CUBE, i);
+                });
+                if (staticBatches.mesh)
+                {
+                    staticBatches.cull(frustum);
+                    for (uint32_t b : staticBatches.visible)
+                    {
+                        const StaticBatches::Batch &batch = staticBatches.batches[b];
+                        float nearest = glm::distance(camera.position, batch.center) - batch.radius;
+                        float depth = std::max(nearest, 0.0f) / zFar;
+                        renderQueue.add(RenderQueue::makeKey(RENDER_LAYER_OPAQUE, batchShader.ID, batch.layer,
+                                                             staticBatches.mesh->VAO, depth),
+                                        DRAW_STATIC, b);
+                    }
+                }
+            }
+        }
+        // the far cells whose cubes aren't in, whichever path draws the cubes
+        if (hlod)
+        {
+            hlod->cull(camera.GetFrustum(), renderOrigin.origin, camera.position,
+                       [&](glm::ivec2 cell) { return world->hasCubes(cell); });
+            for (size_t d = 0; d < hlod->visible.size(); d++)
+            {
+                const HlodProxies::Draw &draw = hlod->visible[d];
+                const HlodProxies::Proxy &proxy = hlod->proxies[draw.proxy];
+                int layer = proxy.materials[draw.submesh] ? LAYER_WALL : LAYER_CONTAINER;
+                renderQueue.add(RenderQueue::makeKey(RENDER_LAYER_OPAQUE, shader.ID, layer, proxy.mesh->VAO,
+                                                     draw.nearest / zFar),
+                                DRAW_HLOD, (uint32_t)d);
+            }
+        }
+
+        // about the pixels across a sphere on screen, for the texture residency
+        float pixelsPerRadian = renderHeight / (2.0f * std::tan(glm::radians(camera.zoom) * 0.5f));
+        auto screenPixels = [&](const glm::vec3 &center, float radius) {
+            return 2.0f * radius * pixelsPerRadian / std::max(glm::distance(camera.position, center) - radius, zNear);
+        };
+        if (scene)
+        {
+            for (size_t i = 0; i < scene->draws.size(); i++)
+            {
+                const GltfDraw &draw = scene->draws[i];
+                const Mesh *mesh = scene->mesh(draw.primitive);
+                if (!mesh || (skinning && skinning->handles(i)))
+                    continue;
+                glm::vec3 center = glm::vec3(draw.model * glm::vec4(mesh->boundsCenter, 1.0f));
+                if (textureLoader.residency)
+                    residency.request(scene->baseColorTexture(draw.material),
+                                      screenPixels(center, glm::length(glm::mat3(draw.model) * mesh->boundsExtent)));
+                bool blended = scene->isBlended(draw.material);
+                RenderLayer layer = !blended ? RENDER_LAYER_OPAQUE
+                                    : useOit ? RENDER_LAYER_WEIGHTED
+                                             : RENDER_LAYER_TRANSPARENT;
+                Shader &program = *sceneProgram(scene->isMasked(draw.material), false, blended && useOit).shader;
+                renderQueue.add(RenderQueue::makeKey(layer, program.ID, scene->baseColorTexture(draw.material).ID,
+                                                     mesh->VAO, glm::distance(camera.position, center) / zFar),
+                                DRAW_SCENE, (uint32_t)i);
+            }
+        }
+        if (skinning)
+        {
+            // pre-skinned draws go through the rigid scene programs
+            for (size_t i = 0; i < skinning->draws.size(); i++)
+            {
+                const SkinnedDraw &skinned = skinning->draws[i];
+                const GltfDraw &draw = scene->draws[skinned.draw];
+                const Mesh *mesh = scene->mesh(draw.primitive);
+                const glm::mat4 &placement = skinning->instances[skinned.instance].placement;
+                glm::vec3 center = glm::vec3(placement * glm::vec4(mesh->boundsCenter, 1.0f));
+                if (textureLoader.residency)
+                    residency.request(scene->baseColorTexture(draw.material),
+                                      screenPixels(center, glm::length(glm::mat3(placement) * mesh->boundsExtent)));
+                bool blended = scene->isBlended(draw.material);
+                RenderLayer layer = !blended ? RENDER_LAYER_OPAQUE
+                                    : useOit ? RENDER_LAYER_WEIGHTED
+                                             : RENDER_LAYER_TRANSPARENT;
+                Shader &program =
+                    *sceneProgram(scene->isMasked(draw.material), !skinning->preSkinning, blended && useOit).shader;
+                renderQueue.add(RenderQueue::makeKey(layer, program.ID, scene->baseColorTexture(draw.material).ID,
+                                                     mesh->VAO, glm::distance(camera.position, center) / zFar),
+                                DRAW_SKINNED, (uint32_t)i);
+            }
+        }
+        if (crowd)
+        {
+            // one draw of every copy of a primitive
+            for (size_t i = 0; i < crowd->draws.size(); i++)
+            {
+                const VertexAnimations::Draw &baked = crowd->draws[i];
+                const GltfDraw &draw = scene->draws[baked.draw];
+                if (textureLoader.residency)
+                    residency.request(scene->baseColorTexture(draw.material), screenPixels(baked.center, baked.radius));
+                bool blended = scene->isBlended(draw.material);
+                RenderLayer layer = !blended ? RENDER_LAYER_OPAQUE
+                                    : useOit ? RENDER_LAYER_WEIGHTED
+                                             : RENDER_LAYER_TRANSPARENT;
+                Shader &program = *sceneProgram(scene->isMasked(draw.material), SCENE_CROWD, blended && useOit).shader;
+                renderQueue.add(RenderQueue::makeKey(layer, program.ID, scene->baseColorTexture(draw.material).ID,
+                                                     baked.VAO, glm::distance(camera.position, baked.center) / zFar),
+                                DRAW_CROWD, (uint32_t)i);
+            }
+        }
+
+        // before the queue, so its transparent draws blend over it
+        if (terrain)
+        {
+            gpuProfiler.begin("terrain");
+            terrain->select(camera.position, camera.GetFrustum());
+            if (virtualTexture)
+            {
+                // the pages of an earlier frame's feedback, then this frame's feedback
+                virtualTexture->update();
+                if (virtualTexture->beginFeedback(renderWidth, renderHeight))
+                {
+                    // every feedback pixel is a page request of its own
+                    bool coarse = shadingRates && shadingRates->isActive();
+                    if (coarse)
+                        shadingRates->end();
+                    terrain->drawFeedback();
+                    virtualTexture->endFeedback();
+                    if (coarse)
+                        shadingRates->begin();
+                }
+                virtualTexture->bind();
+            }
+            terrain->draw();
+            gpuProfiler.end();
+        }
+        if (scatter)
+        {
+            gpuProfiler.begin("scatter");
+            scatter->update(camera.position);
+            scatter->draw();
+            gpuProfiler.end();
+        }
+        if (ocean)
+        {
+            gpuProfiler.begin("ocean");
+            ocean->update(currentFrame);
+            ocean->select(camera.position, camera.GetFrustum());
+            ocean->draw();
+            gpuProfiler.end();
+        }
+
+        // everything queued this frame, grouped by program and material
+        renderQueue.sort(jobs);
+        gpuProfiler.begin("render queue");
+        bool blending = false, weighting = false;
+        // the sky goes after the opaque draws and under the transparent ones, the deferred
+        // path has it in its ambient pass
+        bool skyDrawn = !environment || useDeferred;
+        for (const RenderItem &item : renderQueue.items)
+        {
+            bool weighted = item.key >> 62 == RENDER_LAYER_WEIGHTED;
+            if (!skyDrawn && item.key >> 62 != RENDER_LAYER_OPAQUE)
+            {
+                environment->drawSky(projection * view, useReversedZ);
+                skyDrawn = true;
+            }
+            if (!blending && item.key >> 62 == RENDER_LAYER_TRANSPARENT)
+            {
+                // transparent draws test against the opaque depth but don't write it
+                blending = true;
+                glState.enable(GL_BLEND);
+                glState.setDepthMask(false);
+            }
+            if (!weighting && weighted)
+            {
+                // the same, into the OIT sums
+                weighting = true;
+                oit->begin();
+            }
+
+            if (item.source == DRAW_CUBE)
+            {
+                uint32_t i = item.index;
+                shader.use();
+                cube->bind();
+                if (!cubeBoundsCurrent)
+                {
+                    shader.set(boundsCenterLoc, cube->boundsCenter);
+                    shader.set(boundsExtentLoc, cube->boundsExtent);
+                    cubeBoundsCurrent = true;
+                }
+                shader.set(modelLoc, cubeModel(i));
+                shader.set(layerLoc, cubeLayer(i));
+                if (!occlusionCulling)
+                {
+                    cube->draw();
+                    continue;
+                }
+                // a cube is its own bounding box, so a hidden one is tested with an invisible copy
+                bool visible = occlusion.isVisible(i);
+                if (conditionalRendering)
+                {
+                    if (visible)
+                    {
+                        // visible cubes tend to stay so, their queries are renewed in turns
+                        bool queried = occlusion.recheck(i) && occlusion.begin(i);
+                        cube->draw();
+                        if (queried)
+                            occlusion.end();
+                        continue;
+                    }
+                    // tested now unless an earlier test is still in flight, the draw is up to the GPU
+                    if (occlusion.begin(i))
+                    {
+                        OcclusionQueries::beginProxy();
+                        cube->draw();
+                        occlusion.end();
+                        OcclusionQueries::endProxy();
+                    }
+                    occlusion.beginConditional(i);
+                    cube->draw();
+                    OcclusionQueries::endConditional();
+                    continue;
+                }
+                if (!visible)
+                    OcclusionQueries::beginProxy();
+                bool queried = occlusion.begin(i);
+                if (visible || queried)
+                    cube->draw();
+                if (queried)
+                    occlusion.end();
+                if (!visible)
+                    OcclusionQueries::endProxy();
+            }
+            else if (item.source == DRAW_STATIC)
+            {
+                // already in world space, one draw for a chunk of one material
+                const StaticBatches::Batch &batch = staticBatches.batches[item.index];
+                batchShader.use();
+                if (lightmap)
+                {
+                    lightmap->bind(LightmapBaker::TEXTURE_UNIT);
+                    samplerCache.get(lightmapSamplerDesc).bind(LightmapBaker::TEXTURE_UNIT);
+                }
+                staticBatches.mesh->bind();
+                batchShader.set(batchBoundsCenterLoc, staticBatches.mesh->boundsCenter);
+                batchShader.set(batchBoundsExtentLoc, staticBatches.mesh->boundsExtent);
+                cubeBoundsCurrent = false;
+                batchShader.set(batchModelLoc, glm::mat4(1.0f));
+                batchShader.set(batchLayerLoc, batch.layer);
+                staticBatches.draw(item.index);
+            }
+            else if (item.source == DRAW_HLOD)
+            {
+                // the cubes of a far cell at rest, one draw per material
+                const HlodProxies::Draw &draw = hlod->visible[item.index];
+                const HlodProxies::Proxy &proxy = hlod->proxies[draw.proxy];
+                shader.use();
+                proxy.mesh->bind();
+                shader.set(boundsCenterLoc, proxy.mesh->boundsCenter);
+                shader.set(boundsExtentLoc, proxy.mesh->boundsExtent);
+                cubeBoundsCurrent = false;
+                shader.set(modelLoc, proxy.model);
+                shader.set(layerLoc, proxy.materials[draw.submesh] ? LAYER_WALL : LAYER_CONTAINER);
+                hlod->draw(item.index);
+            }
+            else if (item.source == DRAW_SKINNED)
+            {
+                const SkinnedDraw &skinned = skinning->draws[item.index];
+                const GltfDraw &draw = scene->draws[skinned.draw];
+                const Mesh *mesh = scene->mesh(draw.primitive);
+                SceneProgram &program = sceneProgram(scene->isMasked(draw.material), !skinning->preSkinning, weighted);
+                program.shader->use();
+                sceneSampler->bind(1);
+                scene->baseColorTexture(draw.material).bind(1);
+                if (skinning->preSkinning)
+                {
+                    // world space floats already
+                    skinning->bindPreSkinned(skinned, *mesh);
+                    program.shader->set(program.model, glm::mat4(1.0f));
+                    program.shader->set(program.boundsCenter, glm::vec3(0.0f));
+                    program.shader->set(program.boundsExtent, glm::vec3(1.0f));
+                }
+                else
+                {
+                    mesh->bind();
+                    program.shader->set(program.firstJoint, skinning->instances[skinned.instance].firstJoint);
+                    program.shader->set(program.boundsCenter, mesh->boundsCenter);
+                    program.shader->set(program.boundsExtent, mesh->boundsExtent);
+                }
+                cubeBoundsCurrent = false;
+                program.shader->set(program.baseColor, scene->baseColorFactor(draw.material));
+                if (program.alphaCutoff.valid())
+                    program.shader->set(program.alphaCutoff, scene->alphaCutoff(draw.material));
+                mesh->draw();
+            }
+            else if (item.source == DRAW_CROWD)
+            {
+                const VertexAnimations::Draw &baked = crowd->draws[item.index];
+                const GltfDraw &draw = scene->draws[baked.draw];
+                SceneProgram &program = sceneProgram(scene->isMasked(draw.material), SCENE_CROWD, weighted);
+                program.shader->use();
+                sceneSampler->bind(1);
+                scene->baseColorTexture(draw.material).bind(1);
+                program.shader->set(program.firstTexel, baked.firstTexel);
+                program.shader->set(program.frameTexels, baked.frameTexels);
+                program.shader->set(program.baseColor, scene->baseColorFactor(draw.material));
+                if (program.alphaCutoff.valid())
+                    program.shader->set(program.alphaCutoff, scene->alphaCutoff(draw.material));
+                crowd->draw(item.index);
+            }
+            else
+            {
+                const GltfDraw &draw = scene->draws[item.index];
+                const Mesh *mesh = scene->mesh(draw.primitive);
+                SceneProgram &program = sceneProgram(scene->isMasked(draw.material), false, weighted);
+                program.shader->use();
+                sceneSampler->bind(1);
+                mesh->bind();
+                scene->baseColorTexture(draw.material).bind(1);
+                program.shader->set(program.model, draw.model);
+                program.shader->set(program.boundsCenter, mesh->boundsCenter);
+                program.shader->set(program.boundsExtent, mesh->boundsExtent);
+                cubeBoundsCurrent = false;
+                program.shader->set(program.baseColor, scene->baseColorFactor(draw.material));
+                if (program.alphaCutoff.valid())
+                    program.shader->set(program.alphaCutoff, scene->alphaCutoff(draw.material));
+                mesh->draw();
+            }
+        }
+        if (!skyDrawn)
+            environment->drawSky(projection * view, useReversedZ);
+        if (blending)
+        {
+            glState.disable(GL_BLEND);
+            glState.setDepthMask(true);
+        }
+        if (weighting)
+            oit->composite();
+        gpuProfiler.end();
+        renderQueue.clear();
+        if (shadingRates)
+            shadingRates->end();
+        double submitTime = glfwGetTime() - submitStart;
+
+        if (rayShadows && gbuffer.geometryFBO)
+        {
+            gpuProfiler.begin("ray traced shadows");
+            rayShadows->trace(gbuffer, sceneTarget.depth, lighting->sunDirection, frameData.viewProjection,
+                              useReversedZ);
+            gpuProfiler.end();
+        }
+        if (useDeferred && gbuffer.geometryFBO)
+        {
+            gpuProfiler.begin("lighting");
+            lighting->draw(gbuffer, sceneTarget.depth, lightSet.lights, frameData.viewProjection, useReversedZ);
+            gbuffer.resolve(sceneTarget.FBO);
+            gpuProfiler.end();
+        }
+
+        // over the lit opaque and transparent geometry, before anything resolves the frame
+        if (particles)
         {
+            gpuProfiler.begin("particles");
+            particles->draw();
+            gpuProfiler.end();
+        }
 
-            glm::mat4 model = glm::mat4(1.0f);
-            float angle = 10.0f * (i + 1) * (float)glfwGetTime();
-            model = glm::translate(model, cubePositions[i]);
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            shader.setMat4("model", model);
+        if (useMsaa)
+        {
+            gpuProfiler.begin("msaa resolve");
+            msaaTarget.resolve(sceneTarget.FBO);
+            gpuProfiler.end();
+        }
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        // next frame's occlusion test runs against everything drawn in this one
+        if (hiZ)
+        {
+            gpuProfiler.begin("hi-z build");
+            hiZ->build(renderWidth, renderHeight, frameData.viewProjection);
+            gpuProfiler.end();
+        }
+        // the frame from here on, with the TAA resolved at the window's size, so it doesn't need the upscale
+        const Texture2D *resolved = &sceneTarget.color;
+        if (taa && sceneTarget.FBO)
+        {
+            // only the objects with a Motion can have moved
+            bool firstFrame = previousModels.size() != cubes.size();
+            previousModels.resize(cubes.size());
+            motions.clear();
+            objects.each<Motion, Transform, Renderable>(
+                [&](Entity, const Motion &, const Transform &transform, const Renderable &renderable) {
+                    glm::mat4 &previous = previousModels[renderable.drawIndex];
+                    if (!firstFrame && transform.world != previous)
+                        motions.push_back({transform.world, previous});
+                    previous = transform.world;
+                });
+            gpuProfiler.begin("velocity");
+            taa->drawVelocities(sceneTarget.depth, *cube, motions, sceneTarget.FBO);
+            gpuProfiler.end();
+            gpuProfiler.begin("taa resolve");
+            taa->resolve(sceneTarget.color, sceneTarget.depth, framebufferWidth, framebufferHeight);
+            gpuProfiler.end();
+            if (taa->output())
+                resolved = &taa->output()->color;
+        }
+        // the tone mapped frame goes through the FXAA and the upscale when they are on, else to the window
+        bool upscaling = dynamicScale && !taa;
+        const Texture2D *upscaleSource = &sceneTarget.color;
+        unsigned int upscaleFBO = 0;
+        if (upscaling && (post || useFxaa) && sceneTarget.FBO)
+        {
+            upscaleFBO = dynamicScale->inputFramebuffer(resolved->width, resolved->height);
+            upscaleSource = dynamicScale->inputTexture();
+        }
+        const Texture2D *fxaaSource = resolved;
+        if (post && sceneTarget.FBO)
+        {
+            // in place of the blit, the last pass writes the window or the frame to anti-alias or upscale
+            gpuProfiler.begin("post");
+            unsigned int target = upscaleFBO;
+            if (useFxaa)
+            {
+                target = fxaa.inputFramebuffer(resolved->width, resolved->height);
+                fxaaSource = fxaa.inputTexture();
+            }
+            if (ssao)
+                ssao->prepare(sceneTarget.depth, projection, projection * view, resolved->width, resolved->height,
+                              gpuProfiler);
+            if (reflections)
+                reflections->prepare(*hiZ, projection, view, resolved->width, resolved->height);
+            if (exposureMeter)
+                exposureMeter->prepare(deltaTime);
+            post->execute(*resolved, resolved->width, resolved->height, target, gpuProfiler);
+            gpuProfiler.end();
+        }
+        if (useFxaa && sceneTarget.FBO && fxaaSource)
+        {
+            gpuProfiler.begin("fxaa");
+            fxaa.draw(*fxaaSource, upscaleFBO);
+            gpuProfiler.end();
+        }
+        if (upscaling && sceneTarget.FBO)
+        {
+            gpuProfiler.begin("upscale");
+            if (upscaleSource)
+                dynamicScale->upscale(*upscaleSource, framebufferWidth, framebufferHeight, gpuProfiler);
+            gpuProfiler.end();
+        }
+        else if ((useReversedZ || useDeferred || taa || useMsaa || oit) && sceneTarget.FBO && !benchmarking && !post &&
+                 !useFxaa)
+        {
+            gpuProfiler.begin("blit");
+            if (taa && taa->output())
+                taa->blitToDefault();
+            else
+                sceneTarget.blitToDefault();
+            gpuProfiler.end();
+        }
+        if (labels)
+        {
+            ALLOC_TAG("labels");
+            gpuProfiler.begin("labels");
+            labels->begin(framebufferWidth, framebufferHeight);
+            glm::mat4 viewProjection = projection * view;
+            size_t labelCount = std::min(culler.visible.size(), MAX_LABELS);
+            for (size_t n = 0; n < labelCount; n++)
+            {
+                uint32_t i = culler.visible[n];
+                glm::vec3 above = glm::vec3(cubeModel(i)[3]) + glm::vec3(0.0f, 0.9f, 0.0f);
+                labels->label(viewProjection, above, frameArena.format("cube %u", (unsigned int)i), 14.0f,
+                              SpriteBatch::rgba(255, 255, 255, 220));
+            }
+            labels->end();
+            gpuProfiler.end();
+        }
+        if (spriteBatch)
+        {
+            ALLOC_TAG("sprites");
+            gpuProfiler.begin("sprites");
+            spriteBatch->begin(framebufferWidth, framebufferHeight);
+            // every sprite drifts and spins on its own, added in no particular texture order
+            for (int i = 0; i < spriteCount; i++)
+            {
+                uint32_t hash = (uint32_t)i * 2654435761u;
+                float startX = (float)(hash >> 16) / 65536.0f, startY = (float)(hash & 0xFFFF) / 65536.0f;
+                float x = std::fmod(startX + currentFrame * (0.02f + (float)(i % 7) * 0.01f), 1.0f);
+                float y = std::fmod(startY + currentFrame * (0.015f + (float)(i % 5) * 0.01f), 1.0f);
+                float size = 6.0f + (float)(i % 4) * 4.0f;
+                spriteBatch->draw(spriteTextures[i % spriteTextures.size()], x * framebufferWidth,
+                                  y * framebufferHeight, size, size, 0xFFFFFFFFu, currentFrame + startX * 6.28f);
+            }
+            spriteBatch->end();
+            gpuProfiler.end();
+        }
+        if (showHud)
+        {
+            ALLOC_TAG("hud");
+            // counters of the frame drawn so far, the HUD's own draw isn't in them
+            float frameTime = hud.averageFrameTime();
+            float x = 8.0f, y = 8.0f, line = Hud::lineHeight();
+            uint32_t white = Hud::rgba(255, 255, 255), grey = Hud::rgba(180, 180, 180);
+            // formatted into the frame arena, the HUD doesn't allocate
+            std::string_view scale =
+                dynamicScale ? frameArena.format("  scale %d%%", (int)(dynamicScale->scale * 100.0f + 0.5f)) : "";
+            std::string_view cpuPick =
+                cubePicked ? frameArena.format("  pick %u at %.3g", (unsigned int)pickedCube, pickedDistance) : "";
+            std::string_view gpuPick = picker && picker->picked
+                                           ? frameArena.format("  gpu %u +%u", (unsigned int)picker->object,
+                                                               (unsigned int)picker->latency)
+                                           : "";
+            std::string_view streamed =
+                textureLoader.residency ? frameArena.format("  streamed %llu/%d",
+                                                            (unsigned long long)(residency.residentBytes / (1024 * 1024)),
+                                                            textureBudget)
+                                        : "";
+            std::string_view calls =
+                glCalls.enabled() ? frameArena.format("  gl calls %llu", (unsigned long long)glCalls.frameCalls) : "";
+            std::string_view pages = virtualTexture ? frameArena.format("  pages %u/%u",
+                                                                        (unsigned int)virtualTexture->resident,
+                                                                        (unsigned int)virtualTexture->cacheCapacity())
+                                                    : "";
+            std::string_view triangles =
+                triangleFilter ? frameArena.format("  kept %llu/%llu",
+                                                   (unsigned long long)triangleFilter->trianglesKept,
+                                                   (unsigned long long)triangleFilter->trianglesTested)
+                               : "";
+            std::string_view lines[] = {
+                frameArena.format("fps %d  %.4g ms%.*s", (int)(frameTime > 0.0f ? 1000.0f / frameTime + 0.5f : 0.0f),
+                                  frameTime, (int)scale.size(), scale.data()),
+                frameArena.format("draws %llu  tris %llu%.*s  allocs %llu", (unsigned long long)renderStats.drawCalls,
+                                  (unsigned long long)renderStats.triangles, (int)triangles.size(), triangles.data(),
+                                  (unsigned long long)AllocTracker::instance().frameAllocations),
+                frameArena.format("state changes %llu  filtered %llu%.*s", (unsigned long long)glState.issued,
+                                  (unsigned long long)glState.filtered, (int)calls.size(), calls.data()),
+                frameArena.format("uniforms %llu  unchanged %llu  reused %llu kb%.*s%.*s",
+                                  (unsigned long long)renderStats.uniformUploads,
+                                  (unsigned long long)renderStats.uniformSkips,
+                                  (unsigned long long)(ring.reusedBytes / 1024), (int)cpuPick.size(), cpuPick.data(),
+                                  (int)gpuPick.size(), gpuPick.data()),
+                frameArena.format("gpu mem %llu mb  aa %s%.*s%.*s",
+                                  (unsigned long long)(gpuMemory.total() / (1024 * 1024)),
+                                  antiAliasingName(antiAliasing), (int)streamed.size(), streamed.data(),
+                                  (int)pages.size(), pages.data())};
+            float panelWidth = 340.0f;
+            hud.rect(x - 4.0f, y - 4.0f, panelWidth, line * 5 + 4.0f, Hud::rgba(0, 0, 0, 160));
+            for (std::string_view text : lines)
+            {
+                hud.text(x, y, text, white);
+                y += line;
+            }
+            hud.graph(x - 4.0f, y + 4.0f, panelWidth, 60.0f, 50.0f);
+            y += 72.0f;
+            hud.rect(x - 4.0f, y - 4.0f, panelWidth, line * gpuProfiler.passes.size() + 4.0f, Hud::rgba(0, 0, 0, 160));
+            for (const GpuPassStats &pass : gpuProfiler.passes)
+            {
+                hud.text(x, y, frameArena.format("%s %.4g ms", pass.name.c_str(), pass.average), grey);
+                y += line;
+            }
+            gpuProfiler.begin("hud");
+            hud.draw(framebufferWidth, framebufferHeight);
+            gpuProfiler.end();
         }
-        // glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        gpuProfiler.end();
 
-        glfwSwapBuffers(window);
+        if (capture.recording())
+        {
+            // the benchmark leaves its frame offscreen unless a pass after the resolve wrote the window
+            GL_ZONE("capture");
+            unsigned int captureFBO = 0;
+            if (benchmarking && sceneTarget.FBO && !post && !useFxaa && !upscaling)
+                captureFBO = taa && taa->output() ? taa->output()->FBO : sceneTarget.FBO;
+            capture.capture(captureFBO, framebufferWidth, framebufferHeight);
+        }
+        ring.endFrame();
+        deletionQueue.endFrame();
+        if (secondaryWindow.window)
+        {
+            GL_ZONE("debug window");
+            if (secondaryWindow.open())
+                secondaryWindow.present(debugTarget.color.ID, debugTarget.width, debugTarget.height);
+            else
+                secondaryWindow.destroy();
+        }
+        float cpuFrameMs = (float)((glfwGetTime() - cpuFrameStart) * 1000.0);
+        {
+            PROFILE_ZONE("swap");
+            GL_CHECK_ERRORS("frame");
+            glfwSwapBuffers(window);
+            framePacer.afterSwap();
+        }
+        if (qualityGovernor && !benchmarking)
+        {
+            governor.holdGpu = dynamicScale && dynamicScale->scale > dynamicScale->minScale;
+            if (governor.update(cpuFrameMs, gpuProfiler, glfwGetTime()))
+                applyQuality();
+        }
+        // the frame's calls are in, the switch lands between two frames
+        if (glCalls.enabled())
+            glCalls.endFrame();
+        glCalls.enable(countGLCalls);
+        if (detectHitches || telemetry.listening())
+        {
+            FrameCounters counters;
+            counters.drawCalls = renderStats.drawCalls;
+            counters.triangles = renderStats.triangles;
+            counters.uniformUploads = renderStats.uniformUploads;
+            counters.stateChanges = glState.issued;
+            counters.glCalls = glCalls.enabled() ? glCalls.frameCalls : 0;
+            if (detectHitches)
+                hitchDetector.endFrame(counters, gpuProfiler);
+            if (telemetry.listening())
+            {
+                TelemetryMemory memory;
+                memory.gpuBytes = gpuMemory.total();
+                memory.driverFree = gpuMemory.driverFree;
+                memory.frameAllocations = AllocTracker::instance().frameAllocations;
+                memory.frameBytes = AllocTracker::instance().frameBytes;
+                telemetry.endFrame(counters, memory, gpuProfiler);
+                // the GPU zones are only placed on the CPU's clock while someone looks at them
+                gpuProfiler.history = detectHitches || telemetry.connected();
+            }
+        }
+        if (glTrace.recording())
+        {
+            int traceWidth, traceHeight;
+            glfwGetFramebufferSize(window, &traceWidth, &traceHeight);
+            if (!glTrace.endFrame(traceWidth, traceHeight))
+                glfwSetWindowShouldClose(window, true);
+        }
+        if (!startupTimeline.firstFrameDone())
+        {
+            startupTimeline.phase("first frame", frameBegin);
+            startupTimeline.markFirstFrame();
+        }
+        // the cold start ends once the streamed textures are in as well
+        if (!startupTimeline.finished() && textureLoader.pending() == 0 && assets.pending() == 0)
+            finishStartup();
+        input.endFrame(deltaTime);
+        if (input.finished())
+            glfwSetWindowShouldClose(window, true);
         glfwPollEvents();
+        if (redraw.enabled())
+        {
+            redrawBusy = sceneAnimates ? REDRAW_ANIMATION : REDRAW_NONE;
+            // held keys move the camera without new events
+            if (camera.GetViewMatrix() != redrawView)
+                redrawBusy |= REDRAW_INPUT;
+            redrawView = camera.GetViewMatrix();
+            if (windowSize.settling())
+                redrawBusy |= REDRAW_RESIZE;
+            if (textureLoader.pending() || assets.pending() || uploadContext.pending() || (world && world->pending) ||
+                (voxelStreamer && voxelStreamer->pending) || (impostors && !impostors->baked) ||
+                !startupTimeline.finished())
+                redrawBusy |= REDRAW_STREAMING;
+        }
+
+        if (benchmarking)
+        {
+            double now = glfwGetTime();
+            if (!texturesLoaded && textureLoader.pending() == 0 && assets.pending() == 0)
+            {
+                texturesLoaded = true;
+                benchmark.textureMs = (float)((now - sceneStart) * 1000.0);
+            }
+            else if (texturesLoaded && warmupFrames > 0)
+            {
+                warmupFrames--;
+            }
+            else if (texturesLoaded)
+            {
+                benchmark.addCpu((float)((now - frameStart) * 1000.0), (float)(submitTime * 1000.0),
+                                 renderStats.drawCalls);
+                if (++benchmarkFrame >= benchmarkFrames)
+                    glfwSetWindowShouldClose(window, true);
+                if (benchmarkAntiAliasing && ++modeFrame >= benchmarkModeFrames &&
+                    antiAliasing + 1 < AA_MODE_COUNT)
+                {
+                    antiAliasing = (AntiAliasingMode)(antiAliasing + 1);
+                    modeFrame = 0;
+                }
+            }
+            frameStart = now;
+        }
     }
+    AllocTracker::guard(false);
+    // the frames in flight may still draw the meshes, the pool keeps them until the scene goes
+    if (scene)
+        scene->unload(deletionQueue.frame);
+    if (warmPipelines && !renderThreadMode)
+        pipelineWarmup.save(shaderCompiler);
+    if (allocationsGuarded && AllocTracker::instance().violations > 0)
+        std::cout << "ERROR::ALLOC_TRACKER::STEADY_STATE_ALLOCATIONS: " << AllocTracker::instance().violations.load()
+                  << " allocations after the warmup\n";
 
-    glfwTerminate();
-    return 0;
+    if (benchmarking)
+    {
+        std::string path = useIndirect ? "indirect" : instancedRendering ? "instanced" : "per draw";
+        std::string description = std::string((const char *)glGetString(GL_RENDERER)) + ", " +
+                                  std::to_string(benchmarkWidth) + "x" + std::to_string(benchmarkHeight) + ", " +
+                                  path;
+        // with the programs built on the way, the alpha tested and skinned ones
+        benchmark.shaders = shaderCompiler.stats();
+        if (!benchmarkOutput.empty())
+            benchmark.write(benchmarkOutput, description);
+        benchmarkResult = benchmark.result(description);
+        std::cout << "benchmark: " << benchmark.report() << ", shaders " << benchmark.shaderMs << " ms, textures "
+                  << benchmark.textureMs << " ms\n";
+        std::cout << benchmark.variantReport();
+    }
+    if (capture.recording())
+    {
+        capture.stop();
+        unsigned long captured = capture.frames + capture.dropped;
+        std::cout << "capture: " << capture.frames << " frames of video to " << videoPath << ", " << capture.dropped
+                  << " dropped, " << capture.stalls << " stalls, "
+                  << (captured ? capture.captureSeconds * 1000.0 / captured : 0.0) << " ms per frame\n";
+    }
+    if (redraw.enabled())
+        std::cout << redraw.report(glfwGetTime() - redrawStart);
+    framePacer.fences = nullptr;
+    // closed before the textures arrived
+    if (!startupTimeline.finished())
+        finishStartup();
+}
+
+// stops the startup timeline and reports it
+void finishStartup()
+{
+    startupTimeline.finish();
+    if (printStartup)
+        std::cout << startupTimeline.report();
+    if (!startupTracePath.empty())
+        startupTimeline.writeChromeTrace(startupTracePath);
 }
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    // the viewport, the camera and the render targets follow when the frame commits the size
+    windowSize.request(width, height, glfwGetTime());
+    redraw.request(REDRAW_RESIZE);
+}
+
+// once per frame, before anything reads the size: true when a settled resize was committed
+bool commitWindowSize()
+{
+    if (!windowSize.update(glfwGetTime()))
+        return false;
+    // the camera rebuilds its projection on the next frame
+    camera.setLens(windowSize.aspectRatio(), zNear, zFar);
+    return true;
 }
 
 void processInput(GLFWwindow *window)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    // this frame's events, live or replayed
+    input.beginFrame();
+    // the camera turns and zooms once per frame, by everything the frame's events added up to
+    double cursorX, cursorY;
+    if (input.cursor(cursorX, cursorY))
+        processCursor(cursorX, cursorY);
+    if (input.scrolledY() != 0.0)
+        camera.processMouseScroll(input.scrolledY(), false);
+
+    if (input.isDown(GLFW_KEY_ESCAPE))
     {
         glfwSetWindowShouldClose(window, true);
     }
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if (input.pressed(GLFW_KEY_F1))
+        showHud = !showHud;
+    if (input.pressed(GLFW_KEY_F2))
+        antiAliasing = (AntiAliasingMode)((antiAliasing + 1) % AA_MODE_COUNT);
+    if (input.pressed(GLFW_KEY_F3))
+        showOverdraw = overdrawView && !showOverdraw;
+    if (input.pressed(GLFW_KEY_F4))
+        countGLCalls = !countGLCalls;
+    if (input.isDown(GLFW_KEY_W))
     {
         camera.processKeyboard(FORWARD, deltaTime);
     }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    if (input.isDown(GLFW_KEY_S))
     {
         camera.processKeyboard(BACKWARD, deltaTime);
     }
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if (input.isDown(GLFW_KEY_A))
     {
         camera.processKeyboard(LEFT, deltaTime);
     }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if (input.isDown(GLFW_KEY_D))
     {
         camera.processKeyboard(RIGHT, deltaTime);
     }
 }
 
-void mouse_callback(GLFWwindow *window, double xpos, double ypos)
+// turns cursor positions into camera rotation
+void processCursor(double xpos, double ypos)
 {
     static double lastX = WIDTH / 2;
     static double lastY = HEIGHT / 2;
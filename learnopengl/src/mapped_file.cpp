@@ -0,0 +1,165 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+// glad defines APIENTRY the same way windows.h does
+#undef APIENTRY
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read only memory mapping of a whole file, the pages are read in by the OS
+// the first time they are touched and nothing is copied into our own buffers.
+class MappedFile
+{
+  public:
+    const unsigned char *data = NULL;
+    size_t size = 0;
+
+    MappedFile()
+    {
+    }
+
+    MappedFile(const std::string &path)
+    {
+        open(path);
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &path)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping)
+        {
+            close();
+            return false;
+        }
+        data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!data)
+        {
+            close();
+            return false;
+        }
+        size = (size_t)fileSize.QuadPart;
+#else
+        descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0)
+            return false;
+        struct stat info;
+        if (fstat(descriptor, &info) != 0 || info.st_size == 0)
+        {
+            close();
+            return false;
+        }
+        void *view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (view == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+        data = (const unsigned char *)view;
+        size = (size_t)info.st_size;
+#endif
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data)
+            munmap((void *)data, size);
+        if (descriptor >= 0)
+            ::close(descriptor);
+        descriptor = -1;
+#endif
+        data = NULL;
+        size = 0;
+    }
+
+    bool isOpen() const
+    {
+        return data != NULL;
+    }
+
+    // readahead hint: the OS starts reading [offset, offset + length) in the background,
+    // so the first touch doesn't wait on the disk
+    void willNeed(size_t offset, size_t length) const
+    {
+        if (!data || offset >= size)
+            return;
+        length = std::min(length, size - offset);
+#ifdef _WIN32
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+        WIN32_MEMORY_RANGE_ENTRY range = {(PVOID)(data + offset), length};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+        // madvise wants a page aligned start
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t start = offset / page * page;
+        madvise((void *)(data + start), length + (offset - start), MADV_WILLNEED);
+#endif
+    }
+
+    // asks the kernel to back the mapping with huge pages where it can map files that way (read
+    // only file THP), so a pack read all over doesn't miss the TLB every 4 KB; nothing elsewhere
+    void adviseHugePages() const
+    {
+#if !defined(_WIN32) && defined(MADV_HUGEPAGE)
+        if (data)
+            madvise((void *)data, size, MADV_HUGEPAGE);
+#endif
+    }
+
+  private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int descriptor = -1;
+#endif
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "block_layout.cpp"
+#include "gl_extensions.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+
+#include <cstddef>
+#include <vector>
+
+// one material as the cube shaders read it (shader_src/material.glsl), the same in std430
+struct GpuMaterial
+{
+    // multiplies the blended albedo
+    glm::vec4 tint = glm::vec4(1.0f);
+    // x layer of the materials array, y layer blended over it, zw unused
+    glm::ivec4 layers = glm::ivec4(0);
+    // x how much of the y layer goes over the x one, yzw unused
+    glm::vec4 params = glm::vec4(0.0f);
+};
+
+constexpr BlockMember GPU_MATERIAL_LAYOUT[] = {
+    BLOCK_MEMBER(GpuMaterial, tint, GL_FLOAT_VEC4),
+    BLOCK_MEMBER(GpuMaterial, layers, GL_INT_VEC4),
+    BLOCK_MEMBER(GpuMaterial, params, GL_FLOAT_VEC4),
+};
+static_assert(blockLayoutMismatch(GPU_MATERIAL_LAYOUT, STD430) == -1,
+              "GpuMaterial members are not where std430 puts them");
+static_assert(blockLayoutSize(GPU_MATERIAL_LAYOUT, STD430) == sizeof(GpuMaterial),
+              "GpuMaterial is not padded like std430");
+
+// The parameters of every cube material in one storage buffer, indexed by the per-instance
+// layer the vertex stages already hand on (see SHADER_MATERIAL_TABLE). What used to be the
+// decalLayer uniform and the constant 0.3 of the cube fragment shaders is a row of it, so
+// cubes of any material are drawn by one program with nothing set between them, and a pass
+// merging them into one instanced or indirect draw isn't split by uniform values.
+// Rows are edited on the CPU and the whole table goes up again on the next upload().
+class MaterialTable
+{
+  public:
+    // shader storage binding of the table (see shader_src/material.glsl)
+    static const unsigned int BINDING = 23;
+
+    std::vector<GpuMaterial> materials;
+
+    MaterialTable()
+    {
+    }
+
+    ~MaterialTable()
+    {
+        deleteBuffers(1, &buffer);
+    }
+
+    MaterialTable(const MaterialTable &) = delete;
+    MaterialTable &operator=(const MaterialTable &) = delete;
+
+    // storage buffers are core since 4.3, the 330 shaders take them and the binding through
+    // the extensions material.glsl enables
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_3 && hasGLExtension("GL_ARB_shader_storage_buffer_object") &&
+               hasGLExtension("GL_ARB_shading_language_420pack");
+    }
+
+    // a material showing layer with decalLayer blended over it at decalBlend, its index
+    unsigned int add(int layer, int decalLayer, float decalBlend, const glm::vec4 &tint = glm::vec4(1.0f))
+    {
+        GpuMaterial material;
+        material.tint = tint;
+        material.layers = glm::ivec4(layer, decalLayer, 0, 0);
+        material.params = glm::vec4(decalBlend, 0.0f, 0.0f, 0.0f);
+        materials.push_back(material);
+        dirty = true;
+        return (unsigned int)materials.size() - 1;
+    }
+
+    void set(unsigned int index, const GpuMaterial &material)
+    {
+        if (index >= materials.size())
+            return;
+        materials[index] = material;
+        dirty = true;
+    }
+
+    // GL thread, before drawing: the table into its buffer when it changed, bound to BINDING
+    void upload()
+    {
+        if (!dirty || materials.empty())
+            return;
+        dirty = false;
+        size_t bytes = materials.size() * sizeof(GpuMaterial);
+        if (bytes > capacity)
+        {
+            deleteBuffers(1, &buffer);
+            capacity = bytes;
+            buffer = createBuffer(capacity, materials.data(), GL_DYNAMIC_STORAGE_BIT, GL_DYNAMIC_DRAW);
+        }
+        else
+            updateBuffer(buffer, 0, bytes, materials.data());
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, buffer, 0, 0);
+    }
+
+  private:
+    unsigned int buffer = 0;
+    size_t capacity = 0;
+    bool dirty = false;
+};
+
+#endif
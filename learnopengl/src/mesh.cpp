@@ -0,0 +1,554 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "render_stats.cpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// range of indices drawn with one material
+struct Submesh
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+// one level of detail: a range of indices over the same vertices as the full mesh,
+// firstIndex counts from the mesh's first index. Mirrors MeshLod in shader_src/cull.comp
+struct MeshLod
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    // largest distance the simplification moved the surface, in model units
+    float error;
+    uint32_t reserved;
+};
+static_assert(sizeof(MeshLod) == 16, "MeshLod is 4 tightly packed words");
+
+// at most this many levels per mesh, the full one included
+#define MESH_MAX_LODS 6
+
+// a small cluster of level 0's triangles (see meshlets.cpp), culled on its own by the GPU.
+// Mirrors Meshlet in shader_src/meshlet_cull.comp
+struct Meshlet
+{
+    // of the triangle range, counted from the mesh's first index
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t reserved[2];
+    // model space bounding sphere, xyz center and w radius
+    glm::vec4 sphere;
+    // xyz the average facing of the triangles, w the sine of the widest angle between it and
+    // any of them; 1 when they face too many ways for the whole cluster to ever face away
+    glm::vec4 cone;
+};
+static_assert(sizeof(Meshlet) == 48, "Meshlet must match the std430 layout");
+
+// Turns a triangle list of interleaved float vertices into unique vertices plus
+// indices, so shared corners are stored and transformed once
+// and the post-transform vertex cache gets hits.
+// Meshes with up to 65536 vertices are uploaded with 16-bit indices.
+class MeshBuilder
+{
+  public:
+    // floats per vertex
+    int stride;
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    // triangle ranges, e.g. the groups of an OBJ file, empty means one range over everything
+    std::vector<Submesh> submeshes;
+    // the simplified levels behind the full one (see mesh_simplifier.cpp), empty means only
+    // one level over every index; the submeshes describe level 0
+    std::vector<MeshLod> lods;
+    // clusters of level 0 for the meshlet cull pass, empty when not built
+    std::vector<Meshlet> meshlets;
+
+    MeshBuilder(int stride) : stride(stride)
+    {
+    }
+
+    // appends one triangle list corner, reusing an identical earlier vertex
+    void add(const float *vertex)
+    {
+        std::string key((const char *)vertex, stride * sizeof(float));
+        auto found = unique.find(key);
+        if (found != unique.end())
+        {
+            indices.push_back(found->second);
+            return;
+        }
+        uint32_t index = (uint32_t)vertexCount();
+        vertices.insert(vertices.end(), vertex, vertex + stride);
+        unique.emplace(std::move(key), index);
+        indices.push_back(index);
+    }
+
+    void addTriangles(const float *triangleVertices, size_t vertexCount)
+    {
+        for (size_t i = 0; i < vertexCount; i++)
+            add(triangleVertices + i * stride);
+    }
+
+    // closes the indices added since the last call into a submesh
+    void endSubmesh()
+    {
+        uint32_t first = submeshes.empty() ? 0 : submeshes.back().firstIndex + submeshes.back().indexCount;
+        if (indices.size() > first)
+            submeshes.push_back({first, (uint32_t)indices.size() - first});
+    }
+
+    size_t vertexCount() const
+    {
+        return vertices.size() / stride;
+    }
+
+    // 2 or 4
+    size_t indexSize() const
+    {
+        return vertexCount() <= 0x10000 ? 2 : 4;
+    }
+
+    // the levels of detail, level 0 covers every index unless simplified ones were appended
+    std::vector<MeshLod> levels() const
+    {
+        if (!lods.empty())
+            return lods;
+        return {{0, (uint32_t)indices.size(), 0.0f, 0}};
+    }
+
+    // the indices in indexSize() bytes each
+    std::vector<unsigned char> packIndices() const
+    {
+        std::vector<unsigned char> packed(indices.size() * indexSize());
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            if (indexSize() == 2)
+            {
+                uint16_t index = (uint16_t)indices[i];
+                std::memcpy(&packed[i * 2], &index, 2);
+            }
+            else
+            {
+                std::memcpy(&packed[i * 4], &indices[i], 4);
+            }
+        }
+        return packed;
+    }
+
+    // moves the vertices into a new order, order[i] is the old index of vertex i (each old
+    // index at most once, the ones left out are dropped), the indices follow
+    void reorderVertices(const std::vector<uint32_t> &order)
+    {
+        std::vector<uint32_t> remap(vertexCount(), 0);
+        std::vector<float> reordered(order.size() * stride);
+        unique.clear();
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const float *vertex = &vertices[(size_t)order[i] * stride];
+            std::copy(vertex, vertex + stride, &reordered[i * stride]);
+            unique.emplace(std::string((const char *)vertex, stride * sizeof(float)), (uint32_t)i);
+            remap[order[i]] = (uint32_t)i;
+        }
+        vertices = std::move(reordered);
+        for (uint32_t &index : indices)
+            index = remap[index];
+    }
+
+  private:
+    // vertex bytes -> index
+    std::unordered_map<std::string, uint32_t> unique;
+};
+
+// storage type of one attribute in the GPU vertex buffer
+enum class VertexFormat
+{
+    Float,
+    HalfFloat,
+    // normalized integers, [-1, 1] or [0, 1]
+    Snorm16,
+    Unorm16,
+    Snorm8,
+    Unorm8,
+    // 3 signed normalized 10-bit components + 2 bits, for normals and tangents (4 bytes)
+    Int2_10_10_10_Rev,
+    // unsigned 8-bit integers read as uvec by the shader, e.g. joint indices
+    Uint8,
+};
+
+// one attribute: how many floats it takes in the MeshBuilder vertex and how it is stored on the GPU
+struct VertexElement
+{
+    unsigned int location;
+    int components;
+    VertexFormat format = VertexFormat::Float;
+    // quantized relative to the mesh bounding box, positions stored as Snorm16
+    // are decoded in the vertex shader with boundsCenter + value * boundsExtent
+    bool boundsRelative = false;
+};
+
+// how the GPU reads an element of format with components source floats
+struct VertexFormatInfo
+{
+    GLenum type;
+    GLint components;
+    GLboolean normalized;
+    // read by the shader as ints (glVertexAttribIFormat)
+    bool integer;
+    // bytes in the vertex before the 4 byte alignment
+    size_t bytes;
+};
+
+constexpr VertexFormatInfo vertexFormatInfo(VertexFormat format, int components)
+{
+    switch (format)
+    {
+    case VertexFormat::HalfFloat:
+        return {GL_HALF_FLOAT, components, GL_FALSE, false, (size_t)components * 2};
+    case VertexFormat::Snorm16:
+        return {GL_SHORT, components, GL_TRUE, false, (size_t)components * 2};
+    case VertexFormat::Unorm16:
+        return {GL_UNSIGNED_SHORT, components, GL_TRUE, false, (size_t)components * 2};
+    case VertexFormat::Snorm8:
+        return {GL_BYTE, components, GL_TRUE, false, (size_t)components};
+    case VertexFormat::Unorm8:
+        return {GL_UNSIGNED_BYTE, components, GL_TRUE, false, (size_t)components};
+    case VertexFormat::Int2_10_10_10_Rev:
+        // always 4 components, w is 0 for 3 component sources
+        return {GL_INT_2_10_10_10_REV, 4, GL_TRUE, false, 4};
+    case VertexFormat::Uint8:
+        return {GL_UNSIGNED_BYTE, components, GL_FALSE, true, (size_t)components};
+    default:
+        return {GL_FLOAT, components, GL_FALSE, false, (size_t)components * 4};
+    }
+}
+
+// offset of the element after one of size bytes at offset
+constexpr size_t nextVertexOffset(size_t offset, size_t size)
+{
+    return offset + ((size + 3) & ~(size_t)3);
+}
+
+// GPU vertex layout, attributes are interleaved in declaration order at 4 byte aligned offsets
+class VertexLayout
+{
+  public:
+    std::vector<VertexElement> elements;
+    std::vector<size_t> offsets;
+    size_t stride = 0;
+
+    VertexLayout()
+    {
+    }
+
+    VertexLayout(std::initializer_list<VertexElement> list) : VertexLayout(std::vector<VertexElement>(list))
+    {
+    }
+
+    VertexLayout(const std::vector<VertexElement> &list) : elements(list)
+    {
+        for (const VertexElement &element : elements)
+        {
+            offsets.push_back(stride);
+            stride = nextVertexOffset(stride, size(element));
+        }
+    }
+
+    // bytes one element takes in the vertex
+    static size_t size(const VertexElement &element)
+    {
+        return vertexFormatInfo(element.format, element.components).bytes;
+    }
+
+    bool operator==(const VertexLayout &other) const
+    {
+        if (elements.size() != other.elements.size())
+            return false;
+        for (size_t i = 0; i < elements.size(); i++)
+        {
+            const VertexElement &a = elements[i], &b = other.elements[i];
+            if (a.location != b.location || a.components != b.components || a.format != b.format ||
+                a.boundsRelative != b.boundsRelative)
+                return false;
+        }
+        return true;
+    }
+
+    // vertex buffer binding of the VAO the layout's attributes read from
+    static const unsigned int BINDING = 0;
+
+    // points the attributes of vertexArray at buffer, on DSA as formats of one vertex buffer binding
+    void apply(unsigned int vertexArray, unsigned int buffer) const
+    {
+        if (hasDSA())
+        {
+            glVertexArrayVertexBuffer(vertexArray, BINDING, buffer, 0, (GLsizei)stride);
+        }
+        else
+        {
+            glState.bindVertexArray(vertexArray);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        }
+        for (size_t i = 0; i < elements.size(); i++)
+        {
+            const VertexElement &element = elements[i];
+            VertexFormatInfo info = vertexFormatInfo(element.format, element.components);
+            GLenum type = info.type;
+            GLboolean normalized = info.normalized;
+            GLint components = info.components;
+            bool integer = info.integer;
+            if (hasDSA())
+            {
+                if (integer)
+                    glVertexArrayAttribIFormat(vertexArray, element.location, components, type, (GLuint)offsets[i]);
+                else
+                    glVertexArrayAttribFormat(vertexArray, element.location, components, type, normalized,
+                                              (GLuint)offsets[i]);
+                glVertexArrayAttribBinding(vertexArray, element.location, BINDING);
+                glEnableVertexArrayAttrib(vertexArray, element.location);
+            }
+            else
+            {
+                if (integer)
+                    glVertexAttribIPointer(element.location, components, type, (GLsizei)stride, (void *)offsets[i]);
+                else
+                    glVertexAttribPointer(element.location, components, type, normalized, (GLsizei)stride,
+                                          (void *)offsets[i]);
+                glEnableVertexAttribArray(element.location);
+            }
+        }
+    }
+};
+
+// vertices converted to a VertexLayout, plus the box boundsRelative elements were quantized against
+struct PackedVertices
+{
+    std::vector<unsigned char> data;
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    glm::vec3 boundsExtent = glm::vec3(1.0f);
+};
+
+// quantizes the float vertices of a builder at load time, the floats of each element
+// are read consecutively from the builder vertex in layout order
+inline PackedVertices packVertices(const MeshBuilder &builder, const VertexLayout &layout)
+{
+    PackedVertices packed;
+    size_t count = builder.vertexCount();
+    packed.data.assign(count * layout.stride, 0);
+
+    // bounding box of the first boundsRelative element
+    size_t sourceOffset = 0;
+    for (const VertexElement &element : layout.elements)
+    {
+        if (element.boundsRelative && count > 0)
+        {
+            glm::vec3 low(1e30f), high(-1e30f);
+            for (size_t v = 0; v < count; v++)
+            {
+                const float *value = &builder.vertices[v * builder.stride + sourceOffset];
+                for (int c = 0; c < element.components && c < 3; c++)
+                {
+                    low[c] = std::min(low[c], value[c]);
+                    high[c] = std::max(high[c], value[c]);
+                }
+            }
+            for (int c = 0; c < 3; c++)
+            {
+                if (c >= element.components)
+                    low[c] = high[c] = 0.0f;
+                packed.boundsCenter[c] = (low[c] + high[c]) * 0.5f;
+                packed.boundsExtent[c] = high[c] > low[c] ? (high[c] - low[c]) * 0.5f : 1.0f;
+            }
+            break;
+        }
+        sourceOffset += element.components;
+    }
+
+    for (size_t v = 0; v < count; v++)
+    {
+        const float *source = &builder.vertices[v * builder.stride];
+        unsigned char *vertex = &packed.data[v * layout.stride];
+        for (size_t i = 0; i < layout.elements.size(); i++)
+        {
+            const VertexElement &element = layout.elements[i];
+            float value[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            for (int c = 0; c < element.components && c < 4; c++)
+            {
+                value[c] = source[c];
+                if (element.boundsRelative && c < 3)
+                    value[c] = (value[c] - packed.boundsCenter[c]) / packed.boundsExtent[c];
+            }
+            source += element.components;
+
+            unsigned char *out = vertex + layout.offsets[i];
+            for (int c = 0; c < element.components; c++)
+            {
+                switch (element.format)
+                {
+                case VertexFormat::HalfFloat:
+                {
+                    uint16_t bits = glm::packHalf1x16(value[c]);
+                    std::memcpy(out + c * 2, &bits, 2);
+                    break;
+                }
+                case VertexFormat::Snorm16:
+                {
+                    uint16_t bits = glm::packSnorm1x16(value[c]);
+                    std::memcpy(out + c * 2, &bits, 2);
+                    break;
+                }
+                case VertexFormat::Unorm16:
+                {
+                    uint16_t bits = glm::packUnorm1x16(value[c]);
+                    std::memcpy(out + c * 2, &bits, 2);
+                    break;
+                }
+                case VertexFormat::Snorm8:
+                    out[c] = glm::packSnorm1x8(value[c]);
+                    break;
+                case VertexFormat::Unorm8:
+                    out[c] = glm::packUnorm1x8(value[c]);
+                    break;
+                case VertexFormat::Uint8:
+                    out[c] = (unsigned char)glm::clamp(value[c] + 0.5f, 0.0f, 255.0f);
+                    break;
+                case VertexFormat::Float:
+                    std::memcpy(out + c * 4, &value[c], 4);
+                    break;
+                default:
+                    break;
+                }
+            }
+            if (element.format == VertexFormat::Int2_10_10_10_Rev)
+            {
+                uint32_t bits = glm::packSnorm3x10_1x2(glm::vec4(value[0], value[1], value[2], value[3]));
+                std::memcpy(out, &bits, 4);
+            }
+        }
+    }
+    return packed;
+}
+
+// GPU copy of a mesh: one VAO with a static vertex and index buffer,
+// the indices of every level of detail behind each other
+class Mesh
+{
+  public:
+    unsigned int VAO, VBO, EBO;
+    // of level 0, what draw() draws
+    GLsizei indexCount;
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLenum indexType;
+    // vertex buffer size after quantization
+    size_t vertexBytes;
+    // decode of boundsRelative elements, pass to the vertex shader
+    glm::vec3 boundsCenter, boundsExtent;
+    std::vector<Submesh> submeshes;
+    // at least level 0
+    std::vector<MeshLod> lods;
+    // how the vertex buffer is laid out, for code that reads it without the VAO
+    VertexLayout layout;
+
+    // quantizes the builder's vertices into layout
+    Mesh(const MeshBuilder &builder, const VertexLayout &layout)
+    {
+        PackedVertices packed = packVertices(builder, layout);
+        std::vector<unsigned char> indices = builder.packIndices();
+        boundsCenter = packed.boundsCenter;
+        boundsExtent = packed.boundsExtent;
+        submeshes = builder.submeshes;
+        lods = builder.levels();
+        create(layout, packed.data.data(), packed.data.size(), indices.data(), builder.indices.size(),
+               builder.indexSize());
+    }
+
+    // uploads vertices already in layout, e.g. straight out of a memory mapped mesh file
+    Mesh(const VertexLayout &layout, const void *vertices, size_t vertexBytes, const void *indices,
+         size_t indexCount, size_t indexSize, glm::vec3 boundsCenter, glm::vec3 boundsExtent,
+         std::vector<Submesh> submeshes, std::vector<MeshLod> lods = {})
+        : boundsCenter(boundsCenter), boundsExtent(boundsExtent), submeshes(std::move(submeshes)),
+          lods(std::move(lods))
+    {
+        if (this->lods.empty())
+            this->lods.push_back({0, (uint32_t)indexCount, 0.0f, 0});
+        create(layout, vertices, vertexBytes, indices, indexCount, indexSize);
+    }
+
+    ~Mesh()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        deleteBuffers(1, &VBO);
+        deleteBuffers(1, &EBO);
+    }
+
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+
+    void bind() const
+    {
+        glState.bindVertexArray(VAO);
+    }
+
+    void draw() const
+    {
+        renderStats.countDraw(indexCount);
+        glDrawElements(GL_TRIANGLES, indexCount, indexType, (void *)0);
+    }
+
+    void drawInstanced(GLsizei instanceCount) const
+    {
+        renderStats.countDraw(indexCount, instanceCount);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, indexType, (void *)0, instanceCount);
+    }
+
+    void drawLod(size_t level) const
+    {
+        const MeshLod &lod = lods[std::min(level, lods.size() - 1)];
+        renderStats.countDraw(lod.indexCount);
+        glDrawElements(GL_TRIANGLES, (GLsizei)lod.indexCount, indexType, (void *)(lod.firstIndex * indexSize()));
+    }
+
+    void drawSubmesh(size_t index) const
+    {
+        const Submesh &submesh = submeshes[index];
+        renderStats.countDraw(submesh.indexCount);
+        glDrawElements(GL_TRIANGLES, (GLsizei)submesh.indexCount, indexType,
+                       (void *)(submesh.firstIndex * indexSize()));
+    }
+
+    size_t indexSize() const
+    {
+        return indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    }
+
+  private:
+    void create(const VertexLayout &layout, const void *vertices, size_t bytes, const void *indices,
+                size_t count, size_t size)
+    {
+        this->layout = layout;
+        indexCount = (GLsizei)lods[0].indexCount;
+        indexType = size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        vertexBytes = bytes;
+
+        // both buffers are written once, immutable storage without any access flags
+        VAO = createVertexArray();
+        VBO = createBuffer(bytes, vertices, 0, GL_STATIC_DRAW, GPU_MEMORY_GEOMETRY);
+        layout.apply(VAO, VBO);
+
+        // the element buffer binding is part of the VAO
+        EBO = createBuffer(count * size, indices, 0, GL_STATIC_DRAW, GPU_MEMORY_GEOMETRY);
+        setElementBuffer(VAO, EBO);
+    }
+};
+
+#endif
@@ -0,0 +1,310 @@
+#ifndef MESH_CODEC_H
+#define MESH_CODEC_H
+
+#include "simd_math.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Vertex and index codecs of the mesh files (mesh_file.cpp), after meshoptimizer's: they leave
+// data that is already quantized and in vertex cache and fetch order (mesh_optimizer.cpp) a
+// lot smaller and more regular for the LZ4 of the asset pack, and decode at memory speed.
+//
+// Vertices come in blocks of MESH_CODEC_VERTEX_BLOCK, each coded on its own so the blocks
+// decode in parallel: byte k of every vertex is one channel, stored as the zigzagged byte
+// difference to the vertex before it in the block, in groups of 16 vertices of 0, 2, 4 or 8
+// bits each behind a 2 bit header per group. The blob starts with the byte offset of every
+// block. The decoder unpacks a group, undoes the differences with a prefix sum and
+// transposes 4 channels of 16 vertices at a time back into interleaved vertices with SSE2.
+//
+// Indices are zigzagged differences to the index before them as variable length integers,
+// small on fetch ordered meshes, where every triangle's indices are close to the last one's.
+
+#define MESH_CODEC_VERTEX_BLOCK 256
+
+namespace meshcodec
+{
+const size_t GROUP = 16;
+
+inline unsigned char zigzag(unsigned char delta)
+{
+    return (unsigned char)((delta << 1) ^ (unsigned char)((signed char)delta >> 7));
+}
+
+inline unsigned char unzigzag(unsigned char value)
+{
+    return (unsigned char)((value >> 1) ^ (unsigned char)(0u - (value & 1u)));
+}
+
+// bits per value of a group from its header code
+inline size_t groupBits(unsigned int code)
+{
+    return code == 0 ? 0 : code == 1 ? 2 : code == 2 ? 4 : 8;
+}
+
+// one channel of count vertices: the group headers, then the groups
+inline void encodeChannel(std::vector<unsigned char> &out, const unsigned char *values, size_t count)
+{
+    size_t groups = (count + GROUP - 1) / GROUP;
+    size_t header = out.size();
+    out.resize(out.size() + (groups + 3) / 4, 0);
+    for (size_t g = 0; g < groups; g++)
+    {
+        unsigned char group[GROUP] = {};
+        size_t first = g * GROUP, length = std::min(GROUP, count - first);
+        std::memcpy(group, values + first, length);
+        unsigned char largest = *std::max_element(group, group + GROUP);
+        unsigned int code = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+        out[header + g / 4] |= (unsigned char)(code << (g % 4 * 2));
+        size_t bits = groupBits(code);
+        if (bits == 8)
+        {
+            out.insert(out.end(), group, group + GROUP);
+            continue;
+        }
+        // value i in byte i * bits / 8, the first ones in the low bits
+        for (size_t i = 0; bits > 0 && i < GROUP; i += 8 / bits)
+        {
+            unsigned char byte = 0;
+            for (size_t j = 0; j < 8 / bits; j++)
+                byte |= (unsigned char)(group[i + j] << (j * bits));
+            out.push_back(byte);
+        }
+    }
+}
+
+// the 16 zigzagged values of a group, NULL when data runs out before the end
+inline const unsigned char *unpackGroup(const unsigned char *data, const unsigned char *end, unsigned int code,
+                                        unsigned char *group)
+{
+    size_t bits = groupBits(code);
+    if ((size_t)(end - data) < bits * GROUP / 8)
+        return NULL;
+#if SIMD_SSE2
+    __m128i values = _mm_setzero_si128();
+    if (bits == 8)
+    {
+        values = _mm_loadu_si128((const __m128i *)data);
+    }
+    else if (bits == 4)
+    {
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        __m128i bytes = _mm_loadl_epi64((const __m128i *)data);
+        values = _mm_unpacklo_epi8(_mm_and_si128(bytes, nibble), _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+    }
+    else if (bits == 2)
+    {
+        const __m128i pair = _mm_set1_epi8(0x03);
+        int word;
+        std::memcpy(&word, data, 4);
+        __m128i bytes = _mm_cvtsi32_si128(word);
+        __m128i a = _mm_and_si128(bytes, pair), b = _mm_and_si128(_mm_srli_epi16(bytes, 2), pair);
+        __m128i c = _mm_and_si128(_mm_srli_epi16(bytes, 4), pair), d = _mm_and_si128(_mm_srli_epi16(bytes, 6), pair);
+        values = _mm_unpacklo_epi16(_mm_unpacklo_epi8(a, b), _mm_unpacklo_epi8(c, d));
+    }
+    _mm_storeu_si128((__m128i *)group, values);
+#else
+    if (bits == 0)
+        std::memset(group, 0, GROUP);
+    for (size_t i = 0; bits > 0 && i < GROUP; i++)
+        group[i] = (unsigned char)((data[i * bits / 8] >> (i * bits % 8)) & ((1u << bits) - 1));
+#endif
+    return data + bits * GROUP / 8;
+}
+
+// a channel of groups groups back into byte values, each group's differences summed onto the
+// last value before it; NULL when data runs out
+inline const unsigned char *decodeChannel(const unsigned char *data, const unsigned char *end, size_t groups,
+                                          unsigned char *values)
+{
+    if ((size_t)(end - data) < (groups + 3) / 4)
+        return NULL;
+    const unsigned char *header = data;
+    data += (groups + 3) / 4;
+    unsigned char last = 0;
+    for (size_t g = 0; g < groups; g++)
+    {
+        unsigned char *group = values + g * GROUP;
+        data = unpackGroup(data, end, (header[g / 4] >> (g % 4 * 2)) & 3u, group);
+        if (!data)
+            return NULL;
+#if SIMD_SSE2
+        __m128i zigzagged = _mm_loadu_si128((const __m128i *)group);
+        __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(zigzagged, _mm_set1_epi8(1)));
+        __m128i delta = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(zigzagged, 1), _mm_set1_epi8(0x7F)), sign);
+        // inclusive prefix sum of the 16 bytes
+        delta = _mm_add_epi8(delta, _mm_slli_si128(delta, 1));
+        delta = _mm_add_epi8(delta, _mm_slli_si128(delta, 2));
+        delta = _mm_add_epi8(delta, _mm_slli_si128(delta, 4));
+        delta = _mm_add_epi8(delta, _mm_slli_si128(delta, 8));
+        delta = _mm_add_epi8(delta, _mm_set1_epi8((char)last));
+        _mm_storeu_si128((__m128i *)group, delta);
+        last = (unsigned char)(_mm_extract_epi16(delta, 7) >> 8);
+#else
+        for (size_t i = 0; i < GROUP; i++)
+            group[i] = last = (unsigned char)(last + unzigzag(group[i]));
+#endif
+    }
+    return data;
+}
+
+// 4 channels of rows into count interleaved vertices at stride, starting at byte k of each
+inline void interleave(const unsigned char *rows, size_t rowStride, size_t count, unsigned char *vertices,
+                       size_t stride)
+{
+    for (size_t first = 0; first < count; first += GROUP)
+    {
+        size_t length = std::min(GROUP, count - first);
+#if SIMD_SSE2
+        const unsigned char *row = rows + first;
+        __m128i r0 = _mm_loadu_si128((const __m128i *)row);
+        __m128i r1 = _mm_loadu_si128((const __m128i *)(row + rowStride));
+        __m128i r2 = _mm_loadu_si128((const __m128i *)(row + 2 * rowStride));
+        __m128i r3 = _mm_loadu_si128((const __m128i *)(row + 3 * rowStride));
+        __m128i low01 = _mm_unpacklo_epi8(r0, r1), high01 = _mm_unpackhi_epi8(r0, r1);
+        __m128i low23 = _mm_unpacklo_epi8(r2, r3), high23 = _mm_unpackhi_epi8(r2, r3);
+        // the 4 bytes of 16 vertices one after the other
+        alignas(16) uint32_t words[GROUP];
+        _mm_store_si128((__m128i *)words, _mm_unpacklo_epi16(low01, low23));
+        _mm_store_si128((__m128i *)(words + 4), _mm_unpackhi_epi16(low01, low23));
+        _mm_store_si128((__m128i *)(words + 8), _mm_unpacklo_epi16(high01, high23));
+        _mm_store_si128((__m128i *)(words + 12), _mm_unpackhi_epi16(high01, high23));
+        for (size_t i = 0; i < length; i++)
+            std::memcpy(vertices + (first + i) * stride, &words[i], 4);
+#else
+        for (size_t i = 0; i < length; i++)
+        {
+            for (size_t c = 0; c < 4; c++)
+                vertices[(first + i) * stride + c] = rows[c * rowStride + first + i];
+        }
+#endif
+    }
+}
+} // namespace meshcodec
+
+inline size_t vertexCodecBlocks(size_t count)
+{
+    return (count + MESH_CODEC_VERTEX_BLOCK - 1) / MESH_CODEC_VERTEX_BLOCK;
+}
+
+// empty when stride isn't a multiple of 4, as every VertexLayout's is
+inline std::vector<unsigned char> encodeVertexBuffer(const unsigned char *vertices, size_t count, size_t stride)
+{
+    std::vector<unsigned char> out;
+    if (stride == 0 || stride % 4 != 0)
+        return out;
+    size_t blocks = vertexCodecBlocks(count);
+    out.resize(blocks * 4);
+    std::vector<unsigned char> channel(MESH_CODEC_VERTEX_BLOCK);
+    for (size_t b = 0; b < blocks; b++)
+    {
+        uint32_t offset = (uint32_t)out.size();
+        std::memcpy(&out[b * 4], &offset, 4);
+        size_t first = b * MESH_CODEC_VERTEX_BLOCK, length = std::min<size_t>(MESH_CODEC_VERTEX_BLOCK, count - first);
+        for (size_t k = 0; k < stride; k++)
+        {
+            unsigned char last = 0;
+            for (size_t i = 0; i < length; i++)
+            {
+                unsigned char value = vertices[(first + i) * stride + k];
+                channel[i] = meshcodec::zigzag((unsigned char)(value - last));
+                last = value;
+            }
+            meshcodec::encodeChannel(out, channel.data(), length);
+        }
+    }
+    return out;
+}
+
+// blocks [firstBlock, lastBlock) of an encoded buffer of count vertices into vertices, which
+// holds all of them; false when the data is corrupt. Different blocks may decode at once.
+inline bool decodeVertexBlocks(const unsigned char *data, size_t size, size_t count, size_t stride,
+                               size_t firstBlock, size_t lastBlock, unsigned char *vertices)
+{
+    size_t blocks = vertexCodecBlocks(count);
+    if (stride == 0 || stride % 4 != 0 || size < blocks * 4 || lastBlock > blocks)
+        return false;
+    // a whole block of channels, transposed 4 at a time
+    std::vector<unsigned char> rows(4 * MESH_CODEC_VERTEX_BLOCK);
+    for (size_t b = firstBlock; b < lastBlock; b++)
+    {
+        uint32_t offset;
+        std::memcpy(&offset, data + b * 4, 4);
+        if (offset > size)
+            return false;
+        const unsigned char *in = data + offset, *end = data + size;
+        size_t first = b * MESH_CODEC_VERTEX_BLOCK, length = std::min<size_t>(MESH_CODEC_VERTEX_BLOCK, count - first);
+        size_t groups = (length + meshcodec::GROUP - 1) / meshcodec::GROUP;
+        for (size_t k = 0; k < stride; k += 4)
+        {
+            for (size_t c = 0; c < 4; c++)
+            {
+                in = meshcodec::decodeChannel(in, end, groups, &rows[c * MESH_CODEC_VERTEX_BLOCK]);
+                if (!in)
+                    return false;
+            }
+            meshcodec::interleave(rows.data(), MESH_CODEC_VERTEX_BLOCK, length, vertices + first * stride + k,
+                                  stride);
+        }
+    }
+    return true;
+}
+
+inline std::vector<unsigned char> encodeIndexBuffer(const uint32_t *indices, size_t count)
+{
+    std::vector<unsigned char> out;
+    out.reserve(count * 2);
+    uint32_t last = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t delta = (int32_t)(indices[i] - last);
+        uint32_t value = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+        last = indices[i];
+        while (value >= 0x80)
+        {
+            out.push_back((unsigned char)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((unsigned char)value);
+    }
+    return out;
+}
+
+// count indices of indexSize bytes, 2 or 4, into indices; false when the data is corrupt or
+// doesn't hold exactly count of them
+inline bool decodeIndexBuffer(const unsigned char *data, size_t size, size_t count, size_t indexSize, void *indices)
+{
+    const unsigned char *end = data + size;
+    uint32_t last = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            if (data == end || shift > 28)
+                return false;
+            unsigned char byte = *data++;
+            value |= (uint32_t)(byte & 0x7F) << shift;
+            if (byte < 0x80)
+                break;
+        }
+        last += (uint32_t)((int32_t)(value >> 1) ^ -(int32_t)(value & 1));
+        if (indexSize == 2)
+        {
+            if (last > 0xFFFF)
+                return false;
+            uint16_t narrow = (uint16_t)last;
+            std::memcpy((unsigned char *)indices + i * 2, &narrow, 2);
+        }
+        else
+        {
+            std::memcpy((unsigned char *)indices + i * 4, &last, 4);
+        }
+    }
+    return data == end;
+}
+
+#endif
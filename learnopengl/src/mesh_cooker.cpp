@@ -0,0 +1,454 @@
+#ifndef MESH_COOKER_H
+#define MESH_COOKER_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include "hash.cpp"
+#include "job_system.cpp"
+#include "mesh_file.cpp"
+#include "mesh_optimizer.cpp"
+#include "mesh_simplifier.cpp"
+#include "meshlets.cpp"
+#include "startup_graph.cpp"
+#include "static_vertex_layout.cpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Offline mesh cooker: parses OBJ files once and stores them as quantized binary
+// mesh files (mesh_file.cpp) under <directory>/cooked, next to the cooked textures,
+// together with the simplified levels of detail of each (mesh_simplifier.cpp) and the
+// meshlets of the full level (meshlets.cpp), every level in vertex cache and overdraw
+// friendly order (mesh_optimizer.cpp).
+// Every mesh of a directory goes through the stages as tasks of a StartupGraph on the job
+// system, so the meshes cook side by side, and a source whose content hash is the one in the
+// directory's manifest from the last cook is left as it is.
+// Runs without a GL context, see the --cook command line option in main.cpp.
+
+// vertex written by parseOBJ: position, texture coordinate, normal
+#define OBJ_VERTEX_FLOATS 8
+
+// layout of cooked meshes, the normal sits behind the per-instance streams (locations 2 to 6)
+using CookedVertex = VertexLayoutOf<Position3s, UV2h, Normal1010102>;
+static_assert(CookedVertex::floats == OBJ_VERTEX_FLOATS, "CookedVertex must pack the whole OBJ vertex");
+
+inline VertexLayout cookedMeshLayout()
+{
+    return CookedVertex::layout();
+}
+
+// an OBJ vertex followed by 4 joint indices and their 4 weights
+#define SKINNED_VERTEX_FLOATS (OBJ_VERTEX_FLOATS + 8)
+
+// CookedVertex plus the joints and weights of skinned glTF meshes (see skinning.cpp)
+using SkinnedVertex = VertexLayoutOf<Position3s, UV2h, Normal1010102, Joints4u8, Weights4un8>;
+static_assert(SkinnedVertex::floats == SKINNED_VERTEX_FLOATS, "SkinnedVertex must pack the whole skinned vertex");
+
+inline VertexLayout skinnedMeshLayout()
+{
+    return SkinnedVertex::layout();
+}
+
+// an OBJ vertex followed by its lightmap texture coordinate
+#define LIGHTMAPPED_VERTEX_FLOATS (OBJ_VERTEX_FLOATS + 2)
+
+// CookedVertex plus the coordinate of the static batches' lightmap (see lightmap_baker.cpp)
+using LightmappedVertex = VertexLayoutOf<Position3s, UV2h, Normal1010102, LightmapUV2us>;
+static_assert(LightmappedVertex::floats == LIGHTMAPPED_VERTEX_FLOATS,
+              "LightmappedVertex must pack the whole lightmapped vertex");
+
+inline VertexLayout lightmappedMeshLayout()
+{
+    return LightmappedVertex::layout();
+}
+
+// where the cooked version of a mesh lives, e.g. res/cube.obj -> res/cooked/cube.mesh
+inline std::string cookedMeshPath(const std::string &sourcePath)
+{
+    std::filesystem::path path(sourcePath);
+    return (path.parent_path() / "cooked" / path.stem()).string() + ".mesh";
+}
+
+namespace cooker
+{
+// OBJ indices are 1 based, negative ones count back from the end
+inline int resolveOBJIndex(long index, size_t count)
+{
+    if (index > 0)
+        return (int)index - 1;
+    if (index < 0)
+        return (int)count + (int)index;
+    return -1;
+}
+
+// the whitespace separated floats after a keyword
+inline void readOBJFloats(const char *c, int count, std::vector<float> &out)
+{
+    char *next;
+    for (int i = 0; i < count; i++)
+    {
+        out.push_back(std::strtof(c, &next));
+        c = next;
+    }
+}
+
+inline bool isOBJSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+} // namespace cooker
+
+// triangulates the faces of the OBJ text read from path into builder (OBJ_VERTEX_FLOATS per
+// vertex), every object, group or material change starts a new submesh
+inline bool parseOBJ(const std::string &path, const std::string &text, MeshBuilder &builder)
+{
+    std::vector<float> positions, texCoords, normals;
+    std::vector<float> corners;
+    const char *cursor = text.c_str();
+    const char *end = cursor + text.size();
+    while (cursor < end)
+    {
+        const char *lineEnd = std::find(cursor, end, '\n');
+        std::string line(cursor, lineEnd);
+        cursor = lineEnd + 1;
+        const char *c = line.c_str();
+        while (cooker::isOBJSpace(*c))
+            c++;
+
+        if (c[0] == 'v' && cooker::isOBJSpace(c[1]))
+            cooker::readOBJFloats(c + 1, 3, positions);
+        else if (c[0] == 'v' && c[1] == 't' && cooker::isOBJSpace(c[2]))
+            cooker::readOBJFloats(c + 2, 2, texCoords);
+        else if (c[0] == 'v' && c[1] == 'n' && cooker::isOBJSpace(c[2]))
+            cooker::readOBJFloats(c + 2, 3, normals);
+        else if (c[0] == 'f' && cooker::isOBJSpace(c[1]))
+        {
+            // position/texcoord/normal triples, fan triangulated
+            corners.clear();
+            c++;
+            for (;;)
+            {
+                while (cooker::isOBJSpace(*c) || *c == '\r')
+                    c++;
+                if (!*c)
+                    break;
+                char *next;
+                long indices[3] = {0, 0, 0};
+                indices[0] = std::strtol(c, &next, 10);
+                c = next;
+                for (int i = 1; i < 3 && *c == '/'; i++)
+                {
+                    c++;
+                    indices[i] = std::strtol(c, &next, 10);
+                    c = next;
+                }
+                int p = cooker::resolveOBJIndex(indices[0], positions.size() / 3);
+                int t = cooker::resolveOBJIndex(indices[1], texCoords.size() / 2);
+                int n = cooker::resolveOBJIndex(indices[2], normals.size() / 3);
+                if (p < 0 || (size_t)p * 3 >= positions.size())
+                {
+                    std::cout << "ERROR::MESH_COOKER::BAD_FACE: " << path << '\n';
+                    return false;
+                }
+                float vertex[OBJ_VERTEX_FLOATS] = {};
+                std::copy(&positions[p * 3], &positions[p * 3] + 3, vertex);
+                if (t >= 0 && (size_t)t * 2 < texCoords.size())
+                    std::copy(&texCoords[t * 2], &texCoords[t * 2] + 2, vertex + 3);
+                if (n >= 0 && (size_t)n * 3 < normals.size())
+                    std::copy(&normals[n * 3], &normals[n * 3] + 3, vertex + 5);
+                corners.insert(corners.end(), vertex, vertex + OBJ_VERTEX_FLOATS);
+            }
+            size_t cornerCount = corners.size() / OBJ_VERTEX_FLOATS;
+            for (size_t i = 2; i < cornerCount; i++)
+            {
+                builder.add(&corners[0]);
+                builder.add(&corners[(i - 1) * OBJ_VERTEX_FLOATS]);
+                builder.add(&corners[i * OBJ_VERTEX_FLOATS]);
+            }
+        }
+        else if (((c[0] == 'o' || c[0] == 'g') && cooker::isOBJSpace(c[1])) || std::strncmp(c, "usemtl", 6) == 0)
+        {
+            builder.endSubmesh();
+        }
+    }
+    builder.endSubmesh();
+    return true;
+}
+
+inline bool parseOBJ(const std::string &path, MeshBuilder &builder)
+{
+    std::string text;
+    if (!readAsset(path, text))
+    {
+        std::cout << "ERROR::MESH_COOKER::FAILED_TO_LOAD: " << path << '\n';
+        return false;
+    }
+    return parseOBJ(path, text, builder);
+}
+
+namespace cooker
+{
+// part of every source hash, a change to what the stages make cooks every mesh again
+const uint64_t MESH_COOKER_VERSION = 2;
+
+// Area weighted normals for the vertices of an OBJ face without vn, summed over every vertex
+// at the same position so the texture seams stay smooth. builder is as parseOBJ() wrote it,
+// its vertices are unique already and stay so.
+inline void generateMissingNormals(MeshBuilder &builder)
+{
+    typedef std::tuple<float, float, float> Position;
+    std::map<Position, glm::vec3> sums;
+    float *vertices = builder.vertices.data();
+    auto missing = [&](uint32_t index) {
+        const float *normal = vertices + (size_t)index * OBJ_VERTEX_FLOATS + 5;
+        return normal[0] == 0.0f && normal[1] == 0.0f && normal[2] == 0.0f;
+    };
+    auto position = [&](uint32_t index) {
+        const float *p = vertices + (size_t)index * OBJ_VERTEX_FLOATS;
+        return Position(p[0], p[1], p[2]);
+    };
+    for (size_t i = 0; i + 2 < builder.indices.size(); i += 3)
+    {
+        const uint32_t *corner = &builder.indices[i];
+        if (!missing(corner[0]) && !missing(corner[1]) && !missing(corner[2]))
+            continue;
+        glm::vec3 a = glm::make_vec3(vertices + (size_t)corner[0] * OBJ_VERTEX_FLOATS);
+        glm::vec3 b = glm::make_vec3(vertices + (size_t)corner[1] * OBJ_VERTEX_FLOATS);
+        glm::vec3 c = glm::make_vec3(vertices + (size_t)corner[2] * OBJ_VERTEX_FLOATS);
+        // twice the area long
+        glm::vec3 face = glm::cross(b - a, c - a);
+        for (int k = 0; k < 3; k++)
+        {
+            if (missing(corner[k]))
+                sums[position(corner[k])] += face;
+        }
+    }
+    if (sums.empty())
+        return;
+    for (uint32_t v = 0; v < (uint32_t)builder.vertexCount(); v++)
+    {
+        if (!missing(v))
+            continue;
+        glm::vec3 sum = sums[position(v)];
+        float length = glm::length(sum);
+        glm::vec3 normal = length > 0.0f ? sum / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        std::copy(&normal.x, &normal.x + 3, vertices + (size_t)v * OBJ_VERTEX_FLOATS + 5);
+    }
+}
+
+// content hash of every cooked source of a directory, "hash<TAB>source" lines
+inline std::map<std::string, uint64_t> readCookManifest(const std::string &path)
+{
+    std::map<std::string, uint64_t> manifest;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t tab = line.find('\t');
+        if (tab != std::string::npos)
+            manifest[line.substr(tab + 1)] = std::strtoull(line.substr(0, tab).c_str(), NULL, 16);
+    }
+    return manifest;
+}
+
+// written aside and renamed, a cook stopped halfway leaves the previous manifest
+inline bool writeCookManifest(const std::string &path, const std::map<std::string, uint64_t> &manifest)
+{
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        for (const std::pair<const std::string, uint64_t> &entry : manifest)
+        {
+            char hash[17];
+            std::snprintf(hash, sizeof(hash), "%016" PRIx64, entry.second);
+            file << hash << '\t' << entry.first << '\n';
+        }
+        if (!file)
+        {
+            std::cout << "ERROR::MESH_COOKER::COULD_NOT_WRITE: " << path << '\n';
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+    if (error)
+    {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+// one mesh on its way through the stages, each stage a task after the one before
+struct MeshCook
+{
+    std::string source, output;
+    std::string text;
+    uint64_t hash = 0;
+    MeshBuilder builder = MeshBuilder(OBJ_VERTEX_FLOATS);
+    size_t triangles = 0;
+    VertexCacheStats before = {};
+    // the manifest has the hash and the cooked file is there
+    bool upToDate = false;
+    bool failed = false;
+    // what the stages print, in the order of the sources once all are done
+    std::ostringstream report;
+
+    // nothing left for the stages after this one
+    bool finished() const
+    {
+        return upToDate || failed;
+    }
+};
+} // namespace cooker
+
+// Cooks every obj in a directory on the job system, returns the number of failures.
+// A mesh is read and hashed, parsed with the normals it lacks generated, simplified into its
+// levels of detail, split into meshlets, reordered and quantized into its file, a task for each
+// stage. Sources unchanged since the last cook are skipped unless force is set.
+inline int cookMeshDirectory(const std::string &directory, JobSystem &jobs, bool force = false)
+{
+    std::vector<std::string> sources;
+    std::error_code error;
+    for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory, error))
+    {
+        if (!entry.is_regular_file())
+            continue;
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == ".obj")
+            sources.push_back(entry.path().string());
+    }
+    if (error)
+        std::cout << "ERROR::MESH_COOKER::COULD_NOT_OPEN: " << directory << '\n';
+    std::sort(sources.begin(), sources.end());
+
+    std::string manifestPath = (std::filesystem::path(directory) / "cooked" / "meshes.manifest").string();
+    const std::map<std::string, uint64_t> previous = cooker::readCookManifest(manifestPath);
+    std::vector<std::unique_ptr<cooker::MeshCook>> meshes;
+    {
+        // waits for every task on the way out
+        StartupGraph graph(jobs);
+        for (const std::string &source : sources)
+        {
+            meshes.push_back(std::make_unique<cooker::MeshCook>());
+            cooker::MeshCook &mesh = *meshes.back();
+            mesh.source = source;
+            mesh.output = cookedMeshPath(source);
+            StartupGraph::Task read = graph.add("cook read " + source, [&mesh, &previous, force] {
+                if (!readAsset(mesh.source, mesh.text))
+                {
+                    mesh.report << "ERROR::MESH_COOKER::FAILED_TO_LOAD: " << mesh.source << '\n';
+                    mesh.failed = true;
+                    return;
+                }
+                mesh.hash = hashWords64(mesh.text.data(), mesh.text.size(), cooker::MESH_COOKER_VERSION);
+                auto found = previous.find(mesh.source);
+                std::error_code missing;
+                mesh.upToDate = !force && found != previous.end() && found->second == mesh.hash &&
+                                std::filesystem::exists(mesh.output, missing);
+            });
+            StartupGraph::Task parse = graph.add(
+                "cook parse " + source,
+                [&mesh] {
+                    if (mesh.finished())
+                        return;
+                    mesh.failed = !parseOBJ(mesh.source, mesh.text, mesh.builder);
+                    std::string().swap(mesh.text);
+                    if (mesh.failed)
+                        return;
+                    cooker::generateMissingNormals(mesh.builder);
+                    mesh.triangles = mesh.builder.indices.size() / 3;
+                    mesh.before = analyzeVertexCache(mesh.builder.indices.data(), mesh.builder.indices.size(),
+                                                     mesh.builder.vertexCount());
+                },
+                {read});
+            StartupGraph::Task lods = graph.add(
+                "cook lods " + source,
+                [&mesh] {
+                    if (!mesh.finished())
+                        buildMeshLods(mesh.builder);
+                },
+                {parse});
+            StartupGraph::Task meshlets = graph.add(
+                "cook meshlets " + source,
+                [&mesh] {
+                    if (!mesh.finished())
+                        buildMeshlets(mesh.builder);
+                },
+                {lods});
+            StartupGraph::Task optimize = graph.add(
+                "cook optimize " + source,
+                [&mesh] {
+                    if (!mesh.finished())
+                        optimizeMesh(mesh.builder);
+                },
+                {meshlets});
+            graph.add(
+                "cook write " + source,
+                [&mesh] {
+                    if (mesh.finished())
+                        return;
+                    MeshBuilder &builder = mesh.builder;
+                    VertexCacheStats after = analyzeVertexCache(builder.indices.data(), builder.levels()[0].indexCount,
+                                                                builder.vertexCount());
+                    VertexLayout layout = cookedMeshLayout();
+                    std::error_code ignored;
+                    std::filesystem::create_directories(std::filesystem::path(mesh.output).parent_path(), ignored);
+                    if (!writeMeshFile(mesh.output, builder, layout, true))
+                    {
+                        mesh.failed = true;
+                        return;
+                    }
+                    mesh.report << "cooked " << mesh.source << " -> " << mesh.output << " (" << builder.vertexCount()
+                                << " vertices, " << mesh.triangles << " triangles, " << builder.submeshes.size()
+                                << " submeshes, " << layout.stride << " bytes per vertex, " << builder.meshlets.size()
+                                << " meshlets)\n";
+                    mesh.report << "  vertex cache: acmr " << mesh.before.acmr << " -> " << after.acmr << ", atvr "
+                                << mesh.before.atvr << " -> " << after.atvr << '\n';
+                    for (size_t i = 1; i < builder.lods.size(); i++)
+                        mesh.report << "  lod " << i << ": " << builder.lods[i].indexCount / 3 << " triangles, error "
+                                    << builder.lods[i].error << '\n';
+                    // the stages are done with it
+                    mesh.builder = MeshBuilder(OBJ_VERTEX_FLOATS);
+                },
+                {optimize});
+        }
+    }
+
+    // a failed mesh stays out of the manifest so the next cook tries it again
+    int failures = 0, skipped = 0;
+    std::map<std::string, uint64_t> manifest;
+    for (const std::unique_ptr<cooker::MeshCook> &mesh : meshes)
+    {
+        std::cout << mesh->report.str();
+        if (mesh->failed)
+        {
+            failures++;
+            continue;
+        }
+        skipped += mesh->upToDate ? 1 : 0;
+        manifest[mesh->source] = mesh->hash;
+    }
+    if (skipped > 0)
+        std::cout << "meshes: " << skipped << " of " << meshes.size() << " unchanged since the last cook\n";
+    if (!meshes.empty())
+        cooker::writeCookManifest(manifestPath, manifest);
+    return failures;
+}
+
+#endif
@@ -0,0 +1,370 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include "asset_pack.cpp"
+#include "gl_objects.cpp"
+#include "job_system.cpp"
+#include "mapped_file.cpp"
+#include "mesh.cpp"
+#include "mesh_codec.cpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Packed binary mesh container, written by the mesh cooker (mesh_cooker.cpp).
+// Layout: MeshFileHeader, the vertex elements, the submesh table, the level of detail
+// table, the meshlet table, then the vertex and index blobs, every section starting at a
+// 16 byte aligned offset.
+// The index blob holds every level behind the full one, all of them over the same vertices.
+// The vertices are already quantized to the stored layout, so loading maps the file
+// and hands the blobs straight to the buffer storage without parsing or copying.
+// Either blob may instead be stored with the codecs of mesh_codec.cpp, whichever is smaller;
+// those are decoded on the job system straight into a mapped upload buffer.
+// Files are little endian and only read on the kind of machine that wrote them.
+
+#define MESH_FILE_MAGIC 0x48534D4Cu // "LMSH"
+#define MESH_FILE_VERSION 4u
+
+// MeshFileHeader::encoding bits
+#define MESH_FILE_ENCODED_VERTICES 1u
+#define MESH_FILE_ENCODED_INDICES 2u
+
+struct MeshFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t vertexStride;
+    uint32_t indexCount;
+    // bytes per index, 2 or 4
+    uint32_t indexSize;
+    uint32_t elementCount;
+    uint32_t submeshCount;
+    float boundsCenter[3];
+    float boundsExtent[3];
+    // file offsets of the sections
+    uint64_t elementsOffset;
+    uint64_t submeshesOffset;
+    uint64_t verticesOffset;
+    uint64_t indicesOffset;
+    // MeshLod entries, level 0 first
+    uint32_t lodCount;
+    // Meshlet entries over level 0, may be 0
+    uint32_t meshletCount;
+    uint64_t lodsOffset;
+    uint64_t meshletsOffset;
+    // MESH_FILE_ENCODED_* bits, and MESH_CODEC_VERTEX_BLOCK of the encoder
+    uint32_t encoding;
+    uint32_t vertexBlock;
+    // stored bytes of the blobs, encoded or not
+    uint64_t verticesSize;
+    uint64_t indicesSize;
+};
+static_assert(sizeof(MeshFileHeader) == 136, "mesh file header is 136 bytes");
+
+struct MeshFileElement
+{
+    uint32_t location;
+    uint32_t components;
+    uint32_t format;
+    uint32_t boundsRelative;
+};
+
+inline uint64_t alignMeshFileOffset(uint64_t offset)
+{
+    return (offset + 15) & ~(uint64_t)15;
+}
+
+// quantizes the builder into layout and writes the file, with encode each blob encoded when
+// that makes it smaller
+inline bool writeMeshFile(const std::string &path, const MeshBuilder &builder, const VertexLayout &layout,
+                          bool encode = false)
+{
+    PackedVertices packed = packVertices(builder, layout);
+    std::vector<unsigned char> indices = builder.packIndices();
+    uint32_t encoding = 0;
+    if (encode)
+    {
+        std::vector<unsigned char> vertices =
+            encodeVertexBuffer(packed.data.data(), builder.vertexCount(), layout.stride);
+        if (!vertices.empty() && vertices.size() < packed.data.size())
+        {
+            packed.data.swap(vertices);
+            encoding |= MESH_FILE_ENCODED_VERTICES;
+        }
+        std::vector<unsigned char> encodedIndices = encodeIndexBuffer(builder.indices.data(), builder.indices.size());
+        if (encodedIndices.size() < indices.size())
+        {
+            indices.swap(encodedIndices);
+            encoding |= MESH_FILE_ENCODED_INDICES;
+        }
+    }
+    std::vector<Submesh> submeshes = builder.submeshes;
+    std::vector<MeshLod> lods = builder.levels();
+    if (submeshes.empty())
+        submeshes.push_back({0, lods[0].indexCount});
+
+    MeshFileHeader header = {};
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.vertexCount = (uint32_t)builder.vertexCount();
+    header.vertexStride = (uint32_t)layout.stride;
+    header.indexCount = (uint32_t)builder.indices.size();
+    header.indexSize = (uint32_t)builder.indexSize();
+    header.elementCount = (uint32_t)layout.elements.size();
+    header.submeshCount = (uint32_t)submeshes.size();
+    header.lodCount = (uint32_t)lods.size();
+    header.meshletCount = (uint32_t)builder.meshlets.size();
+    header.encoding = encoding;
+    header.vertexBlock = MESH_CODEC_VERTEX_BLOCK;
+    header.verticesSize = packed.data.size();
+    header.indicesSize = indices.size();
+    for (int c = 0; c < 3; c++)
+    {
+        header.boundsCenter[c] = packed.boundsCenter[c];
+        header.boundsExtent[c] = packed.boundsExtent[c];
+    }
+    header.elementsOffset = alignMeshFileOffset(sizeof(MeshFileHeader));
+    header.submeshesOffset = alignMeshFileOffset(header.elementsOffset + header.elementCount * sizeof(MeshFileElement));
+    header.lodsOffset = alignMeshFileOffset(header.submeshesOffset + header.submeshCount * sizeof(Submesh));
+    header.meshletsOffset = alignMeshFileOffset(header.lodsOffset + header.lodCount * sizeof(MeshLod));
+    header.verticesOffset = alignMeshFileOffset(header.meshletsOffset + header.meshletCount * sizeof(Meshlet));
+    header.indicesOffset = alignMeshFileOffset(header.verticesOffset + packed.data.size());
+
+    std::vector<unsigned char> file(header.indicesOffset + indices.size(), 0);
+    std::memcpy(file.data(), &header, sizeof(header));
+    for (size_t i = 0; i < layout.elements.size(); i++)
+    {
+        const VertexElement &element = layout.elements[i];
+        MeshFileElement stored = {element.location, (uint32_t)element.components, (uint32_t)element.format,
+                                  element.boundsRelative ? 1u : 0u};
+        std::memcpy(&file[header.elementsOffset + i * sizeof(MeshFileElement)], &stored, sizeof(stored));
+    }
+    std::memcpy(&file[header.submeshesOffset], submeshes.data(), submeshes.size() * sizeof(Submesh));
+    std::memcpy(&file[header.lodsOffset], lods.data(), lods.size() * sizeof(MeshLod));
+    if (!builder.meshlets.empty())
+        std::memcpy(&file[header.meshletsOffset], builder.meshlets.data(), builder.meshlets.size() * sizeof(Meshlet));
+    std::memcpy(&file[header.verticesOffset], packed.data.data(), packed.data.size());
+    std::memcpy(&file[header.indicesOffset], indices.data(), indices.size());
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cout << "ERROR::MESH_FILE::COULD_NOT_WRITE: " << path << '\n';
+        return false;
+    }
+    out.write((const char *)file.data(), file.size());
+    return (bool)out;
+}
+
+// a validated mesh file, vertices and indices point into the mapping
+struct MeshFileView
+{
+    MeshFileHeader header;
+    VertexLayout layout;
+    std::vector<Submesh> submeshes;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+    const unsigned char *vertices = NULL;
+    const unsigned char *indices = NULL;
+};
+
+// whether bytes from offset lie within a file of size, the header values are untrusted
+// so the check mustn't wrap around
+inline bool meshFileSectionFits(uint64_t offset, uint64_t bytes, size_t size)
+{
+    return offset <= size && bytes <= size - offset;
+}
+
+// maps and validates a mesh file, false when it is missing or invalid.
+// A packed mesh points into the asset pack's mapping and leaves mapping closed.
+inline bool openMeshFile(const std::string &path, MappedFile &mapping, MeshFileView &view)
+{
+    const unsigned char *data;
+    size_t size;
+    if (!assetPack.view(path, data, size))
+    {
+        if (!mapping.open(path))
+            return false;
+        data = mapping.data;
+        size = mapping.size;
+    }
+
+    MeshFileHeader &header = view.header;
+    if (size < sizeof(header))
+    {
+        std::cout << "ERROR::MESH_FILE::TRUNCATED: " << path << '\n';
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != MESH_FILE_MAGIC || header.version != MESH_FILE_VERSION ||
+        (header.indexSize != 2 && header.indexSize != 4) ||
+        ((header.encoding & MESH_FILE_ENCODED_VERTICES) && header.vertexBlock != MESH_CODEC_VERTEX_BLOCK))
+    {
+        std::cout << "ERROR::MESH_FILE::UNSUPPORTED: " << path << '\n';
+        return false;
+    }
+    uint64_t vertexBytes = (uint64_t)header.vertexCount * header.vertexStride;
+    uint64_t indexBytes = (uint64_t)header.indexCount * header.indexSize;
+    if ((!(header.encoding & MESH_FILE_ENCODED_VERTICES) && header.verticesSize != vertexBytes) ||
+        (!(header.encoding & MESH_FILE_ENCODED_INDICES) && header.indicesSize != indexBytes) ||
+        !meshFileSectionFits(header.elementsOffset, (uint64_t)header.elementCount * sizeof(MeshFileElement), size) ||
+        !meshFileSectionFits(header.submeshesOffset, (uint64_t)header.submeshCount * sizeof(Submesh), size) ||
+        header.lodCount == 0 ||
+        !meshFileSectionFits(header.lodsOffset, (uint64_t)header.lodCount * sizeof(MeshLod), size) ||
+        !meshFileSectionFits(header.meshletsOffset, (uint64_t)header.meshletCount * sizeof(Meshlet), size) ||
+        !meshFileSectionFits(header.verticesOffset, header.verticesSize, size) ||
+        !meshFileSectionFits(header.indicesOffset, header.indicesSize, size))
+    {
+        std::cout << "ERROR::MESH_FILE::TRUNCATED: " << path << '\n';
+        return false;
+    }
+
+    std::vector<VertexElement> elements(header.elementCount);
+    for (uint32_t i = 0; i < header.elementCount; i++)
+    {
+        MeshFileElement stored;
+        std::memcpy(&stored, data + header.elementsOffset + i * sizeof(MeshFileElement), sizeof(stored));
+        elements[i] = {stored.location, (int)stored.components, (VertexFormat)stored.format,
+                       stored.boundsRelative != 0};
+    }
+    view.layout = VertexLayout(elements);
+    if (view.layout.stride != header.vertexStride)
+    {
+        std::cout << "ERROR::MESH_FILE::LAYOUT_MISMATCH: " << path << '\n';
+        return false;
+    }
+    view.submeshes.resize(header.submeshCount);
+    std::memcpy(view.submeshes.data(), data + header.submeshesOffset, header.submeshCount * sizeof(Submesh));
+    view.lods.resize(header.lodCount);
+    std::memcpy(view.lods.data(), data + header.lodsOffset, header.lodCount * sizeof(MeshLod));
+    view.meshlets.resize(header.meshletCount);
+    if (header.meshletCount > 0)
+        std::memcpy(view.meshlets.data(), data + header.meshletsOffset, header.meshletCount * sizeof(Meshlet));
+    for (const MeshLod &lod : view.lods)
+    {
+        if ((uint64_t)lod.firstIndex + lod.indexCount > header.indexCount)
+        {
+            std::cout << "ERROR::MESH_FILE::TRUNCATED: " << path << '\n';
+            return false;
+        }
+    }
+    for (const Meshlet &meshlet : view.meshlets)
+    {
+        if ((uint64_t)meshlet.firstIndex + meshlet.indexCount > view.lods[0].indexCount)
+        {
+            std::cout << "ERROR::MESH_FILE::TRUNCATED: " << path << '\n';
+            return false;
+        }
+    }
+    view.vertices = data + header.verticesOffset;
+    view.indices = data + header.indicesOffset;
+    return true;
+}
+
+// the vertices and the indices of a mesh file, as indexSize bytes each, into memory sized for
+// them, e.g. a mapped buffer; encoded blobs are decoded a few vertex blocks per job on jobs
+// when there is one, raw ones copied. False when the data is corrupt.
+inline bool decodeMeshFile(const MeshFileView &view, void *vertices, void *indices, size_t indexSize,
+                           JobSystem *jobs = NULL)
+{
+    const MeshFileHeader &header = view.header;
+    size_t vertexBytes = (size_t)header.vertexCount * header.vertexStride;
+    std::atomic<bool> failed(false);
+    if (header.encoding & MESH_FILE_ENCODED_VERTICES)
+    {
+        // 16 blocks are 4096 vertices, about as much as a job should take
+        const size_t grain = 16;
+        auto decode = [&](size_t first, size_t last) {
+            if (!decodeVertexBlocks(view.vertices, (size_t)header.verticesSize, header.vertexCount,
+                                    header.vertexStride, first, last, (unsigned char *)vertices))
+                failed = true;
+        };
+        size_t blocks = vertexCodecBlocks(header.vertexCount);
+        if (jobs)
+            jobs->parallelFor(0, blocks, grain, decode);
+        else
+            decode(0, blocks);
+    }
+    else
+    {
+        std::memcpy(vertices, view.vertices, vertexBytes);
+    }
+
+    if (header.encoding & MESH_FILE_ENCODED_INDICES)
+        return !failed && decodeIndexBuffer(view.indices, (size_t)header.indicesSize, header.indexCount, indexSize,
+                                            indices);
+    if (indexSize == header.indexSize)
+    {
+        std::memcpy(indices, view.indices, (size_t)header.indicesSize);
+        return !failed;
+    }
+    // widened or narrowed one by one
+    for (size_t i = 0; i < header.indexCount; i++)
+    {
+        uint32_t index = 0;
+        std::memcpy(&index, view.indices + i * header.indexSize, header.indexSize);
+        if (indexSize == 2)
+        {
+            uint16_t narrow = (uint16_t)index;
+            std::memcpy((unsigned char *)indices + i * 2, &narrow, 2);
+        }
+        else
+        {
+            std::memcpy((unsigned char *)indices + i * 4, &index, 4);
+        }
+    }
+    return !failed;
+}
+
+// maps a mesh file and uploads it, returns NULL when the file is missing or invalid
+inline std::unique_ptr<Mesh> loadMeshFile(const std::string &path, JobSystem *jobs = NULL)
+{
+    MappedFile file;
+    MeshFileView view;
+    if (!openMeshFile(path, file, view))
+        return NULL;
+
+    const MeshFileHeader &header = view.header;
+    size_t vertexBytes = (size_t)header.vertexCount * header.vertexStride;
+    size_t indexBytes = (size_t)header.indexCount * header.indexSize;
+    glm::vec3 boundsCenter(header.boundsCenter[0], header.boundsCenter[1], header.boundsCenter[2]);
+    glm::vec3 boundsExtent(header.boundsExtent[0], header.boundsExtent[1], header.boundsExtent[2]);
+    // the raw blobs go to the driver straight from the mapped pages
+    if (header.encoding == 0)
+        return std::make_unique<Mesh>(view.layout, view.vertices, vertexBytes, view.indices,
+                                      (size_t)header.indexCount, (size_t)header.indexSize, boundsCenter, boundsExtent,
+                                      std::move(view.submeshes), std::move(view.lods));
+
+    // the encoded ones are decoded into a mapped upload buffer and copied into place on the GPU,
+    // the indices behind the vertices at an offset that keeps them aligned
+    size_t indexOffset = (vertexBytes + 15) & ~(size_t)15;
+    unsigned int upload = createBuffer(indexOffset + indexBytes, NULL, GL_MAP_WRITE_BIT, GL_STREAM_DRAW);
+    unsigned char *mapped = (unsigned char *)mapBuffer(upload, 0, indexOffset + indexBytes,
+                                                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    bool decoded = mapped && decodeMeshFile(view, mapped, mapped + indexOffset, header.indexSize, jobs);
+    if (mapped)
+        unmapBuffer(upload);
+    if (!decoded)
+    {
+        deleteBuffers(1, &upload);
+        std::cout << "ERROR::MESH_FILE::" << (mapped ? "CORRUPT: " : "COULD_NOT_MAP: ") << path << '\n';
+        return NULL;
+    }
+    std::unique_ptr<Mesh> mesh =
+        std::make_unique<Mesh>(view.layout, (const void *)NULL, vertexBytes, (const void *)NULL,
+                               (size_t)header.indexCount, (size_t)header.indexSize, boundsCenter, boundsExtent,
+                               std::move(view.submeshes), std::move(view.lods));
+    copyBuffer(upload, mesh->VBO, 0, 0, vertexBytes);
+    copyBuffer(upload, mesh->EBO, indexOffset, 0, indexBytes);
+    deleteBuffers(1, &upload);
+    return mesh;
+}
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "glm/glm.hpp"
+
+#include "mesh.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Index and vertex order optimizations the mesh cooker runs once the levels of detail and
+// meshlets are built, none of them changes what is drawn:
+// - post-transform vertex cache: triangles reordered (Forsyth's linear-speed algorithm) so
+//   a vertex is reused while still in the cache, fewer vertex shader invocations
+// - overdraw: the runs of triangles that start on a cold cache are sorted outside in, so
+//   the front of a convex-ish mesh is drawn first and the early depth test rejects the back
+//   (Sander, Nehab and Barczak, "Fast triangle reordering for vertex locality and reduced
+//   overdraw"); with meshlets, those are the runs, their triangles stay contiguous
+// - vertex fetch: vertices renumbered in the order the indices first use them, so the
+//   vertex buffer is read front to back
+// analyzeVertexCache() gives the ACMR (transformed vertices per triangle) and ATVR
+// (transformed vertices per vertex) the cooker reports before and after.
+
+// FIFO entries of the simulated post-transform cache of analyzeVertexCache()
+#define VERTEX_CACHE_SIZE 16
+
+struct VertexCacheStats
+{
+    // average cache miss ratio, 0.5 at best for a large regular grid, 3 at worst
+    float acmr = 0.0f;
+    // average transformed vertex ratio, 1 when every vertex is transformed exactly once
+    float atvr = 0.0f;
+};
+
+// vertex shader invocations of drawing indices[0, count) through a FIFO cache of cacheSize
+inline VertexCacheStats analyzeVertexCache(const uint32_t *indices, size_t count, size_t vertexCount,
+                                           int cacheSize = VERTEX_CACHE_SIZE)
+{
+    VertexCacheStats stats;
+    if (count < 3)
+        return stats;
+    // the time a vertex entered the cache, + 1
+    std::vector<size_t> enteredAt(vertexCount, 0);
+    std::vector<char> used(vertexCount, 0);
+    size_t misses = 0, usedVertices = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t vertex = indices[i];
+        if (!used[vertex])
+            usedVertices++;
+        used[vertex] = 1;
+        if (enteredAt[vertex] == 0 || misses + 1 - enteredAt[vertex] > (size_t)cacheSize)
+        {
+            misses++;
+            enteredAt[vertex] = misses;
+        }
+    }
+    stats.acmr = (float)misses / (float)(count / 3);
+    stats.atvr = (float)misses / (float)usedVertices;
+    return stats;
+}
+
+namespace optimizer
+{
+// Forsyth's scoring, a 32 entry LRU cache
+const int CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+// how much drawing a triangle with this vertex next is worth: more when it is recent in the
+// cache and when few triangles are left to use it, so no vertex gets stranded
+inline float vertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+    if (remainingTriangles == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        // the three of the last triangle score the same, it doesn't matter which goes first
+        if (cachePosition < 3)
+            score = LAST_TRIANGLE_SCORE;
+        else
+            score = std::pow(1.0f - (float)(cachePosition - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+    }
+    return score + VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+}
+} // namespace optimizer
+
+// reorders the triangles of indices[0, count) for the post-transform vertex cache
+inline void optimizeVertexCache(uint32_t *indices, size_t count, size_t vertexCount)
+{
+    using namespace optimizer;
+    size_t triangleCount = count / 3;
+    if (triangleCount < 2)
+        return;
+
+    // the triangles around every vertex
+    std::vector<uint32_t> firstTriangle(vertexCount + 1, 0), triangles(triangleCount * 3);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        firstTriangle[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] += firstTriangle[v];
+    std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        triangles[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+    // the triangles not drawn yet are kept at the front of each vertex's list
+    std::vector<uint32_t> remaining(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        remaining[v] = firstTriangle[v + 1] - firstTriangle[v];
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<uint32_t> ordered;
+    ordered.reserve(triangleCount * 3);
+    std::vector<uint32_t> cache, nextCache;
+    size_t scan = 0;
+    int64_t best = -1;
+    while (ordered.size() < triangleCount * 3)
+    {
+        // nothing in the cache has triangles left, start over from the first one not drawn
+        if (best < 0)
+        {
+            while (emitted[scan])
+                scan++;
+            best = (int64_t)scan;
+        }
+        uint32_t triangle = (uint32_t)best;
+        emitted[triangle] = 1;
+        const uint32_t *corners = &indices[triangle * 3];
+        nextCache.assign(corners, corners + 3);
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t vertex = corners[k];
+            ordered.push_back(vertex);
+            // drop triangle from the vertex's remaining ones
+            uint32_t *begin = &triangles[firstTriangle[vertex]];
+            uint32_t *found = std::find(begin, begin + remaining[vertex], triangle);
+            std::swap(*found, begin[remaining[vertex] - 1]);
+            remaining[vertex]--;
+        }
+        for (uint32_t vertex : cache)
+        {
+            if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2])
+                nextCache.push_back(vertex);
+        }
+
+        // rescore what is in the cache or just fell out, the best triangle touches one of them
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            uint32_t vertex = nextCache[i];
+            cachePosition[vertex] = i < (size_t)CACHE_SIZE ? (int)i : -1;
+            float newScore = vertexScore(cachePosition[vertex], remaining[vertex]);
+            for (uint32_t t = firstTriangle[vertex]; t < firstTriangle[vertex] + remaining[vertex]; t++)
+                triangleScore[triangles[t]] += newScore - score[vertex];
+            score[vertex] = newScore;
+        }
+        best = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < nextCache.size() && i < (size_t)CACHE_SIZE; i++)
+        {
+            uint32_t vertex = nextCache[i];
+            for (uint32_t t = firstTriangle[vertex]; t < firstTriangle[vertex] + remaining[vertex]; t++)
+            {
+                if (triangleScore[triangles[t]] > bestScore)
+                {
+                    bestScore = triangleScore[triangles[t]];
+                    best = triangles[t];
+                }
+            }
+        }
+        if (nextCache.size() > (size_t)CACHE_SIZE)
+            nextCache.resize(CACHE_SIZE);
+        std::swap(cache, nextCache);
+    }
+    std::copy(ordered.begin(), ordered.end(), indices);
+}
+
+namespace optimizer
+{
+// a run of triangles to be moved as a whole, with how far out it faces and what it was
+// made of (a meshlet)
+struct Cluster
+{
+    uint32_t firstIndex, indexCount;
+    float outwardness;
+    uint32_t source;
+};
+
+// dot of the area weighted facing of the cluster with its offset from center: large for
+// runs on the outside facing out, which should be drawn first
+inline float clusterOutwardness(const MeshBuilder &builder, const uint32_t *indices, uint32_t first, uint32_t count,
+                                const glm::vec3 &center)
+{
+    glm::vec3 facing(0.0f), centroid(0.0f);
+    float area = 0.0f;
+    for (uint32_t i = first; i + 2 < first + count; i += 3)
+    {
+        const float *a = &builder.vertices[(size_t)indices[i] * builder.stride];
+        const float *b = &builder.vertices[(size_t)indices[i + 1] * builder.stride];
+        const float *c = &builder.vertices[(size_t)indices[i + 2] * builder.stride];
+        glm::vec3 p0(a[0], a[1], a[2]), p1(b[0], b[1], b[2]), p2(c[0], c[1], c[2]);
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float triangleArea = glm::length(normal);
+        facing += normal;
+        centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+        area += triangleArea;
+    }
+    if (area <= 0.0f || glm::length(facing) <= 0.0f)
+        return 0.0f;
+    return glm::dot(centroid / area - center, glm::normalize(facing));
+}
+
+// moves the contiguous clusters of indices into falling outwardness, updating their ranges
+inline void sortClusters(const MeshBuilder &builder, uint32_t *indices, std::vector<Cluster> &clusters,
+                         const glm::vec3 &center)
+{
+    if (clusters.size() < 2)
+        return;
+    for (Cluster &cluster : clusters)
+        cluster.outwardness = clusterOutwardness(builder, indices, cluster.firstIndex, cluster.indexCount, center);
+    std::vector<Cluster> sorted = clusters;
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const Cluster &x, const Cluster &y) { return x.outwardness > y.outwardness; });
+    uint32_t first = clusters.front().firstIndex;
+    std::vector<uint32_t> ordered;
+    for (const Cluster &cluster : sorted)
+        ordered.insert(ordered.end(), indices + cluster.firstIndex, indices + cluster.firstIndex + cluster.indexCount);
+    std::copy(ordered.begin(), ordered.end(), indices + first);
+    for (Cluster &cluster : sorted)
+    {
+        cluster.firstIndex = first;
+        first += cluster.indexCount;
+    }
+    clusters = std::move(sorted);
+}
+
+inline glm::vec3 meshCenter(const MeshBuilder &builder)
+{
+    glm::vec3 low(1e30f), high(-1e30f);
+    for (size_t v = 0; v < builder.vertexCount(); v++)
+    {
+        const float *p = &builder.vertices[v * builder.stride];
+        low = glm::min(low, glm::vec3(p[0], p[1], p[2]));
+        high = glm::max(high, glm::vec3(p[0], p[1], p[2]));
+    }
+    return builder.vertexCount() > 0 ? (low + high) * 0.5f : glm::vec3(0.0f);
+}
+} // namespace optimizer
+
+// sorts the cache optimized triangles of indices[0, count) for less overdraw. They are cut
+// where a triangle misses the simulated cache with all three vertices, the cache starts cold
+// there anyway, so moving the runs keeps the ACMR
+inline void optimizeOverdraw(const MeshBuilder &builder, uint32_t *indices, size_t count)
+{
+    using namespace optimizer;
+    std::vector<size_t> enteredAt(builder.vertexCount(), 0);
+    std::vector<Cluster> clusters;
+    size_t misses = 0;
+    for (size_t t = 0; t + 2 < count; t += 3)
+    {
+        int triangleMisses = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t vertex = indices[t + k];
+            if (enteredAt[vertex] == 0 || misses + 1 - enteredAt[vertex] > VERTEX_CACHE_SIZE)
+            {
+                misses++;
+                enteredAt[vertex] = misses;
+                triangleMisses++;
+            }
+        }
+        if (triangleMisses == 3 || clusters.empty())
+            clusters.push_back({(uint32_t)t, 0, 0.0f, 0});
+        clusters.back().indexCount += 3;
+    }
+    sortClusters(builder, indices, clusters, meshCenter(builder));
+}
+
+// renumbers the vertices in the order the indices first use them, unused ones are dropped
+inline void optimizeVertexFetch(MeshBuilder &builder)
+{
+    std::vector<char> placed(builder.vertexCount(), 0);
+    std::vector<uint32_t> order;
+    order.reserve(builder.vertexCount());
+    for (uint32_t index : builder.indices)
+    {
+        if (!placed[index])
+            order.push_back(index);
+        placed[index] = 1;
+    }
+    builder.reorderVertices(order);
+}
+
+// every optimization above over every level of builder: level 0 per submesh, or per meshlet
+// when built, with the meshlets of a submesh sorted for overdraw instead of the cache runs
+inline void optimizeMesh(MeshBuilder &builder)
+{
+    using namespace optimizer;
+    std::vector<MeshLod> levels = builder.levels();
+    std::vector<Submesh> ranges = builder.submeshes;
+    if (ranges.empty())
+        ranges.push_back({0, levels[0].indexCount});
+    size_t vertexCount = builder.vertexCount();
+
+    if (builder.meshlets.empty())
+    {
+        for (const Submesh &range : ranges)
+        {
+            optimizeVertexCache(&builder.indices[range.firstIndex], range.indexCount, vertexCount);
+            optimizeOverdraw(builder, &builder.indices[range.firstIndex], range.indexCount);
+        }
+    }
+    else
+    {
+        // meshlets don't cross submeshes and are in submesh order (see meshlets.cpp)
+        glm::vec3 center = meshCenter(builder);
+        size_t next = 0;
+        std::vector<Meshlet> sortedMeshlets;
+        for (const Submesh &range : ranges)
+        {
+            std::vector<Cluster> clusters;
+            for (; next < builder.meshlets.size() &&
+                   builder.meshlets[next].firstIndex < range.firstIndex + range.indexCount;
+                 next++)
+            {
+                const Meshlet &meshlet = builder.meshlets[next];
+                optimizeVertexCache(&builder.indices[meshlet.firstIndex], meshlet.indexCount, vertexCount);
+                clusters.push_back({meshlet.firstIndex, meshlet.indexCount, 0.0f, (uint32_t)next});
+            }
+            sortClusters(builder, builder.indices.data(), clusters, center);
+            for (const Cluster &cluster : clusters)
+            {
+                sortedMeshlets.push_back(builder.meshlets[cluster.source]);
+                sortedMeshlets.back().firstIndex = cluster.firstIndex;
+            }
+        }
+        builder.meshlets = std::move(sortedMeshlets);
+    }
+    for (size_t level = 1; level < levels.size(); level++)
+    {
+        optimizeVertexCache(&builder.indices[levels[level].firstIndex], levels[level].indexCount, vertexCount);
+        optimizeOverdraw(builder, &builder.indices[levels[level].firstIndex], levels[level].indexCount);
+    }
+    optimizeVertexFetch(builder);
+}
+
+#endif
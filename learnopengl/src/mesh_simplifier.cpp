@@ -0,0 +1,278 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "glm/glm.hpp"
+
+#include "mesh.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Quadric error mesh simplification (Garland and Heckbert) for the levels of detail the mesh
+// cooker writes. Every corner gathers the planes of the triangles around it as a quadric,
+// which measures the squared distance of a point to all of them; collapsing an edge moves
+// one end onto the other for the sum of both quadrics at that point, the cheapest edges
+// go first. The kept vertex is always one of the originals, so the levels share the vertex
+// buffer of the full mesh and only add indices.
+// Collapses run in passes over every edge, no corner moves twice within a pass and a collapse
+// that would flip a triangle around it is skipped. Corners with several vertices (texture
+// coordinate or normal seams) and corners on an open border stay where they are, so the
+// seams and the silhouette of holes don't tear.
+
+namespace simplifier
+{
+// symmetric 4x4 matrix of a sum of planes, the upper triangle row by row
+struct Quadric
+{
+    double m[10] = {};
+
+    void addPlane(const glm::dvec3 &normal, double distance)
+    {
+        double p[4] = {normal.x, normal.y, normal.z, distance};
+        int k = 0;
+        for (int row = 0; row < 4; row++)
+        {
+            for (int column = row; column < 4; column++)
+                m[k++] += p[row] * p[column];
+        }
+    }
+
+    void add(const Quadric &other)
+    {
+        for (int k = 0; k < 10; k++)
+            m[k] += other.m[k];
+    }
+
+    // the summed squared distance of point to the planes
+    double evaluate(const glm::dvec3 &point) const
+    {
+        double v[4] = {point.x, point.y, point.z, 1.0};
+        double result = 0.0;
+        int k = 0;
+        for (int row = 0; row < 4; row++)
+        {
+            for (int column = row; column < 4; column++)
+                result += (row == column ? 1.0 : 2.0) * m[k++] * v[row] * v[column];
+        }
+        return std::max(result, 0.0);
+    }
+};
+
+struct Collapse
+{
+    uint32_t from, to;
+    double cost;
+};
+
+inline uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+    return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+inline glm::dvec3 triangleNormal(const glm::dvec3 &a, const glm::dvec3 &b, const glm::dvec3 &c)
+{
+    return glm::cross(b - a, c - a);
+}
+} // namespace simplifier
+
+// The triangles of indices (into the vertices of builder, which start with their position)
+// simplified down to about targetIndexCount indices, no collapse costing more than maxError.
+// error is raised to the distance, in model units, the surface moved by at most.
+inline std::vector<uint32_t> simplifyMesh(const MeshBuilder &builder, std::vector<uint32_t> indices,
+                                          size_t targetIndexCount, float maxError, float &error)
+{
+    using namespace simplifier;
+    size_t vertexCount = builder.vertexCount();
+    std::vector<glm::dvec3> positions(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        const float *vertex = &builder.vertices[v * builder.stride];
+        positions[v] = glm::dvec3(vertex[0], vertex[1], vertex[2]);
+    }
+
+    // vertices at the same position are one corner
+    std::vector<uint32_t> corner(vertexCount);
+    std::vector<uint32_t> cornerVertices;
+    std::unordered_map<std::string, uint32_t> cornerOfPosition;
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        std::string key((const char *)&builder.vertices[v * builder.stride], 3 * sizeof(float));
+        auto found = cornerOfPosition.emplace(std::move(key), (uint32_t)cornerVertices.size());
+        if (found.second)
+            cornerVertices.push_back(0);
+        corner[v] = found.first->second;
+    }
+
+    std::vector<char> used(vertexCount, 0);
+    for (uint32_t index : indices)
+    {
+        if (!used[index])
+            cornerVertices[corner[index]]++;
+        used[index] = 1;
+    }
+    std::vector<char> locked(cornerVertices.size(), 0);
+    for (size_t c = 0; c < cornerVertices.size(); c++)
+        locked[c] = cornerVertices[c] > 1;
+
+    // an edge with one triangle is on a border, with more than two it isn't a manifold
+    std::unordered_map<uint64_t, uint32_t> edgeTriangles;
+    std::vector<Quadric> quadrics(cornerVertices.size());
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        const uint32_t *triangle = &indices[t];
+        for (int e = 0; e < 3; e++)
+            edgeTriangles[edgeKey(corner[triangle[e]], corner[triangle[(e + 1) % 3]])]++;
+        glm::dvec3 normal = triangleNormal(positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]);
+        double length = glm::length(normal);
+        if (length <= 0.0)
+            continue;
+        normal /= length;
+        double distance = -glm::dot(normal, positions[triangle[0]]);
+        for (int e = 0; e < 3; e++)
+            quadrics[corner[triangle[e]]].addPlane(normal, distance);
+    }
+    for (const auto &edge : edgeTriangles)
+    {
+        if (edge.second != 2)
+            locked[edge.first >> 32] = locked[edge.first & 0xFFFFFFFFu] = 1;
+    }
+
+    double maxCost = (double)maxError * maxError;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint32_t> firstTriangle(vertexCount + 1), triangles;
+    std::vector<char> touched(cornerVertices.size());
+    std::vector<Collapse> collapses;
+    while (indices.size() > targetIndexCount)
+    {
+        // the triangles around every vertex
+        std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+        for (uint32_t index : indices)
+            firstTriangle[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            firstTriangle[v + 1] += firstTriangle[v];
+        triangles.resize(indices.size());
+        std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            triangles[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+        // every edge both ways, unless the moving end is locked
+        collapses.clear();
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                uint32_t a = indices[t + e], b = indices[t + (e + 1) % 3];
+                for (int direction = 0; direction < 2; direction++, std::swap(a, b))
+                {
+                    if (locked[corner[a]] || corner[a] == corner[b])
+                        continue;
+                    Quadric sum = quadrics[corner[a]];
+                    sum.add(quadrics[corner[b]]);
+                    collapses.push_back({a, b, sum.evaluate(positions[b])});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+        // each collapse takes about two triangles
+        size_t wanted = (indices.size() - targetIndexCount) / 6 + 1, done = 0;
+        for (size_t v = 0; v < vertexCount; v++)
+            remap[v] = (uint32_t)v;
+        std::fill(touched.begin(), touched.end(), 0);
+        for (const Collapse &collapse : collapses)
+        {
+            if (collapse.cost > maxCost || done >= wanted)
+                break;
+            uint32_t from = collapse.from, to = collapse.to;
+            if (touched[corner[from]] || touched[corner[to]])
+                continue;
+            // the triangles that stay have to keep facing the same way
+            bool flips = false;
+            for (uint32_t i = firstTriangle[from]; i < firstTriangle[from + 1] && !flips; i++)
+            {
+                const uint32_t *triangle = &indices[triangles[i] * 3];
+                if (corner[triangle[0]] == corner[to] || corner[triangle[1]] == corner[to] ||
+                    corner[triangle[2]] == corner[to])
+                    continue;
+                glm::dvec3 before[3], after[3];
+                for (int c = 0; c < 3; c++)
+                {
+                    before[c] = positions[triangle[c]];
+                    after[c] = triangle[c] == from ? positions[to] : before[c];
+                }
+                glm::dvec3 oldNormal = triangleNormal(before[0], before[1], before[2]);
+                glm::dvec3 newNormal = triangleNormal(after[0], after[1], after[2]);
+                flips = glm::dot(oldNormal, newNormal) <= 0.25 * glm::length(oldNormal) * glm::length(newNormal);
+            }
+            if (flips)
+                continue;
+
+            remap[from] = to;
+            quadrics[corner[to]].add(quadrics[corner[from]]);
+            error = std::max(error, (float)std::sqrt(collapse.cost));
+            // the ring around the collapse is fixed for the rest of the pass, the flip test
+            // above assumed it doesn't move
+            for (uint32_t i = firstTriangle[from]; i < firstTriangle[from + 1]; i++)
+            {
+                for (int c = 0; c < 3; c++)
+                    touched[corner[indices[triangles[i] * 3 + c]]] = 1;
+            }
+            done++;
+        }
+        if (done == 0)
+            break;
+
+        // the collapsed triangles are the ones with two corners on one position now
+        size_t kept = 0;
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            uint32_t a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+            if (corner[a] == corner[b] || corner[b] == corner[c] || corner[c] == corner[a])
+                continue;
+            indices[kept++] = a;
+            indices[kept++] = b;
+            indices[kept++] = c;
+        }
+        indices.resize(kept);
+    }
+    return indices;
+}
+
+// appends up to MESH_MAX_LODS - 1 simplified levels to the indices of builder, each with about
+// half the triangles of the one before. Stops early once the simplification has nothing left
+// to take without seams moving, or would move the surface by more than maxRelativeError of
+// the mesh's bounding radius.
+inline void buildMeshLods(MeshBuilder &builder, float maxRelativeError = 0.25f)
+{
+    builder.lods = builder.levels();
+    glm::vec3 low(1e30f), high(-1e30f);
+    for (size_t v = 0; v < builder.vertexCount(); v++)
+    {
+        glm::vec3 position(builder.vertices[v * builder.stride], builder.vertices[v * builder.stride + 1],
+                           builder.vertices[v * builder.stride + 2]);
+        low = glm::min(low, position);
+        high = glm::max(high, position);
+    }
+    float maxError = builder.vertexCount() > 0 ? glm::length(high - low) * 0.5f * maxRelativeError : 0.0f;
+
+    std::vector<uint32_t> level(builder.indices.begin(), builder.indices.end());
+    float error = 0.0f;
+    while (builder.lods.size() < MESH_MAX_LODS)
+    {
+        size_t target = level.size() / 6 * 3;
+        std::vector<uint32_t> simplified = simplifyMesh(builder, level, target, maxError, error);
+        // less than a tenth fewer triangles isn't worth a level
+        if (simplified.empty() || simplified.size() * 10 > level.size() * 9)
+            break;
+        builder.lods.push_back({(uint32_t)builder.indices.size(), (uint32_t)simplified.size(), error, 0});
+        builder.indices.insert(builder.indices.end(), simplified.begin(), simplified.end());
+        level = std::move(simplified);
+    }
+}
+
+#endif
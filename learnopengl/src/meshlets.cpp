@@ -0,0 +1,189 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include "glm/glm.hpp"
+
+#include "mesh.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Splits level 0 of a mesh into meshlets of at most MESHLET_MAX_VERTICES distinct vertices and
+// MESHLET_MAX_TRIANGLES triangles, for the GPU to cull each one on its own by its bounding
+// sphere (frustum, Hi-Z) and its normal cone (all triangles facing away from the camera).
+// A meshlet grows from a seed triangle over the triangles next to it (sharing a position, so
+// across texture seams too), taking the one that brings the fewest new vertices first, so it
+// stays compact and its bounds tight. The triangles of level 0 are reordered into meshlet
+// order within each submesh, so every meshlet is a plain range of indices and is drawn as
+// one indirect command.
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+namespace meshlets
+{
+inline glm::vec3 position(const MeshBuilder &builder, uint32_t vertex)
+{
+    const float *p = &builder.vertices[(size_t)vertex * builder.stride];
+    return glm::vec3(p[0], p[1], p[2]);
+}
+
+// bounds of the triangles of indices[first, first + count)
+inline Meshlet bound(const MeshBuilder &builder, uint32_t first, uint32_t count)
+{
+    Meshlet meshlet = {first, count, {0, 0}, glm::vec4(0.0f), glm::vec4(0.0f, 0.0f, 1.0f, 1.0f)};
+    glm::vec3 low(1e30f), high(-1e30f);
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        low = glm::min(low, position(builder, builder.indices[i]));
+        high = glm::max(high, position(builder, builder.indices[i]));
+    }
+    glm::vec3 center = (low + high) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t i = first; i < first + count; i++)
+        radius = std::max(radius, glm::length(position(builder, builder.indices[i]) - center));
+    meshlet.sphere = glm::vec4(center, radius);
+
+    std::vector<glm::vec3> normals;
+    glm::vec3 sum(0.0f);
+    for (uint32_t i = first; i + 2 < first + count; i += 3)
+    {
+        glm::vec3 a = position(builder, builder.indices[i]);
+        glm::vec3 normal = glm::cross(position(builder, builder.indices[i + 1]) - a,
+                                      position(builder, builder.indices[i + 2]) - a);
+        float length = glm::length(normal);
+        if (length <= 0.0f)
+            continue;
+        normals.push_back(normal / length);
+        sum += normal / length;
+    }
+    if (normals.empty() || glm::length(sum) <= 0.0f)
+        return meshlet;
+    glm::vec3 axis = glm::normalize(sum);
+    float minDot = 1.0f;
+    for (const glm::vec3 &normal : normals)
+        minDot = std::min(minDot, glm::dot(normal, axis));
+    // wider than about 84 degrees, or a half space it could always be seen from
+    if (minDot <= 0.1f)
+        return meshlet;
+    meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+    return meshlet;
+}
+} // namespace meshlets
+
+// one meshlet over all of level 0, what a mesh without built meshlets is culled as
+inline Meshlet wholeMeshlet(uint32_t indexCount, glm::vec3 boundsCenter, glm::vec3 boundsExtent)
+{
+    return {0, indexCount, {0, 0}, glm::vec4(boundsCenter, glm::length(boundsExtent)),
+            glm::vec4(0.0f, 0.0f, 1.0f, 1.0f)};
+}
+
+// reorders the triangles of level 0 into meshlets and fills builder.meshlets
+inline void buildMeshlets(MeshBuilder &builder)
+{
+    using namespace meshlets;
+    builder.meshlets.clear();
+    uint32_t levelCount = builder.levels()[0].indexCount;
+    std::vector<Submesh> ranges = builder.submeshes;
+    if (ranges.empty())
+        ranges.push_back({0, levelCount});
+
+    // vertices at the same position are one corner, so neighbours across a seam are found too
+    size_t vertexCount = builder.vertexCount();
+    std::vector<uint32_t> corner(vertexCount);
+    std::unordered_map<std::string, uint32_t> cornerOfPosition;
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        std::string key((const char *)&builder.vertices[v * builder.stride], 3 * sizeof(float));
+        corner[v] = cornerOfPosition.emplace(std::move(key), (uint32_t)cornerOfPosition.size()).first->second;
+    }
+
+    // the triangles around every corner
+    size_t cornerCount = cornerOfPosition.size();
+    std::vector<uint32_t> firstTriangle(cornerCount + 1, 0), triangles(levelCount);
+    for (uint32_t i = 0; i < levelCount; i++)
+        firstTriangle[corner[builder.indices[i]] + 1]++;
+    for (size_t c = 0; c < cornerCount; c++)
+        firstTriangle[c + 1] += firstTriangle[c];
+    std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (uint32_t i = 0; i < levelCount; i++)
+        triangles[fill[corner[builder.indices[i]]]++] = i / 3;
+
+    std::vector<char> emitted(levelCount / 3, 0);
+    // the meshlet a vertex was last added to, + 1
+    std::vector<uint32_t> inMeshlet(vertexCount, 0);
+    std::vector<uint32_t> ordered(builder.indices.begin(), builder.indices.begin() + levelCount);
+    std::vector<uint32_t> candidates;
+    uint32_t out = 0, stamp = 0;
+    for (const Submesh &range : ranges)
+    {
+        uint32_t firstTriangleOfRange = range.firstIndex / 3, lastTriangle = (range.firstIndex + range.indexCount) / 3;
+        uint32_t seed = firstTriangleOfRange;
+        for (;;)
+        {
+            while (seed < lastTriangle && emitted[seed])
+                seed++;
+            if (seed >= lastTriangle)
+                break;
+
+            // a new meshlet from the first triangle not taken yet
+            uint32_t meshletFirst = out, vertices = 0, meshletTriangles = 0;
+            stamp++;
+            candidates.assign(1, seed);
+            while (!candidates.empty() && meshletTriangles < MESHLET_MAX_TRIANGLES)
+            {
+                // the candidate adding the fewest vertices, ones taken meanwhile drop out
+                candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                                [&](uint32_t triangle) { return emitted[triangle] != 0; }),
+                                 candidates.end());
+                size_t best = candidates.size();
+                int bestNew = 4;
+                for (size_t c = 0; c < candidates.size(); c++)
+                {
+                    int added = 0;
+                    for (int k = 0; k < 3; k++)
+                        added += inMeshlet[builder.indices[candidates[c] * 3 + k]] != stamp;
+                    if (added < bestNew)
+                    {
+                        bestNew = added;
+                        best = c;
+                    }
+                }
+                if (best == candidates.size() || vertices + bestNew > MESHLET_MAX_VERTICES)
+                    break;
+                uint32_t triangle = candidates[best];
+                candidates[best] = candidates.back();
+                candidates.pop_back();
+                emitted[triangle] = 1;
+                meshletTriangles++;
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t vertex = builder.indices[triangle * 3 + k];
+                    ordered[out++] = vertex;
+                    if (inMeshlet[vertex] == stamp)
+                        continue;
+                    inMeshlet[vertex] = stamp;
+                    vertices++;
+                    // its neighbours in the same submesh
+                    uint32_t at = corner[vertex];
+                    for (uint32_t t = firstTriangle[at]; t < firstTriangle[at + 1]; t++)
+                    {
+                        uint32_t next = triangles[t];
+                        if (!emitted[next] && next >= firstTriangleOfRange && next < lastTriangle)
+                            candidates.push_back(next);
+                    }
+                }
+            }
+            builder.meshlets.push_back({meshletFirst, out - meshletFirst, {0, 0}, glm::vec4(0.0f), glm::vec4(0.0f)});
+        }
+    }
+    std::copy(ordered.begin(), ordered.end(), builder.indices.begin());
+    for (Meshlet &meshlet : builder.meshlets)
+        meshlet = bound(builder, meshlet.firstIndex, meshlet.indexCount);
+}
+
+#endif
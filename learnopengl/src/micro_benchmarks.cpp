@@ -0,0 +1,453 @@
+#ifndef MICRO_BENCHMARKS_H
+#define MICRO_BENCHMARKS_H
+
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "batch_math.cpp"
+#include "camera.cpp"
+#include "gl_context.cpp"
+#include "gl_objects.cpp"
+#include "gpu_sort.cpp"
+#include "image_decoder.cpp"
+#include "render_queue.cpp"
+#include "shader.cpp"
+#include "shader_compiler.cpp"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Microbenchmarks of the pieces the frame is built from, in the style of Google Benchmark
+// without the dependency: a benchmark runs its loop while state.next() says so, the runner
+// grows the iterations until a run takes minSeconds and prints the time per iteration, with
+// the items per second where the benchmark says how many items an iteration handles. The GL
+// ones run on a hidden window's context, made only when one of them is selected.
+
+// keeps the compiler from dropping a result nothing reads
+template <typename T> inline void doNotOptimize(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static const void *volatile sink;
+    sink = &value;
+    _ReadWriteBarrier();
+#endif
+}
+
+class MicroBenchmarkState
+{
+  public:
+    // items one iteration handles, set by the benchmark for a throughput
+    uint64_t itemsPerIteration = 0;
+
+    explicit MicroBenchmarkState(uint64_t iterations) : remaining(iterations)
+    {
+    }
+
+    bool next()
+    {
+        return remaining-- > 0;
+    }
+
+  private:
+    uint64_t remaining;
+};
+
+struct MicroBenchmark
+{
+    std::string name;
+    bool needsGL;
+    std::function<void(MicroBenchmarkState &)> run;
+};
+
+// --micro-benchmark [filter]: every benchmark whose name contains filter, the images in
+// directory for the decodes. Returns 1 when a GL one was selected but there was no context.
+inline int runMicroBenchmarks(const std::string &filter, const std::string &directory, double minSeconds = 0.2)
+{
+    std::vector<MicroBenchmark> benchmarks;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    // uniforms, as the render loop sets them: by a literal name (hashed at compile time, a
+    // binary search at run time), by a name built at run time, by a handle resolved once,
+    // and the driver's string lookup that reflection replaced. The value alternates, set()
+    // doesn't send one the program already holds, the last one measures that skip
+    std::unique_ptr<Shader> shader;
+    UniformHandle model;
+    glm::mat4 value = glm::rotate(glm::mat4(1.0f), 0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 alternating[2] = {value, glm::mat4(1.0f)};
+    std::string runtimeName = "model";
+    benchmarks.push_back({"shader/uniform by literal name", true, [&](MicroBenchmarkState &state) {
+                              for (size_t n = 0; state.next(); n++)
+                                  shader->setMat4("model", alternating[n & 1]);
+                          }});
+    benchmarks.push_back({"shader/uniform by run time name", true, [&](MicroBenchmarkState &state) {
+                              for (size_t n = 0; state.next(); n++)
+                                  shader->setMat4(runtimeName, alternating[n & 1]);
+                          }});
+    benchmarks.push_back({"shader/uniform by cached handle", true, [&](MicroBenchmarkState &state) {
+                              for (size_t n = 0; state.next(); n++)
+                                  shader->set(model, alternating[n & 1]);
+                          }});
+    benchmarks.push_back({"shader/unchanged uniform by cached handle", true, [&](MicroBenchmarkState &state) {
+                              while (state.next())
+                                  shader->set(model, value);
+                          }});
+    benchmarks.push_back({"shader/glGetUniformLocation per set", true, [&](MicroBenchmarkState &state) {
+                              while (state.next())
+                                  glUniformMatrix4fv(glGetUniformLocation(shader->ID, "model"), 1, GL_FALSE,
+                                                     &value[0][0]);
+                          }});
+
+    // the camera's matrices: still (the cached path every other caller takes), moving, and
+    // turning, which is updateCameraVectors() or the quaternion update
+    Camera camera(glm::vec3(0.0f, 1.0f, 5.0f));
+    benchmarks.push_back({"camera/GetViewMatrix still", false, [&](MicroBenchmarkState &state) {
+                              while (state.next())
+                                  doNotOptimize(camera.GetViewMatrix());
+                          }});
+    benchmarks.push_back({"camera/GetViewMatrix moving", false, [&](MicroBenchmarkState &state) {
+                              while (state.next())
+                              {
+                                  camera.position.x += 0.001f;
+                                  doNotOptimize(camera.GetViewMatrix());
+                              }
+                          }});
+    benchmarks.push_back({"camera/GetViewMatrix turning (euler)", false, [&](MicroBenchmarkState &state) {
+                              camera.setQuaternionMode(false);
+                              while (state.next())
+                              {
+                                  camera.processMouseMovement(0.5, 0.0);
+                                  doNotOptimize(camera.GetViewMatrix());
+                              }
+                          }});
+    benchmarks.push_back({"camera/GetViewMatrix turning (quaternion)", false, [&](MicroBenchmarkState &state) {
+                              camera.setQuaternionMode(true);
+                              while (state.next())
+                              {
+                                  camera.processMouseMovement(0.5, 0.0);
+                                  doNotOptimize(camera.GetViewMatrix());
+                              }
+                              camera.setQuaternionMode(false);
+                          }});
+
+    // one model matrix per spinning object, as the main loop built them and as TransformSystem does
+    const size_t OBJECTS = 10000;
+    std::vector<float> x(OBJECTS), y(OBJECTS), z(OBJECTS), ax(OBJECTS), ay(OBJECTS), az(OBJECTS), angles(OBJECTS);
+    for (size_t i = 0; i < OBJECTS; i++)
+    {
+        x[i] = unit(random) * 50.0f;
+        y[i] = unit(random) * 50.0f;
+        z[i] = unit(random) * 50.0f;
+        glm::vec3 axis = glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 2.0f, 0.0f);
+        axis = glm::normalize(axis);
+        ax[i] = axis.x;
+        ay[i] = axis.y;
+        az[i] = axis.z;
+        angles[i] = unit(random) * 3.14159265f;
+    }
+    std::vector<glm::mat4> models(OBJECTS);
+    benchmarks.push_back({"model matrices/glm loop", false, [&](MicroBenchmarkState &state) {
+                              state.itemsPerIteration = OBJECTS;
+                              while (state.next())
+                              {
+                                  for (size_t i = 0; i < OBJECTS; i++)
+                                  {
+                                      glm::vec3 position(x[i], y[i], z[i]);
+                                      glm::mat4 translated = glm::translate(glm::mat4(1.0f), position);
+                                      models[i] = glm::rotate(translated, angles[i], glm::vec3(ax[i], ay[i], az[i]));
+                                  }
+                                  doNotOptimize(models.data());
+                              }
+                          }});
+    benchmarks.push_back({"model matrices/batched", false, [&](MicroBenchmarkState &state) {
+                              state.itemsPerIteration = OBJECTS;
+                              while (state.next())
+                              {
+                                  batchTranslateRotate(x.data(), y.data(), z.data(), ax.data(), ay.data(), az.data(),
+                                                       angles.data(), models.data(), OBJECTS);
+                                  doNotOptimize(models.data());
+                              }
+                          }});
+
+    // a frame's worth of queued draws, refilled in the order they were recorded and sorted
+    const size_t DRAWS = 20000;
+    std::vector<RenderItem> recorded(DRAWS);
+    for (size_t i = 0; i < DRAWS; i++)
+    {
+        RenderLayer layer = i % 8 == 0 ? RENDER_LAYER_TRANSPARENT : RENDER_LAYER_OPAQUE;
+        recorded[i] = {RenderQueue::makeKey(layer, random() % 12, random() % 300, random() % 40,
+                                            (unit(random) + 1.0f) * 0.5f),
+                       0, (uint32_t)i};
+    }
+    RenderQueue queue;
+    benchmarks.push_back({"render queue/radix sort", false, [&](MicroBenchmarkState &state) {
+                              state.itemsPerIteration = DRAWS;
+                              while (state.next())
+                              {
+                                  queue.items.assign(recorded.begin(), recorded.end());
+                                  queue.sort();
+                                  doNotOptimize(queue.items.data());
+                              }
+                          }});
+    benchmarks.push_back({"render queue/std::stable_sort", false, [&](MicroBenchmarkState &state) {
+                              state.itemsPerIteration = DRAWS;
+                              while (state.next())
+                              {
+                                  queue.items.assign(recorded.begin(), recorded.end());
+                                  std::stable_sort(queue.items.begin(), queue.items.end(),
+                                                   [](const RenderItem &a, const RenderItem &b) {
+                                                       return a.key < b.key;
+                                                   });
+                                  doNotOptimize(queue.items.data());
+                              }
+                          }});
+
+    // 100k draws keyed on the workers into their buckets and radix sorted over them, against
+    // the same on one thread
+    const size_t MANY_DRAWS = 100000;
+    std::vector<RenderItem> many(MANY_DRAWS);
+    for (size_t i = 0; i < MANY_DRAWS; i++)
+        many[i] = {RenderQueue::makeKey(RENDER_LAYER_OPAQUE, random() % 12, random() % 300, random() % 40,
+                                        (unit(random) + 1.0f) * 0.5f),
+                   0, (uint32_t)i};
+    std::unique_ptr<JobSystem> jobs;
+    benchmarks.push_back({"render queue/record and sort 100k", false, [&](MicroBenchmarkState &state) {
+                              state.itemsPerIteration = MANY_DRAWS;
+                              while (state.next())
+                              {
+                                  queue.clear();
+                                  for (const RenderItem &item : many)
+                                      queue.add(item.key, item.source, item.index);
+                                  queue.sort();
+                                  doNotOptimize(queue.items.data());
+                              }
+                          }});
+    benchmarks.push_back({"render queue/parallel record and sort 100k", false, [&](MicroBenchmarkState &state) {
+                              if (!jobs)
+                                  jobs = std::make_unique<JobSystem>();
+                              state.itemsPerIteration = MANY_DRAWS;
+                              while (state.next())
+                              {
+                                  queue.clear();
+                                  queue.record(*jobs, MANY_DRAWS, 1024, [&](size_t i, RenderBucket &bucket) {
+                                      bucket.add(many[i].key, many[i].source, many[i].index);
+                                  });
+                                  queue.sort(*jobs);
+                                  doNotOptimize(queue.items.data());
+                              }
+                          }});
+
+    // GPU sorting from 1M to 16M keys (see gpu_sort.cpp): each iteration first copies the
+    // unsorted keys back, the GPU is waited for at the end
+    const size_t GPU_KEYS = (size_t)16 << 20;
+    std::unique_ptr<ShaderCompiler> compiler;
+    std::unique_ptr<GpuSort> gpuSort;
+    unsigned int sortBuffers[6] = {};
+    unsigned int &unsortedKeys = sortBuffers[0], &keys = sortBuffers[1], &indices = sortBuffers[2],
+                 &values = sortBuffers[3], &flags = sortBuffers[4], &compactedCount = sortBuffers[5];
+    auto createSortBuffers = [&]() {
+        if (unsortedKeys)
+            return;
+        std::vector<uint32_t> words(GPU_KEYS);
+        for (uint32_t &word : words)
+            word = (uint32_t)random();
+        unsortedKeys = createBuffer(words.size() * sizeof(uint32_t), words.data(), 0);
+        keys = createBuffer(words.size() * sizeof(uint32_t), NULL, 0);
+        // every other value on average is kept by the compaction
+        for (uint32_t &word : words)
+            word &= 1u;
+        flags = createBuffer(words.size() * sizeof(uint32_t), words.data(), 0);
+        for (size_t i = 0; i < words.size(); i++)
+            words[i] = (uint32_t)i;
+        indices = createBuffer(words.size() * sizeof(uint32_t), words.data(), 0);
+        values = createBuffer(words.size() * sizeof(uint32_t), NULL, 0);
+        compactedCount = createBuffer(sizeof(uint32_t), NULL, 0);
+    };
+    // keys of 1 or 2 words, with their index as the value or alone
+    auto gpuSortBenchmark = [&](size_t count, int words, bool withValues) {
+        return [&, count, words, withValues](MicroBenchmarkState &state) {
+            state.itemsPerIteration = count;
+            if (!gpuSort)
+            {
+                while (state.next())
+                    ;
+                return;
+            }
+            createSortBuffers();
+            while (state.next())
+            {
+                copyBuffer(unsortedKeys, keys, 0, 0, count * words * sizeof(uint32_t));
+                if (withValues)
+                    copyBuffer(indices, values, 0, 0, count * sizeof(uint32_t));
+                gpuSort->sort(keys, withValues ? values : 0, count, words);
+            }
+            glFinish();
+        };
+    };
+    for (size_t millions : {1, 4, 16})
+    {
+        std::string size = " " + std::to_string(millions) + "M";
+        benchmarks.push_back({"gpu sort/32 bit keys" + size, true, gpuSortBenchmark(millions << 20, 1, false)});
+        benchmarks.push_back(
+            {"gpu sort/32 bit keys and values" + size, true, gpuSortBenchmark(millions << 20, 1, true)});
+        // the 16M words make 8M of them
+        if (millions < 16)
+            benchmarks.push_back({"gpu sort/64 bit keys and values" + size, true,
+                                  gpuSortBenchmark(millions << 20, 2, true)});
+    }
+    benchmarks.push_back({"gpu sort/prefix sum 16M", true, [&](MicroBenchmarkState &state) {
+                              state.itemsPerIteration = GPU_KEYS;
+                              if (!gpuSort)
+                              {
+                                  while (state.next())
+                                      ;
+                                  return;
+                              }
+                              createSortBuffers();
+                              while (state.next())
+                              {
+                                  copyBuffer(flags, keys, 0, 0, GPU_KEYS * sizeof(uint32_t));
+                                  gpuSort->scan(keys, GPU_KEYS);
+                              }
+                              glFinish();
+                          }});
+    benchmarks.push_back({"gpu sort/stream compaction 16M", true, [&](MicroBenchmarkState &state) {
+                              state.itemsPerIteration = GPU_KEYS;
+                              if (!gpuSort)
+                              {
+                                  while (state.next())
+                                      ;
+                                  return;
+                              }
+                              createSortBuffers();
+                              while (state.next())
+                                  gpuSort->compact(indices, flags, GPU_KEYS, values, compactedCount);
+                              glFinish();
+                          }});
+
+    // every image of the directory through the preferred decoder, as RGBA like the texture array
+    std::vector<std::string> names;
+    std::vector<std::vector<unsigned char>> files;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(directory, error))
+    {
+        std::string extension = entry.path().extension().string();
+        if (extension != ".jpg" && extension != ".jpeg" && extension != ".png")
+            continue;
+        std::vector<unsigned char> bytes;
+        if (!readFileContents(entry.path().string(), bytes))
+            continue;
+        names.push_back(entry.path().filename().string());
+        files.push_back(std::move(bytes));
+    }
+    for (size_t i = 0; i < files.size(); i++)
+        benchmarks.push_back({"image decode/" + names[i], false, [&bytes = files[i]](MicroBenchmarkState &state) {
+                                  int width = 0, height = 0, channels = 0;
+                                  while (state.next())
+                                  {
+                                      unsigned char *pixels =
+                                          decodeImage(bytes.data(), bytes.size(), &width, &height, &channels, 4);
+                                      doNotOptimize(pixels);
+                                      stbi_image_free(pixels);
+                                  }
+                                  state.itemsPerIteration = (uint64_t)width * height;
+                              }});
+
+    std::vector<const MicroBenchmark *> selected;
+    bool needsGL = false;
+    for (const MicroBenchmark &benchmark : benchmarks)
+    {
+        if (benchmark.name.find(filter) == std::string::npos)
+            continue;
+        selected.push_back(&benchmark);
+        needsGL = needsGL || benchmark.needsGL;
+    }
+
+    GLFWwindow *window = NULL;
+    bool initialized = needsGL && glfwInit();
+    if (needsGL)
+    {
+        GLContextVersion created;
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        if (initialized)
+            window = createGLWindow(64, 64, "micro benchmarks", {4, 6}, created);
+        if (window)
+        {
+            glfwMakeContextCurrent(window);
+            if (gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+            {
+                shader = std::make_unique<Shader>("src/shader_src/vertex_shader.vs",
+                                                  "src/shader_src/fragment_shader.fs");
+                shader->use();
+                model = shader->uniform("model");
+                if (GpuSort::isSupported())
+                {
+                    compiler = std::make_unique<ShaderCompiler>((GLADloadproc)glfwGetProcAddress);
+                    gpuSort = std::make_unique<GpuSort>(*compiler);
+                    gpuSort->prepare();
+                }
+            }
+        }
+        if (!shader)
+            std::cout << "ERROR::MICRO_BENCHMARKS::NO_CONTEXT: the shader benchmarks are skipped\n";
+    }
+
+    std::cout.precision(3);
+    std::cout << std::fixed;
+    for (const MicroBenchmark *benchmark : selected)
+    {
+        if (benchmark->needsGL && !shader)
+            continue;
+        uint64_t iterations = 1;
+        double seconds = 0.0;
+        uint64_t items = 0;
+        while (true)
+        {
+            MicroBenchmarkState state(iterations);
+            auto start = std::chrono::steady_clock::now();
+            benchmark->run(state);
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            items = state.itemsPerIteration;
+            if (seconds >= minSeconds || iterations >= (1ull << 40))
+                break;
+            iterations *= seconds > 0.0 ? std::clamp<uint64_t>((uint64_t)(minSeconds / seconds * 1.2), 2, 10) : 10;
+        }
+        if (benchmark->needsGL)
+            glFinish();
+        double nanoseconds = seconds * 1e9 / (double)iterations;
+        std::cout << benchmark->name << "  " << iterations << " iterations  " << nanoseconds << " ns";
+        if (items)
+            std::cout << "  " << (double)items * (double)iterations / seconds * 1e-6 << " M items/s";
+        std::cout << '\n';
+    }
+
+    if (unsortedKeys)
+        deleteBuffers(6, sortBuffers);
+    gpuSort.reset();
+    compiler.reset();
+    shader.reset();
+    if (window)
+        glfwDestroyWindow(window);
+    if (initialized)
+        glfwTerminate();
+    return needsGL && !shader ? 1 : 0;
+}
+
+#endif
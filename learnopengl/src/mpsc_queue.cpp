@@ -0,0 +1,107 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+// Bounded lock-free queue for any number of producer threads and a single consumer, capacity
+// a power of two. Every slot carries a sequence number: a producer claims the tail with a
+// compare exchange when the slot's sequence says it is empty, moves its item in and publishes
+// it by setting the sequence one past; the consumer takes the head once its slot is published
+// and hands the slot back to the producers a lap later. push() fails instead of waiting when
+// the queue is full and pop() when it is empty, neither ever takes a lock or allocates.
+template <typename T> class MPSCQueue
+{
+  public:
+    explicit MPSCQueue(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        mask = size - 1;
+        slots.reset(new Slot[size]);
+        for (size_t i = 0; i < size; i++)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // whatever is still queued is destroyed with it
+    ~MPSCQueue()
+    {
+        T item;
+        while (pop(item))
+        {
+        }
+    }
+
+    MPSCQueue(const MPSCQueue &) = delete;
+    MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+    size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+    // any thread; false when full, item is left as it was then
+    bool push(T &&item)
+    {
+        size_t position = tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot &slot = slots[position & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t lap = (intptr_t)sequence - (intptr_t)position;
+            if (lap == 0)
+            {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    new (slot.storage) T(std::move(item));
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (lap < 0)
+                return false;
+            else
+                position = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    // the consumer thread only; false when empty
+    bool pop(T &item)
+    {
+        Slot &slot = slots[head & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+            return false;
+        T *stored = std::launder(reinterpret_cast<T *>(slot.storage));
+        item = std::move(*stored);
+        stored->~T();
+        slot.sequence.store(head + mask + 1, std::memory_order_release);
+        head++;
+        return true;
+    }
+
+    // the consumer thread only, a snapshot while producers push
+    size_t size() const
+    {
+        return tail.load(std::memory_order_relaxed) - head;
+    }
+
+  private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+    // producers and the consumer on cache lines of their own
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) size_t head = 0;
+};
+
+#endif
@@ -0,0 +1,325 @@
+#ifndef MULTI_VIEW_H
+#define MULTI_VIEW_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include <GLFW/glfw3.h>
+
+#include "frame_data.cpp"
+#include "frustum_culler.cpp"
+#include "gl_extensions.cpp"
+#include "gl_state.cpp"
+#include "ring_buffer.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+// Mirrors the std140 layout of the Views block in shader_src/vertex_shader.vs.
+struct ViewsBlock
+{
+    glm::mat4 viewProjections[4];
+    int viewCount;
+    int padding[3];
+};
+static_assert(sizeof(ViewsBlock) == 272, "ViewsBlock must match the std140 block layout");
+
+// Several cameras drawn in one frame from the same scene data: the main view first, then
+// e.g. a debug camera in an inset or in a second window. cull() tests every sphere once
+// against all the frustums (batchCullSpheresViews) and leaves a visible list per view.
+// The views after the first are drawn either
+//   layered: in one instanced draw of the union of their lists, every object instanced once
+//            per view and routed to its viewport with gl_ViewportIndex (GL 4.1 viewport
+//            arrays and ARB_shader_viewport_layer_array, SHADER_MULTI_VIEW)
+//   per view: one draw each with the view's FrameData and viewport, on anything else
+// Views with a framebuffer of their own (a SecondaryWindow's) are always drawn per view.
+class MultiView
+{
+  public:
+    static const int MAX_VIEWS = 4;
+    // uniform buffer binding point of the Views block
+    static const unsigned int BINDING = 6;
+
+    struct View
+    {
+        FrameData frame;
+        Frustum frustum;
+        // viewport in the framebuffer, 0 draws into the one that is bound
+        int x, y, width, height;
+        unsigned int framebuffer;
+    };
+
+    // filled by cull() and gather(), visible[0] is the main view's
+    std::vector<uint32_t> visible[MAX_VIEWS];
+    // union of the views after the first, what the layered draw (or a StereoTarget) instances
+    std::vector<uint32_t> combined;
+    bool layered = false;
+
+    MultiView(RingBuffer &ring) : ring(ring)
+    {
+    }
+
+    static bool viewportArraySupported()
+    {
+        return GLAD_GL_VERSION_4_1 && hasGLExtension("GL_ARB_shader_viewport_layer_array");
+    }
+
+    int size() const
+    {
+        return (int)views.size();
+    }
+
+    const View &view(int index) const
+    {
+        return views[index];
+    }
+
+    // the views are set again every frame, starting with the main camera
+    void clear()
+    {
+        views.clear();
+        frustums.clear();
+    }
+
+    void add(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &position, int x, int y, int width,
+             int height, unsigned int framebuffer = 0)
+    {
+        if (size() == MAX_VIEWS)
+            return;
+        View added = {};
+        added.frame.view = view;
+        added.frame.projection = projection;
+        added.frame.viewProjection = projection * view;
+        added.frame.cameraPosition = glm::vec4(position, 1.0f);
+        added.frustum = Frustum(added.frame.viewProjection);
+        added.x = x;
+        added.y = y;
+        added.width = width;
+        added.height = height;
+        added.framebuffer = framebuffer;
+        views.push_back(added);
+        frustums.push_back(added.frustum);
+    }
+
+    // before the ranged cull() calls, rangeCount disjoint ranges of the spheres
+    void beginCull(size_t rangeCount)
+    {
+        for (std::vector<std::vector<uint32_t>> &viewRanges : ranges)
+            viewRanges.resize(rangeCount);
+    }
+
+    // one job's range of spheres for all the views, jobs with different ranges can run at once
+    void cull(const FrustumCuller &culler, size_t range, size_t first, size_t last)
+    {
+        // the kernel wants the views' lists side by side, swapping keeps their storage
+        std::vector<uint32_t> lists[MAX_VIEWS];
+        for (int v = 0; v < size(); v++)
+        {
+            ranges[v][range].clear();
+            lists[v].swap(ranges[v][range]);
+        }
+        culler.cull(frustums.data(), size(), first, last, lists);
+        for (int v = 0; v < size(); v++)
+            lists[v].swap(ranges[v][range]);
+    }
+
+    // the main view's ranges, for FrustumCuller::gather() to keep its counters
+    const std::vector<std::vector<uint32_t>> &mainRanges() const
+    {
+        return ranges[0];
+    }
+
+    // joins the ranges of every view and works out the layered draw
+    void gather()
+    {
+        for (int v = 0; v < size(); v++)
+        {
+            visible[v].clear();
+            for (const std::vector<uint32_t> &range : ranges[v])
+                visible[v].insert(visible[v].end(), range.begin(), range.end());
+        }
+        layered = size() > 1 && viewportArraySupported();
+        for (int v = 1; v < size(); v++)
+            layered = layered && views[v].framebuffer == 0;
+        combined.clear();
+        if (size() < 2)
+            return;
+        // the lists are in ascending order, and so is their union
+        combined = visible[1];
+        for (int v = 2; v < size(); v++)
+        {
+            merged.clear();
+            std::set_union(combined.begin(), combined.end(), visible[v].begin(), visible[v].end(),
+                           std::back_inserter(merged));
+            combined.swap(merged);
+        }
+    }
+
+    // views after the first that draw into the bound framebuffer get their rectangle cleared,
+    // they sit on top of what the main view drew there
+    void beginExtraViews()
+    {
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &mainFramebuffer);
+        glState.enable(GL_SCISSOR_TEST);
+        for (int v = 1; v < size(); v++)
+        {
+            if (views[v].framebuffer)
+                continue;
+            glScissor(views[v].x, views[v].y, views[v].width, views[v].height);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+        glState.disable(GL_SCISSOR_TEST);
+    }
+
+    // the layered draw: the Views block and one viewport per view after the first, the draw
+    // then instances each object of combined extraViews() times
+    void beginLayered()
+    {
+        ViewsBlock block = {};
+        block.viewCount = extraViews();
+        for (int v = 1; v < size(); v++)
+        {
+            block.viewProjections[v - 1] = views[v].frame.viewProjection;
+            glViewportIndexedf(v - 1, (float)views[v].x, (float)views[v].y, (float)views[v].width,
+                               (float)views[v].height);
+        }
+        GLintptr offset = ring.push(&block, sizeof(ViewsBlock), ring.uniformAlignment);
+        if (offset >= 0)
+            glState.bindBufferRange(GL_UNIFORM_BUFFER, BINDING, ring.ID, offset, sizeof(ViewsBlock));
+    }
+
+    // one view after the first on its own, with its FrameData, framebuffer and viewport
+    void beginView(int index, FrameDataBuffer &frameDataBuffer, float time)
+    {
+        View &current = views[index];
+        current.frame.time = time;
+        frameDataBuffer.update(current.frame);
+        if (current.framebuffer)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, current.framebuffer);
+            glViewport(current.x, current.y, current.width, current.height);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            return;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)mainFramebuffer);
+        glViewport(current.x, current.y, current.width, current.height);
+    }
+
+    // back to the main view's framebuffer, viewport and FrameData
+    void endExtraViews(FrameDataBuffer &frameDataBuffer, FrameData &mainFrame, int width, int height)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)mainFramebuffer);
+        // sets every viewport of the array back to the same one
+        glViewport(0, 0, width, height);
+        frameDataBuffer.update(mainFrame);
+    }
+
+    int extraViews() const
+    {
+        return std::max(size() - 1, 0);
+    }
+
+  private:
+    RingBuffer &ring;
+    std::vector<View> views;
+    std::vector<Frustum> frustums;
+    std::vector<std::vector<uint32_t>> ranges[MAX_VIEWS];
+    std::vector<uint32_t> merged;
+    GLint mainFramebuffer = 0;
+};
+
+// A second window whose context shares the main one's objects, showing a texture the main
+// context rendered, e.g. a MultiView view with its own framebuffer. Framebuffers are not
+// shared between contexts, so the window reads the texture through a framebuffer of its
+// own context; the main context's fence orders the read after the rendering. present()
+// comes back with the main context current, and the window never waits for vsync so the
+// main swap alone paces the frame.
+class SecondaryWindow
+{
+  public:
+    GLFWwindow *window = nullptr;
+
+    SecondaryWindow(const SecondaryWindow &) = delete;
+    SecondaryWindow &operator=(const SecondaryWindow &) = delete;
+    SecondaryWindow() = default;
+
+    ~SecondaryWindow()
+    {
+        destroy();
+    }
+
+    // called with the main context current on the main thread
+    bool create(GLFWwindow *shared, int width, int height, const char *title)
+    {
+        window = glfwCreateWindow(width, height, title, nullptr, shared);
+        if (!window)
+        {
+            std::cout << "ERROR::SECONDARY_WINDOW::CREATION_FAILED" << std::endl;
+            return false;
+        }
+        main = shared;
+        glfwMakeContextCurrent(window);
+        glfwSwapInterval(0);
+        glGenFramebuffers(1, &readFramebuffer);
+        glfwMakeContextCurrent(main);
+        return true;
+    }
+
+    bool open() const
+    {
+        return window && !glfwWindowShouldClose(window);
+    }
+
+    void framebufferSize(int &width, int &height) const
+    {
+        glfwGetFramebufferSize(window, &width, &height);
+    }
+
+    // scales the first width x height texels of texture to the window and swaps it
+    void present(unsigned int texture, int width, int height)
+    {
+        if (!open())
+            return;
+        GLsync rendered = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        glfwMakeContextCurrent(window);
+        glWaitSync(rendered, 0, GL_TIMEOUT_IGNORED);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+        if (texture != attached)
+        {
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+            attached = texture;
+        }
+        int windowWidth, windowHeight;
+        framebufferSize(windowWidth, windowHeight);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glfwSwapBuffers(window);
+        glfwMakeContextCurrent(main);
+        glDeleteSync(rendered);
+    }
+
+    void destroy()
+    {
+        if (!window)
+            return;
+        GLFWwindow *current = glfwGetCurrentContext();
+        glfwMakeContextCurrent(window);
+        glDeleteFramebuffers(1, &readFramebuffer);
+        glfwMakeContextCurrent(current);
+        glfwDestroyWindow(window);
+        window = nullptr;
+        readFramebuffer = 0;
+        attached = 0;
+    }
+
+  private:
+    GLFWwindow *main = nullptr;
+    unsigned int readFramebuffer = 0;
+    unsigned int attached = 0;
+};
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef OCEAN_H
+#define OCEAN_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "cdlod_grid.cpp"
+#include "frustum_culler.cpp"
+#include "ring_buffer.cpp"
+#include "shader.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Open water from a Tessendorf wave spectrum, evaluated and inverse transformed on the GPU
+// every frame, on a CDLOD grid that follows the camera (see cdlod_grid.cpp).
+// The constructor fills the initial spectrum h0(k) of a resolution x resolution patch of
+// patchSize world units once on the CPU: Phillips amplitudes for windSpeed along
+// windDirection, times gaussian noise from seed, scaled so the waves are waveHeight high
+// (the significant height, 4 standard deviations). update() is then fixed work whatever is
+// in view:
+// - ocean_spectrum.comp advances h0 to the time, by the deep water dispersion, and writes the
+//   height, the choppy displacements, the slopes and the displacements' derivatives as eight
+//   real fields. The fields have Hermitian spectra, so two share one complex channel pair:
+//   four complex fields in two RGBA32F images,
+// - ocean_fft.comp does one radix-2 Stockham butterfly stage along rows or columns, log2 of
+//   resolution stages each way, ping-ponging between two pairs of images,
+// - ocean_resolve.comp undoes the centered frequencies' sign and writes an RGBA16F
+//   displacement and an RGBA16F map of the slopes with the Jacobian of the displacement,
+//   whose fold below foamThreshold is foam; both get their mip chains.
+// ocean.vs moves the grid by the displacement at a level that matches the node's quads, and
+// ocean.fs shades with the slopes. The patch repeats across the whole surface.
+// The grid moves with the camera in steps of an eighth of its size. A step is a whole number
+// of vertex spacings at every level, so no vertex moves when it does. Needs GL 4.3.
+class Ocean
+{
+  public:
+    static const unsigned int DISPLACEMENT_UNIT = 2;
+    static const unsigned int SLOPE_UNIT = 3;
+    // local size of the compute passes in both dimensions
+    static const int GROUP_SIZE = 8;
+
+    float seaLevel = -6.0f;
+    // of the square the grid covers around the camera
+    float size = 4096.0f;
+    // of the repeating patch, in world units
+    float patchSize = 256.0f;
+    // horizontal displacement over the height's, 0 rounds the crests off
+    float choppiness = 1.2f;
+    // the Jacobian below which the surface folds into foam
+    float foamThreshold = 0.4f;
+    // towards the sun, for ocean.fs
+    glm::vec3 sunDirection = glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f));
+    CdlodGrid grid;
+
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    // resolution is rounded to a power of two from 16 to 512; spectrumProgram, fftProgram
+    // and resolveProgram are the compute passes, drawProgram ocean.vs with ocean.fs
+    Ocean(RingBuffer &ring, int resolution, Shader &spectrumProgram, Shader &fftProgram, Shader &resolveProgram,
+          Shader &drawProgram, float windSpeed = 12.0f, glm::vec2 windDirection = glm::vec2(1.0f, 0.3f),
+          float waveHeight = 2.0f, uint32_t seed = 1)
+        : grid(ring), spectrumProgram(spectrumProgram), fftProgram(fftProgram), resolveProgram(resolveProgram),
+          drawProgram(drawProgram), sampler(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_REPEAT, GL_REPEAT)
+    {
+        this->resolution = 16;
+        while (this->resolution < std::min(resolution, 512))
+            this->resolution *= 2;
+        int n = this->resolution;
+        spectrum.create(n, n, GL_RGBA32F, 1);
+        for (int i = 0; i < 2; i++)
+            for (int j = 0; j < 2; j++)
+                fields[i][j].create(n, n, GL_RGBA32F, 1);
+        displacement.create(n, n, GL_RGBA16F);
+        slopes.create(n, n, GL_RGBA16F);
+        buildSpectrum(windSpeed, windDirection, waveHeight, seed);
+
+        CdlodGrid::setup(drawProgram);
+        drawProgram.setInt("displacementMap", DISPLACEMENT_UNIT);
+        drawProgram.setInt("slopeMap", SLOPE_UNIT);
+        seaLevelLoc = drawProgram.uniform("seaLevel");
+        patchSizeLoc = drawProgram.uniform("patchSize");
+        morphRangesLoc = drawProgram.uniform("morphRanges");
+        sunDirectionLoc = drawProgram.uniform("sunDirection");
+        foamThresholdLoc = drawProgram.uniform("foamThreshold");
+        spectrumProgram.use();
+        timeLoc = spectrumProgram.uniform("time");
+        patchLoc = spectrumProgram.uniform("patchSize");
+        fftProgram.use();
+        stageLoc = fftProgram.uniform("stage");
+        verticalLoc = fftProgram.uniform("vertical");
+        resolveProgram.use();
+        choppinessLoc = resolveProgram.uniform("choppiness");
+    }
+
+    Ocean(const Ocean &) = delete;
+    Ocean &operator=(const Ocean &) = delete;
+
+    // the displacement and slopes at time, in seconds
+    void update(float time)
+    {
+        GLuint groups = (GLuint)(resolution / GROUP_SIZE);
+        spectrumProgram.use();
+        spectrumProgram.set(timeLoc, time);
+        spectrumProgram.set(patchLoc, patchSize);
+        glBindImageTexture(0, spectrum.ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+        glBindImageTexture(1, fields[0][0].ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+        glBindImageTexture(2, fields[0][1].ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+        glDispatchCompute(groups, groups, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        // the rows, then the columns; an even number of stages ends in the first pair again
+        fftProgram.use();
+        int stages = 0;
+        while ((1 << stages) < resolution)
+            stages++;
+        int from = 0;
+        for (int pass = 0; pass < 2 * stages; pass++)
+        {
+            fftProgram.set(stageLoc, pass % stages);
+            fftProgram.set(verticalLoc, pass >= stages);
+            glBindImageTexture(0, fields[from][0].ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+            glBindImageTexture(1, fields[from][1].ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+            glBindImageTexture(2, fields[from ^ 1][0].ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+            glBindImageTexture(3, fields[from ^ 1][1].ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+            // a butterfly per invocation, half the row's points wide
+            glDispatchCompute(std::max(groups / 2, 1u), groups, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            from ^= 1;
+        }
+
+        resolveProgram.use();
+        resolveProgram.set(choppinessLoc, choppiness);
+        glBindImageTexture(0, fields[from][0].ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+        glBindImageTexture(1, fields[from][1].ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+        glBindImageTexture(2, displacement.ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glBindImageTexture(3, slopes.ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glDispatchCompute(groups, groups, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+        displacement.generateMipmaps();
+        slopes.generateMipmaps();
+    }
+
+    // the nodes to draw from camera, around it
+    void select(const glm::vec3 &camera, const Frustum &frustum)
+    {
+        float step = size / 8.0f;
+        glm::vec2 center = glm::floor(glm::vec2(camera.x, camera.z) / step + 0.5f) * step;
+        // the waves rise and fall by about waveHeight around the sea level
+        grid.origin = glm::vec3(center.x - size * 0.5f, seaLevel - waveHeight, center.y - size * 0.5f);
+        grid.size = size;
+        grid.height = waveHeight * 2.0f;
+        grid.select(camera, frustum);
+    }
+
+    void draw()
+    {
+        if (grid.selected == 0)
+            return;
+        drawProgram.use();
+        drawProgram.set(seaLevelLoc, seaLevel);
+        drawProgram.set(patchSizeLoc, patchSize);
+        drawProgram.set(sunDirectionLoc, sunDirection);
+        drawProgram.set(foamThresholdLoc, foamThreshold);
+        displacement.bind(DISPLACEMENT_UNIT);
+        sampler.bind(DISPLACEMENT_UNIT);
+        slopes.bind(SLOPE_UNIT);
+        sampler.bind(SLOPE_UNIT);
+        grid.draw(drawProgram, morphRangesLoc);
+    }
+
+    int fftResolution() const
+    {
+        return resolution;
+    }
+
+  private:
+    Shader &spectrumProgram, &fftProgram, &resolveProgram, &drawProgram;
+    Sampler sampler;
+    int resolution;
+    float waveHeight = 2.0f;
+    // xy h0(k), zw the conjugate of h0(-k)
+    Texture2D spectrum;
+    // two ping-pong pairs of four complex fields each
+    Texture2D fields[2][2];
+    Texture2D displacement, slopes;
+    UniformHandle timeLoc, patchLoc, stageLoc, verticalLoc, choppinessLoc;
+    UniformHandle seaLevelLoc, patchSizeLoc, morphRangesLoc, sunDirectionLoc, foamThresholdLoc;
+
+    // the Phillips spectrum at frequency index (x, y), centered on resolution / 2
+    float phillips(int x, int y, float windSpeed, glm::vec2 wind) const
+    {
+        const float GRAVITY = 9.81f;
+        glm::vec2 k = glm::vec2((float)(x - resolution / 2), (float)(y - resolution / 2)) *
+                      (2.0f * 3.14159265f / patchSize);
+        float k2 = glm::dot(k, k);
+        if (k2 < 1e-8f)
+            return 0.0f;
+        // the largest wave the wind makes, and a thousandth of it where the small ones die off
+        float largest = windSpeed * windSpeed / GRAVITY;
+        float smallest = largest / 1000.0f;
+        float aligned = glm::dot(k / std::sqrt(k2), wind);
+        // waves against the wind are damped
+        float damping = aligned < 0.0f ? 0.07f : 1.0f;
+        return std::exp(-1.0f / (k2 * largest * largest)) / (k2 * k2) * aligned * aligned * damping *
+               std::exp(-k2 * smallest * smallest);
+    }
+
+    void buildSpectrum(float windSpeed, glm::vec2 windDirection, float height, uint32_t seed)
+    {
+        waveHeight = height;
+        int n = resolution;
+        glm::vec2 wind = glm::normalize(windDirection);
+        std::vector<float> amplitudes((size_t)n * n);
+        double total = 0.0;
+        for (int y = 0; y < n; y++)
+        {
+            for (int x = 0; x < n; x++)
+            {
+                amplitudes[(size_t)y * n + x] = phillips(x, y, windSpeed, wind);
+                total += amplitudes[(size_t)y * n + x];
+            }
+        }
+        // the variance of the height is the sum of the spectrum, 4 deviations are waveHeight
+        float scale = total > 0.0 ? (float)((height * 0.25) / std::sqrt(total)) : 0.0f;
+
+        std::mt19937 random(seed);
+        std::normal_distribution<float> gaussian(0.0f, 1.0f);
+        std::vector<glm::vec2> h0((size_t)n * n);
+        for (size_t i = 0; i < h0.size(); i++)
+        {
+            // the h0(k) and h0(-k) terms each carry half of it
+            float amplitude = std::sqrt(amplitudes[i] * 0.5f) * scale;
+            h0[i] = glm::vec2(gaussian(random), gaussian(random)) * (amplitude * 0.70710678f);
+        }
+        std::vector<glm::vec4> texels((size_t)n * n);
+        for (int y = 0; y < n; y++)
+        {
+            for (int x = 0; x < n; x++)
+            {
+                glm::vec2 opposite = h0[(size_t)((n - y) % n) * n + (n - x) % n];
+                texels[(size_t)y * n + x] = glm::vec4(h0[(size_t)y * n + x], opposite.x, -opposite.y);
+            }
+        }
+        spectrum.upload(0, GL_RGBA, GL_FLOAT, texels.data());
+    }
+};
+
+#endif
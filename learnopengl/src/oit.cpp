@@ -0,0 +1,143 @@
+#ifndef OIT_H
+#define OIT_H
+
+#include "glad/glad.h"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "render_stats.cpp"
+#include "shader.cpp"
+#include "texture.cpp"
+
+#include <iostream>
+
+// Weighted blended order-independent transparency (McGuire and Bavoil 2013). The
+// transparent draws go to two targets in any order, with depth testing against the frame's
+// depth texture but no depth writes:
+//   accumulation (RGBA16F, added up):   sum of premultiplied color * w and of alpha * w
+//   revealage    (R16F, multiplied):    product of (1 - alpha), how much of the opaque shows
+// w falls off with the view distance (scene.fs WEIGHTED_OIT), so nearer surfaces dominate.
+// composite() then lays accumulation.rgb / accumulation.a over the frame with 1 - revealage
+// as its alpha in one full screen pass. The result is an approximation of the sorted blend
+// that needs no per frame sort, opaque-looking layers and very different alphas in a stack
+// are where it differs most; --sorted-transparency keeps the back to front path to compare.
+class WeightedBlendedOIT
+{
+  public:
+    // texture units the composite reads from
+    static const unsigned int ACCUMULATION_UNIT = 0;
+    static const unsigned int REVEALAGE_UNIT = 1;
+
+    unsigned int FBO = 0;
+    Texture2D accumulation;
+    Texture2D revealage;
+    int width = 0, height = 0;
+
+    WeightedBlendedOIT(Shader &compositeShader) : compositeShader(compositeShader)
+    {
+        emptyVAO = createVertexArray();
+        compositeShader.use();
+        compositeShader.setInt("accumulation", ACCUMULATION_UNIT);
+        compositeShader.setInt("revealage", REVEALAGE_UNIT);
+    }
+
+    ~WeightedBlendedOIT()
+    {
+        if (FBO)
+            glDeleteFramebuffers(1, &FBO);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    WeightedBlendedOIT(const WeightedBlendedOIT &) = delete;
+    WeightedBlendedOIT &operator=(const WeightedBlendedOIT &) = delete;
+
+    // the two targets blend differently, glBlendFunci is GL 4.0
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_0 != 0;
+    }
+
+    // (re)creates the targets when the size or the depth texture changed, false when incomplete
+    bool resize(int w, int h, const Texture2D &depth)
+    {
+        if (w <= 0 || h <= 0)
+            return false;
+        if (FBO && w == width && h == height && depth.ID == depthID)
+            return true;
+        width = w;
+        height = h;
+        depthID = depth.ID;
+        accumulation.create(width, height, GL_RGBA16F, 1, GPU_MEMORY_RENDER_TARGETS);
+        revealage.create(width, height, GL_R16F, 1, GPU_MEMORY_RENDER_TARGETS);
+
+        if (!FBO)
+            FBO = createFramebuffer();
+        const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        GLenum status;
+        if (hasDSA())
+        {
+            glNamedFramebufferTexture(FBO, GL_COLOR_ATTACHMENT0, accumulation.ID, 0);
+            glNamedFramebufferTexture(FBO, GL_COLOR_ATTACHMENT1, revealage.ID, 0);
+            glNamedFramebufferTexture(FBO, GL_DEPTH_ATTACHMENT, depthID, 0);
+            glNamedFramebufferDrawBuffers(FBO, 2, drawBuffers);
+            status = glCheckNamedFramebufferStatus(FBO, GL_FRAMEBUFFER);
+        }
+        else
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulation.ID, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, revealage.ID, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthID, 0);
+            glDrawBuffers(2, drawBuffers);
+            status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::OIT::INCOMPLETE: 0x" << std::hex << status << std::dec << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    // binds the cleared targets with their blending, the transparent draws follow
+    void begin()
+    {
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &frameFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        const float zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        const float one[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glClearBufferfv(GL_COLOR, 0, zero);
+        glClearBufferfv(GL_COLOR, 1, one);
+        glState.enable(GL_BLEND);
+        glState.setBlendFunci(0, GL_ONE, GL_ONE);
+        glState.setBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+        glState.setDepthMask(false);
+    }
+
+    // back to the frame's framebuffer and the sums composited over it
+    void composite()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)frameFBO);
+        accumulation.bind(ACCUMULATION_UNIT);
+        revealage.bind(REVEALAGE_UNIT);
+        glState.disable(GL_DEPTH_TEST);
+        // the alpha blending everything else expects, composite.fs outputs 1 - revealage as alpha
+        glState.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        compositeShader.use();
+        glState.bindVertexArray(emptyVAO);
+        renderStats.countDraw(3);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glState.disable(GL_BLEND);
+        glState.enable(GL_DEPTH_TEST);
+        glState.setDepthMask(true);
+    }
+
+  private:
+    Shader &compositeShader;
+    unsigned int emptyVAO = 0;
+    unsigned int depthID = 0;
+    GLint frameFBO = 0;
+};
+
+#endif
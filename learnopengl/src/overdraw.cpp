@@ -0,0 +1,119 @@
+#ifndef OVERDRAW_H
+#define OVERDRAW_H
+
+#include "glad/glad.h"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "render_stats.cpp"
+#include "shader.cpp"
+#include "texture.cpp"
+
+#include <iostream>
+
+// Overdraw heatmap: the draws between begin() and composite() go again, with a program that
+// outputs 1 (overdraw.fs), to an R16F target with additive blending and neither depth test nor
+// depth writes, so each texel ends up with the number of fragments rasterized over it.
+// composite() then replaces the frame with those counts on a color ramp (overdraw_heatmap.fs),
+// black for none through blue, green, yellow and red up to white at maxOverdraw and above.
+// Fragments the prepass or early depth would have spared are counted too: it shows how much
+// the geometry piles up per pixel, what sorting and culling can win back.
+class OverdrawView
+{
+  public:
+    // texture unit the composite reads the counts from
+    static const unsigned int COUNT_UNIT = 0;
+
+    unsigned int FBO = 0;
+    Texture2D counts;
+    int width = 0, height = 0;
+    // fragments per pixel the ramp ends at
+    float maxOverdraw = 16.0f;
+
+    OverdrawView(Shader &heatmapShader) : heatmapShader(heatmapShader)
+    {
+        emptyVAO = createVertexArray();
+        heatmapShader.use();
+        heatmapShader.setInt("counts", COUNT_UNIT);
+    }
+
+    ~OverdrawView()
+    {
+        if (FBO)
+            glDeleteFramebuffers(1, &FBO);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    OverdrawView(const OverdrawView &) = delete;
+    OverdrawView &operator=(const OverdrawView &) = delete;
+
+    // (re)creates the target when the size changed, false when incomplete
+    bool resize(int w, int h)
+    {
+        if (w <= 0 || h <= 0)
+            return false;
+        if (FBO && w == width && h == height)
+            return true;
+        width = w;
+        height = h;
+        // half floats count exactly up to 2048, far more than the ramp shows
+        counts.create(width, height, GL_R16F, 1, GPU_MEMORY_RENDER_TARGETS);
+
+        if (!FBO)
+            FBO = createFramebuffer();
+        GLenum status;
+        if (hasDSA())
+        {
+            glNamedFramebufferTexture(FBO, GL_COLOR_ATTACHMENT0, counts.ID, 0);
+            status = glCheckNamedFramebufferStatus(FBO, GL_FRAMEBUFFER);
+        }
+        else
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, counts.ID, 0);
+            status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::OVERDRAW::INCOMPLETE: 0x" << std::hex << status << std::dec << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    // binds the cleared counts with additive blending, the draws to count follow
+    void begin()
+    {
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &frameFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        const float zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, zero);
+        glState.enable(GL_BLEND);
+        glState.setBlendFunc(GL_ONE, GL_ONE);
+        glState.disable(GL_DEPTH_TEST);
+        glState.setDepthMask(false);
+    }
+
+    // back to the frame's framebuffer and the counts drawn over it as a heatmap
+    void composite()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)frameFBO);
+        glState.disable(GL_BLEND);
+        counts.bind(COUNT_UNIT);
+        heatmapShader.use();
+        heatmapShader.setFloat("maxOverdraw", maxOverdraw);
+        glState.bindVertexArray(emptyVAO);
+        renderStats.countDraw(3);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glState.enable(GL_DEPTH_TEST);
+        glState.setDepthMask(true);
+    }
+
+  private:
+    Shader &heatmapShader;
+    unsigned int emptyVAO = 0;
+    GLint frameFBO = 0;
+};
+
+#endif
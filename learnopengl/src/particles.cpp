@@ -0,0 +1,223 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "render_stats.cpp"
+#include "shader.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Mirrors the std430 ParticleCounters block in shader_src/particles.glsl
+struct ParticleCounters
+{
+    // glDispatchComputeIndirect arguments of the simulate pass
+    uint32_t simulateGroups[3];
+    int32_t deadCount;
+    // a DrawArraysIndirectCommand per alive list: 4 vertices, the list's length in instances
+    uint32_t aliveDraws[2][4];
+};
+
+// Particles that live on the GPU only. The state is a structure of arrays in storage
+// buffers (a position and life, a velocity and starting life per slot) with a stack of the
+// free slots and two lists of the live ones, and every frame is three compute passes and a
+// draw the CPU only issues:
+// - particle_emit.comp pops a slot off the dead list per particle to emit, an atomicAdd on
+//   the dead count that gives the slot back when there was none, and appends it to this
+//   frame's alive list with another atomicAdd,
+// - particle_prepare.comp (one invocation) turns that list's length into the simulate
+//   dispatch and empties the other list,
+// - particle_simulate.comp, dispatched indirectly, ages and moves each live particle and
+//   appends it to the other list or pushes its slot back on the dead list, so the live
+//   particles stay packed at the front without ever being sorted,
+// - the list it wrote is drawn as camera facing quads by glDrawArraysIndirect, its length
+//   being the instance count of the command (particle.vs, particle.fs).
+// The lists swap every frame. Nothing is read back, so the CPU cost is the same for any count.
+// Needs GL 4.3 for the compute passes and storage blocks in the vertex stage.
+class ParticleSystem
+{
+  public:
+    // shader storage bindings, the same as in particles.glsl; the indirect renderer's, which
+    // binds its own before each of its passes
+    static const unsigned int POSITION_BINDING = 2;
+    static const unsigned int VELOCITY_BINDING = 3;
+    static const unsigned int DEAD_BINDING = 4;
+    static const unsigned int ALIVE_BINDING = 5;
+    static const unsigned int COUNTER_BINDING = 6;
+    // local_size_x of the emit and simulate passes
+    static const unsigned int GROUP_SIZE = 64;
+
+    // particles per second, at most a capacity per frame
+    float emitRate = 0.0f;
+    // where particles start, within emitterRadius, and how fast they leave
+    glm::vec3 emitter = glm::vec3(0.0f);
+    float emitterRadius = 0.1f;
+    glm::vec3 velocity = glm::vec3(0.0f, 6.0f, 0.0f);
+    float velocitySpread = 2.0f;
+    float minLife = 2.0f, maxLife = 4.0f;
+    glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+    // velocity kept after a second
+    float drag = 0.8f;
+    float floorHeight = -5.0f;
+    // half the quad's size in world units
+    float particleSize = 0.03f;
+    glm::vec4 startColor = glm::vec4(1.0f, 0.8f, 0.4f, 1.0f);
+    glm::vec4 endColor = glm::vec4(0.8f, 0.1f, 0.05f, 0.0f);
+
+    static bool isSupported()
+    {
+        if (!GLAD_GL_VERSION_4_3)
+            return false;
+        GLint blocks = 0;
+        glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &blocks);
+        return blocks >= 4;
+    }
+
+    ParticleSystem(unsigned int capacity, Shader &emitProgram, Shader &prepareProgram, Shader &simulateProgram,
+                   Shader &drawProgram)
+        : capacity(capacity), emitShader(emitProgram), prepareShader(prepareProgram),
+          simulateShader(simulateProgram), drawShader(drawProgram)
+    {
+        positions = createBuffer((size_t)capacity * sizeof(glm::vec4), NULL, 0);
+        velocities = createBuffer((size_t)capacity * sizeof(glm::vec4), NULL, 0);
+        alive = createBuffer((size_t)capacity * 2 * sizeof(uint32_t), NULL, 0);
+        // every slot starts out dead
+        std::vector<uint32_t> slots(capacity);
+        for (unsigned int i = 0; i < capacity; i++)
+            slots[i] = capacity - 1 - i;
+        dead = createBuffer(slots.size() * sizeof(uint32_t), slots.data(), 0);
+        ParticleCounters counters = {{0, 1, 1}, (int32_t)capacity, {{4, 0, 0, 0}, {4, 0, 0, 0}}};
+        counterBuffer = createBuffer(sizeof(counters), &counters, 0);
+        emptyVAO = createVertexArray();
+
+        for (Shader *program : {&emitShader, &prepareShader, &simulateShader, &drawShader})
+        {
+            program->use();
+            program->set(program->uniform("capacity"), capacity);
+        }
+        emitListLoc = emitShader.uniform("list");
+        emitCountLoc = emitShader.uniform("emitCount");
+        seedLoc = emitShader.uniform("seed");
+        emitterLoc = emitShader.uniform("emitter");
+        velocityLoc = emitShader.uniform("velocity");
+        lifeLoc = emitShader.uniform("life");
+        prepareListLoc = prepareShader.uniform("list");
+        simulateListLoc = simulateShader.uniform("list");
+        deltaTimeLoc = simulateShader.uniform("deltaTime");
+        gravityLoc = simulateShader.uniform("gravity");
+        dragLoc = simulateShader.uniform("drag");
+        floorLoc = simulateShader.uniform("floorHeight");
+        drawListLoc = drawShader.uniform("list");
+        sizeLoc = drawShader.uniform("particleSize");
+        startColorLoc = drawShader.uniform("startColor");
+        endColorLoc = drawShader.uniform("endColor");
+    }
+
+    ~ParticleSystem()
+    {
+        deleteBuffers(1, &positions);
+        deleteBuffers(1, &velocities);
+        deleteBuffers(1, &dead);
+        deleteBuffers(1, &alive);
+        deleteBuffers(1, &counterBuffer);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    ParticleSystem(const ParticleSystem &) = delete;
+    ParticleSystem &operator=(const ParticleSystem &) = delete;
+
+    // emits what deltaTime is worth of emitRate and simulates over deltaTime
+    void update(float deltaTime)
+    {
+        // the fraction of a particle left over carries into the next frame
+        emitBacklog = std::min(emitBacklog + emitRate * deltaTime, (float)capacity);
+        unsigned int emitCount = (unsigned int)emitBacklog;
+        emitBacklog -= (float)emitCount;
+        frame++;
+
+        bindBuffers();
+        if (emitCount > 0)
+        {
+            emitShader.use();
+            emitShader.set(emitListLoc, list);
+            emitShader.set(emitCountLoc, emitCount);
+            emitShader.set(seedLoc, frame * 0x9E3779B9u);
+            emitShader.set(emitterLoc, glm::vec4(emitter, emitterRadius));
+            emitShader.set(velocityLoc, glm::vec4(velocity, velocitySpread));
+            emitShader.set(lifeLoc, glm::vec2(minLife, maxLife));
+            glDispatchCompute((emitCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
+        prepareShader.use();
+        prepareShader.set(prepareListLoc, list);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        simulateShader.use();
+        simulateShader.set(simulateListLoc, list);
+        simulateShader.set(deltaTimeLoc, deltaTime);
+        simulateShader.set(gravityLoc, gravity);
+        simulateShader.set(dragLoc, drag);
+        simulateShader.set(floorLoc, floorHeight);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, counterBuffer);
+        glDispatchComputeIndirect(0);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+        list ^= 1;
+    }
+
+    // the particles update() left alive, blended over the frame's depth without writing it
+    void draw()
+    {
+        bindBuffers();
+        glState.bindVertexArray(emptyVAO);
+        drawShader.use();
+        drawShader.set(drawListLoc, list);
+        drawShader.set(sizeLoc, particleSize);
+        drawShader.set(startColorLoc, startColor);
+        drawShader.set(endColorLoc, endColor);
+        glState.enable(GL_BLEND);
+        glState.setBlendFunc(GL_ONE, GL_ONE);
+        glState.setDepthMask(false);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, counterBuffer);
+        // the instance count is only known on the GPU
+        renderStats.countDraw(0);
+        glDrawArraysIndirect(GL_TRIANGLE_STRIP, (const void *)(offsetof(ParticleCounters, aliveDraws) +
+                                                               list * sizeof(uint32_t[4])));
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glState.setDepthMask(true);
+        glState.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glState.disable(GL_BLEND);
+    }
+
+  private:
+    unsigned int capacity;
+    Shader &emitShader, &prepareShader, &simulateShader, &drawShader;
+    unsigned int positions = 0, velocities = 0, dead = 0, alive = 0, counterBuffer = 0;
+    unsigned int emptyVAO = 0;
+    // the alive list the next pass reads
+    unsigned int list = 0;
+    unsigned int frame = 0;
+    float emitBacklog = 0.0f;
+    UniformHandle emitListLoc, emitCountLoc, seedLoc, emitterLoc, velocityLoc, lifeLoc;
+    UniformHandle prepareListLoc, simulateListLoc, deltaTimeLoc, gravityLoc, dragLoc, floorLoc;
+    UniformHandle drawListLoc, sizeLoc, startColorLoc, endColorLoc;
+
+    void bindBuffers()
+    {
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, POSITION_BINDING, positions, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, VELOCITY_BINDING, velocities, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, DEAD_BINDING, dead, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, ALIVE_BINDING, alive, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, COUNTER_BINDING, counterBuffer, 0, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef PATH_CALIBRATION_H
+#define PATH_CALIBRATION_H
+
+#include "glad/glad.h"
+
+#include "benchmark.cpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// one way of drawing the cubes, the renderer settings that pick it
+struct RendererPath
+{
+    const char *name;
+    bool indirect;
+    bool gpuCulling;
+    bool instanced;
+    bool bindless;
+};
+
+// every path the calibration races, the fastest of them is what the renderer starts with
+inline const std::vector<RendererPath> &rendererPaths()
+{
+    static const std::vector<RendererPath> paths = {
+        {"per draw", false, false, false, false},  {"instanced", false, false, true, false},
+        {"bindless", false, false, true, true},    {"indirect", true, false, false, false},
+        {"gpu culling", true, true, false, false},
+    };
+    return paths;
+}
+
+inline const RendererPath *findRendererPath(const std::string &name)
+{
+    for (const RendererPath &path : rendererPaths())
+        if (name == path.name)
+            return &path;
+    return NULL;
+}
+
+// The renderer path measured fastest on each GPU and driver, in a text file of one
+// "path<TAB>renderer" line per GPU the program ran on. The renderer is GL_RENDERER and
+// GL_VERSION, whose text carries the driver's version, so a driver update runs the
+// calibration again. Which path wins is what the short benchmarks of main.cpp's
+// selectRendererPath() say, by the slower of the CPU and the GPU frame times.
+class PathCalibration
+{
+  public:
+    std::string path;
+
+    PathCalibration(const std::string &path = "cache/renderer_path.txt") : path(path)
+    {
+    }
+
+    // of the current context
+    static std::string rendererKey()
+    {
+        const char *renderer = (const char *)glGetString(GL_RENDERER);
+        const char *version = (const char *)glGetString(GL_VERSION);
+        return std::string(renderer ? renderer : "unknown") + ", " + (version ? version : "unknown");
+    }
+
+    // the path stored for renderer, NULL before its calibration
+    const RendererPath *find(const std::string &renderer) const
+    {
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            size_t tab = line.find('\t');
+            if (tab != std::string::npos && line.compare(tab + 1, std::string::npos, renderer) == 0)
+                return findRendererPath(line.substr(0, tab));
+        }
+        return NULL;
+    }
+
+    // stores chosen for renderer in place of what it had, written aside and renamed
+    bool store(const std::string &renderer, const RendererPath &chosen) const
+    {
+        std::vector<std::string> lines;
+        {
+            std::ifstream file(path);
+            std::string line;
+            while (std::getline(file, line))
+            {
+                size_t tab = line.find('\t');
+                if (tab != std::string::npos && line.compare(tab + 1, std::string::npos, renderer) != 0)
+                    lines.push_back(line);
+            }
+        }
+        lines.push_back(std::string(chosen.name) + "\t" + renderer);
+
+        std::error_code error;
+        std::filesystem::path parent = std::filesystem::path(path).parent_path();
+        if (!parent.empty())
+            std::filesystem::create_directories(parent, error);
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::trunc);
+            for (const std::string &line : lines)
+                file << line << '\n';
+            if (!file)
+            {
+                std::cout << "ERROR::PATH_CALIBRATION::COULD_NOT_WRITE: " << path << '\n';
+                return false;
+            }
+        }
+        std::filesystem::rename(temporary, path, error);
+        if (error)
+        {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+        return true;
+    }
+
+    // the frame time a path is ranked by, GPU times are missing without timer queries
+    static float frameMs(const BenchmarkResult &result)
+    {
+        return std::max(result.cpuMs, result.gpuMs);
+    }
+};
+
+#endif
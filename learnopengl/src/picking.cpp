@@ -0,0 +1,238 @@
+#ifndef PICKING_H
+#define PICKING_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "frustum_culler.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "mesh.cpp"
+#include "shader.cpp"
+
+#include <cstdint>
+#include <iostream>
+
+// Object selection on the GPU: the objects around a point of the view are drawn into a small
+// R32UI target with their id + 1 (pick.vs, pick.fs), 0 where there is nothing, and the
+// REGION x REGION ids are copied into a pixel pack buffer by glReadPixels, which with a
+// buffer bound only queues the copy. A fence goes in behind it and poll() maps the buffer
+// once the fence has signaled, a frame or more later, so nothing ever waits for the GPU.
+// The region is the view's projection narrowed to those pixels (like gluPickMatrix), its
+// frustum() is for culling the objects to draw to the few near the point. FRAMES read backs
+// can be in flight, begin() skips the frame while all of them are.
+class GpuPicker
+{
+  public:
+    static const int REGION = 8;
+    static const unsigned int FRAMES = 3;
+
+    // GL_LESS, or GL_GREATER with reversed Z
+    GLenum depthFunc = GL_LESS;
+
+    // the latest result: the id under the point, or nearest to it within the region
+    bool picked = false;
+    uint32_t object = 0;
+    // frames from the draw to the result
+    unsigned int latency = 0;
+
+    GpuPicker(Shader &program) : program(program)
+    {
+        viewProjectionLoc = program.uniform("regionViewProjection");
+        modelLoc = program.uniform("model");
+        boundsCenterLoc = program.uniform("boundsCenter");
+        boundsExtentLoc = program.uniform("boundsExtent");
+        idLoc = program.uniform("id");
+
+        GLenum status;
+        if (hasDSA())
+        {
+            glCreateFramebuffers(1, &FBO);
+            glCreateRenderbuffers(1, &ids);
+            glCreateRenderbuffers(1, &depth);
+            glNamedRenderbufferStorage(ids, GL_R32UI, REGION, REGION);
+            glNamedRenderbufferStorage(depth, GL_DEPTH_COMPONENT32F, REGION, REGION);
+            glNamedFramebufferRenderbuffer(FBO, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, ids);
+            glNamedFramebufferRenderbuffer(FBO, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+            status = glCheckNamedFramebufferStatus(FBO, GL_FRAMEBUFFER);
+        }
+        else
+        {
+            glGenFramebuffers(1, &FBO);
+            glGenRenderbuffers(1, &ids);
+            glGenRenderbuffers(1, &depth);
+            glBindRenderbuffer(GL_RENDERBUFFER, ids);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, REGION, REGION);
+            glBindRenderbuffer(GL_RENDERBUFFER, depth);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, REGION, REGION);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, ids);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+            status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        complete = status == GL_FRAMEBUFFER_COMPLETE;
+        if (!complete)
+            std::cout << "ERROR::GPU_PICKER::INCOMPLETE: 0x" << std::hex << status << std::dec << '\n';
+        for (unsigned int i = 0; i < FRAMES; i++)
+            buffers[i] = createBuffer(sizeof(uint32_t) * REGION * REGION, NULL, GL_MAP_READ_BIT, GL_STREAM_READ);
+    }
+
+    ~GpuPicker()
+    {
+        for (unsigned int i = 0; i < FRAMES; i++)
+        {
+            if (fences[i])
+                glDeleteSync(fences[i]);
+        }
+        deleteBuffers(FRAMES, buffers);
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteRenderbuffers(1, &ids);
+        glDeleteRenderbuffers(1, &depth);
+    }
+
+    GpuPicker(const GpuPicker &) = delete;
+    GpuPicker &operator=(const GpuPicker &) = delete;
+
+    // viewProjection narrowed to the REGION pixels around (x, y) of a width x height view,
+    // in pixels from the bottom left, the point is kept far enough inside for the whole region
+    static glm::mat4 regionMatrix(const glm::mat4 &viewProjection, float x, float y, int width, int height)
+    {
+        x = glm::clamp(x, REGION * 0.5f, glm::max(REGION * 0.5f, width - REGION * 0.5f));
+        y = glm::clamp(y, REGION * 0.5f, glm::max(REGION * 0.5f, height - REGION * 0.5f));
+        glm::vec3 center(x * 2.0f / width - 1.0f, y * 2.0f / height - 1.0f, 0.0f);
+        glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::vec3((float)width / REGION, (float)height / REGION, 1.0f));
+        return scale * glm::translate(glm::mat4(1.0f), -center) * viewProjection;
+    }
+
+    // starts a pick around (x, y), false when every read back is still in flight;
+    // remembers the target and viewport end() puts back
+    bool begin(const glm::mat4 &viewProjection, float x, float y, int width, int height)
+    {
+        if (!complete)
+            return false;
+        unsigned int next = (current + 1) % FRAMES;
+        if (fences[next])
+            return false;
+        current = next;
+        regionViewProjection = regionMatrix(viewProjection, x, y, width, height);
+        regionFrustum = Frustum(regionViewProjection);
+
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &savedFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, REGION, REGION);
+        const GLuint none[4] = {0, 0, 0, 0};
+        glClearBufferuiv(GL_COLOR, 0, none);
+        const float farthest = depthFunc == GL_GREATER ? 0.0f : 1.0f;
+        glClearBufferfv(GL_DEPTH, 0, &farthest);
+        glState.enable(GL_DEPTH_TEST);
+        glState.setDepthMask(true);
+        glState.setDepthFunc(depthFunc);
+        glState.disable(GL_BLEND);
+        program.use();
+        program.set(viewProjectionLoc, regionViewProjection);
+        meshBounds = NULL;
+        return true;
+    }
+
+    // the region's view, for culling what is drawn
+    const Frustum &frustum() const
+    {
+        return regionFrustum;
+    }
+
+    // one object between begin() and end(), id is what poll() reports for it
+    void draw(const Mesh &mesh, const glm::mat4 &model, uint32_t id)
+    {
+        if (meshBounds != &mesh)
+        {
+            program.set(boundsCenterLoc, mesh.boundsCenter);
+            program.set(boundsExtentLoc, mesh.boundsExtent);
+            mesh.bind();
+            meshBounds = &mesh;
+        }
+        program.set(modelLoc, model);
+        program.set(idLoc, id + 1u);
+        mesh.draw();
+    }
+
+    // queues the copy of the ids and its fence
+    void end()
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[current]);
+        glReadPixels(0, 0, REGION, REGION, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        submitted[current] = frame;
+        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)savedFramebuffer);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+    }
+
+    // once per frame before begin(): takes the finished read backs, oldest first, without
+    // waiting; true when picked and object changed to a newer result
+    bool poll()
+    {
+        frame++;
+        bool updated = false;
+        for (unsigned int k = 1; k <= FRAMES; k++)
+        {
+            unsigned int i = (current + k) % FRAMES;
+            if (!fences[i])
+                continue;
+            GLenum state = glClientWaitSync(fences[i], 0, 0);
+            if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(fences[i]);
+            fences[i] = NULL;
+            collect(i);
+            updated = true;
+        }
+        return updated;
+    }
+
+  private:
+    Shader &program;
+    UniformHandle viewProjectionLoc, modelLoc, boundsCenterLoc, boundsExtentLoc, idLoc;
+    unsigned int FBO = 0, ids = 0, depth = 0;
+    bool complete = false;
+    unsigned int buffers[FRAMES] = {};
+    GLsync fences[FRAMES] = {};
+    unsigned int submitted[FRAMES] = {};
+    unsigned int current = 0, frame = 0;
+    glm::mat4 regionViewProjection = glm::mat4(1.0f);
+    Frustum regionFrustum;
+    const Mesh *meshBounds = NULL;
+    GLint savedFramebuffer = 0;
+    GLint savedViewport[4] = {};
+
+    void collect(unsigned int index)
+    {
+        const uint32_t *pixels =
+            (const uint32_t *)mapBuffer(buffers[index], 0, sizeof(uint32_t) * REGION * REGION, GL_MAP_READ_BIT);
+        if (!pixels)
+            return;
+        // the id at the middle of the region, or the one nearest to it
+        picked = false;
+        float nearest = 1e30f;
+        for (int y = 0; y < REGION; y++)
+        {
+            for (int x = 0; x < REGION; x++)
+            {
+                uint32_t id = pixels[y * REGION + x];
+                float dx = x + 0.5f - REGION * 0.5f, dy = y + 0.5f - REGION * 0.5f;
+                if (id == 0 || dx * dx + dy * dy >= nearest)
+                    continue;
+                nearest = dx * dx + dy * dy;
+                object = id - 1;
+                picked = true;
+            }
+        }
+        unmapBuffer(buffers[index]);
+        latency = frame - submitted[index];
+    }
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef PIPELINE_STATE_H
+#define PIPELINE_STATE_H
+
+#include "glad/glad.h"
+
+#include "gl_state.cpp"
+#include "shader.cpp"
+
+#include <vector>
+
+// The thin render interface draws are recorded against, shaped after Vulkan so another
+// backend can take the same recordings: a PipelineState is everything fixed about a kind
+// of draw, a BindingTable the resources it reads (a descriptor set), and a CommandStream
+// (command_stream.cpp) the command buffer both are bound in, recordable on any thread.
+// Both objects are built once and referenced by the commands, so they have to outlive
+// every stream that binds them.
+// The GL backend is applyPipelineState() / applyBindingTable() at replay: one pass over the
+// baked fields against the GLStateCache, which only passes on what differs from the last draw.
+
+// program, vertex input and fixed function state of a draw
+struct PipelineState
+{
+    // finished and bound by use() at replay, so hot reloads and separable pipelines just work
+    Shader *shader = NULL;
+    unsigned int vertexArray = 0;
+    bool depthTest = true;
+    bool depthWrite = true;
+    GLenum depthFunc = GL_LESS;
+    bool blend = false;
+    GLenum blendSource = GL_SRC_ALPHA;
+    GLenum blendDestination = GL_ONE_MINUS_SRC_ALPHA;
+    bool cullFace = false;
+};
+
+// textures with their samplers and buffer ranges, each at its binding point
+struct BindingTable
+{
+    struct TextureBinding
+    {
+        unsigned int unit;
+        GLenum target;
+        unsigned int texture;
+        unsigned int sampler;
+    };
+    struct BufferBinding
+    {
+        // GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER
+        GLenum target;
+        unsigned int index;
+        unsigned int buffer;
+        GLintptr offset;
+        // 0 for the whole buffer
+        GLsizeiptr size;
+    };
+
+    std::vector<TextureBinding> textures;
+    std::vector<BufferBinding> buffers;
+
+    BindingTable &texture(unsigned int unit, GLenum target, unsigned int texture, unsigned int sampler = 0)
+    {
+        textures.push_back({unit, target, texture, sampler});
+        return *this;
+    }
+
+    BindingTable &uniformBuffer(unsigned int index, unsigned int buffer, GLintptr offset = 0, GLsizeiptr size = 0)
+    {
+        buffers.push_back({GL_UNIFORM_BUFFER, index, buffer, offset, size});
+        return *this;
+    }
+
+    BindingTable &storageBuffer(unsigned int index, unsigned int buffer, GLintptr offset = 0, GLsizeiptr size = 0)
+    {
+        buffers.push_back({GL_SHADER_STORAGE_BUFFER, index, buffer, offset, size});
+        return *this;
+    }
+};
+
+// GL thread only
+inline void applyPipelineState(const PipelineState &state)
+{
+    if (state.shader)
+        state.shader->use();
+    glState.bindVertexArray(state.vertexArray);
+    glState.setCapability(GL_DEPTH_TEST, state.depthTest);
+    glState.setDepthMask(state.depthWrite);
+    glState.setDepthFunc(state.depthFunc);
+    glState.setCapability(GL_BLEND, state.blend);
+    if (state.blend)
+        glState.setBlendFunc(state.blendSource, state.blendDestination);
+    glState.setCapability(GL_CULL_FACE, state.cullFace);
+}
+
+inline void applyBindingTable(const BindingTable &table)
+{
+    for (const BindingTable::TextureBinding &binding : table.textures)
+    {
+        glState.bindTexture(binding.unit, binding.target, binding.texture);
+        glState.bindSampler(binding.unit, binding.sampler);
+    }
+    for (const BindingTable::BufferBinding &binding : table.buffers)
+        glState.bindBufferRange(binding.target, binding.index, binding.buffer, binding.offset, binding.size);
+}
+
+#endif
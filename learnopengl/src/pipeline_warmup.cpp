@@ -0,0 +1,352 @@
+#ifndef PIPELINE_WARMUP_H
+#define PIPELINE_WARMUP_H
+
+#include "glad/glad.h"
+
+#include "asset_pack.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "hash.cpp"
+#include "render_stats.cpp"
+#include "render_target.cpp"
+#include "shader.cpp"
+#include "shader_compiler.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Drivers tend to finish a program for the vertex layout and fixed function state it is drawn
+// with on its first draw, so the first frame showing something new hitches. While recording,
+// every countDraw() notes the program, vertex layout and depth, blend and cull state of the
+// draw (through RenderStats::drawHook, only the combinations not seen yet cost more than a
+// lookup) and save() merges them into the list the earlier runs left in cache/pipelines.bin.
+// The next run's warm() draws one triangle per listed combination into a 1x1 target, within
+// a budget per call, so the loading frames pay for the driver's work before the first real
+// draw needs it. Programs are found again by Shader::identity() among the compiler's; a
+// combination whose program no longer exists is dropped, one still compiling is waited for.
+class PipelineWarmup
+{
+  public:
+    std::string path = "cache/pipelines.bin";
+    // combinations drawn by warm() so far
+    size_t warmed = 0;
+
+    PipelineWarmup() = default;
+
+    ~PipelineWarmup()
+    {
+        stopRecording();
+        for (const auto &entry : vertexArrays)
+            glDeleteVertexArrays(1, &entry.second);
+        if (buffer)
+            deleteBuffers(1, &buffer);
+    }
+
+    PipelineWarmup(const PipelineWarmup &) = delete;
+    PipelineWarmup &operator=(const PipelineWarmup &) = delete;
+
+    // the list of the earlier runs, false when there is none
+    bool load()
+    {
+        std::vector<unsigned char> bytes;
+        if (!readFileContents(path, bytes) || bytes.size() < 8 || std::memcmp(bytes.data(), "PSOW", 4) != 0)
+            return false;
+        uint32_t count = 0;
+        std::memcpy(&count, bytes.data() + 4, 4);
+        size_t offset = 8;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            Combination combination;
+            if (!decode(bytes, offset, combination))
+            {
+                std::cout << "ERROR::PIPELINE_WARMUP::CORRUPT: " << path << '\n';
+                listed.clear();
+                return false;
+            }
+            listed.push_back(combination);
+        }
+        return true;
+    }
+
+    // the draws from now on, on the GL thread; one recorder at a time
+    void startRecording()
+    {
+        recorder = this;
+        renderStats.drawHook = [] { recorder->record(); };
+    }
+
+    void stopRecording()
+    {
+        if (recorder != this)
+            return;
+        renderStats.drawHook = NULL;
+        recorder = NULL;
+    }
+
+    // the draw about to be issued
+    void record()
+    {
+        GLStateCache::DrawState state = glState.drawState();
+        Draw draw = {state.program ? state.program : state.pipeline,
+                     state.program == 0,
+                     state.vertexArray,
+                     state.depthTest,
+                     state.depthWrite,
+                     state.blend,
+                     state.cullFace,
+                     state.depthFunc,
+                     state.blendSource,
+                     state.blendDestination};
+        if (draw.program == 0 || !seen.insert(fnv1a64((const char *)&draw, sizeof(draw))).second)
+            return;
+        // bound right now, so its layout is read back from the driver once
+        auto layout = layouts.find(draw.vertexArray);
+        if (layout == layouts.end())
+            layout = layouts.emplace(draw.vertexArray, readLayout()).first;
+        draws.push_back({draw, layout->second});
+    }
+
+    // this run's combinations and the listed ones in path, for the next run
+    bool save(const ShaderCompiler &compiler) const
+    {
+        std::string body;
+        std::unordered_set<uint64_t> written;
+        uint32_t count = 0;
+        auto add = [&](const Combination &combination) {
+            std::string record = encode(combination);
+            if (written.insert(fnv1a64(record.data(), record.size())).second)
+            {
+                body += record;
+                count++;
+            }
+        };
+        for (const Recorded &recorded : draws)
+        {
+            Shader *shader = compiler.findID(recorded.draw.program, recorded.draw.pipeline);
+            if (!shader)
+                continue;
+            const Draw &draw = recorded.draw;
+            add({shader->identity(), draw.depthTest != 0, draw.depthWrite != 0, draw.blend != 0, draw.cullFace != 0,
+                 draw.depthFunc, draw.blendSource, draw.blendDestination, recorded.layout});
+        }
+        // programs a run didn't get to stay listed for the ones that do
+        for (const Combination &combination : listed)
+            add(combination);
+
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                std::cout << "ERROR::PIPELINE_WARMUP::COULD_NOT_WRITE: " << path << '\n';
+                return false;
+            }
+            file.write("PSOW", 4);
+            file.write((const char *)&count, 4);
+            file.write(body.data(), body.size());
+        }
+        std::filesystem::rename(temporary, path, error);
+        return !error;
+    }
+
+    // the GL thread, per loading frame: warms the listed combinations until budgetMs are spent,
+    // true once they are all done. State goes through glState, the framebuffer and viewport are
+    // put back.
+    bool warm(ShaderCompiler &compiler, double budgetMs)
+    {
+        if (next >= listed.size())
+            return true;
+        auto start = std::chrono::steady_clock::now();
+        int readFramebuffer = 0, drawFramebuffer = 0, viewport[4];
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        target.resize(1, 1);
+        target.bind();
+        glViewport(0, 0, 1, 1);
+        while (next < listed.size() &&
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < budgetMs)
+        {
+            const Combination &combination = listed[next];
+            auto found = programs.find(combination.program);
+            if (found == programs.end())
+                found = programs.emplace(combination.program, compiler.find(combination.program)).first;
+            Shader *shader = found->second;
+            if (shader && !compiler.isReady(*shader))
+                break;
+            next++;
+            if (!shader)
+                continue;
+            shader->use();
+            if (!shader->isLinked())
+                continue;
+            glState.bindVertexArray(vertexArrayFor(combination.layout));
+            glState.setCapability(GL_DEPTH_TEST, combination.depthTest);
+            glState.setDepthMask(combination.depthWrite);
+            glState.setDepthFunc(combination.depthFunc);
+            glState.setCapability(GL_BLEND, combination.blend);
+            if (combination.blend)
+                glState.setBlendFunc(combination.blendSource, combination.blendDestination);
+            glState.setCapability(GL_CULL_FACE, combination.cullFace);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            warmed++;
+        }
+        glState.bindVertexArray(0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        return next >= listed.size();
+    }
+
+  private:
+    // one enabled vertex attribute
+    struct Attribute
+    {
+        uint32_t index, size, type, normalized, integer, divisor;
+    };
+    struct Combination
+    {
+        uint64_t program;
+        bool depthTest, depthWrite, blend, cullFace;
+        GLenum depthFunc, blendSource, blendDestination;
+        std::vector<Attribute> layout;
+    };
+    // a draw of this run, with GL names; hashed as bytes, so no padding
+    struct Draw
+    {
+        unsigned int program;
+        uint32_t pipeline;
+        unsigned int vertexArray;
+        uint32_t depthTest, depthWrite, blend, cullFace;
+        GLenum depthFunc, blendSource, blendDestination;
+    };
+    struct Recorded
+    {
+        Draw draw;
+        std::vector<Attribute> layout;
+    };
+
+    static inline PipelineWarmup *recorder = NULL;
+    // attributes past this aren't read back
+    static constexpr uint32_t MAX_ATTRIBUTES = 16;
+    // the warm draws read their three vertices from here, enough for any attribute format
+    static const size_t BUFFER_SIZE = 256;
+
+    std::vector<Combination> listed;
+    size_t next = 0;
+    std::unordered_map<uint64_t, Shader *> programs;
+    std::unordered_set<uint64_t> seen;
+    std::vector<Recorded> draws;
+    std::unordered_map<unsigned int, std::vector<Attribute>> layouts;
+    // a vertex array per layout for warm(), its attributes all read from buffer
+    std::map<std::string, unsigned int> vertexArrays;
+    unsigned int buffer = 0;
+    RenderTarget target;
+
+    static std::vector<Attribute> readLayout()
+    {
+        int count = 0;
+        glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &count);
+        std::vector<Attribute> layout;
+        for (uint32_t i = 0; i < std::min((uint32_t)count, MAX_ATTRIBUTES); i++)
+        {
+            int enabled = 0;
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+            if (!enabled)
+                continue;
+            int size = 0, type = 0, normalized = 0, integer = 0, divisor = 0;
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_SIZE, &size);
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_TYPE, &type);
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &normalized);
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &integer);
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_DIVISOR, &divisor);
+            layout.push_back({i, (uint32_t)size, (uint32_t)type, (uint32_t)normalized, (uint32_t)integer,
+                              (uint32_t)divisor});
+        }
+        return layout;
+    }
+
+    static std::string encode(const std::vector<Attribute> &layout)
+    {
+        return std::string((const char *)layout.data(), layout.size() * sizeof(Attribute));
+    }
+
+    // program, four state bytes, three enums, the attribute count and the attributes
+    static std::string encode(const Combination &combination)
+    {
+        std::string record((const char *)&combination.program, 8);
+        const char flags[4] = {combination.depthTest, combination.depthWrite, combination.blend,
+                               combination.cullFace};
+        record.append(flags, 4);
+        const uint32_t enums[4] = {combination.depthFunc, combination.blendSource, combination.blendDestination,
+                                   (uint32_t)combination.layout.size()};
+        record.append((const char *)enums, sizeof(enums));
+        return record + encode(combination.layout);
+    }
+
+    static bool decode(const std::vector<unsigned char> &bytes, size_t &offset, Combination &combination)
+    {
+        const size_t FIXED = 8 + 4 + 4 * 4;
+        if (offset + FIXED > bytes.size())
+            return false;
+        const unsigned char *record = bytes.data() + offset;
+        std::memcpy(&combination.program, record, 8);
+        combination.depthTest = record[8] != 0;
+        combination.depthWrite = record[9] != 0;
+        combination.blend = record[10] != 0;
+        combination.cullFace = record[11] != 0;
+        uint32_t enums[4];
+        std::memcpy(enums, record + 12, sizeof(enums));
+        combination.depthFunc = enums[0];
+        combination.blendSource = enums[1];
+        combination.blendDestination = enums[2];
+        if (enums[3] > MAX_ATTRIBUTES || offset + FIXED + enums[3] * sizeof(Attribute) > bytes.size())
+            return false;
+        combination.layout.resize(enums[3]);
+        std::memcpy(combination.layout.data(), record + FIXED, enums[3] * sizeof(Attribute));
+        offset += FIXED + enums[3] * sizeof(Attribute);
+        return true;
+    }
+
+    unsigned int vertexArrayFor(const std::vector<Attribute> &layout)
+    {
+        unsigned int &vertexArray = vertexArrays[encode(layout)];
+        if (vertexArray)
+            return vertexArray;
+        if (!buffer)
+        {
+            std::vector<unsigned char> zeros(BUFFER_SIZE, 0);
+            buffer = createBuffer(BUFFER_SIZE, zeros.data(), 0);
+        }
+        glGenVertexArrays(1, &vertexArray);
+        glState.bindVertexArray(vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        for (const Attribute &attribute : layout)
+        {
+            if (attribute.integer)
+                glVertexAttribIPointer(attribute.index, (int)attribute.size, attribute.type, 0, NULL);
+            else
+                glVertexAttribPointer(attribute.index, (int)attribute.size, attribute.type,
+                                      attribute.normalized ? GL_TRUE : GL_FALSE, 0, NULL);
+            glVertexAttribDivisor(attribute.index, attribute.divisor);
+            glEnableVertexAttribArray(attribute.index);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return vertexArray;
+    }
+};
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "frame_graph.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "gpu_profiler.cpp"
+#include "render_stats.cpp"
+#include "shader.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A chain of full screen passes over the HDR frame, declared once as a graph: every pass reads
+// the frame or outputs of earlier passes ("input0", "input1", ... at units 0, 1, ...) and
+// writes one texture of its own scale of the frame and format, the last pass writes to the
+// target execute() is given. Every execute() declares the chain as a FrameGraph, the
+// intermediate textures are its transients: they come out of its pool and go back after
+// their last reader, so a run of passes at one size ping-pongs between two targets by
+// itself, and passes whose output nothing reads (the bloom when the composite skips it)
+// aren't run. Passes at half or quarter scale (the blurs of the bloom) cost a quarter
+// or a sixteenth of the fill rate. Each pass gets its params and the texel size of its
+// first input ("texelSize") as uniforms, and is a zone of the GpuProfiler. Textures from
+// outside the chain (a depth buffer, a history kept across frames) are externals, given
+// anew before each execute(), which passes read and can write in place of a texture of their own.
+// Compute passes sit in the chain the same way, they read passes and write externals through
+// imageStore() (the histogram and exposure of auto_exposure.cpp), a later pass sampling such an
+// external gets the barrier for it from the graph.
+class PostProcessGraph
+{
+  public:
+    // the frame given to execute()
+    static const int SOURCE = 0;
+
+    PostProcessGraph() : sampler(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)
+    {
+        emptyVAO = createVertexArray();
+    }
+
+    ~PostProcessGraph()
+    {
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    PostProcessGraph(const PostProcessGraph &) = delete;
+    PostProcessGraph &operator=(const PostProcessGraph &) = delete;
+
+    // a pass writing a texture of scale x the frame's size, returns the handle later passes read it by
+    int addPass(const std::string &name, Shader &program, const std::vector<int> &inputs, float scale, GLenum format,
+                const glm::vec4 &params = glm::vec4(0.0f))
+    {
+        Pass pass;
+        pass.name = name;
+        pass.program = &program;
+        pass.inputs = inputs;
+        pass.scale = scale;
+        pass.format = format;
+        pass.params = params;
+        program.use();
+        for (size_t i = 0; i < inputs.size(); i++)
+            program.setInt("input" + std::to_string(i), (int)i);
+        pass.paramsLoc = program.uniform("params");
+        pass.texelSizeLoc = program.uniform("texelSize");
+        passes.push_back(pass);
+        return (int)passes.size();
+    }
+
+    // a texture from outside the chain, its handle is negative; set it with setExternal()
+    int addExternal(const std::string &name)
+    {
+        externals.push_back({name, NULL, 0});
+        return -(int)externals.size();
+    }
+
+    // what an external is this frame, fbo when a pass writes it; an unset one reads as nothing
+    // and a pass writing it writes a texture of its own
+    void setExternal(int handle, const Texture2D *texture, unsigned int fbo = 0)
+    {
+        if (handle < 0 && -handle <= (int)externals.size())
+            externals[-handle - 1] = {externals[-handle - 1].name, texture, fbo};
+    }
+
+    // the pass writes an external at its size instead, later passes reading the pass read that
+    void setTarget(int handle, int external)
+    {
+        if (handle > 0 && handle <= (int)passes.size() && external < 0 && -external <= (int)externals.size())
+            passes[handle - 1].target = external;
+    }
+
+    // a pass dispatching compute work over the textures of inputs in place of a draw, writing
+    // the externals of images with imageStore()
+    void addCompute(const std::string &name, const std::vector<int> &inputs, const std::vector<int> &images,
+                    std::function<void(const std::vector<const Texture2D *> &)> dispatch)
+    {
+        Pass pass;
+        pass.name = name;
+        pass.inputs = inputs;
+        pass.images = images;
+        pass.dispatch = std::move(dispatch);
+        passes.push_back(pass);
+    }
+
+    // uniforms of a pass besides its params, set with its program in use before it draws
+    void setUniforms(int handle, std::function<void(Shader &)> uniforms)
+    {
+        if (handle > 0 && handle <= (int)passes.size())
+            passes[handle - 1].uniforms = std::move(uniforms);
+    }
+
+    // the last pass, into execute()'s target at the frame's size
+    void addOutput(const std::string &name, Shader &program, const std::vector<int> &inputs,
+                   const glm::vec4 &params = glm::vec4(0.0f))
+    {
+        addPass(name, program, inputs, 1.0f, 0, params);
+    }
+
+    // changes a pass's params, e.g. the bloom strength
+    void setParams(int handle, const glm::vec4 &params)
+    {
+        if (handle > 0 && handle <= (int)passes.size())
+            passes[handle - 1].params = params;
+    }
+
+    // changes a pass's scale of the frame, e.g. a cheaper bloom
+    void setScale(int handle, float scale)
+    {
+        if (handle > 0 && handle <= (int)passes.size())
+            passes[handle - 1].scale = scale;
+    }
+
+    // runs every pass over source (width x height) and leaves targetFBO bound with the viewport on it
+    void execute(const Texture2D &source, int width, int height, unsigned int targetFBO, GpuProfiler &profiler)
+    {
+        if (passes.empty() || width <= 0 || height <= 0)
+            return;
+        // the chain as this frame's graph, passes nobody reads from are culled there
+        std::vector<FrameGraph::Resource> outputs(passes.size() + 1, -1), imports;
+        outputs[SOURCE] = graph.importTexture("source", source);
+        for (const External &external : externals)
+            imports.push_back(external.texture ? graph.importTexture(external.name, *external.texture, external.fbo)
+                                               : graph.importFramebuffer(external.name, 0, 1, 1));
+        auto resource = [&outputs, &imports](int handle) {
+            return handle < 0 ? imports[-handle - 1] : outputs[handle];
+        };
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            Pass &pass = passes[i];
+            bool last = i + 1 == passes.size();
+            if (pass.dispatch)
+            {
+                FrameGraph::Pass node = graph.addPass(pass.name, [&pass, &resource](FrameGraph &frame) {
+                    std::vector<const Texture2D *> textures;
+                    for (int input : pass.inputs)
+                        textures.push_back(frame.texture(resource(input)));
+                    pass.dispatch(textures);
+                });
+                for (int input : pass.inputs)
+                    graph.read(node, resource(input));
+                for (int image : pass.images)
+                    graph.write(node, resource(image), FRAME_GRAPH_IMAGE_WRITE);
+                continue;
+            }
+            if (pass.target < 0 && externals[-pass.target - 1].texture)
+                outputs[i + 1] = resource(pass.target);
+            else
+                outputs[i + 1] = last ? graph.importFramebuffer("target", targetFBO, width, height)
+                                      : graph.createTexture(pass.name, (int)(width * pass.scale),
+                                                            (int)(height * pass.scale), pass.format);
+            FrameGraph::Pass node = graph.addPass(pass.name, [this, &pass, &resource](FrameGraph &frame) {
+                pass.program->use();
+                glm::vec2 texelSize(0.0f);
+                for (size_t unit = 0; unit < pass.inputs.size(); unit++)
+                {
+                    const Texture2D *texture = frame.texture(resource(pass.inputs[unit]));
+                    if (!texture)
+                        continue;
+                    texture->bind((unsigned int)unit);
+                    sampler.bind((unsigned int)unit);
+                    if (unit == 0)
+                        texelSize = glm::vec2(1.0f / texture->width, 1.0f / texture->height);
+                }
+                pass.program->set(pass.paramsLoc, pass.params);
+                pass.program->set(pass.texelSizeLoc, texelSize);
+                if (pass.uniforms)
+                    pass.uniforms(*pass.program);
+                renderStats.countDraw(3);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            });
+            for (int input : pass.inputs)
+                graph.read(node, resource(input));
+            graph.write(node, outputs[i + 1]);
+        }
+
+        glState.disable(GL_DEPTH_TEST);
+        glState.setDepthMask(false);
+        glState.disable(GL_BLEND);
+        glState.bindVertexArray(emptyVAO);
+        graph.compile();
+        culledPasses = graph.culledPasses;
+        graph.execute(profiler);
+        glState.setDepthMask(true);
+        glState.enable(GL_DEPTH_TEST);
+    }
+
+    // textures the pool holds now
+    size_t pooledTargets() const
+    {
+        return graph.targets().size();
+    }
+
+    // passes the last execute() skipped because nothing read their output
+    size_t culledPasses = 0;
+
+  private:
+    struct Pass
+    {
+        std::string name;
+        Shader *program = NULL;
+        std::vector<int> inputs;
+        float scale = 1.0f;
+        GLenum format = 0;
+        glm::vec4 params = glm::vec4(0.0f);
+        UniformHandle paramsLoc, texelSizeLoc;
+        // an external written in place of a texture of its own, 0 for none
+        int target = 0;
+        std::function<void(Shader &)> uniforms;
+        // of a compute pass, which has no program or texture of its own
+        std::vector<int> images;
+        std::function<void(const std::vector<const Texture2D *> &)> dispatch;
+    };
+    struct External
+    {
+        std::string name;
+        const Texture2D *texture;
+        unsigned int fbo;
+    };
+
+    std::vector<Pass> passes;
+    std::vector<External> externals;
+    FrameGraph graph;
+    Sampler sampler;
+    unsigned int emptyVAO = 0;
+};
+
+#endif
@@ -0,0 +1,321 @@
+#ifndef PROCEDURAL_SCATTER_H
+#define PROCEDURAL_SCATTER_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "frame_data.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "hiz_buffer.cpp"
+#include "indirect_renderer.cpp"
+#include "mesh.cpp"
+#include "render_stats.cpp"
+#include "shader.cpp"
+#include "terrain.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Mirrors the Instance entries of shader_src/scatter.comp, two vertex attributes of scatter.vs
+struct ScatterInstance
+{
+    // xyz on the terrain, w the scale
+    glm::vec4 placement;
+    // xy the cosine and sine of the turn about y, z the tint
+    glm::vec4 look;
+};
+
+// Grass scattered over the terrain by the GPU, with nothing per instance on the CPU. The
+// ground around the camera is a square of tiles tileSize wide, and every tile has perTile
+// candidates. shader_src/scatter.comp runs one invocation per candidate and a workgroup row
+// per tile. The tile's integer coordinates and the candidate's index seed a hash, which places
+// the candidate in its tile and picks its scale, turn and tint. The keep-or-drop roll uses the
+// same hash, against the density left by the slope and height of the height map (the grass of
+// terrain.fs), the density map when there is one, and a fade out towards maxDistance. Every
+// tile and candidate comes out the same from any camera, so the grass doesn't swim when the
+// camera moves.
+// Kept candidates are culled against the frustum and, with a Hi-Z buffer set, last frame's
+// depth. Each one is appended to the instance list of its level of detail. There are two
+// levels, a tuft of three bent blades near the camera and two flat ones past lodDistance. The
+// lists are the instanced attribute of one VAO, the second starting at its command's
+// baseInstance, and draw() issues one glMultiDrawElementsIndirect with a command per level.
+// The CPU only rewrites the two commands with their instance counts zeroed. Each list has
+// room for every candidate, so the culling never runs out of space. Needs GL 4.3.
+class ProceduralScatter
+{
+  public:
+    // shader storage bindings of scatter.comp
+    static const unsigned int INSTANCE_BINDING = 2;
+    static const unsigned int COMMAND_BINDING = 5;
+    static const unsigned int HEIGHT_UNIT = 2;
+    static const unsigned int DENSITY_UNIT = 3;
+    // vertex buffer binding of the instances, the mesh is on VertexLayout::BINDING
+    static const unsigned int INSTANCE_VERTEX_BINDING = 1;
+    static const unsigned int PLACEMENT_LOCATION = 2;
+    static const unsigned int LOOK_LOCATION = 3;
+    static const unsigned int LODS = 2;
+    // local_size_x of scatter.comp, perTile is a multiple of it
+    static constexpr unsigned int GROUP_SIZE = 64;
+
+    // of a tile's side, in world units
+    float tileSize = 8.0f;
+    // where the grass has faded out completely, it thins over the last quarter before it
+    float maxDistance = 64.0f;
+    float lodDistance = 16.0f;
+    float minScale = 0.6f, maxScale = 1.2f;
+    // another field of grass over the same terrain
+    uint32_t seed = 0;
+
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    // program is scatter.comp, drawProgram scatter.vs with scatter.fs
+    ProceduralScatter(const Terrain &terrain, unsigned int perTile, Shader &program, Shader &drawProgram)
+        : terrain(terrain), program(program), drawProgram(drawProgram),
+          sampler(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)
+    {
+        this->perTile = std::max(GROUP_SIZE, (perTile + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE);
+        buildMesh();
+        commandBuffer = createBuffer(sizeof(commands), NULL, GL_DYNAMIC_STORAGE_BIT, GL_DYNAMIC_DRAW);
+        setupVertexArray();
+    }
+
+    ~ProceduralScatter()
+    {
+        deleteBuffers(1, &instanceBuffer);
+        deleteBuffers(1, &commandBuffer);
+    }
+
+    ProceduralScatter(const ProceduralScatter &) = delete;
+    ProceduralScatter &operator=(const ProceduralScatter &) = delete;
+
+    // the candidates are kept where map's red channel is high, on top of the terrain's own
+    // density; map spans the terrain like its height map
+    void setDensityMap(const Texture2D *map)
+    {
+        densityMap = map;
+    }
+
+    // tests the kept candidates against the depth of the frame before as well
+    void setHiZ(const HiZBuffer *buffer)
+    {
+        hiZ = buffer;
+    }
+
+    // the tiles around camera, culled against the frame's viewProjection (see frame_data.cpp)
+    void update(const glm::vec3 &camera)
+    {
+        tilesPerSide = 2 * (int)std::ceil(maxDistance / tileSize) + 1;
+        reserve((size_t)tilesPerSide * tilesPerSide * perTile);
+        glm::ivec2 center((int)std::floor(camera.x / tileSize), (int)std::floor(camera.z / tileSize));
+        glm::ivec2 firstTile = center - glm::ivec2(tilesPerSide / 2);
+
+        for (unsigned int lod = 0; lod < LODS; lod++)
+        {
+            const Submesh &submesh = mesh->submeshes[lod];
+            commands[lod] = {submesh.indexCount, 0, submesh.firstIndex, 0, (uint32_t)(lod * capacity)};
+        }
+        updateBuffer(commandBuffer, 0, sizeof(commands), commands);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, instanceBuffer, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, commandBuffer, 0, 0);
+
+        program.use();
+        if (!terrainLoc.valid())
+        {
+            program.bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+            program.setInt("heightMap", HEIGHT_UNIT);
+            program.setInt("densityMap", DENSITY_UNIT);
+            terrainLoc = program.uniform("terrain");
+            baseHeightLoc = program.uniform("baseHeight");
+            firstTileLoc = program.uniform("firstTile");
+            tileSizeLoc = program.uniform("tileSize");
+            perTileLoc = program.uniform("perTile");
+            capacityLoc = program.uniform("capacity");
+            distancesLoc = program.uniform("distances");
+            scaleRangeLoc = program.uniform("scaleRange");
+            boundsLoc = program.uniform("bounds");
+            seedLoc = program.uniform("seed");
+            densityEnabledLoc = program.uniform("densityMapEnabled");
+            hiZEnabledLoc = program.uniform("hiZEnabled");
+            hiZViewProjectionLoc = program.uniform("hiZViewProjection");
+            hiZReversedLoc = program.uniform("hiZReversed");
+        }
+        program.set(terrainLoc, glm::vec4(terrain.origin.x, terrain.origin.z, terrain.size, terrain.heightScale));
+        program.set(baseHeightLoc, terrain.origin.y);
+        program.set(firstTileLoc, glm::vec2(firstTile));
+        program.set(tileSizeLoc, tileSize);
+        program.set(perTileLoc, perTile);
+        program.set(capacityLoc, (unsigned int)capacity);
+        program.set(distancesLoc, glm::vec3(lodDistance, maxDistance * 0.75f, maxDistance));
+        program.set(scaleRangeLoc, glm::vec2(minScale, maxScale));
+        program.set(boundsLoc, bounds);
+        program.set(seedLoc, seed);
+        program.set(densityEnabledLoc, densityMap != NULL);
+        terrain.heights().bind(HEIGHT_UNIT);
+        sampler.bind(HEIGHT_UNIT);
+        if (densityMap)
+        {
+            densityMap->bind(DENSITY_UNIT);
+            sampler.bind(DENSITY_UNIT);
+        }
+        bool occlusion = hiZ && hiZ->valid;
+        program.set(hiZEnabledLoc, occlusion);
+        if (occlusion)
+        {
+            hiZ->bind();
+            program.set(hiZViewProjectionLoc, hiZ->viewProjection);
+            program.set(hiZReversedLoc, hiZ->reversedZ);
+        }
+        glDispatchCompute(perTile / GROUP_SIZE, (GLuint)tilesPerSide, (GLuint)tilesPerSide);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+
+    // the instances update() kept, both levels in one indirect draw
+    void draw()
+    {
+        drawProgram.use();
+        if (!sunDirectionLoc.valid())
+            sunDirectionLoc = drawProgram.uniform("sunDirection");
+        drawProgram.set(sunDirectionLoc, terrain.sunDirection);
+        mesh->bind();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        // the instance counts are only known on the GPU
+        renderStats.countDraw(0);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, mesh->indexType, (const void *)0, LODS, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // the candidates every update() tests
+    size_t candidates() const
+    {
+        return (size_t)tilesPerSide * tilesPerSide * perTile;
+    }
+
+  private:
+    const Terrain &terrain;
+    Shader &program, &drawProgram;
+    Sampler sampler;
+    const Texture2D *densityMap = NULL;
+    const HiZBuffer *hiZ = NULL;
+    unsigned int perTile;
+    int tilesPerSide = 0;
+    std::unique_ptr<Mesh> mesh;
+    // xyz the center and w the radius of the mesh's bounding sphere at scale 1
+    glm::vec4 bounds = glm::vec4(0.0f);
+    unsigned int instanceBuffer = 0, commandBuffer = 0;
+    // instances of each level's list
+    size_t capacity = 0;
+    DrawElementsIndirectCommand commands[LODS] = {};
+    UniformHandle terrainLoc, baseHeightLoc, firstTileLoc, tileSizeLoc, perTileLoc, capacityLoc, distancesLoc;
+    UniformHandle scaleRangeLoc, boundsLoc, seedLoc, densityEnabledLoc, sunDirectionLoc;
+    UniformHandle hiZEnabledLoc, hiZViewProjectionLoc, hiZReversedLoc;
+
+    // a blade of width at the root and height, bent over by lean, turned angle about y; segments
+    // quads taper to a triangle at its tip
+    static void addBlade(MeshBuilder &builder, float angle, float width, float height, float lean, int segments)
+    {
+        glm::vec3 across(std::cos(angle), 0.0f, std::sin(angle));
+        glm::vec3 facing(-across.z, 0.0f, across.x);
+        auto point = [&](float t, float side) {
+            float w = width * (1.0f - t) * 0.5f;
+            return across * (side * w) + facing * (lean * t * t) + glm::vec3(0.0f, height * t, 0.0f);
+        };
+        auto corner = [&](glm::vec3 p) {
+            glm::vec3 normal = glm::normalize(facing + glm::vec3(0.0f, 0.5f, 0.0f));
+            const float vertex[6] = {p.x, p.y, p.z, normal.x, normal.y, normal.z};
+            builder.add(vertex);
+        };
+        for (int s = 0; s < segments; s++)
+        {
+            float t0 = (float)s / segments, t1 = (float)(s + 1) / segments;
+            glm::vec3 a = point(t0, -1.0f), b = point(t0, 1.0f), c = point(t1, -1.0f), d = point(t1, 1.0f);
+            corner(a);
+            corner(b);
+            corner(d);
+            if (s + 1 == segments)
+                continue;
+            corner(a);
+            corner(d);
+            corner(c);
+        }
+    }
+
+    // level 0 three bent blades of three segments, level 1 two flat ones; submeshes in that order
+    void buildMesh()
+    {
+        MeshBuilder builder(6);
+        for (int i = 0; i < 3; i++)
+            addBlade(builder, (float)i * 2.0944f, 0.12f, 0.5f, 0.12f, 3);
+        builder.endSubmesh();
+        for (int i = 0; i < 2; i++)
+            addBlade(builder, 0.5f + (float)i * 1.5708f, 0.14f, 0.5f, 0.0f, 1);
+        builder.endSubmesh();
+        glm::vec3 low(1e30f), high(-1e30f);
+        for (size_t v = 0; v < builder.vertices.size(); v += 6)
+        {
+            glm::vec3 p(builder.vertices[v], builder.vertices[v + 1], builder.vertices[v + 2]);
+            low = glm::min(low, p);
+            high = glm::max(high, p);
+        }
+        bounds = glm::vec4((low + high) * 0.5f, glm::length(high - low) * 0.5f);
+        VertexLayout layout({{0, 3, VertexFormat::Float}, {1, 3, VertexFormat::Float}});
+        mesh = std::make_unique<Mesh>(builder, layout);
+    }
+
+    // the instance stream of the mesh's VAO, its buffer attached by reserve()
+    void setupVertexArray()
+    {
+        if (hasDSA())
+        {
+            for (unsigned int location : {PLACEMENT_LOCATION, LOOK_LOCATION})
+            {
+                GLuint offset = location == LOOK_LOCATION ? offsetof(ScatterInstance, look) : 0;
+                glVertexArrayAttribFormat(mesh->VAO, location, 4, GL_FLOAT, GL_FALSE, offset);
+                glVertexArrayAttribBinding(mesh->VAO, location, INSTANCE_VERTEX_BINDING);
+                glEnableVertexArrayAttrib(mesh->VAO, location);
+            }
+            glVertexArrayBindingDivisor(mesh->VAO, INSTANCE_VERTEX_BINDING, 1);
+        }
+        else
+        {
+            glState.bindVertexArray(mesh->VAO);
+            for (unsigned int location : {PLACEMENT_LOCATION, LOOK_LOCATION})
+            {
+                glEnableVertexAttribArray(location);
+                glVertexAttribDivisor(location, 1);
+            }
+        }
+    }
+
+    // room for count instances in each level's list, grown when the tiles get more
+    void reserve(size_t count)
+    {
+        if (count <= capacity)
+            return;
+        deleteBuffers(1, &instanceBuffer);
+        capacity = count;
+        instanceBuffer = createBuffer(capacity * LODS * sizeof(ScatterInstance), NULL, 0, GL_DYNAMIC_COPY,
+                                      GPU_MEMORY_GEOMETRY);
+        if (hasDSA())
+        {
+            glVertexArrayVertexBuffer(mesh->VAO, INSTANCE_VERTEX_BINDING, instanceBuffer, 0, sizeof(ScatterInstance));
+        }
+        else
+        {
+            glState.bindVertexArray(mesh->VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+            glVertexAttribPointer(PLACEMENT_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(ScatterInstance), (void *)0);
+            glVertexAttribPointer(LOOK_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(ScatterInstance),
+                                  (void *)offsetof(ScatterInstance, look));
+        }
+    }
+};
+
+#endif
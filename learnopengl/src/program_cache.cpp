@@ -0,0 +1,122 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include "glad/glad.h"
+
+#include "asset_pack.cpp"
+#include "hash.cpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// off makes every program compile from source, the regression suite times real compiles
+inline bool programBinaryCacheEnabled = true;
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+// Entries are keyed by the shader sources and the driver identification strings,
+// so a driver update or a source edit simply misses and recompiles.
+class ProgramBinaryCache
+{
+  public:
+    std::string directory;
+
+    ProgramBinaryCache(const std::string &directory = "cache/shaders") : directory(directory)
+    {
+    }
+
+    // true when the driver exposes at least one binary format and the cache isn't turned off
+    static bool supported()
+    {
+        if (!programBinaryCacheEnabled)
+            return false;
+        int formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    // key for a set of stage sources on the current context
+    static uint64_t key(const std::vector<std::string_view> &sources)
+    {
+        uint64_t hash = fnv1a64("", 0);
+        const GLenum driverStrings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+        for (GLenum name : driverStrings)
+        {
+            const char *value = (const char *)glGetString(name);
+            if (value)
+                hash = fnv1a64(value, std::char_traits<char>::length(value), hash);
+        }
+        for (std::string_view source : sources)
+        {
+            // the separator keeps ("ab", "c") and ("a", "bc") apart, views aren't NUL terminated
+            // so it is hashed on its own, giving the same keys as before
+            const char separator = '\0';
+            hash = fnv1a64(source.data(), source.size(), hash);
+            hash = fnv1a64(&separator, 1, hash);
+        }
+        return hash;
+    }
+
+    // tries to fill an existing program object from the cache,
+    // returns false on a miss or when the driver rejects the binary
+    bool load(uint64_t key, unsigned int program) const
+    {
+        std::vector<unsigned char> bytes;
+        if (!readFileContents(path(key), bytes) || bytes.size() <= sizeof(GLenum))
+            return false;
+
+        GLenum format = 0;
+        std::memcpy(&format, bytes.data(), sizeof(format));
+        glProgramBinary(program, format, bytes.data() + sizeof(format), (GLsizei)(bytes.size() - sizeof(format)));
+        int success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            // stale or foreign binary, drop it so it gets rewritten
+            std::remove(path(key).c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // stores a successfully linked program, the program should have been linked
+    // with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    void store(uint64_t key, unsigned int program) const
+    {
+        int length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, NULL, &format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::ofstream file(path(key), std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cout << "ERROR::PROGRAM_CACHE::COULD_NOT_WRITE: " << path(key) << '\n';
+            return;
+        }
+        file.write((const char *)&format, sizeof(format));
+        file.write(binary.data(), binary.size());
+    }
+
+  private:
+    std::string path(uint64_t key) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef QUADTREE_ALLOCATOR_H
+#define QUADTREE_ALLOCATOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// a square region handed out by QuadtreeAllocator, in texels of the whole area
+struct QuadtreePage
+{
+    int x = 0, y = 0;
+    // 0 for none
+    int size = 0;
+};
+
+// Allocator of power of two square pages of a square area, for atlases of tiles that come in a
+// few sizes (shadow_atlas.cpp). Every node of the tree is a page, free, split into four
+// quarters or taken; allocate() looks for a free page among the quarters of pages already
+// split before it splits another one, so the small pages stay packed together and the large
+// free ones stay whole, and free() merges four free quarters back into their page.
+class QuadtreeAllocator
+{
+  public:
+    // of the whole area, and the smallest page, both powers of two
+    int size = 0;
+    int minPageSize = 0;
+    // texels handed out and not yet freed
+    int64_t used = 0;
+
+    QuadtreeAllocator(int size = 0, int minPageSize = 1)
+    {
+        reset(size, minPageSize);
+    }
+
+    // everything free again
+    void reset(int areaSize, int smallest)
+    {
+        size = areaSize;
+        minPageSize = std::max(1, std::min(smallest, areaSize));
+        used = 0;
+        states.clear();
+        for (int level = 0; size > 0 && (size >> level) >= minPageSize; level++)
+            states.emplace_back((size_t)1 << (2 * level), FREE);
+    }
+
+    // a page of pageSize, rounded up to a power of two; false when none is free
+    bool allocate(int pageSize, QuadtreePage &page)
+    {
+        int level = levelOf(pageSize);
+        if (level < 0)
+            return false;
+        for (bool split : {false, true})
+        {
+            int x = 0, y = 0;
+            if (find(0, 0, 0, level, split, x, y))
+            {
+                page.size = size >> level;
+                page.x = x * page.size;
+                page.y = y * page.size;
+                used += (int64_t)page.size * page.size;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // returns a page given out by allocate(), merging it with its free siblings
+    void free(const QuadtreePage &page)
+    {
+        int level = levelOf(page.size);
+        if (level < 0 || page.size == 0)
+            return;
+        used -= (int64_t)page.size * page.size;
+        int x = page.x / page.size, y = page.y / page.size;
+        state(level, x, y) = FREE;
+        while (level > 0)
+        {
+            int parentX = x / 2, parentY = y / 2;
+            for (int i = 0; i < 4; i++)
+            {
+                if (state(level, parentX * 2 + (i & 1), parentY * 2 + (i >> 1)) != FREE)
+                    return;
+            }
+            level--;
+            x = parentX;
+            y = parentY;
+            state(level, x, y) = FREE;
+        }
+    }
+
+  private:
+    enum State : uint8_t
+    {
+        FREE,
+        SPLIT,
+        TAKEN
+    };
+
+    // the nodes of each level row by row, level 0 the whole area
+    std::vector<std::vector<State>> states;
+
+    State &state(int level, int x, int y)
+    {
+        return states[level][(size_t)y * ((size_t)1 << level) + x];
+    }
+
+    int levelOf(int pageSize) const
+    {
+        pageSize = std::max(pageSize, minPageSize);
+        for (int level = (int)states.size() - 1; level >= 0; level--)
+        {
+            if ((size >> level) >= pageSize)
+                return level;
+        }
+        return -1;
+    }
+
+    // a free node at target under the node (level, x, y); a free node above target is only
+    // split when split is set
+    bool find(int level, int x, int y, int target, bool split, int &foundX, int &foundY)
+    {
+        State &node = state(level, x, y);
+        if (level == target)
+        {
+            if (node != FREE)
+                return false;
+            node = TAKEN;
+            foundX = x;
+            foundY = y;
+            return true;
+        }
+        if (node == TAKEN || (node == FREE && !split))
+            return false;
+        bool wasFree = node == FREE;
+        node = SPLIT;
+        for (int i = 0; i < 4; i++)
+        {
+            if (find(level + 1, x * 2 + (i & 1), y * 2 + (i >> 1), target, split, foundX, foundY))
+                return true;
+        }
+        // a free node whose quarters were all free keeps being one
+        if (wasFree)
+            node = FREE;
+        return false;
+    }
+};
+
+#endif
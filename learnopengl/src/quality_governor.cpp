@@ -0,0 +1,218 @@
+#ifndef QUALITY_GOVERNOR_H
+#define QUALITY_GOVERNOR_H
+
+#include "gpu_profiler.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+// the settings the governor turns down, in the order it turns them down
+enum QualityKnob
+{
+    // GPU bound: less anisotropic filtering, the bloom at lower resolutions, cheaper screen space
+    // reflections, fewer particles, fewer and smaller shadow cascades, coarser levels of detail sooner
+    QUALITY_ANISOTROPY,
+    QUALITY_POST,
+    QUALITY_REFLECTIONS,
+    QUALITY_PARTICLES,
+    QUALITY_SHADOWS,
+    QUALITY_LOD,
+    // CPU bound: fewer simulation steps, then less submitted by a shorter draw distance
+    QUALITY_SIMULATION,
+    QUALITY_DRAW_DISTANCE,
+    QUALITY_KNOBS
+};
+
+inline const char *qualityKnobName(QualityKnob knob)
+{
+    static const char *const names[QUALITY_KNOBS] = {"anisotropy", "post",       "reflections", "particles",
+                                                     "shadows",    "lod",        "simulation",  "draw distance"};
+    return names[knob];
+}
+
+// Holds a frame time by turning down the knob that costs on the side the frame waits for.
+// The CPU time of the frame (the caller's, without the swap and the waits for the GPU) and
+// the GPU time of the whole frame (the GpuProfiler's "frame" zone, as DynamicResolution
+// reads it) are averaged over SAMPLES frames; when the larger one is over the target the
+// next knob of its side goes down a level. A level only comes back, the last one lowered
+// first, once both were below headroom x the target for raiseDelay seconds, and a level
+// that came back and had to go down again within a few seconds doubles the delay up to
+// maxRaiseDelay, so a knob on the edge doesn't flip. After a change the samples of frames
+// drawn before it are skipped. The caller reads the levels (0 is the full quality) through
+// the scales below and applies them; knobs the renderer doesn't have are disable()d.
+class QualityGovernor
+{
+  public:
+    static const size_t SAMPLES = 30;
+
+    float targetFrameTime = 16.0f;
+    float headroom = 0.75f;
+    double raiseDelay = 2.0;
+    double maxRaiseDelay = 32.0;
+    // set while dynamic resolution can still go lower, the GPU knobs wait for it
+    bool holdGpu = false;
+    int levels[QUALITY_KNOBS] = {};
+    // averages of the last window
+    float cpuAverage = 0.0f, gpuAverage = 0.0f;
+
+    void disable(QualityKnob knob)
+    {
+        maxLevels[knob] = 0;
+        levels[knob] = 0;
+    }
+
+    // once a frame; true when a level changed and the caller has to apply the scales
+    bool update(float cpuMilliseconds, const GpuProfiler &profiler, double now)
+    {
+        for (const GpuPassStats &pass : profiler.passes)
+        {
+            if (pass.name != "frame" || pass.count == seenGpuSamples)
+                continue;
+            seenGpuSamples = pass.count;
+            if (skipGpuSamples > 0)
+                skipGpuSamples--;
+            else
+            {
+                gpuTotal += pass.last;
+                gpuSamples++;
+            }
+        }
+        cpuTotal += cpuMilliseconds;
+        if (++cpuSamples < SAMPLES)
+            return false;
+        cpuAverage = cpuTotal / (float)cpuSamples;
+        gpuAverage = gpuSamples ? gpuTotal / (float)gpuSamples : 0.0f;
+        cpuTotal = gpuTotal = 0.0f;
+        cpuSamples = gpuSamples = 0;
+
+        bool gpuBound = gpuAverage >= cpuAverage;
+        float bound = std::max(cpuAverage, gpuAverage);
+        if (bound > targetFrameTime)
+        {
+            underSince = 0.0;
+            if (gpuBound && holdGpu)
+                return false;
+            return lower(gpuBound ? QUALITY_ANISOTROPY : QUALITY_SIMULATION,
+                         gpuBound ? QUALITY_SIMULATION : QUALITY_KNOBS, now);
+        }
+        if (bound >= targetFrameTime * headroom || lowered.empty())
+        {
+            underSince = 0.0;
+            return false;
+        }
+        if (underSince == 0.0)
+            underSince = now;
+        if (now - underSince < std::max(delay, raiseDelay))
+            return false;
+        QualityKnob knob = lowered.back();
+        lowered.pop_back();
+        levels[knob]--;
+        lastRaised = knob;
+        lastRaise = now;
+        underSince = 0.0;
+        changed();
+        std::cout << "quality: " << qualityKnobName(knob) << " up to level " << levels[knob] << '\n';
+        return true;
+    }
+
+    // the anisotropy tier, of the configured one
+    float anisotropyScale() const
+    {
+        return 1.0f / (float)(1 << levels[QUALITY_ANISOTROPY]);
+    }
+
+    // bloom resolution, of its usual
+    float postScale() const
+    {
+        return 1.0f / (float)(1 << levels[QUALITY_POST]);
+    }
+
+    // the tier of the screen space reflections, 0 the full quality
+    int reflectionTier() const
+    {
+        return levels[QUALITY_REFLECTIONS];
+    }
+
+    // emitted particles, of the configured rate
+    float particleScale() const
+    {
+        return 1.0f / (float)(1 << levels[QUALITY_PARTICLES]);
+    }
+
+    // shadow cascades out of cascades, and their resolution of the maps' size
+    int shadowCascades(int cascades) const
+    {
+        return std::max(1, cascades - std::max(0, levels[QUALITY_SHADOWS] - 1));
+    }
+
+    float shadowResolution() const
+    {
+        return levels[QUALITY_SHADOWS] > 0 ? 0.5f : 1.0f;
+    }
+
+    // the screen error the levels of detail may make, of the configured one
+    float lodScale() const
+    {
+        return (float)(1 << levels[QUALITY_LOD]);
+    }
+
+    float simulationScale() const
+    {
+        static const float scales[] = {1.0f, 0.75f, 0.5f};
+        return scales[levels[QUALITY_SIMULATION]];
+    }
+
+    float drawDistanceScale() const
+    {
+        static const float scales[] = {1.0f, 0.7f, 0.5f, 0.35f};
+        return scales[levels[QUALITY_DRAW_DISTANCE]];
+    }
+
+  private:
+    int maxLevels[QUALITY_KNOBS] = {3, 2, 2, 2, 3, 3, 2, 3};
+    size_t seenGpuSamples = 0, skipGpuSamples = 0;
+    size_t cpuSamples = 0, gpuSamples = 0;
+    float cpuTotal = 0.0f, gpuTotal = 0.0f;
+    // the knobs turned down, in order
+    std::vector<QualityKnob> lowered;
+    double underSince = 0.0;
+    // raiseDelay until a level flipped back
+    double delay = 0.0;
+    int lastRaised = -1;
+    double lastRaise = 0.0;
+
+    // the first knob from first to last - 1 that can still go down
+    bool lower(QualityKnob first, QualityKnob last, double now)
+    {
+        for (int knob = first; knob < last; knob++)
+        {
+            if (levels[knob] >= maxLevels[knob])
+                continue;
+            // it was just given back and didn't fit, wait longer before trying again
+            if (knob == lastRaised && now - lastRaise < 2.0 * std::max(delay, raiseDelay))
+                delay = std::min(std::max(delay, raiseDelay) * 2.0, maxRaiseDelay);
+            else if (now - lastRaise > maxRaiseDelay)
+                delay = raiseDelay;
+            levels[knob]++;
+            lowered.push_back((QualityKnob)knob);
+            changed();
+            std::cout << "quality: " << (first == QUALITY_ANISOTROPY ? "gpu" : "cpu") << " bound at "
+                      << std::max(cpuAverage, gpuAverage) << " ms, " << qualityKnobName((QualityKnob)knob)
+                      << " down to level " << levels[knob] << '\n';
+            return true;
+        }
+        return false;
+    }
+
+    // the samples on their way were of frames at the old levels
+    void changed()
+    {
+        cpuTotal = gpuTotal = 0.0f;
+        cpuSamples = gpuSamples = 0;
+        skipGpuSamples = GpuProfiler::FRAMES;
+    }
+};
+
+#endif
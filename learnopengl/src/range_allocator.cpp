@@ -0,0 +1,131 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <cstddef>
+#include <iterator>
+#include <map>
+
+// Offset allocator for sub-allocating ranges of a GPU buffer, in elements (vertices, indices).
+// Free blocks are kept twice: by offset, to merge a freed range with its neighbours, and
+// by size, so allocate() takes the smallest block that fits (best fit) in O(log n).
+// The allocator never touches the buffer itself, the owner grows it and moves data around.
+class RangeAllocator
+{
+  public:
+    size_t capacity = 0;
+    // elements handed out and not yet freed
+    size_t used = 0;
+
+    RangeAllocator(size_t capacity = 0)
+    {
+        grow(capacity);
+    }
+
+    // false when no free block holds count elements, the owner can grow() and retry
+    bool allocate(size_t count, size_t &offset)
+    {
+        if (count == 0)
+        {
+            offset = 0;
+            return true;
+        }
+        auto fit = bySize.lower_bound(count);
+        if (fit == bySize.end())
+            return false;
+        size_t blockSize = fit->first;
+        offset = fit->second;
+        bySize.erase(fit);
+        byOffset.erase(offset);
+        if (blockSize > count)
+            insert(offset + count, blockSize - count);
+        used += count;
+        return true;
+    }
+
+    // returns a range given out by allocate(), merging it with free neighbours
+    void free(size_t offset, size_t count)
+    {
+        if (count == 0)
+            return;
+        used -= count;
+
+        auto next = byOffset.lower_bound(offset);
+        if (next != byOffset.end() && offset + count == next->first)
+        {
+            count += next->second;
+            eraseSize(next->first, next->second);
+            next = byOffset.erase(next);
+        }
+        if (next != byOffset.begin())
+        {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset)
+            {
+                offset = previous->first;
+                count += previous->second;
+                eraseSize(previous->first, previous->second);
+                byOffset.erase(previous);
+            }
+        }
+        insert(offset, count);
+    }
+
+    // adds the elements from capacity up to newCapacity as free space
+    void grow(size_t newCapacity)
+    {
+        if (newCapacity <= capacity)
+            return;
+        size_t old = capacity;
+        capacity = newCapacity;
+        // used is restored, free() only merges the new space into a trailing free block
+        used += newCapacity - old;
+        free(old, newCapacity - old);
+    }
+
+    // everything free again, e.g. before packing the live ranges from offset 0
+    void reset()
+    {
+        byOffset.clear();
+        bySize.clear();
+        used = 0;
+        if (capacity)
+            insert(0, capacity);
+    }
+
+    size_t largestFree() const
+    {
+        return bySize.empty() ? 0 : bySize.rbegin()->first;
+    }
+
+    // free space split over more than one block, worth a defragment when large
+    size_t fragmented() const
+    {
+        return capacity - used - largestFree();
+    }
+
+  private:
+    // offset -> size and size -> offset of every free block
+    std::map<size_t, size_t> byOffset;
+    std::multimap<size_t, size_t> bySize;
+
+    void insert(size_t offset, size_t count)
+    {
+        byOffset[offset] = count;
+        bySize.emplace(count, offset);
+    }
+
+    void eraseSize(size_t offset, size_t count)
+    {
+        auto range = bySize.equal_range(count);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == offset)
+            {
+                bySize.erase(it);
+                return;
+            }
+        }
+    }
+};
+
+#endif
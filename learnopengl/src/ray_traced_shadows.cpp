@@ -0,0 +1,159 @@
+#ifndef RAY_TRACED_SHADOWS_H
+#define RAY_TRACED_SHADOWS_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "frame_data.cpp"
+#include "gbuffer.cpp"
+#include "shader.cpp"
+#include "shader_compiler.cpp"
+#include "texture.cpp"
+#include "triangle_bvh.cpp"
+
+#include <cstdint>
+
+// The sun's shadows of the deferred path traced against the TriangleBvh of the static geometry
+// instead of drawn into cascades: after the G-buffer is filled, shader_src/rt_shadows.comp
+// - reconstructs a surface of every 2x2 block from the depth and normals, a different one of
+//   the four every frame, and casts one ray from it towards a point of the sun's disc, so the
+//   penumbrae widen with the distance to the caster;
+// - with DENOISE blurs the one bit results over 5x5 of their neighbours weighted by depth and
+//   normal, and blends that with last frame's result at the same world position, kept here
+//   with the view depth it is of.
+// deferred_ambient.fs (SHADER_RAY_TRACED_SHADOWS) upsamples it by the depths of the four
+// nearest blocks. Nothing is drawn from the sun's view, moving objects aren't in the hierarchy
+// and cast no sun shadow.
+class RayTracedShadows
+{
+  public:
+    static const unsigned int VISIBILITY_UNIT = 18;
+
+    // of the sun's disc, in radians
+    float sunRadius = 0.02f;
+    // the rays start this far off the surface along its normal, in world units
+    float bias = 0.02f;
+    float maxDistance = 200.0f;
+    // the weight of this frame's result against the history
+    float feedback = 0.2f;
+
+    RayTracedShadows(ShaderCompiler &compiler, const TriangleBvh &bvh)
+        : traceShader(compiler.submitCompute("src/shader_src/rt_shadows.comp")),
+          denoiseShader(compiler.submitCompute("src/shader_src/rt_shadows.comp", {"DENOISE"})), bvh(bvh)
+    {
+    }
+
+    RayTracedShadows(const RayTracedShadows &) = delete;
+    RayTracedShadows &operator=(const RayTracedShadows &) = delete;
+
+    // the hierarchy's storage blocks and image load/store in compute, and a unit past the 18 in use
+    static bool isSupported()
+    {
+        if (!TriangleBvh::isSupported())
+            return false;
+        GLint units = 0;
+        glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &units);
+        return units > (GLint)VISIBILITY_UNIT;
+    }
+
+    // points a program built with RAY_TRACED_SHADOWS at the visibility
+    void attach(Shader &program)
+    {
+        program.use();
+        program.setInt("sunVisibility", VISIBILITY_UNIT);
+    }
+
+    // traces and denoises the sun's visibility of the filled gbuffer, whose depth is depth,
+    // towards sunDirection, drawn with viewProjection; leaves the result bound
+    void trace(const GBuffer &gbuffer, const Texture2D &depth, const glm::vec3 &sunDirection,
+               const glm::mat4 &viewProjection, bool reversedZ)
+    {
+        int width = (gbuffer.width + 1) / 2, height = (gbuffer.height + 1) / 2;
+        if (width != traced.width || height != traced.height)
+        {
+            traced.create(width, height, GL_R8, 1, GPU_MEMORY_RENDER_TARGETS);
+            for (Texture2D &target : history)
+                target.create(width, height, GL_RG16F, 1, GPU_MEMORY_RENDER_TARGETS);
+            historyValid = false;
+        }
+        if (!traceLocs.inverseViewProjection.valid())
+        {
+            for (int i = 0; i < 2; i++)
+            {
+                Shader &program = i == 0 ? traceShader : denoiseShader;
+                program.use();
+                program.setInt("gAlbedo", GBuffer::ALBEDO_UNIT);
+                program.setInt("gNormal", GBuffer::NORMAL_UNIT);
+                program.setInt("gDepth", GBuffer::DEPTH_UNIT);
+                program.bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+                Handles &locs = i == 0 ? traceLocs : denoiseLocs;
+                locs.inverseViewProjection = program.uniform("inverseViewProjection");
+                locs.depthZeroToOne = program.uniform("depthZeroToOne");
+                locs.clearDepth = program.uniform("clearDepth");
+                locs.params = program.uniform("params");
+            }
+            sunDirectionLoc = traceShader.uniform("sunDirection");
+            previousViewProjectionLoc = denoiseShader.uniform("previousViewProjection");
+        }
+        gbuffer.albedo.bind(GBuffer::ALBEDO_UNIT);
+        gbuffer.normal.bind(GBuffer::NORMAL_UNIT);
+        depth.bind(GBuffer::DEPTH_UNIT);
+        bvh.bind();
+        glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+        // picks the texel of its 2x2 block a half resolution texel stands for and the noise
+        float frame = (float)(frames % 64);
+        for (int i = 0; i < 2; i++)
+        {
+            Shader &program = i == 0 ? traceShader : denoiseShader;
+            Handles &locs = i == 0 ? traceLocs : denoiseLocs;
+            program.use();
+            program.set(locs.inverseViewProjection, inverseViewProjection);
+            program.set(locs.depthZeroToOne, reversedZ);
+            program.set(locs.clearDepth, reversedZ ? 0.0f : 1.0f);
+            if (i == 0)
+                program.set(locs.params, glm::vec4(sunRadius, bias, maxDistance, frame));
+            else
+                program.set(locs.params, glm::vec4(feedback, historyValid ? 1.0f : 0.0f, 0.0f, frame));
+        }
+
+        traceShader.use();
+        traceShader.set(sunDirectionLoc, glm::normalize(sunDirection));
+        glBindImageTexture(0, traced.ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8);
+        glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        Texture2D &previous = history[frames % 2], &next = history[(frames + 1) % 2];
+        denoiseShader.use();
+        denoiseShader.set(previousViewProjectionLoc, previousViewProjection);
+        glBindImageTexture(0, traced.ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R8);
+        glBindImageTexture(1, previous.ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG16F);
+        glBindImageTexture(2, next.ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+        glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+        // the lighting fetches it, the next frame's denoise loads it
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        next.bind(VISIBILITY_UNIT);
+
+        previousViewProjection = viewProjection;
+        historyValid = true;
+        frames++;
+    }
+
+  private:
+    struct Handles
+    {
+        UniformHandle inverseViewProjection, depthZeroToOne, clearDepth, params;
+    };
+
+    Shader &traceShader;
+    Shader &denoiseShader;
+    const TriangleBvh &bvh;
+    Handles traceLocs, denoiseLocs;
+    UniformHandle sunDirectionLoc, previousViewProjectionLoc;
+    Texture2D traced;
+    Texture2D history[2];
+    bool historyValid = false;
+    glm::mat4 previousViewProjection = glm::mat4(1.0f);
+    uint64_t frames = 0;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef REDRAW_SCHEDULER_H
+#define REDRAW_SCHEDULER_H
+
+#include "GLFW/glfw3.h"
+
+#include "input.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// what a frame is drawn for, several at once
+enum RedrawReason : unsigned int
+{
+    REDRAW_NONE = 0,
+    // key, button, cursor or scroll events, or the camera still moving from held keys
+    REDRAW_INPUT = 1 << 0,
+    // a new window size, drawn while it settles so it gets committed
+    REDRAW_RESIZE = 1 << 1,
+    // textures, meshes or cells still on their way, their frames show them as they arrive
+    REDRAW_STREAMING = 1 << 2,
+    // something on screen moves by itself: spinning cubes, bodies, lights, particles, sprites
+    REDRAW_ANIMATION = 1 << 3,
+    // asked for with request(), from any thread
+    REDRAW_REQUESTED = 1 << 4
+};
+
+// Draws frames only when something asks for them, for kiosks and laptops left on a still
+// picture. At the top of the loop waitForFrame() gets what the frame before left running
+// and sleeps in glfwWaitEventsTimeout(), which any window event cuts short, until a frame
+// is due: at once for input, resizes and requests; at streamingFps while only loads are in
+// flight; at the full rate while the scene animates; never once everything is still and the
+// last settleFrames were drawn, so the temporal history and GPU timings catch up. With
+// idleFps every frame not drawn for input or a resize comes at most that often once there
+// was no input for idleSeconds, which also works with onDemand off, for a scene that keeps
+// animating. heartbeatSeconds keeps a slow frame going while idle for the file watcher and
+// the periodic reports that run inside the frame.
+class RedrawScheduler
+{
+  public:
+    bool onDemand = false;
+    // 0 keeps the full rate
+    double idleFps = 0.0;
+    double idleSeconds = 5.0;
+    double streamingFps = 20.0;
+    unsigned int settleFrames = 4;
+    // 0 sleeps until an event
+    double heartbeatSeconds = 1.0;
+
+    // frames drawn and time spent waiting for them
+    uint64_t frames = 0;
+    double sleptSeconds = 0.0;
+
+    bool enabled() const
+    {
+        return onDemand || idleFps > 0.0;
+    }
+
+    // a frame soon, for reasons; thread safe, wakes the main thread when it is waiting
+    void request(unsigned int reasons = REDRAW_REQUESTED)
+    {
+        requested |= reasons;
+        if (waiting)
+            glfwPostEmptyEvent();
+    }
+
+    // at the top of the loop, busy being what the frame before left running; returns once the
+    // next frame is due, with the reasons for it, right away when neither mode is on
+    unsigned int waitForFrame(unsigned int busy, const InputSystem &input)
+    {
+        frames++;
+        unsigned int reasons = busy | requested.exchange(0);
+        if (!enabled())
+            return reasons;
+        double now = glfwGetTime();
+        if (lastFrame == 0.0)
+            lastActivity = lastFrame = now;
+        while (true)
+        {
+            if (input.hasQueuedEvents())
+                reasons |= REDRAW_INPUT;
+            if (reasons & (REDRAW_INPUT | REDRAW_RESIZE))
+                lastActivity = now;
+            double due = dueTime(reasons, now);
+            if (now >= due)
+                break;
+            waiting = true;
+            // a request from another thread before waiting was set would otherwise sleep through
+            if (requested.load() == 0 && due == NEVER)
+                glfwWaitEvents();
+            else if (requested.load() == 0)
+                glfwWaitEventsTimeout(due - now);
+            waiting = false;
+            double woke = glfwGetTime();
+            sleptSeconds += woke - now;
+            now = woke;
+            reasons |= requested.exchange(0);
+        }
+        settling = reasons & ~REDRAW_ANIMATION ? settleFrames : settling > 0 ? settling - 1 : 0;
+        lastFrame = now;
+        return reasons;
+    }
+
+    // the longest frame time the frame after a wait acts on, or a key pressed on a picture
+    // that stood still for a minute moves the camera by all of it
+    float deltaLimit() const
+    {
+        return (float)std::max(0.1, idleFps > 0.0 ? 1.0 / idleFps : 0.0);
+    }
+
+    std::string report(double seconds) const
+    {
+        return "redraw: " + std::to_string(frames) + " frames in " + std::to_string((int)seconds) + " s, " +
+               std::to_string((int)(seconds > 0.0 ? sleptSeconds / seconds * 100.0 : 0.0)) + "% waiting\n";
+    }
+
+  private:
+    static constexpr double NEVER = 1e300;
+
+    std::atomic<unsigned int> requested{0};
+    std::atomic<bool> waiting{false};
+    double lastFrame = 0.0;
+    double lastActivity = 0.0;
+    // frames left to draw after the last reason other than animation went away
+    unsigned int settling = 0;
+
+    double dueTime(unsigned int reasons, double now) const
+    {
+        if (reasons & (REDRAW_INPUT | REDRAW_RESIZE | REDRAW_REQUESTED))
+            return now;
+        bool idle = idleFps > 0.0 && now - lastActivity >= idleSeconds;
+        double idleDue = idle ? lastFrame + 1.0 / idleFps : now;
+        if (reasons & REDRAW_ANIMATION || settling > 0 || !onDemand)
+            return idleDue;
+        if (reasons & REDRAW_STREAMING)
+            return std::max(idleDue, lastFrame + 1.0 / streamingFps);
+        return heartbeatSeconds > 0.0 ? std::max(idleDue, lastFrame + heartbeatSeconds) : NEVER;
+    }
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include "benchmark.cpp"
+#include "json.cpp"
+
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// a compared number of BenchmarkResult, below floor a change counts as noise
+struct RegressionMetric
+{
+    const char *name;
+    float BenchmarkResult::*value;
+    float floor;
+};
+
+inline const std::vector<RegressionMetric> &regressionMetrics()
+{
+    static const std::vector<RegressionMetric> metrics = {
+        {"shader_ms", &BenchmarkResult::shaderMs, 1.0f},
+        {"texture_ms", &BenchmarkResult::textureMs, 1.0f},
+        {"cpu_ms", &BenchmarkResult::cpuMs, 0.05f},
+        {"gpu_ms", &BenchmarkResult::gpuMs, 0.05f},
+        {"submit_ms", &BenchmarkResult::submitMs, 0.05f},
+        {"cpu_per_draw_us", &BenchmarkResult::microsecondsPerDraw, 0.1f},
+        {"shader_instructions", &BenchmarkResult::shaderInstructions, 8.0f},
+    };
+    return metrics;
+}
+
+// Results of the benchmark matrix, see --regression in main.cpp. A baseline file keeps one
+// object per run keyed by its name, compare() flags every metric that got slower than the
+// baseline by more than threshold, draw counts only have to match.
+class RegressionSuite
+{
+  public:
+    // relative slowdown that counts as a regression
+    float threshold = 0.1f;
+    std::vector<BenchmarkResult> results;
+
+    bool writeBaseline(const std::string &path) const
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cout << "ERROR::REGRESSION::CANNOT_WRITE: " << path << '\n';
+            return false;
+        }
+        out << "{\n  \"runs\": {";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const BenchmarkResult &result = results[i];
+            out << (i ? "," : "") << "\n    \"" << result.name << "\": {\"draw_calls\": " << result.drawCalls;
+            for (const RegressionMetric &metric : regressionMetrics())
+                out << ", \"" << metric.name << "\": " << result.*metric.value;
+            out << "}";
+        }
+        out << "\n  }\n}\n";
+        return true;
+    }
+
+    // prints every run next to its baseline, returns the number of regressed metrics
+    // or -1 when the baseline can't be read
+    int compare(const std::string &path) const
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream text;
+        text << file.rdbuf();
+        std::string source = text.str(), error;
+        JsonValue baseline;
+        if (!file || !parseJson(source.data(), source.size(), baseline, error))
+        {
+            std::cout << "ERROR::REGRESSION::INVALID_BASELINE: " << path << " " << error << '\n';
+            return -1;
+        }
+
+        int regressions = 0;
+        std::cout << std::fixed << std::setprecision(3);
+        for (const BenchmarkResult &result : results)
+        {
+            const JsonValue &run = baseline["runs"][result.name.c_str()];
+            std::cout << result.name << '\n';
+            if (run.isNull())
+            {
+                std::cout << "  not in the baseline\n";
+                continue;
+            }
+            float draws = (float)run["draw_calls"].asNumber();
+            if (std::fabs(draws - result.drawCalls) > 0.5f)
+                std::cout << "  draw calls " << draws << " -> " << result.drawCalls << " (different work)\n";
+            for (const RegressionMetric &metric : regressionMetrics())
+            {
+                // baselines written before a metric was added
+                if (run[metric.name].isNull())
+                    continue;
+                float before = (float)run[metric.name].asNumber(), after = result.*metric.value;
+                bool regressed = after - before > metric.floor && after > before * (1.0f + threshold);
+                float change = before > 0.0f ? (after / before - 1.0f) * 100.0f : 0.0f;
+                std::cout << "  " << std::left << std::setw(16) << metric.name << std::right << std::setw(10)
+                          << before << " -> " << std::setw(10) << after << std::setw(9) << std::setprecision(1)
+                          << change << "%" << std::setprecision(3) << (regressed ? "  REGRESSION" : "") << '\n';
+                if (regressed)
+                    regressions++;
+            }
+        }
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout << "regression: " << regressions << " metrics over " << threshold * 100.0f << "% slower\n";
+        return regressions;
+    }
+};
+
+#endif
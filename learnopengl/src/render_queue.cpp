@@ -0,0 +1,259 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "job_system.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// draw order groups, lower layers are drawn first
+enum RenderLayer
+{
+    RENDER_LAYER_OPAQUE = 0,
+    RENDER_LAYER_TRANSPARENT = 1,
+    // transparent draws composited order-independently (oit.cpp), in any order
+    RENDER_LAYER_WEIGHTED = 2
+};
+
+// one queued draw, source and index tell the caller what to draw
+struct RenderItem
+{
+    uint64_t key;
+    uint32_t source;
+    uint32_t index;
+};
+
+// the draws one job of RenderQueue::record() adds, filled by that job's thread alone
+class RenderBucket
+{
+  public:
+    std::vector<RenderItem> items;
+
+    void add(uint64_t key, uint32_t source, uint32_t index)
+    {
+        items.push_back({key, source, index});
+    }
+};
+
+// Draws recorded during a frame, sorted by a 64-bit key and then submitted in key order.
+// Opaque keys hold layer | program | material | VAO | depth, so every program and material
+// is switched to once and each group is drawn front to back for early depth rejection.
+// Transparent keys put the inverted depth right after the layer, so they are drawn
+// back to front and only group state among draws at the same depth. Weighted ones don't
+// depend on the order and are keyed like the opaque ones.
+// Program, material and VAO are packed as their low bits, two ids sharing them only
+// costs a state change, the draw itself comes from source and index.
+// Many draws are recorded on the JobSystem by record(), every job into a RenderBucket of its
+// own so the threads share nothing, and sorted by sort(jobs), which splits each radix pass
+// over chunks of the items; both give the same order as add() and sort() on one thread.
+class RenderQueue
+{
+  public:
+    static const int DEPTH_BITS = 24;
+    static const int PROGRAM_BITS = 8;
+    static const int MATERIAL_BITS = 16;
+    static const int VAO_BITS = 14;
+    // items a job of sort(jobs) counts and scatters per pass, fewer than two chunks go to sort()
+    static const size_t SORT_CHUNK = 16384;
+
+    std::vector<RenderItem> items;
+
+    void clear()
+    {
+        items.clear();
+    }
+
+    // depth is the view distance divided by the far plane, clamped to [0, 1]
+    static uint64_t makeKey(RenderLayer layer, unsigned int program, unsigned int material, unsigned int vao,
+                            float depth)
+    {
+        uint64_t depthBits = quantizeDepth(depth);
+        uint64_t state = (uint64_t)(program & mask(PROGRAM_BITS)) << (MATERIAL_BITS + VAO_BITS) |
+                         (uint64_t)(material & mask(MATERIAL_BITS)) << VAO_BITS | (vao & mask(VAO_BITS));
+        uint64_t key = (uint64_t)layer << 62;
+        if (layer == RENDER_LAYER_TRANSPARENT)
+            key |= (mask(DEPTH_BITS) - depthBits) << (PROGRAM_BITS + MATERIAL_BITS + VAO_BITS) | state;
+        else
+            key |= state << DEPTH_BITS | depthBits;
+        return key;
+    }
+
+    void add(uint64_t key, uint32_t source, uint32_t index)
+    {
+        items.push_back({key, source, index});
+    }
+
+    // calls function(i, bucket) for every i in [0, count) over jobs in ranges of grain, each
+    // range adding to a bucket of its own, then appends the buckets in the order of the ranges
+    template <typename Function> void record(JobSystem &jobs, size_t count, size_t grain, Function function)
+    {
+        grain = std::max<size_t>(grain, 1);
+        size_t ranges = (count + grain - 1) / grain;
+        if (buckets.size() < ranges)
+            buckets.resize(ranges);
+        jobs.parallelFor(0, count, grain, [&](size_t first, size_t last) {
+            RenderBucket &bucket = buckets[first / grain];
+            bucket.items.clear();
+            for (size_t i = first; i < last; i++)
+                function(i, bucket);
+        });
+
+        bucketOffsets.resize(ranges);
+        size_t total = items.size();
+        for (size_t r = 0; r < ranges; r++)
+        {
+            bucketOffsets[r] = total;
+            total += buckets[r].items.size();
+        }
+        items.resize(total);
+        jobs.parallelFor(0, ranges, 1, [&](size_t first, size_t last) {
+            for (size_t r = first; r < last; r++)
+            {
+                const std::vector<RenderItem> &bucket = buckets[r].items;
+                if (!bucket.empty())
+                    std::memcpy(items.data() + bucketOffsets[r], bucket.data(), bucket.size() * sizeof(RenderItem));
+            }
+        });
+    }
+
+    // sort() with every pass split over jobs by chunks of SORT_CHUNK items: each chunk counts
+    // its digits, and scatters its items behind those of the same digit in the earlier chunks
+    void sort(JobSystem &jobs)
+    {
+        size_t count = items.size();
+        if (count < 2 * SORT_CHUNK || jobs.workerCount() == 0)
+        {
+            sort();
+            return;
+        }
+        scratch.resize(count);
+        size_t chunks = (count + SORT_CHUNK - 1) / SORT_CHUNK;
+
+        // the digits of all eight passes in one read, tells which passes can be skipped and
+        // already holds the first pass' counts
+        chunkHistograms.assign(chunks * 8 * 256, 0);
+        jobs.parallelFor(0, chunks, 1, [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; c++)
+            {
+                uint32_t *histograms = chunkHistograms.data() + c * 8 * 256;
+                for (size_t n = c * SORT_CHUNK; n < std::min(count, (c + 1) * SORT_CHUNK); n++)
+                {
+                    for (int pass = 0; pass < 8; pass++)
+                        histograms[pass * 256 + ((items[n].key >> (pass * 8)) & 0xFF)]++;
+                }
+            }
+        });
+        bool sorted[8];
+        for (int pass = 0; pass < 8; pass++)
+        {
+            size_t digit = (items[0].key >> (pass * 8)) & 0xFF, same = 0;
+            for (size_t c = 0; c < chunks; c++)
+                same += chunkHistograms[(c * 8 + pass) * 256 + digit];
+            sorted[pass] = same == count;
+        }
+
+        bool counted = true;
+        for (int pass = 0; pass < 8; pass++)
+        {
+            if (sorted[pass])
+                continue;
+            if (!counted)
+            {
+                jobs.parallelFor(0, chunks, 1, [&](size_t first, size_t last) {
+                    for (size_t c = first; c < last; c++)
+                    {
+                        uint32_t *histogram = chunkHistograms.data() + (c * 8 + pass) * 256;
+                        std::fill(histogram, histogram + 256, 0u);
+                        for (size_t n = c * SORT_CHUNK; n < std::min(count, (c + 1) * SORT_CHUNK); n++)
+                            histogram[(items[n].key >> (pass * 8)) & 0xFF]++;
+                    }
+                });
+            }
+            counted = false;
+
+            // the chunks' counts become where each of them writes its first item of a digit
+            uint32_t offset = 0;
+            for (int digit = 0; digit < 256; digit++)
+            {
+                for (size_t c = 0; c < chunks; c++)
+                {
+                    uint32_t &slot = chunkHistograms[(c * 8 + pass) * 256 + digit];
+                    uint32_t bucket = slot;
+                    slot = offset;
+                    offset += bucket;
+                }
+            }
+            jobs.parallelFor(0, chunks, 1, [&](size_t first, size_t last) {
+                for (size_t c = first; c < last; c++)
+                {
+                    uint32_t *histogram = chunkHistograms.data() + (c * 8 + pass) * 256;
+                    for (size_t n = c * SORT_CHUNK; n < std::min(count, (c + 1) * SORT_CHUNK); n++)
+                        scratch[histogram[(items[n].key >> (pass * 8)) & 0xFF]++] = items[n];
+                }
+            });
+            items.swap(scratch);
+        }
+    }
+
+    // LSD radix sort over the 8 key bytes, stable, passes where every key has
+    // the same byte are skipped
+    void sort()
+    {
+        size_t count = items.size();
+        if (count < 2)
+            return;
+        scratch.resize(count);
+
+        size_t histograms[8][256] = {};
+        for (const RenderItem &item : items)
+        {
+            for (int pass = 0; pass < 8; pass++)
+                histograms[pass][(item.key >> (pass * 8)) & 0xFF]++;
+        }
+
+        for (int pass = 0; pass < 8; pass++)
+        {
+            size_t *histogram = histograms[pass];
+            if (histogram[(items[0].key >> (pass * 8)) & 0xFF] == count)
+                continue;
+
+            size_t offset = 0;
+            for (int digit = 0; digit < 256; digit++)
+            {
+                size_t bucket = histogram[digit];
+                histogram[digit] = offset;
+                offset += bucket;
+            }
+            for (const RenderItem &item : items)
+                scratch[histogram[(item.key >> (pass * 8)) & 0xFF]++] = item;
+            items.swap(scratch);
+        }
+    }
+
+  private:
+    std::vector<RenderItem> scratch;
+    std::vector<RenderBucket> buckets;
+    std::vector<size_t> bucketOffsets;
+    // per chunk of sort(jobs), 256 counts for each of the eight passes
+    std::vector<uint32_t> chunkHistograms;
+
+    static uint64_t mask(int bits)
+    {
+        return ((uint64_t)1 << bits) - 1;
+    }
+
+    static uint64_t quantizeDepth(float depth)
+    {
+        if (!(depth > 0.0f))
+            return 0;
+        if (depth >= 1.0f)
+            return mask(DEPTH_BITS);
+        return (uint64_t)(depth * (float)mask(DEPTH_BITS));
+    }
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include "glad/glad.h"
+
+#include "gl_extensions.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Counters of what a frame sent to the driver, bumped at the draw and uniform call sites and
+// cleared by resetFrame(). The video memory textures and buffers take is in gpu_memory.cpp.
+struct RenderStats
+{
+    unsigned int drawCalls = 0;
+    // an indirect draw counts as the commands it was given, before GPU culling
+    uint64_t triangles = 0;
+    unsigned int uniformUploads = 0;
+    // Shader::set() calls dropped because the program already held the value
+    unsigned int uniformSkips = 0;
+    // called by every countDraw() when set, before the draw (see pipeline_warmup.cpp)
+    void (*drawHook)() = NULL;
+
+    void resetFrame()
+    {
+        drawCalls = 0;
+        triangles = 0;
+        uniformUploads = 0;
+        uniformSkips = 0;
+    }
+
+    void countDraw(size_t indexCount, size_t instanceCount = 1)
+    {
+        if (drawHook)
+            drawHook();
+        drawCalls++;
+        triangles += (uint64_t)(indexCount / 3) * instanceCount;
+    }
+
+    // bytes of glTexStorage for the formats the loaders create, block compressed ones in 4x4 blocks
+    static uint64_t storageBytes(GLenum internalFormat, int width, int height, int layers, int levels)
+    {
+        uint64_t total = 0;
+        for (int level = 0; level < levels; level++)
+        {
+            uint64_t w = (uint64_t)std::max(1, width >> level), h = (uint64_t)std::max(1, height >> level);
+            uint64_t blocks = ((w + 3) / 4) * ((h + 3) / 4);
+            switch (internalFormat)
+            {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+                total += blocks * 8;
+                break;
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                total += blocks * 16;
+                break;
+            case GL_R8:
+                total += w * h;
+                break;
+            case GL_RG8:
+                total += w * h * 2;
+                break;
+            case GL_RGBA16F:
+                total += w * h * 8;
+                break;
+            case GL_RGB8:
+                // drivers pad it to four bytes
+            default:
+                total += w * h * 4;
+                break;
+            }
+        }
+        return total * (uint64_t)layers;
+    }
+};
+
+// the counters of the main context
+inline RenderStats renderStats;
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include "glad/glad.h"
+
+#include "gl_objects.cpp"
+#include "texture.cpp"
+
+#include <iostream>
+
+// Offscreen framebuffer with an RGBA8 color and a 32-bit float depth attachment, for
+// depth formats the default framebuffer doesn't offer (reversed-Z wants float depth).
+// The frame is drawn into it and blitted to the window before the swap, or with an
+// RGBA16F colorFormat kept in HDR for the post-processing (post_process.cpp).
+class RenderTarget
+{
+  public:
+    unsigned int FBO = 0;
+    Texture2D color;
+    Texture2D depth;
+    int width = 0, height = 0;
+    // set before the first resize()
+    GLenum colorFormat = GL_RGBA8;
+
+    ~RenderTarget()
+    {
+        if (FBO)
+            glDeleteFramebuffers(1, &FBO);
+    }
+
+    // (re)creates the attachments when the size changed, false when incomplete
+    bool resize(int w, int h)
+    {
+        if (w <= 0 || h <= 0)
+            return false;
+        if (FBO && w == width && h == height)
+            return true;
+        width = w;
+        height = h;
+        color.create(width, height, colorFormat, 1, GPU_MEMORY_RENDER_TARGETS);
+        depth.create(width, height, GL_DEPTH_COMPONENT32F, 1, GPU_MEMORY_RENDER_TARGETS);
+
+        if (!FBO)
+            FBO = createFramebuffer();
+        GLenum status;
+        if (hasDSA())
+        {
+            glNamedFramebufferTexture(FBO, GL_COLOR_ATTACHMENT0, color.ID, 0);
+            glNamedFramebufferTexture(FBO, GL_DEPTH_ATTACHMENT, depth.ID, 0);
+            status = glCheckNamedFramebufferStatus(FBO, GL_FRAMEBUFFER);
+        }
+        else
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color.ID, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth.ID, 0);
+            status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::RENDER_TARGET::INCOMPLETE: 0x" << std::hex << status << std::dec << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    // draws and reads (e.g. the Hi-Z depth copy) go to this target
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    }
+
+    // copies the color to the default framebuffer and leaves that bound
+    void blitToDefault() const
+    {
+        if (hasDSA())
+        {
+            glBlitNamedFramebuffer(FBO, 0, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        else
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+};
+
+#endif
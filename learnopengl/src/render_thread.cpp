@@ -0,0 +1,109 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+#include "command_stream.cpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Owns the GL context on a thread of its own and replays the CommandStreams the update
+// thread submits, then swaps. There are two streams: while one frame is replayed the next
+// one is recorded into the other, so CPU frame work overlaps driver time by one frame.
+// Event polling stays on the thread that created the window, as GLFW requires.
+class RenderThread
+{
+  public:
+    // frames replayed so far
+    unsigned long framesRendered = 0;
+
+    ~RenderThread()
+    {
+        stop();
+    }
+
+    // takes the window's context away from the calling thread
+    void start(GLFWwindow *renderWindow)
+    {
+        window = renderWindow;
+        glfwMakeContextCurrent(NULL);
+        running = true;
+        worker = std::thread(&RenderThread::run, this);
+    }
+
+    // waits for the last frame and gives the context back to the calling thread
+    void stop()
+    {
+        if (!worker.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_all();
+        worker.join();
+        glfwMakeContextCurrent(window);
+    }
+
+    // the stream for the next frame, the render thread isn't reading it
+    CommandStream &record()
+    {
+        return streams[recording];
+    }
+
+    // hands the recorded frame over, blocks while the previous one is still replayed
+    void submit()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return !busy; });
+        submitted = recording;
+        busy = true;
+        recording ^= 1;
+        streams[recording].reset();
+        lock.unlock();
+        wake.notify_all();
+    }
+
+  private:
+    GLFWwindow *window = NULL;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    CommandStream streams[2];
+    int recording = 0;
+    int submitted = 0;
+    bool busy = false;
+    bool running = false;
+
+    void run()
+    {
+        glfwMakeContextCurrent(window);
+        // the state cache was filled by the thread that had the context before
+        glState.invalidate();
+        while (true)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return busy || !running; });
+            if (!busy)
+                break;
+            const CommandStream &stream = streams[submitted];
+            lock.unlock();
+
+            stream.replay();
+            glfwSwapBuffers(window);
+            startupTimeline.markFirstFrame();
+
+            lock.lock();
+            framesRendered++;
+            busy = false;
+            lock.unlock();
+            done.notify_all();
+        }
+        glfwMakeContextCurrent(NULL);
+    }
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef RESIZE_MANAGER_H
+#define RESIZE_MANAGER_H
+
+#include <cstdint>
+
+// Window resizes, debounced. The framebuffer size callback only records the newest size with
+// request(); the frame calls update() once and gets true when a size is committed, which
+// happens once the window kept it for settleSeconds. A live drag that sends a size per mouse
+// move thus reallocates the render targets and rebuilds the projection once when it stops,
+// instead of once per size it passed through, and the frames in between keep drawing at the
+// last committed size. A minimized window (0 x 0) keeps the targets it had.
+class ResizeManager
+{
+  public:
+    double settleSeconds = 0.1;
+    // the committed framebuffer size, what the frame renders at
+    int width = 0;
+    int height = 0;
+    // sizes requested and committed so far
+    uint64_t requests = 0;
+    uint64_t commits = 0;
+
+    // the size the window was created with, committed as it is
+    void init(int w, int h)
+    {
+        width = w;
+        height = h;
+        pending = false;
+    }
+
+    // from the GLFW callback, inside glfwPollEvents on the main thread
+    void request(int w, int h, double now)
+    {
+        if (w <= 0 || h <= 0)
+            return;
+        requests++;
+        pendingWidth = w;
+        pendingHeight = h;
+        requestTime = now;
+        pending = w != width || h != height;
+    }
+
+    // once per frame, true when the size changed and the targets and projection must follow
+    bool update(double now)
+    {
+        if (!pending || now - requestTime < settleSeconds)
+            return false;
+        width = pendingWidth;
+        height = pendingHeight;
+        pending = false;
+        commits++;
+        return true;
+    }
+
+    float aspectRatio() const
+    {
+        return height > 0 ? (float)width / (float)height : 1.0f;
+    }
+
+    // a size waits for the window to settle
+    bool settling() const
+    {
+        return pending;
+    }
+
+  private:
+    bool pending = false;
+    int pendingWidth = 0;
+    int pendingHeight = 0;
+    double requestTime = 0.0;
+};
+
+#endif
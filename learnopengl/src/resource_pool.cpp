@@ -0,0 +1,210 @@
+#ifndef RESOURCE_POOL_H
+#define RESOURCE_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// A typed reference into a ResourcePool<T>: the slot and the generation it was created in.
+// A destroyed resource's slot moves to the next generation, so old handles to it (and to
+// whatever reuses the slot later) look up NULL instead of the wrong object.
+template <typename T> struct ResourceHandle
+{
+    uint32_t index = 0;
+    // 0 is never a live generation, a default handle is null
+    uint32_t generation = 0;
+
+    bool valid() const
+    {
+        return generation != 0;
+    }
+
+    bool operator==(const ResourceHandle &other) const
+    {
+        return index == other.index && generation == other.generation;
+    }
+
+    bool operator!=(const ResourceHandle &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// Slot array of GL resources (buffers, textures, programs, meshes, ...) addressed by
+// ResourceHandle. Lookups are an index and a generation compare, objects are built in place
+// and never move, so T needs neither copies nor moves. Slots are kept in chunks and freed
+// slots are reused first, forEach() walks them in order.
+// destroy() with a frame retires the handle at once but keeps the object until collect()
+// is told the GPU finished that frame, so draws already submitted can still use it.
+// Shared objects are counted: create() hands out the first reference, acquire() another and
+// release() drops one, destroying the object with the last (see resource_registry.cpp).
+template <typename T> class ResourcePool
+{
+  public:
+    using Handle = ResourceHandle<T>;
+
+    ResourcePool()
+    {
+    }
+
+    ResourcePool(const ResourcePool &) = delete;
+    ResourcePool &operator=(const ResourcePool &) = delete;
+
+    // builds a T from arguments in a free slot
+    template <typename... Arguments> Handle create(Arguments &&...arguments)
+    {
+        uint32_t index;
+        if (!freeSlots.empty())
+        {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
+        {
+            index = (uint32_t)slots.size();
+            slots.emplace_back();
+        }
+        Slot &slot = slots[index];
+        slot.value.emplace(std::forward<Arguments>(arguments)...);
+        slot.live = true;
+        slot.references = 1;
+        live++;
+        return {index, slot.generation};
+    }
+
+    // NULL for null, destroyed and stale handles
+    T *get(Handle handle)
+    {
+        if (handle.index >= slots.size())
+            return NULL;
+        Slot &slot = slots[handle.index];
+        return slot.live && slot.generation == handle.generation ? &*slot.value : NULL;
+    }
+
+    const T *get(Handle handle) const
+    {
+        return const_cast<ResourcePool *>(this)->get(handle);
+    }
+
+    // the object goes right away, only when nothing in flight on the GPU uses it
+    void destroy(Handle handle)
+    {
+        if (!get(handle))
+            return;
+        Slot &slot = slots[handle.index];
+        retire(slot);
+        slot.value.reset();
+        freeSlots.push_back(handle.index);
+    }
+
+    // the handle goes right away, the object once collect() sees frame completed
+    void destroy(Handle handle, uint64_t frame)
+    {
+        if (!get(handle))
+            return;
+        retire(slots[handle.index]);
+        retired.push_back({handle.index, frame});
+    }
+
+    // destroys the retired objects of completedFrame and older ones, call once per frame
+    void collect(uint64_t completedFrame)
+    {
+        size_t kept = 0;
+        for (const Retired &entry : retired)
+        {
+            if (entry.frame <= completedFrame)
+            {
+                slots[entry.index].value.reset();
+                freeSlots.push_back(entry.index);
+            }
+            else
+            {
+                retired[kept++] = entry;
+            }
+        }
+        retired.resize(kept);
+    }
+
+    // one more reference to a live object, a null handle for destroyed and stale ones
+    Handle acquire(Handle handle)
+    {
+        if (!get(handle))
+            return {};
+        slots[handle.index].references++;
+        return handle;
+    }
+
+    // drops a reference, the last one destroys the object once frame completed; true when
+    // that happened
+    bool release(Handle handle, uint64_t frame)
+    {
+        if (!get(handle) || --slots[handle.index].references > 0)
+            return false;
+        destroy(handle, frame);
+        return true;
+    }
+
+    // references held to a live object, 0 for anything else
+    uint32_t references(Handle handle) const
+    {
+        return get(handle) ? slots[handle.index].references : 0;
+    }
+
+    // calls function(handle, object) for every live object in slot order
+    template <typename Function> void forEach(Function function)
+    {
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            Slot &slot = slots[i];
+            if (slot.live)
+                function(Handle{(uint32_t)i, slot.generation}, *slot.value);
+        }
+    }
+
+    // live objects, retired ones awaiting collect() aren't counted
+    size_t size() const
+    {
+        return live;
+    }
+
+    // retired objects still waiting for their frame
+    size_t pending() const
+    {
+        return retired.size();
+    }
+
+  private:
+    struct Slot
+    {
+        std::optional<T> value;
+        uint32_t generation = 1;
+        // false once destroyed, while a retired value may still be there
+        bool live = false;
+        uint32_t references = 0;
+    };
+    struct Retired
+    {
+        uint32_t index;
+        uint64_t frame;
+    };
+
+    // deque grows in chunks without moving the objects
+    std::deque<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<Retired> retired;
+    size_t live = 0;
+
+    void retire(Slot &slot)
+    {
+        slot.live = false;
+        // skips 0 when it wraps, so no live handle is ever null
+        if (++slot.generation == 0)
+            slot.generation = 1;
+        live--;
+    }
+};
+
+#endif
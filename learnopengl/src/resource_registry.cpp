@@ -0,0 +1,80 @@
+#ifndef RESOURCE_REGISTRY_H
+#define RESOURCE_REGISTRY_H
+
+#include "resource_pool.cpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+
+// Content addressed ResourcePool: every object is registered under a hash of what it was
+// built from (vertex and index bytes, encoded image bytes, ...), so importers look it up before
+// they build another copy, and the copies they would have made share one GPU resource.
+// find() and create() each hand out a reference of the pool's count, release() drops it and
+// the last one retires the object, taking the hash out of the registry with it.
+template <typename T> class ResourceRegistry
+{
+  public:
+    using Handle = ResourceHandle<T>;
+
+    ResourcePool<T> pool;
+    // lookups that found a live object, and objects built
+    size_t hits = 0;
+    size_t misses = 0;
+
+    // a reference to the object built from content with hash, null when there is none
+    Handle find(uint64_t hash)
+    {
+        auto found = byHash.find(hash);
+        if (found == byHash.end())
+            return {};
+        Handle handle = pool.acquire(found->second);
+        if (handle.valid())
+            hits++;
+        return handle;
+    }
+
+    // builds a T from arguments under hash, which should have missed find() just before
+    template <typename... Arguments> Handle create(uint64_t hash, Arguments &&...arguments)
+    {
+        misses++;
+        Handle handle = pool.create(std::forward<Arguments>(arguments)...);
+        byHash[hash] = handle;
+        hashes[handle.index] = hash;
+        return handle;
+    }
+
+    // see ResourcePool::release()
+    bool release(Handle handle, uint64_t frame)
+    {
+        if (!pool.release(handle, frame))
+            return false;
+        auto hash = hashes.find(handle.index);
+        if (hash != hashes.end())
+        {
+            auto entry = byHash.find(hash->second);
+            if (entry != byHash.end() && entry->second == handle)
+                byHash.erase(entry);
+            hashes.erase(hash);
+        }
+        return true;
+    }
+
+    T *get(Handle handle)
+    {
+        return pool.get(handle);
+    }
+
+    const T *get(Handle handle) const
+    {
+        return pool.get(handle);
+    }
+
+  private:
+    std::unordered_map<uint64_t, Handle> byHash;
+    // of every live slot, to unregister it on its last release()
+    std::unordered_map<uint32_t, uint64_t> hashes;
+};
+
+#endif
@@ -0,0 +1,745 @@
+#ifndef RIGID_BODIES_H
+#define RIGID_BODIES_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include "job_system.cpp"
+#include "simd_math.cpp"
+#include "transform_system.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+// Boxes of one size falling onto the ground plane y = groundHeight and onto each other, the
+// objects of a TransformSystem: step() moves its positions and writes the orientations back
+// as its axes and angles, so the models its passes build are the bodies'. An object's spin
+// when they are made becomes its angular velocity. Every step:
+// - the world AABBs, SoA, are sorted along x, insertion sort on last step's order since the
+//   bodies barely move, and swept: the following boxes are tested 4 (SSE2) or 8 (AVX) at a
+//   time until one starts past the box's end;
+// - the overlapping pairs are collided on the job system, separating axis test over the 15
+//   axes of two boxes, then the incident face clipped against the reference one or the
+//   closest points of two edges, up to MAX_CONTACTS points a pair;
+// - the touching bodies are joined into islands, the ground joins none, and the islands are
+//   solved on the job system, an island per job: sequential impulses with friction, started
+//   from the impulses a pair's points had last step, then integrated. An island still for
+//   SLEEP_TIME falls asleep and skips both until an awake body touches it.
+// Drawn are the poses of the last step, the interpolate() of TransformSystem interpolates
+// angles about the new axes only.
+class RigidBodies
+{
+  public:
+    static const int MAX_CONTACTS = 8;
+    // solver passes over an island's contacts per step
+    static const int ITERATIONS = 10;
+    static constexpr float SLEEP_TIME = 0.5f;
+
+    glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+    float groundHeight = 0.0f;
+    float friction = 0.6f;
+    // of approaching speeds beyond 1 unit per second
+    float restitution = 0.2f;
+
+    std::vector<glm::vec3> velocity, angularVelocity;
+    std::vector<glm::quat> orientation;
+    // world AABBs of the last step
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    // counters of the last step
+    size_t pairs = 0;
+    size_t contacts = 0;
+    size_t islands = 0;
+    size_t sleeping = 0;
+
+    // every object of transforms a body of halfExtent and unit mass
+    RigidBodies(TransformSystem &transforms, glm::vec3 halfExtent) : transforms(transforms), halfExtent(halfExtent)
+    {
+        // a solid box of unit mass
+        glm::vec3 size = halfExtent * 2.0f;
+        inverseInertia = 12.0f / glm::vec3(size.y * size.y + size.z * size.z, size.x * size.x + size.z * size.z,
+                                           size.x * size.x + size.y * size.y);
+        size_t count = transforms.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            glm::vec3 axis(transforms.axisX[i], transforms.axisY[i], transforms.axisZ[i]);
+            velocity.push_back(glm::vec3(0.0f));
+            angularVelocity.push_back(axis * transforms.angularSpeed[i]);
+            orientation.push_back(glm::angleAxis(transforms.angles[i], axis));
+        }
+        sleepTime.assign(count, 0.0f);
+        minX.resize(count);
+        minY.resize(count);
+        minZ.resize(count);
+        maxX.resize(count);
+        maxY.resize(count);
+        maxZ.resize(count);
+        order.resize(count);
+        std::iota(order.begin(), order.end(), 0u);
+        parent.resize(count);
+        island.resize(count);
+        inverseInertiaWorld.resize(count);
+    }
+
+    RigidBodies(const RigidBodies &) = delete;
+    RigidBodies &operator=(const RigidBodies &) = delete;
+
+    size_t size() const
+    {
+        return velocity.size();
+    }
+
+    // dt seconds, grain bodies or pairs per job
+    void step(JobSystem &jobs, float dt, size_t grain = 1024)
+    {
+        if (size() == 0 || dt <= 0.0f)
+            return;
+        updateBounds(jobs, grain);
+        sweep();
+        pairs = pairList.size();
+
+        // every pair collided into its own manifold, the ground with every body below its top
+        manifolds.resize(pairList.size() + size());
+        jobs.parallelFor(0, pairList.size(), grain / 16 + 1, [&](size_t first, size_t last) {
+            for (size_t n = first; n < last; n++)
+                collideBoxes(pairList[n].a, pairList[n].b, manifolds[n]);
+        });
+        jobs.parallelFor(0, size(), grain, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                collideGround((uint32_t)i, manifolds[pairList.size() + i]);
+        });
+
+        buildIslands();
+        contacts = 0;
+        for (const Manifold &manifold : manifolds)
+            contacts += manifold.count;
+
+        sleepingIslands.assign(islandStarts.size() - 1, 0);
+        jobs.parallelFor(0, islandStarts.size() - 1, 1, [&](size_t first, size_t last) {
+            std::vector<Constraint> constraints;
+            for (size_t n = first; n < last; n++)
+                sleepingIslands[n] = solveIsland(n, dt, constraints);
+        });
+        islands = islandStarts.size() - 1;
+        sleeping = (size_t)std::count(sleepingIslands.begin(), sleepingIslands.end(), 1);
+
+        jobs.parallelFor(0, size(), grain, [&](size_t first, size_t last) { writeTransforms(first, last); });
+
+        // what the touching pairs start the next step with
+        warmStart.clear();
+        for (const Manifold &manifold : manifolds)
+            if (manifold.count)
+                warmStart[pairKey(manifold.a, manifold.b)] = manifold;
+    }
+
+  private:
+    struct Pair
+    {
+        uint32_t a, b;
+    };
+
+    // the points of one pair, the normal points from b to a, a ground contact has b = NONE
+    struct Manifold
+    {
+        uint32_t a = 0, b = 0;
+        int count = 0;
+        glm::vec3 normal = glm::vec3(0.0f);
+        glm::vec3 points[MAX_CONTACTS];
+        float depths[MAX_CONTACTS];
+        // the solved normal and friction impulses of every point
+        glm::vec3 impulses[MAX_CONTACTS];
+    };
+
+    struct Constraint
+    {
+        uint32_t a, b;
+        uint32_t manifold;
+        int point;
+        glm::vec3 normal, tangent, bitangent;
+        glm::vec3 ra, rb;
+        float normalMass, tangentMass, bitangentMass;
+        float bias;
+        float normalImpulse, tangentImpulse, bitangentImpulse;
+    };
+
+    static const uint32_t NONE = 0xFFFFFFFFu;
+    // AABBs grow by this much and points this far apart are contacts already, bodies resting
+    // on each other keep theirs
+    static constexpr float MARGIN = 0.02f;
+    // penetration left to the position bias, and the fraction of the rest it removes per step
+    static constexpr float SLOP = 0.01f;
+    static constexpr float BAUMGARTE = 0.2f;
+    static constexpr float SLEEP_SPEED = 0.05f;
+    static constexpr float WARM_DISTANCE = 0.05f;
+
+    TransformSystem &transforms;
+    glm::vec3 halfExtent;
+    glm::vec3 inverseInertia;
+    std::vector<float> sleepTime;
+    // body indices sorted by minX, kept from step to step
+    std::vector<uint32_t> order;
+    bool swept = false;
+    // the AABBs in that order
+    std::vector<float> sortedMinX, sortedMaxX, sortedMinY, sortedMaxY, sortedMinZ, sortedMaxZ;
+    // of the orientations at the start of the step
+    std::vector<glm::mat3> inverseInertiaWorld;
+    std::vector<Pair> pairList;
+    std::vector<Manifold> manifolds;
+    // union-find parents, then every body's island and the manifolds and bodies grouped by island
+    std::vector<uint32_t> parent, island;
+    std::vector<uint32_t> islandStarts, islandBodies, islandManifoldStarts, islandManifolds;
+    std::vector<char> sleepingIslands;
+    // last step's manifolds by pair, read by every island job
+    std::unordered_map<uint64_t, Manifold> warmStart;
+
+    static uint64_t pairKey(uint32_t a, uint32_t b)
+    {
+        return (uint64_t)a << 32 | b;
+    }
+
+    glm::vec3 position(uint32_t i) const
+    {
+        return glm::vec3(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i]);
+    }
+
+    // the AABB of every box, its half extent along world axes is |R| halfExtent, and its inertia
+    void updateBounds(JobSystem &jobs, size_t grain)
+    {
+        jobs.parallelFor(0, size(), grain, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+            {
+                glm::mat3 rotation = glm::mat3_cast(orientation[i]);
+                glm::mat3 scaled = rotation;
+                for (int k = 0; k < 3; k++)
+                    scaled[k] *= inverseInertia[k];
+                inverseInertiaWorld[i] = scaled * glm::transpose(rotation);
+                glm::vec3 extent(MARGIN);
+                for (int axis = 0; axis < 3; axis++)
+                    extent += glm::abs(rotation[axis]) * halfExtent[axis];
+                glm::vec3 center = position((uint32_t)i);
+                minX[i] = center.x - extent.x;
+                minY[i] = center.y - extent.y;
+                minZ[i] = center.z - extent.z;
+                maxX[i] = center.x + extent.x;
+                maxY[i] = center.y + extent.y;
+                maxZ[i] = center.z + extent.z;
+            }
+        });
+    }
+
+    // pairList gets every pair of overlapping AABBs
+    void sweep()
+    {
+        if (!swept)
+            std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return minX[a] < minX[b]; });
+        swept = true;
+        for (size_t k = 1; k < order.size(); k++)
+        {
+            uint32_t body = order[k];
+            size_t j = k;
+            for (; j > 0 && minX[order[j - 1]] > minX[body]; j--)
+                order[j] = order[j - 1];
+            order[j] = body;
+        }
+        size_t count = order.size();
+        sortedMinX.resize(count);
+        sortedMaxX.resize(count);
+        sortedMinY.resize(count);
+        sortedMaxY.resize(count);
+        sortedMinZ.resize(count);
+        sortedMaxZ.resize(count);
+        for (size_t k = 0; k < count; k++)
+        {
+            uint32_t i = order[k];
+            sortedMinX[k] = minX[i];
+            sortedMaxX[k] = maxX[i];
+            sortedMinY[k] = minY[i];
+            sortedMaxY[k] = maxY[i];
+            sortedMinZ[k] = minZ[i];
+            sortedMaxZ[k] = maxZ[i];
+        }
+
+        pairList.clear();
+        for (size_t k = 0; k < count; k++)
+        {
+            const float endX = sortedMaxX[k], lowY = sortedMinY[k], highY = sortedMaxY[k];
+            const float lowZ = sortedMinZ[k], highZ = sortedMaxZ[k];
+            size_t j = k + 1;
+            bool past = false;
+#if SIMD_AVX
+            for (; j + 8 <= count && !past; j += 8)
+            {
+                __m256 inX = _mm256_cmp_ps(_mm256_loadu_ps(&sortedMinX[j]), _mm256_set1_ps(endX), _CMP_LE_OQ);
+                __m256 belowY = _mm256_cmp_ps(_mm256_loadu_ps(&sortedMinY[j]), _mm256_set1_ps(highY), _CMP_LE_OQ);
+                __m256 aboveY = _mm256_cmp_ps(_mm256_loadu_ps(&sortedMaxY[j]), _mm256_set1_ps(lowY), _CMP_GE_OQ);
+                __m256 belowZ = _mm256_cmp_ps(_mm256_loadu_ps(&sortedMinZ[j]), _mm256_set1_ps(highZ), _CMP_LE_OQ);
+                __m256 aboveZ = _mm256_cmp_ps(_mm256_loadu_ps(&sortedMaxZ[j]), _mm256_set1_ps(lowZ), _CMP_GE_OQ);
+                __m256 inY = _mm256_and_ps(belowY, aboveY), inZ = _mm256_and_ps(belowZ, aboveZ);
+                int xMask = _mm256_movemask_ps(inX);
+                appendPairs(k, j, _mm256_movemask_ps(_mm256_and_ps(inX, _mm256_and_ps(inY, inZ))));
+                // sorted, a lane past the end means every one after it is too
+                past = xMask != 0xFF;
+            }
+#endif
+#if SIMD_SSE2
+            for (; j + 4 <= count && !past; j += 4)
+            {
+                __m128 inX = _mm_cmple_ps(_mm_loadu_ps(&sortedMinX[j]), _mm_set1_ps(endX));
+                __m128 inY = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&sortedMinY[j]), _mm_set1_ps(highY)),
+                                        _mm_cmpge_ps(_mm_loadu_ps(&sortedMaxY[j]), _mm_set1_ps(lowY)));
+                __m128 inZ = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&sortedMinZ[j]), _mm_set1_ps(highZ)),
+                                        _mm_cmpge_ps(_mm_loadu_ps(&sortedMaxZ[j]), _mm_set1_ps(lowZ)));
+                int xMask = _mm_movemask_ps(inX);
+                appendPairs(k, j, _mm_movemask_ps(_mm_and_ps(inX, _mm_and_ps(inY, inZ))));
+                past = xMask != 0xF;
+            }
+#endif
+            for (; j < count && !past; j++)
+            {
+                past = sortedMinX[j] > endX;
+                if (!past && sortedMinY[j] <= highY && sortedMaxY[j] >= lowY && sortedMinZ[j] <= highZ &&
+                    sortedMaxZ[j] >= lowZ)
+                    addPair(order[k], order[j]);
+            }
+        }
+    }
+
+    // the lower index first whatever the order along x, a pair keeps its reference box
+    void addPair(uint32_t a, uint32_t b)
+    {
+        pairList.push_back({std::min(a, b), std::max(a, b)});
+    }
+
+    void appendPairs(size_t k, size_t j, int mask)
+    {
+        for (; mask; mask &= mask - 1)
+        {
+            int lane = 0;
+            while (!(mask & (1 << lane)))
+                lane++;
+            addPair(order[k], order[j + lane]);
+        }
+    }
+
+    // the box's center, axes and half extents
+    void box(uint32_t i, glm::vec3 &center, glm::mat3 &axes) const
+    {
+        center = position(i);
+        axes = glm::mat3_cast(orientation[i]);
+    }
+
+    // contacts of boxes a and b, none when an axis separates them
+    void collideBoxes(uint32_t a, uint32_t b, Manifold &out) const
+    {
+        out.a = a;
+        out.b = b;
+        out.count = 0;
+        glm::vec3 ca, cb;
+        glm::mat3 ra, rb;
+        box(a, ca, ra);
+        box(b, cb, rb);
+        const glm::vec3 offset = ca - cb;
+
+        // 0-2 faces of a, 3-5 faces of b, 6-14 edge pairs; near ties go to the faces of a, then
+        // of b, their contacts are the steadier ones
+        float best = 1e30f, bestOverlap = 0.0f;
+        int bestAxis = -1;
+        glm::vec3 bestNormal(0.0f);
+        for (int n = 0; n < 15; n++)
+        {
+            glm::vec3 axis = n < 3 ? ra[n] : n < 6 ? rb[n - 3] : glm::cross(ra[(n - 6) / 3], rb[(n - 6) % 3]);
+            float length = glm::length(axis);
+            if (length < 1e-4f)
+                continue;
+            axis /= length;
+            float overlap = project(ra, axis) + project(rb, axis) - std::abs(glm::dot(offset, axis));
+            if (overlap < -MARGIN)
+                return;
+            float weighted = n < 3 ? overlap : n < 6 ? overlap + 0.0005f : overlap * 1.05f + 0.001f;
+            if (weighted < best)
+            {
+                best = weighted;
+                bestOverlap = overlap;
+                bestAxis = n;
+                // from b to a
+                bestNormal = glm::dot(offset, axis) < 0.0f ? -axis : axis;
+            }
+        }
+        if (bestAxis < 0)
+            return;
+        out.normal = bestNormal;
+        if (bestAxis < 3)
+            clipFaces(ca, ra, cb, rb, -bestNormal, out);
+        else if (bestAxis < 6)
+            clipFaces(cb, rb, ca, ra, bestNormal, out);
+        else
+        {
+            int i = (bestAxis - 6) / 3, j = (bestAxis - 6) % 3;
+            // the edge of a nearest b and the one of b nearest a
+            glm::vec3 pa = ca, pb = cb;
+            for (int k = 0; k < 3; k++)
+            {
+                if (k != i)
+                    pa += ra[k] * halfExtent[k] * (glm::dot(ra[k], bestNormal) > 0.0f ? -1.0f : 1.0f);
+                if (k != j)
+                    pb += rb[k] * halfExtent[k] * (glm::dot(rb[k], bestNormal) > 0.0f ? 1.0f : -1.0f);
+            }
+            // closest points of the two lines
+            glm::vec3 da = ra[i], db = rb[j], r = pa - pb;
+            float d = glm::dot(da, db), e = glm::dot(da, r), f = glm::dot(db, r);
+            float denominator = 1.0f - d * d;
+            float s = denominator > 1e-6f ? (d * f - e) / denominator : 0.0f;
+            s = glm::clamp(s, -halfExtent[i], halfExtent[i]);
+            float t = glm::clamp(d * s + f, -halfExtent[j], halfExtent[j]);
+            out.points[0] = (pa + da * s + pb + db * t) * 0.5f;
+            out.depths[0] = bestOverlap;
+            out.count = 1;
+        }
+    }
+
+    // the half extent of a box with axes along axis
+    float project(const glm::mat3 &axes, const glm::vec3 &axis) const
+    {
+        return halfExtent.x * std::abs(glm::dot(axes[0], axis)) + halfExtent.y * std::abs(glm::dot(axes[1], axis)) +
+               halfExtent.z * std::abs(glm::dot(axes[2], axis));
+    }
+
+    // the face of the incident box most against the reference box's face with outward normal,
+    // clipped to the reference face's sides; its points below that face or less than MARGIN
+    // above it are the contacts
+    void clipFaces(const glm::vec3 &referenceCenter, const glm::mat3 &reference, const glm::vec3 &incidentCenter,
+                   const glm::mat3 &incident, const glm::vec3 &normal, Manifold &out) const
+    {
+        int face = 0;
+        for (int k = 1; k < 3; k++)
+            if (std::abs(glm::dot(reference[k], normal)) > std::abs(glm::dot(reference[face], normal)))
+                face = k;
+        int incidentFace = 0;
+        for (int k = 1; k < 3; k++)
+            if (std::abs(glm::dot(incident[k], normal)) > std::abs(glm::dot(incident[incidentFace], normal)))
+                incidentFace = k;
+        const int u = (incidentFace + 1) % 3, v = (incidentFace + 2) % 3;
+        float side = glm::dot(incident[incidentFace], normal) > 0.0f ? -1.0f : 1.0f;
+        glm::vec3 faceCenter = incidentCenter + incident[incidentFace] * halfExtent[incidentFace] * side;
+        glm::vec3 eu = incident[u] * halfExtent[u], ev = incident[v] * halfExtent[v];
+        glm::vec3 polygon[2][MAX_CONTACTS];
+        int count = 4;
+        polygon[0][0] = faceCenter - eu - ev;
+        polygon[0][1] = faceCenter + eu - ev;
+        polygon[0][2] = faceCenter + eu + ev;
+        polygon[0][3] = faceCenter - eu + ev;
+
+        // Sutherland-Hodgman against the 4 sides, a quad clipped by 4 planes keeps at most 8 points
+        int current = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            if (k == face)
+                continue;
+            for (float sign : {1.0f, -1.0f})
+            {
+                glm::vec3 planeNormal = reference[k] * sign;
+                float planeOffset = glm::dot(planeNormal, referenceCenter) + halfExtent[k];
+                int kept = 0;
+                for (int n = 0; n < count; n++)
+                {
+                    const glm::vec3 &p = polygon[current][n], &q = polygon[current][(n + 1) % count];
+                    float dp = glm::dot(planeNormal, p) - planeOffset, dq = glm::dot(planeNormal, q) - planeOffset;
+                    if (dp <= 0.0f && kept < MAX_CONTACTS)
+                        polygon[1 - current][kept++] = p;
+                    if (((dp < 0.0f && dq > 0.0f) || (dp > 0.0f && dq < 0.0f)) && kept < MAX_CONTACTS)
+                        polygon[1 - current][kept++] = p + (q - p) * (dp / (dp - dq));
+                }
+                current = 1 - current;
+                count = kept;
+            }
+        }
+
+        glm::vec3 faceNormal = reference[face] * (glm::dot(reference[face], normal) > 0.0f ? 1.0f : -1.0f);
+        float faceOffset = glm::dot(faceNormal, referenceCenter) + halfExtent[face];
+        for (int n = 0; n < count; n++)
+        {
+            float separation = glm::dot(faceNormal, polygon[current][n]) - faceOffset;
+            glm::vec3 point = polygon[current][n] - faceNormal * (separation * 0.5f);
+            // a corner on a side plane comes out twice, once kept and once as the crossing
+            bool repeated = false;
+            for (int k = 0; k < out.count && !repeated; k++)
+                repeated = glm::dot(out.points[k] - point, out.points[k] - point) < 1e-6f;
+            if (separation > MARGIN || repeated)
+                continue;
+            out.points[out.count] = point;
+            out.depths[out.count] = -separation;
+            out.count++;
+        }
+    }
+
+    // the corners of box i below the ground or less than MARGIN above it
+    void collideGround(uint32_t i, Manifold &out) const
+    {
+        out.a = i;
+        out.b = NONE;
+        out.count = 0;
+        out.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        if (minY[i] - MARGIN > groundHeight)
+            return;
+        glm::vec3 center;
+        glm::mat3 axes;
+        box(i, center, axes);
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 p = center;
+            for (int k = 0; k < 3; k++)
+                p += axes[k] * halfExtent[k] * ((corner >> k) & 1 ? 1.0f : -1.0f);
+            if (p.y > groundHeight + MARGIN)
+                continue;
+            out.points[out.count] = glm::vec3(p.x, (p.y + groundHeight) * 0.5f, p.z);
+            out.depths[out.count] = groundHeight - p.y;
+            out.count++;
+        }
+    }
+
+    uint32_t findRoot(uint32_t i)
+    {
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    // the bodies and manifolds grouped by island, a counting sort over the union-find roots
+    void buildIslands()
+    {
+        const size_t count = size();
+        std::iota(parent.begin(), parent.end(), 0u);
+        for (size_t n = 0; n < pairList.size(); n++)
+        {
+            if (!manifolds[n].count)
+                continue;
+            uint32_t a = findRoot(manifolds[n].a), b = findRoot(manifolds[n].b);
+            if (a != b)
+                parent[std::max(a, b)] = std::min(a, b);
+        }
+        islandStarts.clear();
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t root = findRoot((uint32_t)i);
+            if (root == i)
+            {
+                island[i] = (uint32_t)islandStarts.size();
+                islandStarts.push_back(0);
+            }
+            else
+                island[i] = island[root];
+        }
+        const size_t islandCount = islandStarts.size();
+        islandStarts.assign(islandCount + 1, 0);
+        islandManifoldStarts.assign(islandCount + 1, 0);
+        for (size_t i = 0; i < count; i++)
+            islandStarts[island[i] + 1]++;
+        for (const Manifold &manifold : manifolds)
+            if (manifold.count)
+                islandManifoldStarts[island[manifold.a] + 1]++;
+        for (size_t n = 0; n < islandCount; n++)
+        {
+            islandStarts[n + 1] += islandStarts[n];
+            islandManifoldStarts[n + 1] += islandManifoldStarts[n];
+        }
+        islandBodies.resize(count);
+        islandManifolds.resize(islandManifoldStarts.back());
+        std::vector<uint32_t> bodyFill(islandStarts.begin(), islandStarts.end() - 1);
+        std::vector<uint32_t> manifoldFill(islandManifoldStarts.begin(), islandManifoldStarts.end() - 1);
+        for (size_t i = 0; i < count; i++)
+            islandBodies[bodyFill[island[i]]++] = (uint32_t)i;
+        for (size_t n = 0; n < manifolds.size(); n++)
+            if (manifolds[n].count)
+                islandManifolds[manifoldFill[island[manifolds[n].a]]++] = (uint32_t)n;
+    }
+
+    // gravity, the contacts and the integration of one island, true when it sleeps instead
+    bool solveIsland(size_t n, float dt, std::vector<Constraint> &constraints)
+    {
+        const uint32_t *bodies = &islandBodies[islandStarts[n]];
+        const size_t bodyCount = islandStarts[n + 1] - islandStarts[n];
+        float still = 1e30f;
+        for (size_t k = 0; k < bodyCount; k++)
+            still = std::min(still, sleepTime[bodies[k]]);
+        if (still >= SLEEP_TIME)
+        {
+            for (size_t k = 0; k < bodyCount; k++)
+            {
+                velocity[bodies[k]] = glm::vec3(0.0f);
+                angularVelocity[bodies[k]] = glm::vec3(0.0f);
+            }
+            // woken, it starts from nothing
+            for (uint32_t m = islandManifoldStarts[n]; m < islandManifoldStarts[n + 1]; m++)
+                std::fill(manifolds[islandManifolds[m]].impulses, manifolds[islandManifolds[m]].impulses + MAX_CONTACTS,
+                          glm::vec3(0.0f));
+            return true;
+        }
+        for (size_t k = 0; k < bodyCount; k++)
+            velocity[bodies[k]] += gravity * dt;
+
+        // the island's bodies are its own, no other job touches them; every point is prepared
+        // before any impulse is applied, restitution takes the velocities they approach with
+        constraints.clear();
+        for (uint32_t m = islandManifoldStarts[n]; m < islandManifoldStarts[n + 1]; m++)
+        {
+            const Manifold &manifold = manifolds[islandManifolds[m]];
+            for (int p = 0; p < manifold.count; p++)
+            {
+                constraints.push_back(prepare(manifold, p, dt));
+                constraints.back().manifold = islandManifolds[m];
+            }
+        }
+        // then started with the impulse of last step's point nearest each one
+        for (Constraint &c : constraints)
+        {
+            const Manifold &manifold = manifolds[c.manifold];
+            auto previous = warmStart.find(pairKey(manifold.a, manifold.b));
+            int match = previous == warmStart.end() ? -1 : nearestPoint(previous->second, manifold.points[c.point]);
+            if (match < 0)
+                continue;
+            glm::vec3 impulse = previous->second.impulses[match];
+            c.normalImpulse = impulse.x;
+            c.tangentImpulse = impulse.y;
+            c.bitangentImpulse = impulse.z;
+            applyImpulse(c, c.normal * impulse.x + c.tangent * impulse.y + c.bitangent * impulse.z);
+        }
+        for (int iteration = 0; iteration < ITERATIONS; iteration++)
+            for (Constraint &constraint : constraints)
+                solve(constraint);
+        for (const Constraint &c : constraints)
+            manifolds[c.manifold].impulses[c.point] = glm::vec3(c.normalImpulse, c.tangentImpulse, c.bitangentImpulse);
+
+        for (size_t k = 0; k < bodyCount; k++)
+        {
+            uint32_t i = bodies[k];
+            transforms.positionX[i] += velocity[i].x * dt;
+            transforms.positionY[i] += velocity[i].y * dt;
+            transforms.positionZ[i] += velocity[i].z * dt;
+            glm::quat spin(0.0f, angularVelocity[i].x, angularVelocity[i].y, angularVelocity[i].z);
+            orientation[i] = glm::normalize(orientation[i] + spin * orientation[i] * (0.5f * dt));
+            bool slow = glm::dot(velocity[i], velocity[i]) < SLEEP_SPEED * SLEEP_SPEED &&
+                        glm::dot(angularVelocity[i], angularVelocity[i]) < SLEEP_SPEED * SLEEP_SPEED;
+            sleepTime[i] = slow ? sleepTime[i] + dt : 0.0f;
+        }
+        return false;
+    }
+
+    // the point of manifold within WARM_DISTANCE of point, -1 when there is none
+    static int nearestPoint(const Manifold &manifold, const glm::vec3 &point)
+    {
+        int nearest = -1;
+        float best = WARM_DISTANCE * WARM_DISTANCE;
+        for (int p = 0; p < manifold.count; p++)
+        {
+            glm::vec3 offset = manifold.points[p] - point;
+            float distance = glm::dot(offset, offset);
+            if (distance < best)
+            {
+                best = distance;
+                nearest = p;
+            }
+        }
+        return nearest;
+    }
+
+    // the velocity of body i at offset r from its center, 0 for the ground
+    glm::vec3 pointVelocity(uint32_t i, const glm::vec3 &r) const
+    {
+        return i == NONE ? glm::vec3(0.0f) : velocity[i] + glm::cross(angularVelocity[i], r);
+    }
+
+    // the inverse effective mass of both bodies along direction at the contact
+    float inverseMass(const Constraint &c, const glm::vec3 &direction) const
+    {
+        glm::vec3 ra = glm::cross(c.ra, direction);
+        float mass = 1.0f + glm::dot(ra, inverseInertiaWorld[c.a] * ra);
+        if (c.b != NONE)
+        {
+            glm::vec3 rb = glm::cross(c.rb, direction);
+            mass += 1.0f + glm::dot(rb, inverseInertiaWorld[c.b] * rb);
+        }
+        return mass;
+    }
+
+    Constraint prepare(const Manifold &manifold, int p, float dt) const
+    {
+        Constraint c;
+        c.a = manifold.a;
+        c.b = manifold.b;
+        c.point = p;
+        c.normal = manifold.normal;
+        c.ra = manifold.points[p] - position(c.a);
+        c.rb = c.b == NONE ? glm::vec3(0.0f) : manifold.points[p] - position(c.b);
+        c.tangent = std::abs(c.normal.x) > 0.57f ? glm::vec3(c.normal.y, -c.normal.x, 0.0f)
+                                                  : glm::vec3(0.0f, c.normal.z, -c.normal.y);
+        c.tangent = glm::normalize(c.tangent);
+        c.bitangent = glm::cross(c.normal, c.tangent);
+        c.normalMass = 1.0f / inverseMass(c, c.normal);
+        c.tangentMass = 1.0f / inverseMass(c, c.tangent);
+        c.bitangentMass = 1.0f / inverseMass(c, c.bitangent);
+        float approach = glm::dot(pointVelocity(c.a, c.ra) - pointVelocity(c.b, c.rb), c.normal);
+        // a point still apart may close its gap this step and no more
+        float depth = manifold.depths[p];
+        c.bias = depth < 0.0f ? depth / dt : BAUMGARTE / dt * std::max(depth - SLOP, 0.0f);
+        if (approach < -1.0f)
+            c.bias = std::max(c.bias, -restitution * approach);
+        c.normalImpulse = c.tangentImpulse = c.bitangentImpulse = 0.0f;
+        return c;
+    }
+
+    void applyImpulse(const Constraint &c, const glm::vec3 &impulse)
+    {
+        velocity[c.a] += impulse;
+        angularVelocity[c.a] += inverseInertiaWorld[c.a] * glm::cross(c.ra, impulse);
+        if (c.b == NONE)
+            return;
+        velocity[c.b] -= impulse;
+        angularVelocity[c.b] -= inverseInertiaWorld[c.b] * glm::cross(c.rb, impulse);
+    }
+
+    // the accumulated normal impulse stays pushing, the friction ones within friction of it
+    void solve(Constraint &c)
+    {
+        glm::vec3 relative = pointVelocity(c.a, c.ra) - pointVelocity(c.b, c.rb);
+        float impulse = c.normalMass * (c.bias - glm::dot(relative, c.normal));
+        float total = std::max(c.normalImpulse + impulse, 0.0f);
+        applyImpulse(c, c.normal * (total - c.normalImpulse));
+        c.normalImpulse = total;
+
+        float limit = friction * c.normalImpulse;
+        relative = pointVelocity(c.a, c.ra) - pointVelocity(c.b, c.rb);
+        total = glm::clamp(c.tangentImpulse - c.tangentMass * glm::dot(relative, c.tangent), -limit, limit);
+        applyImpulse(c, c.tangent * (total - c.tangentImpulse));
+        c.tangentImpulse = total;
+        relative = pointVelocity(c.a, c.ra) - pointVelocity(c.b, c.rb);
+        total = glm::clamp(c.bitangentImpulse - c.bitangentMass * glm::dot(relative, c.bitangent), -limit, limit);
+        applyImpulse(c, c.bitangent * (total - c.bitangentImpulse));
+        c.bitangentImpulse = total;
+    }
+
+    // the orientations as the axes and angles of transforms, the angle in [0, pi]
+    void writeTransforms(size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; i++)
+        {
+            glm::quat q = orientation[i].w < 0.0f ? -orientation[i] : orientation[i];
+            float s = std::sqrt(std::max(0.0f, 1.0f - q.w * q.w));
+            glm::vec3 axis = s > 1e-4f ? glm::vec3(q.x, q.y, q.z) / s : glm::vec3(1.0f, 0.0f, 0.0f);
+            float angle = 2.0f * std::acos(std::min(q.w, 1.0f));
+            transforms.axisX[i] = axis.x;
+            transforms.axisY[i] = axis.y;
+            transforms.axisZ[i] = axis.z;
+            transforms.angles[i] = angle;
+            transforms.previousAngles[i] = angle;
+        }
+    }
+};
+
+#endif
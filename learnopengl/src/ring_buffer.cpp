@@ -0,0 +1,200 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include "glad/glad.h"
+
+#include "frame_pacing.cpp"
+#include "gl_objects.cpp"
+#include "hash.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+// One buffer for all per-frame dynamic data (instance streams, uniform blocks, indirect
+// commands), split into FRAMES regions used in turn. Each frame allocates linearly from
+// its region, a fence per region keeps the CPU from writing a region the GPU still reads,
+// so uploads are plain memcpys into persistently mapped memory with no orphaning. When the
+// loop fences its frames (see FrameFences) the region waits for the frame that last used it
+// on those fences instead.
+// Without GL 4.4 buffer storage the buffer isn't mapped, push() falls back to
+// glBufferSubData and allocate() returns NULL.
+// pushUnique() skips the copy of a block its call site already pushed the same frame.
+class RingBuffer
+{
+  public:
+    static const unsigned int FRAMES = 3;
+
+    unsigned int ID = 0;
+    // bytes per frame, rounded up to the binding alignments
+    size_t regionSize = 0;
+    // offset alignments of glBindBufferRange, queried once
+    size_t uniformAlignment = 256;
+    size_t storageAlignment = 256;
+    // false when the fallback path is used
+    bool mapped = false;
+    // the loop's frame fences, set before the first beginFrame(); NULL keeps a fence per region
+    FrameFences *frameFences = NULL;
+    // bytes pushUnique() found already in this frame's region
+    size_t reusedBytes = 0;
+
+    // what one call site of pushUnique() pushed last
+    struct PushCache
+    {
+        uint64_t hash = 0;
+        size_t bytes = 0;
+        GLintptr offset = -1;
+        uint64_t frame = 0;
+    };
+
+    RingBuffer(size_t bytesPerFrame)
+    {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        if (alignment > 0)
+            uniformAlignment = (size_t)alignment;
+        if (GLAD_GL_VERSION_4_3)
+        {
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            if (alignment > 0)
+                storageAlignment = (size_t)alignment;
+        }
+        // every region starts aligned for both kinds of binding
+        size_t regionAlignment = std::max(uniformAlignment, storageAlignment);
+        regionSize = (bytesPerFrame + regionAlignment - 1) / regionAlignment * regionAlignment;
+
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        ID = createBuffer(regionSize * FRAMES, NULL, flags, GL_STREAM_DRAW);
+        if (GLAD_GL_VERSION_4_4)
+        {
+            memory = (unsigned char *)mapBuffer(ID, 0, regionSize * FRAMES, flags);
+            mapped = memory != NULL;
+        }
+    }
+
+    ~RingBuffer()
+    {
+        for (GLsync fence : fences)
+        {
+            if (fence)
+                glDeleteSync(fence);
+        }
+        // deleting the buffer unmaps it
+        deleteBuffers(1, &ID);
+    }
+
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    // moves to the next region, blocks only if the GPU is still FRAMES frames behind
+    void beginFrame()
+    {
+        region = (region + 1) % FRAMES;
+        head = 0;
+        frame++;
+        reusedBytes = 0;
+        if (frameFences)
+        {
+            frameFences->wait(regionFrames[region]);
+            regionFrames[region] = frameFences->frame;
+            return;
+        }
+        GLsync &fence = fences[region];
+        if (fence)
+        {
+            GLenum status = glClientWaitSync(fence, 0, 0);
+            while (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED && status != GL_WAIT_FAILED)
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+
+    // after the last draw reading this frame's data
+    void endFrame()
+    {
+        if (frameFences)
+            return;
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // reserves bytes in this frame's region for writing in place, returns the mapped pointer
+    // and sets offset to its position in the buffer, NULL when unmapped or out of space
+    void *allocate(size_t bytes, size_t alignment, GLintptr &offset)
+    {
+        if (!mapped || !reserve(bytes, alignment, offset))
+            return NULL;
+        return memory + offset;
+    }
+
+    // copies data into this frame's region, returns its offset in the buffer or -1 when out of space
+    GLintptr push(const void *data, size_t bytes, size_t alignment = 16)
+    {
+        GLintptr offset;
+        if (!reserve(bytes, alignment, offset))
+            return -1;
+        if (mapped)
+        {
+            std::memcpy(memory + offset, data, bytes);
+        }
+        else
+        {
+            updateBuffer(ID, (size_t)offset, bytes, data);
+        }
+        return offset;
+    }
+
+    // push(), or the offset of the same bytes when cache saw them pushed earlier this frame: a
+    // block restored after a pass (the camera's FrameData after the shadow cascades) or the
+    // instances of casters every cascade sees are written once. Blocks are told apart by their
+    // hashWords64, the regions of earlier frames are never pointed at again
+    GLintptr pushUnique(const void *data, size_t bytes, size_t alignment, PushCache &cache)
+    {
+        uint64_t hash = hashWords64(data, bytes);
+        if (cache.offset >= 0 && cache.frame == frame && cache.bytes == bytes && cache.hash == hash &&
+            cache.offset % (GLintptr)alignment == 0)
+        {
+            reusedBytes += bytes;
+            return cache.offset;
+        }
+        GLintptr offset = push(data, bytes, alignment);
+        cache = {hash, bytes, offset, frame};
+        return offset;
+    }
+
+    // bytes allocated this frame
+    size_t used() const
+    {
+        return head;
+    }
+
+  private:
+    unsigned char *memory = NULL;
+    unsigned int region = 0;
+    size_t head = 0;
+    // beginFrame() calls, tells a PushCache of this frame from an older one
+    uint64_t frame = 1;
+    GLsync fences[FRAMES] = {};
+    // the frame of FrameFences each region was last used in
+    uint64_t regionFrames[FRAMES] = {};
+    bool reportedFull = false;
+
+    bool reserve(size_t bytes, size_t alignment, GLintptr &offset)
+    {
+        size_t start = (head + alignment - 1) / alignment * alignment;
+        if (start + bytes > regionSize)
+        {
+            if (!reportedFull)
+                std::cout << "ERROR::RING_BUFFER::OUT_OF_SPACE: " << start + bytes << " > " << regionSize << '\n';
+            reportedFull = true;
+            return false;
+        }
+        head = start + bytes;
+        offset = (GLintptr)(region * regionSize + start);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef SAMPLER_CACHE_H
+#define SAMPLER_CACHE_H
+
+#include "glad/glad.h"
+
+#include "gl_extensions.cpp"
+#include "gl_state.cpp"
+#include "hash.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+// everything a sampler object is made of; anisotropy is what the sampler asks for at most,
+// the cache's tier decides what it gets
+struct SamplerDesc
+{
+    GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+    GLenum wrapS = GL_REPEAT;
+    GLenum wrapT = GL_REPEAT;
+    float anisotropy = 1.0f;
+    float minLod = -1000.0f;
+    float maxLod = 1000.0f;
+    float lodBias = 0.0f;
+
+    bool operator==(const SamplerDesc &other) const
+    {
+        return minFilter == other.minFilter && magFilter == other.magFilter && wrapS == other.wrapS &&
+               wrapT == other.wrapT && anisotropy == other.anisotropy && minLod == other.minLod &&
+               maxLod == other.maxLod && lodBias == other.lodBias;
+    }
+};
+
+struct SamplerDescHash
+{
+    size_t operator()(const SamplerDesc &desc) const
+    {
+        uint32_t fields[] = {desc.minFilter, desc.magFilter, desc.wrapS, desc.wrapT};
+        uint64_t hash = fnv1a64(fields, sizeof(fields));
+        float values[] = {desc.anisotropy, desc.minLod, desc.maxLod, desc.lodBias};
+        return (size_t)fnv1a64(values, sizeof(values), hash);
+    }
+};
+
+// One sampler object per distinct SamplerDesc, however many textures and passes ask for it.
+// The anisotropy tier caps what every sampler gets (1 is off, then 2, 4, 8 and 16, within the
+// driver's GL_MAX_TEXTURE_MAX_ANISOTROPY), so a weak GPU or the QualityGovernor can turn the
+// texture filtering down in one place. A sampler is never changed once made: callers get() it
+// again after a tier change and find another one, and one that went into a bindless handle,
+// whose sampler state is frozen, keeps filtering as it did.
+class SamplerCache
+{
+  public:
+    SamplerCache()
+    {
+        if (GLAD_GL_VERSION_4_6 || hasGLExtension("GL_ARB_texture_filter_anisotropic") ||
+            hasGLExtension("GL_EXT_texture_filter_anisotropic"))
+            glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+    }
+
+    SamplerCache(const SamplerCache &) = delete;
+    SamplerCache &operator=(const SamplerCache &) = delete;
+
+    void setAnisotropyTier(float tier)
+    {
+        anisotropyTier = std::max(1.0f, tier);
+    }
+
+    // what a sampler asking for more than 1 gets now
+    float anisotropyLimit() const
+    {
+        return std::min(anisotropyTier, maxAnisotropy);
+    }
+
+    const Sampler &get(const SamplerDesc &desc)
+    {
+        SamplerDesc key = desc;
+        key.anisotropy = std::clamp(desc.anisotropy, 1.0f, anisotropyLimit());
+        std::unique_ptr<Sampler> &sampler = samplers[key];
+        if (!sampler)
+        {
+            sampler = std::make_unique<Sampler>(key.minFilter, key.magFilter, key.wrapS, key.wrapT);
+            glSamplerParameterf(sampler->ID, GL_TEXTURE_MIN_LOD, key.minLod);
+            glSamplerParameterf(sampler->ID, GL_TEXTURE_MAX_LOD, key.maxLod);
+            glSamplerParameterf(sampler->ID, GL_TEXTURE_LOD_BIAS, key.lodBias);
+            if (key.anisotropy > 1.0f)
+                glSamplerParameterf(sampler->ID, GL_TEXTURE_MAX_ANISOTROPY, key.anisotropy);
+        }
+        return *sampler;
+    }
+
+    // sampler objects made so far
+    size_t size() const
+    {
+        return samplers.size();
+    }
+
+  private:
+    // 1 without the extension
+    float maxAnisotropy = 1.0f;
+    float anisotropyTier = 16.0f;
+    std::unordered_map<SamplerDesc, std::unique_ptr<Sampler>, SamplerDescHash> samplers;
+};
+
+#endif
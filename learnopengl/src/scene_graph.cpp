@@ -0,0 +1,248 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include "glm/glm.hpp"
+
+#include "job_system.cpp"
+#include "scene_snapshot.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Transform hierarchy in flat arrays sorted by depth: the roots first, then their children,
+// and so on, every node after its parent. A node has its parent's slot, a local matrix and
+// the world matrix update() builds as parent world * local.
+// Only dirty nodes and the subtrees below them are recomputed, a level at a time: the nodes
+// of one level only read the level above, so each level is split over the job system.
+// Static nodes are computed once when the order is (re)built and never again, they can't
+// move and are left out of the per-level work lists; a static node under a moving one
+// would have to move with it, so it is added as a moving one.
+// Nodes are referred to by the handle add() returns, which stays valid when adding more
+// nodes reorders the slots.
+class SceneGraph
+{
+  public:
+    static const uint32_t NO_PARENT = 0xFFFFFFFFu;
+
+    // world matrices recomputed by the last update()
+    size_t updated = 0;
+
+    size_t size() const
+    {
+        return locals.size();
+    }
+
+    void reserve(size_t count)
+    {
+        parents.reserve(count);
+        locals.reserve(count);
+        worlds.reserve(count);
+        depths.reserve(count);
+        dirty.reserve(count);
+        statics.reserve(count);
+        updatedIn.reserve(count);
+        nodeOfSlot.reserve(count);
+        slotOfNode.reserve(count);
+    }
+
+    // parent is a handle or NO_PARENT, returns the handle of the new node
+    uint32_t add(uint32_t parent, const glm::mat4 &local, bool isStatic = false)
+    {
+        uint32_t node = (uint32_t)slotOfNode.size();
+        uint32_t parentSlot = parent == NO_PARENT ? NO_PARENT : slotOfNode[parent];
+        parents.push_back(parentSlot);
+        locals.push_back(local);
+        worlds.push_back(glm::mat4(1.0f));
+        depths.push_back(parentSlot == NO_PARENT ? 0 : depths[parentSlot] + 1);
+        dirty.push_back(1);
+        statics.push_back(isStatic && (parentSlot == NO_PARENT || statics[parentSlot]));
+        updatedIn.push_back(0);
+        nodeOfSlot.push_back(node);
+        slotOfNode.push_back((uint32_t)locals.size() - 1);
+        sorted = false;
+        return node;
+    }
+
+    // moving nodes only, the static ones keep the local they were added with
+    void setLocal(uint32_t node, const glm::mat4 &local)
+    {
+        uint32_t slot = slotOfNode[node];
+        locals[slot] = local;
+        dirty[slot] = 1;
+    }
+
+    const glm::mat4 &local(uint32_t node) const
+    {
+        return locals[slotOfNode[node]];
+    }
+
+    // as of the last update()
+    const glm::mat4 &world(uint32_t node) const
+    {
+        return worlds[slotOfNode[node]];
+    }
+
+    bool isStatic(uint32_t node) const
+    {
+        return statics[slotOfNode[node]] != 0;
+    }
+
+    // orders the nodes added since the last call and computes every world matrix, for a
+    // hierarchy with only static nodes that needs no update()
+    void build()
+    {
+        if (!sorted)
+            sort();
+    }
+
+    // recomputes the world matrices of the dirty nodes and everything below them, grain
+    // nodes of a level per job
+    void update(JobSystem &jobs, size_t grain = 1024)
+    {
+        build();
+        frame++;
+        updated = 0;
+        for (const std::vector<uint32_t> &level : moving)
+        {
+            jobs.parallelFor(0, level.size(), grain, [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; i++)
+                    updateSlot(level[i]);
+            });
+        }
+        for (const std::vector<uint32_t> &level : moving)
+        {
+            for (uint32_t slot : level)
+                updated += updatedIn[slot] == frame;
+        }
+    }
+
+    // the built order and matrices, see scene_snapshot.cpp
+    void save(SceneSnapshotWriter &snapshot)
+    {
+        build();
+        snapshot.add("scene graph/parents", parents);
+        snapshot.add("scene graph/locals", locals);
+        snapshot.add("scene graph/worlds", worlds);
+        snapshot.add("scene graph/depths", depths);
+        snapshot.add("scene graph/statics", statics);
+        snapshot.add("scene graph/node of slot", nodeOfSlot);
+        snapshot.add("scene graph/slot of node", slotOfNode);
+        std::vector<uint32_t> levels, slots;
+        for (const std::vector<uint32_t> &level : moving)
+        {
+            levels.push_back((uint32_t)level.size());
+            slots.insert(slots.end(), level.begin(), level.end());
+        }
+        snapshot.add("scene graph/moving levels", levels);
+        snapshot.add("scene graph/moving slots", slots);
+    }
+
+    // replaces every node with the saved ones, built already; false leaves the graph empty
+    bool restore(const SceneSnapshot &snapshot)
+    {
+        std::vector<uint32_t> levels, slots;
+        bool read = snapshot.read("scene graph/parents", parents) && snapshot.read("scene graph/locals", locals) &&
+                    snapshot.read("scene graph/worlds", worlds) && snapshot.read("scene graph/depths", depths) &&
+                    snapshot.read("scene graph/statics", statics) &&
+                    snapshot.read("scene graph/node of slot", nodeOfSlot) &&
+                    snapshot.read("scene graph/slot of node", slotOfNode) &&
+                    snapshot.read("scene graph/moving levels", levels) &&
+                    snapshot.read("scene graph/moving slots", slots);
+        size_t count = locals.size();
+        read = read && parents.size() == count && worlds.size() == count && depths.size() == count &&
+               statics.size() == count && nodeOfSlot.size() == count && slotOfNode.size() == count &&
+               std::all_of(slots.begin(), slots.end(), [&](uint32_t slot) { return slot < count; });
+        moving.clear();
+        size_t first = 0;
+        for (size_t d = 0; read && d < levels.size(); d++)
+        {
+            read = first + levels[d] <= slots.size();
+            if (read)
+                moving.emplace_back(slots.begin() + first, slots.begin() + first + levels[d]);
+            first += levels[d];
+        }
+        if (!read)
+        {
+            *this = SceneGraph();
+            return false;
+        }
+        dirty.assign(count, 0);
+        updatedIn.assign(count, 0);
+        frame = 0;
+        sorted = true;
+        return true;
+    }
+
+  private:
+    // per slot, in depth order
+    std::vector<uint32_t> parents;
+    std::vector<glm::mat4> locals, worlds;
+    std::vector<uint32_t> depths;
+    std::vector<unsigned char> dirty, statics;
+    // the update() that last recomputed the slot
+    std::vector<uint32_t> updatedIn;
+    std::vector<uint32_t> nodeOfSlot;
+    // per handle
+    std::vector<uint32_t> slotOfNode;
+    // the slots of the moving nodes, one list per depth
+    std::vector<std::vector<uint32_t>> moving;
+    uint32_t frame = 0;
+    bool sorted = true;
+
+    void updateSlot(uint32_t slot)
+    {
+        uint32_t parent = parents[slot];
+        bool parentMoved = parent != NO_PARENT && updatedIn[parent] == frame;
+        if (!dirty[slot] && !parentMoved)
+            return;
+        worlds[slot] = parent == NO_PARENT ? locals[slot] : worlds[parent] * locals[slot];
+        dirty[slot] = 0;
+        updatedIn[slot] = frame;
+    }
+
+    // stable counting sort of the slots by depth, then every world matrix once
+    void sort()
+    {
+        uint32_t maxDepth = 0;
+        for (uint32_t depth : depths)
+            maxDepth = std::max(maxDepth, depth);
+        std::vector<uint32_t> firstOfDepth(maxDepth + 2, 0);
+        for (uint32_t depth : depths)
+            firstOfDepth[depth + 1]++;
+        for (uint32_t d = 0; d <= maxDepth; d++)
+            firstOfDepth[d + 1] += firstOfDepth[d];
+        std::vector<uint32_t> newSlot(size());
+        for (size_t slot = 0; slot < size(); slot++)
+            newSlot[slot] = firstOfDepth[depths[slot]]++;
+
+        std::vector<uint32_t> oldParents = parents, oldDepths = depths, oldNodes = nodeOfSlot;
+        std::vector<glm::mat4> oldLocals = locals;
+        std::vector<unsigned char> oldStatics = statics;
+        for (size_t slot = 0; slot < size(); slot++)
+        {
+            uint32_t to = newSlot[slot];
+            parents[to] = oldParents[slot] == NO_PARENT ? NO_PARENT : newSlot[oldParents[slot]];
+            locals[to] = oldLocals[slot];
+            depths[to] = oldDepths[slot];
+            statics[to] = oldStatics[slot];
+            nodeOfSlot[to] = oldNodes[slot];
+            slotOfNode[oldNodes[slot]] = to;
+        }
+
+        moving.assign(maxDepth + 1, {});
+        for (uint32_t slot = 0; slot < size(); slot++)
+        {
+            uint32_t parent = parents[slot];
+            worlds[slot] = parent == NO_PARENT ? locals[slot] : worlds[parent] * locals[slot];
+            dirty[slot] = 0;
+            updatedIn[slot] = 0;
+            if (!statics[slot])
+                moving[depths[slot]].push_back(slot);
+        }
+        sorted = true;
+    }
+};
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef SCENE_SNAPSHOT_H
+#define SCENE_SNAPSHOT_H
+
+#include "hash.cpp"
+#include "mapped_file.cpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Runtime ready scene state written once and mapped on later launches instead of being built
+// again (see --scene-snapshot in main.cpp). A snapshot is a table of named sections, each a
+// flat array of trivially copyable elements at a 16 byte aligned offset; the systems that
+// own the state write their arrays with save() and take them back with restore() (scene
+// graph, entity store, transform system, static batches). Nothing in the file is a pointer:
+// arrays of arrays are stored as a flat array and the offsets into it, which restore() turns
+// back into its containers, so a snapshot maps at any address.
+// The key names what the state was built from (scene settings, component ids, ...), a
+// snapshot with another key or version is refused and the scene is built from scratch.
+// Files are little endian and only read on the kind of machine that wrote them.
+
+#define SCENE_SNAPSHOT_MAGIC 0x50534E53u // "SNSP"
+#define SCENE_SNAPSHOT_VERSION 2u
+
+struct SceneSnapshotHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t sectionCount;
+    // of the section table, right after the header
+    uint64_t sectionsOffset;
+};
+
+struct SceneSnapshotSection
+{
+    // fnv1a64 of the name
+    uint64_t name;
+    uint64_t offset;
+    uint64_t size;
+};
+
+inline uint64_t sceneSnapshotName(const char *name)
+{
+    return fnv1a64(name, std::strlen(name));
+}
+
+class SceneSnapshotWriter
+{
+  public:
+    uint64_t key;
+
+    SceneSnapshotWriter(uint64_t key) : key(key)
+    {
+    }
+
+    // copies size bytes of data as the section name
+    void add(const char *name, const void *data, size_t size)
+    {
+        payload.resize((payload.size() + 15) & ~(size_t)15);
+        sections.push_back({sceneSnapshotName(name), (uint64_t)payload.size(), (uint64_t)size});
+        payload.insert(payload.end(), (const unsigned char *)data, (const unsigned char *)data + size);
+    }
+
+    template <typename T> void add(const char *name, const std::vector<T> &array)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "sections are copied with memcpy");
+        add(name, array.data(), array.size() * sizeof(T));
+    }
+
+    // the sections so far, written aside and renamed so a reader never maps half a snapshot
+    bool write(const std::string &path) const
+    {
+        SceneSnapshotHeader header = {SCENE_SNAPSHOT_MAGIC, SCENE_SNAPSHOT_VERSION, key, sections.size(),
+                                      sizeof(SceneSnapshotHeader)};
+        size_t tableEnd = sizeof(header) + sections.size() * sizeof(SceneSnapshotSection);
+        size_t payloadStart = (tableEnd + 15) & ~(size_t)15;
+        std::vector<SceneSnapshotSection> table = sections;
+        for (SceneSnapshotSection &section : table)
+            section.offset += payloadStart;
+
+        std::error_code error;
+        std::filesystem::path parent = std::filesystem::path(path).parent_path();
+        if (!parent.empty())
+            std::filesystem::create_directories(parent, error);
+        std::string temporary =
+            path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            const char padding[16] = {};
+            file.write((const char *)&header, sizeof(header));
+            file.write((const char *)table.data(), table.size() * sizeof(SceneSnapshotSection));
+            file.write(padding, payloadStart - tableEnd);
+            file.write((const char *)payload.data(), payload.size());
+            if (!file)
+            {
+                std::cout << "ERROR::SCENE_SNAPSHOT::COULD_NOT_WRITE: " << path << '\n';
+                return false;
+            }
+        }
+        std::filesystem::rename(temporary, path, error);
+        if (error)
+        {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    std::vector<SceneSnapshotSection> sections;
+    // the sections from offset 0, before the table moves them behind it
+    std::vector<unsigned char> payload;
+};
+
+// a snapshot mapped for restore(), the sections point into the mapping
+class SceneSnapshot
+{
+  public:
+    SceneSnapshot()
+    {
+    }
+
+    SceneSnapshot(const SceneSnapshot &) = delete;
+    SceneSnapshot &operator=(const SceneSnapshot &) = delete;
+
+    // false when there is no snapshot at path, or one of another key, version or layout
+    bool open(const std::string &path, uint64_t key)
+    {
+        sections = NULL;
+        sectionCount = 0;
+        if (!file.open(path) || file.size < sizeof(SceneSnapshotHeader))
+            return false;
+        SceneSnapshotHeader header;
+        std::memcpy(&header, file.data, sizeof(header));
+        if (header.magic != SCENE_SNAPSHOT_MAGIC || header.version != SCENE_SNAPSHOT_VERSION || header.key != key ||
+            header.sectionsOffset != sizeof(header) ||
+            header.sectionCount > (file.size - sizeof(header)) / sizeof(SceneSnapshotSection))
+        {
+            file.close();
+            return false;
+        }
+        sections = (const SceneSnapshotSection *)(file.data + header.sectionsOffset);
+        sectionCount = (size_t)header.sectionCount;
+        for (size_t i = 0; i < sectionCount; i++)
+        {
+            if (sections[i].offset % 16 != 0 || sections[i].offset > file.size ||
+                sections[i].size > file.size - sections[i].offset)
+            {
+                std::cout << "ERROR::SCENE_SNAPSHOT::CORRUPT: " << path << '\n';
+                file.close();
+                sections = NULL;
+                sectionCount = 0;
+                return false;
+            }
+        }
+        file.willNeed(0, file.size);
+        return true;
+    }
+
+    bool isOpen() const
+    {
+        return file.isOpen();
+    }
+
+    // the section in place, valid while the snapshot is open; false when it is missing or
+    // isn't a whole number of T
+    template <typename T> bool view(const char *name, const T *&data, size_t &count) const
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "sections are copied with memcpy");
+        uint64_t hash = sceneSnapshotName(name);
+        for (size_t i = 0; i < sectionCount; i++)
+        {
+            if (sections[i].name != hash)
+                continue;
+            if (sections[i].size % sizeof(T) != 0)
+                return false;
+            data = (const T *)(file.data + sections[i].offset);
+            count = (size_t)(sections[i].size / sizeof(T));
+            return true;
+        }
+        return false;
+    }
+
+    // the section copied into array
+    template <typename T> bool read(const char *name, std::vector<T> &array) const
+    {
+        const T *data;
+        size_t count;
+        if (!view(name, data, count))
+            return false;
+        array.resize(count);
+        if (count > 0)
+            std::memcpy(array.data(), data, count * sizeof(T));
+        return true;
+    }
+
+  private:
+    MappedFile file;
+    const SceneSnapshotSection *sections = NULL;
+    size_t sectionCount = 0;
+};
+
+#endif
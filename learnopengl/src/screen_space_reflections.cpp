@@ -0,0 +1,194 @@
+#ifndef SCREEN_SPACE_REFLECTIONS_H
+#define SCREEN_SPACE_REFLECTIONS_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "environment_maps.cpp"
+#include "frame_graph.cpp"
+#include "hiz_buffer.cpp"
+#include "post_process.cpp"
+#include "shader.cpp"
+#include "shader_compiler.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Reflections of what is on screen without drawing the scene again, as passes of the
+// PostProcessGraph after the ambient occlusion: "ssr trace" reflects a ray off every pixel of a
+// half (or quarter) resolution and walks it over the HiZBuffer's pyramid of nearest depths, the
+// one the occlusion culling builds of the frame anyway (shader_src/ssr_trace.fs), "ssr temporal"
+// averages the jittered hits over the frames into a history kept here and "ssr apply" adds the
+// result to the frame by the Fresnel term of environment.glsl. Where a ray misses or fades out
+// at the screen's edges the frame keeps the prefiltered environment's reflection the lit paths
+// already gave it. A tier from the QualityGovernor takes steps off the walk and then halves its
+// resolution again. Every pass is a zone of the GpuProfiler.
+class ScreenSpaceReflections
+{
+  public:
+    // 0 the full quality, TIERS - 1 the cheapest
+    static const int TIERS = 3;
+
+    // how far a ray goes, in view space units
+    float maxDistance = 30.0f;
+    // how far behind a surface a ray may come out and still hit it, in view space units
+    float thickness = 0.5f;
+    float intensity = 1.0f;
+    // the weight of this frame's reflection against the history
+    float feedback = 0.15f;
+
+    // environment is the probe the misses fall back to, NULL for none
+    ScreenSpaceReflections(ShaderCompiler &compiler, const EnvironmentMaps *environment, bool reversedZ)
+        : traceShader(compiler.submit("src/shader_src/post.vs", "src/shader_src/ssr_trace.fs")),
+          temporalShader(compiler.submit("src/shader_src/post.vs", "src/shader_src/ssr_temporal.fs")),
+          applyShader(compiler.submit("src/shader_src/post.vs", "src/shader_src/ssr_apply.fs",
+                                      environment ? std::vector<std::string>{"ENVIRONMENT_LIGHTING"}
+                                                  : std::vector<std::string>{})),
+          environment(environment), reversedZ(reversedZ)
+    {
+    }
+
+    ScreenSpaceReflections(const ScreenSpaceReflections &) = delete;
+    ScreenSpaceReflections &operator=(const ScreenSpaceReflections &) = delete;
+
+    // the pyramid is built by compute shaders
+    static bool isSupported()
+    {
+        return HiZBuffer::isSupported();
+    }
+
+    // the passes over source into graph, returns the handle of the frame with the reflections on it
+    int addPasses(PostProcessGraph &graph, int source)
+    {
+        this->graph = &graph;
+        depthInput = graph.addExternal("ssr depth");
+        historyInput = graph.addExternal("ssr history");
+        historyOutput = graph.addExternal("ssr history next");
+        float z = reversedZ ? 1.0f : 0.0f;
+        tracePass = graph.addPass("ssr trace", traceShader, {depthInput, source}, traceScale(), GL_RGBA16F);
+        temporalPass = graph.addPass("ssr temporal", temporalShader, {tracePass, historyInput, depthInput},
+                                     traceScale(), GL_RGBA16F);
+        graph.setTarget(temporalPass, historyOutput);
+        int apply = graph.addPass("ssr apply", applyShader, {source, temporalPass, depthInput}, 1.0f, GL_RGBA16F,
+                                  glm::vec4(intensity, 0.0f, z, 0.0f));
+        // without one the cube maps still sit off the units of the pass' inputs
+        applyShader.use();
+        applyShader.setInt("irradianceMap", EnvironmentMaps::IRRADIANCE_UNIT);
+        applyShader.setInt("specularMap", EnvironmentMaps::SPECULAR_UNIT);
+
+        traceProjectionLoc = traceShader.uniform("projection");
+        traceInverseLoc = traceShader.uniform("inverseProjection");
+        baseLevelLoc = traceShader.uniform("baseLevel");
+        maxDistanceLoc = traceShader.uniform("maxDistance");
+        reprojectionLoc = temporalShader.uniform("reprojection");
+        applyInverseLoc = applyShader.uniform("inverseProjection");
+        inverseViewLoc = applyShader.uniform("inverseView");
+        graph.setUniforms(tracePass, [this](Shader &shader) {
+            shader.set(traceProjectionLoc, projection);
+            shader.set(traceInverseLoc, inverseProjection);
+            shader.set(baseLevelLoc, baseLevel());
+            shader.set(maxDistanceLoc, maxDistance);
+        });
+        graph.setUniforms(temporalPass, [this](Shader &shader) { shader.set(reprojectionLoc, reprojection); });
+        graph.setUniforms(apply, [this](Shader &shader) {
+            shader.set(applyInverseLoc, inverseProjection);
+            shader.set(inverseViewLoc, inverseView);
+        });
+        this->apply = apply;
+        return apply;
+    }
+
+    // the tier to trace at from the next frame on
+    void setTier(int level)
+    {
+        tier = std::clamp(level, 0, TIERS - 1);
+        if (!graph)
+            return;
+        graph->setScale(tracePass, traceScale());
+        graph->setScale(temporalPass, traceScale());
+    }
+
+    // before the graph's execute() over a width x height frame, hiZ built this frame with its
+    // nearest pyramid, the frame drawn with projection and view
+    void prepare(const HiZBuffer &hiZ, const glm::mat4 &projection, const glm::mat4 &view, int width, int height)
+    {
+        if (!graph)
+            return;
+        // the history at the scale of the trace
+        int historyWidth = std::max(1, (int)(width * traceScale()));
+        int historyHeight = std::max(1, (int)(height * traceScale()));
+        if (!history[0] || history[0]->width != historyWidth || history[0]->height != historyHeight)
+        {
+            for (RenderTargetPool::Target *&target : history)
+            {
+                targets.release(target);
+                target = targets.acquire(historyWidth, historyHeight, GL_RGBA16F);
+            }
+            historyValid = false;
+        }
+        targets.endFrame();
+        bool complete = history[0] && history[1] && hiZ.valid;
+        if (!complete)
+            historyValid = false;
+        RenderTargetPool::Target *previous = history[latest], *next = history[1 - latest];
+
+        graph->setExternal(depthInput, hiZ.valid ? &hiZ.nearest : NULL);
+        graph->setExternal(historyInput, complete ? &previous->color : NULL);
+        graph->setExternal(historyOutput, complete ? &next->color : NULL, complete ? next->FBO : 0);
+        float z = reversedZ ? 1.0f : 0.0f;
+        graph->setParams(tracePass, glm::vec4((float)STEPS[tier], thickness, z, (float)(frame++ % 64)));
+        graph->setParams(temporalPass, glm::vec4(feedback, historyValid ? 1.0f : 0.0f, z, (float)baseLevel()));
+        graph->setParams(apply, glm::vec4(intensity, 0.0f, z, 0.0f));
+        if (environment)
+            environment->bind();
+        glm::mat4 viewProjection = projection * view;
+        this->projection = projection;
+        inverseProjection = glm::inverse(projection);
+        inverseView = glm::inverse(view);
+        reprojection = previousViewProjection * glm::inverse(viewProjection);
+        previousViewProjection = viewProjection;
+
+        latest = 1 - latest;
+        historyValid = complete;
+    }
+
+  private:
+    // steps of a ray at each tier, and the scale of the frame it is traced at
+    static constexpr int STEPS[TIERS] = {64, 40, 24};
+    static constexpr float SCALES[TIERS] = {0.5f, 0.5f, 0.25f};
+
+    Shader &traceShader;
+    Shader &temporalShader;
+    Shader &applyShader;
+    const EnvironmentMaps *environment;
+    bool reversedZ;
+    PostProcessGraph *graph = NULL;
+    int depthInput = 0, historyInput = 0, historyOutput = 0;
+    int tracePass = 0, temporalPass = 0, apply = 0;
+    int tier = 0;
+    UniformHandle traceProjectionLoc, traceInverseLoc, baseLevelLoc, maxDistanceLoc, reprojectionLoc;
+    UniformHandle applyInverseLoc, inverseViewLoc;
+
+    RenderTargetPool targets;
+    RenderTargetPool::Target *history[2] = {NULL, NULL};
+    int latest = 0;
+    bool historyValid = false;
+    unsigned int frame = 0;
+    glm::mat4 projection = glm::mat4(1.0f), inverseProjection = glm::mat4(1.0f), inverseView = glm::mat4(1.0f);
+    glm::mat4 reprojection = glm::mat4(1.0f), previousViewProjection = glm::mat4(1.0f);
+
+    float traceScale() const
+    {
+        return SCALES[tier];
+    }
+
+    // the pyramid's level at the trace's resolution
+    int baseLevel() const
+    {
+        return tier == TIERS - 1 ? 2 : 1;
+    }
+};
+
+#endif
@@ -0,0 +1,331 @@
+#ifndef SDF_TEXT_H
+#define SDF_TEXT_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "hash.cpp"
+#include "hud.cpp"
+#include "ring_buffer.cpp"
+#include "shader.cpp"
+#include "sprite_batch.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Signed distance fields of the HUD_FONT glyphs in R8 pages, made the first time a glyph
+// is drawn. A field texel holds 0.5 on the outline, more inside and less outside, so one
+// texel size serves every text size: sdf_text.fs thresholds it with a width of about one
+// screen pixel instead of magnifying the bitmap. The fields are exact for the font pixel
+// squares of a bitmap glyph, worked out per texel from the distance to the nearest lit or
+// unlit square. When every page is full the page used longest ago is emptied for the new
+// glyph, except one a sprite of the current frame still samples.
+class SdfGlyphCache
+{
+  public:
+    // field texels per font pixel, and the margin of the field around the glyph
+    static const int TEXELS_PER_PIXEL = 8;
+    static const int SPREAD = 6;
+    static const int GLYPH_WIDTH = 5, GLYPH_HEIGHT = 7;
+    static const int CELL_WIDTH = GLYPH_WIDTH * TEXELS_PER_PIXEL + 2 * SPREAD;
+    static const int CELL_HEIGHT = GLYPH_HEIGHT * TEXELS_PER_PIXEL + 2 * SPREAD;
+
+    struct Glyph
+    {
+        unsigned int texture;
+        glm::vec4 uvRect;
+    };
+
+    // fields made and pages emptied so far
+    size_t generated = 0;
+    size_t evictions = 0;
+
+    SdfGlyphCache(int pageSize = 512, int maxPages = 2)
+        : pageSize(pageSize), maxPages(std::max(maxPages, 1)), columns(pageSize / CELL_WIDTH),
+          cellsPerPage(columns * (pageSize / CELL_HEIGHT))
+    {
+    }
+
+    SdfGlyphCache(const SdfGlyphCache &) = delete;
+    SdfGlyphCache &operator=(const SdfGlyphCache &) = delete;
+
+    // a page is only reused for glyphs once no sprite of its last frame can still be batched
+    void beginFrame()
+    {
+        frame++;
+    }
+
+    // the glyph's page and place in it, made now if needed; false for characters without a
+    // glyph, or when every page is in use this frame
+    bool find(uint32_t codepoint, Glyph &found)
+    {
+        int glyph = glyphIndex(codepoint);
+        if (glyph <= 0)
+            return false;
+        std::unordered_map<int, Entry>::iterator entry = entries.find(glyph);
+        if (entry == entries.end())
+        {
+            Entry made;
+            if (!allocate(made) || !generate(glyph, made))
+                return false;
+            entry = entries.emplace(glyph, made).first;
+        }
+        Page &page = pages[entry->second.page];
+        page.lastUsed = frame;
+        int cellX = entry->second.cell % columns * CELL_WIDTH, cellY = entry->second.cell / columns * CELL_HEIGHT;
+        found.texture = page.texture.ID;
+        found.uvRect = glm::vec4((float)cellX / pageSize, (float)cellY / pageSize, (float)CELL_WIDTH / pageSize,
+                                 (float)CELL_HEIGHT / pageSize);
+        return true;
+    }
+
+    // HUD_FONT covers ' ' to 'Z', lowercase letters use the uppercase glyphs
+    static int glyphIndex(uint32_t codepoint)
+    {
+        if (codepoint >= 'a' && codepoint <= 'z')
+            codepoint = codepoint - 'a' + 'A';
+        return codepoint >= ' ' && codepoint < ' ' + 59 ? (int)(codepoint - ' ') : 0;
+    }
+
+  private:
+    struct Page
+    {
+        Texture2D texture;
+        int used = 0;
+        uint64_t lastUsed = 0;
+    };
+
+    struct Entry
+    {
+        int page, cell;
+    };
+
+    int pageSize, maxPages, columns, cellsPerPage;
+    std::vector<Page> pages;
+    std::unordered_map<int, Entry> entries;
+    uint64_t frame = 1;
+    std::vector<uint8_t> field;
+
+    bool allocate(Entry &entry)
+    {
+        if (cellsPerPage <= 0)
+            return false;
+        for (size_t p = 0; p < pages.size(); p++)
+        {
+            if (pages[p].used < cellsPerPage)
+            {
+                entry = {(int)p, pages[p].used++};
+                return true;
+            }
+        }
+        if ((int)pages.size() < maxPages)
+        {
+            pages.emplace_back();
+            pages.back().texture.create(pageSize, pageSize, GL_R8, 1);
+            entry = {(int)pages.size() - 1, pages.back().used++};
+            return true;
+        }
+        // the least recently used page that this frame hasn't batched from
+        int oldest = -1;
+        for (size_t p = 0; p < pages.size(); p++)
+        {
+            if (pages[p].lastUsed < frame && (oldest < 0 || pages[p].lastUsed < pages[oldest].lastUsed))
+                oldest = (int)p;
+        }
+        if (oldest < 0)
+            return false;
+        for (std::unordered_map<int, Entry>::iterator it = entries.begin(); it != entries.end();)
+            it = it->second.page == oldest ? entries.erase(it) : std::next(it);
+        evictions++;
+        pages[oldest].used = 1;
+        entry = {oldest, 0};
+        return true;
+    }
+
+    // distance from (x, y) to the font pixel square at (column, row), 0 inside it
+    static float squareDistance(float x, float y, int column, int row)
+    {
+        float dx = std::max({(float)column - x, 0.0f, x - (float)(column + 1)});
+        float dy = std::max({(float)row - y, 0.0f, y - (float)(row + 1)});
+        return std::sqrt(dx * dx + dy * dy);
+    }
+
+    bool generate(int glyph, const Entry &entry)
+    {
+        const uint8_t *rows = HUD_FONT[glyph];
+        const float spread = (float)SPREAD / TEXELS_PER_PIXEL;
+        field.resize(CELL_WIDTH * CELL_HEIGHT);
+        for (int ty = 0; ty < CELL_HEIGHT; ty++)
+        {
+            for (int tx = 0; tx < CELL_WIDTH; tx++)
+            {
+                // texel center in font pixels, the glyph's top left corner at 0 0
+                float x = ((float)tx + 0.5f) / TEXELS_PER_PIXEL - spread;
+                float y = ((float)ty + 0.5f) / TEXELS_PER_PIXEL - spread;
+                int column = (int)std::floor(x), row = (int)std::floor(y);
+                bool inside = column >= 0 && column < GLYPH_WIDTH && row >= 0 && row < GLYPH_HEIGHT &&
+                              (rows[row] & (0x10 >> column));
+                // inside: to the nearest unlit square or the glyph's border, outside: to the nearest lit square
+                float distance = inside ? std::min({x, y, (float)GLYPH_WIDTH - x, (float)GLYPH_HEIGHT - y})
+                                        : spread;
+                for (int r = 0; r < GLYPH_HEIGHT; r++)
+                {
+                    for (int c = 0; c < GLYPH_WIDTH; c++)
+                    {
+                        bool lit = (rows[r] & (0x10 >> c)) != 0;
+                        if (lit != inside)
+                            distance = std::min(distance, squareDistance(x, y, c, r));
+                    }
+                }
+                float value = 0.5f + (inside ? distance : -distance) / (2.0f * spread);
+                field[ty * CELL_WIDTH + tx] = (uint8_t)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+        }
+        int cellX = entry.cell % columns * CELL_WIDTH, cellY = entry.cell / columns * CELL_HEIGHT;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        pages[entry.page].texture.uploadRegion(0, cellX, cellY, CELL_WIDTH, CELL_HEIGHT, GL_RED, GL_UNSIGNED_BYTE,
+                                               field.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        generated++;
+        return true;
+    }
+};
+
+// Text in window pixels or over points of the scene, drawn through a SpriteBatch with the
+// sdf_text.fs program: every glyph is a sprite of its cache page, so all the text of a
+// frame is one draw per page in use. The glyph positions of a string are laid out once and
+// kept by the string's hash while it is drawn in the last LAYOUT_FRAMES frames, a label
+// drawn every frame costs a lookup and its sprites.
+class TextRenderer
+{
+  public:
+    // frames a layout is kept without being drawn
+    static const uint64_t LAYOUT_FRAMES = 120;
+    // font pixels from one character to the next, and from one line to the next
+    static const int ADVANCE = 6, LINE_HEIGHT = 10;
+
+    SdfGlyphCache glyphs;
+    SpriteBatch batch;
+
+    TextRenderer(Shader &program, RingBuffer &ring) : batch(program, ring)
+    {
+    }
+
+    TextRenderer(const TextRenderer &) = delete;
+    TextRenderer &operator=(const TextRenderer &) = delete;
+
+    // layouts in the cache, for the HUD
+    size_t cachedLayouts() const
+    {
+        return layouts.size();
+    }
+
+    void begin(int w, int h)
+    {
+        width = w;
+        height = h;
+        frame++;
+        glyphs.beginFrame();
+        batch.begin(w, h);
+    }
+
+    // size is the height of a capital letter in screen pixels, (x, y) its top left corner
+    void text(float x, float y, std::string_view string, float size, uint32_t color, int layer = 0)
+    {
+        const Layout &layout = layoutOf(string);
+        float scale = size / SdfGlyphCache::GLYPH_HEIGHT;
+        float margin = (float)SdfGlyphCache::SPREAD / SdfGlyphCache::TEXELS_PER_PIXEL * scale;
+        float cellWidth = (float)SdfGlyphCache::CELL_WIDTH / SdfGlyphCache::TEXELS_PER_PIXEL * scale;
+        float cellHeight = (float)SdfGlyphCache::CELL_HEIGHT / SdfGlyphCache::TEXELS_PER_PIXEL * scale;
+        SdfGlyphCache::Glyph glyph;
+        for (const LayoutGlyph &placed : layout.glyphs)
+        {
+            if (glyphs.find(placed.codepoint, glyph))
+                batch.draw(glyph.texture, x + placed.x * scale - margin, y + placed.y * scale - margin, cellWidth,
+                           cellHeight, glyph.uvRect, color, 0.0f, layer);
+        }
+    }
+
+    // centered above a point of the scene, nothing when it's behind the camera or off screen
+    void label(const glm::mat4 &viewProjection, const glm::vec3 &position, std::string_view string, float size,
+               uint32_t color, int layer = 0)
+    {
+        glm::vec4 clip = viewProjection * glm::vec4(position, 1.0f);
+        if (clip.w <= 0.0f)
+            return;
+        glm::vec2 ndc = glm::vec2(clip) / clip.w;
+        if (std::abs(ndc.x) > 1.1f || std::abs(ndc.y) > 1.1f)
+            return;
+        const Layout &layout = layoutOf(string);
+        float scale = size / SdfGlyphCache::GLYPH_HEIGHT;
+        float x = (ndc.x * 0.5f + 0.5f) * width - layout.width * scale * 0.5f;
+        float y = (0.5f - ndc.y * 0.5f) * height - layout.height * scale;
+        text(x, y, string, size, color, layer);
+    }
+
+    // draws the frame's text and forgets the layouts that weren't drawn for a while
+    void end()
+    {
+        batch.end();
+        if (frame % LAYOUT_FRAMES)
+            return;
+        for (std::unordered_map<uint64_t, Layout>::iterator it = layouts.begin(); it != layouts.end();)
+            it = frame - it->second.lastUsed > LAYOUT_FRAMES ? layouts.erase(it) : std::next(it);
+    }
+
+  private:
+    struct LayoutGlyph
+    {
+        uint32_t codepoint;
+        // top left corner of the glyph in font pixels
+        float x, y;
+    };
+
+    struct Layout
+    {
+        std::vector<LayoutGlyph> glyphs;
+        // font pixels, the widest line and the lines' height
+        float width = 0.0f, height = 0.0f;
+        bool laidOut = false;
+        uint64_t lastUsed = 0;
+    };
+
+    std::unordered_map<uint64_t, Layout> layouts;
+    uint64_t frame = 0;
+    int width = 0, height = 0;
+
+    const Layout &layoutOf(std::string_view string)
+    {
+        uint64_t key = fnv1a64(string.data(), string.size());
+        Layout &layout = layouts[key];
+        layout.lastUsed = frame;
+        if (layout.laidOut)
+            return layout;
+        layout.laidOut = true;
+        float x = 0.0f, y = 0.0f;
+        layout.width = 0.0f;
+        for (char c : string)
+        {
+            if (c == '\n')
+            {
+                x = 0.0f;
+                y += LINE_HEIGHT;
+                continue;
+            }
+            // spaces only advance
+            if (SdfGlyphCache::glyphIndex((uint8_t)c) > 0)
+                layout.glyphs.push_back({(uint8_t)c, x, y});
+            x += ADVANCE;
+            layout.width = std::max(layout.width, x - (ADVANCE - SdfGlyphCache::GLYPH_WIDTH));
+        }
+        layout.height = y + SdfGlyphCache::GLYPH_HEIGHT;
+        return layout;
+    }
+};
+
+#endif
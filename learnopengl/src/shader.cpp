@@ -3,101 +3,1129 @@
 
 #include "glad/glad.h"
 
-#include <fstream>
+#include "block_layout.cpp"
+#include "cpu_profiler.cpp"
+#include "gl_debug.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "hash.cpp"
+#include "program_cache.cpp"
+#include "render_stats.cpp"
+#include "shader_preprocessor.cpp"
+#include "shader_stats.cpp"
+#include "spirv_module.cpp"
+#include "startup_timeline.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
-#include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
+
+class Shader;
+
+// resolved uniform location, obtained once through Shader::uniform()
+// so the render loop can set values without any name lookups
+struct UniformHandle
+{
+    int location = -1;
+    // the program holding the uniform, set through glProgramUniform* whether it is bound or not
+    // (GL 4.1); NULL sets the program in use
+    const Shader *program = NULL;
+
+    bool valid() const
+    {
+        return location != -1;
+    }
+};
+
+// A uniform name reduced to its FNV-1a hash. Literals convert through the consteval
+// constructor, so shader.setMat4("model", m) always hashes "model" at compile time instead of
+// building a std::string, and the lookup compares integers only. Names only known at
+// run time go through the std::string constructor.
+struct UniformName
+{
+    uint64_t hash;
+
+    template <size_t N> consteval UniformName(const char (&name)[N]) : hash(fnv1a64(name, N - 1))
+    {
+    }
+
+    UniformName(const std::string &name) : hash(fnv1a64(name.data(), name.size()))
+    {
+    }
+};
+
+// value of a specialization constant of a SPIR-V module, layout (constant_id = id) in the source
+struct ShaderSpecialization
+{
+    unsigned int id;
+    unsigned int value;
+};
 
 class Shader
 {
   public:
     // program ID
     unsigned int ID;
+    // true when the program was restored from the on-disk binary cache
+    bool fromBinaryCache = false;
+    // main thread time spent reading, submitting and finishing the program,
+    // ShaderCompiler adds the submission
+    mutable double buildMilliseconds = 0.0;
+    // of that the time finish() blocked on the driver's compile and link
+    mutable double linkMilliseconds = 0.0;
+
+    // default constructed shaders are empty until submit() is called,
+    // used by ShaderCompiler to defer the link status checks
+    Shader() : ID(0)
+    {
+    }
 
     // constructor reads and builds the shader
-    Shader(const char *vertexPath, const char *fragmentPath)
+    Shader(const char *vertexPath, const char *fragmentPath) : ID(0)
     {
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
+        submit(vertexPath, fragmentPath);
+        finish();
+    }
 
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    // reads the sources and hands them to the driver without waiting on the result,
+    // the compile/link status is only checked in finish(). defines are NAME or "NAME value"
+    // for both stages (see ShaderPreprocessor). fromDisk ignores the asset pack and the
+    // prefetch, for rebuilding from edited files
+    void submit(const char *vertexPath, const char *fragmentPath, const std::vector<std::string> &defines = {},
+                bool fromDisk = false)
+    {
+        PROFILE_ZONE("Shader::submit");
+        StartupScope startup(std::string("shader ") + vertexPath + " " + fragmentPath);
+        paths = {vertexPath, fragmentPath};
+        this->defines = defines;
+        // pieces of the pack, the prefetch or a mapping, handed to the driver as they are
+        ShaderPreprocessor vertexStage, fragmentStage;
+        vertexStage.process(vertexPath, defines, fromDisk);
+        fragmentStage.process(fragmentPath, defines, fromDisk);
+        setDependencies({&vertexStage, &fragmentStage});
 
-        // Tries to open the files, outputs the errors if it cant open them
-        try
+        // linked programs are cached on disk, skip compilation when the driver accepts the binary
+        ID = glCreateProgram();
+        labelObject(GL_PROGRAM, ID, std::string(vertexPath) + " " + fragmentPath);
+        ProgramBinaryCache binaryCache;
+        cacheable = ProgramBinaryCache::supported();
+        if (cacheable)
         {
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-
-            std::stringstream vShaderStream, fShaderStream;
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-
-            vShaderFile.close();
-            fShaderFile.close();
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            std::vector<std::string_view> key = {"vertex"};
+            for (std::string_view piece : vertexStage.pieces())
+                key.push_back(piece);
+            key.push_back("fragment");
+            for (std::string_view piece : fragmentStage.pieces())
+                key.push_back(piece);
+            cacheKey = ProgramBinaryCache::key(key);
         }
-        catch (std::ifstream::failure &e)
+        if (cacheable && binaryCache.load(cacheKey, ID))
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ:" << e.what() << '\n';
+            fromBinaryCache = true;
+            linked = true;
+            reflectUniforms();
+            return;
         }
 
-        // converting the string source code into c_style strings for compilation
-        const char *vShaderCode = vertexCode.c_str();
-        const char *fShaderCode = fragmentCode.c_str();
-
-        // compiling shaders
-        unsigned int vertex, fragment;
+        // compiling shaders, with explicit lengths since the pieces aren't NUL terminated
         vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glShaderSource(vertex, (GLsizei)vertexStage.strings.size(), vertexStage.strings.data(),
+                       vertexStage.lengths.data());
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
 
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glShaderSource(fragment, (GLsizei)fragmentStage.strings.size(), fragmentStage.strings.data(),
+                       fragmentStage.lengths.data());
         glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
 
         // linking the program
-        ID = glCreateProgram();
+        if (cacheable || shaderStatsEnabled)
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        pending = true;
+    }
 
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+    // same for a compute program, dispatched by the caller after use()
+    void submitCompute(const char *computePath, const std::vector<std::string> &defines = {}, bool fromDisk = false)
+    {
+        submitStage(GL_COMPUTE_SHADER, computePath, defines, false, fromDisk);
+    }
+
+    // a program out of a single stage, separable ones are combined by submitPipeline()
+    void submitStage(GLenum type, const char *path, const std::vector<std::string> &defines = {},
+                     bool separable = false, bool fromDisk = false)
+    {
+        PROFILE_ZONE("Shader::submitStage");
+        StartupScope startup(std::string("shader ") + path);
+        paths = {path};
+        this->defines = defines;
+        stageType = type;
+        this->separable = separable;
+        ShaderPreprocessor stage;
+        stage.process(path, defines, fromDisk);
+        setDependencies({&stage});
+
+        ID = glCreateProgram();
+        if (separable)
+            glProgramParameteri(ID, GL_PROGRAM_SEPARABLE, GL_TRUE);
+        ProgramBinaryCache binaryCache;
+        cacheable = ProgramBinaryCache::supported();
+        if (cacheable)
+        {
+            // the stage is part of the key so a compute source never matches a graphics program
+            std::vector<std::string_view> key = {stageName(type), separable ? "separable" : ""};
+            for (std::string_view piece : stage.pieces())
+                key.push_back(piece);
+            cacheKey = ProgramBinaryCache::key(key);
+        }
+        if (cacheable && binaryCache.load(cacheKey, ID))
+        {
+            fromBinaryCache = true;
+            linked = true;
+            reflectUniforms();
+            return;
+        }
+
+        unsigned int &object = type == GL_COMPUTE_SHADER ? compute : type == GL_VERTEX_SHADER ? vertex : fragment;
+        object = glCreateShader(type);
+        glShaderSource(object, (GLsizei)stage.strings.size(), stage.strings.data(), stage.lengths.data());
+        glCompileShader(object);
+
+        if (cacheable || shaderStatsEnabled)
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glAttachShader(ID, object);
+        glLinkProgram(ID);
+        pending = true;
+    }
+
+    // A single stage program from the SPIR-V module cooked out of path (GL 4.6 or
+    // GL_ARB_gl_spirv), specialized instead of compiled. The GLSL is still read for its
+    // includes, hot reload rebuilds from it. False without creating anything when the module
+    // is missing, invalid or older than one of the files it was cooked from, the caller
+    // compiles the GLSL then
+    bool submitSpirv(GLenum type, const char *path, const std::string &modulePath,
+                     const std::vector<ShaderSpecialization> &specializations = {})
+    {
+        PROFILE_ZONE("Shader::submitSpirv");
+        StartupScope startup(std::string("spirv ") + modulePath);
+        ShaderPreprocessor stage;
+        stage.process(path);
+        if (!assetPack.find(modulePath))
+        {
+            std::error_code error;
+            std::filesystem::file_time_type built = std::filesystem::last_write_time(modulePath, error);
+            if (error)
+                return false;
+            for (const std::string &file : stage.files())
+            {
+                if (std::filesystem::last_write_time(file, error) > built && !error)
+                {
+                    std::cout << "ERROR::SHADER::STALE_SPIRV: " << modulePath << " is older than " << file
+                              << ", compiling the GLSL\n";
+                    return false;
+                }
+            }
+        }
+        SpirvModule module;
+        if (!module.load(modulePath))
+            return false;
+
+        paths = {path};
+        defines.clear();
+        stageType = type;
+        separable = false;
+        spirvUniforms = module.uniformLocations();
+        setDependencies({&stage});
+
+        std::vector<GLuint> ids, values;
+        for (const ShaderSpecialization &specialization : specializations)
+        {
+            ids.push_back(specialization.id);
+            values.push_back(specialization.value);
+        }
+        // not put into the binary cache: specializing is already cheap, and Mesa crashes
+        // retrieving the binary of a program without uniform names
+        ID = glCreateProgram();
+        cacheable = false;
+
+        unsigned int &object = type == GL_COMPUTE_SHADER ? compute : type == GL_VERTEX_SHADER ? vertex : fragment;
+        object = glCreateShader(type);
+        glShaderBinary(1, &object, GL_SHADER_BINARY_FORMAT_SPIR_V, module.data(), module.size());
+        glSpecializeShader(object, "main", (GLuint)ids.size(), ids.data(), values.data());
+
+        glAttachShader(ID, object);
+        glLinkProgram(ID);
+        pending = true;
+        return true;
+    }
+
+    // Combines a separable vertex and fragment program (GL_ARB_separate_shader_objects) instead
+    // of linking the two sources into one. use() binds the pipeline, uniform() finds a name
+    // in either stage. The stages stay owned by the caller and may be shared with other
+    // pipelines, so their uniform values are too. ID is the pipeline object.
+    void submitPipeline(Shader &vertexStage, Shader &fragmentStage)
+    {
+        stages[0] = &vertexStage;
+        stages[1] = &fragmentStage;
+        if (hasDSA())
+            glCreateProgramPipelines(1, &ID);
+        else
+            glGenProgramPipelines(1, &ID);
+        pending = true;
+    }
+
+    bool isPipeline() const
+    {
+        return stages[0] != NULL;
+    }
+
+    // the vertex and fragment programs of a pipeline, NULL otherwise
+    Shader *pipelineStage(int index) const
+    {
+        return stages[index];
+    }
+
+    // the same sources, defines and kind of program as original, read from disk
+    void submitFromDisk(const Shader &original)
+    {
+        const std::vector<std::string> &source = original.paths;
+        if (source.size() == 2)
+            submit(source[0].c_str(), source[1].c_str(), original.defines, true);
+        else
+            submitStage(original.stageType, source[0].c_str(), original.defines, original.separable, true);
+    }
+
+    // true while the link submitted by submit() has not been checked yet
+    bool isPending() const
+    {
+        return pending;
+    }
+
+    // whether finish() found the program linked
+    bool isLinked() const
+    {
+        return linked;
+    }
+
+    // the files the program is built from, vertex and fragment or the compute source
+    const std::vector<std::string> &sourcePaths() const
+    {
+        return paths;
+    }
+
+    // the defines the program was built with
+    const std::vector<std::string> &sourceDefines() const
+    {
+        return defines;
+    }
+
+    // what the linked program costs, see shader_stats.cpp; a pipeline's are those of its stages
+    ShaderStats stats() const
+    {
+        finish();
+        ShaderStats result;
+        for (const std::string &path : paths)
+            result.name += (result.name.empty() ? "" : " ") + path;
+        for (const std::string &define : defines)
+            result.name += " " + define;
+        result.buildMs = buildMilliseconds;
+        result.linkMs = linkMilliseconds;
+        result.fromBinaryCache = fromBinaryCache;
+        if (isPipeline() || !linked)
+            return result;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &result.uniforms);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &result.uniformBlocks);
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &result.attributes);
+        // a program linked without the retrievable hint may have no binary to give
+        glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &result.binaryBytes);
+        if (result.binaryBytes > 0)
+        {
+            std::vector<char> binary(result.binaryBytes);
+            GLenum format = 0;
+            int length = 0;
+            glGetProgramBinary(ID, result.binaryBytes, &length, &format, binary.data());
+            binary.resize(std::max(length, 0));
+            parseBinaryStats(binary, result);
+        }
+        return result;
+    }
+
+    // the same for the same sources, defines and kind of program on every run, unlike ID;
+    // a pipeline's comes from its stages
+    uint64_t identity() const
+    {
+        if (isPipeline())
+        {
+            uint64_t pieces[2] = {stages[0]->identity(), stages[1]->identity()};
+            return fnv1a64((const char *)pieces, sizeof(pieces));
+        }
+        uint64_t hash = fnv1a64((const char *)&stageType, sizeof(stageType));
+        hash = fnv1a64(separable ? "separable" : "", separable ? 9 : 0, hash);
+        const char separator = '\0';
+        for (const std::vector<std::string> *strings : {&paths, &defines})
+        {
+            for (const std::string &string : *strings)
+            {
+                std::string name = strings == &paths ? assetName(string) : string;
+                hash = fnv1a64(name.data(), name.size(), hash);
+                hash = fnv1a64(&separator, 1, hash);
+            }
+            hash = fnv1a64(&separator, 1, hash);
+        }
+        return hash;
+    }
+
+    // whether the file is one of the sources or included by one
+    bool usesSource(const std::string &path) const
+    {
+        std::string name = assetName(path);
+        for (const std::string &source : dependencies)
+        {
+            if (assetName(source) == name)
+                return true;
+        }
+        return false;
+    }
+
+    // Takes over the program of a finished rebuild of the same files, so references to this
+    // Shader stay valid. The uniform values and block bindings set so far carry over.
+    // UniformHandles resolved earlier hold plain locations, a rebuild that moves one of them
+    // is refused, as is one that failed to compile or link; this program is kept then.
+    bool replaceWith(Shader &replacement)
+    {
+        finish();
+        replacement.finish();
+        if (!replacement.linked)
+            return false;
+        for (const UniformEntry &entry : replacement.uniforms)
+        {
+            for (const UniformEntry &old : uniforms)
+            {
+                if (old.alias || entry.alias)
+                    continue;
+                if ((old.name == entry.name) != (old.location == entry.location))
+                {
+                    std::cout << "ERROR::SHADER::RELOAD_MOVED_UNIFORM: " << entry.name << " in " << paths[0]
+                              << ", restart to pick up this change\n";
+                    return false;
+                }
+            }
+        }
+
+        copyUniformState(replacement);
+        glDeleteProgram(ID);
+        ID = replacement.ID;
+        uniforms.swap(replacement.uniforms);
+        spirvUniforms.swap(replacement.spirvUniforms);
+        fromBinaryCache = replacement.fromBinaryCache;
+        replacement.ID = 0;
+        return true;
+    }
+
+    // checks the compile/link results, stores the binary and reflects the uniforms,
+    // blocks if the driver is still compiling
+    void finish() const
+    {
+        if (!pending)
+            return;
+        PROFILE_ZONE("Shader::finish");
+        StartupScope startup("link program " + std::to_string(ID));
+        pending = false;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        if (isPipeline())
+        {
+            stages[0]->finish();
+            stages[1]->finish();
+            linked = stages[0]->linked && stages[1]->linked;
+            attachStages();
+            warnSharedUniforms();
+            return;
+        }
+
+        if (vertex)
+            checkCompileErrors(vertex, "VERTEX");
+        if (fragment)
+            checkCompileErrors(fragment, "FRAGMENT");
+        if (compute)
+            checkCompileErrors(compute, "COMPUTE");
+        linked = checkCompileErrors(ID, "PROGRAM");
+        linkMilliseconds +=
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (linked && cacheable)
+            ProgramBinaryCache().store(cacheKey, ID);
+
+        for (unsigned int stage : {vertex, fragment, compute})
+        {
+            if (!stage)
+                continue;
+            glDetachShader(ID, stage);
+            glDeleteShader(stage);
+        }
+        vertex = fragment = compute = 0;
+
+        reflectUniforms();
+        buildMilliseconds +=
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
     }
 
     void use()
     {
-        glUseProgram(ID);
+        finish();
+        if (!isPipeline())
+        {
+            glState.useProgram(ID);
+            return;
+        }
+        // a hot reload swaps the program of a stage
+        if (attached[0] != stages[0]->ID || attached[1] != stages[1]->ID)
+            attachStages();
+        glState.bindProgramPipeline(ID);
+    }
+
+    // looks the name up in the table reflected at link time, a binary search on the hash,
+    // meant to be called once outside of the render loop
+    UniformHandle uniform(UniformName name) const
+    {
+        finish();
+        UniformHandle handle;
+        if (isPipeline())
+        {
+            // the pipeline is bound, not the stage, so the handle always names its program
+            for (const Shader *stage : stages)
+            {
+                handle = stage->uniform(name);
+                if (handle.valid())
+                {
+                    handle.program = stage;
+                    break;
+                }
+            }
+            return handle;
+        }
+        auto found = std::lower_bound(uniforms.begin(), uniforms.end(), name.hash,
+                                      [](const UniformEntry &entry, uint64_t hash) { return entry.hash < hash; });
+        if (found != uniforms.end() && found->hash == name.hash)
+            handle.location = found->location;
+        if (GLAD_GL_VERSION_4_1)
+            handle.program = this;
+        return handle;
+    }
+
+    // assigns a uniform block of the program to a buffer binding point,
+    // blocks the program doesn't use are ignored
+    void bindUniformBlock(const char *name, unsigned int binding) const
+    {
+        finish();
+        if (isPipeline())
+        {
+            stages[0]->bindUniformBlock(name, binding);
+            stages[1]->bindUniformBlock(name, binding);
+            return;
+        }
+        unsigned int index = glGetUniformBlockIndex(ID, name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+
+    // offsets and strides of a uniform block as the driver laid it out (see block_layout.cpp),
+    // for checking the C++ struct that fills it; a pipeline looks in both stages
+    BlockInfo uniformBlock(const char *name) const
+    {
+        finish();
+        BlockInfo block;
+        if (isPipeline())
+        {
+            block = stages[0]->uniformBlock(name);
+            return block.valid() ? block : stages[1]->uniformBlock(name);
+        }
+        unsigned int index = glGetUniformBlockIndex(ID, name);
+        if (index == GL_INVALID_INDEX)
+            return block;
+        int count = 0;
+        glGetActiveUniformBlockiv(ID, index, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+        glGetActiveUniformBlockiv(ID, index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &count);
+        std::vector<int> indices(count);
+        if (count > 0)
+            glGetActiveUniformBlockiv(ID, index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES, indices.data());
+        std::vector<GLuint> uniformIndices(indices.begin(), indices.end());
+        std::vector<int> offsets(count), types(count), sizes(count), arrayStrides(count), matrixStrides(count);
+        const std::pair<GLenum, std::vector<int> *> queries[] = {{GL_UNIFORM_OFFSET, &offsets},
+                                                                 {GL_UNIFORM_TYPE, &types},
+                                                                 {GL_UNIFORM_SIZE, &sizes},
+                                                                 {GL_UNIFORM_ARRAY_STRIDE, &arrayStrides},
+                                                                 {GL_UNIFORM_MATRIX_STRIDE, &matrixStrides}};
+        for (const std::pair<GLenum, std::vector<int> *> &query : queries)
+        {
+            if (count == 0)
+                break;
+            glGetActiveUniformsiv(ID, (GLsizei)count, uniformIndices.data(), query.first, query.second->data());
+        }
+        for (int i = 0; i < count; i++)
+        {
+            char variableName[256];
+            GLsizei length = 0;
+            glGetActiveUniformName(ID, uniformIndices[i], sizeof(variableName), &length, variableName);
+            BlockVariable variable;
+            variable.name.assign(variableName, length);
+            variable.offset = offsets[i];
+            variable.type = (GLenum)types[i];
+            variable.arraySize = sizes[i];
+            variable.arrayStride = arrayStrides[i];
+            variable.matrixStride = matrixStrides[i];
+            block.variables.push_back(variable);
+        }
+        return block;
+    }
+
+    // the same for a shader storage block, through the GL 4.3 program interface queries
+    BlockInfo storageBlock(const char *name) const
+    {
+        finish();
+        BlockInfo block;
+        if (isPipeline())
+        {
+            block = stages[0]->storageBlock(name);
+            return block.valid() ? block : stages[1]->storageBlock(name);
+        }
+        if (!GLAD_GL_VERSION_4_3)
+            return block;
+        unsigned int index = glGetProgramResourceIndex(ID, GL_SHADER_STORAGE_BLOCK, name);
+        if (index == GL_INVALID_INDEX)
+            return block;
+        const GLenum blockProperties[] = {GL_BUFFER_DATA_SIZE, GL_NUM_ACTIVE_VARIABLES};
+        int blockValues[2] = {0, 0};
+        glGetProgramResourceiv(ID, GL_SHADER_STORAGE_BLOCK, index, 2, blockProperties, 2, NULL, blockValues);
+        block.dataSize = blockValues[0];
+        std::vector<int> variables(blockValues[1]);
+        const GLenum activeVariables = GL_ACTIVE_VARIABLES;
+        if (!variables.empty())
+            glGetProgramResourceiv(ID, GL_SHADER_STORAGE_BLOCK, index, 1, &activeVariables, (GLsizei)variables.size(),
+                                   NULL, variables.data());
+        for (int variableIndex : variables)
+        {
+            const GLenum properties[] = {GL_OFFSET,        GL_TYPE,          GL_ARRAY_SIZE,
+                                         GL_ARRAY_STRIDE,  GL_MATRIX_STRIDE, GL_TOP_LEVEL_ARRAY_STRIDE};
+            int values[6] = {0, 0, 0, 0, 0, 0};
+            glGetProgramResourceiv(ID, GL_BUFFER_VARIABLE, (GLuint)variableIndex, 6, properties, 6, NULL, values);
+            char variableName[256];
+            GLsizei length = 0;
+            glGetProgramResourceName(ID, GL_BUFFER_VARIABLE, (GLuint)variableIndex, sizeof(variableName), &length,
+                                     variableName);
+            BlockVariable variable;
+            variable.name.assign(variableName, length);
+            variable.offset = values[0];
+            variable.type = (GLenum)values[1];
+            variable.arraySize = values[2];
+            variable.arrayStride = values[3];
+            variable.matrixStride = values[4];
+            variable.topLevelArrayStride = values[5];
+            block.variables.push_back(variable);
+        }
+        return block;
+    }
+
+    // handle based setters, no lookups and no string construction. With GL 4.1 they write
+    // straight into the handle's program, no use() needed first. A single value the program
+    // got from the last set() of its location already isn't sent again (renderStats.uniformSkips)
+    void set(UniformHandle handle, bool value) const
+    {
+        set(handle, (int)value);
+    }
+    void set(UniformHandle handle, int value) const
+    {
+        set(handle, &value, 1);
+    }
+    void set(UniformHandle handle, unsigned int value) const
+    {
+        set(handle, &value, 1);
+    }
+    void set(UniformHandle handle, float value) const
+    {
+        set(handle, &value, 1);
+    }
+    void set(UniformHandle handle, const glm::vec2 &value) const
+    {
+        set(handle, &value, 1);
+    }
+    void set(UniformHandle handle, const glm::vec3 &value) const
+    {
+        set(handle, &value, 1);
+    }
+    void set(UniformHandle handle, const glm::vec4 &value) const
+    {
+        set(handle, &value, 1);
+    }
+    void set(UniformHandle handle, const glm::mat3 &value) const
+    {
+        set(handle, &value, 1);
+    }
+    void set(UniformHandle handle, const glm::mat4 &value) const
+    {
+        set(handle, &value, 1);
+    }
+
+    // count consecutive elements of an array uniform from the handle's element on, in one call
+    void set(UniformHandle handle, const int *values, int count) const
+    {
+        if (!needsWrite(handle, values, count))
+            return;
+        renderStats.uniformUploads++;
+        if (handle.program)
+            glProgramUniform1iv(handle.program->ID, handle.location, count, values);
+        else
+            glUniform1iv(handle.location, count, values);
+    }
+    void set(UniformHandle handle, const unsigned int *values, int count) const
+    {
+        if (!needsWrite(handle, values, count))
+            return;
+        renderStats.uniformUploads++;
+        if (handle.program)
+            glProgramUniform1uiv(handle.program->ID, handle.location, count, values);
+        else
+            glUniform1uiv(handle.location, count, values);
+    }
+    void set(UniformHandle handle, const float *values, int count) const
+    {
+        if (!needsWrite(handle, values, count))
+            return;
+        renderStats.uniformUploads++;
+        if (handle.program)
+            glProgramUniform1fv(handle.program->ID, handle.location, count, values);
+        else
+            glUniform1fv(handle.location, count, values);
     }
+    void set(UniformHandle handle, const glm::vec2 *values, int count) const
+    {
+        if (!needsWrite(handle, values, count))
+            return;
+        renderStats.uniformUploads++;
+        if (handle.program)
+            glProgramUniform2fv(handle.program->ID, handle.location, count, glm::value_ptr(values[0]));
+        else
+            glUniform2fv(handle.location, count, glm::value_ptr(values[0]));
+    }
+    void set(UniformHandle handle, const glm::vec3 *values, int count) const
+    {
+        if (!needsWrite(handle, values, count))
+            return;
+        renderStats.uniformUploads++;
+        if (handle.program)
+            glProgramUniform3fv(handle.program->ID, handle.location, count, glm::value_ptr(values[0]));
+        else
+            glUniform3fv(handle.location, count, glm::value_ptr(values[0]));
+    }
+    void set(UniformHandle handle, const glm::vec4 *values, int count) const
+    {
+        if (!needsWrite(handle, values, count))
+            return;
+        renderStats.uniformUploads++;
+        if (handle.program)
+            glProgramUniform4fv(handle.program->ID, handle.location, count, glm::value_ptr(values[0]));
+        else
+            glUniform4fv(handle.location, count, glm::value_ptr(values[0]));
+    }
+    void set(UniformHandle handle, const glm::mat3 *values, int count) const
+    {
+        if (!needsWrite(handle, values, count))
+            return;
+        renderStats.uniformUploads++;
+        if (handle.program)
+            glProgramUniformMatrix3fv(handle.program->ID, handle.location, count, GL_FALSE, glm::value_ptr(values[0]));
+        else
+            glUniformMatrix3fv(handle.location, count, GL_FALSE, glm::value_ptr(values[0]));
+    }
+    void set(UniformHandle handle, const glm::mat4 *values, int count) const
+    {
+        if (!needsWrite(handle, values, count))
+            return;
+        renderStats.uniformUploads++;
+        if (handle.program)
+            glProgramUniformMatrix4fv(handle.program->ID, handle.location, count, GL_FALSE, glm::value_ptr(values[0]));
+        else
+            glUniformMatrix4fv(handle.location, count, GL_FALSE, glm::value_ptr(values[0]));
+    }
+
     // utility uniform functions
     // setting uniforms specifically
-    void setBool(const std::string &name, bool value) const
+    void setBool(UniformName name, bool value) const
+    {
+        set(uniform(name), value);
+    }
+    void setInt(UniformName name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        set(uniform(name), value);
     }
-    void setInt(const std::string &name, int value) const
+    void setFloat(UniformName name, float value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        set(uniform(name), value);
     }
-    void setFloat(const std::string &name, float value) const
+
+    void setVec3(UniformName name, const glm::vec3 &value) const
+    {
+        set(uniform(name), value);
+    }
+
+    void setVec4(UniformName name, const glm::vec4 &value) const
+    {
+        set(uniform(name), value);
+    }
+
+    void setMat3(UniformName name, const glm::mat3 &value) const
+    {
+        set(uniform(name), value);
+    }
+
+    void setMat4(UniformName name, const glm::mat4 &value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        set(uniform(name), value);
     }
 
-    void setMat4(const std::string &name, glm::mat4 value) const
+    // the whole array, or its first count elements, in one upload
+    void setMat4Array(UniformName name, const glm::mat4 *values, int count) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+        set(uniform(name), values, count);
+    }
+
+    void setVec4Array(UniformName name, const glm::vec4 *values, int count) const
+    {
+        set(uniform(name), values, count);
     }
 
   private:
-    void checkCompileErrors(unsigned int shader, std::string type)
+    struct UniformEntry
+    {
+        // UniformName hash of name
+        uint64_t hash;
+        std::string name;
+        int location;
+        GLenum type;
+        int size;
+        // the "name[0]" twin of an array, skipped wherever each uniform is visited once
+        bool alias = false;
+    };
+    // every active uniform of the linked program, filled lazily by finish()
+    mutable std::vector<UniformEntry> uniforms;
+    // the bytes set() last wrote to each location as a single value, empty when unknown;
+    // dropped when glState.uniformGeneration moves on
+    struct UniformValue
+    {
+        unsigned char bytes[64];
+        unsigned char size = 0;
+    };
+    // locations beyond this aren't remembered
+    static const int MAX_REMEMBERED_LOCATION = 1024;
+    mutable std::vector<UniformValue> values;
+    mutable unsigned int valuesGeneration = 0;
+
+    std::vector<std::string> paths;
+    std::vector<std::string> defines;
+    // shader type of a single stage program
+    GLenum stageType = 0;
+    bool separable = false;
+    // vertex and fragment program of a pipeline, and the IDs last put into it
+    Shader *stages[2] = {NULL, NULL};
+    mutable unsigned int attached[2] = {0, 0};
+    // paths and everything they include
+    std::vector<std::string> dependencies;
+    // uniform names and locations of a program made from SPIR-V, the driver doesn't know the names
+    std::vector<std::pair<std::string, int>> spirvUniforms;
+
+    // state of a submitted but not yet checked link
+    mutable bool pending = false;
+    mutable bool linked = false;
+    mutable unsigned int vertex = 0;
+    mutable unsigned int fragment = 0;
+    mutable unsigned int compute = 0;
+    bool cacheable = false;
+    uint64_t cacheKey = 0;
+
+    // false when the handle's program already holds this single value from an earlier set()
+    template <typename T> bool needsWrite(UniformHandle handle, const T *data, int count) const
+    {
+        static_assert(sizeof(T) <= sizeof(UniformValue::bytes), "uniform value too big to remember");
+        const Shader &target = handle.program ? *handle.program : *this;
+        if (target.remember(handle.location, data, sizeof(T), count))
+            return true;
+        renderStats.uniformSkips++;
+        return false;
+    }
+
+    // keeps a single value of location, an array write forgets the locations it covers
+    bool remember(int location, const void *data, size_t size, int count) const
+    {
+        if (location < 0 || location + count > MAX_REMEMBERED_LOCATION)
+            return true;
+        if (valuesGeneration != glState.uniformGeneration)
+        {
+            values.clear();
+            valuesGeneration = glState.uniformGeneration;
+        }
+        if ((size_t)(location + count) > values.size())
+            values.resize(location + count);
+        if (count != 1)
+        {
+            for (int i = 0; i < count; i++)
+                values[location + i].size = 0;
+            return true;
+        }
+        UniformValue &value = values[location];
+        if (value.size == size && std::memcmp(value.bytes, data, size) == 0)
+            return false;
+        std::memcpy(value.bytes, data, size);
+        value.size = (unsigned char)size;
+        return true;
+    }
+
+    // queries all active uniforms once after linking
+    void reflectUniforms() const
+    {
+        uniforms.clear();
+        if (!spirvUniforms.empty())
+        {
+            reflectSpirvUniforms();
+            indexUniforms();
+            return;
+        }
+
+        int count = 0;
+        int maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+        for (int i = 0; i < count; i++)
+        {
+            int length = 0;
+            int size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+
+            UniformEntry entry;
+            entry.name.assign(nameBuffer.data(), length);
+            // arrays are reported as "name[0]", both spellings go into the table so either resolves
+            bool array = entry.name.size() > 3 && entry.name.compare(entry.name.size() - 3, 3, "[0]") == 0;
+            if (array)
+                entry.name.resize(entry.name.size() - 3);
+            entry.location = glGetUniformLocation(ID, entry.name.c_str());
+            entry.type = type;
+            entry.size = size;
+            // members of uniform blocks have no location
+            if (entry.location == -1)
+                continue;
+            uniforms.push_back(entry);
+            if (array)
+            {
+                entry.name += "[0]";
+                entry.alias = true;
+                uniforms.push_back(entry);
+            }
+        }
+        indexUniforms();
+    }
+
+    // hashes the names and sorts by hash for uniform()
+    void indexUniforms() const
+    {
+        for (UniformEntry &entry : uniforms)
+            entry.hash = UniformName(entry.name).hash;
+        std::sort(uniforms.begin(), uniforms.end(),
+                  [](const UniformEntry &a, const UniformEntry &b) { return a.hash < b.hash; });
+        for (size_t i = 1; i < uniforms.size(); i++)
+        {
+            if (uniforms[i].hash == uniforms[i - 1].hash)
+                std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION: " << uniforms[i - 1].name << " and "
+                          << uniforms[i].name << '\n';
+        }
+    }
+
+    // the types and sizes by location, the names come from the module
+    void reflectSpirvUniforms() const
+    {
+        int count = 0;
+        glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+        for (int i = 0; i < count; i++)
+        {
+            const GLenum properties[] = {GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE};
+            int values[3] = {-1, 0, 0};
+            glGetProgramResourceiv(ID, GL_UNIFORM, (GLuint)i, 3, properties, 3, NULL, values);
+            for (const std::pair<std::string, int> &named : spirvUniforms)
+            {
+                if (named.second == values[0])
+                    uniforms.push_back({0, named.first, values[0], (GLenum)values[1], values[2]});
+            }
+        }
+    }
+
+    void setDependencies(std::initializer_list<const ShaderPreprocessor *> stages)
+    {
+        dependencies.clear();
+        for (const ShaderPreprocessor *stage : stages)
+            dependencies.insert(dependencies.end(), stage->files().begin(), stage->files().end());
+    }
+
+    static const char *stageName(GLenum type)
+    {
+        return type == GL_COMPUTE_SHADER ? "compute" : type == GL_VERTEX_SHADER ? "vertex" : "fragment";
+    }
+
+    void attachStages() const
+    {
+        glUseProgramStages(ID, GL_VERTEX_SHADER_BIT, stages[0]->ID);
+        glUseProgramStages(ID, GL_FRAGMENT_SHADER_BIT, stages[1]->ID);
+        attached[0] = stages[0]->ID;
+        attached[1] = stages[1]->ID;
+    }
+
+    // a handle only reaches the first stage that has the name, a uniform both stages read
+    // has to go through a uniform block instead
+    void warnSharedUniforms() const
+    {
+        for (const UniformEntry &entry : stages[1]->uniforms)
+        {
+            if (entry.alias)
+                continue;
+            if (stages[0]->uniform(entry.name).valid())
+                std::cout << "ERROR::SHADER::PIPELINE_SHARED_UNIFORM: " << entry.name << " is only set in "
+                          << stages[0]->paths[0] << '\n';
+        }
+    }
+
+    // reads every uniform of this program and writes it into the replacement where that has
+    // one of the same name and type, then gives it the same uniform block bindings.
+    // Leaves the replacement bound through glState.
+    void copyUniformState(const Shader &replacement) const
+    {
+        glState.useProgram(replacement.ID);
+        for (const UniformEntry &entry : uniforms)
+        {
+            if (entry.alias)
+                continue;
+            int components = 0;
+            char kind = uniformKind(entry.type, components);
+            const UniformEntry *target = NULL;
+            for (const UniformEntry &candidate : replacement.uniforms)
+            {
+                if (!candidate.alias && candidate.name == entry.name && candidate.type == entry.type)
+                    target = &candidate;
+            }
+            if (!kind || !target)
+                continue;
+            for (int element = 0; element < std::min(entry.size, target->size); element++)
+            {
+                std::string name = entry.size > 1 ? entry.name + "[" + std::to_string(element) + "]" : entry.name;
+                // names of a SPIR-V program are unknown to the driver, its arrays have consecutive locations
+                int from = spirvUniforms.empty() ? glGetUniformLocation(ID, name.c_str()) : entry.location + element;
+                int to = glGetUniformLocation(replacement.ID, name.c_str());
+                if (from == -1 || to == -1)
+                    continue;
+                float floats[16];
+                int ints[4];
+                unsigned int uints[4];
+                if (kind == 'f')
+                    glGetUniformfv(ID, from, floats);
+                else if (kind == 'i')
+                    glGetUniformiv(ID, from, ints);
+                else
+                    glGetUniformuiv(ID, from, uints);
+                writeUniform(to, entry.type, kind, components, floats, ints, uints);
+            }
+        }
+
+        int blocks = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+        for (int i = 0; i < blocks; i++)
+        {
+            char name[256];
+            int binding = 0;
+            glGetActiveUniformBlockName(ID, (GLuint)i, sizeof(name), NULL, name);
+            glGetActiveUniformBlockiv(ID, (GLuint)i, GL_UNIFORM_BLOCK_BINDING, &binding);
+            unsigned int index = glGetUniformBlockIndex(replacement.ID, name);
+            if (index != GL_INVALID_INDEX)
+                glUniformBlockBinding(replacement.ID, index, (GLuint)binding);
+        }
+    }
+
+    // 'f', 'i' or 'u' with the component count, 0 for types that aren't copied
+    static char uniformKind(GLenum type, int &components)
+    {
+        struct Kind
+        {
+            GLenum type;
+            char kind;
+            int components;
+        };
+        static const Kind kinds[] = {
+            {GL_FLOAT, 'f', 1},          {GL_FLOAT_VEC2, 'f', 2},        {GL_FLOAT_VEC3, 'f', 3},
+            {GL_FLOAT_VEC4, 'f', 4},     {GL_FLOAT_MAT2, 'f', 4},        {GL_FLOAT_MAT3, 'f', 9},
+            {GL_FLOAT_MAT4, 'f', 16},    {GL_INT, 'i', 1},               {GL_INT_VEC2, 'i', 2},
+            {GL_INT_VEC3, 'i', 3},       {GL_INT_VEC4, 'i', 4},          {GL_BOOL, 'i', 1},
+            {GL_BOOL_VEC2, 'i', 2},      {GL_BOOL_VEC3, 'i', 3},         {GL_BOOL_VEC4, 'i', 4},
+            {GL_UNSIGNED_INT, 'u', 1},   {GL_UNSIGNED_INT_VEC2, 'u', 2}, {GL_UNSIGNED_INT_VEC3, 'u', 3},
+            {GL_UNSIGNED_INT_VEC4, 'u', 4}, {GL_DOUBLE, 0, 0},           {GL_DOUBLE_VEC2, 0, 0},
+            {GL_DOUBLE_VEC3, 0, 0},      {GL_DOUBLE_VEC4, 0, 0},         {GL_FLOAT_MAT2x3, 0, 0},
+            {GL_FLOAT_MAT2x4, 0, 0},     {GL_FLOAT_MAT3x2, 0, 0},        {GL_FLOAT_MAT3x4, 0, 0},
+            {GL_FLOAT_MAT4x2, 0, 0},     {GL_FLOAT_MAT4x3, 0, 0},
+        };
+        for (const Kind &kind : kinds)
+        {
+            if (kind.type == type)
+            {
+                components = kind.components;
+                return kind.kind;
+            }
+        }
+        // samplers and images, their value is the unit
+        components = 1;
+        return 'i';
+    }
+
+    static void writeUniform(int location, GLenum type, char kind, int components, const float *floats,
+                             const int *ints, const unsigned int *uints)
+    {
+        if (type == GL_FLOAT_MAT2)
+            glUniformMatrix2fv(location, 1, GL_FALSE, floats);
+        else if (type == GL_FLOAT_MAT3)
+            glUniformMatrix3fv(location, 1, GL_FALSE, floats);
+        else if (type == GL_FLOAT_MAT4)
+            glUniformMatrix4fv(location, 1, GL_FALSE, floats);
+        else if (kind == 'f' && components == 1)
+            glUniform1fv(location, 1, floats);
+        else if (kind == 'f' && components == 2)
+            glUniform2fv(location, 1, floats);
+        else if (kind == 'f' && components == 3)
+            glUniform3fv(location, 1, floats);
+        else if (kind == 'f')
+            glUniform4fv(location, 1, floats);
+        else if (kind == 'i' && components == 1)
+            glUniform1iv(location, 1, ints);
+        else if (kind == 'i' && components == 2)
+            glUniform2iv(location, 1, ints);
+        else if (kind == 'i' && components == 3)
+            glUniform3iv(location, 1, ints);
+        else if (kind == 'i')
+            glUniform4iv(location, 1, ints);
+        else if (components == 1)
+            glUniform1uiv(location, 1, uints);
+        else if (components == 2)
+            glUniform2uiv(location, 1, uints);
+        else if (components == 3)
+            glUniform3uiv(location, 1, uints);
+        else
+            glUniform4uiv(location, 1, uints);
+    }
+
+    // prints the info log on failure, returns whether compiling/linking succeeded
+    bool checkCompileErrors(unsigned int shader, std::string type) const
     {
         int success;
         char infoLog[1024];
@@ -121,6 +1149,7 @@ class Shader
                           << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
 
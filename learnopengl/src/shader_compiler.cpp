@@ -0,0 +1,276 @@
+#ifndef SHADER_COMPILER_H
+#define SHADER_COMPILER_H
+
+#include "glad/glad.h"
+
+#include "gl_extensions.cpp"
+#include "shader.cpp"
+#include "shader_cooker.cpp"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Front end that submits every program up front and defers the status checks.
+// With GL_KHR_parallel_shader_compile the driver compiles on its own threads
+// and GL_COMPLETION_STATUS_KHR tells us without blocking when a program is done,
+// otherwise the checks still overlap with whatever the caller does in between.
+// Each Shader finishes itself on its first use(), so callers may ignore the compiler
+// after submitting.
+class ShaderCompiler
+{
+  public:
+    // whether the driver compiles in parallel for us
+    bool parallel = false;
+    // whether program pipelines are there (GL 4.1 or GL_ARB_separate_shader_objects), and whether
+    // ShaderVariants builds its permutations out of them, off unless the caller turns it on
+    bool separableSupported = false;
+    bool separable = false;
+    // whether SPIR-V modules can be loaded (GL 4.6 or GL_ARB_gl_spirv), and whether
+    // submitCompute() takes the one cooked by --spirv over the GLSL
+    bool spirvSupported = false;
+    bool spirv = false;
+
+    // loader is used for the extension entry point, e.g. glfwGetProcAddress
+    ShaderCompiler(GLADloadproc loader)
+    {
+        typedef void(APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+        MaxShaderCompilerThreadsProc maxShaderCompilerThreads = NULL;
+        if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+            maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsKHR");
+        else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+            maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsARB");
+
+        if (maxShaderCompilerThreads)
+        {
+            // 0xFFFFFFFF lets the implementation pick the thread count
+            maxShaderCompilerThreads(0xFFFFFFFFu);
+            parallel = true;
+        }
+        separableSupported = GLAD_GL_VERSION_4_1 || hasGLExtension("GL_ARB_separate_shader_objects");
+        // the extension has the same entry point under another name, glShaderBinary is core since 4.1
+        if (!GLAD_GL_VERSION_4_6 && GLAD_GL_VERSION_4_1 && hasGLExtension("GL_ARB_gl_spirv"))
+            glad_glSpecializeShader = (PFNGLSPECIALIZESHADERPROC)loader("glSpecializeShaderARB");
+        spirvSupported = glSpecializeShader != NULL;
+    }
+
+    // starts compiling a program, the returned reference stays valid with the compiler
+    Shader &submit(const char *vertexPath, const char *fragmentPath, const std::vector<std::string> &defines = {})
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        shaders.push_back(std::make_unique<Shader>());
+        shaders.back()->submit(vertexPath, fragmentPath, defines);
+        shaders.back()->buildMilliseconds +=
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return *shaders.back();
+    }
+
+    // With spirv the cooked module of a compute source without defines is specialized instead
+    // of compiling the GLSL, the specializations are ignored otherwise. A constant declared with
+    // SPECIALIZATION() is a uniform in GLSL, the caller sets it to the same value either way
+    Shader &submitCompute(const char *computePath, const std::vector<std::string> &defines = {},
+                          const std::vector<ShaderSpecialization> &specializations = {})
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        shaders.push_back(std::make_unique<Shader>());
+        if (!spirv || !defines.empty() ||
+            !shaders.back()->submitSpirv(GL_COMPUTE_SHADER, computePath, cookedShaderPath(computePath),
+                                         specializations))
+            shaders.back()->submitCompute(computePath, defines);
+        shaders.back()->buildMilliseconds +=
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return *shaders.back();
+    }
+
+    // A separable program of one stage, compiled once for every pipeline that uses the same
+    // file with the same defines
+    Shader &submitStage(GLenum type, const char *path, const std::vector<std::string> &defines = {})
+    {
+        std::string key = std::to_string(type) + " " + assetName(path);
+        for (const std::string &define : defines)
+            key += " " + define;
+        Shader *&cached = stagePrograms[key];
+        if (cached)
+            return *cached;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        shaders.push_back(std::make_unique<Shader>());
+        shaders.back()->submitStage(type, path, defines, true);
+        shaders.back()->buildMilliseconds +=
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        cached = shaders.back().get();
+        return *cached;
+    }
+
+    // the pipeline of two stage programs, one per combination
+    Shader &submitPipeline(Shader &vertexStage, Shader &fragmentStage)
+    {
+        Shader *&cached = pipelines[std::make_pair(&vertexStage, &fragmentStage)];
+        if (!cached)
+        {
+            shaders.push_back(std::make_unique<Shader>());
+            shaders.back()->submitPipeline(vertexStage, fragmentStage);
+            cached = shaders.back().get();
+        }
+        return *cached;
+    }
+
+    // non blocking completion check of a single program
+    bool isReady(const Shader &shader) const
+    {
+        if (!shader.isPending())
+            return true;
+        if (shader.isPipeline())
+            return isReady(*shader.pipelineStage(0)) && isReady(*shader.pipelineStage(1));
+        if (!parallel)
+            return false;
+        int done = 0;
+        glGetProgramiv(shader.ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done != 0;
+    }
+
+    // finishes the programs that are already done, returns how many are still compiling
+    int poll()
+    {
+        int remaining = 0;
+        for (const std::unique_ptr<Shader> &shader : shaders)
+        {
+            if (!shader->isPending())
+                continue;
+            if (isReady(*shader))
+                shader->finish();
+            else
+                remaining++;
+        }
+        return remaining;
+    }
+
+    // blocks until every submitted program is linked and checked
+    void finishAll()
+    {
+        for (const std::unique_ptr<Shader> &shader : shaders)
+            shader->finish();
+    }
+
+    // permutations of a ShaderVariants, keyed by (source hash, feature bits) so every request
+    // for the same sources and features shares one program
+    Shader *findVariant(uint64_t sourceHash, uint32_t features) const
+    {
+        auto found = variants.find(std::make_pair(sourceHash, features));
+        return found == variants.end() ? NULL : found->second;
+    }
+
+    Shader &addVariant(uint64_t sourceHash, uint32_t features, Shader &shader)
+    {
+        variants[std::make_pair(sourceHash, features)] = &shader;
+        return shader;
+    }
+
+    // the program with that Shader::identity(), NULL when none was submitted
+    Shader *find(uint64_t identity) const
+    {
+        for (const std::unique_ptr<Shader> &shader : shaders)
+        {
+            if (shader->identity() == identity)
+                return shader.get();
+        }
+        return NULL;
+    }
+
+    // the program or pipeline with that ID
+    Shader *findID(unsigned int id, bool pipeline) const
+    {
+        for (const std::unique_ptr<Shader> &shader : shaders)
+        {
+            if (shader->ID == id && shader->isPipeline() == pipeline)
+                return shader.get();
+        }
+        return NULL;
+    }
+
+    // Starts rebuilding every program that uses the file from what is on disk now. The
+    // programs keep running with their old ID until pollReloads() swaps in a linked rebuild.
+    // Returns how many programs are rebuilt.
+    int reload(const std::string &path)
+    {
+        int started = 0;
+        for (const std::unique_ptr<Shader> &shader : shaders)
+        {
+            if (!shader->usesSource(path))
+                continue;
+            std::unique_ptr<Shader> replacement = std::make_unique<Shader>();
+            replacement->submitFromDisk(*shader);
+            reloads.push_back({shader.get(), std::move(replacement)});
+            started++;
+        }
+        return started;
+    }
+
+    // swaps in the rebuilds that are done, in the order they were started so a later save
+    // wins. Without parallel compile the driver can't say when one is done and the first
+    // rebuild blocks here. Returns how many are still compiling.
+    int pollReloads()
+    {
+        size_t done = 0;
+        while (done < reloads.size() && isReady(*reloads[done].replacement))
+        {
+            Reload &pending = reloads[done++];
+            std::string files;
+            for (const std::string &path : pending.shader->sourcePaths())
+                files += (files.empty() ? "" : " ") + path;
+            if (pending.shader->replaceWith(*pending.replacement))
+                std::cout << "reloaded " << files << '\n';
+            else
+                std::cout << "ERROR::SHADER::RELOAD_FAILED: keeping the previous build of " << files << '\n';
+            // a rebuild that wasn't taken over still owns its program
+            if (pending.replacement->ID)
+                glDeleteProgram(pending.replacement->ID);
+        }
+        if (done == 0 && !reloads.empty() && !parallel)
+        {
+            reloads.front().replacement->finish();
+            return pollReloads();
+        }
+        reloads.erase(reloads.begin(), reloads.begin() + done);
+        return (int)reloads.size();
+    }
+
+    // main thread time of every program so far, submitting plus finishing
+    double buildMilliseconds() const
+    {
+        double total = 0.0;
+        for (const std::unique_ptr<Shader> &shader : shaders)
+            total += shader->buildMilliseconds;
+        return total;
+    }
+
+    // every program's costs, the pipelines are left out since their stages are in
+    std::vector<ShaderStats> stats() const
+    {
+        std::vector<ShaderStats> result;
+        for (const std::unique_ptr<Shader> &shader : shaders)
+        {
+            if (shader->ID && !shader->isPipeline())
+                result.push_back(shader->stats());
+        }
+        return result;
+    }
+
+  private:
+    struct Reload
+    {
+        Shader *shader;
+        std::unique_ptr<Shader> replacement;
+    };
+    std::vector<std::unique_ptr<Shader>> shaders;
+    std::vector<Reload> reloads;
+    std::map<std::pair<uint64_t, uint32_t>, Shader *> variants;
+    std::map<std::string, Shader *> stagePrograms;
+    std::map<std::pair<Shader *, Shader *>, Shader *> pipelines;
+};
+
+#endif
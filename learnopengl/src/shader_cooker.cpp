@@ -0,0 +1,97 @@
+#ifndef SHADER_COOKER_H
+#define SHADER_COOKER_H
+
+#include "shader_preprocessor.cpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Offline shader cooker: expands the includes of a GLSL stage with the ShaderPreprocessor and
+// compiles it to a SPIR-V module for GL_ARB_gl_spirv with glslangValidator, which has to be on
+// the PATH (or named by the GLSLANG_VALIDATOR environment variable). The modules go under
+// <directory>/cooked, where ShaderCompiler prefers them over compiling the GLSL.
+// Runs without a GL context, see the --spirv command line option in main.cpp.
+// GL_SPIRV is defined while compiling, sources use it for what only SPIR-V has: explicit
+// uniform locations are required and SPECIALIZATION() (specialization.glsl) declares
+// specialization constants instead of uniforms.
+
+// where the cooked version of a stage lives, e.g. src/shader_src/cull.comp -> src/shader_src/cooked/cull.comp.spv
+inline std::string cookedShaderPath(const std::string &sourcePath)
+{
+    std::filesystem::path path(sourcePath);
+    return (path.parent_path() / "cooked" / path.filename()).generic_string() + ".spv";
+}
+
+// glslangValidator's name of the stage, from the extension like the sources in shader_src
+inline const char *shaderCookerStage(const std::string &sourcePath)
+{
+    std::string extension = std::filesystem::path(sourcePath).extension().string();
+    if (extension == ".vs" || extension == ".vert")
+        return "vert";
+    if (extension == ".fs" || extension == ".frag")
+        return "frag";
+    if (extension == ".comp")
+        return "comp";
+    return NULL;
+}
+
+inline bool cookShader(const std::string &sourcePath, const std::string &outputPath)
+{
+    const char *stage = shaderCookerStage(sourcePath);
+    if (!stage)
+    {
+        std::cout << "ERROR::SHADER_COOKER::UNKNOWN_STAGE: " << sourcePath << '\n';
+        return false;
+    }
+    ShaderPreprocessor preprocessor;
+    if (!preprocessor.process(sourcePath, {}, true))
+        return false;
+
+    // the compiler reads one file, the expanded pieces go next to the output for it
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(outputPath).parent_path(), error);
+    std::string expandedPath = outputPath + ".glsl";
+    {
+        std::ofstream expanded(expandedPath, std::ios::binary);
+        for (std::string_view piece : preprocessor.pieces())
+            expanded.write(piece.data(), (std::streamsize)piece.size());
+        if (!expanded)
+        {
+            std::cout << "ERROR::SHADER_COOKER::COULD_NOT_WRITE: " << expandedPath << '\n';
+            return false;
+        }
+    }
+    const char *validator = std::getenv("GLSLANG_VALIDATOR");
+    std::string command = std::string("\"") + (validator ? validator : "glslangValidator") + "\" -G -S " + stage +
+                          " -o \"" + outputPath + "\" \"" + expandedPath + "\"";
+    int status = std::system(command.c_str());
+    std::filesystem::remove(expandedPath, error);
+    if (status != 0)
+    {
+        std::cout << "ERROR::SHADER_COOKER::COMPILE_FAILED: " << sourcePath << " (" << command << ")\n";
+        std::filesystem::remove(outputPath, error);
+        return false;
+    }
+
+    std::cout << "cooked " << sourcePath << " -> " << outputPath << " ("
+              << std::filesystem::file_size(outputPath, error) << " bytes)\n";
+    return true;
+}
+
+// cooks every listed stage, returns the number of failures
+inline int cookShaders(const std::vector<std::string> &sourcePaths)
+{
+    int failures = 0;
+    for (const std::string &source : sourcePaths)
+    {
+        if (!cookShader(source, cookedShaderPath(source)))
+            failures++;
+    }
+    return failures;
+}
+
+#endif
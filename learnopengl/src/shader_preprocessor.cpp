@@ -0,0 +1,176 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include "asset_pack.cpp"
+#include "shader_source.cpp"
+
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Builds the text of one shader stage out of its file, the files it pulls in with
+// #include "name" (relative to the including file, each one once) and "#define NAME"
+// lines put in right after #version. Nothing is concatenated: the result is a list of
+// pieces pointing into the ShaderSources and a few generated lines, which glShaderSource
+// takes as they are, so a file without includes or defines is still a single view of the
+// mapping. #line directives keep the line numbers of compile errors right, with the
+// index into files() as the source string number.
+class ShaderPreprocessor
+{
+  public:
+    std::vector<const char *> strings;
+    std::vector<int> lengths;
+
+    ShaderPreprocessor()
+    {
+    }
+
+    ShaderPreprocessor(const ShaderPreprocessor &) = delete;
+    ShaderPreprocessor &operator=(const ShaderPreprocessor &) = delete;
+
+    // fromDisk as in ShaderSource::load(), false when a file can't be read
+    bool process(const std::string &path, const std::vector<std::string> &defines = {}, bool fromDisk = false)
+    {
+        strings.clear();
+        lengths.clear();
+        sources.clear();
+        generated.clear();
+        paths.clear();
+        this->fromDisk = fromDisk;
+        return expand(path, &defines);
+    }
+
+    // every file that went into the stage, the one passed to process() first
+    const std::vector<std::string> &files() const
+    {
+        return paths;
+    }
+
+    std::vector<std::string_view> pieces() const
+    {
+        std::vector<std::string_view> result;
+        for (size_t i = 0; i < strings.size(); i++)
+            result.push_back(std::string_view(strings[i], (size_t)lengths[i]));
+        return result;
+    }
+
+  private:
+    std::vector<std::unique_ptr<ShaderSource>> sources;
+    // std::unique_ptr so the pointers in strings survive the vector growing
+    std::vector<std::unique_ptr<std::string>> generated;
+    std::vector<std::string> paths;
+    bool fromDisk = false;
+
+    // defines only for the top level file
+    bool expand(const std::string &path, const std::vector<std::string> *defines)
+    {
+        std::string name = assetName(path);
+        for (const std::string &included : paths)
+        {
+            if (assetName(included) == name)
+                return true;
+        }
+        int fileIndex = (int)paths.size();
+        paths.push_back(path);
+        sources.push_back(std::make_unique<ShaderSource>());
+        ShaderSource &source = *sources.back();
+        if (!source.load(path, fromDisk))
+            return false;
+
+        std::string_view text = source.view();
+        size_t chunk = 0;
+        bool needVersion = defines && !defines->empty();
+        if (!defines)
+            generate("#line 1 " + std::to_string(fileIndex) + "\n");
+        int line = 1;
+        for (size_t start = 0; start < text.size(); line++)
+        {
+            size_t end = text.find('\n', start);
+            end = end == std::string_view::npos ? text.size() : end + 1;
+            std::string_view directive = trimmed(text.substr(start, end - start));
+            bool isVersion = directive.compare(0, 8, "#version") == 0;
+            bool isInclude = directive.compare(0, 8, "#include") == 0;
+            // the defines go after #version, or first when there is none
+            if (needVersion && !isVersion && !directive.empty() && directive.compare(0, 2, "//") != 0)
+            {
+                insertDefines(text, chunk, start, *defines, fileIndex, line);
+                needVersion = false;
+            }
+            if (isVersion && needVersion)
+            {
+                insertDefines(text, chunk, end, *defines, fileIndex, line + 1);
+                needVersion = false;
+            }
+            if (isInclude)
+            {
+                size_t open = directive.find('"');
+                size_t close = open == std::string_view::npos ? open : directive.find('"', open + 1);
+                if (close == std::string_view::npos)
+                {
+                    std::cout << "ERROR::SHADER::BAD_INCLUDE: " << path << ":" << line << '\n';
+                    return false;
+                }
+                piece(text, chunk, start);
+                std::string includePath =
+                    (std::filesystem::path(path).parent_path() / std::string(directive.substr(open + 1, close - open - 1)))
+                        .generic_string();
+                if (!expand(includePath, NULL))
+                {
+                    std::cout << "ERROR::SHADER::INCLUDE_FAILED: " << includePath << " from " << path << '\n';
+                    return false;
+                }
+                generate("#line " + std::to_string(line + 1) + " " + std::to_string(fileIndex) + "\n");
+                chunk = end;
+            }
+            start = end;
+        }
+        if (needVersion)
+            insertDefines(text, chunk, text.size(), *defines, fileIndex, line);
+        piece(text, chunk, text.size());
+        return true;
+    }
+
+    // the text up to at, then the defines, then a #line for the line after them
+    void insertDefines(std::string_view text, size_t &chunk, size_t at, const std::vector<std::string> &defines,
+                       int fileIndex, int nextLine)
+    {
+        piece(text, chunk, at);
+        // a last line without newline would run into the first define
+        std::string lines = at > 0 && text[at - 1] != '\n' ? "\n" : "";
+        for (const std::string &define : defines)
+            lines += "#define " + define + "\n";
+        generate(lines + "#line " + std::to_string(nextLine) + " " + std::to_string(fileIndex) + "\n");
+        chunk = at;
+    }
+
+    void piece(std::string_view text, size_t &chunk, size_t end)
+    {
+        if (end > chunk)
+        {
+            strings.push_back(text.data() + chunk);
+            lengths.push_back((int)(end - chunk));
+        }
+        chunk = end;
+    }
+
+    void generate(const std::string &text)
+    {
+        generated.push_back(std::make_unique<std::string>(text));
+        strings.push_back(generated.back()->data());
+        lengths.push_back((int)generated.back()->size());
+    }
+
+    static std::string_view trimmed(std::string_view line)
+    {
+        size_t first = line.find_first_not_of(" \t\r\n");
+        if (first == std::string_view::npos)
+            return std::string_view();
+        size_t last = line.find_last_not_of(" \t\r\n");
+        return line.substr(first, last - first + 1);
+    }
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include "asset_pack.cpp"
+#include "asset_prefetch.cpp"
+#include "mapped_file.cpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+// The text of one shader file as pointer + length for glShaderSource, taken from wherever
+// it already is in memory instead of being copied through iostreams. load() looks in order:
+// a stored entry of the asset pack (the mapping itself), the startup prefetch (shared, not
+// copied), a compressed pack entry (decompressed once) and last the file, mapped.
+// The text is not NUL terminated, always pass length() along.
+class ShaderSource
+{
+  public:
+    ShaderSource()
+    {
+    }
+
+    explicit ShaderSource(const std::string &path, bool fromDisk = false)
+    {
+        load(path, fromDisk);
+    }
+
+    ShaderSource(const ShaderSource &) = delete;
+    ShaderSource &operator=(const ShaderSource &) = delete;
+
+    // fromDisk skips the pack and the prefetch, a reload wants the file as it is now
+    bool load(const std::string &path, bool fromDisk = false)
+    {
+        clear();
+        const unsigned char *packed;
+        size_t packedSize;
+        if (!fromDisk && assetPack.view(path, packed, packedSize))
+            return set((const char *)packed, packedSize);
+        if (!fromDisk && (shared = assetPrefetch.file(path)))
+            return set(shared->data(), shared->size());
+        if (!fromDisk && assetPack.read(path, owned))
+            return set(owned.data(), owned.size());
+        if (mapping.open(path))
+            return set((const char *)mapping.data, mapping.size);
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << '\n';
+        return false;
+    }
+
+    void clear()
+    {
+        text = NULL;
+        textLength = 0;
+        shared.reset();
+        owned.clear();
+        mapping.close();
+    }
+
+    bool loaded() const
+    {
+        return text != NULL;
+    }
+
+    const char *data() const
+    {
+        return text;
+    }
+
+    int length() const
+    {
+        return (int)textLength;
+    }
+
+    std::string_view view() const
+    {
+        return std::string_view(text ? text : "", textLength);
+    }
+
+  private:
+    const char *text = NULL;
+    size_t textLength = 0;
+    // whichever of these backs text
+    std::shared_ptr<const std::string> shared;
+    std::string owned;
+    MappedFile mapping;
+
+    bool set(const char *data, size_t size)
+    {
+        text = data;
+        textLength = size;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,70 @@
+#version 330 core
+// the ambient occlusion onto the frame (see ambient_occlusion.cpp): the HDR frame (input0) times
+// the half resolution occlusion (input1) upsampled bilaterally, the bilinear weights of the four
+// texels around the pixel scaled down by how far their depth (input3) is from the pixel's
+// (input2), so the occlusion stays on its side of an edge. params.z is 1 with reversed Z.
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D input0;
+uniform sampler2D input1;
+uniform sampler2D input2;
+uniform sampler2D input3;
+uniform vec4 params;
+uniform mat4 inverseProjection;
+
+// of the relative depth difference that halves a texel's weight
+const float DEPTH_TOLERANCE = 0.01;
+
+bool isSky(float depth)
+{
+    return params.z > 0.5 ? depth <= 0.0 : depth >= 1.0;
+}
+
+float viewDistance(float depth)
+{
+    float z = params.z > 0.5 ? depth : depth * 2.0 - 1.0;
+    vec4 position = inverseProjection * vec4(0.0, 0.0, z, 1.0);
+    return -position.z / position.w;
+}
+
+float depthAt(sampler2D depths, vec2 uv)
+{
+    ivec2 size = textureSize(depths, 0);
+    return texelFetch(depths, clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1), 0).r;
+}
+
+void main()
+{
+    vec4 color = texture(input0, UV);
+    float depth = depthAt(input2, UV);
+    if (isSky(depth))
+    {
+        FragColor = color;
+        return;
+    }
+    float distance = viewDistance(depth);
+
+    vec2 size = vec2(textureSize(input1, 0));
+    vec2 position = UV * size - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 f = fract(position);
+    float total = 0.0, weights = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), ivec2(size) - 1);
+        vec2 texelUV = (vec2(texel) + 0.5) / size;
+        float texelDepth = depthAt(input3, texelUV);
+        if (isSky(texelDepth))
+            continue;
+        float bilinear = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+        float difference = abs(viewDistance(texelDepth) - distance) / distance;
+        float weight = (bilinear + 1e-3) / (1.0 + difference / DEPTH_TOLERANCE);
+        total += texelFetch(input1, texel, 0).r * weight;
+        weights += weight;
+    }
+    float occlusion = weights > 0.0 ? total / weights : 1.0;
+    FragColor = vec4(color.rgb * occlusion, color.a);
+}
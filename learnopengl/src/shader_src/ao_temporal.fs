@@ -0,0 +1,46 @@
+#version 330 core
+// the ambient occlusion's temporal pass (see ambient_occlusion.cpp): this frame's occlusion
+// (input0) blended into the last one's (input1) reprojected through the half resolution depth
+// (input2), the history clamped to the 3x3 around the pixel first so disocclusions don't ghost.
+// params.x is the weight of this frame, y 1 while there is a history, z 1 with reversed Z.
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D input0;
+uniform sampler2D input1;
+uniform sampler2D input2;
+uniform vec4 params;
+uniform vec2 texelSize;
+// this frame's clip space to the last frame's
+uniform mat4 reprojection;
+
+void main()
+{
+    float current = texture(input0, UV).r;
+    float lowest = current, highest = current;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            float neighbour = texture(input0, UV + vec2(x, y) * texelSize).r;
+            lowest = min(lowest, neighbour);
+            highest = max(highest, neighbour);
+        }
+    }
+
+    ivec2 size = textureSize(input2, 0);
+    float depth = texelFetch(input2, clamp(ivec2(UV * vec2(size)), ivec2(0), size - 1), 0).r;
+    float z = params.z > 0.5 ? depth : depth * 2.0 - 1.0;
+    vec4 previous = reprojection * vec4(UV * 2.0 - 1.0, z, 1.0);
+    vec2 previousUV = previous.xy / previous.w * 0.5 + 0.5;
+    // no history, or none for what was off screen or is the sky at an infinite far plane
+    if (params.y < 0.5 || previous.w <= 0.0 || any(lessThan(previousUV, vec2(0.0))) ||
+        any(greaterThan(previousUV, vec2(1.0))))
+    {
+        FragColor = vec4(current);
+        return;
+    }
+    float history = clamp(texture(input1, previousUV).r, lowest, highest);
+    FragColor = vec4(mix(history, current, params.x));
+}
@@ -0,0 +1,23 @@
+#version 450 core
+#extension GL_ARB_bindless_texture : require
+#include "interface.glsl"
+out vec4 FragColor;
+
+INTERFACE(0) in vec2 TexCoord;
+// material slot, the per-instance layer of the INSTANCED vertex_shader.vs
+INTERFACE(1) flat in int Layer;
+
+// texture handles written by BindlessTextures (see bindless_textures.cpp)
+layout (std430, binding = 1) readonly buffer Materials
+{
+    uvec2 materials[];
+};
+// material blended over every cube
+uniform int decalLayer;
+
+void main()
+{
+    vec4 base = texture(sampler2D(materials[Layer]), TexCoord);
+    vec4 decal = texture(sampler2D(materials[decalLayer]), vec2(-1*TexCoord.x, TexCoord.y));
+    FragColor = mix(base, decal, 0.3);
+}
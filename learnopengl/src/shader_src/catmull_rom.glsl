@@ -0,0 +1,29 @@
+// the Catmull-Rom filter of the 4x4 texels around uv in 9 bilinear taps, the inner two weights
+// of each axis are merged into one tap; sharper than bilinear, but it overshoots at edges
+vec3 catmullRom(sampler2D image, vec2 uv, vec2 texelSize)
+{
+    vec2 position = uv / texelSize;
+    vec2 center = floor(position - 0.5) + 0.5;
+    vec2 f = position - center;
+
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+    vec2 w12 = w1 + w2;
+    vec2 offset12 = w2 / w12;
+
+    vec2 uv0 = (center - 1.0) * texelSize;
+    vec2 uv3 = (center + 2.0) * texelSize;
+    vec2 uv12 = (center + offset12) * texelSize;
+
+    return texture(image, vec2(uv0.x, uv0.y)).rgb * w0.x * w0.y +
+           texture(image, vec2(uv12.x, uv0.y)).rgb * w12.x * w0.y +
+           texture(image, vec2(uv3.x, uv0.y)).rgb * w3.x * w0.y +
+           texture(image, vec2(uv0.x, uv12.y)).rgb * w0.x * w12.y +
+           texture(image, vec2(uv12.x, uv12.y)).rgb * w12.x * w12.y +
+           texture(image, vec2(uv3.x, uv12.y)).rgb * w3.x * w12.y +
+           texture(image, vec2(uv0.x, uv3.y)).rgb * w0.x * w3.y +
+           texture(image, vec2(uv12.x, uv3.y)).rgb * w12.x * w3.y +
+           texture(image, vec2(uv3.x, uv3.y)).rgb * w3.x * w3.y;
+}
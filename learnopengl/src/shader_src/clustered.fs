@@ -0,0 +1,31 @@
+#version 430 core
+#include "interface.glsl"
+#include "material.glsl"
+// fragment_shader.fs's material under the clustered decals, lit by the clustered light lists
+// (see light_clusters.cpp)
+out vec4 FragColor;
+
+INTERFACE(0) in vec2 TexCoord;
+INTERFACE(1) flat in int Layer;
+INTERFACE(2) in vec3 Normal;
+INTERFACE(3) in vec3 WorldPosition;
+
+#include "frame_data.glsl"
+#include "clustered_lights.glsl"
+
+uniform sampler2DArray materials;
+
+#include "lod_fade.glsl"
+
+void main()
+{
+    lodFadeDiscard();
+    vec4 albedo = materialAlbedo(materials, Layer, TexCoord);
+    vec3 normal = normalize(Normal);
+    albedo.rgb = clusteredDecals(materials, albedo.rgb, normal, WorldPosition, gl_FragCoord.xy);
+    vec3 color = clusteredLighting(albedo.rgb, normal, WorldPosition, gl_FragCoord.xy);
+#ifdef VOLUMETRIC_FOG
+    color = applyVolumetricFog(color, WorldPosition, gl_FragCoord.xy);
+#endif
+    FragColor = vec4(color, albedo.a);
+}
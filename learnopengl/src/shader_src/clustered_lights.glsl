@@ -0,0 +1,119 @@
+// the light and decal lists of the clustered forward path (see light_clusters.cpp), after frame_data.glsl
+#include "point_light.glsl"
+#include "decal.glsl"
+
+layout (std140, binding = 4) uniform ClusterData
+{
+    // clusters along x, y and z, w is the number of lights
+    uvec4 clusterGrid;
+    // x is the number of decals
+    uvec4 clusterDecalCount;
+    // xy tile size in pixels, zw scale and bias from log(view depth) to the slice
+    vec4 clusterTile;
+    // x zNear, y zFar, zw the target size in pixels
+    vec4 clusterDepthRange;
+    vec4 ambientColor;
+    // towards the sun
+    vec4 sunDirection;
+    vec4 sunColor;
+};
+
+#ifndef CLUSTER_BUILD
+#ifdef SUN_SHADOWS
+#include "shadows.glsl"
+#endif
+#ifdef ENVIRONMENT_LIGHTING
+#include "environment.glsl"
+#endif
+#ifdef POINT_SHADOWS
+#include "point_shadows.glsl"
+#endif
+
+layout (std430, binding = 12) readonly buffer ClusterLights
+{
+    PointLight clusterLights[];
+};
+layout (std430, binding = 16) readonly buffer ClusterDecals
+{
+    Decal clusterDecals[];
+};
+// offset and count of each cluster's run of lights in clusterIndices, zw of its decals
+layout (std430, binding = 13) readonly buffer Clusters
+{
+    uvec4 clusters[];
+};
+layout (std430, binding = 14) readonly buffer ClusterIndices
+{
+    uint clusterIndices[];
+};
+
+// the runs of the pixel's cluster
+uvec4 findCluster(vec3 position, vec2 fragCoord)
+{
+    float viewDepth = max(-(view * vec4(position, 1.0)).z, clusterDepthRange.x);
+    uint slice = uint(clamp(log(viewDepth) * clusterTile.z + clusterTile.w, 0.0, float(clusterGrid.z - 1u)));
+    uvec2 tile = min(uvec2(fragCoord / clusterTile.xy), clusterGrid.xy - 1u);
+    return clusters[tile.x + clusterGrid.x * (tile.y + clusterGrid.y * slice)];
+}
+
+// albedo with the decals of the pixel's cluster over it, in the order they were added
+vec3 clusteredDecals(sampler2DArray images, vec3 albedo, vec3 normal, vec3 position, vec2 fragCoord)
+{
+    uvec4 cluster = findCluster(position, fragCoord);
+    // before the loop, every invocation of the quad takes them
+    vec3 dpdx = dFdx(position), dpdy = dFdy(position);
+    for (uint i = 0u; i < cluster.w; i++)
+        albedo = applyDecal(clusterDecals[clusterIndices[cluster.z + i]], images, albedo, position, normal, dpdx, dpdy);
+    return albedo;
+}
+
+// the sun, the ambient and the lights of the pixel's cluster on a surface
+vec3 clusteredLighting(vec3 albedo, vec3 normal, vec3 position, vec2 fragCoord)
+{
+    uvec4 cluster = findCluster(position, fragCoord);
+
+    float sun = max(dot(normal, sunDirection.xyz), 0.0);
+#ifdef SUN_SHADOWS
+    if (sun > 0.0)
+        sun *= sunShadow(position, normal);
+#endif
+#ifdef ENVIRONMENT_LIGHTING
+    vec3 color = environmentLighting(albedo, normal, normalize(cameraPosition.xyz - position));
+    color += albedo * sunColor.rgb * sun;
+#else
+    vec3 color = albedo * (ambientColor.rgb + sunColor.rgb * sun);
+#endif
+    for (uint i = 0u; i < cluster.y; i++)
+    {
+        PointLight light = clusterLights[clusterIndices[cluster.x + i]];
+        vec3 lit = shadePointLight(light, albedo, normal, position, cameraPosition.xyz);
+#ifdef POINT_SHADOWS
+        // the w of the color is the index + 1 of the light's shadow, 0 for none
+        if (light.color.w > 0.0 && lit != vec3(0.0))
+            lit *= pointShadow(uint(light.color.w) - 1u, light.positionRadius.xyz, position, normal);
+#endif
+        color += lit;
+    }
+    return color;
+}
+
+#ifdef VOLUMETRIC_FOG
+// light in front and transmittance of the fog up to the far side of each froxel (see volumetric_fog.cpp)
+uniform sampler3D fogVolume;
+
+// the fog between the eye and a surface over the surface's color, with one fetch of the froxel
+// volume, whose columns are the clusters' tiles cut finer and whose slices are theirs
+vec3 applyVolumetricFog(vec3 color, vec3 position, vec2 fragCoord)
+{
+    float viewDepth = max(-(view * vec4(position, 1.0)).z, clusterDepthRange.x);
+    vec3 size = vec3(textureSize(fogVolume, 0));
+    float slice = (log(viewDepth) * clusterTile.z + clusterTile.w) * size.z / float(clusterGrid.z);
+    // a froxel's texel is the fog up to its far side, half a texel further than its center
+    vec3 coord = vec3(fragCoord / (clusterTile.xy * vec2(clusterGrid.xy)), (slice - 0.5) / size.z);
+    vec4 fog = texture(fogVolume, coord);
+    // in front of the first far side the fog thins out to none at the eye
+    fog = mix(vec4(0.0, 0.0, 0.0, 1.0), fog, clamp(slice, 0.0, 1.0));
+    return color * fog.a + fog.rgb;
+}
+#endif
+#endif
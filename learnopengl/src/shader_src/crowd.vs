@@ -0,0 +1,57 @@
+#version 430 core
+#include "interface.glsl"
+// SkinnedVertex vertices of a crowd, posed from the vertex animation texture instead of by
+// joints (see vertex_animation.cpp); only aTexCoord of its VERTEX_INPUTS define is read
+VERTEX_INPUTS
+// xyz where the instance stands, w radians around y
+layout (location = 2) in vec4 aPlacement;
+// x first frame of the clip, y its frames, z frames of offset, w frames per second
+layout (location = 3) in vec4 aAnimation;
+
+// the depth prepass and the shading pass have to agree on the depth exactly
+invariant gl_Position;
+
+INTERFACE(0) out vec2 TexCoord;
+INTERFACE(1) flat out int Layer;
+// world space, for the G-buffer and the lighting
+INTERFACE(2) out vec3 Normal;
+INTERFACE(3) out vec3 WorldPosition;
+
+#include "frame_data.glsl"
+
+// a texel per vertex and frame as skin.comp writes them: float x 3 position and the signed
+// 2_10_10_10 normal
+uniform usamplerBuffer animationTexture;
+// of the first vertex of frame 0 of the draw's primitive, and from one frame to the next
+uniform int firstTexel;
+uniform int frameTexels;
+
+vec3 unpackNormal(uint bits)
+{
+    int packedNormal = int(bits);
+    return max(vec3(ivec3(packedNormal << 22, packedNormal << 12, packedNormal << 2) >> 22) / 511.0, -1.0);
+}
+
+void main()
+{
+    // the clip loops, its last frame blends into its first
+    int frameCount = int(aAnimation.y);
+    float frame = mod(time * aAnimation.w + aAnimation.z, aAnimation.y);
+    int current = min(int(frame), frameCount - 1);
+    int next = current + 1 < frameCount ? current + 1 : 0;
+    float t = frame - float(current);
+    int vertex = firstTexel + int(aAnimation.x) * frameTexels + gl_VertexID;
+    uvec4 a = texelFetch(animationTexture, vertex + current * frameTexels);
+    uvec4 b = texelFetch(animationTexture, vertex + next * frameTexels);
+    vec3 position = mix(uintBitsToFloat(a.xyz), uintBitsToFloat(b.xyz), t);
+    vec3 normal = mix(unpackNormal(a.w), unpackNormal(b.w), t);
+
+    float c = cos(aPlacement.w), s = sin(aPlacement.w);
+    mat3 turn = mat3(c, 0.0, -s, 0.0, 1.0, 0.0, s, 0.0, c);
+    vec4 world = vec4(aPlacement.xyz + turn * position, 1.0);
+    gl_Position = viewProjection * world;
+    WorldPosition = world.xyz;
+    TexCoord = aTexCoord;
+    Layer = 0;
+    Normal = turn * normal;
+}
@@ -0,0 +1,31 @@
+// directions of the texels of a cube map's faces, in GL_TEXTURE_CUBE_MAP_POSITIVE_X + face order,
+// for the compute shaders that write one through an imageCube (see environment_maps.cpp)
+
+// the direction through the middle of texel on a face of size x size texels
+vec3 cubeDirection(ivec2 texel, int face, int size)
+{
+    // s to the right and t down the face, as the cube map lookup takes them
+    vec2 st = (vec2(texel) + 0.5) / float(size) * 2.0 - 1.0;
+    vec3 direction;
+    if (face == 0)
+        direction = vec3(1.0, -st.y, -st.x);
+    else if (face == 1)
+        direction = vec3(-1.0, -st.y, st.x);
+    else if (face == 2)
+        direction = vec3(st.x, 1.0, st.y);
+    else if (face == 3)
+        direction = vec3(st.x, -1.0, -st.y);
+    else if (face == 4)
+        direction = vec3(st.x, -st.y, 1.0);
+    else
+        direction = vec3(-st.x, -st.y, -1.0);
+    return normalize(direction);
+}
+
+// two unit vectors that make a basis with normal
+void tangentBasis(vec3 normal, out vec3 tangent, out vec3 bitangent)
+{
+    vec3 up = abs(normal.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    tangent = normalize(cross(up, normal));
+    bitangent = cross(normal, tangent);
+}
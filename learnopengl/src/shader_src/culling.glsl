@@ -0,0 +1,59 @@
+// Bounding sphere tests of the GPU cull passes (cull.comp, meshlet_cull.comp), after frame_data.glsl.
+// The including pass declares the Hi-Z inputs first: the hiZ pyramid, hiZViewProjection and
+// the hiZReversed specialization constant.
+
+// whether the sphere is at least partly inside the frustum planes of viewProjection
+bool sphereInFrustum(vec3 center, float radius)
+{
+    mat4 m = transpose(viewProjection);
+    vec4 planes[6] = vec4[6](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2]);
+    for (int i = 0; i < 6; i++)
+    {
+        if (dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz))
+            return false;
+    }
+    return true;
+}
+
+// whether the box around the sphere was behind everything drawn under it last frame
+bool isOccluded(vec3 center, float radius)
+{
+    vec2 low = vec2(1.0), high = vec2(0.0);
+    float nearest = hiZReversed ? 0.0 : 1.0;
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0,
+                                             (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = hiZViewProjection * vec4(corner, 1.0);
+        // crossing the camera plane, nothing to compare against
+        if (clip.w <= 0.0)
+            return false;
+        vec3 ndc = clip.xyz / clip.w;
+        low = min(low, ndc.xy * 0.5 + 0.5);
+        high = max(high, ndc.xy * 0.5 + 0.5);
+        nearest = hiZReversed ? max(nearest, ndc.z) : min(nearest, ndc.z * 0.5 + 0.5);
+    }
+    low = clamp(low, 0.0, 1.0);
+    high = clamp(high, 0.0, 1.0);
+
+    // the level where the rectangle spans about 4 texels, so at most 5x5 are read
+    // and they hug the rectangle close enough for nearby occluders to count
+    vec2 size = (high - low) * vec2(textureSize(hiZ, 0));
+    int level = int(ceil(log2(max(max(size.x, size.y) * 0.25, 1.0))));
+    level = clamp(level, 0, textureQueryLevels(hiZ) - 1);
+    // same sizes as the reduction, level n is level 0 halved n times
+    ivec2 levelSize = max(textureSize(hiZ, 0) >> level, ivec2(1));
+    ivec2 first = min(ivec2(low * vec2(levelSize)), levelSize - 1);
+    ivec2 last = min(ivec2(high * vec2(levelSize)), levelSize - 1);
+
+    float farthest = hiZReversed ? 1.0 : 0.0;
+    for (int y = first.y; y <= last.y; y++)
+    {
+        for (int x = first.x; x <= last.x; x++)
+        {
+            float depth = texelFetch(hiZ, ivec2(x, y), level).r;
+            farthest = hiZReversed ? min(farthest, depth) : max(farthest, depth);
+        }
+    }
+    return hiZReversed ? nearest < farthest : nearest > farthest;
+}
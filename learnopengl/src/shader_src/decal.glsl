@@ -0,0 +1,31 @@
+// one projected decal (see decal_set.cpp) and how it goes on a surface, for the clustered path
+struct Decal
+{
+    // world space to the box's -1..1 cube, the decal is projected along its -z
+    mat4 worldToDecal;
+    // xyz center, w radius of the sphere around the box
+    vec4 sphere;
+    // x layer of the materials array, y opacity, z the cosine past which faces fade out
+    vec4 params;
+};
+
+// albedo with the decal over it where position is in its box; dpdx and dpdy are the
+// position's screen derivatives, gradients taken in a loop over the decals aren't defined
+vec3 applyDecal(Decal decal, sampler2DArray images, vec3 albedo, vec3 position, vec3 normal, vec3 dpdx, vec3 dpdy)
+{
+    vec3 local = (decal.worldToDecal * vec4(position, 1.0)).xyz;
+    if (any(greaterThan(abs(local), vec3(1.0))))
+        return albedo;
+    // the box's z in world space, what a surface facing the projector faces
+    vec3 facing = normalize(vec3(decal.worldToDecal[0][2], decal.worldToDecal[1][2], decal.worldToDecal[2][2]));
+    float facingCos = dot(normal, facing);
+    if (facingCos <= decal.params.z)
+        return albedo;
+    mat3 toDecal = mat3(decal.worldToDecal);
+    vec2 uv = local.xy * 0.5 + 0.5;
+    vec4 image = textureGrad(images, vec3(uv, decal.params.x), (toDecal * dpdx).xy * 0.5, (toDecal * dpdy).xy * 0.5);
+    // softer towards the ends of the box and the faces turned away
+    float fade = clamp((1.0 - abs(local.z)) * 4.0, 0.0, 1.0) *
+                 clamp((facingCos - decal.params.z) / (1.0 - decal.params.z) * 4.0, 0.0, 1.0);
+    return mix(albedo, image.rgb, image.a * decal.params.y * fade);
+}
@@ -0,0 +1,96 @@
+#version 330 core
+// first lighting pass of the deferred path: ambient and the sun on every pixel, the clear
+// color where nothing was drawn, or the environment and the sky with ENVIRONMENT_LIGHTING,
+// the light volumes are added on top
+out vec4 FragColor;
+
+#include "gbuffer.glsl"
+#if defined(SUN_SHADOWS) || defined(RAY_TRACED_SHADOWS)
+#include "frame_data.glsl"
+#endif
+#ifdef SUN_SHADOWS
+#include "shadows.glsl"
+#endif
+#ifdef ENVIRONMENT_LIGHTING
+#include "environment.glsl"
+#endif
+
+uniform vec3 ambient;
+// towards the light
+uniform vec3 sunDirection;
+uniform vec3 sunColor;
+uniform vec3 background;
+
+#ifdef RAY_TRACED_SHADOWS
+// the sun's visibility traced at half resolution (see ray_traced_shadows.cpp), x the visibility
+// and y the view depth it is of
+uniform sampler2D sunVisibility;
+
+// the four half resolution texels around the pixel, bilinearly and by how near their depths are
+float tracedVisibility(vec3 position)
+{
+    float depth = -(view * vec4(position, 1.0)).z;
+    ivec2 size = textureSize(sunVisibility, 0);
+    vec2 coord = gl_FragCoord.xy * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(coord));
+    vec2 f = coord - vec2(base);
+    float sum = 0.0, weights = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        vec2 texel = texelFetch(sunVisibility, clamp(base + offset, ivec2(0), size - 1), 0).rg;
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        // a texel of another surface still counts a little, so there is always one
+        float weight = bilinear.x * bilinear.y * (exp(-abs(texel.g - depth) / (depth * 0.02)) + 1e-3);
+        sum += texel.r * weight;
+        weights += weight;
+    }
+    return weights > 0.0 ? sum / weights : 1.0;
+}
+#endif
+
+#ifdef ENVIRONMENT_LIGHTING
+// world position on the view ray of the pixel at NDC z
+vec3 rayPoint(float z)
+{
+    vec2 ndc = gl_FragCoord.xy / vec2(textureSize(gDepth, 0)) * 2.0 - 1.0;
+    vec4 world = inverseViewProjection * vec4(ndc, z, 1.0);
+    return world.xyz / world.w;
+}
+#endif
+
+void main()
+{
+    Surface surface = readGBuffer(ivec2(gl_FragCoord.xy));
+#ifdef ENVIRONMENT_LIGHTING
+    // the near plane is at 1 with reversed-Z, the far one may be at infinity
+    vec3 eye = rayPoint(depthZeroToOne ? 1.0 : -1.0);
+    if (surface.empty)
+    {
+        FragColor = vec4(skyRadiance(normalize(rayPoint(depthZeroToOne ? 0.5 : 0.0) - eye)), 1.0);
+        return;
+    }
+#else
+    if (surface.empty)
+    {
+        FragColor = vec4(background, 1.0);
+        return;
+    }
+#endif
+    float diffuse = max(dot(surface.normal, sunDirection), 0.0);
+#ifdef SUN_SHADOWS
+    if (diffuse > 0.0)
+        diffuse *= sunShadow(surface.position, surface.normal);
+#endif
+#ifdef RAY_TRACED_SHADOWS
+    if (diffuse > 0.0)
+        diffuse *= tracedVisibility(surface.position);
+#endif
+#ifdef ENVIRONMENT_LIGHTING
+    vec3 toEye = normalize(eye - surface.position);
+    vec3 color = environmentLighting(surface.albedo, surface.normal, toEye);
+    FragColor = vec4(color + surface.albedo * sunColor * diffuse, 1.0);
+#else
+    FragColor = vec4(surface.albedo * (ambient + sunColor * diffuse), 1.0);
+#endif
+}
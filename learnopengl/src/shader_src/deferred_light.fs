@@ -0,0 +1,20 @@
+#version 330 core
+// one point light blended onto the pixels its volume covers (see deferred_lighting.cpp)
+out vec4 FragColor;
+
+flat in int LightIndex;
+
+#include "frame_data.glsl"
+#include "gbuffer.glsl"
+#include "point_lights.glsl"
+
+void main()
+{
+    Surface surface = readGBuffer(ivec2(gl_FragCoord.xy));
+    PointLight light = lights[LightIndex];
+    // pixels behind the light's reach are in the volume on screen too
+    if (surface.empty || distance(light.positionRadius.xyz, surface.position) >= light.positionRadius.w)
+        discard;
+    vec3 color = shadePointLight(light, surface.albedo, surface.normal, surface.position, cameraPosition.xyz);
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,9 @@
+#version 330 core
+// the depth prepass (see depth_prepass.cpp), color writes are masked and the depth is fixed function
+#include "lod_fade.glsl"
+
+void main()
+{
+    // the same pixels as the shading pass, which tests against this depth
+    lodFadeDiscard();
+}
@@ -0,0 +1,40 @@
+// image based lighting from the prefiltered environment (see environment_maps.cpp): the
+// irradiance map for the diffuse part and a level of the specular map for the reflection
+uniform samplerCube irradianceMap;
+uniform samplerCube specularMap;
+
+// neither the materials nor the G-buffer hold a roughness, every surface reflects the same
+const float ENVIRONMENT_ROUGHNESS = 0.6;
+// EnvironmentMaps::SPECULAR_LEVELS, roughness 0 to 1 over them
+const float SPECULAR_LEVELS = 6.0;
+// reflectance at normal incidence of a dielectric
+const float ENVIRONMENT_F0 = 0.04;
+
+// what the camera sees of the environment along direction, level 0 is the unfiltered one
+vec3 skyRadiance(vec3 direction)
+{
+    return textureLod(specularMap, direction, 0.0).rgb;
+}
+
+// scale and bias to F0 of the split sum's BRDF term, Karis' analytic fit in place of a
+// lookup texture
+vec2 environmentBRDF(float roughness, float nv)
+{
+    const vec4 c0 = vec4(-1.0, -0.0275, -0.572, 0.022);
+    const vec4 c1 = vec4(1.0, 0.0425, 1.04, -0.04);
+    vec4 r = roughness * c0 + c1;
+    float a004 = min(r.x * r.x, exp2(-9.28 * nv)) * r.x + r.y;
+    return vec2(-1.04, 1.04) * a004 + r.zw;
+}
+
+// the light the environment puts on a surface seen from toEye, in place of a constant ambient
+vec3 environmentLighting(vec3 albedo, vec3 normal, vec3 toEye)
+{
+    float nv = max(dot(normal, toEye), 1e-4);
+    vec2 brdf = environmentBRDF(ENVIRONMENT_ROUGHNESS, nv);
+    float fresnel = ENVIRONMENT_F0 * brdf.x + brdf.y;
+    vec3 diffuse = albedo * texture(irradianceMap, normal).rgb;
+    float level = ENVIRONMENT_ROUGHNESS * (SPECULAR_LEVELS - 1.0);
+    vec3 specular = textureLod(specularMap, reflect(-toEye, normal), level).rgb;
+    return diffuse * (1.0 - fresnel) + specular * fresnel;
+}
@@ -1,13 +1,31 @@
 #version 330 core
+#include "interface.glsl"
+#include "material.glsl"
 out vec4 FragColor;  
 
-in vec2 TexCoord;
+INTERFACE(0) in vec2 TexCoord;
+INTERFACE(1) flat in int Layer;
 
-uniform sampler2D texture1;
-uniform sampler2D texture2;
+// every material of the scene as layers of one texture (see Texture2DArray)
+uniform sampler2DArray materials;
+
+#ifdef LIGHTMAP
+INTERFACE(5) in vec2 LightmapCoord;
+// the baked light of the static batches, RGBM (see lightmap_baker.cpp)
+uniform sampler2D lightmap;
+// LightmapBaker::RANGE
+const float LIGHTMAP_RANGE = 4.0;
+#endif
+
+#include "lod_fade.glsl"
 
 void main()
 {
-    //FragColor = texture(texture1, TexCoord);
-    FragColor = mix(texture(texture1, TexCoord), texture(texture2, vec2(-1*TexCoord.x, TexCoord.y)), 0.3);
+    lodFadeDiscard();
+    //FragColor = texture(materials, vec3(TexCoord, Layer));
+    FragColor = materialAlbedo(materials, Layer, TexCoord);
+#ifdef LIGHTMAP
+    vec4 baked = texture(lightmap, LightmapCoord);
+    FragColor.rgb *= baked.rgb * (baked.a * LIGHTMAP_RANGE);
+#endif
 }
@@ -0,0 +1,14 @@
+// per-frame camera data, shared by all programs (see frame_data.cpp)
+#if defined(GL_SPIRV) || __VERSION__ >= 420
+// the binding of FrameDataBuffer, SPIR-V programs can't be bound by block name
+layout (std140, binding = 0) uniform FrameData
+#else
+layout (std140) uniform FrameData
+#endif
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    float time;
+};
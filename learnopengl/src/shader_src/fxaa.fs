@@ -0,0 +1,133 @@
+#version 330 core
+// FXAA over the tone mapped frame (see antialiasing.cpp), after FXAA 3.11's quality preset:
+// a pixel whose luma contrast to its 4 neighbours is over params.x of the brightest (and over
+// params.y) is on an edge, horizontal or vertical by the larger luma gradient. The edge is
+// followed both ways until its luma changes, and the pixel is blended across it by how near
+// it is to the closer end, so a staircase becomes a slope. A subpixel term smooths what is
+// thinner than a pixel.
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D input0;
+uniform vec2 texelSize;
+uniform vec4 params;
+
+const int SEARCH_STEPS = 10;
+const float STEP_SIZES[SEARCH_STEPS] = float[SEARCH_STEPS](1.0, 1.5, 2.0, 2.0, 2.0, 2.0, 2.0, 2.0, 4.0, 8.0);
+const float SUBPIXEL = 0.75;
+
+float luma(vec3 color)
+{
+    return sqrt(dot(color, vec3(0.299, 0.587, 0.114)));
+}
+
+float lumaAt(vec2 uv)
+{
+    return luma(textureLod(input0, uv, 0.0).rgb);
+}
+
+void main()
+{
+    vec3 color = textureLod(input0, UV, 0.0).rgb;
+    float center = luma(color);
+    float north = lumaAt(UV + vec2(0.0, texelSize.y));
+    float south = lumaAt(UV - vec2(0.0, texelSize.y));
+    float east = lumaAt(UV + vec2(texelSize.x, 0.0));
+    float west = lumaAt(UV - vec2(texelSize.x, 0.0));
+    float highest = max(max(max(north, south), max(east, west)), center);
+    float lowest = min(min(min(north, south), min(east, west)), center);
+    float range = highest - lowest;
+    if (range < max(params.y, highest * params.x))
+    {
+        FragColor = vec4(color, 1.0);
+        return;
+    }
+
+    float northEast = lumaAt(UV + texelSize);
+    float southWest = lumaAt(UV - texelSize);
+    float northWest = lumaAt(UV + vec2(-texelSize.x, texelSize.y));
+    float southEast = lumaAt(UV + vec2(texelSize.x, -texelSize.y));
+
+    // thinner than a pixel: how far the center is from the 3x3 average
+    float average = (2.0 * (north + south + east + west) + northEast + southWest + northWest + southEast) / 12.0;
+    float subpixel = clamp(abs(average - center) / range, 0.0, 1.0);
+    subpixel = smoothstep(0.0, 1.0, subpixel);
+    subpixel = subpixel * subpixel * SUBPIXEL;
+
+    float horizontal = abs(northWest + southWest - 2.0 * west) + 2.0 * abs(north + south - 2.0 * center) +
+                       abs(northEast + southEast - 2.0 * east);
+    float vertical = abs(northWest + northEast - 2.0 * north) + 2.0 * abs(west + east - 2.0 * center) +
+                     abs(southWest + southEast - 2.0 * south);
+    bool isHorizontal = horizontal >= vertical;
+
+    // the neighbour across the edge with the larger gradient
+    float positive = isHorizontal ? north : east;
+    float negative = isHorizontal ? south : west;
+    float positiveGradient = abs(positive - center);
+    float negativeGradient = abs(negative - center);
+    float stepLength = isHorizontal ? texelSize.y : texelSize.x;
+    float edgeLuma;
+    float gradient;
+    if (positiveGradient < negativeGradient)
+    {
+        stepLength = -stepLength;
+        edgeLuma = 0.5 * (negative + center);
+        gradient = negativeGradient;
+    }
+    else
+    {
+        edgeLuma = 0.5 * (positive + center);
+        gradient = positiveGradient;
+    }
+
+    // on the edge between the two pixels, then along it both ways
+    vec2 edgeUV = UV;
+    vec2 along = isHorizontal ? vec2(texelSize.x, 0.0) : vec2(0.0, texelSize.y);
+    if (isHorizontal)
+        edgeUV.y += stepLength * 0.5;
+    else
+        edgeUV.x += stepLength * 0.5;
+    float threshold = gradient * 0.25;
+
+    vec2 uvPositive = edgeUV + along;
+    vec2 uvNegative = edgeUV - along;
+    float endPositive = lumaAt(uvPositive) - edgeLuma;
+    float endNegative = lumaAt(uvNegative) - edgeLuma;
+    bool donePositive = abs(endPositive) >= threshold;
+    bool doneNegative = abs(endNegative) >= threshold;
+    for (int i = 1; i < SEARCH_STEPS && !(donePositive && doneNegative); i++)
+    {
+        if (!donePositive)
+        {
+            uvPositive += along * STEP_SIZES[i];
+            endPositive = lumaAt(uvPositive) - edgeLuma;
+            donePositive = abs(endPositive) >= threshold;
+        }
+        if (!doneNegative)
+        {
+            uvNegative -= along * STEP_SIZES[i];
+            endNegative = lumaAt(uvNegative) - edgeLuma;
+            doneNegative = abs(endNegative) >= threshold;
+        }
+    }
+
+    float distancePositive = isHorizontal ? uvPositive.x - UV.x : uvPositive.y - UV.y;
+    float distanceNegative = isHorizontal ? UV.x - uvNegative.x : UV.y - uvNegative.y;
+    bool positiveCloser = distancePositive < distanceNegative;
+    float closest = min(distancePositive, distanceNegative);
+    float edgeLength = distancePositive + distanceNegative;
+
+    // only blend when the closer end turns the way the center does, else the pixel is outside the slope
+    bool centerSmaller = center - edgeLuma < 0.0;
+    bool correct = ((positiveCloser ? endPositive : endNegative) < 0.0) != centerSmaller;
+    float edgeOffset = correct ? 0.5 - closest / edgeLength : 0.0;
+    float offset = max(edgeOffset, subpixel);
+
+    vec2 finalUV = UV;
+    if (isHorizontal)
+        finalUV.y += offset * stepLength;
+    else
+        finalUV.x += offset * stepLength;
+    FragColor = vec4(textureLod(input0, finalUV, 0.0).rgb, 1.0);
+}
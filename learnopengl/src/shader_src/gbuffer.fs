@@ -0,0 +1,24 @@
+#version 330 core
+#include "interface.glsl"
+#include "material.glsl"
+#include "octahedral.glsl"
+// the geometry pass of the deferred path, fragment_shader.fs's material into the G-buffer
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec2 EncodedNormal;
+
+INTERFACE(0) in vec2 TexCoord;
+INTERFACE(1) flat in int Layer;
+INTERFACE(2) in vec3 Normal;
+
+uniform sampler2DArray materials;
+
+#include "lod_fade.glsl"
+
+void main()
+{
+    lodFadeDiscard();
+    Albedo = materialAlbedo(materials, Layer, TexCoord);
+    Albedo.a = 1.0;
+    // stored unsigned, the compact targets have no signed renderable format
+    EncodedNormal = encodeOctahedral(normalize(Normal)) * 0.5 + 0.5;
+}
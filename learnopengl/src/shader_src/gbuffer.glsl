@@ -0,0 +1,33 @@
+// the G-buffer as the lighting passes read it (see gbuffer.cpp), one texel per fragment
+#include "octahedral.glsl"
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+// maps window positions and depth back to world space
+uniform mat4 inverseViewProjection;
+// glClipControl(GL_ZERO_TO_ONE) is on, depth is NDC z as it is
+uniform bool depthZeroToOne;
+// the depth the buffer is cleared to, nothing was drawn there
+uniform float clearDepth;
+
+struct Surface
+{
+    vec3 albedo;
+    vec3 normal;
+    vec3 position;
+    bool empty;
+};
+
+Surface readGBuffer(ivec2 texel)
+{
+    Surface surface;
+    float depth = texelFetch(gDepth, texel, 0).r;
+    surface.empty = depth == clearDepth;
+    surface.albedo = texelFetch(gAlbedo, texel, 0).rgb;
+    surface.normal = decodeOctahedral(texelFetch(gNormal, texel, 0).rg * 2.0 - 1.0);
+    vec2 ndc = (vec2(texel) + 0.5) / vec2(textureSize(gDepth, 0)) * 2.0 - 1.0;
+    vec4 world = inverseViewProjection * vec4(ndc, depthZeroToOne ? depth : depth * 2.0 - 1.0, 1.0);
+    surface.position = world.xyz / world.w;
+    return surface;
+}
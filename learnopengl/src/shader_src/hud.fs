@@ -0,0 +1,13 @@
+#version 330 core
+in vec2 TexCoord;
+in vec4 Color;
+
+out vec4 FragColor;
+
+// R8 glyph atlas, coverage in the red channel
+uniform sampler2D glyphs;
+
+void main()
+{
+    FragColor = vec4(Color.rgb, Color.a * texture(glyphs, TexCoord).r);
+}
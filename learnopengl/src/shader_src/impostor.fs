@@ -0,0 +1,18 @@
+#version 330 core
+#include "interface.glsl"
+out vec4 FragColor;
+
+INTERFACE(0) in vec2 TexCoord;
+INTERFACE(1) flat in int Layer;
+
+// the baked cells, one layer per material (see impostors.cpp)
+uniform sampler2DArray impostors;
+
+void main()
+{
+    // the mips average the image with the transparent clear, alpha is its coverage
+    vec4 color = texture(impostors, vec3(TexCoord, Layer));
+    if (color.a < 0.5)
+        discard;
+    FragColor = vec4(color.rgb / color.a, 1.0);
+}
@@ -0,0 +1,56 @@
+#version 330 core
+// a quad in place of a far mesh, facing the way the atlas cell nearest to the camera's
+// direction was baked (see impostors.cpp)
+#include "interface.glsl"
+// the instanced model matrix and layer (see instance_buffer.cpp)
+layout (location = 2) in mat4 aModel;
+layout (location = 6) in int aLayer;
+
+INTERFACE(0) out vec2 TexCoord;
+INTERFACE(1) flat out int Layer;
+
+#include "frame_data.glsl"
+
+// the bounding sphere of the baked mesh in its own space, and cells per atlas side
+uniform vec3 boundsCenter;
+uniform float boundsRadius;
+uniform float grid;
+
+// Impostors::octahedralDirection()
+vec3 octahedralDirection(vec2 p)
+{
+    vec3 n = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+    if (n.y < 0.0)
+        n.xz = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// the inverse, n of unit length
+vec2 octahedralPoint(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 p = n.xz;
+    if (n.y < 0.0)
+        p = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+    return p;
+}
+
+void main()
+{
+    // the corners of a 4 vertex strip
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec3 center = (aModel * vec4(boundsCenter, 1.0)).xyz;
+    // the camera in the object's space, scale doesn't change the direction
+    vec3 toCamera = transpose(mat3(aModel)) * (cameraPosition.xyz - center);
+    vec2 cell = clamp(floor((octahedralPoint(normalize(toCamera)) * 0.5 + 0.5) * grid), 0.0, grid - 1.0);
+    vec3 direction = octahedralDirection((cell + 0.5) / grid * 2.0 - 1.0);
+
+    // glm::lookAt()'s axes of the cell's camera, Impostors::cellUp() for its up
+    vec3 up = abs(direction.y) > 0.99 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(-direction, up));
+    vec3 imageUp = cross(right, -direction);
+    vec3 position = boundsCenter + (right * corner.x + imageUp * corner.y) * boundsRadius;
+    gl_Position = viewProjection * (aModel * vec4(position, 1.0));
+    TexCoord = (cell + corner * 0.5 + 0.5) / grid;
+    Layer = aLayer;
+}
@@ -0,0 +1,17 @@
+#version 330 core
+// the forward cube shading of fragment_shader.fs, opaque over the atlas' transparent clear
+#include "interface.glsl"
+#include "material.glsl"
+out vec4 FragColor;
+
+INTERFACE(0) in vec2 TexCoord;
+
+uniform sampler2DArray materials;
+// the material, and the atlas layer being baked
+uniform int layer;
+
+void main()
+{
+    vec4 color = materialAlbedo(materials, layer, TexCoord);
+    FragColor = vec4(color.rgb, 1.0);
+}
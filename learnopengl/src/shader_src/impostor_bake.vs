@@ -0,0 +1,18 @@
+#version 330 core
+// one cell of an impostor atlas, the mesh in its own space from the cell's direction
+// (see impostors.cpp)
+#include "interface.glsl"
+VERTEX_INPUTS
+
+INTERFACE(0) out vec2 TexCoord;
+
+// decodes the quantized positions of the mesh (see mesh.cpp)
+uniform vec3 boundsCenter;
+uniform vec3 boundsExtent;
+uniform mat4 bakeViewProjection;
+
+void main()
+{
+    gl_Position = bakeViewProjection * vec4(boundsCenter + aPos * boundsExtent, 1.0);
+    TexCoord = aTexCoord;
+}
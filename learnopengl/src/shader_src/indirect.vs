@@ -0,0 +1,50 @@
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+#include "interface.glsl"
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 7) in vec3 aNormal;
+
+// the depth prepass and the shading pass have to agree on the depth exactly
+invariant gl_Position;
+
+INTERFACE(0) out vec2 TexCoord;
+INTERFACE(1) flat out int Layer;
+// world space, for the G-buffer and the lighting
+INTERFACE(2) out vec3 Normal;
+INTERFACE(3) out vec3 WorldPosition;
+// the level of detail cross-fade the cull pass left in material.w (see lod_fade.glsl)
+INTERFACE(4) flat out float LodFade;
+
+#include "frame_data.glsl"
+
+// one entry per draw of the multi-draw call (see indirect_renderer.cpp)
+struct ObjectData
+{
+    mat4 model;
+    vec4 boundsCenter;
+    vec4 boundsExtent;
+    ivec4 material;
+};
+layout (std430, binding = 2) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+void main()
+{
+#ifdef MESHLETS
+    // a draw per visible meshlet, its base instance is the object (see meshlet_cull.comp)
+    ObjectData object = objects[gl_BaseInstanceARB];
+#else
+    ObjectData object = objects[gl_DrawIDARB];
+#endif
+    vec3 position = object.boundsCenter.xyz + aPos * object.boundsExtent.xyz;
+    vec4 world = object.model * vec4(position, 1.0);
+    gl_Position = viewProjection * world;
+    WorldPosition = world.xyz;
+    TexCoord = aTexCoord;
+    Layer = object.material.x;
+    LodFade = intBitsToFloat(object.material.w);
+    Normal = mat3(object.model) * aNormal;
+}
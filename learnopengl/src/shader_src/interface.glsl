@@ -0,0 +1,9 @@
+// Locations of what the vertex stages hand to the fragment stages. Separable programs
+// (see Shader::submitPipeline) match their stages by location, not by name, once one side
+// declares something the other doesn't use.
+#ifdef GL_ARB_separate_shader_objects
+#extension GL_ARB_separate_shader_objects : enable
+#define INTERFACE(n) layout (location = n)
+#else
+#define INTERFACE(n)
+#endif
@@ -0,0 +1,20 @@
+#version 330 core
+// a cube around each point light's radius from gl_VertexID, 36 corners wound counter clockwise
+// seen from outside, instance i is lights[i]
+flat out int LightIndex;
+
+#include "frame_data.glsl"
+#include "point_lights.glsl"
+
+// corner c is at -1 or 1 on x, y and z by its bits 0, 1 and 2
+const int CORNERS[36] = int[36](0, 6, 2, 0, 4, 6, 1, 3, 7, 1, 7, 5, 0, 1, 5, 0, 5, 4, 2, 7, 3, 2, 6, 7, 0, 3, 1, 0, 2, 3,
+                                4, 5, 7, 4, 7, 6);
+
+void main()
+{
+    int corner = CORNERS[gl_VertexID];
+    vec3 position = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * 2.0 - 1.0;
+    vec4 light = lights[gl_InstanceID].positionRadius;
+    gl_Position = viewProjection * vec4(light.xyz + position * light.w, 1.0);
+    LightIndex = gl_InstanceID;
+}
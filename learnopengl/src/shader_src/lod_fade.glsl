@@ -0,0 +1,25 @@
+// Dithered cross-fade between two levels of detail of one mesh (see cull.comp): both levels
+// are drawn while it lasts, the incoming one keeps the pixels of a 4x4 ordered pattern
+// below its fade and the outgoing one the rest, so each pixel is covered by exactly one
+// of them and nothing has to be blended. Only programs built with LOD_FADE read the fade.
+#include "interface.glsl"
+#ifdef LOD_FADE
+// of the incoming level, negated for the outgoing one, 0 when not fading
+INTERFACE(4) flat in float LodFade;
+
+void lodFadeDiscard()
+{
+    if (LodFade == 0.0)
+        return;
+    const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0,
+                                      13.0, 5.0);
+    ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+    float threshold = (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
+    if (LodFade > 0.0 ? threshold >= LodFade : threshold < -LodFade)
+        discard;
+}
+#else
+void lodFadeDiscard()
+{
+}
+#endif
@@ -0,0 +1,37 @@
+// The material of a cube: its layer of the materials array with a decal layer blended over.
+// With MATERIAL_TABLE the per-instance layer is the index of a row of the material table
+// (see material_table.cpp), otherwise the layer itself under decalLayer at 0.3. Included
+// before anything but other includes, the extensions have to come first.
+#ifdef MATERIAL_TABLE
+#if __VERSION__ < 430
+#extension GL_ARB_shader_storage_buffer_object : require
+#extension GL_ARB_shading_language_420pack : require
+#endif
+struct Material
+{
+    vec4 tint;
+    // x layer, y the layer blended over it
+    ivec4 layers;
+    // x how much of layers.y
+    vec4 params;
+};
+layout (std430, binding = 23) buffer MaterialTable
+{
+    Material materialTable[];
+};
+#else
+// layer blended over every cube
+uniform int decalLayer;
+#endif
+
+vec4 materialAlbedo(sampler2DArray layerArray, int material, vec2 texCoord)
+{
+#ifdef MATERIAL_TABLE
+    Material row = materialTable[material];
+    vec4 base = texture(layerArray, vec3(texCoord, row.layers.x));
+    return mix(base, texture(layerArray, vec3(-texCoord.x, texCoord.y, row.layers.y)), row.params.x) * row.tint;
+#else
+    return mix(texture(layerArray, vec3(texCoord, material)), texture(layerArray, vec3(-texCoord.x, texCoord.y, decalLayer)),
+               0.3);
+#endif
+}
@@ -0,0 +1,31 @@
+#version 330 core
+#include "interface.glsl"
+out vec4 FragColor;
+
+INTERFACE(0) in vec2 TexCoord;
+INTERFACE(1) in vec3 WorldPosition;
+
+#include "frame_data.glsl"
+
+// xy the slopes along x and z, z the Jacobian (see ocean.cpp)
+uniform sampler2D slopeMap;
+uniform vec3 sunDirection;
+uniform float foamThreshold;
+
+void main()
+{
+    vec3 slope = texture(slopeMap, TexCoord).xyz;
+    vec3 normal = normalize(vec3(-slope.x, 1.0, -slope.y));
+    vec3 view = normalize(cameraPosition.xyz - WorldPosition);
+    float facing = max(dot(normal, view), 0.0);
+    // Schlick with water's reflectance head on
+    float fresnel = 0.02 + 0.98 * pow(1.0 - facing, 5.0);
+    vec3 reflected = reflect(-view, normal);
+    vec3 sky = mix(vec3(0.62, 0.72, 0.8), vec3(0.24, 0.45, 0.75), clamp(reflected.y, 0.0, 1.0));
+    // the light through the crests facing the sun
+    vec3 water = vec3(0.01, 0.06, 0.09) + vec3(0.0, 0.08, 0.07) * max(dot(normal, sunDirection), 0.0);
+    vec3 color = mix(water, sky, fresnel);
+    color += vec3(1.0, 0.95, 0.85) * pow(max(dot(reflected, sunDirection), 0.0), 400.0) * 4.0;
+    float foam = clamp((foamThreshold - slope.z) / max(foamThreshold, 1e-3), 0.0, 1.0);
+    FragColor = vec4(mix(color, vec3(0.88, 0.9, 0.92), foam), 1.0);
+}
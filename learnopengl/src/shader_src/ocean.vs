@@ -0,0 +1,38 @@
+#version 330 core
+#include "interface.glsl"
+// One CDLOD node per instance over the shared grid (see cdlod_grid.cpp), moved by the waves
+// of the repeating patch (see ocean.cpp)
+layout (location = 0) in vec2 aGrid;
+// xy corner, z size, w level
+layout (location = 2) in vec4 aNode;
+
+INTERFACE(0) out vec2 TexCoord;
+INTERFACE(1) out vec3 WorldPosition;
+
+#include "frame_data.glsl"
+
+uniform sampler2D displacementMap;
+uniform float seaLevel;
+uniform float patchSize;
+// quads per side of the grid
+uniform float gridSize;
+// per level the distance the morph starts at and 1 / its length
+uniform vec2 morphRanges[8];
+
+void main()
+{
+    vec2 position = aNode.xy + aGrid * aNode.z;
+    vec2 morph = morphRanges[int(aNode.w)];
+    float distance = length(cameraPosition.xyz - vec3(position.x, seaLevel, position.y));
+    float k = clamp((distance - morph.x) * morph.y, 0.0, 1.0);
+    // the odd vertices slide onto the even ones, the grid of the next coarser level
+    vec2 odd = fract(aGrid * gridSize * 0.5) * 2.0 / gridSize;
+    position = aNode.xy + (aGrid - odd * k) * aNode.z;
+
+    // the level whose texels are as large as the node's quads, so far nodes don't alias
+    float texel = patchSize / float(textureSize(displacementMap, 0).x);
+    float level = max(log2(aNode.z / gridSize / texel), 0.0);
+    TexCoord = position / patchSize;
+    WorldPosition = vec3(position.x, seaLevel, position.y) + textureLod(displacementMap, TexCoord, level).xyz;
+    gl_Position = viewProjection * vec4(WorldPosition, 1.0);
+}
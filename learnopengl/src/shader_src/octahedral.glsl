@@ -0,0 +1,20 @@
+// Unit vectors folded onto the octahedron and flattened to two components in [-1, 1],
+// near uniform precision over the sphere at two channels (see gbuffer.cpp)
+vec2 octahedralWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeOctahedral(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : octahedralWrap(n.xy);
+}
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = octahedralWrap(n.xy);
+    return normalize(n);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+// the weighted blended transparency over the frame (see oit.cpp): the weighted average color
+// with 1 - revealage as its alpha, blended with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+out vec4 FragColor;
+
+uniform sampler2D accumulation;
+uniform sampler2D revealage;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float revealed = texelFetch(revealage, texel, 0).r;
+    // nothing transparent here
+    if (revealed >= 1.0)
+        discard;
+    vec4 sum = texelFetch(accumulation, texel, 0);
+    // a huge sum of weights overflows the half floats, it still averages to the brightest color
+    if (isinf(max(max(abs(sum.r), abs(sum.g)), abs(sum.b))))
+        sum.rgb = vec3(sum.a);
+    FragColor = vec4(sum.rgb / max(sum.a, 1e-5), 1.0 - revealed);
+}
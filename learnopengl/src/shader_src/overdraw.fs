@@ -0,0 +1,12 @@
+#version 330 core
+// the overdraw view (see overdraw.cpp): every fragment adds one to its pixel's count
+#include "lod_fade.glsl"
+
+out vec4 FragColor;
+
+void main()
+{
+    // a cross-fading level only covers its share of the pixels
+    lodFadeDiscard();
+    FragColor = vec4(1.0);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+// the overdraw counts (see overdraw.cpp) over the frame: black where nothing was drawn, then
+// blue, green, yellow, red and white at maxOverdraw fragments per pixel and above
+out vec4 FragColor;
+
+uniform sampler2D counts;
+uniform float maxOverdraw;
+
+void main()
+{
+    float count = texelFetch(counts, ivec2(gl_FragCoord.xy), 0).r;
+    const vec3 ramp[6] = vec3[6](vec3(0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 0.0),
+                                 vec3(1.0, 0.0, 0.0), vec3(1.0));
+    float t = clamp(count / max(maxOverdraw, 1.0), 0.0, 1.0) * 5.0;
+    int i = min(int(t), 4);
+    FragColor = vec4(mix(ramp[i], ramp[i + 1], t - float(i)), 1.0);
+}
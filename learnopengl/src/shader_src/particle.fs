@@ -0,0 +1,13 @@
+#version 430 core
+#include "interface.glsl"
+// a soft round sprite, blended additively over the scene
+out vec4 FragColor;
+
+INTERFACE(0) in vec2 Corner;
+INTERFACE(1) in vec4 Color;
+
+void main()
+{
+    float falloff = max(1.0 - dot(Corner, Corner), 0.0);
+    FragColor = vec4(Color.rgb * Color.a * falloff * falloff, 1.0);
+}
@@ -0,0 +1,30 @@
+#version 430 core
+#include "interface.glsl"
+// a camera facing quad per live particle, the instances of the list simulate wrote (see particles.cpp)
+
+INTERFACE(0) out vec2 Corner;
+INTERFACE(1) out vec4 Color;
+
+#include "frame_data.glsl"
+#include "particles.glsl"
+
+// half the quad's size in world units
+uniform float particleSize;
+// colors at the start and at the end of a particle's life
+uniform vec4 startColor;
+uniform vec4 endColor;
+
+void main()
+{
+    uint slot = aliveList[list * capacity + uint(gl_InstanceID)];
+    vec4 position = particlePositions[slot];
+    float age = 1.0 - position.w / particleVelocities[slot].w;
+    // a triangle strip over the corners (-1, -1), (1, -1), (-1, 1), (1, 1)
+    Corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    // the camera's right and up are the first two rows of the view matrix
+    vec3 right = vec3(view[0][0], view[1][0], view[2][0]);
+    vec3 up = vec3(view[0][1], view[1][1], view[2][1]);
+    vec3 world = position.xyz + (right * Corner.x + up * Corner.y) * particleSize;
+    gl_Position = viewProjection * vec4(world, 1.0);
+    Color = mix(startColor, endColor, age);
+}
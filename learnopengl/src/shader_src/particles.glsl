@@ -0,0 +1,32 @@
+// the particle buffers of ParticleSystem (see particles.cpp), structure of arrays:
+// xyz position and w the life left in seconds, xyz velocity and w the life it started with
+layout (std430, binding = 2) buffer ParticlePositions
+{
+    vec4 particlePositions[];
+};
+layout (std430, binding = 3) buffer ParticleVelocities
+{
+    vec4 particleVelocities[];
+};
+// the free slots, a stack of deadCount entries
+layout (std430, binding = 4) buffer ParticleDead
+{
+    uint deadList[];
+};
+// two lists of the live slots, capacity apart: this frame's and the one simulate appends to
+layout (std430, binding = 5) buffer ParticleAlive
+{
+    uint aliveList[];
+};
+// mirrors ParticleCounters: the dispatch of the simulate pass and a DrawArraysIndirectCommand
+// per alive list, whose instance count is the length of that list
+layout (std430, binding = 6) buffer ParticleCounters
+{
+    uvec3 simulateGroups;
+    int deadCount;
+    uvec4 aliveDraws[2];
+};
+
+uniform uint capacity;
+// the list that is read this frame, 0 or 1
+uniform uint list;
@@ -0,0 +1,10 @@
+#version 330 core
+// the object id + 1 into the R32UI pick target, 0 is the clear value for nothing
+out uint ObjectId;
+
+uniform uint id;
+
+void main()
+{
+    ObjectId = id;
+}
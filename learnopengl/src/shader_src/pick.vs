@@ -0,0 +1,14 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// the view narrowed to the pixels around the pick point (see picking.cpp)
+uniform mat4 regionViewProjection;
+uniform mat4 model;
+// decodes the quantized positions of the mesh (see mesh.cpp)
+uniform vec3 boundsCenter;
+uniform vec3 boundsExtent;
+
+void main()
+{
+    gl_Position = regionViewProjection * (model * vec4(boundsCenter + aPos * boundsExtent, 1.0));
+}
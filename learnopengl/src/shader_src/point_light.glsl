@@ -0,0 +1,30 @@
+// one point light (see light_set.cpp) and how it lights a surface, for the deferred and the clustered path
+struct PointLight
+{
+    // xyz position, w radius of influence
+    vec4 positionRadius;
+    // rgb color times intensity, w the index + 1 of its shadow in point_shadows.glsl, 0 for none
+    vec4 color;
+};
+
+// inverse square, falling to zero at the radius so the edge of a light's reach never shows
+float pointLightAttenuation(PointLight light, float distance)
+{
+    float window = clamp(1.0 - pow(distance / light.positionRadius.w, 4.0), 0.0, 1.0);
+    return window * window / (distance * distance + 1.0);
+}
+
+// Blinn-Phong
+vec3 shadePointLight(PointLight light, vec3 albedo, vec3 normal, vec3 position, vec3 eye)
+{
+    vec3 toLight = light.positionRadius.xyz - position;
+    float distance = length(toLight);
+    if (distance >= light.positionRadius.w)
+        return vec3(0.0);
+    vec3 l = toLight / max(distance, 1e-4);
+    vec3 h = normalize(l + normalize(eye - position));
+    float attenuation = pointLightAttenuation(light, distance);
+    float diffuse = max(dot(normal, l), 0.0);
+    float specular = diffuse > 0.0 ? pow(max(dot(normal, h), 0.0), 32.0) * 0.5 : 0.0;
+    return light.color.rgb * (albedo * diffuse + specular) * attenuation;
+}
@@ -0,0 +1,7 @@
+// the point lights of the deferred path (see deferred_lighting.cpp)
+#include "point_light.glsl"
+#define MAX_POINT_LIGHTS 256
+layout (std140) uniform PointLights
+{
+    PointLight lights[MAX_POINT_LIGHTS];
+};
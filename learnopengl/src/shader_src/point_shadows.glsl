@@ -0,0 +1,44 @@
+// the shadows of the clustered point lights from the atlas (see shadow_atlas.cpp)
+struct PointShadow
+{
+    // world to the atlas of each cube face, xy the texture coordinates and z the depth
+    mat4 faceMatrices[6];
+    // the part of the atlas each face may be filtered in, xy the low corner and zw the high one
+    vec4 faceRects[6];
+    // x depth bias, y normal offset in texels, z size of the face in texels, w 1 / atlas size
+    vec4 params;
+};
+
+layout (std430, binding = 17) readonly buffer PointShadows
+{
+    PointShadow pointShadows[];
+};
+
+uniform sampler2DShadow shadowAtlas;
+
+// how much of the light at lightPosition reaches a surface, 3x3 filtered inside the page of
+// the cube face the surface is in
+float pointShadow(uint index, vec3 lightPosition, vec3 position, vec3 normal)
+{
+    PointShadow shadow = pointShadows[index];
+    vec3 toSurface = position - lightPosition;
+    vec3 axis = abs(toSurface);
+    int face = axis.x >= axis.y && axis.x >= axis.z ? (toSurface.x > 0.0 ? 0 : 1)
+             : axis.y >= axis.z                     ? (toSurface.y > 0.0 ? 2 : 3)
+                                                    : (toSurface.z > 0.0 ? 4 : 5);
+    // a texel of the face at the surface's distance spans twice the distance over the face's size
+    float texel = 2.0 * max(axis.x, max(axis.y, axis.z)) / shadow.params.z;
+    vec4 clip = shadow.faceMatrices[face] * vec4(position + normal * texel * shadow.params.y, 1.0);
+    vec3 coord = clip.xyz / clip.w;
+    vec4 rect = shadow.faceRects[face];
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            vec2 uv = clamp(coord.xy + vec2(x, y) * shadow.params.w, rect.xy, rect.zw);
+            lit += texture(shadowAtlas, vec3(uv, coord.z - shadow.params.x));
+        }
+    }
+    return lit / 9.0;
+}
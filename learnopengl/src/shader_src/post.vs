@@ -0,0 +1,10 @@
+#version 330 core
+// fullscreen.vs with the target's texture coordinates, for the post-processing passes
+out vec2 UV;
+
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    UV = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,25 @@
+#version 330 core
+// a post-processing pass (see post_process.cpp): 9 tap gaussian of input0 along params.xy in
+// 5 bilinear taps, one direction per pass
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D input0;
+uniform vec2 texelSize;
+uniform vec4 params;
+
+const float OFFSETS[3] = float[3](0.0, 1.3846153846, 3.2307692308);
+const float WEIGHTS[3] = float[3](0.2270270270, 0.3162162162, 0.0702702703);
+
+void main()
+{
+    vec2 step = params.xy * texelSize;
+    vec3 color = texture(input0, UV).rgb * WEIGHTS[0];
+    for (int i = 1; i < 3; i++)
+    {
+        color += texture(input0, UV + step * OFFSETS[i]).rgb * WEIGHTS[i];
+        color += texture(input0, UV - step * OFFSETS[i]).rgb * WEIGHTS[i];
+    }
+    FragColor = vec4(color, 1.0);
+}
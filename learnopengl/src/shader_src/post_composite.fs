@@ -0,0 +1,34 @@
+#version 330 core
+// the last post-processing pass (see post_process.cpp): the HDR frame (input0) with the bloom
+// (input1, upsampled by the bilinear filter) added, exposed by params.x, params.y of the bloom,
+// and tone mapped with the ACES fit to the window's 0..1; with AUTO_EXPOSURE params.x is scaled
+// by the measured exposure, the red of input EXPOSURE_INPUT's texel (see auto_exposure.cpp), 1
+// when there is no bloom and 2 after it
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D input0;
+uniform sampler2D input1;
+uniform vec4 params;
+#if defined(AUTO_EXPOSURE) && EXPOSURE_INPUT == 2
+uniform sampler2D input2;
+#define exposureTexture input2
+#elif defined(AUTO_EXPOSURE)
+#define exposureTexture input1
+#endif
+
+vec3 tonemapACES(vec3 color)
+{
+    return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main()
+{
+    vec3 color = texture(input0, UV).rgb + texture(input1, UV).rgb * params.y;
+    float exposure = params.x;
+#ifdef AUTO_EXPOSURE
+    exposure *= texelFetch(exposureTexture, ivec2(0), 0).r;
+#endif
+    FragColor = vec4(tonemapACES(color * exposure), 1.0);
+}
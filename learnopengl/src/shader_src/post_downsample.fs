@@ -0,0 +1,27 @@
+#version 330 core
+// a post-processing pass (see post_process.cpp): input0 into a smaller target as the average of
+// four bilinear taps of 2x2 texels each; with params.x > 0 only what is brighter than params.x,
+// faded in over params.y more, for the bloom
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D input0;
+// of input0
+uniform vec2 texelSize;
+uniform vec4 params;
+
+void main()
+{
+    vec3 color = texture(input0, UV + vec2(-1.0, -1.0) * texelSize).rgb;
+    color += texture(input0, UV + vec2(1.0, -1.0) * texelSize).rgb;
+    color += texture(input0, UV + vec2(-1.0, 1.0) * texelSize).rgb;
+    color += texture(input0, UV + vec2(1.0, 1.0) * texelSize).rgb;
+    color *= 0.25;
+    if (params.x > 0.0)
+    {
+        float brightness = max(color.r, max(color.g, color.b));
+        color *= clamp((brightness - params.x) / max(params.y, 1e-4), 0.0, 1.0);
+    }
+    FragColor = vec4(color, 1.0);
+}
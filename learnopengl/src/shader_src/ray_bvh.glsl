@@ -0,0 +1,115 @@
+// ray queries against the TriangleBvh (see triangle_bvh.cpp) for compute shaders: the nearest
+// hit of a ray and whether anything is in its way, for shadow and occlusion rays
+struct BvhNode
+{
+    vec3 low;
+    // of an inner node its left child, the right one follows it; of a leaf its first triangle
+    uint leftFirst;
+    vec3 high;
+    // triangles of a leaf, 0 for an inner node
+    uint count;
+};
+
+struct BvhTriangle
+{
+    vec3 corner;
+    uint instance;
+    vec4 edge1;
+    vec4 edge2;
+};
+
+layout (std430, binding = 25) readonly buffer BvhNodes
+{
+    BvhNode bvhNodes[];
+};
+layout (std430, binding = 26) readonly buffer BvhTriangles
+{
+    BvhTriangle bvhTriangles[];
+};
+
+// TriangleBvh::MAX_DEPTH, the builder keeps the tree within it
+const int BVH_STACK = 64;
+
+// distance along the ray to where it enters the box, a huge one when it misses
+float bvhEnterBox(uint node, vec3 origin, vec3 inverse)
+{
+    vec3 t0 = (bvhNodes[node].low - origin) * inverse;
+    vec3 t1 = (bvhNodes[node].high - origin) * inverse;
+    vec3 near = min(t0, t1), far = max(t0, t1);
+    float enter = max(max(near.x, near.y), max(near.z, 0.0));
+    float exit = min(far.x, min(far.y, far.z));
+    return enter <= exit ? enter : 1e30;
+}
+
+// Moeller-Trumbore, the distance to the hit from either side, a huge one for a miss
+float bvhIntersect(uint index, vec3 origin, vec3 direction)
+{
+    BvhTriangle triangle = bvhTriangles[index];
+    vec3 p = cross(direction, triangle.edge2.xyz);
+    float determinant = dot(triangle.edge1.xyz, p);
+    if (abs(determinant) < 1e-12)
+        return 1e30;
+    float inverse = 1.0 / determinant;
+    vec3 s = origin - triangle.corner;
+    float u = dot(s, p) * inverse;
+    vec3 q = cross(s, triangle.edge1.xyz);
+    float v = dot(direction, q) * inverse;
+    float t = dot(triangle.edge2.xyz, q) * inverse;
+    return u >= 0.0 && v >= 0.0 && u + v <= 1.0 && t > 0.0 ? t : 1e30;
+}
+
+// the walk of both queries, with anyHit the first triangle found within maxDistance ends it
+bool bvhTrace(vec3 origin, vec3 direction, float maxDistance, bool anyHit, out float distance, out uint triangle)
+{
+    vec3 inverse = 1.0 / direction;
+    distance = maxDistance;
+    triangle = 0u;
+    bool found = false;
+    uint pending[BVH_STACK];
+    int top = 0;
+    pending[top++] = 0u;
+    while (top > 0)
+    {
+        uint index = pending[--top];
+        if (bvhEnterBox(index, origin, inverse) >= distance)
+            continue;
+        BvhNode node = bvhNodes[index];
+        if (node.count == 0u)
+        {
+            // the nearer child on top
+            float left = bvhEnterBox(node.leftFirst, origin, inverse);
+            float right = bvhEnterBox(node.leftFirst + 1u, origin, inverse);
+            pending[top++] = left < right ? node.leftFirst + 1u : node.leftFirst;
+            pending[top++] = left < right ? node.leftFirst : node.leftFirst + 1u;
+            continue;
+        }
+        for (uint i = node.leftFirst; i < node.leftFirst + node.count; i++)
+        {
+            float t = bvhIntersect(i, origin, direction);
+            if (t < distance)
+            {
+                distance = t;
+                triangle = i;
+                found = true;
+                if (anyHit)
+                    return true;
+            }
+        }
+    }
+    return found;
+}
+
+// the nearest triangle the ray from origin along the unit direction hits within maxDistance,
+// its index into bvhTriangles and the distance to it
+bool bvhClosestHit(vec3 origin, vec3 direction, float maxDistance, out float distance, out uint triangle)
+{
+    return bvhTrace(origin, direction, maxDistance, false, distance, triangle);
+}
+
+// whether any triangle is on the ray within maxDistance
+bool bvhOccluded(vec3 origin, vec3 direction, float maxDistance)
+{
+    float distance;
+    uint triangle;
+    return bvhTrace(origin, direction, maxDistance, true, distance, triangle);
+}
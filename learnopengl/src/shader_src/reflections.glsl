@@ -0,0 +1,37 @@
+// the depth helpers of the screen space reflection passes (see screen_space_reflections.cpp),
+// over the nearest depth pyramid of the HiZBuffer; params.z is 1 with reversed Z
+uniform mat4 inverseProjection;
+
+bool isSky(float depth)
+{
+    return params.z > 0.5 ? depth <= 0.0 : depth >= 1.0;
+}
+
+// the depth of the pyramid's texel under uv at level
+float depthAt(sampler2D pyramid, vec2 uv, int level)
+{
+    ivec2 size = textureSize(pyramid, level);
+    return texelFetch(pyramid, clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1), level).r;
+}
+
+vec3 viewPosition(vec2 uv, float depth)
+{
+    // reversed Z comes with the 0..1 clip range, the depth is the NDC z
+    float z = params.z > 0.5 ? depth : depth * 2.0 - 1.0;
+    vec4 position = inverseProjection * vec4(uv * 2.0 - 1.0, z, 1.0);
+    return position.xyz / position.w;
+}
+
+// the view space normal at uv from the depths of the neighbouring texels of level, on each axis
+// the side nearer to the pixel's depth so an edge doesn't bend it
+vec3 viewNormal(sampler2D pyramid, vec2 uv, vec3 position, int level)
+{
+    vec2 texel = 1.0 / vec2(textureSize(pyramid, level));
+    vec3 left = viewPosition(uv - vec2(texel.x, 0.0), depthAt(pyramid, uv - vec2(texel.x, 0.0), level));
+    vec3 right = viewPosition(uv + vec2(texel.x, 0.0), depthAt(pyramid, uv + vec2(texel.x, 0.0), level));
+    vec3 down = viewPosition(uv - vec2(0.0, texel.y), depthAt(pyramid, uv - vec2(0.0, texel.y), level));
+    vec3 up = viewPosition(uv + vec2(0.0, texel.y), depthAt(pyramid, uv + vec2(0.0, texel.y), level));
+    vec3 dx = abs(right.z - position.z) < abs(position.z - left.z) ? right - position : position - left;
+    vec3 dy = abs(up.z - position.z) < abs(position.z - down.z) ? up - position : position - down;
+    return normalize(cross(dx, dy));
+}
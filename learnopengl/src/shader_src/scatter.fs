@@ -0,0 +1,20 @@
+#version 330 core
+#include "interface.glsl"
+out vec4 FragColor;
+
+INTERFACE(0) in vec3 Normal;
+INTERFACE(1) in float Tint;
+INTERFACE(2) in float Height;
+
+// towards the sun (see terrain.cpp)
+uniform vec3 sunDirection;
+
+void main()
+{
+    // darker at the root, where the terrain.fs grass is, lighter and yellower at the tips
+    vec3 root = vec3(0.16, 0.32, 0.11), tip = mix(vec3(0.36, 0.58, 0.2), vec3(0.58, 0.6, 0.26), Tint);
+    vec3 color = mix(root, tip, Height);
+    // blades are lit from either side
+    float light = 0.35 + 0.65 * abs(dot(normalize(Normal), sunDirection));
+    FragColor = vec4(color * light, 1.0);
+}
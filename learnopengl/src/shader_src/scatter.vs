@@ -0,0 +1,31 @@
+#version 330 core
+#include "interface.glsl"
+// One scattered instance of the grass mesh per instance, both levels of detail out of the lists
+// scatter.comp wrote (see procedural_scatter.cpp)
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+// xyz on the terrain and w the scale
+layout (location = 2) in vec4 aPlacement;
+// xy the cosine and sine of the turn about y, z the tint
+layout (location = 3) in vec4 aLook;
+
+INTERFACE(0) out vec3 Normal;
+INTERFACE(1) out float Tint;
+// 0 at the root, 1 at the tip
+INTERFACE(2) out float Height;
+
+#include "frame_data.glsl"
+
+void main()
+{
+    mat2 turn = mat2(aLook.x, aLook.y, -aLook.y, aLook.x);
+    vec3 local = aPos * aPlacement.w;
+    local.xz = turn * local.xz;
+    // the tips sway in the wind, out of step from one instance to the next
+    float sway = sin(time * 1.7 + aPlacement.x * 0.35 + aPlacement.z * 0.27) * 0.08;
+    local.x += sway * aPos.y * aPos.y * aPlacement.w;
+    Normal = vec3(turn * aNormal.xz, aNormal.y).xzy;
+    Tint = aLook.z;
+    Height = clamp(aPos.y * 2.0, 0.0, 1.0);
+    gl_Position = viewProjection * vec4(aPlacement.xyz + local, 1.0);
+}
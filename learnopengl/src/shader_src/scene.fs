@@ -0,0 +1,43 @@
+#version 330 core
+#include "interface.glsl"
+#ifdef WEIGHTED_OIT
+// the sums of the weighted blended transparency (see oit.cpp)
+layout (location = 0) out vec4 accumulation;
+layout (location = 1) out float revealage;
+#include "frame_data.glsl"
+#else
+out vec4 FragColor;
+#endif
+
+INTERFACE(0) in vec2 TexCoord;
+#ifdef WEIGHTED_OIT
+INTERFACE(3) in vec3 WorldPosition;
+#endif
+
+// glTF base color (see gltf_loader.cpp)
+uniform sampler2D baseColorTexture;
+uniform vec4 baseColorFactor;
+#ifdef ALPHA_TEST
+// alphaMode MASK
+uniform float alphaCutoff;
+#endif
+
+void main()
+{
+    vec4 color = texture(baseColorTexture, TexCoord) * baseColorFactor;
+#ifdef ALPHA_TEST
+    if (color.a < alphaCutoff)
+        discard;
+#endif
+#ifdef WEIGHTED_OIT
+    // equation 7 of the paper on the view distance, which doesn't depend on the depth range
+    // or on reversed-Z the way gl_FragCoord.z does
+    float distance = length(WorldPosition - cameraPosition.xyz);
+    float weight =
+        color.a * clamp(10.0 / (1e-5 + pow(distance / 5.0, 2.0) + pow(distance / 200.0, 6.0)), 1e-2, 3e3);
+    accumulation = vec4(color.rgb * color.a, color.a) * weight;
+    revealage = color.a;
+#else
+    FragColor = color;
+#endif
+}
@@ -0,0 +1,17 @@
+#version 330 core
+in vec2 TexCoord;
+in vec4 Color;
+
+out vec4 FragColor;
+
+// R8 distance field page, 0.5 on the outline (see sdf_text.cpp)
+uniform sampler2D sprites;
+
+void main()
+{
+    float distance = texture(sprites, TexCoord).r;
+    // about one screen pixel of antialiasing at any size
+    float width = max(fwidth(distance) * 0.7, 1e-4);
+    float coverage = smoothstep(0.5 - width, 0.5 + width, distance);
+    FragColor = vec4(Color.rgb, Color.a * coverage);
+}
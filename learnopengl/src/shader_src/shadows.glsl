@@ -0,0 +1,43 @@
+// the cascaded shadow maps of the sun (see shadow_maps.cpp), after frame_data.glsl
+#if defined(GL_SPIRV) || __VERSION__ >= 420
+layout (std140, binding = 5) uniform ShadowData
+#else
+layout (std140) uniform ShadowData
+#endif
+{
+    // world to shadow map space of each cascade, xy the texture coordinates and z the depth
+    mat4 cascadeMatrices[4];
+    // the view depth each cascade reaches
+    vec4 cascadeSplits;
+    // world size of a texel of each cascade
+    vec4 cascadeTexelSizes;
+    // x depth bias, y normal offset in texels, z cascade count, w 1 / map size
+    vec4 shadowParams;
+};
+
+uniform sampler2DArrayShadow shadowMaps;
+
+// how much of the sun reaches a surface, 3x3 filtered; 1 beyond the last cascade
+float sunShadow(vec3 position, vec3 normal)
+{
+    float viewDepth = -(view * vec4(position, 1.0)).z;
+    int cascade = 0;
+    int count = int(shadowParams.z);
+    while (cascade < count && viewDepth > cascadeSplits[cascade])
+        cascade++;
+    if (cascade == count)
+        return 1.0;
+
+    vec3 offsetPosition = position + normal * cascadeTexelSizes[cascade] * shadowParams.y;
+    vec3 coord = (cascadeMatrices[cascade] * vec4(offsetPosition, 1.0)).xyz;
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            vec2 uv = coord.xy + vec2(x, y) * shadowParams.w;
+            lit += texture(shadowMaps, vec4(uv, float(cascade), coord.z - shadowParams.x));
+        }
+    }
+    return lit / 9.0;
+}
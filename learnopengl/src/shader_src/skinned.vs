@@ -0,0 +1,33 @@
+#version 430 core
+#include "interface.glsl"
+// SkinnedVertex vertices, skinned by the joints of the draw's instance (see skinning.cpp);
+// aPos, aTexCoord, aNormal, aJoints and aWeights come from its VERTEX_INPUTS define
+VERTEX_INPUTS
+
+// the depth prepass and the shading pass have to agree on the depth exactly
+invariant gl_Position;
+
+INTERFACE(0) out vec2 TexCoord;
+INTERFACE(1) flat out int Layer;
+// world space, for the G-buffer and the lighting
+INTERFACE(2) out vec3 Normal;
+INTERFACE(3) out vec3 WorldPosition;
+
+#include "frame_data.glsl"
+#include "skinning.glsl"
+
+// decodes the quantized positions of the mesh (see mesh.cpp)
+uniform vec3 boundsCenter;
+uniform vec3 boundsExtent;
+
+void main()
+{
+    // the palette already places the instance in the world
+    mat4 skin = skinMatrix(aJoints, aWeights);
+    vec4 world = skin * vec4(boundsCenter + aPos * boundsExtent, 1.0);
+    gl_Position = viewProjection * world;
+    WorldPosition = world.xyz;
+    TexCoord = aTexCoord;
+    Layer = 0;
+    Normal = mat3(skin) * aNormal;
+}
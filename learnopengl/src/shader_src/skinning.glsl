@@ -0,0 +1,15 @@
+// Joint palettes of every skinned instance of the frame, one block in the ring buffer
+// (see skinning.cpp)
+layout (std430, binding = 0) readonly buffer JointPalettes
+{
+    mat4 palette[];
+};
+
+// the instance's joints start here
+uniform uint firstJoint;
+
+mat4 skinMatrix(uvec4 joints, vec4 weights)
+{
+    return weights.x * palette[firstJoint + joints.x] + weights.y * palette[firstJoint + joints.y] +
+           weights.z * palette[firstJoint + joints.z] + weights.w * palette[firstJoint + joints.w];
+}
@@ -0,0 +1,19 @@
+#version 330 core
+// the environment along the view ray of every pixel the scene left at the cleared depth
+out vec4 FragColor;
+
+in vec2 ndc;
+
+#include "environment.glsl"
+
+uniform mat4 inverseViewProjection;
+// glClipControl(GL_ZERO_TO_ONE) is on with reversed-Z, the near plane is at 1
+uniform bool depthZeroToOne;
+
+void main()
+{
+    vec4 near = inverseViewProjection * vec4(ndc, depthZeroToOne ? 1.0 : -1.0, 1.0);
+    // a point further along, the far plane may be at infinity
+    vec4 further = inverseViewProjection * vec4(ndc, depthZeroToOne ? 0.5 : 0.0, 1.0);
+    FragColor = vec4(skyRadiance(normalize(further.xyz / further.w - near.xyz / near.w)), 1.0);
+}
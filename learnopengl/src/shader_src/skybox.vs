@@ -0,0 +1,13 @@
+#version 330 core
+// one triangle over the whole target at the far plane, the sky behind everything drawn so far
+out vec2 ndc;
+
+// NDC z of the far plane: 1, or 0 with reversed-Z
+uniform float farDepth;
+
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    ndc = corner * 2.0 - 1.0;
+    gl_Position = vec4(ndc, farDepth, 1.0);
+}
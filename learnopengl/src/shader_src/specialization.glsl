@@ -0,0 +1,8 @@
+// SPECIALIZATION(id, type, name) declares a value that is fixed once the program is built.
+// In a SPIR-V module (see shader_cooker.cpp) it is a specialization constant that
+// glSpecializeShader folds into the code, compiled from GLSL it stays a uniform of that name.
+#ifdef GL_SPIRV
+#define SPECIALIZATION(id, type, name) layout (constant_id = id) const type name = type(0);
+#else
+#define SPECIALIZATION(id, type, name) uniform type name;
+#endif
@@ -0,0 +1,13 @@
+#version 330 core
+in vec2 TexCoord;
+in vec4 Color;
+
+out vec4 FragColor;
+
+// the run's texture or atlas page
+uniform sampler2D sprites;
+
+void main()
+{
+    FragColor = Color * texture(sprites, TexCoord);
+}
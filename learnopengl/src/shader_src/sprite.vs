@@ -0,0 +1,25 @@
+#version 330 core
+// one instance per sprite, window pixels with the origin top left (see sprite_batch.cpp)
+layout (location = 0) in vec4 aRect;
+layout (location = 1) in vec4 aUvRect;
+layout (location = 2) in vec4 aColor;
+layout (location = 3) in float aRotation;
+
+uniform vec2 screenSize;
+
+out vec2 TexCoord;
+out vec4 Color;
+
+void main()
+{
+    // the strip's corners 0 0, 1 0, 0 1, 1 1
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 halfSize = 0.5 * aRect.zw;
+    vec2 local = (corner - 0.5) * aRect.zw;
+    float c = cos(aRotation), s = sin(aRotation);
+    vec2 position = aRect.xy + halfSize + vec2(c * local.x - s * local.y, s * local.x + c * local.y);
+    vec2 ndc = position / screenSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    TexCoord = aUvRect.xy + corner * aUvRect.zw;
+    Color = aColor;
+}
@@ -0,0 +1,80 @@
+#version 330 core
+// the ambient occlusion of the half resolution depth (see ambient_occlusion.cpp), in the manner
+// of scalable ambient obscurance: SAMPLES taps on a spiral over a disc of params.x view space
+// units around the pixel, turned per pixel and frame, each occluding by how far it is in front
+// of the surface's plane. The taps further out read coarser levels of the depth (input0).
+// params.y is the intensity, z 1 with reversed Z, w the frame the noise is for.
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D input0;
+uniform vec4 params;
+uniform vec2 texelSize;
+uniform mat4 projection;
+uniform mat4 inverseProjection;
+
+const int SAMPLES = 12;
+// turns of the spiral over the samples, prime to SAMPLES so no two line up
+const float TURNS = 7.0;
+// AmbientOcclusion::DEPTH_LEVELS - 1
+const int MAX_LEVEL = 3;
+// in view space units, against self occlusion of flat surfaces
+const float BIAS = 0.01;
+
+bool isSky(float depth)
+{
+    return params.z > 0.5 ? depth <= 0.0 : depth >= 1.0;
+}
+
+vec3 viewPosition(vec2 uv, float depth)
+{
+    // reversed Z comes with the 0..1 clip range, the depth is the NDC z
+    float z = params.z > 0.5 ? depth : depth * 2.0 - 1.0;
+    vec4 position = inverseProjection * vec4(uv * 2.0 - 1.0, z, 1.0);
+    return position.xyz / position.w;
+}
+
+float depthAt(vec2 uv, int level)
+{
+    ivec2 size = textureSize(input0, level);
+    return texelFetch(input0, clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1), level).r;
+}
+
+void main()
+{
+    float depth = depthAt(UV, 0);
+    if (isSky(depth))
+    {
+        FragColor = vec4(1.0);
+        return;
+    }
+    vec3 position = viewPosition(UV, depth);
+    vec3 normal = normalize(cross(dFdx(position), dFdy(position)));
+    // the disc projected at the pixel's distance, in UV units
+    vec2 radius = params.x * 0.5 * vec2(projection[0][0], projection[1][1]) / -position.z;
+    float radius2 = params.x * params.x;
+
+    // interleaved gradient noise, another every frame for the temporal pass to average
+    vec2 pixel = gl_FragCoord.xy + params.w * 5.588238;
+    float angle = 6.2831853 * fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+    float occlusion = 0.0;
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        float alpha = (float(i) + 0.5) / float(SAMPLES);
+        float theta = alpha * TURNS * 6.2831853 + angle;
+        vec2 offset = alpha * radius * vec2(cos(theta), sin(theta));
+        // a level texel per 8 texels of distance keeps the taps near the cache
+        int level = clamp(int(log2(max(length(offset / texelSize), 1.0))) - 3, 0, MAX_LEVEL);
+        float sampleDepth = depthAt(UV + offset, level);
+        if (isSky(sampleDepth))
+            continue;
+        vec3 v = viewPosition(UV + offset, sampleDepth) - position;
+        float vv = dot(v, v);
+        float falloff = max(radius2 - vv, 0.0);
+        occlusion += falloff * falloff * falloff * max((dot(v, normal) - BIAS) / (vv + BIAS), 0.0);
+    }
+    // the falloff peaks at radius^6
+    occlusion *= params.y * 5.0 / (radius2 * radius2 * radius2 * float(SAMPLES));
+    FragColor = vec4(max(1.0 - occlusion, 0.0));
+}
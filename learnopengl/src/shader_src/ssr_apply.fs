@@ -0,0 +1,45 @@
+#version 330 core
+// the screen space reflections onto the frame (see screen_space_reflections.cpp): the HDR frame
+// (input0) plus the filtered reflection (input1, premultiplied by its confidence) upsampled and
+// weighted by the Fresnel term of environment.glsl's surfaces at the normal the full resolution
+// depth (input2) gives. With ENVIRONMENT_LIGHTING the lighting already put the probe's reflection
+// on every surface, a hit takes its place by its confidence and the misses keep the probe.
+// params.x is the intensity, z 1 with reversed Z.
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D input0;
+uniform sampler2D input1;
+uniform sampler2D input2;
+uniform vec4 params;
+// view to world, for the probe's directions
+uniform mat4 inverseView;
+
+#include "reflections.glsl"
+#include "environment.glsl"
+
+void main()
+{
+    vec4 color = texture(input0, UV);
+    float depth = depthAt(input2, UV, 0);
+    if (isSky(depth))
+    {
+        FragColor = color;
+        return;
+    }
+    vec3 position = viewPosition(UV, depth);
+    vec3 normal = viewNormal(input2, UV, position, 0);
+    vec3 toEye = normalize(-position);
+    vec2 brdf = environmentBRDF(ENVIRONMENT_ROUGHNESS, max(dot(normal, toEye), 1e-4));
+    float fresnel = (ENVIRONMENT_F0 * brdf.x + brdf.y) * params.x;
+    vec4 reflection = texture(input1, UV);
+#ifdef ENVIRONMENT_LIGHTING
+    vec3 direction = mat3(inverseView) * reflect(-toEye, normal);
+    vec3 probe = textureLod(specularMap, direction, ENVIRONMENT_ROUGHNESS * (SPECULAR_LEVELS - 1.0)).rgb;
+    color.rgb += fresnel * (reflection.rgb - probe * reflection.a);
+#else
+    color.rgb += fresnel * reflection.rgb;
+#endif
+    FragColor = vec4(max(color.rgb, vec3(0.0)), color.a);
+}
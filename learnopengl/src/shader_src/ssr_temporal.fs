@@ -0,0 +1,48 @@
+#version 330 core
+// the screen space reflections' temporal pass (see screen_space_reflections.cpp): this frame's
+// premultiplied reflection (input0) blended into the last one's (input1), reprojected by the
+// depth of the surface (input2, the nearest depth pyramid) and clamped to the 3x3 around the
+// pixel first so what a moving ray ran off doesn't ghost. params.x is the weight of this frame,
+// y 1 while there is a history, z 1 with reversed Z, w the level of input2 at this resolution.
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D input0;
+uniform sampler2D input1;
+uniform sampler2D input2;
+uniform vec4 params;
+uniform vec2 texelSize;
+// this frame's clip space to the last frame's
+uniform mat4 reprojection;
+
+void main()
+{
+    vec4 current = texture(input0, UV);
+    vec4 lowest = current, highest = current;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            vec4 neighbour = texture(input0, UV + vec2(x, y) * texelSize);
+            lowest = min(lowest, neighbour);
+            highest = max(highest, neighbour);
+        }
+    }
+
+    int level = int(params.w);
+    ivec2 size = textureSize(input2, level);
+    float depth = texelFetch(input2, clamp(ivec2(UV * vec2(size)), ivec2(0), size - 1), level).r;
+    float z = params.z > 0.5 ? depth : depth * 2.0 - 1.0;
+    vec4 previous = reprojection * vec4(UV * 2.0 - 1.0, z, 1.0);
+    vec2 previousUV = previous.xy / previous.w * 0.5 + 0.5;
+    // no history, or none for what was off screen or is the sky at an infinite far plane
+    if (params.y < 0.5 || previous.w <= 0.0 || any(lessThan(previousUV, vec2(0.0))) ||
+        any(greaterThan(previousUV, vec2(1.0))))
+    {
+        FragColor = current;
+        return;
+    }
+    vec4 history = clamp(texture(input1, previousUV), lowest, highest);
+    FragColor = mix(history, current, params.x);
+}
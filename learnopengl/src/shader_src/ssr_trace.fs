@@ -0,0 +1,130 @@
+#version 330 core
+// the screen space reflection of every pixel of the trace's resolution (see
+// screen_space_reflections.cpp): a ray from the pixel's surface, reflected about the normal its
+// depth gives, walks the nearest depth pyramid (input0) in texture space, where the depth changes
+// linearly along it. While the ray is in front of everything in a cell it skips the cell and
+// goes a level coarser, when it reaches the cell's nearest depth inside the cell it moves there and
+// goes a level finer, past the finest level it hit. The hit takes the lit frame's color (input1),
+// premultiplied by a confidence that fades at the screen's edges, at the end of the ray's reach and
+// for rays towards the camera; a ray that came out more than params.y behind the surface missed.
+// params.x is the most steps, z 1 with reversed Z, w the frame the jitter is for.
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D input0;
+uniform sampler2D input1;
+uniform vec4 params;
+uniform vec2 texelSize;
+uniform mat4 projection;
+// the level of input0 at the trace's resolution, the finest the rays descend to
+uniform int baseLevel;
+// how far a ray reaches, in view space units
+uniform float maxDistance;
+
+#include "reflections.glsl"
+
+// levels above baseLevel a ray climbs at most, the cells of coarser ones span too much of the screen
+const int MAX_CLIMB = 6;
+
+// the depth in the order of the pyramid's nearest, 0 at the near plane and 1 at the far one
+float ordered(float depth)
+{
+    return params.z > 0.5 ? 1.0 - depth : depth;
+}
+
+// texture coordinates and ordered depth of a view space position
+vec3 screenPosition(vec3 position)
+{
+    vec4 clip = projection * vec4(position, 1.0);
+    vec3 ndc = clip.xyz / clip.w;
+    return vec3(ndc.xy * 0.5 + 0.5, ordered(params.z > 0.5 ? ndc.z : ndc.z * 0.5 + 0.5));
+}
+
+void main()
+{
+    float depth = depthAt(input0, UV, baseLevel);
+    if (isSky(depth))
+    {
+        FragColor = vec4(0.0);
+        return;
+    }
+    vec3 position = viewPosition(UV, depth);
+    vec3 normal = viewNormal(input0, UV, position, baseLevel);
+    vec3 direction = reflect(normalize(position), normal);
+    // a ray towards the camera ends in front of it
+    float reach = maxDistance;
+    if (direction.z > 0.0)
+        reach = min(reach, -position.z * 0.9 / direction.z);
+    vec3 origin = screenPosition(position);
+    vec3 ray = screenPosition(position + direction * reach) - origin;
+
+    // the walk starts a texel or two out, off its own texel and turned by interleaved gradient
+    // noise every frame for the temporal pass to average
+    vec2 pixel = gl_FragCoord.xy + params.w * 5.588238;
+    float noise = fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+    ivec2 baseSize = textureSize(input0, baseLevel);
+    float t = (1.0 + noise) / max(length(ray.xy * vec2(baseSize)), 1.0);
+
+    ivec2 size = textureSize(input0, 0);
+    int maxLevel = min(int(log2(float(max(size.x, size.y)))), baseLevel + MAX_CLIMB);
+    vec2 ahead = step(0.0, ray.xy);
+    vec2 safeRay = vec2(abs(ray.x) < 1e-7 ? 1e-7 : ray.x, abs(ray.y) < 1e-7 ? 1e-7 : ray.y);
+    int level = baseLevel;
+    for (int i = 0; i < int(params.x) && level >= baseLevel; i++)
+    {
+        vec3 p = origin + ray * t;
+        if (t > 1.0 || any(lessThan(p.xy, vec2(0.0))) || any(greaterThan(p.xy, vec2(1.0))))
+            break;
+        ivec2 cellCount = textureSize(input0, level);
+        vec2 cell = clamp(floor(p.xy * vec2(cellCount)), vec2(0.0), vec2(cellCount - 1));
+        // where the ray leaves the cell, a hundredth of a cell into the next one
+        vec2 boundary = (cell + ahead + (ahead * 2.0 - 1.0) * 0.01) / vec2(cellCount);
+        vec2 leave = (boundary - origin.xy) / safeRay;
+        float cellEnd = min(leave.x, leave.y);
+        float nearest = ordered(texelFetch(input0, ivec2(cell), level).r);
+        // in front of the cell's nearest depth until the ray gets to it, at or behind it already
+        float reaches = t;
+        if (p.z < nearest)
+            reaches = ray.z > 0.0 ? (nearest - origin.z) / ray.z : 1e30;
+        if (reaches > cellEnd)
+        {
+            t = cellEnd;
+            level = min(level + 1, maxLevel);
+        }
+        else
+        {
+            t = max(reaches, t);
+            level--;
+        }
+    }
+    if (level >= baseLevel)
+    {
+        FragColor = vec4(0.0);
+        return;
+    }
+
+    vec3 hit = origin + ray * t;
+    float hitDepth = depthAt(input0, hit.xy, baseLevel);
+    if (isSky(hitDepth))
+    {
+        FragColor = vec4(0.0);
+        return;
+    }
+    // the ray's own view depth at the hit against the surface's there
+    float rayDepth = params.z > 0.5 ? 1.0 - hit.z : hit.z;
+    float behind = viewPosition(hit.xy, hitDepth).z - viewPosition(hit.xy, rayDepth).z;
+    if (behind > params.y)
+    {
+        FragColor = vec4(0.0);
+        return;
+    }
+    vec2 edge = min(hit.xy, 1.0 - hit.xy);
+    float confidence = clamp(min(edge.x, edge.y) * 10.0, 0.0, 1.0);
+    confidence *= 1.0 - smoothstep(0.7, 1.0, t);
+    // towards the camera the hit is likely the back of what is seen
+    confidence *= 1.0 - smoothstep(0.4, 0.9, direction.z);
+    // the odd very bright texel would flicker through the history
+    vec3 color = min(textureLod(input1, hit.xy, 0.0).rgb, vec3(64.0));
+    FragColor = vec4(color * confidence, confidence);
+}
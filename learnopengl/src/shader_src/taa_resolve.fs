@@ -0,0 +1,120 @@
+#version 330 core
+// the temporal anti-aliasing resolve (see temporal_aa.cpp), at the output's size: this frame's
+// jittered sample nearest to the pixel blended into the history reprojected along the dilated
+// velocity, the history clipped to the color distribution of the 3x3 samples around it first
+// so what the surfaces disoccluded or changed doesn't ghost. Works in a reversible tone mapped
+// YCoCg, so fireflies don't dominate the blend.
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D current;
+uniform sampler2D history;
+uniform sampler2D velocities;
+uniform sampler2D depths;
+// this frame's unjittered clip space to the last frame's
+uniform mat4 reprojection;
+// the projection's offset in the current frame's pixels
+uniform vec2 jitter;
+// x the weight of the current frame at its sample, y 1 while there is a history,
+// z 1 with reversed Z, then the depth is the NDC z and larger is nearer
+uniform vec4 params;
+
+#include "catmull_rom.glsl"
+
+// velocities of what drawVelocities() didn't draw
+const float NO_VELOCITY = 1.5;
+// of the standard deviations the history is allowed away from the mean
+const float CLIP_SIGMAS = 1.25;
+
+vec3 tonemap(vec3 color)
+{
+    return color / (1.0 + max(color.r, max(color.g, color.b)));
+}
+
+vec3 untonemap(vec3 color)
+{
+    return color / max(1.0 - max(color.r, max(color.g, color.b)), 1e-4);
+}
+
+vec3 toYCoCg(vec3 color)
+{
+    return vec3(0.25 * color.r + 0.5 * color.g + 0.25 * color.b, 0.5 * color.r - 0.5 * color.b,
+                -0.25 * color.r + 0.5 * color.g - 0.25 * color.b);
+}
+
+vec3 fromYCoCg(vec3 color)
+{
+    return vec3(color.x + color.y - color.z, color.x + color.z, color.x - color.y - color.z);
+}
+
+// history pulled onto the segment towards the center of the box until it is inside
+vec3 clipToBox(vec3 color, vec3 lowest, vec3 highest)
+{
+    vec3 center = 0.5 * (lowest + highest);
+    vec3 extent = 0.5 * (highest - lowest) + 1e-5;
+    vec3 away = color - center;
+    vec3 units = abs(away / extent);
+    float furthest = max(units.x, max(units.y, units.z));
+    return furthest > 1.0 ? center + away / furthest : color;
+}
+
+void main()
+{
+    ivec2 renderSize = textureSize(current, 0);
+    ivec2 last = renderSize - 1;
+    vec2 outputSize = vec2(textureSize(history, 0));
+    bool reversed = params.z > 0.5;
+
+    // the pixel in the current frame's pixels without the jitter, the sample of texel i is at i + 0.5 - jitter
+    vec2 position = UV * vec2(renderSize);
+    ivec2 texel = clamp(ivec2(floor(position + jitter)), ivec2(0), last);
+    vec2 offset = (position - (vec2(texel) + 0.5 - jitter)) * outputSize / vec2(renderSize);
+
+    // the moments of the 3x3 samples around it, and the nearest of their surfaces
+    vec3 sum = vec3(0.0), squares = vec3(0.0);
+    float nearest = reversed ? 0.0 : 1.0;
+    ivec2 nearestTexel = texel;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            ivec2 sampleTexel = clamp(texel + ivec2(x, y), ivec2(0), last);
+            vec3 color = toYCoCg(tonemap(texelFetch(current, sampleTexel, 0).rgb));
+            sum += color;
+            squares += color * color;
+            float depth = texelFetch(depths, sampleTexel, 0).r;
+            if (reversed ? depth > nearest : depth < nearest)
+            {
+                nearest = depth;
+                nearestTexel = sampleTexel;
+            }
+        }
+    }
+    vec3 currentColor = toYCoCg(tonemap(texelFetch(current, texel, 0).rgb));
+
+    // edges move with the surface in front, what didn't move on its own moves with the camera
+    vec2 velocity = texelFetch(velocities, nearestTexel, 0).xy;
+    if (velocity.x > NO_VELOCITY)
+    {
+        vec3 ndc = vec3(UV * 2.0 - 1.0, reversed ? nearest : nearest * 2.0 - 1.0);
+        vec4 previous = reprojection * vec4(ndc, 1.0);
+        velocity = (ndc.xy - previous.xy / previous.w) * 0.5;
+    }
+    vec2 previousUV = UV - velocity;
+    if (params.y < 0.5 || any(lessThan(previousUV, vec2(0.0))) || any(greaterThan(previousUV, vec2(1.0))))
+    {
+        FragColor = vec4(texture(current, UV + jitter / vec2(renderSize)).rgb, 1.0);
+        return;
+    }
+
+    vec3 historyColor = toYCoCg(tonemap(max(catmullRom(history, previousUV, 1.0 / outputSize), 0.0)));
+    vec3 mean = sum / 9.0;
+    vec3 sigma = sqrt(abs(squares / 9.0 - mean * mean));
+    historyColor = clipToBox(historyColor, mean - sigma * CLIP_SIGMAS, mean + sigma * CLIP_SIGMAS);
+
+    // upscaling, the sample counts less the further it is from the pixel
+    float weight = clamp(params.x * exp(-2.29 * dot(offset, offset)), 0.02, 1.0);
+    vec3 color = mix(historyColor, currentColor, weight);
+    FragColor = vec4(untonemap(fromYCoCg(color)), 1.0);
+}
@@ -0,0 +1,32 @@
+#version 330 core
+#include "interface.glsl"
+out vec4 FragColor;
+
+INTERFACE(0) in vec2 TexCoord;
+INTERFACE(2) in vec3 Normal;
+INTERFACE(3) in vec3 WorldPosition;
+
+// xy corner, z size and w height scale of the whole terrain (see terrain.cpp)
+uniform vec4 terrain;
+uniform float baseHeight;
+// towards the sun
+uniform vec3 sunDirection;
+
+#ifdef VIRTUAL_TEXTURE
+#include "virtual_texture.glsl"
+#endif
+
+void main()
+{
+    vec3 normal = normalize(Normal);
+#ifdef VIRTUAL_TEXTURE
+    vec3 color = sampleVirtual(TexCoord).rgb;
+#else
+    float height = (WorldPosition.y - baseHeight) / terrain.w;
+    // grass on the flats, rock on the slopes, snow on the tops
+    vec3 color = mix(vec3(0.22, 0.42, 0.16), vec3(0.42, 0.38, 0.34), smoothstep(0.15, 0.35, 1.0 - normal.y));
+    color = mix(color, vec3(0.9, 0.92, 0.95), smoothstep(0.75, 0.9, height) * normal.y);
+#endif
+    float light = 0.3 + 0.7 * max(dot(normal, sunDirection), 0.0);
+    FragColor = vec4(color * light, 1.0);
+}
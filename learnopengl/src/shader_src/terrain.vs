@@ -0,0 +1,50 @@
+#version 330 core
+#include "interface.glsl"
+// One CDLOD node per instance over the shared grid (see cdlod_grid.cpp and terrain.cpp)
+layout (location = 0) in vec2 aGrid;
+// xy corner, z size, w level
+layout (location = 2) in vec4 aNode;
+
+INTERFACE(0) out vec2 TexCoord;
+INTERFACE(1) flat out int Layer;
+INTERFACE(2) out vec3 Normal;
+INTERFACE(3) out vec3 WorldPosition;
+
+#include "frame_data.glsl"
+
+uniform sampler2D heightMap;
+// xy corner, z size and w height scale of the whole terrain
+uniform vec4 terrain;
+uniform float baseHeight;
+// quads per side of the grid
+uniform float gridSize;
+// per level the distance the morph starts at and 1 / its length
+uniform vec2 morphRanges[8];
+
+float heightAt(vec2 position)
+{
+    return baseHeight + textureLod(heightMap, (position - terrain.xy) / terrain.z, 0.0).r * terrain.w;
+}
+
+void main()
+{
+    vec2 position = aNode.xy + aGrid * aNode.z;
+    vec2 morph = morphRanges[int(aNode.w)];
+    float distance = length(cameraPosition.xyz - vec3(position.x, heightAt(position), position.y));
+    float k = clamp((distance - morph.x) * morph.y, 0.0, 1.0);
+    // the odd vertices slide onto the even ones, the grid of the next coarser level
+    vec2 odd = fract(aGrid * gridSize * 0.5) * 2.0 / gridSize;
+    position = aNode.xy + (aGrid - odd * k) * aNode.z;
+
+    float height = heightAt(position);
+    // central differences a texel apart
+    vec2 texel = terrain.z / vec2(textureSize(heightMap, 0));
+    float left = heightAt(position - vec2(texel.x, 0.0)), right = heightAt(position + vec2(texel.x, 0.0));
+    float back = heightAt(position - vec2(0.0, texel.y)), front = heightAt(position + vec2(0.0, texel.y));
+    Normal = normalize(vec3((left - right) / texel.x, 2.0, (back - front) / texel.y));
+
+    WorldPosition = vec3(position.x, height, position.y);
+    gl_Position = viewProjection * vec4(WorldPosition, 1.0);
+    TexCoord = (position - terrain.xy) / terrain.z;
+    Layer = 0;
+}
@@ -0,0 +1,12 @@
+#version 330 core
+// the bilinear upscale of the scaled frame to the window (see dynamic_resolution.cpp)
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D input0;
+
+void main()
+{
+    FragColor = vec4(texture(input0, UV).rgb, 1.0);
+}
@@ -0,0 +1,27 @@
+#version 330 core
+// the edge adaptive upscale of the scaled frame (see dynamic_resolution.cpp), after FSR 1's EASU:
+// a Catmull-Rom filter of the 4x4 texels around the sample, sharper than the bilinear one along
+// edges, clamped to the nearest 2x2 texels so the negative lobes don't ring
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D input0;
+// of input0
+uniform vec2 texelSize;
+
+#include "catmull_rom.glsl"
+
+void main()
+{
+    vec3 color = catmullRom(input0, UV, texelSize);
+
+    ivec2 texel = ivec2(floor(UV / texelSize - 0.5));
+    ivec2 last = textureSize(input0, 0) - 1;
+    vec3 a = texelFetch(input0, clamp(texel, ivec2(0), last), 0).rgb;
+    vec3 b = texelFetch(input0, clamp(texel + ivec2(1, 0), ivec2(0), last), 0).rgb;
+    vec3 c = texelFetch(input0, clamp(texel + ivec2(0, 1), ivec2(0), last), 0).rgb;
+    vec3 d = texelFetch(input0, clamp(texel + ivec2(1, 1), ivec2(0), last), 0).rgb;
+    color = clamp(color, min(min(a, b), min(c, d)), max(max(a, b), max(c, d)));
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,35 @@
+#version 330 core
+// the sharpening after the upscale (see dynamic_resolution.cpp), FSR 1's RCAS: the center
+// texel minus its 4 neighbours by a lobe as large as it can be without any channel leaving
+// the range of the neighbourhood, times params.x (1 is the sharpest)
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D input0;
+uniform vec4 params;
+
+// larger lobes would sharpen noise and 1 pixel features into halos
+const float LOBE_LIMIT = 0.25 - 1.0 / 16.0;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 last = textureSize(input0, 0) - 1;
+    vec3 b = texelFetch(input0, clamp(texel + ivec2(0, -1), ivec2(0), last), 0).rgb;
+    vec3 d = texelFetch(input0, clamp(texel + ivec2(-1, 0), ivec2(0), last), 0).rgb;
+    vec3 e = texelFetch(input0, clamp(texel, ivec2(0), last), 0).rgb;
+    vec3 f = texelFetch(input0, clamp(texel + ivec2(1, 0), ivec2(0), last), 0).rgb;
+    vec3 h = texelFetch(input0, clamp(texel + ivec2(0, 1), ivec2(0), last), 0).rgb;
+
+    vec3 lowest = min(min(min(b, d), min(f, h)), e);
+    vec3 highest = max(max(max(b, d), max(f, h)), e);
+    // the lobes that would take a channel to 0 and to 1
+    vec3 hitMin = lowest / (4.0 * highest + 1e-5);
+    vec3 hitMax = (1.0 - highest) / (4.0 * lowest - 4.0 - 1e-5);
+    vec3 lobes = max(-hitMin, hitMax);
+    float lobe = max(-LOBE_LIMIT, min(max(lobes.r, max(lobes.g, lobes.b)), 0.0)) * params.x;
+
+    vec3 color = (lobe * (b + d + f + h) + e) / (4.0 * lobe + 1.0);
+    FragColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
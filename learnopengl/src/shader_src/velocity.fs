@@ -0,0 +1,12 @@
+#version 430 core
+#include "interface.glsl"
+// the motion of the surface since the last frame in texture coordinates, current - previous
+out vec2 Velocity;
+
+INTERFACE(0) in vec4 CurrentClip;
+INTERFACE(1) in vec4 PreviousClip;
+
+void main()
+{
+    Velocity = (CurrentClip.xy / CurrentClip.w - PreviousClip.xy / PreviousClip.w) * 0.5;
+}
@@ -0,0 +1,39 @@
+#version 430 core
+#include "interface.glsl"
+layout (location = 0) in vec3 aPos;
+
+// lands on the depth the shading pass left, see TemporalAA::drawVelocities()
+invariant gl_Position;
+
+INTERFACE(0) out vec4 CurrentClip;
+INTERFACE(1) out vec4 PreviousClip;
+
+#include "frame_data.glsl"
+
+// the instances that moved since the last frame (see temporal_aa.cpp)
+struct InstanceMotion
+{
+    mat4 model;
+    mat4 previousModel;
+};
+layout (std430, binding = 7) readonly buffer Motions
+{
+    InstanceMotion motions[];
+};
+
+// decodes the quantized positions of the mesh (see mesh.cpp)
+uniform vec3 boundsCenter;
+uniform vec3 boundsExtent;
+// without the jitter
+uniform mat4 currentViewProjection;
+uniform mat4 previousViewProjection;
+
+void main()
+{
+    InstanceMotion motion = motions[gl_InstanceID];
+    vec4 position = vec4(boundsCenter + aPos * boundsExtent, 1.0);
+    vec4 world = motion.model * position;
+    gl_Position = viewProjection * world;
+    CurrentClip = currentViewProjection * world;
+    PreviousClip = previousViewProjection * (motion.previousModel * position);
+}
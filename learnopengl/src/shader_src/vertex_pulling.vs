@@ -0,0 +1,59 @@
+#version 450 core
+#include "interface.glsl"
+// No vertex attributes: the corner is fetched by gl_VertexID from the mesh's index and vertex
+// buffers and the instance by gl_InstanceID, all bound as storage (see vertex_puller.cpp)
+
+// the depth prepass and the shading pass have to agree on the depth exactly
+invariant gl_Position;
+
+INTERFACE(0) out vec2 TexCoord;
+INTERFACE(1) flat out int Layer;
+// world space, for the G-buffer and the lighting
+INTERFACE(2) out vec3 Normal;
+INTERFACE(3) out vec3 WorldPosition;
+
+#include "frame_data.glsl"
+
+// cookedMeshLayout() vertices, 16 bytes each: snorm16 x 3 position padded to 8 bytes,
+// half float x 2 texcoord and the signed 2_10_10_10 normal
+layout (std430, binding = 8) readonly buffer PulledVertices
+{
+    uint vertexWords[];
+};
+// 16 or 32 bit indices, two 16 bit ones per word
+layout (std430, binding = 9) readonly buffer PulledIndices
+{
+    uint indexWords[];
+};
+layout (std430, binding = 10) readonly buffer PulledModels
+{
+    mat4 instanceModels[];
+};
+layout (std430, binding = 11) readonly buffer PulledLayers
+{
+    int instanceLayers[];
+};
+
+uniform bool shortIndices;
+// decodes the quantized positions of the mesh (see mesh.cpp)
+uniform vec3 boundsCenter;
+uniform vec3 boundsExtent;
+
+void main()
+{
+    uint corner = uint(gl_VertexID);
+    uint index = shortIndices ? (indexWords[corner >> 1] >> ((corner & 1u) * 16u)) & 0xFFFFu : indexWords[corner];
+    uint first = index * 4u;
+    vec3 position = vec3(unpackSnorm2x16(vertexWords[first]), unpackSnorm2x16(vertexWords[first + 1u]).x);
+
+    int packedNormal = int(vertexWords[first + 3u]);
+    vec3 normal = vec3(ivec3(packedNormal << 22, packedNormal << 12, packedNormal << 2) >> 22) / 511.0;
+
+    mat4 model = instanceModels[gl_InstanceID];
+    vec4 world = model * vec4(boundsCenter + position * boundsExtent, 1.0);
+    gl_Position = viewProjection * world;
+    WorldPosition = world.xyz;
+    TexCoord = unpackHalf2x16(vertexWords[first + 2u]);
+    Layer = instanceLayers[gl_InstanceID];
+    Normal = mat3(model) * max(normal, -1.0);
+}
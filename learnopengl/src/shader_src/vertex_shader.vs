@@ -1,15 +1,149 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;   // the position variable has attribute position 0
-layout (location = 1) in vec2 aTexCoord; // the texture 'uv's or as learnopengl calls them - 'st's
+#if defined(STEREO) && defined(OVR_MULTIVIEW)
+#extension GL_OVR_multiview2 : require
+#elif defined(MULTI_VIEW) || defined(STEREO)
+// gl_ViewportIndex and gl_Layer from the vertex stage
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
+#include "interface.glsl"
+// aPos, aTexCoord and aNormal of CookedVertex, declared by its VERTEX_INPUTS define
+// (see static_vertex_layout.cpp)
+VERTEX_INPUTS
+#ifdef INSTANCED
+// per-instance model matrix, takes locations 2 to 5 (see instance_buffer.cpp)
+layout (location = 2) in mat4 aModel;
+// per-instance texture array layer
+layout (location = 6) in int aLayer;
+#elif defined(ANIMATED)
+// position and radians per second, rotation axis and layer of the instance, never updated
+// (see animated_instances.cpp)
+layout (location = 2) in vec4 aPositionSpeed;
+layout (location = 3) in vec3 aAxis;
+layout (location = 6) in int aLayer;
+#elif defined(COMPACT)
+// which CompactTransform of compactTransforms is the instance's (see compact_instances.cpp)
+layout (location = 6) in uint aInstance;
+#endif
 
-out vec2 TexCoord;
+// the depth prepass and the shading pass have to agree on the depth exactly
+invariant gl_Position;
 
+INTERFACE(0) out vec2 TexCoord;
+INTERFACE(1) flat out int Layer;
+// world space, for the G-buffer and the lighting
+INTERFACE(2) out vec3 Normal;
+INTERFACE(3) out vec3 WorldPosition;
+#ifdef LIGHTMAP
+// aLightmapCoord of LightmappedVertex (see lightmap_baker.cpp)
+INTERFACE(5) out vec2 LightmapCoord;
+#endif
+
+#include "frame_data.glsl"
+
+// decodes the quantized positions of the mesh (see mesh.cpp)
+uniform vec3 boundsCenter;
+uniform vec3 boundsExtent;
+
+#if defined(MULTI_VIEW) || defined(STEREO)
+// the views of one draw, each instance of an object goes to the next one (see multi_view.cpp),
+// or the eyes (see stereo.cpp)
+layout (std140) uniform Views
+{
+    mat4 viewProjections[4];
+    int viewCount;
+};
+#endif
+#if defined(STEREO) && defined(OVR_MULTIVIEW)
+layout (num_views = 2) in;
+#endif
+
+#if !defined(INSTANCED) && !defined(ANIMATED) && !defined(COMPACT)
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// texture array layer of this draw
+uniform int layer;
+#endif
+
+#ifdef ANIMATED
+// glm::rotate(glm::translate(I, position), angle, axis), what TransformSystem::update() builds
+mat4 spin(vec3 position, vec3 axis, float angle)
+{
+    float c = cos(angle), s = sin(angle);
+    mat3 cross = mat3(0.0, axis.z, -axis.y, -axis.z, 0.0, axis.x, axis.y, -axis.x, 0.0);
+    mat3 rotation = c * mat3(1.0) + (1.0 - c) * outerProduct(axis, axis) + s * cross;
+    return mat4(vec4(rotation[0], 0.0), vec4(rotation[1], 0.0), vec4(rotation[2], 0.0), vec4(position, 1.0));
+}
+#endif
+
+#ifdef COMPACT
+// 3 RG32UI texels per record: x y, z and the rotation's x y, its z w and the scale and layer
+uniform usamplerBuffer compactTransforms;
+
+// the low half of bits, GLSL 3.30 has no unpackHalf2x16; the encoder writes no infinities
+float halfToFloat(uint bits)
+{
+    uint exponent = (bits >> 10) & 0x1Fu;
+    uint mantissa = bits & 0x3FFu;
+    float magnitude = exponent == 0u ? float(mantissa) * exp2(-24.0)
+                                     : uintBitsToFloat(((exponent + 112u) << 23) | (mantissa << 13));
+    return (bits & 0x8000u) != 0u ? -magnitude : magnitude;
+}
+
+// the model matrix of record index, the quaternion needn't be of exactly unit length
+mat4 compactModel(int index, out int layer)
+{
+    uvec2 first = texelFetch(compactTransforms, index * 3).xy;
+    uvec2 second = texelFetch(compactTransforms, index * 3 + 1).xy;
+    uvec2 third = texelFetch(compactTransforms, index * 3 + 2).xy;
+    vec3 position = vec3(uintBitsToFloat(first.x), uintBitsToFloat(first.y), uintBitsToFloat(second.x));
+    vec4 q = vec4(halfToFloat(second.y), halfToFloat(second.y >> 16), halfToFloat(third.x), halfToFloat(third.x >> 16));
+    float scale = halfToFloat(third.y);
+    layer = int(third.y >> 16);
+
+    float s = 2.0 / dot(q, q);
+    vec3 qs = q.xyz * s;
+    float xx = q.x * qs.x, yy = q.y * qs.y, zz = q.z * qs.z;
+    float xy = q.x * qs.y, xz = q.x * qs.z, yz = q.y * qs.z;
+    float wx = q.w * qs.x, wy = q.w * qs.y, wz = q.w * qs.z;
+    mat3 rotation = mat3(1.0 - yy - zz, xy + wz, xz - wy,
+                         xy - wz, 1.0 - xx - zz, yz + wx,
+                         xz + wy, yz - wx, 1.0 - xx - yy);
+    return mat4(vec4(rotation[0] * scale, 0.0), vec4(rotation[1] * scale, 0.0), vec4(rotation[2] * scale, 0.0),
+                vec4(position, 1.0));
+}
+#endif
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+#ifdef INSTANCED
+    mat4 model = aModel;
+    int layer = aLayer;
+#elif defined(ANIMATED)
+    // wrapped to a turn first, the product grows without bound
+    mat4 model = spin(aPositionSpeed.xyz, aAxis, mod(aPositionSpeed.w * time, 6.28318530718));
+    int layer = aLayer;
+#elif defined(COMPACT)
+    int layer;
+    mat4 model = compactModel(int(aInstance), layer);
+#endif
+    vec4 world = model * vec4(boundsCenter + aPos * boundsExtent, 1.0);
+#if defined(STEREO) && defined(OVR_MULTIVIEW)
+    gl_Position = viewProjections[gl_ViewID_OVR] * world;
+#elif defined(STEREO)
+    int eye = gl_InstanceID % 2;
+    gl_Position = viewProjections[eye] * world;
+    gl_Layer = eye;
+#elif defined(MULTI_VIEW)
+    int viewIndex = gl_InstanceID % viewCount;
+    gl_Position = viewProjections[viewIndex] * world;
+    gl_ViewportIndex = viewIndex;
+#else
+    gl_Position = viewProjection * world;
+#endif
+    WorldPosition = world.xyz;
     TexCoord = aTexCoord;
-}       
+    Layer = layer;
+    Normal = mat3(model) * aNormal;
+#ifdef LIGHTMAP
+    LightmapCoord = aLightmapCoord;
+#endif
+}
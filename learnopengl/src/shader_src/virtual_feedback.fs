@@ -0,0 +1,14 @@
+#version 330 core
+#include "interface.glsl"
+// the page of the virtual texture each pixel samples, read back by virtual_texture.cpp
+out vec4 FragColor;
+
+INTERFACE(0) in vec2 TexCoord;
+
+#include "virtual_texture.glsl"
+
+void main()
+{
+    // alpha 0 is left where nothing samples it
+    FragColor = vec4(virtualPage(TexCoord, virtualLevel(TexCoord)), 255.0) / 255.0;
+}
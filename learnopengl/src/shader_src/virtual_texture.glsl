@@ -0,0 +1,39 @@
+// Sampling of a virtual texture (see virtual_texture.cpp)
+
+// a texel per page and a level per level: the xy cache slot, z the level of the page that is
+// resident there, the page itself or its nearest resident ancestor
+uniform sampler2D pageTable;
+// cacheSlots x cacheSlots pages, each virtualSize.z + 2 * virtualSize.w texels on a side
+uniform sampler2D pageCache;
+// x texels on a side of the finest level, y levels, z texels of a page, w border texels
+uniform vec4 virtualSize;
+uniform float cacheSlots;
+// added to the level, negative in the smaller feedback target
+uniform float levelBias;
+
+// the level the derivatives of uv ask for, the finest being 0
+float virtualLevel(vec2 uv)
+{
+    vec2 dx = dFdx(uv) * virtualSize.x, dy = dFdy(uv) * virtualSize.x;
+    float level = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + levelBias;
+    return clamp(floor(level), 0.0, virtualSize.y - 1.0);
+}
+
+// the page uv needs at level, xy page coordinates and z the level
+vec3 virtualPage(vec2 uv, float level)
+{
+    float pages = virtualSize.x / virtualSize.z / exp2(level);
+    return vec3(min(floor(clamp(uv, 0.0, 1.0) * pages), pages - 1.0), level);
+}
+
+vec4 sampleVirtual(vec2 uv)
+{
+    uv = clamp(uv, 0.0, 1.0);
+    vec4 entry = floor(textureLod(pageTable, uv, virtualLevel(uv)) * 255.0 + 0.5);
+    float pages = virtualSize.x / virtualSize.z / exp2(entry.z);
+    // the page's own fraction, the last page keeps uv = 1 inside
+    vec2 inPage = min(uv * pages - min(floor(uv * pages), pages - 1.0), 1.0);
+    float slot = virtualSize.z + 2.0 * virtualSize.w;
+    vec2 texel = entry.xy * slot + virtualSize.w + inPage * virtualSize.z;
+    return textureLod(pageCache, texel / (cacheSlots * slot), 0.0);
+}
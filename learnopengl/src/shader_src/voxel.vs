@@ -0,0 +1,48 @@
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+#include "interface.glsl"
+// the corner inside the chunk, w is the face direction in bits 0-2 and the layer above them
+// (see voxel_world.cpp)
+layout (location = 0) in uvec4 aVoxel;
+
+invariant gl_Position;
+
+// what indirect.vs hands the cube fragment shaders
+INTERFACE(0) out vec2 TexCoord;
+INTERFACE(1) flat out int Layer;
+INTERFACE(2) out vec3 Normal;
+INTERFACE(3) out vec3 WorldPosition;
+INTERFACE(4) flat out float LodFade;
+
+#include "frame_data.glsl"
+
+// one entry per chunk, the model matrix moves it to its corner
+struct ObjectData
+{
+    mat4 model;
+    vec4 boundsCenter;
+    vec4 boundsExtent;
+    ivec4 material;
+};
+layout (std430, binding = 2) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+const vec3 FACE_NORMALS[6] = vec3[](vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0),
+                                    vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+
+void main()
+{
+    ObjectData object = objects[gl_DrawIDARB];
+    uint face = aVoxel.w & 7u;
+    vec4 world = object.model * vec4(vec3(aVoxel.xyz), 1.0);
+    gl_Position = viewProjection * world;
+    WorldPosition = world.xyz;
+    // the texture repeats once a voxel across the two axes of the face
+    uint axis = face >> 1;
+    TexCoord = axis == 0u ? world.zy : axis == 1u ? world.xz : world.xy;
+    Layer = int(aVoxel.w >> 3);
+    LodFade = intBitsToFloat(object.material.w);
+    Normal = FACE_NORMALS[face];
+}
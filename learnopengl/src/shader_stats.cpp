@@ -0,0 +1,111 @@
+#ifndef SHADER_STATS_H
+#define SHADER_STATS_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// on makes every program retrievable as a binary whether the cache keeps it or not,
+// --shader-stats and the benchmarks want the instruction counts out of it
+inline bool shaderStatsEnabled = false;
+
+// What a program costs, from the GL after it is linked (see Shader::stats()).
+// Instructions and registers are what the driver says in its program binary, -1 where it says
+// nothing: NVIDIA's binaries carry the assembly of each stage with a
+// "# N instructions, M R-regs" comment, other drivers' binaries are opaque.
+struct ShaderStats
+{
+    // the sources and defines
+    std::string name;
+    // main thread time of the program, and of that what finish() waited on the driver
+    double buildMs = 0.0, linkMs = 0.0;
+    bool fromBinaryCache = false;
+    int uniforms = 0, uniformBlocks = 0, attributes = 0;
+    int binaryBytes = 0;
+    // summed over the stages, registers of the stage using the most
+    int instructions = -1, registers = -1;
+};
+
+// reads the instruction and register counts out of a program binary into stats,
+// false when the binary has none
+inline bool parseBinaryStats(const std::vector<char> &binary, ShaderStats &stats)
+{
+    const std::string marker = " instructions, ";
+    std::string_view text(binary.data(), binary.size());
+    bool found = false;
+    for (size_t at = text.find(marker); at != std::string_view::npos; at = text.find(marker, at + 1))
+    {
+        // "# 52 instructions, 4 R-regs", the number before the marker and the one after it
+        size_t start = at;
+        while (start > 0 && std::isdigit((unsigned char)text[start - 1]))
+            start--;
+        if (start == at || start < 2 || text[start - 1] != ' ' || text[start - 2] != '#')
+            continue;
+        size_t end = at + marker.size();
+        int registers = 0;
+        while (end < text.size() && std::isdigit((unsigned char)text[end]))
+            registers = registers * 10 + (text[end++] - '0');
+        if (text.compare(end, 7, " R-regs") != 0)
+            continue;
+        int instructions = std::stoi(std::string(text.substr(start, at - start)));
+        stats.instructions = (found ? stats.instructions : 0) + instructions;
+        stats.registers = std::max(found ? stats.registers : 0, registers);
+        found = true;
+    }
+    return found;
+}
+
+// the most instructions first, then the slowest to build
+inline void sortShaderStats(std::vector<ShaderStats> &stats)
+{
+    std::sort(stats.begin(), stats.end(), [](const ShaderStats &a, const ShaderStats &b) {
+        return a.instructions != b.instructions ? a.instructions > b.instructions : a.buildMs > b.buildMs;
+    });
+}
+
+// one row per program, in sortShaderStats() order
+inline void writeShaderStatsCsv(std::ostream &out, std::vector<ShaderStats> stats)
+{
+    sortShaderStats(stats);
+    out << "program,build_ms,link_ms,cached,uniforms,uniform_blocks,attributes,binary_bytes,instructions,registers\n";
+    for (const ShaderStats &program : stats)
+    {
+        out << '"' << program.name << "\"," << program.buildMs << ',' << program.linkMs << ','
+            << (program.fromBinaryCache ? 1 : 0) << ',' << program.uniforms << ',' << program.uniformBlocks << ','
+            << program.attributes << ',' << program.binaryBytes << ',';
+        if (program.instructions >= 0)
+            out << program.instructions << ',' << program.registers;
+        else
+            out << ',';
+        out << '\n';
+    }
+}
+
+// the count costliest programs for the console
+inline void printShaderStats(std::ostream &out, std::vector<ShaderStats> stats, size_t count)
+{
+    sortShaderStats(stats);
+    std::streamsize precision = out.precision();
+    out << std::setw(8) << "build ms" << std::setw(8) << "instr" << std::setw(6) << "regs" << std::setw(9)
+        << "uniforms" << "  program\n";
+    for (size_t i = 0; i < std::min(count, stats.size()); i++)
+    {
+        const ShaderStats &program = stats[i];
+        out << std::fixed << std::setprecision(2) << std::setw(8) << program.buildMs;
+        out.unsetf(std::ios::floatfield);
+        out.precision(precision);
+        if (program.instructions >= 0)
+            out << std::setw(8) << program.instructions << std::setw(6) << program.registers;
+        else
+            out << std::setw(8) << "-" << std::setw(6) << "-";
+        out << std::setw(9) << program.uniforms << "  " << program.name << (program.fromBinaryCache ? " (cached)" : "")
+            << '\n';
+    }
+}
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include "hash.cpp"
+#include "shader_compiler.cpp"
+#include "shader_preprocessor.cpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// compile time switches of the shader sources, each one a #define of the same name
+enum ShaderFeature : uint32_t
+{
+    // per-instance model matrix and layer attributes instead of the per-draw uniforms
+    SHADER_INSTANCED = 1u << 0,
+    // fragments below alphaCutoff are discarded
+    SHADER_ALPHA_TEST = 1u << 1,
+    // the sun term is shadowed by the cascaded shadow maps (shadow_maps.cpp)
+    SHADER_SUN_SHADOWS = 1u << 2,
+    // instances go round the views of the Views block, one viewport each (multi_view.cpp)
+    SHADER_MULTI_VIEW = 1u << 3,
+    // both eyes of the Views block in one draw into the layers of a StereoTarget (stereo.cpp)
+    SHADER_STEREO = 1u << 4,
+    // writes the weighted blended transparency sums instead of a color (oit.cpp)
+    SHADER_WEIGHTED_OIT = 1u << 5,
+    // per-instance position, axis and speed, the vertex stage spins the instance by FrameData's time
+    // (animated_instances.cpp)
+    SHADER_ANIMATED = 1u << 6,
+    // per-instance index of a CompactTransform record in place of the model matrix and layer
+    // (compact_instances.cpp)
+    SHADER_COMPACT = 1u << 7,
+    // the ambient term is the prefiltered environment's irradiance and reflection (environment_maps.cpp)
+    SHADER_ENVIRONMENT_LIGHTING = 1u << 8,
+    // the clustered point lights are shadowed by their pages of the shadow atlas (shadow_atlas.cpp)
+    SHADER_POINT_SHADOWS = 1u << 9,
+    // the material comes out of the material table by the instance's layer (material_table.cpp)
+    SHADER_MATERIAL_TABLE = 1u << 10,
+    // the clustered path's surfaces are seen through the froxel volume of the fog (volumetric_fog.cpp)
+    SHADER_VOLUMETRIC_FOG = 1u << 11,
+    // the deferred path's sun term is shadowed by the rays traced at half resolution (ray_traced_shadows.cpp)
+    SHADER_RAY_TRACED_SHADOWS = 1u << 12,
+    // the albedo is lit by the baked lightmap at the mesh's second texture coordinate (lightmap_baker.cpp)
+    SHADER_LIGHTMAP = 1u << 13,
+};
+
+// the features each stage sees when the stages are separate programs, a vertex program is
+// then shared by every fragment program whatever the fragment features are
+const uint32_t SHADER_VERTEX_FEATURES =
+    SHADER_INSTANCED | SHADER_MULTI_VIEW | SHADER_STEREO | SHADER_ANIMATED | SHADER_COMPACT | SHADER_LIGHTMAP;
+const uint32_t SHADER_FRAGMENT_FEATURES = SHADER_ALPHA_TEST | SHADER_SUN_SHADOWS | SHADER_WEIGHTED_OIT |
+                                          SHADER_ENVIRONMENT_LIGHTING | SHADER_POINT_SHADOWS | SHADER_MATERIAL_TABLE |
+                                          SHADER_VOLUMETRIC_FOG | SHADER_RAY_TRACED_SHADOWS | SHADER_LIGHTMAP;
+
+inline std::vector<std::string> shaderFeatureDefines(uint32_t features)
+{
+    static const char *names[] = {"INSTANCED", "ALPHA_TEST",   "SUN_SHADOWS", "MULTI_VIEW",
+                                  "STEREO",    "WEIGHTED_OIT", "ANIMATED",    "COMPACT",
+                                  "ENVIRONMENT_LIGHTING", "POINT_SHADOWS", "MATERIAL_TABLE", "VOLUMETRIC_FOG",
+                                  "RAY_TRACED_SHADOWS", "LIGHTMAP"};
+    std::vector<std::string> defines;
+    for (uint32_t bit = 0; bit < sizeof(names) / sizeof(names[0]); bit++)
+    {
+        if (features & (1u << bit))
+            defines.push_back(names[bit]);
+    }
+    return defines;
+}
+
+// One vertex + fragment pair and the permutations of it, selected with ShaderFeature bits
+// instead of branches on uniforms. get() compiles a combination the first time it is asked
+// for and the ShaderCompiler hands out the same program afterwards, keyed by the hash of
+// the expanded sources and the bits, so only the combinations in use are ever built.
+// With ShaderCompiler::separable a permutation is a pipeline of a vertex and a fragment
+// program that are each compiled once, V + F programs instead of V x F.
+class ShaderVariants
+{
+  public:
+    // defines go to every permutation, e.g. the VERTEX_INPUTS of a VertexLayoutOf (static_vertex_layout.cpp)
+    ShaderVariants(ShaderCompiler &compiler, const char *vertexPath, const char *fragmentPath,
+                   const std::vector<std::string> &defines = {})
+        : compiler(compiler), vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines)
+    {
+        // the sources without any defines, with their includes
+        ShaderPreprocessor vertexStage, fragmentStage;
+        vertexStage.process(vertexPath);
+        fragmentStage.process(fragmentPath);
+        hash = fnv1a64("", 0);
+        for (const ShaderPreprocessor *stage : {&vertexStage, &fragmentStage})
+        {
+            const char separator = '\0';
+            for (std::string_view piece : stage->pieces())
+                hash = fnv1a64(piece.data(), piece.size(), hash);
+            hash = fnv1a64(&separator, 1, hash);
+        }
+        for (const std::string &define : defines)
+            hash = fnv1a64(define.c_str(), define.size() + 1, hash);
+    }
+
+    // submitted on the first request without waiting, the Shader finishes on its first use(),
+    // later requests are one map lookup
+    Shader &get(uint32_t features)
+    {
+        if (Shader *found = compiler.findVariant(hash, features))
+            return *found;
+        if (compiler.separable)
+        {
+            Shader &vertexStage = compiler.submitStage(GL_VERTEX_SHADER, vertexPath.c_str(),
+                                                       withDefines(features & SHADER_VERTEX_FEATURES));
+            Shader &fragmentStage = compiler.submitStage(GL_FRAGMENT_SHADER, fragmentPath.c_str(),
+                                                         withDefines(features & SHADER_FRAGMENT_FEATURES));
+            return compiler.addVariant(hash, features, compiler.submitPipeline(vertexStage, fragmentStage));
+        }
+        return compiler.addVariant(hash, features,
+                                   compiler.submit(vertexPath.c_str(), fragmentPath.c_str(), withDefines(features)));
+    }
+
+    uint64_t sourceHash() const
+    {
+        return hash;
+    }
+
+  private:
+    ShaderCompiler &compiler;
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> defines;
+    uint64_t hash;
+
+    std::vector<std::string> withDefines(uint32_t features) const
+    {
+        std::vector<std::string> all = shaderFeatureDefines(features);
+        all.insert(all.end(), defines.begin(), defines.end());
+        return all;
+    }
+};
+
+#endif
@@ -0,0 +1,470 @@
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "block_layout.cpp"
+#include "camera.cpp"
+#include "frame_data.cpp"
+#include "frustum_culler.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "light_set.cpp"
+#include "quadtree_allocator.cpp"
+#include "ring_buffer.cpp"
+#include "shader.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Mirrors the std430 PointShadow struct in shader_src/point_shadows.glsl
+struct PointShadow
+{
+    // world to the atlas of each cube face, xy the texture coordinates and z the depth, all 0..1
+    glm::mat4 faceMatrices[6];
+    // the part of the atlas each face may be filtered in, xy the low corner and zw the high one
+    glm::vec4 faceRects[6];
+    // x depth bias, y normal offset in texels, z size of the face in texels
+    glm::vec4 params;
+};
+
+constexpr BlockMember POINT_SHADOW_LAYOUT[] = {
+    BLOCK_ARRAY(PointShadow, faceMatrices, GL_FLOAT_MAT4, 6),
+    BLOCK_ARRAY(PointShadow, faceRects, GL_FLOAT_VEC4, 6),
+    BLOCK_MEMBER(PointShadow, params, GL_FLOAT_VEC4),
+};
+static_assert(blockLayoutMismatch(POINT_SHADOW_LAYOUT, STD430) == -1,
+              "PointShadow members are not where std430 puts them");
+static_assert(blockLayoutSize(POINT_SHADOW_LAYOUT, STD430) == sizeof(PointShadow),
+              "PointShadow is not padded like std430");
+
+// Shadows of the clustered path's point lights from one depth atlas. Every frame update()
+// picks the MAX_SHADOWS lights that cover the most of the screen and gives each six square
+// pages of the atlas, one per cube face, from a QuadtreeAllocator: the page size follows the
+// light's coverage in powers of two, so near lights get sharp shadows and far ones cheap
+// pages. A face is only drawn again when it is new or resized, its light moved more than
+// moveThreshold since, or one of the dynamic casters is in its view, and at most faceBudget
+// faces are drawn per frame: the due faces of the lights that cover the most go first and the
+// others keep what they had a few frames longer. A light's shadow is used once all six of its
+// faces were drawn, its index goes to the receivers in the w of the light's color.
+// The casters are drawn by the caller between beginFace() and the next one with the
+// renderer's depth only programs, like the CascadedShadowMaps' cascades.
+class PointShadowAtlas
+{
+  public:
+    static const int FACES = 6;
+    static const int MAX_SHADOWS = 32;
+    static const int MIN_PAGE_SIZE = 64;
+    static constexpr int MAX_PAGE_SIZE = 512;
+    // storage binding of the PointShadows block and the texture unit of the atlas
+    static const unsigned int BINDING = 17;
+    static const unsigned int TEXTURE_UNIT = 15;
+
+    // faces drawn per frame at most
+    int faceBudget = 6;
+    // page texels per pixel of the light's radius on screen
+    float coverageScale = 1.0f;
+    // world distance a light moves before its faces are due again
+    float moveThreshold = 0.1f;
+    // in the depth compare, and the receiver moved along its normal by this many texels
+    float depthBias = 0.0005f;
+    float normalOffset = 1.5f;
+    // depth test of the frame, put back by end()
+    GLenum depthFunc = GL_LESS;
+    // lights with a shadow and faces drawn by the last update()
+    int shadowCount = 0;
+    int renderedFaces = 0;
+
+    PointShadowAtlas(RingBuffer &ring, int atlasSize)
+        : ring(ring), sampler(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)
+    {
+        size = std::max(MAX_PAGE_SIZE, atlasSize);
+        allocator.reset(size, MIN_PAGE_SIZE);
+        atlas.create(size, size, GL_DEPTH_COMPONENT32F, 1, GPU_MEMORY_RENDER_TARGETS);
+        // depth comparison, the hardware filters the four results
+        glSamplerParameteri(sampler.ID, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glSamplerParameteri(sampler.ID, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        framebuffer = createFramebuffer();
+        GLenum status;
+        if (hasDSA())
+        {
+            glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, atlas.ID, 0);
+            glNamedFramebufferDrawBuffer(framebuffer, GL_NONE);
+            glNamedFramebufferReadBuffer(framebuffer, GL_NONE);
+            status = glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER);
+        }
+        else
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlas.ID, 0);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+            status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::SHADOW_ATLAS::INCOMPLETE: 0x" << std::hex << status << std::dec << '\n';
+    }
+
+    ~PointShadowAtlas()
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+    }
+
+    PointShadowAtlas(const PointShadowAtlas &) = delete;
+    PointShadowAtlas &operator=(const PointShadowAtlas &) = delete;
+
+    // the receivers read the block next to the clusters' ones in the fragment stage
+    static bool isSupported()
+    {
+        if (!GLAD_GL_VERSION_4_3)
+            return false;
+        GLint blocks = 0, bindings = 0, units = 0;
+        glGetIntegerv(GL_MAX_FRAGMENT_SHADER_STORAGE_BLOCKS, &blocks);
+        glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &bindings);
+        glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &units);
+        return blocks >= 5 && bindings > (GLint)BINDING && units > (GLint)TEXTURE_UNIT;
+    }
+
+    // points a receiver program (one built with POINT_SHADOWS) at the atlas
+    void attach(Shader &program)
+    {
+        program.use();
+        program.setInt("shadowAtlas", TEXTURE_UNIT);
+    }
+
+    // picks the shadowed lights for the camera and a height pixels tall target and decides
+    // which faces are drawn this frame, writing the shadow of every light into its color's w
+    // (0 for none, else the index + 1); dynamicCasters as in CascadedShadowMaps::update()
+    void update(std::vector<PointLight> &lights, Camera &camera, int height,
+                const std::vector<glm::vec4> &dynamicCasters, bool zeroToOne)
+    {
+        renderedFaces = 0;
+        if (zeroToOne != cachedZeroToOne)
+        {
+            // the projections change, every face is drawn again
+            for (Slot &slot : slots)
+                slot.drawn = 0;
+            cachedZeroToOne = zeroToOne;
+        }
+
+        // the radius on screen of the lights in view, the largest ones get the shadows
+        Frustum view(camera.GetProjectionMatrix() * camera.GetViewMatrix());
+        float pixelsPerSlope = camera.GetProjectionMatrix()[1][1] * height * 0.5f;
+        candidates.clear();
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            lights[i].color.w = 0.0f;
+            glm::vec4 sphere = lights[i].positionRadius;
+            if (!touches(view, sphere))
+                continue;
+            float distance = glm::distance(glm::vec3(sphere), camera.position);
+            float coverage = distance <= sphere.w ? (float)height : sphere.w / distance * pixelsPerSlope;
+            candidates.push_back({(uint32_t)i, coverage});
+        }
+        size_t keep = std::min(candidates.size(), (size_t)MAX_SHADOWS);
+        std::partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end(),
+                          [](const Candidate &a, const Candidate &b) { return a.coverage > b.coverage; });
+        candidates.resize(keep);
+
+        // the slots of lights that lost their shadow free their pages first, for the new ones
+        for (Slot &slot : slots)
+        {
+            bool kept = false;
+            for (const Candidate &candidate : candidates)
+                kept = kept || candidate.light == slot.light;
+            if (!kept)
+                release(slot);
+        }
+        slots.erase(std::remove_if(slots.begin(), slots.end(), [](const Slot &slot) { return slot.pageSize == 0; }),
+                    slots.end());
+        for (const Candidate &candidate : candidates)
+        {
+            Slot *slot = find(candidate.light);
+            int wanted = pageSize(candidate.coverage);
+            // grown at once, shrunk only for a quarter of the size, so a light at the edge of
+            // a size doesn't change pages every frame
+            if (slot && (wanted > slot->pageSize || wanted * 4 <= slot->pageSize))
+                release(*slot);
+            if (!slot)
+            {
+                slots.push_back(Slot());
+                slot = &slots.back();
+                slot->light = candidate.light;
+            }
+            slot->coverage = candidate.coverage;
+            if (slot->pageSize == 0)
+                allocate(*slot, wanted);
+        }
+        slots.erase(std::remove_if(slots.begin(), slots.end(), [](const Slot &slot) { return slot.pageSize == 0; }),
+                    slots.end());
+
+        // the faces that are due: new, moved or with a dynamic caster in view
+        due.clear();
+        for (size_t s = 0; s < slots.size(); s++)
+        {
+            Slot &slot = slots[s];
+            const glm::vec4 &sphere = lights[slot.light].positionRadius;
+            bool moved = glm::distance(glm::vec3(sphere), slot.origin) > moveThreshold || sphere.w != slot.radius;
+            if (moved || slot.drawn == 0)
+            {
+                slot.origin = glm::vec3(sphere);
+                slot.radius = sphere.w;
+                fit(slot, zeroToOne);
+                slot.stale = (1u << FACES) - 1;
+            }
+            for (const glm::vec4 &caster : dynamicCasters)
+            {
+                if (glm::distance(glm::vec3(caster), slot.origin) > caster.w + slot.radius)
+                    continue;
+                for (int face = 0; face < FACES; face++)
+                {
+                    if (touches(slot.frusta[face], caster))
+                        slot.stale |= 1u << face;
+                }
+            }
+            for (int face = 0; face < FACES; face++)
+            {
+                if (slot.stale & (1u << face))
+                    due.push_back({(uint32_t)s, face});
+            }
+        }
+        // faces never drawn first, then by the coverage of their light
+        std::stable_sort(due.begin(), due.end(), [this](const Face &a, const Face &b) {
+            bool aNew = !(slots[a.slot].drawn & (1u << a.face)), bNew = !(slots[b.slot].drawn & (1u << b.face));
+            if (aNew != bNew)
+                return aNew;
+            return slots[a.slot].coverage > slots[b.slot].coverage;
+        });
+        due.resize(std::min(due.size(), (size_t)std::max(faceBudget, 0)));
+        renderedFaces = (int)due.size();
+
+        // the lights whose six faces are all in the atlas after this frame's read it
+        for (const Face &face : due)
+            slots[face.slot].drawn |= 1u << face.face;
+        shadowCount = 0;
+        for (Slot &slot : slots)
+        {
+            slot.index = slot.drawn == (1u << FACES) - 1 ? ++shadowCount : 0;
+            lights[slot.light].color.w = (float)slot.index;
+        }
+    }
+
+    // the faces to draw this frame, beginFace(0) up to beginFace(renderedFaces - 1)
+    const Frustum &frustum(int index) const
+    {
+        return slots[due[index].slot].frusta[due[index].face];
+    }
+
+    // before the first beginFace(), remembers the target and viewport to put back
+    void begin()
+    {
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &savedFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glState.setDepthFunc(GL_LESS);
+        glState.setDepthMask(true);
+        glState.enable(GL_SCISSOR_TEST);
+        glState.enable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+    }
+
+    // clears the face's page and makes frameData the light's view of it, the casters are
+    // drawn with the depth only programs after this
+    void beginFace(int index, FrameDataBuffer &frameDataBuffer, FrameData frameData)
+    {
+        Slot &slot = slots[due[index].slot];
+        int face = due[index].face;
+        const QuadtreePage &page = slot.pages[face];
+        glViewport(page.x, page.y, page.size, page.size);
+        glScissor(page.x, page.y, page.size, page.size);
+        const float farthest = 1.0f;
+        glClearBufferfv(GL_DEPTH, 0, &farthest);
+        frameData.view = slot.views[face];
+        frameData.projection = slot.projection;
+        frameData.cameraPosition = glm::vec4(slot.origin, 1.0f);
+        frameDataBuffer.update(frameData);
+        slot.stale &= ~(1u << face);
+        slot.shadow.faceMatrices[face] = slot.pending[face];
+    }
+
+    // puts the target, the viewport, the depth state and the camera's frameData back
+    void end(FrameDataBuffer &frameDataBuffer, FrameData &frameData)
+    {
+        glState.disable(GL_POLYGON_OFFSET_FILL);
+        glState.disable(GL_SCISSOR_TEST);
+        glState.setDepthFunc(depthFunc);
+        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)savedFramebuffer);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+        frameDataBuffer.update(frameData);
+    }
+
+    // uploads the receivers' PointShadows, in the order of the indexes update() handed out,
+    // and binds them with the atlas
+    void bind()
+    {
+        shadows.clear();
+        for (const Slot &slot : slots)
+        {
+            if (slot.index > 0)
+                shadows.push_back(slot.shadow);
+        }
+        if (!shadows.empty())
+        {
+            GLintptr offset = ring.push(shadows.data(), shadows.size() * sizeof(PointShadow), ring.storageAlignment);
+            if (offset >= 0)
+                glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, ring.ID, offset,
+                                        shadows.size() * sizeof(PointShadow));
+        }
+        atlas.bind(TEXTURE_UNIT);
+        sampler.bind(TEXTURE_UNIT);
+    }
+
+  private:
+    struct Candidate
+    {
+        uint32_t light;
+        float coverage;
+    };
+    struct Slot
+    {
+        uint32_t light = 0;
+        float coverage = 0.0f;
+        int pageSize = 0;
+        QuadtreePage pages[FACES];
+        // where the light was when the faces were fit
+        glm::vec3 origin = glm::vec3(0.0f);
+        float radius = 0.0f;
+        glm::mat4 views[FACES];
+        glm::mat4 projection = glm::mat4(1.0f);
+        Frustum frusta[FACES];
+        // the face matrices of the fit, each goes to the receivers once its face is drawn
+        glm::mat4 pending[FACES];
+        PointShadow shadow;
+        // bits of the faces drawn at least once into their pages, and of the ones due
+        uint32_t drawn = 0;
+        uint32_t stale = 0;
+        // in the receivers' PointShadows + 1, 0 while a face was never drawn
+        int index = 0;
+    };
+    struct Face
+    {
+        uint32_t slot;
+        int face;
+    };
+
+    RingBuffer &ring;
+    Texture2D atlas;
+    Sampler sampler;
+    unsigned int framebuffer = 0;
+    int size = 0;
+    QuadtreeAllocator allocator;
+    std::vector<Slot> slots;
+    std::vector<Candidate> candidates;
+    std::vector<Face> due;
+    std::vector<PointShadow> shadows;
+    bool cachedZeroToOne = false;
+    GLint savedFramebuffer = 0;
+    GLint savedViewport[4] = {};
+
+    int pageSize(float coverage) const
+    {
+        int wanted = MIN_PAGE_SIZE;
+        while (wanted < MAX_PAGE_SIZE && wanted < coverage * coverageScale)
+            wanted *= 2;
+        return wanted;
+    }
+
+    Slot *find(uint32_t light)
+    {
+        for (Slot &slot : slots)
+            if (slot.light == light)
+                return &slot;
+        return NULL;
+    }
+
+    // six pages of pageSize, or of the largest smaller size the atlas still has room for
+    void allocate(Slot &slot, int wanted)
+    {
+        for (int pageSize = wanted; pageSize >= MIN_PAGE_SIZE; pageSize /= 2)
+        {
+            int face = 0;
+            for (; face < FACES; face++)
+            {
+                if (!allocator.allocate(pageSize, slot.pages[face]))
+                    break;
+            }
+            if (face == FACES)
+            {
+                slot.pageSize = pageSize;
+                slot.drawn = 0;
+                return;
+            }
+            for (int i = 0; i < face; i++)
+                allocator.free(slot.pages[i]);
+        }
+    }
+
+    void release(Slot &slot)
+    {
+        if (slot.pageSize == 0)
+            return;
+        for (const QuadtreePage &page : slot.pages)
+            allocator.free(page);
+        slot.pageSize = 0;
+        slot.drawn = 0;
+    }
+
+    // the 90 degree views of the cube faces around the light, out to its radius, in the
+    // GL_TEXTURE_CUBE_MAP_POSITIVE_X + face order point_shadows.glsl picks them in
+    void fit(Slot &slot, bool zeroToOne)
+    {
+        static const glm::vec3 directions[FACES] = {glm::vec3(1.0f, 0.0f, 0.0f),  glm::vec3(-1.0f, 0.0f, 0.0f),
+                                                    glm::vec3(0.0f, 1.0f, 0.0f),  glm::vec3(0.0f, -1.0f, 0.0f),
+                                                    glm::vec3(0.0f, 0.0f, 1.0f),  glm::vec3(0.0f, 0.0f, -1.0f)};
+        static const glm::vec3 ups[FACES] = {glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+                                             glm::vec3(0.0f, 0.0f, 1.0f),  glm::vec3(0.0f, 0.0f, -1.0f),
+                                             glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)};
+        float nearPlane = std::max(0.02f, slot.radius * 0.01f);
+        slot.projection = zeroToOne ? glm::perspectiveRH_ZO(glm::radians(90.0f), 1.0f, nearPlane, slot.radius)
+                                    : glm::perspectiveRH_NO(glm::radians(90.0f), 1.0f, nearPlane, slot.radius);
+        for (int face = 0; face < FACES; face++)
+        {
+            slot.views[face] = glm::lookAt(slot.origin, slot.origin + directions[face], ups[face]);
+            glm::mat4 viewProjection = slot.projection * slot.views[face];
+            slot.frusta[face] = Frustum(viewProjection);
+
+            // clip space to the face's page of the atlas' 0..1, depth is 0..1 already with GL_ZERO_TO_ONE
+            const QuadtreePage &page = slot.pages[face];
+            float scale = 0.5f * page.size / size;
+            glm::vec2 center = (glm::vec2(page.x, page.y) + 0.5f * page.size) / (float)size;
+            glm::mat4 toTexture =
+                glm::translate(glm::mat4(1.0f), glm::vec3(center, zeroToOne ? 0.0f : 0.5f)) *
+                glm::scale(glm::mat4(1.0f), glm::vec3(scale, scale, zeroToOne ? 1.0f : 0.5f));
+            slot.pending[face] = toTexture * viewProjection;
+            // the filter's taps stay a texel and a half inside the page
+            float inset = 1.5f / size;
+            slot.shadow.faceRects[face] = glm::vec4(glm::vec2(page.x, page.y) / (float)size + inset,
+                                                    glm::vec2(page.x + page.size, page.y + page.size) / (float)size -
+                                                        inset);
+        }
+        slot.shadow.params = glm::vec4(depthBias, normalOffset, (float)slot.pageSize, 1.0f / size);
+    }
+
+    static bool touches(const Frustum &frustum, const glm::vec4 &sphere)
+    {
+        for (const glm::vec4 &plane : frustum.planes)
+        {
+            if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,349 @@
+#ifndef SHADOW_MAPS_H
+#define SHADOW_MAPS_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "block_layout.cpp"
+#include "camera.cpp"
+#include "frame_data.cpp"
+#include "frustum_culler.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "ring_buffer.cpp"
+#include "shader.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Mirrors the std140 ShadowData block in shader_src/shadows.glsl
+struct ShadowData
+{
+    // world to shadow map space of each cascade, xy the texture coordinates and z the depth, all 0..1
+    glm::mat4 cascadeMatrices[4];
+    // the view depth each cascade reaches
+    glm::vec4 splits;
+    // world size of a texel of each cascade
+    glm::vec4 texelSizes;
+    // x depth bias, y normal offset in texels, z cascade count, w 1 / map size
+    glm::vec4 params;
+};
+
+constexpr BlockMember SHADOW_DATA_LAYOUT[] = {
+    BLOCK_ARRAY(ShadowData, cascadeMatrices, GL_FLOAT_MAT4, 4), BLOCK_MEMBER(ShadowData, splits, GL_FLOAT_VEC4),
+    BLOCK_MEMBER(ShadowData, texelSizes, GL_FLOAT_VEC4),        BLOCK_MEMBER(ShadowData, params, GL_FLOAT_VEC4),
+};
+static_assert(blockLayoutMismatch(SHADOW_DATA_LAYOUT, STD140) == -1, "ShadowData members are not where std140 puts them");
+static_assert(blockLayoutSize(SHADOW_DATA_LAYOUT, STD140) == sizeof(ShadowData), "ShadowData is not padded like std140");
+
+// Cascaded shadow maps of the sun. The camera's view out to distance is cut into CASCADES
+// slices (split between even and logarithmic by splitLambda), each one gets an orthographic
+// view from the sun around the bounding sphere of its slice and a layer of one depth texture
+// array. The sphere doesn't change size as the camera turns and its center is snapped to
+// whole texels of the light's view, so the shadow edges don't shimmer.
+// Cascades from cacheFrom on are fit with cacheMargin of spare radius and kept as they are
+// while the camera's slice still fits inside, so far cascades of static geometry are only
+// drawn again once the camera moved past the margin. A cascade any of the dynamic casters
+// reaches is drawn every frame.
+// The casters are drawn by the caller between beginCascade() and the next one, with the
+// renderer's depth only programs: FrameData is switched to the light's view for it.
+// setQuality() trades them down for GPU time: the view is cut into fewer cascades, which the
+// receivers read from the block, and they are drawn into a corner of their layers.
+class CascadedShadowMaps
+{
+  public:
+    static constexpr int CASCADES = 4;
+    // uniform buffer binding point of the ShadowData block and the texture unit of the maps
+    static const unsigned int BINDING = 5;
+    static const unsigned int TEXTURE_UNIT = 8;
+
+    // towards the sun
+    glm::vec3 lightDirection = glm::normalize(glm::vec3(0.3f, 1.0f, 0.5f));
+    // view depth the last cascade reaches, and the share of logarithmic splits
+    float distance = 40.0f;
+    float splitLambda = 0.75f;
+    // how far towards the sun casters outside a cascade still throw shadows into it
+    float casterDistance = 20.0f;
+    // the first cascade that is cached, and the part of its radius the camera can move
+    int cacheFrom = 2;
+    float cacheMargin = 0.15f;
+    // in the depth compare, and the receiver moved along its normal by this many texels
+    float depthBias = 0.0005f;
+    float normalOffset = 1.5f;
+    // depth test of the frame, put back by end()
+    GLenum depthFunc = GL_LESS;
+    // cascades drawn by the last update()
+    int renderedCascades = 0;
+    // the cascades in use, and the part of the maps' size drawn
+    int cascadeCount = CASCADES;
+    float resolutionScale = 1.0f;
+
+    CascadedShadowMaps(RingBuffer &ring, int mapSize)
+        : ring(ring), sampler(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)
+    {
+        size = std::max(64, mapSize);
+        maps.create(size, size, CASCADES, GL_DEPTH_COMPONENT32F, 1, GPU_MEMORY_RENDER_TARGETS);
+        // depth comparison, the hardware filters the four results
+        glSamplerParameteri(sampler.ID, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glSamplerParameteri(sampler.ID, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        for (int i = 0; i < CASCADES; i++)
+        {
+            framebuffers[i] = createFramebuffer();
+            GLenum status;
+            if (hasDSA())
+            {
+                glNamedFramebufferTextureLayer(framebuffers[i], GL_DEPTH_ATTACHMENT, maps.ID, 0, i);
+                glNamedFramebufferDrawBuffer(framebuffers[i], GL_NONE);
+                glNamedFramebufferReadBuffer(framebuffers[i], GL_NONE);
+                status = glCheckNamedFramebufferStatus(framebuffers[i], GL_FRAMEBUFFER);
+            }
+            else
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, maps.ID, 0, i);
+                glDrawBuffer(GL_NONE);
+                glReadBuffer(GL_NONE);
+                status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            }
+            if (status != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::SHADOW_MAPS::INCOMPLETE: 0x" << std::hex << status << std::dec << '\n';
+        }
+    }
+
+    ~CascadedShadowMaps()
+    {
+        glDeleteFramebuffers(CASCADES, framebuffers);
+    }
+
+    CascadedShadowMaps(const CascadedShadowMaps &) = delete;
+    CascadedShadowMaps &operator=(const CascadedShadowMaps &) = delete;
+
+    // cascades from 1 to CASCADES and a resolution of the maps' size, every cascade is drawn
+    // again after a change
+    void setQuality(int count, float resolution)
+    {
+        count = std::clamp(count, 1, CASCADES);
+        resolution = std::clamp(resolution, 64.0f / size, 1.0f);
+        if (count == cascadeCount && resolution == resolutionScale)
+            return;
+        cascadeCount = count;
+        resolutionScale = resolution;
+        for (Cascade &cascade : cascades)
+            cascade.valid = false;
+    }
+
+    // points a receiver program (one built with SUN_SHADOWS) at the block and the maps
+    void attach(Shader &program)
+    {
+        program.use();
+        program.setInt("shadowMaps", TEXTURE_UNIT);
+        program.bindUniformBlock("ShadowData", BINDING);
+    }
+
+    // fits the cascades to the camera and decides which are drawn this frame, dynamicCasters
+    // are the bounding spheres (xyz center, w radius) of the casters that move or change;
+    // zeroToOne is glClipControl(GL_ZERO_TO_ONE)
+    void update(Camera &camera, const std::vector<glm::vec4> &dynamicCasters, bool zeroToOne)
+    {
+        renderedCascades = 0;
+        float zNear = camera.zNear;
+        float zFar = std::min(distance, camera.reversedZ ? distance : camera.zFar);
+        float tanHalf = std::tan(glm::radians(camera.zoom) * 0.5f);
+        // squared tangent of the slices' corner rays
+        float cornerSlope = tanHalf * tanHalf * (1.0f + camera.aspectRatio * camera.aspectRatio);
+        bool lightChanged = lightDirection != cachedLightDirection || zeroToOne != cachedZeroToOne;
+        cachedLightDirection = lightDirection;
+        cachedZeroToOne = zeroToOne;
+
+        float sliceNear = zNear;
+        for (int i = 0; i < cascadeCount; i++)
+        {
+            float t = float(i + 1) / cascadeCount;
+            float logarithmic = zNear * std::pow(zFar / zNear, t);
+            float even = zNear + (zFar - zNear) * t;
+            float sliceFar = splitLambda * logarithmic + (1.0f - splitLambda) * even;
+            splits[i] = sliceFar;
+
+            // the smallest sphere around the slice, on the view axis
+            float centerDepth = std::min(sliceFar, (sliceNear + sliceFar) * 0.5f * (1.0f + cornerSlope));
+            float radius = std::sqrt((sliceFar - centerDepth) * (sliceFar - centerDepth) +
+                                     sliceFar * sliceFar * cornerSlope);
+            glm::vec3 center = camera.position + camera.front * centerDepth;
+            sliceNear = sliceFar;
+
+            Cascade &cascade = cascades[i];
+            bool cached = i >= cacheFrom;
+            bool fits = cascade.valid && !lightChanged && cached &&
+                        glm::distance(center, cascade.center) + radius <= cascade.radius;
+            if (!fits)
+            {
+                fit(cascade, center, radius * (cached ? 1.0f + cacheMargin : 1.0f), zeroToOne);
+                cascade.stale = true;
+            }
+            if (!cascade.stale)
+            {
+                // the cached map is good unless something in it moved
+                for (const glm::vec4 &caster : dynamicCasters)
+                {
+                    if (touches(cascade.frustum, caster))
+                    {
+                        cascade.stale = true;
+                        break;
+                    }
+                }
+            }
+            if (cascade.stale)
+                renderedCascades++;
+        }
+    }
+
+    // true when the cascade has to be drawn this frame
+    bool stale(int cascade) const
+    {
+        return cascade < cascadeCount && cascades[cascade].stale;
+    }
+
+    // the cascade's view from the sun, to cull the casters with
+    const Frustum &frustum(int cascade) const
+    {
+        return cascades[cascade].frustum;
+    }
+
+    // before the first beginCascade(), remembers the target and viewport to put back
+    void begin()
+    {
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &savedFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
+        glViewport(0, 0, drawSize(), drawSize());
+        glState.setDepthFunc(GL_LESS);
+        glState.setDepthMask(true);
+        // the slope of the surfaces away from the sun, on top of the receivers' normal offset
+        glState.enable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+    }
+
+    // clears the cascade's layer and makes frameData the light's view, the casters are
+    // drawn with the depth only programs after this
+    void beginCascade(int index, FrameDataBuffer &frameDataBuffer, FrameData frameData)
+    {
+        Cascade &cascade = cascades[index];
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[index]);
+        const float farthest = 1.0f;
+        glClearBufferfv(GL_DEPTH, 0, &farthest);
+        frameData.view = cascade.view;
+        frameData.projection = cascade.projection;
+        frameData.cameraPosition = glm::vec4(cascade.center + lightDirection * cascade.radius, 1.0f);
+        frameDataBuffer.update(frameData);
+        cascade.stale = false;
+        cascade.valid = true;
+    }
+
+    // puts the target, the viewport, the depth state and the camera's frameData back
+    void end(FrameDataBuffer &frameDataBuffer, FrameData &frameData)
+    {
+        glState.disable(GL_POLYGON_OFFSET_FILL);
+        glState.setDepthFunc(depthFunc);
+        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)savedFramebuffer);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+        frameDataBuffer.update(frameData);
+    }
+
+    // uploads the receivers' ShadowData and binds it with the maps
+    void bind()
+    {
+        ShadowData data;
+        for (int i = 0; i < CASCADES; i++)
+        {
+            data.cascadeMatrices[i] = cascades[i].shadowMatrix;
+            data.splits[i] = splits[i];
+            data.texelSizes[i] = 2.0f * cascades[i].radius / drawSize();
+        }
+        data.params = glm::vec4(depthBias, normalOffset, (float)cascadeCount, 1.0f / size);
+        GLintptr offset = ring.push(&data, sizeof(ShadowData), ring.uniformAlignment);
+        if (offset >= 0)
+            glState.bindBufferRange(GL_UNIFORM_BUFFER, BINDING, ring.ID, offset, sizeof(ShadowData));
+        maps.bind(TEXTURE_UNIT);
+        sampler.bind(TEXTURE_UNIT);
+    }
+
+  private:
+    struct Cascade
+    {
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+        glm::mat4 view = glm::mat4(1.0f);
+        glm::mat4 projection = glm::mat4(1.0f);
+        // world to the 0..1 coordinates of the map
+        glm::mat4 shadowMatrix = glm::mat4(1.0f);
+        Frustum frustum;
+        // drawn at least once, and due this frame
+        bool valid = false;
+        bool stale = true;
+    };
+
+    RingBuffer &ring;
+    Texture2DArray maps;
+    Sampler sampler;
+    unsigned int framebuffers[CASCADES] = {};
+    int size = 0;
+    Cascade cascades[CASCADES];
+    float splits[CASCADES] = {};
+    glm::vec3 cachedLightDirection = glm::vec3(0.0f);
+    bool cachedZeroToOne = false;
+    GLint savedFramebuffer = 0;
+    GLint savedViewport[4] = {};
+
+    int drawSize() const
+    {
+        return std::max(1, (int)(size * resolutionScale));
+    }
+
+    // the light's view around a sphere, the center snapped to whole texels in it
+    void fit(Cascade &cascade, glm::vec3 center, float radius, bool zeroToOne)
+    {
+        // rounded up, so the sphere of a lens keeps one size
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+        glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f), -lightDirection, up);
+        glm::vec3 lightCenter = glm::vec3(view * glm::vec4(center, 1.0f));
+        float texel = 2.0f * radius / drawSize();
+        lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+        lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+        cascade.center = glm::vec3(glm::inverse(view) * glm::vec4(lightCenter, 1.0f));
+        cascade.radius = radius;
+        cascade.view = view;
+
+        // looking down -z, the casters up to casterDistance towards the sun are in front of the near plane
+        float nearPlane = -lightCenter.z - radius - casterDistance, farPlane = -lightCenter.z + radius;
+        float left = lightCenter.x - radius, right = lightCenter.x + radius;
+        float bottom = lightCenter.y - radius, top = lightCenter.y + radius;
+        cascade.projection = zeroToOne ? glm::orthoRH_ZO(left, right, bottom, top, nearPlane, farPlane)
+                                       : glm::orthoRH_NO(left, right, bottom, top, nearPlane, farPlane);
+        glm::mat4 viewProjection = cascade.projection * view;
+        cascade.frustum = Frustum(viewProjection);
+
+        // clip space to the drawn corner of the map's 0..1, depth is 0..1 already with GL_ZERO_TO_ONE
+        float corner = (float)drawSize() / size;
+        glm::mat4 toTexture =
+            glm::translate(glm::mat4(1.0f), glm::vec3(0.5f * corner, 0.5f * corner, zeroToOne ? 0.0f : 0.5f)) *
+            glm::scale(glm::mat4(1.0f), glm::vec3(0.5f * corner, 0.5f * corner, zeroToOne ? 1.0f : 0.5f));
+        cascade.shadowMatrix = toTexture * viewProjection;
+    }
+
+    static bool touches(const Frustum &frustum, const glm::vec4 &sphere)
+    {
+        for (const glm::vec4 &plane : frustum.planes)
+        {
+            if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
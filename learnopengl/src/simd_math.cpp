@@ -0,0 +1,123 @@
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <cmath>
+
+// SSE2 is part of every x64 target, on other targets the batched code falls back to scalar loops
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#else
+#define SIMD_SSE2 0
+#endif
+
+// SSSE3 byte shuffles when the compiler targets them (-mssse3, implied by /arch:AVX and -mavx)
+#if defined(__SSSE3__) || defined(__AVX__)
+#define SIMD_SSSE3 1
+#include <tmmintrin.h>
+#else
+#define SIMD_SSSE3 0
+#endif
+
+// AVX only when the compiler targets it (/arch:AVX or -mavx), there is no runtime dispatch
+#if defined(__AVX__)
+#define SIMD_AVX 1
+#include <immintrin.h>
+#else
+#define SIMD_AVX 0
+#endif
+
+// F16C half float conversions when the compiler targets them (-mf16c, implied by /arch:AVX2 and -mavx2)
+#if defined(__F16C__) || defined(__AVX2__)
+#define SIMD_F16C 1
+#include <immintrin.h>
+#else
+#define SIMD_F16C 0
+#endif
+
+#if SIMD_SSE2
+// lane-wise select, mask lanes must be all ones or all zeros
+inline __m128 simdSelect(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// x - 2 pi k into [-pi, pi], with 2 pi split in two (Cody-Waite) so the product of the high
+// part is exact and the reduction stays accurate to |x| = 1e4
+inline __m128 simdReduceAngle(__m128 x)
+{
+    const __m128 invTwoPi = _mm_set1_ps(0.15915494309189533577f);
+    // 6.28125 has 9 bits, times turns of up to 11 bits it is exact
+    const __m128 twoPiHigh = _mm_set1_ps(6.28125f);
+    const __m128 twoPiLow = _mm_set1_ps(1.93530717958647692529e-3f);
+
+    // cvtps rounds to nearest
+    __m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, invTwoPi)));
+    x = _mm_sub_ps(x, _mm_mul_ps(turns, twoPiHigh));
+    return _mm_sub_ps(x, _mm_mul_ps(turns, twoPiLow));
+}
+
+// sine of 4 angles in [-3 pi / 2, 3 pi / 2]: reflection into [-pi/2, pi/2] followed by a
+// degree 11 odd polynomial
+inline __m128 simdSinReduced(__m128 x)
+{
+    const __m128 pi = _mm_set1_ps(3.14159265358979323846f);
+    const __m128 halfPi = _mm_set1_ps(1.57079632679489661923f);
+
+    // sin(pi - x) = sin(x)
+    __m128 signedPi = _mm_or_ps(pi, _mm_and_ps(x, _mm_set1_ps(-0.0f)));
+    __m128 outside = _mm_cmpgt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), x), halfPi);
+    x = simdSelect(outside, _mm_sub_ps(signedPi, x), x);
+
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 p = _mm_set1_ps(-2.50521083854417187751e-8f);
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(2.75573192239858906526e-6f));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.98412698412698412698e-4f));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(8.33333333333333333333e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.66666666666666666667e-1f));
+    p = _mm_mul_ps(_mm_mul_ps(p, x2), x);
+    return _mm_add_ps(p, x);
+}
+
+// sine of 4 angles in radians, absolute error below 1e-6 for |x| < 1e4
+inline __m128 simdSin(__m128 x)
+{
+    return simdSinReduced(simdReduceAngle(x));
+}
+
+// sine and cosine of 4 angles, cos(x) = sin(x + pi/2) with pi/2 added after the reduction
+inline void simdSinCos(__m128 x, __m128 &s, __m128 &c)
+{
+    x = simdReduceAngle(x);
+    s = simdSinReduced(x);
+    c = simdSinReduced(_mm_add_ps(x, _mm_set1_ps(1.57079632679489661923f)));
+}
+
+// the 4 lanes of v as halves rounded to nearest, in the low 64 bits. Without F16C the
+// magnitudes below the smallest normal half become 0, those above the largest are clamped
+// to it and ties round up
+inline __m128i simdFloatToHalf(__m128 v)
+{
+#if SIMD_F16C
+    return _mm_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT);
+#else
+    __m128i bits = _mm_castps_si128(v);
+    __m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+    __m128i magnitude = _mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF));
+    // the exponent bias from 127 to 15 and the mantissa rounded to its top 10 bits
+    __m128i rounded = _mm_add_epi32(magnitude, _mm_set1_epi32(0x1000 - (112 << 23)));
+    __m128i half = _mm_srli_epi32(rounded, 13);
+    __m128i largest = _mm_set1_epi32(0x7BFF);
+    __m128i huge = _mm_cmpgt_epi32(half, largest);
+    half = _mm_or_si128(_mm_andnot_si128(huge, half), _mm_and_si128(huge, largest));
+    half = _mm_andnot_si128(_mm_cmplt_epi32(magnitude, _mm_set1_epi32(113 << 23)), half);
+    half = _mm_or_si128(half, sign);
+    // packs saturates signed, 0 to 0xFFFF goes through it moved down by 0x8000 and back
+    __m128i offset = _mm_set1_epi32(0x8000);
+    return _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(half, offset), _mm_setzero_si128()),
+                         _mm_set1_epi16((short)0x8000));
+#endif
+}
+#endif
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Fixed timestep scheduler: the frame's real time is accumulated and spent in steps of
+// exactly 1 / hz seconds, so the simulation runs at the same rate whatever the frame rate.
+// alpha() is how far the next step has progressed, for drawing state interpolated between
+// the last two steps. After a stall at most maxSteps are run and the rest of the time is
+// dropped, so a slow frame can't snowball into ever more steps.
+class FixedTimestep
+{
+  public:
+    double step;
+    int maxSteps = 8;
+    // simulated seconds so far
+    double time = 0.0;
+
+    FixedTimestep(double hz = 60.0) : step(1.0 / hz)
+    {
+    }
+
+    // returns how many steps to run for frameSeconds of real time
+    int advance(double frameSeconds)
+    {
+        accumulator += frameSeconds;
+        int steps = (int)(accumulator / step);
+        if (steps > maxSteps)
+        {
+            steps = maxSteps;
+            accumulator = 0.0;
+        }
+        else
+        {
+            accumulator -= steps * step;
+        }
+        time += steps * step;
+        return steps;
+    }
+
+    float alpha() const
+    {
+        return (float)std::min(accumulator / step, 1.0);
+    }
+
+  private:
+    double accumulator = 0.0;
+};
+
+// Runs a step function at a fixed rate on its own thread. The function is called with
+// mutex held, the renderer locks it while reading the simulation state and takes alpha()
+// to interpolate from the time since the last step.
+class SimulationThread
+{
+  public:
+    std::mutex mutex;
+
+    ~SimulationThread()
+    {
+        stop();
+    }
+
+    void start(double hz, std::function<void(double)> stepFunction)
+    {
+        stop();
+        step = 1.0 / hz;
+        function = std::move(stepFunction);
+        running = true;
+        lastStep = Clock::now();
+        worker = std::thread(&SimulationThread::run, this);
+    }
+
+    void stop()
+    {
+        running = false;
+        if (worker.joinable())
+            worker.join();
+    }
+
+    // call with mutex held
+    float alpha() const
+    {
+        double since = std::chrono::duration<double>(Clock::now() - lastStep).count();
+        return (float)std::min(since / step, 1.0);
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    std::thread worker;
+    std::atomic<bool> running{false};
+    std::function<void(double)> function;
+    double step = 1.0 / 60.0;
+    Clock::time_point lastStep;
+
+    void run()
+    {
+        Clock::duration interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(step));
+        Clock::time_point next = Clock::now() + interval;
+        while (running)
+        {
+            std::this_thread::sleep_until(next);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                function(step);
+                lastStep = Clock::now();
+            }
+            next += interval;
+            // fell more than a step behind, catch up from now instead of bursting
+            if (Clock::now() > next + interval)
+                next = Clock::now() + interval;
+        }
+    }
+};
+
+#endif
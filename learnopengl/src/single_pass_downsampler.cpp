@@ -0,0 +1,200 @@
+#ifndef SINGLE_PASS_DOWNSAMPLER_H
+#define SINGLE_PASS_DOWNSAMPLER_H
+
+#include "glad/glad.h"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "shader.cpp"
+#include "shader_compiler.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+// how a texel of a level is made of the texels above it
+enum DownsampleOp
+{
+    // mip maps, and a luminance down to the 1x1 average
+    DOWNSAMPLE_AVERAGE,
+    // depth pyramids: the nearest, or the farthest with reversed-Z
+    DOWNSAMPLE_MIN,
+    DOWNSAMPLE_MAX
+};
+
+// Builds a mip chain in one compute dispatch instead of one per level, like AMD's single pass
+// downsampler. Every group of shader_src/spd.comp reduces a 64x64 tile of the source level six
+// levels down, through shared memory from the third on, and bumps a counter in a buffer; the
+// group that finds itself last reduces the texels the others wrote to the rest of the chain,
+// so the levels don't wait for each other on an empty GPU. A dispatch writes as many levels
+// as there are image units next to the source (7 on the minimum GL 4.3 limits), a longer chain
+// or a level 6 over a tile takes one more. The last texel of an odd sized level reduces the
+// row or column that has no texel of its own below too, the same as hiz_reduce.comp, so a min
+// or max chain stays conservative. R32F, RGBA8 and RGBA16F textures; the others keep
+// glGenerateMipmap, which also knows sRGB. A depth buffer can be the source of an R32F
+// chain of its own, e.g. a half resolution depth, sampled from DEPTH_UNIT.
+class SinglePassDownsampler
+{
+  public:
+    // source texels of a group's tile in both dimensions
+    static const int TILE = 64;
+    // levels a group reduces on its own
+    static constexpr int GROUP_LEVELS = 6;
+    // levels spd.comp writes at most in one dispatch
+    static constexpr int MAX_IMAGES = 12;
+    // texture unit a depth source is sampled from
+    static const unsigned int DEPTH_UNIT = 7;
+
+    explicit SinglePassDownsampler(ShaderCompiler &compiler) : compiler(compiler)
+    {
+        GLint units = 8, uniforms = 8;
+        glGetIntegerv(GL_MAX_IMAGE_UNITS, &units);
+        glGetIntegerv(GL_MAX_COMPUTE_IMAGE_UNIFORMS, &uniforms);
+        imagesPerDispatch = std::clamp(std::min(units, uniforms) - 1, 1, MAX_IMAGES);
+        uint32_t zero = 0;
+        counter = createBuffer(sizeof(zero), &zero, 0);
+    }
+
+    ~SinglePassDownsampler()
+    {
+        deleteBuffers(1, &counter);
+    }
+
+    SinglePassDownsampler(const SinglePassDownsampler &) = delete;
+    SinglePassDownsampler &operator=(const SinglePassDownsampler &) = delete;
+
+    // compute shaders and image load/store are core since 4.3
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    static bool supportsFormat(GLenum internalFormat)
+    {
+        return formatIndex(internalFormat) >= 0;
+    }
+
+    // submits the program of a format ahead of its first use, which would otherwise build it then
+    void prepare(GLenum internalFormat)
+    {
+        program(internalFormat);
+    }
+
+    // the levels below level of a texture of levelCount levels whose level 0 is width x height,
+    // made from level; layer picks one layer of an array texture
+    void generate(unsigned int texture, int width, int height, int levelCount, GLenum internalFormat,
+                  DownsampleOp op, int level = 0, int layer = 0)
+    {
+        Shader *shader = program(internalFormat);
+        if (!shader)
+            return;
+        int index = formatIndex(internalFormat);
+        shader->use();
+        // looked up here, prepare() doesn't wait for the link
+        if (!opLocs[index].valid())
+        {
+            opLocs[index] = shader->uniform("op");
+            levelsLocs[index] = shader->uniform("levels");
+        }
+        shader->set(opLocs[index], (int)op);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, counter, 0, 0);
+        while (level < levelCount - 1)
+        {
+            int w = std::max(1, width >> level), h = std::max(1, height >> level);
+            int count = std::min(imagesPerDispatch, levelCount - 1 - level);
+            // the last group would be left alone with a large level 7, the next dispatch spreads it out
+            if (std::max(w, h) >> GROUP_LEVELS > TILE)
+                count = std::min(count, GROUP_LEVELS);
+            glBindImageTexture(0, texture, level, GL_FALSE, layer, GL_READ_ONLY, internalFormat);
+            for (int i = 0; i < count; i++)
+                glBindImageTexture(1 + i, texture, level + 1 + i, GL_FALSE, layer, GL_READ_WRITE, internalFormat);
+            shader->set(levelsLocs[index], count);
+            glDispatchCompute(std::max(1, w / TILE), std::max(1, h / TILE), 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+            level += count;
+        }
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    // the levels of an R32F target from a depth texture, target level 0 being depth's level 1
+    void generateFromDepth(const Texture2D &depth, const Texture2D &target, DownsampleOp op)
+    {
+        if (!depthProgram)
+            depthProgram = &compiler.submitCompute(
+                "src/shader_src/spd.comp",
+                {"FORMAT r32f", "DEPTH_SOURCE", "MIP_IMAGES " + std::to_string(imagesPerDispatch)});
+        depthProgram->use();
+        if (!depthOpLoc.valid())
+        {
+            depthOpLoc = depthProgram->uniform("op");
+            depthLevelsLoc = depthProgram->uniform("levels");
+        }
+        int count = std::min({imagesPerDispatch, target.levels, GROUP_LEVELS});
+        depthProgram->set(depthOpLoc, (int)op);
+        depthProgram->set(depthLevelsLoc, count);
+        depth.bind(DEPTH_UNIT);
+        glState.bindSampler(DEPTH_UNIT, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, counter, 0, 0);
+        for (int i = 0; i < count; i++)
+            glBindImageTexture(1 + i, target.ID, i, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+        glDispatchCompute(std::max(1, depth.width / TILE), std::max(1, depth.height / TILE), 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        // the rest of a longer chain from the levels just written
+        if (target.levels > count + 1)
+            generate(target.ID, target.width, target.height, target.levels, GL_R32F, op, count - 1);
+    }
+
+    void generate(const Texture2D &texture, DownsampleOp op = DOWNSAMPLE_AVERAGE, int level = 0)
+    {
+        generate(texture.ID, texture.width, texture.height, texture.levels, texture.internalFormat, op, level);
+    }
+
+    // one layer, or every one when layer is negative
+    void generate(const Texture2DArray &texture, int layer = -1, DownsampleOp op = DOWNSAMPLE_AVERAGE)
+    {
+        for (int i = layer < 0 ? 0 : layer; i < (layer < 0 ? texture.layers : layer + 1); i++)
+            generate(texture.ID, texture.width, texture.height, texture.levels, texture.internalFormat, op, 0, i);
+    }
+
+  private:
+    static const int FORMATS = 3;
+
+    ShaderCompiler &compiler;
+    int imagesPerDispatch = 7;
+    unsigned int counter = 0;
+    Shader *programs[FORMATS] = {};
+    UniformHandle opLocs[FORMATS], levelsLocs[FORMATS];
+    Shader *depthProgram = NULL;
+    UniformHandle depthOpLoc, depthLevelsLoc;
+
+    static int formatIndex(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_R32F:
+            return 0;
+        case GL_RGBA8:
+            return 1;
+        case GL_RGBA16F:
+            return 2;
+        default:
+            return -1;
+        }
+    }
+
+    Shader *program(GLenum internalFormat)
+    {
+        static const char *const formats[FORMATS] = {"r32f", "rgba8", "rgba16f"};
+        int index = formatIndex(internalFormat);
+        if (index < 0)
+            return NULL;
+        if (!programs[index])
+            programs[index] = &compiler.submitCompute(
+                "src/shader_src/spd.comp",
+                {std::string("FORMAT ") + formats[index], "MIP_IMAGES " + std::to_string(imagesPerDispatch)});
+        return programs[index];
+    }
+};
+
+#endif
@@ -0,0 +1,482 @@
+#ifndef SKINNING_H
+#define SKINNING_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "gltf_loader.cpp"
+#include "job_system.cpp"
+#include "mesh.cpp"
+#include "mesh_cooker.cpp"
+#include "ring_buffer.cpp"
+#include "scene_graph.cpp"
+#include "shader.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// one played copy of a skin, where it stands and the clips it is in
+struct SkinnedInstance
+{
+    uint32_t skin;
+    // in front of the skin's own transforms
+    glm::mat4 placement = glm::mat4(1.0f);
+    // index into the scene's animations, -1 for the rest pose
+    int clip = -1;
+    float time = 0.0f;
+    // mixed in by blendWeight, each clip loops on its own time
+    int blendClip = -1;
+    float blendTime = 0.0f;
+    float blendWeight = 0.0f;
+    // seconds of clip per second
+    float speed = 1.0f;
+    // where the instance's palette starts in the frame's, set by update()
+    uint32_t firstJoint = 0;
+};
+
+// a skinned primitive of one instance
+struct SkinnedDraw
+{
+    uint32_t instance;
+    // index into the scene's draws
+    uint32_t draw;
+    // of its pre-skinned vertices in the output buffer, -1 when the vertex shader skins
+    GLintptr output;
+};
+
+// Skeletal animation of the skins of a GltfScene. Every frame update()
+// - samples the clips of each instance and blends them on the job system, a range of
+//   instances per job: the joints' translation, rotation and scale, their matrices from the
+//   parents down, then per joint placement * joint world * inverse bind matrix,
+// - pushes the palettes of all instances into the frame's RingBuffer region as one block
+//   bound as one storage buffer range, so a draw only sets the firstJoint of its instance
+//   (skinning.glsl),
+// - with preSkinning, runs skin.comp once per skinned primitive of every instance, which
+//   writes world space positions and normals into one shared vertex buffer: whatever pass
+//   draws the primitive afterwards reads them through bindPreSkinned() like a rigid mesh
+//   instead of skinning every vertex again (skinned.vs does it in each pass otherwise).
+// The joints are played on a copy per instance, the scene's hierarchy keeps its rest pose;
+// nodes between two joints that aren't joints themselves are never animated.
+// Needs GL 4.3 for the storage blocks in the vertex stage and the compute pass.
+class SkinningSystem
+{
+  public:
+    // shader storage bindings, the same as in skinning.glsl and skin.comp; 8 and 9 are the
+    // vertex puller's, which binds its own before each of its draws
+    static const unsigned int PALETTE_BINDING = 0;
+    static const unsigned int SOURCE_BINDING = 8;
+    static const unsigned int OUTPUT_BINDING = 9;
+    // local_size_x of skin.comp
+    static const unsigned int GROUP_SIZE = 64;
+    // instances sampled per job
+    static const size_t JOB_GRAIN = 16;
+    // a float position and a packed normal per pre-skinned vertex
+    static const size_t OUTPUT_STRIDE = 16;
+
+    bool preSkinning = false;
+    std::vector<SkinnedInstance> instances;
+    // of the last update(), one per skinned primitive of every instance, instance by instance
+    std::vector<SkinnedDraw> draws;
+    // palette bytes pushed and vertices pre-skinned by the last update()
+    size_t paletteBytes = 0;
+    size_t skinnedVertices = 0;
+
+    static bool isSupported()
+    {
+        if (!GLAD_GL_VERSION_4_3)
+            return false;
+        GLint blocks = 0;
+        glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &blocks);
+        return blocks >= 1;
+    }
+
+    // skinProgram is skin.comp, only used with preSkinning
+    SkinningSystem(const GltfScene &scene, RingBuffer &ring, Shader &skinProgram)
+        : scene(scene), ring(ring), skinShader(skinProgram)
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        outputAlignment = (size_t)std::max(alignment, (GLint)OUTPUT_STRIDE);
+        vertexCountLoc = skinShader.uniform("vertexCount");
+        firstJointLoc = skinShader.uniform("firstJoint");
+        boundsCenterLoc = skinShader.uniform("boundsCenter");
+        boundsExtentLoc = skinShader.uniform("boundsExtent");
+    }
+
+    ~SkinningSystem()
+    {
+        for (const auto &entry : vertexArrays)
+            glDeleteVertexArrays(1, &entry.second);
+        if (output)
+            deleteBuffers(1, &output);
+    }
+
+    SkinningSystem(const SkinningSystem &) = delete;
+    SkinningSystem &operator=(const SkinningSystem &) = delete;
+
+    bool ready() const
+    {
+        return built;
+    }
+
+    // once the scene has finished loading: the skeletons and which joint each channel moves
+    void build()
+    {
+        built = true;
+        skeletons.assign(scene.skins.size(), Skeleton());
+        skinDraws.assign(scene.skins.size(), std::vector<uint32_t>());
+        handled.assign(scene.draws.size(), 0);
+        for (size_t s = 0; s < scene.skins.size(); s++)
+        {
+            const GltfSkin &skin = scene.skins[s];
+            Skeleton &skeleton = skeletons[s];
+            std::unordered_map<uint32_t, int> jointOf;
+            for (size_t j = 0; j < skin.joints.size(); j++)
+                jointOf[skin.joints[j]] = (int)j;
+
+            std::vector<uint32_t> depths(skin.joints.size(), 0);
+            for (size_t j = 0; j < skin.joints.size(); j++)
+            {
+                uint32_t node = skin.joints[j];
+                GltfNodePose rest = {SceneGraph::NO_PARENT, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                                     glm::vec3(1.0f)};
+                int parent = -1;
+                glm::mat4 base(1.0f);
+                if (node < scene.poses.size())
+                {
+                    rest = scene.poses[node];
+                    // up to the nearest joint, or to the root through the nodes in between
+                    for (uint32_t above = rest.parent; above != SceneGraph::NO_PARENT;
+                         above = scene.poses[above].parent)
+                    {
+                        depths[j]++;
+                        auto found = jointOf.find(above);
+                        if (parent < 0 && found != jointOf.end())
+                            parent = found->second;
+                        else if (parent < 0)
+                            base = scene.hierarchy.local(above) * base;
+                    }
+                }
+                skeleton.rest.push_back(rest);
+                skeleton.parents.push_back(parent);
+                skeleton.bases.push_back(base);
+                skeleton.order.push_back((uint32_t)j);
+            }
+            std::stable_sort(skeleton.order.begin(), skeleton.order.end(),
+                             [&](uint32_t a, uint32_t b) { return depths[a] < depths[b]; });
+
+            skeleton.clips.resize(scene.animations.size());
+            for (size_t a = 0; a < scene.animations.size(); a++)
+            {
+                for (const GltfChannel &channel : scene.animations[a].channels)
+                {
+                    auto found = jointOf.find(channel.node);
+                    if (found != jointOf.end() && !channel.times.empty())
+                        skeleton.clips[a].push_back({&channel, (uint32_t)found->second});
+                }
+            }
+        }
+
+        // only the primitives that did load with joints and weights
+        for (size_t d = 0; d < scene.draws.size(); d++)
+        {
+            const GltfDraw &draw = scene.draws[d];
+            const Mesh *mesh = scene.mesh(draw.primitive);
+            if (draw.skin < 0 || !mesh || !(mesh->layout == skinnedMeshLayout()))
+                continue;
+            handled[d] = 1;
+            skinDraws[draw.skin].push_back((uint32_t)d);
+        }
+    }
+
+    // the draw is skinned by this system, the rigid path leaves it out
+    bool handles(size_t draw) const
+    {
+        return draw < handled.size() && handled[draw];
+    }
+
+    // the primitives of skin this system deforms, indices into the scene's draws
+    const std::vector<uint32_t> &drawsOf(uint32_t skin) const
+    {
+        return skinDraws[skin];
+    }
+
+    // the palette of skin in its own space playing clip (-1 for the rest pose) at time, as many
+    // matrices as it has joints, e.g. to bake it (see vertex_animation.cpp)
+    void pose(uint32_t skin, int clip, float time, glm::mat4 *palette) const
+    {
+        SkinnedInstance instance;
+        instance.skin = skin;
+        instance.clip = clip;
+        instance.time = time;
+        Scratch scratch;
+        evaluate(instance, palette, scratch);
+    }
+
+    // count copies of every skin in rows of 16 along x, far enough apart not to overlap, each
+    // starting its clip at its own time and blending towards the next clip
+    void addInstances(unsigned int count)
+    {
+        glm::vec3 extent(0.0f);
+        for (size_t d = 0; d < scene.draws.size(); d++)
+        {
+            if (handles(d))
+                extent = glm::max(extent, scene.mesh(scene.draws[d].primitive)->boundsExtent);
+        }
+        float spacing = std::max(2.5f * std::max(extent.x, extent.z), 0.5f);
+        int clips = (int)scene.animations.size();
+        for (uint32_t s = 0; s < scene.skins.size(); s++)
+        {
+            if (skinDraws[s].empty())
+                continue;
+            for (unsigned int i = 0; i < count; i++)
+            {
+                SkinnedInstance instance;
+                instance.skin = s;
+                float column = (float)(i % 16) - (std::min(count, 16u) - 1) * 0.5f;
+                instance.placement =
+                    glm::translate(glm::mat4(1.0f), glm::vec3(column * spacing, 0.0f, -(float)(i / 16) * spacing));
+                if (clips > 0)
+                {
+                    instance.clip = (int)(i % clips);
+                    instance.time = instance.blendTime = i * 0.37f;
+                }
+                if (clips > 1)
+                    instance.blendClip = (int)((i + 1) % clips);
+                instances.push_back(instance);
+            }
+        }
+    }
+
+    // advances the clips by deltaTime, samples and uploads the palettes and pre-skins
+    void update(float deltaTime, JobSystem &jobs)
+    {
+        draws.clear();
+        paletteBytes = skinnedVertices = 0;
+        if (instances.empty())
+            return;
+        uint32_t jointCount = 0;
+        for (SkinnedInstance &instance : instances)
+        {
+            instance.firstJoint = jointCount;
+            jointCount += (uint32_t)scene.skins[instance.skin].joints.size();
+            instance.time = advance(instance.clip, instance.time, deltaTime * instance.speed);
+            instance.blendTime = advance(instance.blendClip, instance.blendTime, deltaTime * instance.speed);
+        }
+        palettes.resize(jointCount);
+        jobs.parallelFor(0, instances.size(), JOB_GRAIN, [this](size_t first, size_t last) {
+            Scratch scratch;
+            for (size_t i = first; i < last; i++)
+                evaluate(instances[i], &palettes[instances[i].firstJoint], scratch);
+        });
+
+        size_t bytes = palettes.size() * sizeof(glm::mat4);
+        GLintptr offset = ring.push(palettes.data(), bytes, ring.storageAlignment);
+        if (offset < 0)
+            return;
+        paletteBytes = bytes;
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, PALETTE_BINDING, ring.ID, offset, (GLsizeiptr)bytes);
+
+        for (uint32_t i = 0; i < instances.size(); i++)
+        {
+            for (uint32_t d : skinDraws[instances[i].skin])
+                draws.push_back({i, d, -1});
+        }
+        if (preSkinning)
+            preSkin();
+    }
+
+    // binds the pre-skinned vertices of draw with the primitive's texcoords and indices, to be
+    // drawn like a rigid mesh in world space, i.e. with an identity model and no quantization
+    void bindPreSkinned(const SkinnedDraw &draw, const Mesh &mesh)
+    {
+        size_t primitive = scene.draws[draw.draw].primitive;
+        auto found = vertexArrays.find(primitive);
+        if (found == vertexArrays.end())
+        {
+            // vertex buffer bindings of GL 4.3, which the compute pass needs anyway: 0 for the
+            // primitive's own vertices, 1 for the skinned ones
+            unsigned int vertexArray = createVertexArray();
+            glState.bindVertexArray(vertexArray);
+            glBindVertexBuffer(0, mesh.VBO, 0, (GLsizei)mesh.layout.stride);
+            glVertexAttribFormat(1, 2, GL_HALF_FLOAT, GL_FALSE, (GLuint)SkinnedVertex::offsetOf<UV2h>());
+            glVertexAttribBinding(1, 0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, 0);
+            glVertexAttribBinding(0, 1);
+            glEnableVertexAttribArray(0);
+            glVertexAttribFormat(7, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 12);
+            glVertexAttribBinding(7, 1);
+            glEnableVertexAttribArray(7);
+            setElementBuffer(vertexArray, mesh.EBO);
+            found = vertexArrays.emplace(primitive, vertexArray).first;
+        }
+        glState.bindVertexArray(found->second);
+        glBindVertexBuffer(1, output, draw.output, (GLsizei)OUTPUT_STRIDE);
+    }
+
+  private:
+    // a channel and the joint of the skin it moves
+    struct Target
+    {
+        const GltfChannel *channel;
+        uint32_t joint;
+    };
+    struct Skeleton
+    {
+        std::vector<GltfNodePose> rest;
+        // the parent joint in the skin, -1 when there is none above
+        std::vector<int> parents;
+        // the rest transforms between the parent joint (or the root) and the joint
+        std::vector<glm::mat4> bases;
+        // the joints with every parent before its children
+        std::vector<uint32_t> order;
+        // per animation, what it moves of this skin
+        std::vector<std::vector<Target>> clips;
+    };
+    // per job, so the jobs don't allocate per instance
+    struct Scratch
+    {
+        std::vector<GltfNodePose> pose, blend;
+        std::vector<glm::mat4> world;
+    };
+
+    const GltfScene &scene;
+    RingBuffer &ring;
+    Shader &skinShader;
+    UniformHandle vertexCountLoc, firstJointLoc, boundsCenterLoc, boundsExtentLoc;
+    bool built = false;
+    std::vector<Skeleton> skeletons;
+    // per skin the scene draws it deforms
+    std::vector<std::vector<uint32_t>> skinDraws;
+    std::vector<unsigned char> handled;
+    std::vector<glm::mat4> palettes;
+    // the shared pre-skinned vertices
+    unsigned int output = 0;
+    size_t outputCapacity = 0;
+    size_t outputAlignment = 256;
+    std::unordered_map<size_t, unsigned int> vertexArrays;
+
+    float advance(int clip, float time, float step) const
+    {
+        if (clip < 0 || clip >= (int)scene.animations.size())
+            return time;
+        float duration = scene.animations[clip].duration;
+        return duration > 0.0f ? std::fmod(time + step, duration) : 0.0f;
+    }
+
+    static glm::vec4 sample(const GltfChannel &channel, float time)
+    {
+        const std::vector<float> &times = channel.times;
+        if (time <= times.front())
+            return channel.values.front();
+        if (time >= times.back())
+            return channel.values.back();
+        size_t next = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+        size_t key = next - 1;
+        const glm::vec4 &a = channel.values[key], &b = channel.values[next];
+        if (channel.step)
+            return a;
+        float t = (time - times[key]) / (times[next] - times[key]);
+        if (channel.path != GLTF_ROTATION)
+            return glm::mix(a, b, t);
+        glm::quat rotation = glm::slerp(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), t);
+        return glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+    }
+
+    // the channels of clip at time over the rest pose in pose
+    void apply(const Skeleton &skeleton, int clip, float time, std::vector<GltfNodePose> &pose) const
+    {
+        pose.assign(skeleton.rest.begin(), skeleton.rest.end());
+        if (clip < 0 || clip >= (int)skeleton.clips.size())
+            return;
+        for (const Target &target : skeleton.clips[clip])
+        {
+            glm::vec4 value = sample(*target.channel, time);
+            GltfNodePose &joint = pose[target.joint];
+            if (target.channel->path == GLTF_TRANSLATION)
+                joint.translation = glm::vec3(value);
+            else if (target.channel->path == GLTF_ROTATION)
+                joint.rotation = glm::normalize(glm::quat(value.w, value.x, value.y, value.z));
+            else
+                joint.scale = glm::vec3(value);
+        }
+    }
+
+    // job: the palette of one instance
+    void evaluate(const SkinnedInstance &instance, glm::mat4 *palette, Scratch &scratch) const
+    {
+        const Skeleton &skeleton = skeletons[instance.skin];
+        const GltfSkin &skin = scene.skins[instance.skin];
+        apply(skeleton, instance.clip, instance.time, scratch.pose);
+        if (instance.blendClip >= 0 && instance.blendWeight > 0.0f)
+        {
+            apply(skeleton, instance.blendClip, instance.blendTime, scratch.blend);
+            float weight = std::min(instance.blendWeight, 1.0f);
+            for (size_t j = 0; j < scratch.pose.size(); j++)
+            {
+                GltfNodePose &joint = scratch.pose[j];
+                const GltfNodePose &other = scratch.blend[j];
+                joint.translation = glm::mix(joint.translation, other.translation, weight);
+                joint.rotation = glm::slerp(joint.rotation, other.rotation, weight);
+                joint.scale = glm::mix(joint.scale, other.scale, weight);
+            }
+        }
+        scratch.world.resize(scratch.pose.size());
+        for (uint32_t j : skeleton.order)
+        {
+            const GltfNodePose &joint = scratch.pose[j];
+            glm::mat4 local = glm::translate(glm::mat4(1.0f), joint.translation) * glm::mat4_cast(joint.rotation);
+            local = glm::scale(local, joint.scale);
+            int parent = skeleton.parents[j];
+            scratch.world[j] = (parent >= 0 ? scratch.world[parent] * skeleton.bases[j] : skeleton.bases[j]) * local;
+            palette[j] = instance.placement * scratch.world[j] * skin.inverseBindMatrices[j];
+        }
+    }
+
+    // skin.comp over every draw into its own range of the output buffer
+    void preSkin()
+    {
+        size_t needed = 0;
+        for (SkinnedDraw &draw : draws)
+        {
+            const Mesh &mesh = *scene.mesh(scene.draws[draw.draw].primitive);
+            draw.output = (GLintptr)needed;
+            size_t bytes = mesh.vertexBytes / mesh.layout.stride * OUTPUT_STRIDE;
+            needed += (bytes + outputAlignment - 1) / outputAlignment * outputAlignment;
+        }
+        if (needed > outputCapacity)
+        {
+            if (output)
+                deleteBuffers(1, &output);
+            outputCapacity = needed + needed / 2;
+            output = createBuffer(outputCapacity, NULL, 0, GL_STATIC_DRAW, GPU_MEMORY_GEOMETRY);
+        }
+
+        skinShader.use();
+        for (const SkinnedDraw &draw : draws)
+        {
+            const Mesh &mesh = *scene.mesh(scene.draws[draw.draw].primitive);
+            uint32_t vertexCount = (uint32_t)(mesh.vertexBytes / mesh.layout.stride);
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, SOURCE_BINDING, mesh.VBO, 0, 0);
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, OUTPUT_BINDING, output, draw.output,
+                                    (GLsizeiptr)(vertexCount * OUTPUT_STRIDE));
+            skinShader.set(vertexCountLoc, vertexCount);
+            skinShader.set(firstJointLoc, instances[draw.instance].firstJoint);
+            skinShader.set(boundsCenterLoc, mesh.boundsCenter);
+            skinShader.set(boundsExtentLoc, mesh.boundsExtent);
+            glDispatchCompute((vertexCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+            skinnedVertices += vertexCount;
+        }
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+};
+
+#endif
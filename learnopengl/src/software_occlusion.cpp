@@ -0,0 +1,308 @@
+#ifndef SOFTWARE_OCCLUSION_H
+#define SOFTWARE_OCCLUSION_H
+
+#include "glm/glm.hpp"
+
+#include "frustum_culler.cpp"
+#include "job_system.cpp"
+#include "simd_math.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A small depth buffer filled on the CPU with the boxes of the largest visible objects, then
+// used to drop the visible objects that are behind them before their draws are submitted.
+// Depth is stored as 1 / w, larger is nearer and 0 (the clear value) is nothing at all, so
+// the reversed and the regular projections rasterize the same. rasterize() runs one job per
+// row of TILE x TILE tiles: a band clears its rows, fills every triangle's span in them 8
+// pixels at a time with AVX (4 with SSE2) and keeps each tile's farthest depth. An occludee's
+// bounding sphere is hidden when its nearest depth is behind the farthest occluder depth of
+// every tile its screen rectangle touches, so a tile only hides anything once it is covered.
+class SoftwareOcclusion
+{
+  public:
+    static const int WIDTH = 256;
+    static const int HEIGHT = 144;
+    static const int TILE = 8;
+    static const int TILES_X = WIDTH / TILE;
+    static const int TILES_Y = HEIGHT / TILE;
+    // occluders rasterized per frame, the ones covering most of the view
+    static const size_t MAX_OCCLUDERS = 128;
+
+    // counters of the last frame
+    size_t occluders = 0;
+    size_t triangleCount = 0;
+    size_t tested = 0;
+    size_t culled = 0;
+
+    SoftwareOcclusion() : depth(WIDTH * HEIGHT), tiles(TILES_X * TILES_Y)
+    {
+    }
+
+    // starts a frame seen through viewProjection, no occluders yet
+    void begin(const glm::mat4 &viewProjection)
+    {
+        this->viewProjection = viewProjection;
+        wRow = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+        triangles.clear();
+        occluders = 0;
+        triangleCount = 0;
+        tested = 0;
+        culled = 0;
+    }
+
+    // the visible spheres of culler with the largest radius over distance from eye, at most MAX_OCCLUDERS
+    const std::vector<uint32_t> &chooseOccluders(const FrustumCuller &culler, const std::vector<uint32_t> &visible,
+                                                 const glm::vec3 &eye)
+    {
+        chosen.assign(visible.begin(), visible.end());
+        auto score = [&](uint32_t i) {
+            glm::vec3 offset = glm::vec3(culler.centerX[i], culler.centerY[i], culler.centerZ[i]) - eye;
+            return culler.radius[i] * culler.radius[i] / std::max(glm::dot(offset, offset), 1e-6f);
+        };
+        if (chosen.size() > MAX_OCCLUDERS)
+        {
+            std::nth_element(chosen.begin(), chosen.begin() + MAX_OCCLUDERS, chosen.end(),
+                             [&](uint32_t a, uint32_t b) { return score(a) > score(b); });
+            chosen.resize(MAX_OCCLUDERS);
+        }
+        return chosen;
+    }
+
+    // the box center +- extent placed by model, left out when it crosses the near plane
+    void addBox(const glm::mat4 &model, const glm::vec3 &center, const glm::vec3 &extent)
+    {
+        static const uint8_t BOX_TRIANGLES[36] = {0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1,
+                                                  2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3};
+        glm::mat4 toClip = viewProjection * model;
+        glm::vec3 screen[8];
+        for (int c = 0; c < 8; c++)
+        {
+            glm::vec3 sign((c & 4) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 1) ? 1.0f : -1.0f);
+            glm::vec4 clip = toClip * glm::vec4(center + extent * sign, 1.0f);
+            if (clip.w < NEAREST_W)
+                return;
+            screen[c] = toScreen(clip);
+        }
+        // both windings are kept, the back faces cover the same pixels a little farther away
+        for (int t = 0; t < 36; t += 3)
+            setup(screen[BOX_TRIANGLES[t]], screen[BOX_TRIANGLES[t + 1]], screen[BOX_TRIANGLES[t + 2]]);
+        occluders++;
+    }
+
+    // fills the depth buffer and its tiles with every triangle added since begin()
+    void rasterize(JobSystem &jobs)
+    {
+        triangleCount = triangles.size();
+        jobs.parallelFor(0, TILES_Y, 1, [&](size_t first, size_t last) {
+            for (size_t row = first; row < last; row++)
+                rasterizeBand((int)row);
+        });
+    }
+
+    // false when the sphere is behind the occluders over all of its screen rectangle
+    bool visible(const glm::vec3 &center, float radius) const
+    {
+        // w is the view depth, nearest where the sphere reaches toward the eye
+        glm::vec3 wAxis(wRow);
+        float nearestW = glm::dot(wAxis, center) + wRow.w - radius * glm::length(wAxis);
+        if (nearestW < NEAREST_W)
+            return true;
+        float nearest = 1.0f / nearestW;
+
+        // the box around the sphere on screen, every corner in front of the eye by the test above
+        float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+        for (int c = 0; c < 8; c++)
+        {
+            glm::vec3 sign((c & 4) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 1) ? 1.0f : -1.0f);
+            glm::vec4 clip = viewProjection * glm::vec4(center + sign * radius, 1.0f);
+            if (clip.w < NEAREST_W)
+                return true;
+            glm::vec3 p = toScreen(clip);
+            minX = std::min(minX, p.x);
+            minY = std::min(minY, p.y);
+            maxX = std::max(maxX, p.x);
+            maxY = std::max(maxY, p.y);
+        }
+        if (minX < -1e6f || minY < -1e6f || maxX > 1e6f || maxY > 1e6f)
+            return true;
+        // a pixel wider on every side, the occluders cover whole pixels by their centers
+        int tileX0 = std::max((int)std::floor(minX - 1.0f), 0) / TILE;
+        int tileY0 = std::max((int)std::floor(minY - 1.0f), 0) / TILE;
+        int tileX1 = std::min((int)std::ceil(maxX + 1.0f), WIDTH - 1) / TILE;
+        int tileY1 = std::min((int)std::ceil(maxY + 1.0f), HEIGHT - 1) / TILE;
+        if (tileX0 > tileX1 || tileY0 > tileY1)
+            return true;
+        for (int y = tileY0; y <= tileY1; y++)
+            for (int x = tileX0; x <= tileX1; x++)
+                if (nearest >= tiles[y * TILES_X + x])
+                    return true;
+        return false;
+    }
+
+    // drops the hidden spheres of culler from indices, the rest keep their order
+    void cull(JobSystem &jobs, const FrustumCuller &culler, std::vector<uint32_t> &indices)
+    {
+        tested = indices.size();
+        hidden.assign(indices.size(), 0);
+        if (triangleCount)
+            jobs.parallelFor(0, indices.size(), JOB_GRAIN, [&](size_t first, size_t last) {
+                for (size_t n = first; n < last; n++)
+                {
+                    uint32_t i = indices[n];
+                    glm::vec3 center(culler.centerX[i], culler.centerY[i], culler.centerZ[i]);
+                    hidden[n] = !visible(center, culler.radius[i]);
+                }
+            });
+        size_t kept = 0;
+        for (size_t n = 0; n < indices.size(); n++)
+            if (!hidden[n])
+                indices[kept++] = indices[n];
+        culled = indices.size() - kept;
+        indices.resize(kept);
+    }
+
+  private:
+    // ranges of the parallel occludee test
+    static const size_t JOB_GRAIN = 1024;
+    // nearer than this in w is treated as crossing the near plane
+    static constexpr float NEAREST_W = 1e-3f;
+
+    // three edge functions a * x + b * y + c, all >= 0 inside, and the depth plane over the screen
+    struct Triangle
+    {
+        float a[3], b[3], c[3];
+        float depthA, depthB, depthC;
+        int minX, minY, maxX, maxY;
+    };
+
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    // the row of viewProjection that gives clip w
+    glm::vec4 wRow = glm::vec4(0.0f);
+    std::vector<float> depth;
+    // the farthest depth of each tile
+    std::vector<float> tiles;
+    std::vector<Triangle> triangles;
+    std::vector<uint32_t> chosen;
+    std::vector<uint8_t> hidden;
+
+    // pixels with y up as in GL window space, and 1 / w
+    static glm::vec3 toScreen(const glm::vec4 &clip)
+    {
+        float inverseW = 1.0f / clip.w;
+        return glm::vec3((clip.x * inverseW * 0.5f + 0.5f) * WIDTH, (clip.y * inverseW * 0.5f + 0.5f) * HEIGHT,
+                         inverseW);
+    }
+
+    void setup(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2)
+    {
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (std::abs(area) < 1e-6f)
+            return;
+        if (area < 0.0f)
+        {
+            std::swap(v1, v2);
+            area = -area;
+        }
+        Triangle t;
+        t.minX = std::max((int)std::floor(std::min({v0.x, v1.x, v2.x})), 0);
+        t.minY = std::max((int)std::floor(std::min({v0.y, v1.y, v2.y})), 0);
+        t.maxX = std::min((int)std::ceil(std::max({v0.x, v1.x, v2.x})), WIDTH - 1);
+        t.maxY = std::min((int)std::ceil(std::max({v0.y, v1.y, v2.y})), HEIGHT - 1);
+        if (t.minX > t.maxX || t.minY > t.maxY)
+            return;
+        // edge e is the one across from vertex e, its function is that vertex's weight times area
+        const glm::vec3 *from[3] = {&v1, &v2, &v0}, *to[3] = {&v2, &v0, &v1};
+        for (int e = 0; e < 3; e++)
+        {
+            t.a[e] = from[e]->y - to[e]->y;
+            t.b[e] = to[e]->x - from[e]->x;
+            t.c[e] = -(t.a[e] * from[e]->x + t.b[e] * from[e]->y);
+        }
+        float inverseArea = 1.0f / area;
+        t.depthA = (t.a[0] * v0.z + t.a[1] * v1.z + t.a[2] * v2.z) * inverseArea;
+        t.depthB = (t.b[0] * v0.z + t.b[1] * v1.z + t.b[2] * v2.z) * inverseArea;
+        t.depthC = (t.c[0] * v0.z + t.c[1] * v1.z + t.c[2] * v2.z) * inverseArea;
+        triangles.push_back(t);
+    }
+
+    // rows [band * TILE, band * TILE + TILE) of the depth buffer, then their row of tiles
+    void rasterizeBand(int band)
+    {
+        const int firstRow = band * TILE, lastRow = firstRow + TILE - 1;
+        std::fill(depth.begin() + firstRow * WIDTH, depth.begin() + (lastRow + 1) * WIDTH, 0.0f);
+        for (const Triangle &t : triangles)
+        {
+            if (t.maxY < firstRow || t.minY > lastRow)
+                continue;
+            int y0 = std::max(t.minY, firstRow), y1 = std::min(t.maxY, lastRow);
+            for (int y = y0; y <= y1; y++)
+                fillSpan(t, y, &depth[y * WIDTH]);
+        }
+        for (int tileX = 0; tileX < TILES_X; tileX++)
+        {
+            float farthest = 1e30f;
+            for (int y = firstRow; y <= lastRow; y++)
+                for (int x = tileX * TILE; x < tileX * TILE + TILE; x++)
+                    farthest = std::min(farthest, depth[y * WIDTH + x]);
+            tiles[band * TILES_X + tileX] = farthest;
+        }
+    }
+
+    // the pixels of row y inside t, sampled at their centers, keep the nearest depth
+    static void fillSpan(const Triangle &t, int y, float *row)
+    {
+        const float py = y + 0.5f;
+        float rowC[3];
+        for (int e = 0; e < 3; e++)
+            rowC[e] = t.b[e] * py + t.c[e];
+        const float rowDepth = t.depthB * py + t.depthC;
+#if SIMD_AVX
+        // 8 pixels a step from a multiple of 8, WIDTH is one too
+        const __m256 lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 zero = _mm256_setzero_ps();
+        for (int x = t.minX & ~7; x <= t.maxX; x += 8)
+        {
+            __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), lane);
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int e = 0; e < 3; e++)
+            {
+                __m256 edge = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(t.a[e]), px), _mm256_set1_ps(rowC[e]));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(edge, zero, _CMP_GE_OQ));
+            }
+            __m256 z = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(t.depthA), px), _mm256_set1_ps(rowDepth));
+            __m256 old = _mm256_loadu_ps(row + x);
+            _mm256_storeu_ps(row + x, _mm256_blendv_ps(old, _mm256_max_ps(old, z), inside));
+        }
+#elif SIMD_SSE2
+        const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+        for (int x = t.minX & ~3; x <= t.maxX; x += 4)
+        {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int e = 0; e < 3; e++)
+            {
+                __m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.a[e]), px), _mm_set1_ps(rowC[e]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+            }
+            __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.depthA), px), _mm_set1_ps(rowDepth));
+            __m128 old = _mm_loadu_ps(row + x);
+            __m128 nearer = _mm_max_ps(old, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+        }
+#else
+        for (int x = t.minX; x <= t.maxX; x++)
+        {
+            float px = x + 0.5f;
+            if (t.a[0] * px + rowC[0] >= 0.0f && t.a[1] * px + rowC[1] >= 0.0f && t.a[2] * px + rowC[2] >= 0.0f)
+                row[x] = std::max(row[x], t.depthA * px + rowDepth);
+        }
+#endif
+    }
+};
+
+#endif
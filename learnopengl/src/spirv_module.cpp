@@ -0,0 +1,101 @@
+#ifndef SPIRV_MODULE_H
+#define SPIRV_MODULE_H
+
+#include "shader_source.cpp"
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A SPIR-V module written by the --spirv cooker (see shader_cooker.cpp), read like a shader
+// source (pack, prefetch or mapping) and handed to glShaderBinary as it is.
+// GL_ARB_gl_spirv programs can't be asked for uniforms by name, so the names are taken from
+// the module itself: every uniform outside a block needs an explicit location and the
+// OpName of its variable gives the name that goes with it.
+class SpirvModule
+{
+  public:
+    static const uint32_t MAGIC = 0x07230203;
+
+    bool load(const std::string &path)
+    {
+        if (!source.load(path))
+            return false;
+        if (source.length() < 20 || source.length() % 4 != 0 || word(0) != MAGIC)
+        {
+            std::cout << "ERROR::SPIRV::INVALID_MODULE: " << path << '\n';
+            source.clear();
+            return false;
+        }
+        return true;
+    }
+
+    const void *data() const
+    {
+        return source.data();
+    }
+
+    int size() const
+    {
+        return source.length();
+    }
+
+    // name and location of every uniform with a location decoration, blocks and opaque
+    // types bound by binding = n aren't in here
+    std::vector<std::pair<std::string, int>> uniformLocations() const
+    {
+        // SpvOpName, SpvOpDecorate, SpvOpVariable, SpvDecorationLocation, SpvStorageClassUniformConstant
+        const uint32_t OP_NAME = 5, OP_DECORATE = 71, OP_VARIABLE = 59, LOCATION = 30, UNIFORM_CONSTANT = 0;
+        std::map<uint32_t, std::string> names;
+        std::map<uint32_t, int> locations;
+        std::vector<uint32_t> uniforms;
+        size_t count = (size_t)source.length() / 4;
+        // the header is 5 words, each instruction starts with its word count and opcode
+        for (size_t at = 5; at < count;)
+        {
+            uint32_t words = word(at) >> 16, opcode = word(at) & 0xFFFF;
+            if (words == 0 || at + words > count)
+                break;
+            if (opcode == OP_NAME && words > 2)
+            {
+                const char *text = source.data() + (at + 2) * 4;
+                names[word(at + 1)] = std::string(text, strnlen(text, (words - 2) * 4));
+            }
+            else if (opcode == OP_DECORATE && words > 3 && word(at + 2) == LOCATION)
+            {
+                locations[word(at + 1)] = (int)word(at + 3);
+            }
+            else if (opcode == OP_VARIABLE && words > 3 && word(at + 3) == UNIFORM_CONSTANT)
+            {
+                uniforms.push_back(word(at + 2));
+            }
+            at += words;
+        }
+
+        std::vector<std::pair<std::string, int>> result;
+        for (uint32_t id : uniforms)
+        {
+            auto location = locations.find(id);
+            auto name = names.find(id);
+            if (location != locations.end() && name != names.end())
+                result.push_back(std::make_pair(name->second, location->second));
+        }
+        return result;
+    }
+
+  private:
+    ShaderSource source;
+
+    // entries of the pack are not word aligned
+    uint32_t word(size_t index) const
+    {
+        uint32_t value;
+        std::memcpy(&value, source.data() + index * 4, 4);
+        return value;
+    }
+};
+
+#endif
@@ -0,0 +1,282 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include "glad/glad.h"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "render_stats.cpp"
+#include "ring_buffer.cpp"
+#include "shader.cpp"
+#include "texture.cpp"
+#include "texture_atlas.cpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Textured, tinted and rotated quads in window pixels, origin top left, for UI and 2D
+// sprites in the tens of thousands. Every sprite is one instance of a 4 vertex strip whose
+// corners sprite.vs makes from gl_VertexID, so a sprite costs 40 bytes of the frame's
+// RingBuffer region and no index buffer. end() orders the sprites by layer, then by
+// texture (sprites of one atlas page share it) with a counting sort that keeps the order
+// they were added in within each run, writes them to the ring in that order and draws each
+// run with one glDrawArraysInstanced: the draw count is the number of distinct layer and
+// texture pairs, not of sprites. Sprites of different textures in the same layer are not
+// kept in submission order, put overlapping ones in different layers.
+class SpriteBatch
+{
+  public:
+    static const unsigned int TEXTURE_UNIT = 7;
+    // textures per begin()/end(), the batch draws what it has early when one more comes
+    static const unsigned int MAX_TEXTURES = 256;
+    static const int MAX_LAYERS = 256;
+
+    struct Instance
+    {
+        float x, y, width, height;
+        // uvRect of an AtlasRegion, or 0 0 1 1 for a whole texture
+        float u, v, uvWidth, uvHeight;
+        uint32_t color;
+        // radians, clockwise on screen around the sprite's center
+        float rotation;
+    };
+    static_assert(sizeof(Instance) == 40, "Instance must match the attribute formats");
+
+    // draw calls and sprites since begin()
+    size_t draws = 0;
+    size_t drawn = 0;
+
+    SpriteBatch(Shader &program, RingBuffer &ring)
+        : program(program), ring(ring), sampler(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE),
+          white(1, 1, GL_RGBA8, 1)
+    {
+        const uint32_t texel = 0xFFFFFFFFu;
+        white.upload(0, GL_RGBA, GL_UNSIGNED_BYTE, &texel);
+
+        VAO = createVertexArray();
+        if (hasDSA())
+        {
+            glVertexArrayAttribFormat(VAO, 0, 4, GL_FLOAT, GL_FALSE, 0);
+            glVertexArrayAttribFormat(VAO, 1, 4, GL_FLOAT, GL_FALSE, offsetof(Instance, u));
+            glVertexArrayAttribFormat(VAO, 2, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Instance, color));
+            glVertexArrayAttribFormat(VAO, 3, 1, GL_FLOAT, GL_FALSE, offsetof(Instance, rotation));
+            for (unsigned int location = 0; location < 4; location++)
+            {
+                glVertexArrayAttribBinding(VAO, location, 0);
+                glEnableVertexArrayAttrib(VAO, location);
+            }
+            glVertexArrayBindingDivisor(VAO, 0, 1);
+        }
+        else
+        {
+            glState.bindVertexArray(VAO);
+            for (unsigned int location = 0; location < 4; location++)
+            {
+                glEnableVertexAttribArray(location);
+                glVertexAttribDivisor(location, 1);
+            }
+        }
+
+        program.use();
+        program.setInt("sprites", TEXTURE_UNIT);
+        screenSizeLoc = program.uniform("screenSize");
+        counts.resize(MAX_LAYERS * MAX_TEXTURES);
+    }
+
+    ~SpriteBatch()
+    {
+        glDeleteVertexArrays(1, &VAO);
+    }
+
+    SpriteBatch(const SpriteBatch &) = delete;
+    SpriteBatch &operator=(const SpriteBatch &) = delete;
+
+    static uint32_t rgba(int r, int g, int b, int a = 255)
+    {
+        return (uint32_t)r | (uint32_t)g << 8 | (uint32_t)b << 16 | (uint32_t)a << 24;
+    }
+
+    // ring bytes a frame of count sprites takes, for sizing the RingBuffer
+    static size_t bytesFor(size_t count)
+    {
+        return count * sizeof(Instance) + 16;
+    }
+
+    // the sprites until end() go to the bound framebuffer of this size
+    void begin(int w, int h)
+    {
+        width = w;
+        height = h;
+        draws = 0;
+        drawn = 0;
+        sprites.clear();
+        keys.clear();
+        textures.clear();
+        lastTexture = 0;
+        lastSlot = -1;
+    }
+
+    // texture 0 is a white texel, for tinted rectangles
+    void draw(unsigned int texture, float x, float y, float w, float h, const glm::vec4 &uvRect,
+              uint32_t color = 0xFFFFFFFFu, float rotation = 0.0f, int layer = 0)
+    {
+        if (!texture)
+            texture = white.ID;
+        int slot = textureSlot(texture);
+        if (slot < 0)
+        {
+            // out of slots, what is there is drawn and the batch starts over
+            flush();
+            slot = textureSlot(texture);
+        }
+        layer = layer < 0 ? 0 : layer >= MAX_LAYERS ? MAX_LAYERS - 1 : layer;
+        sprites.push_back({x, y, w, h, uvRect.x, uvRect.y, uvRect.z, uvRect.w, color, rotation});
+        keys.push_back((uint16_t)(layer * MAX_TEXTURES + slot));
+    }
+
+    void draw(const Texture2D &texture, float x, float y, float w, float h, uint32_t color = 0xFFFFFFFFu,
+              float rotation = 0.0f, int layer = 0)
+    {
+        draw(texture.ID, x, y, w, h, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), color, rotation, layer);
+    }
+
+    // an image packed into an atlas, every region of the atlas shares its draw
+    void draw(const TextureAtlas &atlas, const AtlasRegion &region, float x, float y, float w, float h,
+              uint32_t color = 0xFFFFFFFFu, float rotation = 0.0f, int layer = 0)
+    {
+        draw(atlas.texture.ID, x, y, w, h, region.uvRect, color, rotation, layer);
+    }
+
+    void rect(float x, float y, float w, float h, uint32_t color, int layer = 0)
+    {
+        draw(0, x, y, w, h, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), color, 0.0f, layer);
+    }
+
+    // sorts and draws everything added since begin()
+    void end()
+    {
+        flush();
+    }
+
+  private:
+    Shader &program;
+    RingBuffer &ring;
+    Sampler sampler;
+    Texture2D white;
+    unsigned int VAO = 0;
+    UniformHandle screenSizeLoc;
+    int width = 0, height = 0;
+
+    std::vector<Instance> sprites;
+    // layer * MAX_TEXTURES + texture slot per sprite
+    std::vector<uint16_t> keys;
+    std::vector<unsigned int> textures;
+    // sprites per key, then where each key's run starts
+    std::vector<uint32_t> counts;
+    std::vector<Instance> sorted;
+    unsigned int lastTexture = 0;
+    int lastSlot = -1;
+
+    // consecutive sprites mostly share a texture, the last lookup is kept
+    int textureSlot(unsigned int texture)
+    {
+        if (texture == lastTexture && lastSlot >= 0)
+            return lastSlot;
+        int slot = -1;
+        for (size_t i = 0; i < textures.size() && slot < 0; i++)
+        {
+            if (textures[i] == texture)
+                slot = (int)i;
+        }
+        if (slot < 0)
+        {
+            if (textures.size() == MAX_TEXTURES)
+                return -1;
+            slot = (int)textures.size();
+            textures.push_back(texture);
+        }
+        lastTexture = texture;
+        lastSlot = slot;
+        return slot;
+    }
+
+    void flush()
+    {
+        if (!sprites.empty() && width > 0 && height > 0)
+            submit();
+        sprites.clear();
+        keys.clear();
+        textures.clear();
+        lastSlot = -1;
+    }
+
+    void submit()
+    {
+        size_t count = sprites.size();
+        sorted.resize(count);
+
+        // counting sort on the 16 bit keys, stable so each run keeps the order sprites came in
+        size_t keyCount = (size_t)MAX_LAYERS * MAX_TEXTURES;
+        std::memset(counts.data(), 0, keyCount * sizeof(uint32_t));
+        for (uint16_t key : keys)
+            counts[key]++;
+        uint32_t start = 0;
+        for (size_t key = 0; key < keyCount; key++)
+        {
+            uint32_t run = counts[key];
+            counts[key] = start;
+            start += run;
+        }
+        for (size_t i = 0; i < count; i++)
+            sorted[counts[keys[i]]++] = sprites[i];
+        // one sequential copy, the mapped ring is write combined and scattered writes into it are slow
+        GLintptr offset = ring.push(sorted.data(), count * sizeof(Instance), sizeof(float));
+        if (offset < 0)
+            return;
+
+        program.use();
+        program.set(screenSizeLoc, glm::vec2((float)width, (float)height));
+        sampler.bind(TEXTURE_UNIT);
+        glState.bindVertexArray(VAO);
+        glState.disable(GL_DEPTH_TEST);
+        glState.enable(GL_BLEND);
+        glState.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        // counts[key] is now where the next key's run starts
+        uint32_t first = 0;
+        for (size_t key = 0; key < keyCount && first < count; key++)
+        {
+            uint32_t last = counts[key];
+            if (last == first)
+                continue;
+            // without base instances (GL 4.2) the binding moves to the run's first sprite
+            GLintptr runOffset = offset + (GLintptr)first * sizeof(Instance);
+            if (hasDSA())
+            {
+                glVertexArrayVertexBuffer(VAO, 0, ring.ID, runOffset, sizeof(Instance));
+            }
+            else
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, ring.ID);
+                glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)runOffset);
+                glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                                      (void *)(runOffset + offsetof(Instance, u)));
+                glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance),
+                                      (void *)(runOffset + offsetof(Instance, color)));
+                glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                                      (void *)(runOffset + offsetof(Instance, rotation)));
+            }
+            glState.bindTexture(TEXTURE_UNIT, GL_TEXTURE_2D, textures[key % MAX_TEXTURES]);
+            renderStats.countDraw(6, last - first);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)(last - first));
+            draws++;
+            first = last;
+        }
+        drawn += count;
+        glState.disable(GL_BLEND);
+        glState.enable(GL_DEPTH_TEST);
+    }
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef STARTUP_GRAPH_H
+#define STARTUP_GRAPH_H
+
+#include "job_system.cpp"
+#include "startup_timeline.cpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Cold start work that doesn't need the GL context, as a graph of tasks on the job system.
+// A task is queued the moment its last dependency finishes, so file reads start before
+// the window exists and a decode follows its read right away. The GL thread never runs
+// these, it only wait()s for the one result it needs next. Without worker threads the
+// tasks run inline as they become ready.
+class StartupGraph
+{
+  public:
+    typedef size_t Task;
+
+    explicit StartupGraph(JobSystem &jobs) : jobs(jobs)
+    {
+    }
+
+    ~StartupGraph()
+    {
+        jobs.wait(counter);
+    }
+
+    StartupGraph(const StartupGraph &) = delete;
+    StartupGraph &operator=(const StartupGraph &) = delete;
+
+    // dependencies have to be tasks added before, the name shows up in the startup timeline
+    Task add(const std::string &name, std::function<void()> function, const std::vector<Task> &dependencies = {})
+    {
+        Node *ready = NULL;
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = nodes.size();
+            nodes.push_back(std::make_unique<Node>());
+            Node &node = *nodes.back();
+            node.name = name;
+            node.function = std::move(function);
+            for (Task dependency : dependencies)
+            {
+                if (dependency < task && !nodes[dependency]->done)
+                {
+                    nodes[dependency]->dependents.push_back(task);
+                    node.remaining++;
+                }
+            }
+            if (node.remaining == 0)
+                ready = &node;
+        }
+        if (ready)
+            schedule(*ready);
+        return task;
+    }
+
+    bool isDone(Task task) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return task < nodes.size() && nodes[task]->done;
+    }
+
+    // blocks until the task ran, from any thread but a job of this graph
+    void wait(Task task)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (task >= nodes.size())
+            return;
+        finished.wait(lock, [&] { return nodes[task]->done; });
+    }
+
+  private:
+    struct Node
+    {
+        std::string name;
+        std::function<void()> function;
+        std::vector<Task> dependents;
+        int remaining = 0;
+        bool done = false;
+    };
+
+    JobSystem &jobs;
+    JobCounter counter;
+    mutable std::mutex mutex;
+    std::condition_variable finished;
+    // unique_ptr keeps nodes in place while the vector grows
+    std::vector<std::unique_ptr<Node>> nodes;
+
+    void schedule(Node &node)
+    {
+        if (jobs.workerCount() == 0)
+            run(node);
+        else
+            jobs.submit([this, &node] { run(node); }, counter);
+    }
+
+    void run(Node &node)
+    {
+        {
+            StartupScope startup(node.name);
+            node.function();
+        }
+        std::vector<Node *> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            node.done = true;
+            for (Task dependent : node.dependents)
+            {
+                if (--nodes[dependent]->remaining == 0)
+                    ready.push_back(nodes[dependent].get());
+            }
+        }
+        finished.notify_all();
+        for (Node *next : ready)
+            schedule(*next);
+    }
+};
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef STARTUP_TIMELINE_H
+#define STARTUP_TIMELINE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct StartupPhase
+{
+    std::string name;
+    // small number per thread in order of appearance, 0 is the one that started first
+    uint32_t thread;
+    // milliseconds since the timeline was created
+    double start, end;
+};
+
+// Phases of the cold start with steady_clock timestamps, from static initialisation (close
+// enough to process start) until finish(), recorded from any thread. The first swap marks
+// time to first frame, finish() is called once the textures are in as well, everything
+// recorded after that is dropped.
+class StartupTimeline
+{
+  public:
+    StartupTimeline() : origin(std::chrono::steady_clock::now())
+    {
+    }
+
+    double now() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void record(const std::string &name, double start, double end)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (done)
+            return;
+        phases.push_back({name, threadIndex(), start, end});
+    }
+
+    // records from start until now and returns now, the start of a following phase
+    double phase(const std::string &name, double start)
+    {
+        double end = now();
+        record(name, start, end);
+        return end;
+    }
+
+    // called after every swap, only the first one counts
+    void markFirstFrame()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (firstFrame < 0.0)
+            firstFrame = now();
+    }
+
+    bool firstFrameDone() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return firstFrame >= 0.0;
+    }
+
+    // stops recording, the moment is reported as everything loaded
+    void finish()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!done)
+            loaded = now();
+        done = true;
+    }
+
+    bool finished() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return done;
+    }
+
+    double timeToFirstFrame() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return firstFrame;
+    }
+
+    // the phases in start order with their thread, then the two totals
+    std::string report() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<StartupPhase> sorted(phases);
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [](const StartupPhase &a, const StartupPhase &b) { return a.start < b.start; });
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2) << "startup timeline (ms):\n";
+        for (const StartupPhase &phase : sorted)
+        {
+            out << std::setw(10) << phase.start << std::setw(10) << phase.end - phase.start << "  t" << phase.thread
+                << "  " << phase.name << '\n';
+        }
+        out << "time to first frame " << firstFrame << " ms, everything loaded " << loaded << " ms\n";
+        return out.str();
+    }
+
+    // chrome://tracing JSON, the totals as instant events
+    bool writeChromeTrace(const std::string &path) const
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cout << "ERROR::STARTUP_TIMELINE::CANNOT_WRITE: " << path << '\n';
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+        for (const StartupPhase &phase : phases)
+        {
+            out << "\n{\"name\":\"" << phase.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << phase.thread
+                << ",\"ts\":" << phase.start * 1000.0 << ",\"dur\":" << (phase.end - phase.start) * 1000.0 << "},";
+        }
+        out << "\n{\"name\":\"first frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"ts\":" << firstFrame * 1000.0
+            << "},\n{\"name\":\"everything loaded\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"ts\":"
+            << loaded * 1000.0 << "}\n]}\n";
+        return true;
+    }
+
+  private:
+    std::chrono::steady_clock::time_point origin;
+    mutable std::mutex mutex;
+    std::vector<StartupPhase> phases;
+    std::vector<std::thread::id> threads;
+    double firstFrame = -1.0;
+    double loaded = -1.0;
+    bool done = false;
+
+    // mutex held
+    uint32_t threadIndex()
+    {
+        std::thread::id id = std::this_thread::get_id();
+        for (size_t i = 0; i < threads.size(); i++)
+        {
+            if (threads[i] == id)
+                return (uint32_t)i;
+        }
+        threads.push_back(id);
+        return (uint32_t)threads.size() - 1;
+    }
+};
+
+// the timeline of this process
+inline StartupTimeline startupTimeline;
+
+// records the rest of the enclosing scope as one phase
+class StartupScope
+{
+  public:
+    explicit StartupScope(std::string name) : name(std::move(name)), start(startupTimeline.now())
+    {
+    }
+
+    ~StartupScope()
+    {
+        startupTimeline.record(name, start, startupTimeline.now());
+    }
+
+    StartupScope(const StartupScope &) = delete;
+    StartupScope &operator=(const StartupScope &) = delete;
+
+  private:
+    std::string name;
+    double start;
+};
+
+#endif
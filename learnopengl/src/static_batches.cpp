@@ -0,0 +1,253 @@
+#ifndef STATIC_BATCHES_H
+#define STATIC_BATCHES_H
+
+#include "glm/glm.hpp"
+
+#include "frustum_culler.cpp"
+#include "hash.cpp"
+#include "lightmap_baker.cpp"
+#include "mesh.cpp"
+#include "mesh_cooker.cpp"
+#include "mesh_file.cpp"
+#include "scene_snapshot.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// appends the OBJ_VERTEX_FLOATS vertices and the indices of source to merged, placed with model,
+// and grows low and high by the positions
+inline void appendTransformedMesh(const MeshBuilder &source, const glm::mat4 &model, MeshBuilder &merged,
+                                  glm::vec3 &low, glm::vec3 &high)
+{
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    uint32_t baseVertex = (uint32_t)merged.vertexCount();
+    for (size_t v = 0; v < source.vertexCount(); v++)
+    {
+        const float *vertex = &source.vertices[v * OBJ_VERTEX_FLOATS];
+        glm::vec3 position = glm::vec3(model * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f));
+        glm::vec3 normal = normalMatrix * glm::vec3(vertex[5], vertex[6], vertex[7]);
+        float length = glm::length(normal);
+        if (length > 0.0f)
+            normal /= length;
+        low = glm::min(low, position);
+        high = glm::max(high, position);
+        const float transformed[OBJ_VERTEX_FLOATS] = {position.x, position.y, position.z, vertex[3],
+                                                      vertex[4],  normal.x,   normal.y,   normal.z};
+        merged.vertices.insert(merged.vertices.end(), transformed, transformed + OBJ_VERTEX_FLOATS);
+    }
+    for (uint32_t index : source.indices)
+        merged.indices.push_back(baseVertex + index);
+}
+
+// Objects that never move, baked into one merged mesh: build() transforms the source mesh's
+// vertices by every object's model matrix and appends them, grouped by material (texture
+// array layer) and by the cell of a CHUNK_SIZE grid the object's origin falls in. Every
+// group is one submesh of the merged mesh with a bounding sphere, so cull() still frustum
+// culls the static scenery per chunk and each visible chunk and material is one draw with
+// an identity model matrix, instead of one draw per object. The merged positions are
+// quantized against the box of all of them, like any other mesh (see packVertices()).
+// With keepMerged set the merged vertices stay in system memory for save(), which writes them
+// as a mesh file next to a scene snapshot, so restore() maps the baked mesh instead.
+// With lightmapTexels set build() unwraps the merged mesh for a lightmap (see
+// lightmap_baker.cpp) and keeps it for the bake, lightmapKey is the hash of what it unwrapped.
+class StaticBatches
+{
+  public:
+    struct Batch
+    {
+        // submesh of mesh
+        size_t submesh;
+        int layer;
+        glm::vec3 center;
+        float radius;
+    };
+
+    // world units per chunk side
+    float chunkSize;
+    std::unique_ptr<Mesh> mesh;
+    std::vector<Batch> batches;
+    // objects baked by the last build()
+    size_t objects = 0;
+    // filled by cull(), indices into batches
+    std::vector<uint32_t> visible;
+    // build() keeps the merged vertices for save()
+    bool keepMerged = false;
+    // texels per world unit of the lightmap build() unwraps the merged mesh for, in a
+    // lightmapSize x lightmapSize atlas; 0 for none, the layout is lightmappedMeshLayout() else
+    float lightmapTexels = 0.0f;
+    int lightmapSize = 2048;
+    // of the geometry of the last build() or restore(), 0 without a lightmap
+    uint64_t lightmapKey = 0;
+
+    StaticBatches(float chunkSize = 32.0f) : chunkSize(chunkSize)
+    {
+    }
+
+    StaticBatches(const StaticBatches &) = delete;
+    StaticBatches &operator=(const StaticBatches &) = delete;
+
+    // an object for the next build(), placed with model and textured with layer
+    void add(const glm::mat4 &model, int layer)
+    {
+        const glm::vec3 origin = glm::vec3(model[3]) / chunkSize;
+        pending.push_back({model, layer, (int)std::floor(origin.x), (int)std::floor(origin.y),
+                           (int)std::floor(origin.z)});
+    }
+
+    // merges every object added since the last build into a new mesh, the source holds
+    // OBJ_VERTEX_FLOATS vertices as parseOBJ() writes them: position, texture coordinate, normal
+    bool build(const MeshBuilder &source, const VertexLayout &layout)
+    {
+        mesh.reset();
+        kept.reset();
+        batches.clear();
+        lightmapKey = 0;
+        objects = pending.size();
+        if (pending.empty() || source.stride != OBJ_VERTEX_FLOATS || source.indices.empty())
+        {
+            pending.clear();
+            return false;
+        }
+        std::sort(pending.begin(), pending.end(), [](const Pending &a, const Pending &b) {
+            if (a.layer != b.layer)
+                return a.layer < b.layer;
+            if (a.x != b.x)
+                return a.x < b.x;
+            if (a.y != b.y)
+                return a.y < b.y;
+            return a.z < b.z;
+        });
+
+        MeshBuilder merged(OBJ_VERTEX_FLOATS);
+        merged.vertices.reserve(pending.size() * source.vertices.size());
+        merged.indices.reserve(pending.size() * source.indices.size());
+        for (size_t first = 0; first < pending.size();)
+        {
+            size_t last = first + 1;
+            while (last < pending.size() && sameBatch(pending[first], pending[last]))
+                last++;
+            glm::vec3 low(1e30f), high(-1e30f);
+            uint32_t firstIndex = (uint32_t)merged.indices.size();
+            for (size_t o = first; o < last; o++)
+                appendTransformedMesh(source, pending[o].model, merged, low, high);
+            merged.submeshes.push_back({firstIndex, (uint32_t)merged.indices.size() - firstIndex});
+            glm::vec3 center = (low + high) * 0.5f;
+            batches.push_back({merged.submeshes.size() - 1, pending[first].layer, center,
+                               glm::length(high - center)});
+            first = last;
+        }
+        pending.clear();
+        if (lightmapTexels > 0.0f)
+        {
+            MeshBuilder unwrapped(LIGHTMAPPED_VERTEX_FLOATS);
+            float texels = unwrapLightmap(merged, lightmapSize, lightmapTexels, unwrapped);
+            if (texels <= 0.0f)
+            {
+                batches.clear();
+                return false;
+            }
+            if (texels < lightmapTexels)
+                std::cout << "static batching: the lightmap is down to " << texels << " texels per unit\n";
+            merged = std::move(unwrapped);
+            lightmapKey = hashWords64(merged.vertices.data(), merged.vertices.size() * sizeof(float));
+            lightmapKey = hashWords64(merged.indices.data(), merged.indices.size() * sizeof(uint32_t), lightmapKey);
+            lightmapKey = fnv1a64(&lightmapSize, sizeof(lightmapSize), lightmapKey);
+        }
+        mesh = std::make_unique<Mesh>(merged, layout);
+        if (keepMerged || lightmapTexels > 0.0f)
+            kept = std::make_unique<MeshBuilder>(std::move(merged));
+        return true;
+    }
+
+    // the batches for a scene snapshot and the merged mesh as the mesh file meshPath, in the
+    // layout build() was given; a mesh has to come from a build() with keepMerged
+    bool save(SceneSnapshotWriter &snapshot, const std::string &meshPath, const VertexLayout &layout) const
+    {
+        if (mesh && (!kept || !writeMeshFile(meshPath, *kept, layout)))
+            return false;
+        snapshot.add("static batches/batches", batches);
+        snapshot.add("static batches/objects", &objects, sizeof(objects));
+        snapshot.add("static batches/lightmap key", &lightmapKey, sizeof(lightmapKey));
+        return true;
+    }
+
+    // the batches of a snapshot and the mesh save() wrote with them, in place of build()
+    bool restore(const SceneSnapshot &snapshot, const std::string &meshPath, JobSystem *jobs = NULL)
+    {
+        const size_t *count;
+        size_t one;
+        mesh.reset();
+        if (!snapshot.read("static batches/batches", batches) || !snapshot.view("static batches/objects", count, one) ||
+            one != 1 || (!batches.empty() && !(mesh = loadMeshFile(meshPath, jobs))))
+        {
+            batches.clear();
+            objects = 0;
+            lightmapKey = 0;
+            return false;
+        }
+        pending.clear();
+        objects = *count;
+        // snapshots of a build without a lightmap have none
+        const uint64_t *key;
+        lightmapKey = snapshot.view("static batches/lightmap key", key, one) && one == 1 ? *key : 0;
+        return true;
+    }
+
+    // the merged vertices build() kept for save() or the lightmap bake, NULL when it didn't
+    const MeshBuilder *merged() const
+    {
+        return kept.get();
+    }
+
+    // once nothing needs the merged vertices any more
+    void releaseMerged()
+    {
+        kept.reset();
+    }
+
+    // the batches whose sphere touches the frustum, in the order they were built
+    void cull(const Frustum &frustum)
+    {
+        visible.clear();
+        for (size_t b = 0; b < batches.size(); b++)
+        {
+            const Batch &batch = batches[b];
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; p++)
+                inside = glm::dot(glm::vec3(frustum.planes[p]), batch.center) + frustum.planes[p].w >= -batch.radius;
+            if (inside)
+                visible.push_back((uint32_t)b);
+        }
+    }
+
+    // with mesh bound and its bounds set on the program
+    void draw(size_t batch) const
+    {
+        mesh->drawSubmesh(batches[batch].submesh);
+    }
+
+  private:
+    struct Pending
+    {
+        glm::mat4 model;
+        int layer;
+        // grid cell of the origin
+        int x, y, z;
+    };
+
+    std::vector<Pending> pending;
+    std::unique_ptr<MeshBuilder> kept;
+
+    static bool sameBatch(const Pending &a, const Pending &b)
+    {
+        return a.layer == b.layer && a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+};
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef STATIC_VERTEX_LAYOUT_H
+#define STATIC_VERTEX_LAYOUT_H
+
+#include "glad/glad.h"
+
+#include "gl_state.cpp"
+#include "mesh.cpp"
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// Attributes of a VertexLayoutOf<...>: where the shader reads them, how many floats they take
+// in the MeshBuilder vertex, how they are stored on the GPU and how the shader declares them.
+template <unsigned int Location, int Components, VertexFormat Format, bool BoundsRelative = false>
+struct VertexAttribute
+{
+    static constexpr unsigned int location = Location;
+    static constexpr int components = Components;
+    static constexpr VertexFormat format = Format;
+    static constexpr bool boundsRelative = BoundsRelative;
+    static constexpr VertexFormatInfo info = vertexFormatInfo(Format, Components);
+};
+
+struct Position3f : VertexAttribute<0, 3, VertexFormat::Float>
+{
+    static constexpr const char *glsl = "vec3";
+    static constexpr const char *name = "aPos";
+};
+// quantized against the mesh bounds, see VertexElement::boundsRelative
+struct Position3s : VertexAttribute<0, 3, VertexFormat::Snorm16, true>
+{
+    static constexpr const char *glsl = "vec3";
+    static constexpr const char *name = "aPos";
+};
+struct UV2f : VertexAttribute<1, 2, VertexFormat::Float>
+{
+    static constexpr const char *glsl = "vec2";
+    static constexpr const char *name = "aTexCoord";
+};
+struct UV2h : VertexAttribute<1, 2, VertexFormat::HalfFloat>
+{
+    static constexpr const char *glsl = "vec2";
+    static constexpr const char *name = "aTexCoord";
+};
+// the normal sits behind the per-instance streams (locations 2 to 6, see instance_buffer.cpp)
+struct Normal3f : VertexAttribute<7, 3, VertexFormat::Float>
+{
+    static constexpr const char *glsl = "vec3";
+    static constexpr const char *name = "aNormal";
+};
+struct Normal1010102 : VertexAttribute<7, 3, VertexFormat::Int2_10_10_10_Rev>
+{
+    static constexpr const char *glsl = "vec3";
+    static constexpr const char *name = "aNormal";
+};
+struct Joints4u8 : VertexAttribute<8, 4, VertexFormat::Uint8>
+{
+    static constexpr const char *glsl = "uvec4";
+    static constexpr const char *name = "aJoints";
+};
+struct Weights4un8 : VertexAttribute<9, 4, VertexFormat::Unorm8>
+{
+    static constexpr const char *glsl = "vec4";
+    static constexpr const char *name = "aWeights";
+};
+// the second texture coordinate of lightmapped meshes, in [0, 1] and finer than half floats
+// across a large atlas (see lightmap_baker.cpp)
+struct LightmapUV2us : VertexAttribute<10, 2, VertexFormat::Unorm16>
+{
+    static constexpr const char *glsl = "vec2";
+    static constexpr const char *name = "aLightmapCoord";
+};
+
+// A vertex layout fixed at compile time, e.g. VertexLayoutOf<Position3s, UV2h, Normal1010102>.
+// Offsets and the stride follow VertexLayout's rules (declaration order, 4 byte aligned) and
+// are constants, apply() is the attribute setup with every format and offset inlined, and
+// glslInputs() declares the same attributes for the vertex shader, so the C++ side and the
+// shader can't disagree. layout() is the VertexLayout for Mesh, GeometryPool and mesh files.
+template <typename... Attributes> class VertexLayoutOf
+{
+  public:
+    static constexpr size_t count = sizeof...(Attributes);
+    // floats of the MeshBuilder vertex the layout packs
+    static constexpr int floats = (Attributes::components + ...);
+
+    // offset of the index-th attribute, count gives the stride
+    static constexpr size_t offset(size_t index)
+    {
+        const size_t sizes[] = {Attributes::info.bytes..., 0};
+        size_t result = 0;
+        for (size_t i = 0; i < index; i++)
+            result = nextVertexOffset(result, sizes[i]);
+        return result;
+    }
+
+    static constexpr size_t stride = offset(count);
+
+    template <typename Attribute> static constexpr size_t offsetOf()
+    {
+        static_assert((std::is_same<Attribute, Attributes>::value || ...), "attribute isn't in the layout");
+        const bool matches[] = {std::is_same<Attribute, Attributes>::value...};
+        size_t index = 0;
+        while (!matches[index])
+            index++;
+        return offset(index);
+    }
+
+    static VertexLayout layout()
+    {
+        return VertexLayout(
+            {VertexElement{Attributes::location, Attributes::components, Attributes::format, Attributes::boundsRelative}...});
+    }
+
+    // the same as layout().apply(vertexArray, buffer)
+    static void apply(unsigned int vertexArray, unsigned int buffer)
+    {
+        if (hasDSA())
+        {
+            glVertexArrayVertexBuffer(vertexArray, VertexLayout::BINDING, buffer, 0, (GLsizei)stride);
+        }
+        else
+        {
+            glState.bindVertexArray(vertexArray);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        }
+        applyAll(vertexArray, std::index_sequence_for<Attributes...>());
+    }
+
+    // "layout (location = 0) in vec3 aPos; ...", on one line so it fits in a #define
+    static std::string glslInputs()
+    {
+        std::string inputs;
+        ((inputs += "layout (location = " + std::to_string(Attributes::location) + ") in " + Attributes::glsl + " " +
+                    Attributes::name + "; "),
+         ...);
+        return inputs;
+    }
+
+    // the define vertex shaders expand in place of their attribute declarations
+    static std::string glslDefine()
+    {
+        return "VERTEX_INPUTS " + glslInputs();
+    }
+
+  private:
+    template <size_t... Indices> static void applyAll(unsigned int vertexArray, std::index_sequence<Indices...>)
+    {
+        (applyAttribute<Attributes, offset(Indices)>(vertexArray), ...);
+    }
+
+    template <typename Attribute, size_t Offset> static void applyAttribute(unsigned int vertexArray)
+    {
+        constexpr VertexFormatInfo info = Attribute::info;
+        if (hasDSA())
+        {
+            if constexpr (info.integer)
+                glVertexArrayAttribIFormat(vertexArray, Attribute::location, info.components, info.type, (GLuint)Offset);
+            else
+                glVertexArrayAttribFormat(vertexArray, Attribute::location, info.components, info.type, info.normalized,
+                                          (GLuint)Offset);
+            glVertexArrayAttribBinding(vertexArray, Attribute::location, VertexLayout::BINDING);
+            glEnableVertexArrayAttrib(vertexArray, Attribute::location);
+        }
+        else
+        {
+            if constexpr (info.integer)
+                glVertexAttribIPointer(Attribute::location, info.components, info.type, (GLsizei)stride, (void *)Offset);
+            else
+                glVertexAttribPointer(Attribute::location, info.components, info.type, info.normalized, (GLsizei)stride,
+                                      (void *)Offset);
+            glEnableVertexAttribArray(Attribute::location);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef STEREO_H
+#define STEREO_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "gl_extensions.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "multi_view.cpp"
+#include "ring_buffer.cpp"
+#include "texture.cpp"
+
+#include <iostream>
+
+// Both eyes of a frame rendered by the same draws into the two layers of a texture array,
+// the left eye in layer 0. The eye matrices go in the Views block of multi_view.cpp and the
+// SHADER_STEREO vertex variant sends each vertex to its eye either
+//   Multiview:       with GL_OVR_multiview2 the driver runs the vertex stage once per layer
+//                    of a multiview framebuffer, gl_ViewID_OVR is the eye (the shader is
+//                    built with the OVR_MULTIVIEW define)
+//   InstancedLayers: every object is instanced twice and gl_InstanceID % 2 picks the eye
+//                    and gl_Layer of a layered framebuffer (ARB_shader_viewport_layer_array)
+// Either way the CPU records one draw for the two eyes. end() puts the eyes side by side
+// into the framebuffer that was bound, for the passes after it and the window.
+class StereoTarget
+{
+  public:
+    enum class Mode
+    {
+        None,
+        Multiview,
+        InstancedLayers
+    };
+
+    Mode mode = Mode::None;
+    Texture2DArray color;
+    Texture2DArray depth;
+    unsigned int FBO = 0;
+    // one eye size
+    int width = 0, height = 0;
+
+    // loader is used for the extension entry point, e.g. glfwGetProcAddress
+    StereoTarget(GLADloadproc loader)
+    {
+        if (hasGLExtension("GL_OVR_multiview2"))
+            framebufferTextureMultiview =
+                (FramebufferTextureMultiviewProc)loader("glFramebufferTextureMultiviewOVR");
+        if (framebufferTextureMultiview)
+            mode = Mode::Multiview;
+        else if (MultiView::viewportArraySupported())
+            mode = Mode::InstancedLayers;
+    }
+
+    ~StereoTarget()
+    {
+        if (FBO)
+            glDeleteFramebuffers(1, &FBO);
+        if (eyeFramebuffers[0])
+            glDeleteFramebuffers(2, eyeFramebuffers);
+    }
+
+    StereoTarget(const StereoTarget &) = delete;
+    StereoTarget &operator=(const StereoTarget &) = delete;
+
+    bool supported() const
+    {
+        return mode != Mode::None;
+    }
+
+    // instances per object of a stereo draw
+    int instancesPerObject() const
+    {
+        return mode == Mode::InstancedLayers ? 2 : 1;
+    }
+
+    // (re)creates the arrays when the eye size changed, false when incomplete
+    bool resize(int w, int h)
+    {
+        if (!supported() || w <= 0 || h <= 0)
+            return false;
+        if (FBO && w == width && h == height)
+            return true;
+        width = w;
+        height = h;
+        color.create(width, height, 2, GL_RGBA8, 1, GPU_MEMORY_RENDER_TARGETS);
+        depth.create(width, height, 2, GL_DEPTH_COMPONENT32F, 1, GPU_MEMORY_RENDER_TARGETS);
+
+        if (!FBO)
+        {
+            FBO = createFramebuffer();
+            eyeFramebuffers[0] = createFramebuffer();
+            eyeFramebuffers[1] = createFramebuffer();
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        if (mode == Mode::Multiview)
+        {
+            framebufferTextureMultiview(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, color.ID, 0, 0, 2);
+            framebufferTextureMultiview(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth.ID, 0, 0, 2);
+        }
+        else
+        {
+            // layered attachments, gl_Layer picks the layer
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, color.ID, 0);
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth.ID, 0);
+        }
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        // a layer each to blit from
+        for (int eye = 0; eye < 2; eye++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, eyeFramebuffers[eye]);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, color.ID, 0, eye);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth.ID, 0, eye);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::STEREO::INCOMPLETE: 0x" << std::hex << status << std::dec << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    // uploads the eyes' view-projections and binds the arrays cleared, the stereo draws follow
+    void begin(RingBuffer &ring, const glm::mat4 &leftViewProjection, const glm::mat4 &rightViewProjection)
+    {
+        ViewsBlock block = {};
+        block.viewProjections[0] = leftViewProjection;
+        block.viewProjections[1] = rightViewProjection;
+        block.viewCount = 2;
+        GLintptr offset = ring.push(&block, sizeof(ViewsBlock), ring.uniformAlignment);
+        if (offset >= 0)
+            glState.bindBufferRange(GL_UNIFORM_BUFFER, MultiView::BINDING, ring.ID, offset, sizeof(ViewsBlock));
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, width, height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // both eyes side by side into the framebuffer bound before begin(), which is left bound
+    // at its own size, the arrays stay as they are for a headset to take. The depth goes along
+    // into offscreen targets, whose depth is GL_DEPTH_COMPONENT32F like the arrays'; the
+    // window's may be another format, which a depth blit doesn't convert.
+    void end(int targetWidth, int targetHeight)
+    {
+        GLbitfield mask = previousFramebuffer ? GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT;
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (unsigned int)previousFramebuffer);
+        for (int eye = 0; eye < 2; eye++)
+        {
+            int x0 = eye * targetWidth / 2, x1 = (eye + 1) * targetWidth / 2;
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, eyeFramebuffers[eye]);
+            glBlitFramebuffer(0, 0, width, height, x0, 0, x1, targetHeight, mask, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)previousFramebuffer);
+        glViewport(0, 0, targetWidth, targetHeight);
+    }
+
+  private:
+    typedef void(APIENTRYP FramebufferTextureMultiviewProc)(GLenum target, GLenum attachment, GLuint texture,
+                                                             GLint level, GLint baseViewIndex, GLsizei numViews);
+    FramebufferTextureMultiviewProc framebufferTextureMultiview = nullptr;
+    unsigned int eyeFramebuffers[2] = {};
+    GLint previousFramebuffer = 0;
+};
+
+#endif
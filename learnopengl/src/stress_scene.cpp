@@ -0,0 +1,134 @@
+#ifndef STRESS_SCENE_H
+#define STRESS_SCENE_H
+
+#include "glm/glm.hpp"
+
+#include "transform_system.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+enum StressLayout
+{
+    // a cube shaped grid, every cube spacing apart
+    STRESS_GRID,
+    // uniformly inside a ball of the same volume
+    STRESS_SPHERE,
+    // dense clumps with empty space between them, hard on the culling
+    STRESS_CLUSTERS
+};
+
+// what generateStressScene() builds, see --stress in main.cpp
+struct StressSceneSettings
+{
+    size_t count = 10000;
+    StressLayout layout = STRESS_GRID;
+    // spinning cubes keep the simulation busy, static ones only cost drawing
+    bool spin = true;
+    // distinct materials handed out round robin, at most textures of them
+    int materials = 2;
+    // texture layers, the first two are the loaded container and wall images,
+    // the rest are made by makeStressTexture()
+    int textures = 2;
+    float spacing = 3.0f;
+    uint32_t seed = 1;
+};
+
+inline StressLayout parseStressLayout(const std::string &name)
+{
+    if (name == "sphere")
+        return STRESS_SPHERE;
+    if (name == "clusters")
+        return STRESS_CLUSTERS;
+    return STRESS_GRID;
+}
+
+// radius of a ball around the origin holding every cube
+inline float stressSceneRadius(const StressSceneSettings &settings)
+{
+    float side = std::ceil(std::cbrt((float)settings.count)) * settings.spacing;
+    return side * 0.5f * std::sqrt(3.0f);
+}
+
+// Adds settings.count cubes centred on the origin, the same scene for the same settings.
+// materials gets the material index of every cube, 0 to settings.materials - 1.
+inline void generateStressScene(const StressSceneSettings &settings, TransformSystem &cubes,
+                                std::vector<int> &materials)
+{
+    std::mt19937 random(settings.seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> speed(10.0f, 100.0f);
+    int materialCount = std::max(1, std::min(settings.materials, settings.textures));
+
+    size_t side = (size_t)std::ceil(std::cbrt((double)settings.count));
+    float half = (float)(side - 1) * settings.spacing * 0.5f;
+    float radius = half * 1.24f;
+    // clusters of about 512 cubes each, packed at half the spacing
+    size_t clusterCount = std::max<size_t>(1, settings.count / 512);
+    std::vector<glm::vec3> clusterCenters(clusterCount);
+    for (glm::vec3 &center : clusterCenters)
+        center = glm::vec3(unit(random), unit(random), unit(random)) * half;
+    float clusterRadius = std::cbrt(512.0f) * settings.spacing * 0.5f;
+
+    cubes.reserve(cubes.size() + settings.count);
+    materials.reserve(materials.size() + settings.count);
+    for (size_t i = 0; i < settings.count; i++)
+    {
+        glm::vec3 position;
+        if (settings.layout == STRESS_GRID)
+        {
+            position = glm::vec3((float)(i % side), (float)(i / side % side), (float)(i / (side * side))) *
+                           settings.spacing -
+                       glm::vec3(half);
+        }
+        else
+        {
+            // rejection sampling inside the unit ball
+            glm::vec3 offset;
+            do
+                offset = glm::vec3(unit(random), unit(random), unit(random));
+            while (glm::dot(offset, offset) > 1.0f);
+            if (settings.layout == STRESS_SPHERE)
+                position = offset * radius;
+            else
+                position = clusterCenters[i % clusterCount] + offset * clusterRadius;
+        }
+        glm::vec3 axis(unit(random), unit(random), unit(random));
+        if (glm::dot(axis, axis) < 1e-4f)
+            axis = glm::vec3(0.0f, 1.0f, 0.0f);
+        cubes.add(position, axis, settings.spin ? speed(random) : 0.0f);
+        materials.push_back((int)(i % materialCount));
+    }
+}
+
+// RGBA8 checkerboard in a colour of its own for generated texture index, size x size texels
+inline std::vector<unsigned char> makeStressTexture(int index, int size)
+{
+    // golden ratio steps around the hue circle keep neighbouring indices apart
+    float hue = std::fmod(index * 0.618034f, 1.0f) * 6.0f;
+    glm::vec3 color =
+        glm::clamp(glm::vec3(std::fabs(hue - 3.0f) - 1.0f, 2.0f - std::fabs(hue - 2.0f), 2.0f - std::fabs(hue - 4.0f)),
+                   0.0f, 1.0f);
+    std::vector<unsigned char> texels((size_t)size * size * 4);
+    int cell = std::max(1, size / 8);
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            float shade = ((x / cell + y / cell) & 1) ? 1.0f : 0.35f;
+            unsigned char *texel = &texels[((size_t)y * size + x) * 4];
+            texel[0] = (unsigned char)(color.r * shade * 255.0f);
+            texel[1] = (unsigned char)(color.g * shade * 255.0f);
+            texel[2] = (unsigned char)(color.b * shade * 255.0f);
+            texel[3] = 255;
+        }
+    }
+    return texels;
+}
+
+#endif
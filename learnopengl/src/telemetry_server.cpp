@@ -0,0 +1,734 @@
+#ifndef TELEMETRY_SERVER_H
+#define TELEMETRY_SERVER_H
+
+#include "cpu_profiler.cpp"
+#include "gpu_profiler.cpp"
+#include "hitch_detector.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#undef APIENTRY
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+typedef SOCKET TelemetrySocket;
+#define TELEMETRY_NO_SOCKET INVALID_SOCKET
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int TelemetrySocket;
+#define TELEMETRY_NO_SOCKET -1
+#endif
+
+// Live profiling of a running instance over TCP (--telemetry <port> in main.cpp, a client
+// with --telemetry-connect <host:port>). A server without a client only tries a non-blocking
+// accept() every ACCEPT_INTERVAL frames; with one, every frame goes out as a few messages in
+// a compact binary stream: the frame's span and counters, memory, the last time of every GPU
+// pass, and the CPU profiler's zones (and the GPU profiler's, whose history is on meanwhile)
+// ended since the frame before. Zone names go once as a NAME message and are ids after that.
+// Sends never block: a client that falls MAX_PENDING bytes behind misses frames instead.
+//
+// Every message is a u32 size (of what follows it), a u8 TelemetryMessage and its fields, all
+// little endian; "varint" is LEB128, "zigzag" a signed varint. Times are CpuProfiler::now()
+// ticks, the HELLO's origin and the FRAME's rate turn them into microseconds.
+//   HELLO   u32 version, u32 GPU thread id, u64 origin, f64 ticks per microsecond
+//   NAME    varint id, the name's bytes up to the end of the message
+//   FRAME   u64 start, u64 end, f64 ticks per microsecond, varint draw calls, triangles,
+//           uniform uploads, state changes, GL calls, GPU bytes, driver free bytes,
+//           allocations, allocated bytes, dropped frames, then varint passes and per pass
+//           varint name id and f32 milliseconds
+//   ZONES   varint thread id, varint count, per zone varint name id, zigzag start minus the
+//           previous zone's start (the FRAME's start for the first), varint duration
+enum TelemetryMessage : uint8_t
+{
+    TELEMETRY_HELLO = 1,
+    TELEMETRY_NAME = 2,
+    TELEMETRY_FRAME = 3,
+    TELEMETRY_ZONES = 4,
+};
+
+// memory numbers of one frame (see gpu_memory.cpp, alloc_tracker.cpp)
+struct TelemetryMemory
+{
+    uint64_t gpuBytes = 0;
+    uint64_t driverFree = 0;
+    uint64_t frameAllocations = 0;
+    uint64_t frameBytes = 0;
+};
+
+inline bool telemetrySocketsReady()
+{
+#ifdef _WIN32
+    static bool ready = []() {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return ready;
+#else
+    return true;
+#endif
+}
+
+inline void closeTelemetrySocket(TelemetrySocket &socket)
+{
+    if (socket == TELEMETRY_NO_SOCKET)
+        return;
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+    socket = TELEMETRY_NO_SOCKET;
+}
+
+inline bool setTelemetryNonBlocking(TelemetrySocket socket)
+{
+#ifdef _WIN32
+    u_long on = 1;
+    return ioctlsocket(socket, FIONBIO, &on) == 0;
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    return flags >= 0 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+inline bool telemetryWouldBlock()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+class TelemetryServer
+{
+  public:
+    static const uint32_t VERSION = 1;
+    static const unsigned int ACCEPT_INTERVAL = 30;
+    static const size_t MAX_PENDING = 4 << 20;
+
+    // frames the client was too far behind for
+    uint64_t dropped = 0;
+
+    TelemetryServer()
+    {
+    }
+
+    ~TelemetryServer()
+    {
+        closeTelemetrySocket(client);
+        closeTelemetrySocket(listener);
+    }
+
+    TelemetryServer(const TelemetryServer &) = delete;
+    TelemetryServer &operator=(const TelemetryServer &) = delete;
+
+    // listens for one client at a time on port of every interface
+    bool listen(int port)
+    {
+        if (!telemetrySocketsReady())
+            return false;
+        listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listener == TELEMETRY_NO_SOCKET)
+            return false;
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons((uint16_t)port);
+        if (bind(listener, (const sockaddr *)&address, sizeof(address)) != 0 || ::listen(listener, 1) != 0 ||
+            !setTelemetryNonBlocking(listener))
+        {
+            std::cout << "ERROR::TELEMETRY::CANNOT_LISTEN: port " << port << '\n';
+            closeTelemetrySocket(listener);
+            return false;
+        }
+        std::cout << "telemetry: listening on port " << port << '\n';
+        return true;
+    }
+
+    bool listening() const
+    {
+        return listener != TELEMETRY_NO_SOCKET;
+    }
+
+    bool connected() const
+    {
+        return client != TELEMETRY_NO_SOCKET;
+    }
+
+    // right after the swap, with the counters of the frame it ended
+    void endFrame(const FrameCounters &counters, const TelemetryMemory &memory, const GpuProfiler &gpu)
+    {
+        uint64_t now = CpuProfiler::now();
+        uint64_t start = lastEnd ? lastEnd : now;
+        lastEnd = now;
+        if (!connected())
+        {
+            if (listening() && ++framesSinceAccept >= ACCEPT_INTERVAL)
+            {
+                framesSinceAccept = 0;
+                accept(gpu, now);
+            }
+            return;
+        }
+        CpuProfiler &profiler = CpuProfiler::instance();
+        // a client that keeps up empties the buffer, one that stays behind would grow it by
+        // everything it was sent; the gone prefix is dropped once it is half of the buffer
+        if (sent > 0 && sent > pending.size() / 2)
+        {
+            pending.erase(pending.begin(), pending.begin() + sent);
+            sent = 0;
+        }
+        if (pending.size() - sent > MAX_PENDING)
+        {
+            dropped++;
+            skip(profiler, gpu);
+        }
+        else
+        {
+            writeFrame(start, now, counters, memory, gpu, profiler.calibrate());
+            writeCpuZones(profiler, start);
+            writeGpuZones(gpu, start);
+        }
+        flush();
+    }
+
+  private:
+    TelemetrySocket listener = TELEMETRY_NO_SOCKET;
+    TelemetrySocket client = TELEMETRY_NO_SOCKET;
+    unsigned int framesSinceAccept = 0;
+    uint64_t lastEnd = 0;
+    // bytes queued for the client, the first sent of them already gone out
+    std::vector<unsigned char> pending;
+    size_t sent = 0;
+    // name ids of the CPU zones by literal and of the GPU passes by index
+    std::unordered_map<const char *, uint32_t> cpuNames;
+    std::vector<uint32_t> passNames;
+    uint32_t nextName = 0;
+    // events of each thread ring and of the GPU profiler already sent
+    std::vector<uint64_t> cpuSent;
+    uint64_t gpuSent = 0;
+    // one message's bytes while it is put together
+    std::vector<unsigned char> message;
+
+    void accept(const GpuProfiler &gpu, uint64_t now)
+    {
+        TelemetrySocket accepted = ::accept(listener, NULL, NULL);
+        if (accepted == TELEMETRY_NO_SOCKET)
+            return;
+        if (!setTelemetryNonBlocking(accepted))
+        {
+            closeTelemetrySocket(accepted);
+            return;
+        }
+        int noDelay = 1;
+        setsockopt(accepted, IPPROTO_TCP, TCP_NODELAY, (const char *)&noDelay, sizeof(noDelay));
+        client = accepted;
+        pending.clear();
+        sent = 0;
+        cpuNames.clear();
+        passNames.clear();
+        nextName = 0;
+        dropped = 0;
+        // the client sees what happens from now on, not what the rings still hold
+        CpuProfiler &profiler = CpuProfiler::instance();
+        skip(profiler, gpu);
+        begin(TELEMETRY_HELLO);
+        put32(VERSION);
+        put32((uint32_t)HitchDetector::GPU_TRACK);
+        put64(now);
+        putDouble(profiler.calibrate());
+        end();
+        std::cout << "telemetry: client connected\n";
+    }
+
+    void disconnect()
+    {
+        closeTelemetrySocket(client);
+        pending.clear();
+        sent = 0;
+        std::cout << "telemetry: client disconnected\n";
+    }
+
+    void skip(CpuProfiler &profiler, const GpuProfiler &gpu)
+    {
+        profiler.visitThreads([this](const CpuProfiler::ThreadEvents &thread) {
+            if (cpuSent.size() <= thread.id)
+                cpuSent.resize(thread.id + 1, 0);
+            cpuSent[thread.id] = thread.count.load(std::memory_order_acquire);
+        });
+        gpuSent = gpu.eventCount;
+    }
+
+    void flush()
+    {
+        while (sent < pending.size())
+        {
+#ifdef _WIN32
+            int result = send(client, (const char *)pending.data() + sent, (int)(pending.size() - sent), 0);
+#else
+            ssize_t result = send(client, pending.data() + sent, pending.size() - sent, MSG_NOSIGNAL);
+#endif
+            if (result > 0)
+            {
+                sent += (size_t)result;
+                continue;
+            }
+            if (result < 0 && telemetryWouldBlock())
+                return;
+            disconnect();
+            return;
+        }
+    }
+
+    void writeFrame(uint64_t frameStart, uint64_t frameEnd, const FrameCounters &counters,
+                    const TelemetryMemory &memory, const GpuProfiler &gpu, double ticksPerMicrosecond)
+    {
+        if (passNames.size() < gpu.passes.size())
+        {
+            for (size_t i = passNames.size(); i < gpu.passes.size(); i++)
+                passNames.push_back(name(gpu.passes[i].name.data(), gpu.passes[i].name.size()));
+        }
+        begin(TELEMETRY_FRAME);
+        put64(frameStart);
+        put64(frameEnd);
+        putDouble(ticksPerMicrosecond);
+        for (uint64_t value : {(uint64_t)counters.drawCalls, counters.triangles, (uint64_t)counters.uniformUploads,
+                               (uint64_t)counters.stateChanges, counters.glCalls, memory.gpuBytes, memory.driverFree,
+                               memory.frameAllocations, memory.frameBytes, dropped})
+            putVarint(value);
+        putVarint(gpu.passes.size());
+        for (size_t i = 0; i < gpu.passes.size(); i++)
+        {
+            putVarint(passNames[i]);
+            putFloat(gpu.passes[i].last);
+        }
+        end();
+    }
+
+    void writeCpuZones(CpuProfiler &profiler, uint64_t frameStart)
+    {
+        profiler.visitThreads([&](const CpuProfiler::ThreadEvents &thread) {
+            if (cpuSent.size() <= thread.id)
+                cpuSent.resize(thread.id + 1, 0);
+            uint64_t count = thread.count.load(std::memory_order_acquire);
+            uint64_t first = std::max(cpuSent[thread.id],
+                                      count > CpuProfiler::EVENTS_PER_THREAD ? count - CpuProfiler::EVENTS_PER_THREAD
+                                                                             : 0);
+            cpuSent[thread.id] = count;
+            if (first == count)
+                return;
+            // names first, a NAME can't go in the middle of the ZONES it is for
+            for (uint64_t i = first; i < count; i++)
+                name(thread.events[i % CpuProfiler::EVENTS_PER_THREAD].name);
+            begin(TELEMETRY_ZONES);
+            putVarint(thread.id);
+            putVarint(count - first);
+            uint64_t previous = frameStart;
+            for (uint64_t i = first; i < count; i++)
+            {
+                const CpuZoneEvent &event = thread.events[i % CpuProfiler::EVENTS_PER_THREAD];
+                // only an event overwritten since the names went out misses
+                auto found = cpuNames.find(event.name);
+                putVarint(found != cpuNames.end() ? found->second : 0);
+                putZigzag((int64_t)(event.start - previous));
+                putVarint(event.end - event.start);
+                previous = event.start;
+            }
+            end();
+        });
+    }
+
+    void writeGpuZones(const GpuProfiler &gpu, uint64_t frameStart)
+    {
+        uint64_t first = std::max(gpuSent, gpu.eventCount > GpuProfiler::EVENTS ? gpu.eventCount - GpuProfiler::EVENTS
+                                                                                 : 0);
+        uint64_t count = gpu.eventCount;
+        gpuSent = count;
+        if (first == count)
+            return;
+        begin(TELEMETRY_ZONES);
+        putVarint(HitchDetector::GPU_TRACK);
+        putVarint(count - first);
+        uint64_t previous = frameStart;
+        for (uint64_t i = first; i < count; i++)
+        {
+            const GpuZoneEvent &event = gpu.events[i % GpuProfiler::EVENTS];
+            putVarint(event.pass < passNames.size() ? passNames[event.pass] : 0);
+            putZigzag((int64_t)(event.start - previous));
+            putVarint(event.end - event.start);
+            previous = event.start;
+        }
+        end();
+    }
+
+    // the id of a zone name, sending it the first time
+    uint32_t name(const char *literal)
+    {
+        auto found = cpuNames.find(literal);
+        if (found != cpuNames.end())
+            return found->second;
+        uint32_t id = name(literal, std::strlen(literal));
+        cpuNames.emplace(literal, id);
+        return id;
+    }
+
+    uint32_t name(const char *text, size_t length)
+    {
+        uint32_t id = nextName++;
+        begin(TELEMETRY_NAME);
+        putVarint(id);
+        message.insert(message.end(), (const unsigned char *)text, (const unsigned char *)text + length);
+        end();
+        return id;
+    }
+
+    void begin(TelemetryMessage type)
+    {
+        message.clear();
+        message.push_back(type);
+    }
+
+    void end()
+    {
+        uint32_t size = (uint32_t)message.size();
+        for (int i = 0; i < 4; i++)
+            pending.push_back((unsigned char)(size >> (8 * i)));
+        pending.insert(pending.end(), message.begin(), message.end());
+    }
+
+    void put32(uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+            message.push_back((unsigned char)(value >> (8 * i)));
+    }
+
+    void put64(uint64_t value)
+    {
+        for (int i = 0; i < 8; i++)
+            message.push_back((unsigned char)(value >> (8 * i)));
+    }
+
+    void putDouble(double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        put64(bits);
+    }
+
+    void putFloat(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        put32(bits);
+    }
+
+    void putVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            message.push_back((unsigned char)(value | 0x80));
+            value >>= 7;
+        }
+        message.push_back((unsigned char)value);
+    }
+
+    void putZigzag(int64_t value)
+    {
+        putVarint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+    }
+};
+
+// Reads the messages of a TelemetryServer into a chrome://tracing / Perfetto trace
+class TelemetryReader
+{
+  public:
+    const unsigned char *data;
+    size_t size;
+    size_t at = 0;
+    bool failed = false;
+
+    TelemetryReader(const unsigned char *data, size_t size) : data(data), size(size)
+    {
+    }
+
+    uint64_t fixed(int bytes)
+    {
+        if (size - at < (size_t)bytes)
+        {
+            failed = true;
+            return 0;
+        }
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++)
+            value |= (uint64_t)data[at++] << (8 * i);
+        return value;
+    }
+
+    double fixedDouble()
+    {
+        uint64_t bits = fixed(8);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    float fixedFloat()
+    {
+        uint32_t bits = (uint32_t)fixed(4);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (at >= size)
+                break;
+            unsigned char byte = data[at++];
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        failed = true;
+        return 0;
+    }
+
+    int64_t zigzag()
+    {
+        uint64_t value = varint();
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+};
+
+// Connects to a server at host:port and writes what it streams to path as a trace_event
+// trace, the frames' counters as counter tracks and the GPU zones on a thread of their own,
+// printing the frame time and counters once a second meanwhile. Runs until the server goes
+// away or, with frames above 0, that many frames are in; returns the exit code.
+// text as the inside of a JSON string, control characters turn into spaces
+inline std::string telemetryJsonEscape(const std::string &text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        if ((unsigned char)c < 0x20)
+            escaped += ' ';
+        else
+            escaped += c;
+    }
+    return escaped;
+}
+
+inline int telemetryToChromeTrace(const std::string &address, const std::string &path, int frames)
+{
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || !telemetrySocketsReady())
+    {
+        std::cout << "ERROR::TELEMETRY::BAD_ADDRESS: " << address << " (host:port)\n";
+        return 1;
+    }
+    std::string host = address.substr(0, colon), port = address.substr(colon + 1);
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = NULL;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+    {
+        std::cout << "ERROR::TELEMETRY::UNKNOWN_HOST: " << host << '\n';
+        return 1;
+    }
+    TelemetrySocket server = TELEMETRY_NO_SOCKET;
+    for (addrinfo *candidate = addresses; candidate && server == TELEMETRY_NO_SOCKET; candidate = candidate->ai_next)
+    {
+        server = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (server != TELEMETRY_NO_SOCKET && connect(server, candidate->ai_addr, (int)candidate->ai_addrlen) != 0)
+            closeTelemetrySocket(server);
+    }
+    freeaddrinfo(addresses);
+    if (server == TELEMETRY_NO_SOCKET)
+    {
+        std::cout << "ERROR::TELEMETRY::CANNOT_CONNECT: " << address << '\n';
+        return 1;
+    }
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cout << "ERROR::TELEMETRY::CANNOT_WRITE: " << path << '\n';
+        closeTelemetrySocket(server);
+        return 1;
+    }
+    std::cout << "telemetry: connected to " << address << ", writing " << path << '\n';
+    out.precision(3);
+    out << std::fixed << "{\"traceEvents\":[";
+    out << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << HitchDetector::GPU_TRACK
+        << ",\"args\":{\"name\":\"GPU\"}}";
+
+    std::vector<unsigned char> received;
+    std::vector<std::string> names;
+    uint64_t origin = 0, frameStart = 0;
+    double rate = 1.0;
+    int framesRead = 0;
+    // the summary printed once a second
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point lastPrint = Clock::now();
+    int printedFrames = 0;
+    double printedMs = 0.0;
+    uint64_t printedDraws = 0, printedTriangles = 0, printedDropped = 0;
+    auto microseconds = [&](uint64_t ticks) { return (double)(int64_t)(ticks - origin) / rate; };
+    auto zoneName = [&](uint64_t id) { return id < names.size() ? names[id] : std::string("?"); };
+
+    bool done = false;
+    char chunk[64 * 1024];
+    while (!done)
+    {
+        int length = (int)recv(server, chunk, sizeof(chunk), 0);
+        if (length <= 0)
+            break;
+        received.insert(received.end(), chunk, chunk + length);
+        size_t consumed = 0;
+        while (!done && received.size() - consumed >= 4)
+        {
+            TelemetryReader header(received.data() + consumed, 4);
+            size_t messageSize = (size_t)header.fixed(4);
+            if (received.size() - consumed - 4 < messageSize)
+                break;
+            TelemetryReader reader(received.data() + consumed + 4, messageSize);
+            consumed += 4 + messageSize;
+            switch (reader.fixed(1))
+            {
+            case TELEMETRY_HELLO:
+                if (reader.fixed(4) != TelemetryServer::VERSION)
+                {
+                    std::cout << "ERROR::TELEMETRY::VERSION_MISMATCH\n";
+                    done = true;
+                    break;
+                }
+                reader.fixed(4);
+                origin = reader.fixed(8);
+                rate = reader.fixedDouble();
+                break;
+            case TELEMETRY_NAME:
+            {
+                uint64_t id = reader.varint();
+                if (id >= names.size())
+                    names.resize(id + 1);
+                // the names only go into the trace, as JSON strings
+                names[id] = telemetryJsonEscape(
+                    std::string((const char *)reader.data + reader.at, reader.size - reader.at));
+                break;
+            }
+            case TELEMETRY_FRAME:
+            {
+                uint64_t start = reader.fixed(8), end = reader.fixed(8);
+                frameStart = start;
+                rate = reader.fixedDouble();
+                uint64_t values[10];
+                for (uint64_t &value : values)
+                    value = reader.varint();
+                uint64_t passes = reader.varint();
+                double ms = (double)(end - start) / rate * 1e-3;
+                out << ",\n{\"name\":\"frame\",\"ph\":\"C\",\"pid\":0,\"ts\":" << microseconds(start)
+                    << ",\"args\":{\"ms\":" << ms << ",\"draws\":" << values[0] << ",\"triangles\":" << values[1]
+                    << ",\"uniforms\":" << values[2] << ",\"state changes\":" << values[3]
+                    << ",\"gl calls\":" << values[4] << "}}";
+                out << ",\n{\"name\":\"memory\",\"ph\":\"C\",\"pid\":0,\"ts\":" << microseconds(start)
+                    << ",\"args\":{\"gpu MB\":" << (double)values[5] / (1024.0 * 1024.0)
+                    << ",\"driver free MB\":" << (double)values[6] / (1024.0 * 1024.0)
+                    << ",\"allocations\":" << values[7] << ",\"allocated KB\":" << (double)values[8] / 1024.0
+                    << "}}";
+                if (passes > 0 && !reader.failed)
+                {
+                    out << ",\n{\"name\":\"gpu passes\",\"ph\":\"C\",\"pid\":0,\"ts\":" << microseconds(start)
+                        << ",\"args\":{";
+                    for (uint64_t i = 0; i < passes && !reader.failed; i++)
+                    {
+                        std::string pass = zoneName(reader.varint());
+                        out << (i ? "," : "") << "\"" << pass << "\":" << reader.fixedFloat();
+                    }
+                    out << "}}";
+                }
+                printedFrames++;
+                printedMs += ms;
+                printedDraws += values[0];
+                printedTriangles += values[1];
+                printedDropped = values[9];
+                if (++framesRead >= frames && frames > 0)
+                    done = true;
+                break;
+            }
+            case TELEMETRY_ZONES:
+            {
+                uint64_t thread = reader.varint(), count = reader.varint();
+                // the first start is relative to the frame sent right before
+                uint64_t previous = frameStart;
+                for (uint64_t i = 0; i < count && !reader.failed; i++)
+                {
+                    std::string zone = zoneName(reader.varint());
+                    int64_t delta = reader.zigzag();
+                    uint64_t duration = reader.varint();
+                    uint64_t start = previous + (uint64_t)delta;
+                    previous = start;
+                    out << ",\n{\"name\":\"" << zone << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread
+                        << ",\"ts\":" << microseconds(start) << ",\"dur\":" << (double)duration / rate << "}";
+                }
+                break;
+            }
+            default:
+                break;
+            }
+            if (reader.failed)
+            {
+                std::cout << "ERROR::TELEMETRY::CORRUPT_MESSAGE\n";
+                done = true;
+            }
+        }
+        received.erase(received.begin(), received.begin() + consumed);
+        if (Clock::now() - lastPrint >= std::chrono::seconds(1) && printedFrames > 0)
+        {
+            std::cout << "telemetry: " << printedFrames << " frames, " << printedMs / printedFrames << " ms, "
+                      << printedDraws / printedFrames << " draws, " << printedTriangles / printedFrames
+                      << " triangles a frame, " << printedDropped << " dropped\n";
+            lastPrint = Clock::now();
+            printedFrames = 0;
+            printedMs = 0.0;
+            printedDraws = printedTriangles = 0;
+        }
+    }
+    closeTelemetrySocket(server);
+    out << "\n]}\n";
+    std::cout << "telemetry: " << framesRead << " frames written to " << path << '\n';
+    return 0;
+}
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef TEMPORAL_AA_H
+#define TEMPORAL_AA_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "frame_graph.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "mesh.cpp"
+#include "render_stats.cpp"
+#include "ring_buffer.cpp"
+#include "shader.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+// an instance that moved since the last frame, mirrors velocity.vs
+struct InstanceMotion
+{
+    glm::mat4 model;
+    glm::mat4 previousModel;
+};
+
+// Temporal anti-aliasing, and temporal upscaling when the frame is drawn smaller than the
+// output (dynamic_resolution.cpp): every frame's projection is moved by a different sub-pixel
+// offset of a Halton (2, 3) sequence, and resolve() accumulates the frames into a history at
+// the output's size (taa_resolve.fs), so a pixel converges to the average over its area
+// from one sample per frame. Upscaled, the sequence is longer as there are more output
+// pixels to cover per sample.
+// The history is reprojected along a velocity buffer: drawVelocities() draws the instances
+// that moved over the frame's depth with their current and last model matrices, the rest only
+// moved with the camera, which the resolve reconstructs from the depth and both frames'
+// view-projections. Ghosting is kept down by clipping the history to the color range of the
+// neighbourhood. Needs GL 4.3 for the storage buffer of the motions.
+class TemporalAA
+{
+  public:
+    static const unsigned int MOTION_BINDING = 7;
+
+    // weight of this frame at its sample
+    float feedback = 0.1f;
+    // depth of the frame, larger is nearer and the NDC z is the depth
+    bool reversedZ = false;
+
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    TemporalAA(RingBuffer &ring, Shader &velocityProgram, Shader &resolveProgram)
+        : ring(ring), velocityShader(velocityProgram), resolveShader(resolveProgram),
+          sampler(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)
+    {
+        emptyVAO = createVertexArray();
+        velocityFBO = createFramebuffer();
+        boundsCenterLoc = velocityShader.uniform("boundsCenter");
+        boundsExtentLoc = velocityShader.uniform("boundsExtent");
+        currentLoc = velocityShader.uniform("currentViewProjection");
+        previousLoc = velocityShader.uniform("previousViewProjection");
+        resolveShader.use();
+        resolveShader.setInt("current", 0);
+        resolveShader.setInt("history", 1);
+        resolveShader.setInt("velocities", 2);
+        resolveShader.setInt("depths", 3);
+        reprojectionLoc = resolveShader.uniform("reprojection");
+        jitterLoc = resolveShader.uniform("jitter");
+        paramsLoc = resolveShader.uniform("params");
+    }
+
+    ~TemporalAA()
+    {
+        glDeleteVertexArrays(1, &emptyVAO);
+        glDeleteFramebuffers(1, &velocityFBO);
+    }
+
+    TemporalAA(const TemporalAA &) = delete;
+    TemporalAA &operator=(const TemporalAA &) = delete;
+
+    // before this frame's projection is used, with the camera's unjittered view-projection;
+    // the frame is width x height, resolved to outputWidth x outputHeight
+    void beginFrame(const glm::mat4 &viewProjection, int width, int height, int outputWidth, int outputHeight)
+    {
+        previousViewProjection = frames > 0 ? currentViewProjection : viewProjection;
+        currentViewProjection = viewProjection;
+        renderWidth = std::max(1, width);
+        renderHeight = std::max(1, height);
+        float upscale = (float)outputWidth * outputHeight / ((float)renderWidth * renderHeight);
+        int phases = std::clamp((int)(8.0f * upscale + 0.5f), 8, 32);
+        frames++;
+        unsigned int index = (unsigned int)(frames % (uint64_t)phases) + 1;
+        jitterPixels = glm::vec2(halton(index, 2) - 0.5f, halton(index, 3) - 0.5f);
+    }
+
+    // the projection moved by this frame's jitter
+    glm::mat4 jitter(const glm::mat4 &projection) const
+    {
+        glm::vec3 offset(jitterPixels.x * 2.0f / renderWidth, jitterPixels.y * 2.0f / renderHeight, 0.0f);
+        return glm::translate(glm::mat4(1.0f), offset) * projection;
+    }
+
+    // the motions of the instances of mesh over depth, after the opaque geometry;
+    // leaves sceneFBO bound again
+    void drawVelocities(const Texture2D &depth, const Mesh &mesh, const std::vector<InstanceMotion> &motions,
+                        unsigned int sceneFBO)
+    {
+        if (velocity.width != depth.width || velocity.height != depth.height || depthID != depth.ID)
+            resizeVelocities(depth);
+        glBindFramebuffer(GL_FRAMEBUFFER, velocityFBO);
+        glViewport(0, 0, velocity.width, velocity.height);
+        // what isn't drawn moved with the camera, see NO_VELOCITY in taa_resolve.fs
+        const float none[4] = {2.0f, 2.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, none);
+
+        GLintptr offset = motions.empty() ? -1
+                                          : ring.push(motions.data(), motions.size() * sizeof(InstanceMotion),
+                                                      ring.storageAlignment);
+        if (offset >= 0)
+        {
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, MOTION_BINDING, ring.ID, offset,
+                                    motions.size() * sizeof(InstanceMotion));
+            velocityShader.use();
+            velocityShader.set(boundsCenterLoc, mesh.boundsCenter);
+            velocityShader.set(boundsExtentLoc, mesh.boundsExtent);
+            velocityShader.set(currentLoc, currentViewProjection);
+            velocityShader.set(previousLoc, previousViewProjection);
+            // on the depth the shading left, pulled a little towards the camera in case two
+            // programs don't agree on it to the bit
+            glState.enable(GL_DEPTH_TEST);
+            glState.setDepthMask(false);
+            glState.setDepthFunc(reversedZ ? GL_GEQUAL : GL_LEQUAL);
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(reversedZ ? 1.0f : -1.0f, reversedZ ? 1.0f : -1.0f);
+            mesh.bind();
+            renderStats.countDraw((size_t)mesh.indexCount, motions.size());
+            mesh.drawInstanced((GLsizei)motions.size());
+            glDisable(GL_POLYGON_OFFSET_FILL);
+            glState.setDepthFunc(reversedZ ? GL_GREATER : GL_LESS);
+            glState.setDepthMask(true);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    }
+
+    // accumulates color (drawn over depth with this frame's jitter) into the history at
+    // outputWidth x outputHeight, output() is the result
+    void resolve(const Texture2D &color, const Texture2D &depth, int outputWidth, int outputHeight)
+    {
+        if (!history[0] || history[0]->width != outputWidth || history[0]->height != outputHeight)
+        {
+            for (RenderTargetPool::Target *&target : history)
+            {
+                targets.release(target);
+                target = targets.acquire(outputWidth, outputHeight, GL_RGBA16F);
+            }
+            historyValid = false;
+        }
+        targets.endFrame();
+        if (!history[0] || !history[1] || !velocity.ID)
+            return;
+        RenderTargetPool::Target *previous = history[latest], *next = history[1 - latest];
+
+        glBindFramebuffer(GL_FRAMEBUFFER, next->FBO);
+        glViewport(0, 0, outputWidth, outputHeight);
+        glState.disable(GL_DEPTH_TEST);
+        glState.setDepthMask(false);
+        glState.disable(GL_BLEND);
+        glState.bindVertexArray(emptyVAO);
+        resolveShader.use();
+        const Texture2D *inputs[] = {&color, &previous->color, &velocity, &depth};
+        for (unsigned int unit = 0; unit < 4; unit++)
+        {
+            inputs[unit]->bind(unit);
+            sampler.bind(unit);
+        }
+        resolveShader.set(reprojectionLoc, previousViewProjection * glm::inverse(currentViewProjection));
+        resolveShader.set(jitterLoc, jitterPixels);
+        resolveShader.set(paramsLoc, glm::vec4(feedback, historyValid ? 1.0f : 0.0f, reversedZ ? 1.0f : 0.0f, 0.0f));
+        renderStats.countDraw(3);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glState.setDepthMask(true);
+        glState.enable(GL_DEPTH_TEST);
+
+        latest = 1 - latest;
+        historyValid = true;
+    }
+
+    // the screen space motion drawVelocities() drew last, in UV units
+    const Texture2D &velocities() const
+    {
+        return velocity;
+    }
+
+    // the last resolve(), NULL before the first one
+    const RenderTargetPool::Target *output() const
+    {
+        return historyValid ? history[latest] : NULL;
+    }
+
+    // copies output() to the default framebuffer and leaves that bound
+    void blitToDefault() const
+    {
+        const RenderTargetPool::Target *target = output();
+        if (!target)
+            return;
+        if (hasDSA())
+        {
+            glBlitNamedFramebuffer(target->FBO, 0, 0, 0, target->width, target->height, 0, 0, target->width,
+                                   target->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        else
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, target->FBO);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, target->width, target->height, 0, 0, target->width, target->height,
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+  private:
+    RingBuffer &ring;
+    Shader &velocityShader, &resolveShader;
+    UniformHandle boundsCenterLoc, boundsExtentLoc, currentLoc, previousLoc;
+    UniformHandle reprojectionLoc, jitterLoc, paramsLoc;
+    Sampler sampler;
+    unsigned int emptyVAO = 0;
+
+    // RG16F over the frame's depth
+    Texture2D velocity;
+    unsigned int velocityFBO = 0;
+    unsigned int depthID = 0;
+
+    RenderTargetPool targets;
+    RenderTargetPool::Target *history[2] = {};
+    int latest = 0;
+    bool historyValid = false;
+
+    glm::mat4 currentViewProjection = glm::mat4(1.0f), previousViewProjection = glm::mat4(1.0f);
+    glm::vec2 jitterPixels = glm::vec2(0.0f);
+    int renderWidth = 1, renderHeight = 1;
+    uint64_t frames = 0;
+
+    static float halton(unsigned int index, unsigned int base)
+    {
+        float result = 0.0f, fraction = 1.0f;
+        for (; index > 0; index /= base)
+        {
+            fraction /= (float)base;
+            result += fraction * (float)(index % base);
+        }
+        return result;
+    }
+
+    void resizeVelocities(const Texture2D &depth)
+    {
+        velocity.create(depth.width, depth.height, GL_RG16F, 1, GPU_MEMORY_RENDER_TARGETS);
+        depthID = depth.ID;
+        GLenum status;
+        if (hasDSA())
+        {
+            glNamedFramebufferTexture(velocityFBO, GL_COLOR_ATTACHMENT0, velocity.ID, 0);
+            glNamedFramebufferTexture(velocityFBO, GL_DEPTH_ATTACHMENT, depth.ID, 0);
+            status = glCheckNamedFramebufferStatus(velocityFBO, GL_FRAMEBUFFER);
+        }
+        else
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, velocityFBO);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, velocity.ID, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth.ID, 0);
+            status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        }
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::TEMPORAL_AA::INCOMPLETE: 0x" << std::hex << status << std::dec << '\n';
+    }
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "cdlod_grid.cpp"
+#include "frustum_culler.cpp"
+#include "ring_buffer.cpp"
+#include "shader.cpp"
+#include "texture.cpp"
+
+// Heightmap terrain drawn with CDLOD over its square (see cdlod_grid.cpp).
+// terrain.vs reads the heights from the height map and morphs each node towards the next
+// coarser grid over the far end of its range, so neighbouring levels meet without cracks.
+// drawFeedback() draws the same nodes through a second program over terrain.vs, the
+// virtual texture's feedback pass (see virtual_texture.cpp).
+class Terrain
+{
+  public:
+    static const unsigned int HEIGHT_UNIT = 2;
+
+    // the terrain spans [origin.x, origin.x + size] x [origin.z, origin.z + size], heights
+    // from origin.y to origin.y + heightScale
+    glm::vec3 origin = glm::vec3(-128.0f, -8.0f, -128.0f);
+    float size = 256.0f;
+    float heightScale = 10.0f;
+    // towards the sun, for terrain.fs
+    glm::vec3 sunDirection = glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f));
+    // its levels and ranges, the square and heights are taken from the above by select()
+    CdlodGrid grid;
+
+    Terrain(RingBuffer &ring, Shader &program, const Texture2D &heightMap)
+        : grid(ring), heightMap(heightMap),
+          sampler(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)
+    {
+        setup(shading, program);
+    }
+
+    Terrain(const Terrain &) = delete;
+    Terrain &operator=(const Terrain &) = delete;
+
+    void setFeedbackProgram(Shader &program)
+    {
+        setup(feedback, program);
+    }
+
+    // the nodes to draw from camera, the ones outside frustum are skipped
+    void select(const glm::vec3 &camera, const Frustum &frustum)
+    {
+        grid.origin = origin;
+        grid.size = size;
+        grid.height = heightScale;
+        grid.select(camera, frustum);
+    }
+
+    // every selected node in one instanced draw
+    void draw()
+    {
+        draw(shading);
+    }
+
+    // the selected nodes through the feedback program, nothing without one
+    void drawFeedback()
+    {
+        if (feedback.shader)
+            draw(feedback);
+    }
+
+    // for what is placed on the terrain, its red channel is the height over origin.y in
+    // heightScale units
+    const Texture2D &heights() const
+    {
+        return heightMap;
+    }
+
+  private:
+    // a program over terrain.vs and its uniforms
+    struct Program
+    {
+        Shader *shader = NULL;
+        UniformHandle terrain, baseHeight, morphRanges, sunDirection;
+    };
+
+    const Texture2D &heightMap;
+    Sampler sampler;
+    Program shading, feedback;
+
+    void setup(Program &target, Shader &program)
+    {
+        target.shader = &program;
+        CdlodGrid::setup(program);
+        program.setInt("heightMap", HEIGHT_UNIT);
+        target.terrain = program.uniform("terrain");
+        target.baseHeight = program.uniform("baseHeight");
+        target.morphRanges = program.uniform("morphRanges");
+        target.sunDirection = program.uniform("sunDirection");
+    }
+
+    void draw(const Program &target)
+    {
+        if (grid.selected == 0)
+            return;
+        Shader &program = *target.shader;
+        program.use();
+        program.set(target.terrain, glm::vec4(origin.x, origin.z, size, heightScale));
+        program.set(target.baseHeight, origin.y);
+        program.set(target.sunDirection, sunDirection);
+        heightMap.bind(HEIGHT_UNIT);
+        sampler.bind(HEIGHT_UNIT);
+        grid.draw(program, target.morphRanges);
+    }
+};
+
+#endif
@@ -0,0 +1,571 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include "glad/glad.h"
+
+#include "gl_debug.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "gpu_memory.cpp"
+#include "render_stats.cpp"
+
+#include <algorithm>
+
+// A 2D texture with immutable storage: all mip levels are allocated once by
+// glTexStorage2D, so the driver never has to revalidate or reallocate the texture.
+// On GL 4.5 everything goes through DSA (glCreateTextures, glTextureSubImage2D, ...)
+// and never touches the texture bindings, older contexts bind to edit.
+// Sampling state lives in Sampler objects, not in the texture.
+class Texture2D
+{
+  public:
+    unsigned int ID = 0;
+    int width = 0, height = 0;
+    int levels = 0;
+    GLenum internalFormat = 0;
+    // false when ID is borrowed from another texture (see alias())
+    bool owner = true;
+    // what its storage counts as in gpuMemory
+    GpuMemoryCategory category = GPU_MEMORY_TEXTURES;
+
+    Texture2D()
+    {
+    }
+
+    // allocates storage, levels = 0 means the full mip chain
+    Texture2D(int width, int height, GLenum internalFormat, int levels = 0,
+              GpuMemoryCategory category = GPU_MEMORY_TEXTURES)
+    {
+        create(width, height, internalFormat, levels, category);
+    }
+
+    ~Texture2D()
+    {
+        release();
+    }
+
+    Texture2D(const Texture2D &) = delete;
+    Texture2D &operator=(const Texture2D &) = delete;
+
+    Texture2D(Texture2D &&other) noexcept
+    {
+        *this = std::move(other);
+    }
+    Texture2D &operator=(Texture2D &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            ID = other.ID;
+            width = other.width;
+            height = other.height;
+            levels = other.levels;
+            internalFormat = other.internalFormat;
+            owner = other.owner;
+            category = other.category;
+            other.ID = 0;
+        }
+        return *this;
+    }
+
+    static int mipCount(int width, int height)
+    {
+        int count = 1;
+        int size = std::max(width, height);
+        while (size > 1)
+        {
+            size /= 2;
+            count++;
+        }
+        return count;
+    }
+
+    static bool hasDSA()
+    {
+        return ::hasDSA();
+    }
+
+    void create(int w, int h, GLenum format, int levelCount = 0, GpuMemoryCategory memory = GPU_MEMORY_TEXTURES)
+    {
+        release();
+        width = w;
+        height = h;
+        internalFormat = format;
+        levels = levelCount > 0 ? levelCount : mipCount(w, h);
+        owner = true;
+        category = memory;
+
+        if (hasDSA())
+        {
+            glCreateTextures(GL_TEXTURE_2D, 1, &ID);
+            GL_CHECK(glTextureStorage2D(ID, levels, internalFormat, width, height));
+        }
+        else
+        {
+            glGenTextures(1, &ID);
+            bindForEdit();
+            GL_CHECK(glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height));
+        }
+        gpuMemory.allocate(category, RenderStats::storageBytes(internalFormat, width, height, 1, levels));
+    }
+
+    // shares another texture's storage without owning it, e.g. a placeholder
+    void alias(const Texture2D &other)
+    {
+        release();
+        ID = other.ID;
+        width = other.width;
+        height = other.height;
+        levels = other.levels;
+        internalFormat = other.internalFormat;
+        owner = false;
+    }
+
+    // uploads a whole level, data may be an offset into the bound GL_PIXEL_UNPACK_BUFFER
+    void upload(int level, GLenum format, GLenum type, const void *data)
+    {
+        uploadRegion(level, 0, 0, std::max(1, width >> level), std::max(1, height >> level), format, type, data);
+    }
+
+    // uploads a w x h rectangle of a level, used by the TextureAtlas
+    void uploadRegion(int level, int x, int y, int w, int h, GLenum format, GLenum type, const void *data)
+    {
+        if (hasDSA())
+        {
+            glTextureSubImage2D(ID, level, x, y, w, h, format, type, data);
+        }
+        else
+        {
+            bindForEdit();
+            glTexSubImage2D(GL_TEXTURE_2D, level, x, y, w, h, format, type, data);
+        }
+    }
+
+    // same for block compressed formats matching internalFormat
+    void uploadCompressed(int level, size_t size, const void *data)
+    {
+        int w = std::max(1, width >> level), h = std::max(1, height >> level);
+        if (hasDSA())
+        {
+            glCompressedTextureSubImage2D(ID, level, 0, 0, w, h, internalFormat, (GLsizei)size, data);
+        }
+        else
+        {
+            bindForEdit();
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, w, h, internalFormat, (GLsizei)size, data);
+        }
+    }
+
+    // fills levels 1..n from level 0
+    void generateMipmaps()
+    {
+        if (hasDSA())
+        {
+            glGenerateTextureMipmap(ID);
+        }
+        else
+        {
+            bindForEdit();
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+    }
+
+    // reads a whole level back into bytes at data, waits for the GPU
+    void download(int level, GLenum format, GLenum type, size_t bytes, void *data)
+    {
+        if (hasDSA())
+        {
+            glGetTextureImage(ID, level, format, type, (GLsizei)bytes, data);
+        }
+        else
+        {
+            bindForEdit();
+            glGetTexImage(GL_TEXTURE_2D, level, format, type, data);
+        }
+    }
+
+    void bind(unsigned int unit) const
+    {
+        glState.bindTexture(unit, GL_TEXTURE_2D, ID);
+    }
+
+  private:
+    void release()
+    {
+        if (ID && owner)
+        {
+            glDeleteTextures(1, &ID);
+            gpuMemory.release(category, RenderStats::storageBytes(internalFormat, width, height, 1, levels));
+        }
+        ID = 0;
+    }
+
+    // the non DSA path edits through the current unit, the state cache has to forget it
+    void bindForEdit()
+    {
+        glBindTexture(GL_TEXTURE_2D, ID);
+        glState.invalidate();
+    }
+};
+
+// Same-size images as layers of one GL_TEXTURE_2D_ARRAY with immutable storage.
+// Shaders pick the layer per draw or per instance, so objects that only differ
+// by their texture share one bind and can be merged into one draw call.
+// Layer contents are undefined until uploaded.
+class Texture2DArray
+{
+  public:
+    unsigned int ID = 0;
+    int width = 0, height = 0;
+    int layers = 0;
+    int levels = 0;
+    GLenum internalFormat = 0;
+    GpuMemoryCategory category = GPU_MEMORY_TEXTURES;
+
+    Texture2DArray()
+    {
+    }
+
+    // levels = 0 means the full mip chain
+    Texture2DArray(int width, int height, int layers, GLenum internalFormat, int levels = 0,
+                   GpuMemoryCategory category = GPU_MEMORY_TEXTURES)
+    {
+        create(width, height, layers, internalFormat, levels, category);
+    }
+
+    ~Texture2DArray()
+    {
+        release();
+    }
+
+    Texture2DArray(const Texture2DArray &) = delete;
+    Texture2DArray &operator=(const Texture2DArray &) = delete;
+
+    Texture2DArray(Texture2DArray &&other) noexcept
+    {
+        *this = std::move(other);
+    }
+    Texture2DArray &operator=(Texture2DArray &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            ID = other.ID;
+            width = other.width;
+            height = other.height;
+            layers = other.layers;
+            levels = other.levels;
+            internalFormat = other.internalFormat;
+            category = other.category;
+            other.ID = 0;
+        }
+        return *this;
+    }
+
+    void create(int w, int h, int layerCount, GLenum format, int levelCount = 0,
+                GpuMemoryCategory memory = GPU_MEMORY_TEXTURES)
+    {
+        release();
+        width = w;
+        height = h;
+        layers = layerCount;
+        internalFormat = format;
+        levels = levelCount > 0 ? levelCount : Texture2D::mipCount(w, h);
+        category = memory;
+
+        if (Texture2D::hasDSA())
+        {
+            glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &ID);
+            GL_CHECK(glTextureStorage3D(ID, levels, internalFormat, width, height, layers));
+        }
+        else
+        {
+            glGenTextures(1, &ID);
+            bindForEdit();
+            GL_CHECK(glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, layers));
+        }
+        gpuMemory.allocate(category, RenderStats::storageBytes(internalFormat, width, height, layers, levels));
+    }
+
+    // uploads a whole level of one layer, data may be an offset into the bound GL_PIXEL_UNPACK_BUFFER
+    void upload(int layer, int level, GLenum format, GLenum type, const void *data)
+    {
+        int w = std::max(1, width >> level), h = std::max(1, height >> level);
+        if (Texture2D::hasDSA())
+        {
+            glTextureSubImage3D(ID, level, 0, 0, layer, w, h, 1, format, type, data);
+        }
+        else
+        {
+            bindForEdit();
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, format, type, data);
+        }
+    }
+
+    // a whole level of every layer in a block compressed format matching internalFormat, the
+    // layers one after the other
+    void uploadCompressed(int level, size_t size, const void *data)
+    {
+        int w = std::max(1, width >> level), h = std::max(1, height >> level);
+        if (Texture2D::hasDSA())
+        {
+            glCompressedTextureSubImage3D(ID, level, 0, 0, 0, w, h, layers, internalFormat, (GLsizei)size, data);
+        }
+        else
+        {
+            bindForEdit();
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, w, h, layers, internalFormat, (GLsizei)size,
+                                      data);
+        }
+    }
+
+    // rebuilds levels 1..n of every layer
+    void generateMipmaps()
+    {
+        if (Texture2D::hasDSA())
+        {
+            glGenerateTextureMipmap(ID);
+        }
+        else
+        {
+            bindForEdit();
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        }
+    }
+
+    void bind(unsigned int unit) const
+    {
+        glState.bindTexture(unit, GL_TEXTURE_2D_ARRAY, ID);
+    }
+
+  private:
+    void release()
+    {
+        if (ID)
+        {
+            glDeleteTextures(1, &ID);
+            gpuMemory.release(category, RenderStats::storageBytes(internalFormat, width, height, layers, levels));
+        }
+        ID = 0;
+    }
+
+    void bindForEdit()
+    {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+        glState.invalidate();
+    }
+};
+
+// The six square faces of a GL_TEXTURE_CUBE_MAP with immutable storage, face i is
+// GL_TEXTURE_CUBE_MAP_POSITIVE_X + i. Sampled seamlessly across the faces once
+// GL_TEXTURE_CUBE_MAP_SEAMLESS is enabled. Face contents are undefined until uploaded.
+class TextureCube
+{
+  public:
+    static const int FACES = 6;
+
+    unsigned int ID = 0;
+    int size = 0;
+    int levels = 0;
+    GLenum internalFormat = 0;
+    GpuMemoryCategory category = GPU_MEMORY_TEXTURES;
+
+    TextureCube()
+    {
+    }
+
+    ~TextureCube()
+    {
+        release();
+    }
+
+    TextureCube(const TextureCube &) = delete;
+    TextureCube &operator=(const TextureCube &) = delete;
+
+    // levels = 0 means the full mip chain
+    void create(int faceSize, GLenum format, int levelCount = 0, GpuMemoryCategory memory = GPU_MEMORY_TEXTURES)
+    {
+        release();
+        size = faceSize;
+        internalFormat = format;
+        levels = levelCount > 0 ? levelCount : Texture2D::mipCount(size, size);
+        category = memory;
+
+        if (Texture2D::hasDSA())
+        {
+            glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &ID);
+            GL_CHECK(glTextureStorage2D(ID, levels, internalFormat, size, size));
+        }
+        else
+        {
+            glGenTextures(1, &ID);
+            bindForEdit();
+            GL_CHECK(glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, internalFormat, size, size));
+        }
+        gpuMemory.allocate(category, RenderStats::storageBytes(internalFormat, size, size, FACES, levels));
+    }
+
+    // uploads a whole level of one face
+    void upload(int face, int level, GLenum format, GLenum type, const void *data)
+    {
+        int w = std::max(1, size >> level);
+        if (Texture2D::hasDSA())
+        {
+            glTextureSubImage3D(ID, level, 0, 0, face, w, w, 1, format, type, data);
+        }
+        else
+        {
+            bindForEdit();
+            glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, w, w, format, type, data);
+        }
+    }
+
+    // reads a whole level of one face back into bytes at data, waits for the GPU
+    void download(int face, int level, GLenum format, GLenum type, size_t bytes, void *data)
+    {
+        int w = std::max(1, size >> level);
+        if (Texture2D::hasDSA())
+        {
+            glGetTextureSubImage(ID, level, 0, 0, face, w, w, 1, format, type, (GLsizei)bytes, data);
+        }
+        else
+        {
+            bindForEdit();
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, format, type, data);
+        }
+    }
+
+    // rebuilds levels 1..n of every face
+    void generateMipmaps()
+    {
+        if (Texture2D::hasDSA())
+        {
+            glGenerateTextureMipmap(ID);
+        }
+        else
+        {
+            bindForEdit();
+            glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        }
+    }
+
+    void bind(unsigned int unit) const
+    {
+        glState.bindTexture(unit, GL_TEXTURE_CUBE_MAP, ID);
+    }
+
+  private:
+    void release()
+    {
+        if (ID)
+        {
+            glDeleteTextures(1, &ID);
+            gpuMemory.release(category, RenderStats::storageBytes(internalFormat, size, size, FACES, levels));
+        }
+        ID = 0;
+    }
+
+    void bindForEdit()
+    {
+        glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
+        glState.invalidate();
+    }
+};
+
+// A GL_TEXTURE_3D with immutable storage and one level, written by compute shaders through
+// image stores and sampled with filtering across all three axes. Contents are undefined
+// until written.
+class Texture3D
+{
+  public:
+    unsigned int ID = 0;
+    int width = 0, height = 0, depth = 0;
+    GLenum internalFormat = 0;
+    GpuMemoryCategory category = GPU_MEMORY_TEXTURES;
+
+    Texture3D()
+    {
+    }
+
+    ~Texture3D()
+    {
+        release();
+    }
+
+    Texture3D(const Texture3D &) = delete;
+    Texture3D &operator=(const Texture3D &) = delete;
+
+    void create(int w, int h, int d, GLenum format, GpuMemoryCategory memory = GPU_MEMORY_TEXTURES)
+    {
+        release();
+        width = w;
+        height = h;
+        depth = d;
+        internalFormat = format;
+        category = memory;
+
+        if (Texture2D::hasDSA())
+        {
+            glCreateTextures(GL_TEXTURE_3D, 1, &ID);
+            GL_CHECK(glTextureStorage3D(ID, 1, internalFormat, width, height, depth));
+        }
+        else
+        {
+            glGenTextures(1, &ID);
+            glBindTexture(GL_TEXTURE_3D, ID);
+            glState.invalidate();
+            GL_CHECK(glTexStorage3D(GL_TEXTURE_3D, 1, internalFormat, width, height, depth));
+        }
+        gpuMemory.allocate(category, RenderStats::storageBytes(internalFormat, width, height, depth, 1));
+    }
+
+    void bind(unsigned int unit) const
+    {
+        glState.bindTexture(unit, GL_TEXTURE_3D, ID);
+    }
+
+  private:
+    void release()
+    {
+        if (ID)
+        {
+            glDeleteTextures(1, &ID);
+            gpuMemory.release(category, RenderStats::storageBytes(internalFormat, width, height, depth, 1));
+        }
+        ID = 0;
+    }
+};
+
+// Sampling state as a separate GL object, shared by any number of textures
+class Sampler
+{
+  public:
+    unsigned int ID = 0;
+
+    Sampler(GLenum minFilter, GLenum magFilter, GLenum wrapS, GLenum wrapT)
+    {
+        if (Texture2D::hasDSA())
+            glCreateSamplers(1, &ID);
+        else
+            glGenSamplers(1, &ID);
+        glSamplerParameteri(ID, GL_TEXTURE_MIN_FILTER, minFilter);
+        glSamplerParameteri(ID, GL_TEXTURE_MAG_FILTER, magFilter);
+        glSamplerParameteri(ID, GL_TEXTURE_WRAP_S, wrapS);
+        glSamplerParameteri(ID, GL_TEXTURE_WRAP_T, wrapT);
+    }
+
+    ~Sampler()
+    {
+        glDeleteSamplers(1, &ID);
+    }
+
+    Sampler(const Sampler &) = delete;
+    Sampler &operator=(const Sampler &) = delete;
+
+    void bind(unsigned int unit) const
+    {
+        glState.bindSampler(unit, ID);
+    }
+};
+
+#endif
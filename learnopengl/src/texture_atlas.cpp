@@ -0,0 +1,108 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "texture.cpp"
+
+#include <algorithm>
+#include <vector>
+
+// where an image ended up inside the atlas,
+// shaders map a texture coordinate with uvRect.xy + uv * uvRect.zw
+struct AtlasRegion
+{
+    int x = 0, y = 0;
+    int width = 0, height = 0;
+    glm::vec4 uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+};
+
+// Shelf packing of rectangles into a width x height area: rectangles go left to right on the
+// current row and a new row starts above the tallest one so far, which works well when they
+// are added tallest first. Every rectangle gets a border of padding units. Needs no GL, the
+// lightmap unwrap packs its charts with it (see lightmap_baker.cpp).
+struct ShelfPacker
+{
+    int width = 0, height = 0;
+    int padding = 0;
+
+    ShelfPacker(int width = 0, int height = 0, int padding = 0) : width(width), height(height), padding(padding)
+    {
+    }
+
+    // the corner of a w x h rectangle inside its border, false when the area is full
+    bool pack(int w, int h, int &x, int &y)
+    {
+        int paddedWidth = w + 2 * padding, paddedHeight = h + 2 * padding;
+        if (shelfX + paddedWidth > width)
+        {
+            // next shelf
+            shelfY += shelfHeight;
+            shelfX = 0;
+            shelfHeight = 0;
+        }
+        if (paddedWidth > width || shelfY + paddedHeight > height)
+            return false;
+        x = shelfX + padding;
+        y = shelfY + padding;
+        shelfX += paddedWidth;
+        shelfHeight = std::max(shelfHeight, paddedHeight);
+        return true;
+    }
+
+  private:
+    int shelfX = 0, shelfY = 0, shelfHeight = 0;
+};
+
+// Packs images of different sizes into one Texture2D, for textures that
+// can't share a Texture2DArray because their sizes don't match, with a ShelfPacker.
+// Every image gets a border of padding texels, keep the mip count low enough
+// (about log2(padding) + 1 levels) that neighbours don't bleed into each other.
+class TextureAtlas
+{
+  public:
+    Texture2D texture;
+    std::vector<AtlasRegion> regions;
+
+    TextureAtlas(int width, int height, GLenum internalFormat = GL_RGBA8, int levels = 1, int padding = 2)
+        : texture(width, height, internalFormat, levels), shelves(width, height, padding)
+    {
+    }
+
+    // reserves space for a width x height image, returns false when the atlas is full
+    bool pack(int width, int height, AtlasRegion &region)
+    {
+        if (!shelves.pack(width, height, region.x, region.y))
+            return false;
+        region.width = width;
+        region.height = height;
+        region.uvRect = glm::vec4((float)region.x / texture.width, (float)region.y / texture.height,
+                                  (float)width / texture.width, (float)height / texture.height);
+        regions.push_back(region);
+        return true;
+    }
+
+    // packs and uploads level 0 of an image, tightly packed rows are expected
+    bool add(int width, int height, GLenum format, GLenum type, const void *data, AtlasRegion &region)
+    {
+        if (!pack(width, height, region))
+            return false;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        texture.uploadRegion(0, region.x, region.y, width, height, format, type, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        return true;
+    }
+
+    // builds the lower levels once every image is in
+    void finish()
+    {
+        if (texture.levels > 1)
+            texture.generateMipmaps();
+    }
+
+  private:
+    ShelfPacker shelves;
+};
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "glad/glad.h"
+
+#include "asset_pack.cpp"
+#include "dds_texture.cpp"
+#include "hash.cpp"
+#include "mapped_file.cpp"
+#include "texture_cooker.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// a cache entry mapped for upload, levels point into file finest first
+struct CachedTexture
+{
+    MappedFile file;
+    int width = 0, height = 0;
+    GLenum internalFormat = GL_RGBA8;
+    bool compressed = false;
+    std::vector<CompressedLevel> levels;
+};
+
+// On-disk cache of decoded source textures with their whole mip chain, for the textures that
+// have no cooked DDS (see texture_cooker.cpp), so later launches map the levels and upload
+// them without decoding or glGenerateMipmap. Entries are named by the source path and the
+// load options and hold the hash of the source's contents: a source whose size and time
+// still match is a hit right away, one that changed is hashed again and is only a miss when
+// its contents did. Levels are RGBA8, or BC1/BC3 with compress set.
+class TextureCache
+{
+  public:
+    // bumped whenever the file layout or the level contents change
+    static const uint32_t VERSION = 1;
+
+    std::string directory;
+    // BC1/BC3 levels instead of RGBA8, only when the driver samples S3TC
+    bool compress = false;
+
+    TextureCache(const std::string &directory = "cache/textures") : directory(directory)
+    {
+    }
+
+    // maps the entry of a loose source file, NULL on a miss. Thread safe
+    std::shared_ptr<CachedTexture> load(const std::string &sourcePath, bool flip) const
+    {
+        Source source;
+        if (!stat(sourcePath, source))
+            return NULL;
+        std::string entryPath = path(sourcePath, flip);
+        std::shared_ptr<CachedTexture> cached = std::make_shared<CachedTexture>();
+        if (!cached->file.open(entryPath) || cached->file.size < sizeof(Header))
+            return NULL;
+        Header header;
+        std::memcpy(&header, cached->file.data, sizeof(header));
+        if (header.magic != MAGIC || header.version != VERSION || header.compressed != (compress ? 1u : 0u))
+            return NULL;
+        if (header.sourceSize != source.size || header.sourceTime != source.time)
+        {
+            // touched, checked out again or edited: only the contents tell
+            std::vector<unsigned char> bytes;
+            if (!readFileContents(sourcePath, bytes) || fnv1a64(bytes.data(), bytes.size()) != header.contentHash)
+                return NULL;
+            cached->file.close();
+            refresh(entryPath, source);
+            if (!cached->file.open(entryPath))
+                return NULL;
+        }
+
+        size_t tableEnd = sizeof(Header) + (size_t)header.levelCount * sizeof(LevelEntry);
+        if (header.levelCount == 0 || cached->file.size < tableEnd)
+            return NULL;
+        cached->width = (int)header.width;
+        cached->height = (int)header.height;
+        cached->internalFormat = header.internalFormat;
+        cached->compressed = header.compressed != 0;
+        const LevelEntry *entries = (const LevelEntry *)(cached->file.data + sizeof(Header));
+        for (uint32_t i = 0; i < header.levelCount; i++)
+        {
+            LevelEntry entry;
+            std::memcpy(&entry, &entries[i], sizeof(entry));
+            if (entry.offset < tableEnd || entry.offset + entry.size > cached->file.size)
+                return NULL;
+            cached->levels.push_back({std::max(1, cached->width >> i), std::max(1, cached->height >> i),
+                                      (size_t)entry.offset, (size_t)entry.size});
+        }
+        cached->file.willNeed(tableEnd, cached->file.size - tableEnd);
+        return cached;
+    }
+
+    // builds the mip chain of freshly decoded RGBA8 pixels, flipped as they are uploaded, and
+    // writes the entry, returns false when the source or the entry can't be read or written. Thread safe
+    bool store(const std::string &sourcePath, bool flip, const unsigned char *rgba, int width, int height) const
+    {
+        Source source;
+        std::vector<unsigned char> bytes;
+        if (!stat(sourcePath, source) || !readFileContents(sourcePath, bytes))
+            return false;
+
+        bool alpha = false;
+        for (size_t i = 3; i < (size_t)width * height * 4 && !alpha; i += 4)
+            alpha = rgba[i] != 255;
+
+        Header header = {};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.sourceSize = source.size;
+        header.sourceTime = source.time;
+        header.contentHash = fnv1a64(bytes.data(), bytes.size());
+        header.width = (uint32_t)width;
+        header.height = (uint32_t)height;
+        header.compressed = compress ? 1 : 0;
+        header.internalFormat = GL_RGBA8;
+        if (compress)
+            header.internalFormat = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+        std::vector<LevelEntry> entries;
+        std::vector<unsigned char> payload;
+        std::vector<unsigned char> level(rgba, rgba + (size_t)width * height * 4);
+        int w = width, h = height;
+        for (;;)
+        {
+            size_t offset = payload.size();
+            if (compress)
+                cooker::compressLevel(level.data(), w, h, alpha, payload);
+            else
+                payload.insert(payload.end(), level.begin(), level.end());
+            entries.push_back({(uint64_t)offset, (uint64_t)(payload.size() - offset)});
+            if (w == 1 && h == 1)
+                break;
+            level = cooker::downsample(level, w, h);
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+        }
+        header.levelCount = (uint32_t)entries.size();
+        uint64_t payloadStart = sizeof(Header) + entries.size() * sizeof(LevelEntry);
+        for (LevelEntry &entry : entries)
+            entry.offset += payloadStart;
+
+        // written aside and renamed, a reader never maps half an entry
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::string entryPath = path(sourcePath, flip);
+        std::string temporary =
+            entryPath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                std::cout << "ERROR::TEXTURE_CACHE::COULD_NOT_WRITE: " << entryPath << '\n';
+                return false;
+            }
+            file.write((const char *)&header, sizeof(header));
+            file.write((const char *)entries.data(), entries.size() * sizeof(LevelEntry));
+            file.write((const char *)payload.data(), payload.size());
+            if (!file)
+            {
+                std::cout << "ERROR::TEXTURE_CACHE::COULD_NOT_WRITE: " << entryPath << '\n';
+                return false;
+            }
+        }
+        std::filesystem::rename(temporary, entryPath, error);
+        if (error)
+        {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    static const uint32_t MAGIC = 0x43585454; // "TTXC"
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t contentHash;
+        uint32_t width, height;
+        uint32_t internalFormat;
+        uint32_t compressed;
+        uint32_t levelCount;
+        uint32_t padding;
+    };
+    // where a level is in the file, from its start
+    struct LevelEntry
+    {
+        uint64_t offset, size;
+    };
+    struct Source
+    {
+        uint64_t size = 0;
+        int64_t time = 0;
+    };
+
+    static bool stat(const std::string &sourcePath, Source &source)
+    {
+        std::error_code error;
+        source.size = (uint64_t)std::filesystem::file_size(sourcePath, error);
+        if (error)
+            return false;
+        source.time = (int64_t)std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+        return !error;
+    }
+
+    // writes the new size and time of a source with unchanged contents into its entry
+    static void refresh(const std::string &entryPath, const Source &source)
+    {
+        std::fstream file(entryPath, std::ios::binary | std::ios::in | std::ios::out);
+        if (!file)
+            return;
+        file.seekp(offsetof(Header, sourceSize));
+        file.write((const char *)&source.size, sizeof(source.size));
+        file.write((const char *)&source.time, sizeof(source.time));
+    }
+
+    std::string path(const std::string &sourcePath, bool flip) const
+    {
+        uint64_t key = fnv1a64(sourcePath.data(), sourcePath.size());
+        const unsigned char options[2] = {(unsigned char)flip, (unsigned char)compress};
+        key = fnv1a64(options, sizeof(options), key);
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.tex", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+};
+
+#endif
@@ -0,0 +1,283 @@
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include "asset_pack.cpp"
+#include "dds_texture.cpp"
+#include "image_convert.cpp"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Offline texture cooker: decodes source images once, builds the full mip chain on the CPU
+// and stores it block compressed (BC1 for opaque images, BC3 when there is alpha) in DDS files
+// under <directory>/cooked, which the TextureLoader prefers over the source images.
+// Runs without a GL context, see the --cook command line option in main.cpp.
+// Cooked images are stored bottom-up, the way the loader flips source images by default.
+
+// where the cooked version of a source texture lives, e.g. res/container.jpg -> res/cooked/container.dds
+inline std::string cookedTexturePath(const std::string &sourcePath)
+{
+    std::filesystem::path path(sourcePath);
+    return (path.parent_path() / "cooked" / path.stem()).string() + ".dds";
+}
+
+namespace cooker
+{
+inline uint16_t packRGB565(const int *rgb)
+{
+    return (uint16_t)(((rgb[0] * 31 + 127) / 255) << 11 | ((rgb[1] * 63 + 127) / 255) << 5 | ((rgb[2] * 31 + 127) / 255));
+}
+
+inline void unpackRGB565(uint16_t c, int *rgb)
+{
+    rgb[0] = ((c >> 11) & 31) * 255 / 31;
+    rgb[1] = ((c >> 5) & 63) * 255 / 63;
+    rgb[2] = (c & 31) * 255 / 31;
+}
+
+// BC1 color block from 16 RGBA texels, endpoints from the bounding box inset by 1/16
+inline void encodeColorBlock(const unsigned char *texels, unsigned char *out)
+{
+    int minColor[3] = {255, 255, 255}, maxColor[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            minColor[c] = std::min(minColor[c], (int)texels[i * 4 + c]);
+            maxColor[c] = std::max(maxColor[c], (int)texels[i * 4 + c]);
+        }
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        int inset = (maxColor[c] - minColor[c]) / 16;
+        minColor[c] += inset;
+        maxColor[c] -= inset;
+    }
+
+    uint16_t c0 = packRGB565(maxColor);
+    uint16_t c1 = packRGB565(minColor);
+    uint32_t indices = 0;
+    if (c0 != c1)
+    {
+        // c0 > c1 selects the 4 color mode
+        if (c0 < c1)
+            std::swap(c0, c1);
+        int palette[4][3];
+        unpackRGB565(c0, palette[0]);
+        unpackRGB565(c1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestDistance = 1 << 30;
+            for (int p = 0; p < 4; p++)
+            {
+                int distance = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    int d = texels[i * 4 + c] - palette[p][c];
+                    distance += d * d;
+                }
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (i * 2);
+        }
+    }
+    std::memcpy(out, &c0, 2);
+    std::memcpy(out + 2, &c1, 2);
+    std::memcpy(out + 4, &indices, 4);
+}
+
+// BC4 style alpha block used by BC3, 8 interpolated values between min and max
+inline void encodeAlphaBlock(const unsigned char *texels, unsigned char *out)
+{
+    int minAlpha = 255, maxAlpha = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        minAlpha = std::min(minAlpha, (int)texels[i * 4 + 3]);
+        maxAlpha = std::max(maxAlpha, (int)texels[i * 4 + 3]);
+    }
+    out[0] = (unsigned char)maxAlpha;
+    out[1] = (unsigned char)minAlpha;
+
+    uint64_t indices = 0;
+    if (maxAlpha != minAlpha)
+    {
+        int palette[8];
+        palette[0] = maxAlpha;
+        palette[1] = minAlpha;
+        for (int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * maxAlpha + p * minAlpha) / 7;
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestDistance = 1 << 30;
+            for (int p = 0; p < 8; p++)
+            {
+                int distance = std::abs(texels[i * 4 + 3] - palette[p]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint64_t)best << (i * 3);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+// compresses one RGBA8 level, edge blocks repeat the last row/column
+inline void compressLevel(const unsigned char *rgba, int width, int height, bool alpha,
+                          std::vector<unsigned char> &out)
+{
+    unsigned char block[16 * 4];
+    for (int by = 0; by < height; by += 4)
+    {
+        for (int bx = 0; bx < width; bx += 4)
+        {
+            for (int y = 0; y < 4; y++)
+            {
+                for (int x = 0; x < 4; x++)
+                {
+                    int sx = std::min(bx + x, width - 1);
+                    int sy = std::min(by + y, height - 1);
+                    std::memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+                }
+            }
+            size_t offset = out.size();
+            out.resize(offset + (alpha ? 16 : 8));
+            if (alpha)
+            {
+                encodeAlphaBlock(block, &out[offset]);
+                encodeColorBlock(block, &out[offset + 8]);
+            }
+            else
+            {
+                encodeColorBlock(block, &out[offset]);
+            }
+        }
+    }
+}
+
+// 2x2 box filter, odd sizes clamp the last texel
+inline std::vector<unsigned char> downsample(const std::vector<unsigned char> &rgba, int width, int height)
+{
+    int w = std::max(1, width / 2), h = std::max(1, height / 2);
+    std::vector<unsigned char> result((size_t)w * h * 4);
+    halveImage(rgba.data(), width, height, 4, result.data());
+    return result;
+}
+// writes the levelCount BC1 (BC3 with alpha) levels of payload, the top one width x height,
+// as a DDS file, creating its directory
+inline bool writeDDS(const std::string &outputPath, int width, int height, bool alpha, uint32_t levelCount,
+                     const std::vector<unsigned char> &payload)
+{
+    DDSHeader header = {};
+    header.size = sizeof(DDSHeader);
+    // caps | height | width | pixel format | mipmap count | linear size
+    header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.pitchOrLinearSize = (uint32_t)compressedLevelSize(width, height, alpha ? 16 : 8);
+    header.mipMapCount = levelCount;
+    header.pixelFormat.size = sizeof(DDSPixelFormat);
+    header.pixelFormat.flags = 0x4; // fourCC
+    header.pixelFormat.fourCC = alpha ? DDS_FOURCC('D', 'X', 'T', '5') : DDS_FOURCC('D', 'X', 'T', '1');
+    header.caps = 0x1000 | 0x400000 | 0x8; // texture | mipmap | complex
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(outputPath).parent_path(), error);
+    std::ofstream file(outputPath, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cout << "ERROR::TEXTURE_COOKER::COULD_NOT_WRITE: " << outputPath << '\n';
+        return false;
+    }
+    uint32_t magic = DDS_MAGIC;
+    file.write((const char *)&magic, 4);
+    file.write((const char *)&header, sizeof(header));
+    file.write((const char *)payload.data(), payload.size());
+    return true;
+}
+} // namespace cooker
+
+// cooks a single image into a DDS file, returns false when the source can't be read
+inline bool cookTexture(const std::string &sourcePath, const std::string &outputPath)
+{
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load_thread(0);
+    std::vector<unsigned char> source;
+    unsigned char *pixels = NULL;
+    if (readFileContents(sourcePath, source))
+        pixels = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &channels, 4);
+    if (pixels)
+        flipRows(pixels, width, height, 4);
+    if (!pixels)
+    {
+        std::cout << "ERROR::TEXTURE_COOKER::FAILED_TO_LOAD: " << sourcePath << '\n';
+        return false;
+    }
+    bool alpha = channels == 2 || channels == 4;
+    std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * 4);
+    stbi_image_free(pixels);
+
+    std::vector<unsigned char> payload;
+    uint32_t levelCount = 0;
+    int w = width, h = height;
+    for (;;)
+    {
+        cooker::compressLevel(level.data(), w, h, alpha, payload);
+        levelCount++;
+        if (w == 1 && h == 1)
+            break;
+        level = cooker::downsample(level, w, h);
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+    }
+
+    if (!cooker::writeDDS(outputPath, width, height, alpha, levelCount, payload))
+        return false;
+    std::cout << "cooked " << sourcePath << " -> " << outputPath << " (" << (alpha ? "BC3" : "BC1") << ", "
+              << levelCount << " mips, " << payload.size() / 1024 << " KiB)\n";
+    return true;
+}
+
+// cooks every jpg/png/tga/bmp in a directory, returns the number of failures
+inline int cookDirectory(const std::string &directory)
+{
+    int failures = 0;
+    std::error_code error;
+    for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory, error))
+    {
+        if (!entry.is_regular_file())
+            continue;
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension != ".jpg" && extension != ".jpeg" && extension != ".png" && extension != ".tga" &&
+            extension != ".bmp")
+            continue;
+        std::string source = entry.path().string();
+        if (!cookTexture(source, cookedTexturePath(source)))
+            failures++;
+    }
+    if (error)
+        std::cout << "ERROR::TEXTURE_COOKER::COULD_NOT_OPEN: " << directory << '\n';
+    return failures;
+}
+
+#endif
@@ -0,0 +1,797 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include "glad/glad.h"
+
+#include "asset_pack.cpp"
+#include "alloc_tracker.cpp"
+#include "asset_prefetch.cpp"
+#include "dds_texture.cpp"
+#include "gl_debug.cpp"
+#include "gl_objects.cpp"
+#include "hash.cpp"
+#include "image_convert.cpp"
+#include "image_decoder.cpp"
+#include "mpsc_queue.cpp"
+#include "single_pass_downsampler.cpp"
+#include "startup_timeline.cpp"
+#include "stb_image.h"
+#include "texture.cpp"
+#include "texture_cache.cpp"
+#include "texture_cooker.cpp"
+#include "texture_residency.cpp"
+#include "upload_context.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Loads textures without blocking the render thread.
+// load() returns a texture right away that shares a grey placeholder pixel,
+// while a worker pool decodes the file (see image_decoder.cpp).
+// Textures use immutable storage, so the real texture object replaces the
+// placeholder's ID once uploaded; bind through the returned reference every frame.
+// update() runs on the GL thread once per frame: decoded images are copied into a
+// staging pixel buffer (persistently mapped on GL 4.4+) and uploaded from there,
+// a fence per upload tells when the staging memory can be reused and the texture is final.
+// The workers hand decoded images over through a bounded lock-free queue (see mpsc_queue.cpp)
+// and wait while it is full; update() takes them until uploadBudget bytes or uploadBudgetMs
+// are spent, the rest wait for the next frame.
+// When a cooked DDS exists for the file (see texture_cooker.cpp) its compressed
+// mip chain is uploaded instead, skipping both the decode and glGenerateMipmap.
+// Source images without a cooked DDS come from the TextureCache when one is set, mapped
+// with their mip chain, and are stored there on a miss.
+// Decoded images pass through convertDecoded() (see image_convert.cpp), so RGB files are
+// uploaded as RGBA8.
+// loadLayer() fills one layer of a Texture2DArray the same way, from the source image only.
+// Streamed loads with a TextureResidency set go to it instead: the worker keeps the whole mip
+// chain in system memory (built on the CPU for source images, which are decoded to RGBA) and
+// the residency uploads the levels the draws ask for within its budget.
+// With an UploadContext set, update() only allocates the storage of whole textures and hands
+// the copy and the mipmaps to its thread; the texture is swapped in once that is done.
+// A quality tier of skipMips leaves out that many of the top levels of every texture, a
+// quarter of the memory and the upload each: cooked and cached mip chains start further down
+// theirs, the levels above are never staged (cache entries are mapped, so never even read),
+// and decoded images are halved on the worker before anything else sees them. Array layers
+// are halved until they fit the array, which is made at the tier's size.
+// Textures are shared: loading a file again (under any spelling of its path) or the same
+// encoded bytes again with the same settings returns the texture of the first load.
+class TextureLoader
+{
+  public:
+    // size of the staging buffer, larger images are uploaded straight from client memory
+    static const size_t STAGING_SIZE = 32 * 1024 * 1024;
+    // decoded images waiting for the GL thread at most
+    static const size_t READY_CAPACITY = 64;
+
+    // per update(), one image always goes even when it is larger on its own
+    size_t uploadBudget = 16 * 1024 * 1024;
+    double uploadBudgetMs = 2.0;
+    // in the last update(): bytes uploaded, the time it took in ms and the images left for later
+    size_t uploadedBytes = 0;
+    double uploadMs = 0.0;
+    size_t deferredUploads = 0;
+    // load() and loadMemory() calls answered with a texture loaded before
+    size_t sharedLoads = 0;
+
+    // takes the streamed loads when set, before they are queued
+    TextureResidency *residency = NULL;
+    // maps the mip chains of source images decoded on an earlier launch when set, and
+    // stores the ones it misses; set before the first load
+    TextureCache *cache = NULL;
+    // fills whole textures on a context of its own when set; array layers and streamed
+    // images stay on the GL thread
+    UploadContext *uploads = NULL;
+    // builds the mip chains uploaded on the GL thread in one dispatch, and only the new layer's
+    // of an array, when set
+    SinglePassDownsampler *downsampler = NULL;
+    // the texture quality tier, top mip levels left out of every texture; set before the first
+    // load, the sharing of textures doesn't tell tiers apart
+    int skipMips = 0;
+
+    TextureLoader(unsigned int workerCount = 0)
+    {
+        if (workerCount == 0)
+            workerCount = std::max(1u, std::min(4u, std::thread::hardware_concurrency() - 1));
+
+        // one buffer for every upload, mapped once when the driver allows it
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        PBO = createBuffer(STAGING_SIZE, NULL, flags, GL_STREAM_DRAW);
+        if (GLAD_GL_VERSION_4_4)
+            mapped = (unsigned char *)mapBuffer(PBO, 0, STAGING_SIZE, flags);
+        persistent = mapped != NULL;
+
+        useCooked = hasGLExtension("GL_EXT_texture_compression_s3tc");
+
+        const unsigned char grey[4] = {128, 128, 128, 255};
+        placeholder.create(1, 1, GL_RGBA8, 1);
+        placeholder.upload(0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+
+        for (unsigned int i = 0; i < workerCount; i++)
+            workers.emplace_back(&TextureLoader::workerLoop, this);
+    }
+
+    ~TextureLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+
+        Decoded image;
+        while (decoded.pop(image))
+            stbi_image_free(image.pixels);
+        if (holding)
+            stbi_image_free(next.pixels);
+        for (InFlight &upload : inFlight)
+            glDeleteSync(upload.fence);
+        if (persistent)
+            unmapBuffer(PBO);
+        deleteBuffers(1, &PBO);
+    }
+
+    TextureLoader(const TextureLoader &) = delete;
+    TextureLoader &operator=(const TextureLoader &) = delete;
+
+    // queues the file for decoding, the texture shows the placeholder until it is uploaded,
+    // the reference stays valid for the loader's lifetime; streamed ones go to the residency
+    const Texture2D &load(const char *path, bool flipVertically = true, bool streamed = false)
+    {
+        std::string normal = std::filesystem::path(path).lexically_normal().generic_string();
+        uint64_t key = loadKey(fnv1a64(normal.data(), normal.size()), flipVertically, streamed);
+        if (const Texture2D *texture = find(key))
+            return *texture;
+        byContent[key] = textures.size();
+        textures.emplace_back();
+        textures.back().alias(placeholder);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Request request = {textures.size() - 1, path, flipVertically};
+            request.streamed = streamed && residency;
+            requests.push_back(request);
+            outstanding++;
+        }
+        wake.notify_one();
+        return textures.back();
+    }
+
+    // same as load() for an encoded image already in memory (png, jpg, ...), e.g. one embedded in a glTF file,
+    // name is only used in error messages
+    const Texture2D &loadMemory(std::vector<unsigned char> bytes, const std::string &name, bool flipVertically = true,
+                                bool streamed = false)
+    {
+        // kept apart from the file keys, an encoded image isn't the name of one
+        uint64_t key = loadKey(~fnv1a64(bytes.data(), bytes.size()), flipVertically, streamed);
+        if (const Texture2D *texture = find(key))
+            return *texture;
+        byContent[key] = textures.size();
+        textures.emplace_back();
+        textures.back().alias(placeholder);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Request request = {textures.size() - 1, name, flipVertically};
+            request.bytes = std::make_shared<const std::vector<unsigned char>>(std::move(bytes));
+            request.streamed = streamed && residency;
+            requests.push_back(request);
+            outstanding++;
+        }
+        wake.notify_one();
+        return textures.back();
+    }
+
+    // queues the file for one layer of an RGBA8 array, the image has to match the array size
+    void loadLayer(Texture2DArray &array, int layer, const char *path, bool flipVertically = true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Request request = {0, path, flipVertically};
+            request.array = &array;
+            request.layer = layer;
+            requests.push_back(request);
+            outstanding++;
+        }
+        wake.notify_one();
+    }
+
+    // number of textures still decoding or uploading
+    int pending() const
+    {
+        return outstanding;
+    }
+
+    // GL thread only: uploads decoded images and retires finished uploads
+    void update()
+    {
+        ALLOC_TAG("texture upload");
+        // uploads whose fence signaled free their staging range
+        while (!inFlight.empty())
+        {
+            GLenum status = glClientWaitSync(inFlight.front().fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(inFlight.front().fence);
+            stagingTail = inFlight.front().end;
+            inFlight.pop_front();
+            outstanding--;
+        }
+        if (inFlight.empty())
+            stagingHead = stagingTail = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        uploadedBytes = 0;
+        bool first = true;
+        for (;;)
+        {
+            if (!holding && !decoded.pop(next))
+                break;
+            holding = true;
+            size_t bytes = uploadSize(next);
+            double elapsed =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (!first && (uploadedBytes + bytes > uploadBudget || elapsed >= uploadBudgetMs))
+                break;
+            // array layers are labeled with their array, streamed images by the residency
+            bool whole = !next.array && next.streamed.levels.empty() &&
+                         (next.pixels || !next.compressed.levels.empty() || next.cached);
+            if (!uploadOnThread(next))
+            {
+                upload(next);
+                stbi_image_free(next.pixels);
+                if (whole)
+                    labelObject(GL_TEXTURE, textures[next.texture].ID, next.path);
+            }
+            next = Decoded{};
+            holding = false;
+            uploadedBytes += bytes;
+            first = false;
+        }
+        deferredUploads = decoded.size() + (holding ? 1 : 0);
+        uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+  private:
+    struct Request
+    {
+        // index into textures
+        size_t texture;
+        std::string path;
+        bool flip;
+        // set for loadLayer() requests instead of texture
+        Texture2DArray *array = NULL;
+        int layer = 0;
+        // encoded image for loadMemory() requests, path is just a name then
+        std::shared_ptr<const std::vector<unsigned char>> bytes;
+        bool streamed = false;
+    };
+    struct Decoded
+    {
+        size_t texture;
+        int width, height, channels;
+        unsigned char *pixels;
+        // filled instead of pixels for cooked textures
+        CompressedImage compressed;
+        Texture2DArray *array;
+        int layer;
+        // for the startup timeline
+        std::string path;
+        // the mip chain of a streamed request, in place of pixels and compressed
+        StreamedImage streamed;
+        // a TextureCache hit, in place of pixels
+        std::shared_ptr<CachedTexture> cached;
+    };
+    struct InFlight
+    {
+        GLsync fence;
+        // staging offset right after this upload
+        size_t end;
+    };
+
+    Texture2D placeholder;
+    // deque keeps the references handed out by load() stable
+    std::deque<Texture2D> textures;
+    // from a hash of the path or the bytes and the load settings to the index in textures
+    std::unordered_map<uint64_t, size_t> byContent;
+
+    unsigned int PBO = 0;
+    bool persistent = false;
+    // cooked files are only used when the driver can sample S3TC
+    bool useCooked = false;
+    unsigned char *mapped = NULL;
+    // staging space in use is [stagingTail, stagingHead), wrapping to 0 when the end is reached
+    size_t stagingHead = 0;
+    size_t stagingTail = 0;
+    std::deque<InFlight> inFlight;
+    int outstanding = 0;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Request> requests;
+    bool stopping = false;
+    MPSCQueue<Decoded> decoded{READY_CAPACITY};
+    // the GL thread's, taken from decoded and over the budget
+    Decoded next{};
+    bool holding = false;
+
+    static uint64_t loadKey(uint64_t source, bool flip, bool streamed)
+    {
+        const unsigned char settings[2] = {flip, streamed};
+        return fnv1a64(settings, sizeof(settings), source);
+    }
+
+    const Texture2D *find(uint64_t key)
+    {
+        auto found = byContent.find(key);
+        if (found == byContent.end())
+            return NULL;
+        sharedLoads++;
+        return &textures[found->second];
+    }
+
+    void workerLoop()
+    {
+        ALLOC_TAG("texture decode");
+        for (;;)
+        {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !requests.empty(); });
+                if (stopping)
+                    return;
+                request = requests.front();
+                requests.pop_front();
+            }
+
+            StartupScope startup("decode " + request.path);
+            Decoded image = {request.texture, 0, 0, 0, NULL, CompressedImage(), request.array, request.layer,
+                             request.path, StreamedImage(), NULL};
+            // cooked textures are stored bottom-up, so they only replace flipped loads,
+            // array layers share one uncompressed format
+            bool cookable = request.flip && !request.array && !request.bytes;
+            // loose files only, the asset pack is mapped already
+            const unsigned char *packed;
+            size_t packedSize;
+            bool cacheable = cache && !request.array && !request.bytes && !request.streamed &&
+                             !assetPack.view(request.path, packed, packedSize);
+            bool loaded = useCooked && cookable && loadCooked(request.path, image.compressed);
+            if (!loaded && cacheable)
+            {
+                image.cached = cache->load(request.path, request.flip);
+                loaded = image.cached != NULL;
+            }
+            if (!loaded)
+            {
+                int desired = request.array || request.streamed ? 4 : 0;
+                // decoded, flipped and widened already when main() prefetched it with the same settings
+                bool prefetched = false;
+                if (request.bytes)
+                    image.pixels = decodeImage(request.bytes->data(), request.bytes->size(), &image.width,
+                                               &image.height, &image.channels, desired);
+                else if (assetPrefetch.image(request.path, request.flip, desired, image.width, image.height,
+                                             image.channels, image.pixels))
+                    prefetched = true;
+                else
+                    image.pixels = decodeImageFile(request.path, &image.width, &image.height, &image.channels, desired);
+                if (request.array || request.streamed)
+                    image.channels = 4;
+                if (!prefetched)
+                    image.pixels =
+                        convertDecoded(image.pixels, image.width, image.height, image.channels, request.flip);
+                if (!image.pixels)
+                    std::cout << "ERROR::TEXTURE_LOADER::FAILED_TO_LOAD: " << request.path << '\n';
+                else if (cacheable && image.channels == 4)
+                    cache->store(request.path, request.flip, image.pixels, image.width, image.height);
+            }
+            // the cache keeps the whole chain, so changing the tier doesn't invalidate it
+            skipLevels(image);
+            if (request.streamed)
+                buildMipChain(image);
+
+            // a full queue means the GL thread is behind its budget, decoding more would only hold memory
+            while (!decoded.push(std::move(image)))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (stopping)
+                    {
+                        stbi_image_free(image.pixels);
+                        return;
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    // drops the levels of the quality tier, the last level always stays; layers are halved
+    // down to their array's size instead
+    void skipLevels(Decoded &image) const
+    {
+        if (image.array)
+        {
+            int levels = 0;
+            while (image.width >> levels > image.array->width || image.height >> levels > image.array->height)
+                levels++;
+            image.pixels = shrinkImage(image.pixels, image.width, image.height, image.channels, levels);
+            return;
+        }
+        if (skipMips <= 0)
+            return;
+        if (!image.compressed.levels.empty())
+        {
+            std::vector<CompressedLevel> &levels = image.compressed.levels;
+            levels.erase(levels.begin(), levels.begin() + std::min((size_t)skipMips, levels.size() - 1));
+            image.compressed.width = levels.front().width;
+            image.compressed.height = levels.front().height;
+        }
+        else if (image.cached)
+        {
+            std::vector<CompressedLevel> &levels = image.cached->levels;
+            levels.erase(levels.begin(), levels.begin() + std::min((size_t)skipMips, levels.size() - 1));
+            image.cached->width = levels.front().width;
+            image.cached->height = levels.front().height;
+        }
+        else
+        {
+            image.pixels = shrinkImage(image.pixels, image.width, image.height, image.channels, skipMips);
+        }
+    }
+
+    // the bytes update() counts against uploadBudget, the residency budgets the streamed ones itself
+    static size_t uploadSize(const Decoded &image)
+    {
+        if (!image.streamed.levels.empty())
+            return 0;
+        if (!image.compressed.levels.empty())
+            return levelsSize(image.compressed.levels);
+        if (image.cached)
+            return levelsSize(image.cached->levels);
+        return image.pixels ? (size_t)image.width * image.height * image.channels : 0;
+    }
+
+    // from the first level to the end of the last, what is staged of a mip chain
+    static size_t levelsSize(const std::vector<CompressedLevel> &levels)
+    {
+        return levels.back().offset + levels.back().size - levels.front().offset;
+    }
+
+    // moves a decoded or cooked image into its StreamedImage, every level on the CPU
+    static void buildMipChain(Decoded &image)
+    {
+        StreamedImage &streamed = image.streamed;
+        if (!image.compressed.levels.empty())
+        {
+            const CompressedImage &compressed = image.compressed;
+            streamed.width = compressed.width;
+            streamed.height = compressed.height;
+            streamed.internalFormat = compressed.format;
+            streamed.compressed = true;
+            for (const CompressedLevel &level : compressed.levels)
+                streamed.levels.emplace_back(compressed.data.begin() + level.offset,
+                                             compressed.data.begin() + level.offset + level.size);
+            image.compressed = CompressedImage();
+            return;
+        }
+        if (!image.pixels)
+            return;
+        streamed.width = image.width;
+        streamed.height = image.height;
+        streamed.levels.emplace_back(image.pixels, image.pixels + (size_t)image.width * image.height * 4);
+        stbi_image_free(image.pixels);
+        image.pixels = NULL;
+        int w = image.width, h = image.height;
+        while (w > 1 || h > 1)
+        {
+            streamed.levels.push_back(cooker::downsample(streamed.levels.back(), w, h));
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+        }
+    }
+
+    static bool loadCooked(const std::string &path, CompressedImage &image)
+    {
+        std::vector<unsigned char> bytes;
+        return readAsset(cookedTexturePath(path), bytes) && parseDDS(std::move(bytes), image);
+    }
+
+    // returns a staging offset for size bytes, waiting on older uploads if the ring is full
+    bool allocateStaging(size_t size, size_t &offset)
+    {
+        if (size > STAGING_SIZE)
+            return false;
+        for (;;)
+        {
+            bool full = !inFlight.empty() && stagingHead == stagingTail;
+            bool wrapped = stagingHead < stagingTail;
+            if (full)
+                wrapped = true;
+            if (!wrapped && stagingHead + size <= STAGING_SIZE)
+                break;
+            if (!wrapped && size <= stagingTail)
+            {
+                // room at the start of the buffer
+                stagingHead = 0;
+                break;
+            }
+            if (wrapped && stagingHead + size <= stagingTail)
+                break;
+            if (inFlight.empty())
+            {
+                stagingHead = stagingTail = 0;
+                break;
+            }
+            // full, block on the oldest upload
+            glClientWaitSync(inFlight.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(inFlight.front().fence);
+            stagingTail = inFlight.front().end;
+            inFlight.pop_front();
+            outstanding--;
+        }
+        offset = stagingHead;
+        stagingHead += size;
+        return true;
+    }
+
+    // copies data into the staging buffer, returns false when it has to be
+    // uploaded from client memory instead
+    bool stage(const void *data, size_t size, size_t &offset)
+    {
+        if (!allocateStaging(size, offset))
+            return false;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+        if (persistent)
+        {
+            std::memcpy(mapped + offset, data, size);
+        }
+        else
+        {
+            void *target =
+                mapBuffer(PBO, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+            std::memcpy(target, data, size);
+            unmapBuffer(PBO);
+        }
+        return true;
+    }
+
+    void uploadCompressed(const Decoded &image)
+    {
+        const CompressedImage &compressed = image.compressed;
+        Texture2D texture(compressed.width, compressed.height, compressed.format, (int)compressed.levels.size());
+
+        size_t first = compressed.levels.front().offset;
+        size_t size = compressed.levels.back().offset + compressed.levels.back().size - first;
+        size_t offset = 0;
+        bool staged = stage(compressed.data.data() + first, size, offset);
+        for (size_t i = 0; i < compressed.levels.size(); i++)
+        {
+            const CompressedLevel &level = compressed.levels[i];
+            const unsigned char *source =
+                staged ? (const unsigned char *)(offset + level.offset - first) : compressed.data.data() + level.offset;
+            texture.uploadCompressed((int)i, level.size, source);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        textures[image.texture] = std::move(texture);
+
+        inFlight.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), stagingHead});
+    }
+
+    // every level straight out of the cache entry's mapping
+    void uploadCached(const CachedTexture &cached, size_t index)
+    {
+        Texture2D texture(cached.width, cached.height, cached.internalFormat, (int)cached.levels.size());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        size_t first = cached.levels.front().offset;
+        size_t size = cached.levels.back().offset + cached.levels.back().size - first;
+        size_t offset = 0;
+        bool staged = stage(cached.file.data + first, size, offset);
+        for (size_t i = 0; i < cached.levels.size(); i++)
+        {
+            const CompressedLevel &level = cached.levels[i];
+            const unsigned char *source =
+                staged ? (const unsigned char *)(offset + level.offset - first) : cached.file.data + level.offset;
+            if (cached.compressed)
+                texture.uploadCompressed((int)i, level.size, source);
+            else
+                texture.upload((int)i, GL_RGBA, GL_UNSIGNED_BYTE, source);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        textures[index] = std::move(texture);
+
+        inFlight.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), stagingHead});
+    }
+
+    void upload(Decoded &image)
+    {
+        StartupScope startup("upload " + image.path);
+        if (!image.streamed.levels.empty())
+        {
+            residency->adopt(textures[image.texture], std::move(image.streamed));
+            outstanding--;
+            return;
+        }
+        if (!image.compressed.levels.empty())
+        {
+            uploadCompressed(image);
+            return;
+        }
+        if (image.cached)
+        {
+            uploadCached(*image.cached, image.texture);
+            return;
+        }
+        if (!image.pixels)
+        {
+            outstanding--;
+            return;
+        }
+
+        if (image.array)
+        {
+            uploadLayer(image);
+            return;
+        }
+
+        static const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+        static const GLenum internalFormats[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+        GLenum format = formats[image.channels - 1];
+        GLenum internalFormat = internalFormats[image.channels - 1];
+        size_t size = (size_t)image.width * image.height * image.channels;
+
+        Texture2D texture(image.width, image.height, internalFormat);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        size_t offset = 0;
+        if (stage(image.pixels, size, offset))
+        {
+            texture.upload(0, format, GL_UNSIGNED_BYTE, (void *)offset);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        else
+        {
+            texture.upload(0, format, GL_UNSIGNED_BYTE, image.pixels);
+        }
+        {
+            StartupScope mipmaps("mipmaps " + image.path);
+            if (downsampler && SinglePassDownsampler::supportsFormat(internalFormat))
+                downsampler->generate(texture);
+            else
+                texture.generateMipmaps();
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        textures[image.texture] = std::move(texture);
+
+        inFlight.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), stagingHead});
+    }
+
+    // hands image to the upload context, false when it is for the GL thread; the storage is
+    // allocated here, so the render stats and the GL state cache are only touched by this thread
+    bool uploadOnThread(Decoded &image)
+    {
+        if (!uploads || image.array || !image.streamed.levels.empty())
+            return false;
+        if (!image.pixels && image.compressed.levels.empty() && !image.cached)
+            return false;
+
+        static const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+        static const GLenum internalFormats[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+        std::shared_ptr<Texture2D> texture;
+        if (!image.compressed.levels.empty())
+        {
+            const CompressedImage &compressed = image.compressed;
+            texture = std::make_shared<Texture2D>(compressed.width, compressed.height, compressed.format,
+                                                  (int)compressed.levels.size());
+        }
+        else if (image.cached)
+        {
+            const CachedTexture &cached = *image.cached;
+            texture = std::make_shared<Texture2D>(cached.width, cached.height, cached.internalFormat,
+                                                  (int)cached.levels.size());
+        }
+        else
+        {
+            texture = std::make_shared<Texture2D>(image.width, image.height, internalFormats[image.channels - 1]);
+        }
+
+        // shared so the callbacks stay copyable, the pixels are freed once by the work
+        std::shared_ptr<Decoded> job = std::make_shared<Decoded>(std::move(image));
+        image.pixels = NULL;
+        unsigned int id = texture->ID;
+        int width = texture->width, height = texture->height;
+        GLenum internalFormat = texture->internalFormat;
+        uploads->submit(
+            [job, id, width, height, internalFormat] {
+                glBindTexture(GL_TEXTURE_2D, id);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                if (!job->compressed.levels.empty() || job->cached)
+                {
+                    const bool cached = job->cached != NULL;
+                    const std::vector<CompressedLevel> &levels = cached ? job->cached->levels : job->compressed.levels;
+                    const unsigned char *data = cached ? job->cached->file.data : job->compressed.data.data();
+                    bool compressed = !cached || job->cached->compressed;
+                    for (size_t i = 0; i < levels.size(); i++)
+                    {
+                        int w = std::max(1, width >> i), h = std::max(1, height >> i);
+                        const unsigned char *source = data + levels[i].offset;
+                        if (compressed)
+                            glCompressedTexSubImage2D(GL_TEXTURE_2D, (int)i, 0, 0, w, h, internalFormat,
+                                                      (GLsizei)levels[i].size, source);
+                        else
+                            glTexSubImage2D(GL_TEXTURE_2D, (int)i, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, source);
+                    }
+                }
+                else
+                {
+                    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, formats[job->channels - 1],
+                                    GL_UNSIGNED_BYTE, job->pixels);
+                    glGenerateMipmap(GL_TEXTURE_2D);
+                    stbi_image_free(job->pixels);
+                    job->pixels = NULL;
+                }
+                glBindTexture(GL_TEXTURE_2D, 0);
+            },
+            [this, job, texture] {
+                textures[job->texture] = std::move(*texture);
+                labelObject(GL_TEXTURE, textures[job->texture].ID, job->path);
+                outstanding--;
+            });
+        return true;
+    }
+
+    void uploadLayer(const Decoded &image)
+    {
+        Texture2DArray &array = *image.array;
+        if (image.width != array.width || image.height != array.height || image.layer < 0 ||
+            image.layer >= array.layers)
+        {
+            std::cout << "ERROR::TEXTURE_LOADER::LAYER_MISMATCH: " << image.width << "x" << image.height
+                      << " image for layer " << image.layer << " of a " << array.width << "x" << array.height << "x"
+                      << array.layers << " array\n";
+            outstanding--;
+            return;
+        }
+
+        size_t size = (size_t)image.width * image.height * 4;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        size_t offset = 0;
+        if (stage(image.pixels, size, offset))
+        {
+            array.upload(image.layer, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void *)offset);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        else
+        {
+            array.upload(image.layer, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+        }
+        // glGenerateMipmap rebuilds every layer, arrays only hold a handful of images loaded once
+        {
+            StartupScope mipmaps("mipmaps " + image.path);
+            if (downsampler && SinglePassDownsampler::supportsFormat(array.internalFormat))
+                downsampler->generate(array, image.layer);
+            else
+                array.generateMipmaps();
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        inFlight.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), stagingHead});
+    }
+};
+
+#endif
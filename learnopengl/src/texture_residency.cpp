@@ -0,0 +1,279 @@
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include "glad/glad.h"
+
+#include "deletion_queue.cpp"
+#include "render_stats.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// the whole mip chain of a streamed texture in system memory, finest level first
+struct StreamedImage
+{
+    int width = 0, height = 0;
+    GLenum internalFormat = GL_RGBA8;
+    // pixel transfer format of the levels, unused when compressed
+    GLenum format = GL_RGBA;
+    bool compressed = false;
+    std::vector<std::vector<unsigned char>> levels;
+};
+
+// Keeps the streamed textures within a budget of video memory. Every texture's mip chain
+// stays in system memory and its GL texture holds only the levels from top down: the levels
+// up to TAIL_SIZE texels are always there, the finer ones are streamed in and out.
+// The draws call request() with how many pixels the surface covers on screen, which names
+// the finest level worth having (the one with about a texel per pixel). update() then, once
+// per frame:
+// - swaps in the textures whose finer levels finished uploading,
+// - raises the textures that want finer levels, the most under-resolved first, into a new
+//   texture uploaded from system memory; the old one stays bound until the upload's fence has
+//   signaled, and no more than uploadBytes are uploaded per frame,
+// - makes room when that goes over the budget, or the budget shrank, by dropping levels of the
+//   least recently requested textures and the finer than wanted levels of the others, the
+//   levels of the frame's textures are never dropped for another one. A drop is a smaller
+//   texture made right away.
+// Textures are replaced by move, so the references handed out by the TextureLoader stay valid
+// and only their ID changes; bindless handles of them would not follow.
+class TextureResidency
+{
+  public:
+    // levels at most this large on either side are never dropped
+    static const int TAIL_SIZE = 64;
+
+    // bytes of video memory the streamed textures may take, their tails count but always stay
+    uint64_t budget = 256ull * 1024 * 1024;
+    // bytes uploaded per frame at most, a single level larger than that still goes through alone
+    uint64_t uploadBytes = 8ull * 1024 * 1024;
+
+    // bytes the streamed textures take, including uploads in flight
+    uint64_t residentBytes = 0;
+    // levels streamed in and dropped overall
+    size_t streamedLevels = 0;
+    size_t droppedLevels = 0;
+    // replaced textures wait here for the frames that still sample them when set, they
+    // are deleted right away otherwise
+    DeletionQueue *deletions = NULL;
+
+    TextureResidency()
+    {
+    }
+
+    ~TextureResidency()
+    {
+        for (Pending &pending : pendings)
+            glDeleteSync(pending.fence);
+    }
+
+    TextureResidency(const TextureResidency &) = delete;
+    TextureResidency &operator=(const TextureResidency &) = delete;
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+    // takes over texture with only the tail of image resident, texture is replaced in place from now on
+    void adopt(Texture2D &texture, StreamedImage &&image)
+    {
+        if (image.levels.empty())
+            return;
+        Entry entry;
+        entry.texture = &texture;
+        entry.image = std::move(image);
+        entry.top = (int)entry.image.levels.size() - 1;
+        while (entry.top > 0 &&
+               std::max(levelWidth(entry, entry.top - 1), levelHeight(entry, entry.top - 1)) <= TAIL_SIZE)
+            entry.top--;
+        entry.tail = entry.top;
+        entry.wanted = entry.top;
+        texture = build(entry, entry.top);
+        residentBytes += bytes(entry, entry.top);
+        lookup[&texture] = entries.size();
+        entries.push_back(std::move(entry));
+    }
+
+    // texture covers about screenPixels pixels across on screen this frame, ignored for
+    // textures that aren't streamed
+    void request(const Texture2D &texture, float screenPixels)
+    {
+        auto found = lookup.find(&texture);
+        if (found == lookup.end())
+            return;
+        Entry &entry = entries[found->second];
+        int size = std::max(entry.image.width, entry.image.height);
+        // about a texel per pixel
+        int level = (int)std::floor(std::log2(std::max(1.0f, (float)size / std::max(screenPixels, 1.0f))));
+        level = std::min(level, entry.tail);
+        if (entry.lastUsed != frame)
+            entry.wanted = level;
+        else
+            entry.wanted = std::min(entry.wanted, level);
+        entry.lastUsed = frame;
+    }
+
+    // once per frame on the GL thread, after the frame's request() calls
+    void update()
+    {
+        // uploads that finished replace their textures
+        for (size_t i = 0; i < pendings.size();)
+        {
+            GLenum state = glClientWaitSync(pendings[i].fence, 0, 0);
+            if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+            {
+                i++;
+                continue;
+            }
+            glDeleteSync(pendings[i].fence);
+            Entry &entry = entries[pendings[i].entry];
+            residentBytes -= bytes(entry, entry.top);
+            streamedLevels += entry.top - pendings[i].top;
+            entry.top = pendings[i].top;
+            replace(entry, std::move(pendings[i].texture));
+            entry.pending = false;
+            pendings.erase(pendings.begin() + i);
+        }
+
+        // the most under-resolved first, the larger on screen among equals
+        std::vector<size_t> raises;
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            if (!entries[i].pending && entries[i].lastUsed == frame && entries[i].wanted < entries[i].top)
+                raises.push_back(i);
+        }
+        std::sort(raises.begin(), raises.end(), [this](size_t a, size_t b) {
+            int deficitA = entries[a].top - entries[a].wanted, deficitB = entries[b].top - entries[b].wanted;
+            return deficitA != deficitB ? deficitA > deficitB : entries[a].wanted < entries[b].wanted;
+        });
+        uint64_t uploaded = 0;
+        for (size_t index : raises)
+        {
+            Entry &entry = entries[index];
+            // as fine as this frame's uploads allow, the next frames continue from there
+            int top = entry.wanted;
+            while (top < entry.top - 1 && uploaded + bytes(entry, top) > uploadBytes)
+                top++;
+            if (uploaded > 0 && uploaded + bytes(entry, top) > uploadBytes)
+                break;
+            // the old texture stays until the swap, both count meanwhile
+            if (!makeRoom(bytes(entry, top), index))
+                continue;
+            Pending pending;
+            pending.entry = index;
+            pending.top = top;
+            pending.texture = build(entry, top);
+            pending.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            residentBytes += bytes(entry, top);
+            uploaded += bytes(entry, top);
+            entry.pending = true;
+            pendings.push_back(std::move(pending));
+        }
+        makeRoom(0, entries.size());
+        frame++;
+    }
+
+  private:
+    struct Entry
+    {
+        Texture2D *texture = NULL;
+        StreamedImage image;
+        // finest resident level, the coarsest level that is always resident and the finest
+        // asked for by the last frame that requested the texture
+        int top = 0, tail = 0, wanted = 0;
+        unsigned int lastUsed = 0;
+        // a finer texture is uploading
+        bool pending = false;
+    };
+    struct Pending
+    {
+        size_t entry;
+        int top;
+        Texture2D texture;
+        GLsync fence;
+    };
+
+    std::vector<Entry> entries;
+    std::unordered_map<const Texture2D *, size_t> lookup;
+    std::vector<Pending> pendings;
+    unsigned int frame = 1;
+
+    static int levelWidth(const Entry &entry, int level)
+    {
+        return std::max(1, entry.image.width >> level);
+    }
+
+    static int levelHeight(const Entry &entry, int level)
+    {
+        return std::max(1, entry.image.height >> level);
+    }
+
+    void replace(Entry &entry, Texture2D &&texture)
+    {
+        if (deletions)
+            deletions->deleteTexture(std::move(*entry.texture));
+        *entry.texture = std::move(texture);
+    }
+
+    // video memory of levels [top, levels)
+    static uint64_t bytes(const Entry &entry, int top)
+    {
+        return RenderStats::storageBytes(entry.image.internalFormat, levelWidth(entry, top), levelHeight(entry, top), 1,
+                                         (int)entry.image.levels.size() - top);
+    }
+
+    // a texture of levels [top, levels) uploaded from system memory
+    static Texture2D build(const Entry &entry, int top)
+    {
+        const StreamedImage &image = entry.image;
+        Texture2D texture(levelWidth(entry, top), levelHeight(entry, top), image.internalFormat,
+                          (int)image.levels.size() - top);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (int level = top; level < (int)image.levels.size(); level++)
+        {
+            if (image.compressed)
+                texture.uploadCompressed(level - top, image.levels[level].size(), image.levels[level].data());
+            else
+                texture.upload(level - top, image.format, GL_UNSIGNED_BYTE, image.levels[level].data());
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        return texture;
+    }
+
+    // drops levels until extra more bytes fit the budget, false when it can't. Only textures
+    // that weren't requested this frame or that have levels finer than they want lose any,
+    // the least recently requested first; never keep or a texture that is uploading
+    bool makeRoom(uint64_t extra, size_t keep)
+    {
+        while (residentBytes + extra > budget)
+        {
+            size_t victim = entries.size();
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                const Entry &entry = entries[i];
+                if (i == keep || entry.pending || entry.top >= entry.tail)
+                    continue;
+                if (entry.lastUsed == frame && entry.top >= entry.wanted)
+                    continue;
+                if (victim == entries.size() || entry.lastUsed < entries[victim].lastUsed)
+                    victim = i;
+            }
+            if (victim == entries.size())
+                return false;
+            Entry &entry = entries[victim];
+            int top = entry.top + 1;
+            residentBytes -= bytes(entry, entry.top);
+            residentBytes += bytes(entry, top);
+            replace(entry, build(entry, top));
+            entry.top = top;
+            droppedLevels++;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef TRANSFORM_SYSTEM_H
+#define TRANSFORM_SYSTEM_H
+
+#include "glm/glm.hpp"
+
+#include "batch_math.cpp"
+#include "scene_snapshot.cpp"
+
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+// Objects spinning in place around a fixed axis, stored as SoA arrays.
+// update() produces every model matrix in one pass with batchTranslateRotate(), 4 objects at a time,
+// the same result as glm::rotate(glm::translate(I, position), speed * time, axis).
+// Axes are normalized and speeds converted to radians once, when the object is added.
+// For a fixed timestep simulation step() advances the angles and interpolate() builds the
+// matrices from the angles blended between the last two steps.
+// After writeCompact() the same pass also writes every object's CompactTransform.
+// Positions are doubles and every matrix is built relative to origin, 0 unless setOrigin()
+// moved it near the camera; the translations are subtracted in double before they are rounded
+// to the floats the GPU gets, so a large world keeps its precision where it is looked at.
+class TransformSystem
+{
+  public:
+    std::vector<double> positionX, positionY, positionZ;
+    std::vector<float> axisX, axisY, axisZ;
+    // radians per second
+    std::vector<float> angularSpeed;
+    // simulation state, radians after the last and the one before that step()
+    std::vector<float> angles, previousAngles;
+    // what the models are relative to, see setOrigin()
+    glm::dvec3 origin = glm::dvec3(0.0);
+    // output of update(), one model matrix per object
+    std::vector<glm::mat4> models;
+    // output of the same passes after writeCompact(), the layers are the caller's to set
+    std::vector<CompactTransform> compact;
+
+    size_t size() const
+    {
+        return angularSpeed.size();
+    }
+
+    void reserve(size_t count)
+    {
+        positionX.reserve(count);
+        positionY.reserve(count);
+        positionZ.reserve(count);
+        axisX.reserve(count);
+        axisY.reserve(count);
+        axisZ.reserve(count);
+        angularSpeed.reserve(count);
+        angles.reserve(count);
+        previousAngles.reserve(count);
+        drawAngles.reserve(count);
+        models.reserve(count);
+    }
+
+    // returns the index of the new object
+    size_t add(glm::dvec3 position, glm::vec3 axis, float degreesPerSecond)
+    {
+        axis = glm::normalize(axis);
+        positionX.push_back(position.x);
+        positionY.push_back(position.y);
+        positionZ.push_back(position.z);
+        axisX.push_back(axis.x);
+        axisY.push_back(axis.y);
+        axisZ.push_back(axis.z);
+        angularSpeed.push_back(glm::radians(degreesPerSecond));
+        angles.push_back(0.0f);
+        previousAngles.push_back(0.0f);
+        drawAngles.push_back(0.0f);
+        models.push_back(glm::mat4(1.0f));
+        if (compactOutput)
+            compact.push_back(CompactTransform{});
+        return size() - 1;
+    }
+
+    // from now on every pass that builds models fills compact as well
+    void writeCompact()
+    {
+        compactOutput = true;
+        compact.resize(size());
+        buildModels(0, size());
+    }
+
+    // models from now on are relative to newOrigin, the ones built so far are rebuilt
+    void setOrigin(const glm::dvec3 &newOrigin)
+    {
+        origin = newOrigin;
+        buildModels(0, size());
+    }
+
+    // rebuilds all model matrices for the given time, read once per frame by the caller
+    void update(float time)
+    {
+        for (size_t i = 0; i < size(); i++)
+            drawAngles[i] = angularSpeed[i] * time;
+        buildModels(0, size());
+    }
+
+    // one fixed simulation step of dt seconds, angles wrap at a full turn to keep precision
+    void step(float dt)
+    {
+        const float turn = 6.28318530718f;
+        for (size_t i = 0; i < size(); i++)
+        {
+            float angle = angles[i] + angularSpeed[i] * dt;
+            float previous = angles[i];
+            if (angle >= turn)
+            {
+                angle -= turn;
+                previous -= turn;
+            }
+            previousAngles[i] = previous;
+            angles[i] = angle;
+        }
+    }
+
+    // rebuilds all model matrices alpha of the way from the previous step to the last one
+    void interpolate(float alpha)
+    {
+        interpolate(alpha, 0, size());
+    }
+
+    // the same for objects first to last - 1, disjoint ranges can run on different threads
+    void interpolate(float alpha, size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; i++)
+            drawAngles[i] = previousAngles[i] + (angles[i] - previousAngles[i]) * alpha;
+        buildModels(first, last);
+    }
+
+    // the objects and their simulation state, see scene_snapshot.cpp
+    void save(SceneSnapshotWriter &snapshot) const
+    {
+        snapshot.add("transforms/position x", positionX);
+        snapshot.add("transforms/position y", positionY);
+        snapshot.add("transforms/position z", positionZ);
+        snapshot.add("transforms/axis x", axisX);
+        snapshot.add("transforms/axis y", axisY);
+        snapshot.add("transforms/axis z", axisZ);
+        snapshot.add("transforms/angular speed", angularSpeed);
+        snapshot.add("transforms/angles", angles);
+        snapshot.add("transforms/previous angles", previousAngles);
+    }
+
+    // replaces every object with the saved ones, models are identities until the next pass;
+    // false leaves no objects
+    bool restore(const SceneSnapshot &snapshot)
+    {
+        bool read = snapshot.read("transforms/position x", positionX) &&
+                    snapshot.read("transforms/position y", positionY) &&
+                    snapshot.read("transforms/position z", positionZ) && snapshot.read("transforms/axis x", axisX) &&
+                    snapshot.read("transforms/axis y", axisY) && snapshot.read("transforms/axis z", axisZ) &&
+                    snapshot.read("transforms/angular speed", angularSpeed) &&
+                    snapshot.read("transforms/angles", angles) &&
+                    snapshot.read("transforms/previous angles", previousAngles);
+        size_t count = angularSpeed.size();
+        for (std::vector<double> *array : {&positionX, &positionY, &positionZ})
+            read = read && array->size() == count;
+        for (std::vector<float> *array : {&axisX, &axisY, &axisZ, &angles, &previousAngles})
+            read = read && array->size() == count;
+        if (!read)
+            count = 0;
+        for (std::vector<double> *array : {&positionX, &positionY, &positionZ})
+            array->resize(count);
+        for (std::vector<float> *array : {&axisX, &axisY, &axisZ, &angularSpeed, &angles, &previousAngles})
+            array->resize(count);
+        drawAngles.assign(count, 0.0f);
+        models.assign(count, glm::mat4(1.0f));
+        if (compactOutput)
+            compact.assign(count, CompactTransform{});
+        return read;
+    }
+
+  private:
+    // the angles models are built from
+    std::vector<float> drawAngles;
+    bool compactOutput = false;
+
+    void buildModels(size_t first, size_t last)
+    {
+        if (first >= last)
+            return;
+        batchTranslateRotate(&positionX[first], &positionY[first], &positionZ[first], origin, &axisX[first],
+                             &axisY[first], &axisZ[first], &drawAngles[first], &models[first], last - first,
+                             compactOutput ? &compact[first] : nullptr);
+    }
+};
+
+#endif
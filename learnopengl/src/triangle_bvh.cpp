@@ -0,0 +1,517 @@
+#ifndef TRIANGLE_BVH_H
+#define TRIANGLE_BVH_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "block_layout.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "job_system.cpp"
+#include "mesh.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// a node as the ray queries read it (shader_src/ray_bvh.glsl), 32 bytes in std430
+struct GpuBvhNode
+{
+    glm::vec3 low = glm::vec3(0.0f);
+    // of an inner node its left child, the right one follows it; of a leaf its first triangle
+    uint32_t leftFirst = 0;
+    glm::vec3 high = glm::vec3(0.0f);
+    // triangles of a leaf, 0 for an inner node
+    uint32_t count = 0;
+};
+
+// a triangle by a corner and its two edges from it, what the intersection test wants
+struct GpuBvhTriangle
+{
+    glm::vec3 corner = glm::vec3(0.0f);
+    // whatever the triangle was added with, e.g. the index of its object
+    uint32_t instance = 0;
+    glm::vec4 edge1 = glm::vec4(0.0f);
+    glm::vec4 edge2 = glm::vec4(0.0f);
+};
+
+constexpr BlockMember GPU_BVH_NODE_LAYOUT[] = {
+    BLOCK_MEMBER(GpuBvhNode, low, GL_FLOAT_VEC3),
+    BLOCK_MEMBER(GpuBvhNode, leftFirst, GL_UNSIGNED_INT),
+    BLOCK_MEMBER(GpuBvhNode, high, GL_FLOAT_VEC3),
+    BLOCK_MEMBER(GpuBvhNode, count, GL_UNSIGNED_INT),
+};
+static_assert(blockLayoutMismatch(GPU_BVH_NODE_LAYOUT, STD430) == -1,
+              "GpuBvhNode members are not where std430 puts them");
+static_assert(sizeof(GpuBvhNode) == 32, "GpuBvhNode is not padded like std430");
+
+constexpr BlockMember GPU_BVH_TRIANGLE_LAYOUT[] = {
+    BLOCK_MEMBER(GpuBvhTriangle, corner, GL_FLOAT_VEC3),
+    BLOCK_MEMBER(GpuBvhTriangle, instance, GL_UNSIGNED_INT),
+    BLOCK_MEMBER(GpuBvhTriangle, edge1, GL_FLOAT_VEC4),
+    BLOCK_MEMBER(GpuBvhTriangle, edge2, GL_FLOAT_VEC4),
+};
+static_assert(blockLayoutMismatch(GPU_BVH_TRIANGLE_LAYOUT, STD430) == -1,
+              "GpuBvhTriangle members are not where std430 puts them");
+static_assert(blockLayoutSize(GPU_BVH_TRIANGLE_LAYOUT, STD430) == sizeof(GpuBvhTriangle),
+              "GpuBvhTriangle is not padded like std430");
+
+// Bounding volume hierarchy over the world space triangles of static geometry, for ray queries
+// of compute shaders (shader_src/ray_bvh.glsl) such as shadow and occlusion rays. Unlike the
+// BoundingVolumeHierarchy of the object spheres (bvh.cpp), which is split at the median and
+// refit as objects move, this one is built once by the surface area heuristic: every node's
+// triangles are binned by their centers into BINS slots along each axis and split at the bin
+// boundary of the lowest expected cost, or kept as a leaf when no split is cheaper.
+// build() runs on the JobSystem: the subtrees of more than TASK_TRIANGLES triangles are jobs
+// of their own and the nodes of more than PARALLEL_TRIANGLES bin their triangles with a
+// parallelFor, the nodes are taken off an atomic counter so the jobs don't wait for each other.
+// The triangles are stored in leaf order, a leaf is one range of them without an index list.
+class TriangleBvh
+{
+  public:
+    // shader storage bindings of the nodes and the triangles (see shader_src/ray_bvh.glsl)
+    static const unsigned int NODE_BINDING = 25;
+    static const unsigned int TRIANGLE_BINDING = 26;
+    static const int BINS = 16;
+    // a node of more triangles is split even when the heuristic would keep it
+    static const uint32_t MAX_LEAF = 8;
+    // ray_bvh.glsl's traversal stack, deeper nodes are leaves whatever their size
+    static const int MAX_DEPTH = 64;
+    static const uint32_t TASK_TRIANGLES = 4096;
+    static const uint32_t PARALLEL_TRIANGLES = 65536;
+
+    // the nodes, the root first, and the triangles in leaf order
+    std::vector<GpuBvhNode> nodes;
+    std::vector<GpuBvhTriangle> triangles;
+
+    TriangleBvh()
+    {
+    }
+
+    ~TriangleBvh()
+    {
+        deleteBuffers(2, buffers);
+    }
+
+    TriangleBvh(const TriangleBvh &) = delete;
+    TriangleBvh &operator=(const TriangleBvh &) = delete;
+
+    // the ray queries are compute shaders reading storage buffers
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    // the triangles of mesh, whose vertices start with their position, placed by model
+    void add(const MeshBuilder &mesh, const glm::mat4 &model, uint32_t instance)
+    {
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            glm::vec3 corners[3];
+            for (int c = 0; c < 3; c++)
+            {
+                const float *vertex = &mesh.vertices[(size_t)mesh.indices[i + c] * mesh.stride];
+                corners[c] = glm::vec3(model * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f));
+            }
+            add(corners[0], corners[1], corners[2], instance);
+        }
+    }
+
+    void add(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, uint32_t instance)
+    {
+        GpuBvhTriangle triangle;
+        triangle.corner = a;
+        triangle.instance = instance;
+        triangle.edge1 = glm::vec4(b - a, 0.0f);
+        triangle.edge2 = glm::vec4(c - a, 0.0f);
+        triangles.push_back(triangle);
+    }
+
+    // the hierarchy over every triangle added so far
+    void build(JobSystem &jobs)
+    {
+        uint32_t count = (uint32_t)triangles.size();
+        nodes.clear();
+        if (count == 0)
+            return;
+        references.resize(count);
+        jobs.parallelFor(0, count, TASK_TRIANGLES, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+            {
+                const GpuBvhTriangle &triangle = triangles[i];
+                glm::vec3 b = triangle.corner + glm::vec3(triangle.edge1);
+                glm::vec3 c = triangle.corner + glm::vec3(triangle.edge2);
+                references[i].box.low = glm::min(triangle.corner, glm::min(b, c));
+                references[i].box.high = glm::max(triangle.corner, glm::max(b, c));
+                references[i].triangle = (uint32_t)i;
+            }
+        });
+        Range root = {0, 0, count, 0};
+        for (uint32_t i = 0; i < count; i++)
+        {
+            root.bounds.grow(references[i].box);
+            root.centers.grow(references[i].box.center());
+        }
+
+        // a binary tree of leaves of one triangle or more has fewer than twice the triangles' nodes
+        nodes.resize((size_t)count * 2);
+        nodeCount.store(1);
+        JobCounter counter;
+        split(jobs, root, counter);
+        jobs.wait(counter);
+        nodes.resize(nodeCount.load());
+
+        // the triangles in the order the leaves point into
+        std::vector<GpuBvhTriangle> sorted(count);
+        jobs.parallelFor(0, count, TASK_TRIANGLES, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                sorted[i] = triangles[references[i].triangle];
+        });
+        triangles.swap(sorted);
+        references.clear();
+        references.shrink_to_fit();
+    }
+
+    // the expected cost of a ray through the tree, in triangle tests per ray that hits the root's
+    // box with a node visit as one test, what the heuristic minimised
+    float cost() const
+    {
+        if (nodes.empty())
+            return 0.0f;
+        float total = 0.0f;
+        for (const GpuBvhNode &node : nodes)
+            total += surfaceArea(node.low, node.high) * (node.count ? (float)node.count : 1.0f);
+        return total / std::max(surfaceArea(nodes[0].low, nodes[0].high), 1e-12f);
+    }
+
+    // the nearest triangle the ray from origin along the unit direction hits within maxDistance,
+    // the same walk as ray_bvh.glsl's bvhClosestHit(); false when there is none
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, uint32_t &triangle,
+                 float &distance) const
+    {
+        if (nodes.empty())
+            return false;
+        glm::vec3 inverse = 1.0f / direction;
+        distance = maxDistance;
+        bool found = false;
+        uint32_t pending[MAX_DEPTH];
+        int top = 0;
+        pending[top++] = 0;
+        while (top > 0)
+        {
+            const GpuBvhNode &node = nodes[pending[--top]];
+            if (enterBox(node, origin, inverse) >= distance)
+                continue;
+            if (node.count == 0)
+            {
+                // the nearer child on top
+                float left = enterBox(nodes[node.leftFirst], origin, inverse);
+                float right = enterBox(nodes[node.leftFirst + 1], origin, inverse);
+                pending[top++] = left < right ? node.leftFirst + 1 : node.leftFirst;
+                pending[top++] = left < right ? node.leftFirst : node.leftFirst + 1;
+                continue;
+            }
+            for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++)
+            {
+                float t = intersect(triangles[i], origin, direction);
+                if (t < distance)
+                {
+                    distance = t;
+                    triangle = i;
+                    found = true;
+                }
+            }
+        }
+        return found;
+    }
+
+    // GL thread: the nodes and triangles into their storage buffers, bound to their bindings
+    void upload()
+    {
+        deleteBuffers(2, buffers);
+        buffers[0] = buffers[1] = 0;
+        if (nodes.empty())
+            return;
+        buffers[0] = createBuffer(nodes.size() * sizeof(GpuBvhNode), nodes.data(), 0);
+        buffers[1] = createBuffer(triangles.size() * sizeof(GpuBvhTriangle), triangles.data(), 0);
+        bind();
+    }
+
+    void bind() const
+    {
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, NODE_BINDING, buffers[0], 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, TRIANGLE_BINDING, buffers[1], 0, 0);
+    }
+
+  private:
+    struct Box
+    {
+        glm::vec3 low = glm::vec3(1e30f), high = glm::vec3(-1e30f);
+
+        void grow(const Box &box)
+        {
+            low = glm::min(low, box.low);
+            high = glm::max(high, box.high);
+        }
+
+        void grow(const glm::vec3 &point)
+        {
+            low = glm::min(low, point);
+            high = glm::max(high, point);
+        }
+
+        glm::vec3 center() const
+        {
+            return (low + high) * 0.5f;
+        }
+
+        float area() const
+        {
+            return low.x <= high.x ? surfaceArea(low, high) : 0.0f;
+        }
+    };
+    struct Reference
+    {
+        Box box;
+        uint32_t triangle;
+    };
+    struct Bin
+    {
+        Box bounds;
+        Box centers;
+        uint32_t count = 0;
+    };
+    // the bins of one split along every axis
+    struct Bins
+    {
+        Bin bins[3][BINS];
+    };
+    // the triangles [first, first + count) of references under the node, their box and their centers' box
+    struct Range
+    {
+        uint32_t node;
+        uint32_t first;
+        uint32_t count;
+        int depth;
+        Box bounds;
+        Box centers;
+    };
+
+    // the triangles' boxes, split in place so the nodes bin and partition runs of them
+    std::vector<Reference> references;
+    std::atomic<uint32_t> nodeCount{0};
+    unsigned int buffers[2] = {0, 0};
+
+    static float surfaceArea(const glm::vec3 &low, const glm::vec3 &high)
+    {
+        glm::vec3 size = high - low;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    // bins per unit along each axis of a range's centers, 0 along the axes they are flat on
+    static glm::vec3 binScale(const Box &centers)
+    {
+        glm::vec3 extent = centers.high - centers.low;
+        return glm::vec3(extent.x > 0.0f ? BINS / extent.x : 0.0f, extent.y > 0.0f ? BINS / extent.y : 0.0f,
+                         extent.z > 0.0f ? BINS / extent.z : 0.0f);
+    }
+
+    // the bins of a center along every axis, the split and the partition agree by both using it
+    static glm::ivec3 binOf(const glm::vec3 &center, const Box &centers, const glm::vec3 &scale)
+    {
+        return glm::clamp(glm::ivec3((center - centers.low) * scale), glm::ivec3(0), glm::ivec3(BINS - 1));
+    }
+
+    void binRange(const Range &range, uint32_t first, uint32_t last, Bins &out) const
+    {
+        glm::vec3 scale = binScale(range.centers);
+        for (uint32_t i = first; i < last; i++)
+        {
+            const Box &box = references[i].box;
+            glm::vec3 center = box.center();
+            glm::ivec3 bins = binOf(center, range.centers, scale);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                Bin &bin = out.bins[axis][bins[axis]];
+                bin.bounds.grow(box);
+                bin.centers.grow(center);
+                bin.count++;
+            }
+        }
+    }
+
+    // splits range and its descendants, handing the large ones to other jobs of counter
+    void split(JobSystem &jobs, Range range, JobCounter &counter)
+    {
+        std::vector<Range> pending = {range};
+        while (!pending.empty())
+        {
+            Range current = pending.back();
+            pending.pop_back();
+            Range children[2];
+            if (!divide(jobs, current, children))
+                continue;
+            for (const Range &child : children)
+            {
+                if (child.count >= TASK_TRIANGLES && jobs.workerCount() > 0)
+                    jobs.submit([this, &jobs, child, &counter] { split(jobs, child, counter); }, counter);
+                else
+                    pending.push_back(child);
+            }
+        }
+    }
+
+    // the node of range as a leaf, or as an inner node over the two children it writes, true then
+    bool divide(JobSystem &jobs, const Range &range, Range children[2])
+    {
+        GpuBvhNode &node = nodes[range.node];
+        node.low = range.bounds.low;
+        node.high = range.bounds.high;
+        node.leftFirst = range.first;
+        node.count = range.count;
+        if (range.count <= 2 || range.depth >= MAX_DEPTH - 1)
+            return false;
+
+        Bins bins;
+        if (range.count >= PARALLEL_TRIANGLES)
+        {
+            // one set of bins per job's range, added up after
+            uint32_t grain = PARALLEL_TRIANGLES / 4;
+            std::vector<Bins> partial((range.count + grain - 1) / grain);
+            jobs.parallelFor(range.first, range.first + range.count, grain, [&](size_t first, size_t last) {
+                binRange(range, (uint32_t)first, (uint32_t)last, partial[(first - range.first) / grain]);
+            });
+            for (const Bins &part : partial)
+                for (int axis = 0; axis < 3; axis++)
+                    for (int b = 0; b < BINS; b++)
+                    {
+                        Bin &bin = bins.bins[axis][b];
+                        bin.bounds.grow(part.bins[axis][b].bounds);
+                        bin.centers.grow(part.bins[axis][b].centers);
+                        bin.count += part.bins[axis][b].count;
+                    }
+        }
+        else
+            binRange(range, range.first, range.first + range.count, bins);
+
+        // the cheapest boundary between bins: a node visit plus the triangle tests of either side
+        // weighted by the chance a ray through this node goes through that side's box
+        float bestCost = INFINITY;
+        int bestAxis = -1, bestSplit = 0;
+        float parentArea = std::max(range.bounds.area(), 1e-12f);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (range.centers.high[axis] <= range.centers.low[axis])
+                continue;
+            const Bin *axisBins = bins.bins[axis];
+            float rightArea[BINS];
+            uint32_t rightCount[BINS];
+            Box right;
+            uint32_t count = 0;
+            for (int b = BINS - 1; b > 0; b--)
+            {
+                right.grow(axisBins[b].bounds);
+                count += axisBins[b].count;
+                rightArea[b] = right.area();
+                rightCount[b] = count;
+            }
+            Box left;
+            count = 0;
+            for (int b = 1; b < BINS; b++)
+            {
+                left.grow(axisBins[b - 1].bounds);
+                count += axisBins[b - 1].count;
+                if (count == 0 || rightCount[b] == 0)
+                    continue;
+                float cost = 1.0f + (left.area() * (float)count + rightArea[b] * (float)rightCount[b]) / parentArea;
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        Reference *begin = references.data() + range.first, *end = begin + range.count, *middle;
+        if (bestAxis < 0)
+        {
+            // every center in one place: a leaf, or halves of it when that is too large
+            if (range.count <= MAX_LEAF)
+                return false;
+            middle = begin + range.count / 2;
+        }
+        else
+        {
+            if (bestCost >= (float)range.count && range.count <= MAX_LEAF)
+                return false;
+            glm::vec3 scale = binScale(range.centers);
+            middle = std::partition(begin, end, [&](const Reference &reference) {
+                return binOf(reference.box.center(), range.centers, scale)[bestAxis] < bestSplit;
+            });
+        }
+
+        uint32_t left = nodeCount.fetch_add(2);
+        node.leftFirst = left;
+        node.count = 0;
+        uint32_t leftCount = (uint32_t)(middle - begin);
+        children[0] = {left, range.first, leftCount, range.depth + 1, Box(), Box()};
+        children[1] = {left + 1, range.first + leftCount, range.count - leftCount, range.depth + 1, Box(), Box()};
+        if (bestAxis >= 0)
+        {
+            for (int b = 0; b < BINS; b++)
+            {
+                const Bin &bin = bins.bins[bestAxis][b];
+                Range &child = children[b < bestSplit ? 0 : 1];
+                child.bounds.grow(bin.bounds);
+                child.centers.grow(bin.centers);
+            }
+        }
+        else
+        {
+            for (int side = 0; side < 2; side++)
+                for (uint32_t i = children[side].first; i < children[side].first + children[side].count; i++)
+                {
+                    children[side].bounds.grow(references[i].box);
+                    children[side].centers.grow(references[i].box.center());
+                }
+        }
+        return true;
+    }
+
+    // distance along the ray to where it enters the node's box, infinite when it misses
+    static float enterBox(const GpuBvhNode &node, const glm::vec3 &origin, const glm::vec3 &inverse)
+    {
+        glm::vec3 t0 = (node.low - origin) * inverse, t1 = (node.high - origin) * inverse;
+        glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+        float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+        float exit = std::min(far.x, std::min(far.y, far.z));
+        return enter <= exit ? enter : INFINITY;
+    }
+
+    // Moeller-Trumbore, the distance to the hit from either side, infinite for a miss
+    static float intersect(const GpuBvhTriangle &triangle, const glm::vec3 &origin, const glm::vec3 &direction)
+    {
+        glm::vec3 edge1 = glm::vec3(triangle.edge1), edge2 = glm::vec3(triangle.edge2);
+        glm::vec3 p = glm::cross(direction, edge2);
+        float determinant = glm::dot(edge1, p);
+        if (std::abs(determinant) < 1e-12f)
+            return INFINITY;
+        float inverse = 1.0f / determinant;
+        glm::vec3 s = origin - triangle.corner;
+        float u = glm::dot(s, p) * inverse;
+        if (u < 0.0f || u > 1.0f)
+            return INFINITY;
+        glm::vec3 q = glm::cross(s, edge1);
+        float v = glm::dot(direction, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f)
+            return INFINITY;
+        float t = glm::dot(edge2, q) * inverse;
+        return t > 0.0f ? t : INFINITY;
+    }
+};
+
+#endif
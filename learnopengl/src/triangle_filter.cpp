@@ -0,0 +1,168 @@
+#ifndef TRIANGLE_FILTER_H
+#define TRIANGLE_FILTER_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "frame_data.cpp"
+#include "geometry_pool.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "shader.cpp"
+
+#include <algorithm>
+#include <cstdint>
+
+// Triangle by triangle culling of the meshlets the meshlet cull pass kept, before they reach
+// the rasterizer: shader_src/triangle_filter.comp runs a workgroup per command, drops the
+// triangles facing away from the camera, those with no area, those outside one side of the
+// frustum and those that fall between pixel centers, and appends the indices of the rest to
+// a compacted index buffer of its own. The command is pointed at them, submit() draws
+// through a VAO over the pool's vertices and that buffer. Face culling is off for the cubes,
+// the back faces it drops were hidden behind the front ones of the same closed mesh.
+// The pool's layout has to begin with a Snorm16 position (CookedVertex). How many triangles
+// went in and came out is read back FRAMES frames late, without waiting on the GPU.
+class TriangleFilter
+{
+  public:
+    // in place of the meshlet pass' tables, the pool's indices and vertices, the compacted
+    // indices in that of the ObjectData array, which submit() binds again, and the counters
+    static const unsigned int POOL_INDEX_BINDING = 1;
+    static const unsigned int POOL_VERTEX_BINDING = 4;
+    static const unsigned int FILTERED_BINDING = 2;
+    static const unsigned int STATS_BINDING = 7;
+    static const unsigned int FRAMES = 3;
+
+    // the counts of the last frame read back
+    uint64_t trianglesTested = 0;
+    uint64_t trianglesKept = 0;
+    // leave sub-pixel triangles in, multisampled targets sample off the pixel centers
+    bool keepSmallTriangles = false;
+
+    // program is shader_src/triangle_filter.comp
+    TriangleFilter(const GeometryPool &pool, Shader &program) : pool(pool), program(program)
+    {
+        VAO = createVertexArray();
+        GLbitfield flags = GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT;
+        for (unsigned int i = 0; i < FRAMES; i++)
+            statsBuffers[i] = createBuffer(sizeof(glm::uvec4), NULL, flags, GL_DYNAMIC_READ);
+    }
+
+    ~TriangleFilter()
+    {
+        for (unsigned int i = 0; i < FRAMES; i++)
+        {
+            if (fences[i])
+                glDeleteSync(fences[i]);
+        }
+        deleteBuffers(FRAMES, statsBuffers);
+        deleteBuffers(1, &indexBuffer);
+        glDeleteVertexArrays(1, &VAO);
+    }
+
+    TriangleFilter(const TriangleFilter &) = delete;
+    TriangleFilter &operator=(const TriangleFilter &) = delete;
+
+    // the positions it decodes: Snorm16 at the start of a vertex of whole words
+    static bool supports(const VertexLayout &layout)
+    {
+        return !layout.elements.empty() && layout.elements[0].location == 0 &&
+               layout.elements[0].format == VertexFormat::Snorm16 && layout.elements[0].boundsRelative &&
+               layout.offsets[0] == 0 && layout.stride % 4 == 0;
+    }
+
+    // the frame the commands are drawn into, in pixels
+    void setViewport(int width, int height)
+    {
+        viewport = glm::vec2((float)width, (float)height);
+    }
+
+    // filters the commandLimit commands at CULLED_COMMANDS_BINDING, counted at DRAW_COUNT_BINDING
+    // with compact, of the candidates at CANDIDATE_OBJECTS_BINDING; indexCount is the most
+    // indices they can have together
+    void run(size_t commandLimit, size_t indexCount)
+    {
+        reserve(indexCount);
+        collect();
+        glm::uvec4 zero(0u);
+        updateBuffer(statsBuffers[slot], 0, sizeof(zero), &zero);
+
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, POOL_INDEX_BINDING, pool.EBO, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, POOL_VERTEX_BINDING, pool.VBO, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, FILTERED_BINDING, indexBuffer, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, STATS_BINDING, statsBuffers[slot], 0, 0);
+
+        program.use();
+        if (!commandLimitLoc.valid())
+        {
+            program.bindUniformBlock("FrameData", FrameDataBuffer::BINDING);
+            commandLimitLoc = program.uniform("commandLimit");
+            vertexWordsLoc = program.uniform("vertexWords");
+            viewportLoc = program.uniform("viewport");
+        }
+        program.set(commandLimitLoc, (unsigned int)commandLimit);
+        program.set(vertexWordsLoc, (unsigned int)(pool.layout.stride / 4));
+        program.set(viewportLoc, keepSmallTriangles ? glm::vec2(0.0f) : viewport);
+        glDispatchCompute((GLuint)commandLimit, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT);
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot = (slot + 1) % FRAMES;
+    }
+
+    // the VAO the filtered commands are drawn with, in place of the pool's
+    void bind()
+    {
+        if (attachedVBO != pool.VBO)
+        {
+            pool.layout.apply(VAO, pool.VBO);
+            attachedVBO = pool.VBO;
+        }
+        glState.bindVertexArray(VAO);
+    }
+
+  private:
+    const GeometryPool &pool;
+    Shader &program;
+    UniformHandle commandLimitLoc, vertexWordsLoc, viewportLoc;
+    glm::vec2 viewport = glm::vec2(0.0f);
+    unsigned int VAO = 0, indexBuffer = 0, attachedVBO = 0;
+    // in indices
+    size_t capacity = 0;
+    unsigned int statsBuffers[FRAMES] = {};
+    GLsync fences[FRAMES] = {};
+    unsigned int slot = 0;
+
+    // grows the compacted indices by doubling, their contents only live for a frame
+    void reserve(size_t indexCount)
+    {
+        if (indexCount <= capacity)
+            return;
+        deleteBuffers(1, &indexBuffer);
+        capacity = std::max(indexCount, capacity * 2);
+        indexBuffer = createBuffer(capacity * sizeof(uint32_t), NULL, 0, GL_DYNAMIC_COPY, GPU_MEMORY_GEOMETRY);
+        setElementBuffer(VAO, indexBuffer);
+    }
+
+    // the counts of the slot about to be reused, when the GPU is done with them
+    void collect()
+    {
+        GLsync &fence = fences[slot];
+        if (!fence)
+            return;
+        GLenum state = glClientWaitSync(fence, 0, 0);
+        glDeleteSync(fence);
+        fence = 0;
+        // still in flight, this frame's counts are lost rather than waited for
+        if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+            return;
+        const glm::uvec4 *stats = (const glm::uvec4 *)mapBuffer(statsBuffers[slot], 0, sizeof(glm::uvec4),
+                                                                GL_MAP_READ_BIT);
+        if (!stats)
+            return;
+        trianglesTested = stats->x;
+        trianglesKept = stats->y;
+        unmapBuffer(statsBuffers[slot]);
+    }
+};
+
+#endif
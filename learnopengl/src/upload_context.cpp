@@ -0,0 +1,172 @@
+#ifndef UPLOAD_CONTEXT_H
+#define UPLOAD_CONTEXT_H
+
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+// A second GL context sharing objects with the main window's, current on a thread of its own
+// that runs the upload work handed to it, so texture and buffer data and glGenerateMipmap go
+// through the driver without holding up the frame. The context belongs to a hidden 1x1 window,
+// which GLFW needs made on the main thread. submit() is for the GL thread: the objects the
+// work fills are made there first, a fence tells the upload context when the main one has
+// them, and the work waits on it on the GPU before touching them. poll() runs a job's done
+// callback on the GL thread once the fence the upload thread put after the work has signaled,
+// so the main context never sees a half uploaded object. The work only sees its own context:
+// it binds with plain GL calls, never through glState, and its uploads read client memory.
+class UploadContext
+{
+  public:
+    ~UploadContext()
+    {
+        stop();
+    }
+
+    UploadContext() = default;
+    UploadContext(const UploadContext &) = delete;
+    UploadContext &operator=(const UploadContext &) = delete;
+
+    // the main thread with the shared context current, false when the driver won't share one
+    bool start(GLFWwindow *shared)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        window = glfwCreateWindow(1, 1, "uploads", NULL, shared);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (!window)
+        {
+            std::cout << "ERROR::UPLOAD_CONTEXT::CREATION_FAILED" << std::endl;
+            return false;
+        }
+        running = true;
+        worker = std::thread(&UploadContext::run, this);
+        return true;
+    }
+
+    // the work submitted so far done and called back, then the thread and the window gone;
+    // the main thread with the shared context current
+    void stop()
+    {
+        if (!worker.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_all();
+        worker.join();
+        while (!finished.empty())
+        {
+            glClientWaitSync(finished.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            complete();
+        }
+        glfwDestroyWindow(window);
+        window = NULL;
+    }
+
+    bool active() const
+    {
+        return worker.joinable();
+    }
+
+    // jobs submitted and not called back yet
+    size_t pending() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queued.size() + busy + finished.size();
+    }
+
+    // the GL thread: work runs on the upload thread, done back here from poll()
+    void submit(std::function<void()> work, std::function<void()> done)
+    {
+        Job job = {std::move(work), std::move(done), glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)};
+        // the upload context only waits on what has reached the driver
+        glFlush();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+
+    // the GL thread, once per frame: the jobs whose uploads the GPU has finished, in order
+    void poll()
+    {
+        for (;;)
+        {
+            GLsync fence;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (finished.empty())
+                    return;
+                fence = finished.front().fence;
+            }
+            GLenum status = glClientWaitSync(fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                return;
+            complete();
+        }
+    }
+
+  private:
+    struct Job
+    {
+        std::function<void()> work, done;
+        // the main context's before the work, then the upload context's after it
+        GLsync fence;
+    };
+
+    GLFWwindow *window = NULL;
+    std::thread worker;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Job> queued, finished;
+    size_t busy = 0;
+    bool running = false;
+
+    void complete()
+    {
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = std::move(finished.front());
+            finished.pop_front();
+        }
+        glDeleteSync(job.fence);
+        job.done();
+    }
+
+    void run()
+    {
+        glfwMakeContextCurrent(window);
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return !running || !queued.empty(); });
+                if (queued.empty())
+                    break;
+                job = std::move(queued.front());
+                queued.pop_front();
+                busy++;
+            }
+            glWaitSync(job.fence, 0, GL_TIMEOUT_IGNORED);
+            glDeleteSync(job.fence);
+            job.work();
+            job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+            std::lock_guard<std::mutex> lock(mutex);
+            busy--;
+            finished.push_back(std::move(job));
+        }
+        glfwMakeContextCurrent(NULL);
+    }
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef VARIABLE_RATE_SHADING_H
+#define VARIABLE_RATE_SHADING_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "gl_extensions.cpp"
+#include "gl_state.cpp"
+#include "shader.cpp"
+#include "shader_compiler.cpp"
+#include "texture.cpp"
+
+#include <algorithm>
+
+// Optional GL_NV_shading_rate_image path: the rasterizer runs the fragment shader once per
+// 1x2 up to 4x4 pixels where a shading rate image says so, every texel of the image covering a
+// tile of the framebuffer (16x16 pixels on current hardware). update() computes the image on
+// the GPU (shader_src/shading_rate.comp) from the last frame before the scene is drawn: tiles
+// whose luminance barely changes from pixel to pixel along an axis are shaded coarser along it,
+// tiles that move fast (the TemporalAA's velocities) one step coarser, and with the stereo eyes
+// the tiles away from the middle of an eye too. Between begin() and end() the draws use it.
+// Without the extension supported stays false and every call is a no-op.
+class VariableRateShading
+{
+  public:
+    // the rate of an axis is 1, 2 or 4 pixels, the image holds log2 x + 3 * log2 y
+    static const int RATE_COUNT = 9;
+    // invocations per group side of shading_rate.comp
+    static const int GROUP_SIZE = 8;
+
+    bool supported = false;
+    // luminance difference between neighbours (of luminance / (1 + luminance)) below which
+    // an axis is shaded at 2 pixels, at 4 below a quarter of it
+    float contrastThreshold = 0.04f;
+    // pixels per frame of motion from which a tile is shaded a step coarser
+    float motionThreshold = 8.0f;
+    // of the eye's half diagonal, the middle of the eye shaded at the full rate, a step coarser
+    // past it and two steps past twice it
+    float foveaRadius = 0.45f;
+
+    // loader is used for the extension entry points, e.g. glfwGetProcAddress
+    VariableRateShading(GLADloadproc loader, ShaderCompiler &compiler)
+    {
+        if (!hasGLExtension("GL_NV_shading_rate_image") || !GLAD_GL_VERSION_4_3)
+            return;
+        bindShadingRateImage = (BindShadingRateImageProc)loader("glBindShadingRateImageNV");
+        shadingRateImagePalette = (ShadingRateImagePaletteProc)loader("glShadingRateImagePaletteNV");
+        shadingRateImageBarrier = (ShadingRateImageBarrierProc)loader("glShadingRateImageBarrierNV");
+        int paletteSize = 0;
+        glGetIntegerv(GL_SHADING_RATE_IMAGE_PALETTE_SIZE_NV, &paletteSize);
+        glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_WIDTH_NV, &texelWidth);
+        glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_HEIGHT_NV, &texelHeight);
+        supported = bindShadingRateImage && shadingRateImagePalette && shadingRateImageBarrier &&
+                    paletteSize >= RATE_COUNT && texelWidth > 0 && texelHeight > 0;
+        if (!supported)
+            return;
+        glGetIntegerv(GL_MAX_VIEWPORTS, &viewports);
+        shader = &compiler.submitCompute("src/shader_src/shading_rate.comp");
+    }
+
+    VariableRateShading(const VariableRateShading &) = delete;
+    VariableRateShading &operator=(const VariableRateShading &) = delete;
+
+    // before the scene: the rate image of a width x height framebuffer from the last frame's
+    // color, its velocities when there are any; with eyes 2 the framebuffer is one stereo eye
+    // and color has both side by side, each tile takes the finer rate of the two
+    void update(const Texture2D &color, const Texture2D *velocities, int width, int height, int eyes)
+    {
+        if (!supported || width <= 0 || height <= 0)
+            return;
+        int columns = (width + texelWidth - 1) / texelWidth, rows = (height + texelHeight - 1) / texelHeight;
+        if (rates.width != columns || rates.height != rows)
+            rates.create(columns, rows, GL_R8UI, 1, GPU_MEMORY_RENDER_TARGETS);
+
+        shader->use();
+        if (!tileSizeLoc.valid())
+        {
+            tileSizeLoc = shader->uniform("tileSize");
+            paramsLoc = shader->uniform("params");
+            eyesLoc = shader->uniform("eyes");
+        }
+        shader->set(tileSizeLoc, glm::vec2(texelWidth, texelHeight));
+        shader->set(paramsLoc, glm::vec4(contrastThreshold, motionThreshold, eyes > 1 ? foveaRadius : 0.0f,
+                                         velocities ? 1.0f : 0.0f));
+        shader->set(eyesLoc, std::max(eyes, 1));
+        color.bind(0);
+        glState.bindSampler(0, 0);
+        (velocities ? velocities : &color)->bind(1);
+        glState.bindSampler(1, 0);
+        glBindImageTexture(0, rates.ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+        glDispatchCompute((columns + GROUP_SIZE - 1) / GROUP_SIZE, (rows + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        shadingRateImageBarrier(GL_TRUE);
+    }
+
+    // the draws from here on shade at the image's rates
+    void begin()
+    {
+        if (!supported || !rates.ID)
+            return;
+        // every viewport, the stereo eyes may each draw through their own
+        static const GLenum palette[RATE_COUNT] = {
+            GL_SHADING_RATE_1_INVOCATION_PER_PIXEL_NV,      GL_SHADING_RATE_1_INVOCATION_PER_2X1_PIXELS_NV,
+            GL_SHADING_RATE_1_INVOCATION_PER_2X1_PIXELS_NV, GL_SHADING_RATE_1_INVOCATION_PER_1X2_PIXELS_NV,
+            GL_SHADING_RATE_1_INVOCATION_PER_2X2_PIXELS_NV, GL_SHADING_RATE_1_INVOCATION_PER_4X2_PIXELS_NV,
+            GL_SHADING_RATE_1_INVOCATION_PER_1X2_PIXELS_NV, GL_SHADING_RATE_1_INVOCATION_PER_2X4_PIXELS_NV,
+            GL_SHADING_RATE_1_INVOCATION_PER_4X4_PIXELS_NV};
+        for (int viewport = 0; viewport < viewports; viewport++)
+            shadingRateImagePalette(viewport, 0, RATE_COUNT, palette);
+        bindShadingRateImage(rates.ID);
+        glState.enable(GL_SHADING_RATE_IMAGE_NV);
+        active = true;
+    }
+
+    // back to a fragment per pixel, e.g. for the shadow maps, which the image doesn't cover
+    void end()
+    {
+        if (!active)
+            return;
+        glState.disable(GL_SHADING_RATE_IMAGE_NV);
+        active = false;
+    }
+
+    bool isActive() const
+    {
+        return active;
+    }
+
+  private:
+    typedef void(APIENTRYP BindShadingRateImageProc)(GLuint texture);
+    typedef void(APIENTRYP ShadingRateImagePaletteProc)(GLuint viewport, GLuint first, GLsizei count,
+                                                         const GLenum *rates);
+    typedef void(APIENTRYP ShadingRateImageBarrierProc)(GLboolean synchronize);
+
+    BindShadingRateImageProc bindShadingRateImage = NULL;
+    ShadingRateImagePaletteProc shadingRateImagePalette = NULL;
+    ShadingRateImageBarrierProc shadingRateImageBarrier = NULL;
+    int texelWidth = 0, texelHeight = 0;
+    int viewports = 1;
+    Shader *shader = NULL;
+    UniformHandle tileSizeLoc, paramsLoc, eyesLoc;
+    Texture2D rates;
+    bool active = false;
+};
+
+#endif
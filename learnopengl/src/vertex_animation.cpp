@@ -0,0 +1,358 @@
+#ifndef VERTEX_ANIMATION_H
+#define VERTEX_ANIMATION_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "gltf_loader.cpp"
+#include "instance_buffer.cpp"
+#include "mesh.cpp"
+#include "render_stats.cpp"
+#include "shader.cpp"
+#include "skinning.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Vertex animation textures for crowds of background characters. bake() plays every clip of
+// every skin of a SkinningSystem at framesPerSecond once, with skin.comp writing the posed
+// positions and normals of each skinned primitive frame after frame into one buffer, read by
+// crowd.vs through a GL_RGBA32UI buffer texture, a texel per vertex and frame in the format
+// skin.comp writes. The crowd's instances are written once too: where each one stands, its
+// clip and its time offset, so a frame draws every copy of a primitive in one instanced draw
+// with no joints sampled, no palettes uploaded and nothing skinned; the vertex stage blends the
+// two frames around FrameData's time. Like AnimatedInstances the crowd is not culled.
+class VertexAnimations
+{
+  public:
+    // the instance attributes, the instanced model matrix's first locations
+    static const unsigned int PLACEMENT_LOCATION = 2;
+    static const unsigned int ANIMATION_LOCATION = 3;
+    static const unsigned int TEXTURE_UNIT = 3;
+    // instances per row of the crowd
+    static constexpr unsigned int ROW = 32;
+
+    // one baked primitive of a skin and every instance of it
+    struct Draw
+    {
+        // index into the scene's draws
+        uint32_t draw;
+        // texel of the first vertex of frame 0, and texels from a frame to the next
+        int firstTexel;
+        int frameTexels;
+        unsigned int VAO;
+        // around the whole crowd of the primitive, in world space
+        glm::vec3 center;
+        float radius;
+    };
+
+    // samples per second of clip, between them crowd.vs interpolates
+    float framesPerSecond = 30.0f;
+    std::vector<Draw> draws;
+    // crowd instances; frames and bytes baked
+    size_t instanceCount = 0;
+    size_t frames = 0;
+    size_t bytes = 0;
+
+    // skinProgram is skin.comp
+    VertexAnimations(const GltfScene &scene, Shader &skinProgram) : scene(scene), skinShader(skinProgram)
+    {
+    }
+
+    ~VertexAnimations()
+    {
+        for (const Draw &draw : draws)
+            glDeleteVertexArrays(1, &draw.VAO);
+        if (texture)
+            glDeleteTextures(1, &texture);
+        if (buffer)
+            deleteBuffers(1, &buffer);
+        if (instanceBuffer)
+            deleteBuffers(1, &instanceBuffer);
+    }
+
+    VertexAnimations(const VertexAnimations &) = delete;
+    VertexAnimations &operator=(const VertexAnimations &) = delete;
+
+    bool ready() const
+    {
+        return baked;
+    }
+
+    // once skinning is built: bakes the clips of its skins and places count copies of each as
+    // rows going away from the camera along +z from origin, every copy on a clip and a time of
+    // its own; false when the frames don't fit in a buffer texture
+    bool bake(const SkinningSystem &skinning, unsigned int count, const glm::vec3 &origin)
+    {
+        baked = true;
+        struct Clip
+        {
+            int animation;
+            uint32_t firstFrame, frameCount;
+            float duration;
+        };
+        struct Skin
+        {
+            std::vector<Clip> clips;
+            uint32_t frameCount = 0;
+        };
+        std::vector<Skin> skins(scene.skins.size());
+        GLint alignment = 256;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        size_t texelAlignment = std::max((size_t)alignment / TEXEL_BYTES, (size_t)1);
+
+        // where every frame of every primitive goes, each frame at a storage offset skin.comp can write at
+        size_t texels = 0;
+        for (uint32_t s = 0; s < scene.skins.size(); s++)
+        {
+            const std::vector<uint32_t> &skinDraws = skinning.drawsOf(s);
+            if (skinDraws.empty())
+                continue;
+            Skin &skin = skins[s];
+            for (int a = 0; a < (int)scene.animations.size(); a++)
+            {
+                float duration = scene.animations[a].duration;
+                uint32_t frameCount = std::max(1u, (uint32_t)std::lround(duration * framesPerSecond));
+                skin.clips.push_back({a, skin.frameCount, frameCount, duration});
+                skin.frameCount += frameCount;
+            }
+            // the rest pose when there is nothing to play
+            if (skin.clips.empty())
+            {
+                skin.clips.push_back({-1, 0, 1, 0.0f});
+                skin.frameCount = 1;
+            }
+            for (uint32_t d : skinDraws)
+            {
+                const Mesh &mesh = *scene.mesh(scene.draws[d].primitive);
+                size_t vertexCount = mesh.vertexBytes / mesh.layout.stride;
+                size_t frameTexels = (vertexCount + texelAlignment - 1) / texelAlignment * texelAlignment;
+                draws.push_back({d, (int)texels, (int)frameTexels, 0, glm::vec3(0.0f), 0.0f});
+                texels += frameTexels * skin.frameCount;
+            }
+        }
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        if (draws.empty() || texels > (size_t)maxTexels)
+        {
+            if (!draws.empty())
+                std::cout << "ERROR::VERTEX_ANIMATION::TOO_MANY_FRAMES " << texels << " texels\n";
+            draws.clear();
+            return false;
+        }
+        bytes = texels * TEXEL_BYTES;
+        buffer = createBuffer(bytes, NULL, 0, GL_STATIC_DRAW, GPU_MEMORY_GEOMETRY);
+        if (hasDSA())
+        {
+            glCreateTextures(GL_TEXTURE_BUFFER, 1, &texture);
+            glTextureBuffer(texture, GL_RGBA32UI, buffer);
+        }
+        else
+        {
+            glGenTextures(1, &texture);
+            glState.bindTexture(TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, buffer);
+        }
+
+        // the palettes of a skin's frames one after the other, skin.comp finds a frame's by firstJoint
+        skinShader.use();
+        if (!vertexCountLoc.valid())
+        {
+            vertexCountLoc = skinShader.uniform("vertexCount");
+            firstJointLoc = skinShader.uniform("firstJoint");
+            boundsCenterLoc = skinShader.uniform("boundsCenter");
+            boundsExtentLoc = skinShader.uniform("boundsExtent");
+        }
+        std::vector<glm::mat4> palettes;
+        size_t next = 0;
+        for (uint32_t s = 0; s < scene.skins.size(); s++)
+        {
+            const Skin &skin = skins[s];
+            if (skin.clips.empty())
+                continue;
+            size_t joints = scene.skins[s].joints.size();
+            palettes.resize(std::max(joints, (size_t)1) * skin.frameCount);
+            for (const Clip &clip : skin.clips)
+            {
+                for (uint32_t f = 0; f < clip.frameCount; f++)
+                {
+                    float time = clip.duration * (float)f / (float)clip.frameCount;
+                    skinning.pose(s, clip.animation, time, &palettes[(clip.firstFrame + f) * joints]);
+                }
+            }
+            unsigned int paletteBuffer =
+                createBuffer(palettes.size() * sizeof(glm::mat4), palettes.data(), 0, GL_STATIC_DRAW);
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, SkinningSystem::PALETTE_BINDING, paletteBuffer, 0, 0);
+            for (size_t i = 0; i < skinning.drawsOf(s).size(); i++, next++)
+            {
+                const Draw &draw = draws[next];
+                const Mesh &mesh = *scene.mesh(scene.draws[draw.draw].primitive);
+                uint32_t vertexCount = (uint32_t)(mesh.vertexBytes / mesh.layout.stride);
+                glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, SkinningSystem::SOURCE_BINDING, mesh.VBO, 0, 0);
+                skinShader.set(vertexCountLoc, vertexCount);
+                skinShader.set(boundsCenterLoc, mesh.boundsCenter);
+                skinShader.set(boundsExtentLoc, mesh.boundsExtent);
+                for (uint32_t f = 0; f < skin.frameCount; f++)
+                {
+                    GLintptr offset = (GLintptr)(draw.firstTexel + (size_t)f * draw.frameTexels) * TEXEL_BYTES;
+                    glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, SkinningSystem::OUTPUT_BINDING, buffer, offset,
+                                            (GLsizeiptr)(vertexCount * TEXEL_BYTES));
+                    skinShader.set(firstJointLoc, (uint32_t)(f * joints));
+                    glDispatchCompute((vertexCount + SkinningSystem::GROUP_SIZE - 1) / SkinningSystem::GROUP_SIZE, 1,
+                                      1);
+                }
+            }
+            frames += skin.frameCount;
+            // the binding goes before the buffer, the next update() binds its own palettes
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, SkinningSystem::PALETTE_BINDING, 0, 0, 0);
+            deleteBuffers(1, &paletteBuffer);
+        }
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        // the crowd of each skin, at the spacing of SkinningSystem::addInstances()
+        std::vector<Instance> instances;
+        next = 0;
+        for (uint32_t s = 0; s < scene.skins.size(); s++)
+        {
+            const Skin &skin = skins[s];
+            if (skin.clips.empty())
+                continue;
+            size_t skinDraws = skinning.drawsOf(s).size();
+            glm::vec3 center(0.0f), extent(0.0f);
+            for (size_t i = 0; i < skinDraws; i++)
+            {
+                const Mesh &mesh = *scene.mesh(scene.draws[draws[next + i].draw].primitive);
+                center = mesh.boundsCenter;
+                extent = glm::max(extent, mesh.boundsExtent);
+            }
+            float spacing = std::max(2.5f * std::max(extent.x, extent.z), 0.5f);
+            size_t firstInstance = instances.size();
+            uint32_t state = s * 7919u + 1u;
+            for (unsigned int i = 0; i < count; i++)
+            {
+                // xorshift32, as LightSet
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                const Clip &clip = skin.clips[i % skin.clips.size()];
+                float column = (float)(i % ROW) - (std::min(count, ROW) - 1) * 0.5f;
+                Instance instance;
+                instance.placement = glm::vec4(origin + glm::vec3(column, 0.0f, (float)(i / ROW)) * spacing,
+                                               (float)(state & 0xFFFF) / 65536.0f * 6.2831853f);
+                // frames per second of playback in w, so the clip's own length doesn't matter in the shader
+                float rate = clip.duration > 0.0f ? (float)clip.frameCount / clip.duration : 0.0f;
+                instance.animation = glm::vec4((float)clip.firstFrame, (float)clip.frameCount,
+                                               (float)(state >> 16) / 65536.0f * (float)clip.frameCount,
+                                               rate * (0.8f + 0.4f * (float)(i % 5) / 4.0f));
+                instances.push_back(instance);
+            }
+            glm::vec3 rows(std::min(count, ROW) * spacing, 0.0f, (float)((count + ROW - 1) / ROW) * spacing);
+            for (size_t i = 0; i < skinDraws; i++, next++)
+            {
+                draws[next].center = origin + center + glm::vec3(0.0f, 0.0f, rows.z * 0.5f - spacing * 0.5f);
+                draws[next].radius = glm::length(rows * 0.5f + extent);
+                drawInstances.push_back({firstInstance, (size_t)count});
+            }
+        }
+        instanceCount = instances.size();
+        if (instances.empty())
+            return true;
+        instanceBuffer = createBuffer(instances.size() * sizeof(Instance), instances.data(), 0);
+        for (size_t i = 0; i < draws.size(); i++)
+            draws[i].VAO = createDrawArray(*scene.mesh(scene.draws[draws[i].draw].primitive), drawInstances[i].first);
+        return true;
+    }
+
+    // points a program built from crowd.vs at the animation texture
+    void attach(Shader &program)
+    {
+        program.use();
+        program.setInt("animationTexture", TEXTURE_UNIT);
+    }
+
+    // every copy of draw i with a crowd.vs program in use, its firstTexel and frameTexels set
+    // from draws[i]
+    void draw(size_t i) const
+    {
+        const InstanceRange &range = drawInstances[i];
+        if (!range.count)
+            return;
+        const Mesh &mesh = *scene.mesh(scene.draws[draws[i].draw].primitive);
+        glState.bindTexture(TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+        glState.bindVertexArray(draws[i].VAO);
+        renderStats.countDraw(mesh.indexCount, range.count);
+        glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, mesh.indexType, (void *)0, (GLsizei)range.count);
+    }
+
+  private:
+    // float x 3 position and the signed 2_10_10_10 normal, SkinningSystem::OUTPUT_STRIDE
+    static const size_t TEXEL_BYTES = SkinningSystem::OUTPUT_STRIDE;
+
+    struct Instance
+    {
+        // xyz where it stands, w turned this many radians around y
+        glm::vec4 placement;
+        // x first frame of the clip, y its frames, z frames of offset, w frames per second
+        glm::vec4 animation;
+    };
+    struct InstanceRange
+    {
+        size_t first, count;
+    };
+
+    const GltfScene &scene;
+    Shader &skinShader;
+    UniformHandle vertexCountLoc, firstJointLoc, boundsCenterLoc, boundsExtentLoc;
+    bool baked = false;
+    unsigned int buffer = 0;
+    unsigned int texture = 0;
+    unsigned int instanceBuffer = 0;
+    // per draw the instances of its skin
+    std::vector<InstanceRange> drawInstances;
+
+    // the mesh's own vertices and indices, the instances from firstInstance on the binding of
+    // InstanceBuffer's instance stream
+    unsigned int createDrawArray(const Mesh &mesh, size_t firstInstance) const
+    {
+        unsigned int vertexArray = createVertexArray();
+        mesh.layout.apply(vertexArray, mesh.VBO);
+        setElementBuffer(vertexArray, mesh.EBO);
+        const unsigned int binding = InstanceBuffer::MODEL_BINDING;
+        GLintptr offset = (GLintptr)(firstInstance * sizeof(Instance));
+        if (hasDSA())
+        {
+            glVertexArrayVertexBuffer(vertexArray, binding, instanceBuffer, offset, sizeof(Instance));
+            glVertexArrayAttribFormat(vertexArray, PLACEMENT_LOCATION, 4, GL_FLOAT, GL_FALSE,
+                                      offsetof(Instance, placement));
+            glVertexArrayAttribFormat(vertexArray, ANIMATION_LOCATION, 4, GL_FLOAT, GL_FALSE,
+                                      offsetof(Instance, animation));
+            for (unsigned int location : {PLACEMENT_LOCATION, ANIMATION_LOCATION})
+            {
+                glVertexArrayAttribBinding(vertexArray, location, binding);
+                glEnableVertexArrayAttrib(vertexArray, location);
+            }
+            glVertexArrayBindingDivisor(vertexArray, binding, 1);
+            return vertexArray;
+        }
+        glState.bindVertexArray(vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glVertexAttribPointer(PLACEMENT_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                              (void *)(offset + offsetof(Instance, placement)));
+        glVertexAttribPointer(ANIMATION_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                              (void *)(offset + offsetof(Instance, animation)));
+        for (unsigned int location : {PLACEMENT_LOCATION, ANIMATION_LOCATION})
+        {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        return vertexArray;
+    }
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef VERTEX_PULLER_H
+#define VERTEX_PULLER_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "mesh.cpp"
+#include "mesh_cooker.cpp"
+#include "render_stats.cpp"
+#include "ring_buffer.cpp"
+#include "shader.cpp"
+
+#include <cstddef>
+#include <iostream>
+
+// Draws instanced meshes without vertex attributes for vertex_pulling.vs: the mesh's vertex and
+// index buffers are bound as shader storage and the shader fetches and decodes its corner by
+// gl_VertexID, the per-instance matrices and layers go through the frame's RingBuffer like
+// InstanceBuffer's and are read by gl_InstanceID. Every mesh is drawn out of one empty VAO,
+// changing the mesh rebinds two buffers instead of a VAO and its attribute setup.
+// Needs GL 4.3 with storage blocks in the vertex stage, and meshes in cookedMeshLayout(),
+// which is what the shader decodes.
+class VertexPuller
+{
+  public:
+    static const unsigned int VERTEX_BINDING = 8;
+    static const unsigned int INDEX_BINDING = 9;
+    static const unsigned int MODEL_BINDING = 10;
+    static const unsigned int LAYER_BINDING = 11;
+
+    bool supported = false;
+    // number of instances uploaded last
+    size_t count = 0;
+
+    VertexPuller(RingBuffer &ring) : ring(ring)
+    {
+        supported = isSupported();
+        if (supported)
+            emptyVAO = createVertexArray();
+    }
+
+    ~VertexPuller()
+    {
+        if (emptyVAO)
+            glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    VertexPuller(const VertexPuller &) = delete;
+    VertexPuller &operator=(const VertexPuller &) = delete;
+
+    static bool isSupported()
+    {
+        if (!GLAD_GL_VERSION_4_3)
+            return false;
+        GLint blocks = 0;
+        glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &blocks);
+        return blocks >= 4;
+    }
+
+    // copies one matrix and one layer per instance of the next draw into this frame's ring buffer region
+    void upload(const glm::mat4 *models, const int *layers, size_t instanceCount)
+    {
+        count = 0;
+        if (instanceCount == 0)
+            return;
+        modelOffset = ring.push(models, instanceCount * sizeof(glm::mat4), ring.storageAlignment);
+        layerOffset = ring.push(layers, instanceCount * sizeof(int), ring.storageAlignment);
+        if (modelOffset < 0 || layerOffset < 0)
+            return;
+        count = instanceCount;
+    }
+
+    // draws count instances of mesh with program, which has to be in use
+    void draw(const Shader &program, const Mesh &mesh)
+    {
+        if (!supported || count == 0)
+            return;
+        if (!(mesh.layout == cookedMeshLayout()))
+        {
+            if (!reportedLayout)
+                std::cout << "ERROR::VERTEX_PULLER::UNSUPPORTED_LAYOUT: only cookedMeshLayout() meshes are pulled\n";
+            reportedLayout = true;
+            return;
+        }
+        program.setBool("shortIndices", mesh.indexType == GL_UNSIGNED_SHORT);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, VERTEX_BINDING, mesh.VBO, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, mesh.EBO, 0, 0);
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, MODEL_BINDING, ring.ID, modelOffset,
+                                count * sizeof(glm::mat4));
+        glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, LAYER_BINDING, ring.ID, layerOffset, count * sizeof(int));
+        glState.bindVertexArray(emptyVAO);
+        renderStats.countDraw(mesh.indexCount, count);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, mesh.indexCount, (GLsizei)count);
+    }
+
+  private:
+    RingBuffer &ring;
+    unsigned int emptyVAO = 0;
+    GLintptr modelOffset = 0, layerOffset = 0;
+    bool reportedLayout = false;
+};
+
+#endif
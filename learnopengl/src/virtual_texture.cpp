@@ -0,0 +1,607 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "asset_pack.cpp"
+#include "gl_objects.cpp"
+#include "gl_state.cpp"
+#include "image_convert.cpp"
+#include "render_target.cpp"
+#include "shader.cpp"
+#include "stb_image.h"
+#include "texture.cpp"
+#include "texture_cooker.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Virtual texture file written by --cook-virtual: a VirtualTextureHeader, then every page of
+// every level, finest level first and row by row, each one pageSize + 2 * border texels on a
+// side of RGBA8 bottom-up like the loader's images. The border repeats the neighbouring pages'
+// texels (the edge at the texture's edges), so a page filters on its own. Level l has
+// pagesWide >> l pages on a side, the last level is a single page of the whole texture.
+
+#define VIRTUAL_TEXTURE_MAGIC 0x58455456u // "VTEX"
+#define VIRTUAL_TEXTURE_VERSION 1u
+
+struct VirtualTextureHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t pageSize;
+    uint32_t border;
+    uint32_t pagesWide;
+    uint32_t levels;
+    uint64_t pagesOffset;
+};
+static_assert(sizeof(VirtualTextureHeader) == 32, "virtual texture header is 32 bytes");
+
+// bilinear resize of RGBA8 texels, for fitting a source image to the virtual size
+inline std::vector<unsigned char> resampleImage(const unsigned char *rgba, int width, int height, int size)
+{
+    std::vector<unsigned char> result((size_t)size * size * 4);
+    for (int y = 0; y < size; y++)
+    {
+        float sy = std::max(0.0f, (y + 0.5f) * height / size - 0.5f);
+        int y0 = std::min((int)sy, height - 1), y1 = std::min(y0 + 1, height - 1);
+        float fy = sy - y0;
+        for (int x = 0; x < size; x++)
+        {
+            float sx = std::max(0.0f, (x + 0.5f) * width / size - 0.5f);
+            int x0 = std::min((int)sx, width - 1), x1 = std::min(x0 + 1, width - 1);
+            float fx = sx - x0;
+            for (int c = 0; c < 4; c++)
+            {
+                float top =
+                    rgba[((size_t)y0 * width + x0) * 4 + c] * (1.0f - fx) + rgba[((size_t)y0 * width + x1) * 4 + c] * fx;
+                float bottom =
+                    rgba[((size_t)y1 * width + x0) * 4 + c] * (1.0f - fx) + rgba[((size_t)y1 * width + x1) * 4 + c] * fx;
+                result[((size_t)y * size + x) * 4 + c] = (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+            }
+        }
+    }
+    return result;
+}
+
+// cooks sourcePath into a virtual texture of pageSize pages at outputPath; the image is stretched
+// to the power of two number of pages that holds its larger side
+inline bool cookVirtualTexture(const std::string &sourcePath, const std::string &outputPath, int pageSize = 128,
+                               int border = 1)
+{
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load_thread(0);
+    std::vector<unsigned char> source;
+    unsigned char *pixels = NULL;
+    if (readFileContents(sourcePath, source))
+        pixels = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &channels, 4);
+    if (pixels)
+        flipRows(pixels, width, height, 4);
+    if (!pixels)
+    {
+        std::cout << "ERROR::VIRTUAL_TEXTURE::FAILED_TO_LOAD: " << sourcePath << '\n';
+        return false;
+    }
+    int pagesWide = 1;
+    while (pagesWide * pageSize < std::max(width, height))
+        pagesWide *= 2;
+    int size = pagesWide * pageSize;
+    std::vector<unsigned char> level =
+        width == size && height == size ? std::vector<unsigned char>(pixels, pixels + (size_t)size * size * 4)
+                                        : resampleImage(pixels, width, height, size);
+    stbi_image_free(pixels);
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(outputPath).parent_path(), error);
+    std::ofstream file(outputPath, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cout << "ERROR::VIRTUAL_TEXTURE::COULD_NOT_WRITE: " << outputPath << '\n';
+        return false;
+    }
+    VirtualTextureHeader header = {VIRTUAL_TEXTURE_MAGIC, VIRTUAL_TEXTURE_VERSION, (uint32_t)pageSize, (uint32_t)border,
+                                   (uint32_t)pagesWide, 0, sizeof(VirtualTextureHeader)};
+    for (int pages = pagesWide; pages >= 1; pages /= 2)
+        header.levels++;
+    file.write((const char *)&header, sizeof(header));
+
+    int slot = pageSize + 2 * border;
+    std::vector<unsigned char> page((size_t)slot * slot * 4);
+    size_t pageCount = 0;
+    for (int pages = pagesWide; pages >= 1; pages /= 2)
+    {
+        int levelSize = pages * pageSize;
+        for (int py = 0; py < pages; py++)
+        {
+            for (int px = 0; px < pages; px++)
+            {
+                for (int y = 0; y < slot; y++)
+                {
+                    int sy = std::clamp(py * pageSize + y - border, 0, levelSize - 1);
+                    for (int x = 0; x < slot; x++)
+                    {
+                        int sx = std::clamp(px * pageSize + x - border, 0, levelSize - 1);
+                        std::memcpy(&page[((size_t)y * slot + x) * 4], &level[((size_t)sy * levelSize + sx) * 4], 4);
+                    }
+                }
+                file.write((const char *)page.data(), page.size());
+                pageCount++;
+            }
+        }
+        if (pages > 1)
+            level = cooker::downsample(level, levelSize, levelSize);
+    }
+    std::cout << "cooked " << sourcePath << " -> " << outputPath << " (" << size << "x" << size << ", " << pageCount
+              << " pages of " << pageSize << ", " << header.levels << " levels)\n";
+    return (bool)file;
+}
+
+// Virtual texturing: a texture far larger than video memory of which only the pages that are
+// on screen are resident. Every frame:
+// - the geometry that samples it is drawn again into a small feedback target (FEEDBACK_SCALE
+//   times smaller than the view) by a program that writes the page each pixel would sample,
+//   and the target is read back through a pixel pack buffer and a fence like the GpuPicker's,
+//   so update() finds the pages of a frame a couple of frames later without waiting,
+// - update() touches the requested pages that are resident and queues the others, together
+//   with their coarser ancestors and coarsest first, to a loader thread that reads them out of
+//   the asset pack's mapping (or the file when it isn't packed),
+// - at most UPLOADS_PER_FRAME loaded pages are copied into free slots of the page cache, an
+//   RGBA8 atlas of cacheSlots x cacheSlots pages, or over the least recently requested ones,
+// - the page table, a texture with a texel per page and a mip level per level, is rebuilt
+//   where it changed: every texel holds the cache slot and level of its page, or of the
+//   nearest resident ancestor, so sampling never misses and only gets blurrier.
+// virtual_texture.glsl does the sampling: the level from the derivatives, the page table
+// texel at that level, the texel in the cache slot it names. The coarsest page is loaded by
+// open() and never evicted. Filtering is bilinear within the chosen level (no
+// trilinear blend across levels).
+class VirtualTexture
+{
+  public:
+    static const unsigned int PAGE_TABLE_UNIT = 9;
+    static const unsigned int CACHE_UNIT = 10;
+    static const int FEEDBACK_SCALE = 8;
+    static const unsigned int FRAMES = 3;
+    static const int UPLOADS_PER_FRAME = 8;
+    // pages read ahead by the loader at most
+    static const size_t MAX_LOADING = 32;
+
+    // GL_LESS, or GL_GREATER with reversed Z
+    GLenum depthFunc = GL_LESS;
+
+    // pages in the cache, requested by the last feedback, loaded and evicted overall
+    size_t resident = 0;
+    size_t requested = 0;
+    size_t loaded = 0;
+    size_t evicted = 0;
+
+    VirtualTexture() : pageTableSampler(GL_NEAREST_MIPMAP_NEAREST, GL_NEAREST, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE),
+                       cacheSampler(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)
+    {
+    }
+
+    ~VirtualTexture()
+    {
+        if (loader.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            loader.join();
+        }
+        for (unsigned int i = 0; i < FRAMES; i++)
+        {
+            if (fences[i])
+                glDeleteSync(fences[i]);
+        }
+        deleteBuffers(FRAMES, buffers);
+    }
+
+    VirtualTexture(const VirtualTexture &) = delete;
+    VirtualTexture &operator=(const VirtualTexture &) = delete;
+
+    // false when path isn't a virtual texture
+    bool open(const std::string &texturePath, int slotsPerSide = 16)
+    {
+        path = texturePath;
+        std::vector<unsigned char> bytes(sizeof(VirtualTextureHeader));
+        if (!readPage(0, bytes.data(), bytes.size()))
+            return fail();
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        if (header.magic != VIRTUAL_TEXTURE_MAGIC || header.version != VIRTUAL_TEXTURE_VERSION || header.levels == 0 ||
+            header.pageSize == 0 || header.pagesWide != 1u << (header.levels - 1) || header.pagesWide > 256)
+            return fail();
+        slotTexels = (int)(header.pageSize + 2 * header.border);
+        pageBytes = (size_t)slotTexels * slotTexels * 4;
+        cacheSlots = std::max(2, std::min(slotsPerSide, 255));
+
+        // the pages of every level in one array, finest first like the file
+        size_t pageCount = 0;
+        for (uint32_t level = 0; level < header.levels; level++)
+        {
+            levelOffsets.push_back(pageCount);
+            size_t pages = header.pagesWide >> level;
+            pageCount += pages * pages;
+        }
+        pageSlots.assign(pageCount, -1);
+        pageStamps.assign(pageCount, 0);
+        pageLoading.assign(pageCount, false);
+        slotPages.assign((size_t)cacheSlots * cacheSlots, -1);
+        slotStamps.assign(slotPages.size(), 0);
+
+        pageTable.create((int)header.pagesWide, (int)header.pagesWide, GL_RGBA8, (int)header.levels);
+        cache.create(cacheSlots * slotTexels, cacheSlots * slotTexels, GL_RGBA8, 1);
+        for (uint32_t level = 0; level < header.levels; level++)
+        {
+            size_t pages = header.pagesWide >> level;
+            tables.emplace_back(pages * pages * 4, (unsigned char)0);
+        }
+        for (unsigned int i = 0; i < FRAMES; i++)
+            buffers[i] = createBuffer(feedbackBytes(), NULL, GL_MAP_READ_BIT, GL_STREAM_READ);
+        feedback.resize(feedbackWidth, feedbackHeight);
+
+        // the coarsest page is the fallback of every other one
+        std::vector<unsigned char> root(pageBytes);
+        if (!readPage(pageOffset(pageCount - 1), root.data(), root.size()))
+            return fail();
+        place((uint32_t)(pageCount - 1), root.data());
+        rebuildTable();
+        loader = std::thread(&VirtualTexture::loadLoop, this);
+        return true;
+    }
+
+
+    size_t cacheCapacity() const
+    {
+        return slotPages.size();
+    }
+
+    // the constant uniforms of a program that includes virtual_texture.glsl, feedback for the
+    // one drawn by beginFeedback()
+    void setup(Shader &program, bool isFeedback) const
+    {
+        program.use();
+        program.setInt("pageTable", PAGE_TABLE_UNIT);
+        program.setInt("pageCache", CACHE_UNIT);
+        program.setVec4("virtualSize", glm::vec4((float)(header.pagesWide * header.pageSize), (float)header.levels,
+                                                  (float)header.pageSize, (float)header.border));
+        program.setFloat("cacheSlots", (float)cacheSlots);
+        // the feedback target's derivatives are FEEDBACK_SCALE times those of the view
+        program.setFloat("levelBias", isFeedback ? -std::log2((float)FEEDBACK_SCALE) : 0.0f);
+    }
+
+    void bind() const
+    {
+        pageTable.bind(PAGE_TABLE_UNIT);
+        pageTableSampler.bind(PAGE_TABLE_UNIT);
+        cache.bind(CACHE_UNIT);
+        cacheSampler.bind(CACHE_UNIT);
+    }
+
+    // starts the feedback of a width x height view, false while every read back is in flight;
+    // remembers the target and viewport endFeedback() puts back
+    bool beginFeedback(int width, int height)
+    {
+        unsigned int next = (current + 1) % FRAMES;
+        if (fences[next])
+            return false;
+        current = next;
+        int w = std::max(1, width / FEEDBACK_SCALE), h = std::max(1, height / FEEDBACK_SCALE);
+        if (w != feedbackWidth || h != feedbackHeight)
+        {
+            feedbackWidth = w;
+            feedbackHeight = h;
+            feedback.resize(w, h);
+            for (unsigned int i = 0; i < FRAMES; i++)
+            {
+                deleteBuffers(1, &buffers[i]);
+                buffers[i] = createBuffer(feedbackBytes(), NULL, GL_MAP_READ_BIT, GL_STREAM_READ);
+            }
+        }
+        sizes[current] = glm::ivec2(w, h);
+
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &savedFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
+        feedback.bind();
+        glViewport(0, 0, w, h);
+        const float none[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, none);
+        const float farthest = depthFunc == GL_GREATER ? 0.0f : 1.0f;
+        glClearBufferfv(GL_DEPTH, 0, &farthest);
+        glState.enable(GL_DEPTH_TEST);
+        glState.setDepthMask(true);
+        glState.setDepthFunc(depthFunc);
+        glState.disable(GL_BLEND);
+        return true;
+    }
+
+    // queues the copy of the requests and its fence
+    void endFeedback()
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[current]);
+        glReadPixels(0, 0, sizes[current].x, sizes[current].y, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)savedFramebuffer);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+    }
+
+    // once per frame: reads the finished feedback, queues what it asks for and uploads loaded pages
+    void update()
+    {
+        frame++;
+        for (unsigned int k = 1; k <= FRAMES; k++)
+        {
+            unsigned int i = (current + k) % FRAMES;
+            if (!fences[i])
+                continue;
+            GLenum state = glClientWaitSync(fences[i], 0, 0);
+            if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(fences[i]);
+            fences[i] = NULL;
+            collect(i);
+        }
+
+        std::vector<LoadedPage> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t count = std::min(loadedPages.size(), (size_t)UPLOADS_PER_FRAME);
+            ready.assign(std::make_move_iterator(loadedPages.begin()),
+                         std::make_move_iterator(loadedPages.begin() + count));
+            loadedPages.erase(loadedPages.begin(), loadedPages.begin() + count);
+        }
+        bool changed = false;
+        for (LoadedPage &page : ready)
+        {
+            pageLoading[page.page] = false;
+            if (!page.texels.empty() && pageSlots[page.page] < 0)
+                changed |= place(page.page, page.texels.data());
+        }
+        if (changed)
+            rebuildTable();
+    }
+
+  private:
+    struct LoadedPage
+    {
+        uint32_t page;
+        // empty when the read failed
+        std::vector<unsigned char> texels;
+    };
+
+    std::string path;
+    VirtualTextureHeader header = {};
+    int slotTexels = 0;
+    size_t pageBytes = 0;
+    int cacheSlots = 0;
+    std::vector<size_t> levelOffsets;
+    // per page: its cache slot or -1, the frame it was last requested and whether it is queued
+    std::vector<int> pageSlots;
+    std::vector<unsigned int> pageStamps;
+    std::vector<bool> pageLoading;
+    // per cache slot: its page or -1 and the frame that page was last requested
+    std::vector<int> slotPages;
+    std::vector<unsigned int> slotStamps;
+    unsigned int frame = 0;
+
+    Texture2D pageTable, cache;
+    Sampler pageTableSampler, cacheSampler;
+    // RGBA8 page table texels per level, the CPU copy that is uploaded
+    std::vector<std::vector<unsigned char>> tables;
+    std::vector<uint32_t> requests;
+
+    RenderTarget feedback;
+    int feedbackWidth = 1, feedbackHeight = 1;
+    unsigned int buffers[FRAMES] = {};
+    GLsync fences[FRAMES] = {};
+    glm::ivec2 sizes[FRAMES] = {};
+    unsigned int current = 0;
+    GLint savedFramebuffer = 0;
+    GLint savedViewport[4] = {};
+
+    // queued by update(), read by the loader thread
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<uint32_t> queuedPages;
+    std::vector<LoadedPage> loadedPages;
+    bool stopping = false;
+
+    bool fail()
+    {
+        std::cout << "ERROR::VIRTUAL_TEXTURE::INVALID: " << path << '\n';
+        return false;
+    }
+
+    size_t feedbackBytes() const
+    {
+        return (size_t)feedbackWidth * feedbackHeight * 4;
+    }
+
+    uint64_t pageOffset(size_t page) const
+    {
+        return header.pagesOffset + (uint64_t)page * pageBytes;
+    }
+
+    // bytes at offset of the file, from the asset pack's mapping when it is packed
+    bool readPage(uint64_t offset, unsigned char *out, size_t bytes) const
+    {
+        const unsigned char *packed;
+        size_t size;
+        if (assetPack.view(path, packed, size))
+        {
+            if (offset + bytes > size)
+                return false;
+            std::memcpy(out, packed + offset, bytes);
+            return true;
+        }
+        return asyncIO.read(path, offset, bytes, out);
+    }
+
+    // the page of a level and page coordinates
+    uint32_t pageIndex(uint32_t level, uint32_t x, uint32_t y) const
+    {
+        return (uint32_t)(levelOffsets[level] + (size_t)y * (header.pagesWide >> level) + x);
+    }
+
+    // marks the feedback's pages and their ancestors requested, queues the missing ones coarsest first
+    void collect(unsigned int index)
+    {
+        size_t bytes = (size_t)sizes[index].x * sizes[index].y * 4;
+        const unsigned char *texels = (const unsigned char *)mapBuffer(buffers[index], 0, bytes, GL_MAP_READ_BIT);
+        if (!texels)
+            return;
+        requests.clear();
+        requested = 0;
+        for (size_t i = 0; i < bytes; i += 4)
+        {
+            // alpha is 0 where nothing sampled the texture
+            if (texels[i + 3] == 0 || texels[i + 2] >= header.levels)
+                continue;
+            uint32_t level = texels[i + 2], x = texels[i], y = texels[i + 1];
+            for (;;)
+            {
+                if (x >= header.pagesWide >> level || y >= header.pagesWide >> level)
+                    break;
+                uint32_t page = pageIndex(level, x, y);
+                // the ancestors were walked by whoever marked it
+                if (pageStamps[page] == frame)
+                    break;
+                pageStamps[page] = frame;
+                requested++;
+                if (pageSlots[page] >= 0)
+                    slotStamps[pageSlots[page]] = frame;
+                else if (!pageLoading[page])
+                    requests.push_back(page);
+                if (++level >= header.levels)
+                    break;
+                x /= 2;
+                y /= 2;
+            }
+        }
+        unmapBuffer(buffers[index]);
+
+        // higher page indices are coarser levels
+        std::sort(requests.begin(), requests.end(), [](uint32_t a, uint32_t b) { return a > b; });
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (uint32_t page : requests)
+            {
+                if (queuedPages.size() + loadedPages.size() >= MAX_LOADING)
+                    break;
+                pageLoading[page] = true;
+                queuedPages.push_back(page);
+            }
+        }
+        wake.notify_one();
+    }
+
+    // copies texels into a free slot or the least recently requested one, false when every slot
+    // was requested this frame
+    bool place(uint32_t page, const unsigned char *texels)
+    {
+        int slot = -1;
+        for (size_t i = 0; i < slotPages.size(); i++)
+        {
+            if (slotPages[i] < 0)
+            {
+                slot = (int)i;
+                break;
+            }
+            // the coarsest page stays
+            if ((size_t)slotPages[i] == pageSlots.size() - 1 || slotStamps[i] == frame)
+                continue;
+            if (slot < 0 || slotStamps[i] < slotStamps[slot])
+                slot = (int)i;
+        }
+        if (slot < 0)
+            return false;
+        if (slotPages[slot] >= 0)
+        {
+            pageSlots[slotPages[slot]] = -1;
+            evicted++;
+            resident--;
+        }
+        slotPages[slot] = (int)page;
+        slotStamps[slot] = frame;
+        pageSlots[page] = slot;
+        resident++;
+        loaded++;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        cache.uploadRegion(0, (slot % cacheSlots) * slotTexels, (slot / cacheSlots) * slotTexels, slotTexels,
+                           slotTexels, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        return true;
+    }
+
+    // every page table texel to its page's slot or its nearest resident ancestor's, coarsest level first
+    void rebuildTable()
+    {
+        for (int level = (int)header.levels - 1; level >= 0; level--)
+        {
+            uint32_t pages = header.pagesWide >> level;
+            std::vector<unsigned char> &table = tables[level];
+            for (uint32_t y = 0; y < pages; y++)
+            {
+                for (uint32_t x = 0; x < pages; x++)
+                {
+                    unsigned char *texel = &table[((size_t)y * pages + x) * 4];
+                    int slot = pageSlots[pageIndex((uint32_t)level, x, y)];
+                    if (slot >= 0)
+                    {
+                        texel[0] = (unsigned char)(slot % cacheSlots);
+                        texel[1] = (unsigned char)(slot / cacheSlots);
+                        texel[2] = (unsigned char)level;
+                        texel[3] = 255;
+                    }
+                    else if (level + 1 < (int)header.levels)
+                    {
+                        uint32_t parentPages = pages / 2;
+                        std::memcpy(texel, &tables[level + 1][((size_t)(y / 2) * parentPages + x / 2) * 4], 4);
+                    }
+                }
+            }
+            pageTable.upload(level, GL_RGBA, GL_UNSIGNED_BYTE, table.data());
+        }
+    }
+
+    void loadLoop()
+    {
+        for (;;)
+        {
+            uint32_t page;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !queuedPages.empty(); });
+                if (stopping)
+                    return;
+                page = queuedPages.front();
+                queuedPages.pop_front();
+            }
+            LoadedPage result = {page, std::vector<unsigned char>(pageBytes)};
+            if (!readPage(pageOffset(page), result.texels.data(), pageBytes))
+            {
+                std::cout << "ERROR::VIRTUAL_TEXTURE::COULD_NOT_READ_PAGE: " << page << '\n';
+                result.texels.clear();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            loadedPages.push_back(std::move(result));
+        }
+    }
+};
+
+#endif
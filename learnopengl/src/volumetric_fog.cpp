@@ -0,0 +1,144 @@
+#ifndef VOLUMETRIC_FOG_H
+#define VOLUMETRIC_FOG_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+#include "light_clusters.cpp"
+#include "shader.cpp"
+#include "shader_compiler.cpp"
+#include "texture.cpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Fog lit by the sun, the ambient and the clustered point lights, worked out in a froxel volume
+// instead of marched per pixel. The volume is the light clusters' frustum grid cut finer,
+// FROXELS_PER_TILE columns across each tile and SLICES_PER_CLUSTER slices in each of their
+// depth slices, so a froxel's lights are the run of the cluster it is part of and the
+// fragment shader finds its froxel the way it finds its cluster. Every frame, after the clusters
+// are built and the shadows drawn, shader_src/volumetric_fog.comp:
+// - lights every froxel at a point of its depth that moves from frame to frame and blends the
+//   result with last frame's at the same world position (the previous volume is kept for that),
+//   so the few samples per froxel add up over frames and the camera moving doesn't smear it;
+// - with INTEGRATE walks every column front to back once, storing the light the fog adds up to
+//   each froxel's far side and how much of what is behind still comes through.
+// The clustered fragment shaders (SHADER_VOLUMETRIC_FOG, clustered_lights.glsl) then fog a
+// surface with one filtered fetch of that volume. The fog is densest up to height and thins
+// out exponentially above it; shadowed when the clustered shaders are (SUN_SHADOWS, POINT_SHADOWS).
+class VolumetricFog
+{
+  public:
+    static const unsigned int FROXELS_PER_TILE = 8;
+    static const unsigned int SLICES_PER_CLUSTER = 2;
+    static const int FROXELS_X = LightClusters::GRID_X * FROXELS_PER_TILE;
+    static const int FROXELS_Y = LightClusters::GRID_Y * FROXELS_PER_TILE;
+    static const int FROXELS_Z = LightClusters::GRID_Z * SLICES_PER_CLUSTER;
+    // the integrated volume for the fragment shaders, last frame's scattering for the compute pass
+    static const unsigned int VOLUME_UNIT = 16;
+    static const unsigned int HISTORY_UNIT = 17;
+
+    // density at height and how fast it falls above, per unit of height
+    float density = 0.02f;
+    float heightFalloff = 0.15f;
+    float height = 0.0f;
+    // of the phase, 0 scatters evenly and towards 1 mostly forward
+    float anisotropy = 0.4f;
+    glm::vec3 albedo = glm::vec3(1.0f);
+    // how much of a froxel is last frame's
+    float temporalBlend = 0.9f;
+
+    // defines are SUN_SHADOWS and POINT_SHADOWS when the lighting pass is to use them
+    VolumetricFog(ShaderCompiler &compiler, const std::vector<std::string> &defines)
+        : lightShader(compiler.submitCompute("src/shader_src/volumetric_fog.comp", defines)),
+          integrateShader(compiler.submitCompute("src/shader_src/volumetric_fog.comp", {"INTEGRATE"})),
+          sampler(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE)
+    {
+        for (Texture3D &volume : scattering)
+            volume.create(FROXELS_X, FROXELS_Y, FROXELS_Z, GL_RGBA16F, GPU_MEMORY_RENDER_TARGETS);
+        integrated.create(FROXELS_X, FROXELS_Y, FROXELS_Z, GL_RGBA16F, GPU_MEMORY_RENDER_TARGETS);
+        glSamplerParameteri(sampler.ID, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+
+    VolumetricFog(const VolumetricFog &) = delete;
+    VolumetricFog &operator=(const VolumetricFog &) = delete;
+
+    // the clusters' storage blocks and image load/store in compute, and units past the 16 in use
+    static bool isSupported()
+    {
+        if (!GLAD_GL_VERSION_4_3)
+            return false;
+        GLint units = 0;
+        glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &units);
+        return units > (GLint)HISTORY_UNIT;
+    }
+
+    // the lighting pass, for the shadows to attach() to
+    Shader &lightingProgram()
+    {
+        return lightShader;
+    }
+
+    // points a program built with VOLUMETRIC_FOG at the volume
+    void attach(Shader &program)
+    {
+        program.use();
+        program.setInt("fogVolume", VOLUME_UNIT);
+    }
+
+    // lights and integrates this frame's volume after LightClusters::build() and with the
+    // shadows bound, view and viewProjection those of FrameData; leaves the volume bound
+    void update(const glm::mat4 &view, const glm::mat4 &viewProjection)
+    {
+        Texture3D &current = scattering[frames % 2];
+        Texture3D &previous = scattering[(frames + 1) % 2];
+
+        lightShader.use();
+        if (!inverseViewLoc.valid())
+        {
+            inverseViewLoc = lightShader.uniform("inverseView");
+            previousViewProjectionLoc = lightShader.uniform("previousViewProjection");
+            paramsLoc = lightShader.uniform("fogParams");
+            albedoLoc = lightShader.uniform("fogAlbedo");
+            temporalLoc = lightShader.uniform("temporalParams");
+            lightShader.setInt("history", HISTORY_UNIT);
+        }
+        lightShader.set(inverseViewLoc, glm::inverse(view));
+        lightShader.set(previousViewProjectionLoc, frames > 0 ? previousViewProjection : viewProjection);
+        lightShader.set(paramsLoc, glm::vec4(density, heightFalloff, height, anisotropy));
+        lightShader.set(albedoLoc, albedo);
+        // the golden ratio keeps the offsets of consecutive frames apart
+        float offset = (float)(frames % 1024) * 0.618034f;
+        lightShader.set(temporalLoc, glm::vec2(frames > 0 ? temporalBlend : 0.0f, offset - (int)offset));
+        previous.bind(HISTORY_UNIT);
+        sampler.bind(HISTORY_UNIT);
+        glBindImageTexture(0, current.ID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glDispatchCompute(FROXELS_X / 4, FROXELS_Y / 4, FROXELS_Z / 4);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        integrateShader.use();
+        glBindImageTexture(0, current.ID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA16F);
+        glBindImageTexture(1, integrated.ID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glDispatchCompute(FROXELS_X / 8, FROXELS_Y / 8, 1);
+        // the fragment shaders fetch it, the next frame's lighting pass samples this one's
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        integrated.bind(VOLUME_UNIT);
+        sampler.bind(VOLUME_UNIT);
+
+        previousViewProjection = viewProjection;
+        frames++;
+    }
+
+  private:
+    Shader &lightShader;
+    Shader &integrateShader;
+    UniformHandle inverseViewLoc, previousViewProjectionLoc, paramsLoc, albedoLoc, temporalLoc;
+    Texture3D scattering[2];
+    Texture3D integrated;
+    Sampler sampler;
+    glm::mat4 previousViewProjection = glm::mat4(1.0f);
+    uint64_t frames = 0;
+};
+
+#endif
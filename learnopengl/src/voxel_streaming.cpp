@@ -0,0 +1,337 @@
+#ifndef VOXEL_STREAMING_H
+#define VOXEL_STREAMING_H
+
+#include "glm/glm.hpp"
+
+#include "asset_pack.cpp"
+#include "job_system.cpp"
+#include "voxel_world.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Keeps a VoxelWorld's box of chunks centred on the camera over an unbounded world. update()
+// slides the box with the camera a column of chunks at a time: the chunks that fall out of it
+// go to a cache of at most cacheBudget voxel bytes, most recently evicted kept first, and the
+// ones that come in are taken from that cache or requested from a worker thread, which loads
+// the chunk saved under directory or else generates it. The worker takes the pending request
+// with the lowest score, the distance from the camera's chunk shortened ahead of the camera
+// and stretched behind it, scored again every update(). Chunks set() changed are written to
+// directory when they leave the cache and when the streamer goes, so digging survives both.
+// Chunks LOD_DISTANCE columns away are meshed at lod 1 and twice as far at lod 2; neighbours
+// of different lods are meshed from each other's voxels at their own resolution, so cracks
+// can show along those borders. The vertical extent stays the world's chunks.y.
+class VoxelStreamer
+{
+  public:
+    // columns of chunks from the camera's one to the first of lod 1
+    static const int LOD_DISTANCE = 4;
+    // chunks meshed per update(), the nearest first
+    static const size_t REMESH_BUDGET = 16;
+
+    std::string directory;
+    size_t cacheBudget;
+    // requested and not installed yet, and the cache's voxel bytes
+    size_t pending = 0;
+    size_t cachedBytes = 0;
+    // since the start: chunks read from directory, generated and written to it
+    size_t loaded = 0;
+    size_t generated = 0;
+    std::atomic<size_t> saved{0};
+
+    VoxelStreamer(VoxelWorld &world, int layers, size_t cacheBudget, const std::string &directory = "cache/voxels")
+        : directory(directory), cacheBudget(cacheBudget), world(world), layers(layers)
+    {
+        // nothing is resident until update() brings it in
+        for (size_t slot = 0; slot < world.grid.size(); slot++)
+        {
+            world.unload(slot);
+            world.grid[slot].coord = glm::ivec3(INT_MIN);
+        }
+        worker = std::thread(&VoxelStreamer::workerLoop, this);
+    }
+
+    // the worker's unfinished saves, the cache's changed chunks and the resident ones go to directory
+    ~VoxelStreamer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+        for (Save &save : saves)
+            write(save.coord, save.voxels);
+        for (Cached &cached : cache)
+            if (cached.modified)
+                write(cached.coord, cached.voxels);
+        for (const VoxelWorld::Chunk &chunk : world.grid)
+            if (chunk.resident && chunk.modified)
+                write(chunk.coord, chunk.voxels);
+    }
+
+    VoxelStreamer(const VoxelStreamer &) = delete;
+    VoxelStreamer &operator=(const VoxelStreamer &) = delete;
+
+    // the box centred on the chunk eye is in, the finished loads installed, the requests
+    // scored for eye looking along front, then the nearest dirty chunks remeshed
+    void update(JobSystem &jobs, const glm::vec3 &eye, const glm::vec3 &front)
+    {
+        glm::ivec3 center = VoxelWorld::chunkOf(glm::ivec3(glm::floor(eye - world.origin)));
+        center.y = 0;
+        glm::ivec3 low = center - world.chunks / 2;
+        low.y = 0;
+
+        std::vector<Result> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.swap(results);
+        }
+        for (Result &result : finished)
+        {
+            uint64_t key = keyOf(result.coord);
+            requested.erase(key);
+            (result.fromDisk ? loaded : generated)++;
+            size_t slot = world.chunkIndex(result.coord);
+            VoxelWorld::Chunk &chunk = world.grid[slot];
+            if (chunk.coord == result.coord && !chunk.resident)
+                world.install(slot, std::move(result.voxels), false);
+            else if (chunk.coord != result.coord && !cacheIndex.count(key))
+                remember(result.coord, std::move(result.voxels), false);
+        }
+
+        for (size_t slot = 0; slot < world.grid.size(); slot++)
+        {
+            VoxelWorld::Chunk &chunk = world.grid[slot];
+            glm::ivec3 wanted = low + (world.chunkCoord(slot) - low % world.chunks + world.chunks) % world.chunks;
+            if (chunk.coord != wanted)
+            {
+                if (chunk.resident)
+                {
+                    bool modified = chunk.modified;
+                    remember(chunk.coord, world.unload(slot), modified);
+                }
+                chunk.coord = wanted;
+                auto hit = cacheIndex.find(keyOf(wanted));
+                if (hit != cacheIndex.end())
+                {
+                    cachedBytes -= hit->second->voxels.bytes();
+                    world.install(slot, std::move(hit->second->voxels), hit->second->modified);
+                    cache.erase(hit->second);
+                    cacheIndex.erase(hit);
+                }
+                else if (requested.insert(keyOf(wanted)).second)
+                    fresh.push_back(wanted);
+            }
+            glm::ivec3 offset = glm::abs(wanted - center);
+            int lod = std::min(VoxelWorld::MAX_LOD, std::max(offset.x, offset.z) / LOD_DISTANCE);
+            if (chunk.resident && chunk.lod != lod)
+            {
+                chunk.lod = lod;
+                chunk.dirty = true;
+            }
+        }
+        trim();
+
+        glm::vec2 forward(front.x, front.z);
+        forward = glm::dot(forward, forward) > 1e-6f ? glm::normalize(forward) : glm::vec2(0.0f);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const glm::ivec3 &coord : fresh)
+                requests.push_back({coord, 0.0f});
+            fresh.clear();
+            // the ones the box has moved past are dropped, the rest scored again
+            for (size_t n = 0; n < requests.size();)
+            {
+                const VoxelWorld::Chunk &chunk = world.grid[world.chunkIndex(requests[n].coord)];
+                if (chunk.coord != requests[n].coord)
+                {
+                    requested.erase(keyOf(requests[n].coord));
+                    requests[n] = requests.back();
+                    requests.pop_back();
+                    continue;
+                }
+                glm::vec2 offset = glm::vec2(requests[n].coord.x - center.x, requests[n].coord.z - center.z);
+                float distance = glm::length(offset);
+                float ahead = distance > 0.0f ? glm::dot(offset / distance, forward) : 1.0f;
+                requests[n].score = distance * (1.0f - 0.5f * ahead) + requests[n].coord.y * 0.01f;
+                n++;
+            }
+        }
+        wake.notify_one();
+        pending = requested.size();
+
+        world.remesh(jobs, REMESH_BUDGET, center);
+    }
+
+  private:
+    struct Request
+    {
+        glm::ivec3 coord;
+        float score;
+    };
+
+    struct Result
+    {
+        glm::ivec3 coord;
+        VoxelChunk voxels;
+        bool fromDisk;
+    };
+
+    struct Save
+    {
+        glm::ivec3 coord;
+        VoxelChunk voxels;
+    };
+
+    struct Cached
+    {
+        glm::ivec3 coord;
+        VoxelChunk voxels;
+        bool modified;
+    };
+
+    VoxelWorld &world;
+    int layers;
+    // the main thread's
+    std::list<Cached> cache;
+    std::unordered_map<uint64_t, std::list<Cached>::iterator> cacheIndex;
+    // requested and not back yet, the worker may be on a dropped one
+    std::unordered_set<uint64_t> requested;
+    std::vector<glm::ivec3> fresh;
+    // shared with the worker under mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Request> requests;
+    std::vector<Save> saves;
+    std::vector<Result> results;
+    bool stopping = false;
+    std::thread worker;
+
+    static uint64_t keyOf(glm::ivec3 c)
+    {
+        const uint64_t mask = ((uint64_t)1 << 21) - 1;
+        return ((uint64_t)c.x & mask) << 42 | ((uint64_t)c.y & mask) << 21 | ((uint64_t)c.z & mask);
+    }
+
+    std::string path(glm::ivec3 c) const
+    {
+        return directory + "/" + std::to_string(c.x) + "_" + std::to_string(c.y) + "_" + std::to_string(c.z) + ".vox";
+    }
+
+    void remember(glm::ivec3 coord, VoxelChunk voxels, bool modified)
+    {
+        cachedBytes += voxels.bytes();
+        cache.push_front({coord, std::move(voxels), modified});
+        cacheIndex[keyOf(coord)] = cache.begin();
+    }
+
+    // the least recently evicted chunks dropped until the cache fits, the changed ones saved by the worker
+    void trim()
+    {
+        bool saving = false;
+        while (cachedBytes > cacheBudget && !cache.empty())
+        {
+            Cached &oldest = cache.back();
+            cachedBytes -= oldest.voxels.bytes();
+            if (oldest.modified)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                saves.push_back({oldest.coord, std::move(oldest.voxels)});
+                saving = true;
+            }
+            cacheIndex.erase(keyOf(oldest.coord));
+            cache.pop_back();
+        }
+        if (saving)
+            wake.notify_one();
+    }
+
+    // written aside and renamed, a load never reads half a chunk
+    bool write(glm::ivec3 coord, const VoxelChunk &voxels)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::vector<unsigned char> bytes;
+        voxels.serialize(bytes);
+        std::string entryPath = path(coord), temporary = entryPath + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                std::cout << "ERROR::VOXEL_STREAMING::COULD_NOT_WRITE: " << entryPath << '\n';
+                return false;
+            }
+            file.write((const char *)bytes.data(), (std::streamsize)bytes.size());
+        }
+        std::filesystem::rename(temporary, entryPath, error);
+        if (error)
+        {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+        saved++;
+        return true;
+    }
+
+    // saves before loads, so a chunk that is saved and wanted again reads back what was saved
+    void workerLoop()
+    {
+        for (;;)
+        {
+            bool save = false;
+            Save job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !saves.empty() || !requests.empty(); });
+                if (stopping)
+                    return;
+                if (!saves.empty())
+                {
+                    save = true;
+                    job = std::move(saves.back());
+                    saves.pop_back();
+                }
+                else
+                {
+                    auto best = std::min_element(requests.begin(), requests.end(),
+                                                 [](const Request &a, const Request &b) { return a.score < b.score; });
+                    job.coord = best->coord;
+                    *best = requests.back();
+                    requests.pop_back();
+                }
+            }
+            if (save)
+            {
+                write(job.coord, job.voxels);
+                continue;
+            }
+
+            Result result = {job.coord, VoxelChunk(), false};
+            std::vector<unsigned char> bytes;
+            result.fromDisk =
+                readFileContents(path(job.coord), bytes, IO_BACKGROUND) &&
+                result.voxels.deserialize(bytes.data(), bytes.size());
+            if (!result.fromDisk)
+                world.generateChunk(job.coord, layers, result.voxels);
+            std::lock_guard<std::mutex> lock(mutex);
+            results.push_back(std::move(result));
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,618 @@
+#ifndef VOXEL_WORLD_H
+#define VOXEL_WORLD_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "geometry_pool.cpp"
+#include "indirect_renderer.cpp"
+#include "job_system.cpp"
+#include "mesh.cpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// 0 is air, any other voxel is solid and textured with layer voxel - 1 of the material array
+typedef uint16_t Voxel;
+
+// SIZE^3 voxels stored as indices into a palette of the voxels the chunk holds, packed into
+// 64-bit words with as few bits as the palette needs: 0 while the chunk is all one voxel,
+// then 1, 2, 4, 8 or 16, powers of two so no index straddles two words. A set() of a voxel
+// new to the chunk grows the palette and once it outgrows the width, repacks at twice the
+// bits. Entries that are no longer used stay in the palette.
+class VoxelChunk
+{
+  public:
+    static const int SIZE = 32;
+    static const int VOLUME = SIZE * SIZE * SIZE;
+
+    VoxelChunk() : palette(1, 0)
+    {
+    }
+
+    static int index(int x, int y, int z)
+    {
+        return x + SIZE * (y + SIZE * z);
+    }
+
+    Voxel get(int x, int y, int z) const
+    {
+        return palette[read(index(x, y, z))];
+    }
+
+    // false when the voxel already was value
+    bool set(int x, int y, int z, Voxel value)
+    {
+        int i = index(x, y, z);
+        uint32_t current = read(i);
+        if (palette[current] == value)
+            return false;
+        uint32_t entry = (uint32_t)(std::find(palette.begin(), palette.end(), value) - palette.begin());
+        if (entry == palette.size())
+        {
+            palette.push_back(value);
+            if (palette.size() > (size_t)1 << bits)
+                repack(bits ? bits * 2 : 1);
+        }
+        write(i, entry);
+        return true;
+    }
+
+    // every voxel in x fastest, then y, then z order
+    void decode(Voxel *out) const
+    {
+        if (!bits)
+        {
+            std::fill(out, out + VOLUME, palette[0]);
+            return;
+        }
+        const uint64_t mask = ((uint64_t)1 << bits) - 1;
+        const int perWord = 64 / bits;
+        for (int w = 0, i = 0; i < VOLUME; w++)
+        {
+            uint64_t word = words[w];
+            for (int n = 0; n < perWord; n++, i++, word >>= bits)
+                out[i] = palette[(size_t)(word & mask)];
+        }
+    }
+
+    // the packed indices and the palette
+    size_t bytes() const
+    {
+        return words.size() * sizeof(uint64_t) + palette.size() * sizeof(Voxel);
+    }
+
+    // MAGIC, VERSION, the bits and palette size, the palette then the words as they are
+    void serialize(std::vector<unsigned char> &out) const
+    {
+        uint32_t header[4] = {MAGIC, VERSION, (uint32_t)bits, (uint32_t)palette.size()};
+        out.resize(sizeof(header) + bytes());
+        std::memcpy(out.data(), header, sizeof(header));
+        std::memcpy(out.data() + sizeof(header), palette.data(), palette.size() * sizeof(Voxel));
+        if (!words.empty())
+            std::memcpy(out.data() + sizeof(header) + palette.size() * sizeof(Voxel), words.data(),
+                        words.size() * sizeof(uint64_t));
+    }
+
+    // false, and the chunk untouched, unless data is a whole serialize() of this version
+    bool deserialize(const unsigned char *data, size_t size)
+    {
+        uint32_t header[4];
+        if (size < sizeof(header))
+            return false;
+        std::memcpy(header, data, sizeof(header));
+        int newBits = (int)header[2];
+        size_t entries = header[3], wordCount = (size_t)VOLUME * newBits / 64;
+        if (header[0] != MAGIC || header[1] != VERSION || header[2] > 16 || (newBits & (newBits - 1)) || entries == 0 ||
+            entries > (size_t)1 << newBits || size != sizeof(header) + entries * sizeof(Voxel) + wordCount * 8)
+            return false;
+        VoxelChunk chunk;
+        chunk.bits = newBits;
+        chunk.palette.resize(entries);
+        chunk.words.resize(wordCount);
+        std::memcpy(chunk.palette.data(), data + sizeof(header), entries * sizeof(Voxel));
+        if (wordCount)
+            std::memcpy(chunk.words.data(), data + sizeof(header) + entries * sizeof(Voxel), wordCount * 8);
+        // no index past the palette
+        for (int i = 0; i < VOLUME; i++)
+            if (chunk.read(i) >= entries)
+                return false;
+        *this = std::move(chunk);
+        return true;
+    }
+
+  private:
+    static const uint32_t MAGIC = 0x43584F56; // "VOXC"
+    static const uint32_t VERSION = 1;
+
+    std::vector<Voxel> palette;
+    std::vector<uint64_t> words;
+    int bits = 0;
+
+    uint32_t read(int i) const
+    {
+        if (!bits)
+            return 0;
+        size_t bit = (size_t)i * bits;
+        return (uint32_t)(words[bit >> 6] >> (bit & 63)) & (((uint32_t)1 << bits) - 1);
+    }
+
+    void write(int i, uint32_t entry)
+    {
+        size_t bit = (size_t)i * bits;
+        uint64_t mask = (((uint64_t)1 << bits) - 1) << (bit & 63);
+        uint64_t &word = words[bit >> 6];
+        word = (word & ~mask) | ((uint64_t)entry << (bit & 63));
+    }
+
+    void repack(int newBits)
+    {
+        std::vector<uint32_t> entries(VOLUME);
+        for (int i = 0; i < VOLUME; i++)
+            entries[i] = read(i);
+        bits = newBits;
+        words.assign((size_t)VOLUME * bits / 64, 0);
+        for (int i = 0; i < VOLUME; i++)
+            write(i, entries[i]);
+    }
+};
+
+// A box of chunks x chunks.y x chunks.z VoxelChunks, one voxel a world unit, voxel 0 at origin.
+// Every chunk is one mesh in its own GeometryPool whose vertices are 4 bytes: the corner
+// inside the chunk (0 to SIZE) and the face direction with the material layer above it,
+// decoded by voxel.vs. remesh() greedy meshes the chunks whose voxels changed since the last
+// time on the job system, a chunk per job, merging neighbouring faces of the same material and
+// direction into one quad, then swaps their ranges in the pool; draw() adds a command per
+// chunk with faces to an IndirectRenderer over that pool. set() marks the neighbouring
+// chunks too when the voxel is on a border, their faces against it come or go.
+// A slot of grid holds the chunk at its coord and chunk coordinates equal modulo chunks share
+// one, so the box can slide over an unbounded world a column of chunks at a time (see
+// voxel_streaming.cpp); a slot whose chunk is not resident reads as air. A chunk with lod 1 or
+// 2 is meshed from blocks of 2^3 or 4^3 voxels and drawn that many times larger.
+class VoxelWorld
+{
+  public:
+    static const int CHUNK = VoxelChunk::SIZE;
+    static constexpr int MAX_LOD = 2;
+
+    struct Chunk
+    {
+        VoxelChunk voxels;
+        MeshRange range;
+        glm::ivec3 coord = glm::ivec3(0);
+        bool resident = true;
+        bool dirty = true;
+        // set() changed it since it was generated or loaded
+        bool modified = false;
+        // the next remesh() meshes it at lod, it is drawn at the one it was meshed at
+        int lod = 0;
+        int meshedLod = 0;
+        size_t quads = 0;
+    };
+
+    glm::ivec3 chunks;
+    glm::vec3 origin;
+    std::vector<Chunk> grid;
+    GeometryPool pool;
+    // chunks meshed by the last remesh() and the quads of all of them
+    size_t remeshed = 0;
+    size_t quads = 0;
+
+    VoxelWorld(glm::ivec3 chunkCounts, glm::vec3 origin)
+        : chunks(glm::max(chunkCounts, glm::ivec3(1))), origin(origin),
+          grid((size_t)chunks.x * chunks.y * chunks.z), pool(layout(), 1 << 16, 1 << 17)
+    {
+        for (size_t c = 0; c < grid.size(); c++)
+            grid[c].coord = chunkCoord(c);
+    }
+
+    VoxelWorld(const VoxelWorld &) = delete;
+    VoxelWorld &operator=(const VoxelWorld &) = delete;
+
+    // corner xyz and face | layer << 3, as uvec4 aVoxel
+    static VertexLayout layout()
+    {
+        return VertexLayout({{0, 4, VertexFormat::Uint8}});
+    }
+
+    glm::ivec3 size() const
+    {
+        return chunks * CHUNK;
+    }
+
+    // the chunk coordinate of voxel p, rounded down on the negative side too
+    static glm::ivec3 chunkOf(glm::ivec3 p)
+    {
+        glm::ivec3 c;
+        for (int axis = 0; axis < 3; axis++)
+            c[axis] = p[axis] >= 0 ? p[axis] / CHUNK : (p[axis] + 1) / CHUNK - 1;
+        return c;
+    }
+
+    // the slot of chunk coordinate c
+    size_t chunkIndex(glm::ivec3 c) const
+    {
+        glm::ivec3 s = (c % chunks + chunks) % chunks;
+        return (size_t)s.x + (size_t)chunks.x * ((size_t)s.y + (size_t)chunks.y * s.z);
+    }
+
+    // the chunk coordinate slot index starts with
+    glm::ivec3 chunkCoord(size_t index) const
+    {
+        return glm::ivec3((int)(index % chunks.x), (int)(index / chunks.x % chunks.y),
+                          (int)(index / ((size_t)chunks.x * chunks.y)));
+    }
+
+    // the resident chunk at c, NULL when its slot holds another one or none
+    Chunk *find(glm::ivec3 c)
+    {
+        return const_cast<Chunk *>(static_cast<const VoxelWorld *>(this)->find(c));
+    }
+
+    const Chunk *find(glm::ivec3 c) const
+    {
+        if (c.y < 0 || c.y >= chunks.y)
+            return NULL;
+        const Chunk &chunk = grid[chunkIndex(c)];
+        return chunk.resident && chunk.coord == c ? &chunk : NULL;
+    }
+
+    // air outside of the resident chunks
+    Voxel get(glm::ivec3 p) const
+    {
+        glm::ivec3 c = chunkOf(p), local = p - c * CHUNK;
+        const Chunk *chunk = find(c);
+        return chunk ? chunk->voxels.get(local.x, local.y, local.z) : 0;
+    }
+
+    // the chunk and the neighbours sharing the voxel's faces are meshed again next remesh()
+    void set(glm::ivec3 p, Voxel value)
+    {
+        glm::ivec3 c = chunkOf(p), local = p - c * CHUNK;
+        Chunk *chunk = find(c);
+        if (!chunk || !chunk->voxels.set(local.x, local.y, local.z, value))
+            return;
+        chunk->dirty = true;
+        chunk->modified = true;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            glm::ivec3 step(0);
+            step[axis] = local[axis] == 0 ? -1 : local[axis] == CHUNK - 1 ? 1 : 0;
+            Chunk *neighbour = step[axis] ? find(c + step) : NULL;
+            if (neighbour)
+                neighbour->dirty = true;
+        }
+    }
+
+    // every voxel within radius of center set to value, in voxels from origin
+    void fillSphere(const glm::vec3 &center, float radius, Voxel value)
+    {
+        glm::ivec3 low = glm::ivec3(glm::floor(center - radius)), high = glm::ivec3(glm::ceil(center + radius));
+        for (int z = low.z; z <= high.z; z++)
+            for (int y = low.y; y <= high.y; y++)
+                for (int x = low.x; x <= high.x; x++)
+                {
+                    glm::vec3 offset = glm::vec3(x, y, z) + 0.5f - center;
+                    if (glm::dot(offset, offset) <= radius * radius)
+                        set(glm::ivec3(x, y, z), value);
+                }
+    }
+
+    // the chunk at coord of rolling hills of layers layers: the top one over a few of the
+    // second over the third. Reads nothing but chunks.y, any thread may call it
+    void generateChunk(glm::ivec3 coord, int layers, VoxelChunk &voxels) const
+    {
+        const float height = (float)size().y;
+        glm::ivec3 base = coord * CHUNK;
+        for (int z = 0; z < CHUNK; z++)
+            for (int x = 0; x < CHUNK; x++)
+            {
+                float wx = (float)(base.x + x), wz = (float)(base.z + z);
+                float surface = height * (0.45f + 0.12f * std::sin(wx * 0.05f) * std::cos(wz * 0.065f) +
+                                          0.06f * std::sin((wx + wz) * 0.11f));
+                for (int y = 0; y < CHUNK; y++)
+                {
+                    float wy = (float)(base.y + y);
+                    if (wy >= surface)
+                        break;
+                    int layer = wy >= surface - 1.0f ? 0 : wy >= surface - 4.0f ? 1 : 2;
+                    voxels.set(x, y, z, (Voxel)(std::min(layer, layers - 1) + 1));
+                }
+            }
+    }
+
+    // every chunk generated, a chunk per job
+    void generate(JobSystem &jobs, int layers)
+    {
+        jobs.parallelFor(0, grid.size(), 1, [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; c++)
+            {
+                generateChunk(grid[c].coord, layers, grid[c].voxels);
+                grid[c].dirty = true;
+            }
+        });
+    }
+
+    // the first solid voxel along the world space ray within distance and the one in front of it
+    bool raycast(const glm::vec3 &from, const glm::vec3 &direction, float distance, glm::ivec3 &hit,
+                 glm::ivec3 &before) const
+    {
+        // Amanatides and Woo, one voxel boundary at a time
+        glm::vec3 start = from - origin;
+        glm::ivec3 p = glm::ivec3(glm::floor(start));
+        glm::ivec3 step = glm::ivec3(glm::sign(direction));
+        glm::vec3 delta, next;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            delta[axis] = direction[axis] != 0.0f ? std::abs(1.0f / direction[axis]) : 1e30f;
+            float boundary = step[axis] > 0 ? p[axis] + 1.0f - start[axis] : start[axis] - p[axis];
+            next[axis] = direction[axis] != 0.0f ? boundary * delta[axis] : 1e30f;
+        }
+        before = p;
+        for (float t = 0.0f; t <= distance;)
+        {
+            if (get(p))
+            {
+                hit = p;
+                return true;
+            }
+            before = p;
+            int axis = next.x < next.y ? (next.x < next.z ? 0 : 2) : (next.y < next.z ? 1 : 2);
+            t = next[axis];
+            next[axis] += delta[axis];
+            p[axis] += step[axis];
+        }
+        return false;
+    }
+
+    // takes the chunk out of its slot, its mesh out of the pool, and hands back its voxels
+    VoxelChunk unload(size_t slot)
+    {
+        Chunk &chunk = grid[slot];
+        if (chunk.range.indexCount)
+            pool.remove(chunk.range);
+        chunk.range = MeshRange();
+        quads -= chunk.quads;
+        chunk.quads = 0;
+        chunk.resident = false;
+        chunk.dirty = false;
+        chunk.modified = false;
+        VoxelChunk voxels = std::move(chunk.voxels);
+        chunk.voxels = VoxelChunk();
+        return voxels;
+    }
+
+    // voxels become the resident chunk at the slot's coord, meshed with its neighbours next remesh()
+    void install(size_t slot, VoxelChunk voxels, bool modified)
+    {
+        Chunk &chunk = grid[slot];
+        chunk.voxels = std::move(voxels);
+        chunk.resident = true;
+        chunk.dirty = true;
+        chunk.modified = modified;
+        for (int axis = 0; axis < 3; axis++)
+            for (int side : {-1, 1})
+            {
+                glm::ivec3 step(0);
+                step[axis] = side;
+                Chunk *neighbour = find(chunk.coord + step);
+                if (neighbour)
+                    neighbour->dirty = true;
+            }
+    }
+
+    // meshes the dirty chunks on the job system and puts the meshes in the pool, no more than
+    // budget of them, the nearest to chunk focus first; the rest stay dirty
+    void remesh(JobSystem &jobs, size_t budget = SIZE_MAX, glm::ivec3 focus = glm::ivec3(0))
+    {
+        dirty.clear();
+        for (size_t c = 0; c < grid.size(); c++)
+            if (grid[c].dirty && grid[c].resident)
+                dirty.push_back((uint32_t)c);
+        if (dirty.size() > budget)
+        {
+            auto distance = [&](uint32_t c) {
+                glm::ivec3 offset = glm::abs(grid[c].coord - focus);
+                return offset.x + offset.y + offset.z;
+            };
+            std::nth_element(dirty.begin(), dirty.begin() + budget, dirty.end(),
+                             [&](uint32_t a, uint32_t b) { return distance(a) < distance(b); });
+            dirty.resize(budget);
+        }
+        remeshed = dirty.size();
+        if (dirty.empty())
+            return;
+        meshes.resize(std::max(meshes.size(), dirty.size()));
+        jobs.parallelFor(0, dirty.size(), 1, [&](size_t first, size_t last) {
+            std::vector<Voxel> padded;
+            for (size_t n = first; n < last; n++)
+                meshChunk(dirty[n], padded, meshes[n]);
+        });
+        // GL on this thread only
+        for (size_t n = 0; n < dirty.size(); n++)
+        {
+            Chunk &chunk = grid[dirty[n]];
+            const ChunkMesh &mesh = meshes[n];
+            if (chunk.range.indexCount)
+                pool.remove(chunk.range);
+            chunk.range = MeshRange();
+            quads -= chunk.quads;
+            chunk.quads = mesh.vertices.size() / 4;
+            quads += chunk.quads;
+            chunk.dirty = false;
+            chunk.meshedLod = chunk.lod;
+            if (mesh.vertices.empty())
+                continue;
+            glm::vec3 low(mesh.low), high(mesh.high);
+            chunk.range = pool.add(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(),
+                                   4, (low + high) * 0.5f, (high - low) * 0.5f);
+        }
+    }
+
+    // a command per chunk with faces, between renderer.begin() and its draw
+    void draw(IndirectRenderer &renderer) const
+    {
+        for (const Chunk &chunk : grid)
+        {
+            if (chunk.range.indexCount == 0)
+                continue;
+            glm::vec3 corner = origin + glm::vec3(chunk.coord * CHUNK);
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), corner);
+            renderer.add(chunk.range, glm::scale(model, glm::vec3((float)(1 << chunk.meshedLod))), 0);
+        }
+    }
+
+    // voxel bytes of every chunk together
+    size_t bytes() const
+    {
+        size_t total = 0;
+        for (const Chunk &chunk : grid)
+            total += chunk.voxels.bytes();
+        return total;
+    }
+
+  private:
+    struct ChunkMesh
+    {
+        std::vector<uint32_t> vertices;
+        std::vector<uint32_t> indices;
+        glm::ivec3 low, high;
+    };
+
+    std::vector<uint32_t> dirty;
+    std::vector<ChunkMesh> meshes;
+
+    static uint32_t packVertex(glm::ivec3 corner, int face, Voxel voxel)
+    {
+        return (uint32_t)corner.x | (uint32_t)corner.y << 8 | (uint32_t)corner.z << 16 |
+               (uint32_t)(face | (voxel - 1) << 3) << 24;
+    }
+
+    // one voxel for the step^3 from corner read by at: air unless at least half of them are
+    // solid, otherwise the highest solid one so a surface keeps its top layer
+    template <typename At> static Voxel block(glm::ivec3 corner, int step, At at)
+    {
+        if (step == 1)
+            return at(corner);
+        int solid = 0;
+        Voxel top = 0;
+        for (int y = 0; y < step; y++)
+            for (int z = 0; z < step; z++)
+                for (int x = 0; x < step; x++)
+                {
+                    Voxel voxel = at(corner + glm::ivec3(x, y, z));
+                    solid += voxel ? 1 : 0;
+                    top = voxel ? voxel : top;
+                }
+        return solid * 2 >= step * step * step ? top : 0;
+    }
+
+    // the chunk with a block of its neighbours on every side at its lod, greedy meshed into out
+    void meshChunk(uint32_t index, std::vector<Voxel> &padded, ChunkMesh &out) const
+    {
+        const Chunk &chunk = grid[index];
+        const int step = 1 << chunk.lod, side = CHUNK >> chunk.lod, P = side + 2;
+        out.vertices.clear();
+        out.indices.clear();
+        out.low = glm::ivec3(side);
+        out.high = glm::ivec3(0);
+        padded.assign((size_t)P * P * P, 0);
+        std::vector<Voxel> inner(VoxelChunk::VOLUME);
+        chunk.voxels.decode(inner.data());
+        glm::ivec3 base = chunk.coord * CHUNK;
+        auto inside = [&](glm::ivec3 p) { return inner[VoxelChunk::index(p.x, p.y, p.z)]; };
+        auto outside = [&](glm::ivec3 p) { return get(base + p); };
+        for (int z = -1; z <= side; z++)
+            for (int y = -1; y <= side; y++)
+                for (int x = -1; x <= side; x++)
+                {
+                    bool border = x < 0 || y < 0 || z < 0 || x == side || y == side || z == side;
+                    glm::ivec3 corner = glm::ivec3(x, y, z) * step;
+                    padded[(x + 1) + P * ((y + 1) + P * (z + 1))] =
+                        border ? block(corner, step, outside) : block(corner, step, inside);
+                }
+        const int strides[3] = {1, P, P * P};
+
+        // the faces on slice s of axis d lie between voxels s - 1 and s, positive masks face +d
+        std::vector<int> mask(side * side);
+        for (int d = 0; d < 3; d++)
+        {
+            const int u = (d + 1) % 3, v = (d + 2) % 3;
+            for (int s = 0; s <= side; s++)
+            {
+                for (int j = 0; j < side; j++)
+                {
+                    const Voxel *row = &padded[(size_t)((s + 1) * strides[d] + strides[u] + (j + 1) * strides[v])];
+                    for (int i = 0; i < side; i++)
+                    {
+                        Voxel a = row[i * strides[u] - strides[d]], b = row[i * strides[u]];
+                        int face = 0;
+                        // only the faces of this chunk's own voxels
+                        if (a && !b && s > 0)
+                            face = a;
+                        else if (b && !a && s < side)
+                            face = -(int)b;
+                        mask[i + j * side] = face;
+                    }
+                }
+                for (int j = 0; j < side; j++)
+                    for (int i = 0; i < side;)
+                    {
+                        int face = mask[i + j * side];
+                        if (!face)
+                        {
+                            i++;
+                            continue;
+                        }
+                        int width = 1;
+                        while (i + width < side && mask[i + width + j * side] == face)
+                            width++;
+                        int height = 1;
+                        for (; j + height < side; height++)
+                        {
+                            bool row = true;
+                            for (int k = 0; k < width && row; k++)
+                                row = mask[i + k + (j + height) * side] == face;
+                            if (!row)
+                                break;
+                        }
+                        for (int h = 0; h < height; h++)
+                            std::fill(&mask[i + (j + h) * side], &mask[i + (j + h) * side] + width, 0);
+                        emitQuad(d, u, v, s, i, j, width, height, face, out);
+                        i += width;
+                    }
+            }
+        }
+    }
+
+    // counter-clockwise seen from the side it faces
+    static void emitQuad(int d, int u, int v, int s, int i, int j, int width, int height, int face, ChunkMesh &out)
+    {
+        glm::ivec3 corner(0), du(0), dv(0);
+        corner[d] = s;
+        corner[u] = i;
+        corner[v] = j;
+        du[u] = width;
+        dv[v] = height;
+        glm::ivec3 corners[4] = {corner, corner + du, corner + du + dv, corner + dv};
+        if (face < 0)
+            std::swap(corners[1], corners[3]);
+        int direction = d * 2 + (face < 0 ? 1 : 0);
+        Voxel voxel = (Voxel)std::abs(face);
+        uint32_t first = (uint32_t)out.vertices.size();
+        for (const glm::ivec3 &c : corners)
+        {
+            out.vertices.push_back(packVertex(c, direction, voxel));
+            out.low = glm::min(out.low, c);
+            out.high = glm::max(out.high, c);
+        }
+        for (uint32_t k : {0u, 1u, 2u, 0u, 2u, 3u})
+            out.indices.push_back(first + k);
+    }
+};
+
+#endif
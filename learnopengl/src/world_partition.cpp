@@ -0,0 +1,544 @@
+#ifndef WORLD_PARTITION_H
+#define WORLD_PARTITION_H
+
+#include "glm/glm.hpp"
+
+#include "asset_pack.cpp"
+#include "hash.cpp"
+#include "hlod_proxies.cpp"
+#include "transform_system.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// An unbounded world of cubes cut into square cells of CELL_SIZE on the xz plane, the cells
+// around the camera kept in a TransformSystem of fixed size. The constructor fills it with
+// slotsFor(radius) slots, CELL_CAPACITY per block, one block per resident cell; a free slot is
+// parked far below the world with a zero axis at a quarter turn, which makes its model matrix
+// zero, so every render path draws and culls the same number of cubes whether they are in or
+// not. update() wants the cells within radius of the camera's cell and of the cell it is
+// predicted to be in LOOKAHEAD seconds from now, at its recent speed, and keeps one more ring
+// around either before letting a cell go. A worker thread takes the wanted cells nearest
+// to either first, reads them from directory or generates them and writes them there, and
+// update() installs the finished ones within two budgets per call: integrateBudget ms of main
+// thread time and uploadBudget bytes of instance data the renderer uploads for them. The
+// cells carry cubes only, the one cube mesh and the material array are shared by all of them.
+// A cell keeps its cubes relative to its corner, sector and offset, and installs them at doubles
+// in the TransformSystem, the positions are as precise at any distance from 0.
+// With a proxySource and a proxyRadius past radius the worker also builds each cell's HLOD proxy
+// (see hlod_proxies.cpp) of its cubes at rest, and the cells out to proxyRadius of the camera's
+// are kept as proxies only, which take no slots: update() hands the new ones to the caller in
+// newProxies and names the ones let go in droppedProxies, hasCubes() tells which to draw.
+class WorldPartition
+{
+  public:
+    static const uint32_t CELL_CAPACITY = 64;
+    static constexpr float CELL_SIZE = 24.0f;
+    static constexpr float LOOKAHEAD = 1.5f;
+    // the bytes a cube adds to the instance uploads, its model matrix and layer
+    static const size_t INSTANCE_BYTES = sizeof(glm::mat4) + sizeof(int);
+
+    std::string directory;
+    int radius;
+    double integrateBudget = 1.0;
+    size_t uploadBudget = 64 * 1024;
+    // material 0 or 1 per slot, for the caller to map to layers
+    std::vector<int> materials;
+    // the slots the last update() filled or parked
+    std::vector<uint32_t> changed;
+    // resident cells, requested and not installed yet, finished and waiting for the budgets
+    size_t resident = 0;
+    size_t pending = 0;
+    size_t waiting = 0;
+    // in the last update(): cells installed, their instance bytes and the time it took in ms
+    size_t installed = 0;
+    size_t uploadBytes = 0;
+    double integrateMs = 0.0;
+    // since the start: cells read from directory and generated
+    size_t loaded = 0;
+    size_t generated = 0;
+    // set before the first update(): the mesh of a cube (OBJ_VERTEX_FLOATS) its proxies merge,
+    // how many cells around the camera's have one and how far their simplification moves them
+    const MeshBuilder *proxySource = NULL;
+    int proxyRadius = 0;
+    float proxyError = 0.5f;
+    // of the last update(), for the caller to upload and to remove
+    std::vector<HlodProxy> newProxies;
+    std::vector<glm::ivec2> droppedProxies;
+    // cells with a proxy
+    size_t proxied = 0;
+
+    // blocks for every cell that can be kept, the squares around the camera and the predicted
+    // cell with their extra rings
+    static size_t slotsFor(int radius)
+    {
+        size_t kept = 2 * (size_t)radius + 3;
+        return 2 * kept * kept * CELL_CAPACITY;
+    }
+
+    WorldPartition(TransformSystem &cubes, int radius, const std::string &directory = "cache/world",
+                   uint32_t seed = 1)
+        : directory(directory), radius(radius), cubes(cubes), seed(seed)
+    {
+        size_t slots = slotsFor(radius);
+        cubes.reserve(cubes.size() + slots);
+        base = cubes.size();
+        for (size_t i = 0; i < slots; i++)
+            cubes.add(glm::vec3(0.0f, PARKED_Y, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), 0.0f);
+        materials.assign(slots, 0);
+        for (uint32_t slot = 0; slot < slots; slot++)
+            park(slot);
+        changed.clear();
+        blocks.resize(slots / CELL_CAPACITY);
+        for (size_t b = blocks.size(); b-- > 0;)
+            freeBlocks.push_back((uint32_t)b);
+        worker = std::thread(&WorldPartition::workerLoop, this);
+    }
+
+    ~WorldPartition()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+
+    WorldPartition(const WorldPartition &) = delete;
+    WorldPartition &operator=(const WorldPartition &) = delete;
+
+    // the cell a point is in
+    static glm::ivec2 cellOf(const glm::dvec3 &position)
+    {
+        return glm::ivec2((int)std::floor(position.x / CELL_SIZE), (int)std::floor(position.z / CELL_SIZE));
+    }
+
+    // whether the cubes of cell are in, and its proxy, if any, isn't to be drawn
+    bool hasCubes(glm::ivec2 cell) const
+    {
+        return cells.count(keyOf(cell)) != 0;
+    }
+
+    // dt seconds after the last call the camera is at eye: the cells that fell out let go, the
+    // new ones requested, the finished ones installed within the budgets
+    void update(const glm::dvec3 &eye, float dt)
+    {
+        auto start = std::chrono::steady_clock::now();
+        changed.clear();
+        newProxies.clear();
+        droppedProxies.clear();
+        installed = uploadBytes = 0;
+
+        // the camera's velocity smoothed over a few frames, so one jump doesn't swing the prediction
+        if (hasEye && dt > 0.0f)
+        {
+            float blend = std::min(1.0f, dt * 4.0f);
+            velocity += (glm::vec3((eye - lastEye) / (double)dt) - velocity) * blend;
+        }
+        lastEye = eye;
+        hasEye = true;
+        glm::ivec2 center = cellOf(eye);
+        glm::ivec2 ahead = cellOf(eye + glm::dvec3(velocity.x, 0.0f, velocity.z) * (double)LOOKAHEAD);
+
+        for (auto it = cells.begin(); it != cells.end();)
+        {
+            if (reach(cellOfKey(it->first), center, ahead) <= 1)
+            {
+                ++it;
+                continue;
+            }
+            evict(it->second);
+            it = cells.erase(it);
+        }
+        for (auto it = proxyCells.begin(); it != proxyCells.end();)
+        {
+            if (proxyReach(cellOfKey(*it), center) <= 1)
+            {
+                ++it;
+                continue;
+            }
+            droppedProxies.push_back(cellOfKey(*it));
+            it = proxyCells.erase(it);
+        }
+
+        std::vector<Result> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.swap(results);
+            // the ones out of range dropped, the rest scored for where the camera is now
+            for (size_t n = 0; n < requests.size();)
+            {
+                if (reach(requests[n].cell, center, ahead) > 0 && proxyReach(requests[n].cell, center) > 0)
+                {
+                    requested.erase(keyOf(requests[n].cell));
+                    requests[n] = requests.back();
+                    requests.pop_back();
+                    continue;
+                }
+                requests[n].score = score(requests[n].cell, center, ahead);
+                n++;
+            }
+            for (const glm::ivec2 &cell : wanted(center, ahead))
+            {
+                uint64_t key = keyOf(cell);
+                if (!cells.count(key) && !requested.count(key) && !ready.count(key))
+                {
+                    requested.insert(key);
+                    requests.push_back({cell, score(cell, center, ahead)});
+                }
+            }
+            // the proxies of the rings past them
+            if (proxying())
+                for (int z = -proxyRadius; z <= proxyRadius; z++)
+                    for (int x = -proxyRadius; x <= proxyRadius; x++)
+                    {
+                        glm::ivec2 cell = center + glm::ivec2(x, z);
+                        uint64_t key = keyOf(cell);
+                        if (!proxyCells.count(key) && !cells.count(key) && !requested.count(key) && !ready.count(key))
+                        {
+                            requested.insert(key);
+                            requests.push_back({cell, score(cell, center, ahead)});
+                        }
+                    }
+        }
+        wake.notify_one();
+        for (Result &result : finished)
+        {
+            uint64_t key = keyOf(result.cell);
+            requested.erase(key);
+            (result.fromDisk ? loaded : generated)++;
+            if (result.proxy.mesh && !proxyCells.count(key) && proxyReach(result.cell, center) <= 1)
+            {
+                proxyCells.insert(key);
+                newProxies.push_back(std::move(result.proxy));
+            }
+            // a dropped request the worker had already taken may have been made again
+            if (!cells.count(key))
+                ready[key] = std::move(result);
+        }
+
+        // the nearest finished cells first, each whole, until a budget is spent
+        std::vector<std::pair<float, uint64_t>> order;
+        for (auto it = ready.begin(); it != ready.end();)
+        {
+            if (reach(it->second.cell, center, ahead) > 0)
+            {
+                it = ready.erase(it);
+                continue;
+            }
+            order.push_back({score(it->second.cell, center, ahead), it->first});
+            ++it;
+        }
+        std::sort(order.begin(), order.end());
+        for (const auto &entry : order)
+        {
+            Result &result = ready[entry.second];
+            size_t bytes = result.cubes.size() * INSTANCE_BYTES;
+            if (freeBlocks.empty() || uploadBytes + bytes > uploadBudget || elapsedMs(start) >= integrateBudget)
+                break;
+            uint32_t block = freeBlocks.back();
+            freeBlocks.pop_back();
+            install(block, result.cell, result.cubes);
+            cells[entry.second] = block;
+            uploadBytes += bytes;
+            installed++;
+            ready.erase(entry.second);
+        }
+
+        resident = cells.size();
+        proxied = proxyCells.size();
+        pending = requested.size();
+        waiting = ready.size();
+        integrateMs = elapsedMs(start);
+    }
+
+  private:
+    // far below anything the camera looks at, a parked slot has no area anyway
+    static constexpr float PARKED_Y = -1e5f;
+    static const uint32_t MAGIC = 0x4C454357; // "WCEL"
+    static const uint32_t VERSION = 2;
+
+    struct Cube
+    {
+        // from the cell's corner
+        float position[3];
+        float axis[3];
+        float degreesPerSecond;
+        int32_t material;
+    };
+
+    struct Request
+    {
+        glm::ivec2 cell;
+        float score;
+    };
+
+    struct Result
+    {
+        glm::ivec2 cell;
+        std::vector<Cube> cubes;
+        bool fromDisk;
+        HlodProxy proxy;
+    };
+
+    struct Block
+    {
+        uint32_t count = 0;
+    };
+
+    TransformSystem &cubes;
+    uint32_t seed;
+    size_t base = 0;
+    std::vector<Block> blocks;
+    std::vector<uint32_t> freeBlocks;
+    // the main thread's: resident cells by key and their blocks, finished cells by key
+    std::unordered_map<uint64_t, uint32_t> cells;
+    std::unordered_map<uint64_t, Result> ready;
+    std::unordered_set<uint64_t> requested;
+    std::unordered_set<uint64_t> proxyCells;
+    glm::dvec3 lastEye = glm::dvec3(0.0);
+    glm::vec3 velocity = glm::vec3(0.0f);
+    bool hasEye = false;
+    // shared with the worker under mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Request> requests;
+    std::vector<Result> results;
+    bool stopping = false;
+    std::thread worker;
+
+    static uint64_t keyOf(glm::ivec2 c)
+    {
+        return (uint64_t)(uint32_t)c.x << 32 | (uint32_t)c.y;
+    }
+
+    static glm::ivec2 cellOfKey(uint64_t key)
+    {
+        return glm::ivec2((int32_t)(uint32_t)(key >> 32), (int32_t)(uint32_t)key);
+    }
+
+    static double elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool proxying() const
+    {
+        return proxySource && proxyRadius > radius;
+    }
+
+    // how many cells outside proxyRadius of the camera's cell, without proxies always outside
+    int proxyReach(glm::ivec2 cell, glm::ivec2 center) const
+    {
+        if (!proxying())
+            return 1 << 30;
+        glm::ivec2 fromCenter = glm::abs(cell - center);
+        return std::max(0, std::max(fromCenter.x, fromCenter.y) - proxyRadius);
+    }
+
+    // how many cells outside radius of both squares, 0 when in either
+    int reach(glm::ivec2 cell, glm::ivec2 center, glm::ivec2 ahead) const
+    {
+        glm::ivec2 fromCenter = glm::abs(cell - center), fromAhead = glm::abs(cell - ahead);
+        int outside = std::max(fromCenter.x, fromCenter.y) - radius;
+        return std::max(0, std::min(outside, std::max(fromAhead.x, fromAhead.y) - radius));
+    }
+
+    static float score(glm::ivec2 cell, glm::ivec2 center, glm::ivec2 ahead)
+    {
+        return std::min(glm::length(glm::vec2(cell - center)), glm::length(glm::vec2(cell - ahead)));
+    }
+
+    // the cells of both squares, once each
+    std::vector<glm::ivec2> wanted(glm::ivec2 center, glm::ivec2 ahead) const
+    {
+        std::vector<glm::ivec2> out;
+        for (glm::ivec2 square : {center, ahead})
+            for (int z = -radius; z <= radius; z++)
+                for (int x = -radius; x <= radius; x++)
+                {
+                    glm::ivec2 cell = square + glm::ivec2(x, z);
+                    if (square == ahead && reach(cell, center, center) == 0)
+                        continue;
+                    out.push_back(cell);
+                }
+        return out;
+    }
+
+    void park(uint32_t slot)
+    {
+        size_t i = base + slot;
+        cubes.positionX[i] = 0.0f;
+        cubes.positionY[i] = PARKED_Y;
+        cubes.positionZ[i] = 0.0f;
+        cubes.axisX[i] = cubes.axisY[i] = cubes.axisZ[i] = 0.0f;
+        cubes.angularSpeed[i] = 0.0f;
+        cubes.angles[i] = cubes.previousAngles[i] = 1.57079632679f;
+        changed.push_back(slot);
+    }
+
+    void install(uint32_t block, glm::ivec2 cell, const std::vector<Cube> &cellCubes)
+    {
+        blocks[block].count = (uint32_t)cellCubes.size();
+        for (uint32_t k = 0; k < blocks[block].count; k++)
+        {
+            const Cube &cube = cellCubes[k];
+            uint32_t slot = block * CELL_CAPACITY + k;
+            size_t i = base + slot;
+            glm::vec3 axis = glm::normalize(glm::vec3(cube.axis[0], cube.axis[1], cube.axis[2]));
+            cubes.positionX[i] = cell.x * (double)CELL_SIZE + cube.position[0];
+            cubes.positionY[i] = cube.position[1];
+            cubes.positionZ[i] = cell.y * (double)CELL_SIZE + cube.position[2];
+            cubes.axisX[i] = axis.x;
+            cubes.axisY[i] = axis.y;
+            cubes.axisZ[i] = axis.z;
+            cubes.angularSpeed[i] = glm::radians(cube.degreesPerSecond);
+            cubes.angles[i] = cubes.previousAngles[i] = 0.0f;
+            materials[slot] = cube.material;
+            changed.push_back(slot);
+        }
+    }
+
+    void evict(uint32_t block)
+    {
+        for (uint32_t k = 0; k < blocks[block].count; k++)
+            park(block * CELL_CAPACITY + k);
+        blocks[block].count = 0;
+        freeBlocks.push_back(block);
+    }
+
+    std::string path(glm::ivec2 c) const
+    {
+        return directory + "/" + std::to_string(c.x) + "_" + std::to_string(c.y) + ".cell";
+    }
+
+    // the same cubes for the same seed and cell, some cells nearly empty, some full
+    std::vector<Cube> generate(glm::ivec2 cell) const
+    {
+        int32_t words[3] = {cell.x, cell.y, (int32_t)seed};
+        std::mt19937 rng((uint32_t)fnv1a64(words, sizeof(words)));
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        uint32_t count = 4 + (uint32_t)(unit(rng) * unit(rng) * (CELL_CAPACITY - 4));
+        std::vector<Cube> out(count);
+        for (Cube &cube : out)
+        {
+            cube.position[0] = unit(rng) * CELL_SIZE;
+            cube.position[1] = unit(rng) * 6.0f - 2.0f;
+            cube.position[2] = unit(rng) * CELL_SIZE;
+            cube.axis[0] = unit(rng) - 0.5f;
+            cube.axis[1] = unit(rng) + 0.1f;
+            cube.axis[2] = unit(rng) - 0.5f;
+            // every other one stays still
+            cube.degreesPerSecond = unit(rng) < 0.5f ? 0.0f : 20.0f + unit(rng) * 60.0f;
+            cube.material = unit(rng) < 0.5f ? 0 : 1;
+        }
+        return out;
+    }
+
+    // the cell's cubes at rest merged, relative to its corner
+    void buildProxy(glm::ivec2 cell, const std::vector<Cube> &cellCubes, HlodProxy &proxy) const
+    {
+        std::vector<glm::mat4> models;
+        std::vector<int> cubeMaterials;
+        for (const Cube &cube : cellCubes)
+        {
+            models.push_back(
+                glm::translate(glm::mat4(1.0f), glm::vec3(cube.position[0], cube.position[1], cube.position[2])));
+            cubeMaterials.push_back(cube.material);
+        }
+        proxy.cell = cell;
+        proxy.corner = glm::dvec3(cell.x * (double)CELL_SIZE, 0.0, cell.y * (double)CELL_SIZE);
+        buildHlodProxy(*proxySource, models.data(), cubeMaterials.data(), models.size(), proxyError, proxy);
+    }
+
+    bool read(glm::ivec2 cell, std::vector<Cube> &out) const
+    {
+        std::vector<unsigned char> bytes;
+        if (!readFileContents(path(cell), bytes, IO_BACKGROUND) || bytes.size() < 3 * sizeof(uint32_t))
+            return false;
+        uint32_t header[3];
+        std::memcpy(header, bytes.data(), sizeof(header));
+        // one of an older version is generated again
+        if (header[0] == MAGIC && header[1] != VERSION)
+            return false;
+        if (header[0] != MAGIC || header[2] > CELL_CAPACITY ||
+            bytes.size() != sizeof(header) + header[2] * sizeof(Cube))
+        {
+            std::cout << "ERROR::WORLD_PARTITION::BAD_CELL: " << path(cell) << '\n';
+            return false;
+        }
+        out.resize(header[2]);
+        std::memcpy(out.data(), bytes.data() + sizeof(header), out.size() * sizeof(Cube));
+        return true;
+    }
+
+    // written aside and renamed, a read never sees half a cell
+    void write(glm::ivec2 cell, const std::vector<Cube> &cellCubes) const
+    {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::string cellPath = path(cell), temporary = cellPath + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                std::cout << "ERROR::WORLD_PARTITION::COULD_NOT_WRITE: " << cellPath << '\n';
+                return;
+            }
+            uint32_t header[3] = {MAGIC, VERSION, (uint32_t)cellCubes.size()};
+            file.write((const char *)header, sizeof(header));
+            file.write((const char *)cellCubes.data(), (std::streamsize)(cellCubes.size() * sizeof(Cube)));
+        }
+        std::filesystem::rename(temporary, cellPath, error);
+        if (error)
+            std::filesystem::remove(temporary, error);
+    }
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            glm::ivec2 cell;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !requests.empty(); });
+                if (stopping)
+                    return;
+                auto best = std::min_element(requests.begin(), requests.end(),
+                                             [](const Request &a, const Request &b) { return a.score < b.score; });
+                cell = best->cell;
+                *best = requests.back();
+                requests.pop_back();
+            }
+            Result result = {cell, {}, false};
+            result.fromDisk = read(cell, result.cubes);
+            if (!result.fromDisk)
+            {
+                result.cubes = generate(cell);
+                write(cell, result.cubes);
+            }
+            if (proxySource)
+                buildProxy(cell, result.cubes, result.proxy);
+            std::lock_guard<std::mutex> lock(mutex);
+            results.push_back(std::move(result));
+        }
+    }
+};
+
+#endif